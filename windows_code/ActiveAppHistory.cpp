@@ -0,0 +1,109 @@
+#include "ActiveAppHistory.h"
+#include <algorithm>
+
+ActiveAppHistory::ActiveAppHistory(std::chrono::seconds retention)
+    : retention(retention)
+    , ring(CAPACITY)
+    , head(0)
+    , count(0)
+{
+}
+
+void ActiveAppHistory::Append(const Record& record, TimePoint now) {
+    Prune(now);
+    if (count == CAPACITY) {
+        PopFront();
+    }
+    ring[(head + count) % CAPACITY] = record;
+    count++;
+    dwellSeconds[record.appId] += record.durationSeconds;
+}
+
+void ActiveAppHistory::Prune(TimePoint now) {
+    TimePoint cutoff = now - retention;
+    while (count > 0 && At(0).timestamp < cutoff) {
+        PopFront();
+    }
+}
+
+void ActiveAppHistory::PopFront() {
+    const Record& oldest = ring[head];
+    auto it = dwellSeconds.find(oldest.appId);
+    if (it != dwellSeconds.end()) {
+        it->second -= oldest.durationSeconds;
+        if (it->second <= 0) {
+            dwellSeconds.erase(it);
+        }
+    }
+    head = (head + 1) % CAPACITY;
+    count--;
+}
+
+void ActiveAppHistory::Prepend(const std::vector<Record>& older, TimePoint now) {
+    // Startup only, so rebuilding is fine: restored records, then current ones
+    std::vector<Record> merged;
+    merged.reserve(older.size() + count);
+    for (const auto& record : older) {
+        if (count == 0 || record.timestamp < At(0).timestamp) {
+            merged.push_back(record);
+        }
+    }
+    for (size_t index = 0; index < count; ++index) {
+        merged.push_back(At(index));
+    }
+
+    Clear();
+    for (const auto& record : merged) {
+        Append(record, now);                // Overflow keeps the newest CAPACITY
+    }
+    Prune(now);
+}
+
+void ActiveAppHistory::Clear() {
+    head = 0;
+    count = 0;
+    dwellSeconds.clear();
+}
+
+std::vector<ActiveAppHistory::Record> ActiveAppHistory::Last(size_t wanted) const {
+    size_t taken = (std::min)(wanted, count);
+    std::vector<Record> result;
+    result.reserve(taken);
+    for (size_t index = count - taken; index < count; ++index) {
+        result.push_back(At(index));
+    }
+    return result;
+}
+
+std::vector<ActiveAppHistory::Record> ActiveAppHistory::Since(TimePoint since) const {
+    // First record starting at or after `since`
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (At(middle).timestamp < since) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    std::vector<Record> result;
+    result.reserve(count - low);
+    for (size_t index = low; index < count; ++index) {
+        result.push_back(At(index));
+    }
+    return result;
+}
+
+std::vector<ActiveAppHistory::Dwell> ActiveAppHistory::DwellTimes() const {
+    std::vector<Dwell> result;
+    result.reserve(dwellSeconds.size());
+    for (const auto& entry : dwellSeconds) {
+        result.push_back(Dwell{ entry.first, entry.second });
+    }
+    std::sort(result.begin(), result.end(), [](const Dwell& a, const Dwell& b) {
+        return a.seconds > b.seconds;
+    });
+    return result;
+}
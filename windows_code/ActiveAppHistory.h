@@ -0,0 +1,74 @@
+#pragma once
+
+#include "WindowsAPIs.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * ActiveAppHistory - Bounded ring of finished app sessions with per-app totals
+ *
+ * Records arrive in time order (one per app or title switch), so the ring is
+ * sorted by start time: appending and pruning past the retention period are
+ * O(1) per record at the two ends, "last N" copies just N records, and
+ * "since T" binary-searches its start. Per-app dwell time over the retained
+ * records is kept as a running total, updated as records enter and leave,
+ * so totals never need recomputing from the history.
+ *
+ * Once CAPACITY records are held the oldest is overwritten even if still
+ * within retention; memory stays fixed at CAPACITY records (they are
+ * trivially copyable, see ActiveAppRecord).
+ *
+ * Usage:
+ *   ActiveAppHistory history(std::chrono::hours(1));
+ *   history.Append(record, std::chrono::system_clock::now());
+ *   std::vector<WindowsAPIs::ActiveAppRecord> recent = history.Last(10);
+ *
+ * Not thread-safe: callers lock around it (WindowsAPIs uses g_historyMutex).
+ */
+class ActiveAppHistory {
+public:
+    using Record = WindowsAPIs::ActiveAppRecord;
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    static constexpr size_t CAPACITY = 4096;
+
+    using Dwell = WindowsAPIs::AppDwellTime;
+
+    explicit ActiveAppHistory(std::chrono::seconds retention);
+
+    // Prunes expired records first; the record must not start before the newest one
+    void Append(const Record& record, TimePoint now);
+
+    // Drop records that started more than the retention period before `now`
+    void Prune(TimePoint now);
+
+    // Put older records (oldest first) in front of the current ones; those not
+    // strictly older than the first current record are skipped
+    void Prepend(const std::vector<Record>& older, TimePoint now);
+
+    void Clear();
+
+    // The newest `count` records, oldest first
+    std::vector<Record> Last(size_t count) const;
+
+    // Records that started at or after `since`, oldest first
+    std::vector<Record> Since(TimePoint since) const;
+
+    // Total duration per app over the retained records, longest first
+    std::vector<Dwell> DwellTimes() const;
+
+    size_t Size() const { return count; }
+
+private:
+    const Record& At(size_t index) const { return ring[(head + index) % CAPACITY]; }   // 0 = oldest
+    void PopFront();
+
+    std::chrono::seconds retention;
+    std::vector<Record> ring;               // CAPACITY slots
+    size_t head;                            // Oldest record
+    size_t count;
+    std::unordered_map<StringInterner::Id, int64_t> dwellSeconds;
+};
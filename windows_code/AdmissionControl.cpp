@@ -0,0 +1,166 @@
+#include "AdmissionControl.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+AdmissionControl::AdmissionControl()
+    : inFlight(0)
+    , maxConcurrent(Limits().maxConcurrent)
+    , admitted{}
+    , rejectedBusy(0)
+    , rejectedRate(0)
+    , clientRate(Limits().clientRate)
+    , clientBurst(Limits().clientBurst)
+{
+}
+
+void AdmissionControl::SetLimits(const Limits& limits) {
+    maxConcurrent = (std::max)(1, limits.maxConcurrent);
+    std::lock_guard<std::mutex> lock(mutex);
+    clientRate = (std::max)(0.0, limits.clientRate);
+    clientBurst = (std::max)(1, limits.clientBurst);
+    for (auto& [client, bucket] : buckets) {
+        bucket.tokens = (std::min)(bucket.tokens, clientBurst);
+    }
+}
+
+int64_t AdmissionControl::NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string AdmissionControl::ClientKey(const HttpRequest& request) {
+    std::string key = request.GetHeader("x-client-id");
+    if (key.empty()) {
+        key = request.remoteAddress + " " + request.GetHeader("user-agent");
+    }
+    if (key.size() > MAX_CLIENT_KEY) {
+        key.resize(MAX_CLIENT_KEY);
+    }
+    return key;
+}
+
+bool AdmissionControl::Acquire(Class requestClass) {
+    int limit = maxConcurrent.load();
+    // A cap of 1 has nothing to spare: the reserve would shut Read out
+    if (requestClass != Class::Ingest && limit >= 2) {
+        limit -= (std::max)(1, limit / RESERVED_SHARE);
+    }
+    int current = inFlight.load();
+    do {
+        if (current >= limit) {
+            return false;
+        }
+    } while (!inFlight.compare_exchange_weak(current, current + 1));
+    return true;
+}
+
+void AdmissionControl::Release() {
+    inFlight.fetch_sub(1);
+}
+
+// Drop buckets that have refilled (their client gets a full one back anyway);
+// with none of those, start over rather than grow past MAX_CLIENTS
+void AdmissionControl::EvictBuckets(int64_t nowUs) {
+    for (auto it = buckets.begin(); it != buckets.end();) {
+        double refilled = it->second.tokens + (nowUs - it->second.refilledUs) / 1e6 * clientRate;
+        it = refilled >= clientBurst ? buckets.erase(it) : std::next(it);
+    }
+    if (buckets.size() >= MAX_CLIENTS) {
+        buckets.clear();
+    }
+}
+
+bool AdmissionControl::TakeToken(const HttpRequest& request, int& retryAfterSeconds) {
+    std::string client = ClientKey(request);
+    int64_t now = NowUs();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (clientRate <= 0.0) {
+        return true;
+    }
+    auto it = buckets.find(client);
+    if (it == buckets.end()) {
+        if (buckets.size() >= MAX_CLIENTS) {
+            EvictBuckets(now);
+        }
+        it = buckets.emplace(std::move(client), Bucket{clientBurst, now}).first;
+    }
+    Bucket& bucket = it->second;
+    bucket.tokens = (std::min)(clientBurst, bucket.tokens + (now - bucket.refilledUs) / 1e6 * clientRate);
+    bucket.refilledUs = now;
+    if (bucket.tokens >= 1.0) {
+        bucket.tokens -= 1.0;
+        return true;
+    }
+    retryAfterSeconds = (std::max)(1, static_cast<int>(std::ceil((1.0 - bucket.tokens) / clientRate)));
+    return false;
+}
+
+void AdmissionControl::Reject(HttpResponse& response, int status, int retryAfterSeconds, const char* error) {
+    response.SetHeader("Content-Type", "application/json");
+    response.SetHeader("Retry-After", std::to_string(retryAfterSeconds));
+    response.SetBody(std::string("{\"error\":\"") + error + "\"}");
+    response.status = status;
+}
+
+HttpRouter::Middleware AdmissionControl::Gate(Class requestClass) {
+    return [this, requestClass](const HttpRequest& request, HttpResponse& response, const HttpRouter::Next& next) {
+        // The slot first, so a request turned away busy doesn't cost its client a token
+        if (!Acquire(requestClass)) {
+            rejectedBusy.fetch_add(1, std::memory_order_relaxed);
+            Reject(response, 503, 1, "Server busy");
+            return;
+        }
+        int retryAfterSeconds = 1;
+        if (requestClass == Class::Read && !TakeToken(request, retryAfterSeconds)) {
+            Release();
+            rejectedRate.fetch_add(1, std::memory_order_relaxed);
+            Reject(response, 429, retryAfterSeconds, "Too many requests");
+            return;
+        }
+        admitted[static_cast<int>(requestClass)].fetch_add(1, std::memory_order_relaxed);
+
+        try {
+            next();
+        }
+        catch (...) {
+            Release();
+            throw;
+        }
+        // A deferred request keeps its slot until the answer
+        if (response.IsDeferred()) {
+            response.completion->OnComplete([this](HttpResponse&) { Release(); });
+        } else {
+            Release();
+        }
+    };
+}
+
+std::string AdmissionControl::FormatPrometheus() const {
+    static const char* const CLASSES[] = { "read", "ingest" };
+    std::string out;
+    char line[160];
+    out += "# HELP perception_http_in_flight Requests in handlers or awaiting a deferred answer\n";
+    out += "# TYPE perception_http_in_flight gauge\n";
+    std::snprintf(line, sizeof(line), "perception_http_in_flight %d\n", inFlight.load());
+    out += line;
+
+    out += "# HELP perception_http_admitted_total Requests admitted per class\n";
+    out += "# TYPE perception_http_admitted_total counter\n";
+    for (int index = 0; index < static_cast<int>(Class::Count); ++index) {
+        std::snprintf(line, sizeof(line), "perception_http_admitted_total{class=\"%s\"} %llu\n", CLASSES[index],
+                      static_cast<unsigned long long>(admitted[index].load()));
+        out += line;
+    }
+
+    out += "# HELP perception_http_rejected_total Requests turned away: 429 (rate) or 503 (busy)\n";
+    out += "# TYPE perception_http_rejected_total counter\n";
+    std::snprintf(line, sizeof(line), "perception_http_rejected_total{reason=\"rate\"} %llu\n",
+                  static_cast<unsigned long long>(rejectedRate.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_http_rejected_total{reason=\"busy\"} %llu\n",
+                  static_cast<unsigned long long>(rejectedBusy.load()));
+    out += line;
+    return out;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "HttpRouter.h"
+
+/**
+ * AdmissionControl - Concurrency cap and per-client rate limits for the HTTP API
+ *
+ * A dashboard tab or agent polling /context in a tight loop costs a worker
+ * per request and takes the collector locks the voice path also takes. Each
+ * route gets a Gate middleware (inside its Metrics, so rejections are
+ * counted as 4xx/5xx there) of one of two classes:
+ *   Ingest  events pushed into the context (POST /ingest, /update_context):
+ *           never rate limited, and the last RESERVED_SHARE of the
+ *           concurrency cap is theirs alone (a cap of 1 is shared)
+ *   Read    everything else: one token per request from the client's
+ *           bucket (clientRate per second, up to clientBurst saved up), and
+ *           admitted only below the cap minus the ingest reserve
+ * A full cap answers 503 with Retry-After: 1 before any token is taken; an
+ * empty bucket answers 429 with Retry-After (whole seconds until the next
+ * token). A deferred
+ * request holds its slot until it is answered; an event stream gives it
+ * back once the stream is open.
+ *
+ * Clients are told apart by an X-Client-Id header when they send one, else
+ * by address and User-Agent (every client of a localhost server shares the
+ * address). At most MAX_CLIENTS buckets are kept; refilled ones are dropped
+ * first.
+ *
+ * Limits come from the http.* hot keys of RuntimeConfig and may change
+ * while requests run.
+ *
+ * Usage:
+ *   AdmissionControl admission;
+ *   admission.SetLimits({64, 20.0, 40});
+ *   router.Add(Method::Get, "/context", ServeContext).Use(admission.Gate(AdmissionControl::Class::Read));
+ */
+class AdmissionControl {
+public:
+    enum class Class { Read, Ingest, Count };
+
+    struct Limits {
+        int maxConcurrent = 64;         // Requests in handlers or deferred, both classes
+        double clientRate = 20.0;       // Read requests per second per client; 0: unlimited
+        int clientBurst = 40;           // Tokens a quiet client saves up
+    };
+
+    static constexpr int RESERVED_SHARE = 4;        // 1/4 of the cap (at least 1; none under 2) held for Ingest
+    static constexpr size_t MAX_CLIENTS = 1024;
+    static constexpr size_t MAX_CLIENT_KEY = 256;
+
+    AdmissionControl();
+
+    AdmissionControl(const AdmissionControl&) = delete;
+    AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+    void SetLimits(const Limits& limits);
+
+    /**
+     * @brief Middleware admitting (or answering 429/503 for) requests of one class
+     */
+    HttpRouter::Middleware Gate(Class requestClass);
+
+    int GetInFlight() const { return inFlight.load(); }
+
+    /**
+     * @brief Prometheus text: in-flight requests, admissions and rejections
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    struct Bucket {
+        double tokens = 0.0;
+        int64_t refilledUs = 0;
+    };
+
+    bool Acquire(Class requestClass);
+    void Release();
+    // false with the seconds until the next token when the client's bucket is empty
+    bool TakeToken(const HttpRequest& request, int& retryAfterSeconds);
+    void EvictBuckets(int64_t nowUs);
+    static std::string ClientKey(const HttpRequest& request);
+    static void Reject(HttpResponse& response, int status, int retryAfterSeconds, const char* error);
+    static int64_t NowUs();
+
+    std::atomic<int> inFlight;
+    std::atomic<int> maxConcurrent;
+    std::atomic<uint64_t> admitted[static_cast<int>(Class::Count)];
+    std::atomic<uint64_t> rejectedBusy;
+    std::atomic<uint64_t> rejectedRate;
+
+    std::mutex mutex;                   // Everything below
+    double clientRate;
+    double clientBurst;
+    std::unordered_map<std::string, Bucket> buckets;
+};
@@ -0,0 +1,269 @@
+#include "AppClassifier.h"
+#include "JsonReader.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cwctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+// Title rules come first so that what a browser shows can override its process rule
+static const char* const DEFAULT_RULES = R"({ "rules": [
+    { "category": "meeting",
+      "processes": ["zoom.exe", "teams.exe", "ms-teams.exe", "webex.exe", "webexmta.exe"],
+      "titles": ["zoom meeting", "meet - ", "webex meeting"] },
+    { "category": "media",
+      "processes": ["spotify.exe", "vlc.exe", "wmplayer.exe", "music.ui.exe", "potplayermini64.exe",
+                    "mpc-hc64.exe"],
+      "titles": [" - youtube", " - netflix", " - twitch"] },
+    { "category": "chat",
+      "processes": ["slack.exe", "discord.exe", "telegram.exe", "whatsapp.exe", "signal.exe", "wechat.exe"] },
+    { "category": "browser",
+      "processes": ["chrome.exe", "msedge.exe", "firefox.exe", "opera.exe", "brave.exe", "vivaldi.exe",
+                    "iexplore.exe"] },
+    { "category": "ide",
+      "processes": ["code.exe", "cursor.exe", "devenv.exe", "idea64.exe", "pycharm64.exe", "clion64.exe",
+                    "rider64.exe", "webstorm64.exe", "goland64.exe", "studio64.exe", "sublime_text.exe",
+                    "notepad++.exe"] },
+    { "category": "terminal",
+      "processes": ["windowsterminal.exe", "cmd.exe", "powershell.exe", "pwsh.exe", "wezterm-gui.exe",
+                    "alacritty.exe", "mintty.exe"] },
+    { "category": "office",
+      "processes": ["winword.exe", "excel.exe", "powerpnt.exe", "onenote.exe", "outlook.exe", "acrord32.exe",
+                    "notion.exe", "obsidian.exe"] }
+] })";
+
+static const char* const CATEGORY_NAMES[] = {
+    "unknown", "browser", "ide", "terminal", "meeting", "chat", "media", "office"
+};
+
+static bool ParseCategory(std::string_view name, AppCategory& category) {
+    for (size_t index = 1; index < sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]); ++index) {
+        if (name == CATEGORY_NAMES[index]) {
+            category = static_cast<AppCategory>(index);
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::wstring Utf8ToWide(std::string_view text) {
+    if (text.empty()) {
+        return std::wstring();
+    }
+    int wideSize = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring wide(wideSize > 0 ? wideSize : 0, L'\0');
+    if (wideSize > 0) {
+        MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), &wide[0], wideSize);
+    }
+    return wide;
+}
+
+// "Code.exe" and "code" name the same process
+static std::wstring_view StripExe(std::wstring_view name) {
+    if (name.size() > 4 && name.substr(name.size() - 4) == L".exe") {
+        name.remove_suffix(4);
+    }
+    return name;
+}
+
+AppClassifier& AppClassifier::Instance() {
+    static AppClassifier classifier;
+    return classifier;
+}
+
+AppClassifier::AppClassifier() {
+    if (std::ifstream(RULES_PATH).good()) {
+        if (LoadRulesFile(RULES_PATH)) {
+            return;
+        }
+        std::cerr << "[AppClassifier] Falling back to built-in rules" << std::endl;
+    }
+    LoadRules(DEFAULT_RULES);
+}
+
+const char* AppClassifier::CategoryName(AppCategory category) {
+    size_t index = static_cast<size_t>(category);
+    return index < sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]) ? CATEGORY_NAMES[index] : "unknown";
+}
+
+std::wstring AppClassifier::ToLower(std::wstring_view text) {
+    std::wstring lower(text);
+    for (auto& ch : lower) {
+        ch = static_cast<wchar_t>(std::towlower(ch));
+    }
+    return lower;
+}
+
+bool AppClassifier::LoadRulesFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "[AppClassifier] Cannot open rules: " << path << std::endl;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    if (!LoadRules(contents.str())) {
+        std::cerr << "[AppClassifier] Invalid rules file: " << path << std::endl;
+        return false;
+    }
+    std::cout << "[AppClassifier] Loaded " << RuleCount() << " rules from " << path << std::endl;
+    return true;
+}
+
+bool AppClassifier::LoadRules(std::string_view json) {
+    JsonValue rules = JsonReader::Parse(json)["rules"];
+    if (!rules.IsArray()) {
+        return false;
+    }
+
+    Matcher compiled;
+    std::vector<Pattern> patterns;
+    std::string scratch;
+    size_t cursor = 0;
+    JsonValue rule;
+    while (rules.Next(cursor, rule)) {
+        AppCategory category;
+        std::string_view categoryName = rule["category"].AsString(scratch);
+        if (!ParseCategory(categoryName, category)) {
+            std::cerr << "[AppClassifier] Skipping rule with unknown category \"" << categoryName << "\"" << std::endl;
+            continue;
+        }
+        uint32_t index = static_cast<uint32_t>(compiled.categories.size());
+        compiled.categories.push_back(category);
+
+        size_t itemCursor = 0;
+        JsonValue item;
+        JsonValue processes = rule["processes"];
+        while (processes.Next(itemCursor, item)) {
+            std::wstring name = ToLower(Utf8ToWide(item.AsString(scratch)));
+            if (!name.empty()) {
+                // emplace keeps an earlier rule for a name listed twice
+                compiled.processes.emplace(std::wstring(StripExe(name)), index);
+            }
+        }
+        itemCursor = 0;
+        JsonValue titles = rule["titles"];
+        while (titles.Next(itemCursor, item)) {
+            std::wstring text = ToLower(Utf8ToWide(item.AsString(scratch)));
+            if (!text.empty()) {
+                patterns.push_back(Pattern{ std::move(text), index });
+            }
+        }
+    }
+    if (compiled.categories.empty()) {
+        return false;
+    }
+
+    BuildAutomaton(compiled, patterns);
+    // Whole-table replacement: the lambda ignores the current value
+    matcher.Update([&](Matcher& current) {
+        current = compiled;
+        return true;
+    });
+    return true;
+}
+
+void AppClassifier::BuildAutomaton(Matcher& compiled, const std::vector<Pattern>& patterns) {
+    if (patterns.empty()) {
+        return;
+    }
+
+    // Dense classes keep the transition table at (states x pattern alphabet)
+    compiled.charClass.assign(0x10000, 0);
+    for (const auto& pattern : patterns) {
+        for (wchar_t ch : pattern.text) {
+            size_t unit = static_cast<size_t>(ch);
+            if (unit < compiled.charClass.size() && compiled.charClass[unit] == 0) {
+                compiled.charClass[unit] = static_cast<uint16_t>(++compiled.classCount);
+            }
+        }
+    }
+    const size_t width = compiled.classCount + 1;
+
+    // Trie
+    compiled.transitions.assign(width, -1);
+    compiled.bestRule.assign(1, NO_RULE);
+    for (const auto& pattern : patterns) {
+        size_t state = 0;
+        for (wchar_t ch : pattern.text) {
+            size_t unit = static_cast<size_t>(ch);
+            size_t cls = unit < compiled.charClass.size() ? compiled.charClass[unit] : 0;
+            int32_t& next = compiled.transitions[state * width + cls];
+            if (next < 0) {
+                next = static_cast<int32_t>(compiled.bestRule.size());
+                compiled.bestRule.push_back(NO_RULE);
+                compiled.transitions.resize(compiled.transitions.size() + width, -1);
+            }
+            state = static_cast<size_t>(compiled.transitions[state * width + cls]);
+        }
+        compiled.bestRule[state] = (std::min)(compiled.bestRule[state], pattern.rule);
+    }
+
+    // Failure links, breadth first, folded into the transition table so that
+    // matching never follows a link; bestRule inherits from the longest proper suffix
+    std::vector<int32_t> failure(compiled.bestRule.size(), 0);
+    std::vector<int32_t> queue;
+    queue.reserve(compiled.bestRule.size());
+    for (size_t cls = 0; cls < width; ++cls) {
+        int32_t& next = compiled.transitions[cls];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int32_t state = queue[head];
+        int32_t fallback = failure[state];
+        compiled.bestRule[state] = (std::min)(compiled.bestRule[state], compiled.bestRule[fallback]);
+        for (size_t cls = 0; cls < width; ++cls) {
+            int32_t& next = compiled.transitions[state * width + cls];
+            int32_t viaFailure = compiled.transitions[fallback * width + cls];
+            if (next < 0) {
+                next = viaFailure;
+            } else {
+                failure[next] = viaFailure;
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+uint32_t AppClassifier::MatchProcess(const Matcher& compiled, std::wstring_view processName) const {
+    if (processName.empty() || compiled.processes.empty()) {
+        return NO_RULE;
+    }
+    auto it = compiled.processes.find(std::wstring(StripExe(ToLower(processName))));
+    return it != compiled.processes.end() ? it->second : NO_RULE;
+}
+
+uint32_t AppClassifier::MatchTitle(const Matcher& compiled, std::wstring_view title) const {
+    if (compiled.charClass.empty()) {
+        return NO_RULE;
+    }
+    const size_t width = compiled.classCount + 1;
+    const size_t classes = compiled.charClass.size();
+    uint32_t best = NO_RULE;
+    size_t state = 0;
+    for (wchar_t ch : title) {
+        size_t unit = static_cast<size_t>(std::towlower(ch));
+        size_t cls = unit < classes ? compiled.charClass[unit] : 0;
+        state = static_cast<size_t>(compiled.transitions[state * width + cls]);
+        best = (std::min)(best, compiled.bestRule[state]);
+    }
+    return best;
+}
+
+AppCategory AppClassifier::Classify(std::wstring_view processName, std::wstring_view title) const {
+    std::shared_ptr<const Matcher> compiled = matcher.Load();
+    uint32_t rule = (std::min)(MatchProcess(*compiled, processName), MatchTitle(*compiled, title));
+    return rule != NO_RULE ? compiled->categories[rule] : AppCategory::Unknown;
+}
+
+AppCategory AppClassifier::ClassifyProcess(std::wstring_view processName) const {
+    std::shared_ptr<const Matcher> compiled = matcher.Load();
+    uint32_t rule = MatchProcess(*compiled, processName);
+    return rule != NO_RULE ? compiled->categories[rule] : AppCategory::Unknown;
+}
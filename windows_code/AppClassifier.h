@@ -0,0 +1,102 @@
+#pragma once
+
+#include "PublishedState.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class AppCategory : uint8_t {
+    Unknown,
+    Browser,
+    IDE,
+    Terminal,
+    Meeting,
+    Chat,
+    Media,
+    Office
+};
+
+/**
+ * AppClassifier - Maps process names and window titles to app categories
+ *
+ * Rules come from a JSON table (RULES_PATH, else the built-in defaults) and
+ * are compiled once, so classifying a window costs the same for ten rules
+ * or a thousand:
+ *   - Process rules are exact, case-insensitive names ("code.exe") in one
+ *     hash table: one lookup per window.
+ *   - Title rules are case-insensitive substrings ("zoom meeting") compiled
+ *     into a single Aho-Corasick automaton with a dense transition table:
+ *     one table step per title character, whatever the number of patterns.
+ *
+ * Rules are ordered; when several match, the earliest in the table wins, so
+ * a "Google Meet" title rule listed before the browser process rules turns
+ * a browser tab into a meeting.
+ *
+ * Rule file:
+ *   { "rules": [
+ *       { "category": "meeting", "titles": ["zoom meeting", "meet - "] },
+ *       { "category": "browser", "processes": ["chrome.exe", "firefox.exe"] } ] }
+ *
+ * Usage:
+ *   AppCategory category = AppClassifier::Instance().Classify(info.processName, info.windowTitle);
+ *   const char* name = AppClassifier::CategoryName(category);   // "meeting"
+ *
+ * Thread-safe: the compiled tables are published with PublishedState, so
+ * classification takes no lock and LoadRules can swap tables at any time.
+ */
+class AppClassifier {
+public:
+    static constexpr const char* RULES_PATH = "config/app_categories.json";
+
+    // Loads RULES_PATH on first use, falling back to the built-in table
+    static AppClassifier& Instance();
+
+    /**
+     * @brief Replace the rule table with one parsed from JSON text
+     * @return false (current rules kept) if the text isn't a valid rule table
+     */
+    bool LoadRules(std::string_view json);
+    bool LoadRulesFile(const std::string& path);
+
+    // Earliest rule matching the process or the title; Unknown if none
+    AppCategory Classify(std::wstring_view processName, std::wstring_view title) const;
+
+    // Process rules only (ignores what the window is showing)
+    AppCategory ClassifyProcess(std::wstring_view processName) const;
+
+    size_t RuleCount() const { return matcher.Load()->categories.size(); }
+
+    // Lower-case name as used in rule files and context documents; "unknown" for Unknown
+    static const char* CategoryName(AppCategory category);
+
+private:
+    static constexpr uint32_t NO_RULE = UINT32_MAX;
+
+    struct Matcher {
+        std::vector<AppCategory> categories;                    // Per rule
+        std::unordered_map<std::wstring, uint32_t> processes;   // Lower-case name -> earliest rule
+
+        // Aho-Corasick over title patterns. Characters used by some pattern
+        // get a class 1..classCount; every other character is class 0
+        std::vector<uint16_t> charClass;            // Indexed by UTF-16 unit; empty without title rules
+        size_t classCount = 0;
+        std::vector<int32_t> transitions;           // state * (classCount + 1) + class -> state
+        std::vector<uint32_t> bestRule;             // Earliest rule matching at a state (suffixes included)
+    };
+
+    struct Pattern {
+        std::wstring text;                          // Lower-case
+        uint32_t rule;
+    };
+
+    AppClassifier();
+
+    uint32_t MatchProcess(const Matcher& compiled, std::wstring_view processName) const;
+    uint32_t MatchTitle(const Matcher& compiled, std::wstring_view title) const;
+    static void BuildAutomaton(Matcher& compiled, const std::vector<Pattern>& patterns);
+    static std::wstring ToLower(std::wstring_view text);
+
+    PublishedState<Matcher> matcher;
+};
@@ -1,72 +1,395 @@
 #include "AsyncWhisperQueue.h"
-#include <iostream>
+#include "CpuBudget.h"
+#include "InferenceScheduler.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "PipelineLatency.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include "UtteranceTracer.h"
+#include "Watchdog.h"
+#include "WhisperTranscriber.h"
+#include <algorithm>
+#include <string_view>
+#include <windows.h>
 #include "whisper.h"
 
-AsyncWhisperQueue::AsyncWhisperQueue(whisper_context* ctx)
-    : whisperContext(ctx)
+AsyncWhisperQueue::AsyncWhisperQueue(whisper_context* ctx, int numWorkers, int threadsPerWorker,
+                                     size_t maxQueued, OverflowPolicy policy)
+    : AsyncWhisperQueue(std::vector<whisper_context*>{ctx}, numWorkers, threadsPerWorker, maxQueued, policy)
+{
+}
+
+AsyncWhisperQueue::AsyncWhisperQueue(const std::vector<whisper_context*>& models, int numWorkers,
+                                     int threadsPerWorker, size_t maxQueued, OverflowPolicy policy,
+                                     const char* watchdogGroup)
+    : AsyncWhisperQueue(models, nullptr, numWorkers, threadsPerWorker, maxQueued, policy, watchdogGroup)
+{
+}
+
+AsyncWhisperQueue::AsyncWhisperQueue(const WhisperProcess::Options& remote, int numWorkers, int threadsPerWorker,
+                                     size_t maxQueued, OverflowPolicy policy, const char* watchdogGroup)
+    : AsyncWhisperQueue({}, &remote, numWorkers, threadsPerWorker, maxQueued, policy, watchdogGroup)
+{
+}
+
+AsyncWhisperQueue::AsyncWhisperQueue(const std::vector<whisper_context*>& models,
+                                     const WhisperProcess::Options* remote, int numWorkers,
+                                     int threadsPerWorker, size_t maxQueued, OverflowPolicy policy,
+                                     const char* watchdogGroup)
+    : models(models)
+    , modelCount(remote ? remote->modelPaths.size() : models.size())
+    , threadsPerWorker((std::max)(1, threadsPerWorker))
+    , transcriber(this->threadsPerWorker)
+    , stateBytes(0)
+    , bytesPerState(0)
+    , backgroundActive(0)
+    , idleWarmProcesses(0)
+    , primaryWaiting(0)
+    , marginalVadConfidence(0.0f)
+    , maxQueued((std::max)(maxQueued, static_cast<size_t>(1)))
+    , overflowPolicy(policy)
+    , partialPending(false)
+    , partialGeneration(0)
+    , utteranceGeneration(0)
+    , activityCount(0)
+    , partialInFlight(false)
+    , modelMsPerAudioSecond(modelCount, 0.0f)
+    , modelUtterances(modelCount, 0)
     , running(true)
-    , processing(false)
+    , activeJobs(0)
+    , inFlightCount(0)
+    , warmWorkers(0)
     , processedCount(0)
     , lastLatencyMs(0.0f)
+    , droppedCount(0)
+    , mergedCount(0)
+    , rejectedSegments(0)
+    , marginalSkipped(0)
+    , lastQueueAgeMs(0.0f)
+    , maxQueueAgeMs(0.0f)
+    , watchdogGroup(watchdogGroup)
 {
-    if (!whisperContext) {
+    if (remote ? remote->modelPaths.empty()
+               : models.empty() || std::find(models.begin(), models.end(), nullptr) != models.end()) {
         throw std::runtime_error("AsyncWhisperQueue: whisper context is null!");
     }
 
-    // Start worker thread
-    workerThread = std::thread(&AsyncWhisperQueue::WorkerThread, this);
+    // Out of process: a child per worker, started by the worker when it needs one
+    numWorkers = (std::max)(1, numWorkers);
+    for (int i = 0; remote && i < numWorkers; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->process = std::make_unique<WhisperProcess>(*remote);
+        worker->index = workers.size();
+        workers.push_back(std::move(worker));
+    }
+
+    // One whisper_state per worker and model; all share the weights in the contexts
+    MemoryAccounting::Meter stateMeter;
+    for (int i = 0; !remote && i < numWorkers; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->index = workers.size();
+        for (whisper_context* model : models) {
+            whisper_state* state = whisper_init_state(model);
+            if (!state) {
+                break;
+            }
+            worker->states.push_back(state);
+        }
+
+        if (worker->states.size() != models.size()) {
+            LOG_ERROR("AsyncQueue", "whisper_init_state failed for worker " << i);
+            for (whisper_state* state : worker->states) {
+                whisper_free_state(state);
+            }
+            break;
+        }
+        workers.push_back(std::move(worker));
+    }
+
+    if (workers.empty()) {
+        throw std::runtime_error("AsyncWhisperQueue: failed to create any whisper state!");
+    }
+    if (!remote) {
+        stateBytes = stateMeter.Bytes();
+        bytesPerState = stateBytes.load() / (workers.size() * models.size());
+    }
+
+    // Start worker threads
+    for (auto& worker : workers) {
+        worker->thread = std::thread(&AsyncWhisperQueue::WorkerThread, this, worker.get());
+    }
 
-    std::cout << "[AsyncQueue] Worker thread started" << std::endl;
+    LOG_INFO("AsyncQueue", workers.size() << " worker thread(s) started ("
+             << this->threadsPerWorker << " threads each, " << modelCount << " model tier"
+             << (modelCount == 1 ? "" : "s") << (remote ? ", out of process" : "") << ")");
 }
 
 AsyncWhisperQueue::~AsyncWhisperQueue() {
-    // Signal worker to stop
+    Cancel();
+
+    // Wait for workers to leave their (aborted) transcription, then release their states
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        for (whisper_state* state : worker->states) {
+            whisper_free_state(state);
+        }
+        worker->states.clear();
+    }
+
+    // Jobs never published: captions stop waiting on them
+    InferenceScheduler::Instance().InteractiveDone(inFlightCount.exchange(0));
+
+    LOG_INFO("AsyncQueue", "Worker threads stopped. Processed "
+             << processedCount.load() << " utterances");
+}
+
+void AsyncWhisperQueue::Cancel() {
+    // Workers and blocked producers see it at their next check; a decode in
+    // progress sees it in OnAbortCheck
     running.store(false);
     cv.notify_all();
+    spaceCv.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(warmMutex);
+    }
+    warmCv.notify_all();
+}
+
+bool AsyncWhisperQueue::WaitUntilWarm() {
+    std::unique_lock<std::mutex> lock(warmMutex);
+    warmCv.wait(lock, [this] { return IsWarm() || !running.load(); });
+    return IsWarm();
+}
+
+void AsyncWhisperQueue::QueueAudio(const std::vector<float>& audio, size_t model, uint64_t traceId, Lane lane,
+                                   bool continuation, float vadConfidence) {
+    std::vector<float> copy = AcquireBuffer();
+    copy.assign(audio.begin(), audio.end());
+    QueueAudio(std::move(copy), model, traceId, lane, continuation, vadConfidence);
+}
+
+void AsyncWhisperQueue::QueueAudio(std::vector<float>&& audio, size_t model, uint64_t traceId, Lane lane,
+                                   bool continuation, float vadConfidence, LogMelSpectrogram::Frames* mel) {
+    model = (std::min)(model, modelCount - 1);
+    std::vector<std::pair<uint64_t, uint64_t>> droppedSequences;   // Sequence, trace
+    std::vector<float> spare;
+    const size_t queuedSamples = audio.size();
+
+    {
+        std::unique_lock<std::mutex> lock(audioQueueMutex);
+        std::deque<Job>& audioQueue = laneQueues[LaneIndex(lane)].jobs;
+
+        activityCount++;
+        // Any pending partial belongs to the microphone utterance that just finished
+        if (lane == Lane::Primary) {
+            utteranceGeneration++;
+            partialPending = false;
+        }
+
+        bool merged = false;
+
+        if (audioQueue.size() >= maxQueued) {
+            if (overflowPolicy == OverflowPolicy::BlockProducer) {
+                spaceCv.wait(lock, [this, &audioQueue] {
+                    return audioQueue.size() < maxQueued || !running.load();
+                });
+                if (!running.load()) {
+                    return;
+                }
+            }
+            else if (overflowPolicy == OverflowPolicy::MergeAdjacent &&
+                     audioQueue.back().audio.size() + audio.size() <= MAX_MERGED_SAMPLES) {
+                // One whisper call covers both; the merged job keeps its original age and model
+                std::vector<float>& newest = audioQueue.back().audio;
+                newest.insert(newest.end(), audio.begin(), audio.end());
+                audioQueue.back().vadConfidence = (std::max)(audioQueue.back().vadConfidence, vadConfidence);
+                audioQueue.back().mel.Clear();      // Frames of the first part only
+                mergedCount++;
+                merged = true;
+                UtteranceTracer::Instance().SetOutcome(traceId, UtteranceTracer::Outcome::Merged);
+                spare = std::move(audio);
+            }
+            else {
+                // DropOldest, or a merge that would overflow the whisper window
+                droppedSequences.emplace_back(audioQueue.front().sequence, audioQueue.front().traceId);
+                spare = std::move(audioQueue.front().audio);
+                audioQueue.pop_front();
+                droppedCount++;
+            }
+        }
 
-    // Wait for worker to finish current transcription
-    if (workerThread.joinable()) {
-        workerThread.join();
+        if (!merged) {
+            audioQueue.push_back(Job{ std::move(audio), laneQueues[LaneIndex(lane)].nextSequence++,
+                                      std::chrono::steady_clock::now(), model, traceId, lane, continuation,
+                                      vadConfidence });
+            if (mel) {
+                std::swap(audioQueue.back().mel, *mel);
+            }
+            inFlightCount++;
+            InferenceScheduler::Instance().InteractiveQueued();
+        }
+        if (lane == Lane::Primary) {
+            primaryWaiting.store(audioQueue.size());
+        }
+    }
+    UtteranceTracer::Instance().Mark(traceId, UtteranceTracer::Point::Enqueued);
+
+    if (spare.capacity() > 0) {
+        RecycleBuffer(std::move(spare));
+    }
+
+    // Dropped utterances still release their slot in the result ordering
+    for (const auto& dropped : droppedSequences) {
+        UtteranceTracer::Instance().SetOutcome(dropped.second, UtteranceTracer::Outcome::Dropped);
+        PublishResult(lane, dropped.first, "", 0);
     }
 
-    std::cout << "[AsyncQueue] Worker thread stopped. Processed "
-              << processedCount.load() << " utterances" << std::endl;
+    // Wake up a worker thread
+    WakeWorker();
+    TRACE_COUNTER("Whisper queue depth", GetQueueSize());
+
+    LOG_DEBUG("AsyncQueue", "Queued " << (lane == Lane::Primary ? "" : "background ") << "audio ("
+              << queuedSamples / 16000 << "s), queue size: " << GetQueueSize(lane));
 }
 
-void AsyncWhisperQueue::QueueAudio(const std::vector<float>& audio) {
+std::vector<float> AsyncWhisperQueue::AcquireBuffer() {
     {
-        std::lock_guard<std::mutex> lock(audioQueueMutex);
-        audioQueue.push(audio);
+        std::lock_guard<std::mutex> lock(freeBuffersMutex);
+        if (!freeBuffers.empty()) {
+            std::vector<float> buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+            buffer.clear();
+            return buffer;
+        }
     }
 
-    // Wake up worker thread
-    cv.notify_one();
+    std::vector<float> buffer;
+    buffer.reserve(MAX_MERGED_SAMPLES);
+    return buffer;
+}
 
-    std::cout << "[AsyncQueue] Queued audio (" << audio.size() / 16000
-              << "s), queue size: " << GetQueueSize() << std::endl;
+void AsyncWhisperQueue::RecycleBuffer(std::vector<float>&& buffer) {
+    std::lock_guard<std::mutex> lock(freeBuffersMutex);
+    if (freeBuffers.size() < MAX_FREE_BUFFERS) {
+        buffer.clear();
+        freeBuffers.push_back(std::move(buffer));
+    }
 }
 
-std::string AsyncWhisperQueue::GetLatestResult() {
+std::string AsyncWhisperQueue::GetLatestResult(uint64_t* traceId, Lane lane) {
     std::lock_guard<std::mutex> lock(resultsQueueMutex);
+    std::queue<Result>& resultsQueue = laneResults[LaneIndex(lane)].published;
 
     if (resultsQueue.empty()) {
         return "";
     }
 
     // Get latest result
-    std::string result = resultsQueue.front();
+    Result result = std::move(resultsQueue.front());
     resultsQueue.pop();
+    if (traceId) {
+        *traceId = result.traceId;
+    }
+
+    return result.text;
+}
+
+void AsyncWhisperQueue::UpdatePartialAudio(const float* audio, size_t count, LogMelSpectrogram::Frames* mel) {
+    if (!audio || count == 0) {
+        return;
+    }
+
+    // Only the trailing window is transcribed; assign() reuses the buffer's capacity
+    const size_t windowSamples = static_cast<size_t>(STREAMING_WINDOW_SEC) * 16000;
+    size_t offset = (count > windowSamples) ? count - windowSamples : 0;
+
+    {
+        std::lock_guard<std::mutex> lock(audioQueueMutex);
+        partialAudio.assign(audio + offset, audio + count);
+        // Frames start at the utterance's first sample: of no use for a later window
+        if (mel && offset == 0 && mel->samples == count) {
+            std::swap(partialMel, *mel);
+        } else {
+            partialMel.Clear();
+        }
+        partialGeneration = utteranceGeneration.load();
+        partialPending = true;
+        activityCount++;
+    }
 
-    return result;
+    WakeWorker();
+}
+
+std::string AsyncWhisperQueue::GetPartialResult() const {
+    std::lock_guard<std::mutex> lock(resultsQueueMutex);
+    return partialResult;
+}
+
+void AsyncWhisperQueue::SetResultReadyCallback(ResultReadyCallback callback) {
+    std::lock_guard<std::mutex> lock(resultReadyMutex);
+    resultReadyCallback = std::move(callback);
+}
+
+void AsyncWhisperQueue::SetFinishedAudioSink(FinishedAudioSink sink) {
+    std::lock_guard<std::mutex> lock(finishedAudioMutex);
+    finishedAudioSink = std::move(sink);
+}
+
+void AsyncWhisperQueue::SetDecodedSegmentCallback(DecodedSegmentCallback callback) {
+    std::lock_guard<std::mutex> lock(decodedSegmentMutex);
+    decodedSegmentCallback = std::move(callback);
+}
+
+void AsyncWhisperQueue::WakeWorker() {
+    if (workers.front()->process) {
+        cv.notify_all();
+    } else {
+        cv.notify_one();
+    }
+}
+
+void AsyncWhisperQueue::NotifyResultReady() {
+    std::lock_guard<std::mutex> lock(resultReadyMutex);
+    if (resultReadyCallback) {
+        resultReadyCallback();
+    }
 }
 
 bool AsyncWhisperQueue::IsProcessing() const {
-    return processing.load();
+    return activeJobs.load() > 0;
 }
 
-size_t AsyncWhisperQueue::GetQueueSize() const {
+size_t AsyncWhisperQueue::GetQueueSize(Lane lane) const {
     std::lock_guard<std::mutex> lock(audioQueueMutex);
-    return audioQueue.size();
+    return laneQueues[LaneIndex(lane)].jobs.size();
+}
+
+bool AsyncWhisperQueue::CanTakeBackground() const {
+    return backgroundActive < (std::max)(static_cast<size_t>(1), workers.size() - 1);
+}
+
+AsyncWhisperQueue::MemoryUsage AsyncWhisperQueue::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.stateBytes = stateBytes;
+    {
+        std::lock_guard<std::mutex> lock(audioQueueMutex);
+        for (const LaneQueue& laneQueue : laneQueues) {
+            for (const Job& job : laneQueue.jobs) {
+                usage.queuedBytes += (job.audio.capacity() + job.mel.data.capacity()) * sizeof(float);
+            }
+        }
+        usage.partialBytes = (partialAudio.capacity() + partialMel.data.capacity()) * sizeof(float);
+    }
+    {
+        std::lock_guard<std::mutex> lock(freeBuffersMutex);
+        for (const auto& buffer : freeBuffers) {
+            usage.freeBufferBytes += buffer.capacity() * sizeof(float);
+        }
+    }
+    return usage;
 }
 
 size_t AsyncWhisperQueue::GetProcessedCount() const {
@@ -77,104 +400,460 @@ float AsyncWhisperQueue::GetLastLatencyMs() const {
     return lastLatencyMs.load();
 }
 
-void AsyncWhisperQueue::WorkerThread() {
-    std::cout << "[AsyncQueue] Worker thread running" << std::endl;
+float AsyncWhisperQueue::GetModelMsPerAudioSecond(size_t model) const {
+    std::lock_guard<std::mutex> lock(modelStatsMutex);
+    return model < modelMsPerAudioSecond.size() ? modelMsPerAudioSecond[model] : 0.0f;
+}
+
+size_t AsyncWhisperQueue::GetModelUtteranceCount(size_t model) const {
+    std::lock_guard<std::mutex> lock(modelStatsMutex);
+    return model < modelUtterances.size() ? modelUtterances[model] : 0;
+}
+
+void AsyncWhisperQueue::RecordModelLatency(size_t model, float latencyMs, size_t samples) {
+    // Whisper pads to 30s windows, so short clips cost more per second; floor at 1s
+    float seconds = (std::max)(1.0f, static_cast<float>(samples) / 16000.0f);
+    float msPerSecond = latencyMs / seconds;
+
+    std::lock_guard<std::mutex> lock(modelStatsMutex);
+    float& average = modelMsPerAudioSecond[model];
+    average = (modelUtterances[model] == 0) ? msPerSecond
+            : average + MODEL_LATENCY_SMOOTHING * (msPerSecond - average);
+    modelUtterances[model]++;
+}
+
+void AsyncWhisperQueue::WorkerThread(Worker* worker) {
+    LOG_DEBUG("AsyncQueue", "Worker thread running");
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Whisper);
+    TRACE_THREAD("Whisper worker");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Whisper);
+    Watchdog::Heartbeat heartbeat("whisper_worker", watchdogGroup, WORKER_STALL_MS);
+
+    heartbeat.Beat("warm-up");
+    WarmUpWorker(worker);
+
+    std::vector<float> partialToProcess;
+    LogMelSpectrogram::Frames partialMelToProcess;
 
     while (running.load()) {
-        std::vector<float> audioToProcess;
+        Job job;
+        bool isPartial = false;
+        uint64_t generation = 0;
 
         // Wait for audio in queue
         {
             std::unique_lock<std::mutex> lock(audioQueueMutex);
-
-            // Wait until we have audio or should stop
-            cv.wait(lock, [this] {
-                return !audioQueue.empty() || !running.load();
-            });
+            heartbeat.Idle();
+
+            std::deque<Job>& primary = laneQueues[LaneIndex(Lane::Primary)].jobs;
+            std::deque<Job>& background = laneQueues[LaneIndex(Lane::Background)].jobs;
+
+            // Wait until we have audio, a trim or should stop
+            auto hasWork = [&] {
+                return !primary.empty() || (partialPending && !partialInFlight) ||
+                       (!background.empty() && CanTakeBackground());
+            };
+            if (!worker->process) {
+                cv.wait(lock, [&] { return hasWork() || worker->trimRequested || !running.load(); });
+            } else {
+                // Out of process: without a live child, only take what no idle worker
+                // with one can (scale up); a child idle for PROCESS_IDLE_MS ends
+                // unless it is worker 0's (scale down)
+                bool warm = worker->process->IsRunning();
+                auto wake = [&] {
+                    return (hasWork() && (warm || idleWarmProcesses == 0)) || worker->trimRequested ||
+                           !running.load();
+                };
+                idleWarmProcesses += warm ? 1 : 0;
+                auto idleSince = std::chrono::steady_clock::now();
+                while (!cv.wait_for(lock, std::chrono::milliseconds(PROCESS_IDLE_CHECK_MS), wake)) {
+                    if (warm && worker->index > 0 &&
+                        std::chrono::steady_clock::now() - idleSince >= std::chrono::milliseconds(PROCESS_IDLE_MS)) {
+                        worker->trimRequested = true;
+                        break;
+                    }
+                }
+                idleWarmProcesses -= warm ? 1 : 0;
+            }
 
             if (!running.load()) {
                 break;  // Exit thread
             }
+            if (worker->trimRequested) {
+                worker->trimRequested = false;
+                if (!hasWork()) {
+                    lock.unlock();
+                    ReleaseStates(worker);
+                    std::vector<float>().swap(partialToProcess);
+                    partialMelToProcess = LogMelSpectrogram::Frames();
+                    continue;
+                }
+            }
+
+            if (!primary.empty()) {
+                // Finalized microphone utterances first
+                job = std::move(primary.front());
+                primary.pop_front();
+                primaryWaiting.store(primary.size());
+                spaceCv.notify_all();
+            } else if (partialPending && !partialInFlight) {
+                // Swap keeps both buffers' capacity alive across passes
+                partialToProcess.swap(partialAudio);
+                std::swap(partialMelToProcess, partialMel);
+                generation = partialGeneration;
+                partialPending = false;
+                partialInFlight = true;
+                isPartial = true;
+            } else {
+                job = std::move(background.front());
+                background.pop_front();
+                backgroundActive++;
+                spaceCv.notify_all();
+            }
+        }
+        heartbeat.Beat(isPartial ? "partial transcription"
+                       : job.lane == Lane::Primary ? "transcription" : "background transcription");
+
+        if (isPartial) {
+            std::string hypothesis = TranscribeAudio(worker, modelCount - 1, partialToProcess,
+                                                     partialMelToProcess, true, Lane::Primary, true);
+
+            // Drop the hypothesis if its utterance was finalized meanwhile
+            bool changed = false;
+            if (!hypothesis.empty() && generation == utteranceGeneration.load()) {
+                std::lock_guard<std::mutex> lock(resultsQueueMutex);
+                changed = (hypothesis != partialResult);
+                partialResult = hypothesis;
+            }
+            if (changed) {
+                NotifyResultReady();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(audioQueueMutex);
+                partialInFlight = false;
+            }
+            WakeWorker();
+            continue;
+        }
 
-            // Get audio from queue
-            audioToProcess = audioQueue.front();
-            audioQueue.pop();
+        // Track how long the utterance waited for a worker
+        float queueAgeMs = std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - job.enqueueTime).count();
+        lastQueueAgeMs.store(queueAgeMs);
+        PipelineLatency::Record(PipelineLatency::Stage::QueueWait, queueAgeMs);
+        if (queueAgeMs > maxQueueAgeMs.load()) {
+            maxQueueAgeMs.store(queueAgeMs);
         }
 
         // Transcribe (this takes 6+ seconds, but doesn't block main thread!)
-        processing.store(true);
+        activeJobs++;
 
+        UtteranceTracer::Instance().Mark(job.traceId, UtteranceTracer::Point::WhisperStart);
         auto startTime = std::chrono::high_resolution_clock::now();
-        std::string transcription = TranscribeAudio(audioToProcess);
+        float marginalConfidence = marginalVadConfidence.load();
+        bool marginal = marginalConfidence > 0.0f && job.vadConfidence < marginalConfidence;
+        std::string transcription = TranscribeAudio(worker, job.model, job.audio, job.mel, false, job.lane,
+                                                    job.continuation, marginal, job.traceId);
         auto endTime = std::chrono::high_resolution_clock::now();
+        UtteranceTracer::Instance().Mark(job.traceId, UtteranceTracer::Point::WhisperEnd);
 
         float latencyMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
         lastLatencyMs.store(latencyMs);
+        PipelineLatency::Record(PipelineLatency::Stage::Whisper, latencyMs);
+        RecordModelLatency(job.model, latencyMs, job.audio.size());
+        InferenceScheduler::Instance().LearnInteractive(latencyMs);
 
-        processing.store(false);
+        activeJobs--;
 
-        // Add result to results queue
         if (!transcription.empty()) {
-            std::lock_guard<std::mutex> lock(resultsQueueMutex);
-            resultsQueue.push(transcription);
-            processedCount++;
+            LOG_INFO("AsyncQueue", (job.lane == Lane::Primary ? "Transcribed: \"" : "Transcribed (background): \"")
+                     << transcription
+                     << "\" (" << (int)latencyMs << "ms"
+                     << (modelCount > 1 ? ", model " + std::to_string(job.model) : "") << ")");
+        }
+
+        if (transcription.empty()) {
+            UtteranceTracer::Instance().SetOutcome(job.traceId, UtteranceTracer::Outcome::Empty);
+        }
+        heartbeat.Beat("publish result");
+        PublishResult(job.lane, job.sequence, transcription, job.traceId);
+        {
+            std::lock_guard<std::mutex> lock(finishedAudioMutex);
+            if (finishedAudioSink) {
+                finishedAudioSink(job.lane, job.audio, transcription);
+            }
+        }
+        RecycleBuffer(std::move(job.audio));
 
-            std::cout << "[AsyncQueue] Transcribed: \"" << transcription
-                      << "\" (" << (int)latencyMs << "ms)" << std::endl;
+        // Frees a background slot: another worker may be waiting on it
+        if (job.lane == Lane::Background) {
+            {
+                std::lock_guard<std::mutex> lock(audioQueueMutex);
+                backgroundActive--;
+            }
+            WakeWorker();
         }
     }
 
-    std::cout << "[AsyncQueue] Worker thread exiting" << std::endl;
+    LOG_DEBUG("AsyncQueue", "Worker thread exiting");
 }
 
-std::string AsyncWhisperQueue::TranscribeAudio(const std::vector<float>& audioData) {
-    if (!whisperContext || audioData.empty()) {
-        return "";
+void AsyncWhisperQueue::PublishResult(Lane lane, uint64_t sequence, const std::string& transcription,
+                                      uint64_t traceId) {
+    size_t published = 0;
+    {
+        std::lock_guard<std::mutex> lock(resultsQueueMutex);
+        LaneResults& results = laneResults[LaneIndex(lane)];
+
+        // Park the result until every earlier utterance of its lane has been published
+        results.pending[sequence] = Result{ transcription, traceId };
+
+        auto it = results.pending.find(results.nextSequenceToPublish);
+        while (it != results.pending.end()) {
+            if (!it->second.text.empty()) {
+                results.published.push(std::move(it->second));
+                processedCount++;
+
+                // Nobody is reading; keep only the most recent results
+                while (results.published.size() > MAX_RESULTS) {
+                    results.published.pop();
+                }
+            }
+            if (lane == Lane::Primary) {
+                partialResult.clear();
+            }
+            published++;
+
+            results.pending.erase(it);
+            results.nextSequenceToPublish++;
+            it = results.pending.find(results.nextSequenceToPublish);
+        }
+    }
+
+    // Outside resultsQueueMutex: the callback reads the results back
+    if (published > 0) {
+        NotifyResultReady();
+        inFlightCount -= published;
+        InferenceScheduler::Instance().InteractiveDone(published);
     }
+}
 
-    // Set up whisper parameters (same as before)
-    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-    params.language = "en";
-    params.n_threads = 4;  // Use 4 CPU threads
-    params.print_progress = false;
-    params.print_special = false;
-    params.print_realtime = false;
-    params.translate = false;
-    params.no_context = true;
-    params.single_segment = false;
-
-    // Run inference
-    int result = whisper_full(
-        whisperContext,
-        params,
-        audioData.data(),
-        static_cast<int>(audioData.size())
-    );
-
-    if (result != 0) {
-        std::cerr << "[AsyncQueue ERROR] whisper_full failed with code: " << result << std::endl;
+uint64_t AsyncWhisperQueue::TrimIdle(size_t keepWorkers) {
+    uint64_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(audioQueueMutex);
+        for (size_t i = (std::max)(keepWorkers, static_cast<size_t>(1)); i < workers.size(); ++i) {
+            workers[i]->trimRequested = true;
+        }
+        if (!partialPending && !partialInFlight) {
+            released += (partialAudio.capacity() + partialMel.data.capacity()) * sizeof(float);
+            std::vector<float>().swap(partialAudio);
+            partialMel = LogMelSpectrogram::Frames();
+        }
+    }
+    cv.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(freeBuffersMutex);
+        for (const auto& buffer : freeBuffers) {
+            released += buffer.capacity() * sizeof(float);
+        }
+        std::vector<std::vector<float>>().swap(freeBuffers);
+    }
+    return released;
+}
+
+void AsyncWhisperQueue::ReleaseStates(Worker* worker) {
+    if (worker->process) {
+        if (worker->process->IsRunning()) {
+            worker->process->Stop();
+            LOG_DEBUG("AsyncQueue", "Worker " << worker->index << " ended its idle whisper process");
+        }
+        return;
+    }
+    size_t freed = 0;
+    for (whisper_state*& state : worker->states) {
+        if (state) {
+            whisper_free_state(state);
+            state = nullptr;
+            freed++;
+        }
+    }
+    if (freed > 0) {
+        stateBytes -= (std::min)(stateBytes.load(), bytesPerState * freed);
+        LOG_DEBUG("AsyncQueue", "Worker released " << freed << " idle whisper state(s)");
+    }
+}
+
+void AsyncWhisperQueue::WarmUpWorker(Worker* worker) {
+    // Idle priority: the warm-up must not slow the other subsystems' startup
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+    auto start = std::chrono::steady_clock::now();
+
+    const std::vector<float> silence(16000 * WARMUP_SEC, 0.0f);
+    bool yielded = false;
+    if (worker->process && worker->index == 0 && running.load()) {
+        // The child warms its own states; the others start theirs on demand
+        TranscribeControl control{ this, true };
+        WhisperTranscriber::Request request;
+        request.abortCheck = &AsyncWhisperQueue::OnAbortCheck;
+        request.hookData = &control;
+        worker->process->Start(&request);
+        yielded = control.yielded;
+    }
+    for (size_t model = 0; model < models.size() && running.load() && !yielded; ++model) {
+        // Marginal: a Primary utterance in the queue aborts the warm-up
+        TranscribeControl control{ this, true };
+        WhisperTranscriber::Request request;
+        request.samples = silence.data();
+        request.count = silence.size();
+        request.encoderBegin = &AsyncWhisperQueue::OnEncoderBegin;
+        request.abortCheck = &AsyncWhisperQueue::OnAbortCheck;
+        request.hookData = &control;
+        transcriber.Transcribe(models[model], worker->states[model], request);
+        yielded = control.yielded;
+    }
+
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Whisper);
+    if (running.load()) {
+        float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG_DEBUG("AsyncQueue", "Worker warm-up " << (yielded ? "gave way to speech" : "done") << " after "
+                  << elapsedMs << "ms");
+    }
+    {
+        std::lock_guard<std::mutex> lock(warmMutex);
+        warmWorkers++;
+    }
+    warmCv.notify_all();
+}
+
+std::string AsyncWhisperQueue::TranscribeAudio(Worker* worker, size_t model, const std::vector<float>& audioData,
+                                              const LogMelSpectrogram::Frames& mel, bool isPartial, Lane lane,
+                                              bool prompted, bool marginal, uint64_t traceId) {
+    TRACE_ZONE("AsyncWhisperQueue::TranscribeAudio");
+    whisper_context* whisperContext = nullptr;
+    whisper_state* state = nullptr;
+    if (!worker->process) {
+        whisperContext = models[model];
+        whisper_state*& slot = worker->states[model];
+        if (!slot && whisperContext) {
+            // Trimmed while idle (TrimIdle): this decode runs cold
+            slot = whisper_init_state(whisperContext);
+            if (slot) {
+                stateBytes += bytesPerState;
+            } else {
+                LOG_ERROR("AsyncQueue", "whisper_init_state failed re-creating a trimmed state");
+            }
+        }
+        state = slot;
+        if (!whisperContext || !state) {
+            return "";
+        }
+    }
+    if (audioData.empty()) {
         return "";
     }
 
-    // Extract transcription
-    const int n_segments = whisper_full_n_segments(whisperContext);
-    std::string transcription;
+    // Shutdown always interrupts a decode; marginal utterances also yield to real speech
+    TranscribeControl control{ this, marginal };
+    control.lane = lane;
+    control.traceId = traceId;
+    WhisperTranscriber::Request request;
+    request.samples = audioData.data();
+    request.count = audioData.size();
+    request.mel = mel.bands > 0 ? &mel : nullptr;
+    request.encoderBegin = &AsyncWhisperQueue::OnEncoderBegin;
+    request.abortCheck = &AsyncWhisperQueue::OnAbortCheck;
+    request.hookData = &control;
+    if (!isPartial) {
+        // Partials are superseded every pass; only final text is reported early
+        std::lock_guard<std::mutex> lock(decodedSegmentMutex);
+        if (decodedSegmentCallback) {
+            request.segment = &AsyncWhisperQueue::OnDecodedSegment;
+        }
+    }
 
-    for (int i = 0; i < n_segments; ++i) {
-        const char* text = whisper_full_get_segment_text(whisperContext, i);
-        if (text) {
-            transcription += text;
+    // Partials and continuation chunks pick up where the lane's last text left off
+    std::vector<int32_t> prompt;
+    if (prompted) {
+        std::lock_guard<std::mutex> lock(promptMutex);
+        const PromptCarry& carry = prompts[LaneIndex(lane)];
+        if (carry.model == model) {
+            prompt = carry.tokens;
         }
     }
+    request.prompt = &prompt;
+
+    // Run inference on this worker's private state, or in its process
+    WhisperTranscriber::Result result = worker->process
+        ? worker->process->Transcribe(model, request, transcriber.GetThreads())
+        : transcriber.Transcribe(whisperContext, state, request);
 
-    // Trim whitespace
-    if (!transcription.empty()) {
-        size_t start = transcription.find_first_not_of(" \t\n\r");
-        size_t end = transcription.find_last_not_of(" \t\n\r");
-        if (start != std::string::npos && end != std::string::npos) {
-            transcription = transcription.substr(start, end - start + 1);
+    if (control.yielded) {
+        marginalSkipped++;
+        LOG_DEBUG("AsyncQueue", "Marginal utterance gave way to queued speech");
+        return "";
+    }
+    if (!result.ok) {
+        if (running.load()) {
+            LOG_ERROR("AsyncQueue", "whisper_full_with_state failed");
+        }
+        return "";
+    }
+    if (!isPartial) {
+        for (const std::string& text : result.rejected) {
+            rejectedSegments++;
+            LOG_DEBUG("AsyncQueue", "Rejected hallucinated segment: \"" << text << "\"");
         }
     }
 
-    return transcription;
+    // The tail of this result's text tokens is the lane's next prompt
+    // (background audio is another conversation: it must not prompt the microphone)
+    {
+        std::lock_guard<std::mutex> lock(promptMutex);
+        prompts[LaneIndex(lane)].tokens.swap(result.tailTokens);
+        prompts[LaneIndex(lane)].model = model;
+    }
+
+    return std::move(result.text);
+}
+
+bool AsyncWhisperQueue::ShouldYield(const TranscribeControl& control) const {
+    return control.marginal && primaryWaiting.load() > 0;
+}
+
+bool AsyncWhisperQueue::OnEncoderBegin(whisper_context*, whisper_state*, void* userData) {
+    // Returning false skips the encoder (and the decode) for this utterance
+    TranscribeControl& control = *static_cast<TranscribeControl*>(userData);
+    if (control.queue->ShouldYield(control)) {
+        control.yielded = true;
+        return false;
+    }
+    return control.queue->running.load();
+}
+
+void AsyncWhisperQueue::OnDecodedSegment(const char* text, int64_t startMs, int64_t endMs, void* userData) {
+    TranscribeControl& control = *static_cast<TranscribeControl*>(userData);
+    std::string_view trimmed(text);
+    size_t start = trimmed.find_first_not_of(" \t\n\r");
+    if (start == std::string_view::npos) {
+        return;
+    }
+    trimmed.remove_prefix(start);
+    AsyncWhisperQueue& queue = *control.queue;
+    std::lock_guard<std::mutex> lock(queue.decodedSegmentMutex);
+    if (queue.decodedSegmentCallback) {
+        queue.decodedSegmentCallback(control.lane, control.traceId, control.segments++, std::string(trimmed),
+                                     startMs, endMs);
+    }
+}
+
+bool AsyncWhisperQueue::OnAbortCheck(void* userData) {
+    // Polled by ggml between graph nodes: keep it to two atomic loads
+    TranscribeControl& control = *static_cast<TranscribeControl*>(userData);
+    if (control.queue->ShouldYield(control)) {
+        control.yielded = true;
+        return true;
+    }
+    return !control.queue->running.load();
 }
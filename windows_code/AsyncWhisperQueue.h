@@ -1,5 +1,9 @@
 #pragma once
 
+#include "WhisperProcess.h"
+#include "WhisperTranscriber.h"
+#include <array>
+#include <deque>
 #include <queue>
 #include <thread>
 #include <mutex>
@@ -8,9 +12,14 @@
 #include <vector>
 #include <string>
 #include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <functional>
 
 // Forward declaration for whisper.cpp
 struct whisper_context;
+struct whisper_state;
 
 /**
  * AsyncWhisperQueue - Non-blocking whisper transcription queue
@@ -19,28 +28,236 @@ struct whisper_context;
  * Critical for long-form speech where transcription latency would otherwise
  * block speech detection.
  *
+ * Worker pool: the model is loaded once (shared whisper_context) and each
+ * worker owns its own whisper_state, so several utterances can be decoded in
+ * parallel (whisper_full_with_state). Each worker gets its own n_threads
+ * budget. Results are still delivered in the order the audio was queued.
+ *
+ * Backpressure: at most maxQueued finalized utterances wait for a worker.
+ * On overflow the configured policy either drops the oldest waiting
+ * utterance, merges the new audio into the newest waiting one (up to one
+ * 30s whisper window), or blocks the producer until a worker frees a slot.
+ * Unread results are capped at MAX_RESULTS (oldest discarded).
+ *
+ * Buffer recycling: QueueAudio(std::move(buf)) hands the utterance over
+ * without copying; once transcribed, the buffer goes back to a small
+ * free-list that AcquireBuffer() draws from, so steady-state capture ->
+ * whisper hand-off neither copies nor allocates.
+ *
+ * Precomputed spectrograms: the producer may hand over the utterance's
+ * log-mel frames with the audio (LogMelSpectrogram, computed while it was
+ * captured), and likewise with a partial window that starts at the
+ * utterance's beginning; the decode then skips whisper's own mel pass. A
+ * merged job has no frames for its joined audio and goes by the samples.
+ *
+ * Model tiers: the queue can hold several models (e.g. base.en, tiny.en) that
+ * share one worker pool; each worker keeps a whisper_state per model. The
+ * caller picks a model per utterance in QueueAudio() (AudioCaptureEngine
+ * routes short utterances to the fast tier under backlog). Partial passes
+ * always use the last model, the fastest by convention.
+ *
+ * Streaming mode: while an utterance is still in progress the caller pushes
+ * the audio so far with UpdatePartialAudio(). When no finalized utterance is
+ * waiting, the worker re-runs whisper over the last STREAMING_WINDOW_SEC of it
+ * (prompted with the previous hypothesis' tokens) and publishes the text as a
+ * partial result. Finalized utterances always take priority and clear the
+ * partial once transcribed.
+ *
+ * Lanes: utterances are queued on the Primary lane (microphone) or the
+ * Background lane (system audio loopback). Each lane keeps its own queue,
+ * backpressure limit and result order, so a slow background utterance never
+ * holds back a microphone result. Workers take primary utterances first,
+ * then a pending partial pass, then background utterances - and at most
+ * all but one worker decode background audio at a time, so a microphone
+ * utterance always finds a free worker within one decode. Partials belong
+ * to the Primary lane.
+ *
+ * Continuations: a long utterance is queued as several chunks (split by the
+ * caller at a pause). A chunk queued with continuation = true is prompted
+ * with the tail tokens of its lane's previous transcription, so wording and
+ * casing carry across the cut. Each lane keeps its own prompt.
+ *
+ * Decoding: every pass goes through one WhisperTranscriber, which holds the
+ * tuned whisper parameters and the hallucination filter; segments it
+ * rejects are counted (GetRejectedSegmentCount) and never reach the
+ * transcript.
+ *
+ * Marginal utterances: the producer passes the mean VAD probability of each
+ * utterance. Below SetMarginalVadConfidence() the decode gives way to real
+ * speech: it is skipped before the encoder, or aborted mid-decode, as soon
+ * as a Primary utterance is waiting for a worker.
+ *
+ * Idle trimming: TrimIdle() has the workers beyond a minimum free their
+ * whisper_states (KV caches and compute buffers) once they are idle, and
+ * drops the recycled buffers and the partial window; a trimmed worker
+ * re-creates its state on its next job, which then decodes cold.
+ *
+ * Warm-up: a whisper_state's first decode pays for its compute buffers and
+ * the first touch of the weights. Each worker therefore starts by decoding
+ * WARMUP_SEC of silence on every model tier at idle priority; a Primary
+ * utterance arriving meanwhile aborts it (like a marginal one) and warms
+ * the state itself. IsWarm() / WaitUntilWarm() report when every worker
+ * is through.
+ *
+ * Out of process (WhisperProcess): each worker decodes in a child process
+ * of its own that loads the model tiers itself, so a crash in whisper costs
+ * a restart, not the engine. Worker 0's child starts with the queue; the
+ * others start on demand - a worker without a live child only takes a job
+ * when no worker with one is idle - and end after PROCESS_IDLE_MS without
+ * a job, so the pool follows the load. Jobs decode from the samples (no
+ * precomputed frames), and are not reported segment by segment.
+ *
+ * Delivery: SetResultReadyCallback() registers a hook the workers call as
+ * soon as a result is published or the partial changes, so consumers read
+ * GetLatestResult()/GetPartialResult() on demand instead of polling them.
+ * With SetDecodedSegmentCallback() a long finalized utterance (from
+ * WhisperTranscriber::SEGMENTED_MIN_SAMPLES) is also reported segment by
+ * segment while whisper decodes it; the whole result follows as usual.
+ *
  * Usage:
- *   AsyncWhisperQueue queue(whisperContext);
- *   queue.QueueAudio(audioData);  // Non-blocking
+ *   AsyncWhisperQueue queue(whisperContext, 2, 4);             // 2 workers x 4 threads
+ *   AsyncWhisperQueue tiered({baseContext, tinyContext}, 2, 4); // model 1 = fast tier
+ *   queue.UpdatePartialAudio(speech.data(), speech.size());  // While speaking
+ *   std::string partial = queue.GetPartialResult();          // Current hypothesis
+ *   queue.QueueAudio(std::move(speech));  // Non-blocking, utterance finished
+ *   speech = queue.AcquireBuffer();       // Recycled, capacity retained
  *   std::string result = queue.GetLatestResult();  // Returns last completed
+ *   queue.SetResultReadyCallback([&] { Drain(queue); });  // Push instead of poll
+ *   queue.QueueAudio(std::move(loopback), 0, 0, AsyncWhisperQueue::Lane::Background);
+ *   std::string remote = queue.GetLatestResult(nullptr, AsyncWhisperQueue::Lane::Background);
  */
 class AsyncWhisperQueue {
 public:
-    explicit AsyncWhisperQueue(whisper_context* ctx);
+    // What QueueAudio() does when maxQueued utterances are already waiting
+    enum class OverflowPolicy {
+        DropOldest,     // Discard the oldest waiting utterance
+        MergeAdjacent,  // Append to the newest waiting utterance (falls back to DropOldest)
+        BlockProducer   // Wait until a worker dequeues one
+    };
+
+    // Which stream an utterance came from; Primary is decoded first
+    enum class Lane {
+        Primary,        // Microphone: user speech, streaming partials
+        Background      // System audio loopback: remote speakers, playback
+    };
+    static constexpr size_t LANE_COUNT = 2;
+
+    // Partial passes cover the last this many seconds of the utterance
+    static constexpr int STREAMING_WINDOW_SEC = 10;
+
+    explicit AsyncWhisperQueue(whisper_context* ctx, int numWorkers = 1, int threadsPerWorker = 4,
+                               size_t maxQueued = 8, OverflowPolicy policy = OverflowPolicy::MergeAdjacent);
+
+    // Tiered: models[0] is the primary model, later entries faster fallbacks.
+    // watchdogGroup: the Watchdog group the workers' heartbeats report to
+    explicit AsyncWhisperQueue(const std::vector<whisper_context*>& models, int numWorkers = 1,
+                               int threadsPerWorker = 4, size_t maxQueued = 8,
+                               OverflowPolicy policy = OverflowPolicy::MergeAdjacent,
+                               const char* watchdogGroup = "voice");
+
+    // Out of process: one WhisperProcess per worker, loading remote.modelPaths
+    explicit AsyncWhisperQueue(const WhisperProcess::Options& remote, int numWorkers = 1,
+                               int threadsPerWorker = 4, size_t maxQueued = 8,
+                               OverflowPolicy policy = OverflowPolicy::MergeAdjacent,
+                               const char* watchdogGroup = "voice");
     ~AsyncWhisperQueue();
 
-    // Queue audio for transcription (non-blocking)
-    void QueueAudio(const std::vector<float>& audio);
+    // Abort the decodes in progress (whisper's abort callback) and let the
+    // workers exit; whatever is queued is dropped. For shutdown: the queue
+    // transcribes nothing afterwards (the destructor still joins)
+    void Cancel();
+
+    // Queue audio for transcription on the given model tier and lane (non-blocking);
+    // traceId (UtteranceTracer) is marked at each step and returned with the result.
+    // continuation: the audio continues the lane's previous chunk (prompted with it);
+    // vadConfidence: mean VAD speech probability of the audio (1 = unknown)
+    void QueueAudio(const std::vector<float>& audio, size_t model = 0, uint64_t traceId = 0,
+                    Lane lane = Lane::Primary, bool continuation = false,
+                    float vadConfidence = 1.0f);                               // Copies
+    void QueueAudio(std::vector<float>&& audio, size_t model = 0, uint64_t traceId = 0,
+                    Lane lane = Lane::Primary, bool continuation = false,
+                    float vadConfidence = 1.0f,
+                    LogMelSpectrogram::Frames* mel = nullptr);                 // Takes ownership (and mel's frames)
+
+    // Empty buffer with utterance-sized capacity, recycled from finished jobs when possible
+    std::vector<float> AcquireBuffer();
+
+    // Get the oldest unread transcription of a lane (non-blocking)
+    // Returns empty string if no new results; traceId gets the utterance's trace
+    std::string GetLatestResult(uint64_t* traceId = nullptr, Lane lane = Lane::Primary);
+
+    // Replace the in-progress utterance audio used for the next partial pass (non-blocking);
+    // mel: frames of exactly audio[0, count), swapped with the previous window's (capacity kept)
+    void UpdatePartialAudio(const float* audio, size_t count, LogMelSpectrogram::Frames* mel = nullptr);
 
-    // Get latest completed transcription (non-blocking)
-    // Returns empty string if no new results
-    std::string GetLatestResult();
+    // Current partial hypothesis for the in-progress utterance (not consumed)
+    // Returns empty string if none, or once the utterance has been finalized
+    std::string GetPartialResult() const;
 
-    // Check if actively transcribing
+    // Called on a worker (or the producer, for dropped utterances) whenever new
+    // results were published or the partial hypothesis changed; invocations are
+    // serialized. Read the results from inside it; don't call back into QueueAudio()
+    using ResultReadyCallback = std::function<void()>;
+    void SetResultReadyCallback(ResultReadyCallback callback);
+
+    // Called on the worker with each transcribed utterance's audio before its
+    // buffer is recycled (AudioArchive). It may swap audio with another empty
+    // buffer, which is recycled in its place; keep it short, the worker waits
+    using FinishedAudioSink = std::function<void(Lane lane, std::vector<float>& audio, const std::string& text)>;
+    void SetFinishedAudioSink(FinishedAudioSink sink);
+
+    // Called on the worker with each segment of a finalized utterance as soon
+    // as whisper has decoded it, before the utterance's result is published.
+    // index counts the utterance's segments from 0; times are ms into its audio
+    using DecodedSegmentCallback = std::function<void(Lane lane, uint64_t traceId, int index,
+                                                      const std::string& text, int64_t startMs, int64_t endMs)>;
+    void SetDecodedSegmentCallback(DecodedSegmentCallback callback);
+
+    // Capacity AcquireBuffer() reserves
+    static size_t BufferSamples() { return MAX_MERGED_SAMPLES; }
+
+    // Utterances with a lower vadConfidence yield to waiting Primary utterances
+    // (skipped or aborted); 0 disables
+    void SetMarginalVadConfidence(float confidence) { marginalVadConfidence.store(confidence); }
+
+    // n_threads for each worker's decodes, from the next one on (power profiles)
+    void SetThreadsPerWorker(int threads) { transcriber.SetThreads(threads); }
+    int GetThreadsPerWorker() const { return transcriber.GetThreads(); }
+
+    // Check if actively transcribing (any worker, finalized utterances only)
     bool IsProcessing() const;
 
-    // Get queue size
-    size_t GetQueueSize() const;
+    // Every worker has run its warm-up decode (or given it up to real speech)
+    bool IsWarm() const { return warmWorkers.load() == workers.size(); }
+
+    // Block until IsWarm() or Cancel(); returns IsWarm()
+    bool WaitUntilWarm();
+
+    // Number of whisper_state workers in the pool
+    size_t GetWorkerCount() const { return workers.size(); }
+
+    // Workers from keepWorkers on free their states when next idle; recycled
+    // buffers and the partial window are released now. Returns those buffers' bytes
+    uint64_t TrimIdle(size_t keepWorkers);
+
+    // Bumped by every QueueAudio() and UpdatePartialAudio(): unchanged means no speech came in
+    uint64_t GetActivityCount() const { return activityCount.load(); }
+
+    // Utterances waiting for a worker on a lane
+    size_t GetQueueSize(Lane lane = Lane::Primary) const;
+
+    // Bytes held by the decoder states and by audio waiting or kept for reuse
+    struct MemoryUsage {
+        uint64_t stateBytes = 0;        // Every worker's whisper_state (measured at creation)
+        uint64_t queuedBytes = 0;       // Queued utterance buffers (capacity)
+        uint64_t freeBufferBytes = 0;   // Recycled buffers on the free-list
+        uint64_t partialBytes = 0;      // Pending partial window
+    };
+    MemoryUsage GetMemoryUsage() const;
+
+    // Finalized utterances queued whose result (or drop) hasn't been delivered
+    // yet; 0 means everything handed to QueueAudio() has come out the other end
+    size_t GetInFlightCount() const { return inFlightCount.load(); }
 
     // Get total processed count
     size_t GetProcessedCount() const;
@@ -48,28 +265,206 @@ public:
     // Get last transcription latency in milliseconds
     float GetLastLatencyMs() const;
 
+    // Model tiers
+    size_t GetModelCount() const { return modelCount; }
+
+    // Smoothed compute ms per second of audio for a model (0 before its first utterance)
+    float GetModelMsPerAudioSecond(size_t model) const;
+    size_t GetModelUtteranceCount(size_t model) const;
+
+    // Backpressure counters
+    size_t GetDroppedCount() const { return droppedCount.load(); }
+    size_t GetMergedCount() const { return mergedCount.load(); }
+
+    // Hallucination filter / marginal utterance counters
+    size_t GetRejectedSegmentCount() const { return rejectedSegments.load(); }
+    size_t GetMarginalSkippedCount() const { return marginalSkipped.load(); }
+
+    // Time the last / slowest utterance spent waiting before a worker picked it up
+    float GetLastQueueAgeMs() const { return lastQueueAgeMs.load(); }
+    float GetMaxQueueAgeMs() const { return maxQueueAgeMs.load(); }
+
 private:
-    void WorkerThread();
-    std::string TranscribeAudio(const std::vector<float>& audioData);
+    // One decoder: a private whisper_state per model + thread, sharing the model
+    // weights - or, out of process, the child that holds both
+    struct Worker {
+        std::vector<whisper_state*> states;     // Null entries: trimmed, re-created on use
+        std::unique_ptr<WhisperProcess> process;
+        size_t index = 0;
+        std::thread thread;
+        bool trimRequested = false;             // audioQueueMutex
+    };
+
+    // A finalized utterance, tagged with its queue order and model tier
+    struct Job {
+        std::vector<float> audio;
+        uint64_t sequence;
+        std::chrono::steady_clock::time_point enqueueTime;
+        size_t model = 0;
+        uint64_t traceId = 0;
+        Lane lane = Lane::Primary;
+        bool continuation = false;
+        float vadConfidence = 1.0f;
+        LogMelSpectrogram::Frames mel;  // Empty unless the producer precomputed them
+    };
+
+    struct Result {
+        std::string text;
+        uint64_t traceId = 0;
+    };
+
+    // Per-lane input (guarded by audioQueueMutex); a deque rather than
+    // std::queue so GetMemoryUsage() can walk it
+    struct LaneQueue {
+        std::deque<Job> jobs;
+        uint64_t nextSequence = 0;
+    };
+
+    // Per-lane output (guarded by resultsQueueMutex); completions that
+    // overtook an earlier job of the lane wait in pending until everything
+    // queued before them has finished
+    struct LaneResults {
+        std::queue<Result> published;
+        std::map<uint64_t, Result> pending;
+        uint64_t nextSequenceToPublish = 0;
+    };
 
-    // Whisper context (shared, not owned)
-    whisper_context* whisperContext;
+    AsyncWhisperQueue(const std::vector<whisper_context*>& models, const WhisperProcess::Options* remote,
+                      int numWorkers, int threadsPerWorker, size_t maxQueued, OverflowPolicy policy,
+                      const char* watchdogGroup);
 
-    // Audio queue (input)
-    std::queue<std::vector<float>> audioQueue;
+    static size_t LaneIndex(Lane lane) { return static_cast<size_t>(lane); }
+
+    void WorkerThread(Worker* worker);
+    // Decode WARMUP_SEC of silence on each of the worker's states (see Warm-up)
+    void WarmUpWorker(Worker* worker);
+    // Free the worker's states (worker thread, idle)
+    void ReleaseStates(Worker* worker);
+    // The result's tokens become the lane's prompt; prompted: decode with the
+    // lane's current prompt (partial passes, continuation chunks); marginal:
+    // give way to waiting Primary utterances (see SetMarginalVadConfidence);
+    // traceId: the utterance reported with its decoded segments (final passes)
+    std::string TranscribeAudio(Worker* worker, size_t model, const std::vector<float>& audioData,
+                                const LogMelSpectrogram::Frames& mel, bool isPartial, Lane lane, bool prompted,
+                                bool marginal = false, uint64_t traceId = 0);
+    // whisper encoder-begin / abort / segment hooks; user data is a TranscribeControl
+    struct TranscribeControl {
+        AsyncWhisperQueue* queue;
+        bool marginal;
+        bool yielded = false;
+        Lane lane = Lane::Primary;
+        uint64_t traceId = 0;
+        int segments = 0;               // Reported so far
+    };
+    static bool OnEncoderBegin(whisper_context* ctx, whisper_state* state, void* userData);
+    static bool OnAbortCheck(void* userData);
+    static void OnDecodedSegment(const char* text, int64_t startMs, int64_t endMs, void* userData);
+    bool ShouldYield(const TranscribeControl& control) const;
+    void RecordModelLatency(size_t model, float latencyMs, size_t samples);
+    void PublishResult(Lane lane, uint64_t sequence, const std::string& transcription, uint64_t traceId);
+    // Background decodes allowed at once: all workers but one (audioQueueMutex held)
+    bool CanTakeBackground() const;
+    void NotifyResultReady();
+    // New work: wakes one worker, or out of process all of them (a cold one may pass on it)
+    void WakeWorker();
+    void RecycleBuffer(std::vector<float>&& buffer);
+
+    // Backpressure configuration
+    static constexpr size_t MAX_MERGED_SAMPLES = 16000 * 30;  // One whisper window
+    static constexpr size_t MAX_RESULTS = 32;                 // Unread results kept
+    static constexpr size_t MAX_FREE_BUFFERS = 4;             // Recycled utterance buffers kept
+
+    // A worker silent this long is reported by the Watchdog (a 30 s window on a slow CPU)
+    static constexpr int WORKER_STALL_MS = 120 * 1000;
+
+    // Silence decoded per model tier before a worker takes its first job
+    static constexpr int WARMUP_SEC = 2;
+
+    // Out of process: an idle worker's child (beyond worker 0's) ends after this long
+    static constexpr int PROCESS_IDLE_MS = 60 * 1000;
+    static constexpr int PROCESS_IDLE_CHECK_MS = 1000;
+
+    // Whisper contexts (shared, not owned); models[0] is the primary
+    std::vector<whisper_context*> models;
+    size_t modelCount;                  // Tiers, in or out of process
+    int threadsPerWorker;
+    WhisperTranscriber transcriber;     // Shared decode parameters, built once
+
+    // Worker pool (states owned, freed in destructor)
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<uint64_t> stateBytes;   // Private bytes grown by whisper_init_state, all workers
+    uint64_t bytesPerState;             // Measured at creation, for the trimmed / re-created ones
+
+    // Audio queues (input), one per lane; maxQueued applies to each
+    std::array<LaneQueue, LANE_COUNT> laneQueues;
+    size_t backgroundActive;            // Workers decoding a Background job (audioQueueMutex)
+    size_t idleWarmProcesses;           // Out of process: idle workers with a live child (audioQueueMutex)
+    std::atomic<size_t> primaryWaiting; // Primary jobs queued, readable from the abort hook
+    std::atomic<float> marginalVadConfidence;
+    size_t maxQueued;
+    OverflowPolicy overflowPolicy;
     mutable std::mutex audioQueueMutex;
+    std::condition_variable spaceCv;    // Signalled when a worker dequeues (BlockProducer)
 
-    // Results queue (output)
-    std::queue<std::string> resultsQueue;
+    // Free-list of finished utterance buffers
+    std::vector<std::vector<float>> freeBuffers;
+    mutable std::mutex freeBuffersMutex;
+
+    // Partial audio (input, guarded by audioQueueMutex): latest window only
+    std::vector<float> partialAudio;
+    LogMelSpectrogram::Frames partialMel;       // Frames of partialAudio, or empty
+    bool partialPending;
+    uint64_t partialGeneration;
+    std::atomic<uint64_t> utteranceGeneration;  // Bumped by every QueueAudio()
+    std::atomic<uint64_t> activityCount;        // GetActivityCount
+    bool partialInFlight;                       // At most one partial pass at a time
+
+    // Results (output), one ordered stream per lane
+    std::array<LaneResults, LANE_COUNT> laneResults;
+    std::string partialResult;
     mutable std::mutex resultsQueueMutex;
 
-    // Worker thread
-    std::thread workerThread;
+    // Result delivery hook; held while it runs so deliveries stay in order
+    ResultReadyCallback resultReadyCallback;
+    std::mutex resultReadyMutex;
+
+    FinishedAudioSink finishedAudioSink;
+    std::mutex finishedAudioMutex;
+    DecodedSegmentCallback decodedSegmentCallback;
+    std::mutex decodedSegmentMutex;
+
+    // Prompt carry-over from each lane's last transcription (shared by all workers)
+    struct PromptCarry {
+        std::vector<int32_t> tokens;
+        size_t model = 0;               // Tokens are only valid for the model that produced them
+    };
+    std::array<PromptCarry, LANE_COUNT> prompts;
+    std::mutex promptMutex;
+
+    // Per-model speed, for the caller's tier selection
+    static constexpr float MODEL_LATENCY_SMOOTHING = 0.3f;   // EWMA weight of the newest utterance
+    std::vector<float> modelMsPerAudioSecond;
+    std::vector<size_t> modelUtterances;
+    mutable std::mutex modelStatsMutex;
+
+    // Worker threads
     std::condition_variable cv;
     std::atomic<bool> running;
-    std::atomic<bool> processing;
+    std::atomic<int> activeJobs;
+    std::atomic<size_t> inFlightCount;  // Queued jobs not yet through NotifyResultReady()
+    std::atomic<size_t> warmWorkers;    // Workers through WarmUpWorker()
+    std::mutex warmMutex;
+    std::condition_variable warmCv;     // Signalled per warmed worker and by Cancel()
 
     // Metrics
     std::atomic<size_t> processedCount;
     std::atomic<float> lastLatencyMs;
+    std::atomic<size_t> droppedCount;
+    std::atomic<size_t> mergedCount;
+    std::atomic<size_t> rejectedSegments;
+    std::atomic<size_t> marginalSkipped;
+    std::atomic<float> lastQueueAgeMs;
+    std::atomic<float> maxQueueAgeMs;
+
+    const char* watchdogGroup;
 };
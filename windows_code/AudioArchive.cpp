@@ -0,0 +1,560 @@
+#include "AudioArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include "Log.h"
+#include "Trace.h"
+
+#ifdef PERCEPTION_OPUS
+#include <opus.h>
+#endif
+
+namespace {
+
+void PutLE16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void PutLE32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void PutLE64(std::vector<uint8_t>& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+std::wstring Widen(const std::string& path) {
+    return std::filesystem::u8path(path).wstring();
+}
+
+bool IsArchiveFile(const std::wstring& name) {
+    auto endsWith = [&](const wchar_t* suffix) {
+        size_t length = wcslen(suffix);
+        return name.size() > length && name.compare(name.size() - length, length, suffix) == 0;
+    };
+    return endsWith(L".opus") || endsWith(L".wav") || endsWith(L".txt");
+}
+
+}  // namespace
+
+#ifdef PERCEPTION_OPUS
+
+// Ogg Opus (RFC 7845): OpusHead and OpusTags pages, then 20 ms packets
+// gathered into pages of up to a second. Granule positions count 48 kHz
+// samples whatever the input rate.
+class AudioArchive::Encoder {
+public:
+    static constexpr int FRAME_SAMPLES = SAMPLE_RATE / 50;
+    static constexpr int PACKETS_PER_PAGE = 50;
+    static constexpr int GRANULE_SCALE = 48000 / SAMPLE_RATE;
+
+    ~Encoder() {
+        if (opus) {
+            opus_encoder_destroy(opus);
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    bool Open(const std::wstring& path) {
+        int error = OPUS_OK;
+        opus = opus_encoder_create(SAMPLE_RATE, 1, OPUS_APPLICATION_VOIP, &error);
+        if (error != OPUS_OK) {
+            opus = nullptr;
+            LOG_ERROR("AudioArchive", "opus_encoder_create failed: " << opus_strerror(error));
+            return false;
+        }
+        opus_encoder_ctl(opus, OPUS_SET_BITRATE(16000));
+        opus_encoder_ctl(opus, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+        opus_encoder_ctl(opus, OPUS_SET_COMPLEXITY(5));
+        opus_int32 lookahead = 0;
+        opus_encoder_ctl(opus, OPUS_GET_LOOKAHEAD(&lookahead));
+        preSkip = static_cast<uint64_t>(lookahead) * GRANULE_SCALE;
+
+        file = _wfopen(path.c_str(), L"wb");
+        if (!file) {
+            return false;
+        }
+        serial = static_cast<uint32_t>(GetTickCount64() ^ reinterpret_cast<uintptr_t>(this));
+
+        std::vector<uint8_t> head = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, 1 };
+        PutLE16(head, static_cast<uint16_t>(preSkip));
+        PutLE32(head, SAMPLE_RATE);
+        PutLE16(head, 0);       // Output gain
+        head.push_back(0);      // Mapping family: mono
+        AddPacket(head.data(), head.size());
+        FlushPage(0x02, 0);
+
+        static const char vendor[] = "PerceptionEngine";
+        std::vector<uint8_t> tags = { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' };
+        PutLE32(tags, sizeof(vendor) - 1);
+        tags.insert(tags.end(), vendor, vendor + sizeof(vendor) - 1);
+        PutLE32(tags, 0);
+        AddPacket(tags.data(), tags.size());
+        FlushPage(0, 0);
+        return !failed;
+    }
+
+    void Write(const float* samples, size_t count) {
+        while (count > 0) {
+            size_t take = std::min(count, static_cast<size_t>(FRAME_SAMPLES) - frame.size());
+            frame.insert(frame.end(), samples, samples + take);
+            samples += take;
+            count -= take;
+            if (frame.size() == FRAME_SAMPLES) {
+                EncodeFrame();
+            }
+        }
+    }
+
+    // Pads the last frame with silence; the final granule trims it off again
+    bool Close(uint64_t& bytes) {
+        uint64_t total = inputSamples + frame.size();
+        if (!frame.empty()) {
+            frame.resize(FRAME_SAMPLES, 0.0f);
+            EncodeFrame();
+        }
+        FlushPage(0x04, preSkip + total * GRANULE_SCALE);
+        bytes = written;
+        bool ok = !failed && fclose(file) == 0;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    void EncodeFrame() {
+        unsigned char packet[1275];
+        opus_int32 size = opus_encode_float(opus, frame.data(), FRAME_SAMPLES, packet, sizeof(packet));
+        inputSamples += frame.size();
+        frame.clear();
+        if (size < 0) {
+            failed = true;
+            return;
+        }
+        // 255 lacing values per page: a full page goes out before this packet
+        if (lacing.size() + size / 255 + 1 > 255 || packets == PACKETS_PER_PAGE) {
+            FlushPage(0, preSkip + pageSamples * GRANULE_SCALE);
+        }
+        AddPacket(packet, static_cast<size_t>(size));
+        pageSamples = inputSamples;
+    }
+
+    void AddPacket(const uint8_t* data, size_t size) {
+        for (size_t remaining = size;; remaining -= 255) {
+            if (remaining < 255) {
+                lacing.push_back(static_cast<uint8_t>(remaining));
+                break;
+            }
+            lacing.push_back(255);
+        }
+        body.insert(body.end(), data, data + size);
+        packets++;
+    }
+
+    void FlushPage(uint8_t flags, uint64_t granule) {
+        std::vector<uint8_t> page = { 'O', 'g', 'g', 'S', 0, flags };
+        PutLE64(page, granule);
+        PutLE32(page, serial);
+        PutLE32(page, pageSequence++);
+        PutLE32(page, 0);       // CRC, filled in below
+        page.push_back(static_cast<uint8_t>(lacing.size()));
+        page.insert(page.end(), lacing.begin(), lacing.end());
+        page.insert(page.end(), body.begin(), body.end());
+        uint32_t crc = Crc(page);
+        std::memcpy(&page[22], &crc, sizeof(crc));
+        if (fwrite(page.data(), 1, page.size(), file) != page.size()) {
+            failed = true;
+        }
+        written += page.size();
+        lacing.clear();
+        body.clear();
+        packets = 0;
+    }
+
+    // Ogg's CRC-32: polynomial 0x04c11db7, unreflected, zero initial value
+    static uint32_t Crc(const std::vector<uint8_t>& data) {
+        static const auto table = [] {
+            std::vector<uint32_t> entries(256);
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i << 24;
+                for (int bit = 0; bit < 8; bit++) {
+                    value = (value & 0x80000000u) ? (value << 1) ^ 0x04c11db7u : value << 1;
+                }
+                entries[i] = value;
+            }
+            return entries;
+        }();
+        uint32_t crc = 0;
+        for (uint8_t byte : data) {
+            crc = (crc << 8) ^ table[((crc >> 24) ^ byte) & 0xff];
+        }
+        return crc;
+    }
+
+    OpusEncoder* opus = nullptr;
+    FILE* file = nullptr;
+    uint32_t serial = 0;
+    uint32_t pageSequence = 0;
+    uint64_t preSkip = 0;
+    std::vector<float> frame;
+    std::vector<uint8_t> lacing;
+    std::vector<uint8_t> body;
+    int packets = 0;
+    uint64_t inputSamples = 0;      // Encoded, at 16 kHz
+    uint64_t pageSamples = 0;       // Completed by the packets on the current page
+    uint64_t written = 0;
+    bool failed = false;
+};
+
+const char* AudioArchive::Format() {
+    return "opus";
+}
+
+#else
+
+// 16-bit PCM WAV; sizes in the header are patched on Close()
+class AudioArchive::Encoder {
+public:
+    ~Encoder() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    bool Open(const std::wstring& path) {
+        file = _wfopen(path.c_str(), L"wb");
+        if (!file) {
+            return false;
+        }
+        std::vector<uint8_t> header = Header(0);
+        return fwrite(header.data(), 1, header.size(), file) == header.size();
+    }
+
+    void Write(const float* samples, size_t count) {
+        pcm.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            float clamped = std::max(-1.0f, std::min(1.0f, samples[i]));
+            pcm[i] = static_cast<int16_t>(clamped * 32767.0f);
+        }
+        if (fwrite(pcm.data(), sizeof(int16_t), count, file) != count) {
+            failed = true;
+        }
+        dataBytes += count * sizeof(int16_t);
+    }
+
+    bool Close(uint64_t& bytes) {
+        std::vector<uint8_t> header = Header(static_cast<uint32_t>(dataBytes));
+        bool ok = !failed && fseek(file, 0, SEEK_SET) == 0 &&
+                  fwrite(header.data(), 1, header.size(), file) == header.size();
+        ok = fclose(file) == 0 && ok;
+        file = nullptr;
+        bytes = header.size() + dataBytes;
+        return ok;
+    }
+
+private:
+    static std::vector<uint8_t> Header(uint32_t dataBytes) {
+        std::vector<uint8_t> header = { 'R', 'I', 'F', 'F' };
+        PutLE32(header, 36 + dataBytes);
+        header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+        PutLE32(header, 16);
+        PutLE16(header, 1);                     // PCM
+        PutLE16(header, 1);                     // Mono
+        PutLE32(header, SAMPLE_RATE);
+        PutLE32(header, SAMPLE_RATE * 2);       // Byte rate
+        PutLE16(header, 2);                     // Block align
+        PutLE16(header, 16);
+        header.insert(header.end(), { 'd', 'a', 't', 'a' });
+        PutLE32(header, dataBytes);
+        return header;
+    }
+
+    FILE* file = nullptr;
+    std::vector<int16_t> pcm;
+    uint64_t dataBytes = 0;
+    bool failed = false;
+};
+
+const char* AudioArchive::Format() {
+    return "wav";
+}
+
+#endif
+
+AudioArchive::AudioArchive(const Options& options, size_t bufferSamples)
+    : options(options), directory(Widen(options.directory)) {
+    spares.resize(MAX_PENDING);
+    for (auto& spare : spares) {
+        spare.reserve(bufferSamples);
+    }
+    if (options.continuous) {
+        continuousRing = std::make_unique<AudioRingBuffer>(SAMPLE_RATE * CONTINUOUS_RING_SEC);
+        continuousChunk.resize(SAMPLE_RATE);
+    }
+}
+
+AudioArchive::~AudioArchive() {
+    Stop();
+}
+
+bool AudioArchive::Start() {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        LOG_ERROR("AudioArchive", "Cannot create " << options.directory << ": " << ec.message());
+        return false;
+    }
+    ScanDirectory();
+    Prune();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return true;
+    }
+    running = true;
+    thread = std::thread(&AudioArchive::Run, this);
+    LOG_INFO("AudioArchive", "Archiving " << (options.continuous ? "all microphone audio" : "speech segments")
+             << " to " << options.directory << " (" << Format() << ", " << (options.maxBytes / (1024 * 1024))
+             << " MB cap, " << (directoryBytes / (1024 * 1024)) << " MB in use)");
+    return true;
+}
+
+void AudioArchive::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool AudioArchive::SubmitSegment(bool systemAudio, std::vector<float>& audio, const std::string& text) {
+    if (audio.empty()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running || spares.empty()) {
+            segmentsDropped.fetch_add(1);
+            return false;
+        }
+        pending.emplace_back();
+        Segment& segment = pending.back();
+        segment.systemAudio = systemAudio;
+        segment.audio = std::move(spares.back());
+        spares.pop_back();
+        segment.audio.swap(audio);
+        segment.text = text;
+        GetLocalTime(&segment.time);
+    }
+    wake.notify_one();
+    return true;
+}
+
+void AudioArchive::WriteContinuous(const float* samples, size_t count) {
+    if (continuousRing) {
+        continuousRing->Write(samples, count);
+    }
+}
+
+void AudioArchive::Run() {
+    TRACE_THREAD("AudioArchive");
+    // Low CPU, I/O and memory priority: encoding never competes with capture or decoding
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+    while (true) {
+        Segment segment;
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(DRAIN_MS), [this]() { return !running || !pending.empty(); });
+            if (!pending.empty()) {
+                segment = std::move(pending.front());
+                pending.pop_front();
+            } else {
+                stopping = !running;
+            }
+        }
+        if (!segment.audio.empty()) {
+            WriteSegment(segment);
+            segment.audio.clear();
+            std::lock_guard<std::mutex> lock(mutex);
+            spares.push_back(std::move(segment.audio));
+        }
+        DrainContinuous(stopping);
+        if (stopping) {
+            break;
+        }
+    }
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+}
+
+std::string AudioArchive::FileStem(const SYSTEMTIME& time, const char* kind) {
+    char name[96];
+    std::snprintf(name, sizeof(name), "%04u%02u%02u-%02u%02u%02u-%03u-%s-%llu",
+                  time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond,
+                  time.wMilliseconds, kind, static_cast<unsigned long long>(++sequence));
+    return name;
+}
+
+void AudioArchive::WriteSegment(Segment& segment) {
+    TRACE_ZONE("AudioArchive::WriteSegment");
+    std::string stem = FileStem(segment.time, segment.systemAudio ? "system" : "mic");
+    auto encoder = std::make_unique<Encoder>();
+    if (!encoder->Open(directory + L"\\" + Widen(stem + "." + Format() + ".tmp"))) {
+        LOG_WARNING("AudioArchive", "Cannot write " << stem << " in " << options.directory);
+        return;
+    }
+    encoder->Write(segment.audio.data(), segment.audio.size());
+    if (!Finish(encoder, stem)) {
+        return;
+    }
+    segmentsWritten.fetch_add(1);
+
+    if (!segment.text.empty()) {
+        std::wstring text = directory + L"\\" + Widen(stem + ".txt");
+        FILE* file = _wfopen((text + L".tmp").c_str(), L"wb");
+        if (file) {
+            bool ok = fwrite(segment.text.data(), 1, segment.text.size(), file) == segment.text.size();
+            ok = fclose(file) == 0 && ok;
+            if (ok && MoveFileExW((text + L".tmp").c_str(), text.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+                files.push_back({ text, segment.text.size() });
+                directoryBytes += segment.text.size();
+                bytesWritten.fetch_add(segment.text.size());
+            }
+        }
+    }
+    Prune();
+}
+
+void AudioArchive::DrainContinuous(bool final) {
+    if (!continuousRing) {
+        return;
+    }
+    while (size_t count = continuousRing->Read(continuousChunk.data(), continuousChunk.size())) {
+        if (!continuousFile) {
+            SYSTEMTIME time;
+            GetLocalTime(&time);
+            continuousStem = FileStem(time, "continuous");
+            continuousFile = std::make_unique<Encoder>();
+            if (!continuousFile->Open(directory + L"\\" + Widen(continuousStem + "." + Format() + ".tmp"))) {
+                LOG_WARNING("AudioArchive", "Cannot write " << continuousStem << " in " << options.directory);
+                continuousFile.reset();
+                break;
+            }
+            continuousSamples = 0;
+        }
+        continuousFile->Write(continuousChunk.data(), count);
+        continuousSamples += count;
+        if (continuousSamples >= static_cast<uint64_t>(CONTINUOUS_FILE_SEC) * SAMPLE_RATE) {
+            Finish(continuousFile, continuousStem);
+            Prune();
+        }
+    }
+    if (final && continuousFile) {
+        Finish(continuousFile, continuousStem);
+        Prune();
+    }
+}
+
+bool AudioArchive::Finish(std::unique_ptr<Encoder>& encoder, const std::string& stem) {
+    std::wstring path = directory + L"\\" + Widen(stem + "." + Format());
+    uint64_t bytes = 0;
+    bool ok = encoder->Close(bytes);
+    encoder.reset();
+    if (!ok || !MoveFileExW((path + L".tmp").c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        LOG_WARNING("AudioArchive", "Failed to write " << stem << " (" << GetLastError() << ")");
+        DeleteFileW((path + L".tmp").c_str());
+        return false;
+    }
+    files.push_back({ path, bytes });
+    directoryBytes += bytes;
+    bytesWritten.fetch_add(bytes);
+    return true;
+}
+
+void AudioArchive::ScanDirectory() {
+    files.clear();
+    directoryBytes = 0;
+    WIN32_FIND_DATAW found;
+    HANDLE find = FindFirstFileW((directory + L"\\*").c_str(), &found);
+    if (find == INVALID_HANDLE_VALUE) {
+        diskBytes.store(0);
+        return;
+    }
+    std::vector<File> existing;
+    do {
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        std::wstring name = found.cFileName;
+        std::wstring path = directory + L"\\" + name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, L".tmp") == 0) {
+            // Left by a run that didn't finish its file
+            DeleteFileW(path.c_str());
+        } else if (IsArchiveFile(name)) {
+            uint64_t bytes = (static_cast<uint64_t>(found.nFileSizeHigh) << 32) | found.nFileSizeLow;
+            existing.push_back({ path, bytes });
+        }
+    } while (FindNextFileW(find, &found));
+    FindClose(find);
+
+    // Names start with the timestamp: sorted by name is oldest first
+    std::sort(existing.begin(), existing.end(), [](const File& a, const File& b) { return a.path < b.path; });
+    for (auto& file : existing) {
+        directoryBytes += file.bytes;
+        files.push_back(std::move(file));
+    }
+    diskBytes.store(directoryBytes);
+}
+
+void AudioArchive::Prune() {
+    while (directoryBytes > options.maxBytes && !files.empty()) {
+        const File& oldest = files.front();
+        if (DeleteFileW(oldest.path.c_str()) || GetLastError() == ERROR_FILE_NOT_FOUND) {
+            filesPruned.fetch_add(1);
+            bytesPruned.fetch_add(oldest.bytes);
+        } else {
+            LOG_WARNING("AudioArchive", "Cannot delete " << std::filesystem::path(oldest.path).u8string()
+                        << " (" << GetLastError() << ")");
+        }
+        directoryBytes -= oldest.bytes;
+        files.pop_front();
+    }
+    diskBytes.store(directoryBytes);
+}
+
+std::string AudioArchive::FormatPrometheus() const {
+    std::string out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "perception_archive_segments_total %llu\n",
+                  static_cast<unsigned long long>(segmentsWritten.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_archive_segments_dropped_total %llu\n",
+                  static_cast<unsigned long long>(segmentsDropped.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_archive_written_bytes_total %llu\n",
+                  static_cast<unsigned long long>(bytesWritten.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_archive_pruned_files_total %llu\n",
+                  static_cast<unsigned long long>(filesPruned.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_archive_pruned_bytes_total %llu\n",
+                  static_cast<unsigned long long>(bytesPruned.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_archive_disk_bytes %llu\n",
+                  static_cast<unsigned long long>(diskBytes.load()));
+    out += line;
+    return out;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AudioRingBuffer.h"
+
+/**
+ * AudioArchive - Rolling, disk-bounded archive of the audio the engine heard
+ *
+ * Keeps every finalized speech segment (and, optionally, the continuous
+ * microphone stream) on disk so a transcript can be checked against the
+ * audio behind it. Files are Ogg Opus when the engine is built with
+ * PERCEPTION_OPUS (about 16 kbit/s for 16 kHz mono speech, ~40x smaller
+ * than the float samples), 16-bit WAV otherwise. Once the directory grows
+ * past maxBytes the oldest files go first.
+ *
+ * Nothing on the audio path waits on it:
+ * - Segments: SubmitSegment() runs on a whisper worker after the segment
+ *   is transcribed and swaps the job's buffer with one from the archive's
+ *   spare pool (same capacity), so the worker recycles a full-sized buffer
+ *   and the processing thread never sees a fresh allocation. With every
+ *   spare still queued for encoding the segment is dropped and counted.
+ * - Continuous: WriteContinuous() on the processing thread is one write
+ *   into a preallocated AudioRingBuffer; the archive thread drains it.
+ * Encoding and file I/O run on the archive thread in background mode
+ * (THREAD_MODE_BACKGROUND_BEGIN: low CPU, I/O and memory priority).
+ *
+ * Files: <dir>/YYYYMMDD-HHMMSS-mmm-<mic|system>-<n>.opus (or .wav) with the
+ * transcript in a .txt beside it; continuous audio rotates every
+ * CONTINUOUS_FILE_SEC into ...-continuous-<n>. Written as .tmp and renamed
+ * when complete, so the directory only ever holds whole files.
+ *
+ * Usage:
+ *   AudioArchive archive({ dir, 1024ull << 20, false }, queueBufferSamples);
+ *   archive.Start();
+ *   archive.SubmitSegment(false, job.audio, text);  // whisper worker
+ *   archive.WriteContinuous(samples, count);        // processing thread (one producer)
+ */
+class AudioArchive {
+public:
+    static constexpr int SAMPLE_RATE = 16000;
+    static constexpr size_t MAX_PENDING = 4;            // Segments waiting for the encoder (= spare buffers)
+    static constexpr int DRAIN_MS = 1000;
+    static constexpr int CONTINUOUS_FILE_SEC = 600;
+    static constexpr size_t CONTINUOUS_RING_SEC = 10;   // Headroom while the archive thread is busy
+
+    struct Options {
+        std::string directory;
+        uint64_t maxBytes = 1024ull * 1024 * 1024;
+        bool continuous = false;        // Also keep the raw microphone stream
+    };
+
+    // bufferSamples: capacity of the spare buffers handed back to the workers
+    AudioArchive(const Options& options, size_t bufferSamples);
+    ~AudioArchive();
+
+    AudioArchive(const AudioArchive&) = delete;
+    AudioArchive& operator=(const AudioArchive&) = delete;
+
+    // Creates the directory and prunes it to maxBytes; false if it can't be created
+    bool Start();
+    void Stop();
+
+    /**
+     * @brief Take a transcribed segment; audio comes back as an empty buffer of the same capacity
+     * @return false if the encoder is behind and the segment was dropped (audio untouched)
+     */
+    bool SubmitSegment(bool systemAudio, std::vector<float>& audio, const std::string& text);
+
+    /**
+     * @brief Raw microphone samples for the continuous file (single producer, no lock)
+     */
+    void WriteContinuous(const float* samples, size_t count);
+
+    bool IsContinuous() const { return options.continuous; }
+    static const char* Format();        // "opus" or "wav"
+
+    /**
+     * @brief Prometheus text: segments, drops, bytes written and pruned, directory size
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    struct Segment {
+        bool systemAudio = false;
+        std::vector<float> audio;
+        std::string text;
+        SYSTEMTIME time;
+    };
+
+    // One open output file: Ogg Opus or WAV, depending on the build
+    class Encoder;
+
+    void Run();
+    void WriteSegment(Segment& segment);
+    void DrainContinuous(bool final);
+    std::string FileStem(const SYSTEMTIME& time, const char* kind);
+    bool Finish(std::unique_ptr<Encoder>& encoder, const std::string& stem);
+    void ScanDirectory();
+    void Prune();
+
+    Options options;
+    std::wstring directory;
+
+    // Segments: spare buffers and the encoder queue share one lock, never held by the encoder
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<std::vector<float>> spares;
+    std::deque<Segment> pending;
+    bool running = false;
+    std::thread thread;
+
+    // Continuous stream (processing thread -> archive thread)
+    std::unique_ptr<AudioRingBuffer> continuousRing;
+    std::vector<float> continuousChunk;
+    std::unique_ptr<Encoder> continuousFile;
+    std::string continuousStem;
+    uint64_t continuousSamples = 0;
+
+    // Archive thread only: the files on disk, oldest first
+    struct File {
+        std::wstring path;
+        uint64_t bytes;
+    };
+    std::deque<File> files;
+    uint64_t directoryBytes = 0;
+    uint64_t sequence = 0;
+
+    std::atomic<uint64_t> segmentsWritten{0};
+    std::atomic<uint64_t> segmentsDropped{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> bytesPruned{0};
+    std::atomic<uint64_t> filesPruned{0};
+    std::atomic<uint64_t> diskBytes{0};
+};
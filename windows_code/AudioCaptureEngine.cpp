@@ -1,17 +1,125 @@
 #include "AudioCaptureEngine.h"
 #include "AsyncWhisperQueue.h"
 #include "SileroVAD.h"
+#include "AudioRingBuffer.h"
+#include "AudioResampler.h"
+#include "AudioSource.h"
+#include "EchoSuppressor.h"
+#include "KeywordSpotter.h"
+#include "SpeakerTracker.h"
+#include "MappedFile.h"
+#include "CpuBudget.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "PipelineLatency.h"
+#include "StartupTimeline.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include "UtteranceTracer.h"
+#include "Watchdog.h"
 #include <iostream>
 #include <chrono>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <avrt.h>
+#include <functiondiscoverykeys_devpkey.h>
 
 // Include whisper.cpp header
 #include "whisper.h"
+#include "ggml-backend.h"
 
 // Link required Windows audio libraries
 #pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "avrt.lib")
+
+// ============================================================================
+// Device Notifications
+// ============================================================================
+
+// Marks the microphone endpoints stale. WASAPI calls in on its own threads
+// and must not be blocked, so this only sets the flag; the processing thread
+// reopens the endpoints between batches
+class EndpointNotifier : public IMMNotificationClient {
+public:
+    explicit EndpointNotifier(std::atomic<bool>& changed) : refCount(1), changed(changed) {}
+
+    ULONG STDMETHODCALLTYPE AddRef() override {
+        return static_cast<ULONG>(InterlockedIncrement(&refCount));
+    }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = static_cast<ULONG>(InterlockedDecrement(&refCount));
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override {
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IMMNotificationClient)) {
+            *object = static_cast<IMMNotificationClient*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR, DWORD) override {
+        changed.store(true);
+        return S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR) override {
+        changed.store(true);
+        return S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR) override {
+        changed.store(true);
+        return S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR) override {
+        if (flow == eCapture && role == eConsole) {
+            changed.store(true);
+        }
+        return S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override {
+        return S_OK;
+    }
+
+private:
+    ~EndpointNotifier() = default;
+
+    LONG refCount;
+    std::atomic<bool>& changed;
+};
+
+namespace {
+
+// Friendly name of a capture device ("Microphone (USB Speakerphone)"), UTF-8
+std::string EndpointName(IMMDevice* device) {
+    std::string name = "microphone";
+    IPropertyStore* properties = nullptr;
+    if (FAILED(device->OpenPropertyStore(STGM_READ, &properties))) {
+        return name;
+    }
+    PROPVARIANT value;
+    PropVariantInit(&value);
+    if (SUCCEEDED(properties->GetValue(PKEY_Device_FriendlyName, &value)) && value.vt == VT_LPWSTR) {
+        int bytes = WideCharToMultiByte(CP_UTF8, 0, value.pwszVal, -1, nullptr, 0, nullptr, nullptr);
+        if (bytes > 1) {
+            name.resize(bytes - 1);
+            WideCharToMultiByte(CP_UTF8, 0, value.pwszVal, -1, &name[0], bytes, nullptr, nullptr);
+        }
+    }
+    PropVariantClear(&value);
+    properties->Release();
+    return name;
+}
+
+}  // namespace
 
 // ============================================================================
 // Constructor / Destructor
@@ -19,17 +127,58 @@
 
 AudioCaptureEngine::AudioCaptureEngine()
     : deviceEnumerator(nullptr)
-    , microphoneDevice(nullptr)
     , systemAudioDevice(nullptr)
-    , microphoneClient(nullptr)
     , systemAudioClient(nullptr)
-    , microphoneCaptureClient(nullptr)
     , systemAudioCaptureClient(nullptr)
+    , selectedMicrophone(0)
+    , multiEndpointCapture(false)
+    , endpointsChanged(false)
+    , endpointNotifier(nullptr)
+    , systemAudioReadyEvent(nullptr)
+    , systemAudioEventDriven(false)
+    , lowLatencyCapture(true)
+    , systemAudioResampler(std::make_unique<AudioResampler>())
+    , echoSuppressor(std::make_unique<EchoSuppressor>())
+    , echoSuppressorFed(true)
     , whisperContext(nullptr)
+    , whisperFastContext(nullptr)
+    , whisperBackend(WhisperBackend::Auto)
+    , whisperGpu(-1)
+    , whisperDevice("CPU")
+    , whisperModelBytes(0)
+    , whisperFastModelBytes(0)
+    , whisperThreadsPerWorker(0)
+    , preferFastWhisper(false)
+    , whisperThreadCap(0)
+    , vadTickMs(10)
+    , memoryReporterId(0)
+    , keywordGate(KeywordGate::Off)
+    , keywordGatedUtterances(0)
+    , denoiseAvoidedUtterances(0)
     , useSimpleVAD(true)
     , vadThreshold(0.0001f)  // Very low threshold for testing
     , isRunning(false)
+    , streamingEnabled(true)
+    , echoSuppressionEnabled(true)
+    , vadGateEnabled(true)
+    , replayMode(false)
+    , watchdogGroup("voice")
+    , segmentingFrames(false)
+    , queuedUtterances(0)
+    , microphoneRing(std::make_unique<AudioRingBuffer>(MAX_BUFFER_SAMPLES))
+    , systemAudioRing(std::make_unique<AudioRingBuffer>(MAX_BUFFER_SAMPLES))
+    , latestUserSpeaker(-1)
+    , latestUserTraceId(0)
+    , metrics{}
 {
+    microphoneLane.name = "microphone";
+    microphoneLane.systemAudio = false;
+    microphoneLane.ring = microphoneRing.get();
+    systemAudioLane.name = "system audio";
+    systemAudioLane.systemAudio = true;
+    systemAudioLane.ring = systemAudioRing.get();
+    microphoneLane.denoiseEnabled.store(true);    // Loopback is the playback itself: nothing to remove
+
     // Initialize COM
     CoInitializeEx(nullptr, COINIT_MULTITHREADED);
 
@@ -37,22 +186,34 @@ AudioCaptureEngine::AudioCaptureEngine()
 }
 
 AudioCaptureEngine::~AudioCaptureEngine() {
+    if (memoryReporterId) {
+        MemoryAccounting::Instance().Unregister(memoryReporterId);
+    }
     Stop();
 
-    // Cleanup whisper
-    if (whisperContext) {
-        whisper_free(whisperContext);
-        whisperContext = nullptr;
-    }
+    // Join the whisper workers first: they call back into this engine and use the contexts
+    asyncWhisperQueue.reset();
+
+    // Cleanup whisper (freed with the last engine sharing the models)
+    whisperContext = nullptr;
+    whisperFastContext = nullptr;
+    whisperModel.reset();
+    whisperFastModel.reset();
 
-    // Cleanup WASAPI
-    if (microphoneCaptureClient) microphoneCaptureClient->Release();
+    // Cleanup WASAPI (no notification may arrive once the notifier is gone)
+    if (endpointNotifier) {
+        deviceEnumerator->UnregisterEndpointNotificationCallback(endpointNotifier);
+        endpointNotifier->Release();
+    }
+    for (auto& endpoint : microphones) {
+        CloseEndpoint(*endpoint);
+    }
+    microphones.clear();
     if (systemAudioCaptureClient) systemAudioCaptureClient->Release();
-    if (microphoneClient) microphoneClient->Release();
     if (systemAudioClient) systemAudioClient->Release();
-    if (microphoneDevice) microphoneDevice->Release();
     if (systemAudioDevice) systemAudioDevice->Release();
     if (deviceEnumerator) deviceEnumerator->Release();
+    if (systemAudioReadyEvent) CloseHandle(systemAudioReadyEvent);
 
     CoUninitialize();
 
@@ -66,60 +227,403 @@ AudioCaptureEngine::~AudioCaptureEngine() {
 bool AudioCaptureEngine::Initialize(const std::string& modelPath) {
     LogDebug("Initializing AudioCaptureEngine...");
 
-    // 1. Initialize Whisper
-    if (!InitializeWhisper(modelPath)) {
-        LogError("Failed to initialize Whisper");
+    // 1-2. Whisper + Silero VAD
+    if (!InitializeInference(modelPath)) {
         return false;
     }
 
-    // 2. Initialize Silero VAD
-    sileroVAD = std::make_unique<SileroVAD>();
-    std::wstring vadModelPath = L"models/vad/silero_vad.onnx";
-    if (sileroVAD->Initialize(vadModelPath)) {
-        LogDebug("Silero VAD initialized successfully");
-        useSimpleVAD = false;  // Use neural VAD
-    } else {
-        LogDebug("Silero VAD failed, falling back to energy-based VAD");
-        useSimpleVAD = true;  // Fall back to energy-based
+    // 3. Initialize Microphone
+    {
+        StartupTimeline::Span span("microphone_open");
+        if (!InitializeMicrophoneCapture()) {
+            LogError("Failed to initialize microphone capture");
+            return false;
+        }
     }
 
-    // 3. Initialize Microphone
+    // 4. Initialize System Audio (optional - may fail if no audio playing)
+    // We'll make this non-critical for now
+    {
+        StartupTimeline::Span span("loopback_open");
+        if (!InitializeSystemAudioCapture()) {
+            LogDebug("System audio capture not available (non-critical)");
+        } else {
+            InitializeSystemAudioVAD();
+        }
+    }
+
+    LogDebug("AudioCaptureEngine initialized successfully");
+    return true;
+}
+
+bool AudioCaptureEngine::InitializeReplay(const std::string& modelPath) {
+    LogDebug("Initializing AudioCaptureEngine for offline replay...");
+
+    if (!InitializeInference(modelPath)) {
+        return false;
+    }
+    replayMode = true;
+
+    LogDebug("AudioCaptureEngine initialized (replay, no capture devices)");
+    return true;
+}
+
+bool AudioCaptureEngine::InitializeWithSource(const std::string& modelPath, std::unique_ptr<AudioSource> source) {
+    LogDebug(std::string("Initializing AudioCaptureEngine on the ") + source->Name() + " source...");
+
+    if (!InitializeInference(modelPath)) {
+        return false;
+    }
+    InitializeSystemAudioVAD();
+    audioSource = std::move(source);
+    replayMode = true;
+
+    LogDebug("AudioCaptureEngine initialized (no capture devices of its own)");
+    return true;
+}
+
+bool AudioCaptureEngine::IsSourceFinished() const {
+    return audioSource && audioSource->IsFinished() && IsReplayIdle();
+}
+
+bool AudioCaptureEngine::InitializeShared(const AudioCaptureEngine& owner, const char* group) {
+    LogDebug("Initializing AudioCaptureEngine on shared whisper models...");
+
+    if (!owner.whisperModel && !owner.outOfProcessWhisper) {
+        LogError("Shared whisper models are not loaded");
+        return false;
+    }
+    watchdogGroup = group;
+    outOfProcessWhisper = owner.outOfProcessWhisper;
+    whisperProcessModels = owner.whisperProcessModels;
+    whisperModel = owner.whisperModel;
+    whisperFastModel = owner.whisperFastModel;
+    whisperContext = whisperModel.get();
+    whisperFastContext = whisperFastModel.get();
+    whisperGpu = owner.whisperGpu;
+    whisperDevice = owner.whisperDevice;
+    vadModelPath = owner.vadModelPath;
+    segmenterConfig = owner.GetSegmenterConfig();
+    preferFastWhisper.store(owner.preferFastWhisper.load());
+    whisperThreadCap.store(owner.whisperThreadCap.load());
+    vadTickMs.store(owner.vadTickMs.load());
+    // whisperModelBytes stay 0: the owner reports the weights
+
+    // Keyword spotting and speaker ids stay with the owner: a session pays
+    // for its VAD states and one whisper worker, nothing else
+    if (!CreateWhisperQueue(SHARED_WHISPER_WORKERS) || !InitializeLaneModels(false)) {
+        return false;
+    }
+    InitializeSystemAudioVAD();
+    replayMode = true;
+
+    LogDebug("AudioCaptureEngine initialized (shared models, fed by FeedAudio)");
+    return true;
+}
+
+bool AudioCaptureEngine::InitializeCaptureOnly(CaptureSink sink) {
+    LogDebug("Initializing AudioCaptureEngine for capture only...");
+
+    captureSink = std::move(sink);
     if (!InitializeMicrophoneCapture()) {
         LogError("Failed to initialize microphone capture");
         return false;
     }
-
-    // 4. Initialize System Audio (optional - may fail if no audio playing)
-    // We'll make this non-critical for now
     if (!InitializeSystemAudioCapture()) {
         LogDebug("System audio capture not available (non-critical)");
     }
 
-    LogDebug("AudioCaptureEngine initialized successfully");
+    LogDebug("AudioCaptureEngine initialized (capture only, no inference)");
     return true;
 }
 
-bool AudioCaptureEngine::InitializeWhisper(const std::string& modelPath) {
+bool AudioCaptureEngine::InitializeInference(const std::string& modelPath) {
+    // Whisper
+    if (!InitializeWhisper(modelPath)) {
+        LogError("Failed to initialize Whisper");
+        return false;
+    }
+    return InitializeLaneModels(true);
+}
+
+bool AudioCaptureEngine::InitializeLaneModels(bool extras) {
+    // Silero VAD
+    sileroVAD = std::make_unique<SileroVAD>();
+    {
+        StartupTimeline::Span span("silero_session");
+        if (sileroVAD->Initialize(vadModelPath)) {
+            LogDebug("Silero VAD initialized successfully");
+            useSimpleVAD = false;  // Use neural VAD
+            microphoneLane.vad = sileroVAD.get();
+        } else {
+            LogDebug("Silero VAD failed, falling back to energy-based VAD");
+            useSimpleVAD = true;  // Fall back to energy-based
+        }
+    }
+
+    // Keyword spotting is optional: only when a model is installed
+    std::error_code ec;
+    if (extras && std::filesystem::exists(KWS_MODEL_PATH, ec)) {
+        keywordSpotter = std::make_unique<KeywordSpotter>();
+        if (keywordSpotter->Initialize(KWS_MODEL_PATH, KWS_LABELS_PATH)) {
+            LogDebug("Keyword spotting enabled (" + std::to_string(keywordSpotter->GetKeywordCount()) + " classes)");
+        } else {
+            LogError("Keyword spotting model failed to load; continuing without it");
+            keywordSpotter.reset();
+        }
+    }
+
+    // Noise suppression model, optional: without it the lanes' denoisers
+    // estimate the noise themselves. One session per lane (recurrent state)
+    if (std::filesystem::exists(DENOISE_MODEL_PATH, ec)) {
+        for (SpeechLane* lane : { &microphoneLane, &systemAudioLane }) {
+            if (!lane->denoiser.LoadModel(DENOISE_MODEL_PATH)) {
+                LogError(std::string("Noise suppression model failed to load for ") + lane->name +
+                         "; using the estimator");
+            }
+        }
+        if (microphoneLane.denoiser.HasModel()) {
+            LogDebug("Noise suppression model loaded");
+        }
+    }
+
+    // Speaker ids, likewise optional
+    if (extras && std::filesystem::exists(SPEAKER_MODEL_PATH, ec)) {
+        speakerTracker = std::make_unique<SpeakerTracker>();
+        if (speakerTracker->Initialize(SPEAKER_MODEL_PATH)) {
+            LogDebug("Speaker tracking enabled");
+        } else {
+            LogError("Speaker embedding model failed to load; continuing without it");
+            speakerTracker.reset();
+        }
+    }
+
+    RegisterMemoryReporter();
+    return true;
+}
+
+void AudioCaptureEngine::InitializeSystemAudioVAD() {
+    // Silero is stateful (LSTM), so interleaving two streams through one
+    // session would blur both; the loopback lane gets its own
+    if (useSimpleVAD) {
+        return;
+    }
+    systemAudioVAD = std::make_unique<SileroVAD>();
+    if (systemAudioVAD->Initialize(vadModelPath)) {
+        systemAudioLane.vad = systemAudioVAD.get();
+        LogDebug("System audio VAD initialized");
+    } else {
+        LogDebug("System audio VAD failed, using energy-based VAD for loopback");
+        systemAudioVAD.reset();
+    }
+}
+
+void AudioCaptureEngine::RegisterMemoryReporter() {
+    if (memoryReporterId) {
+        return;
+    }
+    // Everything read here is fixed once inference is initialized, or locked
+    // by the queue's own accessor
+    memoryReporterId = MemoryAccounting::Instance().Register([this](MemoryAccounting::Entries& entries) {
+        if (whisperModelBytes) {
+            entries.push_back({ "whisper_model", "primary", whisperModelBytes });
+        }
+        if (whisperFastContext && whisperFastModelBytes) {
+            entries.push_back({ "whisper_model", "fast", whisperFastModelBytes });
+        }
+        if (asyncWhisperQueue) {
+            AsyncWhisperQueue::MemoryUsage usage = asyncWhisperQueue->GetMemoryUsage();
+            entries.push_back({ "whisper_state", "workers", usage.stateBytes });
+            entries.push_back({ "whisper_queue", "queued", usage.queuedBytes });
+            entries.push_back({ "whisper_queue", "free_list", usage.freeBufferBytes });
+            entries.push_back({ "whisper_queue", "partial", usage.partialBytes });
+        }
+        if (sileroVAD && sileroVAD->IsInitialized()) {
+            entries.push_back({ "ort_session", "silero_vad", sileroVAD->GetSessionBytes() });
+        }
+        if (systemAudioVAD && systemAudioVAD->IsInitialized()) {
+            entries.push_back({ "ort_session", "silero_vad_loopback", systemAudioVAD->GetSessionBytes() });
+        }
+        if (keywordSpotter) {
+            entries.push_back({ "ort_session", "keyword_spotter", keywordSpotter->GetSessionBytes() });
+        }
+        if (speakerTracker) {
+            entries.push_back({ "ort_session", "speaker_tracker", speakerTracker->GetSessionBytes() });
+        }
+        if (microphoneLane.denoiser.HasModel()) {
+            entries.push_back({ "ort_session", "denoise", microphoneLane.denoiser.GetSessionBytes() });
+        }
+        if (systemAudioLane.denoiser.HasModel()) {
+            entries.push_back({ "ort_session", "denoise_loopback", systemAudioLane.denoiser.GetSessionBytes() });
+        }
+        entries.push_back({ "audio_ring", "microphone", microphoneRing->Capacity() * sizeof(float) });
+        {
+            std::lock_guard<std::mutex> lock(endpointMutex);
+            for (const auto& endpoint : microphones) {
+                entries.push_back({ "audio_ring", endpoint->name, endpoint->ring->Capacity() * sizeof(float) });
+            }
+        }
+        entries.push_back({ "audio_ring", "system", systemAudioRing->Capacity() * sizeof(float) });
+        entries.push_back({ "echo_suppressor", "history", echoSuppressor->GetMemoryBytes() });
+    });
+}
+
+whisper_context* AudioCaptureEngine::LoadWhisperModel(const std::string& modelPath, uint64_t& modelBytes) {
     LogDebug("Loading Whisper model: " + modelPath);
 
     // Initialize whisper context parameters
     struct whisper_context_params cparams = whisper_context_default_params();
-    cparams.use_gpu = false; // CPU-only for now
+    cparams.use_gpu = whisperGpu >= 0;
+    cparams.gpu_device = (std::max)(whisperGpu, 0);
+
+    // Load model from a read-only mapping: the file comes out of the shared page
+    // cache instead of buffered reads (whisper copies tensors into its own
+    // buffers, so the view is only needed during init)
+    whisper_context* context = nullptr;
+    MemoryAccounting::Meter meter;
+    MappedFile modelFile;
+    if (modelFile.Open(modelPath)) {
+        context = whisper_init_from_buffer_with_params(const_cast<void*>(modelFile.Data()),
+                                                       modelFile.Size(), cparams);
+        modelFile.Close();
+    }
+    if (!context) {
+        context = whisper_init_from_file_with_params(modelPath.c_str(), cparams);
+    }
+    modelBytes = context ? meter.Bytes() : 0;
+    return context;
+}
+
+bool AudioCaptureEngine::ParseWhisperBackend(const std::string& name, WhisperBackend& backend) {
+    if (name == "auto") {
+        backend = WhisperBackend::Auto;
+    } else if (name == "cpu") {
+        backend = WhisperBackend::Cpu;
+    } else if (name == "gpu") {
+        backend = WhisperBackend::Gpu;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int AudioCaptureEngine::SelectWhisperGpu() {
+    whisperDevice = "CPU";
+    if (whisperBackend == WhisperBackend::Cpu) {
+        return -1;
+    }
+
+    // Devices registered by the linked ggml build; whisper numbers the GPUs
+    // among themselves (cparams.gpu_device). With several (iGPU + dGPU) the
+    // one with the most memory wins
+    int selected = -1;
+    int gpuIndex = 0;
+    size_t selectedBytes = 0;
+    for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
+        ggml_backend_dev_t device = ggml_backend_dev_get(i);
+        enum ggml_backend_dev_type type = ggml_backend_dev_type(device);
+        if (type == GGML_BACKEND_DEVICE_TYPE_ACCEL) {
+            LogDebug(std::string("ggml accelerator available: ") + ggml_backend_dev_name(device));
+            continue;
+        }
+        if (type != GGML_BACKEND_DEVICE_TYPE_GPU) {
+            continue;
+        }
+        size_t freeBytes = 0;
+        size_t totalBytes = 0;
+        ggml_backend_dev_memory(device, &freeBytes, &totalBytes);
+        LogDebug("ggml GPU " + std::to_string(gpuIndex) + ": " + ggml_backend_dev_description(device) +
+                 " (" + std::to_string(totalBytes >> 20) + " MB)");
+        if (selected < 0 || totalBytes > selectedBytes) {
+            selected = gpuIndex;
+            selectedBytes = totalBytes;
+            whisperDevice = std::string(ggml_backend_dev_name(device)) + " - " + ggml_backend_dev_description(device);
+        }
+        gpuIndex++;
+    }
 
-    // Load model
-    whisperContext = whisper_init_from_file_with_params(modelPath.c_str(), cparams);
+    if (selected < 0 && whisperBackend == WhisperBackend::Gpu) {
+        LogError("No GPU in this ggml build; whisper runs on the CPU");
+    }
+    return selected;
+}
 
+bool AudioCaptureEngine::InitializeWhisper(const std::string& modelPath) {
+    StartupTimeline::Span span("whisper_load");
+    whisperGpu = SelectWhisperGpu();
+    if (outOfProcessWhisper) {
+        // The worker processes load the tiers; a missing fast tier is theirs to fail on
+        whisperProcessModels = { modelPath };
+        std::error_code ec;
+        if (!fastModelPath.empty() && std::filesystem::exists(fastModelPath, ec)) {
+            whisperProcessModels.push_back(fastModelPath);
+        }
+        return CreateWhisperQueue(WHISPER_PROCESS_WORKERS);
+    }
+    whisperContext = LoadWhisperModel(modelPath, whisperModelBytes);
+    if (!whisperContext && whisperGpu >= 0) {
+        // Out of device memory, driver trouble: the CPU always works
+        LogError("Failed to load Whisper on " + whisperDevice + ", retrying on the CPU");
+        whisperGpu = -1;
+        whisperDevice = "CPU";
+        whisperContext = LoadWhisperModel(modelPath, whisperModelBytes);
+    }
     if (!whisperContext) {
         LogError("Failed to load Whisper model from: " + modelPath);
         return false;
     }
 
-    LogDebug("Whisper model loaded successfully");
+    LogDebug("Whisper model loaded successfully on " + whisperDevice);
+    whisperModel.reset(whisperContext, whisper_free);
+
+    // The fast tier is optional: without it every utterance goes to the primary
+    if (!fastModelPath.empty()) {
+        whisperFastContext = LoadWhisperModel(fastModelPath, whisperFastModelBytes);
+        if (whisperFastContext) {
+            whisperFastModel.reset(whisperFastContext, whisper_free);
+            LogDebug("Fast whisper tier loaded: " + fastModelPath);
+        } else {
+            LogError("Failed to load fast whisper model (single tier): " + fastModelPath);
+        }
+    }
+
+    return CreateWhisperQueue(WHISPER_WORKERS);
+}
+
+bool AudioCaptureEngine::CreateWhisperQueue(int workers) {
+    std::vector<whisper_context*> models = { whisperContext };
+    if (whisperFastContext) {
+        models.push_back(whisperFastContext);
+    }
 
     // Create async whisper queue
     try {
-        asyncWhisperQueue = std::make_unique<AsyncWhisperQueue>(whisperContext);
-        LogDebug("Async whisper queue created");
+        // Split whisper's CPU budget between workers so parallel utterances don't oversubscribe;
+        // offloaded, the workers barely use the CPU and leave it to capture and vision
+        int whisperThreads = CpuBudget::Instance().Get(CpuBudget::Subsystem::Whisper).threads;
+        int threadsPerWorker = (std::max)(1, whisperThreads / WHISPER_WORKERS);
+        if (whisperGpu >= 0) {
+            threadsPerWorker = (std::min)(threadsPerWorker, WHISPER_GPU_THREADS);
+        }
+
+        if (outOfProcessWhisper) {
+            WhisperProcess::Options remote;
+            remote.modelPaths = whisperProcessModels;
+            remote.gpu = whisperGpu;
+            asyncWhisperQueue = std::make_unique<AsyncWhisperQueue>(remote, workers, threadsPerWorker, 8,
+                                                                    AsyncWhisperQueue::OverflowPolicy::MergeAdjacent,
+                                                                    watchdogGroup);
+        } else {
+            asyncWhisperQueue = std::make_unique<AsyncWhisperQueue>(models, workers, threadsPerWorker, 8,
+                                                                    AsyncWhisperQueue::OverflowPolicy::MergeAdjacent,
+                                                                    watchdogGroup);
+        }
+        asyncWhisperQueue->SetResultReadyCallback([this]() { DeliverResults(); });
+        asyncWhisperQueue->SetMarginalVadConfidence(MARGINAL_VAD_CONFIDENCE);
+        whisperThreadsPerWorker = threadsPerWorker;
+        ApplyWhisperThreadCap();
+        LogDebug("Async whisper queue created (" + std::to_string(asyncWhisperQueue->GetWorkerCount()) +
+                 " workers x " + std::to_string(threadsPerWorker) + " threads)");
     } catch (const std::exception& e) {
         LogError("Failed to create async whisper queue: " + std::string(e.what()));
         return false;
@@ -128,6 +632,52 @@ bool AudioCaptureEngine::InitializeWhisper(const std::string& modelPath) {
     return true;
 }
 
+void AudioCaptureEngine::SetPowerSettings(const PowerSettings& settings) {
+    preferFastWhisper.store(settings.preferFastWhisper);
+    whisperThreadCap.store((std::max)(0, settings.whisperThreadCap));
+    vadTickMs.store((std::max)(1, (std::min)(settings.vadTickMs, VAD_MAX_TICK_MS)));
+    ApplyWhisperThreadCap();
+    LogDebug(std::string("Power settings: ") + (settings.preferFastWhisper ? "fast" : "primary") +
+             " whisper tier, thread cap " + std::to_string(settings.whisperThreadCap) +
+             ", VAD tick " + std::to_string(vadTickMs.load()) + "ms");
+}
+
+void AudioCaptureEngine::ApplyWhisperThreadCap() {
+    if (!asyncWhisperQueue || whisperThreadsPerWorker <= 0) {
+        return;
+    }
+    int cap = whisperThreadCap.load();
+    asyncWhisperQueue->SetThreadsPerWorker(cap > 0 ? (std::min)(cap, whisperThreadsPerWorker)
+                                                   : whisperThreadsPerWorker);
+}
+
+size_t AudioCaptureEngine::SelectWhisperModel(size_t samples, bool background) {
+    if (!asyncWhisperQueue || asyncWhisperQueue->GetModelCount() < 2) {
+        return 0;
+    }
+    // Power saving: the fast tier for everything, however long
+    if (preferFastWhisper.load()) {
+        return 1;
+    }
+    if (samples > static_cast<size_t>(WHISPER_SHORT_UTTERANCE_SEC * SAMPLE_RATE)) {
+        return 0;
+    }
+
+    // Queue already backing up: the primary can't keep up regardless of length
+    AsyncWhisperQueue::Lane lane = background ? AsyncWhisperQueue::Lane::Background
+                                              : AsyncWhisperQueue::Lane::Primary;
+    if (asyncWhisperQueue->GetQueueSize(lane) >= WHISPER_BACKLOG_DEPTH) {
+        return 1;
+    }
+
+    // Predict the primary's latency for this utterance from its running cost per
+    // audio second (last overall latency until it has history)
+    float seconds = (std::max)(1.0f, static_cast<float>(samples) / SAMPLE_RATE);
+    float msPerSecond = asyncWhisperQueue->GetModelMsPerAudioSecond(0);
+    float predictedMs = msPerSecond > 0.0f ? msPerSecond * seconds : asyncWhisperQueue->GetLastLatencyMs();
+    return predictedMs > WHISPER_LATENCY_SLO_MS ? 1 : 0;
+}
+
 bool AudioCaptureEngine::InitializeMicrophoneCapture() {
     LogDebug("Initializing microphone capture...");
 
@@ -147,78 +697,211 @@ bool AudioCaptureEngine::InitializeMicrophoneCapture() {
         return false;
     }
 
-    // Get default microphone device
-    hr = deviceEnumerator->GetDefaultAudioEndpoint(
-        eCapture,
-        eConsole,
-        &microphoneDevice
-    );
+    // Arrivals, removals and default changes reopen the endpoints. Not for a
+    // capture-only engine: there is no processing thread to do it, and its
+    // sink takes the one stream it started with
+    if (!captureSink) {
+        endpointNotifier = new EndpointNotifier(endpointsChanged);
+        hr = deviceEnumerator->RegisterEndpointNotificationCallback(endpointNotifier);
+        if (FAILED(hr)) {
+            LogDebug("Device change notifications unavailable (non-critical)");
+            endpointNotifier->Release();
+            endpointNotifier = nullptr;
+        }
+    }
 
-    if (FAILED(hr)) {
-        LogError("Failed to get default microphone");
+    if (!RefreshEndpoints()) {
+        LogError("Failed to open a microphone");
         return false;
     }
 
-    // Activate audio client
-    hr = microphoneDevice->Activate(
-        __uuidof(IAudioClient),
-        CLSCTX_ALL,
-        nullptr,
-        (void**)&microphoneClient
-    );
+    LogDebug("Microphone capture initialized successfully");
+    return true;
+}
 
-    if (FAILED(hr)) {
-        LogError("Failed to activate microphone audio client");
-        return false;
+bool AudioCaptureEngine::RefreshEndpoints() {
+    // Wanted: the default capture device first, then (multi-endpoint) every other active one
+    std::vector<IMMDevice*> devices;
+    std::vector<std::wstring> ids;
+    auto want = [&](IMMDevice* device) {
+        LPWSTR id = nullptr;
+        if (SUCCEEDED(device->GetId(&id))) {
+            std::wstring deviceId(id);
+            CoTaskMemFree(id);
+            if (std::find(ids.begin(), ids.end(), deviceId) == ids.end()) {
+                ids.push_back(deviceId);
+                devices.push_back(device);
+                return;
+            }
+        }
+        device->Release();
+    };
+
+    IMMDevice* defaultDevice = nullptr;
+    if (SUCCEEDED(deviceEnumerator->GetDefaultAudioEndpoint(eCapture, eConsole, &defaultDevice))) {
+        want(defaultDevice);
+    } else {
+        LogError("Failed to get default microphone");
+    }
+    if (multiEndpointCapture && !captureSink) {
+        IMMDeviceCollection* collection = nullptr;
+        if (SUCCEEDED(deviceEnumerator->EnumAudioEndpoints(eCapture, DEVICE_STATE_ACTIVE, &collection))) {
+            UINT count = 0;
+            collection->GetCount(&count);
+            for (UINT i = 0; i < count && devices.size() < MAX_CAPTURE_ENDPOINTS; ++i) {
+                IMMDevice* device = nullptr;
+                if (SUCCEEDED(collection->Item(i, &device))) {
+                    want(device);
+                }
+            }
+            collection->Release();
+        }
     }
 
-    // Get mix format (use device's native format)
-    WAVEFORMATEX* pwfx = nullptr;
-    hr = microphoneClient->GetMixFormat(&pwfx);
-    if (FAILED(hr)) {
-        LogError("Failed to get mix format");
-        return false;
+    // Endpoints still wanted (and still capturing) stay as they are; the
+    // rest close, and new devices open (and start, if the engine runs)
+    const std::wstring selectedId = selectedMicrophone < microphones.size() ? microphones[selectedMicrophone]->id
+                                                                            : std::wstring();
+    std::vector<std::unique_ptr<CaptureEndpoint>> next;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        auto existing = std::find_if(microphones.begin(), microphones.end(),
+                                     [&](const std::unique_ptr<CaptureEndpoint>& endpoint) {
+                                         return endpoint && endpoint->id == ids[i] && !endpoint->failed.load();
+                                     });
+        if (existing != microphones.end()) {
+            next.push_back(std::move(*existing));
+        } else if (std::unique_ptr<CaptureEndpoint> endpoint = OpenEndpoint(devices[i], ids[i])) {
+            if (isRunning.load() && !StartEndpoint(*endpoint)) {
+                CloseEndpoint(*endpoint);
+            } else {
+                LogDebug("Microphone endpoint opened: " + endpoint->name);
+                next.push_back(std::move(endpoint));
+            }
+        }
+        devices[i]->Release();
+    }
+    for (auto& endpoint : microphones) {
+        if (endpoint) {
+            LogDebug("Microphone endpoint closed: " + endpoint->name);
+            CloseEndpoint(*endpoint);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(endpointMutex);
+        microphones.swap(next);
     }
 
-    LogDebug("Device format: " + std::to_string(pwfx->nSamplesPerSec) + "Hz, " +
-             std::to_string(pwfx->nChannels) + " channels");
+    // Stay on the selected device if it is still there, else take the default
+    size_t selected = 0;
+    for (size_t i = 0; i < microphones.size(); ++i) {
+        if (microphones[i]->id == selectedId) {
+            selected = i;
+        }
+    }
+    if (microphones.empty() || microphones[selected]->id != selectedId) {
+        SelectMicrophone(selected);
+    } else {
+        selectedMicrophone = selected;
+    }
 
-    // Initialize audio client with device's native format (shared mode requirement)
-    REFERENCE_TIME requestedDuration = 10000000; // 1 second
-    hr = microphoneClient->Initialize(
-        AUDCLNT_SHAREMODE_SHARED,
-        0,
-        requestedDuration,
-        0,
-        pwfx,
-        nullptr
-    );
+    LogDebug("Capturing " + std::to_string(microphones.size()) + " microphone endpoint(s)");
+    return !microphones.empty();
+}
 
-    // Store format for later conversion
-    deviceFormat = *pwfx;
-    CoTaskMemFree(pwfx);
+std::unique_ptr<AudioCaptureEngine::CaptureEndpoint> AudioCaptureEngine::OpenEndpoint(IMMDevice* device,
+                                                                                       const std::wstring& id) {
+    const size_t VAD_WINDOW_SAMPLES = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000;
+
+    auto endpoint = std::make_unique<CaptureEndpoint>();
+    endpoint->id = id;
+    endpoint->name = EndpointName(device);
+    endpoint->device = device;
+    device->AddRef();
+    endpoint->resampler = std::make_unique<AudioResampler>();
+    endpoint->ring = std::make_unique<AudioRingBuffer>(MAX_BUFFER_SAMPLES);
+    endpoint->batch.resize(VAD_WINDOW_SAMPLES * VAD_MAX_BATCH_FRAMES);
+    endpoint->candidates.resize(VAD_MAX_BATCH_FRAMES);
+
+    // Buffer-ready event, signalled by WASAPI each device period
+    endpoint->readyEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+    if (!InitializeCaptureClient(device, &endpoint->client, 0,
+                                 endpoint->readyEvent, &endpoint->format, endpoint->eventDriven)) {
+        LogError("Failed to initialize audio client for " + endpoint->name);
+        CloseEndpoint(*endpoint);
+        return nullptr;
+    }
 
-    if (FAILED(hr)) {
-        LogError("Failed to initialize microphone audio client (HRESULT: 0x" +
-                 std::to_string(hr) + ")");
-        return false;
+    const WAVEFORMATEX& format = endpoint->format.Format;
+    LogDebug(endpoint->name + " format: " + std::to_string(format.nSamplesPerSec) + "Hz, " +
+             std::to_string(format.nChannels) + " channels, " +
+             std::to_string(format.wBitsPerSample) + "-bit (" +
+             (endpoint->eventDriven ? "event-driven" : "polling") + ")");
+
+    if (!ConfigureResampler(*endpoint->resampler, endpoint->format)) {
+        LogError("Unsupported sample format on " + endpoint->name);
+        CloseEndpoint(*endpoint);
+        return nullptr;
     }
 
     // Get capture client
-    hr = microphoneClient->GetService(
+    HRESULT hr = endpoint->client->GetService(
         __uuidof(IAudioCaptureClient),
-        (void**)&microphoneCaptureClient
+        (void**)&endpoint->captureClient
     );
 
     if (FAILED(hr)) {
-        LogError("Failed to get microphone capture client");
-        return false;
+        LogError("Failed to get capture client for " + endpoint->name);
+        CloseEndpoint(*endpoint);
+        return nullptr;
     }
+    return endpoint;
+}
 
-    LogDebug("Microphone capture initialized successfully");
+bool AudioCaptureEngine::StartEndpoint(CaptureEndpoint& endpoint) {
+    HRESULT hr = endpoint.client->Start();
+    if (FAILED(hr)) {
+        LogError("Failed to start capture on " + endpoint.name);
+        return false;
+    }
+    endpoint.failed.store(false);
+    endpoint.capturing.store(true);
+    endpoint.thread = std::make_unique<std::thread>(&AudioCaptureEngine::EndpointCaptureThread, this, &endpoint);
     return true;
 }
 
+void AudioCaptureEngine::CloseEndpoint(CaptureEndpoint& endpoint) {
+    endpoint.capturing.store(false);
+    if (endpoint.thread && endpoint.thread->joinable()) {
+        endpoint.thread->join();
+    }
+    endpoint.thread.reset();
+    if (endpoint.client) {
+        endpoint.client->Stop();
+    }
+    if (endpoint.captureClient) {
+        endpoint.captureClient->Release();
+        endpoint.captureClient = nullptr;
+    }
+    if (endpoint.client) {
+        endpoint.client->Release();
+        endpoint.client = nullptr;
+    }
+    if (endpoint.device) {
+        endpoint.device->Release();
+        endpoint.device = nullptr;
+    }
+    if (endpoint.readyEvent) {
+        CloseHandle(endpoint.readyEvent);
+        endpoint.readyEvent = nullptr;
+    }
+}
+
+size_t AudioCaptureEngine::GetCaptureEndpointCount() const {
+    std::lock_guard<std::mutex> lock(endpointMutex);
+    return microphones.size();
+}
+
 bool AudioCaptureEngine::InitializeSystemAudioCapture() {
     LogDebug("Initializing system audio capture (loopback)...");
 
@@ -236,58 +919,209 @@ bool AudioCaptureEngine::InitializeSystemAudioCapture() {
         return false;
     }
 
-    // Activate audio client
-    hr = systemAudioDevice->Activate(
-        __uuidof(IAudioClient),
-        CLSCTX_ALL,
-        nullptr,
-        (void**)&systemAudioClient
-    );
+    // Initialize in loopback mode
+    systemAudioReadyEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
 
-    if (FAILED(hr)) {
-        LogError("Failed to activate system audio client");
+    WAVEFORMATEXTENSIBLE loopbackFormat = {};
+    if (!InitializeCaptureClient(systemAudioDevice, &systemAudioClient, AUDCLNT_STREAMFLAGS_LOOPBACK,
+                                 systemAudioReadyEvent, &loopbackFormat, systemAudioEventDriven)) {
+        LogError("Failed to initialize system audio client in loopback mode");
         return false;
     }
 
-    // Get mix format
-    WAVEFORMATEX* pwfx = nullptr;
-    hr = systemAudioClient->GetMixFormat(&pwfx);
-    if (FAILED(hr)) {
-        LogError("Failed to get system audio mix format");
+    // Loopback runs at the render device's mix format, which may differ from the mic
+    if (!ConfigureResampler(*systemAudioResampler, loopbackFormat)) {
+        LogError("Unsupported system audio sample format");
         return false;
     }
 
-    // Initialize in loopback mode
-    REFERENCE_TIME requestedDuration = 10000000; // 1 second
-    hr = systemAudioClient->Initialize(
-        AUDCLNT_SHAREMODE_SHARED,
-        AUDCLNT_STREAMFLAGS_LOOPBACK, // Loopback mode
-        requestedDuration,
-        0,
-        pwfx,
-        nullptr
+    // Get capture client
+    hr = systemAudioClient->GetService(
+        __uuidof(IAudioCaptureClient),
+        (void**)&systemAudioCaptureClient
     );
 
-    CoTaskMemFree(pwfx);
-
     if (FAILED(hr)) {
-        LogError("Failed to initialize system audio client in loopback mode");
+        LogError("Failed to get system audio capture client");
         return false;
     }
 
-    // Get capture client
-    hr = systemAudioClient->GetService(
-        __uuidof(IAudioCaptureClient),
-        (void**)&systemAudioCaptureClient
-    );
+    LogDebug("System audio capture initialized successfully");
+    return true;
+}
+
+bool AudioCaptureEngine::InitializeCaptureClient(IMMDevice* device,
+                                                 IAudioClient** client,
+                                                 DWORD streamFlags,
+                                                 HANDLE readyEvent,
+                                                 WAVEFORMATEXTENSIBLE* formatOut,
+                                                 bool& eventDriven) {
+    eventDriven = false;
+
+    // Smallest shared-mode period first: a microphone packet every few ms
+    // instead of every 10 ms (loopback has no low-latency mode)
+    if (lowLatencyCapture && readyEvent && !(streamFlags & AUDCLNT_STREAMFLAGS_LOOPBACK)) {
+        UINT32 periodFrames = 0;
+        if (InitializeLowLatencyClient(device, client, readyEvent, formatOut, periodFrames)) {
+            eventDriven = true;
+            LogDebug("Low-latency shared stream: " + std::to_string(periodFrames) + " frame period (" +
+                     std::to_string(periodFrames * 1000.0 / formatOut->Format.nSamplesPerSec) + "ms)");
+            return true;
+        }
+    }
+
+    // Try event-driven first, then plain polling if the endpoint rejects it
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool wantEvents = (attempt == 0) && readyEvent != nullptr;
+
+        if (*client) {
+            (*client)->Release();
+            *client = nullptr;
+        }
+
+        HRESULT hr = device->Activate(
+            __uuidof(IAudioClient),
+            CLSCTX_ALL,
+            nullptr,
+            (void**)client
+        );
+
+        if (FAILED(hr)) {
+            LogError("Failed to activate audio client");
+            return false;
+        }
+
+        // Get mix format (use device's native format)
+        WAVEFORMATEX* pwfx = nullptr;
+        hr = (*client)->GetMixFormat(&pwfx);
+        if (FAILED(hr)) {
+            LogError("Failed to get mix format");
+            return false;
+        }
+
+        // Initialize audio client with device's native format (shared mode requirement)
+        REFERENCE_TIME requestedDuration = 10000000; // 1 second
+        DWORD flags = streamFlags | (wantEvents ? AUDCLNT_STREAMFLAGS_EVENTCALLBACK : 0);
+        hr = (*client)->Initialize(
+            AUDCLNT_SHAREMODE_SHARED,
+            flags,
+            requestedDuration,
+            0,
+            pwfx,
+            nullptr
+        );
 
+        // Store format for later conversion; the EXTENSIBLE tail (subformat,
+        // valid bits) follows the base struct when cbSize says it is there
+        *formatOut = {};
+        size_t formatBytes = sizeof(WAVEFORMATEX) + pwfx->cbSize;
+        std::memcpy(formatOut, pwfx, (std::min)(formatBytes, sizeof(WAVEFORMATEXTENSIBLE)));
+        CoTaskMemFree(pwfx);
+
+        if (SUCCEEDED(hr) && wantEvents) {
+            hr = (*client)->SetEventHandle(readyEvent);
+        }
+
+        if (SUCCEEDED(hr)) {
+            eventDriven = wantEvents;
+            return true;
+        }
+
+        LogDebug("Audio client initialization failed (HRESULT: " + std::to_string(hr) + ")" +
+                 (wantEvents ? ", retrying without event callback" : ""));
+    }
+
+    return false;
+}
+
+bool AudioCaptureEngine::InitializeLowLatencyClient(IMMDevice* device,
+                                                    IAudioClient** client,
+                                                    HANDLE readyEvent,
+                                                    WAVEFORMATEXTENSIBLE* formatOut,
+                                                    UINT32& periodFrames) {
+    if (*client) {
+        (*client)->Release();
+        *client = nullptr;
+    }
+
+    // IAudioClient3 (Windows 10+): engine periods below the 10 ms default,
+    // when the driver reports a smaller minimum for the mix format
+    IAudioClient3* client3 = nullptr;
+    HRESULT hr = device->Activate(__uuidof(IAudioClient3), CLSCTX_ALL, nullptr, (void**)&client3);
     if (FAILED(hr)) {
-        LogError("Failed to get system audio capture client");
+        LogDebug("IAudioClient3 unavailable, using the default period");
         return false;
     }
 
-    LogDebug("System audio capture initialized successfully");
-    return true;
+    WAVEFORMATEX* pwfx = nullptr;
+    hr = client3->GetMixFormat(&pwfx);
+    if (FAILED(hr)) {
+        client3->Release();
+        return false;
+    }
+
+    UINT32 defaultPeriod = 0;
+    UINT32 fundamentalPeriod = 0;
+    UINT32 minPeriod = 0;
+    UINT32 maxPeriod = 0;
+    hr = client3->GetSharedModeEnginePeriod(pwfx, &defaultPeriod, &fundamentalPeriod, &minPeriod, &maxPeriod);
+    if (SUCCEEDED(hr) && minPeriod > 0 && minPeriod < defaultPeriod) {
+        hr = client3->InitializeSharedAudioStream(AUDCLNT_STREAMFLAGS_EVENTCALLBACK, minPeriod, pwfx, nullptr);
+    } else if (SUCCEEDED(hr)) {
+        LogDebug("Device offers no period below the default (" + std::to_string(defaultPeriod) + " frames)");
+        hr = E_FAIL;
+    }
+    if (SUCCEEDED(hr)) {
+        hr = client3->SetEventHandle(readyEvent);
+    }
+
+    if (SUCCEEDED(hr)) {
+        *formatOut = {};
+        size_t formatBytes = sizeof(WAVEFORMATEX) + pwfx->cbSize;
+        std::memcpy(formatOut, pwfx, (std::min)(formatBytes, sizeof(WAVEFORMATEXTENSIBLE)));
+        periodFrames = minPeriod;
+        *client = client3;      // IAudioClient3 is an IAudioClient
+    } else {
+        LogDebug("Low-latency stream initialization failed (HRESULT: " + std::to_string(hr) + ")");
+        client3->Release();
+    }
+    CoTaskMemFree(pwfx);
+    return SUCCEEDED(hr);
+}
+
+bool AudioCaptureEngine::ConfigureResampler(AudioResampler& resampler, const WAVEFORMATEXTENSIBLE& format) {
+    const WAVEFORMATEX& base = format.Format;
+
+    // EXTENSIBLE carries the real tag in its subformat GUID, whose first field
+    // is the WAVE_FORMAT_* value (KSDATAFORMAT_SUBTYPE_PCM / _IEEE_FLOAT)
+    WORD tag = base.wFormatTag;
+    if (tag == WAVE_FORMAT_EXTENSIBLE) {
+        tag = base.cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)
+            ? static_cast<WORD>(format.SubFormat.Data1) : 0;
+    }
+
+    // By container size: 24 valid bits in a 32-bit container are left-justified,
+    // so they convert as int32
+    AudioResampler::SampleFormat sampleFormat = AudioResampler::SampleFormat::Unsupported;
+    if (tag == WAVE_FORMAT_IEEE_FLOAT && base.wBitsPerSample == 32) {
+        sampleFormat = AudioResampler::SampleFormat::Float32;
+    } else if (tag == WAVE_FORMAT_PCM) {
+        switch (base.wBitsPerSample) {
+            case 16: sampleFormat = AudioResampler::SampleFormat::Int16; break;
+            case 24: sampleFormat = AudioResampler::SampleFormat::Int24; break;
+            case 32: sampleFormat = AudioResampler::SampleFormat::Int32; break;
+            default: break;
+        }
+    }
+    if (sampleFormat == AudioResampler::SampleFormat::Unsupported ||
+        base.nBlockAlign != AudioResampler::BytesPerSample(sampleFormat) * base.nChannels) {
+        LogError("Unsupported sample format: tag " + std::to_string(tag) + ", " +
+                 std::to_string(base.wBitsPerSample) + "-bit, block " + std::to_string(base.nBlockAlign));
+        return false;
+    }
+
+    return resampler.Configure(static_cast<int>(base.nSamplesPerSec), SAMPLE_RATE,
+                               base.nChannels, sampleFormat);
 }
 
 // ============================================================================
@@ -302,36 +1136,73 @@ bool AudioCaptureEngine::Start() {
 
     LogDebug("Starting AudioCaptureEngine...");
 
-    // Start microphone capture
-    HRESULT hr = microphoneClient->Start();
-    if (FAILED(hr)) {
+    if (replayMode) {
+        isRunning.store(true);
+        processingThreadPtr = std::make_unique<std::thread>(&AudioCaptureEngine::ProcessingThread, this);
+        if (audioSource && !audioSource->Start([this](bool systemAudio, const float* samples, size_t count) {
+                return FeedAudio(systemAudio, samples, count);
+            })) {
+            LogError(std::string("Failed to start the ") + audioSource->Name() + " source");
+            isRunning.store(false);
+            processingThreadPtr->join();
+            return false;
+        }
+        LogDebug("AudioCaptureEngine started (replay)");
+        return true;
+    }
+
+    // Start microphone capture: each endpoint runs its own thread; the
+    // engine runs while at least one of them does
+    isRunning.store(true);
+    size_t started = 0;
+    for (auto& endpoint : microphones) {
+        if (StartEndpoint(*endpoint)) {
+            ++started;
+        } else {
+            endpoint->failed.store(true);
+        }
+    }
+    if (started == 0) {
+        isRunning.store(false);
         LogError("Failed to start microphone capture");
         return false;
     }
 
     // Start system audio capture (if available)
     if (systemAudioClient) {
-        hr = systemAudioClient->Start();
+        HRESULT hr = systemAudioClient->Start();
         if (FAILED(hr)) {
             LogDebug("Failed to start system audio capture (non-critical)");
         }
     }
 
-    // Start threads
-    isRunning.store(true);
-
-    micThreadPtr = std::make_unique<std::thread>(&AudioCaptureEngine::MicrophoneCaptureThread, this);
-
     if (systemAudioClient) {
         systemAudioThreadPtr = std::make_unique<std::thread>(&AudioCaptureEngine::SystemAudioCaptureThread, this);
     }
 
-    processingThreadPtr = std::make_unique<std::thread>(&AudioCaptureEngine::ProcessingThread, this);
+    // Capture only: the sink's owner transcribes elsewhere
+    if (!captureSink) {
+        processingThreadPtr = std::make_unique<std::thread>(&AudioCaptureEngine::ProcessingThread, this);
+    }
 
     LogDebug("AudioCaptureEngine started successfully");
     return true;
 }
 
+void AudioCaptureEngine::CancelTranscriptions() {
+    if (asyncWhisperQueue) {
+        asyncWhisperQueue->Cancel();
+    }
+}
+
+bool AudioCaptureEngine::IsWarm() const {
+    return asyncWhisperQueue && asyncWhisperQueue->IsWarm();
+}
+
+bool AudioCaptureEngine::WaitUntilWarm() {
+    return asyncWhisperQueue && asyncWhisperQueue->WaitUntilWarm();
+}
+
 void AudioCaptureEngine::Stop() {
     if (!isRunning.load()) {
         return;
@@ -339,25 +1210,31 @@ void AudioCaptureEngine::Stop() {
 
     LogDebug("Stopping AudioCaptureEngine...");
 
-    // Signal threads to stop
+    // Nothing more comes in, then signal threads to stop
+    if (audioSource) {
+        audioSource->Stop();
+    }
     isRunning.store(false);
 
-    // Wait for threads to finish
-    if (micThreadPtr && micThreadPtr->joinable()) {
-        micThreadPtr->join();
+    // Wait for threads to finish; processing first, it may be reopening endpoints
+    if (processingThreadPtr && processingThreadPtr->joinable()) {
+        processingThreadPtr->join();
     }
 
-    if (systemAudioThreadPtr && systemAudioThreadPtr->joinable()) {
-        systemAudioThreadPtr->join();
+    for (auto& endpoint : microphones) {
+        endpoint->capturing.store(false);
+        if (endpoint->thread && endpoint->thread->joinable()) {
+            endpoint->thread->join();
+        }
     }
 
-    if (processingThreadPtr && processingThreadPtr->joinable()) {
-        processingThreadPtr->join();
+    if (systemAudioThreadPtr && systemAudioThreadPtr->joinable()) {
+        systemAudioThreadPtr->join();
     }
 
     // Stop WASAPI clients
-    if (microphoneClient) {
-        microphoneClient->Stop();
+    for (auto& endpoint : microphones) {
+        endpoint->client->Stop();
     }
 
     if (systemAudioClient) {
@@ -371,78 +1248,82 @@ void AudioCaptureEngine::Stop() {
 // Capture Threads
 // ============================================================================
 
-void AudioCaptureEngine::MicrophoneCaptureThread() {
-    LogDebug("Microphone capture thread started");
-
-    while (isRunning.load()) {
-        UINT32 packetLength = 0;
-        HRESULT hr = microphoneCaptureClient->GetNextPacketSize(&packetLength);
-
-        if (FAILED(hr)) {
-            LogError("Failed to get packet size");
-            break;
-        }
-
-        while (packetLength != 0) {
-            BYTE* pData = nullptr;
-            UINT32 numFramesAvailable = 0;
-            DWORD flags = 0;
-
-            hr = microphoneCaptureClient->GetBuffer(
-                &pData,
-                &numFramesAvailable,
-                &flags,
-                nullptr,
-                nullptr
-            );
+void AudioCaptureEngine::EndpointCaptureThread(CaptureEndpoint* endpoint) {
+    LogDebug("Microphone capture thread started: " + endpoint->name);
+    RunCaptureLoop(endpoint->captureClient,
+                   endpoint->eventDriven ? endpoint->readyEvent : nullptr,
+                   *endpoint->resampler, endpoint, endpoint->name.c_str());
+    LogDebug("Microphone capture thread stopped: " + endpoint->name);
+}
 
-            if (FAILED(hr)) {
-                LogError("Failed to get buffer");
-                break;
-            }
+void AudioCaptureEngine::SystemAudioCaptureThread() {
+    LogDebug("System audio capture thread started");
+    RunCaptureLoop(systemAudioCaptureClient,
+                   systemAudioEventDriven ? systemAudioReadyEvent : nullptr,
+                   *systemAudioResampler, nullptr, "system audio");
+    LogDebug("System audio capture thread stopped");
+}
 
-            // Convert PCM to float and add to buffer
-            if (!(flags & AUDCLNT_BUFFERFLAGS_SILENT)) {
-                std::vector<float> audioData = ConvertPCMToFloat(pData, numFramesAvailable);
-                AddMicrophoneData(audioData);
-            }
+void AudioCaptureEngine::RunCaptureLoop(IAudioCaptureClient* captureClient,
+                                        HANDLE readyEvent,
+                                        AudioResampler& resampler,
+                                        CaptureEndpoint* endpoint,
+                                        const char* streamName) {
+    const bool isMicrophone = endpoint != nullptr;
+
+    // Budget first (core mask), then MMCSS, which owns the priority from here on
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Capture);
+    TRACE_THREAD(isMicrophone ? "Microphone capture" : "System audio capture");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Capture);
+    Watchdog::Heartbeat heartbeat(isMicrophone ? "microphone_capture" : "system_capture", watchdogGroup, CAPTURE_STALL_MS);
+
+    // Register with MMCSS so capture is scheduled promptly under CPU load
+    DWORD taskIndex = 0;
+    HANDLE mmcssHandle = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+    if (!mmcssHandle) {
+        taskIndex = 0;
+        mmcssHandle = AvSetMmThreadCharacteristicsW(L"Audio", &taskIndex);
+    }
+    if (!mmcssHandle) {
+        LogDebug(std::string("MMCSS registration failed for ") + streamName + " capture (non-critical)");
+    }
 
-            hr = microphoneCaptureClient->ReleaseBuffer(numFramesAvailable);
-            if (FAILED(hr)) {
-                LogError("Failed to release buffer");
-                break;
+    // 16kHz mono output, reused for every packet; only grows if a packet exceeds it
+    std::vector<float> converted(resampler.MaxOutputFrames(SAMPLE_RATE));
+    // Microphones turn silent packets into zeros: endpoints are read in step,
+    // so one must not fall behind the others for being muted
+    std::vector<BYTE> silence;
+
+    while (isRunning.load() && (!endpoint || endpoint->capturing.load())) {
+        heartbeat.Beat();
+        if (readyEvent) {
+            // Sleep until WASAPI signals a full period; the timeout only bounds Stop() latency
+            DWORD waitResult = WaitForSingleObject(readyEvent, CAPTURE_WAIT_TIMEOUT_MS);
+            if (waitResult == WAIT_TIMEOUT) {
+                continue;
             }
-
-            hr = microphoneCaptureClient->GetNextPacketSize(&packetLength);
-            if (FAILED(hr)) {
+            if (waitResult != WAIT_OBJECT_0) {
+                LogError(std::string("Failed waiting for ") + streamName + " buffer event");
                 break;
             }
         }
 
-        Sleep(10); // Sleep 10ms between checks
-    }
-
-    LogDebug("Microphone capture thread stopped");
-}
-
-void AudioCaptureEngine::SystemAudioCaptureThread() {
-    LogDebug("System audio capture thread started");
-
-    while (isRunning.load()) {
         UINT32 packetLength = 0;
-        HRESULT hr = systemAudioCaptureClient->GetNextPacketSize(&packetLength);
+        HRESULT hr = captureClient->GetNextPacketSize(&packetLength);
 
         if (FAILED(hr)) {
-            LogError("Failed to get system audio packet size");
+            LogError(std::string("Failed to get ") + streamName + " packet size");
             break;
         }
 
         while (packetLength != 0) {
+            TRACE_ZONE("Capture packet");
             BYTE* pData = nullptr;
             UINT32 numFramesAvailable = 0;
             DWORD flags = 0;
 
-            hr = systemAudioCaptureClient->GetBuffer(
+            auto packetStart = std::chrono::steady_clock::now();
+            hr = captureClient->GetBuffer(
                 &pData,
                 &numFramesAvailable,
                 &flags,
@@ -451,32 +1332,66 @@ void AudioCaptureEngine::SystemAudioCaptureThread() {
             );
 
             if (FAILED(hr)) {
-                LogError("Failed to get system audio buffer");
+                LogError(std::string("Failed to get ") + streamName + " buffer");
                 break;
             }
 
-            // Convert and add to buffer
+            if (endpoint) {
+                endpoint->lastPacketMs.store(GetTickCount64());
+                if (flags & AUDCLNT_BUFFERFLAGS_SILENT) {
+                    silence.assign(static_cast<size_t>(numFramesAvailable) * endpoint->format.Format.nBlockAlign, 0);
+                    pData = silence.data();
+                    flags &= ~AUDCLNT_BUFFERFLAGS_SILENT;
+                }
+            }
+
+            // Convert PCM to 16kHz mono float and add to buffer
             if (!(flags & AUDCLNT_BUFFERFLAGS_SILENT)) {
-                std::vector<float> audioData = ConvertPCMToFloat(pData, numFramesAvailable);
-                AddSystemAudioData(audioData);
+                size_t needed = resampler.MaxOutputFrames(numFramesAvailable);
+                if (converted.size() < needed) {
+                    converted.resize(needed);
+                }
+
+                auto resampleStart = std::chrono::steady_clock::now();
+                size_t count = resampler.Process(pData, numFramesAvailable, converted.data(), converted.size());
+                PipelineLatency::Record(PipelineLatency::Stage::Resample, std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - resampleStart).count());
+                if (isMicrophone) {
+                    AddMicrophoneData(*endpoint, converted.data(), count);
+                } else {
+                    AddSystemAudioData(converted.data(), count);
+                }
             }
 
-            hr = systemAudioCaptureClient->ReleaseBuffer(numFramesAvailable);
+            hr = captureClient->ReleaseBuffer(numFramesAvailable);
             if (FAILED(hr)) {
-                LogError("Failed to release system audio buffer");
+                LogError(std::string("Failed to release ") + streamName + " buffer");
                 break;
             }
+            PipelineLatency::Record(PipelineLatency::Stage::Capture, std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - packetStart).count());
 
-            hr = systemAudioCaptureClient->GetNextPacketSize(&packetLength);
+            hr = captureClient->GetNextPacketSize(&packetLength);
             if (FAILED(hr)) {
                 break;
             }
         }
 
-        Sleep(10);
+        if (!readyEvent) {
+            Sleep(10); // Polling fallback: sleep 10ms between checks
+        }
+    }
+
+    // A device that failed under a running engine (unplugged, invalidated)
+    // is reopened or dropped by the processing thread
+    if (endpoint && isRunning.load() && endpoint->capturing.load()) {
+        endpoint->failed.store(true);
+        endpointsChanged.store(true);
     }
 
-    LogDebug("System audio capture thread stopped");
+    if (mmcssHandle) {
+        AvRevertMmThreadCharacteristics(mmcssHandle);
+    }
 }
 
 // ============================================================================
@@ -485,431 +1400,1040 @@ void AudioCaptureEngine::SystemAudioCaptureThread() {
 
 void AudioCaptureEngine::ProcessingThread() {
     LogDebug("Processing thread started with speech segmentation");
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vad);
+    TRACE_THREAD("Audio processing");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Processing);
+    Watchdog::Heartbeat heartbeat("audio_processing", watchdogGroup, PROCESSING_STALL_MS);
+
+    const size_t VAD_WINDOW_SAMPLES = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000; // 32ms windows
+
+    SegmenterConfig config = GetSegmenterConfig();
+    LogDebug("Speech segmentation: min=" + std::to_string(config.minSpeechMs) + "ms, " +
+             "pause=" + std::to_string(config.silenceThresholdMs) + "ms (" +
+             std::to_string(config.turnMinSilenceMs) + "-" + std::to_string(config.turnMaxSilenceMs) + "ms by turn), " +
+             "max=" + std::to_string(config.maxSpeechSec) + "s, " +
+             "pre-roll=" + std::to_string(config.preRollMs) + "ms, " +
+             "on/off=" + std::to_string(config.speechOnThreshold) + "/" + std::to_string(config.speechOffThreshold) + ", " +
+             "chunks=" + std::to_string(config.chunkMinSec) + "-" + std::to_string(config.chunkMaxSec) + "s");
+
+    // Lane buffers are sized once (for the largest configurable values); the
+    // speech buffers come back recycled from the queue
+    for (SpeechLane* lane : { &microphoneLane, &systemAudioLane }) {
+        lane->batch.resize(VAD_WINDOW_SAMPLES * VAD_MAX_BATCH_FRAMES);
+        lane->scores.resize(VAD_MAX_BATCH_FRAMES);
+        lane->candidates.resize(VAD_MAX_BATCH_FRAMES);
+        lane->rawCandidates.resize(VAD_MAX_BATCH_FRAMES);
+        lane->warmup.resize(VadGate::WARMUP_FRAMES * VadGate::FRAME_SAMPLES);
+        lane->preRoll.assign((static_cast<size_t>(SAMPLE_RATE) * MAX_PRE_ROLL_MS) / 1000, 0.0f);
+        lane->preRollWrite = 0;
+        lane->preRollFill = 0;
+        lane->speechBuffer.reserve(static_cast<size_t>(SAMPLE_RATE) * (MAX_SPEECH_SEC_LIMIT + 1));
+        lane->frameScores.reserve(static_cast<size_t>(SAMPLE_RATE) * (MAX_SPEECH_SEC_LIMIT + 1) / VAD_WINDOW_SAMPLES);
+        // Whisper's mel pass happens here, as the speech arrives (bands of the primary model)
+        lane->mel.Configure(whisperContext ? whisper_model_n_mels(whisperContext) : 0);
+
+        // Silero's first run allocates ORT's buffers; take it on a silent
+        // frame now instead of on the first frame of real audio
+        if (lane->vad) {
+            std::fill(lane->batch.begin(), lane->batch.begin() + VAD_WINDOW_SAMPLES, 0.0f);
+            lane->vad->ProcessBatch(lane->batch.data(), 1, lane->scores.data());
+            lane->vad->Reset();
+        }
+    }
 
-    // Speech segmentation parameters
-    const int VAD_WINDOW_SAMPLES = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000; // 30ms windows
-    const int SILENCE_THRESHOLD_MS = 300;  // 300ms of silence = end of utterance (reduced for lower latency)
-    const int MIN_SPEECH_MS = 300;         // Minimum 300ms of speech to transcribe
-    const int MAX_SPEECH_SEC = 30;         // Maximum 30 seconds per utterance
+    // Endpoint refreshes activate WASAPI clients from this thread
+    if (!replayMode) {
+        CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    }
 
-    const int SILENCE_THRESHOLD_SAMPLES = (SAMPLE_RATE * SILENCE_THRESHOLD_MS) / 1000;
-    const int MIN_SPEECH_SAMPLES = (SAMPLE_RATE * MIN_SPEECH_MS) / 1000;
-    const int MAX_SPEECH_SAMPLES = SAMPLE_RATE * MAX_SPEECH_SEC;
+    while (isRunning.load()) {
+        heartbeat.Beat();
+        if (deviceEnumerator && endpointsChanged.exchange(false)) {
+            RefreshEndpoints();
+        }
+        if (MicrophoneSamplesAvailable() < VAD_WINDOW_SAMPLES &&
+            systemAudioRing->Available() < VAD_WINDOW_SAMPLES) {
+            Sleep(vadTickMs.load());
+            continue;
+        }
 
-    // State machine
-    enum SpeechState { SILENCE, SPEAKING };
-    SpeechState currentState = SILENCE;
+        // Each ring's read cursor is its lane's VAD cursor: every frame is
+        // consumed and classified exactly once, in order, however many arrived
+        // since the last tick. A backlog (e.g. after a stall) is classified in
+        // batches of up to VAD_MAX_BATCH_FRAMES frames per VAD call, the lanes
+        // taking turns so a loopback backlog can't delay the microphone by more
+        // than one batch. The loopback batch goes first: it is the echo
+        // reference for the microphone batch that follows.
+        segmentingFrames.store(true);   // Before the ring read, for IsReplayIdle()
+        while (isRunning.load()) {
+            heartbeat.Beat("VAD batch");
+            bool systemAudioBatch = SegmentNextBatch(systemAudioLane);
+            bool microphoneBatch = SegmentNextBatch(microphoneLane);
+            if (!microphoneBatch && !systemAudioBatch) {
+                break;
+            }
+        }
+        segmentingFrames.store(false);
 
-    std::vector<float> speechBuffer;
-    size_t silenceDurationSamples = 0;
-    size_t speechDurationSamples = 0;
+        Sleep(vadTickMs.load());    // VAD_TICK_MS unless a power profile stretches it
+    }
 
-    LogDebug("Speech segmentation: min=" + std::to_string(MIN_SPEECH_MS) + "ms, " +
-             "pause=" + std::to_string(SILENCE_THRESHOLD_MS) + "ms, " +
-             "max=" + std::to_string(MAX_SPEECH_SEC) + "s");
+    if (systemAudioLane.silentFramesSkipped > 0) {
+        LogDebug("System audio silence fast-path skipped " +
+                 std::to_string(systemAudioLane.silentFramesSkipped) + " VAD frames");
+    }
+    for (const SpeechLane* lane : { &microphoneLane, &systemAudioLane }) {
+        VadGate::Stats gate = lane->gate.GetStats();
+        if (lane->vad && gate.frames > 0) {
+            LogDebug(std::string("VAD gate (") + lane->name + "): Silero ran on " +
+                     std::to_string(gate.candidates) + " of " + std::to_string(gate.frames) +
+                     " gated frames, noise floor " + std::to_string(static_cast<int>(gate.noiseFloorDb)) + " dBFS");
+        }
+    }
+    if (asyncWhisperQueue &&
+        (asyncWhisperQueue->GetRejectedSegmentCount() > 0 || asyncWhisperQueue->GetMarginalSkippedCount() > 0)) {
+        LogDebug("Whisper filter rejected " + std::to_string(asyncWhisperQueue->GetRejectedSegmentCount()) +
+                 " hallucinated segments; " + std::to_string(asyncWhisperQueue->GetMarginalSkippedCount()) +
+                 " marginal utterances gave way to speech");
+    }
+    if (keywordGatedUtterances.load() > 0) {
+        LogDebug("Keyword gate kept " + std::to_string(keywordGatedUtterances.load()) +
+                 " utterances from whisper");
+    }
+    for (const SpeechLane* lane : { &microphoneLane, &systemAudioLane }) {
+        const NoiseSuppressor::Stats& denoise = lane->denoiser.GetStats();
+        if (denoise.blocks > 0) {
+            LogDebug(std::string("Noise suppression (") + lane->name + "): " + std::to_string(denoise.blocks) +
+                     " blocks, " + std::to_string(denoise.modelBlocks) + " by the model, attenuation " +
+                     std::to_string(static_cast<int>(denoise.attenuationDb)) + " dB");
+        }
+    }
+    for (const SpeechLane* lane : { &microphoneLane, &systemAudioLane }) {
+        const TurnDetector::Stats& turns = lane->turn.GetStats();
+        if (turns.closedEarly + turns.closedLate + turns.bridged > 0) {
+            LogDebug(std::string("End of turn (") + lane->name + "): " + std::to_string(turns.closedEarly) +
+                     " closed early, " + std::to_string(turns.closedLate) + " held open, " +
+                     std::to_string(turns.bridged) + " pauses bridged");
+        }
+    }
+    if (denoiseAvoidedUtterances.load() > 0) {
+        LogDebug("Noise suppression avoided an estimated " + std::to_string(denoiseAvoidedUtterances.load()) +
+                 " whisper runs");
+    }
+    const EchoSuppressor::Stats& echoStats = echoSuppressor->GetStats();
+    if (echoStats.framesProcessed > 0) {
+        LogDebug("Echo suppression: " + std::to_string(echoStats.framesProcessed) + " frames with playback, " +
+                 std::to_string(echoStats.framesSuppressed) + " suppressed, " +
+                 std::to_string(echoStats.framesDoubleTalk) + " double talk, delay " +
+                 std::to_string(static_cast<int>(echoStats.delayMs)) + "ms, ERLE " +
+                 std::to_string(static_cast<int>(echoStats.erleDb)) + "dB");
+    }
+    if (!replayMode) {
+        CoUninitialize();
+    }
+    LogDebug("Processing thread stopped");
+}
 
-    while (isRunning.load()) {
-        // Get current buffer snapshot
-        std::vector<float> micBuffer = GetMicrophoneBuffer();
+bool AudioCaptureEngine::SegmentNextBatch(SpeechLane& lane) {
+    const size_t VAD_WINDOW_SAMPLES = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000;
+    const SegmenterConfig config = GetSegmenterConfig();
+    const size_t MAX_SPEECH_SAMPLES = static_cast<size_t>(SAMPLE_RATE) * config.maxSpeechSec;
+    const size_t CHUNK_MAX_SAMPLES = static_cast<size_t>(SAMPLE_RATE) * config.chunkMaxSec;
+    const size_t PRE_ROLL_SAMPLES = (static_cast<size_t>(SAMPLE_RATE) * config.preRollMs) / 1000 /
+                                    VAD_WINDOW_SAMPLES * VAD_WINDOW_SAMPLES;
+    const size_t STREAMING_INTERVAL_SAMPLES = (static_cast<size_t>(SAMPLE_RATE) * STREAMING_INTERVAL_MS) / 1000;
+    const size_t KWS_HOP_SAMPLES = (static_cast<size_t>(SAMPLE_RATE) * KWS_HOP_MS) / 1000;
+    const bool spotKeywords = keywordSpotter && !lane.systemAudio;
+
+    size_t framesReady = (std::min)((lane.systemAudio ? lane.ring->Available() : MicrophoneSamplesAvailable()) /
+                                    VAD_WINDOW_SAMPLES,
+                                    static_cast<size_t>(VAD_MAX_BATCH_FRAMES));
+    if (framesReady == 0) {
+        return false;
+    }
+    TRACE_ZONE("ProcessingThread batch");
+    if (!lane.systemAudio) {
+        TRACE_FRAME("Audio processing");
+        TRACE_COUNTER("VAD batch frames", framesReady);
+    }
 
-        if (micBuffer.empty()) {
-            Sleep(50);
-            continue;
+    size_t samplesWanted = framesReady * VAD_WINDOW_SAMPLES;
+    size_t framesRead = (lane.systemAudio ? ReadSystemAudioSamples(lane.batch.data(), samplesWanted)
+                                          : ReadMicrophoneSamples(lane.batch.data(), samplesWanted)) /
+                        VAD_WINDOW_SAMPLES;
+    if (!lane.systemAudio) {
+        ThreadCpu::Instance().AddAudioSamples(framesRead * VAD_WINDOW_SAMPLES);
+    }
+    if (archive && !lane.systemAudio) {
+        // Raw, before echo suppression and denoising: what the microphone heard
+        archive->WriteContinuous(lane.batch.data(), framesRead * VAD_WINDOW_SAMPLES);
+    }
+
+    // Echo suppression before the VAD: loopback feeds the reference (silent
+    // batches too, they keep the timelines aligned), the microphone is cleaned
+    // in place, so playback picked up by the mic never opens a segment
+    if (!echoSuppressionEnabled.load()) {
+        echoSuppressorFed = false;
+    } else {
+        TRACE_ZONE("EchoSuppressor");
+        if (!echoSuppressorFed) {
+            // Samples went by unseen: the timelines no longer line up
+            echoSuppressor->Reset();
+            echoSuppressorFed = true;
+        }
+        if (lane.systemAudio) {
+            echoSuppressor->AddReference(lane.batch.data(), framesRead * VAD_WINDOW_SAMPLES);
+        } else {
+            echoSuppressor->Process(lane.batch.data(), framesRead * VAD_WINDOW_SAMPLES);
         }
+    }
 
-        // Process in VAD_WINDOW_SAMPLES chunks
-        if (micBuffer.size() < VAD_WINDOW_SAMPLES) {
-            Sleep(10);
-            continue;
+    // Noise suppression, also before the VAD: the raw gate looks first, for
+    // the count of segments the noise alone would have opened
+    const bool denoise = lane.denoiseEnabled.load();
+    if (!denoise) {
+        lane.denoiserFed = false;
+    } else {
+        if (!lane.denoiserFed) {
+            // Samples went by unseen: don't splice them onto the old delay line
+            lane.denoiser.Reset();
+            lane.rawGate.Reset();
+            lane.noiseBurstSamples = 0;
+            lane.noiseBurstGapSamples = 0;
+            lane.denoiserFed = true;
         }
+        lane.rawGate.Classify(lane.batch.data(), framesRead, lane.rawCandidates.data());
+        lane.denoiser.Process(lane.batch.data(), framesRead * VAD_WINDOW_SAMPLES);
+    }
 
-        // Check VAD on latest window
-        std::vector<float> vadWindow(
-            micBuffer.end() - VAD_WINDOW_SAMPLES,
-            micBuffer.end()
-        );
-        bool isSpeech = IsSpeechDetected(vadWindow);
+    // Loopback silence fast-path: quiet playback (muted video, a pause in a
+    // call) never reaches the VAD
+    bool silent = false;
+    if (lane.systemAudio) {
+        float peak = 0.0f;
+        for (size_t i = 0; i < framesRead * VAD_WINDOW_SAMPLES; ++i) {
+            peak = (std::max)(peak, std::fabs(lane.batch[i]));
+        }
+        silent = peak < SYSTEM_AUDIO_SILENCE_PEAK;
+    }
+    if (silent) {
+        std::fill(lane.scores.begin(), lane.scores.begin() + framesRead, 0.0f);
+        lane.silentFramesSkipped += framesRead;
+        lane.vadStale = true;
+        if (!lane.speaking) {
+            lane.preRollFill = 0;   // Silence is not worth prepending
+            return true;
+        }
+    } else {
+        ClassifyFrames(lane, lane.batch.data(), framesRead);
+    }
+
+    // Hysteresis: a frame has to clear the on threshold to start an utterance,
+    // but only the lower off threshold to keep one going
+    const float onThreshold = lane.vad ? config.speechOnThreshold : vadThreshold;
+    const float offThreshold = lane.vad ? config.speechOffThreshold
+                                        : vadThreshold * config.speechOffThreshold / config.speechOnThreshold;
+    if (denoise) {
+        // What the cleaned audio calls noise teaches the raw floor too
+        lane.rawGate.Adapt(lane.scores.data(), framesRead, offThreshold);
+    }
+    if (!lane.systemAudio) {
+        AdaptEndpointGates(lane.scores.data(), framesRead, offThreshold);
+    }
+
+    for (size_t f = 0; f < framesRead && isRunning.load(); ++f) {
+        const float* frame = &lane.batch[f * VAD_WINDOW_SAMPLES];
+        bool isSpeech = lane.scores[f] > (lane.speaking ? offThreshold : onThreshold);
+
+        // Only log significant changes
+        if (isSpeech != lane.lastLoggedSpeech) {
+            LogDebug(std::string(lane.vad ? "Silero VAD (" : "Energy VAD (") + lane.name + "): " +
+                     (isSpeech ? "SPEECH" : "SILENCE") + " (score: " + std::to_string(lane.scores[f]) + ")");
+            lane.lastLoggedSpeech = isSpeech;
+        }
 
-        if (currentState == SILENCE) {
+        if (!lane.speaking) {
+            if (denoise) {
+                TrackNoiseBurst(lane, lane.rawCandidates[f] != 0, isSpeech, config);
+            }
             if (isSpeech) {
-                // Speech started!
-                LogDebug("Speech STARTED");
-                currentState = SPEAKING;
-                speechBuffer.clear();
-                speechBuffer.insert(speechBuffer.end(), micBuffer.begin(), micBuffer.end());
-                speechDurationSamples = micBuffer.size();
-                silenceDurationSamples = 0;
-
-                // Clear processed buffer
-                {
-                    std::lock_guard<std::mutex> lock(micBufferMutex);
-                    microphoneBuffer.clear();
-                }
+                // Speech started! The pre-roll restores the onset the VAD needed
+                // a frame or two to recognize
+                LogDebug(std::string("Speech STARTED (") + lane.name + ")");
+                lane.speaking = true;
+                lane.speechStartTime = std::chrono::steady_clock::now();
+                lane.lastSpeechTime = lane.speechStartTime;
+                lane.speechBuffer.clear();
+                lane.frameScores.clear();
+                lane.mel.Reset();
+                size_t preRollCount = (std::min)(lane.preRollFill, PRE_ROLL_SAMPLES);
+                size_t ringSize = lane.preRoll.size();
+                size_t first = (lane.preRollWrite + ringSize - preRollCount) % ringSize;
+                size_t head = (std::min)(preRollCount, ringSize - first);
+                lane.speechBuffer.insert(lane.speechBuffer.end(), lane.preRoll.begin() + first,
+                                         lane.preRoll.begin() + first + head);
+                lane.speechBuffer.insert(lane.speechBuffer.end(), lane.preRoll.begin(),
+                                         lane.preRoll.begin() + (preRollCount - head));
+                lane.preRollFill = 0;
+                lane.frameScores.assign(lane.speechBuffer.size() / VAD_WINDOW_SAMPLES, 0.0f);
+                lane.speechBuffer.insert(lane.speechBuffer.end(), frame, frame + VAD_WINDOW_SAMPLES);
+                lane.frameScores.push_back(lane.scores[f]);
+                lane.mel.Advance(lane.speechBuffer.data(), lane.speechBuffer.size());
+                lane.speechDurationSamples = VAD_WINDOW_SAMPLES;
+                lane.silenceDurationSamples = 0;
+                lane.turn.Reset();
+                lane.turn.AddFrame(frame, lane.scores[f], true);
+            } else if (PRE_ROLL_SAMPLES > 0) {
+                PushPreRoll(lane, frame, VAD_WINDOW_SAMPLES);
             }
+            continue;
         }
-        else if (currentState == SPEAKING) {
-            if (isSpeech) {
-                // Continue speaking
-                silenceDurationSamples = 0;
-                speechDurationSamples += micBuffer.size();
 
-                // Append new audio to speech buffer
-                speechBuffer.insert(speechBuffer.end(), micBuffer.begin(), micBuffer.end());
+        lane.speechBuffer.insert(lane.speechBuffer.end(), frame, frame + VAD_WINDOW_SAMPLES);
+        lane.frameScores.push_back(lane.scores[f]);
+        lane.mel.Advance(lane.speechBuffer.data(), lane.speechBuffer.size());
+        lane.turn.AddFrame(frame, lane.scores[f], isSpeech);
 
-                // Clear processed buffer
-                {
-                    std::lock_guard<std::mutex> lock(micBufferMutex);
-                    microphoneBuffer.clear();
-                }
+        // Keywords are reported while the utterance is still open
+        if (spotKeywords && lane.speechBuffer.size() - lane.keywordScoredSamples >= KWS_HOP_SAMPLES) {
+            SpotKeywords(lane);
+        }
 
-                // Safety: Max utterance length
-                if (speechBuffer.size() >= MAX_SPEECH_SAMPLES) {
-                    LogDebug("Max utterance length reached, forcing transcription");
-                    goto transcribe_now;
-                }
+        if (isSpeech) {
+            // Continue speaking
+            if (lane.silenceDurationSamples > 0) {
+                lane.turn.NoteResumed(static_cast<int>(lane.silenceDurationSamples * 1000 / SAMPLE_RATE),
+                                      config.silenceThresholdMs);
             }
-            else {
-                // Silence detected during speech
-                silenceDurationSamples += micBuffer.size();
-                speechBuffer.insert(speechBuffer.end(), micBuffer.begin(), micBuffer.end());
-
-                // Clear processed buffer
-                {
-                    std::lock_guard<std::mutex> lock(micBufferMutex);
-                    microphoneBuffer.clear();
-                }
-
-                // Check if silence duration exceeded threshold
-                if (silenceDurationSamples >= SILENCE_THRESHOLD_SAMPLES) {
-                    LogDebug("Speech ENDED (silence detected: " +
-                             std::to_string(silenceDurationSamples * 1000 / SAMPLE_RATE) + "ms)");
-
-transcribe_now:
-                    // Check minimum speech duration
-                    if (speechBuffer.size() >= MIN_SPEECH_SAMPLES) {
-                        LogDebug("Queuing " + std::to_string(speechBuffer.size() / SAMPLE_RATE) +
-                                 "s of speech for async transcription");
-
-                        // Queue for async transcription (non-blocking!)
-                        if (asyncWhisperQueue) {
-                            asyncWhisperQueue->QueueAudio(speechBuffer);
-                        }
-                    }
-                    else {
-                        LogDebug("Speech too short (" +
-                                 std::to_string(speechBuffer.size() * 1000 / SAMPLE_RATE) +
-                                 "ms), ignoring");
-                    }
-
-                    // Reset state
-                    currentState = SILENCE;
-                    speechBuffer.clear();
-                    silenceDurationSamples = 0;
-                    speechDurationSamples = 0;
+            lane.silenceDurationSamples = 0;
+            lane.lastSpeechTime = std::chrono::steady_clock::now();
+            lane.speechDurationSamples += VAD_WINDOW_SAMPLES;
+
+            // Long monologue: queue what we have at its quietest point instead of
+            // waiting for a pause (or the hard cut below)
+            if (CHUNK_MAX_SAMPLES > 0 && lane.speechBuffer.size() >= CHUNK_MAX_SAMPLES) {
+                SplitUtterance(lane, config);
+            }
+            // Safety: Max utterance length
+            else if (lane.speechBuffer.size() >= MAX_SPEECH_SAMPLES) {
+                LogDebug("Max utterance length reached, forcing transcription");
+                FinishUtterance(lane);
+            }
+            // Streaming: refresh the partial hypothesis every interval of new speech
+            else if (!lane.systemAudio && streamingEnabled.load() && asyncWhisperQueue &&
+                     lane.speechBuffer.size() - lane.lastPartialSamples >= STREAMING_INTERVAL_SAMPLES &&
+                     !KeywordGateSkips(lane)) {
+                // The frames so far go along while the window still starts at the utterance's beginning
+                LogMelSpectrogram::Frames* mel = nullptr;
+                if (lane.mel.IsConfigured() && lane.speechBuffer.size() <=
+                        static_cast<size_t>(SAMPLE_RATE) * AsyncWhisperQueue::STREAMING_WINDOW_SEC) {
+                    lane.mel.Copy(lane.speechBuffer.data(), lane.speechBuffer.size(), lane.melFrames);
+                    mel = &lane.melFrames;
                 }
+                asyncWhisperQueue->UpdatePartialAudio(lane.speechBuffer.data(), lane.speechBuffer.size(), mel);
+                lane.lastPartialSamples = lane.speechBuffer.size();
+            }
+        }
+        else {
+            // Silence detected during speech
+            lane.silenceDurationSamples += VAD_WINDOW_SAMPLES;
+
+            // The pause ends the utterance once it outlasts the hangover the
+            // utterance so far calls for (the partial's text helps when streaming)
+            if (!lane.systemAudio && lane.lastPartialSamples > 0 && asyncWhisperQueue) {
+                lane.turn.SetText(asyncWhisperQueue->GetPartialResult());
+            }
+            const int hangoverMs = lane.turn.HangoverMs(config.turnMinSilenceMs, config.silenceThresholdMs,
+                                                        config.turnMaxSilenceMs);
+            if (lane.silenceDurationSamples * 1000 >= static_cast<size_t>(hangoverMs) * SAMPLE_RATE) {
+                LogDebug(std::string("Speech ENDED (") + lane.name + ", silence detected: " +
+                         std::to_string(lane.silenceDurationSamples * 1000 / SAMPLE_RATE) + "ms, end of turn " +
+                         std::to_string(lane.turn.Confidence()) + ")");
+                lane.turn.NoteClosed(hangoverMs, config.silenceThresholdMs);
+                FinishUtterance(lane);
             }
         }
-
-        Sleep(10); // Check every 10ms
     }
+    if (!lane.systemAudio) {
+        std::lock_guard<std::mutex> lock(metricsMutex);
+        metrics.isSpeechDetected = lane.lastLoggedSpeech;
+    }
+    return true;
+}
 
-    LogDebug("Processing thread stopped");
+void AudioCaptureEngine::TrackNoiseBurst(SpeechLane& lane, bool rawCandidate, bool speechStarted,
+                                         const SegmenterConfig& config) {
+    // The same shape the segmenter gives an utterance: at least minSpeechMs
+    // of activity, closed by silenceThresholdMs of none (or cut at maxSpeechSec)
+    const size_t VAD_WINDOW_SAMPLES = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000;
+    const size_t MIN_SPEECH_SAMPLES = (static_cast<size_t>(SAMPLE_RATE) * config.minSpeechMs) / 1000;
+    const size_t SILENCE_THRESHOLD_SAMPLES = (static_cast<size_t>(SAMPLE_RATE) * config.silenceThresholdMs) / 1000;
+    const size_t MAX_SPEECH_SAMPLES = static_cast<size_t>(SAMPLE_RATE) * config.maxSpeechSec;
+
+    if (speechStarted) {
+        // Speech after all: whatever the raw audio had, the utterance is real
+        lane.noiseBurstSamples = 0;
+        lane.noiseBurstGapSamples = 0;
+        return;
+    }
+    if (rawCandidate) {
+        lane.noiseBurstSamples += VAD_WINDOW_SAMPLES;
+        lane.noiseBurstGapSamples = 0;
+    } else if (lane.noiseBurstSamples > 0) {
+        lane.noiseBurstGapSamples += VAD_WINDOW_SAMPLES;
+    }
+    const bool closed = lane.noiseBurstGapSamples >= SILENCE_THRESHOLD_SAMPLES ||
+                        lane.noiseBurstSamples + lane.noiseBurstGapSamples >= MAX_SPEECH_SAMPLES;
+    if (lane.noiseBurstSamples > 0 && closed) {
+        if (lane.noiseBurstSamples >= MIN_SPEECH_SAMPLES) {
+            denoiseAvoidedUtterances++;
+        }
+        lane.noiseBurstSamples = 0;
+        lane.noiseBurstGapSamples = 0;
+    }
 }
 
-// ============================================================================
-// VAD
-// ============================================================================
+void AudioCaptureEngine::FinishUtterance(SpeechLane& lane) {
+    const size_t MIN_SPEECH_SAMPLES = (static_cast<size_t>(SAMPLE_RATE) * GetSegmenterConfig().minSpeechMs) / 1000;
 
-bool AudioCaptureEngine::IsSpeechDetected(const std::vector<float>& audioChunk) {
-    bool isSpeech = false;
+    // The window ending with the utterance (the hangover) hasn't been scored yet
+    if (keywordSpotter && !lane.systemAudio && lane.speechBuffer.size() > lane.keywordScoredSamples) {
+        SpotKeywords(lane);
+    }
 
-    if (!useSimpleVAD && sileroVAD) {
-        // Use Silero VAD (neural network-based)
-        // Silero expects 512 samples (32ms @ 16kHz)
-        const size_t SILERO_CHUNK_SIZE = 512;
+    // Speech frames only: pre-roll and hangover silence don't make a blip long enough
+    if (lane.speechDurationSamples >= MIN_SPEECH_SAMPLES) {
+        LogDebug("Queuing " + std::to_string(lane.speechBuffer.size() / SAMPLE_RATE) + "s of " +
+                 lane.name + " speech for async transcription");
+        QueueSpeech(lane, lane.frameScores.size());
+    }
+    else {
+        LogDebug("Speech too short (" +
+                 std::to_string(lane.speechDurationSamples * 1000 / SAMPLE_RATE) +
+                 "ms), ignoring");
+    }
 
-        // Process in 512-sample chunks
-        float maxProbability = 0.0f;
-        for (size_t i = 0; i + SILERO_CHUNK_SIZE <= audioChunk.size(); i += SILERO_CHUNK_SIZE) {
-            float probability = sileroVAD->Process(&audioChunk[i], SILERO_CHUNK_SIZE);
-            maxProbability = (std::max)(maxProbability, probability);  // Parentheses to avoid Windows max macro
-        }
+    lane.speaking = false;
+    lane.continuation = false;
+    lane.speechBuffer.clear();
+    lane.frameScores.clear();
+    lane.mel.Reset();
+    lane.silenceDurationSamples = 0;
+    lane.speechDurationSamples = 0;
+    lane.lastPartialSamples = 0;
+    lane.keywordScoredSamples = 0;
+    lane.keywordsSpotted = 0;
+}
 
-        // Threshold at 0.5 for balanced detection
-        isSpeech = maxProbability > 0.5f;
+void AudioCaptureEngine::SplitUtterance(SpeechLane& lane, const SegmenterConfig& config) {
+    const size_t VAD_WINDOW_SAMPLES = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000;
+    const size_t frames = lane.frameScores.size();
+    const size_t firstCandidate = static_cast<size_t>(SAMPLE_RATE) * config.chunkMinSec / VAD_WINDOW_SAMPLES;
+    if (!asyncWhisperQueue || frames < firstCandidate + CHUNK_SPLIT_FRAMES) {
+        return;
+    }
 
-        // Only log significant changes
-        static bool lastSpeechState = false;
-        if (isSpeech != lastSpeechState) {
-            LogDebug("Silero VAD: " + std::string(isSpeech ? "SPEECH" : "SILENCE") +
-                     " (probability: " + std::to_string(maxProbability) + ")");
-            lastSpeechState = isSpeech;
-        }
-    } else {
-        // Fallback: Simple energy-based VAD
-        float energy = 0.0f;
-        for (float sample : audioChunk) {
-            energy += sample * sample;
+    // Quietest CHUNK_SPLIT_FRAMES-frame stretch (sliding sum); the cut goes in its middle
+    float sum = 0.0f;
+    for (size_t i = firstCandidate; i < firstCandidate + CHUNK_SPLIT_FRAMES; ++i) {
+        sum += lane.frameScores[i];
+    }
+    float bestSum = sum;
+    size_t bestStart = firstCandidate;
+    for (size_t start = firstCandidate + 1; start + CHUNK_SPLIT_FRAMES <= frames; ++start) {
+        sum += lane.frameScores[start + CHUNK_SPLIT_FRAMES - 1] - lane.frameScores[start - 1];
+        if (sum < bestSum) {
+            bestSum = sum;
+            bestStart = start;
         }
-        energy /= audioChunk.size();
+    }
+    const size_t splitFrame = bestStart + CHUNK_SPLIT_FRAMES / 2;
+    const size_t splitSample = splitFrame * VAD_WINDOW_SAMPLES;
+
+    LogDebug("Splitting " + std::string(lane.name) + " utterance at " +
+             std::to_string(splitSample * 1000 / SAMPLE_RATE) + "ms (mean VAD score " +
+             std::to_string(bestSum / CHUNK_SPLIT_FRAMES) + ")");
+
+    // The tail is at most chunkMaxSec - chunkMinSec: copy it out, queue the head in place
+    std::vector<float> rest = asyncWhisperQueue->AcquireBuffer();
+    rest.assign(lane.speechBuffer.begin() + splitSample, lane.speechBuffer.end());
+    lane.speechBuffer.resize(splitSample);
+    QueueSpeech(lane, splitFrame, &rest);
+    lane.frameScores.erase(lane.frameScores.begin(), lane.frameScores.begin() + splitFrame);
+
+    lane.continuation = true;
+    lane.speechDurationSamples = lane.speechBuffer.size();
+    lane.lastPartialSamples = 0;
+    lane.keywordScoredSamples = 0;
+    lane.speechStartTime = std::chrono::steady_clock::now() -
+        std::chrono::milliseconds(lane.speechBuffer.size() * 1000 / SAMPLE_RATE);
+}
 
-        isSpeech = energy > vadThreshold;
+void AudioCaptureEngine::QueueSpeech(SpeechLane& lane, size_t frames, std::vector<float>* next) {
+    // Queue for async transcription (non-blocking!); ownership moves to the
+    // queue and a recycled buffer takes its place, so nothing is copied
+    if (!asyncWhisperQueue) {
+        return;
+    }
+    if (KeywordGateSkips(lane)) {
+        LogDebug(lane.keywordsSpotted ? "Keyword command, whisper skipped" : "No wake word, whisper skipped");
+        keywordGatedUtterances++;
+        lane.mel.Reset();
+        if (next) {
+            lane.speechBuffer.swap(*next);
+        } else {
+            lane.speechBuffer.clear();
+        }
+        return;
+    }
 
-        // Only log significant changes
-        static bool lastEnergyState = false;
-        if (isSpeech != lastEnergyState) {
-            LogDebug("Energy VAD: " + std::string(isSpeech ? "SPEECH" : "SILENCE") +
-                     " (energy: " + std::to_string(energy) + ")");
-            lastEnergyState = isSpeech;
+    // Mean Silero probability of the speech frames: marginal utterances yield
+    // to real speech in the queue (energy scores aren't probabilities: unknown)
+    float vadConfidence = 1.0f;
+    if (lane.vad) {
+        const float offThreshold = GetSegmenterConfig().speechOffThreshold;
+        float sum = 0.0f;
+        size_t count = 0;
+        for (size_t i = 0; i < (std::min)(frames, lane.frameScores.size()); ++i) {
+            if (lane.frameScores[i] > offThreshold) {
+                sum += lane.frameScores[i];
+                count++;
+            }
         }
+        vadConfidence = count > 0 ? sum / count : 0.0f;
     }
 
+    size_t model = SelectWhisperModel(lane.speechBuffer.size(), lane.systemAudio);
+    if (model != 0) {
+        LogDebug("Primary whisper behind, using fast tier for this utterance");
+    }
+    uint32_t durationMs = static_cast<uint32_t>(lane.speechBuffer.size() * 1000 / SAMPLE_RATE);
+
+    // Only the frames reaching past the end are left to compute; the queue
+    // takes them with the audio. The spectrogram starts over for what follows
+    LogMelSpectrogram::Frames* mel = nullptr;
+    if (lane.mel.IsConfigured()) {
+        lane.mel.Take(lane.speechBuffer.data(), lane.speechBuffer.size(), lane.melFrames);
+        mel = &lane.melFrames;
+    }
+
+    uint64_t traceId = 0;
+    if (lane.systemAudio) {
+        asyncWhisperQueue->QueueAudio(std::move(lane.speechBuffer), model, 0,
+                                      AsyncWhisperQueue::Lane::Background, lane.continuation, vadConfidence, mel);
+    } else {
+        traceId = UtteranceTracer::Instance().Begin(lane.speechStartTime, lane.lastSpeechTime, durationMs);
+        if (speakerTracker) {
+            // Embedded on the tracker's thread while whisper decodes the same audio
+            speakerTracker->Submit(traceId, lane.speechBuffer.data(), lane.speechBuffer.size());
+        }
+        asyncWhisperQueue->QueueAudio(std::move(lane.speechBuffer), model, traceId,
+                                      AsyncWhisperQueue::Lane::Primary, lane.continuation, vadConfidence, mel);
+        queuedUtterances++;
+    }
     {
-        std::lock_guard<std::mutex> lock(metricsMutex);
-        metrics.isSpeechDetected = isSpeech;
+        std::lock_guard<std::mutex> lock(keywordCallbackMutex);
+        if (segmentCallback) {
+            segmentCallback(traceId, durationMs, vadConfidence, lane.systemAudio);
+        }
+    }
+    lane.speechBuffer = next ? std::move(*next) : asyncWhisperQueue->AcquireBuffer();
+}
+
+void AudioCaptureEngine::SpotKeywords(SpeechLane& lane) {
+    lane.keywordScoredSamples = lane.speechBuffer.size();
+    float score = 0.0f;
+    int keyword = keywordSpotter->Spot(lane.speechBuffer.data(), lane.speechBuffer.size(), &score);
+    if (keyword < 0 || (lane.keywordsSpotted & (1ull << keyword))) {
+        return;     // Overlapping windows see the same word several times
+    }
+    lane.keywordsSpotted |= 1ull << keyword;
+
+    const std::string& label = keywordSpotter->GetKeyword(keyword);
+    LogDebug("Keyword spotted: " + label + " (" + std::to_string(score) + ")");
+    std::lock_guard<std::mutex> lock(keywordCallbackMutex);
+    if (keywordCallback) {
+        keywordCallback(label, score);
     }
+}
 
-    return isSpeech;
+bool AudioCaptureEngine::KeywordGateSkips(const SpeechLane& lane) const {
+    if (lane.systemAudio || !keywordSpotter || !keywordSpotter->IsInitialized()) {
+        return false;
+    }
+    switch (keywordGate.load()) {
+        case KeywordGate::Commands:
+            return lane.keywordsSpotted != 0 && !lane.continuation &&
+                   lane.speechDurationSamples <= static_cast<size_t>(SAMPLE_RATE) * KWS_COMMAND_MAX_MS / 1000;
+        case KeywordGate::WakeWord:
+            return lane.keywordsSpotted == 0;
+        default:
+            return false;
+    }
 }
 
 // ============================================================================
-// Whisper Transcription
+// VAD
 // ============================================================================
 
-std::string AudioCaptureEngine::TranscribeAudio(const std::vector<float>& audioData) {
-    if (!whisperContext) {
-        return "";
-    }
-
-    // Set up whisper parameters
-    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-    params.language = "en";
-    params.n_threads = 4; // Use 4 CPU threads
-    params.print_progress = false;
-    params.print_special = false;
-    params.print_realtime = false;
-    params.translate = false;
-    params.no_context = true;
-    params.single_segment = false;
-
-    // Run inference
-    int result = whisper_full(
-        whisperContext,
-        params,
-        audioData.data(),
-        static_cast<int>(audioData.size())
-    );
-
-    if (result != 0) {
-        LogError("Whisper transcription failed");
-        return "";
+void AudioCaptureEngine::ClassifyFrames(SpeechLane& lane, const float* frames, size_t nFrames) {
+    if (nFrames == 0) {
+        return;
     }
+    TRACE_ZONE("ClassifyFrames");
 
-    // Extract text
-    std::string transcription;
-    int n_segments = whisper_full_n_segments(whisperContext);
+    auto vadStartTime = std::chrono::high_resolution_clock::now();
+    const size_t frameSamples = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000;
+    float* scoresOut = lane.scores.data();
 
-    for (int i = 0; i < n_segments; ++i) {
-        const char* text = whisper_full_get_segment_text(whisperContext, i);
-        if (text) {
-            transcription += text;
+    if (lane.vad && vadGateEnabled.load()) {
+        ClassifyGated(lane, frames, nFrames);
+    } else if (lane.vad) {
+        // Use Silero VAD (neural network-based)
+        // Silero expects 512 samples (32ms @ 16kHz) per frame; one call for the whole batch
+        if (lane.vadStale) {
+            WarmUpVad(lane, frames, 0);
+        }
+        lane.vad->ProcessBatch(frames, nFrames, scoresOut);
+    } else {
+        // Fallback: Simple energy-based VAD
+        for (size_t f = 0; f < nFrames; ++f) {
+            const float* frame = frames + f * frameSamples;
+            float energy = 0.0f;
+            for (size_t i = 0; i < frameSamples; ++i) {
+                energy += frame[i] * frame[i];
+            }
+            scoresOut[f] = energy / frameSamples;
         }
     }
 
-    // Clean up whitespace
-    if (!transcription.empty()) {
-        // Trim leading/trailing whitespace
-        size_t start = transcription.find_first_not_of(" \t\n\r");
-        size_t end = transcription.find_last_not_of(" \t\n\r");
-        if (start != std::string::npos && end != std::string::npos) {
-            transcription = transcription.substr(start, end - start + 1);
+    auto vadEndTime = std::chrono::high_resolution_clock::now();
+
+    // Per-frame cost, so the metric stays comparable when a backlog is batched
+    float perFrameMs = std::chrono::duration<float, std::milli>(vadEndTime - vadStartTime).count() / nFrames;
+    PipelineLatency::Record(PipelineLatency::Stage::Vad, perFrameMs);
+    if (!lane.systemAudio) {
+        std::lock_guard<std::mutex> lock(metricsMutex);
+        metrics.vadLatencyMs = perFrameMs;
+    }
+}
+
+void AudioCaptureEngine::ClassifyGated(SpeechLane& lane, const float* frames, size_t nFrames) {
+    const size_t frameSamples = VadGate::FRAME_SAMPLES;
+    lane.gate.Classify(frames, nFrames, lane.candidates.data());
+
+    size_t f = 0;
+    while (f < nFrames) {
+        // A run for Silero: the open utterance, candidates, and the hangover after them
+        size_t end = f;
+        while (end < nFrames) {
+            if (lane.speaking || lane.candidates[end]) {
+                lane.vadHangover = VAD_GATE_HANGOVER_FRAMES;
+            } else if (lane.vadHangover > 0) {
+                lane.vadHangover--;
+            } else {
+                break;
+            }
+            end++;
         }
+        if (end > f) {
+            if (lane.vadStale) {
+                WarmUpVad(lane, frames, f);
+            }
+            lane.vad->ProcessBatch(frames + f * frameSamples, end - f, lane.scores.data() + f);
+            f = end;
+            continue;
+        }
+
+        // Clearly not speech: Silero never sees it
+        lane.scores[f] = 0.0f;
+        lane.vadStale = true;
+        f++;
     }
 
-    return transcription;
+    lane.gate.Adapt(lane.scores.data(), nFrames, GetSegmenterConfig().speechOffThreshold);
+    lane.gate.Remember(frames, nFrames);
+}
+
+void AudioCaptureEngine::WarmUpVad(SpeechLane& lane, const float* frames, size_t first) {
+    // The LSTM state is from before the gap: start clean and give it the
+    // frames leading up to this one, from the batch and the gate's history
+    const size_t frameSamples = VadGate::FRAME_SAMPLES;
+    lane.vad->Reset();
+    lane.vadStale = false;
+
+    size_t historyFrames = 0;
+    const float* history = lane.gate.GetHistory(historyFrames);
+    const size_t fromBatch = (std::min)(first, VadGate::WARMUP_FRAMES);
+    const size_t fromHistory = (std::min)(historyFrames, VadGate::WARMUP_FRAMES - fromBatch);
+    float* warmup = lane.warmup.data();
+    std::memcpy(warmup, history + (historyFrames - fromHistory) * frameSamples,
+                fromHistory * frameSamples * sizeof(float));
+    std::memcpy(warmup + fromHistory * frameSamples, frames + (first - fromBatch) * frameSamples,
+                fromBatch * frameSamples * sizeof(float));
+
+    float discarded[VadGate::WARMUP_FRAMES];
+    if (fromHistory + fromBatch > 0) {
+        lane.vad->ProcessBatch(warmup, fromHistory + fromBatch, discarded);
+    }
+}
+
+void AudioCaptureEngine::PushPreRoll(SpeechLane& lane, const float* frame, size_t count) {
+    size_t ringSize = lane.preRoll.size();
+    for (size_t i = 0; i < count; ++i) {
+        lane.preRoll[lane.preRollWrite] = frame[i];
+        lane.preRollWrite = (lane.preRollWrite + 1) % ringSize;
+    }
+    lane.preRollFill = (std::min)(lane.preRollFill + count, ringSize);
 }
 
 // ============================================================================
-// Buffer Management
+// Segmentation Policy
 // ============================================================================
 
-void AudioCaptureEngine::AddMicrophoneData(const std::vector<float>& data) {
-    std::lock_guard<std::mutex> lock(micBufferMutex);
-
-    microphoneBuffer.insert(microphoneBuffer.end(), data.begin(), data.end());
+bool AudioCaptureEngine::IsValidSegmenterConfig(const SegmenterConfig& config) {
+    return config.preRollMs >= 0 && config.preRollMs <= MAX_PRE_ROLL_MS &&
+           config.speechOnThreshold > 0.0f && config.speechOnThreshold < 1.0f &&
+           config.speechOffThreshold > 0.0f && config.speechOffThreshold <= config.speechOnThreshold &&
+           config.silenceThresholdMs > 0 && config.minSpeechMs >= 0 &&
+           config.turnMinSilenceMs > 0 && config.turnMaxSilenceMs >= config.turnMinSilenceMs &&
+           config.maxSpeechSec >= 1 && config.maxSpeechSec <= MAX_SPEECH_SEC_LIMIT &&
+           (config.chunkMaxSec == 0 ||
+            (config.chunkMinSec >= 1 && config.chunkMinSec < config.chunkMaxSec &&
+             config.chunkMaxSec <= config.maxSpeechSec));
+}
 
-    // Prevent buffer overflow
-    if (microphoneBuffer.size() > MAX_BUFFER_SAMPLES) {
-        microphoneBuffer.erase(
-            microphoneBuffer.begin(),
-            microphoneBuffer.begin() + (microphoneBuffer.size() - MAX_BUFFER_SAMPLES)
-        );
+bool AudioCaptureEngine::SetSegmenterConfig(const SegmenterConfig& config) {
+    if (!IsValidSegmenterConfig(config)) {
+        LogError("Rejected segmenter config (out of range)");
+        return false;
     }
+    std::lock_guard<std::mutex> lock(segmenterMutex);
+    segmenterConfig = config;
+    return true;
 }
 
-void AudioCaptureEngine::AddSystemAudioData(const std::vector<float>& data) {
-    std::lock_guard<std::mutex> lock(systemAudioBufferMutex);
+AudioCaptureEngine::SegmenterConfig AudioCaptureEngine::GetSegmenterConfig() const {
+    std::lock_guard<std::mutex> lock(segmenterMutex);
+    return segmenterConfig;
+}
 
-    systemAudioBuffer.insert(systemAudioBuffer.end(), data.begin(), data.end());
+// ============================================================================
+// Buffer Management
+// ============================================================================
 
-    if (systemAudioBuffer.size() > MAX_BUFFER_SAMPLES) {
-        systemAudioBuffer.erase(
-            systemAudioBuffer.begin(),
-            systemAudioBuffer.begin() + (systemAudioBuffer.size() - MAX_BUFFER_SAMPLES)
-        );
+void AudioCaptureEngine::AddMicrophoneData(CaptureEndpoint& endpoint, const float* data, size_t count) {
+    if (captureSink) {
+        captureSink(false, data, count);
+        return;
     }
+    // Ring drops (and counts) samples if the processing thread falls 30s behind
+    endpoint.ring->Write(data, count);
 }
 
-std::vector<float> AudioCaptureEngine::GetMicrophoneBuffer() {
-    std::lock_guard<std::mutex> lock(micBufferMutex);
-    return microphoneBuffer;
+void AudioCaptureEngine::AddSystemAudioData(const float* data, size_t count) {
+    if (captureSink) {
+        captureSink(true, data, count);
+        return;
+    }
+    systemAudioRing->Write(data, count);
 }
 
-std::vector<float> AudioCaptureEngine::GetSystemAudioBuffer() {
-    std::lock_guard<std::mutex> lock(systemAudioBufferMutex);
-    return systemAudioBuffer;
+size_t AudioCaptureEngine::MicrophoneSamplesAvailable() const {
+    if (microphones.empty()) {
+        return microphoneRing->Available();
+    }
+    if (microphones.size() == 1) {
+        return microphones[0]->ring->Available();
+    }
+    // The selected endpoint paces the reads; a dead one hands over to any live one
+    const uint64_t now = GetTickCount64();
+    if (IsEndpointLive(*microphones[selectedMicrophone], now)) {
+        return microphones[selectedMicrophone]->ring->Available();
+    }
+    size_t available = 0;
+    for (const auto& endpoint : microphones) {
+        if (IsEndpointLive(*endpoint, now)) {
+            available = (std::max)(available, endpoint->ring->Available());
+        }
+    }
+    return available;
 }
 
-// ============================================================================
-// Public Getters
-// ============================================================================
+size_t AudioCaptureEngine::ReadMicrophoneSamples(float* out, size_t maxCount) {
+    const size_t VAD_WINDOW_SAMPLES = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000;
+    const size_t MAX_SKEW_SAMPLES = (static_cast<size_t>(SAMPLE_RATE) * ENDPOINT_MAX_SKEW_MS) / 1000;
 
-std::string AudioCaptureEngine::GetLatestUserSpeech() {
-    // Get result from async queue
-    if (asyncWhisperQueue) {
-        std::string result = asyncWhisperQueue->GetLatestResult();
-        if (!result.empty()) {
-            // Cache for legacy support
-            {
-                std::lock_guard<std::mutex> lock(resultsMutex);
-                latestUserSpeech = result;
+    size_t count = 0;
+    size_t buffered = 0;
+    if (microphones.size() <= 1) {
+        AudioRingBuffer* ring = microphones.empty() ? microphoneRing.get() : microphones[0]->ring.get();
+        count = ring->Read(out, maxCount);
+        buffered = ring->Available();
+    } else {
+        // Every live endpoint gives up the same stretch of time; its gate
+        // scores the batch against that device's own noise floor
+        const uint64_t now = GetTickCount64();
+        const size_t nFrames = (std::min)(maxCount / VAD_WINDOW_SAMPLES, static_cast<size_t>(VAD_MAX_BATCH_FRAMES));
+        const size_t samples = nFrames * VAD_WINDOW_SAMPLES;
+        size_t best = selectedMicrophone;
+        for (size_t i = 0; i < microphones.size(); ++i) {
+            CaptureEndpoint& endpoint = *microphones[i];
+            if (!IsEndpointLive(endpoint, now)) {
+                endpoint.snrDb = -std::numeric_limits<float>::infinity();
+                continue;
             }
-
-            // Trigger callback if set
-            {
-                std::lock_guard<std::mutex> lock(callbackMutex);
-                if (transcriptionCallback) {
-                    transcriptionCallback(result);
-                }
+            size_t read = endpoint.ring->Read(endpoint.batch.data(), samples);
+            std::fill(endpoint.batch.begin() + read, endpoint.batch.begin() + samples, 0.0f);
+            endpoint.gate.Classify(endpoint.batch.data(), nFrames, endpoint.candidates.data());
+            endpoint.snrDb = endpoint.gate.GetPeakMarginDb();
+            if (endpoint.snrDb > microphones[best]->snrDb) {
+                best = i;
             }
+        }
 
-            return result;
+        // Switch between utterances only (an utterance never mixes devices),
+        // unless the selected one died; the challenger has to clear a margin
+        const CaptureEndpoint& selected = *microphones[selectedMicrophone];
+        if (best != selectedMicrophone &&
+            (!microphoneLane.speaking || !IsEndpointLive(selected, now)) &&
+            microphones[best]->snrDb > selected.snrDb + ENDPOINT_SWITCH_MARGIN_DB) {
+            SelectMicrophone(best);
+        }
+        std::copy(microphones[selectedMicrophone]->batch.begin(),
+                  microphones[selectedMicrophone]->batch.begin() + samples, out);
+        count = samples;
+
+        // Keep the others within ENDPOINT_MAX_SKEW_MS of the selected one
+        // (devices drift apart, and a stall leaves a backlog behind)
+        buffered = microphones[selectedMicrophone]->ring->Available();
+        for (const auto& endpoint : microphones) {
+            size_t available = endpoint->ring->Available();
+            if (available > buffered + MAX_SKEW_SAMPLES) {
+                endpoint->ring->Skip(available - buffered);
+            }
         }
     }
 
-    // Fallback to cached result
-    std::lock_guard<std::mutex> lock(resultsMutex);
-    return latestUserSpeech;
+    {
+        std::lock_guard<std::mutex> lock(metricsMutex);
+        metrics.audioBufferSize = static_cast<int>(buffered);
+    }
+
+    return count;
 }
 
-void AudioCaptureEngine::SetTranscriptionCallback(TranscriptionCallback callback) {
-    std::lock_guard<std::mutex> lock(callbackMutex);
-    transcriptionCallback = callback;
+void AudioCaptureEngine::AdaptEndpointGates(const float* scores, size_t nFrames, float noiseThreshold) {
+    // Silero scored the selected device's audio, but the frames are the same
+    // moments on every device: what was noise there is noise everywhere
+    if (microphones.size() <= 1) {
+        return;
+    }
+    for (auto& endpoint : microphones) {
+        endpoint->gate.Adapt(scores, nFrames, noiseThreshold);
+    }
 }
 
-std::string AudioCaptureEngine::GetLatestSystemAudio() {
-    std::lock_guard<std::mutex> lock(resultsMutex);
-    return latestSystemAudio;
+void AudioCaptureEngine::SelectMicrophone(size_t index) {
+    selectedMicrophone = index;
+    // The echo canceller's delay estimate, the noise estimate and Silero's
+    // recurrent state all describe the previous device
+    echoSuppressorFed = false;
+    microphoneLane.denoiserFed = false;
+    microphoneLane.vadStale = true;
+    microphoneLane.gate.Reset();
+    if (index < microphones.size()) {
+        LogDebug("Transcribing microphone: " + microphones[index]->name);
+    }
 }
 
-AudioCaptureEngine::PerformanceMetrics AudioCaptureEngine::GetMetrics() const {
-    std::lock_guard<std::mutex> lock(metricsMutex);
-    return metrics;
+bool AudioCaptureEngine::IsEndpointLive(const CaptureEndpoint& endpoint, uint64_t nowMs) const {
+    return !endpoint.failed.load() && endpoint.capturing.load() &&
+           nowMs - endpoint.lastPacketMs.load() < ENDPOINT_STALL_MS;
+}
+
+size_t AudioCaptureEngine::ReadSystemAudioSamples(float* out, size_t maxCount) {
+    return systemAudioRing->Read(out, maxCount);
+}
+
+size_t AudioCaptureEngine::FeedReplayAudio(const float* samples, size_t count) {
+    return microphoneRing->Write(samples, count);
+}
+
+size_t AudioCaptureEngine::FeedAudio(bool systemAudio, const float* samples, size_t count) {
+    return (systemAudio ? systemAudioRing : microphoneRing)->Write(samples, count);
+}
+
+uint64_t AudioCaptureEngine::GetSpeechActivity() const {
+    return asyncWhisperQueue ? asyncWhisperQueue->GetActivityCount() : 0;
+}
+
+uint64_t AudioCaptureEngine::TrimIdleMemory() {
+    return asyncWhisperQueue ? asyncWhisperQueue->TrimIdle(1) : 0;
+}
+
+bool AudioCaptureEngine::EnableArchive(const AudioArchive::Options& options) {
+    if (!asyncWhisperQueue) {
+        return false;
+    }
+    auto created = std::make_unique<AudioArchive>(options, AsyncWhisperQueue::BufferSamples());
+    if (!created->Start()) {
+        return false;
+    }
+    archive = std::move(created);
+    AudioArchive* sink = archive.get();
+    asyncWhisperQueue->SetFinishedAudioSink(
+        [sink](AsyncWhisperQueue::Lane lane, std::vector<float>& audio, const std::string& text) {
+            sink->SubmitSegment(lane == AsyncWhisperQueue::Lane::Background, audio, text);
+        });
+    return true;
+}
+
+size_t AudioCaptureEngine::GetPendingReplaySamples() const {
+    return microphoneRing->Available();
+}
+
+bool AudioCaptureEngine::IsReplayIdle() const {
+    // Order matters: frames leave the ring only while segmentingFrames is set,
+    // and an utterance is in flight in the queue before it is cleared
+    const size_t vadWindowSamples = (SAMPLE_RATE * VAD_CHUNK_MS) / 1000;
+    if (microphoneRing->Available() >= vadWindowSamples || segmentingFrames.load()) {
+        return false;
+    }
+    return !asyncWhisperQueue || asyncWhisperQueue->GetInFlightCount() == 0;
 }
 
 // ============================================================================
-// Helper Functions
+// Public Getters
 // ============================================================================
 
-std::vector<float> AudioCaptureEngine::ConvertPCMToFloat(const BYTE* pcmData, UINT32 numFrames) {
-    // Handle different audio formats
-    std::vector<float> floatData;
+std::string AudioCaptureEngine::GetLatestUserSpeech() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    return latestUserSpeech;
+}
 
-    // Check if format is float32 (common for WASAPI)
-    if (deviceFormat.wFormatTag == WAVE_FORMAT_IEEE_FLOAT ||
-        deviceFormat.wBitsPerSample == 32) {
-        // Already float format
-        const float* samples = reinterpret_cast<const float*>(pcmData);
+int AudioCaptureEngine::GetLatestUserSpeaker() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    return latestUserSpeaker;
+}
 
-        // Convert to mono if needed (average channels)
-        if (deviceFormat.nChannels == 1) {
-            floatData.assign(samples, samples + numFrames);
-        } else {
-            // Convert stereo/multi-channel to mono by averaging
-            floatData.reserve(numFrames);
-            for (UINT32 i = 0; i < numFrames; ++i) {
-                float mono = 0.0f;
-                for (UINT32 ch = 0; ch < deviceFormat.nChannels; ++ch) {
-                    mono += samples[i * deviceFormat.nChannels + ch];
-                }
-                floatData.push_back(mono / deviceFormat.nChannels);
-            }
+uint64_t AudioCaptureEngine::GetLatestUserTraceId() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    return latestUserTraceId;
+}
+
+void AudioCaptureEngine::DeliverResults() {
+    // Serialized by the queue, so results reach the callback in utterance order
+    std::lock_guard<std::mutex> lock(callbackMutex);
+
+    uint64_t traceId = 0;
+    std::string result;
+    while (!(result = asyncWhisperQueue->GetLatestResult(&traceId)).empty()) {
+        UtteranceTracer::Instance().Mark(traceId, UtteranceTracer::Point::PickedUp);
+        int speaker = speakerTracker ? speakerTracker->Lookup(traceId, SPEAKER_WAIT_MS) : -1;
+        {
+            std::lock_guard<std::mutex> resultsLock(resultsMutex);
+            latestUserSpeech = result;
+            latestUserSpeaker = speaker;
+            latestUserTraceId = traceId;
+        }
+        if (transcriptionCallback) {
+            transcriptionCallback(result);      // UpdateVoiceContext in the engine
+            UtteranceTracer::Instance().Mark(traceId, UtteranceTracer::Point::ContextUpdated);
         }
     }
-    else if (deviceFormat.wBitsPerSample == 16) {
-        // 16-bit PCM format
-        const int16_t* samples = reinterpret_cast<const int16_t*>(pcmData);
 
-        // Convert to mono if needed
-        if (deviceFormat.nChannels == 1) {
-            floatData.reserve(numFrames);
-            for (UINT32 i = 0; i < numFrames; ++i) {
-                floatData.push_back(samples[i] / 32768.0f);
-            }
-        } else {
-            // Convert stereo/multi-channel to mono
-            floatData.reserve(numFrames);
-            for (UINT32 i = 0; i < numFrames; ++i) {
-                float mono = 0.0f;
-                for (UINT32 ch = 0; ch < deviceFormat.nChannels; ++ch) {
-                    mono += samples[i * deviceFormat.nChannels + ch] / 32768.0f;
-                }
-                floatData.push_back(mono / deviceFormat.nChannels);
-            }
+    // Loopback results: their own stream, order and callback
+    while (!(result = asyncWhisperQueue->GetLatestResult(nullptr, AsyncWhisperQueue::Lane::Background)).empty()) {
+        {
+            std::lock_guard<std::mutex> resultsLock(resultsMutex);
+            latestSystemAudio = result;
+        }
+        if (systemAudioCallback) {
+            systemAudioCallback(result);
         }
     }
 
-    // Resample to 16kHz if needed
-    if (deviceFormat.nSamplesPerSec != SAMPLE_RATE) {
-        floatData = ResampleAudio(floatData, deviceFormat.nSamplesPerSec, SAMPLE_RATE);
+    // A published result also clears the partial
+    std::string partial = asyncWhisperQueue->GetPartialResult();
+    if (partial != lastDeliveredPartial) {
+        lastDeliveredPartial = partial;
+        if (partialCallback) {
+            partialCallback(partial);
+        }
     }
+}
+
+void AudioCaptureEngine::SetTranscriptionCallback(TranscriptionCallback callback) {
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    transcriptionCallback = callback;
+}
 
-    return floatData;
+void AudioCaptureEngine::SetPartialTranscriptionCallback(PartialTranscriptionCallback callback) {
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    partialCallback = callback;
 }
 
-std::vector<float> AudioCaptureEngine::ResampleAudio(const std::vector<float>& input,
-                                                      int inputSampleRate,
-                                                      int outputSampleRate) {
-    if (inputSampleRate == outputSampleRate) {
-        return input;
+void AudioCaptureEngine::SetTranscriptSegmentCallback(TranscriptSegmentCallback callback) {
+    if (!asyncWhisperQueue) {
+        return;
+    }
+    if (!callback) {
+        asyncWhisperQueue->SetDecodedSegmentCallback(nullptr);
+        return;
     }
+    // Loopback segments would read as the user's words
+    asyncWhisperQueue->SetDecodedSegmentCallback(
+        [callback](AsyncWhisperQueue::Lane lane, uint64_t traceId, int index, const std::string& text,
+                   int64_t startMs, int64_t endMs) {
+            if (lane == AsyncWhisperQueue::Lane::Primary) {
+                callback(traceId, index, text, startMs, endMs);
+            }
+        });
+}
 
-    // Simple linear resampling
-    float ratio = static_cast<float>(inputSampleRate) / outputSampleRate;
-    size_t outputSize = static_cast<size_t>(input.size() / ratio);
-    std::vector<float> output;
-    output.reserve(outputSize);
+void AudioCaptureEngine::SetSystemAudioCallback(TranscriptionCallback callback) {
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    systemAudioCallback = callback;
+}
+
+void AudioCaptureEngine::SetKeywordCallback(KeywordCallback callback) {
+    std::lock_guard<std::mutex> lock(keywordCallbackMutex);
+    keywordCallback = callback;
+}
 
-    for (size_t i = 0; i < outputSize; ++i) {
-        float srcIndex = i * ratio;
-        size_t index0 = static_cast<size_t>(srcIndex);
-        size_t index1 = (index0 + 1 < input.size()) ? index0 + 1 : input.size() - 1;
-        float fraction = srcIndex - index0;
+void AudioCaptureEngine::SetSegmentCallback(SegmentCallback callback) {
+    std::lock_guard<std::mutex> lock(keywordCallbackMutex);
+    segmentCallback = callback;
+}
 
-        // Linear interpolation
-        float sample = input[index0] * (1.0f - fraction) + input[index1] * fraction;
-        output.push_back(sample);
+std::string AudioCaptureEngine::GetPartialUserSpeech() {
+    if (asyncWhisperQueue) {
+        return asyncWhisperQueue->GetPartialResult();
     }
+    return "";
+}
 
-    return output;
+std::string AudioCaptureEngine::GetLatestSystemAudio() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    return latestSystemAudio;
 }
 
+AudioCaptureEngine::PerformanceMetrics AudioCaptureEngine::GetMetrics() const {
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    return metrics;
+}
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
 void AudioCaptureEngine::LogDebug(const std::string& message) {
-    std::cout << "[AudioEngine] " << message << std::endl;
-    OutputDebugStringA(("[AudioEngine] " + message + "\n").c_str());
+    if (Log::Enabled(Log::Level::Debug)) {
+        Log::Write(Log::Level::Debug, "AudioEngine", message);
+    }
 }
 
 void AudioCaptureEngine::LogError(const std::string& message) {
-    std::cerr << "[AudioEngine ERROR] " << message << std::endl;
-    OutputDebugStringA(("[AudioEngine ERROR] " + message + "\n").c_str());
+    Log::Write(Log::Level::Error, "AudioEngine", message);
 }
@@ -8,10 +8,16 @@
 #include <string>
 #include <vector>
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <queue>
 #include <functional>
+#include "AudioArchive.h"
+#include "LogMelSpectrogram.h"
+#include "NoiseSuppressor.h"
+#include "TurnDetector.h"
+#include "VadGate.h"
 
 // Forward declarations for whisper.cpp
 struct whisper_context;
@@ -22,9 +28,44 @@ class AsyncWhisperQueue;
 // Forward declaration for Silero VAD
 class SileroVAD;
 
+// Forward declaration for lock-free sample ring
+class AudioRingBuffer;
+
+// Forward declaration for PCM -> 16kHz mono conversion kernel
+class AudioResampler;
+
+// Forward declaration for loopback-referenced echo suppression
+class EchoSuppressor;
+
+// Forward declaration for the keyword-spotting fast path
+class KeywordSpotter;
+
+// Forward declaration for per-utterance speaker ids
+class SpeakerTracker;
+
+// Forward declaration for the IMMNotificationClient that reports device changes
+class EndpointNotifier;
+
+// Forward declaration for non-WASAPI capture sources (file, network, synthetic)
+class AudioSource;
+
 // Callback type for transcription results
 using TranscriptionCallback = std::function<void(const std::string& transcription)>;
 
+// Callback type for streaming partials (empty once the utterance is finalized)
+using PartialTranscriptionCallback = std::function<void(const std::string& partial)>;
+
+// Callback type for segments of a long utterance as whisper decodes them, ahead
+// of its transcription (index from 0 per utterance; ms into the utterance)
+using TranscriptSegmentCallback = std::function<void(uint64_t traceId, int index, const std::string& text,
+                                                     int64_t startMs, int64_t endMs)>;
+
+// Callback type for spotted keywords (label, model probability)
+using KeywordCallback = std::function<void(const std::string& keyword, float score)>;
+
+// Callback type for utterances handed to whisper (UtteranceTracer id, 0 for system audio)
+using SegmentCallback = std::function<void(uint64_t traceId, uint32_t durationMs, float vadConfidence, bool systemAudio)>;
+
 /**
  * AudioCaptureEngine - Real-time audio capture and transcription
  *
@@ -32,12 +73,70 @@ using TranscriptionCallback = std::function<void(const std::string& transcriptio
  * - WASAPI microphone capture (user speech)
  * - WASAPI system audio loopback (device playback)
  * - Voice Activity Detection (VAD) for filtering
- * - whisper.cpp CPU inference for transcription
+ * - whisper.cpp inference for transcription (GPU when ggml has one, else CPU)
  *
  * Architecture:
- * - Capture thread: Records audio continuously
- * - Processing thread: VAD -> Whisper pipeline
- * - Thread-safe result queue
+ * - Capture threads: Event-driven WASAPI (buffer-ready event + MMCSS),
+ *   falling back to 10ms polling if the device rejects event callbacks. The
+ *   microphone asks IAudioClient3 for the engine's minimum shared-mode
+ *   period first (a few ms on drivers that support it, instead of 10), so
+ *   speech reaches the VAD - and its end is noticed - sooner
+ * - Processing thread: VAD -> Whisper pipeline, one segmentation lane per
+ *   stream (microphone, system audio loopback), each with its own VAD state;
+ *   both lanes share the whisper state pool, microphone utterances first
+ * - Results pushed from the whisper workers to the registered callbacks
+ *
+ * Echo suppression: on speakers the microphone also hears the playback the
+ * loopback lane transcribes. The loopback batches are the reference of an
+ * EchoSuppressor that cancels them out of the microphone batches before the
+ * microphone VAD, so remote speech isn't transcribed a second time as user
+ * speech. The loopback lane runs first each turn so the reference leads.
+ *
+ * Keyword spotting: when models/kws/kws.onnx (+ labels.txt) is installed, a
+ * KeywordSpotter scores the last second of microphone speech every
+ * KWS_HOP_MS while an utterance is open, and each keyword is reported once
+ * per utterance through the keyword callback, long before whisper returns.
+ * SetKeywordGate() can also let the keywords decide whether whisper runs.
+ *
+ * Speakers: when models/speaker/speaker.onnx is installed, every microphone
+ * utterance is also handed to a SpeakerTracker, which embeds and clusters
+ * it on its own thread while whisper decodes; the speaker id is attached
+ * when the transcription is delivered (GetLatestUserSpeaker).
+ *
+ * Loopback silence costs nothing: WASAPI delivers no packets (or silent
+ * ones, dropped at capture) while nothing plays, and a batch whose peak
+ * stays under SYSTEM_AUDIO_SILENCE_PEAK is treated as silence without
+ * running the VAD.
+ *
+ * Two-stage VAD: outside an utterance, each lane's VadGate (energy against
+ * an adaptive noise floor, zero crossings, spectral flatness) passes only
+ * speech-like frames to Silero, which then keeps scoring for
+ * VAD_GATE_HANGOVER_FRAMES after the last of them and throughout the
+ * utterance. Silero's LSTM state is reset after a skipped span and warmed
+ * up on the frames just before the first one it scores. A quiet room costs
+ * a sum of squares per frame instead of an ONNX run.
+ *
+ * Noise suppression: a lane with SetNoiseSuppressionEnabled() (the
+ * microphone by default) runs its batches through a NoiseSuppressor after
+ * echo suppression, so the gate, Silero and whisper all get the cleaned
+ * audio, 20 ms late. The band gains come from models/denoise/denoise.onnx
+ * when installed, else from the suppressor's own noise estimate. A second
+ * VadGate watches the raw audio; a stretch it would have passed on (as long
+ * as an utterance, ended by a pause) during which the cleaned audio never
+ * opened one is counted as a whisper run avoided (GetDenoiseAvoidedCount).
+ *
+ * Capture endpoints: the microphone lane reads from one CaptureEndpoint per
+ * capture device - the default one, or with SetMultiEndpointCapture() every
+ * active one (a USB speakerphone next to the built-in array, a headset
+ * plugged in mid-day), each with its own client, thread, resampler and
+ * ring. An IMMNotificationClient flags device arrivals, removals and
+ * default changes; the processing thread then reopens the set between
+ * batches. With several endpoints the rings are read in step, each
+ * endpoint's VadGate measures the batch against that device's own noise
+ * floor, and between utterances the lane switches to the endpoint with the
+ * best SNR (by ENDPOINT_SWITCH_MARGIN_DB). There is still one segmenter
+ * and one Silero state, so a speech event heard by every microphone is
+ * transcribed once, from the one that heard it best.
  */
 class AudioCaptureEngine {
 public:
@@ -47,20 +146,218 @@ public:
     // Initialize audio capture and whisper model
     bool Initialize(const std::string& modelPath);
 
+    // Optional smaller whisper model used for short utterances when the primary
+    // falls behind (call before Initialize; empty = single tier)
+    void SetFastWhisperModel(const std::string& modelPath) { fastModelPath = modelPath; }
+
+    // Decode in worker processes (WhisperProcess, --isolate-inference): each
+    // loads the tiers itself and none are loaded here; a crash in whisper
+    // restarts a worker instead of ending the engine (call before Initialize)
+    void SetOutOfProcessWhisper(bool enabled) { outOfProcessWhisper = enabled; }
+
+    // Capture every active microphone instead of only the default one, best
+    // SNR per utterance (call before Initialize; default off). Capture-only
+    // engines always use the default endpoint: the sink gets one stream
+    void SetMultiEndpointCapture(bool enabled) { multiEndpointCapture = enabled; }
+    // Capture devices currently open for the microphone lane
+    size_t GetCaptureEndpointCount() const;
+
+    // Microphone on the smallest shared-mode period IAudioClient3 offers,
+    // falling back to the default period (call before Initialize; default on)
+    void SetLowLatencyCapture(bool enabled) { lowLatencyCapture = enabled; }
+
+    // Silero VAD model for both lanes (call before Initialize)
+    void SetVadModel(const std::wstring& modelPath) { vadModelPath = modelPath; }
+
+    // ggml device whisper runs on (call before Initialize). Auto takes the
+    // first GPU the linked ggml build exposes (Vulkan, CUDA) and falls back to
+    // the CPU; Gpu only differs in logging a warning when there is none.
+    // Accelerator backends (OpenBLAS) are used by whisper in every mode
+    enum class WhisperBackend { Auto, Cpu, Gpu };
+    void SetWhisperBackend(WhisperBackend backend) { whisperBackend = backend; }
+    // "auto", "cpu" or "gpu"
+    static bool ParseWhisperBackend(const std::string& name, WhisperBackend& backend);
+    // Description of the device the models were loaded on ("CPU" until then)
+    const std::string& GetWhisperDevice() const { return whisperDevice; }
+
     // Start/stop audio capture and processing
     bool Start();
     void Stop();
 
-    // Get latest transcription results
+    // Signal the capture and processing threads to exit without joining them,
+    // for an engine with a wedged thread that is being abandoned (leaked)
+    void RequestStop() { isRunning.store(false); }
+
+    // Abort the whisper decodes in progress and drop the queued ones (shutdown);
+    // nothing is transcribed afterwards
+    void CancelTranscriptions();
+
+    // Whisper workers warm (each decodes silence at idle priority on start,
+    // see AsyncWhisperQueue); WaitUntilWarm() blocks until then or cancellation
+    bool IsWarm() const;
+    bool WaitUntilWarm();
+
+    // === Offline replay (bench_audio) ===
+    // Whisper + VAD without WASAPI; Start() then runs only the processing thread
+    // and the microphone ring is fed through FeedReplayAudio()
+    bool InitializeReplay(const std::string& modelPath);
+    // 16 kHz mono samples, as if captured; returns samples accepted by the ring
+    size_t FeedReplayAudio(const float* samples, size_t count);
+    size_t GetPendingReplaySamples() const;
+    // Every fed VAD frame segmented and every queued utterance delivered
+    bool IsReplayIdle() const;
+    // Utterances handed to whisper since start
+    size_t GetQueuedUtteranceCount() const { return queuedUtterances.load(); }
+
+    // === Session broker (SessionBroker) ===
+    // Transcription for another session's audio without loading whisper again:
+    // borrows `owner`'s models (kept alive while this engine holds them), with
+    // its own whisper states, Silero VAD per lane and segmentation, and
+    // owner's segmenter and power settings. No WASAPI: Start() runs only the
+    // processing thread and both lanes are fed through FeedAudio(). The
+    // threads report to `watchdogGroup`, not "voice", whose stall handler
+    // restarts the host's own engine
+    bool InitializeShared(const AudioCaptureEngine& owner, const char* watchdogGroup);
+    // 16 kHz mono samples for one lane, as if captured; returns samples accepted
+    size_t FeedAudio(bool systemAudio, const float* samples, size_t count);
+
+    // === Capture sources (AudioSource.h) ===
+    // Whisper + VAD fed by `source` instead of WASAPI: a WAV file, an RTP
+    // stream, a synthetic generator, or another engine's devices. Start()
+    // starts it after the processing thread, Stop() stops it first; both
+    // lanes take what it sends through FeedAudio()
+    bool InitializeWithSource(const std::string& modelPath, std::unique_ptr<AudioSource> source);
+    // The source ran out (a file played through) and everything it sent was segmented
+    bool IsSourceFinished() const;
+
+    // Capture without inference (SessionAgent): WASAPI only; every converted
+    // 16 kHz mono packet goes to the sink, on its capture thread, instead of
+    // the rings. Start() runs only the capture threads
+    using CaptureSink = std::function<void(bool systemAudio, const float* samples, size_t count)>;
+    bool InitializeCaptureOnly(CaptureSink sink);
+
+    // Last delivered transcription results (new ones arrive via the callbacks)
     std::string GetLatestUserSpeech();
+    // Speaker of the last delivered user utterance (1, 2, ...); -1 when
+    // unknown or no speaker model is installed. Valid inside the
+    // transcription callback for the utterance being delivered
+    int GetLatestUserSpeaker();
+    // UtteranceTracer id of the last delivered user utterance (valid as the speaker is)
+    uint64_t GetLatestUserTraceId();
     std::string GetLatestSystemAudio();
 
+    // Partial hypothesis for the utterance still being spoken (streaming mode)
+    std::string GetPartialUserSpeech();
+
+    // Enable/disable streaming partial transcription (enabled by default)
+    void SetStreamingEnabled(bool enabled) { streamingEnabled.store(enabled); }
+
+    // Speech segmentation policy, shared by both lanes; changes apply from the
+    // next VAD batch. Silero probabilities (the energy fallback scales its own
+    // threshold by speechOffThreshold / speechOnThreshold for the hysteresis)
+    struct SegmenterConfig {
+        int preRollMs = 300;                // Audio before the speech onset prepended to the utterance
+        float speechOnThreshold = 0.5f;     // Probability that starts an utterance
+        float speechOffThreshold = 0.35f;   // ... below which a frame counts as silence once started
+        int silenceThresholdMs = 300;       // Hangover: silence that ends an utterance
+        // TurnDetector moves the hangover within this range by how finished the
+        // utterance sounds (silenceThresholdMs when it can't tell); both equal
+        // to silenceThresholdMs keeps it fixed
+        int turnMinSilenceMs = 120;
+        int turnMaxSilenceMs = 900;
+        int minSpeechMs = 300;              // Utterances with less speech than this aren't transcribed
+        int maxSpeechSec = 30;              // Longer ones are cut (one whisper window)
+        // Long utterances are queued in chunks as they grow: at chunkMaxSec the
+        // buffer is split at the quietest VAD stretch after chunkMinSec, and the
+        // rest continues (prompted with the chunk's text). chunkMaxSec 0 = off
+        int chunkMinSec = 5;
+        int chunkMaxSec = 10;
+    };
+    static constexpr int MAX_PRE_ROLL_MS = 1000;        // Pre-roll ring size
+    static constexpr int MAX_SPEECH_SEC_LIMIT = 30;     // Whisper's window
+    static bool IsValidSegmenterConfig(const SegmenterConfig& config);
+    // False (and nothing changed) when a value is out of range
+    bool SetSegmenterConfig(const SegmenterConfig& config);
+    SegmenterConfig GetSegmenterConfig() const;
+
+    // Whether spotted keywords stand in for whisper on the microphone lane:
+    // Off - every utterance is transcribed (keywords are extra events)
+    // Commands - an utterance of at most KWS_COMMAND_MAX_MS that contained a
+    //            keyword is not transcribed: the keyword is the whole result
+    // WakeWord - only utterances that contained a keyword are transcribed
+    enum class KeywordGate { Off, Commands, WakeWord };
+    void SetKeywordGate(KeywordGate gate) { keywordGate.store(gate); }
+    // Utterances the gate kept from whisper since start
+    size_t GetKeywordGatedCount() const { return keywordGatedUtterances.load(); }
+
+    // Enable/disable loopback echo suppression on the microphone (enabled by default)
+    void SetEchoSuppressionEnabled(bool enabled) { echoSuppressionEnabled.store(enabled); }
+
+    // Enable/disable the VadGate stage in front of Silero (enabled by default)
+    void SetVadGateEnabled(bool enabled) { vadGateEnabled.store(enabled); }
+
+    // Enable/disable noise suppression per device, ahead of the VAD and whisper
+    // (microphone enabled, system audio disabled by default)
+    void SetNoiseSuppressionEnabled(bool systemAudio, bool enabled) {
+        (systemAudio ? systemAudioLane : microphoneLane).denoiseEnabled.store(enabled);
+    }
+    // Utterances the raw audio would likely have produced that the denoised audio didn't, since start
+    size_t GetDenoiseAvoidedCount() const { return denoiseAvoidedUtterances.load(); }
+
+    // Power profile knobs (PowerPolicy), applied from the next utterance / tick:
+    // preferFastWhisper sends every utterance to the fast tier (when loaded),
+    // whisperThreadCap caps the threads per whisper worker (0: the CpuBudget
+    // split), vadTickMs is how long the processing thread sleeps between VAD
+    // batches - longer means fewer wakeups and bigger batches, at up to that
+    // much added latency (clamped to VAD_MAX_TICK_MS)
+    struct PowerSettings {
+        bool preferFastWhisper = false;
+        int whisperThreadCap = 0;
+        int vadTickMs = 10;
+    };
+    void SetPowerSettings(const PowerSettings& settings);
+
+    // Idle memory (MemoryTrimmer): a counter that moves while speech is being
+    // queued, and a trim that drops every whisper worker's state but the
+    // first's, the partial buffers and the recycled utterance buffers.
+    // Returns the bytes released here (worker states are freed on their
+    // own threads and re-created by the next utterance)
+    uint64_t GetSpeechActivity() const;
+    uint64_t TrimIdleMemory();
+
+    // Keep transcribed segments (and the raw microphone stream, when
+    // options.continuous) in a rolling on-disk archive. Call after Initialize,
+    // before Start; false if the directory can't be created
+    bool EnableArchive(const AudioArchive::Options& options);
+    const AudioArchive* GetArchive() const { return archive.get(); }
+
     // Check if engine is running
     bool IsRunning() const { return isRunning.load(); }
 
-    // Set callback for transcription results
+    // Set callback for transcription results; runs on a whisper worker as soon
+    // as each utterance is transcribed, in utterance order
     void SetTranscriptionCallback(TranscriptionCallback callback);
 
+    // Set callback for streaming partials; runs on a whisper worker whenever
+    // the hypothesis changes
+    void SetPartialTranscriptionCallback(PartialTranscriptionCallback callback);
+
+    // Set callback for the decoded segments of long microphone utterances;
+    // runs on a whisper worker. Needs the whisper queue (after Initialize)
+    void SetTranscriptSegmentCallback(TranscriptSegmentCallback callback);
+
+    // Set callback for system audio (loopback) transcriptions; runs on a
+    // whisper worker, in utterance order within the loopback stream
+    void SetSystemAudioCallback(TranscriptionCallback callback);
+
+    // Set callback for spotted keywords; runs on the processing thread, so it
+    // has to return quickly
+    void SetKeywordCallback(KeywordCallback callback);
+
+    // Set callback for utterances queued for transcription; runs on the
+    // processing thread, so it has to return quickly
+    void SetSegmentCallback(SegmentCallback callback);
+
     // Performance metrics
     struct PerformanceMetrics {
         float captureLatencyMs;
@@ -74,68 +371,271 @@ public:
     PerformanceMetrics GetMetrics() const;
 
 private:
+    // One capture device feeding the microphone lane. The capture thread is
+    // the ring's producer; everything else belongs to the processing thread
+    // (or to Initialize/Start/Stop while it isn't running)
+    struct CaptureEndpoint {
+        std::wstring id;
+        std::string name;                       // Friendly name, for logs
+        IMMDevice* device = nullptr;
+        IAudioClient* client = nullptr;
+        IAudioCaptureClient* captureClient = nullptr;
+        HANDLE readyEvent = nullptr;
+        bool eventDriven = false;
+        WAVEFORMATEXTENSIBLE format = {};
+        std::unique_ptr<AudioResampler> resampler;
+        std::unique_ptr<AudioRingBuffer> ring;
+        std::unique_ptr<std::thread> thread;
+        std::atomic<bool> capturing{false};     // Cleared to stop this endpoint's thread alone
+        std::atomic<bool> failed{false};        // The thread gave up (device gone): dropped on refresh
+        std::atomic<uint64_t> lastPacketMs{0};  // GetTickCount64 of the last packet
+        VadGate gate;                           // Batch energy over this device's own noise floor
+        std::vector<float> batch;
+        std::vector<uint8_t> candidates;
+        float snrDb = 0.0f;                     // Of the last batch
+    };
+
     // === WASAPI Audio Capture ===
     bool InitializeMicrophoneCapture();
     bool InitializeSystemAudioCapture();
-    void MicrophoneCaptureThread();
+    // Open / close the microphone endpoints to match the devices present
+    // (the default one, or every active one in multi-endpoint mode); starts
+    // new ones when the engine is running
+    bool RefreshEndpoints();
+    std::unique_ptr<CaptureEndpoint> OpenEndpoint(IMMDevice* device, const std::wstring& id);
+    bool StartEndpoint(CaptureEndpoint& endpoint);
+    void CloseEndpoint(CaptureEndpoint& endpoint);
+    void EndpointCaptureThread(CaptureEndpoint* endpoint);
     void SystemAudioCaptureThread();
+    bool InitializeCaptureClient(IMMDevice* device, IAudioClient** client, DWORD streamFlags,
+                                 HANDLE readyEvent, WAVEFORMATEXTENSIBLE* formatOut, bool& eventDriven);
+    // Event-driven stream at the minimum engine period; false when the
+    // device or driver offers nothing below the default
+    bool InitializeLowLatencyClient(IMMDevice* device, IAudioClient** client, HANDLE readyEvent,
+                                    WAVEFORMATEXTENSIBLE* formatOut, UINT32& periodFrames);
+    // Picks the resampler's conversion kernel for the mix format (EXTENSIBLE subformats included)
+    bool ConfigureResampler(AudioResampler& resampler, const WAVEFORMATEXTENSIBLE& format);
+    // endpoint: the microphone endpoint being captured, null for loopback
+    void RunCaptureLoop(IAudioCaptureClient* captureClient, HANDLE readyEvent,
+                        AudioResampler& resampler, CaptureEndpoint* endpoint, const char* streamName);
 
     // === VAD Processing ===
     bool InitializeVAD(const std::string& vadModelPath);
-    bool IsSpeechDetected(const std::vector<float>& audioChunk);
+    bool InitializeInference(const std::string& modelPath);    // Whisper + VAD
+    bool InitializeLaneModels(bool extras);                     // VAD (+ KWS, speakers when extras)
+    void InitializeSystemAudioVAD();                            // Loopback lane's own Silero state
+
+    // One speech segmenter per captured stream; owned by the processing thread
+    // (pointers are set during initialization)
+    struct SpeechLane {
+        const char* name;
+        bool systemAudio;                   // Loopback: background whisper lane, no partials
+        AudioRingBuffer* ring;
+        SileroVAD* vad = nullptr;           // Null: energy VAD
+        bool speaking = false;
+        bool lastLoggedSpeech = false;      // Last frame decision; transitions are logged, not every frame
+        std::vector<float> speechBuffer;
+        LogMelSpectrogram mel;              // speechBuffer's log-mel frames, advanced with every append
+        LogMelSpectrogram::Frames melFrames;    // Hand-off to the queue (partial windows swap through it)
+        std::vector<float> frameScores;     // VAD score of every speechBuffer frame (chunk split search)
+        bool continuation = false;          // speechBuffer continues a chunk already queued
+        std::vector<float> preRoll;         // Ring of the latest non-speech frames (MAX_PRE_ROLL_MS)
+        size_t preRollWrite = 0;
+        size_t preRollFill = 0;
+        size_t silenceDurationSamples = 0;
+        size_t speechDurationSamples = 0;
+        size_t lastPartialSamples = 0;      // speechBuffer size at the last partial update
+        std::chrono::steady_clock::time_point speechStartTime;     // For UtteranceTracer
+        std::chrono::steady_clock::time_point lastSpeechTime;
+        std::vector<float> batch;           // Reused every tick (no per-tick allocation)
+        std::vector<float> scores;
+        uint64_t silentFramesSkipped = 0;   // Frames the silence fast-path kept from the VAD
+        VadGate gate;                       // Silero's first stage
+        std::vector<uint8_t> candidates;    // Gate verdict per batch frame
+        std::vector<float> warmup;          // Frames replayed through Silero after a skipped span
+        size_t vadHangover = 0;             // Frames Silero still scores after the last candidate
+        bool vadStale = false;              // Frames went by that Silero didn't see
+        size_t keywordScoredSamples = 0;    // speechBuffer size at the last keyword window
+        uint64_t keywordsSpotted = 0;       // Bit per KeywordSpotter class, for this utterance
+        NoiseSuppressor denoiser;           // Before the VAD, when enabled for the lane
+        std::atomic<bool> denoiseEnabled{false};
+        bool denoiserFed = false;           // Every sample since the denoiser's last Reset went through it
+        VadGate rawGate;                    // The gate's view of the audio before noise suppression
+        std::vector<uint8_t> rawCandidates;
+        size_t noiseBurstSamples = 0;       // Raw candidate audio since the last pause, outside utterances
+        size_t noiseBurstGapSamples = 0;
+        TurnDetector turn;                  // End-of-turn confidence: the hangover of the current pause
+    };
+    SpeechLane microphoneLane;
+    SpeechLane systemAudioLane;
+
+    // Read, classify and segment up to VAD_MAX_BATCH_FRAMES frames of a lane;
+    // false when the lane had no whole frame
+    bool SegmentNextBatch(SpeechLane& lane);
+    // Hand the lane's utterance to whisper (or drop it if too short) and reset
+    void FinishUtterance(SpeechLane& lane);
+    // Queue the first chunk of a long utterance, cut at its quietest stretch
+    // between chunkMinSec and now; the rest stays in speechBuffer
+    void SplitUtterance(SpeechLane& lane, const SegmenterConfig& config);
+    // Queue lane.speechBuffer (its first `frames` VAD frames scored in frameScores)
+    // as is; next (or a recycled buffer) takes its place
+    void QueueSpeech(SpeechLane& lane, size_t frames, std::vector<float>* next = nullptr);
+    // Score nFrames consecutive VAD frames into lane.scores (Silero probability,
+    // or energy for the fallback); the segmenter applies the on/off thresholds
+    void ClassifyFrames(SpeechLane& lane, const float* frames, size_t nFrames);
+    // Silero on the frames the lane's VadGate passes (and their hangover); 0 for the rest
+    void ClassifyGated(SpeechLane& lane, const float* frames, size_t nFrames);
+    // Reset Silero and replay the frames before frames[first] (after a skipped span)
+    void WarmUpVad(SpeechLane& lane, const float* frames, size_t first);
+    // Keep a non-speech frame for the next utterance's pre-roll
+    void PushPreRoll(SpeechLane& lane, const float* frame, size_t count);
+    // Count a raw-audio burst that ended without an utterance as a whisper run avoided
+    void TrackNoiseBurst(SpeechLane& lane, bool rawCandidate, bool speechStarted, const SegmenterConfig& config);
+    // Score the last keyword window of the microphone's speech; reports new keywords
+    void SpotKeywords(SpeechLane& lane);
+    // The keyword gate keeps this utterance (or chunk) from whisper
+    bool KeywordGateSkips(const SpeechLane& lane) const;
 
     // === Whisper Transcription ===
     bool InitializeWhisper(const std::string& modelPath);
-    std::string TranscribeAudio(const std::vector<float>& audioData);
+    // The worker pool over whisperContext (+ whisperFastContext)
+    bool CreateWhisperQueue(int workers);
+    // AsyncWhisperQueue result hook: hands new results to the callbacks
+    void DeliverResults();
+    // modelBytes: private bytes grown while loading (the weights whisper copied in)
+    whisper_context* LoadWhisperModel(const std::string& modelPath, uint64_t& modelBytes);
+    // Index among ggml's GPU devices for whisperBackend, or -1 for the CPU;
+    // sets whisperDevice
+    int SelectWhisperGpu();
+    // Tier for an utterance of `samples`: 0 = primary, 1 = fast (see WHISPER_LATENCY_SLO_MS);
+    // background = the loopback lane, whose own backlog is what counts
+    size_t SelectWhisperModel(size_t samples, bool background = false);
     void ProcessingThread();
 
     // === Audio Buffer Management ===
-    void AddMicrophoneData(const std::vector<float>& data);
-    void AddSystemAudioData(const std::vector<float>& data);
-    std::vector<float> GetMicrophoneBuffer();
-    std::vector<float> GetSystemAudioBuffer();
+    // Add* are called from the capture threads (ring producers),
+    // Read* from the processing thread (ring consumer)
+    void AddMicrophoneData(CaptureEndpoint& endpoint, const float* data, size_t count);
+    void AddSystemAudioData(const float* data, size_t count);
+    // Samples the selected endpoint can deliver (the replay ring without endpoints)
+    size_t MicrophoneSamplesAvailable() const;
+    // Several endpoints: reads them in step and returns the selected one's audio
+    size_t ReadMicrophoneSamples(float* out, size_t maxCount);
+    size_t ReadSystemAudioSamples(float* out, size_t maxCount);
+    // Teach the endpoints' noise floors what the VAD called noise
+    void AdaptEndpointGates(const float* scores, size_t nFrames, float noiseThreshold);
+    // Point the microphone lane at another endpoint; the echo canceller,
+    // denoiser and VAD state that followed the old device start over
+    void SelectMicrophone(size_t index);
+    bool IsEndpointLive(const CaptureEndpoint& endpoint, uint64_t nowMs) const;
 
     // === WASAPI Members ===
     IMMDeviceEnumerator* deviceEnumerator;
-    IMMDevice* microphoneDevice;
     IMMDevice* systemAudioDevice;
-    IAudioClient* microphoneClient;
     IAudioClient* systemAudioClient;
-    IAudioCaptureClient* microphoneCaptureClient;
     IAudioCaptureClient* systemAudioCaptureClient;
-    WAVEFORMATEX deviceFormat;
+
+    // Microphone endpoints; the list changes only on the processing thread
+    // (RefreshEndpoints) or while it isn't running, under endpointMutex for
+    // the readers on other threads (GetCaptureEndpointCount, memory report)
+    std::vector<std::unique_ptr<CaptureEndpoint>> microphones;
+    mutable std::mutex endpointMutex;
+    size_t selectedMicrophone;              // Index the lane reads (several endpoints)
+    bool multiEndpointCapture;
+    std::atomic<bool> endpointsChanged;     // Set by the notifier and by failed capture threads
+    EndpointNotifier* endpointNotifier;     // COM object, released in the destructor
+
+    // Buffer-ready event for AUDCLNT_STREAMFLAGS_EVENTCALLBACK capture (loopback)
+    HANDLE systemAudioReadyEvent;
+    bool systemAudioEventDriven;
+    bool lowLatencyCapture;
+
+    // Loopback converter (filter state persists across packets)
+    std::unique_ptr<AudioResampler> systemAudioResampler;
+
+    // Loopback -> microphone echo canceller (processing thread only)
+    std::unique_ptr<EchoSuppressor> echoSuppressor;
+    bool echoSuppressorFed;             // Processing thread: false after a disabled stretch
 
     // === Whisper.cpp ===
     whisper_context* whisperContext;
+    whisper_context* whisperFastContext;    // Optional fallback tier (nullptr = none)
+    // Owners of the two contexts, shared with InitializeShared() engines
+    std::shared_ptr<whisper_context> whisperModel;
+    std::shared_ptr<whisper_context> whisperFastModel;
+    std::string fastModelPath;
+    bool outOfProcessWhisper = false;
+    std::vector<std::string> whisperProcessModels;  // Out of process: the tiers the workers load
+    WhisperBackend whisperBackend;
+    int whisperGpu;                         // -1: CPU
+    std::string whisperDevice;
+    std::unique_ptr<AudioArchive> archive;  // Declared first: outlives the workers that feed it
     std::unique_ptr<AsyncWhisperQueue> asyncWhisperQueue;
+    uint64_t whisperModelBytes;
+    uint64_t whisperFastModelBytes;
+    int whisperThreadsPerWorker;            // The CpuBudget split, before any power cap
+
+    // PowerSettings
+    std::atomic<bool> preferFastWhisper;
+    std::atomic<int> whisperThreadCap;
+    std::atomic<int> vadTickMs;
+    void ApplyWhisperThreadCap();
+
+    // MemoryAccounting reporter (0 until InitializeInference succeeds)
+    uint64_t memoryReporterId;
+    void RegisterMemoryReporter();
 
     // === VAD ===
     std::unique_ptr<SileroVAD> sileroVAD;
+    std::wstring vadModelPath = L"models/vad/silero_vad.onnx";
+    std::unique_ptr<SileroVAD> systemAudioVAD;  // Separate LSTM state for the loopback stream
+    std::unique_ptr<KeywordSpotter> keywordSpotter;     // Null: no KWS model installed
+    std::unique_ptr<SpeakerTracker> speakerTracker;     // Null: no speaker model installed
+    std::atomic<KeywordGate> keywordGate;
+    std::atomic<size_t> keywordGatedUtterances;
+    std::atomic<size_t> denoiseAvoidedUtterances;
     bool useSimpleVAD;  // Fallback if Silero fails
     float vadThreshold;
 
+    // === Segmentation policy ===
+    mutable std::mutex segmenterMutex;
+    SegmenterConfig segmenterConfig;
+
     // === Threading ===
     std::atomic<bool> isRunning;
-    std::unique_ptr<std::thread> micThreadPtr;
+    std::atomic<bool> streamingEnabled;
+    std::atomic<bool> echoSuppressionEnabled;
+    std::atomic<bool> vadGateEnabled;
     std::unique_ptr<std::thread> systemAudioThreadPtr;
     std::unique_ptr<std::thread> processingThreadPtr;
+    bool replayMode;                            // No WASAPI; fed by FeedReplayAudio() / FeedAudio()
+    CaptureSink captureSink;                    // Capture only: packets go here, nothing is transcribed
+    std::unique_ptr<AudioSource> audioSource;   // Replay mode: feeds the rings in place of WASAPI
+    const char* watchdogGroup;                  // Heartbeat group of every thread ("voice")
+    std::atomic<bool> segmentingFrames;         // Processing thread holds frames read from the ring
+    std::atomic<size_t> queuedUtterances;
 
-    // === Audio Buffers (Thread-Safe) ===
-    std::mutex micBufferMutex;
-    std::vector<float> microphoneBuffer;
+    // === Audio Buffers (Lock-free SPSC rings, 16kHz mono) ===
     const size_t MAX_BUFFER_SAMPLES = 16000 * 30; // 30 seconds @ 16kHz
-
-    std::mutex systemAudioBufferMutex;
-    std::vector<float> systemAudioBuffer;
+    std::unique_ptr<AudioRingBuffer> microphoneRing;
+    std::unique_ptr<AudioRingBuffer> systemAudioRing;
 
     // === Transcription Results (Thread-Safe) ===
     std::mutex resultsMutex;
     std::string latestUserSpeech;
+    int latestUserSpeaker;
+    uint64_t latestUserTraceId;
     std::string latestSystemAudio;
 
     // === Transcription Callback ===
     TranscriptionCallback transcriptionCallback;
+    PartialTranscriptionCallback partialCallback;
+    TranscriptionCallback systemAudioCallback;
+    std::string lastDeliveredPartial;   // Guarded by callbackMutex
     std::mutex callbackMutex;
+    KeywordCallback keywordCallback;    // Own mutex: the processing thread must not wait on a delivery
+    std::mutex keywordCallbackMutex;
+    SegmentCallback segmentCallback;    // Under keywordCallbackMutex, also a processing thread hook
 
     // === Performance Metrics ===
     mutable std::mutex metricsMutex;
@@ -146,11 +646,39 @@ private:
     const int CHANNELS = 1;             // Mono
     const int BITS_PER_SAMPLE = 16;     // 16-bit PCM
     const int VAD_CHUNK_MS = 32;        // 32ms chunks for VAD (512 samples for Silero)
+    const int VAD_MAX_BATCH_FRAMES = 16; // Frames classified per VAD call when catching up
+    const size_t VAD_GATE_HANGOVER_FRAMES = 16; // Silero keeps scoring 512ms past the last gate candidate
+    const int VAD_TICK_MS = 10;          // Processing thread wake-up (PowerSettings::vadTickMs default)
+    const int VAD_MAX_TICK_MS = 100;
+    const size_t CHUNK_SPLIT_FRAMES = 4;    // Span averaged when looking for a split point (128ms)
     const int WHISPER_CHUNK_SEC = 3;    // Process 3-second chunks (for testing)
+    const int STREAMING_INTERVAL_MS = 1000;  // Partial re-transcription cadence while speaking
+    const int KWS_HOP_MS = 96;              // Keyword window cadence while speaking (3 VAD frames)
+    const int KWS_COMMAND_MAX_MS = 2000;    // Longest utterance KeywordGate::Commands treats as a bare command
+    const wchar_t* const KWS_MODEL_PATH = L"models/kws/kws.onnx";
+    const char* const KWS_LABELS_PATH = "models/kws/labels.txt";
+    const wchar_t* const SPEAKER_MODEL_PATH = L"models/speaker/speaker.onnx";
+    const wchar_t* const DENOISE_MODEL_PATH = L"models/denoise/denoise.onnx";
+    const size_t MAX_CAPTURE_ENDPOINTS = 4;         // Microphones captured at once (multi-endpoint mode)
+    const float ENDPOINT_SWITCH_MARGIN_DB = 3.0f;   // SNR lead another endpoint needs to take over
+    const int ENDPOINT_MAX_SKEW_MS = 200;           // Ring lead beyond which an endpoint is realigned (clock drift)
+    const int ENDPOINT_STALL_MS = 500;              // No packets for this long: the endpoint isn't waited for
+    const int SPEAKER_WAIT_MS = 100;        // Longest a delivery waits for its utterance's speaker
+    const float MARGINAL_VAD_CONFIDENCE = 0.65f;     // Mean Silero probability below which an utterance
+                                                     // yields to real speech in the whisper queue
+    const float SYSTEM_AUDIO_SILENCE_PEAK = 0.001f;  // -60 dBFS: quieter loopback batches skip the VAD
+    const int WHISPER_WORKERS = 2;      // whisper_state pool size (model loaded once)
+    const int SHARED_WHISPER_WORKERS = 1;   // ... for an InitializeShared() engine (one per session)
+    const int WHISPER_PROCESS_WORKERS = 3;  // Out of process: most worker processes under load
+    const int WHISPER_GPU_THREADS = 2;  // Per worker when offloaded: only mel + sampling stay on the CPU
+    const float WHISPER_LATENCY_SLO_MS = 2000.0f;  // Predicted primary latency that triggers the fast tier
+    const size_t WHISPER_BACKLOG_DEPTH = 2;        // Queued utterances that trigger the fast tier
+    const int WHISPER_SHORT_UTTERANCE_SEC = 8;     // Longer utterances always get the primary model
+    const DWORD CAPTURE_WAIT_TIMEOUT_MS = 100;  // Event wait timeout so Stop() is noticed promptly
+    const int CAPTURE_STALL_MS = 2000;          // Watchdog timeout for the capture threads
+    const int PROCESSING_STALL_MS = 5000;       // ... and the processing thread (VAD, queueing)
 
     // === Helper Functions ===
     void LogDebug(const std::string& message);
     void LogError(const std::string& message);
-    std::vector<float> ConvertPCMToFloat(const BYTE* pcmData, UINT32 numFrames);
-    std::vector<float> ResampleAudio(const std::vector<float>& input, int inputSampleRate, int outputSampleRate);
 };
@@ -0,0 +1,424 @@
+#include "AudioResampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define AUDIO_RESAMPLER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits AVX intrinsics without /arch:AVX; GCC/Clang need a per-function target
+#if defined(AUDIO_RESAMPLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define AUDIO_RESAMPLER_AVX_TARGET __attribute__((target("avx")))
+#else
+#define AUDIO_RESAMPLER_AVX_TARGET
+#endif
+
+// ============================================================================
+// SIMD Helpers
+// ============================================================================
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+bool CpuSupportsAVX() {
+#if defined(AUDIO_RESAMPLER_X86) && defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) {
+        return false;
+    }
+    // OS must save YMM state on context switch
+    unsigned long long xcr0 = _xgetbv(0);
+    return (xcr0 & 0x6) == 0x6;
+#elif defined(AUDIO_RESAMPLER_X86) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_cpu_supports("avx") != 0;
+#else
+    return false;
+#endif
+}
+
+// Modified Bessel function of the first kind, order 0 (Kaiser window)
+double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x / 2.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// count is always a multiple of 8
+#ifndef AUDIO_RESAMPLER_X86
+float DotProductScalar(const float* a, const float* b, int count) {
+    float sum = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+#else
+float DotProductSSE(const float* a, const float* b, int count) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (int i = 0; i < count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(acc);
+}
+
+AUDIO_RESAMPLER_AVX_TARGET
+float DotProductAVX(const float* a, const float* b, int count) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int i = 0; i < count; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum);
+}
+#endif
+
+} // namespace
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+AudioResampler::AudioResampler()
+    : inputRate(0)
+    , outputRate(0)
+    , channels(0)
+    , format(SampleFormat::Unsupported)
+    , downmix(nullptr)
+    , upFactor(1)
+    , downFactor(1)
+    , numPhases(1)
+    , tapsPerPhase(8)
+    , historyLength(0)
+    , nextInput(0)
+    , phase(0)
+    , useAVX(CpuSupportsAVX())
+{
+}
+
+bool AudioResampler::Configure(int inputSampleRate, int outputSampleRate, int channelCount, SampleFormat sampleFormat) {
+    if (inputSampleRate <= 0 || outputSampleRate <= 0 || channelCount <= 0 ||
+        sampleFormat == SampleFormat::Unsupported) {
+        format = SampleFormat::Unsupported;
+        return false;
+    }
+
+    inputRate = inputSampleRate;
+    outputRate = outputSampleRate;
+    channels = channelCount;
+    format = sampleFormat;
+    downmix = SelectDownmix(sampleFormat, channelCount);
+
+    uint32_t divisor = static_cast<uint32_t>(std::gcd(inputRate, outputRate));
+    upFactor = static_cast<uint32_t>(outputRate) / divisor;
+    downFactor = static_cast<uint32_t>(inputRate) / divisor;
+
+    if (!IsPassthrough()) {
+        BuildFilterBank();
+    }
+
+    Reset();
+    return true;
+}
+
+void AudioResampler::BuildFilterBank() {
+    // Cutoff in cycles per input sample, below the lower of the two Nyquist rates
+    double cutoff = 0.5 * CUTOFF_RATIO * (std::min)(1.0, static_cast<double>(outputRate) / inputRate);
+
+    int taps = static_cast<int>(std::ceil(ZERO_CROSSINGS / cutoff));
+    tapsPerPhase = (taps + 7) & ~7;
+    numPhases = static_cast<int>((std::min)(upFactor, static_cast<uint32_t>(MAX_PHASES)));
+
+    coefficients.assign(static_cast<size_t>(numPhases) * tapsPerPhase, 0.0f);
+
+    const double halfLength = taps / 2.0;
+    const double besselBeta = BesselI0(KAISER_BETA);
+    const int padding = tapsPerPhase - taps;
+
+    for (int q = 0; q < numPhases; ++q) {
+        double fraction = static_cast<double>(q) / numPhases;
+        float* bank = &coefficients[static_cast<size_t>(q) * tapsPerPhase];
+        double sum = 0.0;
+
+        for (int d = 0; d < taps; ++d) {
+            // d samples back from the newest input; centred on halfLength
+            double u = d + fraction - halfLength;
+            double x = u / halfLength;
+            double window = (std::abs(x) <= 1.0)
+                ? BesselI0(KAISER_BETA * std::sqrt(1.0 - x * x)) / besselBeta
+                : 0.0;
+            double arg = 2.0 * cutoff * u;
+            double sinc = (std::abs(arg) < 1e-9) ? 1.0 : std::sin(PI * arg) / (PI * arg);
+            double value = 2.0 * cutoff * sinc * window;
+
+            // Oldest sample first; zero padding sits in front
+            bank[padding + (taps - 1 - d)] = static_cast<float>(value);
+            sum += value;
+        }
+
+        // Unity DC gain per phase
+        if (sum != 0.0) {
+            for (int j = 0; j < tapsPerPhase; ++j) {
+                bank[j] = static_cast<float>(bank[j] / sum);
+            }
+        }
+    }
+}
+
+void AudioResampler::Reset() {
+    phase = 0;
+    if (IsPassthrough()) {
+        historyLength = 0;
+        nextInput = 0;
+        return;
+    }
+
+    historyLength = static_cast<size_t>(tapsPerPhase) - 1;
+    nextInput = historyLength;
+    if (workBuffer.size() < historyLength) {
+        workBuffer.resize(historyLength);
+    }
+    std::fill(workBuffer.begin(), workBuffer.begin() + historyLength, 0.0f);
+}
+
+size_t AudioResampler::MaxOutputFrames(size_t inputFrames) const {
+    if (IsPassthrough()) {
+        return inputFrames;
+    }
+    return (inputFrames * upFactor) / downFactor + 2;
+}
+
+// ============================================================================
+// Processing
+// ============================================================================
+
+size_t AudioResampler::Process(const void* interleaved, size_t numFrames, float* out, size_t outCapacity) {
+    if (!IsConfigured() || !interleaved || !out || numFrames == 0) {
+        return 0;
+    }
+
+    if (IsPassthrough()) {
+        size_t count = (std::min)(numFrames, outCapacity);
+        Downmix(interleaved, count, out);
+        return count;
+    }
+
+    // Grows only until the largest packet has been seen
+    const size_t total = historyLength + numFrames;
+    if (workBuffer.size() < total) {
+        workBuffer.resize(total);
+    }
+    Downmix(interleaved, numFrames, workBuffer.data() + historyLength);
+
+    const float* samples = workBuffer.data();
+    const size_t windowOffset = static_cast<size_t>(tapsPerPhase) - 1;
+    size_t written = 0;
+
+    while (nextInput < total && written < outCapacity) {
+        uint32_t bankIndex = static_cast<uint32_t>((static_cast<uint64_t>(phase) * numPhases) / upFactor);
+        const float* bank = &coefficients[static_cast<size_t>(bankIndex) * tapsPerPhase];
+        const float* window = samples + (nextInput - windowOffset);
+
+#ifdef AUDIO_RESAMPLER_X86
+        out[written++] = useAVX ? DotProductAVX(bank, window, tapsPerPhase)
+                                : DotProductSSE(bank, window, tapsPerPhase);
+#else
+        out[written++] = DotProductScalar(bank, window, tapsPerPhase);
+#endif
+
+        phase += downFactor;
+        nextInput += phase / upFactor;
+        phase %= upFactor;
+    }
+
+    // Carry the tail forward as history for the next packet
+    const size_t keepFrom = total - historyLength;
+    std::memmove(workBuffer.data(), workBuffer.data() + keepFrom, historyLength * sizeof(float));
+    nextInput -= keepFrom;
+
+    return written;
+}
+
+// ============================================================================
+// Downmix Kernels
+// ============================================================================
+
+namespace {
+
+using Kernel = void (*)(const void* interleaved, size_t numFrames, int channels, float* dst);
+
+// One per sample type: its size and how it becomes a float in [-1, 1)
+struct Int16Sample {
+    static constexpr size_t BYTES = 2;
+    static constexpr float SCALE = 1.0f / 32768.0f;
+    static float Load(const uint8_t* p) {
+        int16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return static_cast<float>(value);
+    }
+};
+
+struct Int24Sample {
+    static constexpr size_t BYTES = 3;
+    static constexpr float SCALE = 1.0f / 8388608.0f;
+    // Assembled in the top three bytes, then shifted down so the sign extends
+    static float Load(const uint8_t* p) {
+        uint32_t bits = (static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) |
+                        (static_cast<uint32_t>(p[2]) << 24);
+        return static_cast<float>(static_cast<int32_t>(bits) >> 8);
+    }
+};
+
+struct Int32Sample {
+    static constexpr size_t BYTES = 4;
+    static constexpr float SCALE = 1.0f / 2147483648.0f;
+    static float Load(const uint8_t* p) {
+        int32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return static_cast<float>(value);
+    }
+};
+
+struct Float32Sample {
+    static constexpr size_t BYTES = 4;
+    static constexpr float SCALE = 1.0f;
+    static float Load(const uint8_t* p) {
+        float value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+};
+
+// Channels > 0 fixes the layout at compile time; 0 reads it from `channels`
+template <typename Sample, int Channels>
+void DownmixFrames(const void* interleaved, size_t numFrames, int channels, float* dst) {
+    const int count = Channels > 0 ? Channels : channels;
+    const uint8_t* src = static_cast<const uint8_t*>(interleaved);
+    const size_t stride = Sample::BYTES * static_cast<size_t>(count);
+    const float scale = Sample::SCALE / count;
+    for (size_t i = 0; i < numFrames; ++i) {
+        const uint8_t* frame = src + i * stride;
+        float mono = 0.0f;
+        for (int ch = 0; ch < count; ++ch) {
+            mono += Sample::Load(frame + ch * Sample::BYTES);
+        }
+        dst[i] = mono * scale;
+    }
+}
+
+template <>
+void DownmixFrames<Float32Sample, 1>(const void* interleaved, size_t numFrames, int, float* dst) {
+    std::memcpy(dst, interleaved, numFrames * sizeof(float));
+}
+
+#ifdef AUDIO_RESAMPLER_X86
+template <>
+void DownmixFrames<Float32Sample, 2>(const void* interleaved, size_t numFrames, int, float* dst) {
+    const float* src = static_cast<const float*>(interleaved);
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 a = _mm_loadu_ps(src + i * 2);       // L0 R0 L1 R1
+        __m128 b = _mm_loadu_ps(src + i * 2 + 4);   // L2 R2 L3 R3
+        __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+    }
+    for (; i < numFrames; ++i) {
+        dst[i] = (src[i * 2] + src[i * 2 + 1]) * 0.5f;
+    }
+}
+
+template <>
+void DownmixFrames<Int16Sample, 1>(const void* interleaved, size_t numFrames, int, float* dst) {
+    const int16_t* src = static_cast<const int16_t*>(interleaved);
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= numFrames; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    for (; i < numFrames; ++i) {
+        dst[i] = src[i] * (1.0f / 32768.0f);
+    }
+}
+
+template <>
+void DownmixFrames<Int16Sample, 2>(const void* interleaved, size_t numFrames, int, float* dst) {
+    const int16_t* src = static_cast<const int16_t*>(interleaved);
+    // madd against ones sums each L/R pair into one int32
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+    size_t i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        __m128i sums = _mm_madd_epi16(v, ones);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(sums), scale));
+    }
+    for (; i < numFrames; ++i) {
+        dst[i] = (static_cast<int32_t>(src[i * 2]) + src[i * 2 + 1]) * (1.0f / 65536.0f);
+    }
+}
+#endif
+
+// Fixed layouts for the channel counts WASAPI mix formats actually use
+template <typename Sample>
+Kernel ForChannels(int channels) {
+    switch (channels) {
+        case 1:  return &DownmixFrames<Sample, 1>;
+        case 2:  return &DownmixFrames<Sample, 2>;
+        case 4:  return &DownmixFrames<Sample, 4>;
+        case 6:  return &DownmixFrames<Sample, 6>;
+        case 8:  return &DownmixFrames<Sample, 8>;
+        default: return &DownmixFrames<Sample, 0>;
+    }
+}
+
+} // namespace
+
+AudioResampler::DownmixKernel AudioResampler::SelectDownmix(SampleFormat format, int channels) {
+    switch (format) {
+        case SampleFormat::Int16:   return ForChannels<Int16Sample>(channels);
+        case SampleFormat::Int24:   return ForChannels<Int24Sample>(channels);
+        case SampleFormat::Int32:   return ForChannels<Int32Sample>(channels);
+        case SampleFormat::Float32: return ForChannels<Float32Sample>(channels);
+        default:                    return nullptr;
+    }
+}
+
+size_t AudioResampler::BytesPerSample(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::Int16:   return Int16Sample::BYTES;
+        case SampleFormat::Int24:   return Int24Sample::BYTES;
+        case SampleFormat::Int32:   return Int32Sample::BYTES;
+        case SampleFormat::Float32: return Float32Sample::BYTES;
+        default:                    return 0;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * AudioResampler - Interleaved PCM -> 16kHz mono conversion kernel
+ *
+ * Replaces the per-packet ConvertPCMToFloat/ResampleAudio pair in
+ * AudioCaptureEngine. One instance per capture stream; the FIR history and
+ * phase carry over between WASAPI packets so packet boundaries are seamless.
+ *
+ * Features:
+ * - int16 / packed int24 / int32 / float32 input, any channel count
+ * - Downmix kernels are templates over (sample type x channel count), one
+ *   picked by Configure(): the per-packet path has no format or channel
+ *   branches, and the common layouts (1, 2, 4, 6, 8 channels) get loops with
+ *   a constant stride the compiler can unroll and vectorize; SSE2 versions
+ *   for int16/float32 mono and stereo
+ * - Rational polyphase resampler with a Kaiser-windowed sinc (e.g. 48k -> 16k
+ *   is L/M = 1/3, 44.1k -> 16k is 160/441); cutoff at 90% of output Nyquist
+ * - FIR dot product uses AVX when the CPU supports it, SSE otherwise
+ * - Writes straight into a caller-supplied span; no allocation per packet
+ *   once the internal work buffer has grown to the largest packet size
+ *
+ * Usage:
+ *   AudioResampler resampler;
+ *   resampler.Configure(48000, 16000, 2, AudioResampler::SampleFormat::Float32);
+ *   std::vector<float> out(resampler.MaxOutputFrames(packetFrames));
+ *   size_t n = resampler.Process(pData, packetFrames, out.data(), out.size());
+ */
+class AudioResampler {
+public:
+    enum class SampleFormat {
+        Unsupported,
+        Int16,
+        Int24,          // Packed, 3 bytes per sample
+        Int32,          // Also 24-bit samples left-justified in 32-bit containers
+        Float32
+    };
+
+    // Bytes one sample of the format occupies (0 for Unsupported)
+    static size_t BytesPerSample(SampleFormat format);
+
+    AudioResampler();
+
+    // Build the filter bank; returns false for unsupported formats/rates
+    bool Configure(int inputSampleRate, int outputSampleRate, int channels, SampleFormat format);
+
+    // Upper bound on output frames produced by one Process() call
+    size_t MaxOutputFrames(size_t inputFrames) const;
+
+    // Convert numFrames interleaved input frames; returns mono frames written.
+    // outCapacity must be at least MaxOutputFrames(numFrames).
+    size_t Process(const void* interleaved, size_t numFrames, float* out, size_t outCapacity);
+
+    // Drop filter history (e.g. after a stream restart)
+    void Reset();
+
+    bool IsConfigured() const { return format != SampleFormat::Unsupported; }
+    bool IsPassthrough() const { return upFactor == downFactor; }
+
+private:
+    // Interleaved input -> mono float; channels is only read by the any-count kernels
+    using DownmixKernel = void (*)(const void* interleaved, size_t numFrames, int channels, float* dst);
+
+    static DownmixKernel SelectDownmix(SampleFormat format, int channels);
+
+    void Downmix(const void* interleaved, size_t numFrames, float* dst) const {
+        downmix(interleaved, numFrames, channels, dst);
+    }
+
+    void BuildFilterBank();
+
+    // Filter design
+    static constexpr int ZERO_CROSSINGS = 16;       // Per side, at the lower of the two rates
+    static constexpr int MAX_PHASES = 256;          // Cap for awkward rate ratios
+    static constexpr double CUTOFF_RATIO = 0.9;     // Fraction of output Nyquist
+    static constexpr double KAISER_BETA = 8.6;      // ~ -90dB stopband
+
+    int inputRate;
+    int outputRate;
+    int channels;
+    SampleFormat format;
+    DownmixKernel downmix;
+
+    // Rational ratio: outputRate / inputRate = upFactor / downFactor
+    uint32_t upFactor;
+    uint32_t downFactor;
+
+    // Polyphase bank: numPhases filters of tapsPerPhase coefficients (zero-padded at
+    // the front to a multiple of 8), stored oldest-sample-first so the dot product
+    // runs over contiguous history ending at the current input sample
+    int numPhases;
+    int tapsPerPhase;
+    std::vector<float> coefficients;
+
+    // Streaming state: [historyLength carried samples][current packet]
+    std::vector<float> workBuffer;
+    size_t historyLength;       // tapsPerPhase - 1
+    size_t nextInput;           // Work-buffer index of the newest sample under the next output
+    uint32_t phase;             // Fractional position of the next output, in 1/upFactor steps
+
+    bool useAVX;
+};
@@ -0,0 +1,106 @@
+#include "AudioRingBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AudioRingBuffer::AudioRingBuffer(size_t minCapacity)
+    : capacity(RoundUpToPowerOfTwo((std::max)(minCapacity, static_cast<size_t>(1))))
+    , mask(0)
+    , writePos(0)
+    , readPos(0)
+    , droppedSamples(0)
+{
+    mask = capacity - 1;
+    storage.resize(capacity, 0.0f);
+}
+
+size_t AudioRingBuffer::Write(const float* data, size_t count) {
+    if (!data || count == 0) {
+        return 0;
+    }
+
+    const uint64_t write = writePos.load(std::memory_order_relaxed);
+    const uint64_t read = readPos.load(std::memory_order_acquire);
+    const size_t freeSpace = capacity - static_cast<size_t>(write - read);
+
+    size_t toWrite = (std::min)(count, freeSpace);
+    if (toWrite < count) {
+        droppedSamples.fetch_add(count - toWrite, std::memory_order_relaxed);
+    }
+    if (toWrite == 0) {
+        return 0;
+    }
+
+    const size_t start = static_cast<size_t>(write) & mask;
+    const size_t firstPart = (std::min)(toWrite, capacity - start);
+    std::memcpy(&storage[start], data, firstPart * sizeof(float));
+    if (firstPart < toWrite) {
+        std::memcpy(&storage[0], data + firstPart, (toWrite - firstPart) * sizeof(float));
+    }
+
+    // Publish the samples to the consumer
+    writePos.store(write + toWrite, std::memory_order_release);
+    return toWrite;
+}
+
+size_t AudioRingBuffer::Read(float* out, size_t maxCount) {
+    const uint64_t read = readPos.load(std::memory_order_relaxed);
+    const uint64_t write = writePos.load(std::memory_order_acquire);
+    const size_t toRead = (std::min)(maxCount, static_cast<size_t>(write - read));
+
+    if (toRead == 0) {
+        return 0;
+    }
+
+    CopyOut(read, out, toRead);
+
+    // Hand the slots back to the producer
+    readPos.store(read + toRead, std::memory_order_release);
+    return toRead;
+}
+
+size_t AudioRingBuffer::Peek(float* out, size_t maxCount) const {
+    const uint64_t read = readPos.load(std::memory_order_relaxed);
+    const uint64_t write = writePos.load(std::memory_order_acquire);
+    const size_t toRead = (std::min)(maxCount, static_cast<size_t>(write - read));
+
+    if (toRead > 0) {
+        CopyOut(read, out, toRead);
+    }
+    return toRead;
+}
+
+size_t AudioRingBuffer::Skip(size_t count) {
+    const uint64_t read = readPos.load(std::memory_order_relaxed);
+    const uint64_t write = writePos.load(std::memory_order_acquire);
+    const size_t toSkip = (std::min)(count, static_cast<size_t>(write - read));
+
+    readPos.store(read + toSkip, std::memory_order_release);
+    return toSkip;
+}
+
+void AudioRingBuffer::Clear() {
+    readPos.store(writePos.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t AudioRingBuffer::Available() const {
+    const uint64_t write = writePos.load(std::memory_order_acquire);
+    const uint64_t read = readPos.load(std::memory_order_acquire);
+    return static_cast<size_t>(write - read);
+}
+
+void AudioRingBuffer::CopyOut(uint64_t from, float* out, size_t count) const {
+    const size_t start = static_cast<size_t>(from) & mask;
+    const size_t firstPart = (std::min)(count, capacity - start);
+    std::memcpy(out, &storage[start], firstPart * sizeof(float));
+    if (firstPart < count) {
+        std::memcpy(out + firstPart, &storage[0], (count - firstPart) * sizeof(float));
+    }
+}
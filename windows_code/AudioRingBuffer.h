@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * AudioRingBuffer - Lock-free single-producer/single-consumer sample ring
+ *
+ * Replaces the mutex-guarded std::vector buffers in AudioCaptureEngine.
+ * The capture thread is the only writer and the processing thread is the
+ * only reader, so both cursors can be advanced with plain acquire/release
+ * atomics and no lock is ever taken on the audio path.
+ *
+ * Features:
+ * - Fixed capacity (rounded up to a power of two), allocated once
+ * - Monotonic 64-bit cursors: available = write - read, no wrap ambiguity
+ * - No per-packet allocation or memmove; copies are at most two memcpy's
+ * - When the reader falls behind and the ring is full, new samples are
+ *   dropped and counted instead of blocking the capture thread
+ *
+ * Usage:
+ *   AudioRingBuffer ring(16000 * 30);      // 30 seconds @ 16kHz
+ *   ring.Write(samples, count);            // capture thread
+ *   size_t n = ring.Read(out, maxCount);   // processing thread
+ */
+class AudioRingBuffer {
+public:
+    explicit AudioRingBuffer(size_t minCapacity);
+
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    // === Producer side (capture thread only) ===
+
+    // Append samples; returns how many were stored (rest are dropped if full)
+    size_t Write(const float* data, size_t count);
+
+    // Samples dropped because the reader was too far behind
+    uint64_t GetDroppedSamples() const { return droppedSamples.load(std::memory_order_relaxed); }
+
+    // === Consumer side (processing thread only) ===
+
+    // Copy up to maxCount samples into out and advance the read cursor
+    size_t Read(float* out, size_t maxCount);
+
+    // Copy up to maxCount samples into out without advancing the read cursor
+    size_t Peek(float* out, size_t maxCount) const;
+
+    // Advance the read cursor without copying; returns samples skipped
+    size_t Skip(size_t count);
+
+    // Discard everything currently readable
+    void Clear();
+
+    // === Either side ===
+
+    // Samples currently readable (a lower bound for the producer's view)
+    size_t Available() const;
+
+    size_t Capacity() const { return capacity; }
+
+    // Total samples ever written / read (monotonic stream positions)
+    uint64_t GetWritePosition() const { return writePos.load(std::memory_order_acquire); }
+    uint64_t GetReadPosition() const { return readPos.load(std::memory_order_acquire); }
+
+private:
+    void CopyOut(uint64_t from, float* out, size_t count) const;
+
+    std::vector<float> storage;
+    size_t capacity;
+    size_t mask;
+
+    // Cursors live on separate cache lines so producer and consumer
+    // don't false-share on every packet
+    alignas(64) std::atomic<uint64_t> writePos;
+    alignas(64) std::atomic<uint64_t> readPos;
+    alignas(64) std::atomic<uint64_t> droppedSamples;
+};
@@ -0,0 +1,571 @@
+#include "AudioSource.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "AudioCaptureEngine.h"
+#include "CpuBudget.h"
+#include "Log.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+uint16_t ReadU16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+uint32_t ReadU32(const uint8_t* p) { return ReadU16(p) | (static_cast<uint32_t>(ReadU16(p + 2)) << 16); }
+
+bool StartsWith(const std::string& text, const char* prefix, std::string& rest) {
+    size_t length = std::strlen(prefix);
+    if (text.compare(0, length, prefix) != 0) {
+        return false;
+    }
+    rest = text.substr(length);
+    return true;
+}
+
+// G.711 expansions (ITU-T G.711, as in every softphone)
+int16_t DecodeMuLaw(uint8_t value) {
+    value = static_cast<uint8_t>(~value);
+    int magnitude = ((value & 0x0F) << 3) + 0x84;
+    magnitude <<= (value & 0x70) >> 4;
+    return static_cast<int16_t>((value & 0x80) ? 0x84 - magnitude : magnitude - 0x84);
+}
+
+int16_t DecodeALaw(uint8_t value) {
+    value ^= 0x55;
+    int magnitude = (value & 0x0F) << 4;
+    int segment = (value & 0x70) >> 4;
+    if (segment == 0) {
+        magnitude += 8;
+    } else {
+        magnitude = (magnitude + 0x108) << (segment - 1);
+    }
+    return static_cast<int16_t>((value & 0x80) ? magnitude : -magnitude);
+}
+
+}  // namespace
+
+// ============================================================================
+// AudioSource
+// ============================================================================
+
+std::unique_ptr<AudioSource> AudioSource::Create(const std::string& spec, std::string& error) {
+    std::string rest;
+    if (spec == "live") {
+        return std::make_unique<LiveAudioSource>();
+    }
+    if (StartsWith(spec, "file:", rest) || StartsWith(spec, "file-max:", rest)) {
+        Pacing filePacing = spec.compare(0, 9, "file-max:") == 0 ? Pacing::MaxSpeed : Pacing::RealTime;
+        auto source = std::make_unique<WavFileSource>(rest, filePacing);
+        if (!source->Open(error)) {
+            return nullptr;
+        }
+        return source;
+    }
+    if (StartsWith(spec, "rtp:", rest)) {
+        int port = std::atoi(rest.c_str());
+        if (port <= 0 || port > 65535) {
+            error = "bad RTP port: " + rest;
+            return nullptr;
+        }
+        return std::make_unique<RtpAudioSource>(static_cast<uint16_t>(port));
+    }
+    if (StartsWith(spec, "synthetic", rest)) {
+        Pacing synthPacing = Pacing::RealTime;
+        if (rest.compare(0, 4, "-max") == 0) {
+            synthPacing = Pacing::MaxSpeed;
+            rest = rest.substr(4);
+        }
+        double seconds = 0.0;
+        if (!rest.empty()) {
+            seconds = rest[0] == ':' ? std::atof(rest.c_str() + 1) : -1.0;
+            if (seconds <= 0.0) {
+                error = "bad synthetic duration: " + rest;
+                return nullptr;
+            }
+        }
+        return std::make_unique<SyntheticAudioSource>(synthPacing, seconds);
+    }
+    error = "unknown audio source: " + spec;
+    return nullptr;
+}
+
+bool AudioSource::Deliver(bool systemAudio, const float* samples, size_t count) {
+    size_t accepted = 0;
+    while (running.load()) {
+        accepted += sink(systemAudio, samples + accepted, count - accepted);
+        if (accepted >= count || pacing == Pacing::RealTime) {
+            return true;
+        }
+        // Ring full: the engine is behind, offer the rest again shortly
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+bool AudioSource::LoadWav(const std::string& path, WavData& wav, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) != 0 || std::memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        error = "not a RIFF/WAVE file";
+        return false;
+    }
+
+    bool haveFormat = false;
+    size_t offset = 12;
+    while (offset + 8 <= bytes.size()) {
+        const uint8_t* chunk = bytes.data() + offset;
+        size_t size = ReadU32(chunk + 4);
+        size_t body = offset + 8;
+        size = (std::min)(size, bytes.size() - body);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            const uint8_t* fmt = bytes.data() + body;
+            uint16_t tag = ReadU16(fmt);
+            if (tag == 0xFFFE && size >= 26) {
+                tag = ReadU16(fmt + 24);            // SubFormat GUID starts with the format tag
+            }
+            wav.channels = ReadU16(fmt + 2);
+            wav.sampleRate = static_cast<int>(ReadU32(fmt + 4));
+            wav.bytesPerFrame = ReadU16(fmt + 12);
+            uint16_t bits = ReadU16(fmt + 14);
+            if (tag == 1 && bits == 16) {
+                wav.format = AudioResampler::SampleFormat::Int16;
+            } else if (tag == 1 && bits == 24) {
+                wav.format = AudioResampler::SampleFormat::Int24;
+            } else if (tag == 1 && bits == 32) {
+                wav.format = AudioResampler::SampleFormat::Int32;
+            } else if (tag == 3 && bits == 32) {
+                wav.format = AudioResampler::SampleFormat::Float32;
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            wav.data.assign(bytes.begin() + body, bytes.begin() + body + size);
+        }
+        offset = body + size + (size & 1);          // Chunks are word-aligned
+    }
+
+    if (!haveFormat || wav.data.empty()) {
+        error = "missing fmt or data chunk";
+        return false;
+    }
+    if (wav.format == AudioResampler::SampleFormat::Unsupported || wav.channels <= 0 || wav.bytesPerFrame == 0) {
+        error = "unsupported sample format (need 16-bit PCM or 32-bit float)";
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// LiveAudioSource
+// ============================================================================
+
+LiveAudioSource::LiveAudioSource() = default;
+
+LiveAudioSource::~LiveAudioSource() {
+    Stop();
+}
+
+bool LiveAudioSource::Start(Sink target) {
+    sink = std::move(target);
+    running.store(true);
+    capture = std::make_unique<AudioCaptureEngine>();
+    // WASAPI never waits on a consumer: what the ring can't take is dropped, as live
+    bool started = capture->InitializeCaptureOnly([this](bool systemAudio, const float* samples, size_t count) {
+        sink(systemAudio, samples, count);
+    }) && capture->Start();
+    if (!started) {
+        LOG_ERROR("AudioSource", "Live capture failed to start");
+        capture.reset();
+        running.store(false);
+        return false;
+    }
+    return true;
+}
+
+void LiveAudioSource::Stop() {
+    running.store(false);
+    if (capture) {
+        capture->Stop();
+        capture.reset();
+    }
+}
+
+// ============================================================================
+// WavFileSource
+// ============================================================================
+
+WavFileSource::WavFileSource(const std::string& path, Pacing filePacing)
+    : path(path) {
+    pacing = filePacing;
+}
+
+WavFileSource::~WavFileSource() {
+    Stop();
+}
+
+bool WavFileSource::Open(std::string& error) {
+    if (!LoadWav(path, wav, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    if (!resampler.Configure(wav.sampleRate, SAMPLE_RATE, wav.channels, wav.format)) {
+        error = path + ": cannot resample " + std::to_string(wav.sampleRate) + " Hz";
+        return false;
+    }
+    LOG_INFO("AudioSource", "WAV source " << path << ": " << wav.sampleRate << " Hz, " << wav.channels
+             << " channels, " << (wav.Frames() / wav.sampleRate) << " s ("
+             << (pacing == Pacing::MaxSpeed ? "max speed" : "real time") << ")");
+    return true;
+}
+
+bool WavFileSource::Start(Sink target) {
+    if (!resampler.IsConfigured()) {
+        LOG_ERROR("AudioSource", "WAV source " << path << " is not open");
+        return false;
+    }
+    sink = std::move(target);
+    finished.store(false);
+    running.store(true);
+    thread = std::thread(&WavFileSource::FeedThread, this);
+    return true;
+}
+
+void WavFileSource::Stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void WavFileSource::FeedThread() {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Capture);
+    TRACE_THREAD("WAV source");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Capture);
+
+    const size_t packetFrames = (std::max)(static_cast<size_t>(wav.sampleRate * PACKET_MS / 1000), size_t(1));
+    std::vector<float> packet(resampler.MaxOutputFrames(packetFrames));
+    const size_t totalFrames = wav.Frames();
+    auto start = std::chrono::steady_clock::now();
+
+    resampler.Reset();
+    for (size_t frame = 0; frame < totalFrames && running.load(); frame += packetFrames) {
+        size_t frames = (std::min)(packetFrames, totalFrames - frame);
+        if (pacing == Pacing::RealTime) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(
+                static_cast<int64_t>(frame * 1000000.0 / wav.sampleRate)));
+        }
+        size_t produced = resampler.Process(wav.data.data() + frame * wav.bytesPerFrame, frames,
+                                            packet.data(), packet.size());
+        Deliver(false, packet.data(), produced);
+    }
+
+    // Trailing silence closes the last utterance
+    std::vector<float> silence(SAMPLE_RATE * PACKET_MS / 1000, 0.0f);
+    for (int ms = 0; ms < TRAILING_SILENCE_MS && running.load(); ms += PACKET_MS) {
+        if (pacing == Pacing::RealTime) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(PACKET_MS));
+        }
+        Deliver(false, silence.data(), silence.size());
+    }
+
+    LOG_INFO("AudioSource", "WAV source " << path << " finished");
+    finished.store(true);
+}
+
+// ============================================================================
+// RtpAudioSource
+// ============================================================================
+
+RtpAudioSource::RtpAudioSource(uint16_t port)
+    : port(port)
+    , socketHandle(static_cast<uintptr_t>(INVALID_SOCKET))
+    , payloadType(-1)
+    , clockRate(0)
+    , channels(0) {
+}
+
+RtpAudioSource::~RtpAudioSource() {
+    Stop();
+}
+
+bool RtpAudioSource::Start(Sink target) {
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOG_ERROR("AudioSource", "WSAStartup failed");
+        return false;
+    }
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET) {
+        LOG_ERROR("AudioSource", "RTP socket failed: " << WSAGetLastError());
+        WSACleanup();
+        return false;
+    }
+    DWORD timeout = RECEIVE_TIMEOUT_MS;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    int bufferBytes = 1 << 20;      // Rides out a scheduling hiccup without loss
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&bufferBytes), sizeof(bufferBytes));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+        LOG_ERROR("AudioSource", "RTP bind to port " << port << " failed: " << WSAGetLastError());
+        closesocket(sock);
+        WSACleanup();
+        return false;
+    }
+
+    socketHandle = static_cast<uintptr_t>(sock);
+    sink = std::move(target);
+    payloadType = -1;
+    running.store(true);
+    thread = std::thread(&RtpAudioSource::ReceiveThread, this);
+    LOG_INFO("AudioSource", "RTP source listening on UDP port " << port);
+    return true;
+}
+
+void RtpAudioSource::Stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (static_cast<SOCKET>(socketHandle) != INVALID_SOCKET) {
+        closesocket(static_cast<SOCKET>(socketHandle));
+        socketHandle = static_cast<uintptr_t>(INVALID_SOCKET);
+        WSACleanup();
+    }
+}
+
+bool RtpAudioSource::Decode(int type, const uint8_t* payload, size_t size, size_t& frames) {
+    int rate = 0;
+    int count = 0;
+    if (type == 0 || type == 8) {
+        rate = 8000;
+        count = 1;
+        pcm.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            pcm[i] = type == 0 ? DecodeMuLaw(payload[i]) : DecodeALaw(payload[i]);
+        }
+    } else if (type == 10 || type == 11 || type >= 96) {
+        rate = type >= 96 ? SAMPLE_RATE : 44100;
+        count = type == 10 ? 2 : 1;
+        pcm.resize(size / 2);
+        for (size_t i = 0; i < pcm.size(); ++i) {
+            pcm[i] = static_cast<int16_t>((payload[2 * i] << 8) | payload[2 * i + 1]);  // Network order
+        }
+    } else {
+        return false;
+    }
+
+    if (type != payloadType) {
+        if (!resampler.Configure(rate, SAMPLE_RATE, count, AudioResampler::SampleFormat::Int16)) {
+            return false;
+        }
+        LOG_INFO("AudioSource", "RTP payload type " << type << ": " << rate << " Hz, " << count << " channel(s)");
+        payloadType = type;
+        clockRate = rate;
+        channels = count;
+    }
+    frames = pcm.size() / channels;
+    return true;
+}
+
+void RtpAudioSource::ReceiveThread() {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Capture);
+    TRACE_THREAD("RTP source");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Capture);
+    SOCKET sock = static_cast<SOCKET>(socketHandle);
+
+    std::vector<uint8_t> packet(65536);
+    bool started = false;
+    uint32_t ssrc = 0;
+    uint16_t lastSequence = 0;
+    uint32_t nextTimestamp = 0;
+    std::vector<float> silence;
+    uint64_t unsupported = 0;
+
+    while (running.load()) {
+        int received = recvfrom(sock, reinterpret_cast<char*>(packet.data()), static_cast<int>(packet.size()), 0,
+                                nullptr, nullptr);
+        if (received == SOCKET_ERROR) {
+            int error = WSAGetLastError();
+            if (error != WSAETIMEDOUT && error != WSAEMSGSIZE) {
+                LOG_ERROR("AudioSource", "RTP receive failed: " << error);
+                std::this_thread::sleep_for(std::chrono::milliseconds(RECEIVE_TIMEOUT_MS));
+            }
+            continue;
+        }
+
+        // RFC 3550 header: version 2, CSRC list and extension skipped, padding trimmed
+        const uint8_t* data = packet.data();
+        size_t size = static_cast<size_t>(received);
+        if (size < 12 || (data[0] >> 6) != 2) {
+            continue;
+        }
+        size_t offset = 12 + 4 * static_cast<size_t>(data[0] & 0x0F);
+        if ((data[0] & 0x10) && offset + 4 <= size) {
+            offset += 4 + 4 * static_cast<size_t>((data[offset + 2] << 8) | data[offset + 3]);
+        }
+        if ((data[0] & 0x20) && size > 0) {
+            size -= (std::min)(size, static_cast<size_t>(data[size - 1]));
+        }
+        if (offset >= size) {
+            continue;
+        }
+        const int type = data[1] & 0x7F;
+        const uint16_t sequence = static_cast<uint16_t>((data[2] << 8) | data[3]);
+        const uint32_t timestamp = (static_cast<uint32_t>(data[4]) << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+        const uint32_t packetSsrc = (static_cast<uint32_t>(data[8]) << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+
+        // A new sender starts a new timeline; an old packet from this one is too late to play
+        if (!started || packetSsrc != ssrc) {
+            started = true;
+            ssrc = packetSsrc;
+            resampler.Reset();
+        } else if (static_cast<int16_t>(sequence - lastSequence) <= 0) {
+            continue;
+        } else if (clockRate > 0) {
+            int32_t gap = static_cast<int32_t>(timestamp - nextTimestamp);
+            if (gap > 0) {
+                size_t samples = static_cast<size_t>((std::min)(gap, clockRate * MAX_GAP_MS / 1000)) *
+                                 SAMPLE_RATE / clockRate;
+                silence.assign(samples, 0.0f);
+                Deliver(false, silence.data(), silence.size());
+            }
+        }
+        lastSequence = sequence;
+
+        size_t frames = 0;
+        if (!Decode(type, data + offset, size - offset, frames)) {
+            if (unsupported++ % 500 == 0) {
+                LOG_WARNING("AudioSource", "RTP payload type " << type << " is not supported");
+            }
+            continue;
+        }
+        nextTimestamp = timestamp + static_cast<uint32_t>(frames);
+
+        converted.resize(resampler.MaxOutputFrames(frames));
+        size_t produced = resampler.Process(pcm.data(), frames, converted.data(), converted.size());
+        Deliver(false, converted.data(), produced);
+    }
+}
+
+// ============================================================================
+// SyntheticAudioSource
+// ============================================================================
+
+SyntheticAudioSource::SyntheticAudioSource(Pacing synthPacing, double durationSec, uint32_t seed)
+    : durationSec(durationSec)
+    , state(seed ? seed : 1)
+    , segmentRemaining(0)
+    , voiced(true)
+    , pitchHz(0.0)
+    , phase(0.0)
+    , syllablePhase(0.0)
+    , syllableHz(0.0) {
+    pacing = synthPacing;
+}
+
+SyntheticAudioSource::~SyntheticAudioSource() {
+    Stop();
+}
+
+bool SyntheticAudioSource::Start(Sink target) {
+    sink = std::move(target);
+    finished.store(false);
+    running.store(true);
+    thread = std::thread(&SyntheticAudioSource::FeedThread, this);
+    LOG_INFO("AudioSource", "Synthetic source (" << (pacing == Pacing::MaxSpeed ? "max speed" : "real time")
+             << (durationSec > 0.0 ? ", " + std::to_string(durationSec) + " s)" : ", endless)"));
+    return true;
+}
+
+void SyntheticAudioSource::Stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+uint32_t SyntheticAudioSource::NextRandom() {
+    // xorshift32: tiny, and the same sequence on every platform
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void SyntheticAudioSource::Generate(float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (segmentRemaining == 0) {
+            // Alternate bursts and pauses; lengths and voice drawn from the seed
+            voiced = !voiced;
+            int lengthMs = voiced ? 600 + static_cast<int>(NextRandom() % 1900)
+                                  : 400 + static_cast<int>(NextRandom() % 1100);
+            segmentRemaining = static_cast<size_t>(SAMPLE_RATE) * lengthMs / 1000;
+            if (voiced) {
+                pitchHz = 120.0 + NextRandom() % 100;
+                syllableHz = 3.0 + (NextRandom() % 30) / 10.0;
+                syllablePhase = 0.0;
+            }
+        }
+        --segmentRemaining;
+
+        // -60 dBFS white noise floor
+        float sample = (static_cast<float>(NextRandom() & 0xFFFF) / 32768.0f - 1.0f) * 0.001f;
+        if (voiced) {
+            double value = 0.0;
+            for (int harmonic = 1; harmonic <= 8; ++harmonic) {
+                value += std::sin(2.0 * PI * harmonic * phase) / harmonic;
+            }
+            double envelope = 0.5 * (1.0 - std::cos(2.0 * PI * syllablePhase));
+            sample += static_cast<float>(0.1 * envelope * value);
+            phase += pitchHz / SAMPLE_RATE;
+            phase -= std::floor(phase);
+            syllablePhase += syllableHz / SAMPLE_RATE;
+            syllablePhase -= std::floor(syllablePhase);
+        }
+        out[i] = sample;
+    }
+}
+
+void SyntheticAudioSource::FeedThread() {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Capture);
+    TRACE_THREAD("Synthetic source");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Capture);
+
+    const size_t packetSamples = SAMPLE_RATE * PACKET_MS / 1000;
+    const uint64_t totalSamples = static_cast<uint64_t>(durationSec * SAMPLE_RATE);
+    std::vector<float> packet(packetSamples);
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t produced = 0; running.load() && (totalSamples == 0 || produced < totalSamples);
+         produced += packetSamples) {
+        if (pacing == Pacing::RealTime) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(
+                static_cast<int64_t>(produced * 1000000 / SAMPLE_RATE)));
+        }
+        Generate(packet.data(), packetSamples);
+        Deliver(false, packet.data(), packetSamples);
+    }
+
+    // Same ending as a file: silence closes the last burst
+    std::fill(packet.begin(), packet.end(), 0.0f);
+    for (int ms = 0; ms < TRAILING_SILENCE_MS && running.load(); ms += PACKET_MS) {
+        if (pacing == Pacing::RealTime) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(PACKET_MS));
+        }
+        Deliver(false, packet.data(), packetSamples);
+    }
+    finished.store(true);
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AudioResampler.h"
+
+class AudioCaptureEngine;
+
+/**
+ * AudioSource - Where an AudioCaptureEngine's audio comes from, when it is
+ * not the engine's own WASAPI endpoints
+ *
+ * A source runs its own thread and pushes 16 kHz mono float packets (10 ms,
+ * like WASAPI) into a sink, per lane. AudioCaptureEngine::InitializeWithSource
+ * attaches one: the sink is the engine's FeedAudio(), so the VAD, the
+ * segmenter and whisper see exactly what they see live. Implementations:
+ *
+ *   LiveAudioSource        the default microphone and loopback, through a
+ *                          capture-only AudioCaptureEngine
+ *   WavFileSource          a WAV file, once, at real time or at max speed
+ *   RtpAudioSource         an RTP stream on a UDP port (PCMU, PCMA, L16)
+ *   SyntheticAudioSource   seeded speech-like bursts over low noise
+ *
+ * Pacing: RealTime sleeps to the wall clock, MaxSpeed feeds as fast as the
+ * engine drains - the sink returns what the ring accepted and the rest is
+ * offered again, so a max-speed run drops nothing and is repeatable.
+ *
+ * Create() builds one from a command-line spec:
+ *   live                        WASAPI (default devices)
+ *   file:<path.wav>             real time
+ *   file-max:<path.wav>         max speed
+ *   rtp:<port>                  RTP over UDP, any interface
+ *   synthetic[-max][:<seconds>] generator; endless without a duration
+ *
+ * Start/Stop from one thread (the engine's Start/Stop).
+ */
+class AudioSource {
+public:
+    // 16 kHz mono samples for one lane; returns how many were accepted
+    using Sink = std::function<size_t(bool systemAudio, const float* samples, size_t count)>;
+
+    enum class Pacing { RealTime, MaxSpeed };
+
+    static constexpr int SAMPLE_RATE = 16000;
+    static constexpr int PACKET_MS = 10;
+    static constexpr int TRAILING_SILENCE_MS = 1000;    // Closes a file's last utterance
+
+    virtual ~AudioSource() = default;
+
+    // Spec as above; null (with `error` set) when it doesn't parse or open
+    static std::unique_ptr<AudioSource> Create(const std::string& spec, std::string& error);
+
+    virtual const char* Name() const = 0;
+    virtual bool Start(Sink sink) = 0;
+    virtual void Stop() = 0;
+    // Nothing more will come (a file played through); endless sources never finish
+    virtual bool IsFinished() const { return false; }
+
+    // === WAV files (also bench_audio's reader) ===
+    struct WavData {
+        int sampleRate = 0;
+        int channels = 0;
+        size_t bytesPerFrame = 0;
+        AudioResampler::SampleFormat format = AudioResampler::SampleFormat::Unsupported;
+        std::vector<uint8_t> data;
+
+        size_t Frames() const { return bytesPerFrame ? data.size() / bytesPerFrame : 0; }
+    };
+    // 16/24/32-bit PCM or 32-bit float, any channel count and rate (WAVE_FORMAT_EXTENSIBLE too)
+    static bool LoadWav(const std::string& path, WavData& wav, std::string& error);
+
+protected:
+    // Offer a packet until the sink has taken all of it (MaxSpeed) or once (RealTime)
+    bool Deliver(bool systemAudio, const float* samples, size_t count);
+
+    Sink sink;
+    Pacing pacing = Pacing::RealTime;
+    std::atomic<bool> running{false};
+};
+
+/**
+ * LiveAudioSource - The default devices, captured by an engine of their own
+ *
+ * A capture-only AudioCaptureEngine (InitializeCaptureOnly) whose sink is
+ * this source's: the same WASAPI path the engine takes itself, for feeding
+ * an engine that should not own the devices (a replay harness, a remote room).
+ */
+class LiveAudioSource : public AudioSource {
+public:
+    LiveAudioSource();
+    ~LiveAudioSource() override;
+
+    const char* Name() const override { return "live"; }
+    bool Start(Sink sink) override;
+    void Stop() override;
+
+private:
+    std::unique_ptr<AudioCaptureEngine> capture;
+};
+
+/**
+ * WavFileSource - One WAV file, then TRAILING_SILENCE_MS of silence
+ */
+class WavFileSource : public AudioSource {
+public:
+    WavFileSource(const std::string& path, Pacing pacing);
+    ~WavFileSource() override;
+
+    // Reads and checks the file; false (with `error`) when it can't be played
+    bool Open(std::string& error);
+
+    const char* Name() const override { return "file"; }
+    bool Start(Sink sink) override;
+    void Stop() override;
+    bool IsFinished() const override { return finished.load(); }
+
+private:
+    void FeedThread();
+
+    std::string path;
+    WavData wav;
+    AudioResampler resampler;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+};
+
+/**
+ * RtpAudioSource - An RTP audio stream received on a UDP port
+ *
+ * Static payload types 0 (PCMU), 8 (PCMA), 10 and 11 (L16 44.1 kHz stereo
+ * and mono); dynamic types (96-127) are taken as L16 at 16 kHz mono, the
+ * format a gateway re-packetizing a WebRTC or SIP room for us would send.
+ * Packets older than the last one played are dropped; a gap in the RTP
+ * timestamps (lost packets) is filled with up to MAX_GAP_MS of silence so
+ * the engine's timeline keeps pace with the sender's.
+ */
+class RtpAudioSource : public AudioSource {
+public:
+    static constexpr int MAX_GAP_MS = 200;
+    static constexpr int RECEIVE_TIMEOUT_MS = 100;      // Bounds Stop() latency
+
+    explicit RtpAudioSource(uint16_t port);
+    ~RtpAudioSource() override;
+
+    const char* Name() const override { return "rtp"; }
+    bool Start(Sink sink) override;
+    void Stop() override;
+
+private:
+    void ReceiveThread();
+    // Payload -> 16-bit little-endian PCM, resampler configured for it; false: unsupported type
+    bool Decode(int payloadType, const uint8_t* payload, size_t size, size_t& frames);
+
+    uint16_t port;
+    uintptr_t socketHandle;             // SOCKET, kept out of this header
+    std::thread thread;
+    AudioResampler resampler;
+    int payloadType;                    // -1 until the first packet
+    int clockRate;
+    int channels;
+    std::vector<int16_t> pcm;
+    std::vector<float> converted;
+};
+
+/**
+ * SyntheticAudioSource - Deterministic speech-like test audio
+ *
+ * Voiced bursts (a 120-220 Hz harmonic series with syllable-rate amplitude
+ * modulation, 0.6-2.5 s long) separated by 0.4-1.5 s pauses, over white
+ * noise at -60 dBFS. Lengths and pitches come from a fixed-seed generator,
+ * so every run produces the same samples: the VAD opens and closes in the
+ * same places and the load on whisper repeats exactly.
+ */
+class SyntheticAudioSource : public AudioSource {
+public:
+    // durationSec 0: endless
+    SyntheticAudioSource(Pacing pacing, double durationSec, uint32_t seed = 1);
+    ~SyntheticAudioSource() override;
+
+    const char* Name() const override { return "synthetic"; }
+    bool Start(Sink sink) override;
+    void Stop() override;
+    bool IsFinished() const override { return finished.load(); }
+
+private:
+    void FeedThread();
+    void Generate(float* out, size_t count);
+    uint32_t NextRandom();
+
+    double durationSec;
+    uint32_t state;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+
+    // Generator state
+    size_t segmentRemaining;
+    bool voiced;
+    double pitchHz;
+    double phase;
+    double syllablePhase;
+    double syllableHz;
+};
@@ -0,0 +1,221 @@
+#include "BrowserTabTracker.h"
+#include <cwchar>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#pragma comment(lib, "uiautomationcore.lib")
+
+// Forwards Value changes of one window's address bar into the cache
+class BrowserTabTracker::UrlChangedHandler : public IUIAutomationPropertyChangedEventHandler {
+public:
+    UrlChangedHandler(BrowserTabTracker* tracker, HWND hwnd) : refCount(1), tracker(tracker), hwnd(hwnd) {}
+
+    ULONG STDMETHODCALLTYPE AddRef() override {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override {
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IUIAutomationPropertyChangedEventHandler)) {
+            *object = static_cast<IUIAutomationPropertyChangedEventHandler*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    HRESULT STDMETHODCALLTYPE HandlePropertyChangedEvent(IUIAutomationElement*, PROPERTYID propertyId,
+                                                         VARIANT newValue) override {
+        if (propertyId == UIA_ValueValuePropertyId && newValue.vt == VT_BSTR && newValue.bstrVal) {
+            tracker->OnUrlChanged(hwnd, newValue.bstrVal);
+        }
+        return S_OK;
+    }
+
+private:
+    LONG refCount;
+    BrowserTabTracker* tracker;         // Outlives the subscription (Shutdown removes it)
+    HWND hwnd;
+};
+
+BrowserTabTracker::~BrowserTabTracker() {
+    Shutdown();
+}
+
+bool BrowserTabTracker::Initialize() {
+    if (automation) {
+        return true;
+    }
+    HRESULT hr = CoCreateInstance(__uuidof(CUIAutomation), nullptr, CLSCTX_INPROC_SERVER,
+                                  __uuidof(IUIAutomation), reinterpret_cast<void**>(&automation));
+    if (FAILED(hr)) {
+        std::cerr << "[BrowserTabTracker] UI Automation unavailable (hr=0x" << std::hex << hr << std::dec
+                  << "); tab URLs disabled" << std::endl;
+        return false;
+    }
+
+    automation->CreateCacheRequest(&cacheRequest);
+    cacheRequest->AddProperty(UIA_ValueValuePropertyId);
+
+    VARIANT editType;
+    editType.vt = VT_I4;
+    editType.lVal = UIA_EditControlTypeId;
+    automation->CreatePropertyCondition(UIA_ControlTypePropertyId, editType, &chromiumAddressBar);
+
+    VARIANT urlbarId;
+    urlbarId.vt = VT_BSTR;
+    urlbarId.bstrVal = SysAllocString(L"urlbar-input");
+    automation->CreatePropertyCondition(UIA_AutomationIdPropertyId, urlbarId, &firefoxAddressBar);
+    VariantClear(&urlbarId);
+    return true;
+}
+
+void BrowserTabTracker::Shutdown() {
+    if (!automation) {
+        return;
+    }
+    // Blocks until handlers in flight have returned, so `this` stays valid for them
+    automation->RemoveAllEventHandlers();
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        entries.clear();
+    }
+    firefoxAddressBar.Release();
+    chromiumAddressBar.Release();
+    cacheRequest.Release();
+    automation.Release();
+}
+
+bool BrowserTabTracker::GetTabInfo(HWND hwnd, std::wstring& title, std::wstring& url) {
+    wchar_t buffer[1024] = { 0 };
+    if (GetWindowTextW(hwnd, buffer, 1023) <= 0) {
+        return false;
+    }
+    title = StripBrowserSuffix(buffer);
+    url.clear();
+    if (!automation) {
+        return true;
+    }
+
+    uint64_t now = GetTickCount64();
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        auto it = entries.find(hwnd);
+        if (it != entries.end() && (it->second.addressBar || now < it->second.nextSearchMs)) {
+            url = it->second.url;           // Kept current by the subscription
+            return true;
+        }
+    }
+
+    // First sight of this window (or retry): the one expensive call, done without the lock
+    PruneClosedWindows();
+    WindowEntry entry;
+    if (!FindAddressBar(hwnd, entry)) {
+        entry.nextSearchMs = now + SEARCH_RETRY_MS;
+    }
+    url = entry.url;
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    WindowEntry& stored = entries[hwnd];
+    if (!stored.addressBar) {
+        stored = std::move(entry);
+    }
+    return true;
+}
+
+bool BrowserTabTracker::FindAddressBar(HWND hwnd, WindowEntry& entry) {
+    CComPtr<IUIAutomationElement> root;
+    if (FAILED(automation->ElementFromHandle(hwnd, &root)) || !root) {
+        return false;
+    }
+
+    wchar_t className[64] = { 0 };
+    GetClassNameW(hwnd, className, 63);
+    IUIAutomationCondition* condition =
+        wcscmp(className, L"MozillaWindowClass") == 0 ? firefoxAddressBar.p : chromiumAddressBar.p;
+
+    // Search and URL in one cross-process round trip
+    CComPtr<IUIAutomationElement> addressBar;
+    if (FAILED(root->FindFirstBuildCache(TreeScope_Descendants, condition, cacheRequest, &addressBar)) ||
+        !addressBar) {
+        return false;
+    }
+    VARIANT value;
+    VariantInit(&value);
+    if (SUCCEEDED(addressBar->GetCachedPropertyValue(UIA_ValueValuePropertyId, &value)) &&
+        value.vt == VT_BSTR && value.bstrVal) {
+        entry.url = value.bstrVal;
+    }
+    VariantClear(&value);
+
+    // Later URLs are pushed to us
+    CComPtr<IUIAutomationPropertyChangedEventHandler> handler;
+    handler.Attach(new UrlChangedHandler(this, hwnd));
+    PROPERTYID properties[] = { UIA_ValueValuePropertyId };
+    if (FAILED(automation->AddPropertyChangedEventHandlerNativeArray(addressBar, TreeScope_Element, nullptr,
+                                                                    handler, properties, 1))) {
+        return false;
+    }
+    entry.addressBar = addressBar;
+    entry.handler = handler;
+    return true;
+}
+
+void BrowserTabTracker::OnUrlChanged(HWND hwnd, const wchar_t* url) {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    auto it = entries.find(hwnd);
+    if (it != entries.end()) {
+        it->second.url = url;
+    }
+}
+
+void BrowserTabTracker::PruneClosedWindows() {
+    std::vector<WindowEntry> closed;
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (!IsWindow(it->first)) {
+                closed.push_back(std::move(it->second));
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    // Outside the lock: removal waits for in-flight handlers, which take it
+    for (auto& entry : closed) {
+        if (entry.addressBar && entry.handler) {
+            automation->RemovePropertyChangedEventHandler(entry.addressBar, entry.handler);
+        }
+    }
+}
+
+std::wstring BrowserTabTracker::StripBrowserSuffix(const std::wstring& title) {
+    // "<tab> - Google Chrome", "<tab> - Microsoft Edge", "<tab> - Opera", "<tab> — Mozilla Firefox"
+    static const wchar_t* const separators[] = { L" - ", L" — " };
+    static const wchar_t* const browsers[] = { L"Chrome", L"Edge", L"Firefox", L"Opera" };
+    size_t cut = std::wstring::npos;
+    for (const wchar_t* separator : separators) {
+        size_t position = title.rfind(separator);
+        if (position != std::wstring::npos && (cut == std::wstring::npos || position > cut)) {
+            cut = position;
+        }
+    }
+    if (cut == std::wstring::npos || cut == 0) {
+        return title;
+    }
+    for (const wchar_t* browser : browsers) {
+        if (title.find(browser, cut) != std::wstring::npos) {
+            return title.substr(0, cut);
+        }
+    }
+    return title;
+}
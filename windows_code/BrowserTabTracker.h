@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Windows.h>
+#include <UIAutomation.h>
+#include <atlbase.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * BrowserTabTracker - Active tab title and URL of browser windows via UI Automation
+ *
+ * UIA calls into a browser are cross-process and can take milliseconds each,
+ * so nothing is looked up per event:
+ *   - The address bar element of each browser window is found once
+ *     (FindFirstBuildCache: the search and its URL value in one call) and kept.
+ *   - A property-changed subscription on its Value delivers every later URL
+ *     change into the cache, so GetTabInfo is a map lookup, not a tree walk.
+ *   - The tab title is the window title without the browser's suffix; the
+ *     browser keeps it current, and reading it doesn't go through UIA.
+ *   - A window whose address bar can't be found isn't searched again for
+ *     SEARCH_RETRY_MS; entries of closed windows are dropped (and their
+ *     subscriptions removed) as new windows are added.
+ *
+ * Supports Chrome, Edge, Opera (Chromium omnibox: the first Edit control) and
+ * Firefox (AutomationId "urlbar-input"). While the user types in the address
+ * bar the cached URL follows the typed text until the next navigation.
+ *
+ * Usage (on one MTA thread):
+ *   BrowserTabTracker tabs;
+ *   tabs.Initialize();
+ *   std::wstring title, url;
+ *   if (tabs.GetTabInfo(hwnd, title, url)) { ... }
+ *   tabs.Shutdown();
+ */
+class BrowserTabTracker {
+public:
+    static constexpr uint64_t SEARCH_RETRY_MS = 30000;
+
+    BrowserTabTracker() = default;
+    ~BrowserTabTracker();
+
+    BrowserTabTracker(const BrowserTabTracker&) = delete;
+    BrowserTabTracker& operator=(const BrowserTabTracker&) = delete;
+
+    /**
+     * @brief Create the UIA client objects (COM must be initialized on this thread)
+     * @return false if UI Automation is unavailable; GetTabInfo then reports titles only
+     */
+    bool Initialize();
+
+    // Remove every subscription and release UIA (same thread as Initialize)
+    void Shutdown();
+
+    /**
+     * @brief Active tab of a browser top-level window
+     * @return false if the window has no title; url is "" until the address bar is known
+     */
+    bool GetTabInfo(HWND hwnd, std::wstring& title, std::wstring& url);
+
+private:
+    class UrlChangedHandler;
+
+    struct WindowEntry {
+        CComPtr<IUIAutomationElement> addressBar;      // Null while not found
+        CComPtr<IUIAutomationPropertyChangedEventHandler> handler;
+        std::wstring url;
+        uint64_t nextSearchMs = 0;
+    };
+
+    // Called from UIA's event threads
+    void OnUrlChanged(HWND hwnd, const wchar_t* url);
+
+    bool FindAddressBar(HWND hwnd, WindowEntry& entry);
+    void PruneClosedWindows();
+    static std::wstring StripBrowserSuffix(const std::wstring& title);
+
+    CComPtr<IUIAutomation> automation;
+    CComPtr<IUIAutomationCacheRequest> cacheRequest;   // ValueValue, fetched with the element
+    CComPtr<IUIAutomationCondition> chromiumAddressBar;
+    CComPtr<IUIAutomationCondition> firefoxAddressBar;
+
+    std::mutex entriesMutex;                           // Event threads write URLs
+    std::map<HWND, WindowEntry> entries;
+};
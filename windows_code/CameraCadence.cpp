@@ -0,0 +1,96 @@
+#include "CameraCadence.h"
+#include "CpuSampler.h"
+#include "Log.h"
+#include "WindowsAPIs.h"
+#include <algorithm>
+#include <windows.h>
+
+CameraCadence::Signals CameraCadence::Sample() {
+    Signals sample;
+    int64_t now = static_cast<int64_t>(GetTickCount64());
+
+    sample.meeting = WindowsAPIs::GetCurrentForegroundCategory() == "meeting";
+
+    if (voiceSource && voiceSource()) {
+        lastVoiceMs = now;
+    }
+    sample.voiceActive = lastVoiceMs >= 0 && now - lastVoiceMs <= VOICE_HOLD_MS;
+
+    sample.highMotion = lastSceneDistance >= HIGH_MOTION_BITS;
+
+    // dwTime is a 32-bit tick count; the difference wraps correctly in 32 bits
+    LASTINPUTINFO input = {};
+    input.cbSize = sizeof(input);
+    if (GetLastInputInfo(&input)) {
+        DWORD idleMs = GetTickCount() - input.dwTime;
+        sample.userIdle = idleMs >= USER_IDLE_AFTER_MS;
+    }
+
+    // Desktops report AC online, so they never count as on battery
+    sample.onBattery = !WindowsAPIs::IsCharging();
+    sample.batteryPercent = WindowsAPIs::GetBatteryPercentage();
+    sample.cpuPercent = CpuSampler::Instance().SystemPercent();
+    sample.powerScale = powerScale;
+    sample.presenceScale = presenceScale;
+    return sample;
+}
+
+int CameraCadence::ComputeIntervalMs(const Signals& signals, std::string* reason, int defaultIntervalMs) {
+    std::string why;
+    auto note = [&why](const char* text) {
+        why += (why.empty() ? "" : ", ");
+        why += text;
+    };
+
+    int interval = defaultIntervalMs;
+    if (signals.meeting || signals.voiceActive || signals.highMotion) {
+        if (signals.meeting) {
+            interval = (std::min)(interval, MEETING_INTERVAL_MS);
+            note("meeting");
+        }
+        if (signals.voiceActive) {
+            interval = (std::min)(interval, VOICE_INTERVAL_MS);
+            note("voice");
+        }
+        if (signals.highMotion) {
+            interval = (std::min)(interval, MOTION_INTERVAL_MS);
+            note("motion");
+        }
+    } else if (signals.userIdle) {
+        interval = (std::max)(interval, USER_IDLE_INTERVAL_MS);
+        note("user idle");
+    }
+
+    if (signals.onBattery) {
+        bool low = signals.batteryPercent >= 0 && signals.batteryPercent < LOW_BATTERY_PERCENT;
+        interval *= low ? 6 : 2;
+        note(low ? "low battery" : "on battery");
+    }
+    if (signals.cpuPercent >= CPU_SATURATED_PERCENT) {
+        interval *= 3;
+        note("cpu saturated");
+    }
+    if (signals.powerScale > 1) {
+        interval *= signals.powerScale;
+        note("power saver");
+    }
+    if (signals.presenceScale > 1) {
+        interval *= signals.presenceScale;
+        note("nobody present");
+    }
+
+    if (reason) {
+        *reason = why.empty() ? "default" : why;
+    }
+    return (std::min)(interval, MAX_INTERVAL_MS);
+}
+
+int CameraCadence::IntervalMs() {
+    signals = Sample();
+    int interval = ComputeIntervalMs(signals, &reason, defaultIntervalMs);
+    if (interval != lastIntervalMs) {
+        LOG_DEBUG("Camera", "Caption interval " << interval << " ms (" << reason << ")");
+        lastIntervalMs = interval;
+    }
+    return interval;
+}
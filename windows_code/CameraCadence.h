@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * CameraCadence - How long the caption loop waits before the next scene
+ *
+ * The camera used to be captioned every 10 seconds whatever was going on.
+ * The cadence speeds that up when a fresh caption is likely to matter (a
+ * meeting app in the foreground, someone talking, the last frame differing
+ * a lot from the one before) and slows it down when it isn't worth the
+ * CPU (no keyboard/mouse input for a while, running on battery, the
+ * machine already saturated).
+ *
+ *   Boosts (the shortest applies)   meeting app 3 s, voice 4 s, motion 5 s
+ *   Otherwise                       10 s (configurable); 30 s once the user has been idle 5 min
+ *   Then multiplied by              x2 on battery (x6 under 20%), x3 above 85% CPU,
+ *                                   the power profile's scale (SetPowerScale) and the
+ *                                   presence state's (SetPresenceScale: nobody at the machine)
+ *   Capped at                       MAX_INTERVAL_MS
+ *
+ * Every signal is cheap to read (the foreground category is kept by the
+ * window monitor, power status and last input are single calls, CPU is
+ * CpuSampler's smoothed usage), so the caption loop re-evaluates
+ * once per sleep slice: a meeting starting or someone speaking cuts a long
+ * wait short instead of waiting it out.
+ *
+ * Usage:
+ *   CameraCadence cadence;
+ *   cadence.SetVoiceActivitySource([&] { return audio.GetMetrics().isSpeechDetected; });
+ *   describe(); cadence.ReportScene(engine.GetSceneStats().lastSceneDistance);
+ *   while (sinceLastMs < cadence.IntervalMs()) { sleep one slice; }
+ *
+ * One caller at a time (the caption thread).
+ */
+class CameraCadence {
+public:
+    static constexpr int DEFAULT_INTERVAL_MS = 10000;
+    static constexpr int MEETING_INTERVAL_MS = 3000;
+    static constexpr int VOICE_INTERVAL_MS = 4000;
+    static constexpr int MOTION_INTERVAL_MS = 5000;
+    static constexpr int USER_IDLE_INTERVAL_MS = 30000;
+    static constexpr int MAX_INTERVAL_MS = 120000;
+
+    static constexpr uint64_t USER_IDLE_AFTER_MS = 5 * 60 * 1000;
+    static constexpr int64_t VOICE_HOLD_MS = 5000;          // Speech counts this long after it was last seen
+    static constexpr int HIGH_MOTION_BITS = 16;             // Frame hash distance (of 64) counted as motion
+    static constexpr int LOW_BATTERY_PERCENT = 20;
+    static constexpr double CPU_SATURATED_PERCENT = 85.0;
+
+    struct Signals {
+        bool meeting = false;               // Foreground app is a meeting app
+        bool voiceActive = false;           // Speech now or within VOICE_HOLD_MS
+        bool highMotion = false;            // Last scene's hash distance >= HIGH_MOTION_BITS
+        bool userIdle = false;              // No input for USER_IDLE_AFTER_MS
+        bool onBattery = false;
+        int batteryPercent = -1;            // -1 when unknown
+        double cpuPercent = -1.0;           // -1 when unavailable
+        int powerScale = 1;                 // PowerPolicy::Settings::cameraIntervalScale
+        int presenceScale = 1;              // PresenceMonitor::Settings::cameraIntervalScale
+    };
+
+    /**
+     * @brief Where voice activity comes from (null: never active)
+     */
+    void SetVoiceActivitySource(std::function<bool()> source) { voiceSource = std::move(source); }
+
+    /**
+     * @brief Wait when nothing boosts or idles the cadence (DEFAULT_INTERVAL_MS; RuntimeConfig camera.interval_ms)
+     */
+    void SetDefaultIntervalMs(int intervalMs) { defaultIntervalMs = intervalMs; }
+
+    /**
+     * @brief Extra multiplier from the power profile (battery saver); 1 leaves the interval alone
+     */
+    void SetPowerScale(int scale) { powerScale = scale > 1 ? scale : 1; }
+
+    /**
+     * @brief Extra multiplier while nobody is at the machine (PresenceMonitor); 1 leaves the interval alone
+     */
+    void SetPresenceScale(int scale) { presenceScale = scale > 1 ? scale : 1; }
+
+    /**
+     * @brief Hash distance of the scene just described (SceneStats::lastSceneDistance)
+     */
+    void ReportScene(int sceneDistance) { lastSceneDistance = sceneDistance; }
+
+    /**
+     * @brief Read the signals and return the current wait; logs when it changes
+     */
+    int IntervalMs();
+
+    /**
+     * @brief Signals behind the last IntervalMs()
+     */
+    const Signals& GetSignals() const { return signals; }
+
+    /**
+     * @brief What set the last interval, e.g. "meeting, on battery"
+     */
+    const std::string& GetReason() const { return reason; }
+
+    /**
+     * @brief The policy alone, for a given set of signals
+     */
+    static int ComputeIntervalMs(const Signals& signals, std::string* reason = nullptr,
+                                 int defaultIntervalMs = DEFAULT_INTERVAL_MS);
+
+private:
+    std::function<bool()> voiceSource;
+    int defaultIntervalMs = DEFAULT_INTERVAL_MS;
+    int lastSceneDistance = -1;
+    int powerScale = 1;
+    int presenceScale = 1;
+    int64_t lastVoiceMs = -1;
+    int lastIntervalMs = 0;
+    Signals signals;
+    std::string reason;
+
+    Signals Sample();
+};
@@ -0,0 +1,184 @@
+#include "CameraPreview.h"
+#include <vector>
+#include "Log.h"
+#include "Trace.h"
+
+CameraPreview::CameraPreview(HttpServer& server, double streamFps)
+    : server(server)
+    , streamInterval(static_cast<int64_t>(1000.0 / (streamFps > 0.0 ? streamFps : DEFAULT_STREAM_FPS)))
+    , capture(nullptr)
+    , viewing(false)
+    , encodedSequence(0)
+    , running(false)
+{
+}
+
+CameraPreview::~CameraPreview() {
+    Stop();
+}
+
+void CameraPreview::Start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    streamThread = std::thread(&CameraPreview::StreamThread, this);
+    LOG_INFO("CameraPreview", "Serving /camera/latest.jpg and /camera/stream.mjpg (one frame per "
+             << streamInterval.count() << "ms)");
+}
+
+void CameraPreview::Stop() {
+    running.store(false);
+    if (streamThread.joinable()) {
+        streamThread.join();
+    }
+}
+
+void CameraPreview::SetCapture(FrameCapture* newCapture) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (capture == newCapture) {
+        return;
+    }
+    SetViewing(false);
+    capture = newCapture;
+    // Someone watched the previous camera lately: carry on with this one
+    if (std::chrono::steady_clock::now() - lastViewed < std::chrono::milliseconds(VIEWER_TIMEOUT_MS)) {
+        SetViewing(true);
+    }
+}
+
+void CameraPreview::SetViewing(bool on) {
+    on = on && capture != nullptr;
+    if (on == viewing) {
+        return;
+    }
+    viewing = on;
+    if (capture) {
+        capture->EnablePreview(on);
+    }
+    if (!on) {
+        encodedSequence = 0;
+        encodedJpeg.reset();
+        encodedPart.reset();
+    }
+}
+
+void CameraPreview::ServeLatest(HttpResponse& response) {
+    Image image = Current(false);
+    if (!image.jpeg) {
+        response.status = 503;
+        response.SetHeader("Retry-After", "1");
+        response.SetBody(image.camera ? "{\"error\":\"No camera frame yet\"}" : "{\"error\":\"Camera not running\"}");
+        return;
+    }
+    int64_t ageMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - image.timestamp).count();
+    response.SetHeader("Content-Type", "image/jpeg");
+    response.SetHeader("Cache-Control", "no-store");
+    response.SetHeader("X-Frame-Sequence", std::to_string(image.sequence));
+    response.SetHeader("X-Frame-Age-Ms", std::to_string(ageMs));
+    response.SetSharedBody(std::move(image.jpeg));
+    response.status = 200;
+}
+
+void CameraPreview::Subscribe(HttpResponse& response) {
+    Image image = Current(true);
+    if (!image.camera) {
+        response.status = 503;
+        response.SetBody("{\"error\":\"Camera not running\"}");
+        return;
+    }
+    response.StartEventStream(STREAM_NAME);
+    response.SetHeader("Content-Type", std::string("multipart/x-mixed-replace; boundary=") + BOUNDARY);
+    response.SetHeader("Cache-Control", "no-store");
+    if (image.part) {
+        response.SetSharedBody(std::move(image.part));
+    }
+    response.status = 200;
+}
+
+CameraPreview::Image CameraPreview::Current(bool withPart) {
+    Image image;
+    std::lock_guard<std::mutex> lock(mutex);
+    image.camera = capture != nullptr;
+    lastViewed = std::chrono::steady_clock::now();
+    SetViewing(true);
+    std::shared_ptr<const FrameCapture::Frame> frame = capture ? capture->GetPreview() : nullptr;
+    if (!frame || frame->frame.empty()) {
+        return image;
+    }
+
+    if (frame->sequence != encodedSequence || frame->timestamp != encodedTimestamp) {
+        Buffer jpeg = Encode(frame->frame);
+        if (!jpeg) {
+            return image;
+        }
+        encodedSequence = frame->sequence;
+        encodedTimestamp = frame->timestamp;
+        encodedJpeg = std::move(jpeg);
+        encodedPart.reset();
+    }
+    if (withPart && !encodedPart) {
+        encodedPart = MakePart(*encodedJpeg);
+    }
+
+    image.jpeg = encodedJpeg;
+    image.part = withPart ? encodedPart : nullptr;
+    image.sequence = encodedSequence;
+    image.timestamp = encodedTimestamp;
+    return image;
+}
+
+CameraPreview::Buffer CameraPreview::Encode(const cv::Mat& frame) {
+    TRACE_ZONE("CameraPreview::Encode");
+    // Media Foundation frames are BGRA; the JPEG encoder wants BGR or gray
+    cv::Mat bgr;
+    if (frame.channels() == 4) {
+        cv::cvtColor(frame, bgr, cv::COLOR_BGRA2BGR);
+    } else {
+        bgr = frame;
+    }
+    std::vector<uchar> bytes;
+    if (!cv::imencode(".jpg", bgr, bytes, { cv::IMWRITE_JPEG_QUALITY, JPEG_QUALITY })) {
+        LOG_WARNING("CameraPreview", "JPEG encode failed (" << frame.cols << "x" << frame.rows << ", "
+                    << frame.channels() << " channels)");
+        return nullptr;
+    }
+    return std::make_shared<const std::string>(bytes.begin(), bytes.end());
+}
+
+CameraPreview::Buffer CameraPreview::MakePart(const std::string& jpeg) {
+    std::string part;
+    part.reserve(jpeg.size() + 96);
+    part.append("--").append(BOUNDARY).append("\r\n");
+    part.append("Content-Type: image/jpeg\r\n");
+    part.append("Content-Length: ").append(std::to_string(jpeg.size())).append("\r\n\r\n");
+    part.append(jpeg);
+    part.append("\r\n");
+    return std::make_shared<const std::string>(std::move(part));
+}
+
+void CameraPreview::StreamThread() {
+    Buffer published;
+    while (running.load()) {
+        if (server.GetSubscriberCount(STREAM_NAME) == 0) {
+            published.reset();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (viewing && std::chrono::steady_clock::now() - lastViewed >=
+                               std::chrono::milliseconds(VIEWER_TIMEOUT_MS)) {
+                    SetViewing(false);
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_SLICE_MS));
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        Image image = Current(true);
+        // A frame the capture hasn't replaced yet isn't sent again
+        if (image.part && image.part != published) {
+            server.PublishBytes(STREAM_NAME, image.part);
+            published = std::move(image.part);
+        }
+        std::this_thread::sleep_until(start + streamInterval);
+    }
+}
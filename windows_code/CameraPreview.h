@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "FrameCapture.h"
+#include "HttpServer.h"
+
+/**
+ * CameraPreview - What the camera sees, as JPEG, for operators
+ *
+ * GET /camera/latest.jpg answers the newest frame; GET /camera/stream.mjpg
+ * subscribes to a multipart/x-mixed-replace stream of them at streamFps (a
+ * browser shows it as live video). Frames come from the capture's preview
+ * copy (FrameCapture::GetPreview), so the caption path's mailbox is never
+ * touched.
+ *
+ * The capture copies frames for the preview only while someone watches: a
+ * stream subscriber, or a /camera/latest.jpg request within VIEWER_TIMEOUT_MS.
+ * The first request after a quiet spell turns the copy on and may answer 503
+ * until the next frame arrives; the stream thread turns it off (dropping the
+ * copy and the JPEG) once nobody has looked for that long.
+ *
+ * Encoding: lazily, on the thread of whoever asks first (an HTTP worker or
+ * the stream thread), at most once per frame (known by its sequence and
+ * timestamp, so the capture's copy buffer stays free for reuse): the JPEG
+ * and its multipart part are shared, refcounted buffers sent by reference to
+ * every viewer, and the encode runs under the mutex so concurrent viewers of
+ * a new frame wait for the one encode rather than repeat it. Never on the
+ * capture or inference threads.
+ *
+ * Usage:
+ *   CameraPreview preview(server);
+ *   preview.Start();
+ *   preview.SetCapture(&capture);       // nullptr before the capture goes away
+ *   // GET /camera/latest.jpg:  preview.ServeLatest(response);
+ *   // GET /camera/stream.mjpg: preview.Subscribe(response);
+ */
+class CameraPreview {
+public:
+    static constexpr const char* STREAM_NAME = "camera.mjpeg";
+    static constexpr double DEFAULT_STREAM_FPS = 2.0;
+    static constexpr int JPEG_QUALITY = 80;
+
+    explicit CameraPreview(HttpServer& server, double streamFps = DEFAULT_STREAM_FPS);
+    ~CameraPreview();
+
+    CameraPreview(const CameraPreview&) = delete;
+    CameraPreview& operator=(const CameraPreview&) = delete;
+
+    void Start();
+    void Stop();
+
+    /**
+     * @brief The capture to show; its preview copy is enabled while someone watches
+     *
+     * Returns once no encode reads the previous one, so the caller may close
+     * or destroy it after SetCapture(nullptr).
+     */
+    void SetCapture(FrameCapture* capture);
+
+    // 200 image/jpeg, or 503 without a camera (or one closed while suspended) or before its first frame
+    void ServeLatest(HttpResponse& response);
+
+    // Turn the response into an MJPEG subscription, starting with the newest frame
+    void Subscribe(HttpResponse& response);
+
+private:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    struct Image {
+        Buffer jpeg;                    // Null: no frame
+        Buffer part;                    // The JPEG as a multipart part (asked for)
+        uint64_t sequence = 0;
+        std::chrono::steady_clock::time_point timestamp;
+        bool camera = false;            // A capture is set
+    };
+
+    // The newest frame's image, encoded now if this frame hasn't been; counts as a view
+    Image Current(bool withPart);
+    // Mutex held: the capture's preview copy on or off; off drops the encoded frame
+    void SetViewing(bool viewing);
+    static Buffer Encode(const cv::Mat& frame);
+    static Buffer MakePart(const std::string& jpeg);
+
+    void StreamThread();
+
+    static constexpr const char* BOUNDARY = "frame";
+    static constexpr int IDLE_SLICE_MS = 500;           // Stream thread with no subscriber; Stop() latency
+    static constexpr int VIEWER_TIMEOUT_MS = 10000;     // Since the last view: the preview copy stops
+
+    HttpServer& server;
+    std::chrono::milliseconds streamInterval;
+
+    std::mutex mutex;                                   // Everything below
+    FrameCapture* capture;
+    bool viewing;                                       // The capture's preview copy is on
+    std::chrono::steady_clock::time_point lastViewed;
+    uint64_t encodedSequence;                           // With the timestamp: the frame encodedJpeg shows
+    std::chrono::steady_clock::time_point encodedTimestamp;
+    Buffer encodedJpeg;
+    Buffer encodedPart;
+
+    std::atomic<bool> running;
+    std::thread streamThread;
+};
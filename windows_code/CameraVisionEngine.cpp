@@ -1,624 +1,3203 @@
 #include "CameraVisionEngine.h"
 #include "FastVLMTokenizer.h"
-#include <iostream>
+#include "InferenceScheduler.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "OrtRuntime.h"
+#include "PipelineLatency.h"
+#include "StartupTimeline.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
 #include <chrono>
 #include <algorithm>
+#include <cstring>
+#include <bitset>
+#include <optional>
+#include "CpuBudget.h"
 #include <windows.h>
 
+namespace {
+
+// IEEE 754 binary16 <-> binary32 (round to nearest even; inf/NaN preserved)
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (((bits >> 23) & 0xFFu) == 0xFFu) {
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+    }
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        // Subnormal half
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (remainder > midpoint || (remainder == midpoint && (half & 1u))) {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        half++;     // May carry into the exponent, which is still correct rounding
+    }
+    return static_cast<uint16_t>(half);
+}
+
+float HalfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Normalize subnormal
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400u) == 0) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    } else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Same size, type and pixels
+bool SamePixels(const cv::Mat& a, const cv::Mat& b) {
+    if (a.size() != b.size() || a.type() != b.type()) {
+        return false;
+    }
+    size_t rowBytes = static_cast<size_t>(a.cols) * a.elemSize();
+    for (int y = 0; y < a.rows; ++y) {
+        if (std::memcmp(a.ptr(y), b.ptr(y), rowBytes) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::future<CameraVisionEngine::Caption> EmptyCaption(const CameraVisionEngine::SubmitCallback& callback) {
+    std::promise<CameraVisionEngine::Caption> promise;
+    promise.set_value(CameraVisionEngine::Caption());
+    if (callback) {
+        callback(CameraVisionEngine::Caption());
+    }
+    return promise.get_future();
+}
+
+} // namespace
+
 CameraVisionEngine::CameraVisionEngine()
-    : isInitialized(false), lastLatencyMs(0.0f) {
+    : decoderVocabSize(0), captureFps(FrameCapture::DEFAULT_FPS), captureBackend(FrameCapture::Backend::Auto), lastFrameAgeMs(0.0f),
+      stopTailLength(1), maxDraftTokens(DEFAULT_DRAFT_TOKENS), lastSpeculationStats{0, 0, 0},
+      visionEncoderBytes(0), embedTokensBytes(0), decoderBytes(0), kvCacheBytes(0), sceneArenaBytes(0), embeddingTableBytes(0),
+      featureCacheBytes(0), memoryReporterId(0),
+      useOptimizedModels(true), encoderThreads(0), uncachedOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL), executionProviders{"DirectML", "OpenVINO", "CPU"}, modelVariant("auto"), embeddingTableEnabled(false), embeddingTableRows(0), stepEmbeds(HIDDEN_SIZE, 0.0f),
+      batchedModels(false), modelsLoaded(false), isInitialized(false), lastLatencyMs(0.0f), warm(false), warmingUp(false),
+      encoderDone(false), pipelineRunning(false), pipelineStop(false), framesInFlight(0),
+      requestStop(false), requestsCoalesced(0),
+      sceneChangeThreshold(DEFAULT_SCENE_CHANGE_THRESHOLD), scenesDescribed(0), scenesSkipped(0), scenesEmpty(0),
+      lastSceneDistance(-1), lastSceneSkipped(false),
+      featureCacheCapacity(DEFAULT_FEATURE_CACHE_CAPACITY), featureCacheThreshold(DEFAULT_FEATURE_CACHE_THRESHOLD),
+      featureCacheHits(0), featureCacheMisses(0), kvCapacity(0), kvBatchCapacity(0),
+      kvElementType(ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT), kvElementBytes(sizeof(float)),
+      promptTokens(FastVLMTokenizer::GetChatPromptTokens()), promptCacheReady(false), promptPrefixLength(0) {
+    // ImageNet normalization: mean=[0.485, 0.456, 0.406], std=[0.229, 0.224, 0.225]
+    const float mean[3] = {0.485f, 0.456f, 0.406f};
+    const float stddev[3] = {0.229f, 0.224f, 0.225f};
+    for (int c = 0; c < 3; ++c) {
+        for (int v = 0; v < 256; ++v) {
+            normalizeLut[c][v] = (v / 255.0f - mean[c]) / stddev[c];
+        }
+    }
+
+    for (int layer = 0; layer < NUM_LAYERS; ++layer) {
+        kvInputNames.push_back("past_key_values." + std::to_string(layer) + ".key");
+        kvInputNames.push_back("past_key_values." + std::to_string(layer) + ".value");
+        kvOutputNames.push_back("present." + std::to_string(layer) + ".key");
+        kvOutputNames.push_back("present." + std::to_string(layer) + ".value");
+    }
+
+    SetGenerationConfig(generationConfig);
+
+    memoryReporterId = MemoryAccounting::Instance().Register([this](MemoryAccounting::Entries& entries) {
+        entries.push_back({ "ort_session", "vision_encoder", visionEncoderBytes.load() });
+        entries.push_back({ "ort_session", "embed_tokens", embedTokensBytes.load() });
+        entries.push_back({ "ort_session", "decoder", decoderBytes.load() });
+        entries.push_back({ "kv_cache", "caption_decoder", kvCacheBytes.load() });
+        entries.push_back({ "kv_cache", "scene_arena", sceneArenaBytes.load() });
+        entries.push_back({ "vision_cache", "embedding_table", embeddingTableBytes.load() });
+        entries.push_back({ "vision_cache", "scene_features", featureCacheBytes.load() });
+    });
 }
 
 CameraVisionEngine::~CameraVisionEngine() {
-    if (camera.isOpened()) {
-        camera.release();
+    StopRequests();
+    StopPipeline();
+    MemoryAccounting::Instance().Unregister(memoryReporterId);
+    CloseCameras();
+}
+
+void CameraVisionEngine::CloseCameras() {
+    for (auto& stream : streams) {
+        stream.capture->Close();
+    }
+}
+
+void CameraVisionEngine::Cancel() {
+    runOptions.SetTerminate();
+    LOG_DEBUG("Camera", "Inference cancelled");
+}
+
+bool CameraVisionEngine::ReopenCameras() {
+    bool opened = false;
+    for (auto& stream : streams) {
+        // Close() keeps the index; Open() closes again first, so a stream that is still open just restarts
+        opened = stream.capture->Open(stream.capture->GetCameraIndex()) || opened;
+    }
+    return opened;
+}
+
+// ============================================================================
+// Capture Streams
+// ============================================================================
+
+void CameraVisionEngine::SetCaptureFps(double fps) {
+    captureFps = fps > 0.0 ? fps : FrameCapture::DEFAULT_FPS;
+    for (auto& stream : streams) {
+        stream.capture->SetFps(captureFps);
+    }
+}
+
+uint64_t CameraVisionEngine::GetCapturedFrameCount() const {
+    uint64_t total = 0;
+    for (const auto& stream : streams) {
+        total += stream.capture->GetCapturedFrameCount();
     }
+    return total;
 }
 
 bool CameraVisionEngine::Initialize(const std::string& modelPath, int cameraIndex) {
+    return Initialize(modelPath, std::vector<int>{cameraIndex});
+}
+
+bool CameraVisionEngine::Initialize(const std::string& modelPath, const std::vector<int>& cameraIndices) {
+    try {
+        LOG_INFO("Camera", "Initializing CameraVisionEngine (" << cameraIndices.size() << " camera"
+                 << (cameraIndices.size() == 1 ? "" : "s") << ")...");
+
+        if (cameraIndices.empty()) {
+            LOG_ERROR("Camera", "No cameras requested");
+            return false;
+        }
+
+        if (!InitializeModels(modelPath, cameraIndices.size() > 1)) {
+            return false;
+        }
+
+        // Open each camera; capture runs continuously into its latest-frame mailbox
+        for (int cameraIndex : cameraIndices) {
+            CaptionStream stream;
+            stream.capture = std::make_unique<FrameCapture>();
+            stream.capture->SetFps(captureFps);
+            stream.capture->SetBackend(captureBackend);
+            if (!captureSource.empty() && !stream.capture->SetSource(captureSource)) {
+                LOG_ERROR("Camera", "Unknown capture source: " << captureSource);
+                return false;
+            }
+            if (!regionDetector.IsReady()) {
+                stream.capture->SetNativeOutputSize(IMAGE_SIZE, IMAGE_SIZE);
+            }
+            StartupTimeline::Span span("camera_open");
+            if (!stream.capture->Open(cameraIndex)) {
+                continue;
+            }
+            streams.push_back(std::move(stream));
+        }
+        if (streams.empty()) {
+            LOG_ERROR("Camera", "Failed to open camera");
+            return false;
+        }
+
+        isInitialized = true;
+        LOG_INFO("Camera", "Initialization complete!");
+        return true;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Initialization error: " << e.what());
+        return false;
+    }
+}
+
+bool CameraVisionEngine::InitializeWithoutCamera(const std::string& modelPath) {
     try {
-        std::cout << "[Camera] Initializing CameraVisionEngine..." << std::endl;
+        LOG_INFO("Camera", "Initializing CameraVisionEngine (models only)...");
+        if (!InitializeModels(modelPath, false)) {
+            return false;
+        }
+
+        isInitialized = true;
+        LOG_INFO("Camera", "Initialization complete!");
+        return true;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Initialization error: " << e.what());
+        return false;
+    }
+}
+
+bool CameraVisionEngine::InitializeModels(const std::string& modelPath, bool batched) {
+    // Load the vocabulary once; DecodeTokens reuses it for every scene.
+    // Prefer the memory-mapped vocab.bin; on first run convert vocab.json.
+    std::string vocabPath = modelPath + "/vocab.json";
+    std::string vocabBinPath = modelPath + "/vocab.bin";
+    {
+        StartupTimeline::Span span("vocab_load");
+        if (!tokenizer.LoadBinaryVocab(vocabBinPath)) {
+            LOG_INFO("Camera", "Compiling " << vocabPath << " -> " << vocabBinPath << "...");
+            if (!FastVLMTokenizer::ConvertVocab(vocabPath, vocabBinPath) ||
+                !tokenizer.LoadBinaryVocab(vocabBinPath)) {
+                // Read-only model dir or conversion failure: parse the JSON directly
+                LOG_WARNING("Camera", "Binary vocabulary unavailable, loading " << vocabPath);
+                if (!tokenizer.LoadVocab(vocabPath)) {
+                    LOG_ERROR("Camera", "Failed to load vocabulary from " << vocabPath);
+                    return false;
+                }
+            }
+        }
+        // Only needed to encode new questions; captions decode without it
+        std::string mergesPath = modelPath + "/merges.txt";
+        if (!tokenizer.LoadMerges(mergesPath)) {
+            LOG_WARNING("Camera", "No BPE merges at " << mergesPath << ", prompt questions are fixed");
+        } else if (tokenizer.EncodeChatPrompt(FastVLMTokenizer::DEFAULT_QUESTION) !=
+                   FastVLMTokenizer::GetChatPromptTokens()) {
+            LOG_WARNING("Camera", "Encoded default prompt differs from the built-in tokens; "
+                        "check that merges.txt belongs to " << vocabPath);
+        }
+    }
+
+    modelDirectory = modelPath;
+    // Several crops of one frame decode as a batch too
+    batchedModels = batched || (regionDetector.IsReady() && regionDetector.GetMaxRegions() > 1);
+
+    variants.Discover(modelDirectory + "/onnx");
+    if (modelVariant == "auto") {
+        // A winner only holds for the CPU and provider list it was measured on
+        std::string machineKey = ModelVariants::DescribeCpu(ModelVariants::DetectCpu());
+        for (const auto& provider : executionProviders) {
+            machineKey += "|" + provider;
+        }
+        variants.LoadSelection(machineKey);
+    }
+    // Sessions, embedding table and prompt cache; UnloadModels() can drop them later
+    return LoadModels();
+}
 
-        // Initialize ONNX Runtime environment
-        ortEnv = std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "CameraVisionEngine");
+// ============================================================================
+// Model Lifetime
+// ============================================================================
 
-        sessionOptions = std::make_unique<Ort::SessionOptions>();
-        sessionOptions->SetIntraOpNumThreads(4);  // 4 threads for CPU inference
-        sessionOptions->SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);  // Disable optimization to avoid dynamic shape issues
+bool CameraVisionEngine::LoadModels() {
+    try {
+        // Several streams batch the encoder and decoder, so keep batch_size dynamic there
+        std::vector<std::pair<std::string, int64_t>> visionDims = {{"height", 224}, {"width", 224}};
+        std::vector<std::pair<std::string, int64_t>> decoderDims;
+        if (!batchedModels) {
+            visionDims.push_back({"batch_size", 1});
+            decoderDims.push_back({"batch_size", 1});
+        }
 
         memoryInfo = std::make_unique<Ort::MemoryInfo>(
             Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)
         );
 
-        // Load ONNX models
-        std::cout << "[Camera] Loading vision encoder..." << std::endl;
-        std::string visionPath = modelPath + "/onnx/vision_encoder_simplified.onnx";
-        visionEncoder = LoadOnnxModel(visionPath);
-        if (!visionEncoder) {
-            std::cerr << "[Camera] Failed to load vision encoder" << std::endl;
-            return false;
-        }
+        // Load ONNX models
+        LOG_INFO("Camera", "Loading vision encoder...");
+        MemoryAccounting::Meter visionMeter;
+        std::optional<StartupTimeline::Span> span;      // One step at a time: emplace closes the previous
+        span.emplace("vision_encoder_session");
+        visionEncoder = LoadModelVariant(ModelVariants::Component::VisionEncoder, visionDims,
+                                         [this](Ort::Session& session) { BenchmarkVisionEncoder(session); },
+                                         encoderThreads);
+        if (!visionEncoder) {
+            LOG_ERROR("Camera", "Failed to load vision encoder");
+            return false;
+        }
+        if (!BindVisionEncoder()) {
+            LOG_WARNING("Camera", "Vision encoder IoBinding unavailable, allocating tensors per frame");
+        }
+        visionEncoderBytes = visionMeter.Bytes();
+
+        LOG_INFO("Camera", "Loading embed tokens model...");
+        MemoryAccounting::Meter embedMeter;
+        span.emplace("embed_tokens_session");
+        embedTokens = LoadModelVariant(ModelVariants::Component::EmbedTokens, {{"batch_size", 1}},
+                                       [this](Ort::Session& session) { BenchmarkEmbedTokens(session); });
+        if (!embedTokens) {
+            LOG_ERROR("Camera", "Failed to load embed tokens model");
+            return false;
+        }
+        embedTokensBytes = embedMeter.Bytes();
+
+        LOG_INFO("Camera", "Loading decoder model...");
+        MemoryAccounting::Meter decoderMeter;
+        span.emplace("decoder_session");
+        decoder = LoadModelVariant(ModelVariants::Component::Decoder, decoderDims,
+                                   [this](Ort::Session& session) { BenchmarkDecoder(session); });
+        if (!decoder) {
+            LOG_ERROR("Camera", "Failed to load decoder model");
+            return false;
+        }
+        decoderBytes = decoderMeter.Bytes();
+        span.reset();
+
+        // KV banks follow the decoder's past_key_values precision
+        ONNXTensorElementDataType kvType = KVElementType(*decoder) == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16
+            ? ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 : ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+        size_t kvBytes = kvType == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 ? sizeof(uint16_t) : sizeof(float);
+        if (kvBytes != kvElementBytes) {
+            kvCapacity = 0;     // Reallocated at the new width on first use
+            kvBatchCapacity = 0;
+        }
+        kvElementType = kvType;
+        kvElementBytes = kvBytes;
+        LOG_INFO("Camera", "KV cache precision: " << (kvBytes == sizeof(float) ? "fp32" : "fp16"));
+
+        // A fixed logits width lets each run's logits go into the scene arena
+        decoderVocabSize = 0;
+        Ort::AllocatorWithDefaultOptions allocator;
+        for (size_t i = 0; i < decoder->GetOutputCount(); ++i) {
+            if (std::string(decoder->GetOutputNameAllocated(i, allocator).get()) == "logits") {
+                std::vector<int64_t> shape = decoder->GetOutputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape();
+                decoderVocabSize = shape.size() == 3 && shape[2] > 0 ? shape[2] : 0;
+            }
+        }
+        if (decoderVocabSize == 0) {
+            LOG_WARNING("Camera", "Decoder logits width is dynamic, leaving logits to ORT's allocator");
+        }
+
+        if (embeddingTableEnabled) {
+            span.emplace("embedding_table");
+            // Special tokens (e.g. <image>) sit past the end of vocab.json
+            size_t rows = (std::max)(tokenizer.Size(), static_cast<size_t>(FastVLMTokenizer::IMAGE_TOKEN_ID + 1));
+            if (!BuildEmbeddingTable(rows)) {
+                LOG_WARNING("Camera", "Embedding table unavailable, using embed_tokens per step");
+            }
+        }
+
+        // Constant prompt text: embed once, prefill the pre-image prefix once
+        span.emplace("prompt_cache");
+        if (!PreparePromptCache()) {
+            LOG_WARNING("Camera", "Prompt cache unavailable, embedding full prompt per scene");
+        }
+
+        modelsLoaded = true;
+        PublishMemoryUsage();
+        return true;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Model load error: " << e.what());
+        return false;
+    }
+}
+
+bool CameraVisionEngine::EnsureModelsLoaded() {
+    if (modelsLoaded) {
+        return true;
+    }
+
+    LOG_INFO("Camera", "Reloading FastVLM sessions...");
+    auto start = std::chrono::steady_clock::now();
+    if (!LoadModels()) {
+        UnloadModels();     // Drop whatever half-loaded
+        return false;
+    }
+    LOG_INFO("Camera", "FastVLM sessions reloaded in "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+             << "ms");
+    return true;
+}
+
+void CameraVisionEngine::UnloadModels() {
+    std::lock_guard<std::mutex> captionLock(captionMutex);
+    if (IsPipelineBusy("UnloadModels")) {
+        return;
+    }
+    encoderBinding.reset();     // Refers to the session, so goes first
+    visionEncoder.reset();
+    embedTokens.reset();
+    decoder.reset();
+    decoderVocabSize = 0;
+    sceneArena.Release();
+    sceneArenaBytes = 0;
+
+    // Everything sized for or derived from the sessions; swap to actually free
+    std::vector<uint16_t>().swap(embeddingTable);
+    embeddingTableRows = 0;
+    for (int bank = 0; bank < 2; ++bank) {
+        for (auto& buffer : kvBanks[bank]) {
+            std::vector<uint8_t>().swap(buffer);
+        }
+    }
+    for (auto& buffer : promptPrefixKV) {
+        std::vector<uint8_t>().swap(buffer);
+    }
+    std::vector<float>().swap(promptSuffixEmbeds);
+    promptPrefixTokens.clear();
+    std::vector<float>().swap(encoderInput);
+    std::vector<float>().swap(encoderOutput);
+    std::vector<int64_t>().swap(attentionMask);
+    kvCapacity = 0;
+    kvBatchCapacity = 0;
+    promptCacheReady = false;
+    visionEncoderBytes = 0;
+    embedTokensBytes = 0;
+    decoderBytes = 0;
+    PublishMemoryUsage();
+
+    if (modelsLoaded) {
+        LOG_INFO("Camera", "FastVLM sessions unloaded");
+    }
+    modelsLoaded = false;
+    warm.store(false);
+}
+
+void CameraVisionEngine::PublishMemoryUsage() {
+    uint64_t kvBytes = attentionMask.capacity() * sizeof(int64_t) + promptSuffixEmbeds.capacity() * sizeof(float);
+    for (int bank = 0; bank < 2; ++bank) {
+        for (const auto& buffer : kvBanks[bank]) {
+            kvBytes += buffer.capacity();
+        }
+    }
+    for (const auto& buffer : promptPrefixKV) {
+        kvBytes += buffer.capacity();
+    }
+    kvCacheBytes = kvBytes;
+    embeddingTableBytes = embeddingTable.capacity() * sizeof(uint16_t);
+}
+
+void CameraVisionEngine::PublishFeatureCacheUsage() {
+    uint64_t featureBytes = 0;
+    for (const auto& entry : featureCache) {
+        featureBytes += sizeof(entry) + entry.imageFeatures.capacity() * sizeof(float) + entry.description.capacity();
+    }
+    featureCacheBytes = featureBytes;
+}
+
+std::unique_ptr<Ort::Session> CameraVisionEngine::LoadOnnxModel(
+    const std::string& modelPath,
+    const std::vector<std::pair<std::string, int64_t>>& dimensionOverrides,
+    const std::function<void(Ort::Session&)>& benchmark,
+    int privateThreads) {
+    try {
+        LOG_INFO("Camera", "Loading model from: " << modelPath);
+
+        // Convert UTF-8 string to wide string for Windows
+        auto toWide = [](const std::string& path) {
+            int wideSize = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+            if (wideSize <= 1) {
+                return std::wstring();
+            }
+            std::wstring wide(wideSize, 0);
+            MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], wideSize);
+            wide.resize(wideSize - 1);  // Drop the terminator MultiByteToWideChar counted
+            return wide;
+        };
+
+        std::wstring wModelPath = toWide(modelPath);
+        if (wModelPath.empty()) {
+            LOG_ERROR("Camera", "Failed to convert path: " << modelPath);
+            return nullptr;
+        }
+
+        // Shared runtime: global intra-op pool instead of a private 4-thread pool
+        OrtRuntime::SessionConfig config;
+        config.logId = "CameraVisionEngine";
+        if (privateThreads > 0) {
+            config.useGlobalThreadPool = false;
+            config.intraOpThreads = privateThreads;
+        }
+
+        // A reload after UnloadModels() reuses the provider the first probe picked
+        std::vector<std::string> candidates = executionProviders;
+        auto chosen = chosenProviders.find(modelPath);
+        if (chosen != chosenProviders.end()) {
+            candidates = {chosen->second};
+        }
+
+        std::unique_ptr<Ort::Session> session;
+        if (useOptimizedModels) {
+            // Optimize once with the fixed shapes pinned (fusions need static dims),
+            // then later starts load <model>.opt.onnx directly. EXTENDED rather than
+            // ALL keeps the serialized graph free of hardware-specific layouts.
+            // A graph with batch_size left dynamic (multi-stream) is cached separately
+            bool fixedBatch = std::any_of(dimensionOverrides.begin(), dimensionOverrides.end(),
+                [](const std::pair<std::string, int64_t>& dim) { return dim.first == "batch_size"; });
+            std::string optimizedPath = modelPath;
+            size_t extension = optimizedPath.rfind(".onnx");
+            optimizedPath = (extension != std::string::npos ? optimizedPath.substr(0, extension) : optimizedPath) +
+                            (fixedBatch ? ".opt.onnx" : ".batched.opt.onnx");
+
+            config.optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_EXTENDED;
+            config.freeDimensionOverrides = dimensionOverrides;
+            config.optimizedModelPath = toWide(optimizedPath);
+
+            LOG_DEBUG("Camera", "Attempting to load optimized ONNX session...");
+            session = OrtRuntime::Instance().CreateFastestSession(wModelPath, config, candidates, benchmark,
+                                                                  &chosenProviders[modelPath]);
+            if (!session) {
+                LOG_WARNING("Camera", "Optimized load failed, retrying without graph optimizations");
+            }
+        }
+
+        if (!session) {
+            // Disabled by default to avoid dynamic shape issues; always after a failed cached load
+            config.optimizationLevel = useOptimizedModels ? GraphOptimizationLevel::ORT_DISABLE_ALL
+                                                          : uncachedOptimizationLevel;
+            config.freeDimensionOverrides.clear();
+            config.optimizedModelPath.clear();
+
+            LOG_DEBUG("Camera", "Attempting to load ONNX session...");
+            session = OrtRuntime::Instance().CreateFastestSession(wModelPath, config, candidates, benchmark,
+                                                                  &chosenProviders[modelPath]);
+        }
+        if (!session) {
+            LOG_ERROR("Camera", "Failed to create session for " << modelPath);
+            return nullptr;
+        }
+        LOG_INFO("Camera", "Model loaded successfully!");
+        return session;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Error loading model " << modelPath << ": " << e.what());
+        return nullptr;
+    }
+}
+
+std::unique_ptr<Ort::Session> CameraVisionEngine::LoadModelVariant(
+    ModelVariants::Component component,
+    const std::vector<std::pair<std::string, int64_t>>& dimensionOverrides,
+    const std::function<void(Ort::Session&)>& benchmark,
+    int privateThreads) {
+    const int index = static_cast<int>(component);
+    const char* name = ModelVariants::Name(component);
+
+    // A reload after UnloadModels() reuses the variant loaded the first time
+    if (!chosenVariants[index].empty()) {
+        return LoadOnnxModel(chosenVariants[index], dimensionOverrides, benchmark, privateThreads);
+    }
+
+    bool gpuProvider = std::any_of(executionProviders.begin(), executionProviders.end(),
+        [](const std::string& provider) {
+            return provider != "CPU" && OrtRuntime::Instance().IsProviderAvailable(provider);
+        });
+    std::vector<ModelVariants::Variant> candidates = variants.Rank(component, gpuProvider);
+    if (candidates.empty()) {
+        LOG_ERROR("Camera", "No " << name << " model found in " << modelDirectory << "/onnx");
+        return nullptr;
+    }
+
+    // Requested (or previously benchmarked) precision goes first, the ranking stays as fallback
+    ModelVariants::Precision wanted;
+    bool benchmarkAll = modelVariant == "auto" && !variants.GetSelection(component, wanted);
+    bool hasWanted = modelVariant == "auto" ? !benchmarkAll
+                                                 : ModelVariants::ParsePrecision(modelVariant, wanted);
+    if (hasWanted) {
+        auto it = std::find_if(candidates.begin(), candidates.end(),
+            [wanted](const ModelVariants::Variant& variant) { return variant.precision == wanted; });
+        if (it != candidates.end()) {
+            std::rotate(candidates.begin(), it, it + 1);
+        } else {
+            LOG_WARNING("Camera", "No " << ModelVariants::Name(wanted) << " " << name
+                        << " on disk, using " << ModelVariants::Name(candidates.front().precision));
+        }
+    }
+
+    std::unique_ptr<Ort::Session> best;
+    const ModelVariants::Variant* bestVariant = nullptr;
+    double bestMs = 0.0;
+    for (const auto& variant : candidates) {
+        auto session = LoadOnnxModel(variant.path, dimensionOverrides, benchmark, privateThreads);
+        if (!session) {
+            // e.g. a variant exported with float16 inputs/outputs
+            LOG_WARNING("Camera", ModelVariants::Name(variant.precision) << " " << name << " failed to load, trying next");
+            continue;
+        }
+        if (!benchmarkAll) {
+            best = std::move(session);
+            bestVariant = &variant;
+            break;
+        }
+
+        // Same probe the provider choice used: one warm-up, then the mean of a few runs
+        double totalMs = 0.0;
+        try {
+            benchmark(*session);
+            for (int run = 0; run < VARIANT_PROBE_RUNS; ++run) {
+                auto start = std::chrono::steady_clock::now();
+                benchmark(*session);
+                totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+        } catch (const Ort::Exception& e) {
+            LOG_WARNING("Camera", ModelVariants::Name(variant.precision) << " " << name << " probe failed: " << e.what());
+            continue;
+        }
+        double meanMs = totalMs / VARIANT_PROBE_RUNS;
+        LOG_INFO("Camera", name << " " << ModelVariants::Name(variant.precision) << ": " << meanMs << " ms/probe");
+        if (!best || meanMs < bestMs) {
+            best = std::move(session);      // The slower session is released here, before the next load
+            bestVariant = &variant;
+            bestMs = meanMs;
+        }
+    }
+    if (!best) {
+        return nullptr;
+    }
+
+    chosenVariants[index] = bestVariant->path;
+    LOG_INFO("Camera", "Using " << ModelVariants::Name(bestVariant->precision) << " " << name
+             << " (" << (bestVariant->bytes >> 20) << " MB, cpu " << ModelVariants::DescribeCpu(ModelVariants::DetectCpu())
+             << ")");
+    if (benchmarkAll) {
+        variants.SetSelection(component, bestVariant->precision);
+        if (!variants.SaveSelection()) {
+            LOG_WARNING("Camera", "Could not save variant choice to " << modelDirectory << "/onnx");
+        }
+    }
+    return best;
+}
+
+// ============================================================================
+// Execution Provider Probes
+// ============================================================================
+
+void CameraVisionEngine::BenchmarkVisionEncoder(Ort::Session& session) {
+    std::vector<float> pixels(static_cast<size_t>(3) * IMAGE_SIZE * IMAGE_SIZE, 0.0f);
+    const int64_t shape[] = {1, 3, IMAGE_SIZE, IMAGE_SIZE};
+    Ort::Value input = Ort::Value::CreateTensor<float>(*memoryInfo, pixels.data(), pixels.size(), shape, 4);
+
+    const char* inputNames[] = {"pixel_values"};
+    const char* outputNames[] = {"image_features"};
+    session.Run(runOptions, inputNames, &input, 1, outputNames, 1);
+}
+
+void CameraVisionEngine::BenchmarkEmbedTokens(Ort::Session& session) {
+    std::vector<int64_t> ids(8, 0);
+    const int64_t shape[] = {1, static_cast<int64_t>(ids.size())};
+    Ort::Value input = Ort::Value::CreateTensor<int64_t>(*memoryInfo, ids.data(), ids.size(), shape, 2);
+
+    const char* inputNames[] = {"input_ids"};
+    const char* outputNames[] = {"inputs_embeds"};
+    session.Run(runOptions, inputNames, &input, 1, outputNames, 1);
+}
+
+void CameraVisionEngine::BenchmarkDecoder(Ort::Session& session) {
+    // One token with an empty cache: the per-step shape Generate runs most
+    std::vector<float> embeds(HIDDEN_SIZE, 0.0f);
+    int64_t mask = 1;
+    int64_t position = 0;
+    float emptyPast = 0.0f;
+    ONNXTensorElementDataType pastType = KVElementType(session);
+
+    const int64_t embedShape[] = {1, 1, HIDDEN_SIZE};
+    const int64_t tokenShape[] = {1, 1};
+    const int64_t pastShape[] = {1, NUM_HEADS, 0, HEAD_DIM};
+
+    Ort::IoBinding binding(session);
+    Ort::Value embedTensor = Ort::Value::CreateTensor<float>(*memoryInfo, embeds.data(), embeds.size(), embedShape, 3);
+    Ort::Value maskTensor = Ort::Value::CreateTensor<int64_t>(*memoryInfo, &mask, 1, tokenShape, 2);
+    Ort::Value posTensor = Ort::Value::CreateTensor<int64_t>(*memoryInfo, &position, 1, tokenShape, 2);
+    binding.BindInput("inputs_embeds", embedTensor);
+    binding.BindInput("attention_mask", maskTensor);
+    binding.BindInput("position_ids", posTensor);
+    binding.BindOutput("logits", *memoryInfo);
+
+    std::vector<Ort::Value> pastTensors;
+    pastTensors.reserve(NUM_LAYERS * 2);
+    for (int i = 0; i < NUM_LAYERS * 2; ++i) {
+        pastTensors.push_back(Ort::Value::CreateTensor(*memoryInfo, &emptyPast, 0, pastShape, 4, pastType));
+        binding.BindInput(kvInputNames[i].c_str(), pastTensors.back());
+        binding.BindOutput(kvOutputNames[i].c_str(), *memoryInfo);
+    }
+
+    session.Run(runOptions, binding);
+}
+
+void CameraVisionEngine::PreprocessImage(const cv::Mat& frame, std::vector<float>& output, size_t batchIndex) {
+    PipelineLatency::Timer timer(PipelineLatency::Stage::Preprocess);
+    TRACE_ZONE("Camera preprocess");
+
+    // Camera frames are BGR8 (OpenCV) or BGRA8 (Media Foundation); anything else
+    // is converted once up front
+    const cv::Mat* source = &frame;
+    int pixelStride = 3;
+    if (frame.type() == CV_8UC4) {
+        pixelStride = 4;
+    } else if (frame.type() != CV_8UC3) {
+        if (frame.channels() == 1) {
+            cv::cvtColor(frame, convertedFrame, cv::COLOR_GRAY2BGR);
+        } else {
+            frame.convertTo(convertedFrame, CV_8UC3);
+        }
+        source = &convertedFrame;
+    }
+
+    // Resize to 224x224 (FastVLM input size) unless the camera already delivered
+    // that; reuses resizedFrame's storage
+    if (source->cols != IMAGE_SIZE || source->rows != IMAGE_SIZE) {
+        cv::resize(*source, resizedFrame, cv::Size(IMAGE_SIZE, IMAGE_SIZE));
+        source = &resizedFrame;
+    }
+
+    // Fused BGR->RGB + normalize + HWC->CHW in one pass over the pixels
+    const size_t planeSize = static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE;
+    if (output.size() < (batchIndex + 1) * 3 * planeSize) {
+        output.resize((batchIndex + 1) * 3 * planeSize);
+    }
+
+    float* red = output.data() + batchIndex * 3 * planeSize;
+    float* green = red + planeSize;
+    float* blue = green + planeSize;
+    const float* lutR = normalizeLut[0];
+    const float* lutG = normalizeLut[1];
+    const float* lutB = normalizeLut[2];
+
+    for (int h = 0; h < IMAGE_SIZE; ++h) {
+        const uint8_t* row = source->ptr<uint8_t>(h);
+        size_t base = static_cast<size_t>(h) * IMAGE_SIZE;
+        for (int w = 0; w < IMAGE_SIZE; ++w) {
+            const uint8_t* px = row + w * pixelStride;
+            blue[base + w] = lutB[px[0]];
+            green[base + w] = lutG[px[1]];
+            red[base + w] = lutR[px[2]];
+        }
+    }
+}
+
+uint64_t CameraVisionEngine::ComputeFrameHash(const cv::Mat& frame) {
+    cv::Mat gray;
+    if (frame.channels() == 1) {
+        gray = frame;
+    } else {
+        cv::cvtColor(frame, gray, frame.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+
+    // INTER_AREA averages whole blocks, so sensor noise barely moves the bits
+    cv::Mat thumb;
+    cv::resize(gray, thumb, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+
+    uint64_t hash = 0;
+    for (int y = 0; y < 8; ++y) {
+        const uint8_t* row = thumb.ptr<uint8_t>(y);
+        for (int x = 0; x < 8; ++x) {
+            hash = (hash << 1) | (row[x] > row[x + 1] ? 1u : 0u);
+        }
+    }
+    return hash;
+}
+
+CameraVisionEngine::SceneStats CameraVisionEngine::GetSceneStats() const {
+    SceneStats stats;
+    stats.scenesDescribed = scenesDescribed.load();
+    stats.scenesSkipped = scenesSkipped.load();
+    stats.lastSceneDistance = lastSceneDistance.load();
+    stats.cacheHits = featureCacheHits.load();
+    stats.cacheMisses = featureCacheMisses.load();
+    stats.scenesEmpty = scenesEmpty.load();
+    stats.requestsCoalesced = requestsCoalesced.load();
+    return stats;
+}
+
+void CameraVisionEngine::SetFeatureCacheConfig(size_t capacity, int thresholdBits) {
+    featureCacheCapacity = capacity;
+    featureCacheThreshold = thresholdBits;
+    while (featureCache.size() > featureCacheCapacity) {
+        featureCache.pop_back();
+    }
+    PublishFeatureCacheUsage();
+}
+
+CameraVisionEngine::FeatureCacheEntry* CameraVisionEngine::LookupFeatureCache(uint64_t hash) {
+    auto best = featureCache.end();
+    int bestDistance = featureCacheThreshold + 1;
+    for (auto it = featureCache.begin(); it != featureCache.end(); ++it) {
+        int distance = static_cast<int>(std::bitset<64>(hash ^ it->hash).count());
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = it;
+        }
+    }
+
+    if (best == featureCache.end()) {
+        return nullptr;
+    }
+
+    featureCache.splice(featureCache.begin(), featureCache, best);
+    return &featureCache.front();
+}
+
+void CameraVisionEngine::StoreFeatureCache(uint64_t hash, const std::vector<float>& imageFeatures,
+                                           const std::string& description) {
+    if (featureCacheCapacity == 0) {
+        return;
+    }
+
+    // Refresh an exact match in place rather than holding two copies of one scene
+    for (auto it = featureCache.begin(); it != featureCache.end(); ++it) {
+        if (it->hash == hash) {
+            it->imageFeatures = imageFeatures;
+            it->description = description;
+            featureCache.splice(featureCache.begin(), featureCache, it);
+            PublishFeatureCacheUsage();
+            return;
+        }
+    }
+
+    featureCache.push_front({hash, imageFeatures, description});
+    while (featureCache.size() > featureCacheCapacity) {
+        featureCache.pop_back();
+    }
+    PublishFeatureCacheUsage();
+}
+
+std::vector<float> CameraVisionEngine::RunVisionEncoder(const std::vector<float>& imageData, int batchSize) {
+    PipelineLatency::Timer timer(PipelineLatency::Stage::Encoder);
+    TRACE_ZONE("Camera vision encoder");
+    try {
+        LOG_DEBUG("Camera", "Vision encoder input data size: " << imageData.size());
+
+        // Input shape: [B, 3, 224, 224]
+        std::vector<int64_t> inputShape = {batchSize, 3, 224, 224};
+
+        // Verify data size covers the shape (the buffer may be larger from a bigger batch)
+        size_t expectedSize = static_cast<size_t>(batchSize) * 3 * 224 * 224;
+        if (batchSize < 1 || imageData.size() < expectedSize) {
+            LOG_ERROR("Camera", "Image data size mismatch! Got " << imageData.size()
+                      << ", expected " << expectedSize);
+            return {};
+        }
+
+        LOG_DEBUG("Camera", "Creating input tensor with shape [" << batchSize << ", 3, 224, 224]");
+
+        // Create input tensor
+        Ort::Value inputTensor = Ort::Value::CreateTensor<float>(
+            *memoryInfo,
+            const_cast<float*>(imageData.data()),
+            expectedSize,
+            inputShape.data(),
+            inputShape.size()
+        );
+
+        LOG_DEBUG("Camera", "Input tensor created, running inference...");
+
+        // Run inference
+        const char* inputNames[] = {"pixel_values"};
+        const char* outputNames[] = {"image_features"};
+
+        auto outputTensors = visionEncoder->Run(
+            runOptions,
+            inputNames,
+            &inputTensor,
+            1,
+            outputNames,
+            1
+        );
+
+        // Get output (shape: [B, 16, 896])
+        float* outputData = outputTensors[0].GetTensorMutableData<float>();
+        auto tensorInfo = outputTensors[0].GetTensorTypeAndShapeInfo();
+        size_t outputSize = tensorInfo.GetElementCount();
+
+        std::vector<float> imageFeatures(outputData, outputData + outputSize);
+        return imageFeatures;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Vision encoder error: " << e.what());
+        return {};
+    }
+}
+
+bool CameraVisionEngine::BindVisionEncoder() {
+    encoderBinding.reset();
+    try {
+        const size_t inputSize = static_cast<size_t>(3) * IMAGE_SIZE * IMAGE_SIZE;
+        const int64_t inputShape[] = {1, 3, IMAGE_SIZE, IMAGE_SIZE};
+        encoderInput.assign(inputSize, 0.0f);
+
+        auto binding = std::make_unique<Ort::IoBinding>(*visionEncoder);
+        binding->BindInput("pixel_values", Ort::Value::CreateTensor<float>(
+            *memoryInfo, encoderInput.data(), inputSize, inputShape, 4));
+
+        // Output [1, tokens, hidden]: from the graph, or from one run on the zero image
+        // when the export left those dims symbolic
+        std::vector<int64_t> outputShape =
+            visionEncoder->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        if (!outputShape.empty() && outputShape[0] < 0) {
+            outputShape[0] = 1;
+        }
+        if (outputShape.empty() || std::any_of(outputShape.begin(), outputShape.end(),
+                                               [](int64_t dim) { return dim <= 0; })) {
+            binding->BindOutput("image_features", *memoryInfo);
+            visionEncoder->Run(runOptions, *binding);
+            outputShape = binding->GetOutputValues()[0].GetTensorTypeAndShapeInfo().GetShape();
+            binding->ClearBoundOutputs();
+        }
+
+        size_t outputSize = 1;
+        for (int64_t dim : outputShape) {
+            outputSize *= static_cast<size_t>(dim);
+        }
+        encoderOutput.assign(outputSize, 0.0f);
+        binding->BindOutput("image_features", Ort::Value::CreateTensor<float>(
+            *memoryInfo, encoderOutput.data(), outputSize, outputShape.data(), outputShape.size()));
+
+        encoderBinding = std::move(binding);
+        LOG_DEBUG("Camera", "Vision encoder bound: " << inputSize << " -> " << outputSize << " floats");
+        return true;
+
+    } catch (const std::exception& e) {
+        LOG_WARNING("Camera", "Vision encoder binding error: " << e.what());
+        return false;
+    }
+}
+
+const float* CameraVisionEngine::RunBoundVisionEncoder() {
+    if (!encoderBinding) {
+        encoderOutput = RunVisionEncoder(encoderInput);
+        return encoderOutput.empty() ? nullptr : encoderOutput.data();
+    }
+
+    PipelineLatency::Timer timer(PipelineLatency::Stage::Encoder);
+    TRACE_ZONE("Camera vision encoder");
+    try {
+        // Writes straight into encoderOutput; nothing is allocated per frame
+        visionEncoder->Run(runOptions, *encoderBinding);
+        return encoderOutput.data();
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Vision encoder error: " << e.what());
+        return nullptr;
+    }
+}
+
+// ============================================================================
+// Scene Description
+// ============================================================================
+
+const FrameCapture::Frame* CameraVisionEngine::AcquireStreamFrame(CaptionStream& stream, uint64_t& frameHash) {
+    const FrameCapture::Frame* latest = stream.capture->AcquireLatest();
+    if (!latest || latest->frame.empty()) {
+        LOG_ERROR("Camera", "Failed to capture frame from camera " << stream.capture->GetCameraIndex());
+        return nullptr;
+    }
+    const cv::Mat& frame = latest->frame;
+
+    // Validate frame dimensions
+    if (frame.rows == 0 || frame.cols == 0) {
+        LOG_ERROR("Camera", "Invalid frame dimensions: " << frame.rows << "x" << frame.cols);
+        return nullptr;
+    }
+
+    float ageMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - latest->timestamp).count();
+    LOG_DEBUG("Camera", "Captured frame: " << frame.cols << "x" << frame.rows
+              << " (camera " << stream.capture->GetCameraIndex() << ", #" << latest->sequence << ", "
+              << static_cast<int>(ageMs) << "ms old)");
+
+    frameHash = ComputeFrameHash(frame);
+    return latest;
+}
+
+bool CameraVisionEngine::ReuseCachedScene(CaptionStream& stream, uint64_t frameHash,
+                                          std::string& description, std::vector<float>& imageFeatures) {
+    // Scene-change gate: skip encoder + decoder if the scene hasn't materially changed
+    int threshold = sceneChangeThreshold.load();
+    if (!stream.lastDescription.empty()) {
+        int distance = static_cast<int>(std::bitset<64>(frameHash ^ stream.lastSceneHash).count());
+        lastSceneDistance.store(distance);
+
+        if (threshold >= 0 && distance <= threshold) {
+            scenesSkipped++;
+            LOG_DEBUG("Camera", "Scene unchanged (distance " << distance << " <= " << threshold
+                      << "), reusing previous description");
+            description = stream.lastDescription;
+            return true;
+        }
+    }
+
+    // Feature cache: a near-duplicate of a recent scene skips the encoder (and,
+    // if it was described, the decoder too)
+    FeatureCacheEntry* cached = featureCacheCapacity > 0 ? LookupFeatureCache(frameHash) : nullptr;
+    if (!cached) {
+        featureCacheMisses++;
+        return false;
+    }
+
+    featureCacheHits++;
+    if (!cached->description.empty()) {
+        stream.lastSceneHash = frameHash;
+        stream.lastDescription = cached->description;
+        LOG_DEBUG("Camera", "Feature cache hit, reusing cached description");
+        description = cached->description;
+        return true;
+    }
+
+    imageFeatures = cached->imageFeatures;
+    LOG_DEBUG("Camera", "Feature cache hit, reusing image features");
+    return false;
+}
+
+size_t CameraVisionEngine::InputEmbedsSize(size_t featureCount) const {
+    if (promptCacheReady) {
+        return featureCount + promptSuffixEmbeds.size();
+    }
+    return (promptTokens.empty() ? 0 : promptTokens.size() - 1) * HIDDEN_SIZE + featureCount;
+}
+
+bool CameraVisionEngine::BuildInputEmbeds(const float* imageFeatures, size_t featureCount, float* out,
+                                          int& cachedPrefix) {
+    TRACE_ZONE("Camera input embeds");
+    cachedPrefix = 0;
+    if (!promptCacheReady) {
+        return TokenizeAndEmbed(promptTokens, imageFeatures, featureCount, out);
+    }
+
+    // Prefix lives in the KV cache; only image + suffix need prefill
+    std::memcpy(out, imageFeatures, featureCount * sizeof(float));
+    std::memcpy(out + featureCount, promptSuffixEmbeds.data(), promptSuffixEmbeds.size() * sizeof(float));
+    cachedPrefix = promptPrefixLength;
+    return true;
+}
+
+void CameraVisionEngine::RecordDescription(CaptionStream& stream, uint64_t frameHash,
+                                           const std::vector<float>& imageFeatures, const std::string& description) {
+    // Gate later frames against this one (compare to the last described
+    // frame, not the last captured one, so slow drift still triggers)
+    if (!description.empty()) {
+        stream.lastSceneHash = frameHash;
+        stream.lastDescription = description;
+    }
+    StoreFeatureCache(frameHash, imageFeatures, description);
+    scenesDescribed++;
+    ThreadCpu::Instance().AddCaptions(1);
+}
+
+std::string CameraVisionEngine::CaptionFrame(const cv::Mat& frame, std::vector<float>& imageFeatures) {
+    const float* features = imageFeatures.data();
+    size_t featureCount = imageFeatures.size();
+    if (imageFeatures.empty()) {
+        // Step 2: Preprocess straight into the encoder's bound input
+        PreprocessImage(frame, encoderInput);
+
+        // Step 3: Run vision encoder; features stay in its bound output
+        features = RunBoundVisionEncoder();
+        if (!features) {
+            LOG_ERROR("Camera", "Vision encoder failed");
+            return "";
+        }
+        featureCount = encoderOutput.size();
+
+        // Only the feature cache needs a copy it owns
+        if (featureCacheCapacity > 0) {
+            imageFeatures.assign(features, features + featureCount);
+        }
+    }
+
+    // Step 4: Combine prompt embeddings with image features
+    int cachedPrefix = 0;
+    decoderInput.resize(InputEmbedsSize(featureCount));
+    if (!BuildInputEmbeds(features, featureCount, decoderInput.data(), cachedPrefix)) {
+        LOG_ERROR("Camera", "Token embedding failed");
+        return "";
+    }
+
+    // Step 5: Generate description tokens
+    std::vector<int64_t> generatedTokens = Generate(decoderInput, generationConfig.maxTokens, cachedPrefix);
+    if (generatedTokens.empty()) {
+        LOG_ERROR("Camera", "Generation failed");
+        return "";
+    }
+
+    // Step 6: Decode tokens to text
+    return DecodeTokens(generatedTokens);
+}
+
+bool CameraVisionEngine::EnableRegionDetection(const std::string& faceModelPath, int maxRegions) {
+    if (modelsLoaded) {
+        LOG_WARNING("Camera", "EnableRegionDetection must be called before Initialize");
+        return false;
+    }
+    regionDetector.SetMaxRegions(maxRegions);
+    return regionDetector.Initialize(faceModelPath);
+}
+
+std::string CameraVisionEngine::CaptionRegions(const cv::Mat& frame) {
+    std::vector<cv::Rect> regions = regionDetector.Detect(frame);
+    if (regions.empty()) {
+        scenesEmpty++;
+        LOG_DEBUG("Camera", "No regions of interest, skipping FastVLM");
+        return NO_REGIONS_DESCRIPTION;
+    }
+
+    if (regions.size() == 1) {
+        std::vector<float> imageFeatures;
+        return CaptionFrame(frame(regions.front()), imageFeatures);
+    }
+
+    // Step 2-3: every crop into its batch slot, one vision encoder run
+    int batch = static_cast<int>(regions.size());
+    for (int b = 0; b < batch; ++b) {
+        PreprocessImage(frame(regions[b]), pixelValues, b);
+    }
+    std::vector<float> features = RunVisionEncoder(pixelValues, batch);
+    if (features.empty() || features.size() % batch != 0) {
+        LOG_ERROR("Camera", "Vision encoder failed");
+        return "";
+    }
+
+    // Step 4: prompt embeddings per crop, written into their slots of decoderInput
+    size_t perImage = features.size() / batch;
+    size_t slotSize = InputEmbedsSize(perImage);
+    decoderInput.resize(batch * slotSize);
+    int cachedPrefix = 0;
+    for (int b = 0; b < batch; ++b) {
+        if (!BuildInputEmbeds(features.data() + b * perImage, perImage, decoderInput.data() + b * slotSize,
+                              cachedPrefix)) {
+            LOG_ERROR("Camera", "Token embedding failed");
+            return "";
+        }
+    }
+
+    // Step 5-6: decode all crops together, then join their captions
+    std::vector<std::vector<int64_t>> generated = GenerateBatch(decoderInput, batch, generationConfig.maxTokens,
+                                                                cachedPrefix);
+    if (generated.size() != regions.size()) {
+        LOG_ERROR("Camera", "Batched generation failed");
+        return "";
+    }
+
+    std::vector<std::string> captions;
+    for (const auto& tokens : generated) {
+        std::string caption = DecodeTokens(tokens);
+        if (!caption.empty() && std::find(captions.begin(), captions.end(), caption) == captions.end()) {
+            captions.push_back(std::move(caption));
+        }
+    }
+    std::string description;
+    for (const auto& caption : captions) {
+        description += (description.empty() ? "" : ". ") + caption;
+    }
+    LOG_DEBUG("Camera", "Captioned " << batch << " regions");
+    return description;
+}
+
+std::vector<std::string> CameraVisionEngine::AnswerQuestions(const float* imageFeatures, size_t featureCount,
+                                                             const std::vector<std::string>& questions) {
+    TRACE_ZONE("Camera answer questions");
+    if (!tokenizer.CanEncode()) {
+        LOG_ERROR("Camera", "Questions need BPE merges (merges.txt next to the vocabulary)");
+        return {};
+    }
+
+    // Identical questions are answered once
+    std::vector<std::string> unique;
+    std::vector<size_t> answerOf(questions.size());
+    for (size_t i = 0; i < questions.size(); ++i) {
+        auto it = std::find(unique.begin(), unique.end(), questions[i]);
+        answerOf[i] = static_cast<size_t>(it - unique.begin());
+        if (it == unique.end()) {
+            unique.push_back(questions[i]);
+        }
+    }
+
+    // Split each prompt at <image>: the system prompt before it is the same for all
+    std::vector<int64_t> prefix;
+    std::vector<std::vector<int64_t>> suffixes;
+    for (const std::string& question : unique) {
+        std::vector<int64_t> tokens = tokenizer.EncodeChatPrompt(question);
+        auto image = std::find(tokens.begin(), tokens.end(), FastVLMTokenizer::IMAGE_TOKEN_ID);
+        if (image == tokens.end() || std::find(image + 1, tokens.end(), FastVLMTokenizer::IMAGE_TOKEN_ID) != tokens.end()) {
+            LOG_ERROR("Camera", "Question must not contain <image>: " << question);
+            return {};
+        }
+        prefix.assign(tokens.begin(), image);
+        suffixes.emplace_back(image + 1, tokens.end());
+    }
+
+    // Text after <image> that every question starts with (at least the newline) is
+    // prefilled once with the image; each keeps at least one token of its own
+    size_t common = suffixes.front().size() - 1;
+    for (const auto& suffix : suffixes) {
+        size_t i = 0;
+        while (i < common && i + 1 < suffix.size() && suffix[i] == suffixes.front()[i]) {
+            ++i;
+        }
+        common = i;
+    }
+
+    try {
+        // Shared sequence: [system prompt (restored when KV-cached)][image][common text]
+        const bool prefixCached = promptCacheReady && prefix == promptPrefixTokens;
+        const size_t cachedLength = prefixCached ? prefix.size() : 0;
+        const size_t textBefore = prefixCached ? 0 : prefix.size();
+        const size_t featureTokens = featureCount / HIDDEN_SIZE;
+        const size_t sharedNew = textBefore + featureTokens + common;
+        std::vector<float> sharedEmbeds(sharedNew * HIDDEN_SIZE);
+        if (textBefore > 0 && !EmbedTokensTo(prefix.data(), textBefore, sharedEmbeds.data())) {
+            return {};
+        }
+        std::memcpy(sharedEmbeds.data() + textBefore * HIDDEN_SIZE, imageFeatures, featureCount * sizeof(float));
+        if (common > 0 && !EmbedTokensTo(suffixes.front().data(), common,
+                                         sharedEmbeds.data() + (textBefore + featureTokens) * HIDDEN_SIZE)) {
+            return {};
+        }
+
+        SceneArena::Scope scene(sceneArena);
+        const size_t batch = unique.size();
+        const int maxTokens = generationConfig.maxTokens;
+        const int maxContext = generationConfig.maxContext;
+        const int sharedLength = static_cast<int>(cachedLength + sharedNew);
+        size_t longestTail = 0;
+        for (const auto& suffix : suffixes) {
+            longestTail = (std::max)(longestTail, suffix.size() - common);
+        }
+        auto startTime = std::chrono::steady_clock::now();
+
+        // maxContext: the shared sequence loses its first positions before it is forked
+        const int positionOffset = (std::min)(ContextOverflow(sharedLength + static_cast<int>(longestTail)),
+                                              sharedLength - 1);
+        size_t contextNeeded = static_cast<size_t>(sharedLength - positionOffset) + longestTail + maxTokens;
+        if (maxContext > 0) {
+            contextNeeded = (std::min)(contextNeeded, static_cast<size_t>(maxContext));
+        }
+        EnsureKVCapacity((std::max)(contextNeeded, static_cast<size_t>(sharedLength)), batchedModels ? batch : 1);
+
+        // STEP 1: Prefill the shared sequence once (bank 0 -> bank 1)
+        Ort::IoBinding binding(*decoder);
+        if (cachedLength > 0) {
+            RestorePromptPrefix(0, 1, 0);
+        }
+        {
+            PipelineLatency::Timer timer(PipelineLatency::Stage::Prefill);
+            TRACE_ZONE("Camera prefill");
+            RunDecoder(binding, sharedEmbeds.data(), 1, static_cast<int>(sharedNew), static_cast<int>(cachedLength), 0);
+        }
+        int pastLength = sharedLength;
+        if (positionOffset > 0) {
+            EvictKV(1, 1, sharedLength, 0, positionOffset);
+            pastLength -= positionOffset;
+        }
+
+        std::vector<std::vector<int64_t>> generated(batch);
+        int steps = 0;
+        if (batchedModels) {
+            // STEP 2: Fork into one slot per question. The shortest own-token run is
+            // prefilled for all as one batch; longer questions feed the rest of theirs
+            // during the decode steps while shorter ones already answer
+            ForkKVSlot(1, static_cast<int>(batch), pastLength);
+            size_t tailPrefill = longestTail;
+            for (const auto& suffix : suffixes) {
+                tailPrefill = (std::min)(tailPrefill, suffix.size() - common);
+            }
+            std::vector<float> tailEmbeds(batch * tailPrefill * HIDDEN_SIZE);
+            std::vector<std::vector<int64_t>> forced(batch);
+            for (size_t b = 0; b < batch; ++b) {
+                if (!EmbedTokensTo(suffixes[b].data() + common, tailPrefill,
+                                   tailEmbeds.data() + b * tailPrefill * HIDDEN_SIZE)) {
+                    return {};
+                }
+                forced[b].assign(suffixes[b].begin() + common + tailPrefill, suffixes[b].end());
+            }
+
+            ArenaVector<const std::vector<int64_t>*> histories(batch, ArenaAllocator<const std::vector<int64_t>*>(sceneArena));
+            for (size_t b = 0; b < batch; ++b) {
+                histories[b] = &generated[b];
+            }
+            ArenaVector<int64_t> firstTokens(batch, ArenaAllocator<int64_t>(sceneArena));
+            RunDecoderBatch(binding, tailEmbeds.data(), static_cast<int>(batch), static_cast<int>(tailPrefill),
+                            pastLength, 1, histories.data(), firstTokens.data(), positionOffset);
+            const int sink = pastLength + static_cast<int>(tailPrefill);
+            steps = DecodeBatch(binding, 0, sink, sink, positionOffset, firstTokens.data(), &forced,
+                                maxTokens, startTime, generated);
+        } else {
+            // STEP 2: batch_size is pinned to 1 in this session, so the forks run one
+            // after another, each starting from a copy of the shared KV
+            const size_t sharedBytes = static_cast<size_t>(NUM_HEADS) * pastLength * HEAD_DIM * kvElementBytes;
+            std::vector<uint8_t> shared[NUM_LAYERS * 2];
+            if (batch > 1) {
+                for (int i = 0; i < NUM_LAYERS * 2; ++i) {
+                    shared[i].assign(kvBanks[1][i].begin(), kvBanks[1][i].begin() + sharedBytes);
+                }
+            }
+            std::vector<float> tailEmbeds;
+            for (size_t b = 0; b < batch; ++b) {
+                if (b > 0) {
+                    for (int i = 0; i < NUM_LAYERS * 2; ++i) {
+                        std::memcpy(kvBanks[1][i].data(), shared[i].data(), sharedBytes);
+                    }
+                }
+                std::vector<int64_t> tail(suffixes[b].begin() + common, suffixes[b].end());
+                if (!EmbedTokensInto(tail, tailEmbeds)) {
+                    return {};
+                }
+                std::vector<std::vector<int64_t>> answer(1);
+                int64_t firstToken = RunDecoderStep(binding, tailEmbeds.data(), static_cast<int>(tail.size()),
+                                                    pastLength, 1, answer.front(), positionOffset);
+                const int sink = pastLength + static_cast<int>(tail.size());
+                steps += DecodeBatch(binding, 0, sink, sink, positionOffset, &firstToken, nullptr,
+                                     maxTokens, startTime, answer);
+                generated[b] = std::move(answer.front());
+            }
+        }
+        sceneArenaBytes = sceneArena.GetReservedBytes();
+
+        std::vector<std::string> answers;
+        answers.reserve(questions.size());
+        for (size_t index : answerOf) {
+            answers.push_back(DecodeTokens(generated[index]));
+        }
+        LOG_DEBUG("Camera", "Answered " << questions.size() << " questions (" << sharedLength
+                  << " shared positions prefilled once, " << steps << " batched decode steps)");
+        return answers;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Question answering error: " << e.what());
+        return {};
+    }
+}
+
+std::string CameraVisionEngine::DescribeImage(const cv::Mat& image) {
+    if (!isInitialized) {
+        LOG_ERROR("Camera", "Engine not initialized");
+        return "";
+    }
+    std::lock_guard<std::mutex> captionLock(captionMutex);
+    if (IsPipelineBusy("DescribeImage") || !EnsureModelsLoaded() || image.empty()) {
+        return "";
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    try {
+        std::vector<float> imageFeatures;
+        std::string description = CaptionFrame(image, imageFeatures);
+        lastLatencyMs = std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+        return description;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Error in DescribeImage: " << e.what());
+        return "";
+    }
+}
+
+bool CameraVisionEngine::WarmUp() {
+    if (!isInitialized) {
+        LOG_ERROR("Camera", "Engine not initialized");
+        return false;
+    }
+    std::lock_guard<std::mutex> captionLock(captionMutex);
+    if (pipelineRunning.load()) {
+        return true;    // The staged pipeline's first frames warm the sessions
+    }
+    if (!EnsureModelsLoaded()) {
+        return false;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool ok = false;
+    warmingUp = true;
+    try {
+        // Same shapes as a real caption: one frame, the full prompt, a few decode steps
+        cv::Mat blank(IMAGE_SIZE, IMAGE_SIZE, CV_8UC3, cv::Scalar(0, 0, 0));
+        PreprocessImage(blank, encoderInput);
+        const float* features = RunBoundVisionEncoder();
+        if (features) {
+            int cachedPrefix = 0;
+            decoderInput.resize(InputEmbedsSize(encoderOutput.size()));
+            ok = BuildInputEmbeds(features, encoderOutput.size(), decoderInput.data(), cachedPrefix) &&
+                 !Generate(decoderInput, WARMUP_TOKENS, cachedPrefix).empty();
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Error in WarmUp: " << e.what());
+    }
+    warmingUp = false;
+
+    if (!ok) {
+        LOG_WARNING("Camera", "Warm-up failed; the first caption runs cold");
+        return false;
+    }
+    warm.store(true);
+    float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_DEBUG("Camera", "Warm-up done in " << elapsedMs << "ms");
+    return true;
+}
+
+std::string CameraVisionEngine::DescribeScene() {
+    if (!isInitialized || streams.empty()) {
+        LOG_ERROR("Camera", "Engine not initialized");
+        return "";
+    }
+    std::lock_guard<std::mutex> captionLock(captionMutex);
+    return DescribeStream(streams.front());
+}
+
+std::string CameraVisionEngine::DescribeStream(CaptionStream& stream) {
+    TRACE_ZONE("CameraVisionEngine::DescribeScene");
+    if (IsPipelineBusy("DescribeScene") || !EnsureModelsLoaded()) {
+        return "";
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    try {
+        // Step 1: Take the freshest frame from the capture thread
+        uint64_t frameHash = 0;
+        const FrameCapture::Frame* latest = nullptr;
+        {
+            TRACE_ZONE("Camera acquire frame");
+            latest = AcquireStreamFrame(stream, frameHash);
+        }
+        if (!latest) {
+            return "";
+        }
+        const cv::Mat& frame = latest->frame;
+        lastFrameAgeMs.store(std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - latest->timestamp).count());
+
+        // Scene gate and feature cache
+        std::string reused;
+        std::vector<float> imageFeatures;
+        if (ReuseCachedScene(stream, frameHash, reused, imageFeatures)) {
+            lastSceneSkipped.store(true);
+            lastLatencyMs = std::chrono::duration<float, std::milli>(
+                std::chrono::high_resolution_clock::now() - startTime).count();
+            return reused;
+        }
+        lastSceneSkipped.store(false);
+
+        // Steps 2-6: preprocess, encode, prefill, decode (per detected region in ROI mode)
+        std::string description = regionDetector.IsReady() ? CaptionRegions(frame)
+                                                           : CaptionFrame(frame, imageFeatures);
+        if (description.empty()) {
+            // Keep the features so a retry on the same scene skips the encoder
+            if (!imageFeatures.empty()) {
+                StoreFeatureCache(frameHash, imageFeatures, "");
+            }
+            return "";
+        }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        lastLatencyMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+        LOG_DEBUG("Camera", "Total latency: " << lastLatencyMs << "ms");
+        LOG_DEBUG("Camera", "Description: " << description);
+
+        RecordDescription(stream, frameHash, imageFeatures, description);
+        return description;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Error in DescribeScene: " << e.what());
+        return "";
+    }
+}
+
+std::vector<std::string> CameraVisionEngine::DescribeScenes() {
+    TRACE_ZONE("CameraVisionEngine::DescribeScenes");
+    std::vector<std::string> descriptions(streams.size());
+    if (!isInitialized || streams.empty()) {
+        LOG_ERROR("Camera", "Engine not initialized");
+        return descriptions;
+    }
+    std::lock_guard<std::mutex> captionLock(captionMutex);
+    if (IsPipelineBusy("DescribeScenes") || !EnsureModelsLoaded()) {
+        return descriptions;
+    }
+
+    if (streams.size() == 1) {
+        descriptions[0] = DescribeStream(streams.front());
+        return descriptions;
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    try {
+        // Streams whose frame needs the decoder this round
+        struct PendingScene {
+            size_t stream;
+            uint64_t frameHash;
+            std::vector<float> imageFeatures;
+        };
+        std::vector<PendingScene> pending;
+        std::vector<size_t> needEncoder;           // Indices into pending
+        float maxFrameAgeMs = 0.0f;
+        bool allReused = true;
+
+        // Step 1: Latest frame per stream; gate and cache answer unchanged ones
+        for (size_t i = 0; i < streams.size(); ++i) {
+            uint64_t frameHash = 0;
+            const FrameCapture::Frame* latest = AcquireStreamFrame(streams[i], frameHash);
+            if (!latest) {
+                continue;
+            }
+            maxFrameAgeMs = (std::max)(maxFrameAgeMs, std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - latest->timestamp).count());
+
+            PendingScene scene{i, frameHash, {}};
+            if (ReuseCachedScene(streams[i], frameHash, descriptions[i], scene.imageFeatures)) {
+                continue;
+            }
+            allReused = false;
+
+            if (scene.imageFeatures.empty()) {
+                // Step 2: Preprocess straight into this frame's batch slot
+                PreprocessImage(latest->frame, pixelValues, needEncoder.size());
+                needEncoder.push_back(pending.size());
+            }
+            pending.push_back(std::move(scene));
+        }
+        lastFrameAgeMs.store(maxFrameAgeMs);
+        lastSceneSkipped.store(allReused);
+
+        if (pending.empty()) {
+            lastLatencyMs = std::chrono::duration<float, std::milli>(
+                std::chrono::high_resolution_clock::now() - startTime).count();
+            return descriptions;
+        }
+
+        // Step 3: One vision encoder run over every changed frame
+        if (!needEncoder.empty()) {
+            int batch = static_cast<int>(needEncoder.size());
+            std::vector<float> features = RunVisionEncoder(pixelValues, batch);
+            if (features.empty() || features.size() % batch != 0) {
+                LOG_ERROR("Camera", "Vision encoder failed");
+                return descriptions;
+            }
+
+            size_t perImage = features.size() / batch;
+            for (int b = 0; b < batch; ++b) {
+                auto first = features.begin() + b * perImage;
+                pending[needEncoder[b]].imageFeatures.assign(first, first + perImage);
+            }
+        }
+
+        // Step 4: Prompt embeddings per scene, each written into its slot of one
+        // batch buffer (same prompt and encoder, so same length)
+        size_t slotSize = InputEmbedsSize(pending.front().imageFeatures.size());
+        decoderInput.resize(pending.size() * slotSize);
+        int cachedPrefix = 0;
+        for (size_t b = 0; b < pending.size(); ++b) {
+            const auto& features = pending[b].imageFeatures;
+            if (InputEmbedsSize(features.size()) != slotSize ||
+                !BuildInputEmbeds(features.data(), features.size(), decoderInput.data() + b * slotSize, cachedPrefix)) {
+                LOG_ERROR("Camera", "Token embedding failed");
+                return descriptions;
+            }
+        }
+
+        // Step 5: Decode all captions together, one KV slot each
+        std::vector<std::vector<int64_t>> generated = GenerateBatch(decoderInput, pending.size(),
+                                                                    generationConfig.maxTokens, cachedPrefix);
+        if (generated.size() != pending.size()) {
+            LOG_ERROR("Camera", "Batched generation failed");
+            for (const auto& scene : pending) {
+                StoreFeatureCache(scene.frameHash, scene.imageFeatures, "");
+            }
+            return descriptions;
+        }
+
+        // Step 6: Decode tokens to text
+        for (size_t p = 0; p < pending.size(); ++p) {
+            const PendingScene& scene = pending[p];
+            std::string description = DecodeTokens(generated[p]);
+            LOG_DEBUG("Camera", "Description (camera " << streams[scene.stream].capture->GetCameraIndex()
+                      << "): " << description);
+
+            RecordDescription(streams[scene.stream], scene.frameHash, scene.imageFeatures, description);
+            descriptions[scene.stream] = description;
+        }
+
+        lastLatencyMs = std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+        LOG_DEBUG("Camera", "Round latency: " << lastLatencyMs << "ms (" << pending.size() << " of "
+                  << streams.size() << " streams captioned)");
+        return descriptions;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Error in DescribeScenes: " << e.what());
+        return descriptions;
+    }
+}
+
+// ============================================================================
+// Requests
+// ============================================================================
+
+std::future<CameraVisionEngine::Caption> CameraVisionEngine::Submit(int streamIndex) {
+    return SubmitStream(streamIndex, nullptr);
+}
+
+std::future<CameraVisionEngine::Caption> CameraVisionEngine::Submit(const cv::Mat& image, const cv::Rect& region) {
+    return SubmitImage(image, region, nullptr);
+}
+
+void CameraVisionEngine::Submit(int streamIndex, SubmitCallback callback) {
+    SubmitStream(streamIndex, std::move(callback));
+}
+
+void CameraVisionEngine::Submit(const cv::Mat& image, const cv::Rect& region, SubmitCallback callback) {
+    SubmitImage(image, region, std::move(callback));
+}
+
+std::future<CameraVisionEngine::Caption> CameraVisionEngine::SubmitStream(int streamIndex, SubmitCallback callback) {
+    if (streamIndex < 0 || static_cast<size_t>(streamIndex) >= streams.size()) {
+        LOG_ERROR("Camera", "Submit: no camera stream " << streamIndex);
+        return EmptyCaption(callback);
+    }
+    auto request = std::make_shared<CaptionRequest>();
+    request->stream = streamIndex;
+    return EnqueueRequest(std::move(request), std::move(callback));
+}
+
+std::future<CameraVisionEngine::Caption> CameraVisionEngine::SubmitImage(const cv::Mat& image, const cv::Rect& region,
+                                                                         SubmitCallback callback) {
+    cv::Rect bounds(0, 0, image.cols, image.rows);
+    if (region.area() > 0) {
+        bounds &= region;
+    }
+    if (image.empty() || bounds.area() <= 0) {
+        LOG_ERROR("Camera", "Submit: empty image or region");
+        return EmptyCaption(callback);
+    }
+    auto request = std::make_shared<CaptionRequest>();
+    request->stream = -1;
+    image(bounds).copyTo(request->image);
+    request->imageHash = ComputeFrameHash(request->image);
+    return EnqueueRequest(std::move(request), std::move(callback));
+}
+
+std::future<CameraVisionEngine::Caption> CameraVisionEngine::Ask(const std::vector<std::string>& questions,
+                                                                int streamIndex, SubmitCallback callback) {
+    if (questions.empty() || questions.size() > MAX_QUESTIONS) {
+        LOG_ERROR("Camera", "Ask: 1 to " << MAX_QUESTIONS << " questions, got " << questions.size());
+        return EmptyCaption(callback);
+    }
+    if (streamIndex < 0 || static_cast<size_t>(streamIndex) >= streams.size()) {
+        LOG_ERROR("Camera", "Ask: no camera stream " << streamIndex);
+        return EmptyCaption(callback);
+    }
+    auto request = std::make_shared<CaptionRequest>();
+    request->stream = streamIndex;
+    request->questions = questions;
+    return EnqueueRequest(std::move(request), std::move(callback));
+}
+
+std::future<CameraVisionEngine::Caption> CameraVisionEngine::Ask(const std::vector<std::string>& questions,
+                                                                const cv::Mat& image, SubmitCallback callback) {
+    if (questions.empty() || questions.size() > MAX_QUESTIONS) {
+        LOG_ERROR("Camera", "Ask: 1 to " << MAX_QUESTIONS << " questions, got " << questions.size());
+        return EmptyCaption(callback);
+    }
+    if (image.empty()) {
+        LOG_ERROR("Camera", "Ask: empty image");
+        return EmptyCaption(callback);
+    }
+    auto request = std::make_shared<CaptionRequest>();
+    request->stream = -1;
+    image.copyTo(request->image);
+    request->imageHash = ComputeFrameHash(request->image);
+    request->questions = questions;
+    return EnqueueRequest(std::move(request), std::move(callback));
+}
+
+size_t CameraVisionEngine::GetPendingRequestCount() {
+    std::lock_guard<std::mutex> lock(requestMutex);
+    return requestQueue.size();
+}
+
+std::future<CameraVisionEngine::Caption> CameraVisionEngine::EnqueueRequest(std::shared_ptr<CaptionRequest> request,
+                                                                           SubmitCallback callback) {
+    std::unique_lock<std::mutex> lock(requestMutex);
+    if (requestStop) {
+        lock.unlock();
+        return EmptyCaption(callback);
+    }
+    CaptionWaiter waiter{ std::promise<Caption>(), std::chrono::steady_clock::now(), false, std::move(callback) };
+    std::future<Caption> future = waiter.promise.get_future();
+
+    // Same frame: a queued request for the stream (it takes the freshest frame
+    // when it runs), the one in flight if no newer frame has been captured
+    // since it started, or an identical image
+    auto sameFrame = [this, &request](const CaptionRequest& other, bool inFlight) {
+        if (other.questions != request->questions) {
+            return false;
+        }
+        if (request->stream >= 0) {
+            return other.stream == request->stream &&
+                   (!inFlight || streams[other.stream].capture->GetCapturedFrameCount() == other.capturedAtStart);
+        }
+        return other.stream < 0 && other.imageHash == request->imageHash && SamePixels(other.image, request->image);
+    };
+
+    std::shared_ptr<CaptionRequest> target;
+    if (requestInFlight && sameFrame(*requestInFlight, true)) {
+        target = requestInFlight;
+    }
+    for (size_t i = 0; i < requestQueue.size() && !target; ++i) {
+        if (sameFrame(*requestQueue[i], false)) {
+            target = requestQueue[i];
+        }
+    }
+    if (target) {
+        waiter.joined = true;
+        target->waiters.push_back(std::move(waiter));
+        requestsCoalesced++;
+        return future;
+    }
+
+    request->waiters.push_back(std::move(waiter));
+    requestQueue.push_back(std::move(request));
+    if (!requestThread.joinable()) {
+        requestThread = std::thread(&CameraVisionEngine::RunRequestWorker, this);
+    }
+    requestCv.notify_one();
+    return future;
+}
+
+void CameraVisionEngine::RunRequestWorker() {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vision);
+    TRACE_THREAD("Caption requests");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Camera);
+
+    std::unique_lock<std::mutex> lock(requestMutex);
+    while (true) {
+        requestCv.wait(lock, [this] { return requestStop || !requestQueue.empty(); });
+        if (requestStop) {
+            break;
+        }
+        requestInFlight = std::move(requestQueue.front());
+        requestQueue.pop_front();
+        if (requestInFlight->stream >= 0) {
+            requestInFlight->capturedAtStart = streams[requestInFlight->stream].capture->GetCapturedFrameCount();
+        }
+
+        // Callers may still join while it runs; the waiters are read back under the lock
+        lock.unlock();
+        Caption caption = ExecuteRequest(*requestInFlight);
+        auto finished = std::chrono::steady_clock::now();
+        lock.lock();
+
+        std::vector<std::pair<SubmitCallback, Caption>> callbacks;
+        for (CaptionWaiter& waiter : requestInFlight->waiters) {
+            Caption result = caption;
+            result.latencyMs = std::chrono::duration<float, std::milli>(finished - waiter.submitted).count();
+            result.coalesced = waiter.joined;
+            if (waiter.callback) {
+                callbacks.emplace_back(std::move(waiter.callback), result);
+            }
+            waiter.promise.set_value(std::move(result));
+        }
+        requestInFlight.reset();
+
+        // Outside the lock, so Submit() callers never wait on a callback
+        lock.unlock();
+        for (auto& callback : callbacks) {
+            callback.first(callback.second);
+        }
+        lock.lock();
+    }
+
+    // Stopping: nothing will caption what is still queued
+    std::vector<SubmitCallback> callbacks;
+    for (auto& request : requestQueue) {
+        for (CaptionWaiter& waiter : request->waiters) {
+            waiter.promise.set_value(Caption());
+            if (waiter.callback) {
+                callbacks.push_back(std::move(waiter.callback));
+            }
+        }
+    }
+    requestQueue.clear();
+    lock.unlock();
+    for (auto& callback : callbacks) {
+        callback(Caption());
+    }
+}
+
+CameraVisionEngine::Caption CameraVisionEngine::ExecuteRequest(CaptionRequest& request) {
+    TRACE_ZONE("CameraVisionEngine::ExecuteRequest");
+    Caption caption;
+    if (!isInitialized) {
+        LOG_ERROR("Camera", "Engine not initialized");
+        return caption;
+    }
+    std::lock_guard<std::mutex> captionLock(captionMutex);
+
+    if (!request.questions.empty()) {
+        caption.answers = ExecuteQuestions(request);
+        return caption;
+    }
+
+    if (request.stream >= 0) {
+        caption.description = DescribeStream(streams[request.stream]);
+        caption.reused = lastSceneSkipped.load();
+        return caption;
+    }
+
+    if (IsPipelineBusy("Submit") || !EnsureModelsLoaded()) {
+        return caption;
+    }
+    auto startTime = std::chrono::high_resolution_clock::now();
+    try {
+        // Feature cache only: a supplied image has no stream to gate against
+        std::vector<float> imageFeatures;
+        FeatureCacheEntry* cached = featureCacheCapacity > 0 ? LookupFeatureCache(request.imageHash) : nullptr;
+        if (cached) {
+            featureCacheHits++;
+            if (!cached->description.empty()) {
+                caption.description = cached->description;
+                caption.reused = true;
+                return caption;
+            }
+            imageFeatures = cached->imageFeatures;
+        } else {
+            featureCacheMisses++;
+        }
+
+        caption.description = CaptionFrame(request.image, imageFeatures);
+        lastLatencyMs = std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+        if (!caption.description.empty()) {
+            scenesDescribed++;
+            ThreadCpu::Instance().AddCaptions(1);
+        }
+        if (!caption.description.empty() || !imageFeatures.empty()) {
+            StoreFeatureCache(request.imageHash, imageFeatures, caption.description);
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Error in submitted request: " << e.what());
+        caption.description.clear();
+    }
+    return caption;
+}
+
+std::vector<std::string> CameraVisionEngine::ExecuteQuestions(CaptionRequest& request) {
+    if (IsPipelineBusy("Ask") || !EnsureModelsLoaded()) {
+        return {};
+    }
+    auto startTime = std::chrono::high_resolution_clock::now();
+    try {
+        const cv::Mat* frame = &request.image;
+        uint64_t frameHash = request.imageHash;
+        if (request.stream >= 0) {
+            const FrameCapture::Frame* latest = AcquireStreamFrame(streams[request.stream], frameHash);
+            if (!latest) {
+                return {};
+            }
+            frame = &latest->frame;
+        }
+
+        // Feature cache only: a caption of this scene doesn't answer these questions
+        const float* features = nullptr;
+        size_t featureCount = 0;
+        FeatureCacheEntry* cached = featureCacheCapacity > 0 ? LookupFeatureCache(frameHash) : nullptr;
+        if (cached && !cached->imageFeatures.empty()) {
+            featureCacheHits++;
+            features = cached->imageFeatures.data();
+            featureCount = cached->imageFeatures.size();
+        } else {
+            featureCacheMisses++;
+            PreprocessImage(*frame, encoderInput);
+            features = RunBoundVisionEncoder();
+            if (!features) {
+                LOG_ERROR("Camera", "Vision encoder failed");
+                return {};
+            }
+            featureCount = encoderOutput.size();
+            if (featureCacheCapacity > 0 && !cached) {
+                StoreFeatureCache(frameHash, std::vector<float>(features, features + featureCount), "");
+            }
+        }
+
+        std::vector<std::string> answers = AnswerQuestions(features, featureCount, request.questions);
+        lastLatencyMs = std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+        return answers;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Error in Ask: " << e.what());
+        return {};
+    }
+}
+
+void CameraVisionEngine::StopRequests() {
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        requestStop = true;
+    }
+    requestCv.notify_all();
+    if (requestThread.joinable()) {
+        requestThread.join();
+    }
+}
+
+// ============================================================================
+// Staged Pipeline
+// ============================================================================
+
+bool CameraVisionEngine::IsPipelineBusy(const char* caller) const {
+    if (pipelineRunning.load()) {
+        LOG_ERROR("Camera", caller << " refused: the staged pipeline is running");
+        return true;
+    }
+    return false;
+}
+
+bool CameraVisionEngine::StartPipeline(const CaptionCallback& onCaption, int intervalMs) {
+    if (!isInitialized || streams.empty()) {
+        LOG_ERROR("Camera", "Engine not initialized");
+        return false;
+    }
+    if (IsPipelineBusy("StartPipeline") || !EnsureModelsLoaded()) {
+        return false;
+    }
+    if (encoderThreads == 0) {
+        LOG_DEBUG("Camera", "Pipelined encoder shares the global ORT pool with the decoder");
+    }
+
+    encodedFrames.clear();
+    encoderDone = false;
+    framesInFlight = 0;
+    pipelineStop = false;
+    pipelineRunning = true;
+    encoderThread = std::thread(&CameraVisionEngine::RunEncoderStage, this, nullptr, (std::max)(0, intervalMs));
+    decoderThread = std::thread(&CameraVisionEngine::RunDecoderStage, this, onCaption, true);
+    LOG_INFO("Camera", "Staged caption pipeline started (interval " << intervalMs << "ms)");
+    return true;
+}
+
+void CameraVisionEngine::StopPipeline() {
+    if (!encoderThread.joinable() && !decoderThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        pipelineStop = true;
+    }
+    pipelineCv.notify_all();
+    if (encoderThread.joinable()) {
+        encoderThread.join();
+    }
+    if (decoderThread.joinable()) {
+        decoderThread.join();
+    }
+    encodedFrames.clear();
+    pipelineRunning = false;
+    LOG_INFO("Camera", "Staged caption pipeline stopped");
+}
+
+std::vector<std::string> CameraVisionEngine::DescribeImagesPipelined(const std::vector<cv::Mat>& images,
+                                                                     std::vector<float>* latenciesMs) {
+    std::vector<std::string> descriptions(images.size());
+    if (latenciesMs) {
+        latenciesMs->assign(images.size(), 0.0f);
+    }
+    if (!isInitialized) {
+        LOG_ERROR("Camera", "Engine not initialized");
+        return descriptions;
+    }
+    if (images.empty() || IsPipelineBusy("DescribeImagesPipelined") || !EnsureModelsLoaded()) {
+        return descriptions;
+    }
+
+    encodedFrames.clear();
+    encoderDone = false;
+    framesInFlight = 0;
+    pipelineStop = false;
+    pipelineRunning = true;
+
+    // The calling thread is the decoder stage; it returns once the encoder has run dry
+    encoderThread = std::thread(&CameraVisionEngine::RunEncoderStage, this, &images, 0);
+    RunDecoderStage([&descriptions, latenciesMs](const PipelineCaption& caption) {
+        descriptions[caption.sequence] = caption.description;
+        if (latenciesMs) {
+            (*latenciesMs)[caption.sequence] = caption.latencyMs;
+        }
+    }, false);
+    encoderThread.join();
+    pipelineRunning = false;
+    return descriptions;
+}
+
+void CameraVisionEngine::RunEncoderStage(const std::vector<cv::Mat>* images, int intervalMs) {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vision);
+    TRACE_THREAD("Caption encoder");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Camera);
+
+    auto nextFrame = std::chrono::steady_clock::now();
+    uint64_t inFlightHash = 0;
+    size_t imageIndex = 0;
+
+    while (!pipelineStop.load()) {
+        // Room in the queue first, so the frame taken below is as fresh as possible
+        {
+            std::unique_lock<std::mutex> lock(pipelineMutex);
+            pipelineCv.wait(lock, [this] { return pipelineStop.load() || encodedFrames.size() < PIPELINE_DEPTH; });
+            if (pipelineStop.load()) {
+                break;
+            }
+            if (intervalMs > 0) {
+                pipelineCv.wait_until(lock, nextFrame, [this] { return pipelineStop.load(); });
+                if (pipelineStop.load()) {
+                    break;
+                }
+                auto now = std::chrono::steady_clock::now();
+                nextFrame = (std::max)(nextFrame + std::chrono::milliseconds(intervalMs), now);
+            }
+        }
+
+        EncodedFrame encoded{0, 0, std::chrono::steady_clock::now(), {}, {}};
+        const cv::Mat* frame = nullptr;
+        if (images) {
+            if (imageIndex >= images->size()) {
+                break;
+            }
+            encoded.sequence = imageIndex;
+            frame = &(*images)[imageIndex++];
+        } else {
+            CaptionStream& stream = streams.front();
+            const FrameCapture::Frame* latest = AcquireStreamFrame(stream, encoded.frameHash);
+            if (!latest) {
+                std::unique_lock<std::mutex> lock(pipelineMutex);
+                pipelineCv.wait_for(lock, std::chrono::milliseconds(100), [this] { return pipelineStop.load(); });
+                continue;
+            }
+            encoded.sequence = latest->sequence;
+            frame = &latest->frame;
+            lastFrameAgeMs.store(std::chrono::duration<float, std::milli>(
+                encoded.start - latest->timestamp).count());
+
+            // Same scene as the frame still being captioned: its caption will cover this one
+            int threshold = sceneChangeThreshold.load();
+            if (framesInFlight.load() > 0 && threshold >= 0 &&
+                static_cast<int>(std::bitset<64>(encoded.frameHash ^ inFlightHash).count()) <= threshold) {
+                scenesSkipped++;
+                continue;
+            }
+
+            bool reused;
+            {
+                std::lock_guard<std::mutex> lock(sceneMutex);
+                reused = ReuseCachedScene(stream, encoded.frameHash, encoded.description, encoded.imageFeatures);
+            }
+            lastSceneSkipped.store(reused);
+        }
+
+        if (encoded.description.empty()) {
+            if (encoded.imageFeatures.empty()) {
+                // The decoder stage still reads the previous frame's features, so this
+                // frame's leave the bound output as a copy of their own
+                PreprocessImage(*frame, encoderInput);
+                if (const float* features = RunBoundVisionEncoder()) {
+                    encoded.imageFeatures.assign(features, features + encoderOutput.size());
+                }
+                if (encoded.imageFeatures.empty()) {
+                    LOG_ERROR("Camera", "Vision encoder failed");
+                    if (!images) {
+                        continue;
+                    }
+                }
+            }
+            inFlightHash = encoded.frameHash;
+            framesInFlight++;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pipelineMutex);
+            encodedFrames.push_back(std::move(encoded));
+        }
+        pipelineCv.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        encoderDone = true;
+    }
+    pipelineCv.notify_all();
+}
+
+void CameraVisionEngine::RunDecoderStage(const CaptionCallback& onCaption, bool gated) {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vision);
+    TRACE_THREAD("Caption decoder");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Camera);
+
+    while (true) {
+        EncodedFrame encoded;
+        {
+            std::unique_lock<std::mutex> lock(pipelineMutex);
+            pipelineCv.wait(lock, [this] { return pipelineStop.load() || encoderDone || !encodedFrames.empty(); });
+            if (pipelineStop.load() || encodedFrames.empty()) {
+                break;
+            }
+            encoded = std::move(encodedFrames.front());
+            encodedFrames.pop_front();
+        }
+        pipelineCv.notify_all();     // Room for the encoder's next frame
+
+        PipelineCaption caption{encoded.description, 0.0f, !encoded.description.empty(), encoded.sequence};
+        if (!caption.reused) {
+            try {
+                std::string description;
+                if (!encoded.imageFeatures.empty()) {
+                    int cachedPrefix = 0;
+                    decoderInput.resize(InputEmbedsSize(encoded.imageFeatures.size()));
+                    std::vector<int64_t> generated;
+                    if (BuildInputEmbeds(encoded.imageFeatures.data(), encoded.imageFeatures.size(),
+                                         decoderInput.data(), cachedPrefix)) {
+                        generated = Generate(decoderInput, generationConfig.maxTokens, cachedPrefix);
+                    }
+                    if (!generated.empty()) {
+                        description = DecodeTokens(generated);
+                    }
+                }
+                caption.description = description;
+            } catch (const std::exception& e) {
+                LOG_ERROR("Camera", "Pipelined caption error: " << e.what());
+            }
+
+            if (gated) {
+                std::lock_guard<std::mutex> lock(sceneMutex);
+                if (caption.description.empty()) {
+                    // Keep the features so a retry on the same scene skips the encoder
+                    StoreFeatureCache(encoded.frameHash, encoded.imageFeatures, "");
+                } else {
+                    RecordDescription(streams.front(), encoded.frameHash, encoded.imageFeatures, caption.description);
+                }
+            }
+            framesInFlight--;
+        }
+
+        caption.latencyMs = std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - encoded.start).count();
+        lastLatencyMs = caption.latencyMs;
+        if (!caption.description.empty()) {
+            LOG_DEBUG("Camera", "Pipelined caption #" << caption.sequence << " (" << static_cast<int>(caption.latencyMs)
+                      << "ms): " << caption.description);
+        }
+        if (onCaption && (!gated || !caption.description.empty())) {
+            onCaption(caption);
+        }
+    }
+}
+
+std::vector<float> CameraVisionEngine::EmbedTokenIds(const std::vector<int64_t>& tokens) {
+    try {
+        std::vector<int64_t> tokenShape = {1, static_cast<int64_t>(tokens.size())};
+
+        Ort::Value tokenTensor = Ort::Value::CreateTensor<int64_t>(
+            *memoryInfo,
+            const_cast<int64_t*>(tokens.data()),
+            tokens.size(),
+            tokenShape.data(),
+            tokenShape.size()
+        );
+
+        const char* inputNames[] = {"input_ids"};
+        const char* outputNames[] = {"inputs_embeds"};
+
+        auto outputTensors = embedTokens->Run(
+            runOptions,
+            inputNames,
+            &tokenTensor,
+            1,
+            outputNames,
+            1
+        );
+
+        const float* embedData = outputTensors[0].GetTensorData<float>();
+        size_t embedSize = outputTensors[0].GetTensorTypeAndShapeInfo().GetElementCount();
+        return std::vector<float>(embedData, embedData + embedSize);
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Token embedding error: " << e.what());
+        return {};
+    }
+}
+
+bool CameraVisionEngine::SetPromptQuestion(const std::string& question) {
+    std::vector<int64_t> tokens;
+    if (question.empty()) {
+        tokens = FastVLMTokenizer::GetChatPromptTokens();
+    } else if (!tokenizer.CanEncode()) {
+        LOG_WARNING("Camera", "Cannot encode prompt question without BPE merges");
+        return false;
+    } else {
+        tokens = tokenizer.EncodeChatPrompt(question);
+    }
+    if (std::count(tokens.begin(), tokens.end(), FastVLMTokenizer::IMAGE_TOKEN_ID) != 1) {
+        LOG_ERROR("Camera", "Prompt question must not contain <image>: " << question);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> captionLock(captionMutex);
+    if (tokens == promptTokens) {
+        return true;
+    }
+    promptTokens = std::move(tokens);
+
+    // Answers to the old question don't answer this one
+    for (CaptionStream& stream : streams) {
+        stream.lastDescription.clear();
+    }
+    for (FeatureCacheEntry& entry : featureCache) {
+        entry.description.clear();
+    }
+
+    if (modelsLoaded && !PreparePromptCache()) {
+        LOG_WARNING("Camera", "Prompt cache unavailable, embedding full prompt per scene");
+    }
+    LOG_INFO("Camera", "Prompt question: " << (question.empty() ? FastVLMTokenizer::DEFAULT_QUESTION : question)
+             << " (" << promptTokens.size() << " tokens)");
+    return true;
+}
 
-        std::cout << "[Camera] Loading embed tokens model..." << std::endl;
-        std::string embedPath = modelPath + "/onnx/embed_tokens_q4f16.onnx";
-        embedTokens = LoadOnnxModel(embedPath);
-        if (!embedTokens) {
-            std::cerr << "[Camera] Failed to load embed tokens model" << std::endl;
-            return false;
-        }
+bool CameraVisionEngine::PreparePromptCache() {
+    promptCacheReady = false;
 
-        std::cout << "[Camera] Loading decoder model..." << std::endl;
-        std::string decoderPath = modelPath + "/onnx/decoder_model_merged_q4f16.onnx";
-        decoder = LoadOnnxModel(decoderPath);
-        if (!decoder) {
-            std::cerr << "[Camera] Failed to load decoder model" << std::endl;
-            return false;
-        }
+    auto imageIt = std::find(promptTokens.begin(), promptTokens.end(), FastVLMTokenizer::IMAGE_TOKEN_ID);
+    if (imageIt == promptTokens.end()) {
+        LOG_ERROR("Camera", "Prompt has no <image> token");
+        return false;
+    }
 
-        // Initialize camera
-        std::cout << "[Camera] Opening camera " << cameraIndex << "..." << std::endl;
-        camera.open(cameraIndex);
-        if (!camera.isOpened()) {
-            std::cerr << "[Camera] Failed to open camera" << std::endl;
-            return false;
+    try {
+        size_t imageIndex = static_cast<size_t>(imageIt - promptTokens.begin());
+        std::vector<int64_t> prefix(promptTokens.begin(), imageIt);
+        std::vector<int64_t> suffix(imageIt + 1, promptTokens.end());
+
+        // A new question behind the same system prompt keeps the prefilled prefix
+        bool prefixCached = !prefix.empty() && prefix == promptPrefixTokens &&
+                            promptPrefixKV[0].size() ==
+                            static_cast<size_t>(NUM_HEADS) * prefix.size() * HEAD_DIM * kvElementBytes;
+        if (prefixCached || prefix.empty()) {
+            promptSuffixEmbeds = suffix.empty() ? std::vector<float>() : EmbedTokenIds(suffix);
+            if (promptSuffixEmbeds.size() != suffix.size() * HIDDEN_SIZE) {
+                return false;
+            }
+        } else {
+            std::vector<float> embeds = EmbedTokenIds(promptTokens);
+            if (embeds.size() != promptTokens.size() * HIDDEN_SIZE) {
+                return false;
+            }
+            promptSuffixEmbeds.assign(embeds.begin() + (imageIndex + 1) * HIDDEN_SIZE, embeds.end());
+
+            // Prefill the prefix into bank 1 (past = empty bank 0), then keep a compact copy;
+            // with pastLength == prefix the [1, H, prefix, D] layout is exactly the buffer head
+            promptPrefixTokens.clear();
+            EnsureKVCapacity(prefix.size());
+            Ort::IoBinding binding(*decoder);
+            RunDecoderStep(binding, embeds.data(), static_cast<int>(prefix.size()), 0, 0, {});
+
+            size_t bytes = static_cast<size_t>(NUM_HEADS) * prefix.size() * HEAD_DIM * kvElementBytes;
+            for (int i = 0; i < NUM_LAYERS * 2; ++i) {
+                promptPrefixKV[i].assign(kvBanks[1][i].begin(), kvBanks[1][i].begin() + bytes);
+            }
+            promptPrefixTokens = prefix;
         }
+        promptPrefixLength = static_cast<int>(prefix.size());
 
-        // Set camera resolution (smaller = faster)
-        camera.set(cv::CAP_PROP_FRAME_WIDTH, 320);
-        camera.set(cv::CAP_PROP_FRAME_HEIGHT, 240);
-
-        isInitialized = true;
-        std::cout << "[Camera] Initialization complete!" << std::endl;
+        promptCacheReady = true;
+        LOG_INFO("Camera", "Prompt cache ready (prefix " << promptPrefixLength << " tokens KV-cached"
+                 << (prefixCached ? " (reused), " : ", ") << suffix.size() << " suffix tokens pre-embedded)");
         return true;
 
     } catch (const std::exception& e) {
-        std::cerr << "[Camera] Initialization error: " << e.what() << std::endl;
+        LOG_ERROR("Camera", "Prompt cache error: " << e.what());
         return false;
     }
 }
 
-std::unique_ptr<Ort::Session> CameraVisionEngine::LoadOnnxModel(const std::string& modelPath) {
-    try {
-        std::cout << "[Camera] Loading model from: " << modelPath << std::endl;
-
-        // Convert UTF-8 string to wide string for Windows
-        int wideSize = MultiByteToWideChar(CP_UTF8, 0, modelPath.c_str(), -1, nullptr, 0);
-        if (wideSize == 0) {
-            std::cerr << "[Camera] Failed to convert path: " << modelPath << std::endl;
-            return nullptr;
-        }
+bool CameraVisionEngine::TokenizeAndEmbed(
+    const std::vector<int64_t>& tokens,
+    const float* imageFeatures,
+    size_t featureCount,
+    float* out) {
+
+    // Image features replace the <image> token's embedding; text may sit on
+    // both sides of it (e.g. a chat template before <image>)
+    size_t imageIndex = static_cast<size_t>(
+        std::find(tokens.begin(), tokens.end(), FastVLMTokenizer::IMAGE_TOKEN_ID) - tokens.begin());
+    if (imageIndex >= tokens.size()) {
+        LOG_ERROR("Camera", "Prompt has no <image> token");
+        return false;
+    }
 
-        std::wstring wModelPath(wideSize, 0);
-        MultiByteToWideChar(CP_UTF8, 0, modelPath.c_str(), -1, &wModelPath[0], wideSize);
+    // Layout of out: [prefix tokens x HIDDEN_SIZE][image features][suffix tokens x HIDDEN_SIZE]
+    float* prefixSlot = out;
+    float* imageSlot = out + imageIndex * HIDDEN_SIZE;
+    float* suffixSlot = imageSlot + featureCount;
+    size_t suffixCount = tokens.size() - imageIndex - 1;
 
-        std::cout << "[Camera] Attempting to load ONNX session..." << std::endl;
-        auto session = std::make_unique<Ort::Session>(*ortEnv, wModelPath.c_str(), *sessionOptions);
-        std::cout << "[Camera] Model loaded successfully!" << std::endl;
-        return session;
-    } catch (const std::exception& e) {
-        std::cerr << "[Camera] Error loading model " << modelPath << ": " << e.what() << std::endl;
-        return nullptr;
+    if (imageIndex > 0 && !EmbedTokensTo(tokens.data(), imageIndex, prefixSlot)) {
+        return false;
+    }
+    std::memcpy(imageSlot, imageFeatures, featureCount * sizeof(float));
+    if (suffixCount > 0 && !EmbedTokensTo(tokens.data() + imageIndex + 1, suffixCount, suffixSlot)) {
+        return false;
     }
+    return true;
 }
 
-void CameraVisionEngine::PreprocessImage(const cv::Mat& frame, std::vector<float>& output) {
-    // Resize to 224x224 (FastVLM input size)
-    cv::Mat resized;
-    cv::resize(frame, resized, cv::Size(224, 224));
-
-    // Convert BGR to RGB
-    cv::Mat rgb;
-    cv::cvtColor(resized, rgb, cv::COLOR_BGR2RGB);
+bool CameraVisionEngine::BuildEmbeddingTable(size_t rows) {
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-    // Convert to float and normalize to [0, 1]
-    cv::Mat floatImage;
-    rgb.convertTo(floatImage, CV_32F, 1.0 / 255.0);
+    try {
+        LOG_INFO("Camera", "Building fp16 embedding table (" << rows << " x " << HIDDEN_SIZE << ")...");
 
-    // ImageNet normalization: mean=[0.485, 0.456, 0.406], std=[0.229, 0.224, 0.225]
-    std::vector<float> mean = {0.485f, 0.456f, 0.406f};
-    std::vector<float> std = {0.229f, 0.224f, 0.225f};
+        embeddingTable.assign(rows * HIDDEN_SIZE, 0);
+        embeddingTableRows = 0;
 
-    // Convert to CHW format (channels, height, width) and normalize
-    output.resize(3 * 224 * 224);
+        std::vector<int64_t> ids(EMBED_TABLE_BATCH);
+        const char* inputNames[] = {"input_ids"};
+        const char* outputNames[] = {"inputs_embeds"};
 
-    for (int c = 0; c < 3; ++c) {
-        for (int h = 0; h < 224; ++h) {
-            for (int w = 0; w < 224; ++w) {
-                float pixel = floatImage.at<cv::Vec3f>(h, w)[c];
-                pixel = (pixel - mean[c]) / std[c];
-                output[c * 224 * 224 + h * 224 + w] = pixel;
+        for (size_t first = 0; first < rows; first += EMBED_TABLE_BATCH) {
+            size_t count = (std::min)(static_cast<size_t>(EMBED_TABLE_BATCH), rows - first);
+            for (size_t i = 0; i < count; ++i) {
+                ids[i] = static_cast<int64_t>(first + i);
             }
-        }
-    }
-}
 
-std::vector<float> CameraVisionEngine::RunVisionEncoder(const std::vector<float>& imageData) {
-    try {
-        std::cout << "[Camera] Vision encoder input data size: " << imageData.size() << std::endl;
+            std::vector<int64_t> shape = {1, static_cast<int64_t>(count)};
+            Ort::Value idTensor = Ort::Value::CreateTensor<int64_t>(
+                *memoryInfo, ids.data(), count, shape.data(), shape.size());
 
-        // Input shape: [1, 3, 224, 224]
-        std::vector<int64_t> inputShape = {1, 3, 224, 224};
+            auto outputs = embedTokens->Run(runOptions, inputNames, &idTensor, 1, outputNames, 1);
 
-        // Verify data size matches shape
-        size_t expectedSize = 1 * 3 * 224 * 224;
-        if (imageData.size() != expectedSize) {
-            std::cerr << "[Camera] ERROR: Image data size mismatch! Got " << imageData.size()
-                      << ", expected " << expectedSize << std::endl;
-            return {};
+            const float* embeds = outputs[0].GetTensorData<float>();
+            uint16_t* dst = embeddingTable.data() + first * HIDDEN_SIZE;
+            for (size_t i = 0; i < count * HIDDEN_SIZE; ++i) {
+                dst[i] = FloatToHalf(embeds[i]);
+            }
         }
 
-        std::cout << "[Camera] Creating input tensor with shape [1, 3, 224, 224]" << std::endl;
+        embeddingTableRows = rows;
 
-        // Create input tensor
-        Ort::Value inputTensor = Ort::Value::CreateTensor<float>(
-            *memoryInfo,
-            const_cast<float*>(imageData.data()),
-            imageData.size(),
-            inputShape.data(),
-            inputShape.size()
-        );
+        float elapsedMs = std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+        LOG_INFO("Camera", "Embedding table ready: " << (embeddingTable.size() * sizeof(uint16_t) / (1024 * 1024))
+                 << " MB in " << elapsedMs << "ms");
+        return true;
 
-        std::cout << "[Camera] Input tensor created, running inference..." << std::endl;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Embedding table error: " << e.what());
+        embeddingTable.clear();
+        embeddingTable.shrink_to_fit();
+        embeddingTableRows = 0;
+        return false;
+    }
+}
 
-        // Run inference
-        const char* inputNames[] = {"pixel_values"};
-        const char* outputNames[] = {"image_features"};
+const float* CameraVisionEngine::EmbedSingleToken(int64_t tokenId) {
+    if (tokenId >= 0 && static_cast<size_t>(tokenId) < embeddingTableRows) {
+        const uint16_t* row = embeddingTable.data() + static_cast<size_t>(tokenId) * HIDDEN_SIZE;
+        for (int i = 0; i < HIDDEN_SIZE; ++i) {
+            stepEmbeds[i] = HalfToFloat(row[i]);
+        }
+        return stepEmbeds.data();
+    }
 
-        auto outputTensors = visionEncoder->Run(
-            Ort::RunOptions{nullptr},
-            inputNames,
-            &inputTensor,
-            1,
-            outputNames,
-            1
-        );
+    std::vector<int64_t> tokenShape = {1, 1};
+    Ort::Value tokenTensor = Ort::Value::CreateTensor<int64_t>(
+        *memoryInfo,
+        &tokenId,
+        1,
+        tokenShape.data(),
+        tokenShape.size()
+    );
+
+    const char* embedInputNames[] = {"input_ids"};
+    const char* embedOutputNames[] = {"inputs_embeds"};
+
+    auto embedOutputs = embedTokens->Run(
+        runOptions,
+        embedInputNames,
+        &tokenTensor,
+        1,
+        embedOutputNames,
+        1
+    );
+
+    std::memcpy(stepEmbeds.data(), embedOutputs[0].GetTensorData<float>(), HIDDEN_SIZE * sizeof(float));
+    return stepEmbeds.data();
+}
 
-        // Get output (shape: [1, 16, 896])
-        float* outputData = outputTensors[0].GetTensorMutableData<float>();
-        auto tensorInfo = outputTensors[0].GetTensorTypeAndShapeInfo();
-        size_t outputSize = tensorInfo.GetElementCount();
+void CameraVisionEngine::EnsureKVCapacity(size_t tokens, size_t batch) {
+    if (tokens <= kvCapacity && batch <= kvBatchCapacity) {
+        return;
+    }
 
-        std::vector<float> imageFeatures(outputData, outputData + outputSize);
-        return imageFeatures;
+    tokens = (std::max)(tokens, kvCapacity);
+    batch = (std::max)(batch, kvBatchCapacity);
 
-    } catch (const std::exception& e) {
-        std::cerr << "[Camera] Vision encoder error: " << e.what() << std::endl;
-        return {};
+    size_t bytes = batch * NUM_HEADS * tokens * HEAD_DIM * kvElementBytes;
+    for (int bank = 0; bank < 2; ++bank) {
+        for (auto& buffer : kvBanks[bank]) {
+            buffer.assign(bytes, 0);
+        }
     }
+    attentionMask.assign(batch * tokens, 1);
+    kvCapacity = tokens;
+    kvBatchCapacity = batch;
+    PublishMemoryUsage();
+
+    LOG_INFO("Camera", "KV cache sized for " << batch << " x " << tokens << " tokens ("
+             << (bytes * NUM_LAYERS * 2 * 2 / (1024 * 1024)) << " MB)");
 }
 
-std::string CameraVisionEngine::DescribeScene() {
-    if (!isInitialized) {
-        std::cerr << "[Camera] Engine not initialized" << std::endl;
-        return "";
+ONNXTensorElementDataType CameraVisionEngine::KVElementType(Ort::Session& session) const {
+    Ort::AllocatorWithDefaultOptions allocator;
+    for (size_t i = 0; i < session.GetInputCount(); ++i) {
+        if (kvInputNames[0] == session.GetInputNameAllocated(i, allocator).get()) {
+            return session.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetElementType();
+        }
     }
+    return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+}
 
-    auto startTime = std::chrono::high_resolution_clock::now();
+void CameraVisionEngine::ForkKVSlot(int bank, int copies, int length) {
+    const size_t slotBytes = static_cast<size_t>(NUM_HEADS) * length * HEAD_DIM * kvElementBytes;
+    for (auto& buffer : kvBanks[bank]) {
+        uint8_t* data = buffer.data();
+        for (int b = 1; b < copies; ++b) {
+            std::memcpy(data + b * slotBytes, data, slotBytes);
+        }
+    }
+}
 
-    try {
-        // Step 1: Capture frame
-        cv::Mat frame;
-        if (!camera.read(frame) || frame.empty()) {
-            std::cerr << "[Camera] Failed to capture frame" << std::endl;
-            return "";
+void CameraVisionEngine::RestorePromptPrefix(int bank, size_t batch, int drop) {
+    // Compact [1, H, prefix, D] -> each slot's [H, prefix - drop, D] head
+    const size_t position = static_cast<size_t>(HEAD_DIM) * kvElementBytes;
+    const size_t kept = static_cast<size_t>(promptPrefixLength - drop);
+    for (int i = 0; i < NUM_LAYERS * 2; ++i) {
+        const uint8_t* source = promptPrefixKV[i].data();
+        uint8_t* slot = kvBanks[bank][i].data();
+        for (size_t b = 0; b < batch; ++b, slot += NUM_HEADS * kept * position) {
+            if (drop == 0) {
+                std::memcpy(slot, source, promptPrefixKV[i].size());
+                continue;
+            }
+            for (int h = 0; h < NUM_HEADS; ++h) {
+                std::memcpy(slot + h * kept * position,
+                            source + (static_cast<size_t>(h) * promptPrefixLength + drop) * position, kept * position);
+            }
         }
+    }
+}
 
-        // Validate frame dimensions
-        if (frame.rows == 0 || frame.cols == 0) {
-            std::cerr << "[Camera] Invalid frame dimensions: " << frame.rows << "x" << frame.cols << std::endl;
-            return "";
+int CameraVisionEngine::ContextOverflow(int promptLength) const {
+    if (generationConfig.maxContext <= 0) {
+        return 0;
+    }
+    // The prompt keeps 3/4 of the context; the rest is the generated tokens' window
+    return (std::max)(0, promptLength - generationConfig.maxContext * 3 / 4);
+}
+
+void CameraVisionEngine::EvictKV(int bank, int batch, int length, int start, int count) {
+    if (count <= 0) {
+        return;
+    }
+    // Rows (slot, head) move down in order, so every move goes to a lower address
+    const size_t position = static_cast<size_t>(HEAD_DIM) * kvElementBytes;
+    const size_t kept = static_cast<size_t>(length - count);
+    const size_t tail = static_cast<size_t>(length - start - count);
+    const size_t rows = static_cast<size_t>(batch) * NUM_HEADS;
+    for (auto& buffer : kvBanks[bank]) {
+        uint8_t* data = buffer.data();
+        for (size_t row = 0; row < rows; ++row) {
+            uint8_t* source = data + row * length * position;
+            uint8_t* target = data + row * kept * position;
+            if (row > 0) {
+                std::memmove(target, source, start * position);
+            }
+            std::memmove(target + start * position, source + (start + count) * position, tail * position);
         }
+    }
+}
 
-        std::cout << "[Camera] Captured frame: " << frame.cols << "x" << frame.rows << std::endl;
+void CameraVisionEngine::RemoveKVSlot(int bank, int slot, int batch, int length) {
+    size_t slotBytes = static_cast<size_t>(NUM_HEADS) * length * HEAD_DIM * kvElementBytes;
+    size_t tail = static_cast<size_t>(batch - slot - 1) * slotBytes;
+    if (tail == 0) {
+        return;     // Last slot: shrinking the batch is enough
+    }
 
-        // Step 2: Preprocess image
-        std::vector<float> imageData;
-        PreprocessImage(frame, imageData);
+    for (auto& buffer : kvBanks[bank]) {
+        uint8_t* dst = buffer.data() + slot * slotBytes;
+        std::memmove(dst, dst + slotBytes, tail);
+    }
+}
 
-        std::cout << "[Camera] Preprocessed image data size: " << imageData.size() << " (expected: " << (3 * 224 * 224) << ")" << std::endl;
-        if (imageData.empty()) {
-            std::cerr << "[Camera] ERROR: Image preprocessing returned empty data!" << std::endl;
-            return "";
-        }
+int64_t CameraVisionEngine::RunDecoderStep(
+    Ort::IoBinding& binding,
+    const float* embeds,
+    int numTokens,
+    int pastLength,
+    int pastBank,
+    const std::vector<int64_t>& history,
+    int positionOffset) {
+
+    int64_t token = 0;
+    const std::vector<int64_t>* histories[] = {&history};
+    RunDecoderBatch(binding, embeds, 1, numTokens, pastLength, pastBank, histories, &token, positionOffset);
+    return token;
+}
 
-        // Step 3: Run vision encoder
-        std::vector<float> imageFeatures = RunVisionEncoder(imageData);
-        if (imageFeatures.empty()) {
-            std::cerr << "[Camera] Vision encoder failed" << std::endl;
-            return "";
-        }
+void CameraVisionEngine::RunDecoderBatch(
+    Ort::IoBinding& binding,
+    const float* embeds,
+    int batchSize,
+    int numTokens,
+    int pastLength,
+    int pastBank,
+    const std::vector<int64_t>* const* histories,
+    int64_t* tokensOut,
+    int positionOffset) {
+
+    SceneArena::Scope scope(sceneArena);
+    Ort::Value logits = RunDecoder(binding, embeds, batchSize, numTokens, pastLength, pastBank, positionOffset);
+    float* logitsData = logits.GetTensorMutableData<float>();
+    auto logitsShape = logits.GetTensorTypeAndShapeInfo().GetShape();
+
+    int64_t vocabSize = logitsShape[2];
+    for (int b = 0; b < batchSize; ++b) {
+        float* lastRow = logitsData + (b * logitsShape[1] + logitsShape[1] - 1) * vocabSize;
+
+        // Works in place on the ORT-owned logits; no copy of the ~151k row
+        tokensOut[b] = logitsProcessor.SelectToken(lastRow, static_cast<size_t>(vocabSize), *histories[b]);
+    }
+}
 
-        // Step 4: Get prompt tokens and embed them with image features
-        std::vector<int64_t> promptTokens = FastVLMTokenizer::GetPromptTokens();
-        std::vector<float> inputEmbeds = TokenizeAndEmbed(promptTokens, imageFeatures);
-        if (inputEmbeds.empty()) {
-            std::cerr << "[Camera] Token embedding failed" << std::endl;
-            return "";
+Ort::Value CameraVisionEngine::RunDecoder(
+    Ort::IoBinding& binding,
+    const float* embeds,
+    int batchSize,
+    int numTokens,
+    int pastLength,
+    int pastBank,
+    int positionOffset) {
+
+    int totalLength = pastLength + numTokens;
+    int presentBank = 1 - pastBank;
+
+    const int64_t embedShape[] = {batchSize, numTokens, HIDDEN_SIZE};
+    const int64_t maskShape[] = {batchSize, totalLength};
+    const int64_t posShape[] = {batchSize, numTokens};
+    const int64_t pastShape[] = {batchSize, NUM_HEADS, pastLength, HEAD_DIM};
+    const int64_t presentShape[] = {batchSize, NUM_HEADS, totalLength, HEAD_DIM};
+
+    // Every sequence sits at the same position, so the rows are identical;
+    // positions dropped under maxContext still count
+    size_t positionCount = static_cast<size_t>(batchSize) * numTokens;
+    int64_t* positionIds = sceneArena.AllocateArray<int64_t>(positionCount);
+    for (int b = 0; b < batchSize; ++b) {
+        for (int i = 0; i < numTokens; ++i) {
+            positionIds[static_cast<size_t>(b) * numTokens + i] = positionOffset + pastLength + i;
         }
+    }
 
-        // Step 5: Generate description tokens
-        std::vector<int64_t> generatedTokens = Generate(inputEmbeds, 50);
-        if (generatedTokens.empty()) {
-            std::cerr << "[Camera] Generation failed" << std::endl;
-            return "";
-        }
+    // Tensors below are views over caller/member buffers; creating them copies nothing
+    Ort::Value embedTensor = Ort::Value::CreateTensor<float>(
+        *memoryInfo, const_cast<float*>(embeds), static_cast<size_t>(batchSize) * numTokens * HIDDEN_SIZE,
+        embedShape, 3);
+    Ort::Value maskTensor = Ort::Value::CreateTensor<int64_t>(
+        *memoryInfo, attentionMask.data(), static_cast<size_t>(batchSize) * totalLength, maskShape, 2);
+    Ort::Value posTensor = Ort::Value::CreateTensor<int64_t>(
+        *memoryInfo, positionIds, positionCount, posShape, 2);
+
+    binding.ClearBoundInputs();
+    binding.ClearBoundOutputs();
+    binding.BindInput("inputs_embeds", embedTensor);
+    binding.BindInput("attention_mask", maskTensor);
+    binding.BindInput("position_ids", posTensor);
+
+    // Logits go into the scene arena when their shape is known up front;
+    // otherwise they are bound first so they are GetOutputValues()[0]
+    Ort::Value logits{nullptr};
+    if (decoderVocabSize > 0) {
+        const int64_t logitsShape[] = {batchSize, numTokens, decoderVocabSize};
+        logits = Ort::Value::CreateTensor<float>(sceneArena.GetOrtAllocator(), logitsShape, 3);
+        binding.BindOutput("logits", logits);
+    } else {
+        binding.BindOutput("logits", *memoryInfo);
+    }
 
-        // Step 6: Decode tokens to text
-        std::string description = DecodeTokens(generatedTokens);
+    size_t pastBytes = static_cast<size_t>(batchSize) * NUM_HEADS * pastLength * HEAD_DIM * kvElementBytes;
+    size_t presentBytes = static_cast<size_t>(batchSize) * NUM_HEADS * totalLength * HEAD_DIM * kvElementBytes;
 
-        auto endTime = std::chrono::high_resolution_clock::now();
-        lastLatencyMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+    // Values must outlive Run(); the binding only references them
+    ArenaVector<Ort::Value> kvTensors{ArenaAllocator<Ort::Value>(sceneArena)};
+    kvTensors.reserve(NUM_LAYERS * 2 * 2);
+    for (int i = 0; i < NUM_LAYERS * 2; ++i) {
+        kvTensors.push_back(Ort::Value::CreateTensor(
+            *memoryInfo, kvBanks[pastBank][i].data(), pastBytes, pastShape, 4, kvElementType));
+        binding.BindInput(kvInputNames[i].c_str(), kvTensors.back());
 
-        std::cout << "[Camera] Total latency: " << lastLatencyMs << "ms" << std::endl;
-        std::cout << "[Camera] Description: " << description << std::endl;
+        kvTensors.push_back(Ort::Value::CreateTensor(
+            *memoryInfo, kvBanks[presentBank][i].data(), presentBytes, presentShape, 4, kvElementType));
+        binding.BindOutput(kvOutputNames[i].c_str(), kvTensors.back());
+    }
 
-        return description;
+    decoder->Run(runOptions, binding);
 
-    } catch (const std::exception& e) {
-        std::cerr << "[Camera] Error in DescribeScene: " << e.what() << std::endl;
-        return "";
+    if (logits) {
+        return logits;
     }
+    std::vector<Ort::Value> outputs = binding.GetOutputValues();
+    return std::move(outputs[0]);
 }
 
-std::vector<float> CameraVisionEngine::TokenizeAndEmbed(
-    const std::vector<int64_t>& tokens,
-    const std::vector<float>& imageFeatures) {
+void CameraVisionEngine::TruncateKV(int bank, int length, int keepLength) {
+    if (keepLength >= length) {
+        return;
+    }
 
-    try {
-        // Embed text tokens
-        std::vector<int64_t> tokenShape = {1, static_cast<int64_t>(tokens.size())};
+    // Head 0 is already in place; later heads slide down to the shorter stride
+    size_t rowBytes = static_cast<size_t>(keepLength) * HEAD_DIM * kvElementBytes;
+    for (auto& buffer : kvBanks[bank]) {
+        uint8_t* data = buffer.data();
+        for (int h = 1; h < NUM_HEADS; ++h) {
+            std::memmove(data + h * rowBytes, data + static_cast<size_t>(h) * length * HEAD_DIM * kvElementBytes,
+                         rowBytes);
+        }
+    }
+}
 
-        Ort::Value tokenTensor = Ort::Value::CreateTensor<int64_t>(
-            *memoryInfo,
-            const_cast<int64_t*>(tokens.data()),
-            tokens.size(),
-            tokenShape.data(),
-            tokenShape.size()
-        );
+bool CameraVisionEngine::EmbedTokensInto(const std::vector<int64_t>& tokens, std::vector<float>& out) {
+    out.resize(tokens.size() * HIDDEN_SIZE);
+    return EmbedTokensTo(tokens.data(), tokens.size(), out.data());
+}
+
+bool CameraVisionEngine::EmbedTokensTo(const int64_t* tokens, size_t count, float* out) {
+    bool allInTable = std::all_of(tokens, tokens + count, [this](int64_t id) {
+        return id >= 0 && static_cast<size_t>(id) < embeddingTableRows;
+    });
+    if (allInTable) {
+        for (size_t t = 0; t < count; ++t) {
+            std::memcpy(out + t * HIDDEN_SIZE, EmbedSingleToken(tokens[t]), HIDDEN_SIZE * sizeof(float));
+        }
+        return true;
+    }
+
+    // embed_tokens writes its [1, count, HIDDEN_SIZE] output straight into out
+    try {
+        const int64_t idShape[] = {1, static_cast<int64_t>(count)};
+        const int64_t embedShape[] = {1, static_cast<int64_t>(count), HIDDEN_SIZE};
+        Ort::Value idTensor = Ort::Value::CreateTensor<int64_t>(
+            *memoryInfo, const_cast<int64_t*>(tokens), count, idShape, 2);
+        Ort::Value embedTensor = Ort::Value::CreateTensor<float>(
+            *memoryInfo, out, count * HIDDEN_SIZE, embedShape, 3);
 
         const char* inputNames[] = {"input_ids"};
         const char* outputNames[] = {"inputs_embeds"};
+        embedTokens->Run(runOptions, inputNames, &idTensor, 1, outputNames, &embedTensor, 1);
+        return true;
 
-        auto outputTensors = embedTokens->Run(
-            Ort::RunOptions{nullptr},
-            inputNames,
-            &tokenTensor,
-            1,
-            outputNames,
-            1
-        );
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Token embedding error: " << e.what());
+        return false;
+    }
+}
 
-        float* embedData = outputTensors[0].GetTensorMutableData<float>();
-        auto tensorInfo = outputTensors[0].GetTensorTypeAndShapeInfo();
-        size_t embedSize = tensorInfo.GetElementCount();
+void CameraVisionEngine::SetGenerationConfig(const GenerationConfig& config) {
+    generationConfig = config;
+    generationConfig.maxTokens = (std::max)(1, config.maxTokens);
+    if (config.maxContext > 0) {
+        generationConfig.maxContext = (std::max)(MIN_CONTEXT, config.maxContext);
+    } else {
+        generationConfig.maxContext = 0;
+    }
 
-        std::vector<float> tokenEmbeds(embedData, embedData + embedSize);
+    stopTailLength = 1;
+    for (const auto& stop : generationConfig.stopSequences) {
+        stopTailLength = (std::max)(stopTailLength, stop.size());
+    }
+}
 
-        // Combine token embeds with image features
-        // Token embeds: [1, num_tokens, 896]
-        // Image features: [1, 16, 896]
-        // Need to insert image features at <image> token position (index 0)
+const char* CameraVisionEngine::CheckStopCondition(int64_t token, size_t generatedCount, std::string& tail,
+                                                   std::chrono::steady_clock::time_point start) const {
+    if (token == FastVLMTokenizer::EOS_TOKEN_ID) {
+        return "EOS token";
+    }
 
-        std::vector<float> combined;
-        combined.reserve(tokenEmbeds.size() + imageFeatures.size());
+    if (!generationConfig.stopSequences.empty()) {
+        FastVLMTokenizer::AppendTokenText(tail, tokenizer.GetToken(token));
+        if (tail.size() > stopTailLength) {
+            tail.erase(0, tail.size() - stopTailLength);
+        }
 
-        // Add image features first (replaces <image> token)
-        combined.insert(combined.end(), imageFeatures.begin(), imageFeatures.end());
+        // Trailing spaces don't end a sentence but shouldn't hide a "." before them
+        size_t end = tail.find_last_not_of(' ');
+        std::string_view text(tail.data(), end == std::string::npos ? 0 : end + 1);
+        for (const auto& stop : generationConfig.stopSequences) {
+            if (!stop.empty() && text.size() >= stop.size() &&
+                text.compare(text.size() - stop.size(), stop.size(), stop) == 0) {
+                return "stop sequence";
+            }
+        }
+    }
 
-        // Add remaining token embeddings (skip first token which is <image>)
-        size_t embedDim = 896;
-        size_t tokensPerEmbed = embedDim;
-        combined.insert(combined.end(),
-                       tokenEmbeds.begin() + embedDim,  // Skip first token embedding
-                       tokenEmbeds.end());
+    if (generatedCount >= static_cast<size_t>(generationConfig.maxTokens)) {
+        return "token budget";
+    }
 
-        return combined;
+    if (generationConfig.deadlineMs > 0 &&
+        std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(generationConfig.deadlineMs)) {
+        return "deadline";
+    }
+    return nullptr;
+}
 
-    } catch (const std::exception& e) {
-        std::cerr << "[Camera] Token embedding error: " << e.what() << std::endl;
-        return {};
+void CameraVisionEngine::StreamToken(FastVLMTokenizer::StreamDecoder& stream, int64_t token,
+                                     std::string& lastPartial) {
+    if (!partialCaptionCallback || warmingUp) {
+        return;
+    }
+    std::string_view added = stream.Push(token);
+    if (added.find_first_of(" \n") == std::string_view::npos) {
+        return;     // Still inside a word
+    }
+
+    // Up to the last word boundary: a half-decoded word isn't worth reporting
+    std::string_view text = stream.Text();
+    std::string partial = ShapeCaption(std::string(text.substr(0, text.find_last_of(" \n"))));
+    if (!partial.empty() && partial != lastPartial) {
+        lastPartial = partial;
+        partialCaptionCallback(partial);
     }
 }
 
 std::vector<int64_t> CameraVisionEngine::Generate(
     const std::vector<float>& inputEmbeds,
-    int maxTokens) {
+    int maxTokens,
+    int cachedPrefixLength) {
 
+    TRACE_ZONE("Camera generate");
+    SceneArena::Scope scene(sceneArena);
     std::vector<int64_t> generatedTokens;
+    generatedTokens.reserve(static_cast<size_t>(maxTokens) + maxDraftTokens);
+    auto startTime = std::chrono::steady_clock::now();
+    std::string stopTail;
+    stopTail.reserve(stopTailLength + STOP_TAIL_SLACK);
+    lastSpeculationStats = {0, 0, 0};
+    FastVLMTokenizer::StreamDecoder stream(tokenizer);
+    std::string lastPartial;
+    InferenceScheduler::Caption caption;    // Parks between steps while whisper has work
 
     try {
-        std::cout << "[Camera] Starting auto-regressive generation (max " << maxTokens << " tokens)..." << std::endl;
+        LOG_DEBUG("Camera", "Starting auto-regressive generation (max " << maxTokens << " tokens)...");
 
         // Calculate initial sequence length
         int seqLen = (inputEmbeds.size() / HIDDEN_SIZE);
-        std::cout << "[Camera] Initial sequence length: " << seqLen << std::endl;
-
-        // STEP 1: First forward pass with full prompt
-        // =============================================
-
-        // Create attention mask (all ones for input sequence)
-        std::vector<int64_t> attentionMask(seqLen, 1);
-
-        // Create position IDs
-        std::vector<int64_t> positionIds(seqLen);
-        for (int i = 0; i < seqLen; ++i) {
-            positionIds[i] = i;
+        LOG_DEBUG("Camera", "Initial sequence length: " << seqLen);
+
+        // Under maxContext the front of the prompt that doesn't fit is dropped:
+        // cached prefix positions first, then prefill embeddings
+        const int maxContext = generationConfig.maxContext;
+        int positionOffset = ContextOverflow(cachedPrefixLength + seqLen);
+        int prefixDropped = (std::min)(positionOffset, cachedPrefixLength);
+        int inputDropped = positionOffset - prefixDropped;
+        int pastLength = cachedPrefixLength - prefixDropped;
+        const float* prefill = inputEmbeds.data() + static_cast<size_t>(inputDropped) * HIDDEN_SIZE;
+        seqLen -= inputDropped;
+        if (positionOffset > 0) {
+            LOG_DEBUG("Camera", "Prompt truncated by " << positionOffset << " positions (max context " << maxContext << ")");
         }
 
-        // Prepare input tensors for first pass
-        std::vector<int64_t> embedShape = {1, static_cast<int64_t>(seqLen), HIDDEN_SIZE};
-        std::vector<int64_t> maskShape = {1, static_cast<int64_t>(seqLen)};
-        std::vector<int64_t> posShape = {1, static_cast<int64_t>(seqLen)};
-
-        Ort::Value embedTensor = Ort::Value::CreateTensor<float>(
-            *memoryInfo,
-            const_cast<float*>(inputEmbeds.data()),
-            inputEmbeds.size(),
-            embedShape.data(),
-            embedShape.size()
-        );
-
-        Ort::Value maskTensor = Ort::Value::CreateTensor<int64_t>(
-            *memoryInfo,
-            attentionMask.data(),
-            attentionMask.size(),
-            maskShape.data(),
-            maskShape.size()
-        );
-
-        Ort::Value posTensor = Ort::Value::CreateTensor<int64_t>(
-            *memoryInfo,
-            positionIds.data(),
-            positionIds.size(),
-            posShape.data(),
-            posShape.size()
-        );
+        // Generated tokens slide through what the prompt leaves of the context;
+        // drafts must fit in that window with the model's own token
+        const int sink = pastLength + seqLen;
+        int draftLimit = maxDraftTokens;
+        if (maxContext > 0) {
+            draftLimit = (std::min)(draftLimit, (std::max)(0, maxContext - sink - 1));
+        }
 
-        // For first pass: empty KV cache (sequence length = 0)
-        std::vector<int64_t> emptyKVShape = {1, NUM_HEADS, 0, HEAD_DIM};
-        std::vector<float> emptyKVData;
-
-        // Build input names and tensors
-        std::vector<const char*> inputNames = {"inputs_embeds", "attention_mask", "position_ids"};
-        std::vector<Ort::Value> inputTensors;
-        inputTensors.push_back(std::move(embedTensor));
-        inputTensors.push_back(std::move(maskTensor));
-        inputTensors.push_back(std::move(posTensor));
-
-        // Add empty past_key_values for all 24 layers
-        std::vector<std::string> kvInputNames;  // Need to keep strings alive
-        for (int layer = 0; layer < NUM_LAYERS; ++layer) {
-            kvInputNames.push_back("past_key_values." + std::to_string(layer) + ".key");
-            kvInputNames.push_back("past_key_values." + std::to_string(layer) + ".value");
-            inputNames.push_back(kvInputNames[layer * 2].c_str());
-            inputNames.push_back(kvInputNames[layer * 2 + 1].c_str());
-
-            // Empty tensors for first pass
-            inputTensors.push_back(Ort::Value::CreateTensor<float>(
-                *memoryInfo, emptyKVData.data(), 0, emptyKVShape.data(), emptyKVShape.size()
-            ));
-            inputTensors.push_back(Ort::Value::CreateTensor<float>(
-                *memoryInfo, emptyKVData.data(), 0, emptyKVShape.data(), emptyKVShape.size()
-            ));
-        }
-
-        // Build output names (logits + present KV cache for all layers)
-        std::vector<std::string> kvOutputNames;
-        std::vector<const char*> outputNames = {"logits"};
-        for (int layer = 0; layer < NUM_LAYERS; ++layer) {
-            kvOutputNames.push_back("present." + std::to_string(layer) + ".key");
-            kvOutputNames.push_back("present." + std::to_string(layer) + ".value");
-            outputNames.push_back(kvOutputNames[layer * 2].c_str());
-            outputNames.push_back(kvOutputNames[layer * 2 + 1].c_str());
-        }
-
-        std::cout << "[Camera] Running first forward pass..." << std::endl;
-
-        // Run first forward pass
-        auto outputTensors = decoder->Run(
-            Ort::RunOptions{nullptr},
-            inputNames.data(),
-            inputTensors.data(),
-            inputTensors.size(),
-            outputNames.data(),
-            outputNames.size()
-        );
+        // Prefix + prompt + every generated token (+ rejected drafts) must fit without
+        // reallocating mid-generation
+        size_t contextNeeded = static_cast<size_t>(sink) + maxTokens + draftLimit;
+        EnsureKVCapacity(maxContext > 0 ? (std::min)(contextNeeded, static_cast<size_t>(maxContext)) : contextNeeded);
 
-        // Extract first token from logits
-        float* logitsData = outputTensors[0].GetTensorMutableData<float>();
-        auto logitsInfo = outputTensors[0].GetTensorTypeAndShapeInfo();
-        auto logitsShape = logitsInfo.GetShape();
+        Ort::IoBinding binding(*decoder);
+        int pastBank = 0;
 
-        int vocabSize = logitsShape[2];
-        int lastTokenIdx = (logitsShape[1] - 1) * vocabSize;
+        // Restore the constant prompt prefix as past KV (compact copy == [1, H, prefix, D])
+        if (pastLength > 0) {
+            RestorePromptPrefix(pastBank, 1, prefixDropped);
+        }
 
-        // Find argmax (greedy selection)
-        float maxLogit = logitsData[lastTokenIdx];
-        int64_t nextToken = 0;
-        for (int i = 1; i < vocabSize; ++i) {
-            if (logitsData[lastTokenIdx + i] > maxLogit) {
-                maxLogit = logitsData[lastTokenIdx + i];
-                nextToken = i;
-            }
+        // STEP 1: First forward pass over the uncached prompt (past = cached prefix, if any)
+        // =============================================
+        LOG_DEBUG("Camera", "Running first forward pass...");
+        int64_t nextToken;
+        startTime += caption.Yield(0, static_cast<size_t>(maxTokens));
+        {
+            PipelineLatency::Timer timer(PipelineLatency::Stage::Prefill);
+            TRACE_ZONE("Camera prefill");
+            nextToken = RunDecoderStep(binding, prefill, seqLen, pastLength, pastBank, generatedTokens,
+                                       positionOffset);
         }
+        pastBank = 1 - pastBank;
 
         generatedTokens.push_back(nextToken);
-        std::cout << "[Camera] Generated token 1/" << maxTokens << ": " << nextToken << std::endl;
+        StreamToken(stream, nextToken, lastPartial);
+        LOG_DEBUG("Camera", "Generated token 1/" << maxTokens << ": " << nextToken);
 
-        // Check for EOS
-        if (nextToken == FastVLMTokenizer::EOS_TOKEN_ID) {
-            std::cout << "[Camera] EOS token reached" << std::endl;
+        // Check for EOS / first sentence / budget
+        if (const char* reason = CheckStopCondition(nextToken, generatedTokens.size(), stopTail, startTime)) {
+            LOG_DEBUG("Camera", "Stopped after 1 token (" << reason << ")");
             return generatedTokens;
         }
 
         // STEP 2: Auto-regressive loop
         // ==============================
+        int currentPos = sink;
+        bool speculate = draftLimit > 0 && logitsProcessor.IsGreedy();
+        SpeculationStats stats{0, 0, 0};
+        const char* stopReason = nullptr;
+
+        while (!stopReason && static_cast<int>(generatedTokens.size()) < maxTokens) {
+            startTime += caption.Yield(generatedTokens.size(), static_cast<size_t>(maxTokens));
+            TRACE_ZONE("Camera decode step");
+            SceneArena::Scope step(sceneArena);
+            auto stepStart = std::chrono::steady_clock::now();
+
+            // Leave room for the model's own token after the drafts
+            size_t remaining = static_cast<size_t>(maxTokens) - generatedTokens.size();
+            size_t drafted = speculate
+                ? drafter.Draft(generatedTokens, (std::min)(static_cast<size_t>(draftLimit), remaining - 1), draftTokens)
+                : 0;
+
+            verifyTokens.assign(1, nextToken);
+            verifyTokens.insert(verifyTokens.end(), draftTokens.begin(), draftTokens.begin() + drafted);
+
+            const float* stepInput = nullptr;
+            if (drafted == 0) {
+                // Embed the last generated token (table lookup when available)
+                stepInput = EmbedSingleToken(nextToken);
+            } else if (EmbedTokensInto(verifyTokens, verifyEmbeds)) {
+                stepInput = verifyEmbeds.data();
+            } else {
+                LOG_WARNING("Camera", "Draft embedding failed, continuing without speculation");
+                speculate = false;
+                continue;
+            }
 
-        // Store KV cache from first pass
-        std::vector<std::vector<float>> kvCache;
-        for (int i = 1; i < outputTensors.size(); ++i) {
-            float* kvData = outputTensors[i].GetTensorMutableData<float>();
-            auto kvInfo = outputTensors[i].GetTensorTypeAndShapeInfo();
-            size_t kvSize = kvInfo.GetElementCount();
-            kvCache.push_back(std::vector<float>(kvData, kvData + kvSize));
-        }
-
-        int currentPos = seqLen;
-
-        // Generate remaining tokens
-        for (int tokenIdx = 1; tokenIdx < maxTokens; ++tokenIdx) {
-            // Embed the last generated token
-            std::vector<int64_t> tokenVec = {nextToken};
-            std::vector<int64_t> tokenShape = {1, 1};
-
-            Ort::Value tokenTensor = Ort::Value::CreateTensor<int64_t>(
-                *memoryInfo,
-                tokenVec.data(),
-                1,
-                tokenShape.data(),
-                tokenShape.size()
-            );
-
-            // Get token embedding
-            const char* embedInputNames[] = {"input_ids"};
-            const char* embedOutputNames[] = {"inputs_embeds"};
-
-            auto embedOutputs = embedTokens->Run(
-                Ort::RunOptions{nullptr},
-                embedInputNames,
-                &tokenTensor,
-                1,
-                embedOutputNames,
-                1
-            );
-
-            float* newEmbedData = embedOutputs[0].GetTensorMutableData<float>();
-            size_t newEmbedSize = HIDDEN_SIZE;
-
-            // Prepare inputs for next decoder pass
-            std::vector<int64_t> newEmbedShape = {1, 1, HIDDEN_SIZE};
-            std::vector<int64_t> newMask = {1};
-            std::vector<int64_t> newMaskShape = {1, 1};
-            std::vector<int64_t> newPos = {currentPos};
-            std::vector<int64_t> newPosShape = {1, 1};
-
-            Ort::Value newEmbedTensor = Ort::Value::CreateTensor<float>(
-                *memoryInfo,
-                newEmbedData,
-                newEmbedSize,
-                newEmbedShape.data(),
-                newEmbedShape.size()
-            );
-
-            Ort::Value newMaskTensor = Ort::Value::CreateTensor<int64_t>(
-                *memoryInfo,
-                newMask.data(),
-                1,
-                newMaskShape.data(),
-                newMaskShape.size()
-            );
-
-            Ort::Value newPosTensor = Ort::Value::CreateTensor<int64_t>(
-                *memoryInfo,
-                newPos.data(),
-                1,
-                newPosShape.data(),
-                newPosShape.size()
-            );
-
-            // Build inputs with KV cache
-            std::vector<Ort::Value> newInputTensors;
-            newInputTensors.push_back(std::move(newEmbedTensor));
-            newInputTensors.push_back(std::move(newMaskTensor));
-            newInputTensors.push_back(std::move(newPosTensor));
-
-            // Add past KV cache
-            std::vector<int64_t> kvShape = {1, NUM_HEADS, currentPos, HEAD_DIM};
-            for (size_t i = 0; i < kvCache.size(); ++i) {
-                newInputTensors.push_back(Ort::Value::CreateTensor<float>(
-                    *memoryInfo,
-                    kvCache[i].data(),
-                    kvCache[i].size(),
-                    kvShape.data(),
-                    kvShape.size()
-                ));
-            }
-
-            // Run decoder with KV cache
-            auto newOutputs = decoder->Run(
-                Ort::RunOptions{nullptr},
-                inputNames.data(),
-                newInputTensors.data(),
-                newInputTensors.size(),
-                outputNames.data(),
-                outputNames.size()
-            );
-
-            // Extract next token
-            float* newLogitsData = newOutputs[0].GetTensorMutableData<float>();
-
-            // Find argmax
-            maxLogit = newLogitsData[0];
-            nextToken = 0;
-            for (int i = 1; i < vocabSize; ++i) {
-                if (newLogitsData[i] > maxLogit) {
-                    maxLogit = newLogitsData[i];
-                    nextToken = i;
+            // One pass over [last token, drafts...]: past lives in kvBanks[pastBank],
+            // present lands in the other bank
+            int numTokens = static_cast<int>(verifyTokens.size());
+            if (maxContext > 0 && currentPos + numTokens > maxContext) {
+                // Evict the oldest generated tokens, half the window at a time
+                int evict = (std::max)(currentPos + numTokens - maxContext, (maxContext - sink) / 2);
+                evict = (std::min)(evict, currentPos - sink);
+                EvictKV(pastBank, 1, currentPos, sink, evict);
+                currentPos -= evict;
+                positionOffset += evict;
+            }
+            Ort::Value logits = RunDecoder(binding, stepInput, 1, numTokens, currentPos, pastBank, positionOffset);
+            pastBank = 1 - pastBank;
+            stats.decoderRuns++;
+            stats.draftedTokens += drafted;
+
+            float* logitsData = logits.GetTensorMutableData<float>();
+            size_t vocabSize = static_cast<size_t>(logits.GetTensorTypeAndShapeInfo().GetShape()[2]);
+
+            // Row r predicts the token after verifyTokens[r]; keep going while it
+            // matches the next draft, so the rows after it saw the right input
+            int fed = 0;
+            for (int row = 0; row < numTokens; ++row) {
+                nextToken = logitsProcessor.SelectToken(logitsData + row * vocabSize, vocabSize, generatedTokens);
+                generatedTokens.push_back(nextToken);
+                StreamToken(stream, nextToken, lastPartial);
+                fed = row + 1;
+
+                stopReason = CheckStopCondition(nextToken, generatedTokens.size(), stopTail, startTime);
+                if (stopReason) {
+                    break;
                 }
+                if (row + 1 < numTokens && nextToken == verifyTokens[row + 1]) {
+                    stats.acceptedTokens++;
+                    continue;
+                }
+                break;
             }
 
-            generatedTokens.push_back(nextToken);
-            std::cout << "[Camera] Generated token " << (tokenIdx + 1) << "/" << maxTokens
-                     << ": " << nextToken << std::endl;
+            // Rejected drafts still wrote KV; drop those positions
+            TruncateKV(pastBank, currentPos + numTokens, currentPos + fed);
+            currentPos += fed;
 
-            // Check for EOS
-            if (nextToken == FastVLMTokenizer::EOS_TOKEN_ID) {
-                std::cout << "[Camera] EOS token reached after " << (tokenIdx + 1) << " tokens" << std::endl;
-                break;
-            }
+            // Accepted drafts share the run's cost
+            double stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+            PipelineLatency::Record(PipelineLatency::Stage::DecodeToken, stepMs / fed);
+            caption.Step(static_cast<size_t>(fed), stepMs);
+        }
 
-            // Update KV cache with new present values
-            kvCache.clear();
-            for (int i = 1; i < newOutputs.size(); ++i) {
-                float* newKVData = newOutputs[i].GetTensorMutableData<float>();
-                auto newKVInfo = newOutputs[i].GetTensorTypeAndShapeInfo();
-                size_t newKVSize = newKVInfo.GetElementCount();
-                kvCache.push_back(std::vector<float>(newKVData, newKVData + newKVSize));
-            }
+        if (stopReason) {
+            LOG_DEBUG("Camera", "Stopped after " << generatedTokens.size() << " tokens (" << stopReason << ")");
+        }
 
-            currentPos++;
+        lastSpeculationStats = stats;
+        if (stats.draftedTokens > 0) {
+            LOG_DEBUG("Camera", "Speculation: " << stats.acceptedTokens << "/" << stats.draftedTokens
+                      << " drafts accepted, " << stats.decoderRuns << " decoder runs for "
+                      << generatedTokens.size() << " tokens");
         }
+        drafter.Observe(generatedTokens);
+        sceneArenaBytes = sceneArena.GetReservedBytes();
 
-        std::cout << "[Camera] Generation complete! Generated " << generatedTokens.size() << " tokens" << std::endl;
+        LOG_DEBUG("Camera", "Generation complete! Generated " << generatedTokens.size() << " tokens");
         return generatedTokens;
 
     } catch (const std::exception& e) {
-        std::cerr << "[Camera] Generation error: " << e.what() << std::endl;
+        LOG_ERROR("Camera", "Generation error: " << e.what());
         return {};
     }
 }
 
-std::string CameraVisionEngine::DecodeTokens(const std::vector<int64_t>& tokenIds) {
-    // Use FastVLMTokenizer to decode tokens
-    FastVLMTokenizer tokenizer;
+std::vector<std::vector<int64_t>> CameraVisionEngine::GenerateBatch(
+    const std::vector<float>& inputEmbeds,
+    size_t batch,
+    int maxTokens,
+    int cachedPrefixLength) {
+
+    TRACE_ZONE("Camera generate batch");
+    SceneArena::Scope scene(sceneArena);
+    std::vector<std::vector<int64_t>> generated(batch);
+    if (batch == 0) {
+        return generated;
+    }
+    for (auto& tokens : generated) {
+        tokens.reserve(static_cast<size_t>(maxTokens));
+    }
+
+    try {
+        if (inputEmbeds.size() % (batch * HIDDEN_SIZE) != 0) {
+            LOG_ERROR("Camera", "Batched sequences must have equal length");
+            return {};
+        }
+        int seqLen = static_cast<int>(inputEmbeds.size() / (batch * HIDDEN_SIZE));
+
+        LOG_DEBUG("Camera", "Starting batched generation (" << batch << " sequences, max "
+                  << maxTokens << " tokens)...");
+        auto startTime = std::chrono::steady_clock::now();
+        // maxContext: same truncation and sliding window as Generate, for every slot
+        const int maxContext = generationConfig.maxContext;
+        int positionOffset = ContextOverflow(cachedPrefixLength + seqLen);
+        int prefixDropped = (std::min)(positionOffset, cachedPrefixLength);
+        int inputDropped = positionOffset - prefixDropped;
+        int pastLength = cachedPrefixLength - prefixDropped;
+        const float* prefill = inputEmbeds.data();
+        std::vector<float> truncated;
+        if (inputDropped > 0) {
+            // Each sequence loses its own first positions: repack the kept tails back to back
+            size_t stride = static_cast<size_t>(seqLen) * HIDDEN_SIZE;
+            size_t kept = static_cast<size_t>(seqLen - inputDropped) * HIDDEN_SIZE;
+            truncated.resize(batch * kept);
+            for (size_t b = 0; b < batch; ++b) {
+                std::memcpy(truncated.data() + b * kept, inputEmbeds.data() + b * stride + (stride - kept),
+                            kept * sizeof(float));
+            }
+            prefill = truncated.data();
+            seqLen -= inputDropped;
+        }
+        const int sink = pastLength + seqLen;
+
+        size_t contextNeeded = static_cast<size_t>(sink) + maxTokens;
+        EnsureKVCapacity(maxContext > 0 ? (std::min)(contextNeeded, static_cast<size_t>(maxContext)) : contextNeeded,
+                         batch);
+
+        Ort::IoBinding binding(*decoder);
+        int pastBank = 0;
+
+        // Restore the constant prompt prefix into every slot ([B, H, prefix, D])
+        if (pastLength > 0) {
+            RestorePromptPrefix(pastBank, batch, prefixDropped);
+        }
+
+        // STEP 1: One prefill pass over all prompts, already laid out back to back
+        ArenaVector<const std::vector<int64_t>*> histories(batch, ArenaAllocator<const std::vector<int64_t>*>(sceneArena));
+        for (size_t b = 0; b < batch; ++b) {
+            histories[b] = &generated[b];
+        }
+        ArenaVector<int64_t> firstTokens(batch, ArenaAllocator<int64_t>(sceneArena));
+        {
+            PipelineLatency::Timer timer(PipelineLatency::Stage::Prefill);
+            TRACE_ZONE("Camera prefill");
+            RunDecoderBatch(binding, prefill, static_cast<int>(batch), seqLen, pastLength,
+                            pastBank, histories.data(), firstTokens.data(), positionOffset);
+        }
 
-    // Load vocabulary
-    std::string vocabPath = "models/fastvlm/vocab.json";
-    if (!tokenizer.LoadVocab(vocabPath)) {
-        std::cerr << "[Camera] Failed to load vocabulary from " << vocabPath << std::endl;
+        // STEP 2: Interleaved decode steps over the captions still in flight
+        int steps = DecodeBatch(binding, 1 - pastBank, sink, sink, positionOffset, firstTokens.data(), nullptr,
+                                maxTokens, startTime, generated);
+
+        for (const auto& tokens : generated) {
+            drafter.Observe(tokens);
+        }
+        sceneArenaBytes = sceneArena.GetReservedBytes();
+
+        LOG_DEBUG("Camera", "Batched generation complete (" << steps << " decode steps for "
+                  << batch << " sequences)");
+        return generated;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("Camera", "Batched generation error: " << e.what());
+        return {};
+    }
+}
+
+int CameraVisionEngine::DecodeBatch(
+    Ort::IoBinding& binding,
+    int pastBank,
+    int currentPos,
+    int sink,
+    int positionOffset,
+    const int64_t* firstTokens,
+    const std::vector<std::vector<int64_t>>* forced,
+    int maxTokens,
+    std::chrono::steady_clock::time_point startTime,
+    std::vector<std::vector<int64_t>>& generated) {
+
+    const size_t batch = generated.size();
+    const int maxContext = generationConfig.maxContext;
+    std::vector<std::string> stopTails(batch);
+    for (auto& tail : stopTails) {
+        tail.reserve(stopTailLength + STOP_TAIL_SLACK);
+    }
+
+    // Slot k holds sequence active[k]; slots retire as their sequence finishes.
+    // Only ever shrink, so the arena holds them without waste
+    ArenaVector<size_t> active(batch, ArenaAllocator<size_t>(sceneArena));
+    ArenaVector<const std::vector<int64_t>*> histories(batch, ArenaAllocator<const std::vector<int64_t>*>(sceneArena));
+    ArenaVector<int64_t> nextTokens(firstTokens, firstTokens + batch, ArenaAllocator<int64_t>(sceneArena));
+    ArenaVector<size_t> fed(batch, 0, ArenaAllocator<size_t>(sceneArena));
+    for (size_t b = 0; b < batch; ++b) {
+        active[b] = b;
+    }
+    ArenaVector<float> stepBatch(batch * HIDDEN_SIZE, ArenaAllocator<float>(sceneArena));
+
+    int evicted = 0;
+    InferenceScheduler::Caption caption;    // Parks between steps while whisper has work
+    while (!active.empty()) {
+        // Record this step's tokens; retire finished sequences (iterate back
+        // to front so removing a slot doesn't shift ones still to visit)
+        for (size_t k = active.size(); k-- > 0;) {
+            size_t sequence = active[k];
+            if (forced && fed[sequence] < (*forced)[sequence].size()) {
+                // Still reading its prompt: feed the next prompt token, drop the prediction
+                nextTokens[k] = (*forced)[sequence][fed[sequence]++];
+                continue;
+            }
+            std::vector<int64_t>& tokens = generated[sequence];
+            tokens.push_back(nextTokens[k]);
+            bool finished = tokens.size() >= static_cast<size_t>(maxTokens) ||
+                CheckStopCondition(nextTokens[k], tokens.size(), stopTails[sequence], startTime) != nullptr;
+            if (finished) {
+                RemoveKVSlot(pastBank, static_cast<int>(k), static_cast<int>(active.size()), currentPos);
+                active.erase(active.begin() + k);
+                nextTokens.erase(nextTokens.begin() + k);
+            }
+        }
+        if (active.empty()) {
+            break;
+        }
+
+        int activeCount = static_cast<int>(active.size());
+        stepBatch.resize(static_cast<size_t>(activeCount) * HIDDEN_SIZE);
+        histories.resize(active.size());
+        for (int k = 0; k < activeCount; ++k) {
+            std::memcpy(stepBatch.data() + static_cast<size_t>(k) * HIDDEN_SIZE,
+                        EmbedSingleToken(nextTokens[k]), HIDDEN_SIZE * sizeof(float));
+            histories[k] = &generated[active[k]];
+        }
+
+        if (maxContext > 0 && currentPos + 1 > maxContext) {
+            int evict = (std::min)((std::max)(1, (maxContext - sink) / 2), currentPos - sink);
+            EvictKV(pastBank, activeCount, currentPos, sink, evict);
+            currentPos -= evict;
+            positionOffset += evict;
+            evicted += evict;
+        }
+
+        startTime += caption.Yield(generated[active[0]].size(), static_cast<size_t>(maxTokens));
+
+        // One step yields a token for every sequence in flight, in the time of one
+        PipelineLatency::Timer timer(PipelineLatency::Stage::DecodeToken);
+        TRACE_ZONE("Camera decode step");
+        auto stepStart = std::chrono::steady_clock::now();
+        RunDecoderBatch(binding, stepBatch.data(), activeCount, 1, currentPos, pastBank,
+                        histories.data(), nextTokens.data(), positionOffset);
+        pastBank = 1 - pastBank;
+        currentPos++;
+        caption.Step(1, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count());
+    }
+    return currentPos + evicted - sink;
+}
+
+std::string CameraVisionEngine::DecodeTokens(const std::vector<int64_t>& tokenIds) {
+    TRACE_ZONE("Camera detokenize");
+    if (!tokenizer.IsLoaded()) {
+        LOG_ERROR("Camera", "Vocabulary not loaded");
         return "[Error: Could not load vocabulary]";
     }
 
     // Decode token IDs to text
-    std::string decoded = tokenizer.Decode(tokenIds);
+    return ShapeCaption(tokenizer.Decode(tokenIds));
+}
 
-    // Clean up the output (remove extra whitespace, trim, etc.)
+std::string CameraVisionEngine::ShapeCaption(std::string decoded) {
     // Remove leading/trailing whitespace
     size_t start = decoded.find_first_not_of(" \t\n\r");
     size_t end = decoded.find_last_not_of(" \t\n\r");
 
     if (start != std::string::npos && end != std::string::npos) {
         decoded = decoded.substr(start, end - start + 1);
+    } else {
+        return "";
+    }
+
+    // Same shaping as the Python client: first sentence, no trailing period
+    for (const char* delimiter : {"\n", ". ", "? ", "! "}) {
+        size_t cut = decoded.find(delimiter);
+        if (cut != std::string::npos) {
+            decoded.resize(cut);
+            break;
+        }
+    }
+    while (!decoded.empty() && (decoded.back() == '.' || decoded.back() == ' ')) {
+        decoded.pop_back();
+    }
+    if (!decoded.empty() && decoded[0] >= 'a' && decoded[0] <= 'z') {
+        decoded[0] = static_cast<char>(decoded[0] - 'a' + 'A');
     }
 
     return decoded;
@@ -1,10 +1,30 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <vector>
+#include <list>
+#include <unordered_map>
 #include <memory>
+#include <utility>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <opencv2/opencv.hpp>
 #include <onnxruntime_cxx_api.h>
+#include "FastVLMTokenizer.h"
+#include "FrameCapture.h"
+#include "LogitsProcessor.h"
+#include "ModelVariants.h"
+#include "RegionDetector.h"
+#include "NGramDrafter.h"
+#include "SceneArena.h"
 
 /**
  * @brief Camera vision engine using FastVLM ONNX models for scene description
@@ -12,7 +32,7 @@
  * Architecture:
  *   Camera → Vision Encoder → Image Features → Text Decoder → Scene Description
  *
- * Models (q4f16 quantization):
+ * Models (precision per model chosen by ModelVariants, e.g. q4f16):
  *   - vision_encoder_q4f16.onnx (241MB): Extracts image features
  *   - embed_tokens_q4f16.onnx (260MB): Embeds text tokens
  *   - decoder_model_merged_q4f16.onnx (270MB): Generates text description
@@ -21,6 +41,84 @@
  *   - Vision encoder: 250-400ms (CPU)
  *   - Decoder: 1200-1800ms for 50 tokens (CPU)
  *   - Total: 1.5-2.5 seconds (vs 8-12s Python)
+ *
+ * Capture:
+ *   Each camera has a FrameCapture thread that drains the driver queue and
+ *   decodes at captureFps into a latest-frame mailbox. DescribeScene takes
+ *   the freshest frame without blocking on camera I/O.
+ *
+ * Multi-stream:
+ *   Initialize with several camera indices and call DescribeScenes() to
+ *   caption every stream in one round. Unchanged streams are answered by the
+ *   scene gate; the rest are batched: one vision encoder run over all changed
+ *   frames, then decoder steps over a [B, ...] batch where each caption owns
+ *   a KV slot. A caption that hits EOS retires and its slot is compacted out,
+ *   so later steps only pay for captions still in flight.
+ *
+ * Scene-change gating:
+ *   Each captured frame gets a 64-bit difference hash (9x8 grayscale). If it is
+ *   within sceneChangeThreshold bits of the last described frame, the encoder
+ *   and decoder are skipped and the previous description is returned.
+ *
+ * Feature cache:
+ *   Frames that do change are looked up in a small LRU of (hash -> image
+ *   features, description). A near-duplicate of any recent scene (within
+ *   featureCacheThreshold bits) reuses its description, or at least its
+ *   features, so returning to an earlier view skips the encoder and decoder.
+ *
+ * Speculative decoding:
+ *   With greedy decoding, an n-gram table built from earlier captions drafts
+ *   the next few tokens; one decoder pass over [last token, drafts...] checks
+ *   them all, keeping the longest prefix the model agrees with plus the
+ *   model's own next token. Output is the same as plain greedy decoding, but
+ *   a familiar phrase costs one decoder run instead of one per token.
+ *
+ * Prompt cache:
+ *   The prompt is split at <image>. Tokens before it are a constant prefix:
+ *   they are prefilled once in Initialize and their KV state is copied into
+ *   the cache at the start of every Generate, so prefill only covers the image
+ *   features and the text after them. The text after <image> depends on the
+ *   image (causal attention), so only its embeddings are cached. The default
+ *   prompt is the model's chat template (same as the Python client), whose
+ *   system/user preamble is the KV-cached prefix.
+ *
+ * KV cache:
+ *   Stored in the precision the decoder's past_key_values inputs declare:
+ *   fp16 for the variants exported with half KV, which halves its memory
+ *   and the bytes every decode step reads. GenerationConfig::maxContext caps
+ *   the positions a sequence holds: the prompt keeps at most 3/4 of them
+ *   (truncated from the front) and generated tokens slide through the rest,
+ *   the oldest evicted in chunks; position ids keep counting, so RoPE
+ *   distances stay right.
+ *
+ * Staged pipeline:
+ *   DescribeScene() runs capture, preprocess, encoder, prefill and decode
+ *   back to back. StartPipeline() splits them over two threads instead: the
+ *   encoder stage (capture, gate, preprocess, vision encoder) hands image
+ *   features through a bounded queue (PIPELINE_DEPTH) to the decoder stage
+ *   (prefill, decode, detokenize), so frame N+1 is encoded while frame N
+ *   decodes and captions arrive at the rate of the slower stage. The encoder
+ *   waits for room in the queue before taking a frame, keeping it fresh.
+ *   SetEncoderThreads() gives the encoder its own ORT pool so the two
+ *   sessions don't compete for the global one.
+ *
+ * Requests:
+ *   Submit() queues a caption of a camera's freshest frame or of a given
+ *   image (e.g. a region crop) and returns a future; Ask() queues questions
+ *   about one the same way. One worker thread runs the queue, so the
+ *   periodic caption loop, HTTP /describe and /ask and ROI callers can share
+ *   the engine from any thread. A request for a frame already queued or
+ *   being captioned (same stream with no newer frame captured, or an
+ *   identical image) joins it instead of running again. The direct
+ *   Describe*() calls and UnloadModels() are serialized with the worker.
+ *
+ * Idle unload:
+ *   UnloadModels() drops the sessions and everything sized for them (~1 GB)
+ *   while cameras, vocabulary and scene state stay. The next DescribeScene()
+ *   reloads them with the execution providers the first probe chose.
+ *
+ * Captions are post-processed like the Python client's: first sentence only,
+ * no trailing period, first letter capitalized.
  */
 class CameraVisionEngine {
 public:
@@ -36,41 +134,746 @@ public:
     bool Initialize(const std::string& modelPath, int cameraIndex = 0);
 
     /**
-     * @brief Capture frame and generate scene description
+     * @brief Initialize the ONNX models and one capture stream per camera
+     *
+     * With more than one camera the vision encoder and decoder are loaded with
+     * a dynamic batch dimension (cached as <model>.batched.opt.onnx).
+     * Cameras that fail to open are skipped; fails if none open.
+     */
+    bool Initialize(const std::string& modelPath, const std::vector<int>& cameraIndices);
+
+    /**
+     * @brief Initialize the ONNX models only, for captioning supplied images (bench_camera)
+     *
+     * DescribeImage() works afterwards; DescribeScene() returns empty (no streams).
+     */
+    bool InitializeWithoutCamera(const std::string& modelPath);
+
+    /**
+     * @brief Stop the capture threads and release the cameras (also done by the destructor)
+     *
+     * Lets a replacement engine open the same cameras while this one is
+     * abandoned with its caption thread stuck.
+     */
+    void CloseCameras();
+
+    /**
+     * @brief Open the cameras CloseCameras() released again (EngineHost resume)
+     * @return false when none reopened
+     */
+    bool ReopenCameras();
+
+    /**
+     * @brief Make every ORT Run in progress or to come fail at once (RunOptions::SetTerminate)
+     *
+     * For shutdown: a caption being decoded ends with an empty description
+     * instead of finishing, and so does everything queued behind it. Final.
+     */
+    void Cancel();
+
+    /**
+     * @brief Capture frame and generate scene description (stream 0)
      * @return Scene description text (empty on error)
      */
     std::string DescribeScene();
 
+    /**
+     * @brief Caption every stream in one batched round
+     * @return One description per stream, in Initialize order (empty on error)
+     */
+    std::vector<std::string> DescribeScenes();
+
+    /**
+     * @brief Caption one image through the full pipeline
+     *
+     * Preprocess, vision encoder, prefill and decode always run: the scene gate
+     * and feature cache are bypassed so every call measures the same work.
+     * @return Scene description text (empty on error)
+     */
+    std::string DescribeImage(const cv::Mat& image);
+
+    /**
+     * @brief Result of a Submit()ted request
+     */
+    struct Caption {
+        std::string description;    // Empty on error
+        float latencyMs = 0.0f;     // Submit to result, queueing included
+        bool reused = false;        // Answered by the scene gate or feature cache
+        bool coalesced = false;     // Shared with an earlier request for the same frame
+        std::vector<std::string> answers;   // Ask(): one per question, in order (empty on error)
+    };
+
+    /**
+     * @brief Queue a caption of stream streamIndex's freshest frame (taken when the request runs)
+     *
+     * Goes through the scene gate and feature cache like DescribeScene(). Joins
+     * a request for the same stream that is still queued, or one in flight
+     * when no newer frame has been captured since it started.
+     */
+    std::future<Caption> Submit(int streamIndex = 0);
+
+    /**
+     * @brief Queue a caption of image (only the region inside it, when given)
+     *
+     * The image is copied. Joins a queued or in-flight request only for an
+     * identical image (same hash and pixels); otherwise it goes through the
+     * feature cache (not the scene gate, which belongs to a stream), which
+     * may answer a near-duplicate the way it does for camera frames.
+     */
+    std::future<Caption> Submit(const cv::Mat& image, const cv::Rect& region = cv::Rect());
+
+    using SubmitCallback = std::function<void(const Caption& caption)>;
+
+    /**
+     * @brief Submit() that calls back instead of returning a future
+     *
+     * For callers that must not wait (HTTP handlers answering later): the
+     * callback runs on the request worker once the caption is ready, or
+     * right away on the calling thread when the request is refused. It
+     * must return quickly and must not Submit() again.
+     */
+    void Submit(int streamIndex, SubmitCallback callback);
+    void Submit(const cv::Mat& image, const cv::Rect& region, SubmitCallback callback);
+
+    /**
+     * @brief Queue several questions about one frame: one encoder pass, N short decodes
+     *
+     * The frame (stream streamIndex's freshest, or image) is encoded once
+     * (or taken from the feature cache) and prefilled once together with
+     * the system prompt and the text all questions start with. That KV is
+     * forked into one slot per question, and the questions' own tokens and
+     * answers decode as one batch, so N questions cost about one caption
+     * plus a few decoder steps. Answers are shaped like captions (first
+     * sentence). The scene gate doesn't apply, and nothing is cached for
+     * the caption path. Needs merges.txt (see SetPromptQuestion).
+     * Joins only a request for the same frame and the same questions.
+     */
+    std::future<Caption> Ask(const std::vector<std::string>& questions, int streamIndex = 0,
+                             SubmitCallback callback = nullptr);
+    std::future<Caption> Ask(const std::vector<std::string>& questions, const cv::Mat& image,
+                             SubmitCallback callback = nullptr);
+
+    static constexpr size_t MAX_QUESTIONS = 16;
+
+    /**
+     * @brief Requests queued and not yet running
+     */
+    size_t GetPendingRequestCount();
+
+    /**
+     * @brief Caption delivered by the staged pipeline
+     */
+    struct PipelineCaption {
+        std::string description;    // Empty when captioning the frame failed (images only)
+        float latencyMs;            // Frame taken to caption decoded, queueing included
+        bool reused;                // Answered by the scene gate or feature cache
+        uint64_t sequence;          // Camera frame sequence, or image index
+    };
+    using CaptionCallback = std::function<void(const PipelineCaption&)>;
+
+    /**
+     * @brief Caption stream 0 continuously on the staged pipeline
+     *
+     * Frames are taken at most every intervalMs (0: as fast as the slower
+     * stage allows) and go through the scene gate and feature cache like
+     * DescribeScene(); a frame matching the one still in flight is skipped.
+     * onCaption runs on the decoder thread. DescribeScene(s), DescribeImage()
+     * and UnloadModels() are refused until StopPipeline().
+     * @return false if the engine, models or camera aren't ready, or already running
+     */
+    bool StartPipeline(const CaptionCallback& onCaption, int intervalMs = 0);
+
+    /**
+     * @brief Stop and join both stages (also done by the destructor)
+     */
+    void StopPipeline();
+    bool IsPipelineRunning() const { return pipelineRunning.load(); }
+
+    /**
+     * @brief Caption a list of images on the staged pipeline (bench_camera)
+     *
+     * Like DescribeImage() per image (no gate or cache), with the encoder of
+     * image i+1 overlapping the decode of image i. Blocks until all are done.
+     * @param latenciesMs Optional per-image latency, in input order
+     * @return One description per image (empty on error)
+     */
+    std::vector<std::string> DescribeImagesPipelined(const std::vector<cv::Mat>& images,
+                                                     std::vector<float>* latenciesMs = nullptr);
+
+    /**
+     * @brief Private intra-op pool for the vision encoder (call before Initialize)
+     *
+     * 0 (default) shares the global pool with the decoder. For the staged
+     * pipeline a few threads of its own let the encoder run beside a decode
+     * instead of queueing behind its parallel loops.
+     */
+    void SetEncoderThreads(int threads) { encoderThreads = (std::max)(0, threads); }
+
+    /**
+     * @brief Caption detected faces/people instead of the whole frame (call before Initialize)
+     *
+     * DescribeScene() runs a RegionDetector on each changed frame first. With
+     * nothing found it returns NO_REGIONS_DESCRIPTION without touching FastVLM;
+     * otherwise the crops (at most maxRegions) go through one batched encoder
+     * run and one batched decode, and their captions are joined. More than one
+     * region keeps batch_size dynamic in the sessions. Multi-camera
+     * DescribeScenes() and the staged pipeline still caption whole frames.
+     * @param faceModelPath YuNet face detection ONNX model
+     * @return false (and whole-frame captions) if the detector could not load
+     */
+    bool EnableRegionDetection(const std::string& faceModelPath,
+                               int maxRegions = RegionDetector::DEFAULT_MAX_REGIONS);
+    bool IsRegionDetectionEnabled() const { return regionDetector.IsReady(); }
+
+    static constexpr const char* NO_REGIONS_DESCRIPTION = "No one in view";
+
+    /**
+     * @brief Number of open camera streams
+     */
+    size_t GetStreamCount() const { return streams.size(); }
+
+    /**
+     * @brief A stream's capture, for viewers outside the caption path (FrameCapture::GetPreview)
+     * @return nullptr for a stream index that isn't open
+     */
+    FrameCapture* GetCapture(size_t stream) const {
+        return stream < streams.size() ? streams[stream].capture.get() : nullptr;
+    }
+
     /**
      * @brief Get last inference latency in milliseconds
      */
-    float GetLastLatencyMs() const { return lastLatencyMs; }
+    float GetLastLatencyMs() const { return lastLatencyMs.load(); }
 
     /**
      * @brief Check if engine is initialized and ready
      */
     bool IsReady() const { return isInitialized; }
 
+    /**
+     * @brief Run the caption path once on a blank 224x224 frame
+     *
+     * Each session's first Run allocates its arena and buffers; this takes
+     * that cost off the first real caption. Encoder, prefill and
+     * WARMUP_TOKENS decode steps run; no partial captions, caches or scene
+     * state are touched. Blocks other captions while it runs.
+     * @return false when not initialized or a stage failed
+     */
+    bool WarmUp();
+    bool IsWarm() const { return warm.load(); }
+
+    /**
+     * @brief Release the ONNX sessions, embedding table and KV/prompt caches
+     *
+     * Cameras, vocabulary and gating state stay; the next DescribeScene()
+     * reloads the sessions (skipping the provider probe). Call from the
+     * thread that runs DescribeScene().
+     */
+    void UnloadModels();
+    bool AreModelsLoaded() const { return modelsLoaded; }
+
+    /**
+     * @brief Frames decoded per second by the capture thread (default 2)
+     */
+    void SetCaptureFps(double fps);
+    double GetCaptureFps() const { return captureFps; }
+
+    /**
+     * @brief Camera backend (call before Initialize; default Auto = Media Foundation first)
+     *
+     * With Media Foundation the frames arrive already scaled to the encoder's
+     * 224x224 (BGRA), so preprocessing skips the resize; in region mode they
+     * keep the capture size so crops have pixels to spare.
+     */
+    void SetCaptureBackend(FrameCapture::Backend backend) { captureBackend = backend; }
+
+    /**
+     * @brief Caption a video file, network stream or test pattern instead of the cameras
+     *
+     * Spec as FrameCapture::SetSource ("file:clip.mp4", "rtsp://...",
+     * "synthetic", ...); call before Initialize. Empty = the cameras.
+     */
+    void SetCaptureSource(const std::string& spec) { captureSource = spec; }
+
+    /**
+     * @brief Frames published by all capture threads so far
+     */
+    uint64_t GetCapturedFrameCount() const;
+
+    /**
+     * @brief Age of the frame used by the last DescribeScene() in milliseconds
+     */
+    float GetLastFrameAgeMs() const { return lastFrameAgeMs.load(); }
+
+    /**
+     * @brief Max Hamming distance (of 64 hash bits) still treated as the same scene
+     * Negative disables gating so every call runs the full pipeline.
+     */
+    void SetSceneChangeThreshold(int bits) { sceneChangeThreshold.store(bits); }
+    int GetSceneChangeThreshold() const { return sceneChangeThreshold.load(); }
+
+    /**
+     * @brief Gating counters (safe to read from any thread)
+     */
+    struct SceneStats {
+        uint64_t scenesDescribed;   // Full pipeline runs
+        uint64_t scenesSkipped;     // Unchanged frames answered from the previous description
+        int lastSceneDistance;      // Hash distance of the last frame (-1 before the first)
+        uint64_t cacheHits;         // Changed frames answered from the feature cache
+        uint64_t cacheMisses;       // Changed frames that ran the vision encoder
+        uint64_t scenesEmpty;       // Changed frames the region detector found nothing in
+        uint64_t requestsCoalesced; // Submit() calls answered by another request's caption
+    };
+    SceneStats GetSceneStats() const;
+
+    /**
+     * @brief True if the last DescribeScene() reused the previous description
+     */
+    bool WasLastSceneSkipped() const { return lastSceneSkipped.load(); }
+
+    /**
+     * @brief Feature cache tuning (call before DescribeScene runs; not thread-safe)
+     * @param capacity Max cached scenes (0 disables the cache)
+     * @param thresholdBits Max hash distance counted as a hit
+     */
+    void SetFeatureCacheConfig(size_t capacity, int thresholdBits);
+
+    /**
+     * @brief Replace the prompt (must contain one IMAGE_TOKEN_ID); call before Initialize
+     *
+     * <image> may sit anywhere, e.g. after chat-template text as the Python
+     * client renders it; the image features take exactly its place.
+     */
+    void SetPromptTokens(const std::vector<int64_t>& tokens) { promptTokens = tokens; }
+
+    /**
+     * @brief Ask a different question about every frame (empty: the default caption prompt)
+     *
+     * Encoded at runtime into the chat template (needs merges.txt next to
+     * the vocabulary; call after Initialize). Safe while scenes are being
+     * described: takes effect on the next one. The system prompt before
+     * <image> is unchanged, so its cached KV is kept and only the suffix
+     * after the image is re-embedded. Descriptions cached for the old
+     * question are dropped; cached image features stay.
+     * @return false if the question could not be encoded
+     */
+    bool SetPromptQuestion(const std::string& question);
+
+    /**
+     * @brief Configure decoding (default greedy); takes effect on the next scene
+     */
+    void SetSamplingConfig(const LogitsProcessor::Config& config) { logitsProcessor.Configure(config); }
+
+    /**
+     * @brief Caption length controls (call between scenes; not thread-safe)
+     *
+     * Decoding stops at EOS, at maxTokens, once the text ends with one of
+     * stopSequences (default "." and newline, i.e. after the first sentence),
+     * or when deadlineMs of wall-clock time has passed since Generate started.
+     * maxContext bounds the KV positions per sequence (see KV cache above).
+     */
+    struct GenerationConfig {
+        int maxTokens = 50;                         // Hard token budget per caption
+        int deadlineMs = 0;                         // Wall-clock budget per Generate (0: none)
+        int maxContext = 0;                         // KV positions per sequence (0: unlimited, else >= MIN_CONTEXT)
+        std::vector<std::string> stopSequences = {".", "\n"};  // Empty: EOS/budget only
+    };
+    void SetGenerationConfig(const GenerationConfig& config);
+    static constexpr int MIN_CONTEXT = 32;
+    const GenerationConfig& GetGenerationConfig() const { return generationConfig; }
+
+    /**
+     * @brief Stream a caption while it decodes (call between scenes; not thread-safe)
+     *
+     * Called on the captioning thread each time the decoded text completes
+     * another word, with the text so far shaped like the final caption (first
+     * sentence, capitalized), so a consumer can act on "Person at desk" long
+     * before the last token. The finished caption still comes back from
+     * DescribeScene(). Batched multi-stream rounds don't stream.
+     */
+    using PartialCaptionCallback = std::function<void(const std::string& partial)>;
+    void SetPartialCaptionCallback(const PartialCaptionCallback& callback) { partialCaptionCallback = callback; }
+
+    /**
+     * @brief Speculative decoding with n-gram drafts from earlier captions (default on, 4 drafts)
+     *
+     * Only used with greedy decoding (sampling needs the draft distribution);
+     * maxDraftTokens <= 0 disables it.
+     */
+    void SetSpeculativeDecoding(int maxDraftTokens) { this->maxDraftTokens = (std::max)(0, maxDraftTokens); }
+
+    /**
+     * @brief Speculation counters for the last Generate
+     */
+    struct SpeculationStats {
+        uint64_t decoderRuns;       // Decoder passes after prefill
+        uint64_t draftedTokens;     // Tokens proposed by the drafter
+        uint64_t acceptedTokens;    // Drafts the decoder agreed with
+    };
+    SpeculationStats GetLastSpeculationStats() const { return lastSpeculationStats; }
+
+    /**
+     * @brief Precompute an fp16 embedding table at Initialize (call before Initialize)
+     *
+     * Runs embed_tokens once over every vocabulary ID in batches and keeps the
+     * rows (~270MB for 151k x 896 fp16), so decode steps look up the next
+     * token's embedding instead of running the embed_tokens session per token.
+     * IDs outside the table still go through the session.
+     */
+    void SetEmbeddingTableEnabled(bool enabled) { embeddingTableEnabled = enabled; }
+
+    /**
+     * @brief Use ORT graph optimizations via cached <model>.opt.onnx files (call before Initialize)
+     *
+     * On by default. The first start optimizes each model with batch=1 and the
+     * 224x224 input pinned and serializes it next to the source model; later
+     * starts load the optimized file with no optimization cost. A model that
+     * fails to load this way falls back to the unoptimized graph. On CPU the
+     * cache is <model>.opt.ort, memory-mapped with weights used in place.
+     */
+    void SetOptimizedModelsEnabled(bool enabled) { useOptimizedModels = enabled; }
+
+    /**
+     * @brief Graph optimization level for sessions built without the cache (call before Initialize)
+     *
+     * Only used with SetOptimizedModelsEnabled(false); default ORT_DISABLE_ALL.
+     * The cache is always built at ORT_ENABLE_EXTENDED, and a failed cached
+     * load falls back to ORT_DISABLE_ALL.
+     */
+    void SetGraphOptimizationLevel(GraphOptimizationLevel level) { uncachedOptimizationLevel = level; }
+
+    /**
+     * @brief Candidate execution providers, probed in order (call before Initialize)
+     *
+     * Default {"DirectML", "OpenVINO", "CPU"}. Each model gets a session on every
+     * provider this ONNX Runtime build ships, one dummy inference is timed on
+     * each, and the fastest is kept; the choice is logged per model.
+     */
+    void SetExecutionProviders(const std::vector<std::string>& providers) { executionProviders = providers; }
+
+    /**
+     * @brief Weight precision of each model (call before Initialize)
+     *
+     * "auto" (default) times every variant's provider probe on the first start,
+     * keeps the fastest and remembers it in onnx/variants.selected.json;
+     * "ranked" loads the best variant for this CPU or GPU without timing (see
+     * ModelVariants); "fp32", "fp16", "int8", "q4" or "q4f16" asks for one
+     * precision and falls back to the ranked order where that file is missing.
+     */
+    void SetModelVariant(const std::string& variant) { modelVariant = variant; }
+    bool HasEmbeddingTable() const { return embeddingTableRows > 0; }
+
 private:
-    // ONNX Runtime components
-    std::unique_ptr<Ort::Env> ortEnv;
-    std::unique_ptr<Ort::SessionOptions> sessionOptions;
+    // ONNX Runtime components (sessions created by the shared OrtRuntime)
     std::unique_ptr<Ort::Session> visionEncoder;
     std::unique_ptr<Ort::Session> embedTokens;
     std::unique_ptr<Ort::Session> decoder;
     std::unique_ptr<Ort::MemoryInfo> memoryInfo;
+    Ort::RunOptions runOptions;                    // Shared by every Run; terminated by Cancel()
+
+    // Per-caption scratch (position ids, bound tensor handles, logits): one
+    // scope per caption, one per decoder run; used under captionMutex
+    SceneArena sceneArena;
+    int64_t decoderVocabSize;                      // Logits width; 0 when the model leaves it dynamic
+
+    // Camera streams: capture plus the scene-gate reference for that camera
+    struct CaptionStream {
+        std::unique_ptr<FrameCapture> capture;
+        uint64_t lastSceneHash = 0;                // Hash of the frame behind lastDescription
+        std::string lastDescription;
+    };
+    std::vector<CaptionStream> streams;
+    double captureFps;
+    FrameCapture::Backend captureBackend;
+    std::string captureSource;
+    std::atomic<float> lastFrameAgeMs;
+
+    // Tokenizer: vocabulary and BPE merges loaded once in Initialize
+    FastVLMTokenizer tokenizer;
+
+    // Next-token selection (greedy argmax or sampling) over the decoder logits
+    LogitsProcessor logitsProcessor;
+
+    // Streaming: partial captions at word boundaries during Generate
+    PartialCaptionCallback partialCaptionCallback;
+
+    /**
+     * @brief Feed one generated token to the stream; report the caption if it gained a word
+     * @param lastPartial Last text reported for this caption (skips repeats)
+     */
+    void StreamToken(FastVLMTokenizer::StreamDecoder& stream, int64_t token, std::string& lastPartial);
+
+    // Early exit: stop sequences, token budget and deadline
+    GenerationConfig generationConfig;
+    size_t stopTailLength;                     // Longest stop sequence (bytes of text to keep)
+    static constexpr size_t STOP_TAIL_SLACK = 32;  // Reserved past it for the token appended before trimming
 
-    // Camera
-    cv::VideoCapture camera;
+    /**
+     * @brief Early-exit check after each generated token
+     * @param token Token just generated
+     * @param generatedCount Tokens generated so far, including token
+     * @param tail Recent decoded text of this sequence (appended to, bounded)
+     * @param start When Generate started (for the deadline)
+     * @return Stop reason for the log, or nullptr to keep decoding
+     */
+    const char* CheckStopCondition(int64_t token, size_t generatedCount, std::string& tail,
+                                   std::chrono::steady_clock::time_point start) const;
+
+    // Speculative decoding: draft table, per-pass draft limit, scratch buffers
+    static constexpr int DEFAULT_DRAFT_TOKENS = 4;
+    NGramDrafter drafter;
+    int maxDraftTokens;
+    SpeculationStats lastSpeculationStats;
+    std::vector<int64_t> draftTokens;
+    std::vector<int64_t> verifyTokens;             // [last token, drafts...]
+    std::vector<float> verifyEmbeds;
+
+    // Bytes held, republished by the caption thread whenever they change and
+    // read by the MemoryAccounting reporter from the scraping thread
+    std::atomic<uint64_t> visionEncoderBytes;      // Private bytes grown by each session's load + probe
+    std::atomic<uint64_t> embedTokensBytes;
+    std::atomic<uint64_t> decoderBytes;
+    std::atomic<uint64_t> kvCacheBytes;            // KV banks and mask, prompt prefix KV + suffix embeds
+    std::atomic<uint64_t> sceneArenaBytes;
+    std::atomic<uint64_t> embeddingTableBytes;
+    std::atomic<uint64_t> featureCacheBytes;
+    uint64_t memoryReporterId;
+    void PublishMemoryUsage();
+    void PublishFeatureCacheUsage();               // Caller holds sceneMutex
+
+    bool useOptimizedModels;
+    int encoderThreads;                            // 0: vision encoder on the global pool
+    GraphOptimizationLevel uncachedOptimizationLevel;
+    std::vector<std::string> executionProviders;
+    std::unordered_map<std::string, std::string> chosenProviders;  // Model path -> probe winner
+    std::string modelVariant;                      // "auto", "ranked" or a precision name
+    ModelVariants variants;
+    std::string chosenVariants[static_cast<int>(ModelVariants::Component::Count)];  // Loaded path per model
+    static constexpr int VARIANT_PROBE_RUNS = 3;   // Timed probes per variant in "auto" mode
+
+    // Model lifetime (sessions can be unloaded while idle and reloaded on demand)
+    std::string modelDirectory;
+    bool batchedModels;                            // batch_size left dynamic for multi-stream
+    bool modelsLoaded;
+
+    /**
+     * @brief Create the three sessions, embedding table and prompt cache
+     */
+    bool LoadModels();
+
+    /**
+     * @brief Vocabulary plus LoadModels(); shared by both Initialize paths
+     */
+    bool InitializeModels(const std::string& modelPath, bool batched);
+
+    /**
+     * @brief Preprocess (unless imageFeatures is given), encode, prefill, decode
+     * @param imageFeatures Cached features to start from; filled by the encoder otherwise
+     * @return Description, empty on error (imageFeatures kept when the encoder ran)
+     */
+    std::string CaptionFrame(const cv::Mat& frame, std::vector<float>& imageFeatures);
 
-    // Tokenizer (simplified - hardcoded tokens for now)
+    /**
+     * @brief Reload after UnloadModels(); no-op when already loaded
+     */
+    bool EnsureModelsLoaded();
+
+    // Optional fp16 token embedding table (row i = embed_tokens(i))
+    bool embeddingTableEnabled;
+    std::vector<uint16_t> embeddingTable;
+    size_t embeddingTableRows;
+    std::vector<float> stepEmbeds;                 // One row, reused every decode step
+    static constexpr int EMBED_TABLE_BATCH = 2048; // IDs per embed_tokens run while building
     static constexpr int IMAGE_TOKEN_ID = 128256;  // <image> token
     static constexpr int BOS_TOKEN_ID = 128000;    // Beginning of sequence
     static constexpr int EOS_TOKEN_ID = 128001;    // End of sequence
 
     // State
     bool isInitialized;
-    float lastLatencyMs;
+    std::atomic<float> lastLatencyMs;
+    std::atomic<bool> warm;                        // WarmUp() ran on the loaded sessions
+    bool warmingUp;                                // WarmUp() in progress: no partials (captionMutex)
+    static constexpr int WARMUP_TOKENS = 4;
+
+    // Staged pipeline: encoder thread -> encodedFrames -> decoder thread
+    struct EncodedFrame {
+        uint64_t sequence;
+        uint64_t frameHash;
+        std::chrono::steady_clock::time_point start;   // When the frame was taken
+        std::vector<float> imageFeatures;
+        std::string description;                   // Set by the gate/cache: nothing to decode
+    };
+    static constexpr size_t PIPELINE_DEPTH = 1;    // Encoded frames waiting for the decoder
+    std::deque<EncodedFrame> encodedFrames;
+    bool encoderDone;
+    std::mutex pipelineMutex;                      // encodedFrames, encoderDone
+    std::condition_variable pipelineCv;
+    std::atomic<bool> pipelineRunning;
+    std::atomic<bool> pipelineStop;
+    std::atomic<int> framesInFlight;               // Sent to the decoder and not yet captioned
+    std::thread encoderThread;
+    std::thread decoderThread;
+
+    // Scene gate state and feature cache are shared by the two stages
+    std::mutex sceneMutex;
+
+    // Requests (Submit): one worker drains the queue; a request collects the
+    // promises of every caller that joined it
+    struct CaptionWaiter {
+        std::promise<Caption> promise;
+        std::chrono::steady_clock::time_point submitted;
+        bool joined;                               // Coalesced into a request someone else submitted
+        SubmitCallback callback;                   // Called outside requestMutex after the promise is set
+    };
+    struct CaptionRequest {
+        int stream;                                // -1: image request
+        cv::Mat image;
+        uint64_t imageHash = 0;
+        uint64_t capturedAtStart = 0;              // Stream's captured frame count when it started
+        std::vector<std::string> questions;        // Ask(); empty: a caption
+        std::vector<CaptionWaiter> waiters;
+    };
+    std::deque<std::shared_ptr<CaptionRequest>> requestQueue;
+    std::shared_ptr<CaptionRequest> requestInFlight;
+    bool requestStop;
+    std::mutex requestMutex;                       // requestQueue, requestInFlight, requestStop, requestThread
+    std::condition_variable requestCv;
+    std::thread requestThread;                     // Started by the first Submit
+    std::mutex captionMutex;                       // One caption (or unload) at a time across threads
+    std::atomic<uint64_t> requestsCoalesced;
+
+    /**
+     * @brief Join a matching queued/in-flight request or queue a new one (takes requestMutex)
+     */
+    std::future<Caption> EnqueueRequest(std::shared_ptr<CaptionRequest> request, SubmitCallback callback);
+    std::future<Caption> SubmitStream(int streamIndex, SubmitCallback callback);
+    std::future<Caption> SubmitImage(const cv::Mat& image, const cv::Rect& region, SubmitCallback callback);
+
+    /**
+     * @brief Worker: run requests in order until StopRequests()
+     */
+    void RunRequestWorker();
+
+    /**
+     * @brief Caption one request (takes captionMutex)
+     */
+    Caption ExecuteRequest(CaptionRequest& request);
+
+    /**
+     * @brief Ask() request: the frame's image features, then AnswerQuestions (caller holds captionMutex)
+     */
+    std::vector<std::string> ExecuteQuestions(CaptionRequest& request);
+
+    /**
+     * @brief Stop the worker; queued requests complete with an empty caption
+     */
+    void StopRequests();
+
+    /**
+     * @brief DescribeScene() for any stream (caller holds captionMutex)
+     */
+    std::string DescribeStream(CaptionStream& stream);
+
+    /**
+     * @brief Encoder stage: images in order, or stream 0 paced by intervalMs when images is null
+     */
+    void RunEncoderStage(const std::vector<cv::Mat>* images, int intervalMs);
+
+    /**
+     * @brief Decoder stage: caption queued features until the encoder is done or the pipeline stops
+     * @param gated Record captions for the scene gate and feature cache (camera frames)
+     */
+    void RunDecoderStage(const CaptionCallback& onCaption, bool gated);
+
+    /**
+     * @brief Refuse single-shot calls while the stages own the sessions
+     */
+    bool IsPipelineBusy(const char* caller) const;
+
+    // Scene-change gating
+    static constexpr int DEFAULT_SCENE_CHANGE_THRESHOLD = 6;
+    std::atomic<int> sceneChangeThreshold;
+    std::atomic<uint64_t> scenesDescribed;
+    std::atomic<uint64_t> scenesSkipped;
+    std::atomic<int> lastSceneDistance;
+    std::atomic<bool> lastSceneSkipped;
+
+    // Region-of-interest mode (EnableRegionDetection)
+    RegionDetector regionDetector;
+    std::atomic<uint64_t> scenesEmpty;
+
+    /**
+     * @brief Detect regions in frame and caption them (FastVLM skipped when none)
+     * @return Joined captions of the crops, NO_REGIONS_DESCRIPTION, or empty on error
+     */
+    std::string CaptionRegions(const cv::Mat& frame);
+
+    // Feature cache (LRU, most recent first)
+    struct FeatureCacheEntry {
+        uint64_t hash;
+        std::vector<float> imageFeatures;
+        std::string description;
+    };
+    static constexpr size_t DEFAULT_FEATURE_CACHE_CAPACITY = 16;
+    static constexpr int DEFAULT_FEATURE_CACHE_THRESHOLD = 4;
+    std::list<FeatureCacheEntry> featureCache;
+    size_t featureCacheCapacity;
+    int featureCacheThreshold;
+    std::atomic<uint64_t> featureCacheHits;
+    std::atomic<uint64_t> featureCacheMisses;
+
+    /**
+     * @brief Closest cached scene within featureCacheThreshold, moved to the front
+     * @return Entry pointer (valid until the next cache insert) or nullptr on miss
+     */
+    FeatureCacheEntry* LookupFeatureCache(uint64_t hash);
+
+    /**
+     * @brief Insert or refresh the entry for hash, evicting the least recently used
+     */
+    void StoreFeatureCache(uint64_t hash, const std::vector<float>& imageFeatures, const std::string& description);
+
+    /**
+     * @brief 64-bit difference hash: 9x8 grayscale thumbnail, one bit per horizontal gradient
+     */
+    static uint64_t ComputeFrameHash(const cv::Mat& frame);
+
+    /**
+     * @brief Take the stream's freshest frame and hash it
+     * @return Frame (valid until the stream's next acquire) or nullptr on failure
+     */
+    const FrameCapture::Frame* AcquireStreamFrame(CaptionStream& stream, uint64_t& frameHash);
+
+    /**
+     * @brief Scene gate + feature cache for one frame
+     * @param description Set when the encoder and decoder can be skipped entirely
+     * @param imageFeatures Filled from the cache when only the encoder can be skipped
+     * @return true if description was answered from the gate or cache
+     */
+    bool ReuseCachedScene(CaptionStream& stream, uint64_t frameHash,
+                          std::string& description, std::vector<float>& imageFeatures);
+
+    /**
+     * @brief Floats BuildInputEmbeds() writes for featureCount floats of image features
+     */
+    size_t InputEmbedsSize(size_t featureCount) const;
+
+    /**
+     * @brief Prompt embeddings around imageFeatures (prefix omitted when KV-cached)
+     * @param out Destination, InputEmbedsSize(featureCount) floats (e.g. a slot of decoderInput)
+     * @param cachedPrefix Set to the number of positions restored from promptPrefixKV
+     * @return false on error
+     */
+    bool BuildInputEmbeds(const float* imageFeatures, size_t featureCount, float* out, int& cachedPrefix);
+
+    // Decoder prefill input, reused across scenes (one slot per sequence when batched)
+    std::vector<float> decoderInput;
+
+    /**
+     * @brief Remember a fresh description for the stream's gate and the feature cache
+     */
+    void RecordDescription(CaptionStream& stream, uint64_t frameHash,
+                           const std::vector<float>& imageFeatures, const std::string& description);
 
     // Model constants
     static constexpr int NUM_LAYERS = 24;          // Decoder layers (for KV cache)
@@ -78,47 +881,283 @@ private:
     static constexpr int NUM_HEADS = 14;           // Attention heads
     static constexpr int HEAD_DIM = 64;            // Head dimension
 
+    // KV cache: two banks of per-layer K/V buffers sized for kvCapacity tokens.
+    // Each decoder step reads past_key_values.* from one bank while ORT writes
+    // present.* straight into the other (bound via IoBinding); the banks then
+    // swap roles, so nothing is copied between steps and the footprint is fixed.
+    // With a batch, each buffer is [B, H, S, D]: caption b owns the contiguous
+    // H*S*D block at b*H*S*D (its KV slot). Elements are kvElementBytes wide
+    // (fp32, or fp16 when the decoder takes half KV), so the buffers are raw bytes
+    std::vector<uint8_t> kvBanks[2][NUM_LAYERS * 2];
+    ONNXTensorElementDataType kvElementType;       // Of past_key_values.*, read when the decoder loads
+    size_t kvElementBytes;
+    size_t kvCapacity;                             // Tokens each slot can hold
+    size_t kvBatchCapacity;                        // Slots each buffer can hold
+    std::vector<std::string> kvInputNames;         // past_key_values.{L}.key/value
+    std::vector<std::string> kvOutputNames;        // present.{L}.key/value
+    std::vector<int64_t> attentionMask;            // All ones, kvBatchCapacity * kvCapacity long
+
+    // Prompt cache: [prefix][<image> -> image features][suffix]
+    std::vector<int64_t> promptTokens;
+    bool promptCacheReady;
+    int promptPrefixLength;                        // Tokens before <image> (KV cached)
+    std::vector<uint8_t> promptPrefixKV[NUM_LAYERS * 2];  // NUM_HEADS x prefix x HEAD_DIM each, kvElementBytes wide
+    std::vector<float> promptSuffixEmbeds;         // Embeddings of tokens after <image>
+    std::vector<int64_t> promptPrefixTokens;       // Tokens behind promptPrefixKV
+
+    /**
+     * @brief Embed the constant prompt text and prefill the prefix KV
+     * A prefix equal to the one already prefilled is kept; only the suffix is re-embedded.
+     * @return true if the cache is usable (otherwise the full prompt is embedded per scene)
+     */
+    bool PreparePromptCache();
+
+    /**
+     * @brief Run embed_tokens over tokens
+     * @return Embeddings (tokens.size() x HIDDEN_SIZE), empty on error
+     */
+    std::vector<float> EmbedTokenIds(const std::vector<int64_t>& tokens);
+
+    /**
+     * @brief Fill embeddingTable by running embed_tokens over IDs [0, rows)
+     * @return true if the table was built
+     */
+    bool BuildEmbeddingTable(size_t rows);
+
+    /**
+     * @brief Embedding for one token into stepEmbeds (table lookup, else embed_tokens)
+     * @return Pointer to HIDDEN_SIZE floats, valid until the next call
+     */
+    const float* EmbedSingleToken(int64_t tokenId);
+
+    /**
+     * @brief Grow both KV banks (and the attention mask) to hold `batch` slots of `tokens` positions
+     */
+    void EnsureKVCapacity(size_t tokens, size_t batch = 1);
+
+    /**
+     * @brief Element type a decoder session expects for past_key_values.* (float or float16)
+     */
+    ONNXTensorElementDataType KVElementType(Ort::Session& session) const;
+
+    /**
+     * @brief Run one decoder pass over bound buffers
+     * @param binding Reusable IoBinding for the decoder session
+     * @param embeds Input embeddings (numTokens x HIDDEN_SIZE)
+     * @param numTokens Number of new positions in this pass
+     * @param pastLength Positions already held in kvBanks[pastBank]
+     * @param pastBank Bank holding the past KV; present is written to the other bank
+     * @param history Tokens generated so far (repetition penalty)
+     * @param positionOffset Positions evicted or truncated before the KV (position ids start past them)
+     * @return Token selected by logitsProcessor for the last position
+     */
+    int64_t RunDecoderStep(Ort::IoBinding& binding, const float* embeds, int numTokens,
+                           int pastLength, int pastBank, const std::vector<int64_t>& history,
+                           int positionOffset = 0);
+
+    /**
+     * @brief Batched RunDecoderStep: every sequence has the same pastLength and numTokens
+     * @param embeds Input embeddings (batchSize x numTokens x HIDDEN_SIZE)
+     * @param histories Per-sequence generated tokens (repetition penalty)
+     * @param tokensOut Receives one selected token per sequence
+     */
+    void RunDecoderBatch(Ort::IoBinding& binding, const float* embeds, int batchSize, int numTokens,
+                         int pastLength, int pastBank, const std::vector<int64_t>* const* histories,
+                         int64_t* tokensOut, int positionOffset = 0);
+
+    /**
+     * @brief Bind and run one decoder pass; token selection is left to the caller
+     * @return Logits (batchSize x numTokens x vocab), in sceneArena when the decoder's
+     *         vocabulary size is fixed (valid until the caller's scope rewinds), else ORT-allocated
+     */
+    Ort::Value RunDecoder(Ort::IoBinding& binding, const float* embeds, int batchSize, int numTokens,
+                          int pastLength, int pastBank, int positionOffset = 0);
+
+    /**
+     * @brief Keep the first keepLength positions of a [1, H, length, D] bank, repacked as [1, H, keepLength, D]
+     */
+    void TruncateKV(int bank, int length, int keepLength);
+
+    /**
+     * @brief Embeddings for several tokens (table rows, else one embed_tokens run)
+     */
+    bool EmbedTokensInto(const std::vector<int64_t>& tokens, std::vector<float>& out);
+
+    /**
+     * @brief Embeddings for count tokens written to out (table rows, else embed_tokens into out)
+     */
+    bool EmbedTokensTo(const int64_t* tokens, size_t count, float* out);
+
+    /**
+     * @brief Drop KV slot `slot` from a [batch, H, length, D] bank, shifting later slots down
+     */
+    void RemoveKVSlot(int bank, int slot, int batch, int length);
+
+    /**
+     * @brief Drop positions [start, start + count) from every slot of a [batch, H, length, D] bank,
+     *        repacked as [batch, H, length - count, D] (the maxContext sliding window)
+     */
+    void EvictKV(int bank, int batch, int length, int start, int count);
+
+    /**
+     * @brief Copy slot 0 of a [1, H, length, D] bank into slots 1..copies-1 ([copies, H, length, D])
+     */
+    void ForkKVSlot(int bank, int copies, int length);
+
+    /**
+     * @brief Copy promptPrefixKV into the first `batch` slots of a bank, minus its first `drop` positions
+     */
+    void RestorePromptPrefix(int bank, size_t batch, int drop);
+
+    /**
+     * @brief Positions to drop from the front of a prompt under maxContext (0: it fits)
+     * @param promptLength Cached prefix + prefill positions
+     */
+    int ContextOverflow(int promptLength) const;
+
+    // Preprocessing: reused resize target, pixel tensor and per-channel lookup
+    // tables mapping a uint8 value straight to its normalized float
+    static constexpr int IMAGE_SIZE = 224;
+    cv::Mat resizedFrame;
+    cv::Mat convertedFrame;                        // Only for non-BGR8 input
+    std::vector<float> pixelValues;                // (B, 3, 224, 224) for batched encoder runs
+    float normalizeLut[3][256];                    // RGB plane order
+
+    // Single-image encoder runs go through IoBinding: the input and output
+    // tensors wrap these buffers for the session's lifetime, so a frame is
+    // preprocessed straight into the bound input and its features are read
+    // in place from the bound output
+    std::vector<float> encoderInput;               // (1, 3, 224, 224)
+    std::vector<float> encoderOutput;              // (1, 16, 896)
+    std::unique_ptr<Ort::IoBinding> encoderBinding;
+
+    /**
+     * @brief Bind encoderInput/encoderOutput to the vision encoder (after it loads)
+     * @return false if binding failed (single images then go through RunVisionEncoder)
+     */
+    bool BindVisionEncoder();
+
+    /**
+     * @brief Encode the image already preprocessed into encoderInput
+     * @return encoderOutput.data() (encoderOutput.size() floats), nullptr on error
+     */
+    const float* RunBoundVisionEncoder();
+
     /**
      * @brief Preprocess camera frame for vision encoder
-     * @param frame Input BGR frame from camera
-     * @param output Output float tensor (1, 3, 224, 224)
+     *
+     * One fused pass after the resize: BGR->RGB, /255, ImageNet mean/std and
+     * HWC->CHW, via a 256-entry table per channel. No per-frame allocations
+     * once the member buffers exist. BGRA input is read in place (alpha
+     * skipped), and a frame already 224x224 skips the resize.
+     * @param frame Input BGR or BGRA frame from camera
+     * @param output Output float tensor (B, 3, 224, 224), grown to fit
+     * @param batchIndex Image slot in output to write
      */
-    void PreprocessImage(const cv::Mat& frame, std::vector<float>& output);
+    void PreprocessImage(const cv::Mat& frame, std::vector<float>& output, size_t batchIndex = 0);
+    friend struct PerfMicro;            // perf_micro times PreprocessImage
 
     /**
-     * @brief Run vision encoder on preprocessed image
-     * @param imageData Preprocessed image (1, 3, 224, 224)
-     * @return Image features (1, 16, 896)
+     * @brief Run vision encoder on preprocessed images
+     * @param imageData Preprocessed images (B, 3, 224, 224)
+     * @param batchSize Number of images B
+     * @return Image features (B, 16, 896)
      */
-    std::vector<float> RunVisionEncoder(const std::vector<float>& imageData);
+    std::vector<float> RunVisionEncoder(const std::vector<float>& imageData, int batchSize = 1);
 
     /**
-     * @brief Embed tokens and combine with image features
-     * @param tokens Pre-tokenized prompt tokens
-     * @param imageFeatures Image features from vision encoder
-     * @return Combined embeddings (image + text)
+     * @brief Embed tokens with image features in place of the <image> token
+     *
+     * Text before and after <image> is embedded straight into its slot of out
+     * and the features are copied once into theirs; no intermediate buffers.
+     * @param tokens Pre-tokenized prompt tokens, <image> anywhere
+     * @param imageFeatures Image features from vision encoder (read in place)
+     * @param featureCount Number of floats at imageFeatures
+     * @param out Destination, (tokens.size() - 1) * HIDDEN_SIZE + featureCount floats
+     * @return false on error
      */
-    std::vector<float> TokenizeAndEmbed(const std::vector<int64_t>& tokens, const std::vector<float>& imageFeatures);
+    bool TokenizeAndEmbed(const std::vector<int64_t>& tokens, const float* imageFeatures, size_t featureCount,
+                          float* out);
 
     /**
      * @brief Run decoder to generate text
-     * @param inputEmbeds Combined text + image embeddings
+     * @param inputEmbeds Combined text + image embeddings (after any cached prefix)
      * @param maxTokens Maximum tokens to generate
+     * @param cachedPrefixLength Positions restored from promptPrefixKV before prefill
      * @return Generated token IDs
      */
-    std::vector<int64_t> Generate(const std::vector<float>& inputEmbeds, int maxTokens = 50);
+    std::vector<int64_t> Generate(const std::vector<float>& inputEmbeds, int maxTokens = 50,
+                                  int cachedPrefixLength = 0);
+
+    /**
+     * @brief Generate for several sequences at once, one KV slot each
+     * @param inputEmbeds Embeddings of every sequence back to back, all the same length
+     * @param batch Number of sequences
+     * @param maxTokens Maximum tokens per sequence
+     * @param cachedPrefixLength Positions restored from promptPrefixKV into every slot
+     * @return Generated token IDs per sequence (empty on error)
+     */
+    std::vector<std::vector<int64_t>> GenerateBatch(const std::vector<float>& inputEmbeds, size_t batch,
+                                                    int maxTokens = 50, int cachedPrefixLength = 0);
 
     /**
-     * @brief Decode token IDs to text (simplified)
+     * @brief Decode steps of a batched generation after its prefill, until every sequence finishes
+     * @param pastBank Bank the prefill wrote; slot k holds sequence k
+     * @param currentPos Positions each slot holds
+     * @param sink Positions the maxContext window never evicts (the prompt)
+     * @param firstTokens Token the prefill selected for each sequence
+     * @param forced Per sequence, prompt tokens still to feed before its own tokens count (nullptr: none)
+     * @param generated One (empty) vector per sequence; receives its tokens
+     * @return Decode steps run
+     */
+    int DecodeBatch(Ort::IoBinding& binding, int pastBank, int currentPos, int sink, int positionOffset,
+                    const int64_t* firstTokens, const std::vector<std::vector<int64_t>>* forced, int maxTokens,
+                    std::chrono::steady_clock::time_point startTime, std::vector<std::vector<int64_t>>& generated);
+
+    /**
+     * @brief Answer questions about one image from its features (see Ask)
+     * @return One answer per question (empty on error)
+     */
+    std::vector<std::string> AnswerQuestions(const float* imageFeatures, size_t featureCount,
+                                             const std::vector<std::string>& questions);
+
+    /**
+     * @brief Decode token IDs to a caption (first sentence, trimmed, capitalized)
      * @param tokenIds Generated token IDs
      * @return Decoded text
      */
     std::string DecodeTokens(const std::vector<int64_t>& tokenIds);
 
+    /**
+     * @brief Caption shaping shared by final and partial captions
+     * @return First sentence of text, trimmed, no trailing period, first letter capitalized
+     */
+    static std::string ShapeCaption(std::string text);
+
     /**
      * @brief Load ONNX model
      * @param modelPath Path to .onnx file
+     * @param dimensionOverrides Symbolic dims pinned for the optimized graph (e.g. batch_size=1)
+     * @param benchmark Dummy inference timed to pick the execution provider
+     * @param privateThreads Own intra-op pool of this size instead of the global one (0: global)
      * @return ONNX session
      */
-    std::unique_ptr<Ort::Session> LoadOnnxModel(const std::string& modelPath);
+    std::unique_ptr<Ort::Session> LoadOnnxModel(const std::string& modelPath,
+        const std::vector<std::pair<std::string, int64_t>>& dimensionOverrides,
+        const std::function<void(Ort::Session&)>& benchmark, int privateThreads = 0);
+
+    /**
+     * @brief Load one model in the weight precision SetModelVariant() asks for
+     *
+     * Tries the candidates best first until one loads; a reload after
+     * UnloadModels() goes straight to the variant loaded before.
+     */
+    std::unique_ptr<Ort::Session> LoadModelVariant(ModelVariants::Component component,
+        const std::vector<std::pair<std::string, int64_t>>& dimensionOverrides,
+        const std::function<void(Ort::Session&)>& benchmark, int privateThreads = 0);
+
+    // Provider probes: one representative run of each model on zero inputs
+    void BenchmarkVisionEncoder(Ort::Session& session);
+    void BenchmarkEmbedTokens(Ort::Session& session);
+    void BenchmarkDecoder(Ort::Session& session);
 };
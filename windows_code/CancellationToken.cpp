@@ -0,0 +1,50 @@
+#include "CancellationToken.h"
+#include <chrono>
+#include <vector>
+
+void CancellationToken::Cancel() {
+    std::vector<Callback> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cancelled.exchange(true)) {
+            return;
+        }
+        for (auto& entry : callbacks) {
+            pending.push_back(std::move(entry.second));
+        }
+        callbacks.clear();
+    }
+    wake.notify_all();
+    for (const Callback& callback : pending) {
+        callback();
+    }
+}
+
+uint64_t CancellationToken::OnCancel(Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!cancelled.load()) {
+            uint64_t id = nextId++;
+            callbacks.emplace(id, std::move(callback));
+            return id;
+        }
+    }
+    callback();
+    return 0;
+}
+
+void CancellationToken::Remove(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    callbacks.erase(id);
+}
+
+bool CancellationToken::WaitFor(int64_t ms) const {
+    std::unique_lock<std::mutex> lock(mutex);
+    return wake.wait_for(lock, std::chrono::milliseconds(ms), [this]() { return cancelled.load(); });
+}
+
+void CancellationToken::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = false;
+    callbacks.clear();
+}
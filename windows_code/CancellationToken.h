@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+/**
+ * CancellationToken - One cooperative "stop now" shared by a host and its workers
+ *
+ * Shutdown used to be a flag the loops polled once per sleep, and whatever
+ * was blocked (a whisper decode, an ORT Run, a caption future) finished its
+ * work before anything noticed. A token is cancelled once; at that moment
+ * it runs the callbacks registered on it, which is where each blocking
+ * call gets its own way out: whisper's abort callback, ORT's
+ * RunOptions::SetTerminate, llama.cpp's abort callback. Loops that sleep
+ * between passes WaitFor() on the token instead, so they leave at once.
+ *
+ * Usage:
+ *   CancellationToken token;
+ *   uint64_t id = token.OnCancel([&] { engine.Cancel(); });   // At once if already cancelled
+ *   while (!token.WaitFor(1000)) { ... }
+ *   token.Cancel();                                           // From the stopping thread
+ *   token.Remove(id);                                         // Before `engine` goes away
+ *
+ * Callbacks run on the thread that calls Cancel(), outside the token's
+ * lock, so they may block briefly but must not wait on a thread that is
+ * itself registering or removing. Thread-safe.
+ */
+class CancellationToken {
+public:
+    using Callback = std::function<void()>;
+
+    CancellationToken() = default;
+
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    /**
+     * @brief Cancel and run every registered callback (once; later calls do nothing)
+     */
+    void Cancel();
+
+    bool IsCancelled() const { return cancelled.load(); }
+
+    /**
+     * @brief Run `callback` at Cancel(); runs it now (returning 0) when already cancelled
+     * @return Id for Remove()
+     */
+    uint64_t OnCancel(Callback callback);
+
+    /**
+     * @brief Forget a callback that hasn't run yet
+     */
+    void Remove(uint64_t id);
+
+    /**
+     * @brief Sleep up to `ms`
+     * @return true when cancelled (before or during the wait)
+     */
+    bool WaitFor(int64_t ms) const;
+
+    /**
+     * @brief Back to not cancelled, with no callbacks (a host started again)
+     */
+    void Reset();
+
+private:
+    std::atomic<bool> cancelled{false};
+    mutable std::mutex mutex;
+    mutable std::condition_variable wake;
+    std::map<uint64_t, Callback> callbacks;
+    uint64_t nextId = 1;
+};
@@ -0,0 +1,56 @@
+#include "CaptionDeduplicator.h"
+#include "Log.h"
+#include "SentenceEmbedder.h"
+
+CaptionDeduplicator::CaptionDeduplicator(SentenceEmbedder& embedder)
+    : embedder(embedder)
+    , threshold(DEFAULT_THRESHOLD)
+    , suppressed(0)
+    , lastHeld(false)
+{
+}
+
+bool CaptionDeduplicator::Deduplicate(std::string& caption) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // The same raw caption again (a gate reuse): same answer, no model run
+    if (!lastInput.empty() && caption == lastInput) {
+        if (lastHeld) {
+            caption = kept;
+        }
+        return lastHeld;
+    }
+    lastInput = caption;
+    lastHeld = false;
+
+    const float limit = threshold.load();
+    if (limit >= 1.0f || !embedder.Embed(caption, embedding)) {
+        kept = caption;
+        keptEmbedding.clear();
+        return false;
+    }
+    if (keptEmbedding.size() == embedding.size()) {
+        float similarity = 0.0f;
+        for (size_t i = 0; i < embedding.size(); ++i) {
+            similarity += keptEmbedding[i] * embedding[i];
+        }
+        if (similarity >= limit) {
+            suppressed++;
+            lastHeld = true;
+            LOG_DEBUG("CaptionDeduplicator", "Held back \"" << caption << "\" (similarity "
+                      << similarity << " to \"" << kept << "\")");
+            caption = kept;
+            return true;
+        }
+    }
+    kept = caption;
+    keptEmbedding.swap(embedding);
+    return false;
+}
+
+void CaptionDeduplicator::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    lastInput.clear();
+    lastHeld = false;
+    kept.clear();
+    keptEmbedding.clear();
+}
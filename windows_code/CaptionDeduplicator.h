@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class SentenceEmbedder;
+
+/**
+ * CaptionDeduplicator - Holds back captions that say what the last one said
+ *
+ * FastVLM words the same scene differently from one pass to the next ("A man
+ * sitting at a desk" / "A person sits at a desk with a laptop"). The scene
+ * gate only catches unchanged pixels; each rewording still lands in the
+ * context as a new camera event, bumps its version and fills the history.
+ * Each caption is embedded (SentenceEmbedder) and compared with the last one
+ * kept: at or above the similarity threshold the caption is replaced by the
+ * kept one, which the collector then sees as unchanged.
+ *
+ * The comparison is against the caption kept, not the one before: a scene
+ * drifting slowly still produces a new caption once it has drifted far
+ * enough. A caption identical to the previous input gets the previous
+ * decision without running the model (gate reuses repeat the raw caption).
+ * Without a working embedder every caption is kept.
+ *
+ * Threading: Deduplicate() serializes on a private mutex.
+ *
+ * Usage:
+ *   CaptionDeduplicator dedup(embedder);
+ *   dedup.SetThreshold(0.9f);
+ *   std::string text = caption.description;
+ *   bool held = dedup.Deduplicate(text);        // text: the caption to publish
+ */
+class CaptionDeduplicator {
+public:
+    static constexpr float DEFAULT_THRESHOLD = 0.9f;
+
+    // embedder must outlive this
+    explicit CaptionDeduplicator(SentenceEmbedder& embedder);
+
+    CaptionDeduplicator(const CaptionDeduplicator&) = delete;
+    CaptionDeduplicator& operator=(const CaptionDeduplicator&) = delete;
+
+    // Cosine similarity at which a caption counts as unchanged; 1 keeps every caption
+    void SetThreshold(float similarity) { threshold.store(similarity); }
+
+    /**
+     * @brief Replace caption with the last caption kept when it says the same thing
+     * @return true when replaced (publish it as reused); false when caption is
+     *         the new reference
+     */
+    bool Deduplicate(std::string& caption);
+
+    // Forget the kept caption (after a new question)
+    void Reset();
+
+    uint64_t GetSuppressedCount() const { return suppressed.load(); }
+
+private:
+    SentenceEmbedder& embedder;
+    std::atomic<float> threshold;
+    std::atomic<uint64_t> suppressed;
+
+    std::mutex mutex;                   // Everything below
+    std::string lastInput;
+    bool lastHeld;
+    std::string kept;
+    std::vector<float> keptEmbedding;   // Unit length; empty: nothing kept yet
+    std::vector<float> embedding;       // Scratch
+};
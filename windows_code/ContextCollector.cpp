@@ -1,268 +1,928 @@
 #include "ContextCollector.h"
+#include "ContextFusion.h"
+#include "CpuSampler.h"
+#include "EventBus.h"
+#include "SystemCounters.h"
+#include "PipelineLatency.h"
+#include "PowerPolicy.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "MessagePack.h"
+#include "NetworkState.h"
+#include "StartupTimeline.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include "Watchdog.h"
+#include <algorithm>
 #include <thread>
 #include <atomic>
 #include <iomanip>
 #include <sstream>
 #include <vector>
 
-static std::atomic<bool> updateThreadRunning{false};
-static std::thread updateThread;
-static std::atomic<bool> activeAppMonitoringInitialized{false};
+// Window monitoring (WindowsAPIs) and NetworkState are process-wide; the
+// first collector starts them and the last one stops them
+static std::mutex monitoringMutex;
+static int monitoringUsers = 0;
 
 ContextCollector::ContextCollector()
-    : latestCameraLatency(0.0f)
-    , latestVoiceLatency(0.0f)
-    , latestContextUpdateLatency(0.0f)
+    : stateVersion(0)
+    , documentVersion(0)
+    , sources{
+          {"app", APP_FALLBACK_TTL_MS, 5.0},
+          {"power", 30 * 1000, 5.0},
+          {"cpu", 1000, 5.0},
+          {"memory", 2000, 2.0},
+          {"network", 10 * 1000, 20.0},
+          {"location", 10 * 1000, 1.0},     // Cache read: the tracker pushes fixes
+      }
+    , lastAppGeneration(0)
+    , lastNetworkGeneration(0)
+    , lastPowerGeneration(0)
+    , lastReaderMs(0)
+    , fusionDemandMs(0)
+    , refreshScale(1)
+    , updateThreadRunning(false)
+    , refreshRequested(false)
+    , sampleRequested(false)
 {
-    lastUpdate = std::chrono::steady_clock::now() - std::chrono::seconds(2);
+    for (auto& demand : sourceDemandMs) {
+        demand = 0;
+    }
+    {
+        StartupTimeline::Span span("active_app_monitoring");
+        std::lock_guard<std::mutex> lock(monitoringMutex);
+        if (monitoringUsers++ == 0) {
+            if (!WindowsAPIs::InitializeActiveAppMonitoring()) {
+                LOG_WARNING("ContextCollector", "Active app monitoring unavailable");
+            }
+            NetworkState::Instance().Start();
+        }
+    }
+
+    memoryReporterId = MemoryAccounting::Instance().Register([this](MemoryAccounting::Entries& entries) {
+        // Retained versions plus the live snapshot when it isn't one of them
+        // (an unchanged rebuild shares its predecessor's encodings)
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        uint64_t documentBytes = 0;
+        uint64_t encodedBytes = 0;
+        const Snapshot::EncodedBodies* lastEncoded = nullptr;
+        auto add = [&](const Snapshot& document) {
+            documentBytes += document.serialized.capacity() +
+                             document.members.capacity() * sizeof(document.members[0]);
+            if (document.encoded && document.encoded.get() != lastEncoded) {
+                encodedBytes += document.encoded->bytes.load();
+                lastEncoded = document.encoded.get();
+            }
+        };
+        bool currentRetained = false;
+        {
+            std::lock_guard<std::mutex> lock(documentMutex);
+            for (const auto& document : documentHistory) {
+                add(*document);
+                currentRetained = currentRetained || document == current;
+            }
+        }
+        if (current && !currentRetained) {
+            add(*current);
+        }
+        entries.push_back({ "context_json", "documents", documentBytes });
+        entries.push_back({ "context_json", "encoded", encodedBytes });
+        entries.push_back({ "history", "samples_events", history.GetMemoryUsage() });
+    });
+}
 
-    // Initialize active app monitoring
-    if (!activeAppMonitoringInitialized.load()) {
-        if (WindowsAPIs::InitializeActiveAppMonitoring()) {
-            activeAppMonitoringInitialized.store(true);
+int64_t ContextCollector::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ContextCollector::NoteReader() {
+    int64_t now = NowMs();
+    lastReaderMs = now;
+    fusionDemandMs = now;
+    bool woke = false;
+    for (auto& demand : sourceDemandMs) {
+        woke |= now - demand.exchange(now) > DEMAND_WINDOW_MS;
+    }
+    if (woke) {
+        // Sources were idle: have the sampler refresh them now
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            sampleRequested = true;
         }
+        stateChanged.notify_all();
     }
 }
 
-bool ContextCollector::ShouldUpdateCache() {
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - lastUpdate);
-    return elapsed.count() >= 1; // Update every 1 second
+void ContextCollector::NoteReader(const std::vector<std::string_view>& fields) {
+    int64_t now = NowMs();
+    lastReaderMs = now;
+    bool woke = false;
+    for (std::string_view field : fields) {
+        SourceId id;
+        if (FindFieldSource(field, id)) {
+            woke |= now - sourceDemandMs[static_cast<size_t>(id)].exchange(now) > DEMAND_WINDOW_MS;
+        } else if (field == "fusedContext") {
+            fusionDemandMs = now;
+        }
+    }
+    if (woke) {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            sampleRequested = true;
+        }
+        stateChanged.notify_all();
+    }
 }
 
-void ContextCollector::UpdateCache() {
-    auto startTime = std::chrono::high_resolution_clock::now();
+// The probe source behind a top-level field; false for producer fields
+// (voice, camera, sensors, ...), which cost nothing to keep current
+bool ContextCollector::FindFieldSource(std::string_view field, SourceId& id) {
+    static const std::pair<const char*, SourceId> FIELDS[] = {
+        { "activeApp", SourceId::App },
+        { "activeAppCategory", SourceId::App },
+        { "RecentPeriodActiveApps", SourceId::App },
+        { "appDwellSeconds", SourceId::App },
+        { "battery", SourceId::Power },
+        { "isCharging", SourceId::Power },
+        { "cpuUsage", SourceId::Cpu },
+        { "cpuCoreUsage", SourceId::Cpu },
+        { "diskUsage", SourceId::Cpu },
+        { "gpuUsage", SourceId::Cpu },
+        { "memoryUsage", SourceId::Memory },
+        { "memoryUsedGB", SourceId::Memory },
+        { "totalMemoryGB", SourceId::Memory },
+        { "networkConnected", SourceId::Network },
+        { "networkType", SourceId::Network },
+        { "locationLat", SourceId::Location },
+        { "locationLon", SourceId::Location },
+        { "locationAccuracyMeters", SourceId::Location },
+        { "locationTimestamp", SourceId::Location },
+        { "locationValid", SourceId::Location },
+    };
+    for (const auto& entry : FIELDS) {
+        if (field == entry.first) {
+            id = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Collect all context data (BEFORE locking cacheMutex to avoid deadlock)
-    auto activeApp = WindowsAPIs::GetForegroundAppName();
-    auto battery = WindowsAPIs::GetBatteryPercentage();
-    auto isCharging = WindowsAPIs::IsCharging();
-    
-    // Collect system performance data
-    auto cpuUsage = WindowsAPIs::GetCPUUsage();          // CPUʹ�ðٷֱ�
-    auto memoryUsage = WindowsAPIs::GetMemoryUsage();    // �ڴ�ʹ�ðٷֱ�
-    auto memoryUsed = WindowsAPIs::GetMemoryUsed();      // �����ڴ�GB
-    auto totalMemory = WindowsAPIs::GetTotalMemory();    // ���ڴ�GB
-    
-    auto networkConnected = WindowsAPIs::IsNetworkConnected();
-    auto networkType = WindowsAPIs::GetNetworkType();
-    auto location = WindowsAPIs::GetLocation();
-    auto timestamp = WindowsAPIs::GetCurrentTimestamp();
-    
-    // Get recent active apps list
-    auto recentApps = WindowsAPIs::GetRecentPeriodActiveAppList();
+// ============================================================================
+// System Sources
+// ============================================================================
 
-    // Lock cacheMutex for the entire JSON building process
-    std::lock_guard<std::mutex> lock(cacheMutex);
+bool ContextCollector::UpdateCache() {
+    TRACE_ZONE("ContextCollector::UpdateCache");
+    int64_t now = NowMs();
+    uint64_t appGeneration = WindowsAPIs::GetActiveAppGeneration();
+    uint64_t networkGeneration = NetworkState::Instance().GetGeneration();
+    const PowerPolicy* power = powerPolicy.load();
+    uint64_t powerGeneration = power ? power->GetStateGeneration() : 0;
 
-    // Clear and rebuild the context
-    cachedContext = Json();
-
-    // Build JSON response
-    cachedContext.set("activeApp", activeApp);
-    cachedContext.set("battery", battery);
-    cachedContext.set("isCharging", isCharging);
-    
-    // Add system performance data with proper formatting
-    if (cpuUsage >= 0) {
-        std::ostringstream cpuStream;
-        cpuStream << std::fixed << std::setprecision(2) << cpuUsage;
-        cachedContext.setRaw("cpuUsage", cpuStream.str());
-    } else {
-        cachedContext.setRaw("cpuUsage", "null");
-    }
-    
-    // memoryUsage �ڴ�ʹ�ðٷֱ�
-    if (memoryUsage >= 0) {
-        std::ostringstream memPercentStream;
-        memPercentStream << std::fixed << std::setprecision(2) << memoryUsage;
-        cachedContext.setRaw("memoryUsage", memPercentStream.str());
-    } else {
-        cachedContext.setRaw("memoryUsage", "null");
-    }
-    
-    // memoryUsed ��GBΪ��λ
-    if (memoryUsed >= 0) {
-        std::ostringstream memUsedStream;
-        memUsedStream << std::fixed << std::setprecision(2) << memoryUsed;
-        cachedContext.setRaw("memoryUsedGB", memUsedStream.str());
-    } else {
-        cachedContext.setRaw("memoryUsedGB", "null");
-    }
-    
-    // totalMemory ��GBΪ��λ
-    if (totalMemory >= 0) {
-        std::ostringstream totalMemStream;
-        totalMemStream << std::fixed << std::setprecision(2) << totalMemory;
-        cachedContext.setRaw("totalMemoryGB", totalMemStream.str());
-    } else {
-        cachedContext.setRaw("totalMemoryGB", "null");
-    }
-    
-    cachedContext.set("networkConnected", networkConnected);
-    cachedContext.set("networkType", networkType);
-    
-    // ��ȷ����WinRT location����
-    if (location.valid && location.latitude != 0.0 && location.longitude != 0.0) {
-        // ��Ч��GPS����
-        std::ostringstream latStream, lonStream;
-        latStream << std::fixed << std::setprecision(8) << location.latitude;
-        lonStream << std::fixed << std::setprecision(8) << location.longitude;
-        cachedContext.setRaw("locationLat", latStream.str());
-        cachedContext.setRaw("locationLon", lonStream.str());
-        cachedContext.setRaw("locationValid", "true");
-    } else {
-        // ��Ч���޷���ȡλ��
-        cachedContext.setRaw("locationLat", "null");
-        cachedContext.setRaw("locationLon", "null");
-        cachedContext.setRaw("locationValid", "false");
-    }
-    
-    // Add recent active apps to JSON as a properly formatted array
-    std::ostringstream recentAppsStream;
-    recentAppsStream << "[";
-    bool firstApp = true;
-    for (const auto& record : recentApps) {
-        if (!firstApp) {
-            recentAppsStream << ",";
-        }
-        
-        // Format timestamp as ISO string (using local time)
-        auto time_t_val = std::chrono::system_clock::to_time_t(record.timestamp);
-        struct tm timeinfo;
-        std::string timestampStr = "1970-01-01T00:00:00.000+00:00";
-        if (localtime_s(&timeinfo, &time_t_val) == 0) {
-            std::ostringstream timeStream;
-            timeStream << std::put_time(&timeinfo, "%Y-%m-%dT%H:%M:%S");
-            timeStream << ".000";
-            
-            // Add timezone offset
-            char tz_offset[16];
-            strftime(tz_offset, sizeof(tz_offset), "%z", &timeinfo);
-            std::string tz_str(tz_offset);
-            if (tz_str.length() >= 5) {
-                // Convert +0800 to +08:00 format
-                tz_str = tz_str.substr(0, 3) + ":" + tz_str.substr(3);
+    SystemContext fields;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        fields = systemContext;
+    }
+
+    // Collect outside cacheMutex: probes can take a while
+    bool ran = false;
+    int64_t scale = refreshScale.load();
+    double totalCostMs = 0.0;
+    std::array<float, static_cast<size_t>(SourceId::Count)> costs{};
+    std::array<bool, static_cast<size_t>(SourceId::Count)> probed{};
+    for (size_t index = 0; index < static_cast<size_t>(SourceId::Count); ++index) {
+        Source& source = sources[index];
+        SourceId id = static_cast<SourceId>(index);
+        bool demanded = now - sourceDemandMs[index].load() <= DEMAND_WINDOW_MS;
+        bool due = source.lastRunMs == 0 ||
+                   (demanded && (now - source.lastRunMs >= source.ttlMs * source.backoff * scale ||
+                                 (id == SourceId::App && appGeneration != lastAppGeneration) ||
+                                 (id == SourceId::Network && networkGeneration != lastNetworkGeneration) ||
+                                 (id == SourceId::Power && powerGeneration != lastPowerGeneration)));
+        if (!due) {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ProbeSource(id, fields);
+        double costMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Over budget: probe less often; comfortably under: recover
+        source.averageCostMs = source.lastRunMs == 0 ? costMs : source.averageCostMs * 0.8 + costMs * 0.2;
+        if (source.averageCostMs > source.budgetMs && source.backoff < MAX_SOURCE_BACKOFF) {
+            source.backoff *= 2;
+        } else if (source.averageCostMs < source.budgetMs / 2 && source.backoff > 1) {
+            source.backoff /= 2;
+        }
+        source.lastRunMs = NowMs();
+        totalCostMs += costMs;
+        costs[index] = static_cast<float>(costMs);
+        probed[index] = true;
+        ran = true;
+    }
+    if (!ran) {
+        return false;
+    }
+    lastAppGeneration = appGeneration;
+    lastNetworkGeneration = networkGeneration;
+    lastPowerGeneration = powerGeneration;
+    fields.timestamp = WindowsAPIs::GetCurrentTimestamp();
+    history.RecordSample(ContextHistory::NowMs(), fields.cpuUsage, fields.memoryUsage, fields.battery,
+                         fields.activeApp);
+    if (EventBus* bus = eventBus.load()) {
+        bus->Publish(EventBus::SystemSample{fields.cpuUsage, fields.memoryUsage, fields.battery});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        systemContext = std::move(fields);
+    }
+    probeMetrics.Update([&](ProbeMetrics& metrics) {
+        metrics.contextUpdateLatency = static_cast<float>(totalCostMs);
+        for (size_t index = 0; index < costs.size(); ++index) {
+            if (probed[index]) {
+                metrics.probeLatencyMs[index] = costs[index];
+            }
+        }
+        return true;
+    });
+    return true;
+}
+
+void ContextCollector::ProbeSource(SourceId id, SystemContext& fields) {
+    switch (id) {
+        case SourceId::App: {
+            fields.activeApp = WindowsAPIs::GetCurrentForegroundApp();
+            fields.activeAppCategory = WindowsAPIs::GetCurrentForegroundCategory();
+            bool appChanged;
+            {
+                std::lock_guard<std::mutex> stateLock(stateMutex);
+                appChanged = (fields.activeApp != lastActiveApp);
+                lastActiveApp = fields.activeApp;
+            }
+            if (appChanged) {
+                if (fields.activeApp != "Unknown" && fields.activeApp != "Desktop") {
+                    JournalEvent(EventJournal::Kind::AppSwitch, fields.activeApp);
+                }
+                if (EventBus* bus = eventBus.load()) {
+                    bus->Publish(EventBus::AppSwitch{fields.activeApp, fields.activeAppCategory});
+                }
+                BumpStateVersion();
+            }
+
+            // Reuse the fragments of records unchanged since the last probe,
+            // so only new records (and the current app's duration) are serialized
+            auto recentApps = WindowsAPIs::GetRecentPeriodActiveAppList();
+            fields.appDwellTimes = WindowsAPIs::GetActiveAppDwellTimes();
+            std::vector<RecentApp> previous = std::move(fields.recentApps);
+            fields.recentApps.clear();
+            fields.recentApps.reserve(recentApps.size());
+            for (const auto& record : recentApps) {
+                auto seen = std::find_if(previous.begin(), previous.end(), [&](const RecentApp& known) {
+                    return known.started == record.timestamp && known.appId == record.appId &&
+                           known.windowTitleId == record.windowTitleId &&
+                           known.durationSeconds == record.durationSeconds && !known.fragment.empty();
+                });
+                if (seen != previous.end()) {
+                    fields.recentApps.push_back(std::move(*seen));
+                    continue;
+                }
+
+                RecentApp app;
+                app.appId = record.appId;
+                app.windowTitleId = record.windowTitleId;
+                app.durationSeconds = record.durationSeconds;
+                app.started = record.timestamp;
+                BuildRecentAppFragment(app);
+                fields.recentApps.push_back(std::move(app));
+            }
+            break;
+        }
+
+        case SourceId::Power:
+            if (const PowerPolicy* power = powerPolicy.load()) {
+                PowerPolicy::State state = power->GetState();
+                fields.battery = state.batteryPercent;
+                fields.isCharging = state.onAc;
             } else {
-                tz_str = "+00:00"; // fallback
+                fields.battery = WindowsAPIs::GetBatteryPercentage();
+                fields.isCharging = WindowsAPIs::IsCharging();
             }
-            timeStream << tz_str;
-            timestampStr = timeStream.str();
-        }
-        
-        // Build individual app record as JSON object (escape quotes and backslashes in strings)
-        std::string escapedAppName = record.appName;
-        std::string escapedWindowTitle = record.windowTitle;
-        
-        // First escape backslashes (must be done before escaping quotes)
-        size_t pos = 0;
-        while ((pos = escapedAppName.find("\\", pos)) != std::string::npos) {
-            escapedAppName.replace(pos, 1, "\\\\");
-            pos += 2; // Skip the escaped backslash
-        }
-        pos = 0;
-        while ((pos = escapedWindowTitle.find("\\", pos)) != std::string::npos) {
-            escapedWindowTitle.replace(pos, 1, "\\\\");
-            pos += 2; // Skip the escaped backslash
-        }
-        
-        // Then escape quotes
-        pos = 0;
-        while ((pos = escapedAppName.find("\"", pos)) != std::string::npos) {
-            escapedAppName.replace(pos, 1, "\\\"");
-            pos += 2; // Skip the escaped quote
-        }
-        pos = 0;
-        while ((pos = escapedWindowTitle.find("\"", pos)) != std::string::npos) {
-            escapedWindowTitle.replace(pos, 1, "\\\"");
-            pos += 2; // Skip the escaped quote
-        }
-        
-        recentAppsStream << "{";
-        recentAppsStream << "\"appName\":\"" << escapedAppName << "\",";
-        recentAppsStream << "\"windowTitle\":\"" << escapedWindowTitle << "\",";
-        recentAppsStream << "\"durationSeconds\":" << record.durationSeconds << ",";
-        recentAppsStream << "\"timestamp\":\"" << timestampStr << "\"";
-        recentAppsStream << "}";
-        
-        firstApp = false;
-    }
-    recentAppsStream << "]";
-
-    // Use setRaw to set the array as a proper JSON array (not a quoted string)
-    cachedContext.setRaw("RecentPeriodActiveApps", recentAppsStream.str());
-    cachedContext.set("timestamp", timestamp);
-
-    // cacheMutex is released here automatically
-
-    // Calculate and store latency (AFTER releasing cacheMutex to avoid deadlock)
-    auto endTime = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
+            break;
 
-    {
-        std::lock_guard<std::mutex> metricsLock(metricsMutex);
-        latestContextUpdateLatency = duration.count() / 1000.0f;
+        // CPU is CpuSampler's smoothed usage; the rest, like memory, reads the
+        // shared PDH sample: probes in one pass cost one collection
+        case SourceId::Cpu: {
+            SystemCounters::Sample load = SystemCounters::Instance().Get();
+            fields.cpuUsage = CpuSampler::Instance().SystemPercent();
+            fields.cpuCoreUsage = CpuSampler::Instance().CorePercent();
+            fields.diskUsage = load.diskBusyPercent;
+            fields.gpuUsage = load.gpuPercent;
+            break;
+        }
+
+        case SourceId::Memory: {
+            SystemCounters::Sample load = SystemCounters::Instance().Get();
+            fields.memoryUsage = load.memoryPercent;
+            fields.memoryUsedGB = load.memoryUsedGB;
+            fields.totalMemoryGB = load.totalMemoryGB;
+            break;
+        }
+
+        // A snapshot read while NetworkState runs (it re-reads on network events)
+        case SourceId::Network:
+            fields.networkConnected = WindowsAPIs::IsNetworkConnected();
+            fields.networkType = WindowsAPIs::GetNetworkType();
+            break;
+
+        case SourceId::Location: {
+            auto location = WindowsAPIs::GetLocation();
+            fields.locationValid = location.valid && location.latitude != 0.0 && location.longitude != 0.0;
+            fields.locationLat = location.latitude;
+            fields.locationLon = location.longitude;
+            fields.locationAccuracy = location.accuracyMeters;
+            fields.locationTimestamp = fields.locationValid ? FormatLocalTime(location.updated) : "";
+            break;
+        }
+
+        case SourceId::Count:
+            break;
     }
+}
 
-    lastUpdate = std::chrono::steady_clock::now();
+void ContextCollector::BuildRecentAppFragment(RecentApp& app) {
+    const StringInterner& strings = WindowsAPIs::GetActiveAppStrings();
+    app.fragment.clear();
+    JsonWriter writer(app.fragment);
+    writer.BeginObject();
+    writer.Key("appName").EscapedString(strings.GetEscaped(app.appId));
+    writer.Key("windowTitle").EscapedString(strings.GetEscaped(app.windowTitleId));
+    writer.Key("durationSeconds").Int(app.durationSeconds);
+    writer.Key("timestamp").String(FormatLocalTime(app.started));
+    writer.EndObject();
 }
 
-Json ContextCollector::CollectCurrentContext() {
-    if (ShouldUpdateCache()) {
-        UpdateCache();
+std::string ContextCollector::FormatLocalTime(std::chrono::system_clock::time_point time) {
+    // Format timestamp as ISO string (using local time)
+    auto time_t_val = std::chrono::system_clock::to_time_t(time);
+    struct tm timeinfo;
+    if (localtime_s(&timeinfo, &time_t_val) != 0) {
+        return "1970-01-01T00:00:00.000+00:00";
     }
+    std::ostringstream timeStream;
+    timeStream << std::put_time(&timeinfo, "%Y-%m-%dT%H:%M:%S");
+    timeStream << ".000";
 
-    std::lock_guard<std::mutex> lock(cacheMutex);
+    // Add timezone offset
+    char tz_offset[16];
+    strftime(tz_offset, sizeof(tz_offset), "%z", &timeinfo);
+    std::string tz_str(tz_offset);
+    if (tz_str.length() >= 5) {
+        // Convert +0800 to +08:00 format
+        tz_str = tz_str.substr(0, 3) + ":" + tz_str.substr(3);
+    } else {
+        tz_str = "+00:00"; // fallback
+    }
+    timeStream << tz_str;
+    return timeStream.str();
+}
 
-    // Get voice text first (before it's needed by GenerateFusedContext)
-    std::string voiceText;
-    {
-        std::lock_guard<std::mutex> voiceLock(voiceMutex);
-        voiceText = latestVoiceTranscription;
-        if (!latestVoiceTranscription.empty()) {
-            cachedContext.set("voiceTranscription", latestVoiceTranscription);
-        } else {
-            cachedContext.setRaw("voiceTranscription", "null");
+// ============================================================================
+// Event Journal
+// ============================================================================
+
+bool ContextCollector::OpenJournal(const std::string& directory) {
+    auto opened = std::make_unique<EventJournal>(directory);
+
+    // Replay straight from the mapped files: captions and history events as
+    // they were, app switches turned back into recent-app records
+    std::vector<WindowsAPIs::ActiveAppRecord> apps;
+    int64_t lastSwitchMs = 0;
+    std::string lastVoice;
+    std::string lastCamera;
+    int64_t lastCameraMs = 0;
+    size_t replayed = opened->Replay([&](const EventJournal::Record& record) {
+        std::string text(record.text);
+        switch (record.kind) {
+            case EventJournal::Kind::Voice:
+                history.RecordEvent(record.timeMs, ContextHistory::VOICE, text);
+                lastVoice = text;
+                break;
+
+            case EventJournal::Kind::Camera:
+                history.RecordEvent(record.timeMs, ContextHistory::CAMERA, text);
+                lastCamera = text;
+                lastCameraMs = record.timeMs;
+                break;
+
+            case EventJournal::Kind::AppSwitch:
+                // The previous app ran until this switch
+                if (!apps.empty()) {
+                    apps.back().durationSeconds = static_cast<int>((record.timeMs - lastSwitchMs) / 1000);
+                }
+                apps.emplace_back(text, "");
+                apps.back().timestamp = std::chrono::system_clock::time_point(std::chrono::milliseconds(record.timeMs));
+                lastSwitchMs = record.timeMs;
+                break;
         }
+    });
+
+    // The last app's session ended at shutdown, at an unknown time
+    if (!apps.empty()) {
+        apps.pop_back();
+    }
+    apps.erase(std::remove_if(apps.begin(), apps.end(),
+                              [](const WindowsAPIs::ActiveAppRecord& app) { return app.durationSeconds <= 0; }),
+               apps.end());
+    WindowsAPIs::RestoreActiveAppHistory(apps);
+    if (!lastVoice.empty()) {
+        voice.Update([&](VoiceState& state) {
+            state.transcription = lastVoice;
+            return true;
+        });
     }
+    if (!lastCamera.empty()) {
+        std::string timestamp = FormatLocalTime(std::chrono::system_clock::time_point(
+            std::chrono::milliseconds(lastCameraMs)));
+        camera.Update([&](CameraState& state) {
+            state.description = lastCamera;
+            state.timestamp = timestamp;
+            return true;
+        });
+    }
+    LOG_INFO("ContextCollector", "Replayed " << replayed << " journal records");
 
-    // Add camera vision to context (thread-safe)
+    if (!opened->Open()) {
+        return false;
+    }
+    journal = std::move(opened);
+    BumpStateVersion();
+    return true;
+}
+
+void ContextCollector::JournalEvent(EventJournal::Kind kind, const std::string& text) {
+    if (journal) {
+        journal->Append(kind, ContextHistory::NowMs(), text);
+    }
+}
+
+std::string ContextCollector::CollectCurrentContext() {
+    NoteReader();
+    return GetSnapshot()->serialized;
+}
+
+std::shared_ptr<const ContextCollector::Snapshot> ContextCollector::GetSnapshot() {
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+    if (!current) {
+        RefreshSnapshot();
+        current = std::atomic_load(&snapshot);
+    }
+    return current;
+}
+
+std::shared_ptr<const ContextCollector::Snapshot> ContextCollector::WaitForSnapshot(uint64_t since, int timeoutMs) {
     {
-        std::lock_guard<std::mutex> cameraLock(cameraMutex);
-        if (!latestCameraDescription.empty()) {
-            cachedContext.set("cameraDescription", latestCameraDescription);
-            cachedContext.set("cameraLatency", static_cast<int>(latestCameraLatency));
+        std::unique_lock<std::mutex> lock(stateMutex);
+        snapshotPublished.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() {
+            std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+            return current && current->stateVersion != since;
+        });
+    }
+    return GetSnapshot();
+}
+
+void ContextCollector::RefreshSnapshot() {
+    // Idle (no reader, no producer change): the current snapshot still
+    // stands, so skip the rebuild
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+    bool demanded = NowMs() - lastReaderMs.load() <= DEMAND_WINDOW_MS;
+    if (!demanded && current && current->stateVersion == GetStateVersion()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    PublishSnapshot();
+}
+
+void ContextCollector::WriteTopProcesses(JsonWriter& writer) const {
+    writer.Key("topProcesses");
+    if (!processMonitor) {
+        writer.Null();
+        return;
+    }
+    std::shared_ptr<const EtwProcessMonitor::TopProcesses> top = processMonitor->GetTopProcesses();
+    writer.BeginObject();
+    writer.Key("cpu").BeginArray();
+    for (const auto& process : top->byCpu) {
+        writer.BeginObject();
+        writer.Key("name").String(process.name);
+        writer.Key("pid").UInt(process.processId);
+        writer.Key("cpuPercent").Double(process.cpuPercent, 2);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("network").BeginArray();
+    for (const auto& process : top->byNetwork) {
+        writer.BeginObject();
+        writer.Key("name").String(process.name);
+        writer.Key("pid").UInt(process.processId);
+        writer.Key("sentBytesPerSecond").Double(process.sentBytesPerSecond, 0);
+        writer.Key("receivedBytesPerSecond").Double(process.receivedBytesPerSecond, 0);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+void ContextCollector::PublishSnapshot() {
+    PipelineLatency::Timer timer(PipelineLatency::Stage::JsonBuild);
+    TRACE_ZONE("ContextCollector::PublishSnapshot");
+    auto next = std::make_shared<Snapshot>();
+    std::shared_ptr<const Snapshot> previous = std::atomic_load(&snapshot);
+
+    // Read the version first: a change landing mid-build bumps it again and
+    // triggers another snapshot
+    next->stateVersion = GetStateVersion();
+
+    // One allocation in the common case: documents barely change in size
+    std::string& out = next->serialized;
+    out.reserve(previous ? previous->serialized.size() + 256 : 4096);
+    JsonWriter writer(out);
+    writer.BeginObject();
+
+    // System fields (cacheMutex is held by the caller)
+    const SystemContext& system = systemContext;
+    writer.Key("activeApp").String(system.activeApp);
+    writer.Key("activeAppCategory").String(system.activeAppCategory);
+    writer.Key("battery").Int(system.battery);
+    writer.Key("isCharging").Bool(system.isCharging);
+    auto writeMeasure = [&writer](const char* key, double value) {
+        if (value >= 0) {
+            writer.Key(key).Double(value, 2);
         } else {
-            cachedContext.setRaw("cameraDescription", "null");
-            cachedContext.set("cameraLatency", 0);
+            writer.Key(key).Null();
         }
+    };
+    writeMeasure("cpuUsage", system.cpuUsage);
+    writer.Key("cpuCoreUsage").BeginArray();
+    for (double core : system.cpuCoreUsage) {
+        writer.Double(core, 1);
     }
+    writer.EndArray();
+    writeMeasure("diskUsage", system.diskUsage);
+    writeMeasure("gpuUsage", system.gpuUsage);
+    writeMeasure("memoryUsage", system.memoryUsage);
+    writeMeasure("memoryUsedGB", system.memoryUsedGB);
+    writeMeasure("totalMemoryGB", system.totalMemoryGB);
+    writer.Key("networkConnected").Bool(system.networkConnected);
+    writer.Key("networkType").String(system.networkType);
+    if (system.locationValid) {
+        writer.Key("locationLat").Double(system.locationLat, 8);
+        writer.Key("locationLon").Double(system.locationLon, 8);
+        writer.Key("locationAccuracyMeters").Double(system.locationAccuracy, 0);
+        writer.Key("locationTimestamp").String(system.locationTimestamp);
+    } else {
+        writer.Key("locationLat").Null();
+        writer.Key("locationLon").Null();
+        writer.Key("locationAccuracyMeters").Null();
+        writer.Key("locationTimestamp").Null();
+    }
+    writer.Key("locationValid").Bool(system.locationValid);
+
+    WriteTopProcesses(writer);
 
-    // Add pipeline latency metrics (thread-safe)
+    writer.Key("RecentPeriodActiveApps").BeginArray();
+    for (const auto& app : system.recentApps) {
+        writer.Raw(app.fragment);
+    }
+    writer.EndArray();
+
+    // Per-app totals over the last hour, maintained by the history itself
+    const StringInterner& appStrings = WindowsAPIs::GetActiveAppStrings();
+    writer.Key("appDwellSeconds").BeginArray();
+    for (size_t index = 0; index < system.appDwellTimes.size() && index < MAX_DWELL_APPS; ++index) {
+        writer.BeginObject();
+        writer.Key("appName").EscapedString(appStrings.GetEscaped(system.appDwellTimes[index].appId));
+        writer.Key("seconds").Int(system.appDwellTimes[index].seconds);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("timestamp").String(system.timestamp);
+
+    // Producer state: one lock-free load per source
+    std::shared_ptr<const VoiceState> voiceState = voice.Load();
+    writer.Key("voiceTranscription").StringOrNull(voiceState->transcription);
+    writer.Key("voicePartial").StringOrNull(voiceState->partial);
+    writer.Key("voiceDecoded").StringOrNull(voiceState->decoded);
+    writer.Key("voiceDecodedUntilMs").Int(voiceState->decodedUntilMs);
+    if (voiceState->speaker >= 0) {
+        writer.Key("voiceSpeaker").Int(voiceState->speaker);
+    } else {
+        writer.Key("voiceSpeaker").Null();
+    }
+    writer.Key("systemAudioTranscription").StringOrNull(voiceState->systemAudio);
+    writer.Key("voiceKeyword").StringOrNull(voiceState->keyword);
+    writer.Key("voiceKeywordScore").Double(voiceState->keywordScore, 3);
+    writer.Key("voiceKeywordTimestamp").StringOrNull(voiceState->keywordTimestamp);
+    writer.Key("voiceKeywordCount").UInt(voiceState->keywordCount);
+
+    std::shared_ptr<const CameraState> cameraState = camera.Load();
+    if (!cameraState->description.empty()) {
+        writer.Key("cameraDescription").String(cameraState->description);
+        writer.Key("cameraLatency").Int(static_cast<int>(cameraState->latencyMs));
+        writer.Key("cameraTimestamp").String(cameraState->timestamp);
+        writer.Key("cameraReused").Bool(cameraState->reused);
+    } else {
+        writer.Key("cameraDescription").Null();
+        writer.Key("cameraLatency").Int(0);
+        writer.Key("cameraTimestamp").Null();
+        writer.Key("cameraReused").Bool(false);
+    }
+    writer.Key("cameraScenesDescribed").UInt(cameraState->scenesDescribed);
+    writer.Key("cameraScenesSkipped").UInt(cameraState->scenesSkipped);
+    writer.Key("cameraCacheHits").UInt(cameraState->cacheHits);
+    writer.Key("cameraCacheMisses").UInt(cameraState->cacheMisses);
+    writer.Key("cameraPartial").StringOrNull(cameraState->partial);
+
+    std::shared_ptr<const ScreenState> screenState = screen.Load();
+    writer.Key("screenDescription").StringOrNull(screenState->description);
+    writer.Key("screenWindow").StringOrNull(screenState->window);
+    writer.Key("screenTimestamp").StringOrNull(screenState->timestamp);
+    writer.Key("screenLatency").Int(static_cast<int>(screenState->latencyMs));
+    writer.Key("screenChangedShare").Double(screenState->changedShare, 3);
+    writer.Key("screenText").StringOrNull(screenState->text);
+    writer.Key("screenTextWindow").StringOrNull(screenState->textWindow);
+    writer.Key("screenTextTimestamp").StringOrNull(screenState->textTimestamp);
+    writer.Key("screenTextLatency").Int(static_cast<int>(screenState->textLatencyMs));
+
+    // External sensors
+    writer.Key("sensors").BeginObject();
+    for (const auto& entry : *sensors.Load()) {
+        writer.Key(entry.first).BeginObject();
+        writer.Key("value").Raw(entry.second.value);
+        writer.Key("timestamp").String(entry.second.timestamp);
+        writer.Key("latencyMs").Double(entry.second.latencyMs, 2);
+        writer.EndObject();
+    }
+    writer.EndObject();
+
+    // Model readiness
+    for (const auto& entry : *modelStatus.Load()) {
+        writer.Key(entry.first + "ModelStatus").String(entry.second);
+    }
+
+    // Pipeline latency metrics
+    std::shared_ptr<const ProbeMetrics> metrics = probeMetrics.Load();
+    writer.Key("voiceLatency").Double(voiceState->latencyMs, 2);
+    writer.Key("contextUpdateLatency").Double(metrics->contextUpdateLatency, 2);
+    writer.Key("probeLatencies").BeginObject();
+    for (size_t index = 0; index < metrics->probeLatencyMs.size(); ++index) {
+        writer.Key(sources[index].name).Double(metrics->probeLatencyMs[index], 2);
+    }
+    writer.EndObject();
+
+    // Fused context summary, from the same voice state as the fields above
+    const FusedSummary& summary = UpdateFusedContext(voiceState->transcription, cameraState->description);
+    writer.Key("fusedContext").String(summary.text);
+    next->fusedVersion = summary.version;
+    writer.EndObject();
+
+    // The document is complete, so views into it stay valid
+    std::string_view document(out);
+    for (const auto& span : writer.GetTopLevelMembers()) {
+        next->members.emplace_back(document.substr(span.keyOffset, span.keyLength),
+                                   document.substr(span.valueOffset, span.valueLength));
+    }
+
+    bool changed = !previous || previous->members != next->members;
+    next->version = changed ? ++documentVersion : previous->version;
+    next->encoded = changed ? std::make_shared<Snapshot::EncodedBodies>() : previous->encoded;
+
+    std::shared_ptr<const Snapshot> published = std::move(next);
+    std::atomic_store(&snapshot, published);
+
+    if (changed) {
+        std::lock_guard<std::mutex> lock(documentMutex);
+        documentHistory.push_back(published);
+        if (documentHistory.size() > DOCUMENT_HISTORY) {
+            documentHistory.pop_front();
+        }
+    }
+
+    // Taking stateMutex orders the notify after any waiter's predicate check
     {
-        std::lock_guard<std::mutex> metricsLock(metricsMutex);
-        std::ostringstream voiceLatencyStream, contextLatencyStream;
-        voiceLatencyStream << std::fixed << std::setprecision(2) << latestVoiceLatency;
-        contextLatencyStream << std::fixed << std::setprecision(2) << latestContextUpdateLatency;
+        std::lock_guard<std::mutex> lock(stateMutex);
+    }
+    snapshotPublished.notify_all();
+}
+
+const std::string& ContextCollector::Snapshot::GetEncoded(Deflate::Container container) const {
+    if (container == Deflate::Container::Gzip) {
+        std::call_once(encoded->gzipOnce, [this]() {
+            encoded->gzip = Deflate::Compress(serialized, Deflate::Container::Gzip);
+            encoded->bytes += encoded->gzip.capacity();
+        });
+        return encoded->gzip;
+    }
+    std::call_once(encoded->deflateOnce, [this]() {
+        encoded->deflate = Deflate::Compress(serialized, Deflate::Container::Zlib);
+        encoded->bytes += encoded->deflate.capacity();
+    });
+    return encoded->deflate;
+}
+
+std::string_view ContextCollector::Snapshot::FindMember(std::string_view key) const {
+    for (const auto& member : members) {
+        if (member.first == key) {
+            return member.second;
+        }
+    }
+    return std::string_view();
+}
 
-        cachedContext.setRaw("voiceLatency", voiceLatencyStream.str());
-        cachedContext.setRaw("contextUpdateLatency", contextLatencyStream.str());
+std::string ContextCollector::Snapshot::Project(const std::vector<std::string_view>& keys) const {
+    std::string out;
+    out.reserve(256);
+    out += '{';
+    for (const auto& member : members) {
+        if (std::find(keys.begin(), keys.end(), member.first) == keys.end()) {
+            continue;
+        }
+        if (out.size() > 1) {
+            out += ',';
+        }
+        // Member keys are kept escaped, without their quotes
+        out += '"';
+        out.append(member.first.data(), member.first.size());
+        out += "\":";
+        out.append(member.second.data(), member.second.size());
+    }
+    out += '}';
+    return out;
+}
+
+const std::string& ContextCollector::Snapshot::GetMessagePack() const {
+    std::call_once(encoded->messagePackOnce, [this]() {
+        MessagePack::TranscodeJson(encoded->messagePack, serialized);
+        encoded->bytes += encoded->messagePack.capacity();
+    });
+    return encoded->messagePack;
+}
+
+ContextCollector::ContextDelta ContextCollector::CollectContextSince(uint64_t since) {
+    NoteReader();
+    std::shared_ptr<const Snapshot> latest = GetSnapshot();
+    ContextDelta delta;
+    delta.version = latest->version;
+    delta.snapshot = latest;
+    if (since == delta.version) {
+        delta.notModified = true;
+        return delta;
+    }
+
+    std::shared_ptr<const Snapshot> base;
+    {
+        std::lock_guard<std::mutex> lock(documentMutex);
+        for (const auto& entry : documentHistory) {
+            if (entry->version == since) {
+                base = entry;
+                break;
+            }
+        }
+    }
+    if (!base) {
+        return delta;                       // Too old or from another run: full document
     }
 
-    // Add fused context summary (pass voiceText to avoid re-locking voiceMutex)
-    cachedContext.set("fusedContext", GenerateFusedContext(voiceText));
+    // Merge patch: changed and added keys with their new values, removed keys
+    // as null (keys are plain identifiers, so their stored text needs no re-escaping)
+    JsonWriter patch(delta.body);
+    patch.BeginObject();
+    for (const auto& member : latest->members) {
+        if (base->FindMember(member.first) != member.second) {
+            patch.Key(member.first).Raw(member.second);
+        }
+    }
+    for (const auto& member : base->members) {
+        if (latest->FindMember(member.first).empty()) {
+            patch.Key(member.first).Null();
+        }
+    }
+    patch.EndObject();
 
-    return cachedContext;
+    delta.isPatch = true;
+    return delta;
 }
 
 void ContextCollector::UpdateVoiceContext(const std::string& transcription) {
-    std::lock_guard<std::mutex> lock(voiceMutex);
+    PublishTranscription(transcription, nullptr);
+}
+
+void ContextCollector::PublishTranscription(const std::string& transcription, const float* latencyMs,
+                                            int speaker) {
+    std::string cleaned = CleanTranscription(transcription);
+
+    // Text and latency land in one published value
+    voice.Update([&](VoiceState& state) {
+        state.transcription = cleaned;
+        state.partial.clear();
+        state.decoded.clear();
+        state.decodedUntilMs = 0;
+        state.speaker = speaker;
+        if (latencyMs) {
+            state.latencyMs = *latencyMs;
+        }
+        return true;
+    });
+    if (latencyMs) {
+        history.RecordLatency(ContextHistory::VOICE, *latencyMs);
+    }
+    if (!cleaned.empty()) {
+        history.RecordEvent(ContextHistory::NowMs(), ContextHistory::VOICE, cleaned);
+        JournalEvent(EventJournal::Kind::Voice, cleaned);
+    }
+    BumpStateVersion();
+}
+
+void ContextCollector::UpdateVoicePartial(const std::string& partial) {
+    std::string cleaned = CleanTranscription(partial);
+
+    bool changed = voice.Update([&](VoiceState& state) {
+        if (state.partial == cleaned) {
+            return false;   // Partial passes often repeat the hypothesis
+        }
+        state.partial = cleaned;
+        return true;
+    });
+    if (changed) {
+        BumpStateVersion();
+    }
+}
 
-    // Clean up common Whisper hallucinations
+void ContextCollector::UpdateVoiceSegment(uint64_t traceId, int index, const std::string& text, int64_t endMs) {
+    std::string cleaned = CleanTranscription(text);
+    if (cleaned.empty()) {
+        return;
+    }
+
+    voice.Update([&](VoiceState& state) {
+        // The first segment, or another utterance's: start over
+        if (index == 0 || state.decodedTrace != traceId) {
+            state.decoded.clear();
+        }
+        if (!state.decoded.empty()) {
+            state.decoded += ' ';
+        }
+        state.decoded += cleaned;
+        state.decodedTrace = traceId;
+        state.decodedUntilMs = endMs;
+        return true;
+    });
+    BumpStateVersion();
+}
+
+void ContextCollector::UpdateSystemAudioContext(const std::string& transcription) {
+    std::string cleaned = CleanTranscription(transcription);
+    if (cleaned.empty()) {
+        return;     // Music and effects often transcribe to nothing but hallucination markers
+    }
+
+    bool changed = voice.Update([&](VoiceState& state) {
+        if (state.systemAudio == cleaned) {
+            return false;
+        }
+        state.systemAudio = cleaned;
+        return true;
+    });
+    if (changed) {
+        BumpStateVersion();
+    }
+}
+
+void ContextCollector::UpdateVoiceKeyword(const std::string& keyword, float score) {
+    std::string timestamp = WindowsAPIs::GetCurrentTimestamp();
+    voice.Update([&](VoiceState& state) {
+        state.keyword = keyword;
+        state.keywordScore = score;
+        state.keywordTimestamp = timestamp;
+        state.keywordCount++;
+        return true;
+    });
+    BumpStateVersion();
+}
+
+std::string ContextCollector::CleanTranscription(const std::string& transcription) {
+    // Safety net: AsyncWhisperQueue already suppresses non-speech tokens and
+    // drops low-confidence segments, so these rarely get this far
     std::string cleaned = transcription;
 
     // List of common hallucination patterns to remove
-    const std::vector<std::string> hallucinations = {
+    static const std::string_view hallucinations[] = {
         "[no audio]", "[NO AUDIO]",
         "[BLANK_AUDIO]", "[blank_audio]",
         "[BLANK AUDIO]", "[blank audio]",
@@ -274,11 +934,13 @@ void ContextCollector::UpdateVoiceContext(const std::string& transcription) {
         "(upbeat music)", "(soft music)"
     };
 
-    // Remove hallucination patterns (trim whitespace after removal)
-    for (const auto& hallucination : hallucinations) {
-        size_t pos = 0;
-        while ((pos = cleaned.find(hallucination, pos)) != std::string::npos) {
-            cleaned.erase(pos, hallucination.length());
+    // Every pattern has a bracket or "watching": most transcripts skip the scan
+    if (cleaned.find_first_of("[(") != std::string::npos || cleaned.find("watching") != std::string::npos) {
+        for (std::string_view hallucination : hallucinations) {
+            size_t pos = 0;
+            while ((pos = cleaned.find(hallucination.data(), pos, hallucination.size())) != std::string::npos) {
+                cleaned.erase(pos, hallucination.size());
+            }
         }
     }
 
@@ -291,73 +953,399 @@ void ContextCollector::UpdateVoiceContext(const std::string& transcription) {
         cleaned = "";
     }
 
-    latestVoiceTranscription = cleaned;
+    return cleaned;
 }
 
 void ContextCollector::UpdateVoiceContext(const std::string& transcription, float latencyMs) {
-    // Update latency FIRST (before locking voiceMutex to avoid deadlock)
+    PublishTranscription(transcription, &latencyMs);
+}
+
+void ContextCollector::UpdateVoiceContext(const std::string& transcription, float latencyMs, int speaker) {
+    PublishTranscription(transcription, &latencyMs, speaker);
+}
+
+void ContextCollector::UpdateCameraContext(const std::string& description, float latencyMs) {
+    UpdateCameraContext(description, latencyMs, false);
+}
+
+void ContextCollector::UpdateCameraContext(const std::string& description, float latencyMs, bool reused) {
+    std::string timestamp = WindowsAPIs::GetCurrentTimestamp();
+    bool changed = false;
+
+    camera.Update([&](CameraState& state) {
+        changed = (description != state.description);
+        state.description = description;
+        state.timestamp = timestamp;
+        state.reused = reused;
+        state.partial.clear();
+
+        // A reused description keeps the latency of the run that produced it
+        if (!reused) {
+            state.latencyMs = latencyMs;
+        }
+        return true;
+    });
+
+    if (!reused) {
+        history.RecordLatency(ContextHistory::CAMERA, latencyMs);
+    }
+    if (changed) {
+        history.RecordEvent(ContextHistory::NowMs(), ContextHistory::CAMERA, description);
+        JournalEvent(EventJournal::Kind::Camera, description);
+        BumpStateVersion();
+    }
+}
+
+void ContextCollector::UpdateScreenContext(const std::string& description, const std::string& window,
+                                           float latencyMs, float changedShare) {
+    std::string timestamp = WindowsAPIs::GetCurrentTimestamp();
+    bool changed = false;
+    screen.Update([&](ScreenState& state) {
+        changed = description != state.description || window != state.window;
+        state.description = description;
+        state.window = window;
+        state.timestamp = timestamp;
+        state.latencyMs = latencyMs;
+        state.changedShare = changedShare;
+        return true;
+    });
+    if (changed) {
+        BumpStateVersion();
+    }
+}
+
+void ContextCollector::UpdateScreenText(const std::string& text, const std::string& window, float latencyMs) {
+    std::string timestamp = WindowsAPIs::GetCurrentTimestamp();
+    bool changed = false;
+    screen.Update([&](ScreenState& state) {
+        changed = text != state.text || window != state.textWindow;
+        state.text = text;
+        state.textWindow = window;
+        state.textTimestamp = timestamp;
+        state.textLatencyMs = latencyMs;
+        return true;
+    });
+    if (changed) {
+        BumpStateVersion();
+    }
+}
+
+void ContextCollector::UpdateCameraPartial(const std::string& partial) {
+    bool changed = camera.Update([&](CameraState& state) {
+        if (state.partial == partial) {
+            return false;
+        }
+        state.partial = partial;
+        return true;
+    });
+    if (changed) {
+        BumpStateVersion();
+    }
+}
+
+size_t ContextCollector::IngestEvents(const std::vector<IngestEvent>& events) {
+    std::string now = WindowsAPIs::GetCurrentTimestamp();
+    size_t applied = 0;
+    bool changed = false;
+
+    // Apply the batch per source, one publish each; side effects (history,
+    // journal) only after the publish that can't be retried any more
+    std::vector<const IngestEvent*> cameraEvents, voiceEvents, sensorEvents;
+    for (const auto& event : events) {
+        switch (event.kind) {
+            case IngestEvent::Kind::Camera: cameraEvents.push_back(&event); break;
+            case IngestEvent::Kind::Voice: voiceEvents.push_back(&event); break;
+            case IngestEvent::Kind::Sensor: sensorEvents.push_back(&event); break;
+        }
+    }
+
+    if (!cameraEvents.empty()) {
+        std::vector<const IngestEvent*> newCaptions;
+        camera.Update([&](CameraState& state) {
+            newCaptions.clear();
+            for (const IngestEvent* event : cameraEvents) {
+                if (event->text != state.description) {
+                    newCaptions.push_back(event);
+                }
+                state.description = event->text;
+                state.timestamp = event->timestamp.empty() ? now : event->timestamp;
+                state.reused = false;
+                state.latencyMs = event->latencyMs;
+            }
+            return true;
+        });
+        for (const IngestEvent* event : cameraEvents) {
+            if (event->latencyMs > 0) {
+                history.RecordLatency(ContextHistory::CAMERA, event->latencyMs);
+            }
+        }
+        for (const IngestEvent* event : newCaptions) {
+            history.RecordEvent(ContextHistory::NowMs(), ContextHistory::CAMERA, event->text);
+            JournalEvent(EventJournal::Kind::Camera, event->text);
+        }
+        changed |= !newCaptions.empty();
+        applied += cameraEvents.size();
+    }
+
+    if (!voiceEvents.empty()) {
+        std::vector<std::string> transcriptions;
+        for (const IngestEvent* event : voiceEvents) {
+            transcriptions.push_back(CleanTranscription(event->text));
+        }
+        voice.Update([&](VoiceState& state) {
+            state.transcription = transcriptions.back();
+            state.partial.clear();
+            state.latencyMs = voiceEvents.back()->latencyMs;
+            return true;
+        });
+        for (const IngestEvent* event : voiceEvents) {
+            if (event->latencyMs > 0) {
+                history.RecordLatency(ContextHistory::VOICE, event->latencyMs);
+            }
+        }
+        for (const auto& transcription : transcriptions) {
+            if (!transcription.empty()) {
+                history.RecordEvent(ContextHistory::NowMs(), ContextHistory::VOICE, transcription);
+                JournalEvent(EventJournal::Kind::Voice, transcription);
+            }
+        }
+        changed = true;
+        applied += voiceEvents.size();
+    }
+
+    if (!sensorEvents.empty()) {
+        size_t sensorsApplied = 0;
+        bool sensorsChanged = false;
+        sensors.Update([&](std::map<std::string, SensorReading>& readings) {
+            sensorsApplied = 0;
+            sensorsChanged = false;
+            for (const IngestEvent* event : sensorEvents) {
+                auto it = readings.find(event->name);
+                if (it == readings.end()) {
+                    if (readings.size() >= MAX_SENSORS) {
+                        continue;
+                    }
+                    it = readings.emplace(event->name, SensorReading()).first;
+                }
+                sensorsChanged |= (it->second.value != event->text);
+                it->second.value = event->text;
+                it->second.timestamp = event->timestamp.empty() ? now : event->timestamp;
+                it->second.latencyMs = event->latencyMs;
+                sensorsApplied++;
+            }
+            return sensorsApplied > 0;
+        });
+        changed |= sensorsChanged;
+        applied += sensorsApplied;
+    }
+
+    if (changed) {
+        BumpStateVersion();
+    }
+    return applied;
+}
+
+void ContextCollector::UpdateCameraStats(uint64_t scenesDescribed, uint64_t scenesSkipped,
+                                         uint64_t cacheHits, uint64_t cacheMisses) {
+    camera.Update([&](CameraState& state) {
+        state.scenesDescribed = scenesDescribed;
+        state.scenesSkipped = scenesSkipped;
+        state.cacheHits = cacheHits;
+        state.cacheMisses = cacheMisses;
+        return true;
+    });
+}
+
+void ContextCollector::UpdateModelStatus(const std::string& subsystem, const std::string& status) {
+    bool changed = modelStatus.Update([&](std::map<std::string, std::string>& statuses) {
+        if (statuses[subsystem] == status) {
+            return false;
+        }
+        statuses[subsystem] = status;
+        return true;
+    });
+    if (changed) {
+        BumpStateVersion();
+    }
+}
+
+void ContextCollector::BumpStateVersion() {
     {
-        std::lock_guard<std::mutex> lock(metricsMutex);
-        latestVoiceLatency = latencyMs;
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stateVersion++;
     }
+    stateChanged.notify_all();
+}
 
-    // Then update transcription (locks voiceMutex)
-    UpdateVoiceContext(transcription);
+uint64_t ContextCollector::GetStateVersion() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return stateVersion;
 }
 
-void ContextCollector::UpdateCameraContext(const std::string& description, float latencyMs) {
-    std::lock_guard<std::mutex> lock(cameraMutex);
+void ContextCollector::SetFusionEngine(ContextFusion* engine) {
+    if (engine) {
+        engine->SetSummaryCallback([this]() { BumpStateVersion(); });
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    fusion = engine;
+    fused.valid = false;
+}
 
-    // Store camera vision data in member variables (persists across cache rebuilds)
-    latestCameraDescription = description;
-    latestCameraLatency = latencyMs;
+void ContextCollector::SetEventBus(EventBus* bus) {
+    eventBus.store(bus);
 }
 
-// Overload that fetches voice text itself (may cause deadlock if voiceMutex already locked)
-std::string ContextCollector::GenerateFusedContext() const {
-    std::string voiceText;
+void ContextCollector::SetPowerPolicy(const PowerPolicy* policy) {
+    powerPolicy.store(policy);
+}
+
+void ContextCollector::SetRefreshScale(int scale) {
+    scale = (std::max)(scale, 1);
+    if (refreshScale.exchange(scale) <= scale) {
+        return;
+    }
+    // Faster again: sample and rebuild now instead of at the end of a long wait
     {
-        std::lock_guard<std::mutex> voiceLock(voiceMutex);
-        voiceText = latestVoiceTranscription;
+        std::lock_guard<std::mutex> lock(stateMutex);
+        sampleRequested = true;
+        refreshRequested = true;
     }
-    return GenerateFusedContext(voiceText);
+    stateChanged.notify_all();
 }
 
-// Overload that accepts voice text to avoid deadlock
+// Least to most volatile, so ContextFusion re-prefills only from the first changed line
+std::string ContextCollector::BuildFusionInputs(const std::string& voiceText, const std::string& cameraText) const {
+    std::ostringstream inputs;
+    const std::string& activeApp = systemContext.activeApp;
+    if (activeApp != "Unknown" && !activeApp.empty()) {
+        inputs << "App: " << ContextFusion::TrimField(activeApp);
+        const std::string& category = systemContext.activeAppCategory;
+        if (!category.empty() && category != "unknown") {
+            inputs << " (" << category << ")";
+        }
+        inputs << "\n";
+    }
+
+    std::string alerts;
+    if (systemContext.battery < 20 && !systemContext.isCharging) {
+        alerts += "low battery " + std::to_string(systemContext.battery) + "%";
+    }
+    if (!systemContext.networkConnected) {
+        alerts += (alerts.empty() ? "" : ", ");
+        alerts += "offline";
+    }
+    if (systemContext.cpuUsage > 80.0) {
+        alerts += (alerts.empty() ? "" : ", ");
+        alerts += "high CPU " + std::to_string(static_cast<int>(systemContext.cpuUsage)) + "%";
+    }
+    if (!alerts.empty()) {
+        inputs << "Alerts: " << alerts << "\n";
+    }
+
+    if (!cameraText.empty()) {
+        inputs << "Camera: " << ContextFusion::TrimField(cameraText) << "\n";
+    }
+    if (!voiceText.empty()) {
+        inputs << "Voice: " << ContextFusion::TrimField(voiceText) << "\n";
+    }
+    return inputs.str();
+}
+
+// The LLM's summary once it has summarized exactly these inputs, else the
+// heuristic. Most builds change none of the inputs (metrics, timestamps) and
+// return the last result after a few comparisons
+const ContextCollector::FusedSummary& ContextCollector::UpdateFusedContext(const std::string& voiceText,
+                                                                           const std::string& cameraText) {
+    const SystemContext& system = systemContext;
+    int lowBattery = system.battery < 20 && !system.isCharging ? system.battery : -1;
+    int highCpu = system.cpuUsage > 80.0 ? static_cast<int>(system.cpuUsage) : -1;
+    bool same = fused.valid && fused.activeApp == system.activeApp &&
+                fused.activeAppCategory == system.activeAppCategory && fused.lowBattery == lowBattery &&
+                fused.offline == !system.networkConnected && fused.highCpu == highCpu &&
+                fused.voiceText == voiceText && (!fusion || fused.cameraText == cameraText);
+    // Unchanged, and nothing more to wait for from the model
+    if (same && (!fusion || fused.fromModel)) {
+        return fused;
+    }
+
+    if (!same) {
+        fused.activeApp = system.activeApp;
+        fused.activeAppCategory = system.activeAppCategory;
+        fused.lowBattery = lowBattery;
+        fused.offline = !system.networkConnected;
+        fused.highCpu = highCpu;
+        fused.voiceText = voiceText;
+        fused.cameraText = cameraText;
+        fused.valid = true;
+        fused.fromModel = false;
+        fused.submitted = false;
+        fused.inputs = fusion ? BuildFusionInputs(voiceText, cameraText) : std::string();
+    }
+
+    std::string text;
+    if (fusion) {
+        // Summarized only while someone reads fusedContext
+        if (!fused.submitted && NowMs() - fusionDemandMs.load() <= DEMAND_WINDOW_MS) {
+            fusion->Submit(fused.inputs);
+            fused.submitted = true;
+        }
+        fused.fromModel = fusion->GetSummary(fused.inputs, text) && !text.empty();
+    }
+    if (!fused.fromModel) {
+        if (same) {
+            return fused;               // Still the heuristic for the same inputs
+        }
+        text = GenerateFusedContext(voiceText);
+    }
+    if (text != fused.text) {
+        fused.text = std::move(text);
+        fused.version++;
+    }
+    return fused;
+}
+
+// Overload that loads the voice text itself
+std::string ContextCollector::GenerateFusedContext() const {
+    return GenerateFusedContext(voice.Load()->transcription);
+}
+
+// Reads systemContext: cacheMutex must be held by the caller (it takes no other lock)
 std::string ContextCollector::GenerateFusedContext(const std::string& voiceText) const {
-    // NOTE: cacheMutex must already be locked by caller!
-    // Do not lock here to avoid deadlock.
     std::ostringstream fused;
 
     // Current activity
-    std::string activeApp = cachedContext.getString("activeApp", "Unknown");
+    const std::string& activeApp = systemContext.activeApp;
     if (activeApp != "Unknown" && !activeApp.empty()) {
         fused << "Active: " << activeApp;
+        const std::string& category = systemContext.activeAppCategory;
+        if (!category.empty() && category != "unknown") {
+            fused << " (" << category << ")";
+        }
     }
 
-    // Voice transcription (if recent) - passed as parameter to avoid mutex deadlock
+    // Voice transcription (if recent)
     if (!voiceText.empty()) {
         if (fused.tellp() > 0) fused << " | ";
         fused << "Said: \"" << voiceText << "\"";
     }
 
     // Battery status (if critical)
-    int battery = cachedContext.getInt("battery", 100);
-    bool isCharging = cachedContext.getBool("isCharging", false);
+    int battery = systemContext.battery;
+    bool isCharging = systemContext.isCharging;
     if (battery < 20 && !isCharging) {
         if (fused.tellp() > 0) fused << " | ";
         fused << "⚠️ Low battery: " << battery << "%";
     }
 
     // Network status
-    bool networkConnected = cachedContext.getBool("networkConnected", true);
+    bool networkConnected = systemContext.networkConnected;
     if (!networkConnected) {
         if (fused.tellp() > 0) fused << " | ";
         fused << "⚠️ Offline";
     }
 
     // CPU usage (if high)
-    double cpuUsage = cachedContext.getDouble("cpuUsage", 0.0);
+    double cpuUsage = systemContext.cpuUsage;
     if (cpuUsage > 80.0) {
         if (fused.tellp() > 0) fused << " | ";
         fused << "⚠️ High CPU: " << static_cast<int>(cpuUsage) << "%";
@@ -368,34 +1356,93 @@ std::string ContextCollector::GenerateFusedContext(const std::string& voiceText)
 }
 
 void ContextCollector::StartPeriodicUpdate() {
-    if (updateThreadRunning.load()) {
+    if (updateThreadRunning.exchange(true)) {
         return; // Already running
     }
-    
-    updateThreadRunning.store(true);
-    updateThread = std::thread([this]() {
-        while (updateThreadRunning.load()) {
-            if (ShouldUpdateCache()) {
-                UpdateCache();
+
+    auto monitor = std::make_unique<EtwProcessMonitor>();
+    if (monitor->Start()) {
+        std::lock_guard<std::mutex> lock(cacheMutex);     // Snapshot builds read it under cacheMutex
+        processMonitor = std::move(monitor);
+    } else {
+        LOG_INFO("ContextCollector", "Per-process usage unavailable; topProcesses will be null");
+    }
+
+    samplerThread = std::thread(&ContextCollector::SamplerLoop, this);
+    updateThread = std::thread(&ContextCollector::WriterLoop, this);
+}
+
+void ContextCollector::SamplerLoop() {
+    Watchdog::Heartbeat heartbeat("context_sampler", "context", SAMPLER_STALL_MS);
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Context);
+    while (updateThreadRunning.load()) {
+        // Probes run without any lock the writer or readers need
+        heartbeat.Beat("probes");
+        if (UpdateCache()) {
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                refreshRequested = true;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            stateChanged.notify_all();
         }
-    });
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        heartbeat.Idle();
+        stateChanged.wait_for(lock, std::chrono::milliseconds(SAMPLER_TICK_MS * refreshScale.load()), [&]() {
+            return sampleRequested || !updateThreadRunning.load();
+        });
+        sampleRequested = false;
+    }
+}
+
+void ContextCollector::WriterLoop() {
+    Watchdog::Heartbeat heartbeat("context_update", "context", WRITER_STALL_MS);
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Context);
+    while (updateThreadRunning.load()) {
+        heartbeat.Beat("snapshot");
+        RefreshSnapshot();
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        uint64_t built = current ? current->stateVersion : 0;
+
+        // Rebuild as soon as a producer changes something or the sampler has
+        // new system fields, else on the refresh tick
+        std::unique_lock<std::mutex> lock(stateMutex);
+        heartbeat.Idle();
+        stateChanged.wait_for(lock, std::chrono::milliseconds(SNAPSHOT_REFRESH_MS * refreshScale.load()), [&]() {
+            return stateVersion != built || refreshRequested || !updateThreadRunning.load();
+        });
+        refreshRequested = false;
+    }
 }
 
 void ContextCollector::StopPeriodicUpdate() {
-    updateThreadRunning.store(false);
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        updateThreadRunning.store(false);
+    }
+    stateChanged.notify_all();
+    if (samplerThread.joinable()) {
+        samplerThread.join();
+    }
     if (updateThread.joinable()) {
         updateThread.join();
     }
+    std::unique_ptr<EtwProcessMonitor> monitor;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        monitor = std::move(processMonitor);
+    }
+    monitor.reset();                        // Stops the trace session outside the lock
 }
 
 ContextCollector::~ContextCollector() {
+    MemoryAccounting::Instance().Unregister(memoryReporterId);
     StopPeriodicUpdate();
-    
-    // Cleanup active app monitoring when the collector is destroyed
-    if (activeAppMonitoringInitialized.load()) {
+
+    // The last collector stops the process-wide window and network monitoring
+    std::lock_guard<std::mutex> lock(monitoringMutex);
+    if (--monitoringUsers == 0) {
         WindowsAPIs::CleanupActiveAppMonitoring();
-        activeAppMonitoringInitialized.store(false);
+        NetworkState::Instance().Stop();
     }
 }
\ No newline at end of file
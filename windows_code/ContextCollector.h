@@ -1,47 +1,469 @@
 #pragma once
-#include "third-party/include/json.hpp"
 #include "WindowsAPIs.h"
+#include "ContextHistory.h"
+#include "EventJournal.h"
+#include "EtwProcessMonitor.h"
+#include "PublishedState.h"
+#include "Deflate.h"
+#include "JsonWriter.h"
 #include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <array>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * ContextCollector - Fuses system, voice and camera state into /context
+ *
+ * Architecture:
+ *   Producers (audio, camera, model loaders) publish their fields as
+ *   immutable per-source values (PublishedState: copy, change, pointer swap)
+ *   and bump the state version; nothing holds two of these at once, so there
+ *   is no lock order to get wrong. A single writer thread (the
+ *   periodic update) rebuilds an immutable Snapshot - the document written
+ *   once by JsonWriter plus views of its top-level members - whenever the state version moves or every
+ *   SNAPSHOT_REFRESH_MS for metrics, and publishes it with an atomic
+ *   shared_ptr swap. Readers (HTTP handlers) only load that pointer: they
+ *   never take cacheMutex, never block the writer, and serialization happens
+ *   once per change instead of once per request. Compressed encodings of a
+ *   document are likewise built once, on first request, per version.
+ *
+ *   System fields come from per-source probes (app, power, CPU, memory,
+ *   network, location), each with its own TTL and cost budget, run by a
+ *   separate sampler thread that hands results to the writer. No reader or
+ *   snapshot rebuild ever waits on an OS API: a slow location query only
+ *   delays the location field. Sources are only re-probed while someone
+ *   reads their fields (NoteReader within DEMAND_WINDOW_MS); the app source
+ *   also refreshes on foreground-window events, the network source (a read
+ *   of NetworkState's event-driven snapshot) on network changes, and the
+ *   power source (PowerPolicy's notified state) on power changes. Each
+ *   probe's last duration is
+ *   published as probeLatencies. topProcesses (CPU and network leaders)
+ *   comes from kernel ETW events rather than probes (EtwProcessMonitor).
+ *   App switches and system samples are also published on the EventBus
+ *   (SetEventBus) for whoever else wants them.
+ *   Instances are independent: each owns its sampler and writer threads.
+ */
+class ContextFusion;
+class EventBus;
+class PowerPolicy;
 
 class ContextCollector {
+public:
+    // Immutable published view of the context, shared by every reader
+    struct Snapshot {
+        Snapshot() = default;
+        Snapshot(const Snapshot&) = delete;             // members point into serialized
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        std::string serialized;                         // The document, written once
+        // (key, serialized value) per top-level member, in document order, for patches
+        std::vector<std::pair<std::string_view, std::string_view>> members;
+        uint64_t version = 0;                           // Document version: changes with content
+        uint64_t stateVersion = 0;                      // State version the snapshot reflects
+        uint64_t fusedVersion = 0;                      // Of the fusedContext member (changes with its text)
+
+        // `serialized` per content coding, compressed on first request and
+        // shared by every snapshot with the same version
+        struct EncodedBodies {
+            std::once_flag gzipOnce;
+            std::once_flag deflateOnce;
+            std::once_flag messagePackOnce;
+            std::string gzip;
+            std::string deflate;
+            std::string messagePack;
+            std::atomic<size_t> bytes{0};              // Sum of the encodings made so far
+        };
+        std::shared_ptr<EncodedBodies> encoded;
+
+        // Gzip or Zlib ("deflate") encoding of `serialized`
+        const std::string& GetEncoded(Deflate::Container container) const;
+
+        // The document as a MessagePack map with the same keys and values
+        const std::string& GetMessagePack() const;
+
+        // Serialized value of a top-level member, or "" when absent
+        std::string_view FindMember(std::string_view key) const;
+
+        // A document of just the members named in keys, in document order,
+        // copied from the serialized values (unknown keys are left out)
+        std::string Project(const std::vector<std::string_view>& keys) const;
+    };
+
 private:
-    Json cachedContext;
-    std::chrono::steady_clock::time_point lastUpdate;
+    // System fields from WindowsAPIs (written only by probe passes);
+    // cacheMutex serializes the writers, readers never take it
+    // One RecentPeriodActiveApps entry, serialized once: a record only
+    // changes while it is the current app (its duration grows)
+    struct RecentApp {
+        StringInterner::Id appId = StringInterner::EMPTY;   // WindowsAPIs::GetActiveAppStrings
+        StringInterner::Id windowTitleId = StringInterner::EMPTY;
+        int durationSeconds = 0;
+        std::chrono::system_clock::time_point started;
+        std::string fragment;           // The entry's JSON object
+    };
+    static void BuildRecentAppFragment(RecentApp& app);
+    static constexpr size_t MAX_DWELL_APPS = 10;
+    struct SystemContext {
+        std::string activeApp;
+        std::string activeAppCategory;  // AppClassifier name ("ide", "meeting", ...)
+        int battery = 100;
+        bool isCharging = false;
+        double cpuUsage = -1.0;         // Percent; negative when unavailable (null)
+        std::vector<double> cpuCoreUsage;   // Percent per logical processor
+        double diskUsage = -1.0;        // Percent busy
+        double gpuUsage = -1.0;         // 3D engine percent
+        double memoryUsage = -1.0;      // Percent
+        double memoryUsedGB = -1.0;
+        double totalMemoryGB = -1.0;
+        bool networkConnected = true;
+        std::string networkType;
+        bool locationValid = false;
+        double locationLat = 0.0;
+        double locationLon = 0.0;
+        double locationAccuracy = 0.0;  // Meters
+        std::string locationTimestamp;  // When the fix was taken: fixes only update on movement
+        std::vector<RecentApp> recentApps;
+        std::vector<WindowsAPIs::AppDwellTime> appDwellTimes;  // Longest first; MAX_DWELL_APPS are published
+        std::string timestamp;
+    };
+    SystemContext systemContext;
     mutable std::mutex cacheMutex;
 
+    // === System sources ===
+    // Each owns some SystemContext fields and is re-probed when its TTL, times
+    // a backoff that doubles while its average probe cost exceeds the budget,
+    // has expired
+    enum class SourceId { App, Power, Cpu, Memory, Network, Location, Count };
+    struct Source {
+        const char* name;
+        int64_t ttlMs;
+        double budgetMs;
+        int64_t lastRunMs = 0;          // 0 = never probed (always due)
+        double averageCostMs = 0.0;     // EWMA of probe duration
+        int backoff = 1;                // TTL multiplier, 1..MAX_SOURCE_BACKOFF
+    };
+    static constexpr int MAX_SOURCE_BACKOFF = 8;
+    static constexpr int64_t APP_FALLBACK_TTL_MS = 5000;    // Titles can change without a window event
+    static constexpr int64_t DEMAND_WINDOW_MS = 10000;      // Readers this recent keep sources live
+    Source sources[static_cast<size_t>(SourceId::Count)];
+    uint64_t lastAppGeneration;             // WindowsAPIs::GetActiveAppGeneration at the last app probe
+    uint64_t lastNetworkGeneration;         // NetworkState::GetGeneration at the last probe pass
+    uint64_t lastPowerGeneration;           // PowerPolicy::GetStateGeneration at the last probe pass
+    std::atomic<int64_t> lastReaderMs;
+    // Per source (and for the LLM behind fusedContext), the last reader that
+    // wanted its fields; a reader of a few fields leaves the others idle
+    std::array<std::atomic<int64_t>, static_cast<size_t>(SourceId::Count)> sourceDemandMs;
+    std::atomic<int64_t> fusionDemandMs;
+    static bool FindFieldSource(std::string_view field, SourceId& id);
+
+    // Probe every due source (sampler thread only); returns whether any ran
+    bool UpdateCache();
+    void ProbeSource(SourceId id, SystemContext& fields);
+    void SamplerLoop();
+    static int64_t NowMs();
+    static constexpr int SAMPLER_TICK_MS = 250;     // Bounds how late a window event is noticed
+    static constexpr int SAMPLER_STALL_MS = 15000;  // Watchdog timeout for one probe pass
+    // Multiplies the source TTLs, the sampler tick and the refresh tick (SetRefreshScale)
+    std::atomic<int> refreshScale;
+    static constexpr int WRITER_STALL_MS = 5000;    // ... and one snapshot build
+
+    // Sampler and writer threads (periodic update)
+    std::thread samplerThread;
+    std::thread updateThread;
+    std::atomic<bool> updateThreadRunning;
+    bool refreshRequested;                  // Guarded by stateMutex; wakes the writer
+    bool sampleRequested;                   // Guarded by stateMutex; wakes the sampler
+
+    // Latest snapshot; only accessed through std::atomic_load / std::atomic_store
+    std::shared_ptr<const Snapshot> snapshot;
+    std::condition_variable snapshotPublished;      // Waits on stateMutex
+    static constexpr int SNAPSHOT_REFRESH_MS = 500;
+
+    // === Producer state ===
+    // One PublishedState slot per source: producers publish a new value,
+    // the writer loads each slot without a lock, and no code path ever holds
+    // two of them (nor waits on one while holding cacheMutex)
+
     // Voice transcription context
-    std::string latestVoiceTranscription;
-    mutable std::mutex voiceMutex;
+    struct VoiceState {
+        std::string transcription;
+        std::string partial;            // In-progress utterance (streaming), cleared on final
+        std::string decoded;            // Segments of a long utterance decoded so far, cleared on final
+        uint64_t decodedTrace = 0;      // Utterance the segments belong to
+        int64_t decodedUntilMs = 0;     // End of the last segment, into the utterance
+        float latencyMs = 0.0f;
+        int speaker = -1;               // SpeakerTracker id of the transcription; -1 unknown
+        std::string systemAudio;        // Last loopback utterance (remote speakers, playback)
+        std::string keyword;            // Last spotted keyword (KeywordSpotter, ahead of whisper)
+        float keywordScore = 0.0f;
+        std::string keywordTimestamp;
+        uint64_t keywordCount = 0;      // Tells a repeated keyword from the same one still published
+    };
+    PublishedState<VoiceState> voice;
+    void PublishTranscription(const std::string& transcription, const float* latencyMs,   // Null: keep latency
+                              int speaker = -1);
 
     // Camera vision context
-    std::string latestCameraDescription;
-    float latestCameraLatency;
-    mutable std::mutex cameraMutex;
+    struct CameraState {
+        std::string description;
+        std::string timestamp;          // Refreshed even when gating reuses the description
+        float latencyMs = 0.0f;
+        bool reused = false;            // Scene unchanged, previous description reused
+        std::string partial;            // Caption still decoding (streaming), cleared on final
+        uint64_t scenesDescribed = 0;
+        uint64_t scenesSkipped = 0;
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+    };
+    PublishedState<CameraState> camera;
+
+    // Foreground window content (ScreenCapture's changed region, captioned by the camera engine)
+    struct ScreenState {
+        std::string description;
+        std::string window;             // Title of the window it describes
+        std::string timestamp;
+        float latencyMs = 0.0f;
+        float changedShare = 0.0f;      // Of the window, the part that changed and was captioned
+        std::string text;               // OCR of the window, lines top to bottom
+        std::string textWindow;
+        std::string textTimestamp;
+        float textLatencyMs = 0.0f;
+    };
+    PublishedState<ScreenState> screen;
+
+    // External sensor readings from /ingest, published under "sensors"
+    struct SensorReading {
+        std::string value;              // Raw JSON value (validated by the producer's parser)
+        std::string timestamp;
+        float latencyMs = 0.0f;
+    };
+    static constexpr size_t MAX_SENSORS = 64;
+    PublishedState<std::map<std::string, SensorReading>> sensors;
+
+    // Model readiness per subsystem ("voice", "camera"): loading/ready/unloaded/failed
+    PublishedState<std::map<std::string, std::string>> modelStatus;
+
+    // Top processes by CPU and network from kernel ETW events (null when the
+    // session can't start, e.g. not elevated); started with the periodic
+    // update, set and read under cacheMutex
+    std::unique_ptr<EtwProcessMonitor> processMonitor;
+
+    // Performance metrics of the system probes (milliseconds)
+    struct ProbeMetrics {
+        float contextUpdateLatency = 0.0f;                  // Whole probe pass
+        std::array<float, static_cast<size_t>(SourceId::Count)> probeLatencyMs{};
+    };
+    PublishedState<ProbeMetrics> probeMetrics;
+
+    // Change counter for push clients: voice, camera, model status and the
+    // active app (not metrics or timestamps, which change every refresh)
+    uint64_t stateVersion;
+    std::string lastActiveApp;
+    mutable std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    void BumpStateVersion();
+
+    // Document versions for /context?since=: a new version whenever a
+    // snapshot's content differs from the last one; recent versions are kept
+    // so a client can get a patch against its copy
+    static constexpr size_t DOCUMENT_HISTORY = 16;
+    uint64_t documentVersion;                       // Guarded by cacheMutex
+    std::deque<std::shared_ptr<const Snapshot>> documentHistory;
+    std::mutex documentMutex;
+
+    // MemoryAccounting reporter: published documents and the history store
+    uint64_t memoryReporterId;
+
+    // Time series of system samples (one per sampler pass) and voice/camera
+    // events, for /history
+    ContextHistory history;
+
+    void WriteTopProcesses(JsonWriter& writer) const;
+
+    // Durable copy of voice, camera and app-switch events (null until OpenJournal)
+    std::unique_ptr<EventJournal> journal;
+    void JournalEvent(EventJournal::Kind kind, const std::string& text);
+
+    // "2024-01-01T12:00:00.000+08:00" in local time
+    static std::string FormatLocalTime(std::chrono::system_clock::time_point time);
+
+    // AppSwitch and SystemSample events go here (see SetEventBus)
+    std::atomic<EventBus*> eventBus{nullptr};
 
-    // Performance metrics (latencies in milliseconds)
-    float latestVoiceLatency;
-    float latestContextUpdateLatency;
-    mutable std::mutex metricsMutex;
+    // Power notifications behind the power source (see SetPowerPolicy)
+    std::atomic<const PowerPolicy*> powerPolicy{nullptr};
 
-    void UpdateCache();
-    bool ShouldUpdateCache();
+    // Optional LLM summary behind fusedContext (see SetFusionEngine); guarded by cacheMutex
+    ContextFusion* fusion = nullptr;
+    std::string BuildFusionInputs(const std::string& voiceText, const std::string& cameraText) const;
+
+    // fusedContext as of the last build, redone only when one of its inputs
+    // changed (or an LLM summary of them may have landed); guarded by cacheMutex
+    struct FusedSummary {
+        // Inputs it reflects: the app, the alert thresholds crossed, voice, camera
+        std::string activeApp;
+        std::string activeAppCategory;
+        int lowBattery = -1;            // Percent when low and discharging, else -1
+        bool offline = false;
+        int highCpu = -1;               // Percent when above 80, else -1
+        std::string voiceText;
+        std::string cameraText;
+        bool valid = false;
+
+        std::string inputs;             // BuildFusionInputs of the above (with fusion)
+        std::string text;
+        bool fromModel = false;         // The LLM's summary: final for these inputs
+        bool submitted = false;         // Handed to the LLM (once someone read fusedContext)
+        uint64_t version = 0;           // Bumped whenever text changes
+    };
+    FusedSummary fused;
+    const FusedSummary& UpdateFusedContext(const std::string& voiceText, const std::string& cameraText);
+
+    // Build and publish a snapshot from the current fields (cacheMutex held)
+    void PublishSnapshot();
+    void RefreshSnapshot();
+    void WriterLoop();
+
+    static std::string CleanTranscription(const std::string& transcription);
 
 public:
     ContextCollector();
     ~ContextCollector(); // Add destructor
 
-    Json CollectCurrentContext();
+    std::string CollectCurrentContext();    // Serialized document of the latest snapshot
+
+    /**
+     * @brief Restore the last captions, recent apps and history from the
+     *        journal in `directory`, then keep appending to it
+     * @return false (and logs) if the journal can't be opened; the collector
+     *         then runs without one
+     *
+     * Call before StartPeriodicUpdate and before producers start.
+     */
+    bool OpenJournal(const std::string& directory);
+
+    // Someone is consuming the context (HTTP poll, stream subscriber): keeps
+    // system sources refreshing, and wakes them at once if they had gone idle
+    void NoteReader();
+
+    // ... of only these top-level fields (/context?fields=): the sources
+    // behind other fields are not re-probed on its account, nor is the LLM
+    // summary behind fusedContext requested
+    void NoteReader(const std::vector<std::string_view>& fields);
+
+    // Latest published snapshot (built on the spot, without probing, before
+    // the writer's first pass)
+    std::shared_ptr<const Snapshot> GetSnapshot();
+
+    // Block until a snapshot newer than state version `since` is published or
+    // timeoutMs elapses; returns the latest snapshot either way
+    std::shared_ptr<const Snapshot> WaitForSnapshot(uint64_t since, int timeoutMs);
+
+    // Current context relative to a version the client already has
+    struct ContextDelta {
+        uint64_t version = 0;
+        bool notModified = false;   // Client's version is current: nothing to send
+        bool isPatch = false;       // body is a JSON merge patch (RFC 7396) against `since`
+        std::string body;           // The merge patch (isPatch only)
+        std::shared_ptr<const Snapshot> snapshot;   // Latest snapshot; the full document when not a patch
+    };
+    ContextDelta CollectContextSince(uint64_t since);
     void StartPeriodicUpdate(); // Start background thread for periodic updates
     void StopPeriodicUpdate();
 
     // Voice transcription update
     void UpdateVoiceContext(const std::string& transcription);
     void UpdateVoiceContext(const std::string& transcription, float latencyMs);
+    // ... with the speaker id the audio engine attached (-1 unknown), published as "voiceSpeaker"
+    void UpdateVoiceContext(const std::string& transcription, float latencyMs, int speaker);
+
+    // Partial (streaming) hypothesis for the utterance still being spoken
+    void UpdateVoicePartial(const std::string& partial);
+
+    // Segment of a long utterance decoded ahead of its transcription, published
+    // as "voiceDecoded" (the utterance's segments so far) and "voiceDecodedUntilMs"
+    void UpdateVoiceSegment(uint64_t traceId, int index, const std::string& text, int64_t endMs);
+
+    // System audio (loopback) transcription, published as "systemAudioTranscription"
+    void UpdateSystemAudioContext(const std::string& transcription);
+
+    // Keyword from the audio engine's spotting stage, published as "voiceKeyword"
+    void UpdateVoiceKeyword(const std::string& keyword, float score);
 
     // Camera vision update
     void UpdateCameraContext(const std::string& description, float latencyMs);
+    void UpdateCameraContext(const std::string& description, float latencyMs, bool reused);
+
+    // Caption text so far while the camera decoder is still running
+    void UpdateCameraPartial(const std::string& partial);
+
+    // Caption of what changed in the foreground window, published as "screenDescription"
+    void UpdateScreenContext(const std::string& description, const std::string& window, float latencyMs,
+                             float changedShare);
+
+    // Text of the foreground window, published as "screenText"
+    void UpdateScreenText(const std::string& text, const std::string& window, float latencyMs);
+
+    // Scene-change gating and feature-cache counters from CameraVisionEngine
+    void UpdateCameraStats(uint64_t scenesDescribed, uint64_t scenesSkipped,
+                           uint64_t cacheHits, uint64_t cacheMisses);
+
+    // One event from an external producer (see /ingest)
+    struct IngestEvent {
+        enum class Kind { Camera, Voice, Sensor };
+        Kind kind = Kind::Sensor;
+        std::string name;               // Sensor name (Sensor only)
+        std::string text;               // Caption or transcription; a sensor's raw JSON value
+        std::string timestamp;          // Producer's timestamp; arrival time when empty
+        float latencyMs = 0.0f;
+    };
+
+    /**
+     * @brief Apply a batch of events in one critical section, in order
+     * @return Number applied (sensors past MAX_SENSORS distinct names are dropped)
+     *
+     * Each source's share of the batch is published at once, and the state
+     * version is bumped once, after the last; a snapshot built mid-batch may
+     * see one source's events before another's.
+     */
+    size_t IngestEvents(const std::vector<IngestEvent>& events);
+
+    // Background model loading state, reported as "<subsystem>ModelStatus"
+    void UpdateModelStatus(const std::string& subsystem, const std::string& status);
+
+    // State version (see stateVersion)
+    uint64_t GetStateVersion() const;
+
+    // Recorded samples and events; samples only accrue while the context is
+    // being read (see NoteReader)
+    const ContextHistory& GetHistory() const { return history; }
+
+    // LLM summaries for fusedContext, the heuristic standing in until one
+    // matches the current inputs; null detaches. Call before fusion->Start(),
+    // and detach before the engine goes away
+    void SetFusionEngine(ContextFusion* engine);
+
+    // Publish app switches and system samples on the bus; null detaches.
+    // The bus has to outlive the collector or be detached first
+    void SetEventBus(EventBus* bus);
+
+    // Take battery and isCharging from the policy's notified state instead
+    // of GetSystemPowerStatus; null detaches. Same lifetime rule as the bus
+    void SetPowerPolicy(const PowerPolicy* policy);
+
+    // Sample and refresh `scale` times less often (nobody at the machine:
+    // PresenceMonitor); 1 restores the normal rates at once
+    void SetRefreshScale(int scale);
 
     // Generate fused context summary
     std::string GenerateFusedContext() const;
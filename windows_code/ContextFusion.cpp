@@ -0,0 +1,386 @@
+#include "ContextFusion.h"
+#include "CpuBudget.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+#include <algorithm>
+
+#ifdef PERCEPTION_LLAMA_FUSION
+#include "llama.h"
+#endif
+
+namespace {
+
+const char* const SYSTEM_PROMPT =
+    "You describe what a computer user is doing right now, for another assistant. "
+    "You get the active app, alerts, what their camera sees and what they last said. "
+    "Reply with one sentence of at most 25 words. No preamble, no quotes.";
+
+} // namespace
+
+ContextFusion::ContextFusion()
+    : model(nullptr), context(nullptr), sampler(nullptr), vocab(nullptr), batchTokens(0), systemTokens(0),
+      hasPending(false), stopRequested(false), memoryReporterId(0), modelBytes(0) {
+    memoryReporterId = MemoryAccounting::Instance().Register([this](MemoryAccounting::Entries& entries) {
+        entries.push_back({ "llm_model", "context_fusion", modelBytes.load() });
+    });
+}
+
+ContextFusion::~ContextFusion() {
+    MemoryAccounting::Instance().Unregister(memoryReporterId);
+    Stop();
+    Release();
+}
+
+bool ContextFusion::IsAvailable() {
+#ifdef PERCEPTION_LLAMA_FUSION
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string ContextFusion::TrimField(const std::string& text) {
+    if (text.size() <= MAX_FIELD_CHARS) {
+        return text;
+    }
+    // Keep the end, starting at a word (and so never inside a UTF-8 sequence)
+    size_t start = text.find(' ', text.size() - MAX_FIELD_CHARS);
+    return start == std::string::npos ? std::string() : "..." + text.substr(start);
+}
+
+ContextFusion::Stats ContextFusion::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// ============================================================================
+// Model
+// ============================================================================
+
+#ifdef PERCEPTION_LLAMA_FUSION
+
+bool ContextFusion::Initialize(const Config& fusionConfig) {
+    Release();
+    config = fusionConfig;
+    static std::once_flag backendOnce;
+    std::call_once(backendOnce, [] { llama_backend_init(); });
+
+    llama_model_params modelParams = llama_model_default_params();
+    model = llama_model_load_from_file(config.modelPath.c_str(), modelParams);
+    if (!model) {
+        LOG_WARNING("Fusion", "Failed to load " << config.modelPath);
+        return false;
+    }
+    vocab = llama_model_get_vocab(model);
+    const char* modelTemplate = llama_model_chat_template(model, nullptr);
+    chatTemplate = modelTemplate ? modelTemplate : "chatml";
+
+    int threads = config.threads > 0 ? config.threads
+                                     : CpuBudget::Instance().Get(CpuBudget::Subsystem::Fusion).threads;
+    llama_context_params contextParams = llama_context_default_params();
+    contextParams.n_ctx = static_cast<uint32_t>(config.contextTokens);
+    contextParams.n_batch = (std::min)(512u, contextParams.n_ctx);
+    contextParams.n_threads = threads;
+    contextParams.n_threads_batch = threads;
+    contextParams.abort_callback = &ContextFusion::AbortCallback;
+    contextParams.abort_callback_data = this;
+    context = llama_init_from_model(model, contextParams);
+    if (!context) {
+        LOG_WARNING("Fusion", "Failed to create a llama.cpp context");
+        Release();
+        return false;
+    }
+    batchTokens = static_cast<int>(llama_n_batch(context));
+
+    sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    llama_sampler_chain_add(sampler, llama_sampler_init_greedy());
+
+    // The system prompt is whatever two renders with different inputs share;
+    // prefill it now, and no later prompt diverges before it
+    std::vector<int32_t> first;
+    std::vector<int32_t> second;
+    if (!Tokenize(RenderPrompt("App: a"), first) || !Tokenize(RenderPrompt("Voice: b"), second)) {
+        Release();
+        return false;
+    }
+    size_t shared = 0;
+    while (shared < first.size() && shared < second.size() && first[shared] == second[shared]) {
+        ++shared;
+    }
+    deadline = std::chrono::steady_clock::time_point::max();
+    if (shared == 0 || !Decode(first.data(), shared)) {
+        LOG_WARNING("Fusion", "System prompt prefill failed");
+        Release();
+        return false;
+    }
+    systemTokens = shared;
+
+    modelBytes = llama_model_size(model);
+    LOG_INFO("Fusion", "Context fusion ready: " << config.modelPath << " (" << (modelBytes.load() >> 20) << " MB, "
+             << threads << " threads, system prompt " << systemTokens << " tokens cached)");
+    return true;
+}
+
+void ContextFusion::Release() {
+    if (sampler) {
+        llama_sampler_free(sampler);
+        sampler = nullptr;
+    }
+    if (context) {
+        llama_free(context);
+        context = nullptr;
+    }
+    if (model) {
+        llama_model_free(model);
+        model = nullptr;
+    }
+    vocab = nullptr;
+    cachedTokens.clear();
+    systemTokens = 0;
+    modelBytes = 0;
+}
+
+bool ContextFusion::AbortCallback(void* data) {
+    const ContextFusion* fusion = static_cast<ContextFusion*>(data);
+    return fusion->aborting.load() || std::chrono::steady_clock::now() > fusion->deadline;
+}
+
+std::string ContextFusion::RenderPrompt(const std::string& inputs) const {
+    llama_chat_message messages[] = {
+        { "system", SYSTEM_PROMPT },
+        { "user", inputs.c_str() },
+    };
+    std::string prompt(1024 + inputs.size(), '\0');
+    int length = llama_chat_apply_template(chatTemplate.c_str(), messages, 2, true, &prompt[0],
+                                           static_cast<int32_t>(prompt.size()));
+    if (length > static_cast<int>(prompt.size())) {
+        prompt.resize(length);
+        length = llama_chat_apply_template(chatTemplate.c_str(), messages, 2, true, &prompt[0], length);
+    }
+    prompt.resize((std::max)(0, length));
+    return prompt;
+}
+
+bool ContextFusion::Tokenize(const std::string& text, std::vector<int32_t>& tokens) const {
+    tokens.resize(text.size() + 8);
+    int count = llama_tokenize(vocab, text.c_str(), static_cast<int32_t>(text.size()), tokens.data(),
+                               static_cast<int32_t>(tokens.size()), true, true);
+    if (count < 0) {
+        tokens.resize(-count);
+        count = llama_tokenize(vocab, text.c_str(), static_cast<int32_t>(text.size()), tokens.data(),
+                               static_cast<int32_t>(tokens.size()), true, true);
+    }
+    if (count <= 0) {
+        LOG_WARNING("Fusion", "Tokenization failed");
+        tokens.clear();
+        return false;
+    }
+    tokens.resize(count);
+    return true;
+}
+
+bool ContextFusion::Decode(const int32_t* tokens, size_t count) {
+    for (size_t done = 0; done < count;) {
+        int chunk = static_cast<int>((std::min)(count - done, static_cast<size_t>(batchTokens)));
+        llama_batch batch = llama_batch_get_one(const_cast<llama_token*>(tokens + done), chunk);
+        if (llama_decode(context, batch) != 0) {
+            // Aborted or failed mid-batch: forget whatever part of it landed
+            llama_memory_seq_rm(llama_get_memory(context), 0, static_cast<llama_pos>(cachedTokens.size()), -1);
+            return false;
+        }
+        cachedTokens.insert(cachedTokens.end(), tokens + done, tokens + done + chunk);
+        done += chunk;
+    }
+    return true;
+}
+
+bool ContextFusion::Summarize(const std::string& inputs, std::string& summary, bool& missedDeadline) {
+    TRACE_ZONE("ContextFusion::Summarize");
+    missedDeadline = false;
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.deadlineMs);
+
+    std::vector<int32_t> prompt;
+    if (!Tokenize(RenderPrompt(inputs), prompt)) {
+        return false;
+    }
+    if (prompt.size() + config.maxTokens > static_cast<size_t>(config.contextTokens)) {
+        LOG_WARNING("Fusion", "Prompt of " << prompt.size() << " tokens doesn't fit the context");
+        return false;
+    }
+
+    // Keep the longest prefix already cached (the system prompt at least); the
+    // last prompt token is always decoded again, since its logits seed the reply
+    size_t keep = 0;
+    while (keep < cachedTokens.size() && keep < prompt.size() && cachedTokens[keep] == prompt[keep]) {
+        ++keep;
+    }
+    keep = (std::min)(keep, prompt.size() - 1);
+    llama_memory_seq_rm(llama_get_memory(context), 0, static_cast<llama_pos>(keep), -1);
+    cachedTokens.resize(keep);
+
+    bool prefilled = Decode(prompt.data() + keep, prompt.size() - keep);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.reusedTokens += keep;
+        stats.prefilledTokens += prompt.size() - keep;
+    }
+    if (!prefilled) {
+        missedDeadline = std::chrono::steady_clock::now() > deadline;
+        return false;
+    }
+
+    // Greedy, one line
+    std::string text;
+    llama_sampler_reset(sampler);
+    for (int i = 0; i < config.maxTokens; ++i) {
+        llama_token token = llama_sampler_sample(sampler, context, -1);
+        if (llama_vocab_is_eog(vocab, token)) {
+            break;
+        }
+        char piece[128];
+        int length = llama_token_to_piece(vocab, token, piece, sizeof(piece), 0, false);
+        if (length > 0) {
+            text.append(piece, length);
+        }
+        if (text.find('\n') != std::string::npos) {
+            break;
+        }
+        if (std::chrono::steady_clock::now() > deadline || !Decode(&token, 1)) {
+            missedDeadline = std::chrono::steady_clock::now() > deadline;
+            return false;
+        }
+    }
+
+    // First line, trimmed
+    text = text.substr(0, text.find('\n'));
+    size_t first = text.find_first_not_of(" \t\"");
+    size_t last = text.find_last_not_of(" \t\"");
+    summary = first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+    return !summary.empty();
+}
+
+#else
+
+bool ContextFusion::Initialize(const Config& fusionConfig) {
+    config = fusionConfig;
+    LOG_WARNING("Fusion", "Built without llama.cpp (PERCEPTION_LLAMA_FUSION); fusedContext stays heuristic");
+    return false;
+}
+
+void ContextFusion::Release() {
+}
+
+bool ContextFusion::AbortCallback(void*) {
+    return true;
+}
+
+std::string ContextFusion::RenderPrompt(const std::string& inputs) const {
+    return inputs;
+}
+
+bool ContextFusion::Tokenize(const std::string&, std::vector<int32_t>& tokens) const {
+    tokens.clear();
+    return false;
+}
+
+bool ContextFusion::Decode(const int32_t*, size_t) {
+    return false;
+}
+
+bool ContextFusion::Summarize(const std::string&, std::string&, bool& missedDeadline) {
+    missedDeadline = false;
+    return false;
+}
+
+#endif
+
+// ============================================================================
+// Worker
+// ============================================================================
+
+void ContextFusion::Start() {
+    if (!context || worker.joinable()) {
+        return;
+    }
+    stopRequested = false;
+    aborting = false;
+    worker = std::thread(&ContextFusion::RunWorker, this);
+}
+
+void ContextFusion::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    aborting = true;
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void ContextFusion::Submit(const std::string& inputs) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (inputs == summaryInputs || inputs == runningInputs || (hasPending && inputs == pendingInputs)) {
+            return;
+        }
+        pendingInputs = inputs;
+        hasPending = true;
+    }
+    wake.notify_one();
+}
+
+bool ContextFusion::GetSummary(const std::string& inputs, std::string& summary) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (summaryText.empty() || inputs != summaryInputs) {
+        return false;
+    }
+    summary = summaryText;
+    return true;
+}
+
+void ContextFusion::RunWorker() {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Fusion);
+    TRACE_THREAD("Context fusion");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopRequested || hasPending; });
+        if (stopRequested) {
+            break;
+        }
+        runningInputs = std::move(pendingInputs);
+        hasPending = false;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        std::string summary;
+        bool missedDeadline = false;
+        bool made = Summarize(runningInputs, summary, missedDeadline);
+        float latencyMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        if (made) {
+            summaryInputs = runningInputs;
+            summaryText = summary;
+            stats.summaries++;
+            stats.lastLatencyMs = latencyMs;
+        } else if (missedDeadline) {
+            stats.deadlineMisses++;
+        }
+        runningInputs.clear();
+
+        if (made) {
+            LOG_DEBUG("Fusion", "Summary in " << static_cast<int>(latencyMs) << "ms: " << summary);
+            if (summaryCallback) {
+                lock.unlock();
+                summaryCallback();
+                lock.lock();
+            }
+        } else if (missedDeadline) {
+            LOG_DEBUG("Fusion", "Summary dropped after the " << config.deadlineMs << "ms deadline");
+        }
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct llama_model;
+struct llama_context;
+struct llama_sampler;
+struct llama_vocab;
+
+/**
+ * ContextFusion - Local LLM summary of app, voice and camera state
+ *
+ * Optional stage behind ContextCollector's fusedContext: a small instruct
+ * model (GGUF, run by llama.cpp) turns the active app, camera caption and
+ * last utterance into one short sentence. Compiled in only with
+ * PERCEPTION_LLAMA_FUSION; otherwise Initialize() fails and the collector
+ * keeps its string heuristics.
+ *
+ * Incremental prefill:
+ *   The prompt is the model's chat template around a fixed system prompt and
+ *   a state block whose lines are ordered from least to most volatile (app,
+ *   alerts, camera, voice). The tokens held in the KV cache are remembered;
+ *   a new prompt keeps their longest common prefix, and only the tail after
+ *   it is evicted and prefilled again. The system prompt is prefilled once in
+ *   Initialize and never leaves the cache, so a new utterance costs a line
+ *   of prefill rather than the whole prompt.
+ *
+ * Scheduling:
+ *   Submit() never blocks and the latest submission wins: one worker at the
+ *   lowest priority (CpuBudget::Subsystem::Fusion) summarizes the newest
+ *   inputs, and states overtaken while it was busy are never run. Prefill and
+ *   decode share a deadline; a summary that misses it is dropped (the
+ *   heuristic stays). A finished summary is kept with its inputs, so
+ *   unchanged inputs never reach the model again.
+ *
+ * Usage:
+ *   ContextFusion fusion;
+ *   if (fusion.Initialize(config)) { fusion.Start(); }
+ *   fusion.Submit(inputs);                            // snapshot writer, every build
+ *   if (fusion.GetSummary(inputs, summary)) { ... }   // only a summary of exactly these inputs
+ */
+class ContextFusion {
+public:
+    struct Config {
+        std::string modelPath;          // GGUF instruct model
+        int threads = 0;                // 0: CpuBudget's Fusion allocation
+        int contextTokens = 1024;       // KV cache length
+        int maxTokens = 48;             // Summary budget
+        int deadlineMs = 3000;          // Prefill + decode, per summary
+    };
+
+    static constexpr size_t MAX_FIELD_CHARS = 300;  // Per input line; see TrimField
+
+    ContextFusion();
+    ~ContextFusion();
+
+    ContextFusion(const ContextFusion&) = delete;
+    ContextFusion& operator=(const ContextFusion&) = delete;
+
+    /**
+     * @brief Whether this build links llama.cpp (PERCEPTION_LLAMA_FUSION)
+     */
+    static bool IsAvailable();
+
+    /**
+     * @brief Load the model, create the context and prefill the system prompt
+     */
+    bool Initialize(const Config& config);
+
+    /**
+     * @brief Start / stop (and join) the worker; Stop is also done by the destructor
+     *
+     * Stop aborts a summary in progress (llama.cpp's abort callback) rather
+     * than waiting for it.
+     */
+    void Start();
+    void Stop();
+
+    /**
+     * @brief Called on the worker after each new summary (e.g. to republish the context)
+     *
+     * Set before Start().
+     */
+    void SetSummaryCallback(const std::function<void()>& callback) { summaryCallback = callback; }
+
+    /**
+     * @brief Ask for a summary of inputs (non-blocking; replaces any not yet started)
+     */
+    void Submit(const std::string& inputs);
+
+    /**
+     * @brief Summary of exactly these inputs, if one has been made
+     */
+    bool GetSummary(const std::string& inputs, std::string& summary) const;
+
+    /**
+     * @brief Cut a field to MAX_FIELD_CHARS, keeping the end (the latest words of speech)
+     */
+    static std::string TrimField(const std::string& text);
+
+    struct Stats {
+        uint64_t summaries = 0;         // Summaries made
+        uint64_t deadlineMisses = 0;    // Dropped for running past the deadline
+        uint64_t prefilledTokens = 0;   // Prompt tokens decoded
+        uint64_t reusedTokens = 0;      // Prompt tokens kept from the KV cache
+        float lastLatencyMs = 0.0f;
+    };
+    Stats GetStats() const;
+
+private:
+    Config config;
+    llama_model* model;
+    llama_context* context;
+    llama_sampler* sampler;
+    const llama_vocab* vocab;
+    std::string chatTemplate;
+    int batchTokens;
+
+    // Tokens whose KV is in the cache, positions 0..n-1 (worker only after Initialize)
+    std::vector<int32_t> cachedTokens;
+    size_t systemTokens;                        // Leading cachedTokens shared by every prompt
+
+    // Prefill/decode deadline and Stop's abort, read by llama.cpp's abort callback
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> aborting{false};
+    static bool AbortCallback(void* data);
+
+    // Latest-wins mailbox and the cached summary
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::string pendingInputs;
+    bool hasPending;
+    std::string runningInputs;                  // Being summarized now
+    std::string summaryInputs;
+    std::string summaryText;
+    Stats stats;
+    bool stopRequested;
+    std::thread worker;
+    std::function<void()> summaryCallback;
+
+    uint64_t memoryReporterId;
+    std::atomic<uint64_t> modelBytes;
+
+    void RunWorker();
+
+    /**
+     * @brief Chat-templated prompt: system prompt plus inputs as the user turn
+     */
+    std::string RenderPrompt(const std::string& inputs) const;
+    bool Tokenize(const std::string& text, std::vector<int32_t>& tokens) const;
+
+    /**
+     * @brief Decode tokens after cachedTokens in batches, appending them as they land
+     * @return false on error or deadline (the KV cache is trimmed back to cachedTokens)
+     */
+    bool Decode(const int32_t* tokens, size_t count);
+
+    /**
+     * @brief Prefill what changed since the last prompt, then decode one line greedily
+     */
+    bool Summarize(const std::string& inputs, std::string& summary, bool& missedDeadline);
+
+    void Release();
+};
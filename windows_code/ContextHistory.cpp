@@ -0,0 +1,283 @@
+#include "ContextHistory.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const double NO_READING = std::numeric_limits<double>::quiet_NaN();
+
+// Negative: no reading. Rounded to float, the precision history always kept:
+// the zero low mantissa bits are what lets XOR coding shrink them
+double Reading(double value) {
+    return value < 0 ? NO_READING : static_cast<double>(static_cast<float>(value));
+}
+
+}  // namespace
+
+ContextHistory::ContextHistory()
+    : samples(COLUMN_COUNT, SAMPLE_CAPACITY)
+    , events(EVENT_CAPACITY)
+    , eventHead(0)
+    , eventCount(0)
+    , appNames(1)
+{
+}
+
+size_t ContextHistory::GetMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    size_t bytes = samples.GetMemoryUsage() + events.capacity() * sizeof(Event);
+    for (const Event& event : events) {
+        bytes += event.text.capacity();
+    }
+    for (const std::string& name : appNames) {
+        bytes += sizeof(name) + name.capacity();
+    }
+    return bytes;
+}
+
+int64_t ContextHistory::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+void ContextHistory::RecordSample(int64_t timeMs, double cpuUsage, double memoryUsage, int battery,
+                                  const std::string& activeApp) {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    if (!samples.Empty() && timeMs - samples.LastTimeMs() < MIN_SAMPLE_INTERVAL_MS) {
+        return;
+    }
+
+    auto meanLatency = [](PendingLatency& pending) {
+        double mean = pending.count > 0 ? Reading(pending.sum / pending.count) : NO_READING;
+        pending = PendingLatency();
+        return mean;
+    };
+    double row[COLUMN_COUNT];
+    row[CPU_COLUMN] = Reading(cpuUsage);
+    row[MEMORY_COLUMN] = Reading(memoryUsage);
+    row[BATTERY_COLUMN] = battery < 0 ? NO_READING : (std::min)(battery, 100);
+    row[APP_COLUMN] = InternApp(activeApp);
+    row[VOICE_LATENCY_COLUMN] = meanLatency(voiceLatency);
+    row[CAMERA_LATENCY_COLUMN] = meanLatency(cameraLatency);
+    samples.Append(timeMs, row);
+}
+
+void ContextHistory::RecordLatency(Field kind, double latencyMs) {
+    if (latencyMs < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(historyMutex);
+    PendingLatency& pending = kind == VOICE ? voiceLatency : cameraLatency;
+    pending.sum += latencyMs;
+    pending.count++;
+}
+
+void ContextHistory::RecordEvent(int64_t timeMs, Field kind, std::string_view text) {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    if (eventCount > 0) {
+        timeMs = (std::max)(timeMs, events[EventPosition(eventCount - 1)].timeMs);
+    }
+
+    // Overwriting reuses the slot's string capacity
+    Event& event = events[eventHead];
+    event.timeMs = timeMs;
+    event.kind = kind;
+    event.text.assign(text.data(), (std::min)(text.size(), MAX_EVENT_TEXT));
+
+    eventHead = (eventHead + 1) % EVENT_CAPACITY;
+    eventCount = (std::min)(eventCount + 1, EVENT_CAPACITY);
+}
+
+void ContextHistory::GetRecentEvents(int64_t sinceMs, size_t maxCount, std::vector<RecentEvent>& out) const {
+    out.clear();
+    std::lock_guard<std::mutex> lock(historyMutex);
+    for (size_t logical = eventCount; logical > 0 && out.size() < maxCount; --logical) {
+        const Event& event = events[EventPosition(logical - 1)];
+        if (event.timeMs < sinceMs) {
+            break;
+        }
+        out.push_back({ event.timeMs, event.kind, event.text });
+    }
+}
+
+uint16_t ContextHistory::InternApp(const std::string& name) {
+    auto it = appIds.find(name);
+    if (it != appIds.end()) {
+        return it->second;
+    }
+    if (name.empty() || appNames.size() >= MAX_APP_NAMES) {
+        return 0;
+    }
+    uint16_t id = static_cast<uint16_t>(appNames.size());
+    appNames.push_back(name);
+    appIds.emplace(name, id);
+    return id;
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+size_t ContextHistory::EventPosition(size_t logical) const {
+    return (eventHead + EVENT_CAPACITY - eventCount + logical) % EVENT_CAPACITY;
+}
+
+size_t ContextHistory::FirstEventAtOrAfter(int64_t timeMs) const {
+    size_t low = 0;
+    size_t high = eventCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (events[EventPosition(middle)].timeMs < timeMs) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void ContextHistory::Write(JsonWriter& writer, const Query& query) const {
+    int64_t fromMs = query.fromMs;
+    int64_t toMs = (std::max)(query.toMs, fromMs);
+    size_t maxPoints = (std::max)(size_t(1), (std::min)(query.maxPoints, MAX_QUERY_POINTS));
+    int64_t span = toMs - fromMs + 1;
+    int64_t bucketMs = (std::max)(MIN_SAMPLE_INTERVAL_MS, (span + static_cast<int64_t>(maxPoints) - 1) /
+                                                               static_cast<int64_t>(maxPoints));
+
+    // Only the requested columns are decoded
+    static const struct { Field field; Column column; } FIELD_COLUMNS[] = {
+        {CPU, CPU_COLUMN}, {MEMORY, MEMORY_COLUMN}, {BATTERY, BATTERY_COLUMN}, {APP, APP_COLUMN},
+        {VOICE_LATENCY, VOICE_LATENCY_COLUMN}, {CAMERA_LATENCY, CAMERA_LATENCY_COLUMN},
+    };
+    uint32_t columnMask = 0;
+    for (const auto& entry : FIELD_COLUMNS) {
+        if (query.fields & entry.field) {
+            columnMask |= 1u << entry.column;
+        }
+    }
+    std::vector<MetricColumns::Bucket> buckets;
+
+    std::lock_guard<std::mutex> lock(historyMutex);
+    samples.Downsample(fromMs, toMs, bucketMs, buckets, columnMask);
+
+    writer.BeginObject();
+    writer.Key("from").Int(fromMs);
+    writer.Key("to").Int(toMs);
+    writer.Key("bucketMs").Int(bucketMs);
+
+    writer.Key("t").BeginArray();
+    for (const auto& bucket : buckets) {
+        writer.Int(bucket.startMs);
+    }
+    writer.EndArray();
+
+    auto writeStatColumn = [&](const std::string& key, Column column, int precision,
+                               double (*stat)(const MetricColumns::Aggregate&)) {
+        writer.Key(key).BeginArray();
+        for (const auto& bucket : buckets) {
+            const MetricColumns::Aggregate& aggregate = bucket.columns[column];
+            if (aggregate.count > 0) {
+                writer.Double(stat(aggregate), precision);
+            } else {
+                writer.Null();
+            }
+        }
+        writer.EndArray();
+    };
+    auto writeMeanColumn = [&](const char* key, Column column, int precision) {
+        writeStatColumn(key, column, precision, [](const MetricColumns::Aggregate& a) { return a.Mean(); });
+        if (query.extremes) {
+            writeStatColumn(std::string(key) + "Min", column, precision,
+                            [](const MetricColumns::Aggregate& a) { return a.min; });
+            writeStatColumn(std::string(key) + "Max", column, precision,
+                            [](const MetricColumns::Aggregate& a) { return a.max; });
+        }
+    };
+    if (query.fields & CPU) {
+        writeMeanColumn("cpu", CPU_COLUMN, 2);
+    }
+    if (query.fields & MEMORY) {
+        writeMeanColumn("memory", MEMORY_COLUMN, 2);
+    }
+    if (query.fields & BATTERY) {
+        writeMeanColumn("battery", BATTERY_COLUMN, 1);
+    }
+    if (query.fields & VOICE_LATENCY) {
+        writeMeanColumn("voiceLatency", VOICE_LATENCY_COLUMN, 1);
+    }
+    if (query.fields & CAMERA_LATENCY) {
+        writeMeanColumn("cameraLatency", CAMERA_LATENCY_COLUMN, 1);
+    }
+    if (query.fields & APP) {
+        writer.Key("app").BeginArray();
+        for (const auto& bucket : buckets) {
+            const MetricColumns::Aggregate& app = bucket.columns[APP_COLUMN];
+            size_t id = app.count > 0 ? static_cast<size_t>(app.last) : 0;
+            writer.StringOrNull(id < appNames.size() ? appNames[id] : std::string());
+        }
+        writer.EndArray();
+    }
+
+    writer.Key("events").BeginArray();
+    uint32_t eventKinds = query.fields & (VOICE | CAMERA);
+    if (eventKinds != 0) {
+        size_t first = FirstEventAtOrAfter(fromMs);
+        size_t last = first;
+        while (last < eventCount && events[EventPosition(last)].timeMs <= toMs) {
+            last++;
+        }
+
+        // Most recent MAX_QUERY_EVENTS of the requested kinds, oldest first
+        size_t begin = last;
+        size_t matched = 0;
+        while (begin > first && matched < MAX_QUERY_EVENTS) {
+            if (events[EventPosition(--begin)].kind & eventKinds) {
+                matched++;
+            }
+        }
+        for (size_t logical = begin; logical < last; ++logical) {
+            const Event& event = events[EventPosition(logical)];
+            if (!(event.kind & eventKinds)) {
+                continue;
+            }
+            writer.BeginObject();
+            writer.Key("t").Int(event.timeMs);
+            writer.Key("type").String(event.kind == VOICE ? "voice" : "camera");
+            writer.Key("text").String(event.text);
+            writer.EndObject();
+        }
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+uint32_t ContextHistory::ParseFields(std::string_view names) {
+    static const struct { const char* name; Field field; } FIELD_NAMES[] = {
+        {"cpu", CPU}, {"memory", MEMORY}, {"battery", BATTERY},
+        {"app", APP}, {"voice", VOICE}, {"camera", CAMERA},
+        {"voice_latency", VOICE_LATENCY}, {"camera_latency", CAMERA_LATENCY},
+    };
+
+    uint32_t fields = 0;
+    size_t start = 0;
+    while (start < names.size()) {
+        size_t end = names.find(',', start);
+        if (end == std::string_view::npos) {
+            end = names.size();
+        }
+        std::string_view name = names.substr(start, end - start);
+        start = end + 1;
+        for (const auto& entry : FIELD_NAMES) {
+            if (name == entry.name) {
+                fields |= entry.field;
+            }
+        }
+    }
+    return fields != 0 ? fields : ALL_FIELDS;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "JsonWriter.h"
+#include "MetricColumns.h"
+
+/**
+ * ContextHistory - Bounded store of timestamped context samples
+ *
+ * Architecture:
+ *   System samples (CPU, memory, battery, active app) and the mean voice and
+ *   camera latency of each sample's second are stored as compressed columns
+ *   (MetricColumns: delta-of-delta times, XOR-coded values) holding the last
+ *   SAMPLE_CAPACITY samples - a week at one a second in a few MB, where the
+ *   plain rings held a day in more. Active apps are stored as ids into a
+ *   small name table. Voice and camera events go to a ring of
+ *   EVENT_CAPACITY entries, their text capped at MAX_EVENT_TEXT bytes; when
+ *   it is full the oldest entry is overwritten.
+ *
+ *   Times are Unix epoch milliseconds and never go backwards: samples less
+ *   than MIN_SAMPLE_INTERVAL_MS after the previous one (or before it, after a
+ *   clock step back) are dropped, and event times are clamped to the last.
+ *
+ * Queries are downsampled on the server: the range is split into at most
+ * maxPoints buckets; numeric columns report the bucket mean (null when
+ * there was no valid reading) and, with Query::extremes, its min and max;
+ * the app column the last app seen in the bucket. Empty buckets are left
+ * out. Events are never downsampled, only capped at the MAX_QUERY_EVENTS
+ * most recent.
+ *
+ * Usage:
+ *   history.RecordSample(ContextHistory::NowMs(), cpu, memory, battery, app);
+ *   history.RecordEvent(ContextHistory::NowMs(), ContextHistory::VOICE, text);
+ *   history.RecordLatency(ContextHistory::VOICE, latencyMs);
+ *
+ *   ContextHistory::Query query;
+ *   query.fromMs = now - 3600 * 1000;
+ *   query.toMs = now;
+ *   query.fields = ContextHistory::ParseFields("cpu,app");
+ *   history.Write(writer, query);
+ *
+ * Thread-safe: one mutex; recording is O(1) and queries hold it only while
+ * they read (milliseconds for a week).
+ */
+class ContextHistory {
+public:
+    static constexpr size_t SAMPLE_CAPACITY = 7 * 24 * 60 * 60; // A week at one sample per second
+    static constexpr size_t EVENT_CAPACITY = 4096;
+    static constexpr size_t MAX_EVENT_TEXT = 1024;
+    static constexpr size_t MAX_APP_NAMES = 1024;               // Later names are recorded as ""
+    static constexpr int64_t MIN_SAMPLE_INTERVAL_MS = 1000;
+    static constexpr size_t MAX_QUERY_POINTS = 5000;
+    static constexpr size_t MAX_QUERY_EVENTS = 1000;
+
+    // Query field bits
+    enum Field : uint32_t {
+        CPU = 1 << 0,
+        MEMORY = 1 << 1,
+        BATTERY = 1 << 2,
+        APP = 1 << 3,
+        VOICE = 1 << 4,
+        CAMERA = 1 << 5,
+        VOICE_LATENCY = 1 << 6,
+        CAMERA_LATENCY = 1 << 7,
+        ALL_FIELDS = (1 << 8) - 1
+    };
+
+    struct Query {
+        int64_t fromMs = 0;
+        int64_t toMs = 0;               // Inclusive
+        uint32_t fields = ALL_FIELDS;
+        size_t maxPoints = 300;
+        bool extremes = false;          // Also <column>Min and <column>Max per bucket
+    };
+
+    ContextHistory();
+
+    // Negative cpu/memory/battery mean "no reading"
+    void RecordSample(int64_t timeMs, double cpuUsage, double memoryUsage, int battery,
+                      const std::string& activeApp);
+
+    // kind is VOICE or CAMERA
+    void RecordEvent(int64_t timeMs, Field kind, std::string_view text);
+
+    // A transcription's or caption's latency (kind VOICE or CAMERA); the
+    // next sample records the mean of those since the previous one
+    void RecordLatency(Field kind, double latencyMs);
+
+    // One JSON object: {"from","to","bucketMs","t":[...],<column>:[...],"events":[...]}
+    void Write(JsonWriter& writer, const Query& query) const;
+
+    struct RecentEvent {
+        int64_t timeMs;
+        Field kind;                     // VOICE or CAMERA
+        std::string text;
+    };
+
+    // Up to maxCount events at or after sinceMs, newest first
+    void GetRecentEvents(int64_t sinceMs, size_t maxCount, std::vector<RecentEvent>& out) const;
+
+    // Comma-separated field names ("cpu,memory,battery,app,voice,camera,
+    // voice_latency,camera_latency");
+    // unknown names are ignored, and a list with no known name means every field
+    static uint32_t ParseFields(std::string_view names);
+
+    // Bytes held by the sample columns, events and the app name table
+    size_t GetMemoryUsage() const;
+
+    static int64_t NowMs();
+
+private:
+    struct Event {
+        int64_t timeMs = 0;
+        Field kind = VOICE;
+        std::string text;
+    };
+
+    // Sample columns
+    enum Column : size_t {
+        CPU_COLUMN,
+        MEMORY_COLUMN,
+        BATTERY_COLUMN,
+        APP_COLUMN,
+        VOICE_LATENCY_COLUMN,
+        CAMERA_LATENCY_COLUMN,
+        COLUMN_COUNT
+    };
+
+    // Latencies since the last sample
+    struct PendingLatency {
+        double sum = 0.0;
+        uint32_t count = 0;
+    };
+
+    // Logical index 0 = oldest entry still stored
+    size_t EventPosition(size_t logical) const;
+    size_t FirstEventAtOrAfter(int64_t timeMs) const;
+    uint16_t InternApp(const std::string& name);
+
+    mutable std::mutex historyMutex;
+
+    // === Samples ===
+    MetricColumns samples;
+    PendingLatency voiceLatency;
+    PendingLatency cameraLatency;
+
+    // === Events ===
+    std::vector<Event> events;
+    size_t eventHead;
+    size_t eventCount;
+
+    // App names; id 0 is "" (unknown or table full)
+    std::vector<std::string> appNames;
+    std::unordered_map<std::string, uint16_t> appIds;
+};
@@ -0,0 +1,359 @@
+#include "ContextPublisher.h"
+#include "Deflate.h"
+#include "Log.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include <winhttp.h>
+#include <algorithm>
+
+#pragma comment(lib, "winhttp.lib")
+
+namespace {
+
+int64_t EpochMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::wstring Widen(const std::string& text) {
+    if (text.empty()) {
+        return std::wstring();
+    }
+    int length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring wide(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), &wide[0], length);
+    return wide;
+}
+
+// A full document at least this often, so dropping the oldest batches
+// never leaves the collector with patches it has no base for
+constexpr uint64_t KEYFRAME_BATCHES = 12;
+
+}  // namespace
+
+ContextPublisher::ContextPublisher(ContextCollector& collector, const Settings& settings)
+    : collector(collector), settings(settings), run(EpochMs()),
+      session(nullptr), connection(nullptr), secure(true),
+      stopEvent(CreateEventA(nullptr, TRUE, FALSE, nullptr)),
+      wakeEvent(CreateEventA(nullptr, FALSE, FALSE, nullptr)) {
+    if (this->settings.node.empty()) {
+        char name[MAX_COMPUTERNAME_LENGTH + 1] = {};
+        DWORD size = sizeof(name);
+        if (GetComputerNameA(name, &size)) {
+            this->settings.node.assign(name, size);
+        }
+    }
+}
+
+ContextPublisher::~ContextPublisher() {
+    Stop();
+    if (connection) {
+        WinHttpCloseHandle(connection);
+    }
+    if (session) {
+        WinHttpCloseHandle(session);
+    }
+    if (stopEvent) {
+        CloseHandle(stopEvent);
+    }
+    if (wakeEvent) {
+        CloseHandle(wakeEvent);
+    }
+}
+
+bool ContextPublisher::Start() {
+    if (running.load()) {
+        return true;
+    }
+
+    std::wstring url = Widen(settings.url);
+    URL_COMPONENTS parts = {};
+    parts.dwStructSize = sizeof(parts);
+    parts.dwHostNameLength = static_cast<DWORD>(-1);
+    parts.dwUrlPathLength = static_cast<DWORD>(-1);
+    parts.dwExtraInfoLength = static_cast<DWORD>(-1);
+    if (!WinHttpCrackUrl(url.c_str(), 0, 0, &parts)) {
+        LOG_ERROR("Publish", "Cannot parse publish.url " << settings.url << ": " << GetLastError());
+        return false;
+    }
+    std::wstring host(parts.lpszHostName, parts.dwHostNameLength);
+    path.assign(parts.lpszUrlPath, parts.dwUrlPathLength);
+    path.append(parts.lpszExtraInfo, parts.dwExtraInfoLength);
+    if (path.empty()) {
+        path = L"/";
+    }
+    secure = parts.nScheme == INTERNET_SCHEME_HTTPS;
+
+    // The system's proxy settings; TLS (and its certificate checks) from Schannel
+    session = WinHttpOpen(L"PerceptionEngine/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                          WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    connection = session ? WinHttpConnect(session, host.c_str(), parts.nPort, 0) : nullptr;
+    if (!connection) {
+        LOG_ERROR("Publish", "WinHTTP unavailable for " << settings.url << ": " << GetLastError());
+        return false;
+    }
+
+    running = true;
+    batchThread = std::thread(&ContextPublisher::BatchThread, this);
+    sendThread = std::thread(&ContextPublisher::SendThread, this);
+    LOG_INFO("Publish", "Publishing context as " << settings.node << " to " << settings.url
+             << " every " << settings.batchMs << "ms");
+    return true;
+}
+
+void ContextPublisher::Stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    SetEvent(stopEvent);
+    if (batchThread.joinable()) {
+        batchThread.join();
+    }
+    if (sendThread.joinable()) {
+        sendThread.join();
+    }
+    ResetEvent(stopEvent);
+    std::lock_guard<std::mutex> lock(outboxMutex);
+    if (!outbox.empty()) {
+        LOG_INFO("Publish", outbox.size() << " unsent batch(es) discarded at shutdown");
+    }
+}
+
+// ============================================================================
+// Batching
+// ============================================================================
+
+void ContextPublisher::BatchThread() {
+    TRACE_THREAD("Context publisher batch");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Context);
+    uint64_t lastState = 0;
+    uint64_t lastVersion = 0;           // Base for the next patch; 0: send a full document
+    std::string entries;
+    size_t count = 0;
+    auto opened = std::chrono::steady_clock::now();
+    const auto window = std::chrono::milliseconds(settings.batchMs);
+
+    while (running.load()) {
+        // A publisher is a reader: system fields keep refreshing for the collector
+        collector.NoteReader();
+        std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.WaitForSnapshot(lastState, WAIT_SLICE_MS);
+        if (snapshot->stateVersion != lastState) {
+            lastState = snapshot->stateVersion;
+            {
+                std::lock_guard<std::mutex> lock(outboxMutex);
+                if (resync || (count == 0 && nextBatch % KEYFRAME_BATCHES == 1)) {
+                    lastVersion = 0;
+                    resync = false;
+                }
+            }
+            ContextCollector::ContextDelta delta = collector.CollectContextSince(lastVersion);
+            if (!delta.notModified) {
+                if (count == 0) {
+                    opened = std::chrono::steady_clock::now();
+                }
+                if (count > 0) {
+                    entries += ',';
+                }
+                JsonWriter writer(entries);
+                writer.BeginObject();
+                writer.Key("version").UInt(delta.version);
+                if (delta.isPatch) {
+                    writer.Key("base").UInt(lastVersion);
+                }
+                writer.Key("timestampMs").Int(EpochMs());
+                if (delta.isPatch) {
+                    writer.Key("patch").Raw(delta.body);
+                } else {
+                    writer.Key("context").Raw(delta.snapshot->serialized);
+                }
+                writer.EndObject();
+                count++;
+                lastVersion = delta.version;
+            }
+        }
+
+        if (count > 0 && std::chrono::steady_clock::now() - opened >= window) {
+            Seal(entries, count);
+        }
+    }
+}
+
+void ContextPublisher::Seal(std::string& entries, size_t& count) {
+    Batch batch;
+    batch.entries = count;
+    {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        batch.number = nextBatch++;
+    }
+
+    std::string body;
+    body.reserve(entries.size() + 128);
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("node").String(settings.node);
+    writer.Key("run").Int(run);
+    writer.Key("batch").UInt(batch.number);
+    writer.Key("entries").Raw("[" + entries + "]");
+    writer.EndObject();
+    batch.body = Deflate::Compress(body, Deflate::Container::Gzip);
+    entries.clear();
+    count = 0;
+
+    std::lock_guard<std::mutex> lock(outboxMutex);
+    outboxBytes += batch.body.size();
+    outbox.push_back(std::move(batch));
+
+    // Over budget (offline too long): drop the oldest, then up to the next
+    // keyframe, so what stays queued still applies in order
+    size_t dropped = 0;
+    while (outboxBytes > settings.bufferBytes && outbox.size() > 1) {
+        outboxBytes -= outbox.front().body.size();
+        outbox.pop_front();
+        dropped++;
+        while (outbox.size() > 1 && outbox.front().number % KEYFRAME_BATCHES != 1) {
+            outboxBytes -= outbox.front().body.size();
+            outbox.pop_front();
+            dropped++;
+        }
+    }
+    if (dropped > 0) {
+        droppedBatches += dropped;
+        LOG_WARNING("Publish", "Outbox over " << settings.bufferBytes / 1024 << " KB: dropped the oldest "
+                    << dropped << " batch(es)");
+    }
+    SetEvent(wakeEvent);
+}
+
+// ============================================================================
+// Sending
+// ============================================================================
+
+void ContextPublisher::SendThread() {
+    TRACE_THREAD("Context publisher send");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Context);
+    int backoffMs = 0;
+    bool idle = true;               // Nothing queued at the last look: wait for a batch
+
+    while (running.load()) {
+        // Backing off, only stop cuts the wait short; a new batch doesn't
+        HANDLE waits[] = { stopEvent, wakeEvent };
+        if (backoffMs > 0) {
+            WaitForSingleObject(stopEvent, static_cast<DWORD>(backoffMs));
+        } else if (idle) {
+            WaitForMultipleObjects(2, waits, FALSE, INFINITE);
+        }
+        if (!running.load()) {
+            break;
+        }
+
+        Batch batch;
+        {
+            std::lock_guard<std::mutex> lock(outboxMutex);
+            idle = outbox.empty();
+            if (idle) {
+                backoffMs = 0;
+                continue;
+            }
+            batch = outbox.front();
+        }
+
+        int retryAfterMs = 0;
+        int status = Post(batch, retryAfterMs);
+        bool delivered = status >= 200 && status < 300;
+        // 409: the collector lost this run's chain; the batch is no use to it
+        bool rejected = status == 409 || status == 400 || status == 413;
+
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        lastStatus = status;
+        if (delivered || rejected) {
+            if (!outbox.empty() && outbox.front().number == batch.number) {
+                outboxBytes -= outbox.front().body.size();
+                outbox.pop_front();
+            }
+            if (delivered) {
+                sentBatches++;
+                sentEntries += batch.entries;
+                lastSuccessMs = EpochMs();
+            } else {
+                droppedBatches++;
+                resync = true;
+                LOG_WARNING("Publish", "Collector refused batch " << batch.number << " (HTTP " << status
+                            << "); resending the full context");
+            }
+            backoffMs = 0;          // The next one, if any, right away
+            continue;
+        }
+
+        failedSends++;
+        backoffMs = backoffMs == 0 ? MIN_BACKOFF_MS : (std::min)(backoffMs * 2, MAX_BACKOFF_MS);
+        backoffMs = (std::max)(backoffMs, (std::min)(retryAfterMs, MAX_BACKOFF_MS));
+        if (failedSends == 1 || backoffMs == MAX_BACKOFF_MS) {
+            LOG_WARNING("Publish", "Send failed (" << (status ? "HTTP " + std::to_string(status) : std::string("no answer"))
+                        << "); " << outbox.size() << " batch(es) queued, retrying in " << backoffMs << "ms");
+        }
+    }
+}
+
+int ContextPublisher::Post(const Batch& batch, int& retryAfterMs) {
+    retryAfterMs = 0;
+    HINTERNET request = WinHttpOpenRequest(static_cast<HINTERNET>(connection), L"POST", path.c_str(), nullptr,
+                                           WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                           secure ? WINHTTP_FLAG_SECURE : 0);
+    if (!request) {
+        return 0;
+    }
+    WinHttpSetTimeouts(request, SEND_TIMEOUT_MS, SEND_TIMEOUT_MS, SEND_TIMEOUT_MS, SEND_TIMEOUT_MS);
+
+    std::wstring headers = L"Content-Type: application/json\r\nContent-Encoding: gzip\r\n"
+                           L"X-Perception-Node: " + Widen(settings.node) + L"\r\n";
+    if (!settings.token.empty()) {
+        headers += L"Authorization: Bearer " + Widen(settings.token) + L"\r\n";
+    }
+
+    int status = 0;
+    if (WinHttpSendRequest(request, headers.c_str(), static_cast<DWORD>(-1),
+                           const_cast<char*>(batch.body.data()), static_cast<DWORD>(batch.body.size()),
+                           static_cast<DWORD>(batch.body.size()), 0) &&
+        WinHttpReceiveResponse(request, nullptr)) {
+        DWORD code = 0;
+        DWORD size = sizeof(code);
+        if (WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                                WINHTTP_HEADER_NAME_BY_INDEX, &code, &size, WINHTTP_NO_HEADER_INDEX)) {
+            status = static_cast<int>(code);
+        }
+        DWORD seconds = 0;
+        size = sizeof(seconds);
+        if ((status == 429 || status == 503) &&
+            WinHttpQueryHeaders(request, WINHTTP_QUERY_RETRY_AFTER | WINHTTP_QUERY_FLAG_NUMBER,
+                                WINHTTP_HEADER_NAME_BY_INDEX, &seconds, &size, WINHTTP_NO_HEADER_INDEX)) {
+            retryAfterMs = static_cast<int>((std::min)(seconds, static_cast<DWORD>(MAX_BACKOFF_MS / 1000))) * 1000;
+        }
+    } else {
+        LOG_DEBUG("Publish", "POST " << settings.url << " failed: " << GetLastError());
+    }
+    WinHttpCloseHandle(request);
+    return status;
+}
+
+// ============================================================================
+// Reporting
+// ============================================================================
+
+void ContextPublisher::Write(JsonWriter& writer) const {
+    std::lock_guard<std::mutex> lock(outboxMutex);
+    writer.BeginObject();
+    writer.Key("url").String(settings.url);
+    writer.Key("node").String(settings.node);
+    writer.Key("run").Int(run);
+    writer.Key("batchMs").Int(settings.batchMs);
+    writer.Key("outboxBatches").UInt(outbox.size());
+    writer.Key("outboxBytes").UInt(outboxBytes);
+    writer.Key("bufferBytes").UInt(settings.bufferBytes);
+    writer.Key("sentBatches").UInt(sentBatches);
+    writer.Key("sentEntries").UInt(sentEntries);
+    writer.Key("droppedBatches").UInt(droppedBatches);
+    writer.Key("failedSends").UInt(failedSends);
+    writer.Key("lastStatus").Int(lastStatus);
+    writer.Key("lastSuccessMs").Int(lastSuccessMs);
+    writer.EndObject();
+}
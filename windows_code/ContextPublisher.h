@@ -0,0 +1,128 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ContextCollector.h"
+#include "JsonWriter.h"
+
+/**
+ * ContextPublisher - Pushes this machine's context to a fleet collector
+ *
+ * The HTTP server only listens on loopback, so a central dashboard had to
+ * poll every machine's /context through a tunnel. With publish.url set, the
+ * engine instead POSTs its context changes to a collector over HTTPS
+ * (WinHTTP, so TLS and proxies come from the system):
+ *
+ *   every change      -> an entry: the full document, or a JSON merge patch
+ *                        against the previous entry (ContextCollector::CollectContextSince)
+ *   every batchMs     -> the entries sealed into one gzip batch
+ *   sender thread     -> POST, oldest batch first; a batch is only dropped
+ *                        from the outbox once the collector answered 2xx
+ *
+ * Batch body (Content-Encoding: gzip, Authorization: Bearer <token>):
+ *   {"node":"DESKTOP-1","run":1718000000000,"batch":12,
+ *    "entries":[{"version":40,"timestampMs":...,"context":{...}},
+ *               {"version":41,"base":40,"timestampMs":...,"patch":{...}}]}
+ * `run` changes on every engine start, and versions only mean something
+ * within a run. The first entry of a run, and the first after batches were
+ * dropped, is always a full document, so a collector can always apply
+ * what it receives in order.
+ *
+ * Offline: failed sends back off exponentially (Retry-After on 429/503 is
+ * honoured) while batches keep accumulating in the outbox, up to
+ * bufferBytes of compressed data; past that the oldest are dropped and
+ * counted. Publishing never blocks the collector: its thread only reads
+ * snapshots.
+ *
+ * Usage:
+ *   ContextPublisher publisher(collector, settings);
+ *   publisher.Start();
+ *   publisher.Stop();
+ */
+class ContextPublisher {
+public:
+    struct Settings {
+        std::string url;                // https://collector.example/ingest
+        std::string token;              // Bearer token; empty sends no Authorization
+        std::string node;               // Empty: the computer name
+        int batchMs = 5000;
+        size_t bufferBytes = 4 * 1024 * 1024;
+    };
+
+    ContextPublisher(ContextCollector& collector, const Settings& settings);
+    ~ContextPublisher();
+
+    ContextPublisher(const ContextPublisher&) = delete;
+    ContextPublisher& operator=(const ContextPublisher&) = delete;
+
+    /**
+     * @brief Start batching and sending
+     * @return false when the URL can't be parsed or WinHTTP can't open a session
+     */
+    bool Start();
+
+    /**
+     * @brief Stop both threads; whatever is still in the outbox is lost
+     */
+    void Stop();
+
+    /**
+     * @brief {"url","node","outboxBatches","outboxBytes","sentBatches","droppedBatches","lastStatus",...}
+     */
+    void Write(JsonWriter& writer) const;
+
+private:
+    struct Batch {
+        uint64_t number = 0;
+        std::string body;               // Gzip
+        size_t entries = 0;
+    };
+
+    static constexpr int WAIT_SLICE_MS = 500;           // Stop() latency
+    static constexpr int MIN_BACKOFF_MS = 1000;
+    static constexpr int MAX_BACKOFF_MS = 60000;
+    static constexpr DWORD SEND_TIMEOUT_MS = 15000;
+
+    void BatchThread();
+    void SendThread();
+    // Seal the open entries into a batch and queue it (dropping the oldest over budget)
+    void Seal(std::string& entries, size_t& count);
+    // One POST; the HTTP status, or 0 when it never got an answer
+    int Post(const Batch& batch, int& retryAfterMs);
+
+    ContextCollector& collector;
+    Settings settings;
+    int64_t run;
+
+    // WinHTTP handles, parsed from settings.url
+    void* session;
+    void* connection;
+    std::wstring path;
+    bool secure;
+
+    std::atomic<bool> running{false};
+    HANDLE stopEvent;                   // Manual reset
+    HANDLE wakeEvent;                   // Auto reset: a batch was sealed
+    std::thread batchThread;
+    std::thread sendThread;
+
+    mutable std::mutex outboxMutex;
+    std::deque<Batch> outbox;
+    size_t outboxBytes = 0;
+    uint64_t nextBatch = 1;
+    bool resync = true;                 // The next entry must be a full document
+    uint64_t sentBatches = 0;
+    uint64_t sentEntries = 0;
+    uint64_t droppedBatches = 0;
+    uint64_t failedSends = 0;
+    int lastStatus = 0;
+    int64_t lastSuccessMs = 0;
+};
@@ -0,0 +1,68 @@
+#include "ContextStream.h"
+#include <iostream>
+
+ContextStream::ContextStream(ContextCollector& collector, HttpServer& server, int minIntervalMs)
+    : collector(collector), server(server), minInterval(minIntervalMs), running(false) {
+}
+
+ContextStream::~ContextStream() {
+    Stop();
+}
+
+void ContextStream::Start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    publishThread = std::thread(&ContextStream::PublishThread, this);
+    std::cout << "[ContextStream] Publishing /context/stream (min interval "
+              << minInterval.count() << "ms)" << std::endl;
+}
+
+void ContextStream::Stop() {
+    running.store(false);
+    if (publishThread.joinable()) {
+        publishThread.join();
+    }
+}
+
+void ContextStream::Subscribe(HttpResponse& response) {
+    collector.NoteReader();
+    std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.GetSnapshot();
+
+    response.StartEventStream(STREAM_NAME);
+    response.SetBody("retry: " + std::to_string(RECONNECT_DELAY_MS) + "\n" +
+                     HttpServer::FormatEvent("context", snapshot->serialized, std::to_string(snapshot->version)));
+    response.status = 200;
+}
+
+void ContextStream::PublishThread() {
+    uint64_t published = collector.GetSnapshot()->stateVersion;
+    auto lastPublish = std::chrono::steady_clock::now() - minInterval;
+
+    while (running.load()) {
+        // Open streams count as readers, so system fields keep refreshing for them
+        if (server.GetSubscriberCount(STREAM_NAME) > 0) {
+            collector.NoteReader();
+        }
+        if (collector.WaitForSnapshot(published, WAIT_SLICE_MS)->stateVersion == published) {
+            continue;
+        }
+
+        // Let the rest of a burst land before building the event
+        auto earliest = lastPublish + minInterval;
+        auto now = std::chrono::steady_clock::now();
+        if (now < earliest) {
+            std::this_thread::sleep_for(earliest - now);
+        }
+
+        std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.GetSnapshot();
+        published = snapshot->stateVersion;
+        if (server.GetSubscriberCount(STREAM_NAME) == 0) {
+            continue;
+        }
+
+        // The snapshot's bytes are shared, not re-serialized per event
+        server.PublishEvent(STREAM_NAME, "context", snapshot->serialized, std::to_string(snapshot->version));
+        lastPublish = std::chrono::steady_clock::now();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "ContextCollector.h"
+#include "HttpServer.h"
+
+/**
+ * ContextStream - Pushes /context to Server-Sent Events subscribers
+ *
+ * Replaces fixed-rate polling: GET /context/stream subscribes a connection
+ * (Subscribe() sends the current context as the first event) and a publisher
+ * thread pushes the collector's pre-serialized snapshot as a "context" event
+ * only when its state version moves, i.e. on voice, camera, model status or
+ * active-app changes.
+ *
+ * Features:
+ * - Bursts (streaming partials, caption + status) coalesce into at most one
+ *   event per minIntervalMs
+ * - Events carry the document version (X-Context-Version) as their SSE id
+ *
+ * Usage:
+ *   ContextStream stream(collector, server);
+ *   stream.Start();
+ *   // in the request handler, for GET /context/stream:
+ *   stream.Subscribe(response);
+ */
+class ContextStream {
+public:
+    static constexpr const char* STREAM_NAME = "context";
+    static constexpr int DEFAULT_MIN_INTERVAL_MS = 250;
+
+    ContextStream(ContextCollector& collector, HttpServer& server, int minIntervalMs = DEFAULT_MIN_INTERVAL_MS);
+    ~ContextStream();
+
+    ContextStream(const ContextStream&) = delete;
+    ContextStream& operator=(const ContextStream&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Turn the response into a subscription, starting with the current context
+    void Subscribe(HttpResponse& response);
+
+private:
+    void PublishThread();
+
+    static constexpr int RECONNECT_DELAY_MS = 2000;     // Sent as the SSE retry hint
+    static constexpr int WAIT_SLICE_MS = 500;           // Stop() latency
+
+    ContextCollector& collector;
+    HttpServer& server;
+    std::chrono::milliseconds minInterval;
+
+    std::atomic<bool> running;
+    std::thread publishThread;
+};
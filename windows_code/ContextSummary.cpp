@@ -0,0 +1,220 @@
+#include "ContextSummary.h"
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include "JsonReader.h"
+#include "Log.h"
+#include "Trace.h"
+
+namespace {
+
+// The fields a summary reads (NoteReader): their sources stay live while summaries are asked for
+const std::vector<std::string_view>& SummaryFields() {
+    static const std::vector<std::string_view> FIELDS = {
+        "timestamp", "activeApp", "activeAppCategory", "voiceTranscription", "voicePartial",
+        "cameraDescription", "fusedContext", "systemAudioTranscription", "battery", "isCharging",
+        "cpuUsage", "networkConnected", "voiceKeyword", "RecentPeriodActiveApps", "locationValid",
+        "locationLat", "locationLon",
+    };
+    return FIELDS;
+}
+
+std::string_view StringMember(const ContextCollector::Snapshot& snapshot, std::string_view key,
+                              std::string& scratch) {
+    std::string_view value = snapshot.FindMember(key);
+    if (value.empty()) {
+        return std::string_view();
+    }
+    return JsonReader::Parse(value).AsString(scratch);
+}
+
+JsonValue Member(const ContextCollector::Snapshot& snapshot, std::string_view key) {
+    std::string_view value = snapshot.FindMember(key);
+    return JsonReader::Parse(value.empty() ? std::string_view("null") : value);
+}
+
+// "14:03" local time of a Unix epoch millisecond time
+std::string ClockTime(int64_t timeMs) {
+    std::time_t seconds = static_cast<std::time_t>(timeMs / 1000);
+    struct tm local;
+    if (localtime_s(&local, &seconds) != 0) {
+        return "--:--";
+    }
+    char text[8];
+    std::strftime(text, sizeof(text), "%H:%M", &local);
+    return text;
+}
+
+} // namespace
+
+ContextSummary::ContextSummary(ContextCollector& collector, std::string modelDir)
+    : collector(collector)
+    , modelDir(std::move(modelDir))
+    , exact(false)
+    , linesVersion(0)
+{
+}
+
+void ContextSummary::LoadTokenizer() {
+    std::error_code ec;
+    bool loaded = tokenizer.LoadBinaryVocab(modelDir + "/vocab.bin") ||
+                  (std::filesystem::exists(modelDir + "/vocab.json", ec) && tokenizer.LoadVocab(modelDir + "/vocab.json"));
+    exact = loaded && tokenizer.LoadMerges(modelDir + "/merges.txt");
+    if (!exact) {
+        LOG_INFO("ContextSummary", "No FastVLM tokenizer in " << modelDir
+                 << "; /context/summary estimates 4 bytes a token");
+    }
+}
+
+size_t ContextSummary::CountTokens(const std::string& line) {
+    auto it = tokenCounts.find(line);
+    if (it != tokenCounts.end()) {
+        return it->second;
+    }
+    size_t tokens = exact ? tokenizer.Encode(line + "\n").size() : (line.size() + 1 + 3) / 4;
+    if (tokenCounts.size() >= MAX_COUNTED_LINES) {
+        tokenCounts.clear();
+    }
+    tokenCounts.emplace(line, static_cast<uint32_t>(tokens));
+    return tokens;
+}
+
+void ContextSummary::BuildLines(const ContextCollector::Snapshot& snapshot) {
+    lines.clear();
+    std::string scratch;
+    auto add = [&](std::string text, bool heading = false) {
+        Line line;
+        line.tokens = CountTokens(text);
+        line.heading = heading;
+        line.item = text.compare(0, 2, "- ") == 0;
+        line.text = std::move(text);
+        lines.push_back(std::move(line));
+    };
+    auto addText = [&](const char* label, std::string_view key) {
+        std::string_view value = StringMember(snapshot, key, scratch);
+        if (!value.empty()) {
+            add(std::string(label) + std::string(value));
+        }
+    };
+
+    // Now
+    addText("Now: ", "timestamp");
+    std::string_view app = StringMember(snapshot, "activeApp", scratch);
+    if (!app.empty() && app != "Unknown") {
+        std::string line = "App: " + std::string(app);
+        std::string_view category = StringMember(snapshot, "activeAppCategory", scratch);
+        if (!category.empty() && category != "unknown") {
+            line += " (" + std::string(category) + ")";
+        }
+        add(std::move(line));
+    }
+    addText("Said: ", "voiceTranscription");
+    addText("Saying: ", "voicePartial");
+    addText("Camera: ", "cameraDescription");
+    addText("Summary: ", "fusedContext");
+    addText("Remote audio: ", "systemAudioTranscription");
+
+    std::string alerts;
+    int64_t battery = Member(snapshot, "battery").AsInt(100);
+    if (battery < 20 && !Member(snapshot, "isCharging").AsBool()) {
+        alerts += "low battery " + std::to_string(battery) + "%";
+    }
+    if (!Member(snapshot, "networkConnected").AsBool(true)) {
+        alerts += (alerts.empty() ? "" : ", ");
+        alerts += "offline";
+    }
+    double cpu = Member(snapshot, "cpuUsage").AsDouble(-1.0);
+    if (cpu > 80.0) {
+        alerts += (alerts.empty() ? "" : ", ");
+        alerts += "high CPU " + std::to_string(static_cast<int>(cpu)) + "%";
+    }
+    if (!alerts.empty()) {
+        add("Alerts: " + alerts);
+    }
+    addText("Keyword: ", "voiceKeyword");
+
+    // Recent
+    std::vector<ContextHistory::RecentEvent> events;
+    collector.GetHistory().GetRecentEvents(ContextHistory::NowMs() - RECENT_WINDOW_MS, RECENT_EVENTS, events);
+    if (!events.empty()) {
+        add("Recently:", true);
+        for (const ContextHistory::RecentEvent& event : events) {
+            add("- " + ClockTime(event.timeMs) + (event.kind == ContextHistory::CAMERA ? " saw: " : " heard: ") +
+                event.text);
+        }
+    }
+
+    JsonValue recentApps = Member(snapshot, "RecentPeriodActiveApps");
+    if (recentApps.IsArray() && recentApps.Size() > 0) {
+        add("Recent apps:", true);
+        // Oldest first in the document
+        size_t count = recentApps.Size();
+        for (size_t index = count; index > 0 && count - index < RECENT_APPS; --index) {
+            JsonValue entry = recentApps[index - 1];
+            std::string line = "- " + entry["appName"].GetString();
+            std::string title = entry["windowTitle"].GetString();
+            if (!title.empty()) {
+                line += ": " + title;
+            }
+            line += " (" + std::to_string(entry["durationSeconds"].AsInt()) + "s)";
+            add(std::move(line));
+        }
+    }
+
+    if (Member(snapshot, "locationValid").AsBool()) {
+        add("Location: " + std::string(snapshot.FindMember("locationLat")) + ", " +
+            std::string(snapshot.FindMember("locationLon")));
+    }
+}
+
+ContextSummary::Result ContextSummary::Render(size_t maxTokens) {
+    TRACE_ZONE("ContextSummary::Render");
+    std::call_once(tokenizerOnce, [this]() { LoadTokenizer(); });
+    maxTokens = (std::min)(maxTokens, MAX_TOKENS);
+    collector.NoteReader(SummaryFields());
+    std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.GetSnapshot();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (linesVersion != snapshot->version || lines.empty()) {
+        BuildLines(*snapshot);
+        linesVersion = snapshot->version;
+        rendered.clear();
+    }
+    auto cached = rendered.find(maxTokens);
+    if (cached != rendered.end()) {
+        return cached->second;
+    }
+
+    Result result;
+    result.version = snapshot->version;
+    result.exact = exact;
+    auto text = std::make_shared<std::string>();
+    const Line* heading = nullptr;
+    for (const Line& line : lines) {
+        if (line.heading) {
+            heading = &line;
+            continue;
+        }
+        if (!line.item) {
+            heading = nullptr;          // Its section had nothing that fit
+        }
+        size_t cost = line.tokens + (heading ? heading->tokens : 0);
+        if (result.tokens + cost > maxTokens) {
+            result.omitted++;
+            continue;
+        }
+        if (heading) {
+            text->append(heading->text).append("\n");
+            heading = nullptr;
+        }
+        text->append(line.text).append("\n");
+        result.tokens += cost;
+    }
+    result.text = std::move(text);
+
+    if (rendered.size() >= CACHED_BUDGETS) {
+        rendered.clear();
+    }
+    rendered.emplace(maxTokens, result);
+    return result;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ContextCollector.h"
+#include "FastVLMTokenizer.h"
+
+/**
+ * ContextSummary - The context as a token-budgeted text block for LLM prompts
+ *
+ * Agents paste /context into prompts and cut it to fit. GET
+ * /context/summary?max_tokens=N renders the current and recent context as
+ * short lines in priority order and keeps lines while they fit the budget:
+ *   now, app, what was said (and is being said), camera, fused summary,
+ *   remote audio, alerts, keyword, then recent voice/camera events and
+ *   recent apps (newest first), location.
+ * A line that doesn't fit is left out and lower ones still get their chance;
+ * a section heading only goes in with its first item.
+ *
+ * Tokens are counted with the FastVLM (Qwen2) tokenizer, loaded from the
+ * camera model directory on first use (the vocabulary is the mapped vocab.bin
+ * the camera engine shares); without it they are estimated at 4 bytes each.
+ * Per-line counts are remembered across versions, since most lines outlive
+ * many versions, and each rendering is cached per (document version, budget).
+ *
+ * Threading: Render() from any thread; one mutex.
+ *
+ * Usage:
+ *   ContextSummary summary(collector, "models/fastvlm");
+ *   ContextSummary::Result result = summary.Render(512);
+ */
+class ContextSummary {
+public:
+    static constexpr size_t DEFAULT_MAX_TOKENS = 512;
+    static constexpr size_t MAX_TOKENS = 32768;
+    static constexpr size_t RECENT_EVENTS = 20;
+    static constexpr int64_t RECENT_WINDOW_MS = 30 * 60 * 1000;
+    static constexpr size_t RECENT_APPS = 5;
+    static constexpr size_t CACHED_BUDGETS = 16;
+    static constexpr size_t MAX_COUNTED_LINES = 4096;
+
+    struct Result {
+        std::shared_ptr<const std::string> text;
+        size_t tokens = 0;              // Of text
+        size_t omitted = 0;             // Lines left out for the budget
+        uint64_t version = 0;           // Document version rendered
+        bool exact = false;             // Counted by the tokenizer (else estimated)
+    };
+
+    // modelDir: the FastVLM directory (vocab.bin or vocab.json, merges.txt)
+    ContextSummary(ContextCollector& collector, std::string modelDir);
+
+    ContextSummary(const ContextSummary&) = delete;
+    ContextSummary& operator=(const ContextSummary&) = delete;
+
+    Result Render(size_t maxTokens);
+
+private:
+    struct Line {
+        std::string text;
+        size_t tokens = 0;              // With its newline
+        bool heading = false;           // Only emitted before an item that fits
+        bool item = false;              // Under the last heading
+    };
+
+    void LoadTokenizer();
+    void BuildLines(const ContextCollector::Snapshot& snapshot);
+    size_t CountTokens(const std::string& line);
+
+    ContextCollector& collector;
+    std::string modelDir;
+
+    std::once_flag tokenizerOnce;
+    FastVLMTokenizer tokenizer;
+    bool exact;                         // Tokenizer loaded with merges
+
+    std::mutex mutex;                   // Everything below
+    uint64_t linesVersion;              // Document version `lines` and `rendered` are for
+    std::vector<Line> lines;
+    std::unordered_map<size_t, Result> rendered;            // By budget
+    std::unordered_map<std::string, uint32_t> tokenCounts;  // By line
+};
@@ -0,0 +1,382 @@
+#include "ContextWatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include "JsonReader.h"
+#include "Log.h"
+#include "Trace.h"
+
+namespace {
+
+std::string_view Trim(std::string_view text) {
+    while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && text.back() == ' ') {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool IsFieldName(std::string_view name) {
+    if (name.empty()) {
+        return false;
+    }
+    for (char ch : name) {
+        if (!((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+char Lower(char ch) {
+    return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+bool ContainsIgnoringCase(std::string_view text, std::string_view needle) {
+    auto it = std::search(text.begin(), text.end(), needle.begin(), needle.end(),
+                          [](char a, char b) { return Lower(a) == Lower(b); });
+    return it != text.end() || needle.empty();
+}
+
+} // namespace
+
+ContextWatch::ContextWatch(ContextCollector& collector, HttpServer& server)
+    : collector(collector), server(server), nextId(1), running(false) {
+}
+
+ContextWatch::~ContextWatch() {
+    Stop();
+}
+
+int64_t ContextWatch::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ContextWatch::Start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    evaluateThread = std::thread(&ContextWatch::EvaluateThread, this);
+    LOG_INFO("ContextWatch", "Serving /context/watch (at most " << MAX_WATCHES << " watches)");
+}
+
+void ContextWatch::Stop() {
+    running.store(false);
+    if (evaluateThread.joinable()) {
+        evaluateThread.join();
+    }
+}
+
+size_t ContextWatch::GetWatchCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return watches.size();
+}
+
+// ============================================================================
+// Predicates
+// ============================================================================
+
+bool ContextWatch::Parse(std::string_view where, std::vector<Clause>& clauses, std::string& error) {
+    clauses.clear();
+    while (!where.empty()) {
+        size_t comma = where.find(',');
+        std::string_view text = Trim(where.substr(0, comma));
+        where = comma == std::string_view::npos ? std::string_view() : where.substr(comma + 1);
+        if (text.empty()) {
+            continue;
+        }
+        if (clauses.size() == MAX_CLAUSES) {
+            error = "At most " + std::to_string(MAX_CLAUSES) + " clauses";
+            return false;
+        }
+
+        Clause clause;
+        size_t at = text.find_first_of("!=~<>", text.front() == '!' ? 1 : 0);
+        std::string_view field = text;
+        if (at == std::string_view::npos) {
+            clause.op = text.front() == '!' ? Clause::Op::Falsy : Clause::Op::Truthy;
+            field = text.front() == '!' ? text.substr(1) : text;
+        } else {
+            field = text.substr(0, at);
+            std::string_view rest = text.substr(at);
+            size_t width = 1;
+            if (rest.compare(0, 2, "!=") == 0) {
+                clause.op = Clause::Op::NotEqual;
+                width = 2;
+            } else if (rest.front() == '=') {
+                clause.op = Clause::Op::Equal;
+            } else if (rest.front() == '~') {
+                clause.op = Clause::Op::Contains;
+            } else if (rest.front() == '>') {
+                clause.op = Clause::Op::Greater;
+            } else if (rest.front() == '<') {
+                clause.op = Clause::Op::Less;
+            } else {
+                error = "Unknown operator in '" + std::string(text) + "'";
+                return false;
+            }
+            clause.value = std::string(Trim(rest.substr(width)));
+            if (clause.op == Clause::Op::Greater || clause.op == Clause::Op::Less) {
+                char* end = nullptr;
+                clause.number = std::strtod(clause.value.c_str(), &end);
+                if (clause.value.empty() || *end != '\0') {
+                    error = "Not a number in '" + std::string(text) + "'";
+                    return false;
+                }
+            }
+        }
+        field = Trim(field);
+        if (!IsFieldName(field)) {
+            error = "Bad field name in '" + std::string(text) + "'";
+            return false;
+        }
+        clause.field = std::string(field);
+        clauses.push_back(std::move(clause));
+    }
+    if (clauses.empty()) {
+        error = "Empty predicate";
+        return false;
+    }
+    return true;
+}
+
+bool ContextWatch::Holds(const Clause& clause, std::string_view value) {
+    // An absent field is null
+    JsonValue json = JsonReader::Parse(value.empty() ? std::string_view("null") : value);
+    std::string scratch;
+    switch (clause.op) {
+        case Clause::Op::Truthy:
+        case Clause::Op::Falsy: {
+            bool truthy = false;
+            switch (json.GetType()) {
+                case JsonValue::Type::Bool: truthy = json.AsBool(); break;
+                case JsonValue::Type::Number: truthy = json.AsDouble() != 0.0; break;
+                case JsonValue::Type::String: truthy = !json.AsString(scratch).empty(); break;
+                case JsonValue::Type::Array:
+                case JsonValue::Type::Object: truthy = json.Size() > 0; break;
+                default: break;
+            }
+            return truthy == (clause.op == Clause::Op::Truthy);
+        }
+        case Clause::Op::Equal:
+        case Clause::Op::NotEqual: {
+            // Strings by content; anything else as serialized ("true", "42")
+            bool equal = json.IsString() ? json.AsString(scratch) == clause.value
+                                         : json.Raw() == clause.value;
+            return equal == (clause.op == Clause::Op::Equal);
+        }
+        case Clause::Op::Contains:
+            return json.IsString() && ContainsIgnoringCase(json.AsString(scratch), clause.value);
+        case Clause::Op::Greater:
+            return json.IsNumber() && json.AsDouble() > clause.number;
+        case Clause::Op::Less:
+            return json.IsNumber() && json.AsDouble() < clause.number;
+    }
+    return false;
+}
+
+bool ContextWatch::Evaluate(const Watch& watch, const ContextCollector::Snapshot& snapshot) {
+    for (const Clause& clause : watch.clauses) {
+        if (!Holds(clause, snapshot.FindMember(clause.field))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string ContextWatch::Project(const Watch& watch, const ContextCollector::Snapshot& snapshot) {
+    std::vector<std::string_view> keys(watch.fields.begin(), watch.fields.end());
+    return snapshot.Project(keys);
+}
+
+// ============================================================================
+// Subscriptions
+// ============================================================================
+
+bool ContextWatch::Subscribe(std::string_view where, std::string_view fields, HttpResponse& response,
+                             std::string& error) {
+    Watch watch;
+    if (!Parse(where, watch.clauses, error)) {
+        return false;
+    }
+    for (const Clause& clause : watch.clauses) {
+        if (std::find(watch.fields.begin(), watch.fields.end(), clause.field) == watch.fields.end()) {
+            watch.fields.push_back(clause.field);
+        }
+    }
+    size_t extras = 0;
+    while (!fields.empty() && extras < MAX_EXTRA_FIELDS) {
+        size_t comma = fields.find(',');
+        std::string field(Trim(fields.substr(0, comma)));
+        fields = comma == std::string_view::npos ? std::string_view() : fields.substr(comma + 1);
+        if (!field.empty() && std::find(watch.fields.begin(), watch.fields.end(), field) == watch.fields.end()) {
+            watch.fields.push_back(std::move(field));
+            extras++;
+        }
+    }
+
+    std::vector<std::string_view> read(watch.fields.begin(), watch.fields.end());
+    collector.NoteReader(read);
+    std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.GetSnapshot();
+    watch.matched = Evaluate(watch, *snapshot);
+    watch.version = snapshot->version;
+    watch.createdMs = NowMs();
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (watches.size() >= MAX_WATCHES) {
+            error = "Too many watches (" + std::to_string(MAX_WATCHES) + ")";
+            return false;
+        }
+        id = nextId++;
+        watch.stream = "watch/" + std::to_string(id);
+        for (const Clause& clause : watch.clauses) {
+            std::vector<uint64_t>& ids = watchesByField[clause.field];
+            if (ids.empty() || ids.back() != id) {
+                ids.push_back(id);
+            }
+        }
+        response.StartEventStream(watch.stream);
+        response.SetBody("retry: " + std::to_string(RECONNECT_DELAY_MS) + "\n" +
+                         HttpServer::FormatEvent(watch.matched ? "match" : "clear", Project(watch, *snapshot),
+                                                 std::to_string(snapshot->version)));
+        response.status = 200;
+        watches.emplace(id, std::move(watch));
+    }
+    LOG_DEBUG("ContextWatch", "Watch " << id << " added: " << std::string(where));
+    return true;
+}
+
+void ContextWatch::DropClosed() {
+    std::vector<std::pair<uint64_t, std::string>> candidates;
+    int64_t now = NowMs();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& [id, watch] : watches) {
+            if (now - watch.createdMs >= CONNECT_GRACE_MS) {
+                candidates.emplace_back(id, watch.stream);
+            }
+        }
+    }
+    for (const auto& [id, stream] : candidates) {
+        if (server.GetSubscriberCount(stream) > 0) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = watches.find(id);
+        if (it == watches.end()) {
+            continue;
+        }
+        for (const Clause& clause : it->second.clauses) {
+            auto byField = watchesByField.find(clause.field);
+            if (byField == watchesByField.end()) {
+                continue;
+            }
+            std::vector<uint64_t>& ids = byField->second;
+            ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+            if (ids.empty()) {
+                watchesByField.erase(byField);
+            }
+        }
+        watches.erase(it);
+        LOG_DEBUG("ContextWatch", "Watch " << id << " closed");
+    }
+}
+
+void ContextWatch::NoteReaders() {
+    std::vector<std::string> fields;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (watches.empty()) {
+            return;
+        }
+        for (const auto& [id, watch] : watches) {
+            fields.insert(fields.end(), watch.fields.begin(), watch.fields.end());
+        }
+    }
+    std::sort(fields.begin(), fields.end());
+    fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+    std::vector<std::string_view> read(fields.begin(), fields.end());
+    collector.NoteReader(read);
+}
+
+void ContextWatch::EvaluateThread() {
+    std::shared_ptr<const ContextCollector::Snapshot> previous = collector.GetSnapshot();
+    int64_t lastSweepMs = NowMs();
+
+    struct Pending {
+        std::string stream;
+        const char* event;
+        std::string data;
+    };
+    std::vector<Pending> pending;
+    std::vector<std::string_view> changed;
+    std::vector<uint64_t> candidates;
+
+    while (running.load()) {
+        NoteReaders();
+        if (NowMs() - lastSweepMs >= SWEEP_MS) {
+            DropClosed();
+            lastSweepMs = NowMs();
+        }
+        std::shared_ptr<const ContextCollector::Snapshot> snapshot =
+            collector.WaitForSnapshot(previous->stateVersion, WAIT_SLICE_MS);
+        if (snapshot->version == previous->version) {
+            previous = snapshot;
+            continue;
+        }
+        TRACE_ZONE("ContextWatch::Evaluate");
+
+        // Members whose serialized value moved (or appeared, or went away)
+        changed.clear();
+        for (const auto& member : snapshot->members) {
+            if (previous->FindMember(member.first) != member.second) {
+                changed.push_back(member.first);
+            }
+        }
+        for (const auto& member : previous->members) {
+            if (snapshot->FindMember(member.first).empty()) {
+                changed.push_back(member.first);
+            }
+        }
+
+        pending.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            candidates.clear();
+            for (std::string_view field : changed) {
+                auto byField = watchesByField.find(std::string(field));
+                if (byField != watchesByField.end()) {
+                    candidates.insert(candidates.end(), byField->second.begin(), byField->second.end());
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+            for (uint64_t id : candidates) {
+                auto it = watches.find(id);
+                if (it == watches.end() || it->second.version >= snapshot->version) {
+                    continue;       // Subscribed against this snapshot already
+                }
+                Watch& watch = it->second;
+                bool matched = Evaluate(watch, *snapshot);
+                watch.version = snapshot->version;
+                // A field it names changed: a new match while it holds
+                if (matched || watch.matched) {
+                    pending.push_back({ watch.stream, matched ? "match" : "clear", Project(watch, *snapshot) });
+                }
+                watch.matched = matched;
+            }
+        }
+
+        std::string id = std::to_string(snapshot->version);
+        for (const Pending& event : pending) {
+            server.PublishEvent(event.stream, event.event, event.data, id);
+        }
+        previous = snapshot;
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ContextCollector.h"
+#include "HttpServer.h"
+
+/**
+ * ContextWatch - Server-side subscriptions to conditions on /context
+ *
+ * Clients that poll /context to notice "a meeting app came to the front and
+ * someone spoke" register the condition instead: GET
+ * /context/watch?where=<predicate>[&fields=a,b] opens a Server-Sent Events
+ * stream that only carries the moments it matches.
+ *
+ * Predicate: clauses over top-level context fields, comma-separated, all of
+ * which must hold:
+ *   field            truthy: true, a non-zero number, a non-empty string,
+ *                    array or object (not null)
+ *   !field           not truthy
+ *   field=value      string equal (or number/bool, as written)
+ *   field!=value
+ *   field~text       string contains text, ASCII case-insensitive
+ *   field>n field<n  numeric
+ * e.g. activeAppCategory=meeting,voiceTranscription
+ *
+ * Events: "match" when the predicate starts to hold, and again whenever a
+ * field it names changes while it still holds (each new transcript during
+ * the meeting); "clear" when it stops holding. The data is the predicate's
+ * fields plus any in `fields`, projected from the snapshot. The stream opens
+ * with the current state.
+ *
+ * Evaluation is incremental: a thread waits for each new snapshot (the
+ * collector rebuilds one per bus update that changes the context), diffs its
+ * members against the previous one, and evaluates only the watches that name
+ * a changed field, so the cost follows changes, not watches x poll rate.
+ * While any watch is open the collector is told which fields are read
+ * (NoteReader), so only the system sources behind them keep probing.
+ *
+ * A watch is dropped once its connection is gone. At most MAX_WATCHES.
+ *
+ * Usage:
+ *   ContextWatch watch(collector, server);
+ *   watch.Start();
+ *   // in the request handler, for GET /context/watch:
+ *   std::string error;
+ *   if (!watch.Subscribe(where, fields, response, error)) { ... 400 ... }
+ */
+class ContextWatch {
+public:
+    static constexpr size_t MAX_WATCHES = 256;
+    static constexpr size_t MAX_CLAUSES = 16;
+    static constexpr size_t MAX_EXTRA_FIELDS = 32;
+
+    ContextWatch(ContextCollector& collector, HttpServer& server);
+    ~ContextWatch();
+
+    ContextWatch(const ContextWatch&) = delete;
+    ContextWatch& operator=(const ContextWatch&) = delete;
+
+    void Start();
+    void Stop();
+
+    /**
+     * @brief Register a predicate and turn the response into its event stream
+     * @param fields Comma-separated fields sent along with the predicate's
+     * @return false with `error` set when the predicate doesn't parse or the
+     *         watch limit is reached (the response is left to the caller)
+     */
+    bool Subscribe(std::string_view where, std::string_view fields, HttpResponse& response, std::string& error);
+
+    size_t GetWatchCount() const;
+
+private:
+    struct Clause {
+        enum class Op { Truthy, Falsy, Equal, NotEqual, Contains, Greater, Less };
+        std::string field;
+        Op op = Op::Truthy;
+        std::string value;
+        double number = 0.0;
+    };
+
+    struct Watch {
+        std::string stream;                 // The connection's SSE stream name
+        std::vector<Clause> clauses;
+        std::vector<std::string> fields;    // Sent with each event: clause fields, then extras
+        bool matched = false;
+        uint64_t version = 0;               // Document version last evaluated
+        int64_t createdMs = 0;
+    };
+
+    static bool Parse(std::string_view where, std::vector<Clause>& clauses, std::string& error);
+    static bool Holds(const Clause& clause, std::string_view value);
+    static bool Evaluate(const Watch& watch, const ContextCollector::Snapshot& snapshot);
+    static std::string Project(const Watch& watch, const ContextCollector::Snapshot& snapshot);
+    void EvaluateThread();
+    void NoteReaders();
+    void DropClosed();
+    static int64_t NowMs();
+
+    static constexpr int RECONNECT_DELAY_MS = 2000;     // Sent as the SSE retry hint
+    static constexpr int WAIT_SLICE_MS = 500;           // Stop() latency
+    static constexpr int64_t SWEEP_MS = 5000;           // Closed-connection check
+    static constexpr int64_t CONNECT_GRACE_MS = 5000;   // A new stream may not be registered yet
+
+    ContextCollector& collector;
+    HttpServer& server;
+
+    mutable std::mutex mutex;               // Everything below
+    uint64_t nextId;
+    std::map<uint64_t, Watch> watches;
+    std::unordered_map<std::string, std::vector<uint64_t>> watchesByField;     // Clause fields only
+
+    std::atomic<bool> running;
+    std::thread evaluateThread;
+};
@@ -0,0 +1,203 @@
+#include "CpuBudget.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <windows.h>
+#include "Log.h"
+
+CpuBudget& CpuBudget::Instance() {
+    static CpuBudget instance;
+    return instance;
+}
+
+CpuBudget::CpuBudget()
+    : logicalProcessors((std::max)(1, static_cast<int>(std::thread::hardware_concurrency())))
+    , pinningEnabled(false)
+    , hybrid(false)
+{
+    // Affinity masks only cover processor group 0
+    int n = (std::min)(logicalProcessors, 64);
+
+    // Core 0 belongs to the audio path; everything heavy stays off it
+    uint64_t audioCores = CoreRange(0, 1);
+    int heavyCores = (std::max)(1, n - 1);
+    int heavyFirst = n > 1 ? 1 : 0;
+
+    int whisperCores = heavyCores;
+    int visionCores = heavyCores;
+    uint64_t whisperMask = CoreRange(heavyFirst, heavyCores);
+    uint64_t visionMask = whisperMask;
+    if (n >= 4) {
+        // Whisper feeds the voice latency SLO, so it gets the larger half
+        whisperCores = (heavyCores + 1) / 2;
+        visionCores = heavyCores - whisperCores;
+        whisperMask = CoreRange(heavyFirst, whisperCores);
+        visionMask = CoreRange(heavyFirst + whisperCores, visionCores);
+    }
+
+    allocations[static_cast<int>(Subsystem::Capture)] = {1, audioCores, THREAD_PRIORITY_HIGHEST, Qos::Realtime};
+    allocations[static_cast<int>(Subsystem::Vad)] = {1, audioCores, THREAD_PRIORITY_ABOVE_NORMAL, Qos::Interactive};
+    allocations[static_cast<int>(Subsystem::Whisper)] = {(std::min)(8, whisperCores), whisperMask, THREAD_PRIORITY_NORMAL,
+                                                         Qos::Utility};
+    allocations[static_cast<int>(Subsystem::Vision)] = {(std::min)(4, visionCores), visionMask, THREAD_PRIORITY_BELOW_NORMAL,
+                                                        Qos::Eco};
+    // The context summary is a nicety: it only gets what captions leave idle
+    allocations[static_cast<int>(Subsystem::Fusion)] = {(std::max)(1, (std::min)(4, visionCores) / 2), visionMask,
+                                                        THREAD_PRIORITY_LOWEST, Qos::Eco};
+    // Short tasks between the engines: a few threads that may run anywhere off the audio core
+    allocations[static_cast<int>(Subsystem::Tasks)] = {(std::max)(2, (std::min)(4, heavyCores / 4)),
+                                                       whisperMask | visionMask, THREAD_PRIORITY_NORMAL, Qos::Default};
+
+    DetectHybrid();
+
+    std::string split;
+    for (int i = 0; i < static_cast<int>(Subsystem::Count); ++i) {
+        split += std::string(" ") + Name(static_cast<Subsystem>(i)) + "=" + std::to_string(allocations[i].threads);
+        if (hybrid) {
+            split += std::string("/") + QosName(allocations[i].qos);
+        }
+    }
+    LOG_INFO("CpuBudget", logicalProcessors << " logical processors"
+             << (hybrid ? " (" + std::to_string(performanceCpuSets.size()) + " P, " +
+                          std::to_string(efficiencyCpuSets.size()) + " E)" : std::string())
+             << ":" << split << " threads");
+}
+
+void CpuBudget::DetectHybrid() {
+    ULONG length = 0;
+    GetSystemCpuSetInformation(nullptr, 0, &length, GetCurrentProcess(), 0);
+    if (length == 0) {
+        return;
+    }
+    std::vector<uint8_t> buffer(length);
+    auto* first = reinterpret_cast<SYSTEM_CPU_SET_INFORMATION*>(buffer.data());
+    if (!GetSystemCpuSetInformation(first, length, &length, GetCurrentProcess(), 0)) {
+        return;
+    }
+
+    BYTE lowest = 0xFF;
+    BYTE highest = 0;
+    for (ULONG offset = 0; offset < length;) {
+        auto* entry = reinterpret_cast<SYSTEM_CPU_SET_INFORMATION*>(buffer.data() + offset);
+        if (entry->Type == CpuSetInformation) {
+            lowest = (std::min)(lowest, entry->CpuSet.EfficiencyClass);
+            highest = (std::max)(highest, entry->CpuSet.EfficiencyClass);
+        }
+        offset += entry->Size;
+    }
+    if (lowest >= highest) {
+        return;                                 // One class: not hybrid
+    }
+    for (ULONG offset = 0; offset < length;) {
+        auto* entry = reinterpret_cast<SYSTEM_CPU_SET_INFORMATION*>(buffer.data() + offset);
+        if (entry->Type == CpuSetInformation) {
+            if (entry->CpuSet.EfficiencyClass == highest) {
+                performanceCpuSets.push_back(entry->CpuSet.Id);
+            } else if (entry->CpuSet.EfficiencyClass == lowest) {
+                efficiencyCpuSets.push_back(entry->CpuSet.Id);
+            }
+        }
+        offset += entry->Size;
+    }
+    hybrid = !performanceCpuSets.empty() && !efficiencyCpuSets.empty();
+}
+
+const std::vector<unsigned long>* CpuBudget::CpuSetsFor(Subsystem subsystem) const {
+    if (!hybrid || pinningEnabled) {
+        return nullptr;
+    }
+    const Allocation& allocation = Get(subsystem);
+    switch (allocation.qos) {
+        case Qos::Realtime:
+        case Qos::Interactive:
+            return &performanceCpuSets;
+        case Qos::Utility:
+        case Qos::Eco:
+            // Too few E-cores for the subsystem's threads: no preference rather than a pile-up
+            if (efficiencyCpuSets.size() >= static_cast<size_t>(allocation.threads)) {
+                return &efficiencyCpuSets;
+            }
+            return nullptr;
+        default:
+            return nullptr;
+    }
+}
+
+uint64_t CpuBudget::CoreRange(int first, int count) {
+    uint64_t mask = 0;
+    for (int core = first; core < first + count && core < 64; ++core) {
+        mask |= 1ull << core;
+    }
+    return mask;
+}
+
+void CpuBudget::SetThreads(Subsystem subsystem, int threads) {
+    if (threads <= 0) {
+        return;
+    }
+    Allocation& allocation = allocations[static_cast<int>(subsystem)];
+    if (allocation.threads != threads) {
+        LOG_INFO("CpuBudget", Name(subsystem) << "=" << threads << " threads (configured, was "
+                 << allocation.threads << ")");
+        allocation.threads = threads;
+    }
+}
+
+void CpuBudget::ApplyToCurrentThread(Subsystem subsystem) const {
+    const Allocation& allocation = Get(subsystem);
+    HANDLE thread = GetCurrentThread();
+
+    if (!SetThreadPriority(thread, allocation.priority)) {
+        LOG_WARNING("CpuBudget", "SetThreadPriority failed for " << Name(subsystem) << " (error " << GetLastError() << ")");
+    }
+
+    if (pinningEnabled && allocation.coreMask != 0 &&
+        !SetThreadAffinityMask(thread, static_cast<DWORD_PTR>(allocation.coreMask))) {
+        LOG_WARNING("CpuBudget", "SetThreadAffinityMask failed for " << Name(subsystem) << " (error " << GetLastError() << ")");
+    }
+
+    if (const std::vector<unsigned long>* cpuSets = CpuSetsFor(subsystem)) {
+        if (!SetThreadSelectedCpuSets(thread, cpuSets->data(), static_cast<ULONG>(cpuSets->size()))) {
+            LOG_WARNING("CpuBudget", "SetThreadSelectedCpuSets failed for " << Name(subsystem)
+                        << " (error " << GetLastError() << ")");
+        }
+    }
+
+    // EcoQoS: Realtime / Interactive opt out (ControlMask set, StateMask clear),
+    // Eco opts in on hybrid CPUs, the rest follow the process
+    if (allocation.qos == Qos::Realtime || allocation.qos == Qos::Interactive || UsesEcoQos(subsystem)) {
+        THREAD_POWER_THROTTLING_STATE throttling = {};
+        throttling.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+        throttling.ControlMask = THREAD_POWER_THROTTLING_EXECUTION_SPEED;
+        throttling.StateMask = UsesEcoQos(subsystem) ? THREAD_POWER_THROTTLING_EXECUTION_SPEED : 0;
+        SetThreadInformation(thread, ThreadPowerThrottling, &throttling, sizeof(throttling));
+    }
+
+    if (allocation.qos == Qos::Utility || allocation.qos == Qos::Eco) {
+        MEMORY_PRIORITY_INFORMATION memoryPriority = {};
+        memoryPriority.MemoryPriority = allocation.qos == Qos::Eco ? MEMORY_PRIORITY_LOW : MEMORY_PRIORITY_BELOW_NORMAL;
+        SetThreadInformation(thread, ThreadMemoryPriority, &memoryPriority, sizeof(memoryPriority));
+    }
+}
+
+const char* CpuBudget::Name(Subsystem subsystem) {
+    switch (subsystem) {
+        case Subsystem::Capture: return "capture";
+        case Subsystem::Vad:     return "vad";
+        case Subsystem::Whisper: return "whisper";
+        case Subsystem::Vision:  return "vision";
+        case Subsystem::Fusion:  return "fusion";
+        case Subsystem::Tasks:   return "tasks";
+        default:                 return "unknown";
+    }
+}
+
+const char* CpuBudget::QosName(Qos qos) {
+    switch (qos) {
+        case Qos::Realtime:    return "realtime";
+        case Qos::Interactive: return "interactive";
+        case Qos::Utility:     return "utility";
+        case Qos::Eco:         return "eco";
+        default:               return "default";
+    }
+}
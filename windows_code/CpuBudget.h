@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * CpuBudget - One process-wide split of the CPU between subsystems
+ *
+ * Whisper, the ORT pools and the capture threads used to size themselves
+ * independently (4 threads each), so on an 8-thread laptop a caption decode
+ * and a transcription together oversubscribed the machine and the audio
+ * path stalled behind them. The budget hands each subsystem a thread count,
+ * a core set and a priority from one plan.
+ *
+ * Plan for N logical processors:
+ *   Capture  WASAPI + camera grab threads   core 0         highest priority
+ *   Vad      processing thread (Silero)     core 0         above normal
+ *   Whisper  transcription workers          next ceil((N-1)/2) cores (max 8)
+ *   Vision   ORT global pool + caption loop remaining cores (max 4), below normal
+ *   Fusion   context LLM (ContextFusion)        Vision's cores, half the threads, lowest
+ *   Tasks    TaskScheduler workers          every core but 0, quarter of them (2-4), normal
+ * With fewer than 4 processors Whisper and Vision share every core but 0.
+ *
+ * Priorities are always applied; core pinning (SetThreadAffinityMask) is
+ * opt-in via SetPinningEnabled() because it can hurt on hybrid CPUs.
+ *
+ * Hybrid CPUs (P- and E-cores, told apart by the CPU sets' EfficiencyClass):
+ * left alone, Windows put whisper and caption work on P-cores next to the
+ * user's foreground apps and capture threads on E-cores. Each subsystem
+ * therefore also has a QoS class, applied with priority:
+ *
+ *   Qos          Subsystems        CPU sets    EcoQoS     Memory priority
+ *   Realtime     Capture           P-cores     never      normal
+ *   Interactive  Vad               P-cores     never      normal
+ *   Utility      Whisper           E-cores     -          below normal
+ *   Eco          Vision, Fusion    E-cores     always     low
+ *   Default      Tasks             -           -          -
+ *
+ * CPU sets (SetThreadSelectedCpuSets) are only used on hybrid CPUs, without
+ * pinning, and for Utility / Eco only when there are at least as many
+ * E-core logical processors as the subsystem has threads; EcoQoS only on
+ * hybrid CPUs, where it steers to E-cores rather than just lowering clocks
+ * (PowerPolicy still adds it from Balanced down). "never" opts the thread
+ * out of throttling even when the process is in EcoQoS; memory priority
+ * decides whose pages are trimmed first under memory pressure.
+ *
+ * Usage:
+ *   CpuBudget::Instance().SetPinningEnabled(true);        // before engines start
+ *   int n = CpuBudget::Instance().Get(CpuBudget::Subsystem::Whisper).threads;
+ *   CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vad);
+ *
+ * Configure before OrtRuntime::Instance() is first used: the ORT global pool
+ * is sized from the Vision allocation when the environment is created.
+ */
+class CpuBudget {
+public:
+    enum class Subsystem { Capture, Vad, Whisper, Vision, Fusion, Tasks, Count };
+
+    enum class Qos { Realtime, Interactive, Utility, Eco, Default };
+
+    struct Allocation {
+        int threads;            // Worker threads this subsystem should run
+        uint64_t coreMask;      // Logical processors (group 0) it may use
+        int priority;           // THREAD_PRIORITY_* value
+        Qos qos;
+    };
+
+    static CpuBudget& Instance();
+
+    CpuBudget(const CpuBudget&) = delete;
+    CpuBudget& operator=(const CpuBudget&) = delete;
+
+    const Allocation& Get(Subsystem subsystem) const { return allocations[static_cast<int>(subsystem)]; }
+
+    /**
+     * @brief Set priority, QoS (and the core mask when pinning) on the calling thread
+     */
+    void ApplyToCurrentThread(Subsystem subsystem) const;
+
+    /**
+     * @brief Whether ApplyToCurrentThread puts the subsystem's threads in EcoQoS
+     */
+    bool UsesEcoQos(Subsystem subsystem) const { return hybrid && Get(subsystem).qos == Qos::Eco; }
+
+    bool IsHybrid() const { return hybrid; }
+
+    /**
+     * @brief Override a subsystem's thread count (0 keeps the computed one); before engines start
+     */
+    void SetThreads(Subsystem subsystem, int threads);
+
+    void SetPinningEnabled(bool enabled) { pinningEnabled = enabled; }
+    bool IsPinningEnabled() const { return pinningEnabled; }
+
+    static const char* Name(Subsystem subsystem);
+    static const char* QosName(Qos qos);
+
+private:
+    CpuBudget();
+
+    static uint64_t CoreRange(int first, int count);
+
+    // Fills performanceCpuSets / efficiencyCpuSets; hybrid when both are non-empty
+    void DetectHybrid();
+    // CPU set ids the subsystem's threads should select, empty for no preference
+    const std::vector<unsigned long>* CpuSetsFor(Subsystem subsystem) const;
+
+    Allocation allocations[static_cast<int>(Subsystem::Count)];
+    int logicalProcessors;
+    bool pinningEnabled;
+
+    bool hybrid;
+    std::vector<unsigned long> performanceCpuSets;      // Highest EfficiencyClass
+    std::vector<unsigned long> efficiencyCpuSets;       // Lowest
+};
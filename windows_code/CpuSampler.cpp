@@ -0,0 +1,214 @@
+#include "CpuSampler.h"
+#include <winternl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "Log.h"
+#include "SystemCounters.h"
+#include "Trace.h"
+
+#pragma comment(lib, "ntdll.lib")
+
+CpuSampler& CpuSampler::Instance() {
+    static CpuSampler instance;
+    return instance;
+}
+
+CpuSampler::~CpuSampler() {
+    Stop();
+}
+
+bool CpuSampler::Start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return true;
+    }
+    // First reading: the baseline the first interval is measured against
+    if (!ReadCores(previousCores)) {
+        LOG_WARNING("CpuSampler", "Processor times unavailable; CPU usage falls back to PDH");
+        return false;
+    }
+    previousProcess = ProcessTime();
+    previousMs = GetTickCount64();
+    coreCount.store((std::min)(previousCores.size(), MAX_CORES));
+    running = true;
+    thread = std::thread(&CpuSampler::Run, this);
+    return true;
+}
+
+void CpuSampler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    samples.store(0);
+    systemSmoothed.store(-1.0);
+    processSmoothed.store(-1.0);
+}
+
+void CpuSampler::Run() {
+    TRACE_THREAD("CpuSampler");
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(SAMPLE_MS), [this]() { return !running; });
+            if (!running) {
+                break;
+            }
+        }
+        Sample(GetTickCount64());
+    }
+}
+
+bool CpuSampler::ReadCores(std::vector<CoreTimes>& times) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size_t processors = (std::min)(static_cast<size_t>(info.dwNumberOfProcessors), MAX_CORES);
+    queryBuffer.resize(processors * sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION));
+    ULONG returned = 0;
+    NTSTATUS status = NtQuerySystemInformation(SystemProcessorPerformanceInformation, queryBuffer.data(),
+                                               static_cast<ULONG>(queryBuffer.size()), &returned);
+    if (status < 0 || returned < sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION)) {
+        return false;
+    }
+    auto cores = reinterpret_cast<const SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION*>(queryBuffer.data());
+    times.resize(returned / sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION));
+    for (size_t core = 0; core < times.size(); core++) {
+        // Kernel time includes the idle time
+        uint64_t total = static_cast<uint64_t>(cores[core].KernelTime.QuadPart + cores[core].UserTime.QuadPart);
+        times[core].total = total;
+        times[core].busy = total - static_cast<uint64_t>(cores[core].IdleTime.QuadPart);
+    }
+    return true;
+}
+
+uint64_t CpuSampler::ProcessTime() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return ticks(kernel) + ticks(user);
+}
+
+void CpuSampler::Sample(uint64_t nowMs) {
+    if (!ReadCores(currentCores)) {
+        return;
+    }
+    if (currentCores.size() != previousCores.size()) {
+        // Processors came online: start over from this reading
+        previousCores.swap(currentCores);
+        return;
+    }
+    uint64_t process = ProcessTime();
+
+    // Every processor's total time advances with the wall clock: their sum
+    // is the interval's processor time, the denominator for the process too
+    uint64_t busySum = 0;
+    uint64_t totalSum = 0;
+    double alpha = 1.0 - std::exp(-static_cast<double>(nowMs - previousMs) / SMOOTH_MS);
+    bool first = samples.load() == 0;
+    size_t cores = coreCount.load();
+    for (size_t core = 0; core < currentCores.size(); core++) {
+        uint64_t busy = currentCores[core].busy - previousCores[core].busy;
+        uint64_t total = currentCores[core].total - previousCores[core].total;
+        busySum += busy;
+        totalSum += total;
+        if (core < cores && total > 0) {
+            float percent = static_cast<float>((std::min)(100.0, 100.0 * busy / total));
+            float smoothed = coreSmoothed[core].load(std::memory_order_relaxed);
+            coreSmoothed[core].store(first ? percent : smoothed + static_cast<float>(alpha) * (percent - smoothed),
+                                     std::memory_order_relaxed);
+        }
+    }
+    previousCores.swap(currentCores);
+    if (totalSum == 0) {
+        return;
+    }
+
+    double system = (std::min)(100.0, 100.0 * busySum / totalSum);
+    double own = process >= previousProcess ? (std::min)(100.0, 100.0 * (process - previousProcess) / totalSum) : 0.0;
+    previousProcess = process;
+    previousMs = nowMs;
+
+    double systemPrevious = systemSmoothed.load();
+    double processPrevious = processSmoothed.load();
+    systemSmoothed.store(first ? system : systemPrevious + alpha * (system - systemPrevious));
+    processSmoothed.store(first ? own : processPrevious + alpha * (own - processPrevious));
+
+    Slot& slot = ring[ringWrites.load() % RING_SIZE];
+    slot.systemPercent.store(static_cast<float>(system));
+    slot.processPercent.store(static_cast<float>(own));
+    slot.timeMs.store(nowMs);
+    ringWrites.fetch_add(1);
+    samples.fetch_add(1);
+}
+
+double CpuSampler::SystemPercent() const {
+    if (!IsRunning()) {
+        return SystemCounters::Instance().Get().cpuPercent;
+    }
+    return systemSmoothed.load();
+}
+
+std::vector<double> CpuSampler::CorePercent() const {
+    if (!IsRunning()) {
+        return SystemCounters::Instance().Get().corePercent;
+    }
+    std::vector<double> cores(coreCount.load());
+    for (size_t core = 0; core < cores.size(); core++) {
+        cores[core] = coreSmoothed[core].load(std::memory_order_relaxed);
+    }
+    return cores;
+}
+
+double CpuSampler::ProcessPercent() const {
+    return IsRunning() ? processSmoothed.load() : -1.0;
+}
+
+double CpuSampler::AverageSystemPercent(int windowMs) const {
+    if (!IsRunning()) {
+        return SystemCounters::Instance().Get().cpuPercent;
+    }
+    uint64_t writes = ringWrites.load();
+    uint64_t since = GetTickCount64() - static_cast<uint64_t>((std::max)(windowMs, SAMPLE_MS));
+    double sum = 0.0;
+    size_t count = 0;
+    for (uint64_t index = writes; index > 0 && count < RING_SIZE; index--) {
+        const Slot& slot = ring[(index - 1) % RING_SIZE];
+        if (slot.timeMs.load() < since) {
+            break;
+        }
+        sum += slot.systemPercent.load();
+        count++;
+    }
+    return count > 0 ? sum / count : systemSmoothed.load();
+}
+
+std::string CpuSampler::FormatPrometheus() const {
+    if (!IsRunning()) {
+        return std::string();
+    }
+    std::string out;
+    char line[128];
+    std::snprintf(line, sizeof(line), "perception_cpu_system_percent %.2f\n", systemSmoothed.load());
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_cpu_process_percent %.2f\n", processSmoothed.load());
+    out += line;
+    size_t cores = coreCount.load();
+    for (size_t core = 0; core < cores; core++) {
+        std::snprintf(line, sizeof(line), "perception_cpu_core_percent{core=\"%zu\"} %.2f\n", core,
+                      static_cast<double>(coreSmoothed[core].load(std::memory_order_relaxed)));
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <windows.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * CpuSampler - Machine, per-core and engine CPU usage on a fixed cadence
+ *
+ * A sampler thread reads every logical processor's idle/kernel/user times
+ * (NtQuerySystemInformation, SystemProcessorPerformanceInformation) and
+ * this process's CPU time every SAMPLE_MS. Each interval's usage goes into
+ * a ring of RING_SIZE samples and into exponentially smoothed values
+ * (SMOOTH_MS time constant), so one busy interval doesn't swing the camera
+ * cadence or /context.
+ *
+ * Readers never query the OS nor take a lock: the values are atomics the
+ * sampler thread publishes, so the caption loop, the context sampler and
+ * HTTP handlers can read as often as they like. Values of one read may come
+ * from adjacent samples.
+ *
+ * Until Start() (tools and tests that never start it) the getters fall back
+ * to the shared PDH sample of SystemCounters; the engine's own usage is
+ * then unavailable.
+ *
+ * Usage:
+ *   CpuSampler::Instance().Start();
+ *   double cpu = CpuSampler::Instance().SystemPercent();      // Smoothed, -1 when unavailable
+ *   double mine = CpuSampler::Instance().ProcessPercent();    // Of all processors
+ *
+ * Only the first processor group is sampled (64 logical processors).
+ */
+class CpuSampler {
+public:
+    static constexpr int SAMPLE_MS = 250;
+    static constexpr int SMOOTH_MS = 2000;
+    static constexpr size_t RING_SIZE = 64;             // 16 s of samples
+    static constexpr size_t MAX_CORES = 64;
+
+    static CpuSampler& Instance();
+
+    CpuSampler(const CpuSampler&) = delete;
+    CpuSampler& operator=(const CpuSampler&) = delete;
+
+    // Start the sampler thread (false if the processor times can't be read)
+    bool Start();
+    void Stop();
+    bool IsRunning() const { return samples.load() > 0; }
+
+    // Smoothed machine-wide usage, percent; -1 when unavailable
+    double SystemPercent() const;
+
+    // Smoothed usage per logical processor, in processor order
+    std::vector<double> CorePercent() const;
+
+    // Smoothed usage of this process, percent of all logical processors; -1 when unavailable
+    double ProcessPercent() const;
+
+    // Mean machine-wide usage over the last windowMs (raw samples); -1 when unavailable
+    double AverageSystemPercent(int windowMs) const;
+
+    // Prometheus text: smoothed system, per-core and process usage
+    std::string FormatPrometheus() const;
+
+private:
+    CpuSampler() = default;
+    ~CpuSampler();
+
+    struct CoreTimes {
+        uint64_t busy = 0;
+        uint64_t total = 0;
+    };
+
+    struct Slot {
+        std::atomic<uint64_t> timeMs{0};
+        std::atomic<float> systemPercent{0.0f};
+        std::atomic<float> processPercent{0.0f};
+    };
+
+    void Run();
+    bool ReadCores(std::vector<CoreTimes>& times);
+    static uint64_t ProcessTime();
+    void Sample(uint64_t nowMs);
+
+    // Sampler thread only
+    std::vector<CoreTimes> previousCores;
+    std::vector<CoreTimes> currentCores;
+    std::vector<BYTE> queryBuffer;
+    uint64_t previousProcess = 0;
+    uint64_t previousMs = 0;
+
+    // Published
+    std::atomic<uint64_t> samples{0};
+    std::atomic<double> systemSmoothed{-1.0};
+    std::atomic<double> processSmoothed{-1.0};
+    std::atomic<size_t> coreCount{0};
+    std::array<std::atomic<float>, MAX_CORES> coreSmoothed{};
+    std::array<Slot, RING_SIZE> ring;
+    std::atomic<uint64_t> ringWrites{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+    std::thread thread;
+};
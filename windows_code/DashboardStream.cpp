@@ -0,0 +1,259 @@
+#include "DashboardStream.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "Log.h"
+
+namespace {
+
+// The fields the panels show (NoteReader): their sources stay live while a dashboard is open
+const std::vector<std::string_view>& DashboardFields() {
+    static const std::vector<std::string_view> FIELDS = {
+        "activeApp", "activeAppCategory", "fusedContext", "voiceTranscription", "voicePartial",
+        "cameraDescription", "cpuUsage", "memoryUsage", "memoryUsedGB", "totalMemoryGB", "battery",
+        "isCharging", "networkConnected", "networkType", "cameraLatency", "voiceLatency",
+        "contextUpdateLatency", "RecentPeriodActiveApps",
+    };
+    return FIELDS;
+}
+
+// Window owners that are never what the user was working in
+bool IsShellApp(std::string_view name) {
+    return name.empty() || name == "Unknown" || name == "Desktop" || name == "Program Manager" || name == "csc_ui";
+}
+
+void CopyMember(JsonWriter& writer, const ContextCollector::Snapshot& snapshot, const char* key,
+                std::string_view member) {
+    std::string_view value = snapshot.FindMember(member);
+    writer.Key(key);
+    if (value.empty()) {
+        writer.Null();
+    } else {
+        writer.Raw(value);
+    }
+}
+
+} // namespace
+
+const std::array<DashboardStream::SparklineStage, DashboardStream::SPARKLINE_COUNT> DashboardStream::SPARKLINE_STAGES = {{
+    { "voice", PipelineLatency::Stage::UtteranceEndToEnd },
+    { "whisper", PipelineLatency::Stage::Whisper },
+    { "camera", PipelineLatency::Stage::Encoder },
+    { "http", PipelineLatency::Stage::HttpSend },
+}};
+
+DashboardStream::DashboardStream(ContextCollector& collector, HttpServer& server, int minIntervalMs)
+    : collector(collector)
+    , server(server)
+    , minInterval(minIntervalMs)
+    , bucketStart(std::chrono::steady_clock::now())
+    , sparklineVersion(0)
+    , currentVersion(0)
+    , currentSparklineVersion(0)
+    , eventId(0)
+    , running(false)
+{
+    for (size_t i = 0; i < SPARKLINE_COUNT; ++i) {
+        LatencyHistogram& histogram = PipelineLatency::Get(SPARKLINE_STAGES[i].stage);
+        sparklines[i].count = histogram.Count();
+        sparklines[i].sumMs = histogram.SumMs();
+    }
+}
+
+DashboardStream::~DashboardStream() {
+    Stop();
+}
+
+void DashboardStream::Start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    publishThread = std::thread(&DashboardStream::PublishThread, this);
+    LOG_INFO("DashboardStream", "Publishing /dashboard/stream (min interval " << minInterval.count() << "ms)");
+}
+
+void DashboardStream::Stop() {
+    running.store(false);
+    if (publishThread.joinable()) {
+        publishThread.join();
+    }
+}
+
+void DashboardStream::Subscribe(HttpResponse& response) {
+    collector.NoteReader(DashboardFields());
+    uint64_t id = 0;
+    std::string model = Current(*collector.GetSnapshot(), id);
+
+    response.StartEventStream(STREAM_NAME);
+    response.SetBody("retry: " + std::to_string(RECONNECT_DELAY_MS) + "\n" +
+                     HttpServer::FormatEvent("dashboard", model, std::to_string(id)));
+    response.status = 200;
+}
+
+std::string DashboardStream::Current(const ContextCollector::Snapshot& snapshot, uint64_t& id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (current.empty() || currentVersion != snapshot.version || currentSparklineVersion != sparklineVersion) {
+        std::string built = Build(snapshot);
+        if (built != current) {
+            current = std::move(built);
+            ++eventId;
+        }
+        currentVersion = snapshot.version;
+        currentSparklineVersion = sparklineVersion;
+    }
+    id = eventId;
+    return current;
+}
+
+std::string DashboardStream::Build(const ContextCollector::Snapshot& snapshot) const {
+    std::string out;
+    out.reserve(2048);
+    JsonWriter writer(out);
+    writer.BeginObject();
+    CopyMember(writer, snapshot, "app", "activeApp");
+    CopyMember(writer, snapshot, "category", "activeAppCategory");
+    CopyMember(writer, snapshot, "fused", "fusedContext");
+    CopyMember(writer, snapshot, "voice", "voiceTranscription");
+    CopyMember(writer, snapshot, "voicePartial", "voicePartial");
+    CopyMember(writer, snapshot, "camera", "cameraDescription");
+
+    writer.Key("system").BeginObject();
+    CopyMember(writer, snapshot, "cpu", "cpuUsage");
+    CopyMember(writer, snapshot, "memory", "memoryUsage");
+    CopyMember(writer, snapshot, "memoryUsedGB", "memoryUsedGB");
+    CopyMember(writer, snapshot, "memoryTotalGB", "totalMemoryGB");
+    CopyMember(writer, snapshot, "battery", "battery");
+    CopyMember(writer, snapshot, "charging", "isCharging");
+    CopyMember(writer, snapshot, "online", "networkConnected");
+    CopyMember(writer, snapshot, "network", "networkType");
+    writer.EndObject();
+
+    writer.Key("latency").BeginObject();
+    CopyMember(writer, snapshot, "camera", "cameraLatency");
+    CopyMember(writer, snapshot, "voice", "voiceLatency");
+    CopyMember(writer, snapshot, "context", "contextUpdateLatency");
+    writer.EndObject();
+
+    writer.Key("apps");
+    WriteRecentApps(snapshot, writer);
+
+    writer.Key("sparklines").BeginObject();
+    writer.Key("bucketMs").Int(SPARKLINE_BUCKET_MS);
+    for (size_t i = 0; i < SPARKLINE_COUNT; ++i) {
+        writer.Key(SPARKLINE_STAGES[i].name).BeginArray();
+        for (double point : sparklines[i].points) {
+            if (point < 0.0) {
+                writer.Null();
+            } else {
+                writer.Double(point, 1);
+            }
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+
+    writer.EndObject();
+    return out;
+}
+
+void DashboardStream::WriteRecentApps(const ContextCollector::Snapshot& snapshot, JsonWriter& writer) const {
+    // One row per app, ordered by its latest use, with the time of every visit in the period
+    std::vector<std::pair<std::string, int64_t>> apps;
+    std::string_view value = snapshot.FindMember("RecentPeriodActiveApps");
+    JsonValue entries = JsonReader::Parse(value.empty() ? std::string_view("null") : value);
+    std::string scratch;
+    for (size_t index = entries.IsArray() ? entries.Size() : 0; index > 0; --index) {
+        JsonValue entry = entries[index - 1];       // Oldest first in the document
+        std::string_view name = entry["appName"].AsString(scratch);
+        if (IsShellApp(name)) {
+            continue;
+        }
+        int64_t seconds = entry["durationSeconds"].AsInt();
+        auto found = std::find_if(apps.begin(), apps.end(),
+                                  [&](const std::pair<std::string, int64_t>& app) { return app.first == name; });
+        if (found != apps.end()) {
+            found->second += seconds;
+        } else {
+            apps.emplace_back(std::string(name), seconds);
+        }
+    }
+
+    writer.BeginArray();
+    for (size_t i = 0; i < apps.size() && i < RECENT_APPS; ++i) {
+        writer.BeginObject();
+        writer.Key("name").String(apps[i].first);
+        writer.Key("seconds").Int(apps[i].second);
+        writer.EndObject();
+    }
+    writer.EndArray();
+}
+
+void DashboardStream::CloseSparklineBucket() {
+    for (size_t i = 0; i < SPARKLINE_COUNT; ++i) {
+        LatencyHistogram& histogram = PipelineLatency::Get(SPARKLINE_STAGES[i].stage);
+        Sparkline& sparkline = sparklines[i];
+        uint64_t count = histogram.Count();
+        double sumMs = histogram.SumMs();
+        // The histograms only grow; a reset leaves an empty bucket
+        double mean = count > sparkline.count ? (sumMs - sparkline.sumMs) / (count - sparkline.count) : -1.0;
+        sparkline.points.push_back(mean);
+        if (sparkline.points.size() > SPARKLINE_POINTS) {
+            sparkline.points.pop_front();
+        }
+        sparkline.count = count;
+        sparkline.sumMs = sumMs;
+    }
+    ++sparklineVersion;
+}
+
+void DashboardStream::PublishThread() {
+    const auto bucket = std::chrono::milliseconds(SPARKLINE_BUCKET_MS);
+    uint64_t seen = collector.GetSnapshot()->stateVersion;
+    auto lastPublish = std::chrono::steady_clock::now() - minInterval;
+    std::string published;
+
+    while (running.load()) {
+        bool watched = server.GetSubscriberCount(STREAM_NAME) > 0;
+        if (watched) {
+            collector.NoteReader(DashboardFields());
+        }
+        std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.WaitForSnapshot(seen, WAIT_SLICE_MS);
+        seen = snapshot->stateVersion;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto now = std::chrono::steady_clock::now();
+            if (now - bucketStart >= bucket) {
+                CloseSparklineBucket();
+                // Behind by more than a bucket (a suspended machine): start over from now
+                bucketStart = now - bucketStart >= 2 * bucket ? now : bucketStart + bucket;
+            }
+        }
+        if (!watched) {
+            continue;
+        }
+
+        uint64_t id = 0;
+        if (Current(*snapshot, id) == published) {
+            continue;
+        }
+
+        // Let the rest of a burst land before publishing
+        auto earliest = lastPublish + minInterval;
+        auto now = std::chrono::steady_clock::now();
+        if (now < earliest) {
+            std::this_thread::sleep_for(earliest - now);
+            snapshot = collector.GetSnapshot();
+            seen = snapshot->stateVersion;
+        }
+
+        std::string model = Current(*snapshot, id);
+        if (model == published) {
+            continue;
+        }
+        published = std::move(model);
+        server.PublishEvent(STREAM_NAME, "dashboard", published, std::to_string(id));
+        lastPublish = std::chrono::steady_clock::now();
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ContextCollector.h"
+#include "HttpServer.h"
+#include "JsonWriter.h"
+#include "PipelineLatency.h"
+
+/**
+ * DashboardStream - The dashboard's view model, pushed over Server-Sent Events
+ *
+ * dashboard.html used to take the whole /context document and rework it in
+ * JavaScript on every update. GET /dashboard/stream instead subscribes to a
+ * small document holding exactly what the panels show, built here once per
+ * change and shared by every open dashboard:
+ *   - the current app, fused summary, voice and camera text
+ *   - CPU, memory, battery and network, as the collector serialized them
+ *   - the last voice, camera and context latencies
+ *   - recent apps, newest first, one row per app, system shells left out
+ *   - latency sparklines: the mean of each SPARKLINE_STAGES stage per
+ *     SPARKLINE_BUCKET_MS, over the last SPARKLINE_POINTS buckets (null for
+ *     a bucket nothing was recorded in), from the PipelineLatency histograms
+ *
+ * A "dashboard" event is published only when the document's bytes change,
+ * at most once per minIntervalMs; with no subscriber nothing is built (the
+ * sparkline buckets are still closed, a few atomic loads each).
+ *
+ * Usage:
+ *   DashboardStream stream(collector, server);
+ *   stream.Start();
+ *   // in the request handler, for GET /dashboard/stream:
+ *   stream.Subscribe(response);
+ */
+class DashboardStream {
+public:
+    static constexpr const char* STREAM_NAME = "dashboard";
+    static constexpr int DEFAULT_MIN_INTERVAL_MS = 500;
+    static constexpr size_t RECENT_APPS = 5;
+    static constexpr int SPARKLINE_BUCKET_MS = 5000;
+    static constexpr size_t SPARKLINE_POINTS = 60;      // Five minutes
+
+    DashboardStream(ContextCollector& collector, HttpServer& server, int minIntervalMs = DEFAULT_MIN_INTERVAL_MS);
+    ~DashboardStream();
+
+    DashboardStream(const DashboardStream&) = delete;
+    DashboardStream& operator=(const DashboardStream&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Turn the response into a subscription, starting with the current view model
+    void Subscribe(HttpResponse& response);
+
+private:
+    // Sparkline name and the stage it follows
+    struct SparklineStage {
+        const char* name;
+        PipelineLatency::Stage stage;
+    };
+    static constexpr size_t SPARKLINE_COUNT = 4;
+    static const std::array<SparklineStage, SPARKLINE_COUNT> SPARKLINE_STAGES;
+
+    struct Sparkline {
+        uint64_t count = 0;             // Histogram totals when the bucket opened
+        double sumMs = 0.0;
+        std::deque<double> points;      // Bucket means, oldest first; negative = empty bucket
+    };
+
+    void PublishThread();
+    void CloseSparklineBucket();        // mutex held
+
+    // The view model for this snapshot, built if its document or the
+    // sparklines moved; id counts the distinct models built
+    std::string Current(const ContextCollector::Snapshot& snapshot, uint64_t& id);
+    std::string Build(const ContextCollector::Snapshot& snapshot) const;    // mutex held
+    void WriteRecentApps(const ContextCollector::Snapshot& snapshot, JsonWriter& writer) const;
+
+    static constexpr int RECONNECT_DELAY_MS = 2000;     // Sent as the SSE retry hint
+    static constexpr int WAIT_SLICE_MS = 500;           // Stop() latency, sparkline bucket lateness
+
+    ContextCollector& collector;
+    HttpServer& server;
+    std::chrono::milliseconds minInterval;
+
+    std::mutex mutex;                                   // Everything below
+    std::array<Sparkline, SPARKLINE_COUNT> sparklines;
+    std::chrono::steady_clock::time_point bucketStart;
+    uint64_t sparklineVersion;                          // Bumped as each bucket closes
+    std::string current;                                // The view model last built
+    uint64_t currentVersion;                            // Document version it was built from
+    uint64_t currentSparklineVersion;
+    uint64_t eventId;                                   // SSE id: counts distinct view models
+
+    std::atomic<bool> running;
+    std::thread publishThread;
+};
@@ -0,0 +1,249 @@
+#include "Deflate.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr size_t WINDOW_SIZE = 32768;
+constexpr size_t MIN_MATCH = 3;
+constexpr size_t MAX_MATCH = 258;
+constexpr int HASH_BITS = 15;
+
+// Length codes 257..285: base length and extra bits (RFC 1951 3.2.5)
+constexpr uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                        8193, 12289, 16385, 24577};
+constexpr uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// LSB-first bit packer; Huffman codes are reversed before they go in
+class BitWriter {
+public:
+    explicit BitWriter(std::string& out) : out(out) {}
+
+    void Put(uint32_t value, int bits) {
+        buffer |= static_cast<uint64_t>(value) << count;
+        count += bits;
+        while (count >= 8) {
+            out.push_back(static_cast<char>(buffer & 0xFF));
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+
+    void PutCode(uint32_t code, int bits) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < bits; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        Put(reversed, bits);
+    }
+
+    void Flush() {
+        if (count > 0) {
+            out.push_back(static_cast<char>(buffer & 0xFF));
+        }
+        buffer = 0;
+        count = 0;
+    }
+
+private:
+    std::string& out;
+    uint64_t buffer = 0;
+    int count = 0;
+};
+
+// Fixed literal/length tree (RFC 1951 3.2.6)
+void PutLiteralLength(BitWriter& writer, int symbol) {
+    if (symbol <= 143) {
+        writer.PutCode(0x30 + symbol, 8);
+    } else if (symbol <= 255) {
+        writer.PutCode(0x190 + (symbol - 144), 9);
+    } else if (symbol <= 279) {
+        writer.PutCode(symbol - 256, 7);
+    } else {
+        writer.PutCode(0xC0 + (symbol - 280), 8);
+    }
+}
+
+void PutMatch(BitWriter& writer, size_t length, size_t distance) {
+    int lengthCode = 28;
+    while (LENGTH_BASE[lengthCode] > length) {
+        --lengthCode;
+    }
+    PutLiteralLength(writer, 257 + lengthCode);
+    writer.Put(static_cast<uint32_t>(length - LENGTH_BASE[lengthCode]), LENGTH_EXTRA[lengthCode]);
+
+    int distanceCode = 29;
+    while (DISTANCE_BASE[distanceCode] > distance) {
+        --distanceCode;
+    }
+    writer.PutCode(distanceCode, 5);
+    writer.Put(static_cast<uint32_t>(distance - DISTANCE_BASE[distanceCode]), DISTANCE_EXTRA[distanceCode]);
+}
+
+uint32_t Hash3(const unsigned char* p) {
+    uint32_t value = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void CompressRaw(std::string_view data, std::string& out) {
+    BitWriter writer(out);
+    writer.Put(1, 1);       // BFINAL
+    writer.Put(1, 2);       // BTYPE = fixed Huffman
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    const size_t size = data.size();
+    std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+    std::vector<int32_t> previous(WINDOW_SIZE, -1);
+
+    auto insert = [&](size_t position) {
+        uint32_t hash = Hash3(bytes + position);
+        previous[position % WINDOW_SIZE] = head[hash];
+        head[hash] = static_cast<int32_t>(position);
+    };
+
+    size_t position = 0;
+    while (position < size) {
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+
+        if (position + MIN_MATCH <= size) {
+            size_t limit = (std::min)(MAX_MATCH, size - position);
+            int32_t candidate = head[Hash3(bytes + position)];
+            for (int chain = 0; chain < Deflate::MAX_CHAIN && candidate >= 0; ++chain) {
+                size_t distance = position - static_cast<size_t>(candidate);
+                if (distance > WINDOW_SIZE - 1) {
+                    break;
+                }
+                const unsigned char* match = bytes + candidate;
+                if (match[bestLength] == bytes[position + bestLength]) {
+                    size_t length = 0;
+                    while (length < limit && match[length] == bytes[position + length]) {
+                        ++length;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == limit) {
+                            break;
+                        }
+                    }
+                }
+                candidate = previous[candidate % WINDOW_SIZE];
+            }
+        }
+
+        if (bestLength >= MIN_MATCH) {
+            PutMatch(writer, bestLength, bestDistance);
+            for (size_t i = 0; i < bestLength; ++i, ++position) {
+                if (position + MIN_MATCH <= size) {
+                    insert(position);
+                }
+            }
+        } else {
+            PutLiteralLength(writer, bytes[position]);
+            if (position + MIN_MATCH <= size) {
+                insert(position);
+            }
+            ++position;
+        }
+    }
+
+    PutLiteralLength(writer, 256);      // End of block
+    writer.Flush();
+}
+
+// Uncompressed blocks, for input the fixed tree would expand (already compressed, random)
+void StoreRaw(std::string_view data, std::string& out) {
+    size_t offset = 0;
+    do {
+        size_t length = (std::min)(data.size() - offset, size_t(65535));
+        bool final = offset + length == data.size();
+        out.push_back(final ? 1 : 0);       // BFINAL, BTYPE = stored, padded to a byte
+        out.push_back(static_cast<char>(length & 0xFF));
+        out.push_back(static_cast<char>(length >> 8));
+        out.push_back(static_cast<char>(~length & 0xFF));
+        out.push_back(static_cast<char>((~length >> 8) & 0xFF));
+        out.append(data.data() + offset, length);
+        offset += length;
+    } while (offset < data.size());
+}
+
+void AppendLittleEndian(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void AppendBigEndian(std::string& out, uint32_t value) {
+    for (int i = 3; i >= 0; --i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+} // namespace
+
+std::string Deflate::Compress(std::string_view data, Container container) {
+    std::string out;
+    out.reserve(data.size() / 3 + 32);
+
+    if (container == Container::Gzip) {
+        // ID1 ID2 CM=deflate FLG=0 MTIME=0 XFL=0 OS=unknown
+        static const char header[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+        out.append(header, sizeof(header));
+    } else if (container == Container::Zlib) {
+        out.push_back('\x78');      // CM=8, 32 KB window
+        out.push_back('\x01');      // Fastest level, FCHECK so the pair is a multiple of 31
+    }
+
+    size_t headerSize = out.size();
+    CompressRaw(data, out);
+    size_t storedSize = data.size() + 5 * (data.size() / 65535 + 1);
+    if (out.size() - headerSize > storedSize) {
+        out.resize(headerSize);
+        StoreRaw(data, out);
+    }
+
+    if (container == Container::Gzip) {
+        AppendLittleEndian(out, Crc32(data));
+        AppendLittleEndian(out, static_cast<uint32_t>(data.size()));
+    } else if (container == Container::Zlib) {
+        AppendBigEndian(out, Adler32(data));
+    }
+    return out;
+}
+
+uint32_t Deflate::Crc32(std::string_view data) {
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> entries(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char c : data) {
+        crc = table[(crc ^ c) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+uint32_t Deflate::Adler32(std::string_view data) {
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (unsigned char c : data) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
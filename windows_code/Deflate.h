@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Deflate - Small RFC 1951 compressor for HTTP content codings
+ *
+ * Greedy LZ77 over a 32 KB window (hash chains, MAX_CHAIN candidates per
+ * position) emitted as a single fixed-Huffman block. It trades some ratio
+ * against zlib for having no dependency; on JSON with repeated keys it still
+ * gets typical 3-5x reductions, which is what matters for /context.
+ *
+ * Containers:
+ * - Gzip: RFC 1952 ("Content-Encoding: gzip")
+ * - Zlib: RFC 1950 ("Content-Encoding: deflate" - the zlib wrapper, not raw)
+ *
+ * Usage:
+ *   std::string gz = Deflate::Compress(body, Deflate::Container::Gzip);
+ */
+class Deflate {
+public:
+    enum class Container { Raw, Zlib, Gzip };
+
+    static constexpr int MAX_CHAIN = 32;
+
+    static std::string Compress(std::string_view data, Container container);
+
+    static uint32_t Crc32(std::string_view data);
+    static uint32_t Adler32(std::string_view data);
+};
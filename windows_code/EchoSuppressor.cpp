@@ -0,0 +1,387 @@
+#include "EchoSuppressor.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define ECHO_SUPPRESSOR_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits AVX intrinsics without /arch:AVX; GCC/Clang need a per-function target
+#if defined(ECHO_SUPPRESSOR_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ECHO_SUPPRESSOR_AVX_TARGET __attribute__((target("avx")))
+#else
+#define ECHO_SUPPRESSOR_AVX_TARGET
+#endif
+
+// ============================================================================
+// SIMD Helpers
+// ============================================================================
+
+namespace {
+
+bool CpuSupportsAVX() {
+#if defined(ECHO_SUPPRESSOR_X86) && defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) {
+        return false;
+    }
+    // OS must save YMM state on context switch
+    unsigned long long xcr0 = _xgetbv(0);
+    return (xcr0 & 0x6) == 0x6;
+#elif defined(ECHO_SUPPRESSOR_X86) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_cpu_supports("avx") != 0;
+#else
+    return false;
+#endif
+}
+
+// count is always a multiple of 8 (filter taps, decimated analysis span)
+#ifndef ECHO_SUPPRESSOR_X86
+float Dot(const float* a, const float* b, size_t count, bool) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// y += scale * x
+void Axpy(float* y, float scale, const float* x, size_t count, bool) {
+    for (size_t i = 0; i < count; ++i) {
+        y[i] += scale * x[i];
+    }
+}
+#else
+float DotSSE(const float* a, const float* b, size_t count) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (size_t i = 0; i < count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(acc);
+}
+
+ECHO_SUPPRESSOR_AVX_TARGET
+float DotAVX(const float* a, const float* b, size_t count) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    if (i < count) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum);
+}
+
+void AxpySSE(float* y, float scale, const float* x, size_t count) {
+    __m128 s = _mm_set1_ps(scale);
+    for (size_t i = 0; i < count; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(s, _mm_loadu_ps(x + i))));
+    }
+}
+
+ECHO_SUPPRESSOR_AVX_TARGET
+void AxpyAVX(float* y, float scale, const float* x, size_t count) {
+    __m256 s = _mm256_set1_ps(scale);
+    for (size_t i = 0; i < count; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(s, _mm256_loadu_ps(x + i))));
+    }
+}
+
+float Dot(const float* a, const float* b, size_t count, bool avx) {
+    return avx ? DotAVX(a, b, count) : DotSSE(a, b, count);
+}
+
+void Axpy(float* y, float scale, const float* x, size_t count, bool avx) {
+    if (avx) {
+        AxpyAVX(y, scale, x, count);
+    } else {
+        AxpySSE(y, scale, x, count);
+    }
+}
+#endif
+
+float PeakAbs(const float* samples, size_t count) {
+    float peak = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        peak = (std::max)(peak, std::fabs(samples[i]));
+    }
+    return peak;
+}
+
+} // namespace
+
+// ============================================================================
+// Construction
+// ============================================================================
+
+EchoSuppressor::EchoSuppressor()
+    : reference(2 * HISTORY_SAMPLES, 0.0f)
+    , nearHistory(NEAR_HISTORY_SAMPLES, 0.0f)
+    , weights(FILTER_TAPS, 0.0f)
+    , decimatedNear(ANALYSIS_SAMPLES / DECIMATION)
+    , decimatedReference((ANALYSIS_SAMPLES + HISTORY_SAMPLES) / DECIMATION)
+    , useAVX(CpuSupportsAVX())
+{
+    Reset();
+}
+
+void EchoSuppressor::Reset() {
+    std::fill(reference.begin(), reference.end(), 0.0f);
+    std::fill(nearHistory.begin(), nearHistory.end(), 0.0f);
+    std::fill(weights.begin(), weights.end(), 0.0f);
+    referenceWrite = 0;
+    nearIndex = 0;
+    lastActiveReference = 0;
+    samplesSinceEstimate = 0;
+    delayValid = false;
+    bulkDelay = 0;
+    doubleTalkFrames = 0;
+    stats = Stats();
+}
+
+// ============================================================================
+// Reference timeline
+// ============================================================================
+
+const float* EchoSuppressor::ReferenceWindow(uint64_t first) const {
+    return &reference[first % HISTORY_SAMPLES];
+}
+
+void EchoSuppressor::WriteReference(const float* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        size_t slot = (referenceWrite + i) % HISTORY_SAMPLES;
+        float value = samples ? samples[i] : 0.0f;
+        reference[slot] = value;
+        reference[slot + HISTORY_SAMPLES] = value;
+    }
+    referenceWrite += count;
+}
+
+void EchoSuppressor::PadReference(uint64_t until) {
+    if (until > referenceWrite) {
+        WriteReference(nullptr, static_cast<size_t>((std::min)(until - referenceWrite,
+                                                               static_cast<uint64_t>(HISTORY_SAMPLES))));
+        referenceWrite = until;
+    }
+}
+
+void EchoSuppressor::AddReference(const float* samples, size_t count) {
+    // Playback resuming after a gap: line it up with the microphone's "now"
+    if (referenceWrite < nearIndex) {
+        PadReference(nearIndex);
+    }
+
+    double energy = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        energy += samples[i] * samples[i];
+    }
+    WriteReference(samples, count);
+    if (count > 0 && energy / count > REFERENCE_SILENCE_ENERGY) {
+        lastActiveReference = referenceWrite;
+    }
+
+    // The microphone stalled: keep the windows it still needs inside the history
+    const uint64_t maxLead = HISTORY_SAMPLES - ANALYSIS_SAMPLES - MAX_DELAY_SAMPLES - FILTER_TAPS;
+    if (referenceWrite > nearIndex + maxLead) {
+        nearIndex = referenceWrite - maxLead;
+        delayValid = false;
+    }
+}
+
+// ============================================================================
+// Processing
+// ============================================================================
+
+void EchoSuppressor::Process(float* samples, size_t count) {
+    for (size_t offset = 0; offset < count; offset += FRAME_SAMPLES) {
+        size_t n = (std::min)(FRAME_SAMPLES, count - offset);
+        float* frame = samples + offset;
+
+        // Raw microphone, for the delay search
+        for (size_t i = 0; i < n; ++i) {
+            nearHistory[(nearIndex + i) % NEAR_HISTORY_SAMPLES] = frame[i];
+        }
+
+        // Nothing played within an echo tail of this frame: nothing to cancel
+        bool referenceActive = lastActiveReference > 0 &&
+                               nearIndex < lastActiveReference + MAX_DELAY_SAMPLES + FILTER_TAPS;
+        if (!referenceActive) {
+            nearIndex += n;
+            samplesSinceEstimate = 0;
+            continue;
+        }
+
+        if (delayValid) {
+            ProcessFrame(frame, n);
+        }
+        nearIndex += n;
+
+        // Search often until the echo is found, then just track drift
+        samplesSinceEstimate += n;
+        size_t interval = delayValid ? ESTIMATE_INTERVAL_SAMPLES : ANALYSIS_SAMPLES / 2;
+        if (samplesSinceEstimate >= interval && nearIndex >= ANALYSIS_SAMPLES) {
+            samplesSinceEstimate = 0;
+            EstimateDelay();
+        }
+    }
+}
+
+void EchoSuppressor::ProcessFrame(float* samples, size_t count) {
+    // Reference window of mic sample t: [t - bulkDelay + PRE_DELAY_TAPS - FILTER_TAPS + 1, ... + FILTER_TAPS)
+    const int64_t windowOffset = static_cast<int64_t>(PRE_DELAY_TAPS) - static_cast<int64_t>(FILTER_TAPS) + 1 - bulkDelay;
+    int64_t firstWindow = static_cast<int64_t>(nearIndex) + windowOffset;
+    if (firstWindow < 0 || static_cast<uint64_t>(firstWindow) + HISTORY_SAMPLES < referenceWrite) {
+        return;     // Timeline start, or windows already overwritten
+    }
+
+    // A reference lagging the estimate is treated as silence
+    PadReference(static_cast<uint64_t>(firstWindow) + count + FILTER_TAPS - 1);
+    stats.framesProcessed++;
+
+    // Geigel double-talk detector: the echo can't be louder than a fraction of the reference
+    float nearPeak = PeakAbs(samples, count);
+    float referencePeak = 0.0f;
+    for (size_t i = 0; i < count + FILTER_TAPS - 1; ++i) {
+        referencePeak = (std::max)(referencePeak, std::fabs(*ReferenceWindow(firstWindow + i)));
+    }
+    if (nearPeak > GEIGEL_THRESHOLD * referencePeak) {
+        if (doubleTalkFrames == 0) {
+            stats.framesDoubleTalk++;
+        }
+        doubleTalkFrames = DOUBLE_TALK_HOLD;
+    } else if (doubleTalkFrames > 0) {
+        doubleTalkFrames--;
+    }
+    bool adapt = doubleTalkFrames == 0;
+
+    // NLMS, one sample at a time; the input power is updated incrementally
+    const float* window = ReferenceWindow(static_cast<uint64_t>(firstWindow));
+    float power = Dot(window, window, FILTER_TAPS, useAVX);
+    double nearEnergy = 0.0;
+    double residualEnergy = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            // The previous window's first sample; the ring may have wrapped in between
+            float oldest = window[0];
+            window = ReferenceWindow(static_cast<uint64_t>(firstWindow) + i);
+            float newest = window[FILTER_TAPS - 1];
+            power = (std::max)(0.0f, power - oldest * oldest + newest * newest);
+        }
+
+        float nearSample = samples[i];
+        float residual = nearSample - Dot(weights.data(), window, FILTER_TAPS, useAVX);
+        if (adapt) {
+            Axpy(weights.data(), STEP_SIZE * residual / (power + 1e-6f), window, FILTER_TAPS, useAVX);
+        }
+        samples[i] = residual;
+        nearEnergy += nearSample * nearSample;
+        residualEnergy += residual * residual;
+    }
+
+    // Diverged (e.g. the echo path changed under double talk): start over
+    if (residualEnergy > 4.0 * nearEnergy + 1e-9) {
+        std::fill(weights.begin(), weights.end(), 0.0f);
+    }
+
+    if (nearEnergy > 1e-9 && residualEnergy > 0.0) {
+        float erle = static_cast<float>(10.0 * std::log10(nearEnergy / residualEnergy));
+        stats.erleDb += 0.1f * (erle - stats.erleDb);
+    }
+
+    // Residual suppression: what the filter explained was echo, so is the rest
+    if (adapt && residualEnergy < RESIDUAL_ECHO_RATIO * nearEnergy) {
+        for (size_t i = 0; i < count; ++i) {
+            samples[i] *= SUPPRESSION_GAIN;
+        }
+        stats.framesSuppressed++;
+    }
+}
+
+void EchoSuppressor::EstimateDelay() {
+    // Lags D with reference[t - D] available for every t in the analysis span
+    const int64_t analysisStart = static_cast<int64_t>(nearIndex) - static_cast<int64_t>(ANALYSIS_SAMPLES);
+    int64_t minDelay = static_cast<int64_t>(nearIndex) - static_cast<int64_t>(referenceWrite);
+    int64_t maxDelay = (std::min)(static_cast<int64_t>(MAX_DELAY_SAMPLES), analysisStart);
+    int64_t oldestReference = static_cast<int64_t>(referenceWrite) - static_cast<int64_t>(HISTORY_SAMPLES);
+    maxDelay = (std::min)(maxDelay, analysisStart - oldestReference);
+    if (maxDelay < minDelay + static_cast<int64_t>(DECIMATION)) {
+        return;
+    }
+
+    // Decimate by block averaging: cheap low-pass, and the search is DECIMATION^2 cheaper
+    const size_t nearCount = ANALYSIS_SAMPLES / DECIMATION;
+    for (size_t i = 0; i < nearCount; ++i) {
+        float sum = 0.0f;
+        for (size_t k = 0; k < DECIMATION; ++k) {
+            sum += nearHistory[(static_cast<uint64_t>(analysisStart) + i * DECIMATION + k) % NEAR_HISTORY_SAMPLES];
+        }
+        decimatedNear[i] = sum;
+    }
+    float nearPower = Dot(decimatedNear.data(), decimatedNear.data(), nearCount, useAVX);
+    if (nearPower < 1e-9f) {
+        return;
+    }
+
+    // decimatedReference[j] starts lag D = maxDelay - j * DECIMATION
+    size_t lags = static_cast<size_t>((maxDelay - minDelay) / static_cast<int64_t>(DECIMATION)) + 1;
+    size_t referenceCount = nearCount + lags - 1;
+    uint64_t referenceStart = static_cast<uint64_t>(analysisStart - maxDelay);
+    for (size_t i = 0; i < referenceCount; ++i) {
+        const float* block = ReferenceWindow(referenceStart + i * DECIMATION);
+        float sum = 0.0f;
+        for (size_t k = 0; k < DECIMATION; ++k) {
+            sum += block[k];
+        }
+        decimatedReference[i] = sum;
+    }
+
+    float bestCorrelation = 0.0f;
+    size_t bestLag = 0;
+    float windowPower = Dot(decimatedReference.data(), decimatedReference.data(), nearCount, useAVX);
+    for (size_t j = 0; j < lags; ++j) {
+        if (j > 0) {
+            float oldest = decimatedReference[j - 1];
+            float newest = decimatedReference[j + nearCount - 1];
+            windowPower = (std::max)(0.0f, windowPower - oldest * oldest + newest * newest);
+        }
+        if (windowPower < 1e-9f) {
+            continue;
+        }
+        float correlation = Dot(decimatedNear.data(), &decimatedReference[j], nearCount, useAVX) /
+                            std::sqrt(nearPower * windowPower);
+        if (std::fabs(correlation) > bestCorrelation) {
+            bestCorrelation = std::fabs(correlation);
+            bestLag = j;
+        }
+    }
+
+    if (bestCorrelation < MIN_CORRELATION) {
+        return;
+    }
+    int64_t delay = maxDelay - static_cast<int64_t>(bestLag * DECIMATION);
+    if (!delayValid || std::llabs(delay - bulkDelay) > static_cast<long long>(2 * DECIMATION)) {
+        bulkDelay = delay;
+        delayValid = true;
+        std::fill(weights.begin(), weights.end(), 0.0f);
+        stats.delayMs = static_cast<float>(delay) * 1000.0f / 16000.0f;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * EchoSuppressor - Loopback-referenced echo canceller for the microphone lane
+ *
+ * On speakers the microphone hears the system audio too, and whisper used
+ * to transcribe it twice: once on the loopback lane and again, smeared by
+ * the room, as "user speech". The loopback stream is exactly what the
+ * speakers play, so it is used as the far-end reference:
+ *
+ *   1. Bulk delay: every ESTIMATE_INTERVAL_SAMPLES of active reference, the
+ *      microphone is cross-correlated (both decimated by DECIMATION) against
+ *      the reference history to find where the echo lines up - the capture
+ *      paths and the room add tens of milliseconds between the two.
+ *   2. Cancellation: an NLMS filter of FILTER_TAPS taps (64 ms of room
+ *      response, starting PRE_DELAY_TAPS before the bulk delay) predicts the
+ *      echo and subtracts it. Dot product and weight update are AVX / SSE.
+ *   3. Suppression: a frame whose residual is below RESIDUAL_ECHO_RATIO of
+ *      the microphone energy was mostly echo; it is attenuated by
+ *      SUPPRESSION_GAIN so the VAD sees silence instead of a false segment.
+ *
+ * Double talk (Geigel: the microphone peak exceeds GEIGEL_THRESHOLD of the
+ * reference peak) freezes adaptation and suppression for DOUBLE_TALK_HOLD
+ * frames, so the user is never suppressed while talking over playback.
+ * While the reference is silent the stage is a no-op.
+ *
+ * Both streams are 16 kHz mono. The reference timeline follows the
+ * microphone's: a reference that stops (nothing playing, so WASAPI sends no
+ * loopback packets) is padded with silence up to the microphone position.
+ *
+ * Usage (processing thread only; not thread-safe):
+ *   EchoSuppressor echo;
+ *   echo.AddReference(loopback, loopbackCount);    // Before the microphone block
+ *   echo.Process(microphone, microphoneCount);     // In place, before VAD
+ */
+class EchoSuppressor {
+public:
+    static constexpr size_t FRAME_SAMPLES = 512;            // 32 ms, one VAD frame
+    static constexpr size_t FILTER_TAPS = 1024;             // 64 ms echo tail
+    static constexpr size_t PRE_DELAY_TAPS = 64;            // Filter starts 4 ms before the bulk delay
+    static constexpr size_t MAX_DELAY_SAMPLES = 16000 / 2;  // Bulk delay search range (500 ms)
+    static constexpr size_t DECIMATION = 4;                 // Delay search at 4 kHz
+    static constexpr size_t ANALYSIS_SAMPLES = 8192;        // Microphone span correlated per estimate
+    static constexpr size_t ESTIMATE_INTERVAL_SAMPLES = 16000;
+    static constexpr float MIN_CORRELATION = 0.3f;          // Normalized peak needed to move the delay
+    static constexpr float STEP_SIZE = 0.2f;                // NLMS mu
+    static constexpr float GEIGEL_THRESHOLD = 1.0f;         // Laptop speakers couple at up to 0 dB
+    static constexpr int DOUBLE_TALK_HOLD = 8;              // Frames (256 ms)
+    static constexpr float RESIDUAL_ECHO_RATIO = 0.25f;     // Residual/mic energy that counts as echo
+    static constexpr float SUPPRESSION_GAIN = 0.05f;        // -26 dB on echo-only frames
+    static constexpr float REFERENCE_SILENCE_ENERGY = 1e-8f;   // Mean square; below it the stage idles
+
+    struct Stats {
+        uint64_t framesProcessed = 0;       // Frames with an active reference
+        uint64_t framesSuppressed = 0;      // ... attenuated as echo
+        uint64_t framesDoubleTalk = 0;
+        float delayMs = 0.0f;               // Current bulk delay (0 until found)
+        float erleDb = 0.0f;                // Smoothed echo return loss enhancement
+    };
+
+    EchoSuppressor();
+
+    // Append loopback samples to the reference timeline
+    void AddReference(const float* samples, size_t count);
+
+    // Cancel and suppress echo in microphone samples, in place
+    void Process(float* samples, size_t count);
+
+    // Forget the reference, the delay and the filter (e.g. after a device change)
+    void Reset();
+
+    const Stats& GetStats() const { return stats; }
+
+    // Reference/microphone history, filter and scratch (fixed at construction)
+    uint64_t GetMemoryBytes() const {
+        return (reference.capacity() + nearHistory.capacity() + weights.capacity() +
+                decimatedNear.capacity() + decimatedReference.capacity()) * sizeof(float);
+    }
+
+private:
+    // Reference history: a mirrored ring (every sample stored at i and
+    // i + HISTORY_SAMPLES) so any filter or analysis window is contiguous
+    static constexpr size_t HISTORY_SAMPLES = 1 << 15;     // 2 s
+    static constexpr size_t NEAR_HISTORY_SAMPLES = ANALYSIS_SAMPLES;
+
+    const float* ReferenceWindow(uint64_t first) const;
+    void WriteReference(const float* samples, size_t count);
+    void PadReference(uint64_t until);
+    void EstimateDelay();
+    void ProcessFrame(float* samples, size_t count);
+
+    std::vector<float> reference;           // 2 * HISTORY_SAMPLES
+    uint64_t referenceWrite;                // Next reference sample (timeline index)
+    uint64_t nearIndex;                     // Next microphone sample (timeline index)
+    uint64_t lastActiveReference;           // Last timeline index with reference energy
+
+    // Microphone history for the delay search (ring, NEAR_HISTORY_SAMPLES)
+    std::vector<float> nearHistory;
+    uint64_t samplesSinceEstimate;
+
+    bool delayValid;
+    int64_t bulkDelay;                      // Echo of reference[t - bulkDelay] arrives at mic[t]
+    std::vector<float> weights;             // FILTER_TAPS, oldest reference sample first
+    int doubleTalkFrames;
+
+    // Scratch for the decimated delay search
+    std::vector<float> decimatedNear;
+    std::vector<float> decimatedReference;
+
+    bool useAVX;
+    Stats stats;
+};
@@ -0,0 +1,2938 @@
+#include "EngineHost.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include "AudioSource.h"
+#include "CameraCadence.h"
+#include "CpuBudget.h"
+#include "CpuSampler.h"
+#include "Experiments.h"
+#include "InferenceScheduler.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "LargePages.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "MemoryAccounting.h"
+#include "MessagePack.h"
+#include "ModelVariants.h"
+#include "OrtRuntime.h"
+#include "PipelineLatency.h"
+#include "ResourceQuota.h"
+#include "StartupTimeline.h"
+#include "TaskScheduler.h"
+#include "ThreadCpu.h"
+#include "UtteranceTracer.h"
+#include "Watchdog.h"
+
+// Whisper tiers: the primary model (base.en) when it's installed, with the
+// fast one (tiny.en) as the fallback the audio engine switches short
+// utterances to when the primary falls behind. A source spec replaces the
+// WASAPI devices
+static bool InitializeAudioEngine(AudioCaptureEngine& engine, const RuntimeConfig::Values& config,
+                                  AudioCaptureEngine::WhisperBackend backend = AudioCaptureEngine::WhisperBackend::Auto,
+                                  const std::string& sourceSpec = std::string()) {
+    engine.SetWhisperBackend(backend);
+    engine.SetVadModel(std::filesystem::u8path(config.vadModel).wstring());
+
+    std::string modelPath = config.whisperFastModel;
+    std::error_code ec;
+    if (std::filesystem::exists(config.whisperModel, ec)) {
+        engine.SetFastWhisperModel(config.whisperFastModel);
+        modelPath = config.whisperModel;
+    }
+    if (!sourceSpec.empty()) {
+        std::string error;
+        std::unique_ptr<AudioSource> source = AudioSource::Create(sourceSpec, error);
+        if (!source) {
+            LOG_ERROR("Engine", "Audio source: " << error);
+            return false;
+        }
+        return engine.InitializeWithSource(modelPath, std::move(source));
+    }
+    return engine.Initialize(modelPath);
+}
+
+// RuntimeConfig from $PERCEPTION_CONFIG or perception_engine.json with this
+// machine's experiment profile over it, then the process-wide startup values: thread counts (before any engine sizes its
+// pools), large pages (before the ORT env exists) and the log level. A
+// malformed file leaves the defaults
+static void LoadRuntimeConfig(RuntimeConfig& config) {
+    std::string error;
+    if (!config.Load(RuntimeConfig::DefaultPath(), error)) {
+        LOG_ERROR("Config", "Using defaults: " << error);
+    }
+    if (!Experiments::Instance().Load(Experiments::DefaultPath(), config, error)) {
+        LOG_ERROR("Experiments", "No profile assigned: " << error);
+    }
+    std::shared_ptr<const RuntimeConfig::Values> values = config.Get();
+    CpuBudget::Instance().SetThreads(CpuBudget::Subsystem::Whisper, values->whisperThreads);
+    CpuBudget::Instance().SetThreads(CpuBudget::Subsystem::Vision, values->visionThreads);
+    CpuBudget::Instance().SetThreads(CpuBudget::Subsystem::Fusion, values->fusionThreads);
+    CpuBudget::Instance().SetThreads(CpuBudget::Subsystem::Tasks, values->taskThreads);
+    if (values->memoryLargePages) {
+        LargePages::Instance().Enable();
+    }
+    Log::Level level;
+    if (Log::ParseLevel(values->logLevel, level)) {
+        Log::SetLevel(level);
+    }
+}
+
+static ResourceQuota::Limits QuotaLimits(const RuntimeConfig::Values& config) {
+    ResourceQuota::Limits limits;
+    limits.cpuPercent = config.quotaCpuPercent;
+    limits.cpuReservePercent = config.quotaCpuReservePercent;
+    limits.memoryMb = config.quotaMemoryMb;
+    return limits;
+}
+
+// A power profile's settings with the quota level's degradation on top: the
+// slower camera, the smaller whisper tier and paused captions of either win
+static PowerPolicy::Settings WithQuota(PowerPolicy::Settings settings) {
+    ResourceQuota::Settings quota = ResourceQuota::Instance().GetSettings();
+    settings.cameraIntervalScale *= quota.cameraIntervalScale;
+    settings.preferFastWhisper = settings.preferFastWhisper || quota.preferFastWhisper;
+    if (quota.whisperThreadCap > 0) {
+        settings.whisperThreadCap = settings.whisperThreadCap > 0
+            ? (std::min)(settings.whisperThreadCap, quota.whisperThreadCap) : quota.whisperThreadCap;
+    }
+    settings.cameraPaused = settings.cameraPaused || quota.captionsPaused;
+    return settings;
+}
+
+// Warm the page cache with the model files the startup tasks are about to
+// read, so their loads overlap disk I/O with each other's parsing and session
+// setup. FastVLM: the variant of each model the engine will try first
+static void PrefetchModels(const RuntimeConfig::Values& config) {
+    std::vector<std::string> paths;
+    ModelVariants variants;
+    variants.Discover(config.cameraModelDir + "/onnx");
+    variants.LoadSelection(ModelVariants::DescribeCpu(ModelVariants::DetectCpu()));
+    for (int index = 0; index < static_cast<int>(ModelVariants::Component::Count); ++index) {
+        auto component = static_cast<ModelVariants::Component>(index);
+        ModelVariants::Precision selected;
+        const ModelVariants::Variant* variant =
+            variants.GetSelection(component, selected) ? variants.Find(component, selected) : nullptr;
+        std::vector<ModelVariants::Variant> ranked = variants.Rank(component, false);
+        if (!variant && !ranked.empty()) {
+            variant = &ranked.front();
+        }
+        if (variant) {
+            paths.push_back(variant->path);
+        }
+    }
+    std::error_code ec;
+    paths.push_back(std::filesystem::exists(config.whisperModel, ec) ? config.whisperModel : config.whisperFastModel);
+    paths.push_back(config.vadModel);
+    paths.push_back(config.sentenceEmbedderModel);
+    if (ContextFusion::IsAvailable()) {
+        paths.push_back(config.fusionModel);
+    }
+
+    size_t files = 0;
+    uint64_t bytes = 0;
+    for (const std::string& path : paths) {
+        MappedFile file;
+        if (file.Open(path)) {
+            file.Prefetch();
+            files++;
+            bytes += file.Size();
+        }
+    }
+    LOG_DEBUG("Startup", "Prefetched " << files << " model files (" << (bytes >> 20) << " MB)");
+}
+
+// Voice, camera and app-switch events are journaled here (relative to the
+// working directory, like the models)
+static const char* const CONTEXT_JOURNAL_DIRECTORY = "journal";
+
+// Caption and transcript vectors for /search (same base as the journal)
+static const char* const VECTOR_INDEX_DIRECTORY = "vectors";
+
+// Every transcript, word-indexed for /transcripts
+static const char* const TRANSCRIPT_INDEX_DIRECTORY = "transcripts";
+static const char* const TIMELINE_STREAM = "timeline";
+static constexpr size_t TIMELINE_DEFAULT_LIMIT = 50;
+
+// Watchdog: stall minidumps, and how long one caption may take (cold model load included)
+static const char* const STALL_DUMP_DIRECTORY = "dumps";
+static constexpr int CAMERA_STALL_MS = 180000;
+
+// Screen captions: how often the foreground window is checked, the share of
+// its tiles that must change, and when a caption that never came back is given up
+static constexpr int SCREEN_POLL_MS = 250;
+static constexpr double SCREEN_MIN_CHANGE = 0.02;
+static constexpr int64_t SCREEN_CAPTION_TIMEOUT_MS = 60000;
+
+// Below this a compressed body saves less than the headers cost
+static constexpr size_t CONTEXT_COMPRESS_MIN_BYTES = 512;
+
+// /context?fields= names at most this many members
+static constexpr size_t CONTEXT_MAX_FIELDS = 64;
+
+// How long an identical /history query is answered from the last result
+static constexpr int HISTORY_CACHE_MS = 1000;
+
+// Each Stop() records its step times here; the next run serves them on /metrics
+static const char* const SHUTDOWN_METRICS_FILE = "dumps/last_shutdown.prom";
+
+// Times Stop() step by step against its deadline. A watcher thread notices an
+// overrun while a step is still stuck in it, logs the step, writes the report
+// (the handler may end the process) and calls the overrun handler once
+class ShutdownClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ShutdownClock(int deadlineMs, std::function<void(const char*)> onOverrun)
+        : start(Clock::now()), deadline(start + std::chrono::milliseconds(deadlineMs)),
+          overrunHandler(std::move(onOverrun)) {
+        watcher = std::thread([this]() { Watch(); });
+    }
+
+    ~ShutdownClock() {
+        Finish();
+    }
+
+    // Ends the current step and starts the next
+    void Step(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Clock::time_point now = Clock::now();
+        if (!steps.empty()) {
+            steps.back().second = now - stepStart;
+        }
+        steps.emplace_back(name, Clock::duration::zero());
+        stepStart = now;
+    }
+
+    bool Expired() const {
+        return Clock::now() >= deadline;
+    }
+
+    void Finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished) {
+                return;
+            }
+            finished = true;
+            if (!steps.empty()) {
+                steps.back().second = Clock::now() - stepStart;
+            }
+            total = Clock::now() - start;
+        }
+        wake.notify_all();
+        if (watcher.joinable()) {
+            watcher.join();
+        }
+        WriteReport();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream summary;
+        for (const auto& step : steps) {
+            summary << " " << step.first << "=" << Ms(step.second) << "ms";
+        }
+        LOG_INFO("Engine", "Shutdown took " << Ms(total) << " ms" << (overran ? " (past the deadline)" : "")
+                 << ":" << summary.str());
+    }
+
+private:
+    Clock::time_point start;
+    Clock::time_point deadline;
+    Clock::time_point stepStart;
+    Clock::duration total{};
+    std::function<void(const char*)> overrunHandler;
+    std::vector<std::pair<const char*, Clock::duration>> steps;
+    bool finished = false;
+    bool overran = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread watcher;
+
+    static int64_t Ms(Clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    }
+
+    void Watch() {
+        const char* stuck = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wake.wait_until(lock, deadline, [this]() { return finished; })) {
+                return;
+            }
+            overran = true;
+            stuck = steps.empty() ? "start" : steps.back().first;
+            total = Clock::now() - start;
+            if (!steps.empty()) {
+                steps.back().second = Clock::now() - stepStart;
+            }
+        }
+        LOG_ERROR("Engine", "Shutdown passed its " << Ms(deadline - start) << " ms deadline, stuck in " << stuck);
+        WriteReport();
+        if (overrunHandler) {
+            overrunHandler(stuck);
+        }
+    }
+
+    void WriteReport() {
+        std::ostringstream text;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            text << "# HELP perception_last_shutdown_seconds Previous run's shutdown, per step and in total\n"
+                 << "# TYPE perception_last_shutdown_seconds gauge\n";
+            for (const auto& step : steps) {
+                text << "perception_last_shutdown_seconds{step=\"" << step.first << "\"} "
+                     << Ms(step.second) / 1000.0 << "\n";
+            }
+            text << "perception_last_shutdown_seconds{step=\"total\"} " << Ms(total) / 1000.0 << "\n"
+                 << "# HELP perception_last_shutdown_overrun 1 when the previous shutdown passed its deadline\n"
+                 << "# TYPE perception_last_shutdown_overrun gauge\n"
+                 << "perception_last_shutdown_overrun " << (overran ? 1 : 0) << "\n";
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(SHUTDOWN_METRICS_FILE).parent_path(), ec);
+        std::ofstream file(SHUTDOWN_METRICS_FILE, std::ios::trunc);
+        file << text.str();
+    }
+};
+
+// Counts a thread in EngineHost::outstandingThreads for as long as it runs
+class OutstandingThread {
+public:
+    explicit OutstandingThread(std::atomic<int>& count) : count(count) { ++count; }
+    ~OutstandingThread() { --count; }
+
+    OutstandingThread(const OutstandingThread&) = delete;
+    OutstandingThread& operator=(const OutstandingThread&) = delete;
+
+private:
+    std::atomic<int>& count;
+};
+
+static bool AcceptsMessagePack(const HttpRequest& request) {
+    std::string accept = request.GetHeader("accept");
+    return accept.find("application/msgpack") != std::string::npos ||
+           accept.find("application/x-msgpack") != std::string::npos;
+}
+
+// GET /context[?since=<version>]: the full document, or 304 / a JSON merge
+// patch when the client already has an earlier version (X-Context-Version).
+// Full documents are gzip/deflate encoded when Accept-Encoding allows.
+// "Accept: application/msgpack" gets the full document as MessagePack
+// (patches are JSON-only; 304 still applies since versions are shared).
+// Full documents name their encoding as a body cache key: on the http.sys
+// backend each version is handed to the kernel once, by its first reader.
+// ?fields=a,b,c gets just those top-level members, copied out of the
+// snapshot, and only the system sources behind them keep being probed on this
+// reader's account; a projection is never a patch, but is 304 while the whole
+// document's version is unchanged
+static void ServeContext(ContextCollector& collector, const HttpRequest& request, HttpResponse& response) {
+    std::string since = request.GetQueryParam("since");
+    uint64_t sinceVersion = since.empty() ? 0 : std::strtoull(since.c_str(), nullptr, 10);
+
+    std::string fieldList = HttpRequest::DecodeQueryValue(request.GetQueryParam("fields"));
+    if (!fieldList.empty()) {
+        std::vector<std::string_view> fields;
+        std::string_view rest(fieldList);
+        while (!rest.empty() && fields.size() < CONTEXT_MAX_FIELDS) {
+            size_t comma = rest.find(',');
+            std::string_view field = rest.substr(0, comma);
+            rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+            if (!field.empty()) {
+                fields.push_back(field);
+            }
+        }
+        collector.NoteReader(fields);
+        std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.GetSnapshot();
+        response.SetHeader("X-Context-Version", std::to_string(snapshot->version));
+        response.SetHeader("Access-Control-Expose-Headers", "X-Context-Version");
+        if (sinceVersion == snapshot->version) {
+            response.status = 304;
+            return;
+        }
+        response.SetHeader("Vary", "Accept");
+        response.status = 200;
+        std::string projected = snapshot->Project(fields);
+        if (AcceptsMessagePack(request)) {
+            std::string packed;
+            MessagePack::TranscodeJson(packed, projected);
+            response.SetHeader("Content-Type", "application/msgpack");
+            response.SetBody(packed);
+            return;
+        }
+        response.SetHeader("Content-Type", "application/json");
+        response.SetBody(projected);
+        return;
+    }
+
+    ContextCollector::ContextDelta delta = collector.CollectContextSince(sinceVersion);
+    response.SetHeader("X-Context-Version", std::to_string(delta.version));
+    response.SetHeader("Access-Control-Expose-Headers", "X-Context-Version");
+
+    if (delta.notModified) {
+        response.status = 304;
+        return;
+    }
+    response.SetHeader("Vary", "Accept, Accept-Encoding");
+    response.status = 200;
+
+    if (AcceptsMessagePack(request)) {
+        const auto& snapshot = delta.snapshot;
+        response.SetHeader("Content-Type", "application/msgpack");
+        response.SetSharedBody(std::shared_ptr<const std::string>(snapshot, &snapshot->GetMessagePack()),
+                               "context.msgpack");
+        return;
+    }
+
+    response.SetHeader("Content-Type", delta.isPatch ? "application/merge-patch+json" : "application/json");
+
+    // Patches are small and request-specific, so they go out as-is
+    if (delta.isPatch) {
+        response.SetBody(delta.body);
+        return;
+    }
+
+    // Full documents (and their encodings, compressed once per version) are
+    // sent straight from the snapshot, which the response keeps alive
+    const auto& snapshot = delta.snapshot;
+    if (snapshot->serialized.size() >= CONTEXT_COMPRESS_MIN_BYTES) {
+        if (request.AcceptsEncoding("gzip")) {
+            response.SetHeader("Content-Encoding", "gzip");
+            response.SetSharedBody(std::shared_ptr<const std::string>(
+                snapshot, &snapshot->GetEncoded(Deflate::Container::Gzip)), "context.gzip");
+            return;
+        }
+        if (request.AcceptsEncoding("deflate")) {
+            response.SetHeader("Content-Encoding", "deflate");
+            response.SetSharedBody(std::shared_ptr<const std::string>(
+                snapshot, &snapshot->GetEncoded(Deflate::Container::Zlib)), "context.deflate");
+            return;
+        }
+    }
+    response.SetSharedBody(std::shared_ptr<const std::string>(snapshot, &snapshot->serialized), "context.json");
+}
+
+// The "context" bus subscriber. A partial superseded by a later one of the
+// same kind in the batch is skipped: it would only be overwritten
+static void ApplyBusEvents(ContextCollector& collector, const EventBus::Event* events, size_t count) {
+    for (size_t index = 0; index < count; ++index) {
+        const EventBus::Event& event = events[index];
+        auto superseded = [&]() {
+            for (size_t later = index + 1; later < count; ++later) {
+                if (events[later].GetType() == event.GetType()) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        if (const auto* transcript = event.As<EventBus::Transcript>()) {
+            if (transcript->systemAudio) {
+                collector.UpdateSystemAudioContext(transcript->text);
+            } else {
+                collector.UpdateVoiceContext(transcript->text, transcript->latencyMs, transcript->speaker);
+            }
+        } else if (const auto* partial = event.As<EventBus::TranscriptPartial>()) {
+            if (!superseded()) {
+                collector.UpdateVoicePartial(partial->text);
+            }
+        } else if (const auto* segment = event.As<EventBus::TranscriptSegment>()) {
+            collector.UpdateVoiceSegment(segment->traceId, segment->index, segment->text, segment->endMs);
+        } else if (const auto* keyword = event.As<EventBus::Keyword>()) {
+            collector.UpdateVoiceKeyword(keyword->keyword, keyword->score);
+        } else if (const auto* caption = event.As<EventBus::Caption>()) {
+            collector.UpdateCameraContext(caption->text, caption->latencyMs, caption->reused);
+        } else if (const auto* captionPartial = event.As<EventBus::CaptionPartial>()) {
+            if (!superseded()) {
+                collector.UpdateCameraPartial(captionPartial->text);
+            }
+        } else if (const auto* screen = event.As<EventBus::ScreenCaption>()) {
+            collector.UpdateScreenContext(screen->text, screen->window, screen->latencyMs, screen->changedShare);
+        } else if (const auto* screenText = event.As<EventBus::ScreenText>()) {
+            if (!superseded()) {
+                collector.UpdateScreenText(screenText->text, screenText->window, screenText->latencyMs);
+            }
+        }
+    }
+}
+
+// One /update_context event: {"device":"Camera"|"Voice","data":{...},"latencyMs":n}.
+// Camera captions come from data.objects[0] (or data.caption), voice text from
+// data.text (or data.transcription); latencyMs may sit at either level
+static bool ApplyContextEvent(ContextCollector& collector, const JsonValue& event, std::string& scratch) {
+    JsonValue data = event["data"];
+    JsonValue latency = event["latencyMs"].IsNumber() ? event["latencyMs"] : data["latencyMs"];
+    float latencyMs = static_cast<float>(latency.AsDouble(0.0));
+    std::string_view device = event["device"].AsString(scratch);
+
+    if (device == "Camera") {
+        JsonValue caption = data["objects"][0];
+        if (!caption.IsString()) {
+            caption = data["caption"];
+        }
+        collector.UpdateCameraContext(caption.GetString(), latencyMs);
+        return true;
+    }
+    if (device == "Voice") {
+        JsonValue text = data["text"];
+        if (!text.IsString()) {
+            text = data["transcription"];
+        }
+        collector.UpdateVoiceContext(text.GetString(), latencyMs);
+        return true;
+    }
+    return false;
+}
+
+// POST /update_context: one event object, or an array of them applied in order
+static void ServeContextUpdate(ContextCollector& collector, const HttpRequest& request, HttpResponse& response) {
+    LOG_DEBUG("Engine", "POST body: " << request.body.size() << " bytes");
+
+    std::string body;
+    JsonWriter writer(body);
+    size_t errorOffset = 0;
+    JsonValue root = JsonReader::Parse(request.body, &errorOffset);
+    if (!root.IsObject() && !root.IsArray()) {
+        LOG_ERROR("Engine", "Failed to parse update_context at offset " << errorOffset);
+        writer.BeginObject().Key("error").String("Invalid JSON").Key("offset").UInt(errorOffset).EndObject();
+        response.SetBody(body);
+        response.status = 400;
+        return;
+    }
+
+    size_t applied = 0;
+    size_t rejected = 0;
+    std::string scratch;
+    auto apply = [&](const JsonValue& event) {
+        if (ApplyContextEvent(collector, event, scratch)) {
+            applied++;
+        } else {
+            rejected++;
+        }
+    };
+    if (root.IsArray()) {
+        size_t cursor = 0;
+        JsonValue event;
+        while (root.Next(cursor, event)) {
+            apply(event);
+        }
+    } else if (root["device"].IsValid()) {
+        apply(root);
+    } else {
+        writer.BeginObject().Key("error").String("Missing device field").EndObject();
+        response.SetBody(body);
+        response.status = 400;
+        return;
+    }
+    LOG_DEBUG("Engine", "Context update: " << applied << " applied, " << rejected << " rejected");
+
+    if (applied == 0 && rejected > 0) {
+        writer.BeginObject().Key("error").String("Unknown device type").EndObject();
+        response.status = 400;
+    } else {
+        writer.BeginObject().Key("status").String("ok").Key("applied").UInt(applied)
+              .Key("rejected").UInt(rejected).EndObject();
+        response.status = 200;
+    }
+    response.SetHeader("Content-Type", "application/json");
+    response.SetBody(body);
+}
+
+// One /ingest event: {"type":"camera"|"voice"|"sensor", "text":"..." (camera,
+// voice), "name":"...","value":<any JSON> (sensor), "timestamp":"...", "latencyMs":n}
+static bool ParseIngestEvent(const JsonValue& event, ContextCollector::IngestEvent& parsed, std::string& scratch) {
+    using Kind = ContextCollector::IngestEvent::Kind;
+    std::string_view type = event["type"].AsString(scratch);
+    if (type == "camera") {
+        parsed.kind = Kind::Camera;
+    } else if (type == "voice") {
+        parsed.kind = Kind::Voice;
+    } else if (type == "sensor") {
+        parsed.kind = Kind::Sensor;
+    } else {
+        return false;
+    }
+
+    if (parsed.kind == Kind::Sensor) {
+        parsed.name = event["name"].GetString();
+        JsonValue value = event["value"];
+        if (parsed.name.empty() || !value.IsValid()) {
+            return false;
+        }
+        parsed.text = std::string(value.Raw());
+    } else {
+        JsonValue text = event["text"];
+        if (!text.IsString()) {
+            return false;
+        }
+        parsed.text = text.GetString();
+    }
+    parsed.timestamp = event["timestamp"].GetString();
+    parsed.latencyMs = static_cast<float>(event["latencyMs"].AsDouble(0.0));
+    return true;
+}
+
+// An ingest batch: a JSON array of events, or newline-delimited JSON (one
+// event per line); the whole batch is applied to the collector at once
+static void IngestBatch(ContextCollector& collector, std::string_view body, size_t& applied, size_t& rejected) {
+    std::vector<ContextCollector::IngestEvent> events;
+    rejected = 0;
+    std::string scratch;
+    auto parseEvent = [&](const JsonValue& event) {
+        ContextCollector::IngestEvent parsed;
+        if (event.IsObject() && ParseIngestEvent(event, parsed, scratch)) {
+            events.push_back(std::move(parsed));
+        } else {
+            rejected++;
+        }
+    };
+
+    size_t first = JsonReader::SkipWhitespace(body, 0);
+    if (first < body.size() && body[first] == '[') {
+        JsonValue root = JsonReader::Parse(body);
+        size_t cursor = 0;
+        JsonValue event;
+        while (root.Next(cursor, event)) {
+            parseEvent(event);
+        }
+        if (!root.IsValid()) {
+            rejected++;
+        }
+    } else {
+        size_t lineStart = 0;
+        while (lineStart < body.size()) {
+            size_t lineEnd = body.find('\n', lineStart);
+            if (lineEnd == std::string_view::npos) {
+                lineEnd = body.size();
+            }
+            std::string_view line = body.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 1;
+            if (JsonReader::SkipWhitespace(line, 0) == line.size()) {
+                continue;       // Blank line (or trailing CR/LF)
+            }
+            parseEvent(JsonReader::Parse(line));
+        }
+    }
+
+    applied = collector.IngestEvents(events);
+    rejected += events.size() - applied;
+    LOG_DEBUG("Engine", "Ingest: " << applied << " applied, " << rejected << " rejected");
+}
+
+// POST /ingest: IngestBatch on the body
+static void ServeIngest(ContextCollector& collector, const HttpRequest& request, HttpResponse& response) {
+    size_t applied = 0;
+    size_t rejected = 0;
+    IngestBatch(collector, request.body, applied, rejected);
+
+    std::string reply;
+    JsonWriter writer(reply);
+    writer.BeginObject().Key("status").String(applied > 0 || rejected == 0 ? "ok" : "rejected")
+          .Key("applied").UInt(applied).Key("rejected").UInt(rejected).EndObject();
+    response.SetHeader("Content-Type", "application/json");
+    response.SetBody(reply);
+    response.status = (applied == 0 && rejected > 0) ? 400 : 200;
+}
+
+// GET /history?from=&to=&fields=&points=&extremes=: recorded samples and
+// events between two Unix epoch millisecond times (default: the last hour),
+// downsampled to at most `points` buckets, with each bucket's min and max too
+// when extremes=1; fields is a comma-separated subset of
+// cpu,memory,battery,app,voice,camera,voice_latency,camera_latency
+static void ServeHistory(ContextCollector& collector, const HttpRequest& request, HttpResponse& response) {
+    // Analytics polling history keeps the samples coming
+    collector.NoteReader();
+
+    ContextHistory::Query query;
+    std::string to = request.GetQueryParam("to");
+    std::string from = request.GetQueryParam("from");
+    std::string points = request.GetQueryParam("points");
+    query.toMs = to.empty() ? ContextHistory::NowMs() : std::strtoll(to.c_str(), nullptr, 10);
+    query.fromMs = from.empty() ? query.toMs - 60 * 60 * 1000 : std::strtoll(from.c_str(), nullptr, 10);
+    query.fields = ContextHistory::ParseFields(request.GetQueryParam("fields"));
+    if (!points.empty()) {
+        query.maxPoints = static_cast<size_t>(std::strtoull(points.c_str(), nullptr, 10));
+    }
+    query.extremes = request.GetQueryParam("extremes") == "1";
+
+    std::string body;
+    JsonWriter writer(body);
+    collector.GetHistory().Write(writer, query);
+    response.SetHeader("Content-Type", "application/json");
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// GET /search?q=&k=&from=&to=: the captions and transcripts closest in meaning
+// to q (best first, at most k, default 10), optionally between two Unix epoch
+// millisecond times
+static void ServeSearch(SentenceEmbedder& embedder, const VectorIndex& index, const HttpRequest& request,
+                        HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    std::string text = HttpRequest::DecodeQueryValue(request.GetQueryParam("q"));
+    if (text.empty() || text.size() > VectorIndex::MAX_TEXT_BYTES) {
+        response.SetBody("{\"error\":\"q: 1-" + std::to_string(VectorIndex::MAX_TEXT_BYTES) + " bytes\"}");
+        response.status = 400;
+        return;
+    }
+    VectorIndex::Query query;
+    std::string k = request.GetQueryParam("k");
+    std::string from = request.GetQueryParam("from");
+    std::string to = request.GetQueryParam("to");
+    if (!k.empty()) {
+        query.k = static_cast<size_t>(std::strtoull(k.c_str(), nullptr, 10));
+    }
+    if (!from.empty()) {
+        query.fromMs = std::strtoll(from.c_str(), nullptr, 10);
+    }
+    if (!to.empty()) {
+        query.toMs = std::strtoll(to.c_str(), nullptr, 10);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<float> vector;
+    if (!embedder.Embed(text, vector)) {
+        response.SetBody("{\"error\":\"Embedding failed\"}");
+        response.status = 500;
+        return;
+    }
+    std::vector<VectorIndex::Hit> hits = index.Search(vector, query);
+    double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::string body;
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("query").String(text);
+    writer.Key("results").BeginArray();
+    for (const VectorIndex::Hit& hit : hits) {
+        writer.BeginObject();
+        writer.Key("kind").String(hit.kind == VectorIndex::Kind::Camera ? "camera" : "voice");
+        writer.Key("timeMs").Int(hit.timeMs);
+        writer.Key("score").Double(hit.score, 3);
+        writer.Key("text").String(hit.text);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("indexed").UInt(index.Size());
+    writer.Key("latencyMs").Double(latencyMs, 2);
+    writer.EndObject();
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// GET /transcripts?q=&from=&to=&limit=: transcripts containing every word of q,
+// or the "quoted phrase", newest first (at most limit, default 20), optionally
+// between two Unix epoch millisecond times; without q, all in the window
+static void ServeTranscripts(const TranscriptIndex& index, const HttpRequest& request, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    TranscriptIndex::Query query;
+    query.text = HttpRequest::DecodeQueryValue(request.GetQueryParam("q"));
+    if (query.text.size() > TranscriptIndex::MAX_TEXT_BYTES) {
+        response.SetBody("{\"error\":\"q: at most " + std::to_string(TranscriptIndex::MAX_TEXT_BYTES) + " bytes\"}");
+        response.status = 400;
+        return;
+    }
+    std::string from = request.GetQueryParam("from");
+    std::string to = request.GetQueryParam("to");
+    std::string limit = request.GetQueryParam("limit");
+    if (!from.empty()) {
+        query.fromMs = std::strtoll(from.c_str(), nullptr, 10);
+    }
+    if (!to.empty()) {
+        query.toMs = std::strtoll(to.c_str(), nullptr, 10);
+    }
+    if (!limit.empty()) {
+        query.limit = static_cast<size_t>(std::strtoull(limit.c_str(), nullptr, 10));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    TranscriptIndex::Result result = index.Search(query);
+    double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::string body;
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("query").String(query.text);
+    writer.Key("results").BeginArray();
+    for (const TranscriptIndex::Hit& hit : result.hits) {
+        writer.BeginObject();
+        writer.Key("timeMs").Int(hit.timeMs);
+        writer.Key("speaker").Int(hit.speaker);
+        writer.Key("systemAudio").Bool(hit.systemAudio);
+        writer.Key("text").String(hit.text);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("matches").UInt(result.matches);
+    writer.Key("segments").UInt(result.segments);
+    writer.Key("latencyMs").Double(latencyMs, 2);
+    writer.EndObject();
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// Per-stage and per-route latency summaries, admission counts, CPU usage and per-thread cost, per-component memory, heartbeat ages and bus queues for Prometheus scrapers
+static void ServeMetrics(const HttpRouter& router, const AdmissionControl& admission, const EventBus& bus,
+                         const ScreenCapture* screen, const ScreenText* screenText, const MemoryTrimmer& trimmer,
+                         const std::string& archive, const std::string& lastShutdown, HttpResponse& response) {
+    response.SetHeader("Content-Type", "text/plain; version=0.0.4");
+    response.SetBody(PipelineLatency::FormatPrometheus() + router.FormatPrometheus() + admission.FormatPrometheus() +
+                     CpuSampler::Instance().FormatPrometheus() + Experiments::Instance().FormatPrometheus() +
+                     ResourceQuota::Instance().FormatPrometheus() +
+                     ThreadCpu::Instance().FormatPrometheus() +
+                     InferenceScheduler::Instance().FormatPrometheus() +
+                     InferenceSupervisor::Instance().FormatPrometheus() +
+                     MemoryAccounting::Instance().FormatPrometheus() + Watchdog::Instance().FormatPrometheus() +
+                     bus.FormatPrometheus() + TaskScheduler::Instance().FormatPrometheus() +
+                     (screen ? screen->FormatPrometheus() : std::string()) +
+                     (screenText ? screenText->FormatPrometheus() : std::string()) + trimmer.FormatPrometheus() +
+                     archive + lastShutdown);
+    response.status = 200;
+}
+
+// GET /watchdog: every heartbeat and the stall counters. POST /watchdog?restart=on|off
+// toggles replacing a stalled engine
+static void ServeWatchdog(const HttpRequest& request, HttpResponse& response, std::atomic<bool>& restartEnabled) {
+    response.SetHeader("Content-Type", "application/json");
+    if (request.method == "POST") {
+        std::string restart = request.GetQueryParam("restart");
+        if (restart != "on" && restart != "off") {
+            response.SetBody("{\"error\":\"restart must be on|off\"}");
+            response.status = 400;
+            return;
+        }
+        restartEnabled.store(restart == "on");
+        LOG_INFO("Engine", "Stalled engine restart " << (restart == "on" ? "enabled" : "disabled"));
+    }
+
+    std::string body;
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("restart").Bool(restartEnabled.load());
+    writer.Key("watchdog");
+    Watchdog::Instance().Write(writer);
+    writer.EndObject();
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// GET /power: the profile, the power state behind it and its settings.
+// POST /power?profile=auto|performance|balanced|saver|away pins a profile (auto: follow the power state)
+static void ServePower(PowerPolicy& power, const HttpRequest& request, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    if (request.method == "POST") {
+        std::string name = request.GetQueryParam("profile");
+        PowerPolicy::Profile profile;
+        if (name == "auto") {
+            power.SetForcedProfile(std::nullopt);
+        } else if (PowerPolicy::ParseProfile(name, profile)) {
+            power.SetForcedProfile(profile);
+        } else {
+            response.SetBody("{\"error\":\"profile must be auto|performance|balanced|saver|away\"}");
+            response.status = 400;
+            return;
+        }
+    }
+
+    std::string body;
+    JsonWriter writer(body);
+    power.Write(writer);
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// GET /presence: state, thresholds, the signals behind it and what it gates
+static void ServePresence(const PresenceMonitor& presence, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    std::string body;
+    JsonWriter writer(body);
+    presence.Write(writer);
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// GET /log: level, format and record counters. POST /log?level=debug&format=json
+// changes either at runtime (level: debug|info|warning|error|off, format: text|json)
+static void ServeLog(const HttpRequest& request, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    if (request.method == "POST") {
+        std::string level = request.GetQueryParam("level");
+        std::string format = request.GetQueryParam("format");
+        Log::Level parsed = Log::GetLevel();
+        if ((!level.empty() && !Log::ParseLevel(level, parsed)) ||
+            (!format.empty() && format != "text" && format != "json")) {
+            response.SetBody("{\"error\":\"level must be debug|info|warning|error|off, format text|json\"}");
+            response.status = 400;
+            return;
+        }
+        Log::SetLevel(parsed);
+        if (!format.empty()) {
+            Log::SetFormat(format == "json" ? Log::Format::Json : Log::Format::Text);
+        }
+        LOG_INFO("Engine", "Log level set to " << Log::LevelName(parsed));
+    }
+
+    std::string body;
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("level").String(Log::LevelName(Log::GetLevel()));
+    writer.Key("format").String(Log::GetFormat() == Log::Format::Json ? "json" : "text");
+    writer.Key("written").UInt(Log::GetWrittenCount());
+    writer.Key("dropped").UInt(Log::GetDroppedCount());
+    writer.EndObject();
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// GET /audio/segmenter: the speech segmentation policy. POST with any of
+// pre_roll_ms, on, off, silence_ms, min_speech_ms, max_speech_sec,
+// chunk_min_sec, chunk_max_sec (0 = no chunking) updates
+// `config` (validated as a whole); true when the caller should apply it
+static bool ServeSegmenter(const HttpRequest& request, HttpResponse& response,
+                           AudioCaptureEngine::SegmenterConfig& config) {
+    response.SetHeader("Content-Type", "application/json");
+    bool changed = false;
+    if (request.method == "POST") {
+        AudioCaptureEngine::SegmenterConfig updated = config;
+        auto intParam = [&request](const char* name, int& value) {
+            std::string text = request.GetQueryParam(name);
+            if (!text.empty()) {
+                value = static_cast<int>(std::strtol(text.c_str(), nullptr, 10));
+            }
+        };
+        auto floatParam = [&request](const char* name, float& value) {
+            std::string text = request.GetQueryParam(name);
+            if (!text.empty()) {
+                value = std::strtof(text.c_str(), nullptr);
+            }
+        };
+        intParam("pre_roll_ms", updated.preRollMs);
+        floatParam("on", updated.speechOnThreshold);
+        floatParam("off", updated.speechOffThreshold);
+        intParam("silence_ms", updated.silenceThresholdMs);
+        intParam("turn_min_ms", updated.turnMinSilenceMs);
+        intParam("turn_max_ms", updated.turnMaxSilenceMs);
+        intParam("min_speech_ms", updated.minSpeechMs);
+        intParam("max_speech_sec", updated.maxSpeechSec);
+        intParam("chunk_min_sec", updated.chunkMinSec);
+        intParam("chunk_max_sec", updated.chunkMaxSec);
+        if (!AudioCaptureEngine::IsValidSegmenterConfig(updated)) {
+            response.SetBody("{\"error\":\"pre_roll_ms 0-1000, 0 < off <= on < 1, silence_ms > 0, "
+                             "0 < turn_min_ms <= turn_max_ms, "
+                             "min_speech_ms >= 0, max_speech_sec 1-30, "
+                             "chunk_max_sec 0 or 1 <= chunk_min_sec < chunk_max_sec <= max_speech_sec\"}");
+            response.status = 400;
+            return false;
+        }
+        config = updated;
+        changed = true;
+        LOG_INFO("Engine", "Segmenter: pre-roll " << config.preRollMs << "ms, on/off " << config.speechOnThreshold
+                 << "/" << config.speechOffThreshold << ", silence " << config.silenceThresholdMs
+                 << "ms (" << config.turnMinSilenceMs << "-" << config.turnMaxSilenceMs << "ms by turn), min " << config.minSpeechMs << "ms, max " << config.maxSpeechSec << "s, chunks "
+                 << config.chunkMinSec << "-" << config.chunkMaxSec << "s");
+    }
+
+    std::string body;
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("pre_roll_ms").Int(config.preRollMs);
+    writer.Key("on").Double(config.speechOnThreshold, 3);
+    writer.Key("off").Double(config.speechOffThreshold, 3);
+    writer.Key("silence_ms").Int(config.silenceThresholdMs);
+    writer.Key("turn_min_ms").Int(config.turnMinSilenceMs);
+    writer.Key("turn_max_ms").Int(config.turnMaxSilenceMs);
+    writer.Key("min_speech_ms").Int(config.minSpeechMs);
+    writer.Key("max_speech_sec").Int(config.maxSpeechSec);
+    writer.Key("chunk_min_sec").Int(config.chunkMinSec);
+    writer.Key("chunk_max_sec").Int(config.chunkMaxSec);
+    writer.EndObject();
+    response.SetBody(body);
+    response.status = 200;
+    return changed;
+}
+
+// GET /config: the runtime configuration, which keys apply without a restart
+// and which changed ones still wait for one. POST with an empty body re-reads
+// the file and environment; a JSON body (file layout, any subset of keys) is
+// overlaid instead. Returns the keys that changed, for the caller to apply
+static std::vector<std::string> ServeConfig(RuntimeConfig& config, const HttpRequest& request,
+                                            HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    std::vector<std::string> changed;
+    if (request.method == "POST") {
+        std::shared_ptr<const RuntimeConfig::Values> before = config.Get();
+        std::string error;
+        bool applied = request.body.empty() ? config.Reload(error) : config.Apply(request.body, error);
+        if (!applied) {
+            std::string body;
+            JsonWriter writer(body);
+            writer.BeginObject();
+            writer.Key("error").String(error);
+            writer.EndObject();
+            response.SetBody(body);
+            response.status = 400;
+            return changed;
+        }
+        changed = RuntimeConfig::Diff(*before, *config.Get());
+        for (const std::string& key : changed) {
+            LOG_INFO("Config", "Changed " << key);
+        }
+    }
+
+    std::string body;
+    JsonWriter writer(body);
+    config.Write(writer);
+    response.SetBody(body);
+    response.status = 200;
+    return changed;
+}
+
+// Hot values among `changed`: the log level is set here; true when the
+// segmentation policy changed (copied into `segmenter` for the caller to
+// apply). camera.interval_ms, camera.question and suspend.unload_ms are read by the caption loops themselves
+static bool ApplyHotConfig(const RuntimeConfig::Values& values, const std::vector<std::string>& changed,
+                           AudioCaptureEngine::SegmenterConfig& segmenter) {
+    bool segmenterChanged = false;
+    for (const std::string& key : changed) {
+        Log::Level level;
+        if (key == "log.level" && Log::ParseLevel(values.logLevel, level)) {
+            Log::SetLevel(level);
+        }
+        segmenterChanged = segmenterChanged || key.rfind("audio.", 0) == 0;
+    }
+    if (segmenterChanged) {
+        segmenter = values.segmenter;
+    }
+    return segmenterChanged;
+}
+
+// Recent utterances with their per-hop breakdown, speech start to context update
+static void ServeUtterances(HttpResponse& response) {
+    std::string body;
+    JsonWriter writer(body);
+    UtteranceTracer::Instance().Write(writer);
+    response.SetHeader("Content-Type", "application/json");
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// The configuration profiles under comparison: latency and CPU per profile against the baseline
+static void ServeExperiments(HttpResponse& response) {
+    std::string body;
+    JsonWriter writer(body);
+    Experiments::Instance().Write(writer);
+    response.SetHeader("Content-Type", "application/json");
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// The resource envelope: limits, usage against them and the degradation level
+static void ServeQuota(HttpResponse& response) {
+    std::string body;
+    JsonWriter writer(body);
+    ResourceQuota::Instance().Write(writer);
+    response.SetHeader("Content-Type", "application/json");
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// How long /describe waits for its caption (queueing and a model reload included)
+static constexpr int DESCRIBE_TIMEOUT_MS = 60000;
+
+// POST /describe body: an encoded image (JPEG, PNG, BMP); ?x=&y=&w=&h= picks a region of it
+static bool ParseDescribeImage(const HttpRequest& request, cv::Mat& image, cv::Rect& region) {
+    if (request.body.empty()) {
+        return false;
+    }
+    std::vector<uint8_t> encoded(request.body.begin(), request.body.end());
+    image = cv::imdecode(encoded, cv::IMREAD_COLOR);
+    if (image.empty()) {
+        return false;
+    }
+    std::string w = request.GetQueryParam("w");
+    std::string h = request.GetQueryParam("h");
+    if (!w.empty() && !h.empty()) {
+        region = cv::Rect(std::atoi(request.GetQueryParam("x").c_str()), std::atoi(request.GetQueryParam("y").c_str()),
+                          std::atoi(w.c_str()), std::atoi(h.c_str()));
+    }
+    return true;
+}
+
+// The answer to a finished /describe caption
+static HttpResponse DescribeResponse(const CameraVisionEngine::Caption& caption) {
+    HttpResponse response;
+    response.SetHeader("Content-Type", "application/json");
+    if (caption.description.empty()) {
+        response.SetBody("{\"error\":\"Captioning failed\"}");
+        response.status = 500;
+        return response;
+    }
+    std::string body;
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("description").String(caption.description);
+    writer.Key("latency_ms").Double(caption.latencyMs, 1);
+    writer.Key("reused").Bool(caption.reused);
+    writer.Key("coalesced").Bool(caption.coalesced);
+    writer.EndObject();
+    response.SetBody(body);
+    response.status = 200;
+    return response;
+}
+
+// GET /describe captions the camera's freshest frame, POST /describe the posted image;
+// both through CameraVisionEngine::Submit, so they share (and coalesce with) the
+// periodic caption loop. engineMutex guards engine, which is null while no camera runs.
+// The response is deferred: no HTTP worker waits out the caption (the server answers
+// 504 after DESCRIBE_TIMEOUT_MS)
+static void ServeDescribe(std::mutex& engineMutex, CameraVisionEngine* const& engine,
+                          const HttpRequest& request, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    cv::Mat image;
+    cv::Rect region;
+    if (request.method == "POST" && !ParseDescribeImage(request, image, region)) {
+        response.SetBody("{\"error\":\"Body must be a JPEG, PNG or BMP image\"}");
+        response.status = 400;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(engineMutex);
+    if (!engine || !engine->IsReady()) {
+        response.SetBody("{\"error\":\"Camera engine not running\"}");
+        response.status = 503;
+        return;
+    }
+    // A destroyed engine completes its requests, so the callback always runs
+    std::shared_ptr<HttpCompletion> completion = response.Defer(DESCRIBE_TIMEOUT_MS);
+    auto answer = [completion](const CameraVisionEngine::Caption& caption) {
+        completion->Complete(DescribeResponse(caption));
+    };
+    if (request.method == "POST") {
+        engine->Submit(image, region, answer);
+    } else {
+        engine->Submit(0, answer);
+    }
+}
+
+// POST /ask {"questions": ["Is anyone at the desk?", ...]}: answers about the camera's
+// freshest frame from one encoder pass (CameraVisionEngine::Ask), deferred like /describe
+static void ServeAsk(std::mutex& engineMutex, CameraVisionEngine* const& engine,
+                     const HttpRequest& request, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    std::vector<std::string> questions;
+    JsonValue list = JsonReader::Parse(request.body)["questions"];
+    size_t cursor = 0;
+    JsonValue question;
+    while (list.IsArray() && list.Next(cursor, question)) {
+        std::string text = question.GetString();
+        if (!question.IsString() || text.empty()) {
+            questions.clear();
+            break;
+        }
+        questions.push_back(std::move(text));
+    }
+    if (questions.empty() || questions.size() > CameraVisionEngine::MAX_QUESTIONS) {
+        response.SetBody("{\"error\":\"Body must be {\\\"questions\\\": [1 to " +
+                         std::to_string(CameraVisionEngine::MAX_QUESTIONS) + " non-empty strings]}\"}");
+        response.status = 400;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(engineMutex);
+    if (!engine || !engine->IsReady()) {
+        response.SetBody("{\"error\":\"Camera engine not running\"}");
+        response.status = 503;
+        return;
+    }
+    std::shared_ptr<HttpCompletion> completion = response.Defer(DESCRIBE_TIMEOUT_MS);
+    engine->Ask(questions, 0, [completion](const CameraVisionEngine::Caption& caption) {
+        HttpResponse answer;
+        answer.SetHeader("Content-Type", "application/json");
+        if (caption.answers.empty()) {
+            answer.SetBody("{\"error\":\"Answering failed\"}");
+            answer.status = 500;
+            completion->Complete(answer);
+            return;
+        }
+        std::string body;
+        JsonWriter writer(body);
+        writer.BeginObject();
+        writer.Key("answers").BeginArray();
+        for (const std::string& text : caption.answers) {
+            writer.String(text);
+        }
+        writer.EndArray();
+        writer.Key("latency_ms").Double(caption.latencyMs, 1);
+        writer.Key("coalesced").Bool(caption.coalesced);
+        writer.EndObject();
+        answer.SetBody(body);
+        answer.status = 200;
+        completion->Complete(answer);
+    });
+}
+
+// GET /sessions lists the agents the broker serves; null broker: sessions.max is 0
+static void ServeSessions(const SessionBroker* broker, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    if (!broker) {
+        response.SetBody("{\"error\":\"Session broker disabled (sessions.max is 0)\"}");
+        response.status = 404;
+        return;
+    }
+    std::string body;
+    JsonWriter writer(body);
+    broker->Write(writer);
+    response.SetBody(body);
+    response.status = 200;
+}
+
+// GET /sessions/{id}/context: one session's voice and app fields
+static void ServeSessionContext(const SessionBroker* broker, std::string_view id, HttpResponse& response) {
+    response.SetHeader("Content-Type", "application/json");
+    if (!broker) {
+        response.SetBody("{\"error\":\"Session broker disabled (sessions.max is 0)\"}");
+        response.status = 404;
+        return;
+    }
+    std::string text(id);
+    char* end = nullptr;
+    unsigned long sessionId = std::strtoul(text.c_str(), &end, 10);
+    std::string body;
+    JsonWriter writer(body);
+    if (text.empty() || *end != '\0' || !broker->WriteSession(static_cast<DWORD>(sessionId), writer)) {
+        response.SetBody("{\"error\":\"No agent serves this session\"}");
+        response.status = 404;
+        return;
+    }
+    response.SetBody(body);
+    response.status = 200;
+}
+
+EngineHost::EngineHost() = default;
+
+EngineHost::~EngineHost() {
+    Stop();
+}
+
+int64_t EngineHost::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void EngineHost::Start(const Options& startOptions) {
+    options = startOptions;
+    started = true;
+    shutdown.Reset();
+    {
+        // What the previous shutdown took, served by /metrics until the next one
+        std::ifstream previous(SHUTDOWN_METRICS_FILE);
+        std::ostringstream text;
+        text << previous.rdbuf();
+        lastShutdownMetrics = previous ? text.str() : std::string();
+    }
+    {
+        StartupTimeline::Span span("config");
+        LoadRuntimeConfig(runtimeConfig);
+    }
+    std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+    {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        segmenterConfig = config->segmenter;
+    }
+    // The job before any worker process, so they start inside it
+    ResourceQuota::Instance().SetLimits(QuotaLimits(*config));
+
+    // The server answers from the first moment; what it serves comes up behind it
+    {
+        StartupTimeline::Span span("http_server");     // WSAStartup
+        httpServer = std::make_unique<HttpServer>(config->httpPort, config->httpKernel
+                                                  ? HttpServer::Backend::HttpSys : HttpServer::Backend::Winsock);
+    }
+    LOG_DEBUG("Engine", "HTTP server created on port " << config->httpPort);
+    // Camera previews encode on request; the camera is attached when one opens
+    cameraPreview = std::make_unique<CameraPreview>(*httpServer);
+    cameraPreview->Start();
+    RegisterRoutes();
+    httpServer->SetRequestHandler([this](const HttpRequest& request, HttpResponse& response) {
+        HandleRequest(request, response);
+    });
+    running = true;
+    lastContextRequestMs = NowMs();
+
+    // Power profile first, so the engines load with its settings
+    powerPolicy = std::make_unique<PowerPolicy>();
+    powerPolicy->SetProfileCallback([this](PowerPolicy::Profile profile, const PowerPolicy::Settings& settings) {
+        PowerPolicy::SetProcessEcoQos(settings.processEcoQos);
+        {
+            std::lock_guard<std::mutex> lock(segmenterMutex);
+            if (liveAudioEngine) {
+                liveAudioEngine->SetPowerSettings(AudioPowerSettings(WithQuota(settings)));
+            }
+            if (liveSessionBroker) {
+                liveSessionBroker->SetPowerSettings(AudioPowerSettings(WithQuota(settings)));
+            }
+        }
+        SetSuspended(SuspendReason::DisplayOff, profile == PowerPolicy::Profile::Away);
+    });
+    powerPolicy->Start(options.watchPowerSettings);
+
+    // CPU usage for the camera cadence and /context, sampled off their threads
+    CpuSampler::Instance().Start();
+
+    // Presence gate: the lock state may have arrived before Start
+    {
+        std::lock_guard<std::mutex> suspendLock(suspendMutex);
+        presence = std::make_unique<PresenceMonitor>();
+        presence->SetSessionLocked((suspendReasons & static_cast<unsigned>(SuspendReason::SessionLocked)) != 0);
+    }
+    presence->SetStateCallback([this](PresenceMonitor::State, const PresenceMonitor::Settings& settings) {
+        ApplyPresence(settings);
+    });
+    presence->SetThresholds(config->presenceIdleMs, config->presenceAwayMs);
+    presence->Start();
+
+    // Idle memory: the whisper pool is quiet when no speech is queued, the
+    // shared ORT arena when the caption loop describes nothing new (the VAD
+    // keeps running on it and carries out the shrink)
+    memoryTrimmer = std::make_unique<MemoryTrimmer>();
+    memoryTrimmer->AddSource("whisper",
+        [this]() -> uint64_t {
+            std::lock_guard<std::mutex> lock(segmenterMutex);
+            return liveAudioEngine ? liveAudioEngine->GetSpeechActivity() : 0;
+        },
+        [this]() -> uint64_t {
+            std::lock_guard<std::mutex> lock(segmenterMutex);
+            return liveAudioEngine ? liveAudioEngine->TrimIdleMemory() : 0;
+        });
+    memoryTrimmer->AddSource("ort_arena",
+        [this]() -> uint64_t {
+            std::lock_guard<std::mutex> lock(describeMutex);
+            if (!liveCameraEngine) {
+                return 0;
+            }
+            CameraVisionEngine::SceneStats stats = liveCameraEngine->GetSceneStats();
+            return stats.scenesDescribed + stats.cacheMisses;
+        },
+        []() -> uint64_t {
+            return OrtRuntime::Instance().RequestArenaShrink();
+        });
+    memoryTrimmer->SetQuietMs(config->memoryTrimAfterMs);
+    memoryTrimmer->Start();
+    Experiments::Instance().Start([this](const std::vector<std::string>& changed) {
+        ApplyConfigChanges(changed);
+    });
+    ResourceQuota::Instance().Start([this](ResourceQuota::Level, const ResourceQuota::Settings&) {
+        ApplyQuotaLevel();
+    });
+
+    // Subsystems come up concurrently; the engines need the collector
+    // they report into, and nothing else needs anything
+    startup = std::make_unique<StartupGraph>();
+    startup->Add("prefetch", {}, [this]() {
+        PrefetchModels(*runtimeConfig.Get());
+        return true;
+    });
+    startup->Add("context", {}, [this]() {
+        auto collector = std::make_unique<ContextCollector>();
+        {
+            StartupTimeline::Span span("journal_replay");
+            if (!collector->OpenJournal(CONTEXT_JOURNAL_DIRECTORY)) {
+                LOG_WARNING("Engine", "Event journal unavailable; context will not survive a restart");
+            }
+        }
+        // Engine results reach the collector through the bus; losing a
+        // transcript is worse than a producer waiting a moment
+        EventBus::SubscriberOptions subscriber;
+        subscriber.name = "context";
+        subscriber.types = EventBus::Mask(EventBus::Type::Transcript) |
+                           EventBus::Mask(EventBus::Type::TranscriptPartial) |
+                           EventBus::Mask(EventBus::Type::TranscriptSegment) |
+                           EventBus::Mask(EventBus::Type::Keyword) |
+                           EventBus::Mask(EventBus::Type::Caption) |
+                           EventBus::Mask(EventBus::Type::CaptionPartial) |
+                           EventBus::Mask(EventBus::Type::ScreenCaption) |
+                           EventBus::Mask(EventBus::Type::ScreenText);
+        subscriber.overflow = EventBus::Overflow::Block;
+        subscriber.capacity = 1024;
+        subscriber.maxBatch = 64;
+        ContextCollector* target = collector.get();
+        eventBus.Subscribe(subscriber, [target](const EventBus::Event* events, size_t count) {
+            ApplyBusEvents(*target, events, count);
+        });
+        collector->SetEventBus(&eventBus);
+        collector->SetPowerPolicy(powerPolicy.get());
+        {
+            std::lock_guard<std::mutex> suspendLock(suspendMutex);
+            collector->SetRefreshScale(presenceSettings.contextRefreshScale);
+            presenceCollector = collector.get();
+            if (!suspendReasons) {
+                collector->StartPeriodicUpdate();
+            }
+        }
+        collector->UpdateModelStatus("voice", "loading");
+        collector->UpdateModelStatus("camera", "loading");
+        // Push clients subscribe at /context/stream instead of polling /context
+        contextStream = std::make_unique<ContextStream>(*collector, *httpServer);
+        contextStream->Start();
+        // Open dashboards get just what their panels show
+        dashboardStream = std::make_unique<DashboardStream>(*collector, *httpServer);
+        dashboardStream->Start();
+        // ... or register a predicate at /context/watch and hear only when it matches
+        contextWatch = std::make_unique<ContextWatch>(*collector, *httpServer);
+        contextWatch->Start();
+        // LLM agents get a token-budgeted text rendering (tokenizer loaded on first use)
+        contextSummary = std::make_unique<ContextSummary>(*collector, runtimeConfig.Get()->cameraModelDir);
+        // Local processes read the same snapshots through shared memory and a pipe
+        if (runtimeConfig.Get()->localIpc) {
+            localContext = std::make_unique<LocalContextServer>(*collector,
+                [target](std::string_view events, size_t& applied, size_t& rejected) {
+                    IngestBatch(*target, events, applied, rejected);
+                });
+            if (!localContext->Start()) {
+                LOG_WARNING("Engine", "Local context transport unavailable; HTTP only");
+                localContext.reset();
+            }
+        }
+        contextCollector = std::move(collector);
+        return true;
+    });
+    startup->Add("voice", {"context"}, [this]() {
+        if (shutdown.IsCancelled()) {
+            return false;
+        }
+        LoadAudioEngine();
+        return audioEngine != nullptr;
+    });
+    startup->Add("camera", {"context"}, [this]() {
+        if (!running.load()) {
+            return false;
+        }
+        if (options.cameraMode != Options::CameraMode::Native) {
+            return StartCameraBridge();
+        }
+        LoadCameraEngine();
+        return cameraEngine != nullptr;
+    });
+    // Captions of the foreground window, on whichever camera engine is live
+    startup->Add("screen", {"context"}, [this]() {
+        return running.load() && StartScreenCaptions();
+    });
+    // Sentence embeddings: caption deduplication and /search
+    startup->Add("search", {"context"}, [this]() {
+        return running.load() && LoadSearch();
+    });
+    startup->Add("transcripts", {"context"}, [this]() {
+        return running.load() && LoadTranscriptIndex();
+    });
+    // Every modality on one clock: /timeline joins what was said with what was seen
+    startup->Add("timeline", {"context"}, [this]() {
+        return running.load() && StartTimeline();
+    });
+    startup->Add("fusion", {"context"}, [this]() {
+        return running.load() && LoadFusionEngine();
+    });
+    // Fleet publishing (publish.url): off unless configured
+    startup->Add("publish", {"context"}, [this]() {
+        return running.load() && StartPublisher();
+    });
+    // Other user sessions transcribe on the voice task's models
+    startup->Add("sessions", {"voice"}, [this]() {
+        return !shutdown.IsCancelled() && StartSessionBroker();
+    });
+    // Warm-up: the first whisper decode and ORT runs pay for buffer
+    // allocation and page-ins; these take it at idle priority, so the first
+    // real request runs at steady-state latency. Ready here means warm
+    startup->Add("voice_warmup", {"voice"}, [this]() {
+        AudioCaptureEngine* engine = audioEngine.get();
+        return engine && engine->WaitUntilWarm();
+    });
+    startup->Add("camera_warmup", {"camera"}, [this]() {
+        CameraVisionEngine* engine = cameraEngine.get();
+        if (!engine) {
+            return true;    // Python bridge: nothing in-process to warm
+        }
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+        return running.load() && engine->WarmUp();
+    });
+    startup->Start();
+
+    serverThread = std::make_unique<std::thread>([this]() {
+        RunHttpServer();
+    });
+    LOG_DEBUG("Engine", "HTTP server thread started");
+
+    Watchdog::Instance().SetDumpDirectory(STALL_DUMP_DIRECTORY);
+    Watchdog::Instance().SetStallHandler("voice", [this](const char* thread) {
+        OutstandingThread guard(outstandingThreads);
+        RestartAudioEngine(thread);
+    });
+    Watchdog::Instance().SetStallHandler("camera", [this](const char* thread) {
+        OutstandingThread guard(outstandingThreads);
+        RestartCameraEngine(thread);
+    });
+}
+
+void EngineHost::Stop() {
+    if (!started) {
+        return;
+    }
+    started = false;
+    ShutdownClock clock(options.shutdownDeadlineMs, options.onShutdownOverrun);
+
+    // Signal the loops to stop and cancel what is blocked: whisper decodes
+    // abort, ORT runs terminate, sleeping loops wake. A pause or resume in
+    // progress finishes first; none start after this
+    clock.Step("cancel");
+    running = false;
+    shutdown.Cancel();
+    {
+        std::lock_guard<std::mutex> suspendLock(suspendMutex);
+    }
+    if (presence) {
+        presence->Stop();
+    }
+    if (memoryTrimmer) {
+        memoryTrimmer->Stop();
+    }
+    Experiments::Instance().Stop();
+    ResourceQuota::Instance().Stop();
+    CpuSampler::Instance().Stop();
+    Watchdog::Instance().SetStallHandler("voice", nullptr);
+    Watchdog::Instance().SetStallHandler("camera", nullptr);
+
+    {
+        // A restart in progress finishes first; none start after this
+        std::lock_guard<std::mutex> restartLock(engineRestartMutex);
+
+        // Startup tasks may still be loading; the engines are only safe to touch after them
+        clock.Step("startup");
+        if (startup) {
+            startup->Wait();
+            LOG_DEBUG("Engine", "Startup tasks joined");
+        }
+
+        // Detach the fusion stage before it stops: snapshots submit to it
+        clock.Step("fusion");
+        if (fusionEngine) {
+            if (contextCollector) {
+                contextCollector->SetFusionEngine(nullptr);
+            }
+            fusionEngine.reset();
+            LOG_DEBUG("Engine", "Context fusion stopped");
+        }
+
+        // The sessions' engines share the audio engine's models
+        clock.Step("sessions");
+        {
+            std::lock_guard<std::mutex> segmenterLock(segmenterMutex);
+            liveSessionBroker = nullptr;
+        }
+        if (sessionBroker) {
+            sessionBroker->Stop();
+            sessionBroker.reset();
+        }
+
+        // Stop audio engine
+        clock.Step("audio");
+        {
+            std::lock_guard<std::mutex> segmenterLock(segmenterMutex);
+            liveAudioEngine = nullptr;
+        }
+        if (audioEngine) {
+            audioEngine->Stop();
+            LOG_DEBUG("Engine", "Audio engine stopped");
+        }
+
+        // Detach the collector: whisper workers may still finish a queued utterance
+        if (audioEngine) {
+            audioEngine->SetTranscriptionCallback(nullptr);
+            audioEngine->SetPartialTranscriptionCallback(nullptr);
+            audioEngine->SetTranscriptSegmentCallback(nullptr);
+            audioEngine->SetSystemAudioCallback(nullptr);
+            audioEngine->SetKeywordCallback(nullptr);
+            audioEngine->SetSegmentCallback(nullptr);
+        }
+
+        // Wait for the caption loop (or the Python bridge), and the screen loop submitting to it
+        clock.Step("camera");
+        if (screenThread && screenThread->joinable()) {
+            screenThread->join();
+            LOG_DEBUG("Engine", "Screen thread joined");
+        }
+        if (cameraThread && cameraThread->joinable()) {
+            cameraThread->join();
+            LOG_DEBUG("Engine", "Camera thread joined");
+        }
+        if (cameraPreview) {
+            cameraPreview->SetCapture(nullptr);
+        }
+        frameCapture.Close();
+        captionWorker.reset();
+        frameRing.Close();
+
+        // Clean up camera engine
+        {
+            std::lock_guard<std::mutex> describeLock(describeMutex);
+            liveCameraEngine = nullptr;
+        }
+        if (cameraEngine) {
+            cameraEngine.reset();
+            LOG_DEBUG("Engine", "Camera engine stopped");
+        }
+
+        clock.Step("publish");
+        if (contextPublisher) {
+            contextPublisher->Stop();
+            contextPublisher.reset();
+        }
+
+        clock.Step("http");
+        if (contextStream) {
+            contextStream->Stop();
+            contextStream.reset();
+        }
+        if (dashboardStream) {
+            dashboardStream->Stop();
+            dashboardStream.reset();
+        }
+        if (cameraPreview) {
+            cameraPreview->Stop();
+        }
+        if (contextWatch) {
+            contextWatch->Stop();
+            contextWatch.reset();
+        }
+        contextSummary.reset();
+        if (localContext) {
+            localContext->Stop();
+            localContext.reset();
+        }
+
+        if (httpServer) {
+            httpServer->Stop();
+            LOG_DEBUG("Engine", "HTTP server stop signal sent");
+        }
+
+        // Wait for server thread to finish
+        if (serverThread && serverThread->joinable()) {
+            serverThread->join();
+            LOG_DEBUG("Engine", "HTTP server thread joined");
+        }
+
+        // Deliver what the engines published before the collector goes
+        clock.Step("bus");
+        eventBus.Stop();
+
+        // Nothing adds to the indexes once the bus is stopped; the transcript
+        // index writes out its in-memory segment
+        clock.Step("search");
+        vectorIndex.reset();
+        transcriptIndex.reset();
+        fusionTimeline.reset();
+
+        clock.Step("collector");
+        if (contextCollector) {
+            contextCollector->StopPeriodicUpdate();
+            contextCollector.reset();
+            LOG_DEBUG("Engine", "Context collector stopped");
+        }
+
+        clock.Step("power");
+        if (powerPolicy) {
+            powerPolicy->Stop();
+            PowerPolicy::SetProcessEcoQos(false);
+        }
+
+        // The whisper workers were cancelled; the queue's destructor only joins them
+        clock.Step("release");
+        audioEngine.reset();
+        httpServer.reset();
+        serverThread.reset();
+        cameraThread.reset();
+        screenThread.reset();
+        screenCapture.reset();
+        screenText.reset();
+        startup.reset();
+        router.reset();
+        admission.reset();
+        powerPolicy.reset();
+        presence.reset();
+        memoryTrimmer.reset();
+    }
+
+    // An abandoned caption loop or a stall handler still reference the host;
+    // give them what is left of the deadline to leave (a wedged one never will)
+    clock.Step("detached");
+    while (outstandingThreads.load() > 0 && !clock.Expired()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (outstandingThreads.load() > 0) {
+        LOG_WARNING("Engine", outstandingThreads.load() << " abandoned thread(s) still running at shutdown");
+    }
+    clock.Finish();
+}
+
+void EngineHost::SetSuspended(SuspendReason reason, bool active) {
+    std::lock_guard<std::mutex> suspendLock(suspendMutex);
+    unsigned bit = static_cast<unsigned>(reason);
+    if (reason == SuspendReason::SessionLocked && presence) {
+        presence->SetSessionLocked(active);
+    }
+    unsigned next = active ? (suspendReasons | bit) : (suspendReasons & ~bit);
+    bool pause = next != 0;
+    bool changed = pause != (suspendReasons != 0);
+    suspendReasons = next;
+    if (!changed || !running.load()) {
+        return;
+    }
+    suspended = pause;
+
+    // The caption loop (or bridge) sees `suspended` and handles the cameras itself
+    int64_t startMs = NowMs();
+    AudioCaptureEngine* engine;
+    {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        engine = liveAudioEngine;
+    }
+    ContextCollector* collector = IsStarted("context") ? contextCollector.get() : nullptr;
+    if (pause) {
+        if (engine) {
+            engine->Stop();
+        }
+        if (collector) {
+            collector->StopPeriodicUpdate();
+        }
+    } else {
+        if (collector) {
+            collector->StartPeriodicUpdate();
+        }
+        // Nobody at the machine: voice stays off until they are back
+        if (engine && !presenceSettings.voicePaused && !engine->Start()) {
+            LOG_WARNING("Engine", "Audio capture did not restart after resume");
+        }
+    }
+    if (collector && engine) {
+        collector->UpdateModelStatus("voice", pause ? "suspended" : presenceSettings.voicePaused ? "paused" : "ready");
+    }
+    LOG_INFO("Engine", (pause ? "Suspended" : "Resumed") << " pipelines in " << (NowMs() - startMs) << " ms ("
+             << ((next & static_cast<unsigned>(SuspendReason::SessionLocked)) ? "session locked" :
+                 (next & static_cast<unsigned>(SuspendReason::DisplayOff)) ? "display off" : "active") << ")");
+}
+
+void EngineHost::HandlePowerSetting(const GUID& setting, const void* data, size_t size) {
+    if (running.load() && powerPolicy) {
+        powerPolicy->HandleSetting(setting, data, size);
+    }
+}
+
+void EngineHost::OnSessionLogon(DWORD sessionId) {
+    if (running.load() && IsStarted("sessions") && sessionBroker) {
+        sessionBroker->OnSessionLogon(sessionId);
+    }
+}
+
+PowerPolicy::Settings EngineHost::PowerSettings() const {
+    return WithQuota(powerPolicy ? powerPolicy->GetSettings() : PowerPolicy::Settings());
+}
+
+void EngineHost::ApplyQuotaLevel() {
+    {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        if (liveAudioEngine) {
+            liveAudioEngine->SetPowerSettings(AudioPowerSettings(PowerSettings()));
+        }
+        if (liveSessionBroker) {
+            liveSessionBroker->SetPowerSettings(AudioPowerSettings(PowerSettings()));
+        }
+    }
+    ApplyAdmissionLimits();
+}
+
+PresenceMonitor::Settings EngineHost::PresenceSettings() const {
+    return presence ? presence->GetSettings() : PresenceMonitor::Settings();
+}
+
+// Voice stops while nobody is there and starts when they are back (a
+// suspend in force keeps it stopped; the resume decides); the collector
+// samples and refreshes at the state's rate
+void EngineHost::ApplyPresence(const PresenceMonitor::Settings& settings) {
+    std::lock_guard<std::mutex> suspendLock(suspendMutex);
+    bool voiceChanged = settings.voicePaused != presenceSettings.voicePaused;
+    presenceSettings = settings;
+    if (!running.load()) {
+        return;
+    }
+    if (presenceCollector) {
+        presenceCollector->SetRefreshScale(settings.contextRefreshScale);
+    }
+    if (!voiceChanged || suspendReasons) {
+        return;
+    }
+    AudioCaptureEngine* engine;
+    {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        engine = liveAudioEngine;
+    }
+    if (!engine) {
+        return;
+    }
+    if (settings.voicePaused) {
+        engine->Stop();
+    } else if (!engine->Start()) {
+        LOG_WARNING("Engine", "Audio capture did not restart on return");
+    }
+    if (presenceCollector) {
+        presenceCollector->UpdateModelStatus("voice", settings.voicePaused ? "paused" : "ready");
+    }
+}
+
+AudioCaptureEngine::PowerSettings EngineHost::AudioPowerSettings(const PowerPolicy::Settings& settings) {
+    AudioCaptureEngine::PowerSettings audio;
+    audio.preferFastWhisper = settings.preferFastWhisper;
+    audio.whisperThreadCap = settings.whisperThreadCap;
+    audio.vadTickMs = settings.vadTickMs;
+    return audio;
+}
+
+// ============================================================================
+// Startup tasks
+// ============================================================================
+
+void EngineHost::LoadAudioEngine() {
+    // Initialize audio capture engine
+    audioEngine = std::make_unique<AudioCaptureEngine>();
+    audioEngine->SetOutOfProcessWhisper(options.isolateWhisper);
+    if (!InitializeAudioEngine(*audioEngine, *runtimeConfig.Get(), options.whisperBackend, options.audioSource)) {
+        LOG_WARNING("Engine", "Failed to initialize audio engine");
+        audioEngine.reset();
+        contextCollector->UpdateModelStatus("voice", "failed");
+        return;
+    }
+    LOG_DEBUG("Engine", "Audio engine initialized");
+    contextCollector->UpdateModelStatus("voice", "ready");
+
+    std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+    if (!config->archiveDir.empty()) {
+        AudioArchive::Options archive;
+        archive.directory = config->archiveDir;
+        archive.maxBytes = static_cast<uint64_t>(config->archiveMaxMb) * 1024 * 1024;
+        archive.continuous = config->archiveContinuous != 0;
+        if (!audioEngine->EnableArchive(archive)) {
+            LOG_WARNING("Engine", "Audio archive disabled: cannot write to " << config->archiveDir);
+        }
+    }
+
+    // Shutdown aborts the decodes in flight. Engines are never freed before
+    // Stop cancels (an abandoned one is leaked), so the pointer stays valid
+    AudioCaptureEngine* engine = audioEngine.get();
+    shutdown.OnCancel([engine]() { engine->CancelTranscriptions(); });
+
+    // Set callback to update context when new transcription arrives; an
+    // abandoned engine's late results are dropped
+    uint64_t generation = audioGeneration.load();
+    audioEngine->SetTranscriptionCallback([this, engine, generation](const std::string& transcription) {
+        if (audioGeneration.load() == generation) {
+            // Get latency from audio engine metrics
+            auto metrics = engine->GetMetrics();
+            eventBus.Publish(EventBus::Transcript{transcription, metrics.whisperLatencyMs,
+                                                  engine->GetLatestUserSpeaker(), false,
+                                                  engine->GetLatestUserTraceId()});
+            LOG_DEBUG("Engine", "Voice transcription: " << transcription);
+        }
+    });
+    audioEngine->SetPartialTranscriptionCallback([this, generation](const std::string& partial) {
+        if (audioGeneration.load() == generation) {
+            eventBus.Publish(EventBus::TranscriptPartial{partial});
+        }
+    });
+    audioEngine->SetTranscriptSegmentCallback([this, generation](uint64_t traceId, int index, const std::string& text,
+                                                                 int64_t startMs, int64_t endMs) {
+        if (audioGeneration.load() == generation) {
+            eventBus.Publish(EventBus::TranscriptSegment{traceId, index, text, startMs, endMs});
+        }
+    });
+    audioEngine->SetSystemAudioCallback([this, generation](const std::string& transcription) {
+        if (audioGeneration.load() == generation) {
+            eventBus.Publish(EventBus::Transcript{transcription, 0.0f, -1, true});
+            LOG_DEBUG("Engine", "System audio transcription: " << transcription);
+        }
+    });
+    audioEngine->SetKeywordCallback([this, generation](const std::string& keyword, float score) {
+        if (audioGeneration.load() == generation) {
+            eventBus.Publish(EventBus::Keyword{keyword, score});
+        }
+    });
+    audioEngine->SetSegmentCallback([this, generation](uint64_t traceId, uint32_t durationMs,
+                                                       float vadConfidence, bool systemAudio) {
+        if (audioGeneration.load() == generation) {
+            eventBus.Publish(EventBus::VoiceSegment{traceId, durationMs, vadConfidence, systemAudio});
+        }
+    });
+    audioEngine->SetKeywordGate(options.keywordGate);
+
+    {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        audioEngine->SetSegmenterConfig(segmenterConfig);
+        audioEngine->SetPowerSettings(AudioPowerSettings(PowerSettings()));
+        liveAudioEngine = audioEngine.get();
+    }
+
+    // Start audio capture; results are pushed from the whisper workers. While
+    // suspended the resume starts it
+    std::lock_guard<std::mutex> suspendLock(suspendMutex);
+    if (suspendReasons) {
+        contextCollector->UpdateModelStatus("voice", "suspended");
+        LOG_DEBUG("Engine", "Audio capture deferred until resume");
+    } else if (presenceSettings.voicePaused) {
+        contextCollector->UpdateModelStatus("voice", "paused");
+        LOG_DEBUG("Engine", "Audio capture deferred until the user is back");
+    } else if (audioEngine->Start()) {
+        LOG_DEBUG("Engine", "Audio capture started");
+    } else {
+        LOG_WARNING("Engine", "Failed to start audio capture");
+    }
+}
+
+// Optional: only when built with llama.cpp and the model is installed
+// (true when there is nothing to load)
+bool EngineHost::LoadFusionEngine() {
+    std::string modelPath = options.fusionModel.empty() ? runtimeConfig.Get()->fusionModel : options.fusionModel;
+    std::error_code ec;
+    if (!ContextFusion::IsAvailable() || !std::filesystem::exists(modelPath, ec)) {
+        return true;
+    }
+    contextCollector->UpdateModelStatus("fusion", "loading");
+    ContextFusion::Config config;
+    config.modelPath = modelPath;
+    auto engine = std::make_unique<ContextFusion>();
+    if (!engine->Initialize(config)) {
+        contextCollector->UpdateModelStatus("fusion", "failed");
+        return false;
+    }
+    contextCollector->SetFusionEngine(engine.get());
+    engine->Start();
+    fusionEngine = std::move(engine);
+    contextCollector->UpdateModelStatus("fusion", "ready");
+    return true;
+}
+
+// The sentence embedder, and what runs on it: caption deduplication and the
+// /search index. Without the model both are off and captions go out as they are
+bool EngineHost::LoadSearch() {
+    StartupTimeline::Span span("sentence_embedder");
+    std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+    std::error_code ec;
+    if (!std::filesystem::exists(std::filesystem::u8path(config->sentenceEmbedderModel), ec)) {
+        LOG_INFO("Engine", "No sentence embedder at " << config->sentenceEmbedderModel
+                 << "; captions are not deduplicated and /search is off");
+        return true;
+    }
+    auto embedder = std::make_unique<SentenceEmbedder>();
+    if (!embedder->Initialize(std::filesystem::u8path(config->sentenceEmbedderModel).wstring())) {
+        LOG_WARNING("Engine", "Sentence embedder failed to load; captions are not deduplicated and /search is off");
+        return false;
+    }
+    captionDeduplicator = std::make_unique<CaptionDeduplicator>(*embedder);
+    captionDeduplicator->SetThreshold(config->cameraDedupSimilarity);
+
+    auto index = std::make_unique<VectorIndex>(VECTOR_INDEX_DIRECTORY);
+    if (index->Open(embedder->GetDimensions())) {
+        // Embedding is a few milliseconds a record: off the context subscriber,
+        // at background priority; a burst past the queue is not indexed
+        EventBus::SubscriberOptions subscriber;
+        subscriber.name = "search";
+        subscriber.types = EventBus::Mask(EventBus::Type::Transcript) | EventBus::Mask(EventBus::Type::Caption);
+        subscriber.overflow = EventBus::Overflow::DropNewest;
+        subscriber.capacity = 256;
+        subscriber.maxBatch = 8;
+        subscriber.priority = TaskScheduler::Priority::Background;
+        SentenceEmbedder* sentences = embedder.get();
+        VectorIndex* target = index.get();
+        eventBus.Subscribe(subscriber, [sentences, target](const EventBus::Event* events, size_t count) {
+            std::vector<float> vector;
+            for (size_t i = 0; i < count; ++i) {
+                const EventBus::Event& event = events[i];
+                if (const auto* transcript = event.As<EventBus::Transcript>()) {
+                    if (!transcript->text.empty() && sentences->Embed(transcript->text, vector)) {
+                        target->Add(VectorIndex::Kind::Voice, event.timeMs, transcript->text, vector);
+                    }
+                } else if (const auto* caption = event.As<EventBus::Caption>()) {
+                    // Reused (and held back) captions are already indexed
+                    if (!caption->reused && !caption->text.empty() && sentences->Embed(caption->text, vector)) {
+                        target->Add(VectorIndex::Kind::Camera, event.timeMs, caption->text, vector);
+                    }
+                }
+            }
+        });
+        vectorIndex = std::move(index);
+    } else {
+        LOG_WARNING("Engine", "Search index unavailable; /search is off");
+    }
+    sentenceEmbedder = std::move(embedder);
+    return true;
+}
+
+// The transcript index, fed from the bus like the collector. Without it
+// /transcripts is off; nothing else depends on it
+bool EngineHost::LoadTranscriptIndex() {
+    StartupTimeline::Span span("transcript_index");
+    auto index = std::make_unique<TranscriptIndex>(TRANSCRIPT_INDEX_DIRECTORY);
+    if (!index->Open()) {
+        LOG_WARNING("Engine", "Transcript index unavailable; /transcripts is off");
+        return false;
+    }
+    // Indexing is microseconds (the file work is on the index's own thread):
+    // blocking like the context subscriber, so no transcript is skipped
+    EventBus::SubscriberOptions subscriber;
+    subscriber.name = "transcripts";
+    subscriber.types = EventBus::Mask(EventBus::Type::Transcript);
+    subscriber.overflow = EventBus::Overflow::Block;
+    subscriber.capacity = 256;
+    subscriber.maxBatch = 32;
+    subscriber.priority = TaskScheduler::Priority::Interactive;
+    TranscriptIndex* target = index.get();
+    eventBus.Subscribe(subscriber, [target](const EventBus::Event* events, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const auto* transcript = events[i].As<EventBus::Transcript>();
+            if (transcript && !transcript->text.empty()) {
+                target->Add(events[i].timeMs, transcript->text, transcript->speaker, transcript->systemAudio);
+            }
+        }
+    });
+    transcriptIndex = std::move(index);
+    return true;
+}
+
+// The fusion timeline, fed from the bus like the transcript index. Each
+// fused record also goes out on /timeline/stream while anyone listens
+bool EngineHost::StartTimeline() {
+    auto timeline = std::make_unique<FusionTimeline>();
+    HttpServer* server = httpServer.get();
+    timeline->SetRecordCallback([server](const FusionTimeline::Record& record) {
+        if (!server || server->GetSubscriberCount(TIMELINE_STREAM) == 0) {
+            return;
+        }
+        std::string json;
+        JsonWriter writer(json);
+        FusionTimeline::WriteRecord(writer, record);
+        server->PublishEvent(TIMELINE_STREAM, "record", json, std::to_string(record.id));
+    });
+    // Applying is an index insert or two per event: blocking, so no
+    // utterance or app switch goes missing from the timeline
+    EventBus::SubscriberOptions subscriber;
+    subscriber.name = "timeline";
+    subscriber.types = EventBus::Mask(EventBus::Type::Transcript) | EventBus::Mask(EventBus::Type::AppSwitch) |
+                       EventBus::Mask(EventBus::Type::Caption) | EventBus::Mask(EventBus::Type::ScreenCaption);
+    subscriber.overflow = EventBus::Overflow::Block;
+    subscriber.capacity = 256;
+    subscriber.maxBatch = 32;
+    subscriber.priority = TaskScheduler::Priority::Interactive;
+    FusionTimeline* target = timeline.get();
+    eventBus.Subscribe(subscriber, [target](const EventBus::Event* events, size_t count) {
+        target->Apply(events, count);
+    });
+    fusionTimeline = std::move(timeline);
+    return true;
+}
+
+// A caption that says what the kept one said goes out as that one, reused, so
+// the collector sees no change (no history entry, no version bump)
+bool EngineHost::PublishCaption(std::string text, float latencyMs, bool reused) {
+    bool held = false;
+    if (IsStarted("search") && captionDeduplicator) {
+        captionDeduplicator->SetThreshold(runtimeConfig.Get()->cameraDedupSimilarity);
+        held = captionDeduplicator->Deduplicate(text);
+    }
+    eventBus.Publish(EventBus::Caption{text, latencyMs, reused || held});
+    return held;
+}
+
+void EngineHost::LoadCameraEngine() {
+    // Initialize camera vision engine
+    cameraEngine = std::make_unique<CameraVisionEngine>();
+    if (options.cameraRegions && !cameraEngine->EnableRegionDetection(runtimeConfig.Get()->cameraRegionModel)) {
+        LOG_WARNING("Engine", "Region detector unavailable, captioning whole frames");
+    }
+    cameraEngine->SetCaptureBackend(options.cameraBackend);
+    cameraEngine->SetCaptureSource(options.cameraSource);
+    if (!cameraEngine->Initialize(runtimeConfig.Get()->cameraModelDir, 0)) {
+        LOG_WARNING("Engine", "Failed to initialize camera engine");
+        cameraEngine.reset();
+        contextCollector->UpdateModelStatus("camera", "failed");
+        return;
+    }
+    LOG_DEBUG("Engine", "Camera vision engine initialized");
+    contextCollector->UpdateModelStatus("camera", "ready");
+
+    // Shutdown terminates the ORT run in flight, same lifetime as the audio engine's
+    CameraVisionEngine* engine = cameraEngine.get();
+    shutdown.OnCancel([engine]() { engine->Cancel(); });
+
+    // Captions stream into the context word by word while they decode
+    {
+        std::lock_guard<std::mutex> describeLock(describeMutex);
+        liveCameraEngine = engine;
+    }
+    cameraPreview->SetCapture(engine->GetCapture(0));
+    engine->SetPartialCaptionCallback([this](const std::string& partial) {
+        eventBus.Publish(EventBus::CaptionPartial{partial});
+    });
+
+    // Start camera processing thread (interval from CameraCadence, camera.interval_ms by default)
+    uint64_t generation = cameraGeneration.load();
+    cameraThread = std::make_unique<std::thread>([this, engine, generation]() {
+        // Counted until it leaves: after a restart nobody joins it
+        OutstandingThread outstanding(outstandingThreads);
+        // Caption decode yields to audio: below-normal priority, Vision cores
+        CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vision);
+        Watchdog::Heartbeat heartbeat("camera_caption", "camera", CAMERA_STALL_MS);
+        ThreadCpu::Scope cpu(ThreadCpu::Group::Camera);
+        CameraCadence cadence;
+        cadence.SetVoiceActivitySource([this]() {
+            std::lock_guard<std::mutex> lock(segmenterMutex);
+            return liveAudioEngine && liveAudioEngine->GetMetrics().isSpeechDetected;
+        });
+        // EcoQoS from the budget (hybrid CPUs) or, from Balanced down, the power profile
+        bool budgetEcoQos = CpuBudget::Instance().UsesEcoQos(CpuBudget::Subsystem::Vision);
+        bool ecoQos = budgetEcoQos;
+        int64_t suspendedSinceMs = -1;          // Cameras released at this time; -1 while capturing
+        std::string question;                   // camera.question last handed to the engine
+        uint64_t scenesEmpty = 0;               // SceneStats::scenesEmpty after the last caption
+        while (running.load() && cameraGeneration.load() == generation) {
+            heartbeat.Beat("describe scene");
+            // Suspended: release the cameras, drop FastVLM after suspend.unload_ms, and
+            // poll quickly so a resume reopens them well within a second
+            if (suspended.load()) {
+                if (suspendedSinceMs < 0) {
+                    engine->CloseCameras();
+                    suspendedSinceMs = NowMs();
+                    contextCollector->UpdateModelStatus("camera", "suspended");
+                    LOG_DEBUG("Engine", "Cameras released (suspended)");
+                }
+                int unloadMs = runtimeConfig.Get()->suspendUnloadMs;
+                if (unloadMs > 0 && engine->AreModelsLoaded() && NowMs() - suspendedSinceMs >= unloadMs) {
+                    engine->UnloadModels();
+                    LOG_DEBUG("Engine", "Camera models unloaded (suspended)");
+                }
+                heartbeat.Idle();
+                shutdown.WaitFor(100);
+                continue;
+            }
+            if (suspendedSinceMs >= 0) {
+                suspendedSinceMs = -1;
+                bool reopened = engine->ReopenCameras();
+                contextCollector->UpdateModelStatus("camera", !reopened ? "failed" :
+                                                    engine->AreModelsLoaded() ? "ready" : "unloaded");
+                LOG_DEBUG("Engine", "Cameras " << (reopened ? "reopened" : "failed to reopen") << " (resumed)");
+            }
+            PowerPolicy::Settings power = PowerSettings();
+            if ((power.backgroundEcoQos || budgetEcoQos) != ecoQos) {
+                ecoQos = power.backgroundEcoQos || budgetEcoQos;
+                PowerPolicy::SetThreadEcoQos(ecoQos);
+            }
+            cadence.SetPowerScale(power.cameraIntervalScale);
+            cadence.SetPresenceScale(PresenceSettings().cameraIntervalScale);
+            // Over the resource quota: no captions, and the FastVLM memory back
+            if (ResourceQuota::Instance().GetSettings().captionsPaused && engine->AreModelsLoaded()) {
+                engine->UnloadModels();
+                contextCollector->UpdateModelStatus("camera", "unloaded");
+                LOG_DEBUG("Engine", "Camera models unloaded (quota)");
+            }
+            // Nobody has asked for context lately: give the FastVLM memory back
+            if (NowMs() - lastContextRequestMs.load() > CAMERA_IDLE_UNLOAD_MS) {
+                if (engine->AreModelsLoaded()) {
+                    engine->UnloadModels();
+                    contextCollector->UpdateModelStatus("camera", "unloaded");
+                    LOG_DEBUG("Engine", "Camera models unloaded (idle)");
+                }
+                heartbeat.Idle();
+                shutdown.WaitFor(1000);
+                continue;
+            }
+
+            // A failed encode is logged once, not retried every scene
+            std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+            if (config->cameraQuestion != question) {
+                question = config->cameraQuestion;
+                engine->SetPromptQuestion(question);
+                // Answers to the old question are no reference for the new one
+                if (IsStarted("search") && captionDeduplicator) {
+                    captionDeduplicator->Reset();
+                }
+            }
+
+            // Display off or lid closed: nothing worth captioning (/describe still answers)
+            if (engine->IsReady() && !power.cameraPaused) {
+                if (!engine->AreModelsLoaded()) {
+                    contextCollector->UpdateModelStatus("camera", "loading");
+                }
+                // Through the request queue, so a /describe for the same frame shares this caption
+                CameraVisionEngine::Caption caption = engine->Submit().get();
+                contextCollector->UpdateModelStatus("camera", engine->AreModelsLoaded() ? "ready" : "failed");
+                if (!caption.description.empty()) {
+                    bool held = PublishCaption(caption.description, caption.latencyMs, caption.reused);
+                    if (!caption.reused && !held) {
+                        LOG_DEBUG("Engine", "Camera scene: " << caption.description << " (latency: "
+                                  << static_cast<int>(caption.latencyMs) << "ms)");
+                    }
+                }
+                auto stats = engine->GetSceneStats();
+                cadence.ReportScene(stats.lastSceneDistance);
+                // Someone in view: movement, or (region detection) a scene that wasn't empty
+                bool personSeen = options.cameraRegions && !caption.reused && !caption.description.empty() &&
+                                  stats.scenesEmpty == scenesEmpty;
+                scenesEmpty = stats.scenesEmpty;
+                if (presence && (stats.lastSceneDistance >= CameraCadence::HIGH_MOTION_BITS || personSeen)) {
+                    presence->ReportActivity();
+                }
+                contextCollector->UpdateCameraStats(stats.scenesDescribed, stats.scenesSkipped,
+                                                    stats.cacheHits, stats.cacheMisses);
+            }
+            // Sleep in slices so shutdown and a returning client are noticed quickly; the
+            // interval is re-read each slice, so a meeting or speech starting cuts it short
+            int64_t sleepStartMs = NowMs();
+            cadence.SetDefaultIntervalMs(runtimeConfig.Get()->cameraIntervalMs);
+            while (running.load() && cameraGeneration.load() == generation && !suspended.load() &&
+                   NowMs() - sleepStartMs < cadence.IntervalMs()) {
+                heartbeat.Beat();
+                cadence.SetPresenceScale(PresenceSettings().cameraIntervalScale);
+                shutdown.WaitFor(1000);
+            }
+        }
+    });
+    LOG_DEBUG("Engine", "Camera processing thread started");
+}
+
+bool EngineHost::StartScreenCaptions() {
+    if (!ScreenCapture::IsSupported()) {
+        LOG_INFO("Engine", "Windows.Graphics.Capture unavailable; no screen captions");
+        return false;
+    }
+    screenCapture = std::make_unique<ScreenCapture>();
+    screenText = std::make_unique<ScreenText>();
+    screenThread = std::make_unique<std::thread>([this]() {
+        RunScreenCaptions();
+    });
+    return true;
+}
+
+// The foreground window is followed every SCREEN_POLL_MS; frames cost
+// nothing until one is taken, at most every screen.interval_ms (scaled like
+// the camera's on battery), and only a change of SCREEN_MIN_CHANGE or more is
+// looked at: its new text recognized (screen.ocr) and, unless a caption is
+// still in flight, captioned - cropped to the changed region unless most of
+// the window moved
+void EngineHost::RunScreenCaptions() {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vision);
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Screen);
+    HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    ScreenCapture& capture = *screenCapture;
+    ScreenCapture::Frame frame;
+    HWND refused = nullptr;                     // Last window that couldn't be captured
+    bool ocrFailed = false;                     // No OCR language: not tried again
+    ScreenText::Result text;
+    int64_t lastCaptionMs = 0;
+    // When the caption in flight was submitted (0: none); shared with its callback
+    auto pendingSinceMs = std::make_shared<std::atomic<int64_t>>(0);
+
+    while (running.load()) {
+        std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+        int intervalMs = config->screenIntervalMs;
+        PowerPolicy::Settings power = PowerSettings();
+        bool unread = NowMs() - lastContextRequestMs.load() > CAMERA_IDLE_UNLOAD_MS;
+        // Off, paused, nobody looking or unread: no capture session, so no frames at all
+        if (intervalMs <= 0 || suspended.load() || power.cameraPaused || PresenceSettings().screenPaused || unread) {
+            capture.SetTarget(nullptr);
+            if (intervalMs <= 0) {
+                capture.Stop();
+            }
+            refused = nullptr;
+            shutdown.WaitFor(1000);
+            continue;
+        }
+        if (!capture.Start()) {
+            break;
+        }
+
+        HWND foreground = GetForegroundWindow();
+        if (foreground != capture.GetTarget() && foreground != refused) {
+            refused = capture.SetTarget(foreground) ? nullptr : foreground;
+        }
+
+        int64_t now = NowMs();
+        int64_t pending = pendingSinceMs->load();
+        bool busy = pending != 0 && now - pending < SCREEN_CAPTION_TIMEOUT_MS;
+        if (now - lastCaptionMs >= static_cast<int64_t>(intervalMs) * power.cameraIntervalScale &&
+            capture.TakeChanged(frame, SCREEN_MIN_CHANGE)) {
+            lastCaptionMs = now;
+            wchar_t title[256] = {0};
+            GetWindowTextW(frame.window, title, static_cast<int>(std::size(title)));
+            std::string window = WindowsAPIs::WideStringToUtf8(title);
+
+            if (config->screenOcr && !ocrFailed && !screenText->IsReady()) {
+                ocrFailed = !screenText->Initialize();
+            }
+            if (config->screenOcr && screenText->IsReady() &&
+                screenText->Update(frame.image, frame.window, frame.sourceWidth, text)) {
+                eventBus.Publish(EventBus::ScreenText{text.text, window, text.latencyMs, text.rowsRecognized,
+                                                      text.rows});
+            }
+            if (busy) {
+                shutdown.WaitFor(SCREEN_POLL_MS);
+                continue;
+            }
+
+            double area = static_cast<double>(frame.image.cols) * frame.image.rows;
+            float changedShare = static_cast<float>(frame.changed.area() / area);
+            // A small change is captioned with some of its surroundings, at least a third of each side
+            cv::Rect region;
+            if (changedShare < 0.5f) {
+                int width = (std::max)(frame.changed.width, frame.image.cols / 3);
+                int height = (std::max)(frame.changed.height, frame.image.rows / 3);
+                int x = frame.changed.x + frame.changed.width / 2 - width / 2;
+                int y = frame.changed.y + frame.changed.height / 2 - height / 2;
+                region = cv::Rect(x, y, width, height) & cv::Rect(0, 0, frame.image.cols, frame.image.rows);
+            }
+
+            std::lock_guard<std::mutex> lock(describeMutex);
+            if (liveCameraEngine && liveCameraEngine->IsReady()) {
+                pendingSinceMs->store(now);
+                liveCameraEngine->Submit(frame.image, region,
+                                         [this, pendingSinceMs, window, changedShare](const CameraVisionEngine::Caption& caption) {
+                    if (!caption.description.empty()) {
+                        eventBus.Publish(EventBus::ScreenCaption{caption.description, window, caption.latencyMs,
+                                                                 changedShare});
+                    }
+                    pendingSinceMs->store(0);
+                });
+            }
+        }
+        shutdown.WaitFor(SCREEN_POLL_MS);
+    }
+
+    capture.Stop();
+    if (SUCCEEDED(com)) {
+        CoUninitialize();
+    }
+}
+
+// CameraMode::Python: the PyTorch client captions, fed frames through shared
+// memory instead of opening the camera itself
+bool EngineHost::StartPublisher() {
+    std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+    if (config->publishUrl.empty()) {
+        return true;
+    }
+    ContextPublisher::Settings settings;
+    settings.url = config->publishUrl;
+    settings.token = config->publishToken;
+    settings.node = config->publishNode;
+    settings.batchMs = config->publishBatchMs;
+    settings.bufferBytes = static_cast<size_t>(config->publishBufferKb) * 1024;
+    auto publisher = std::make_unique<ContextPublisher>(*contextCollector, settings);
+    if (!publisher->Start()) {
+        return false;
+    }
+    contextPublisher = std::move(publisher);
+    return true;
+}
+
+bool EngineHost::StartSessionBroker() {
+    int maxSessions = runtimeConfig.Get()->maxSessions;
+    if (maxSessions <= 0) {
+        return true;                // Console only
+    }
+    // Each session's engine is set up on whatever audio engine is live when
+    // its agent connects (none during a restart: that session goes without voice)
+    auto broker = std::make_unique<SessionBroker>(static_cast<size_t>(maxSessions), [this](AudioCaptureEngine& engine) {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        return liveAudioEngine && engine.InitializeShared(*liveAudioEngine, SessionBroker::WATCHDOG_GROUP);
+    });
+    {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        broker->SetSegmenterConfig(segmenterConfig);
+        broker->SetPowerSettings(AudioPowerSettings(PowerSettings()));
+        liveSessionBroker = broker.get();
+    }
+    if (!broker->Start(options.launchSessionAgents)) {
+        std::lock_guard<std::mutex> lock(segmenterMutex);
+        liveSessionBroker = nullptr;
+        return false;
+    }
+    sessionBroker = std::move(broker);
+    return true;
+}
+
+bool EngineHost::StartCameraBridge() {
+    // Worker: a ring of this engine's own, so a Python client can't attach to it
+    const bool worker = options.cameraMode == Options::CameraMode::Worker;
+    std::string ringName = SharedFrameRing::DEFAULT_NAME;
+    if (worker) {
+        ringName += "." + std::to_string(GetCurrentProcessId());
+        LOG_INFO("Engine", "Camera vision: FastVLM worker process over shared memory (" << ringName << ")");
+    } else {
+        LOG_INFO("Engine", "Camera vision: Python client over shared memory (" << ringName << ")");
+    }
+    // The ring carries BGR8, which the OpenCV backends deliver (DirectShow, as the client used)
+    frameCapture.SetBackend(FrameCapture::Backend::DirectShow);
+    if (!frameCapture.Open(0) || !frameRing.Create(ringName)) {
+        LOG_WARNING("Engine", "Failed to start camera bridge; /update_context still accepts captions");
+        contextCollector->UpdateModelStatus("camera", "failed");
+        return false;
+    }
+    contextCollector->UpdateModelStatus("camera", "ready");
+    cameraPreview->SetCapture(&frameCapture);
+    if (worker) {
+        // Below normal: captions give way to the engine's own threads and to whisper
+        std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+        captionWorker = std::make_unique<InferenceSupervisor::Process>(
+            "caption", std::vector<std::string>{ "--caption-worker", ringName, std::to_string(GetCurrentProcessId()),
+                                                 config->cameraModelDir, std::to_string(config->cameraIntervalMs) },
+            BELOW_NORMAL_PRIORITY_CLASS);
+    }
+
+    // Bridge thread: frames out at the capture rate, captions back as they land
+    cameraThread = std::make_unique<std::thread>([this]() {
+        uint64_t lastSequence = 0;
+        bool released = false;
+        int64_t unansweredSinceMs = 0;          // Worker: oldest frame published since the last caption
+        while (running.load()) {
+            // Suspended: the camera is released until the resume
+            if (suspended.load() != released) {
+                released = !released;
+                if (released) {
+                    frameCapture.Close();
+                } else if (!frameCapture.Open(0)) {
+                    LOG_WARNING("Engine", "Camera bridge failed to reopen the camera after resume");
+                }
+                contextCollector->UpdateModelStatus("camera", released ? "suspended" : "ready");
+            }
+            // Worker: (re)start it, and replace one that sits on a frame too long
+            if (captionWorker && !released) {
+                if (!captionWorker->IsRunning()) {
+                    if (captionWorker->EnsureRunning() && unansweredSinceMs > 0) {
+                        unansweredSinceMs = NowMs();
+                    }
+                } else if (unansweredSinceMs > 0 && NowMs() - unansweredSinceMs >
+                           CAPTION_WORKER_HANG_MS + runtimeConfig.Get()->cameraIntervalMs) {
+                    captionWorker->Fail(InferenceSupervisor::Failure::Hang);
+                    unansweredSinceMs = 0;
+                }
+            }
+            const FrameCapture::Frame* latest = frameCapture.AcquireLatest();
+            if (latest && latest->sequence != lastSequence) {
+                frameRing.PublishFrame(latest->frame);
+                lastSequence = latest->sequence;
+                if (unansweredSinceMs == 0) {
+                    unansweredSinceMs = NowMs();
+                }
+            }
+
+            SharedFrameRing::Result result;
+            if (frameRing.PollResult(result)) {
+                unansweredSinceMs = 0;
+                if (captionWorker) {
+                    captionWorker->MarkHealthy();
+                }
+                if (!result.text.empty()) {
+                    PublishCaption(result.text, result.latencyMs, false);
+                    LOG_DEBUG("Engine", "Camera: " << result.text
+                              << " (latency: " << static_cast<int>(result.latencyMs) << "ms)");
+                }
+            }
+            shutdown.WaitFor(50);
+        }
+    });
+    LOG_DEBUG("Engine", "Camera bridge thread started");
+    return true;
+}
+
+// ============================================================================
+// Stall recovery
+// ============================================================================
+
+bool EngineHost::BeginEngineRestart(const char* engineName, int& restarts, const char* thread) {
+    // A stall while the engine's startup task still runs is the load itself
+    if (!running.load() || !restartStalledEngines.load() || !startup || !startup->IsDone(engineName)) {
+        return false;
+    }
+    if (restarts >= MAX_ENGINE_RESTARTS) {
+        LOG_ERROR("Engine", "Not restarting " << engineName << " after a stall in " << thread
+                  << ": already restarted " << restarts << " times");
+        return false;
+    }
+    restarts++;
+    LOG_WARNING("Engine", "Restarting " << engineName << " after a stall in " << thread
+                << " (restart " << restarts << " of " << MAX_ENGINE_RESTARTS << ")");
+    return true;
+}
+
+void EngineHost::RestartAudioEngine(const char* thread) {
+    std::lock_guard<std::mutex> lock(engineRestartMutex);
+    if (!audioEngine || !BeginEngineRestart("voice", audioRestarts, thread)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> segmenterLock(segmenterMutex);
+        liveAudioEngine = nullptr;
+    }
+    // Healthy threads see the flag and exit; the wedged one keeps the engine alive
+    audioEngine->RequestStop();
+    audioEngine.release();
+    audioGeneration++;
+    contextCollector->UpdateModelStatus("voice", "restarting");
+    LoadAudioEngine();
+}
+
+void EngineHost::RestartCameraEngine(const char* thread) {
+    // Only a wedged caption loop is recoverable here: a stuck capture thread
+    // would also block CloseCameras()
+    if (std::string(thread) != "camera_caption") {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(engineRestartMutex);
+    if (!cameraEngine || !BeginEngineRestart("camera", cameraRestarts, thread)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> describeLock(describeMutex);
+        liveCameraEngine = nullptr;
+    }
+    cameraPreview->SetCapture(nullptr);
+    // The new engine needs the device: release it from under the stuck caption
+    cameraEngine->CloseCameras();
+    cameraEngine.release();
+    cameraGeneration++;
+    if (cameraThread && cameraThread->joinable()) {
+        cameraThread->detach();
+    }
+    contextCollector->UpdateModelStatus("camera", "restarting");
+    LoadCameraEngine();
+}
+
+// ============================================================================
+// HTTP
+// ============================================================================
+
+void EngineHost::RunHttpServer() {
+    try {
+        int port = httpServer->GetPort();
+        if (!httpServer->Start()) {
+            LOG_ERROR("Engine", "Failed to start HTTP server! Possible causes: port " << port << " already in use, "
+                                "insufficient permissions, or a firewall blocking the connection");
+            serverFailed = true;
+            running = false;
+            return;
+        }
+
+        LOG_INFO("Engine", "Server is now listening on: http://localhost:" << port);
+        LOG_INFO("Engine", "Dashboard: http://localhost:" << port << "/dashboard (live at /dashboard/stream)");
+        LOG_INFO("Engine", "API endpoint: http://localhost:" << port << "/context");
+        LOG_INFO("Engine", "Push endpoint: http://localhost:" << port << "/context/stream");
+        LOG_INFO("Engine", "Watch endpoint: http://localhost:" << port << "/context/watch?where=...");
+        LOG_INFO("Engine", "Metrics: http://localhost:" << port << "/metrics");
+        LOG_INFO("Engine", "Timeline: http://localhost:" << port << "/timeline (live: /timeline/stream)");
+        LOG_INFO("Engine", "Startup: http://localhost:" << port << "/startup");
+        LOG_INFO("Engine", "Camera preview: http://localhost:" << port << "/camera/latest.jpg (live: /camera/stream.mjpg)");
+        LOG_INFO("Engine", "Caption now: http://localhost:" << port << "/describe (POST an image to caption it)");
+        LOG_INFO("Engine", "Log level: http://localhost:" << port << "/log (POST ?level=debug to change)");
+        LOG_INFO("Engine", "Config: http://localhost:" << port << "/config (POST to reload " << RuntimeConfig::DefaultPath() << ")");
+        LOG_INFO("Engine", "Experiments: http://localhost:" << port << "/experiments (profiles from "
+                 << Experiments::DefaultPath() << ")");
+        LOG_INFO("Engine", "Power profile: http://localhost:" << port << "/power (POST ?profile=saver to pin one)");
+        LOG_INFO("Engine", "Resource quota: http://localhost:" << port << "/quota");
+        LOG_INFO("Engine", "Heartbeats: http://localhost:" << port << "/watchdog (stall dumps in "
+                 << STALL_DUMP_DIRECTORY << ")");
+
+        // Run the server loop
+        httpServer->Run();
+
+        LOG_DEBUG("Engine", "HTTP server loop ended");
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Engine", "HTTP server thread exception: " << e.what());
+        serverFailed = true;
+    }
+    running = false;
+}
+
+HttpRouter::RouteBuilder EngineHost::AddRoute(HttpRouter::Method method, const char* path,
+                                              HttpRouter::Handler handler, AdmissionControl::Class admissionClass) {
+    std::string label = std::string(HttpRouter::MethodName(method)) + " " + path;
+    return router->Add(method, path, std::move(handler))
+        .Use(router->Metrics(label))
+        .Use(admission->Gate(admissionClass));
+}
+
+void EngineHost::ApplyAdmissionLimits() {
+    std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+    AdmissionControl::Limits limits;
+    limits.maxConcurrent = config->httpMaxConcurrent;
+    limits.clientRate = config->httpClientRate;
+    limits.clientBurst = config->httpClientBurst;
+    // Over the resource quota: Read requests shed first (the ingest reserve scales with the cap)
+    int share = ResourceQuota::Instance().GetSettings().httpShare;
+    if (share > 1) {
+        limits.maxConcurrent = (std::max)(4, limits.maxConcurrent / share);
+        limits.clientRate /= share;
+        limits.clientBurst = (std::max)(1, limits.clientBurst / share);
+    }
+    admission->SetLimits(limits);
+}
+
+void EngineHost::ApplyConfigChanges(const std::vector<std::string>& changed) {
+    std::shared_ptr<const RuntimeConfig::Values> config = runtimeConfig.Get();
+    for (const std::string& key : changed) {
+        if (key.rfind("quota.", 0) == 0) {
+            ResourceQuota::Instance().SetLimits(QuotaLimits(*config));
+            break;
+        }
+    }
+    ApplyAdmissionLimits();
+    presence->SetThresholds(config->presenceIdleMs, config->presenceAwayMs);
+    memoryTrimmer->SetQuietMs(config->memoryTrimAfterMs);
+    std::lock_guard<std::mutex> lock(segmenterMutex);
+    if (ApplyHotConfig(*config, changed, segmenterConfig)) {
+        if (liveAudioEngine) {
+            liveAudioEngine->SetSegmenterConfig(segmenterConfig);
+        }
+        if (liveSessionBroker) {
+            liveSessionBroker->SetSegmenterConfig(segmenterConfig);
+        }
+    }
+}
+
+// The whole HTTP API, compiled before the server starts and never changed
+// while it runs, so dispatch reads the tables without locking
+void EngineHost::RegisterRoutes() {
+    using Method = HttpRouter::Method;
+    router = std::make_unique<HttpRouter>();
+    admission = std::make_unique<AdmissionControl>();
+    ApplyAdmissionLimits();
+
+    // Context: 503 with the startup progress until the collector is up.
+    // /context encodes (and caches) per document version itself
+    AddRoute(Method::Get, "/context", [this](const HttpRequest& request, HttpResponse& response) {
+        lastContextRequestMs = NowMs();
+        WithContext(response, [&](ContextCollector& collector) {
+            ServeContext(collector, request, response);
+        });
+    });
+    AddRoute(Method::Get, "/context/stream", [this](const HttpRequest&, HttpResponse& response) {
+        lastContextRequestMs = NowMs();
+        WithContext(response, [&](ContextCollector&) {
+            contextStream->Subscribe(response);
+            LOG_DEBUG("Engine", "Context stream subscriber added");
+        });
+    });
+    AddRoute(Method::Get, "/dashboard/stream", [this](const HttpRequest&, HttpResponse& response) {
+        WithContext(response, [&](ContextCollector&) {
+            dashboardStream->Subscribe(response);
+            LOG_DEBUG("Engine", "Dashboard stream subscriber added");
+        });
+    });
+    // GET /context/summary?max_tokens=N: the context as prompt text, highest priority lines that fit
+    AddRoute(Method::Get, "/context/summary", [this](const HttpRequest& request, HttpResponse& response) {
+        lastContextRequestMs = NowMs();
+        WithContext(response, [&](ContextCollector&) {
+            std::string budget = request.GetQueryParam("max_tokens");
+            size_t maxTokens = budget.empty() ? ContextSummary::DEFAULT_MAX_TOKENS
+                                              : static_cast<size_t>(std::strtoull(budget.c_str(), nullptr, 10));
+            ContextSummary::Result summary = contextSummary->Render(maxTokens);
+            response.SetHeader("Content-Type", "text/plain; charset=utf-8");
+            response.SetHeader("X-Context-Version", std::to_string(summary.version));
+            response.SetHeader("X-Summary-Tokens", std::to_string(summary.tokens));
+            response.SetHeader("X-Summary-Omitted", std::to_string(summary.omitted));
+            response.SetHeader("X-Summary-Tokenizer", summary.exact ? "fastvlm" : "estimate");
+            response.SetHeader("Access-Control-Expose-Headers",
+                               "X-Context-Version, X-Summary-Tokens, X-Summary-Omitted, X-Summary-Tokenizer");
+            response.SetSharedBody(summary.text);
+            response.status = 200;
+        });
+    });
+    // GET /context/watch?where=<predicate>&fields=: events only when the predicate matches
+    AddRoute(Method::Get, "/context/watch", [this](const HttpRequest& request, HttpResponse& response) {
+        lastContextRequestMs = NowMs();
+        WithContext(response, [&](ContextCollector&) {
+            std::string error;
+            if (!contextWatch->Subscribe(HttpRequest::DecodeQueryValue(request.GetQueryParam("where")),
+                                         HttpRequest::DecodeQueryValue(request.GetQueryParam("fields")),
+                                         response, error)) {
+                std::string body;
+                JsonWriter writer(body);
+                writer.BeginObject().Key("error").String(error).EndObject();
+                response.SetHeader("Content-Type", "application/json");
+                response.SetBody(body);
+                response.status = 400;
+            }
+        });
+    });
+    AddRoute(Method::Post, "/update_context", [this](const HttpRequest& request, HttpResponse& response) {
+        WithContext(response, [&](ContextCollector& collector) {
+            ServeContextUpdate(collector, request, response);
+        });
+    }, AdmissionControl::Class::Ingest);
+    AddRoute(Method::Post, "/ingest", [this](const HttpRequest& request, HttpResponse& response) {
+        WithContext(response, [&](ContextCollector& collector) {
+            ServeIngest(collector, request, response);
+        });
+    }, AdmissionControl::Class::Ingest);
+    // Dashboards re-query the same window; a repeat within the TTL skips the downsampling
+    AddRoute(Method::Get, "/history", [this](const HttpRequest& request, HttpResponse& response) {
+        WithContext(response, [&](ContextCollector& collector) {
+            ServeHistory(collector, request, response);
+        });
+    }).Use(HttpRouter::Cache(HISTORY_CACHE_MS)).Use(HttpRouter::Compress(CONTEXT_COMPRESS_MIN_BYTES));
+    // 503 until the search task ran, 404 without the sentence embedder
+    AddRoute(Method::Get, "/search", [this](const HttpRequest& request, HttpResponse& response) {
+        if (!IsStarted("search")) {
+            ServeStarting(response);
+            return;
+        }
+        if (!sentenceEmbedder || !vectorIndex) {
+            response.SetHeader("Content-Type", "application/json");
+            response.SetBody("{\"error\":\"Search disabled (no sentence embedder or index)\"}");
+            response.status = 404;
+            return;
+        }
+        ServeSearch(*sentenceEmbedder, *vectorIndex, request, response);
+    });
+    AddRoute(Method::Get, "/transcripts", [this](const HttpRequest& request, HttpResponse& response) {
+        if (!IsStarted("transcripts")) {
+            ServeStarting(response);
+            return;
+        }
+        if (!transcriptIndex) {
+            response.SetHeader("Content-Type", "application/json");
+            response.SetBody("{\"error\":\"Transcript index unavailable\"}");
+            response.status = 404;
+            return;
+        }
+        ServeTranscripts(*transcriptIndex, request, response);
+    });
+    // GET /timeline?since=&limit=: fused records (an utterance and the apps,
+    // captions and screens overlapping it) after id `since`, oldest first
+    AddRoute(Method::Get, "/timeline", [this](const HttpRequest& request, HttpResponse& response) {
+        if (!IsStarted("timeline")) {
+            ServeStarting(response);
+            return;
+        }
+        std::string since = request.GetQueryParam("since");
+        std::string limit = request.GetQueryParam("limit");
+        std::string body;
+        JsonWriter writer(body);
+        fusionTimeline->WriteRecords(writer, since.empty() ? 0 : std::strtoull(since.c_str(), nullptr, 10),
+                                     limit.empty() ? TIMELINE_DEFAULT_LIMIT
+                                                   : static_cast<size_t>(std::strtoull(limit.c_str(), nullptr, 10)));
+        response.SetHeader("Content-Type", "application/json");
+        response.SetBody(body);
+        response.status = 200;
+    });
+    // GET /timeline/events?from=&to=: every modality's events overlapping the
+    // window (Unix epoch ms; default the last minute)
+    AddRoute(Method::Get, "/timeline/events", [this](const HttpRequest& request, HttpResponse& response) {
+        if (!IsStarted("timeline")) {
+            ServeStarting(response);
+            return;
+        }
+        std::string from = request.GetQueryParam("from");
+        std::string to = request.GetQueryParam("to");
+        int64_t toMs = to.empty() ? ContextHistory::NowMs() : std::strtoll(to.c_str(), nullptr, 10);
+        int64_t fromMs = from.empty() ? toMs - 60 * 1000 : std::strtoll(from.c_str(), nullptr, 10);
+        if (fromMs > toMs) {
+            response.SetHeader("Content-Type", "application/json");
+            response.SetBody("{\"error\":\"from is after to\"}");
+            response.status = 400;
+            return;
+        }
+        std::string body;
+        JsonWriter writer(body);
+        fusionTimeline->WriteEvents(writer, fromMs, toMs);
+        response.SetHeader("Content-Type", "application/json");
+        response.SetBody(body);
+        response.status = 200;
+    });
+    AddRoute(Method::Get, "/timeline/stream", [this](const HttpRequest&, HttpResponse& response) {
+        if (!IsStarted("timeline")) {
+            ServeStarting(response);
+            return;
+        }
+        response.StartEventStream(TIMELINE_STREAM);
+        LOG_DEBUG("Engine", "Timeline stream subscriber added");
+    });
+
+    // Diagnostics
+    AddRoute(Method::Get, "/startup", [this](const HttpRequest&, HttpResponse& response) {
+        std::string body;
+        JsonWriter writer(body);
+        startup->Write(writer);
+        response.SetHeader("Content-Type", "application/json");
+        response.SetBody(body);
+        response.status = 200;
+    });
+    AddRoute(Method::Get, "/presence", [this](const HttpRequest&, HttpResponse& response) {
+        ServePresence(*presence, response);
+    });
+    AddRoute(Method::Get, "/metrics", [this](const HttpRequest&, HttpResponse& response) {
+        bool screen = IsStarted("screen");
+        std::string archive;
+        {
+            std::lock_guard<std::mutex> lock(segmenterMutex);
+            if (liveAudioEngine && liveAudioEngine->GetArchive()) {
+                archive = liveAudioEngine->GetArchive()->FormatPrometheus();
+            }
+        }
+        ServeMetrics(*router, *admission, eventBus, screen ? screenCapture.get() : nullptr,
+                     screen ? screenText.get() : nullptr, *memoryTrimmer, archive, lastShutdownMetrics, response);
+    }).Use(HttpRouter::Compress(CONTEXT_COMPRESS_MIN_BYTES));
+    AddRoute(Method::Get, "/experiments", [](const HttpRequest&, HttpResponse& response) {
+        ServeExperiments(response);
+    });
+    AddRoute(Method::Get, "/quota", [](const HttpRequest&, HttpResponse& response) {
+        ServeQuota(response);
+    });
+    AddRoute(Method::Get, "/utterances", [](const HttpRequest&, HttpResponse& response) {
+        ServeUtterances(response);
+    }).Use(HttpRouter::Compress(CONTEXT_COMPRESS_MIN_BYTES));
+
+    // Fleet publishing state (ContextPublisher); 404 when publish.url is empty
+    AddRoute(Method::Get, "/publish", [this](const HttpRequest&, HttpResponse& response) {
+        if (!IsStarted("publish")) {
+            ServeStarting(response);
+            return;
+        }
+        response.SetHeader("Content-Type", "application/json");
+        if (!contextPublisher) {
+            response.SetBody("{\"error\":\"Publishing disabled (publish.url is empty)\"}");
+            response.status = 404;
+            return;
+        }
+        std::string body;
+        JsonWriter writer(body);
+        contextPublisher->Write(writer);
+        response.SetBody(body);
+        response.status = 200;
+    });
+
+    // Other user sessions (SessionBroker): 503 until the sessions task ran
+    AddRoute(Method::Get, "/sessions", [this](const HttpRequest&, HttpResponse& response) {
+        if (!IsStarted("sessions")) {
+            ServeStarting(response);
+            return;
+        }
+        ServeSessions(sessionBroker.get(), response);
+    });
+    router->Add(Method::Get, "/sessions/{id}/context",
+                [this](const HttpRequest&, HttpResponse& response, const HttpRouter::Params& params) {
+        if (!IsStarted("sessions")) {
+            ServeStarting(response);
+            return;
+        }
+        ServeSessionContext(sessionBroker.get(), params.Get("id"), response);
+    }).Use(router->Metrics("GET /sessions/{id}/context"));
+
+    // Read with GET, changed with POST
+    for (Method method : {Method::Get, Method::Post}) {
+        AddRoute(method, "/log", [](const HttpRequest& request, HttpResponse& response) {
+            ServeLog(request, response);
+        });
+        AddRoute(method, "/watchdog", [this](const HttpRequest& request, HttpResponse& response) {
+            ServeWatchdog(request, response, restartStalledEngines);
+        }).Use(HttpRouter::Compress(CONTEXT_COMPRESS_MIN_BYTES));
+        AddRoute(method, "/audio/segmenter", [this](const HttpRequest& request, HttpResponse& response) {
+            std::lock_guard<std::mutex> lock(segmenterMutex);
+            if (ServeSegmenter(request, response, segmenterConfig)) {
+                if (liveAudioEngine) {
+                    liveAudioEngine->SetSegmenterConfig(segmenterConfig);
+                }
+                if (liveSessionBroker) {
+                    liveSessionBroker->SetSegmenterConfig(segmenterConfig);
+                }
+            }
+        });
+        AddRoute(method, "/config", [this](const HttpRequest& request, HttpResponse& response) {
+            ApplyConfigChanges(ServeConfig(runtimeConfig, request, response));
+        });
+        AddRoute(method, "/power", [this](const HttpRequest& request, HttpResponse& response) {
+            ServePower(*powerPolicy, request, response);
+        }).Use(HttpRouter::Compress(CONTEXT_COMPRESS_MIN_BYTES));
+        AddRoute(method, "/describe", [this](const HttpRequest& request, HttpResponse& response) {
+            lastContextRequestMs = NowMs();
+            ServeDescribe(describeMutex, liveCameraEngine, request, response);
+        });
+    }
+    AddRoute(Method::Post, "/ask", [this](const HttpRequest& request, HttpResponse& response) {
+        lastContextRequestMs = NowMs();
+        ServeAsk(describeMutex, liveCameraEngine, request, response);
+    });
+
+    // What the camera sees, for operators checking a caption
+    AddRoute(Method::Get, "/camera/latest.jpg", [this](const HttpRequest&, HttpResponse& response) {
+        cameraPreview->ServeLatest(response);
+    });
+    AddRoute(Method::Get, "/camera/stream.mjpg", [this](const HttpRequest&, HttpResponse& response) {
+        cameraPreview->Subscribe(response);
+        LOG_DEBUG("Engine", "Camera preview subscriber added");
+    });
+
+    // Dashboard
+    for (const char* path : {"/dashboard", "/"}) {
+        AddRoute(Method::Get, path, [this](const HttpRequest& request, HttpResponse& response) {
+            ServeDashboard(request, response);
+        });
+    }
+
+    router->Compile();
+}
+
+void EngineHost::HandleRequest(const HttpRequest& request, HttpResponse& response) {
+    try {
+        LOG_DEBUG("Engine", "Handling request: " << request.method << " " << request.path);
+        if (!router->Dispatch(request, response)) {
+            response.SetBody("{\"error\":\"Not found\"}");
+            response.status = 404;
+            LOG_DEBUG("Engine", "Path not found: " << request.path);
+        }
+    }
+    catch (const std::exception& e) {
+        response.SetBody("{\"error\":\"Internal server error\"}");
+        response.status = 500;
+        LOG_ERROR("Engine", "Exception in request handler: " << e.what());
+    }
+}
+
+void EngineHost::WithContext(HttpResponse& response, const std::function<void(ContextCollector&)>& serve) {
+    if (IsStarted("context")) {
+        serve(*contextCollector);
+    } else {
+        ServeStarting(response);
+    }
+}
+
+// 503 while the context is still coming up, with the startup progress
+void EngineHost::ServeStarting(HttpResponse& response) {
+    std::string body;
+    JsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("error").String("Starting");
+    writer.Key("startup");
+    startup->Write(writer);
+    writer.EndObject();
+    response.SetHeader("Content-Type", "application/json");
+    response.SetHeader("Retry-After", "1");
+    response.SetBody(body);
+    response.status = 503;
+}
+
+void EngineHost::ServeDashboard(const HttpRequest& request, HttpResponse& response) {
+    if (dashboardAsset.Serve(request, response)) {
+        LOG_DEBUG("Engine", "Served dashboard HTML");
+    } else {
+        response.SetBody("<html><body><h1>Error: dashboard.html not found</h1></body></html>");
+        response.SetHeader("Content-Type", "text/html");
+        response.status = 500;
+        LOG_ERROR("Engine", "dashboard.html not found");
+    }
+}
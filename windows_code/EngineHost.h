@@ -0,0 +1,338 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AdmissionControl.h"
+#include "AudioCaptureEngine.h"
+#include "CancellationToken.h"
+#include "CameraVisionEngine.h"
+#include "CaptionDeduplicator.h"
+#include "ContextCollector.h"
+#include "ContextFusion.h"
+#include "ContextPublisher.h"
+#include "EventBus.h"
+#include "CameraPreview.h"
+#include "ContextStream.h"
+#include "DashboardStream.h"
+#include "ContextSummary.h"
+#include "ContextWatch.h"
+#include "FrameCapture.h"
+#include "FusionTimeline.h"
+#include "HttpRouter.h"
+#include "HttpServer.h"
+#include "InferenceSupervisor.h"
+#include "LocalContextServer.h"
+#include "MemoryTrimmer.h"
+#include "PowerPolicy.h"
+#include "PresenceMonitor.h"
+#include "RuntimeConfig.h"
+#include "ScreenCapture.h"
+#include "ScreenText.h"
+#include "SentenceEmbedder.h"
+#include "SessionBroker.h"
+#include "SharedFrameRing.h"
+#include "StartupGraph.h"
+#include "StaticAssetCache.h"
+#include "TranscriptIndex.h"
+#include "VectorIndex.h"
+
+/**
+ * EngineHost - The engines, the context they feed and the HTTP API, wired once
+ *
+ * Both ways of running the engine go through here: the Windows service
+ * (Start in OnStart, Stop in OnStop) and --console, which only differs in
+ * the Options it passes. Same startup graph, same engines, same routes, so
+ * whatever is measured in a console run is what the service deploys.
+ *
+ * Start():
+ *   Loads the RuntimeConfig, creates the HTTP server (answering at once; the
+ *   context routes return 503 until the collector is up) and launches the
+ *   startup graph: prefetch, context, then voice, camera, screen and fusion
+ *   once the context is there. The server loop runs on its own thread. Local
+ *   processes can skip TCP: LocalContextServer mirrors the context into
+ *   shared memory and serves a pipe (ipc.local); with publish.url set,
+ *   ContextPublisher pushes it to a fleet collector. With sessions.max set, a
+ *   SessionBroker then serves that many other user sessions on the voice
+ *   task's whisper models (/sessions).
+ *
+ * Suspend:
+ *   While the session is locked (SetSuspended, from the service's session
+ *   events) or the display is off / the lid closed (PowerPolicy's Away
+ *   profile) the pipelines pause: audio capture and VAD stop (the WASAPI
+ *   streams with them), the caption loop releases the cameras, and the
+ *   collector's 1 s sampling stops. Models stay loaded for a warm resume
+ *   unless suspend.unload_ms says to drop FastVLM after a while.
+ *
+ * Presence:
+ *   Short of that, PresenceMonitor gates the pipelines on whether anyone is
+ *   at the machine (input, camera activity, the lock; presence.* keys):
+ *   Idle slows the caption loop and the collector and pauses the screen
+ *   loop, Away also stops voice capture (GET /presence). Separately,
+ *   MemoryTrimmer releases the caches of an engine that has had nothing to
+ *   do for memory.trim_after_ms, and the working set once all have.
+ *
+ * Stop:
+ *   Cancels first, then joins: the shutdown token's callbacks abort the
+ *   whisper decodes and terminate the ORT runs in progress, and the loops
+ *   waiting on it leave, so the joins that follow don't wait out an
+ *   inference. Every step is timed against Options::shutdownDeadlineMs; an
+ *   overrun is logged with the step it stuck in and handed to
+ *   onShutdownOverrun (the service ends the process). The step times are
+ *   kept in dumps/last_shutdown.prom and served on the next run's /metrics.
+ *
+ * Routes:
+ *   Registered once by RegisterRoutes() on an HttpRouter, each with a
+ *   Metrics middleware (per-route latency on /metrics), an AdmissionControl
+ *   gate (ingest ahead of reads, per-client limits) and, where the body is
+ *   worth it, Cache / Compress.
+ *
+ * Usage:
+ *   EngineHost host;
+ *   host.Start(options);
+ *   while (host.IsRunning()) { ... }
+ *   host.Stop();
+ */
+class EngineHost {
+public:
+    struct Options {
+        // Native: the ONNX FastVLM engine. Python: frames go to the PyTorch
+        // client over shared memory and its captions come back the same way.
+        // Worker: the same ring, captioned by FastVLM in a supervised child
+        // process (InferenceWorker)
+        enum class CameraMode { Native, Python, Worker };
+        CameraMode cameraMode = CameraMode::Native;
+        bool cameraRegions = false;             // Caption detected regions (cameraRegionModel)
+        FrameCapture::Backend cameraBackend = FrameCapture::Backend::Auto;
+        // Capture sources in place of the devices (load tests, remote rooms);
+        // empty: WASAPI and the cameras. Specs: AudioSource::Create, FrameCapture::SetSource
+        std::string audioSource;
+        std::string cameraSource;
+        AudioCaptureEngine::WhisperBackend whisperBackend = AudioCaptureEngine::WhisperBackend::Auto;
+        AudioCaptureEngine::KeywordGate keywordGate = AudioCaptureEngine::KeywordGate::Off;
+        // Whisper in supervised worker processes (AudioCaptureEngine::SetOutOfProcessWhisper)
+        bool isolateWhisper = false;
+        std::string fusionModel;                // Empty: the runtime config's models.fusion
+        // False: no notification window; the caller forwards power settings
+        // to HandlePowerSetting (a service, from its control handler)
+        bool watchPowerSettings = true;
+        // Stop() budget, and what to do when a step overruns it (called once,
+        // on a watcher thread, with the step's name; Stop itself carries on)
+        int shutdownDeadlineMs = 15000;
+        std::function<void(const char* step)> onShutdownOverrun;
+        // Launch the SessionBroker's agents into user sessions (needs SYSTEM: the service)
+        bool launchSessionAgents = false;
+    };
+
+    // Why the pipelines are paused; any one is enough
+    enum class SuspendReason : unsigned { SessionLocked = 1, DisplayOff = 2 };
+
+    EngineHost();
+    ~EngineHost();
+
+    EngineHost(const EngineHost&) = delete;
+    EngineHost& operator=(const EngineHost&) = delete;
+
+    /**
+     * @brief Bring everything up (engines load in the background)
+     * @throws std::exception when the HTTP server can't be created
+     */
+    void Start(const Options& options);
+
+    /**
+     * @brief Cancel the work in progress, then stop the engines, the server and the
+     *        collector; waits for startup tasks first. Does nothing unless started
+     */
+    void Stop();
+
+    // False once stopped, or when the server failed to start or died
+    bool IsRunning() const { return running.load(); }
+
+    // The HTTP server couldn't start (port in use, permissions, firewall)
+    bool HasServerFailed() const { return serverFailed.load(); }
+
+    /**
+     * @brief Set or clear one reason to suspend; pauses on the first, resumes when none is left
+     */
+    void SetSuspended(SuspendReason reason, bool active);
+    bool IsSuspended() const { return suspended.load(); }
+
+    /**
+     * @brief A PBT_POWERSETTINGCHANGE payload (Options::watchPowerSettings off)
+     */
+    void HandlePowerSetting(const GUID& setting, const void* data, size_t size);
+
+    /**
+     * @brief A user logged on to a session other than the console (WTS_SESSION_LOGON)
+     */
+    void OnSessionLogon(DWORD sessionId);
+
+private:
+    Options options;
+    bool started = false;
+    std::atomic<bool> running{false};
+
+    // Cancelled first thing in Stop(); engines register their abort on it
+    CancellationToken shutdown;
+    // Threads that can outlive what started them (an abandoned caption loop, a
+    // running stall handler); Stop waits, within the deadline, for them to leave
+    std::atomic<int> outstandingThreads{0};
+    // The previous run's shutdown step times (Prometheus text), for /metrics
+    std::string lastShutdownMetrics;
+    std::atomic<bool> serverFailed{false};
+
+    std::unique_ptr<HttpServer> httpServer;
+    std::unique_ptr<CameraPreview> cameraPreview;      // /camera/latest.jpg, /camera/stream.mjpg
+    // Engines publish their results here; the collector is the "context"
+    // subscriber. Declared first among them so it is destroyed last
+    EventBus eventBus;
+    std::unique_ptr<ContextCollector> contextCollector;
+    std::unique_ptr<ContextStream> contextStream;
+    std::unique_ptr<DashboardStream> dashboardStream;  // /dashboard/stream
+    std::unique_ptr<ContextWatch> contextWatch;
+    std::unique_ptr<ContextSummary> contextSummary;     // /context/summary
+    std::unique_ptr<LocalContextServer> localContext;   // ipc.local
+    std::unique_ptr<ContextPublisher> contextPublisher; // publish.url
+    StaticAssetCache dashboardAsset{"dashboard.html", "text/html; charset=utf-8"};
+    std::unique_ptr<AudioCaptureEngine> audioEngine;
+    std::unique_ptr<CameraVisionEngine> cameraEngine;
+    // The "search" task's (null without the model). Either camera mode's captions
+    // pass through the deduplicator before the bus; the index is fed by the bus
+    std::unique_ptr<SentenceEmbedder> sentenceEmbedder;
+    std::unique_ptr<CaptionDeduplicator> captionDeduplicator;
+    std::unique_ptr<VectorIndex> vectorIndex;
+    std::unique_ptr<TranscriptIndex> transcriptIndex;   // The "transcripts" task's
+    std::unique_ptr<FusionTimeline> fusionTimeline;     // The "timeline" task's
+    std::unique_ptr<ContextFusion> fusionEngine;
+    std::unique_ptr<SessionBroker> sessionBroker;   // sessions.max > 0
+    std::unique_ptr<std::thread> serverThread;
+    std::unique_ptr<std::thread> cameraThread;
+
+    // Foreground window captions (screen.interval_ms; off by default): the
+    // screen thread captures, recognizes the text of what changed
+    // (screen.ocr) and submits it to the live camera engine. Capture and
+    // text outlive the thread until the HTTP server (their /metrics
+    // counters) is gone
+    std::unique_ptr<ScreenCapture> screenCapture;
+    std::unique_ptr<ScreenText> screenText;
+    std::unique_ptr<std::thread> screenThread;
+
+    // CameraMode::Python / Worker: the bridge's capture and the ring it
+    // publishes into; Worker: the child captioning from it (bridge thread only)
+    FrameCapture frameCapture;
+    SharedFrameRing frameRing;
+    std::unique_ptr<InferenceSupervisor::Process> captionWorker;
+    // A frame the worker hasn't answered for this long past its caption interval
+    // (model load included) means it hangs
+    static constexpr int64_t CAPTION_WORKER_HANG_MS = 120 * 1000;
+
+    // Subsystem bring-up (see Start). Handlers touch what a task creates
+    // only once IsReady() says it is there
+    std::unique_ptr<StartupGraph> startup;
+    bool IsStarted(const char* task) const { return startup && startup->IsReady(task); }
+
+    // Paths, port and threads are read at start; GET/POST /config reloads the hot knobs
+    RuntimeConfig runtimeConfig;
+
+    // Compiled by RegisterRoutes before the server starts
+    std::unique_ptr<HttpRouter> router;
+    std::unique_ptr<AdmissionControl> admission;    // Gates every route; limits from the http.* hot keys
+
+    // FastVLM sessions are dropped after this long without a /context request
+    static constexpr int64_t CAMERA_IDLE_UNLOAD_MS = 5 * 60 * 1000;
+    std::atomic<int64_t> lastContextRequestMs{0};
+
+    // Stall recovery (off unless POST /watchdog?restart=on): a wedged engine is
+    // abandoned, not destroyed - its destructor would join the stuck thread - and
+    // a fresh one is loaded. Threads compare generations to notice they were replaced
+    static constexpr int MAX_ENGINE_RESTARTS = 3;
+    std::atomic<bool> restartStalledEngines{false};
+    std::mutex engineRestartMutex;
+    std::atomic<uint64_t> audioGeneration{0};
+    std::atomic<uint64_t> cameraGeneration{0};
+    int audioRestarts = 0;
+    int cameraRestarts = 0;
+
+    // Segmentation policy from POST /audio/segmenter; outlives engine restarts.
+    // liveAudioEngine is the engine it applies to (null while none is running),
+    // liveSessionBroker forwards it to the other sessions' engines
+    std::mutex segmenterMutex;
+    AudioCaptureEngine::SegmenterConfig segmenterConfig;
+    AudioCaptureEngine* liveAudioEngine = nullptr;
+    SessionBroker* liveSessionBroker = nullptr;
+
+    // Power profile (GET/POST /power): applied to liveAudioEngine and
+    // liveSessionBroker under segmenterMutex, read by the caption loop each pass.
+    // PowerSettings() has the ResourceQuota level's degradation folded in
+    std::unique_ptr<PowerPolicy> powerPolicy;
+    PowerPolicy::Settings PowerSettings() const;
+    static AudioCaptureEngine::PowerSettings AudioPowerSettings(const PowerPolicy::Settings& settings);
+    // A quota level change: the audio engines' power settings and the admission limits again
+    void ApplyQuotaLevel();
+
+    // SuspendReason bits; suspendMutex serializes the pause / resume of the
+    // audio engine and the collector (taken before segmenterMutex)
+    std::mutex suspendMutex;
+    unsigned suspendReasons = 0;
+    std::atomic<bool> suspended{false};
+
+    // Presence gate (GET /presence): the caption and screen loops read its
+    // settings each pass; voice and the collector's rates are pushed by
+    // ApplyPresence, under suspendMutex like a suspend. presenceSettings and
+    // presenceCollector (the collector once the context task made it) are
+    // guarded by suspendMutex
+    std::unique_ptr<PresenceMonitor> presence;
+    PresenceMonitor::Settings presenceSettings;
+    ContextCollector* presenceCollector = nullptr;
+    PresenceMonitor::Settings PresenceSettings() const;
+    void ApplyPresence(const PresenceMonitor::Settings& settings);
+
+    // Gives whisper states, audio buffers and the ORT arena back once their
+    // engines have been quiet for memory.trim_after_ms (counts in /metrics)
+    std::unique_ptr<MemoryTrimmer> memoryTrimmer;
+
+    // Camera engine /describe and /ask submit to (null while none is running or during a restart)
+    std::mutex describeMutex;
+    CameraVisionEngine* liveCameraEngine = nullptr;
+
+    // Startup tasks
+    void LoadAudioEngine();
+    bool LoadFusionEngine();
+    void LoadCameraEngine();
+    bool LoadSearch();
+    bool LoadTranscriptIndex();
+    bool StartTimeline();
+    bool PublishCaption(std::string text, float latencyMs, bool reused);
+    bool StartCameraBridge();
+    bool StartScreenCaptions();
+    void RunScreenCaptions();
+    bool StartPublisher();
+    bool StartSessionBroker();
+
+    // Stall recovery (Watchdog handlers, on the watchdog's handler thread)
+    bool BeginEngineRestart(const char* engineName, int& restarts, const char* thread);
+    void RestartAudioEngine(const char* thread);
+    void RestartCameraEngine(const char* thread);
+
+    // HTTP
+    void RunHttpServer();
+    void RegisterRoutes();
+    // router->Add with a Metrics middleware labelled "METHOD path", then the admission gate
+    HttpRouter::RouteBuilder AddRoute(HttpRouter::Method method, const char* path, HttpRouter::Handler handler,
+                                      AdmissionControl::Class admissionClass = AdmissionControl::Class::Read);
+    void ApplyAdmissionLimits();
+    // Applies the hot keys among `changed` (POST /config, an experiment window switch)
+    void ApplyConfigChanges(const std::vector<std::string>& changed);
+    void HandleRequest(const HttpRequest& request, HttpResponse& response);
+    // Runs `serve` with the collector once the context task is ready, else ServeStarting
+    void WithContext(HttpResponse& response, const std::function<void(ContextCollector&)>& serve);
+    void ServeStarting(HttpResponse& response);
+    void ServeDashboard(const HttpRequest& request, HttpResponse& response);
+
+    static int64_t NowMs();
+};
@@ -0,0 +1,316 @@
+#include "EtwProcessMonitor.h"
+#include <tdh.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#pragma comment(lib, "advapi32.lib")
+#pragma comment(lib, "tdh.lib")
+
+// Kernel provider classes (MOF); opcodes from the kernel event schema
+static const GUID PROCESS_GUID = { 0x3d6fa8d0, 0xfe05, 0x11d0, { 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c } };
+static const GUID THREAD_GUID = { 0x3d6fa8d1, 0xfe05, 0x11d0, { 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c } };
+static const GUID PERFINFO_GUID = { 0xce1dbfb4, 0x137e, 0x4da6, { 0x87, 0xb0, 0x3f, 0x59, 0xaa, 0x10, 0x2c, 0xbc } };
+static const GUID TCPIP_GUID = { 0x9a280ac0, 0xc8e0, 0x11d1, { 0x84, 0xe2, 0x00, 0xc0, 0x4f, 0xb9, 0x98, 0xa2 } };
+static const GUID UDPIP_GUID = { 0xbf3a50c5, 0xa9c9, 0x4988, { 0xa0, 0x05, 0x2d, 0xf0, 0xb7, 0xc8, 0x0f, 0x80 } };
+
+static const UCHAR OPCODE_START = 1;
+static const UCHAR OPCODE_END = 2;
+static const UCHAR OPCODE_DC_START = 3;            // Rundown of what already runs
+static const UCHAR OPCODE_SAMPLED_PROFILE = 46;
+static const UCHAR OPCODE_SEND_IPV4 = 10;
+static const UCHAR OPCODE_RECV_IPV4 = 11;
+static const UCHAR OPCODE_SEND_IPV6 = 26;
+static const UCHAR OPCODE_RECV_IPV6 = 27;
+
+static uint64_t SteadyNowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Profile samples are only delivered with this privilege held
+static void EnableProfilePrivilege() {
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return;
+    }
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    if (LookupPrivilegeValueW(nullptr, SE_SYSTEM_PROFILE_NAME, &privileges.Privileges[0].Luid)) {
+        AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr);
+    }
+    CloseHandle(token);
+}
+
+EtwProcessMonitor::EtwProcessMonitor()
+    : session(0)
+    , trace(INVALID_PROCESSTRACE_HANDLE)
+    , running(false)
+    , totalSamples(0)
+    , windowStartMs(0)
+{
+    static std::atomic<int> instances{0};
+    sessionName = L"PerceptionEngine Process Trace " + std::to_wstring(GetCurrentProcessId()) + L"." +
+                  std::to_wstring(instances.fetch_add(1));
+}
+
+EtwProcessMonitor::~EtwProcessMonitor() {
+    Stop();
+}
+
+// ============================================================================
+// Session
+// ============================================================================
+
+bool EtwProcessMonitor::Start() {
+    if (running) {
+        return true;
+    }
+    EnableProfilePrivilege();
+
+    properties.assign(sizeof(EVENT_TRACE_PROPERTIES) + (sessionName.size() + 1) * sizeof(wchar_t), 0);
+    auto props = reinterpret_cast<EVENT_TRACE_PROPERTIES*>(properties.data());
+    props->Wnode.BufferSize = static_cast<ULONG>(properties.size());
+    props->Wnode.Flags = WNODE_FLAG_TRACED_GUID;
+    props->Wnode.ClientContext = 1;                 // QueryPerformanceCounter timestamps
+    props->LogFileMode = EVENT_TRACE_REAL_TIME_MODE | EVENT_TRACE_SYSTEM_LOGGER_MODE;
+    props->EnableFlags = EVENT_TRACE_FLAG_PROCESS | EVENT_TRACE_FLAG_THREAD |
+                         EVENT_TRACE_FLAG_PROFILE | EVENT_TRACE_FLAG_NETWORK_TCPIP;
+    props->LoggerNameOffset = sizeof(EVENT_TRACE_PROPERTIES);
+
+    ULONG status = StartTraceW(&session, sessionName.c_str(), props);
+    if (status == ERROR_ALREADY_EXISTS) {
+        // Left over from a run that didn't stop it
+        ControlTraceW(0, sessionName.c_str(), props, EVENT_TRACE_CONTROL_STOP);
+        props->Wnode.BufferSize = static_cast<ULONG>(properties.size());
+        props->LoggerNameOffset = sizeof(EVENT_TRACE_PROPERTIES);
+        status = StartTraceW(&session, sessionName.c_str(), props);
+    }
+    if (status != ERROR_SUCCESS) {
+        std::cerr << "[EtwProcessMonitor] Cannot start kernel trace session (error " << status
+                  << (status == ERROR_ACCESS_DENIED ? ", needs administrator" : "") << ")" << std::endl;
+        session = 0;
+        return false;
+    }
+
+    EVENT_TRACE_LOGFILEW logFile = {};
+    logFile.LoggerName = const_cast<LPWSTR>(sessionName.c_str());
+    logFile.ProcessTraceMode = PROCESS_TRACE_MODE_REAL_TIME | PROCESS_TRACE_MODE_EVENT_RECORD;
+    logFile.EventRecordCallback = &EtwProcessMonitor::OnEvent;
+    logFile.Context = this;
+    trace = OpenTraceW(&logFile);
+    if (trace == INVALID_PROCESSTRACE_HANDLE) {
+        std::cerr << "[EtwProcessMonitor] Cannot open trace (error " << GetLastError() << ")" << std::endl;
+        StopSession();
+        return false;
+    }
+
+    threadProcess.clear();
+    processNames.clear();
+    exitedProcesses.clear();
+    counters.clear();
+    totalSamples = 0;
+    windowStartMs = SteadyNowMs();
+
+    running = true;
+    consumerThread = std::thread(&EtwProcessMonitor::ConsumerThread, this);
+    std::cout << "[EtwProcessMonitor] Tracing process CPU and network usage" << std::endl;
+    return true;
+}
+
+void EtwProcessMonitor::Stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    // Stopping the session makes ProcessTrace return
+    StopSession();
+    if (consumerThread.joinable()) {
+        consumerThread.join();
+    }
+    CloseTrace(trace);
+    trace = INVALID_PROCESSTRACE_HANDLE;
+}
+
+void EtwProcessMonitor::StopSession() {
+    if (session == 0) {
+        return;
+    }
+    auto props = reinterpret_cast<EVENT_TRACE_PROPERTIES*>(properties.data());
+    ControlTraceW(session, nullptr, props, EVENT_TRACE_CONTROL_STOP);
+    session = 0;
+}
+
+void EtwProcessMonitor::ConsumerThread() {
+    ULONG status = ProcessTrace(&trace, 1, nullptr, nullptr);
+    if (status != ERROR_SUCCESS && status != ERROR_CANCELLED) {
+        std::cerr << "[EtwProcessMonitor] ProcessTrace ended (error " << status << ")" << std::endl;
+    }
+}
+
+// ============================================================================
+// Events (consumer thread)
+// ============================================================================
+
+void WINAPI EtwProcessMonitor::OnEvent(PEVENT_RECORD record) {
+    static_cast<EtwProcessMonitor*>(record->UserContext)->HandleEvent(record);
+}
+
+void EtwProcessMonitor::HandleEvent(PEVENT_RECORD record) {
+    const GUID& provider = record->EventHeader.ProviderId;
+    size_t pointerSize = (record->EventHeader.Flags & EVENT_HEADER_FLAG_32_BIT_HEADER) ? 4 : 8;
+
+    if (IsEqualGUID(provider, PERFINFO_GUID)) {
+        HandleProfileEvent(record, pointerSize);
+    } else if (IsEqualGUID(provider, TCPIP_GUID) || IsEqualGUID(provider, UDPIP_GUID)) {
+        HandleNetworkEvent(record);
+    } else if (IsEqualGUID(provider, THREAD_GUID)) {
+        HandleThreadEvent(record);
+    } else if (IsEqualGUID(provider, PROCESS_GUID)) {
+        HandleProcessEvent(record);
+    }
+
+    uint64_t now = SteadyNowMs();
+    if (now - windowStartMs >= static_cast<uint64_t>(WINDOW_MS)) {
+        CloseWindow(now);
+    }
+}
+
+void EtwProcessMonitor::HandleProcessEvent(PEVENT_RECORD record) {
+    UCHAR opcode = record->EventHeader.EventDescriptor.Opcode;
+    if (opcode != OPCODE_START && opcode != OPCODE_DC_START && opcode != OPCODE_END) {
+        return;
+    }
+
+    // The process payload has variable-length members (SID), so decode by name
+    PROPERTY_DATA_DESCRIPTOR descriptor = {};
+    descriptor.ArrayIndex = ULONG_MAX;
+    descriptor.PropertyName = reinterpret_cast<ULONGLONG>(L"ProcessId");
+    DWORD processId = 0;
+    if (TdhGetProperty(record, 0, nullptr, 1, &descriptor, sizeof(processId),
+                       reinterpret_cast<PBYTE>(&processId)) != ERROR_SUCCESS) {
+        return;
+    }
+
+    if (opcode == OPCODE_END) {
+        exitedProcesses.push_back(processId);
+        return;
+    }
+
+    descriptor.PropertyName = reinterpret_cast<ULONGLONG>(L"ImageFileName");
+    ULONG size = 0;
+    if (TdhGetPropertySize(record, 0, nullptr, 1, &descriptor, &size) != ERROR_SUCCESS || size == 0) {
+        return;
+    }
+    std::string name(size, '\0');                   // ANSI, NUL-terminated
+    if (TdhGetProperty(record, 0, nullptr, 1, &descriptor, size,
+                       reinterpret_cast<PBYTE>(&name[0])) == ERROR_SUCCESS) {
+        name.resize(std::strlen(name.c_str()));
+        processNames[processId] = std::move(name);
+    }
+}
+
+void EtwProcessMonitor::HandleThreadEvent(PEVENT_RECORD record) {
+    // Thread payload starts with ProcessId, TThreadId (u32 each)
+    if (record->UserDataLength < 8) {
+        return;
+    }
+    DWORD processId;
+    DWORD threadId;
+    std::memcpy(&processId, record->UserData, 4);
+    std::memcpy(&threadId, static_cast<const char*>(record->UserData) + 4, 4);
+
+    UCHAR opcode = record->EventHeader.EventDescriptor.Opcode;
+    if (opcode == OPCODE_START || opcode == OPCODE_DC_START) {
+        threadProcess[threadId] = processId;
+    } else if (opcode == OPCODE_END) {
+        threadProcess.erase(threadId);
+    }
+}
+
+void EtwProcessMonitor::HandleProfileEvent(PEVENT_RECORD record, size_t pointerSize) {
+    // SampledProfile: InstructionPointer (pointer), ThreadId u32, Count u16
+    if (record->EventHeader.EventDescriptor.Opcode != OPCODE_SAMPLED_PROFILE ||
+        record->UserDataLength < pointerSize + 4) {
+        return;
+    }
+    DWORD threadId;
+    std::memcpy(&threadId, static_cast<const char*>(record->UserData) + pointerSize, 4);
+
+    totalSamples++;
+    auto it = threadProcess.find(threadId);
+    DWORD processId = it != threadProcess.end() ? it->second : 0;     // Unknown threads count as idle
+    counters[processId].samples++;
+}
+
+void EtwProcessMonitor::HandleNetworkEvent(PEVENT_RECORD record) {
+    // Send/Recv payloads start with PID u32, size u32
+    UCHAR opcode = record->EventHeader.EventDescriptor.Opcode;
+    bool send = opcode == OPCODE_SEND_IPV4 || opcode == OPCODE_SEND_IPV6;
+    bool receive = opcode == OPCODE_RECV_IPV4 || opcode == OPCODE_RECV_IPV6;
+    if ((!send && !receive) || record->UserDataLength < 8) {
+        return;
+    }
+    DWORD processId;
+    uint32_t bytes;
+    std::memcpy(&processId, record->UserData, 4);
+    std::memcpy(&bytes, static_cast<const char*>(record->UserData) + 4, 4);
+
+    Counters& process = counters[processId];
+    if (send) {
+        process.bytesSent += bytes;
+    } else {
+        process.bytesReceived += bytes;
+    }
+}
+
+void EtwProcessMonitor::CloseWindow(uint64_t nowMs) {
+    double seconds = (nowMs - windowStartMs) / 1000.0;
+
+    std::vector<ProcessUsage> usage;
+    usage.reserve(counters.size());
+    for (const auto& entry : counters) {
+        if (entry.first == 0) {
+            continue;                               // Idle
+        }
+        ProcessUsage process;
+        process.processId = entry.first;
+        auto name = processNames.find(entry.first);
+        process.name = name != processNames.end() ? name->second : "pid " + std::to_string(entry.first);
+        process.cpuPercent = totalSamples > 0 ? 100.0 * entry.second.samples / totalSamples : 0.0;
+        process.sentBytesPerSecond = entry.second.bytesSent / seconds;
+        process.receivedBytesPerSecond = entry.second.bytesReceived / seconds;
+        usage.push_back(std::move(process));
+    }
+
+    TopProcesses top;
+    auto takeTop = [&](std::vector<ProcessUsage>& out, auto higher, auto active) {
+        size_t count = (std::min)(TOP_COUNT, usage.size());
+        std::partial_sort(usage.begin(), usage.begin() + count, usage.end(), higher);
+        for (size_t index = 0; index < count && active(usage[index]); ++index) {
+            out.push_back(usage[index]);
+        }
+    };
+    takeTop(top.byCpu,
+            [](const ProcessUsage& a, const ProcessUsage& b) { return a.cpuPercent > b.cpuPercent; },
+            [](const ProcessUsage& p) { return p.cpuPercent > 0.0; });
+    takeTop(top.byNetwork,
+            [](const ProcessUsage& a, const ProcessUsage& b) {
+                return a.sentBytesPerSecond + a.receivedBytesPerSecond > b.sentBytesPerSecond + b.receivedBytesPerSecond;
+            },
+            [](const ProcessUsage& p) { return p.sentBytesPerSecond + p.receivedBytesPerSecond > 0.0; });
+    topProcesses.Update([&](TopProcesses& published) {
+        published = top;
+        return true;
+    });
+
+    for (DWORD processId : exitedProcesses) {
+        processNames.erase(processId);
+    }
+    exitedProcesses.clear();
+    counters.clear();
+    totalSamples = 0;
+    windowStartMs = nowMs;
+}
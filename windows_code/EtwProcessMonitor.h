@@ -0,0 +1,110 @@
+#pragma once
+
+#include <windows.h>
+#include <evntrace.h>
+#include <evntcons.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "PublishedState.h"
+
+/**
+ * EtwProcessMonitor - Per-process CPU and network usage from kernel ETW events
+ *
+ * Architecture:
+ *   A private real-time kernel session (system logger mode, so it doesn't
+ *   take the single "NT Kernel Logger") delivers process and thread
+ *   start/end, sampled-profile and TCP/UDP send/receive events to a consumer
+ *   thread. Counters are kept incrementally per process from those events;
+ *   nothing is polled:
+ *     - CPU: each profile sample (one per CPU per millisecond) is charged to
+ *       the process owning the sampled thread, so a process's share of the
+ *       samples is its share of machine CPU time.
+ *     - Network: payload bytes of every TCP/UDP send and receive, by pid.
+ *   Every WINDOW_MS the consumer turns the window's counters into the top
+ *   TOP_COUNT processes by CPU and by network rate and publishes them in a
+ *   PublishedState slot, so readers get the last window with one atomic load.
+ *
+ *   Kernel sessions need administrator rights (and SeSystemProfilePrivilege
+ *   for the profile samples, enabled on Start); Start fails without them.
+ *
+ * Usage:
+ *   EtwProcessMonitor monitor;
+ *   if (monitor.Start()) {
+ *       std::shared_ptr<const EtwProcessMonitor::TopProcesses> top = monitor.GetTopProcesses();
+ *   }
+ */
+class EtwProcessMonitor {
+public:
+    struct ProcessUsage {
+        DWORD processId = 0;
+        std::string name;                           // Image file name, e.g. "chrome.exe"
+        double cpuPercent = 0.0;                    // Of all CPUs
+        double sentBytesPerSecond = 0.0;
+        double receivedBytesPerSecond = 0.0;
+    };
+
+    struct TopProcesses {
+        std::vector<ProcessUsage> byCpu;            // Highest first
+        std::vector<ProcessUsage> byNetwork;        // Highest sent + received first
+    };
+
+    static constexpr int WINDOW_MS = 2000;
+    static constexpr size_t TOP_COUNT = 5;
+
+    EtwProcessMonitor();
+    ~EtwProcessMonitor();
+
+    EtwProcessMonitor(const EtwProcessMonitor&) = delete;
+    EtwProcessMonitor& operator=(const EtwProcessMonitor&) = delete;
+
+    /**
+     * @brief Start the kernel session and the consumer thread
+     * @return false (and logs) if the session can't be started, e.g. not elevated
+     */
+    bool Start();
+    void Stop();
+    bool IsRunning() const { return running.load(); }
+
+    // Last complete window (empty lists until the first one closes)
+    std::shared_ptr<const TopProcesses> GetTopProcesses() const { return topProcesses.Load(); }
+
+private:
+    struct Counters {
+        uint64_t samples = 0;
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+    };
+
+    static void WINAPI OnEvent(PEVENT_RECORD record);
+    void HandleEvent(PEVENT_RECORD record);
+    void HandleProcessEvent(PEVENT_RECORD record);
+    void HandleThreadEvent(PEVENT_RECORD record);
+    void HandleProfileEvent(PEVENT_RECORD record, size_t pointerSize);
+    void HandleNetworkEvent(PEVENT_RECORD record);
+    void CloseWindow(uint64_t nowMs);
+    void ConsumerThread();
+    void StopSession();
+
+    std::wstring sessionName;
+    std::vector<char> properties;                   // EVENT_TRACE_PROPERTIES + session name
+    TRACEHANDLE session;
+    TRACEHANDLE trace;
+    std::thread consumerThread;
+    std::atomic<bool> running;
+
+    // Consumer thread only
+    std::unordered_map<DWORD, DWORD> threadProcess;     // tid -> pid
+    std::unordered_map<DWORD, std::string> processNames;
+    std::vector<DWORD> exitedProcesses;                 // Names dropped when the window closes
+    std::unordered_map<DWORD, Counters> counters;       // This window
+    uint64_t totalSamples;
+    uint64_t windowStartMs;
+
+    PublishedState<TopProcesses> topProcesses;
+};
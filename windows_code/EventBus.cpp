@@ -0,0 +1,328 @@
+#include "EventBus.h"
+#include "Log.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static const char* const TYPE_NAMES[] = {
+    "voice_segment", "transcript", "transcript_partial", "keyword",
+    "caption", "caption_partial", "app_switch", "system_sample", "screen_caption", "screen_text",
+    "transcript_segment"
+};
+static_assert(sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]) == static_cast<size_t>(EventBus::Type::Count),
+              "one name per event type");
+
+const char* EventBus::TypeName(Type type) {
+    return type < Type::Count ? TYPE_NAMES[static_cast<size_t>(type)] : "unknown";
+}
+
+int64_t EventBus::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// ============================================================================
+// Queue
+// ============================================================================
+
+static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t rounded = 2;
+    while (rounded < value) {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+EventBus::Queue::Queue(size_t capacity)
+    : cells(RoundUpToPowerOfTwo(capacity)), mask(cells.size() - 1) {
+    for (size_t index = 0; index < cells.size(); ++index) {
+        cells[index].sequence.store(index, std::memory_order_relaxed);
+    }
+}
+
+bool EventBus::Queue::TryPush(Event& event) {
+    size_t position = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = cells[position & mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (enqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell.event = std::move(event);
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false;       // Full
+        } else {
+            position = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool EventBus::Queue::TryPop(Event& event) {
+    size_t position = dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = cells[position & mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (difference == 0) {
+            if (dequeuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                event = std::move(cell.event);
+                cell.sequence.store(position + mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false;       // Empty
+        } else {
+            position = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t EventBus::Queue::Size() const {
+    size_t head = dequeuePos.load(std::memory_order_seq_cst);
+    size_t tail = enqueuePos.load(std::memory_order_seq_cst);
+    return tail > head ? tail - head : 0;
+}
+
+// ============================================================================
+// Subscribers
+// ============================================================================
+
+EventBus::Subscriber::Subscriber(const SubscriberOptions& options, BatchHandler handler)
+    : options(options), handler(std::move(handler)), queue(options.capacity) {
+    if (this->options.maxBatch == 0) {
+        this->options.maxBatch = 1;
+    }
+}
+
+EventBus::EventBus() {
+    for (auto& count : published) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    for (auto& slot : slots) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+EventBus::~EventBus() {
+    Stop();
+}
+
+int EventBus::Subscribe(const SubscriberOptions& options, BatchHandler handler) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    for (size_t index = 0; index < MAX_SUBSCRIBERS; ++index) {
+        if (slots[index].load(std::memory_order_relaxed)) {
+            continue;
+        }
+        auto subscriber = std::make_unique<Subscriber>(options, std::move(handler));
+        Subscriber* raw = subscriber.get();
+        subscribers.push_back(std::move(subscriber));
+        slots[index].store(raw, std::memory_order_release);
+        LOG_DEBUG("EventBus", "Subscribed " << options.name << " (capacity " << raw->queue.Capacity()
+                  << ", batch " << raw->options.maxBatch << ")");
+        return static_cast<int>(index);
+    }
+    LOG_ERROR("EventBus", "No subscriber slot left for " << options.name);
+    return -1;
+}
+
+void EventBus::Unsubscribe(int id) {
+    if (id < 0 || id >= static_cast<int>(MAX_SUBSCRIBERS)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    Subscriber* subscriber = slots[id].exchange(nullptr, std::memory_order_acq_rel);
+    if (!subscriber) {
+        return;
+    }
+    subscriber->subscribed.store(false);
+
+    // Publishers that loaded the slot before it was cleared may still push
+    // and schedule; wait for the queue to run dry with no drain pending
+    {
+        std::unique_lock<std::mutex> idleLock(subscriber->idleMutex);
+        subscriber->idleCv.wait(idleLock, [subscriber]() {
+            return !subscriber->scheduled.load() && subscriber->queue.Size() == 0;
+        });
+    }
+    std::lock_guard<std::mutex> deliverLock(subscriber->deliverMutex);
+    subscriber->active = false;
+}
+
+void EventBus::Stop() {
+    running.store(false, std::memory_order_release);
+    for (size_t index = 0; index < MAX_SUBSCRIBERS; ++index) {
+        Unsubscribe(static_cast<int>(index));
+    }
+}
+
+// ============================================================================
+// Publishing
+// ============================================================================
+
+bool EventBus::Publish(Payload payload) {
+    if (!running.load(std::memory_order_acquire)) {
+        return false;
+    }
+    Event event;
+    event.sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+    event.timeMs = NowMs();
+    event.clockUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    event.payload = std::move(payload);
+    uint32_t bit = Mask(event.GetType());
+    published[static_cast<size_t>(event.GetType())].fetch_add(1, std::memory_order_relaxed);
+
+    // Copies for all but the last subscriber of the type, which takes the original
+    Subscriber* pending = nullptr;
+    for (auto& slot : slots) {
+        Subscriber* subscriber = slot.load(std::memory_order_acquire);
+        if (!subscriber || (subscriber->options.types != 0 && !(subscriber->options.types & bit))) {
+            continue;
+        }
+        if (pending) {
+            Offer(*pending, Event(event));
+        }
+        pending = subscriber;
+    }
+    if (pending) {
+        Offer(*pending, std::move(event));
+    }
+    return true;
+}
+
+void EventBus::Offer(Subscriber& subscriber, Event&& event) {
+    bool pushed = subscriber.queue.TryPush(event);
+    if (!pushed) {
+        switch (subscriber.options.overflow) {
+            case Overflow::DropNewest:
+                break;
+            case Overflow::DropOldest: {
+                // Races the drain for the head; a few rounds settle it
+                Event oldest;
+                for (int attempt = 0; attempt < 4 && !pushed; ++attempt) {
+                    if (subscriber.queue.TryPop(oldest)) {
+                        subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    pushed = subscriber.queue.TryPush(event);
+                }
+                break;
+            }
+            case Overflow::Block: {
+                // A full queue always has its drain scheduled: it makes room
+                auto deadline = std::chrono::steady_clock::now() +
+                                std::chrono::milliseconds(subscriber.options.blockTimeoutMs);
+                while (!pushed && subscriber.subscribed.load(std::memory_order_relaxed) &&
+                       std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    pushed = subscriber.queue.TryPush(event);
+                }
+                break;
+            }
+        }
+    }
+    if (!pushed) {
+        subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Pairs with the fence in Drain: either the drain sees the event or we see it finished
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!subscriber.scheduled.exchange(true)) {
+        Schedule(subscriber);
+    }
+}
+
+void EventBus::Schedule(Subscriber& subscriber) {
+    Subscriber* target = &subscriber;
+    TaskScheduler::Instance().Submit(subscriber.options.priority, subscriber.options.name,
+                                     [target]() { Drain(*target); });
+}
+
+void EventBus::Drain(Subscriber& subscriber) {
+    // Per worker thread: a drain only allocates when a batch outgrows the last one
+    thread_local std::vector<Event> batch;
+    Event event;
+
+    for (int round = 0; round < MAX_BATCHES_PER_DRAIN; ++round) {
+        batch.clear();
+        while (batch.size() < subscriber.options.maxBatch && subscriber.queue.TryPop(event)) {
+            batch.push_back(std::move(event));
+        }
+        if (batch.empty()) {
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(subscriber.deliverMutex);
+            if (!subscriber.active) {
+                subscriber.dropped.fetch_add(batch.size(), std::memory_order_relaxed);
+                continue;
+            }
+            subscriber.lagMs.store(NowMs() - batch.front().timeMs, std::memory_order_relaxed);
+            subscriber.handler(batch.data(), batch.size());
+        }
+        subscriber.delivered.fetch_add(batch.size(), std::memory_order_relaxed);
+        subscriber.batches.fetch_add(1, std::memory_order_relaxed);
+    }
+    batch.clear();
+
+    // Hand back; events pushed meanwhile either saw us scheduled (and rely
+    // on this re-check) or will schedule a drain themselves
+    subscriber.scheduled.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (subscriber.queue.Size() > 0 && !subscriber.scheduled.exchange(true)) {
+        Schedule(subscriber);
+        return;
+    }
+    { std::lock_guard<std::mutex> lock(subscriber.idleMutex); }
+    subscriber.idleCv.notify_all();
+}
+
+// ============================================================================
+// Metrics
+// ============================================================================
+
+std::string EventBus::FormatPrometheus() const {
+    std::string out;
+    out.reserve(2048);
+    char line[192];
+
+    out += "# HELP perception_bus_events_total Events published on the event bus, per type\n";
+    out += "# TYPE perception_bus_events_total counter\n";
+    for (size_t index = 0; index < static_cast<size_t>(Type::Count); ++index) {
+        std::snprintf(line, sizeof(line), "perception_bus_events_total{type=\"%s\"} %llu\n", TYPE_NAMES[index],
+                      static_cast<unsigned long long>(published[index].load(std::memory_order_relaxed)));
+        out += line;
+    }
+
+    std::string depth = "# HELP perception_bus_queue_depth Events waiting for each subscriber\n"
+                        "# TYPE perception_bus_queue_depth gauge\n";
+    std::string delivered = "# HELP perception_bus_delivered_total Events handed to each subscriber\n"
+                            "# TYPE perception_bus_delivered_total counter\n";
+    std::string dropped = "# HELP perception_bus_dropped_total Events a full subscriber queue discarded\n"
+                          "# TYPE perception_bus_dropped_total counter\n";
+    std::string lag = "# HELP perception_bus_lag_seconds Publish-to-delivery time of each subscriber's last batch\n"
+                      "# TYPE perception_bus_lag_seconds gauge\n";
+    for (const auto& slot : slots) {
+        const Subscriber* subscriber = slot.load(std::memory_order_acquire);
+        if (!subscriber) {
+            continue;
+        }
+        const char* name = subscriber->options.name;
+        std::snprintf(line, sizeof(line), "perception_bus_queue_depth{subscriber=\"%s\"} %zu\n",
+                      name, subscriber->queue.Size());
+        depth += line;
+        std::snprintf(line, sizeof(line), "perception_bus_delivered_total{subscriber=\"%s\"} %llu\n", name,
+                      static_cast<unsigned long long>(subscriber->delivered.load(std::memory_order_relaxed)));
+        delivered += line;
+        std::snprintf(line, sizeof(line), "perception_bus_dropped_total{subscriber=\"%s\"} %llu\n", name,
+                      static_cast<unsigned long long>(subscriber->dropped.load(std::memory_order_relaxed)));
+        dropped += line;
+        std::snprintf(line, sizeof(line), "perception_bus_lag_seconds{subscriber=\"%s\"} %.3f\n",
+                      name, subscriber->lagMs.load(std::memory_order_relaxed) / 1000.0);
+        lag += line;
+    }
+    return out + depth + delivered + dropped + lag;
+}
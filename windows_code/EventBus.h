@@ -0,0 +1,269 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <variant>
+#include <vector>
+#include "TaskScheduler.h"
+
+// Event payloads (EventBus::Payload); outside the class so the variant sees them complete
+namespace BusEvents {
+
+// A whisper segment queued for transcription (VAD closed an utterance)
+struct VoiceSegment {
+    uint64_t traceId = 0;           // UtteranceTracer id; 0 for system audio
+    uint32_t durationMs = 0;
+    float vadConfidence = 1.0f;
+    bool systemAudio = false;
+};
+struct Transcript {
+    std::string text;
+    float latencyMs = 0.0f;
+    int speaker = -1;               // SpeakerTracker id; -1 unknown
+    bool systemAudio = false;
+    uint64_t traceId = 0;           // UtteranceTracer id; 0 for system audio
+};
+// The in-progress hypothesis; empty once the utterance is final
+struct TranscriptPartial {
+    std::string text;
+};
+// A segment of a long utterance, decoded ahead of its Transcript
+struct TranscriptSegment {
+    uint64_t traceId = 0;           // UtteranceTracer id of the utterance
+    int index = 0;                  // 0 starts a new utterance
+    std::string text;
+    int64_t startMs = 0;            // Within the utterance's audio
+    int64_t endMs = 0;
+};
+struct Keyword {
+    std::string keyword;
+    float score = 0.0f;
+};
+struct Caption {
+    std::string text;
+    float latencyMs = 0.0f;
+    bool reused = false;            // Unchanged scene: the previous caption again
+};
+struct CaptionPartial {
+    std::string text;
+};
+// What the foreground window shows (ScreenCapture's changed region, captioned)
+struct ScreenCaption {
+    std::string text;
+    std::string window;             // Title of the captured window
+    float latencyMs = 0.0f;
+    float changedShare = 1.0f;      // Fraction of the window that changed and was captioned
+};
+// The foreground window's text (ScreenText: OCR of what changed, the rest carried)
+struct ScreenText {
+    std::string text;
+    std::string window;
+    float latencyMs = 0.0f;
+    int rowsRecognized = 0;         // Image rows sent to OCR for this update
+    int rows = 0;
+};
+struct AppSwitch {
+    std::string app;
+    std::string category;
+};
+struct SystemSample {
+    double cpuUsage = -1.0;         // Percent; negative when unavailable
+    double memoryUsage = -1.0;
+    int battery = 100;
+};
+
+}  // namespace BusEvents
+
+/**
+ * EventBus - Typed publish/subscribe between the perception engines
+ *
+ * Engine results used to reach their consumers through a different path
+ * each: transcription callbacks that called into the collector on the
+ * whisper worker, the caption loop calling UpdateCameraContext itself,
+ * app switches noticed inside the collector's probe. Producers now
+ * Publish() one typed event and every subscriber that asked for its type
+ * gets a copy:
+ *
+ *   producers (whisper workers, processing thread, caption loop, sampler)
+ *       -> Publish()              lock-free: one bounded MPMC queue per subscriber
+ *       -> drain task             on the shared TaskScheduler, at most one per
+ *                                 subscriber at a time; up to maxBatch events per
+ *                                 handler call, MAX_BATCHES_PER_DRAIN calls before
+ *                                 it gives the worker back
+ * A subscriber with nothing queued costs no thread.
+ *
+ * Each subscriber picks what happens when its queue is full, so a slow
+ * consumer only ever costs itself:
+ *   DropNewest  the new event is discarded (statistics)
+ *   DropOldest  the oldest queued event makes room (latest-value consumers)
+ *   Block       the producer retries for up to blockTimeoutMs, then drops
+ *               (consumers that must not lose events; never from audio capture)
+ * Drops are counted per subscriber and reported on /metrics.
+ *
+ * Delivery is in publish order per producer thread; events from different
+ * producers interleave in the order their pushes landed.
+ *
+ * Usage:
+ *   EventBus bus;
+ *   EventBus::SubscriberOptions options;
+ *   options.name = "context";
+ *   options.types = EventBus::Mask(EventBus::Type::Transcript) | EventBus::Mask(EventBus::Type::Caption);
+ *   bus.Subscribe(options, [&](const EventBus::Event* events, size_t count) { ... });
+ *   bus.Publish(EventBus::Caption{"a person at a desk", 412.0f, false});
+ *   bus.Stop();
+ */
+class EventBus {
+public:
+    using VoiceSegment = BusEvents::VoiceSegment;
+    using Transcript = BusEvents::Transcript;
+    using TranscriptPartial = BusEvents::TranscriptPartial;
+    using Keyword = BusEvents::Keyword;
+    using Caption = BusEvents::Caption;
+    using CaptionPartial = BusEvents::CaptionPartial;
+    using ScreenCaption = BusEvents::ScreenCaption;
+    using ScreenText = BusEvents::ScreenText;
+    using AppSwitch = BusEvents::AppSwitch;
+    using SystemSample = BusEvents::SystemSample;
+    using TranscriptSegment = BusEvents::TranscriptSegment;
+
+    // Alternative order of Payload
+    enum class Type : uint8_t {
+        VoiceSegment, Transcript, TranscriptPartial, Keyword,
+        Caption, CaptionPartial, AppSwitch, SystemSample, ScreenCaption, ScreenText, TranscriptSegment,
+        Count
+    };
+    using Payload = std::variant<VoiceSegment, Transcript, TranscriptPartial, Keyword,
+                                 Caption, CaptionPartial, AppSwitch, SystemSample, ScreenCaption, ScreenText,
+                                 TranscriptSegment>;
+
+    struct Event {
+        uint64_t sequence = 0;          // Bus-wide publish order
+        int64_t timeMs = 0;             // Unix epoch milliseconds
+        int64_t clockUs = 0;            // Steady clock (QPC) microseconds, UtteranceTracer's timeline
+        Payload payload;
+
+        Type GetType() const { return static_cast<Type>(payload.index()); }
+        template <typename T> const T* As() const { return std::get_if<T>(&payload); }
+    };
+
+    enum class Overflow { DropNewest, DropOldest, Block };
+
+    struct SubscriberOptions {
+        const char* name = "subscriber";    // String literal: metrics label and heartbeat name
+        uint32_t types = 0;                 // Mask() bits; 0 takes everything
+        Overflow overflow = Overflow::DropOldest;
+        size_t capacity = 256;              // Rounded up to a power of two
+        size_t maxBatch = 32;
+        int blockTimeoutMs = 50;            // Overflow::Block only
+        TaskScheduler::Priority priority = TaskScheduler::Priority::Interactive;
+    };
+
+    // Called on a task worker with 1..maxBatch events, oldest first; never
+    // concurrently for one subscriber
+    using BatchHandler = std::function<void(const Event* events, size_t count)>;
+
+    static constexpr size_t MAX_SUBSCRIBERS = 16;
+
+    static constexpr uint32_t Mask(Type type) { return 1u << static_cast<uint32_t>(type); }
+    static const char* TypeName(Type type);
+
+    EventBus();
+    ~EventBus();
+
+    EventBus(const EventBus&) = delete;
+    EventBus& operator=(const EventBus&) = delete;
+
+    /**
+     * @brief Add a subscriber
+     * @return Its id for Unsubscribe, or -1 when all MAX_SUBSCRIBERS slots are taken
+     */
+    int Subscribe(const SubscriberOptions& options, BatchHandler handler);
+
+    /**
+     * @brief Deliver what is queued; the handler is never called once this returns
+     */
+    void Unsubscribe(int id);
+
+    /**
+     * @brief Hand the event to every subscriber of its type; never blocks unless one chose Overflow::Block
+     * @return false once stopped (the event is dropped)
+     */
+    bool Publish(Payload payload);
+
+    /**
+     * @brief Refuse new events and unsubscribe everyone (delivering what is queued)
+     */
+    void Stop();
+
+    /**
+     * @brief Per-type publish counts and per-subscriber depth, deliveries and drops (Prometheus text)
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    // Bounded MPMC ring (Vyukov): each cell's sequence says whose turn it is
+    class Queue {
+    public:
+        explicit Queue(size_t capacity);
+        bool TryPush(Event& event);     // Moves from event on success
+        bool TryPop(Event& event);
+        size_t Size() const;
+        size_t Capacity() const { return cells.size(); }
+
+    private:
+        struct alignas(64) Cell {
+            std::atomic<size_t> sequence{0};
+            Event event;
+        };
+        std::vector<Cell> cells;
+        size_t mask;
+        alignas(64) std::atomic<size_t> enqueuePos{0};
+        alignas(64) std::atomic<size_t> dequeuePos{0};
+    };
+
+    struct Subscriber {
+        Subscriber(const SubscriberOptions& options, BatchHandler handler);
+
+        SubscriberOptions options;
+        BatchHandler handler;
+        Queue queue;
+        std::atomic<bool> subscribed{true};
+        std::atomic<bool> scheduled{false};     // A drain task is queued or running
+
+        // Unsubscribe waits for the last drain, then clears `active` so a
+        // straggling publisher's drain discards instead of calling the handler
+        std::mutex deliverMutex;
+        bool active = true;                     // Guarded by deliverMutex
+        std::mutex idleMutex;
+        std::condition_variable idleCv;         // A drain finished
+
+        std::atomic<uint64_t> delivered{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<int64_t> lagMs{0};          // Publish to handler, the last batch's oldest event
+    };
+
+    static constexpr int MAX_BATCHES_PER_DRAIN = 4;
+
+    static void Offer(Subscriber& subscriber, Event&& event);
+    static void Schedule(Subscriber& subscriber);
+    static void Drain(Subscriber& subscriber);
+    static int64_t NowMs();
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> nextSequence{1};
+    std::atomic<uint64_t> published[static_cast<size_t>(Type::Count)];
+
+    // Slots are read without a lock by Publish; a subscriber object lives
+    // until the bus is destroyed, so a publisher that loaded its pointer just
+    // before Unsubscribe pushes into a queue nobody reads rather than freed memory
+    std::atomic<Subscriber*> slots[MAX_SUBSCRIBERS];
+    mutable std::mutex subscribersMutex;                // Subscribe / Unsubscribe / Stop
+    std::vector<std::unique_ptr<Subscriber>> subscribers;
+};
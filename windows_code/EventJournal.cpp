@@ -0,0 +1,248 @@
+#include "EventJournal.h"
+#include "Deflate.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+EventJournal::EventJournal(const std::string& directory)
+    : directory(directory)
+    , file(INVALID_HANDLE_VALUE)
+    , fileBytes(0)
+    , running(false)
+    , droppedRecords(0)
+{
+}
+
+EventJournal::~EventJournal() {
+    Close();
+}
+
+std::filesystem::path EventJournal::FilePath(int index) const {
+    if (index == 0) {
+        return directory / "events.journal";
+    }
+    return directory / ("events." + std::to_string(index) + ".journal");
+}
+
+// ============================================================================
+// Writing
+// ============================================================================
+
+bool EventJournal::Open() {
+    Close();
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        std::cerr << "[EventJournal] Cannot create " << directory.string() << ": " << ec.message() << std::endl;
+        return false;
+    }
+    if (!OpenCurrentFile()) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        running = true;
+    }
+    writerThread = std::thread(&EventJournal::WriterThread, this);
+    std::cout << "[EventJournal] Appending to " << FilePath(0).string() << " (" << fileBytes << " bytes)" << std::endl;
+    return true;
+}
+
+bool EventJournal::OpenCurrentFile() {
+    // Cut a torn tail off so new records follow the last intact one
+    uint64_t validBytes = 0;
+    std::error_code ec;
+    std::filesystem::path path = FilePath(0);
+    if (std::filesystem::file_size(path, ec) > 0 && !ec) {
+        MappedFile existing;
+        if (existing.Open(path.wstring())) {
+            validBytes = ValidLength(static_cast<const char*>(existing.Data()), existing.Size());
+        }
+    }
+
+    file = CreateFileW(path.wstring().c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "[EventJournal] Cannot open " << path.string() << " (error " << GetLastError() << ")" << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER offset;
+    offset.QuadPart = static_cast<LONGLONG>(validBytes);
+    if (!SetFilePointerEx(file, offset, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+        std::cerr << "[EventJournal] Cannot truncate " << path.string() << " (error " << GetLastError() << ")" << std::endl;
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    fileBytes = validBytes;
+    return true;
+}
+
+void EventJournal::Close() {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        running = false;
+    }
+    pendingReady.notify_all();
+    if (writerThread.joinable()) {
+        writerThread.join();
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+}
+
+void EventJournal::Append(Kind kind, int64_t timeMs, std::string_view text) {
+    text = text.substr(0, MAX_RECORD_TEXT);
+
+    char header[HEADER_BYTES];
+    uint32_t length = static_cast<uint32_t>(text.size());
+    std::memcpy(header, &length, 4);
+    header[8] = static_cast<char>(kind);
+    std::memcpy(header + 9, &timeMs, 8);
+
+    // CRC over kind, time and text, computed outside the lock
+    std::string covered(header + 8, HEADER_BYTES - 8);
+    covered.append(text.data(), text.size());
+    uint32_t crc = Deflate::Crc32(covered);
+    std::memcpy(header + 4, &crc, 4);
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (!running || pending.size() + HEADER_BYTES + text.size() > MAX_PENDING_BYTES) {
+            droppedRecords++;
+            return;
+        }
+        pending.append(header, 8);
+        pending.append(covered);
+        wake = pending.size() >= MAX_BATCH_BYTES;
+    }
+    if (wake) {
+        pendingReady.notify_one();
+    }
+}
+
+void EventJournal::WriterThread() {
+    std::string batch;
+
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            pendingReady.wait_for(lock, std::chrono::milliseconds(GROUP_COMMIT_MS), [&]() {
+                return !running || pending.size() >= MAX_BATCH_BYTES;
+            });
+            stopping = !running;
+            batch.swap(pending);        // Producers refill the (cleared) old batch buffer
+        }
+
+        if (!batch.empty()) {
+            if (fileBytes + batch.size() > MAX_FILE_BYTES && fileBytes > 0) {
+                Rotate();
+            }
+            if (!WriteBatch(batch)) {
+                droppedRecords++;
+            }
+            batch.clear();
+        }
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+bool EventJournal::WriteBatch(const std::string& batch) {
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD written = 0;
+    if (!WriteFile(file, batch.data(), static_cast<DWORD>(batch.size()), &written, nullptr) ||
+        written != batch.size()) {
+        std::cerr << "[EventJournal] Write failed (error " << GetLastError() << ")" << std::endl;
+        return false;
+    }
+    fileBytes += written;
+
+    // Group commit: one flush for every record in the batch
+    FlushFileBuffers(file);
+    return true;
+}
+
+void EventJournal::Rotate() {
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+
+    std::error_code ec;
+    std::filesystem::remove(FilePath(MAX_ROTATED_FILES), ec);
+    for (int index = MAX_ROTATED_FILES - 1; index >= 0; --index) {
+        if (std::filesystem::exists(FilePath(index), ec)) {
+            std::filesystem::rename(FilePath(index), FilePath(index + 1), ec);
+        }
+    }
+
+    if (!OpenCurrentFile()) {
+        std::cerr << "[EventJournal] Rotation failed; records are dropped until restart" << std::endl;
+    }
+}
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+size_t EventJournal::ValidLength(const char* data, size_t size) {
+    size_t offset = 0;
+    while (size - offset >= HEADER_BYTES) {
+        uint32_t length;
+        uint32_t crc;
+        std::memcpy(&length, data + offset, 4);
+        std::memcpy(&crc, data + offset + 4, 4);
+        if (length > MAX_RECORD_TEXT || size - offset - HEADER_BYTES < length ||
+            Deflate::Crc32(std::string_view(data + offset + 8, HEADER_BYTES - 8 + length)) != crc) {
+            break;
+        }
+        offset += HEADER_BYTES + length;
+    }
+    return offset;
+}
+
+size_t EventJournal::Replay(const std::function<void(const Record&)>& visit) const {
+    size_t visited = 0;
+    for (int index = MAX_ROTATED_FILES; index >= 0; --index) {
+        std::error_code ec;
+        std::filesystem::path path = FilePath(index);
+        if (std::filesystem::file_size(path, ec) == 0 || ec) {
+            continue;
+        }
+
+        MappedFile mapped;
+        if (!mapped.Open(path.wstring())) {
+            continue;
+        }
+        const char* data = static_cast<const char*>(mapped.Data());
+        size_t valid = ValidLength(data, mapped.Size());
+
+        for (size_t offset = 0; offset < valid;) {
+            uint32_t length;
+            Record record;
+            std::memcpy(&length, data + offset, 4);
+            record.kind = static_cast<Kind>(data[offset + 8]);
+            std::memcpy(&record.timeMs, data + offset + 9, 8);
+            record.text = std::string_view(data + offset + HEADER_BYTES, length);
+            visit(record);
+            visited++;
+            offset += HEADER_BYTES + length;
+        }
+        if (valid < mapped.Size()) {
+            std::cerr << "[EventJournal] " << path.string() << ": ignored " << (mapped.Size() - valid)
+                      << " bytes after the last intact record" << std::endl;
+        }
+    }
+    return visited;
+}
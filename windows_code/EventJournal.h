@@ -0,0 +1,109 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * EventJournal - Append-only binary log of context events on disk
+ *
+ * Architecture:
+ *   Append() only encodes the record into an in-memory batch and returns; a
+ *   writer thread takes the whole batch every GROUP_COMMIT_MS (sooner once it
+ *   reaches MAX_BATCH_BYTES) and commits it with one WriteFile and one
+ *   FlushFileBuffers, so producers never wait on the disk and a burst costs
+ *   one flush. If the disk falls so far behind that MAX_PENDING_BYTES are
+ *   queued, new records are dropped (and counted) rather than blocking.
+ *
+ *   Records are [length u32][crc32 u32][kind u8][timeMs i64][text], little
+ *   endian; the CRC covers everything after itself, so a torn write at the
+ *   tail is detected on replay and cut off when the file is reopened.
+ *
+ *   The current file is <directory>/events.journal. Once it passes
+ *   MAX_FILE_BYTES it becomes events.1.journal, older files shift up, and
+ *   anything past MAX_ROTATED_FILES is deleted, bounding disk use.
+ *
+ * Replay maps each file read-only (MappedFile) and hands out records whose
+ * text points straight into the mapping: no parsing and no copies, oldest
+ * file first.
+ *
+ * Usage:
+ *   EventJournal journal("journal");
+ *   journal.Replay([&](const EventJournal::Record& record) { ... });
+ *   journal.Open();
+ *   journal.Append(EventJournal::Kind::Voice, nowMs, text);
+ */
+class EventJournal {
+public:
+    enum class Kind : uint8_t { Voice = 1, Camera = 2, AppSwitch = 3 };
+
+    struct Record {
+        Kind kind;
+        int64_t timeMs;                 // Unix epoch milliseconds
+        std::string_view text;          // Valid only during the Replay callback
+    };
+
+    static constexpr size_t HEADER_BYTES = 17;
+    static constexpr size_t MAX_RECORD_TEXT = 64 * 1024;
+    static constexpr uint64_t MAX_FILE_BYTES = 8 * 1024 * 1024;
+    static constexpr int MAX_ROTATED_FILES = 4;
+    static constexpr int GROUP_COMMIT_MS = 200;
+    static constexpr size_t MAX_BATCH_BYTES = 256 * 1024;
+    static constexpr size_t MAX_PENDING_BYTES = 4 * 1024 * 1024;
+
+    explicit EventJournal(const std::string& directory);
+    ~EventJournal();
+
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    /**
+     * @brief Open the current file for appending and start the writer thread
+     * @return false (and logs) if the directory or file can't be opened
+     */
+    bool Open();
+
+    // Commit what is queued and stop the writer thread
+    void Close();
+
+    // Queue one record (text is truncated to MAX_RECORD_TEXT); never blocks on I/O
+    void Append(Kind kind, int64_t timeMs, std::string_view text);
+
+    /**
+     * @brief Visit every intact record, oldest first (call before Open)
+     * @return Number of records visited
+     */
+    size_t Replay(const std::function<void(const Record&)>& visit) const;
+
+    uint64_t GetDroppedRecords() const { return droppedRecords.load(); }
+
+private:
+    std::filesystem::path FilePath(int index) const;    // 0 = current file
+
+    // Byte length of the intact records at the start of the data
+    static size_t ValidLength(const char* data, size_t size);
+
+    bool OpenCurrentFile();
+    void Rotate();
+    void WriterThread();
+    bool WriteBatch(const std::string& batch);
+
+    std::filesystem::path directory;
+    HANDLE file;
+    uint64_t fileBytes;
+
+    std::mutex pendingMutex;
+    std::condition_variable pendingReady;
+    std::string pending;                // Encoded records not yet handed to the writer
+    bool running;                       // Guarded by pendingMutex
+    std::thread writerThread;
+    std::atomic<uint64_t> droppedRecords;
+};
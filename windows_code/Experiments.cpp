@@ -0,0 +1,473 @@
+#include "Experiments.h"
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include "CpuSampler.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include "RuntimeConfig.h"
+#include "Trace.h"
+
+namespace {
+
+const size_t STAGE_COUNT = static_cast<size_t>(PipelineLatency::Stage::Count);
+const double QUANTILES[] = { 0.5, 0.9, 0.99 };
+const struct { const char* key; double quantile; } QUANTILE_CHANGES[] = { { "p50Percent", 0.5 }, { "p90Percent", 0.9 } };
+
+int64_t EpochMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t SteadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Names go into Prometheus labels and JSON unescaped
+bool IsValidName(std::string_view name) {
+    if (name.empty() || name.size() > 64) {
+        return false;
+    }
+    for (char ch : name) {
+        bool allowed = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+                       ch == '_' || ch == '-' || ch == '.';
+        if (!allowed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* AssignmentName(Experiments::Assignment assignment) {
+    switch (assignment) {
+        case Experiments::Assignment::Machine: return "machine";
+        case Experiments::Assignment::Window: return "window";
+        default: return "none";
+    }
+}
+
+// Percent change of `value` from `baseline`; NaN (null in JSON) without both
+double PercentChange(double value, double baseline) {
+    if (!(baseline > 0.0) || value < 0.0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return (value - baseline) / baseline * 100.0;
+}
+
+}  // namespace
+
+Experiments& Experiments::Instance() {
+    static Experiments instance;
+    return instance;
+}
+
+Experiments::Experiments()
+    : profileCount(1)
+    , assignment(Assignment::None)
+    , windowMs(int64_t(DEFAULT_WINDOW_MINUTES) * 60 * 1000)
+    , machineHash(0)
+    , config(nullptr)
+    , active(0)
+    , running(false)
+{
+    profiles[0].name = "default";
+    profiles[0].latency = new LatencyHistogram[STAGE_COUNT];
+}
+
+Experiments::~Experiments() {
+    Stop();
+}
+
+std::string Experiments::DefaultPath() {
+    char buffer[MAX_PATH];
+    DWORD length = GetEnvironmentVariableA(FILE_VARIABLE, buffer, sizeof(buffer));
+    return length > 0 && length < sizeof(buffer) ? std::string(buffer, length) : DEFAULT_FILE;
+}
+
+std::string Experiments::ComputerName() {
+    char name[MAX_COMPUTERNAME_LENGTH + 1] = {};
+    DWORD size = sizeof(name);
+    return GetComputerNameA(name, &size) ? std::string(name, size) : std::string();
+}
+
+// FNV-1a: stable across runs and builds, unlike std::hash
+uint32_t Experiments::NameHash(const std::string& name) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char ch : name) {
+        hash = (hash ^ ch) * 16777619u;
+    }
+    return hash;
+}
+
+// ============================================================================
+// Assignment
+// ============================================================================
+
+bool Experiments::Load(const std::string& path, RuntimeConfig& runtimeConfig, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        LOG_DEBUG("Experiments", "No " << path << "; no experiment profiles");
+        return true;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+    size_t errorOffset = 0;
+    JsonValue document = JsonReader::Parse(text, &errorOffset);
+    if (!document.IsObject()) {
+        error = document.IsValid() ? "expected an object" : "invalid JSON at offset " + std::to_string(errorOffset);
+        return false;
+    }
+
+    std::string scratch;
+    std::string_view assign = document["assign"].AsString(scratch, "machine");
+    Assignment mode;
+    if (assign == "machine") {
+        mode = Assignment::Machine;
+    } else if (assign == "window") {
+        mode = Assignment::Window;
+    } else {
+        error = "assign: machine or window";
+        return false;
+    }
+    int64_t minutes = document["window_minutes"].AsInt(DEFAULT_WINDOW_MINUTES);
+    if (minutes < 1 || minutes > 7 * 24 * 60) {
+        error = "window_minutes: 1-10080";
+        return false;
+    }
+
+    // Profiles in file order; the first is the baseline
+    std::vector<std::pair<std::string, std::string>> loaded;
+    JsonValue list = document["profiles"];
+    size_t cursor = 0;
+    JsonValue overlay;
+    std::string_view name;
+    while (list.Next(cursor, overlay, &name)) {
+        std::string key(name);
+        if (!IsValidName(key)) {
+            error = "profiles: names of letters, digits, '_', '-' and '.' (\"" + key + "\")";
+            return false;
+        }
+        if (!overlay.IsObject()) {
+            error = "profiles." + key + ": expected an object";
+            return false;
+        }
+        // Window profiles switch without a restart, so they can only vary hot keys
+        if (!runtimeConfig.CheckProfile(overlay.Raw(), mode == Assignment::Window, error)) {
+            error = "profiles." + key + ": " + error;
+            return false;
+        }
+        loaded.emplace_back(std::move(key), std::string(overlay.Raw()));
+    }
+    if (loaded.empty() || loaded.size() > MAX_PROFILES) {
+        error = "profiles: an object of 1-" + std::to_string(MAX_PROFILES) + " profiles";
+        return false;
+    }
+
+    std::string computer = ComputerName();
+    uint32_t hash = NameHash(computer);
+    uint32_t index = hash % static_cast<uint32_t>(loaded.size());
+    std::string_view pinned = document["machines"][computer].AsString(scratch);
+    if (mode == Assignment::Machine && !pinned.empty()) {
+        auto match = std::find_if(loaded.begin(), loaded.end(),
+                                  [pinned](const auto& profile) { return profile.first == pinned; });
+        if (match == loaded.end()) {
+            error = "machines." + computer + ": no profile " + std::string(pinned);
+            return false;
+        }
+        index = static_cast<uint32_t>(match - loaded.begin());
+    }
+
+    if (mode == Assignment::Window) {
+        index = WindowProfile(EpochMs(), minutes * 60 * 1000, hash, loaded.size());
+    }
+    if (!runtimeConfig.SetProfile(loaded[index].second, true, error)) {
+        error = "profiles." + loaded[index].first + ": " + error;
+        return false;
+    }
+
+    // Profile 0 keeps the histograms "default" had (nothing recorded yet)
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        profiles[i].name = std::move(loaded[i].first);
+        profiles[i].overlay = std::move(loaded[i].second);
+        if (!profiles[i].latency) {
+            profiles[i].latency = new LatencyHistogram[STAGE_COUNT];
+        }
+    }
+    profileCount = loaded.size();
+    assignment = mode;
+    windowMs = minutes * 60 * 1000;
+    machine = computer;
+    machineHash = hash;
+    config = &runtimeConfig;
+    active.store(index);
+    LOG_INFO("Experiments", "Profile " << profiles[index].name << " of " << profileCount << " ("
+             << AssignmentName(mode) << " assignment" << (mode == Assignment::Window
+                 ? ", switching every " + std::to_string(minutes) + " min" : std::string()) << ")");
+    return true;
+}
+
+// The window's turn, shifted by the machine's hash
+uint32_t Experiments::WindowProfile(int64_t nowMs, int64_t windowMs, uint32_t hash, size_t count) {
+    uint64_t window = static_cast<uint64_t>(nowMs / windowMs);
+    return static_cast<uint32_t>((window + hash) % count);
+}
+
+void Experiments::Switch(uint32_t index) {
+    std::shared_ptr<const RuntimeConfig::Values> before = config->Get();
+    std::string error;
+    if (!config->SetProfile(profiles[index].overlay, false, error)) {
+        LOG_WARNING("Experiments", "Profile " << profiles[index].name << " not applied: " << error);
+        return;
+    }
+    std::vector<std::string> changed = RuntimeConfig::Diff(*before, *config->Get());
+    active.store(index);
+    LOG_INFO("Experiments", "Window switched to profile " << profiles[index].name
+             << " (" << changed.size() << " keys changed)");
+    if (onSwitch) {
+        onSwitch(changed);
+    }
+}
+
+// ============================================================================
+// Sampling
+// ============================================================================
+
+void Experiments::Start(SwitchCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    onSwitch = std::move(callback);
+    running = true;
+    thread = std::thread(&Experiments::Run, this);
+}
+
+void Experiments::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Experiments::Run() {
+    TRACE_THREAD("Experiments");
+    int64_t lastMs = SteadyMs();
+    int64_t settledAtMs = lastMs + SETTLE_MS;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(SAMPLE_MS), [this]() { return !running; });
+            if (!running) {
+                break;
+            }
+        }
+        int64_t nowMs = SteadyMs();
+        int64_t elapsedMs = nowMs - lastMs;
+        lastMs = nowMs;
+
+        if (assignment == Assignment::Window) {
+            uint32_t next = WindowProfile(EpochMs(), windowMs, machineHash, profileCount);
+            if (next != active.load()) {
+                Switch(next);
+                settledAtMs = nowMs + SETTLE_MS;
+            }
+        }
+
+        double process = CpuSampler::Instance().ProcessPercent();
+        double system = CpuSampler::Instance().SystemPercent();
+        std::lock_guard<std::mutex> lock(statsMutex);
+        Profile& profile = profiles[active.load()];
+        profile.activeMs += static_cast<uint64_t>(elapsedMs);
+        if (nowMs >= settledAtMs && process >= 0 && system >= 0) {
+            profile.cpuSamples++;
+            profile.processCpuSum += process;
+            profile.systemCpuSum += system;
+        }
+    }
+}
+
+void Experiments::Record(PipelineLatency::Stage stage, double millis) {
+    LatencyHistogram* latency = profiles[active.load(std::memory_order_relaxed)].latency;
+    if (latency && stage < PipelineLatency::Stage::Count) {
+        latency[static_cast<size_t>(stage)].RecordMs(millis);
+    }
+}
+
+const char* Experiments::ProfileName(uint32_t index) const {
+    return index < profileCount ? profiles[index].name.c_str() : "unknown";
+}
+
+// ============================================================================
+// Reports
+// ============================================================================
+
+void Experiments::Write(JsonWriter& writer) const {
+    struct Cpu {
+        uint64_t activeMs = 0;
+        uint64_t samples = 0;
+        double process = -1.0;
+        double system = -1.0;
+    };
+    Cpu cpu[MAX_PROFILES];
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        for (size_t i = 0; i < profileCount; ++i) {
+            const Profile& profile = profiles[i];
+            cpu[i].activeMs = profile.activeMs;
+            cpu[i].samples = profile.cpuSamples;
+            if (profile.cpuSamples > 0) {
+                cpu[i].process = profile.processCpuSum / profile.cpuSamples;
+                cpu[i].system = profile.systemCpuSum / profile.cpuSamples;
+            }
+        }
+    }
+    auto writeOptional = [&writer](double value, int precision) {
+        if (value >= 0.0) {
+            writer.Double(value, precision);
+        } else {
+            writer.Null();
+        }
+    };
+
+    uint32_t current = active.load();
+    const LatencyHistogram* baseline = profiles[0].latency;
+    writer.BeginObject();
+    writer.Key("assignment").String(AssignmentName(assignment));
+    writer.Key("machine").String(machine);
+    if (assignment == Assignment::Window) {
+        writer.Key("windowMinutes").Int(windowMs / 60000);
+    }
+    writer.Key("active").String(profiles[current].name);
+    writer.Key("baseline").String(profiles[0].name);
+    writer.Key("profiles").BeginArray();
+    for (size_t i = 0; i < profileCount; ++i) {
+        const Profile& profile = profiles[i];
+        writer.BeginObject();
+        writer.Key("name").String(profile.name);
+        writer.Key("active").Bool(i == current);
+        writer.Key("activeSeconds").UInt(cpu[i].activeMs / 1000);
+        writer.Key("overrides").Raw(profile.overlay.empty() ? std::string_view("{}") : profile.overlay);
+
+        writer.Key("cpu").BeginObject();
+        writer.Key("samples").UInt(cpu[i].samples);
+        writer.Key("processPercent");
+        writeOptional(cpu[i].process, 2);
+        writer.Key("systemPercent");
+        writeOptional(cpu[i].system, 2);
+        writer.EndObject();
+
+        // Stages this profile saw, in ms
+        writer.Key("latency").BeginObject();
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            const LatencyHistogram& histogram = profile.latency[stage];
+            if (histogram.Count() == 0) {
+                continue;
+            }
+            writer.Key(PipelineLatency::StageName(static_cast<PipelineLatency::Stage>(stage))).BeginObject();
+            writer.Key("count").UInt(histogram.Count());
+            writer.Key("meanMs").Double(histogram.SumMs() / histogram.Count(), 2);
+            writer.Key("p50Ms").Double(histogram.QuantileMs(0.5), 2);
+            writer.Key("p90Ms").Double(histogram.QuantileMs(0.9), 2);
+            writer.Key("p99Ms").Double(histogram.QuantileMs(0.99), 2);
+            writer.EndObject();
+        }
+        writer.EndObject();
+
+        // Percent change from the baseline: negative is faster / cheaper
+        if (i > 0) {
+            writer.Key("vsBaseline").BeginObject();
+            writer.Key("processCpuPercent").Double(PercentChange(cpu[i].process, cpu[0].process), 1);
+            writer.Key("systemCpuPercent").Double(PercentChange(cpu[i].system, cpu[0].system), 1);
+            for (const auto& change : QUANTILE_CHANGES) {
+                double quantile = change.quantile;
+                writer.Key(change.key).BeginObject();
+                for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+                    const LatencyHistogram& mine = profile.latency[stage];
+                    const LatencyHistogram& theirs = baseline[stage];
+                    if (mine.Count() == 0 || theirs.Count() == 0) {
+                        continue;
+                    }
+                    writer.Key(PipelineLatency::StageName(static_cast<PipelineLatency::Stage>(stage)))
+                          .Double(PercentChange(mine.QuantileMs(quantile), theirs.QuantileMs(quantile)), 1);
+                }
+                writer.EndObject();
+            }
+            writer.EndObject();
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+std::string Experiments::FormatPrometheus() const {
+    std::string out;
+    char line[192];
+    out += "# HELP perception_experiment_info Active experiment profile (join on it to tag any series)\n";
+    out += "# TYPE perception_experiment_info gauge\n";
+    std::snprintf(line, sizeof(line), "perception_experiment_info{profile=\"%s\",assignment=\"%s\"} 1\n",
+                  profiles[active.load()].name.c_str(), AssignmentName(assignment));
+    out += line;
+    if (assignment == Assignment::None) {
+        return out;
+    }
+
+    out += "# HELP perception_experiment_latency_seconds Pipeline stage latency per experiment profile since start\n";
+    out += "# TYPE perception_experiment_latency_seconds summary\n";
+    for (size_t i = 0; i < profileCount; ++i) {
+        const char* name = profiles[i].name.c_str();
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            const LatencyHistogram& histogram = profiles[i].latency[stage];
+            if (histogram.Count() == 0) {
+                continue;
+            }
+            const char* stageName = PipelineLatency::StageName(static_cast<PipelineLatency::Stage>(stage));
+            for (double quantile : QUANTILES) {
+                std::snprintf(line, sizeof(line),
+                              "perception_experiment_latency_seconds{profile=\"%s\",stage=\"%s\",quantile=\"%g\"} %.6f\n",
+                              name, stageName, quantile, histogram.QuantileMs(quantile) / 1000.0);
+                out += line;
+            }
+            std::snprintf(line, sizeof(line), "perception_experiment_latency_seconds_sum{profile=\"%s\",stage=\"%s\"} %.6f\n",
+                          name, stageName, histogram.SumMs() / 1000.0);
+            out += line;
+            std::snprintf(line, sizeof(line), "perception_experiment_latency_seconds_count{profile=\"%s\",stage=\"%s\"} %llu\n",
+                          name, stageName, static_cast<unsigned long long>(histogram.Count()));
+            out += line;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    out += "# HELP perception_experiment_active_seconds_total Time each experiment profile was active\n";
+    out += "# TYPE perception_experiment_active_seconds_total counter\n";
+    for (size_t i = 0; i < profileCount; ++i) {
+        std::snprintf(line, sizeof(line), "perception_experiment_active_seconds_total{profile=\"%s\"} %.3f\n",
+                      profiles[i].name.c_str(), profiles[i].activeMs / 1000.0);
+        out += line;
+    }
+    out += "# HELP perception_experiment_process_cpu_percent Mean engine CPU usage per experiment profile\n";
+    out += "# TYPE perception_experiment_process_cpu_percent gauge\n";
+    for (size_t i = 0; i < profileCount; ++i) {
+        if (profiles[i].cpuSamples == 0) {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "perception_experiment_process_cpu_percent{profile=\"%s\"} %.3f\n",
+                      profiles[i].name.c_str(), profiles[i].processCpuSum / profiles[i].cpuSamples);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "PipelineLatency.h"
+
+class JsonWriter;
+class RuntimeConfig;
+
+/**
+ * Experiments - Named configuration profiles, compared on production data
+ *
+ * perception_experiments.json ($PERCEPTION_EXPERIMENTS overrides the path)
+ * names profiles - each a RuntimeConfig overlay in the config file's layout
+ * - and how a machine gets one:
+ *
+ *   { "assign": "machine",
+ *     "profiles": { "control": {},
+ *                   "whisper6": { "threads": { "whisper": 6 } },
+ *                   "vad_tight": { "audio": { "vad_on": 0.6, "vad_off": 0.45 } } },
+ *     "machines": { "LAB-07": "whisper6" } }
+ *
+ *   machine  One profile for the process's life, applied before the engines
+ *            load, so startup keys (threads, models) may vary: the machines
+ *            entry for this computer, else one picked by a hash of its name -
+ *            a fleet splits evenly and every machine keeps its profile
+ *   window   Profiles take turns every "window_minutes" (default 60),
+ *            offset per machine by the same hash so the fleet runs all of
+ *            them at any time of day; only hot keys may vary
+ *
+ * The profile is a layer between the config file and the environment
+ * (RuntimeConfig::SetProfile). A window switch rebuilds the values from the
+ * defaults up, so a POST /config overlay lasts until the next switch.
+ *
+ * Every PipelineLatency record also lands in the active profile's histogram
+ * (Record(), lock-free), utterance traces carry the profile they began in,
+ * and /metrics exports perception_experiment_info{profile} with per-profile
+ * latency summaries. The sampler thread adds the engine's and the machine's
+ * CPU usage (CpuSampler) and how long each profile was active, skipping
+ * SETTLE_MS after a switch. /experiments compares them: per profile, latency
+ * quantiles per stage, mean CPU, and the change of each against the first
+ * profile (the baseline).
+ *
+ * Without the file nothing is assigned and everything counts against
+ * "default".
+ *
+ * Usage:
+ *   Experiments::Instance().Load(Experiments::DefaultPath(), runtimeConfig, error);
+ *   Experiments::Instance().Start([](const std::vector<std::string>& changed) { ... });
+ *   Experiments::Instance().Write(writer);
+ */
+class Experiments {
+public:
+    static constexpr const char* DEFAULT_FILE = "perception_experiments.json";
+    static constexpr const char* FILE_VARIABLE = "PERCEPTION_EXPERIMENTS";
+    static constexpr size_t MAX_PROFILES = 8;
+    static constexpr int DEFAULT_WINDOW_MINUTES = 60;
+    static constexpr int SAMPLE_MS = 1000;
+    static constexpr int SETTLE_MS = 5000;             // CPU after a switch still shows the previous profile
+
+    enum class Assignment { None, Machine, Window };
+
+    // Keys a window switch changed, for the caller to apply the hot ones
+    using SwitchCallback = std::function<void(const std::vector<std::string>& changed)>;
+
+    static Experiments& Instance();
+
+    Experiments(const Experiments&) = delete;
+    Experiments& operator=(const Experiments&) = delete;
+
+    /**
+     * @brief $PERCEPTION_EXPERIMENTS, else DEFAULT_FILE
+     */
+    static std::string DefaultPath();
+
+    /**
+     * @brief Read the profiles and apply this machine's to `config`; call once, before the engines load
+     * @return false with `error` set when the file is malformed (nothing assigned); a missing file is fine
+     */
+    bool Load(const std::string& path, RuntimeConfig& config, std::string& error);
+
+    // The sampler thread (CPU per profile; window switches)
+    void Start(SwitchCallback onSwitch);
+    void Stop();
+
+    // Lock-free: PipelineLatency::Record calls it for every record
+    void Record(PipelineLatency::Stage stage, double millis);
+
+    uint32_t ActiveIndex() const { return active.load(std::memory_order_relaxed); }
+    const char* ProfileName(uint32_t index) const;
+
+    // {"assignment","machine","active","baseline","profiles":[...]}
+    void Write(JsonWriter& writer) const;
+
+    // perception_experiment_info and, with profiles, per-profile latency and CPU
+    std::string FormatPrometheus() const;
+
+private:
+    Experiments();
+    ~Experiments();
+
+    struct Profile {
+        std::string name;
+        std::string overlay;            // Config file layout
+        LatencyHistogram* latency = nullptr;            // Stage::Count of them; leaked like PipelineLatency's
+        // Sampler thread; read under statsMutex
+        uint64_t activeMs = 0;
+        uint64_t cpuSamples = 0;
+        double processCpuSum = 0.0;
+        double systemCpuSum = 0.0;
+    };
+
+    void Run();
+    static uint32_t WindowProfile(int64_t nowMs, int64_t windowMs, uint32_t hash, size_t count);
+    void Switch(uint32_t index);
+    static std::string ComputerName();
+    static uint32_t NameHash(const std::string& name);
+
+    // Fixed by Load(), before any reader; a fixed array, so Record() never
+    // sees one move
+    Profile profiles[MAX_PROFILES];
+    size_t profileCount;
+    Assignment assignment;
+    int64_t windowMs;
+    std::string machine;
+    uint32_t machineHash;
+    RuntimeConfig* config;
+
+    std::atomic<uint32_t> active;
+    mutable std::mutex statsMutex;      // Profile's sampler fields
+
+    SwitchCallback onSwitch;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running;
+    std::thread thread;
+};
@@ -1,21 +1,76 @@
 #include "FastVLMTokenizer.h"
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <climits>
+#include <windows.h>
+#include "Log.h"
+
+FastVLMTokenizer::~FastVLMTokenizer() {
+    Reset();
+}
+
+void FastVLMTokenizer::Reset() {
+    if (mappedView_) {
+        UnmapViewOfFile(mappedView_);
+        mappedView_ = nullptr;
+    }
+    if (mappingHandle_) {
+        CloseHandle(mappingHandle_);
+        mappingHandle_ = nullptr;
+    }
+    if (fileHandle_) {
+        CloseHandle(fileHandle_);
+        fileHandle_ = nullptr;
+    }
+
+    blob_.clear();
+    blob_.shrink_to_fit();
+    offsets_.clear();
+    offsets_.shrink_to_fit();
+
+    offsetsData_ = nullptr;
+    blobData_ = nullptr;
+    numIds_ = 0;
+
+    // The encoder tables view the blob just released
+    tokenIds_.clear();
+    mergeRanks_.clear();
+    std::lock_guard<std::mutex> lock(wordCacheMutex_);
+    wordCache_.clear();
+    wordLru_.clear();
+}
 
 bool FastVLMTokenizer::LoadVocab(const std::string& vocabPath) {
-    std::ifstream file(vocabPath);
+    std::ifstream file(vocabPath, std::ios::binary | std::ios::ate);
     if (!file.is_open()) {
         std::cerr << "Failed to open vocab file: " << vocabPath << std::endl;
         return false;
     }
 
-    // Read entire file
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string json = buffer.str();
+    // Read entire file in one go (no stringstream double-buffering)
+    std::string json(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&json[0], json.size());
     file.close();
 
     // Simple JSON parsing (vocab.json is {"token": id, ...})
-    vocab_.clear();
+    Reset();
+
+    // vocab.json is ordered by token text, not ID, so collect (id, span) pairs
+    // over a scratch blob first and lay the final blob out in ID order after
+    struct Entry {
+        int64_t id;
+        uint32_t offset;
+        uint32_t length;
+    };
+    std::vector<Entry> parsed;
+    std::string scratch;
+    std::string token;
+    scratch.reserve(json.size() / 2);
+    int64_t maxId = -1;
 
     size_t pos = json.find('{');
     if (pos == std::string::npos) {
@@ -45,7 +100,7 @@ bool FastVLMTokenizer::LoadVocab(const std::string& vocabPath) {
             std::cerr << "Expected quote at position " << pos << std::endl;
             return false;
         }
-        std::string token = ParseJsonString(json, pos);
+        ParseJsonString(json, pos, token);
 
         // Skip whitespace and colon
         while (pos < json.length() && (json[pos] == ' ' || json[pos] == ':')) {
@@ -55,11 +110,40 @@ bool FastVLMTokenizer::LoadVocab(const std::string& vocabPath) {
         // Parse token ID (value)
         int64_t tokenId = ParseJsonNumber(json, pos);
 
-        // Store in reverse map (ID -> token)
-        vocab_[tokenId] = token;
+        if (tokenId < 0) {
+            std::cerr << "Invalid token ID " << tokenId << " at position " << pos << std::endl;
+            return false;
+        }
+
+        parsed.push_back({tokenId, static_cast<uint32_t>(scratch.size()), static_cast<uint32_t>(token.size())});
+        scratch += token;
+        maxId = (std::max)(maxId, tokenId);
         entries++;
     }
 
+    // Build the ID-indexed blob (ID -> token)
+    std::sort(parsed.begin(), parsed.end(),
+              [](const Entry& a, const Entry& b) { return a.id < b.id; });
+
+    blob_.reserve(scratch.size());
+    offsets_.assign(static_cast<size_t>(maxId + 2), 0);
+    size_t next = 0;
+    for (int64_t id = 0; id <= maxId; ++id) {
+        offsets_[id] = static_cast<uint32_t>(blob_.size());
+        if (next < parsed.size() && parsed[next].id == id) {
+            blob_.append(scratch, parsed[next].offset, parsed[next].length);
+            // Duplicate IDs: first occurrence wins, skip the rest
+            while (next < parsed.size() && parsed[next].id == id) {
+                next++;
+            }
+        }
+    }
+    offsets_[maxId + 1] = static_cast<uint32_t>(blob_.size());
+
+    offsetsData_ = offsets_.data();
+    blobData_ = blob_.data();
+    numIds_ = static_cast<size_t>(maxId + 1);
+
     std::cout << "Loaded " << entries << " tokens from vocabulary" << std::endl;
     return entries > 0;
 }
@@ -74,9 +158,14 @@ std::string FastVLMTokenizer::Decode(const std::vector<int64_t>& tokens) const {
             break;
         }
 
-        auto it = vocab_.find(tokenId);
-        if (it != vocab_.end()) {
-            result += it->second;
+        // Chat-template markers (<|im_start|> etc.) aren't caption text
+        if (tokenId >= FIRST_SPECIAL_TOKEN_ID) {
+            continue;
+        }
+
+        std::string_view text = GetToken(tokenId);
+        if (!text.empty()) {
+            AppendTokenText(result, text);
         } else {
             // Unknown token - skip
             std::cerr << "Warning: Unknown token ID " << tokenId << std::endl;
@@ -86,8 +175,197 @@ std::string FastVLMTokenizer::Decode(const std::vector<int64_t>& tokens) const {
     return result;
 }
 
-std::string FastVLMTokenizer::ParseJsonString(const std::string& json, size_t& pos) {
-    std::string result;
+std::string_view FastVLMTokenizer::StreamDecoder::Push(int64_t tokenId) {
+    if (finished || tokenId >= FIRST_SPECIAL_TOKEN_ID) {
+        finished = finished || tokenId == EOS_TOKEN_ID;
+        return {};
+    }
+    AppendTokenText(text, tokenizer.GetToken(tokenId));
+
+    // Whole characters end where the last lead byte's sequence is complete
+    size_t end = text.size();
+    size_t lead = end;
+    while (lead > complete && lead + 3 > end &&
+           (static_cast<unsigned char>(text[lead - 1]) & 0xC0) == 0x80) {
+        --lead;
+    }
+    if (lead > complete) {
+        unsigned char byte = static_cast<unsigned char>(text[lead - 1]);
+        size_t length = byte < 0x80 ? 1 : (byte & 0xE0) == 0xC0 ? 2 : (byte & 0xF0) == 0xE0 ? 3 : 4;
+        end = (lead - 1 + length <= text.size()) ? text.size() : lead - 1;
+    }
+
+    size_t previous = complete;
+    complete = end;
+    return std::string_view(text.data() + previous, complete - previous);
+}
+
+void FastVLMTokenizer::StreamDecoder::Reset() {
+    text.clear();
+    complete = 0;
+    finished = false;
+}
+
+void FastVLMTokenizer::AppendTokenText(std::string& out, std::string_view tokenText) {
+    // GPT-2 byte-level BPE: printable bytes stand for themselves, the other 68
+    // bytes are shifted to U+0100..U+0143 in byte order. Invert that table.
+    static const auto unicodeToByte = [] {
+        std::vector<int16_t> table(256 + 68, -1);
+        int shifted = 0;
+        for (int b = 0; b < 256; ++b) {
+            bool printable = (b >= 33 && b <= 126) || (b >= 161 && b <= 172) || (b >= 174 && b <= 255);
+            table[printable ? b : 256 + shifted++] = static_cast<int16_t>(b);
+        }
+        return table;
+    }();
+
+    for (size_t i = 0; i < tokenText.size();) {
+        unsigned char lead = static_cast<unsigned char>(tokenText[i]);
+        uint32_t codePoint = lead;
+        size_t length = 1;
+        if ((lead & 0xE0) == 0xC0 && i + 1 < tokenText.size()) {
+            codePoint = ((lead & 0x1Fu) << 6) | (static_cast<unsigned char>(tokenText[i + 1]) & 0x3Fu);
+            length = 2;
+        }
+
+        if (codePoint < unicodeToByte.size() && unicodeToByte[codePoint] >= 0 && (length == 2 || lead < 0x80)) {
+            out += static_cast<char>(unicodeToByte[codePoint]);
+        } else {
+            out.append(tokenText.data() + i, length);   // Not byte-level mapped: keep as is
+        }
+        i += length;
+    }
+}
+
+std::string_view FastVLMTokenizer::GetToken(int64_t tokenId) const {
+    if (tokenId < 0 || static_cast<size_t>(tokenId) >= numIds_) {
+        return {};
+    }
+    uint32_t begin = offsetsData_[tokenId];
+    return std::string_view(blobData_ + begin, offsetsData_[tokenId + 1] - begin);
+}
+
+bool FastVLMTokenizer::LoadBinaryVocab(const std::string& binPath) {
+    Reset();
+
+    HANDLE file = CreateFileA(binPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        // Missing file is the normal first-run case; caller falls back to vocab.json
+        return false;
+    }
+    fileHandle_ = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(BinaryHeader))) {
+        std::cerr << "Binary vocab too small: " << binPath << std::endl;
+        Reset();
+        return false;
+    }
+
+    mappingHandle_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle_) {
+        std::cerr << "Failed to map binary vocab: " << binPath << " (error " << GetLastError() << ")" << std::endl;
+        Reset();
+        return false;
+    }
+
+    mappedView_ = MapViewOfFile(mappingHandle_, FILE_MAP_READ, 0, 0, 0);
+    if (!mappedView_) {
+        std::cerr << "Failed to view binary vocab: " << binPath << " (error " << GetLastError() << ")" << std::endl;
+        Reset();
+        return false;
+    }
+
+    // Validate header and table bounds before trusting any offset
+    const char* base = static_cast<const char*>(mappedView_);
+    BinaryHeader header;
+    std::memcpy(&header, base, sizeof(header));
+
+    uint64_t tableBytes = (static_cast<uint64_t>(header.numIds) + 1) * sizeof(uint32_t);
+    uint64_t expectedSize = sizeof(BinaryHeader) + tableBytes + header.blobSize;
+
+    if (std::memcmp(header.magic, "FVOC", 4) != 0 || header.version != BINARY_VERSION ||
+        header.numIds == 0 || expectedSize > static_cast<uint64_t>(fileSize.QuadPart)) {
+        std::cerr << "Invalid binary vocab header: " << binPath << std::endl;
+        Reset();
+        return false;
+    }
+
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(base + sizeof(BinaryHeader));
+    for (uint32_t i = 0; i < header.numIds; ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            std::cerr << "Corrupt binary vocab offsets at ID " << i << ": " << binPath << std::endl;
+            Reset();
+            return false;
+        }
+    }
+    if (offsets[header.numIds] != header.blobSize) {
+        std::cerr << "Corrupt binary vocab blob size: " << binPath << std::endl;
+        Reset();
+        return false;
+    }
+
+    offsetsData_ = offsets;
+    blobData_ = base + sizeof(BinaryHeader) + tableBytes;
+    numIds_ = header.numIds;
+
+    std::cout << "Mapped " << numIds_ << " token IDs from binary vocabulary" << std::endl;
+    return true;
+}
+
+bool FastVLMTokenizer::SaveBinaryVocab(const std::string& binPath) const {
+    if (!IsLoaded()) {
+        std::cerr << "No vocabulary loaded to save" << std::endl;
+        return false;
+    }
+
+    BinaryHeader header;
+    std::memcpy(header.magic, "FVOC", 4);
+    header.version = BINARY_VERSION;
+    header.numIds = static_cast<uint32_t>(numIds_);
+    header.blobSize = offsetsData_[numIds_];
+
+    std::string tmpPath = binPath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Failed to create binary vocab: " << tmpPath << std::endl;
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(offsetsData_), (numIds_ + 1) * sizeof(uint32_t));
+        out.write(blobData_, header.blobSize);
+        if (!out) {
+            std::cerr << "Failed to write binary vocab: " << tmpPath << std::endl;
+            out.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+
+    if (!MoveFileExA(tmpPath.c_str(), binPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        std::cerr << "Failed to move binary vocab into place: " << binPath
+                  << " (error " << GetLastError() << ")" << std::endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    std::cout << "Wrote binary vocabulary: " << binPath << std::endl;
+    return true;
+}
+
+bool FastVLMTokenizer::ConvertVocab(const std::string& jsonPath, const std::string& binPath) {
+    FastVLMTokenizer tokenizer;
+    if (!tokenizer.LoadVocab(jsonPath)) {
+        return false;
+    }
+    return tokenizer.SaveBinaryVocab(binPath);
+}
+
+void FastVLMTokenizer::ParseJsonString(const std::string& json, size_t& pos, std::string& result) {
+    result.clear();
     pos++; // Skip opening quote
 
     while (pos < json.length() && json[pos] != '"') {
@@ -126,7 +404,6 @@ std::string FastVLMTokenizer::ParseJsonString(const std::string& json, size_t& p
     }
 
     pos++; // Skip closing quote
-    return result;
 }
 
 int64_t FastVLMTokenizer::ParseJsonNumber(const std::string& json, size_t& pos) {
@@ -136,3 +413,412 @@ int64_t FastVLMTokenizer::ParseJsonNumber(const std::string& json, size_t& pos)
     }
     return std::stoll(json.substr(start, pos - start));
 }
+
+
+// ============================================================================
+// Encoding
+// ============================================================================
+
+namespace {
+
+// GPT-2 byte-level BPE alphabet: printable bytes stand for themselves, the
+// other 68 are shifted to U+0100..U+0143 in byte order (AppendTokenText inverts this)
+uint32_t ByteToUnicode(int b) {
+    static const auto table = [] {
+        std::vector<uint32_t> codePoints(256);
+        uint32_t shifted = 0;
+        for (int i = 0; i < 256; ++i) {
+            bool printable = (i >= 33 && i <= 126) || (i >= 161 && i <= 172) || (i >= 174 && i <= 255);
+            codePoints[i] = printable ? static_cast<uint32_t>(i) : 256 + shifted++;
+        }
+        return codePoints;
+    }();
+    return table[b];
+}
+
+void AppendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Next code point of text at pos (invalid bytes decode as themselves, one at a time)
+uint32_t NextCodePoint(std::string_view text, size_t& pos) {
+    unsigned char lead = static_cast<unsigned char>(text[pos]);
+    size_t length = lead < 0x80 ? 1 : (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 1;
+    if (pos + length > text.size()) {
+        length = 1;
+    }
+    uint32_t codePoint = length == 1 ? lead : lead & (0x7F >> length);
+    for (size_t i = 1; i < length; ++i) {
+        unsigned char next = static_cast<unsigned char>(text[pos + i]);
+        if ((next & 0xC0) != 0x80) {
+            ++pos;
+            return lead;
+        }
+        codePoint = (codePoint << 6) | (next & 0x3F);
+    }
+    pos += length;
+    return codePoint;
+}
+
+// Unicode classes of the pre-tokenizer pattern. ASCII and Latin-1 are exact;
+// above that the common punctuation, symbol, digit and space blocks are
+// listed and everything else (CJK, Cyrillic, Greek, ...) counts as a letter.
+bool IsSpace(uint32_t c) {
+    return c == ' ' || (c >= 0x09 && c <= 0x0D) || c == 0x85 || c == 0xA0 || c == 0x1680 ||
+           (c >= 0x2000 && c <= 0x200A) || c == 0x2028 || c == 0x2029 || c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+bool IsNumber(uint32_t c) {
+    if (c < 0x80) {
+        return c >= '0' && c <= '9';
+    }
+    return c == 0xB2 || c == 0xB3 || c == 0xB9 || (c >= 0xBC && c <= 0xBE) ||
+           (c >= 0x660 && c <= 0x669) || (c >= 0x6F0 && c <= 0x6F9) || (c >= 0x966 && c <= 0x96F) ||
+           c == 0x2070 || (c >= 0x2074 && c <= 0x2079) || (c >= 0x2080 && c <= 0x2089) ||
+           (c >= 0x2150 && c <= 0x2189) || (c >= 0x2460 && c <= 0x249B) || (c >= 0x24EA && c <= 0x24FF) ||
+           (c >= 0x2776 && c <= 0x2793) || c == 0x3007 || (c >= 0x3021 && c <= 0x3029) ||
+           (c >= 0xFF10 && c <= 0xFF19);
+}
+
+bool IsLetter(uint32_t c) {
+    if (c < 0x80) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+    if (c < 0xC0) {
+        return c == 0xAA || c == 0xB5 || c == 0xBA;
+    }
+    if (c == 0xD7 || c == 0xF7 || IsSpace(c) || IsNumber(c)) {
+        return false;
+    }
+    return !((c >= 0x0300 && c <= 0x036F) ||        // Combining marks
+             (c >= 0x2000 && c <= 0x2BFF) ||        // Punctuation, symbols, arrows, math, box drawing
+             (c >= 0x3000 && c <= 0x303F) ||        // CJK punctuation
+             (c >= 0xE000 && c <= 0xF8FF) ||        // Private use
+             (c >= 0xFE00 && c <= 0xFE6F) ||        // Variation selectors, CJK compatibility forms
+             (c >= 0xFF00 && c <= 0xFF20) || (c >= 0xFF3B && c <= 0xFF40) || (c >= 0xFF5B && c <= 0xFF65) ||
+             (c >= 0x1F000 && c <= 0x1FAFF));       // Emoji and pictographs
+}
+
+bool IsNewline(uint32_t c) {
+    return c == '\r' || c == '\n';
+}
+
+char Lower(uint32_t c) {
+    return c < 0x80 ? static_cast<char>(std::tolower(static_cast<int>(c))) : '\0';
+}
+
+struct SpecialToken {
+    std::string_view text;
+    int64_t id;
+};
+
+constexpr SpecialToken SPECIAL_TOKENS[] = {
+    { "<|endoftext|>", 151643 },
+    { "<|im_start|>", FastVLMTokenizer::IM_START_TOKEN_ID },
+    { "<|im_end|>", FastVLMTokenizer::EOS_TOKEN_ID },
+    { "<image>", FastVLMTokenizer::IMAGE_TOKEN_ID },
+};
+
+}  // namespace
+
+bool FastVLMTokenizer::LoadMerges(const std::string& mergesPath) {
+    if (!IsLoaded()) {
+        LOG_ERROR("Tokenizer", "Load the vocabulary before the merges: " << mergesPath);
+        return false;
+    }
+
+    std::ifstream file(mergesPath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        LOG_ERROR("Tokenizer", "Failed to open merges file: " << mergesPath);
+        return false;
+    }
+    std::string text(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&text[0], text.size());
+    file.close();
+
+    mergeRanks_.clear();
+    tokenIds_.clear();
+    tokenIds_.reserve(numIds_);
+    for (size_t id = 0; id < numIds_; ++id) {
+        std::string_view token = GetToken(static_cast<int64_t>(id));
+        if (!token.empty()) {
+            tokenIds_.emplace(token, static_cast<int32_t>(id));
+        }
+    }
+
+    // Every byte must have a token, or some text could not be encoded at all
+    std::string symbol;
+    for (int b = 0; b < 256; ++b) {
+        symbol.clear();
+        AppendUtf8(symbol, ByteToUnicode(b));
+        auto it = tokenIds_.find(symbol);
+        if (it == tokenIds_.end()) {
+            LOG_ERROR("Tokenizer", "Vocabulary has no token for byte " << b << ", cannot encode");
+            tokenIds_.clear();
+            return false;
+        }
+        byteTokens_[b] = it->second;
+    }
+
+    std::string merged;
+    int32_t rank = 0;
+    size_t skipped = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string_view line(text.data() + pos, end - pos);
+        pos = end + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line.substr(0, 8) == "#version") {
+            continue;
+        }
+
+        size_t space = line.find(' ');
+        if (space == std::string_view::npos) {
+            ++skipped;
+            continue;
+        }
+        std::string_view left = line.substr(0, space);
+        std::string_view right = line.substr(space + 1);
+        merged.assign(left);
+        merged.append(right);
+        auto leftIt = tokenIds_.find(left);
+        auto rightIt = tokenIds_.find(right);
+        auto mergedIt = tokenIds_.find(merged);
+        if (leftIt == tokenIds_.end() || rightIt == tokenIds_.end() || mergedIt == tokenIds_.end()) {
+            ++skipped;
+            continue;
+        }
+        uint64_t key = (static_cast<uint64_t>(leftIt->second) << 32) | static_cast<uint32_t>(rightIt->second);
+        mergeRanks_.emplace(key, Merge{ rank++, mergedIt->second });     // First rank wins on duplicates
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wordCacheMutex_);
+        wordCache_.clear();
+        wordLru_.clear();
+    }
+
+    if (skipped > 0) {
+        LOG_WARNING("Tokenizer", "Skipped " << skipped << " merges not in the vocabulary");
+    }
+    LOG_INFO("Tokenizer", "Loaded " << mergeRanks_.size() << " BPE merges");
+    return !mergeRanks_.empty();
+}
+
+std::string FastVLMTokenizer::ApplyChatTemplate(std::string_view question, std::string_view system) {
+    std::string prompt;
+    prompt.reserve(96 + system.size() + question.size());
+    prompt += "<|im_start|>system\n";
+    prompt += system;
+    prompt += "<|im_end|>\n<|im_start|>user\n<image>\n";
+    prompt += question;
+    prompt += "<|im_end|>\n<|im_start|>assistant\n";
+    return prompt;
+}
+
+std::vector<int64_t> FastVLMTokenizer::Encode(std::string_view text) const {
+    std::vector<int64_t> tokens;
+    if (!CanEncode()) {
+        return tokens;
+    }
+    tokens.reserve(text.size() / 3 + 8);
+
+    // Special tokens are matched verbatim before pre-tokenization, so "<|im_end|>" is never split
+    size_t start = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const SpecialToken* special = nullptr;
+        if (text[pos] == '<') {
+            for (const SpecialToken& candidate : SPECIAL_TOKENS) {
+                if (text.compare(pos, candidate.text.size(), candidate.text) == 0) {
+                    special = &candidate;
+                    break;
+                }
+            }
+        }
+        if (!special) {
+            ++pos;
+            continue;
+        }
+        EncodeOrdinary(text.substr(start, pos - start), tokens);
+        tokens.push_back(special->id);
+        pos += special->text.size();
+        start = pos;
+    }
+    EncodeOrdinary(text.substr(start), tokens);
+    return tokens;
+}
+
+void FastVLMTokenizer::EncodeOrdinary(std::string_view text, std::vector<int64_t>& out) const {
+    if (text.empty()) {
+        return;
+    }
+
+    // Decode once: the pattern is matched over code points, words are cut as byte ranges
+    std::vector<uint32_t> codePoints;
+    std::vector<size_t> offsets;
+    codePoints.reserve(text.size());
+    offsets.reserve(text.size() + 1);
+    for (size_t pos = 0; pos < text.size();) {
+        offsets.push_back(pos);
+        codePoints.push_back(NextCodePoint(text, pos));
+    }
+    offsets.push_back(text.size());
+    const size_t n = codePoints.size();
+
+    // Qwen2 pre-tokenizer, alternatives tried in pattern order:
+    // (?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+    size_t i = 0;
+    while (i < n) {
+        const uint32_t c = codePoints[i];
+        size_t end = 0;
+
+        if (c == '\'' && i + 1 < n) {
+            char a = Lower(codePoints[i + 1]);
+            char b = i + 2 < n ? Lower(codePoints[i + 2]) : '\0';
+            if ((a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l')) {
+                end = i + 3;
+            } else if (a == 's' || a == 't' || a == 'm' || a == 'd') {
+                end = i + 2;
+            }
+        }
+        if (end == 0) {
+            size_t letters = i;
+            if (!IsLetter(c) && !IsNumber(c) && !IsNewline(c) && i + 1 < n && IsLetter(codePoints[i + 1])) {
+                letters = i + 1;
+            }
+            if (IsLetter(codePoints[letters])) {
+                end = letters;
+                while (end < n && IsLetter(codePoints[end])) {
+                    ++end;
+                }
+            }
+        }
+        if (end == 0 && IsNumber(c)) {
+            end = i + 1;
+        }
+        if (end == 0) {
+            size_t j = c == ' ' ? i + 1 : i;
+            if (j < n && !IsSpace(codePoints[j]) && !IsLetter(codePoints[j]) && !IsNumber(codePoints[j])) {
+                end = j;
+                while (end < n && !IsSpace(codePoints[end]) && !IsLetter(codePoints[end]) && !IsNumber(codePoints[end])) {
+                    ++end;
+                }
+                while (end < n && IsNewline(codePoints[end])) {
+                    ++end;
+                }
+            }
+        }
+        if (end == 0 && IsSpace(c)) {
+            size_t runEnd = i;
+            size_t lastNewline = n;
+            while (runEnd < n && IsSpace(codePoints[runEnd])) {
+                if (IsNewline(codePoints[runEnd])) {
+                    lastNewline = runEnd;
+                }
+                ++runEnd;
+            }
+            if (lastNewline != n) {
+                end = lastNewline + 1;              // \s*[\r\n]+
+            } else if (runEnd == n || runEnd - i == 1) {
+                end = runEnd;                       // \s+(?!\S) at the end, or \s+
+            } else {
+                end = runEnd - 1;                   // Leave one space to lead the next word
+            }
+        }
+        if (end == 0) {
+            end = i + 1;
+        }
+
+        EncodeWord(text.substr(offsets[i], offsets[end] - offsets[i]), out);
+        i = end;
+    }
+}
+
+void FastVLMTokenizer::EncodeWord(std::string_view word, std::vector<int64_t>& out) const {
+    {
+        std::lock_guard<std::mutex> lock(wordCacheMutex_);
+        auto it = wordCache_.find(word);
+        if (it != wordCache_.end()) {
+            wordLru_.splice(wordLru_.begin(), wordLru_, it->second);
+            out.insert(out.end(), it->second->second.begin(), it->second->second.end());
+            return;
+        }
+    }
+
+    // Merge outside the lock; two threads racing on one word both insert the same result
+    std::vector<int32_t> ids = MergeWord(word);
+    out.insert(out.end(), ids.begin(), ids.end());
+
+    std::lock_guard<std::mutex> lock(wordCacheMutex_);
+    if (wordCache_.count(word)) {
+        return;
+    }
+    wordLru_.emplace_front(std::string(word), std::move(ids));
+    wordCache_.emplace(wordLru_.front().first, wordLru_.begin());
+    if (wordLru_.size() > WORD_CACHE_CAPACITY) {
+        wordCache_.erase(wordLru_.back().first);
+        wordLru_.pop_back();
+    }
+}
+
+std::vector<int32_t> FastVLMTokenizer::MergeWord(std::string_view word) const {
+    std::vector<int32_t> symbols;
+    symbols.reserve(word.size());
+    for (char ch : word) {
+        symbols.push_back(byteTokens_[static_cast<unsigned char>(ch)]);
+    }
+
+    // Each round merges every occurrence of the lowest-ranked pair, left to right
+    while (symbols.size() > 1) {
+        int32_t bestRank = INT32_MAX;
+        uint64_t bestKey = 0;
+        int32_t bestId = 0;
+        for (size_t i = 0; i + 1 < symbols.size(); ++i) {
+            uint64_t key = (static_cast<uint64_t>(symbols[i]) << 32) | static_cast<uint32_t>(symbols[i + 1]);
+            auto it = mergeRanks_.find(key);
+            if (it != mergeRanks_.end() && it->second.rank < bestRank) {
+                bestRank = it->second.rank;
+                bestKey = key;
+                bestId = it->second.id;
+            }
+        }
+        if (bestRank == INT32_MAX) {
+            break;
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            if (i + 1 < symbols.size() &&
+                ((static_cast<uint64_t>(symbols[i]) << 32) | static_cast<uint32_t>(symbols[i + 1])) == bestKey) {
+                symbols[kept++] = bestId;
+                ++i;
+            } else {
+                symbols[kept++] = symbols[i];
+            }
+        }
+        symbols.resize(kept);
+    }
+    return symbols;
+}
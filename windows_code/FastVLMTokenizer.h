@@ -2,19 +2,58 @@
 
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <cstdint>
+#include <string_view>
 #include <fstream>
-#include <sstream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 /**
- * @brief FastVLM Tokenizer - Handles token decoding
+ * @brief FastVLM Tokenizer - Handles token decoding and prompt encoding
+ *
+ * Loads vocab.json (or its precompiled vocab.bin form) at runtime and
+ * provides token->text decoding for FastVLM model outputs. With merges.txt
+ * loaded as well it also encodes text (byte-level BPE, see Encode()), so
+ * prompts can be built at runtime instead of shipped as token IDs.
+ *
+ * Storage is id-indexed: every token's text lives in one contiguous blob and
+ * offsets[id]..offsets[id + 1] delimits it, so a ~150k entry vocabulary is
+ * two allocations instead of a hash node plus a heap string per entry.
+ * Load once and reuse; Decode() is const and safe to call concurrently.
+ *
+ * Binary format (vocab.bin, little-endian):
+ *   BinaryHeader { "FVOC", version, numIds, blobSize }
+ *   uint32_t offsets[numIds + 1]
+ *   char blob[blobSize]                  (UTF-8 token text, ID order)
+ * LoadBinaryVocab() memory-maps the file read-only and decodes straight from
+ * the mapping, so startup does no parsing and processes on the same host
+ * share the pages through the file cache instead of each holding a copy.
  *
- * Loads vocab.json at runtime and provides token->text decoding
- * for FastVLM model outputs.
+ * Encoding follows Qwen2's tokenizer.json: special tokens are split out
+ * first, the rest is cut into words by the Qwen2 pre-tokenizer pattern
+ * (contractions, letter runs with one leading non-letter, single digits,
+ * punctuation runs, whitespace) and each word's bytes are merged pairwise
+ * by merge rank. Merge ranks live in one hash keyed by the (left, right)
+ * token ID pair, and merged words are kept in a small LRU, so a prompt
+ * that differs in one word from the last re-merges only that word.
+ *
+ * Usage:
+ *   FastVLMTokenizer tokenizer;
+ *   if (!tokenizer.LoadBinaryVocab("models/fastvlm/vocab.bin")) {
+ *       FastVLMTokenizer::ConvertVocab("models/fastvlm/vocab.json", "models/fastvlm/vocab.bin");
+ *       tokenizer.LoadBinaryVocab("models/fastvlm/vocab.bin");
+ *   }
+ *   tokenizer.LoadMerges("models/fastvlm/merges.txt");
+ *   std::vector<int64_t> prompt = tokenizer.EncodeChatPrompt("What is on the desk?");
  */
 class FastVLMTokenizer {
 public:
     FastVLMTokenizer() = default;
+    ~FastVLMTokenizer();
+
+    FastVLMTokenizer(const FastVLMTokenizer&) = delete;
+    FastVLMTokenizer& operator=(const FastVLMTokenizer&) = delete;
 
     /**
      * @brief Load vocabulary from vocab.json
@@ -23,13 +62,135 @@ public:
      */
     bool LoadVocab(const std::string& vocabPath);
 
+    /**
+     * @brief Memory-map a precompiled vocab.bin (see class comment for layout)
+     * @param binPath Path to vocab.bin file
+     * @return true if the file was mapped and its header/offsets validated
+     */
+    bool LoadBinaryVocab(const std::string& binPath);
+
+    /**
+     * @brief Load BPE merge rules (merges.txt, one "left right" pair per line in rank order)
+     * Call after the vocabulary is loaded: pairs are stored as token IDs.
+     * Loading a vocabulary again drops the merges.
+     * @return true if at least one merge was loaded
+     */
+    bool LoadMerges(const std::string& mergesPath);
+
+    /**
+     * @brief Write the loaded vocabulary in binary form
+     * Written to binPath + ".tmp" and renamed into place, so a process that
+     * maps binPath concurrently never sees a partial file.
+     * @return true if written successfully
+     */
+    bool SaveBinaryVocab(const std::string& binPath) const;
+
+    /**
+     * @brief One-time converter: vocab.json -> vocab.bin
+     * @return true if converted successfully
+     */
+    static bool ConvertVocab(const std::string& jsonPath, const std::string& binPath);
+
     /**
      * @brief Decode token IDs to text
+     * Stops at EOS, skips special tokens and undoes the byte-level BPE
+     * mapping (e.g. 'Ġ' -> ' ', 'Ċ' -> newline), matching the HF tokenizer's
+     * decode(skip_special_tokens=True).
      * @param tokens Vector of token IDs
      * @return Decoded text string
      */
     std::string Decode(const std::vector<int64_t>& tokens) const;
 
+    /**
+     * @brief Encode text to token IDs (needs LoadMerges)
+     * <|endoftext|>, <|im_start|>, <|im_end|> and <image> in the text become
+     * their special IDs; everything else is byte-level BPE, matching the HF
+     * tokenizer's encode(add_special_tokens=False). Safe to call concurrently.
+     * @return Token IDs, empty if text is empty or no merges are loaded
+     */
+    std::vector<int64_t> Encode(std::string_view text) const;
+
+    /**
+     * @brief Check if Encode() is available (vocabulary and merges loaded)
+     */
+    bool CanEncode() const { return !mergeRanks_.empty(); }
+
+    /**
+     * @brief A question in the model's chat template, with <image> before it
+     * "<|im_start|>system\n{system}<|im_end|>\n<|im_start|>user\n<image>\n
+     *  {question}<|im_end|>\n<|im_start|>assistant\n"
+     */
+    static std::string ApplyChatTemplate(std::string_view question,
+                                         std::string_view system = DEFAULT_SYSTEM_PROMPT);
+
+    /**
+     * @brief Encode(ApplyChatTemplate(question))
+     * The tokens before <image> depend only on the system prompt, so every
+     * question shares the prefix CameraVisionEngine keeps KV-cached.
+     */
+    std::vector<int64_t> EncodeChatPrompt(std::string_view question) const {
+        return Encode(ApplyChatTemplate(question));
+    }
+
+    /**
+     * @brief Append one token's vocabulary text to out as the bytes it encodes
+     */
+    static void AppendTokenText(std::string& out, std::string_view tokenText);
+
+    /**
+     * @brief Incremental Decode() for streaming: one token at a time
+     *
+     * Byte-level BPE splits multi-byte UTF-8 characters across tokens, so a
+     * token can end mid-character. Push() only releases whole characters and
+     * holds the trailing partial bytes back until the next token completes
+     * them. Text() is Decode() of the tokens pushed so far, minus that tail.
+     *
+     * Usage:
+     *   FastVLMTokenizer::StreamDecoder stream(tokenizer);
+     *   for (int64_t id : generated) { std::string_view added = stream.Push(id); ... }
+     */
+    class StreamDecoder {
+    public:
+        explicit StreamDecoder(const FastVLMTokenizer& tokenizer) : tokenizer(tokenizer) {}
+
+        // Append one token; returns the text it completed (valid until the next call)
+        std::string_view Push(int64_t tokenId);
+
+        // Whole characters decoded so far
+        std::string_view Text() const { return std::string_view(text.data(), complete); }
+
+        // True once EOS was pushed (later tokens are ignored, like Decode())
+        bool Finished() const { return finished; }
+
+        void Reset();
+
+    private:
+        const FastVLMTokenizer& tokenizer;
+        std::string text;               // Decoded bytes, possibly ending mid-character
+        size_t complete = 0;            // Bytes of text that form whole characters
+        bool finished = false;
+    };
+
+    /**
+     * @brief Text for a single token ID (empty if unknown)
+     */
+    std::string_view GetToken(int64_t tokenId) const;
+
+    /**
+     * @brief Check if a vocabulary has been loaded
+     */
+    bool IsLoaded() const { return numIds_ > 0; }
+
+    /**
+     * @brief Check if the vocabulary is served from a memory-mapped vocab.bin
+     */
+    bool IsMapped() const { return mappedView_ != nullptr; }
+
+    /**
+     * @brief Number of ID slots (highest token ID + 1)
+     */
+    size_t Size() const { return numIds_; }
+
     /**
      * @brief Get pre-tokenized prompt tokens
      * Prompt: "<image>Briefly, what is this?"
@@ -38,17 +199,94 @@ public:
         return {151646, 85984, 398, 11, 1128, 374, 419, 30};
     }
 
+    /**
+     * @brief Prompt in the model's chat template (what the Python client sends)
+     * "<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n<|im_start|>user\n
+     *  <image>\nBriefly, what is this?<|im_end|>\n<|im_start|>assistant\n"
+     * Everything before <image> is constant, so CameraVisionEngine prefills it once.
+     */
+    static std::vector<int64_t> GetChatPromptTokens() {
+        return {151644, 8948, 198, 2610, 525, 264, 10950, 17847, 13, 151645, 198,
+                151644, 872, 198, IMAGE_TOKEN_ID, 198, 85984, 398, 11, 1128, 374, 419, 30, 151645, 198,
+                151644, 77091, 198};
+    }
+
     // Special token IDs
     static constexpr int64_t IMAGE_TOKEN_ID = 151646;
-    static constexpr int64_t EOS_TOKEN_ID = 151645;
+    static constexpr int64_t EOS_TOKEN_ID = 151645;             // <|im_end|>
+    static constexpr int64_t IM_START_TOKEN_ID = 151644;
+    static constexpr int64_t FIRST_SPECIAL_TOKEN_ID = 151643;   // <|endoftext|> and up
+
+    // What GetChatPromptTokens() encodes
+    static constexpr const char* DEFAULT_SYSTEM_PROMPT = "You are a helpful assistant.";
+    static constexpr const char* DEFAULT_QUESTION = "Briefly, what is this?";
 
 private:
-    std::unordered_map<int64_t, std::string> vocab_;
+    struct BinaryHeader {
+        char magic[4];          // "FVOC"
+        uint32_t version;
+        uint32_t numIds;
+        uint32_t blobSize;
+    };
+    static constexpr uint32_t BINARY_VERSION = 1;
+
+    // Token text for ID i is blobData_[offsetsData_[i], offsetsData_[i + 1]);
+    // an empty range means the ID is not in the vocabulary. The views point
+    // either into the owned storage below (JSON load) or into the mapping.
+    const uint32_t* offsetsData_ = nullptr;
+    const char* blobData_ = nullptr;
+    size_t numIds_ = 0;
+
+    // Owned storage (LoadVocab)
+    std::string blob_;
+    std::vector<uint32_t> offsets_;
+
+    // Mapped storage (LoadBinaryVocab)
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+    const void* mappedView_ = nullptr;
+
+    // Encoder (LoadMerges): token text -> ID (views into the vocabulary blob),
+    // (left << 32 | right) -> merge, and the token for each single byte
+    struct Merge {
+        int32_t rank;
+        int32_t id;
+    };
+    std::unordered_map<std::string_view, int32_t> tokenIds_;
+    std::unordered_map<uint64_t, Merge> mergeRanks_;
+    int32_t byteTokens_[256] = {};
+
+    // Merged words, most recently used first; keys view the list's strings
+    static constexpr size_t WORD_CACHE_CAPACITY = 4096;
+    using WordEntry = std::pair<std::string, std::vector<int32_t>>;
+    mutable std::mutex wordCacheMutex_;
+    mutable std::list<WordEntry> wordLru_;
+    mutable std::unordered_map<std::string_view, std::list<WordEntry>::iterator> wordCache_;
+
+    /**
+     * @brief Append the BPE tokens of one pre-tokenized word (cached)
+     */
+    void EncodeWord(std::string_view word, std::vector<int64_t>& out) const;
+
+    /**
+     * @brief Merge a word's byte tokens by rank until no pair has a merge
+     */
+    std::vector<int32_t> MergeWord(std::string_view word) const;
+
+    /**
+     * @brief Append the tokens of text that holds no special tokens
+     */
+    void EncodeOrdinary(std::string_view text, std::vector<int64_t>& out) const;
+
+    /**
+     * @brief Drop the current vocabulary and release any mapping
+     */
+    void Reset();
 
     /**
-     * @brief Simple JSON string parser (extracts quoted strings)
+     * @brief Simple JSON string parser (extracts quoted strings into out)
      */
-    std::string ParseJsonString(const std::string& json, size_t& pos);
+    void ParseJsonString(const std::string& json, size_t& pos, std::string& out);
 
     /**
      * @brief Simple JSON number parser
@@ -0,0 +1,268 @@
+#include "FrameCapture.h"
+#include <windows.h>
+#include "CpuBudget.h"
+#include "Log.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include "Watchdog.h"
+
+FrameCapture::FrameCapture()
+    : cameraIndex(-1), requestedBackend(Backend::Auto), activeBackend(Backend::Auto), sourceLockstep(false),
+      nativeWidth(0), nativeHeight(0), mailbox(2), writeSlot(0), readSlot(1), captureFps(DEFAULT_FPS),
+      capturedFrames(0), captureRunning(false), previewEnabled(false) {
+}
+
+const char* FrameCapture::BackendName(Backend backend) {
+    switch (backend) {
+        case Backend::MediaFoundation: return "mf";
+        case Backend::DirectShow: return "dshow";
+        case Backend::OpenCV: return "opencv";
+        case Backend::File: return "file";
+        case Backend::Network: return "network";
+        case Backend::Synthetic: return "synthetic";
+        default: return "auto";
+    }
+}
+
+bool FrameCapture::ParseBackend(const std::string& name, Backend& backend) {
+    for (Backend candidate : {Backend::Auto, Backend::MediaFoundation, Backend::DirectShow, Backend::OpenCV}) {
+        if (name == BackendName(candidate)) {
+            backend = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameCapture::SetSource(const std::string& spec) {
+    auto prefixed = [&spec](const char* prefix) { return spec.rfind(prefix, 0) == 0; };
+    if (prefixed("file:") || prefixed("file-max:")) {
+        sourceLockstep = prefixed("file-max:");
+        sourceUri = spec.substr(spec.find(':') + 1);
+        requestedBackend = Backend::File;
+    } else if (prefixed("network:")) {
+        sourceUri = spec.substr(8);
+        requestedBackend = Backend::Network;
+    } else if (prefixed("rtsp://") || prefixed("rtp://") || prefixed("udp://") ||
+               prefixed("http://") || prefixed("https://")) {
+        sourceUri = spec;
+        requestedBackend = Backend::Network;
+    } else if (spec == "synthetic" || spec == "synthetic-max") {
+        sourceLockstep = spec == "synthetic-max";
+        requestedBackend = Backend::Synthetic;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+FrameCapture::~FrameCapture() {
+    Close();
+}
+
+bool FrameCapture::Open(int index, int width, int height) {
+    Close();
+
+    LOG_INFO("Camera", "Opening camera " << index << " (backend " << BackendName(requestedBackend) << ")...");
+    bool opened = false;
+    switch (requestedBackend) {
+        case Backend::MediaFoundation:
+            opened = OpenMediaFoundation(index, width, height);
+            break;
+        case Backend::DirectShow:
+            opened = OpenOpenCV(index, width, height, cv::CAP_DSHOW);
+            break;
+        case Backend::OpenCV:
+            opened = OpenOpenCV(index, width, height, cv::CAP_ANY);
+            break;
+        case Backend::File: {
+            auto file = std::make_unique<VideoFileSource>(sourceUri, sourceLockstep);
+            if ((opened = file->Open())) {
+                source = std::move(file);
+                activeBackend = Backend::File;
+            }
+            break;
+        }
+        case Backend::Network: {
+            auto stream = std::make_unique<NetworkStreamSource>(sourceUri);
+            if ((opened = stream->Open())) {
+                source = std::move(stream);
+                activeBackend = Backend::Network;
+            }
+            break;
+        }
+        case Backend::Synthetic: {
+            bool native = nativeWidth > 0 && nativeHeight > 0;
+            source = std::make_unique<SyntheticFrameSource>(native ? nativeWidth : width,
+                                                            native ? nativeHeight : height, sourceLockstep);
+            activeBackend = Backend::Synthetic;
+            opened = true;
+            break;
+        }
+        default:
+            opened = OpenMediaFoundation(index, width, height) ||
+                     OpenOpenCV(index, width, height, cv::CAP_DSHOW) ||
+                     OpenOpenCV(index, width, height, cv::CAP_ANY);
+            break;
+    }
+    if (!opened) {
+        LOG_ERROR("Camera", "Failed to open camera " << index);
+        return false;
+    }
+    cameraIndex = index;
+
+    // Continuous capture into the latest-frame mailbox
+    captureRunning.store(true);
+    captureThread = std::thread(&FrameCapture::CaptureThread, this);
+    return true;
+}
+
+bool FrameCapture::OpenMediaFoundation(int index, int width, int height) {
+    auto reader = std::make_unique<MediaFoundationSource>();
+    bool native = nativeWidth > 0 && nativeHeight > 0;
+    if (!reader->Open(index, native ? nativeWidth : width, native ? nativeHeight : height)) {
+        return false;
+    }
+    source = std::move(reader);
+    activeBackend = Backend::MediaFoundation;
+    return true;
+}
+
+bool FrameCapture::OpenOpenCV(int index, int width, int height, int apiPreference) {
+    auto camera = std::make_unique<OpenCvCameraSource>();
+    if (!camera->Open(index, width, height, apiPreference)) {
+        return false;
+    }
+    source = std::move(camera);
+    activeBackend = apiPreference == cv::CAP_DSHOW ? Backend::DirectShow : Backend::OpenCV;
+    return true;
+}
+
+void FrameCapture::Close() {
+    captureRunning.store(false);
+    if (captureThread.joinable()) {
+        captureThread.join();
+    }
+    source.reset();
+    // A closed camera has nothing to show
+    std::lock_guard<std::mutex> lock(previewMutex);
+    preview.reset();
+}
+
+bool FrameCapture::WaitForConsumer() {
+    while (captureRunning.load() && (mailbox.load(std::memory_order_acquire) & FRESH_FRAME)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return captureRunning.load();
+}
+
+// ============================================================================
+// Capture Thread
+// ============================================================================
+
+void FrameCapture::CaptureThread() {
+    LOG_INFO("Camera", "Capture thread " << cameraIndex << " started (" << captureFps.load() << " fps)");
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Capture);
+    TRACE_THREAD("Camera capture");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Camera);
+    Watchdog::Heartbeat heartbeat("camera_capture", "camera", CAPTURE_STALL_MS);
+    HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);   // Media Foundation reads on this thread
+
+    auto nextDecode = std::chrono::steady_clock::now();
+    uint64_t sequence = 0;
+    int consecutiveFailures = 0;
+    const bool lockstep = source->IsLockstep();
+
+    while (captureRunning.load()) {
+        heartbeat.Beat();
+        // Lockstep: every frame is decoded and taken, at the consumer's pace
+        if (lockstep && !WaitForConsumer()) {
+            break;
+        }
+        // grab() every frame so the driver queue never holds stale buffers;
+        // it blocks at the camera's native rate, so this loop mostly sleeps
+        if (!source->Grab()) {
+            if (++consecutiveFailures % 50 == 1) {
+                LOG_ERROR("Camera", "Frame grab failed on camera " << cameraIndex
+                          << " (" << consecutiveFailures << " in a row)");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+        consecutiveFailures = 0;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now < nextDecode && !lockstep) {
+            continue;
+        }
+
+        // Decode only at captureFps; retrieve() reuses the slot's buffer
+        Frame& slot = frameSlots[writeSlot];
+        if (!source->Retrieve(slot.frame) || slot.frame.empty()) {
+            continue;
+        }
+        slot.timestamp = now;
+        slot.sequence = ++sequence;
+        if (previewEnabled.load(std::memory_order_relaxed)) {
+            CopyToPreview(slot);
+        }
+
+        // Publish: hand the filled slot to the mailbox, take back the stale one
+        uint32_t previous = mailbox.exchange(writeSlot | FRESH_FRAME, std::memory_order_acq_rel);
+        writeSlot = previous & SLOT_MASK;
+        capturedFrames++;
+
+        auto interval = std::chrono::duration<double>(1.0 / captureFps.load());
+        nextDecode = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+    }
+
+    if (SUCCEEDED(com)) {
+        CoUninitialize();
+    }
+    LOG_INFO("Camera", "Capture thread " << cameraIndex << " stopped");
+}
+
+void FrameCapture::EnablePreview(bool enable) {
+    previewEnabled.store(enable);
+    if (!enable) {
+        std::lock_guard<std::mutex> lock(previewMutex);
+        preview.reset();
+    }
+}
+
+void FrameCapture::CopyToPreview(const Frame& slot) {
+    std::lock_guard<std::mutex> lock(previewMutex);
+    // A viewer still holding the last copy keeps it: it is immutable once handed out
+    if (!preview || preview.use_count() > 1) {
+        preview = std::make_shared<Frame>();
+    }
+    slot.frame.copyTo(preview->frame);
+    preview->timestamp = slot.timestamp;
+    preview->sequence = slot.sequence;
+}
+
+std::shared_ptr<const FrameCapture::Frame> FrameCapture::GetPreview() const {
+    std::lock_guard<std::mutex> lock(previewMutex);
+    return preview;
+}
+
+const FrameCapture::Frame* FrameCapture::AcquireLatest() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(FIRST_FRAME_TIMEOUT_MS);
+
+    while (true) {
+        if (mailbox.load(std::memory_order_acquire) & FRESH_FRAME) {
+            uint32_t previous = mailbox.exchange(readSlot, std::memory_order_acq_rel);
+            readSlot = previous & SLOT_MASK;
+        }
+
+        // No fresh frame: the slot we already hold is still the latest
+        if (frameSlots[readSlot].sequence != 0) {
+            return &frameSlots[readSlot];
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline || !captureRunning.load()) {
+            return nullptr;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
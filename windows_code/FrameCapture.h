@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "FrameSource.h"
+
+/**
+ * FrameCapture - One camera feeding a latest-frame mailbox
+ *
+ * A dedicated thread drains the driver queue with grab() and decodes
+ * (retrieve) at the configured fps into a triple-buffered mailbox, so a
+ * consumer always takes the freshest frame without blocking on camera I/O.
+ *
+ * Architecture:
+ *   The capture thread owns writeSlot, the consumer owns readSlot, and
+ *   `mailbox` holds the third slot's index plus FRESH_FRAME when it carries
+ *   a frame the consumer hasn't taken yet. Slots swap by atomic exchange only,
+ *   so neither side ever locks or copies.
+ *
+ * Usage:
+ *   FrameCapture capture;
+ *   if (capture.Open(0)) {
+ *       const FrameCapture::Frame* latest = capture.AcquireLatest();
+ *       if (latest) { ... latest->frame ... }
+ *   }
+ *
+ * Backends: Auto tries Media Foundation first (native format negotiated,
+ * decode/convert/scale in MF's video processor, BGRA frames at the native
+ * output size when one is set), then OpenCV on DirectShow like the Python
+ * client, then OpenCV's default backend. Frames are BGR8 from OpenCV and
+ * BGRA8 from Media Foundation.
+ *
+ * Sources other than a camera (SetSource): a video file, a network stream
+ * or a synthetic pattern, through the same FrameSource interface, so the
+ * vision engine can be load-tested on CI hardware or fed from a remote room.
+ *
+ * Single consumer: AcquireLatest() must only be called from one thread.
+ * Viewers that must not take frames from it (a camera preview) read a copy
+ * instead: with EnablePreview() the capture thread also copies each frame it
+ * publishes into a shared preview frame, from any thread via GetPreview().
+ */
+class FrameCapture {
+public:
+    struct Frame {
+        cv::Mat frame;
+        std::chrono::steady_clock::time_point timestamp;
+        uint64_t sequence = 0;                     // 0 = never written
+    };
+
+    static constexpr double DEFAULT_FPS = 2.0;
+    static constexpr int FIRST_FRAME_TIMEOUT_MS = 3000;
+    static constexpr int CAPTURE_STALL_MS = 5000;      // Watchdog timeout for one grab
+
+    enum class Backend { Auto, MediaFoundation, DirectShow, OpenCV, File, Network, Synthetic };
+    static const char* BackendName(Backend backend);
+    static bool ParseBackend(const std::string& name, Backend& backend);   // "auto", "mf", "dshow", "opencv"
+
+    FrameCapture();
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    /**
+     * @brief Open the camera and start the capture thread
+     * @param cameraIndex Camera device index
+     * @param width Requested frame width (smaller = faster)
+     * @param height Requested frame height
+     * @return true if the camera opened
+     */
+    bool Open(int cameraIndex, int width = 320, int height = 240);
+
+    /**
+     * @brief Backend to open with (call before Open; default Auto)
+     */
+    void SetBackend(Backend backend) { requestedBackend = backend; }
+
+    /**
+     * @brief Capture from something other than a camera (call before Open)
+     *
+     * "file:<path>" loops a video file at its own frame rate, "file-max:<path>"
+     * in lockstep with the consumer; rtsp://, rtp://, udp:// and http(s)://
+     * URLs (or an .sdp file as "network:<path>") open a network stream through
+     * FFmpeg; "synthetic" / "synthetic-max" generate a test pattern at Open's
+     * size. Open's camera index then only names the stream in logs.
+     * @return false (and the backend unchanged) if the spec is not one of these
+     */
+    bool SetSource(const std::string& spec);
+    Backend GetBackend() const { return activeBackend; }           // The one Open() ended up using
+
+    /**
+     * @brief Frame size for backends that scale in hardware (call before Open; 0x0 = Open's size)
+     *
+     * Media Foundation delivers frames at exactly this size (e.g. the vision
+     * encoder's 224x224). OpenCV backends ignore it and keep Open's size.
+     */
+    void SetNativeOutputSize(int width, int height) { nativeWidth = width; nativeHeight = height; }
+
+    /**
+     * @brief Stop the capture thread and release the camera
+     */
+    void Close();
+
+    /**
+     * @brief Take the freshest published frame (waits for the first one)
+     * @return Frame owned by the caller until the next call, or nullptr on timeout
+     */
+    const Frame* AcquireLatest();
+
+    /**
+     * @brief Frames decoded per second by the capture thread (default 2)
+     */
+    void SetFps(double fps) { captureFps.store(fps > 0.0 ? fps : DEFAULT_FPS); }
+    double GetFps() const { return captureFps.load(); }
+
+    /**
+     * @brief Keep a copy of the newest frame for GetPreview (off by default)
+     *
+     * One copy per captured frame on the capture thread; the copy's buffer
+     * is reused while no viewer holds it. Disabling drops the copy.
+     */
+    void EnablePreview(bool enable);
+
+    /**
+     * @brief The newest frame copied for previews, from any thread
+     * @return Shared, immutable frame; nullptr before the first one (without EnablePreview, or once closed)
+     */
+    std::shared_ptr<const Frame> GetPreview() const;
+
+    uint64_t GetCapturedFrameCount() const { return capturedFrames.load(); }
+    int GetCameraIndex() const { return cameraIndex; }
+    bool IsRunning() const { return captureRunning.load(); }
+
+private:
+    void CaptureThread();
+
+    static constexpr uint32_t FRESH_FRAME = 0x4;
+    static constexpr uint32_t SLOT_MASK = 0x3;
+
+    // Source (owned by captureThread once Open has started it)
+    std::unique_ptr<FrameSource> source;
+    int cameraIndex;
+    Backend requestedBackend;
+    Backend activeBackend;
+    std::string sourceUri;                  // File path or URL (File, Network)
+    bool sourceLockstep;                    // File, Synthetic: max speed
+    int nativeWidth;
+    int nativeHeight;
+
+    bool OpenMediaFoundation(int index, int width, int height);
+    bool OpenOpenCV(int index, int width, int height, int apiPreference);
+    // Blocks while a lockstep source's last frame is still waiting for the consumer
+    bool WaitForConsumer();
+
+    // Mutex held: copy the slot about to be published into the preview
+    void CopyToPreview(const Frame& slot);
+
+    Frame frameSlots[3];
+    std::atomic<uint32_t> mailbox;
+    uint32_t writeSlot;
+    uint32_t readSlot;
+    std::atomic<double> captureFps;
+    std::atomic<uint64_t> capturedFrames;
+    std::atomic<bool> captureRunning;
+    std::thread captureThread;
+
+    std::atomic<bool> previewEnabled;
+    mutable std::mutex previewMutex;
+    std::shared_ptr<Frame> preview;         // Handed out as const; rewritten only while unshared
+};
@@ -0,0 +1,162 @@
+#include "FrameSource.h"
+#include <algorithm>
+#include <thread>
+#include "Log.h"
+#include "MediaFoundationCamera.h"
+
+// ============================================================================
+// Cameras
+// ============================================================================
+
+MediaFoundationSource::MediaFoundationSource() = default;
+
+MediaFoundationSource::~MediaFoundationSource() = default;
+
+bool MediaFoundationSource::Open(int index, int width, int height) {
+    auto reader = std::make_unique<MediaFoundationCamera>();
+    if (!reader->Open(index, width, height)) {
+        return false;
+    }
+    camera = std::move(reader);
+    return true;
+}
+
+bool MediaFoundationSource::Grab() {
+    return camera->Grab();
+}
+
+bool MediaFoundationSource::Retrieve(cv::Mat& frame) {
+    return camera->Retrieve(frame);
+}
+
+bool OpenCvCameraSource::Open(int index, int width, int height, int api) {
+    if (!camera.open(index, api) || !camera.isOpened()) {
+        return false;
+    }
+    apiPreference = api;
+    camera.set(cv::CAP_PROP_FRAME_WIDTH, width);
+    camera.set(cv::CAP_PROP_FRAME_HEIGHT, height);
+    camera.set(cv::CAP_PROP_BUFFERSIZE, 1);     // Not honored by every backend; grab() drains anyway
+    LOG_INFO("Camera", "OpenCV capture on camera " << index << " (" << Name() << ")");
+    return true;
+}
+
+// ============================================================================
+// Video File
+// ============================================================================
+
+VideoFileSource::VideoFileSource(const std::string& path, bool lockstep)
+    : path(path), lockstep(lockstep), frameInterval(0) {
+}
+
+bool VideoFileSource::Open() {
+    if (!video.open(path) || !video.isOpened()) {
+        LOG_ERROR("Camera", "Cannot open video file " << path);
+        return false;
+    }
+    double fps = video.get(cv::CAP_PROP_FPS);
+    if (!(fps > 0.0)) {
+        fps = 30.0;
+    }
+    frameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / fps));
+    nextFrame = std::chrono::steady_clock::now();
+    LOG_INFO("Camera", "Video file " << path << ": " << video.get(cv::CAP_PROP_FRAME_WIDTH) << "x"
+             << video.get(cv::CAP_PROP_FRAME_HEIGHT) << " @ " << fps << " fps ("
+             << (lockstep ? "lockstep" : "real time") << ", looped)");
+    return true;
+}
+
+bool VideoFileSource::Grab() {
+    // Real time: one frame per frame interval, like a camera's native rate
+    if (!lockstep) {
+        std::this_thread::sleep_until(nextFrame);
+        nextFrame = (std::max)(nextFrame + frameInterval, std::chrono::steady_clock::now() - frameInterval);
+    }
+    if (video.grab()) {
+        return true;
+    }
+    // End of the file: start over, the engine never sees the stream end
+    video.set(cv::CAP_PROP_POS_FRAMES, 0);
+    if (++loops % 100 == 1) {
+        LOG_DEBUG("Camera", "Video file " << path << " looped (" << loops << ")");
+    }
+    return video.grab();
+}
+
+// ============================================================================
+// Network Stream
+// ============================================================================
+
+NetworkStreamSource::NetworkStreamSource(const std::string& url)
+    : url(url) {
+}
+
+bool NetworkStreamSource::Open() {
+    if (!stream.open(url, cv::CAP_FFMPEG) || !stream.isOpened()) {
+        LOG_ERROR("Camera", "Cannot open network stream " << url);
+        return false;
+    }
+    stream.set(cv::CAP_PROP_BUFFERSIZE, 1);
+    failures = 0;
+    LOG_INFO("Camera", "Network stream " << url << ": " << stream.get(cv::CAP_PROP_FRAME_WIDTH) << "x"
+             << stream.get(cv::CAP_PROP_FRAME_HEIGHT));
+    return true;
+}
+
+bool NetworkStreamSource::Grab() {
+    if (stream.isOpened() && stream.grab()) {
+        failures = 0;
+        return true;
+    }
+    // A sender that went away (or a stream FFmpeg gave up on) is reopened;
+    // FrameCapture logs and paces the failed grabs in the meantime
+    if (++failures >= RECONNECT_AFTER_FAILURES) {
+        LOG_WARNING("Camera", "Network stream " << url << " stalled, reconnecting");
+        stream.release();
+        Open();
+        failures = 0;
+    }
+    return false;
+}
+
+// ============================================================================
+// Synthetic
+// ============================================================================
+
+SyntheticFrameSource::SyntheticFrameSource(int width, int height, bool lockstep)
+    : width(width), height(height), lockstep(lockstep), nextFrame(std::chrono::steady_clock::now()) {
+}
+
+bool SyntheticFrameSource::Grab() {
+    if (!lockstep) {
+        std::this_thread::sleep_until(nextFrame);
+        nextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / FPS));
+    }
+    ++sequence;
+    return true;
+}
+
+bool SyntheticFrameSource::Retrieve(cv::Mat& frame) {
+    // Same pixels for the same sequence number: a gradient that scrolls one
+    // pixel per frame, a square crossing the frame every 4 s and the frame
+    // number, so scene changes (and caption cache hits) happen on schedule
+    frame.create(height, width, CV_8UC3);
+    const int shift = static_cast<int>(sequence % 256);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < width; ++x) {
+            row[3 * x + 0] = static_cast<uint8_t>((x + shift) & 0xFF);
+            row[3 * x + 1] = static_cast<uint8_t>((y * 255) / (height > 1 ? height - 1 : 1));
+            row[3 * x + 2] = static_cast<uint8_t>(((x + y) / 2 + 128) & 0xFF);
+        }
+    }
+    const int side = (std::max)(height / 4, 8);
+    const int period = static_cast<int>(FPS * 4);
+    const int left = static_cast<int>((sequence % period) * (width + side) / period) - side;
+    cv::rectangle(frame, cv::Rect(left, height / 2 - side / 2, side, side), cv::Scalar(255, 255, 255), cv::FILLED);
+    cv::putText(frame, std::to_string(sequence), cv::Point(8, height - 8), cv::FONT_HERSHEY_SIMPLEX,
+                0.5, cv::Scalar(0, 0, 0), 1);
+    return true;
+}
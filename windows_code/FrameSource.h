@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+class MediaFoundationCamera;
+
+/**
+ * FrameSource - What a FrameCapture thread reads frames from
+ *
+ * The cv::VideoCapture split: Grab() waits for the next frame at the
+ * source's own rate and holds it, Retrieve() decodes the held frame into a
+ * caller-owned Mat (storage reused frame to frame). FrameCapture drains
+ * Grab() continuously and retrieves at its fps, so every source looks the
+ * same to CameraVisionEngine. Implementations:
+ *
+ *   MediaFoundationSource   a camera through Media Foundation (BGRA)
+ *   OpenCvCameraSource      a camera through OpenCV (DirectShow or default; BGR)
+ *   VideoFileSource         an MP4/AVI/... file, looped, at its own frame
+ *                           rate or lockstep with the consumer
+ *   NetworkStreamSource     RTSP / RTP (SDP) / UDP / HTTP through FFmpeg,
+ *                           reconnecting after a dropped stream
+ *   SyntheticFrameSource    a deterministic moving test pattern
+ *
+ * Lockstep sources (max speed) hand every frame to the consumer: FrameCapture
+ * retrieves each one and waits for it to be taken before grabbing the next,
+ * so a run decodes the same frames however fast the encoder is.
+ *
+ * One thread at a time (the capture thread).
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    virtual const char* Name() const = 0;
+    virtual bool Grab() = 0;
+    virtual bool Retrieve(cv::Mat& frame) = 0;
+    virtual bool IsLockstep() const { return false; }
+};
+
+class MediaFoundationSource : public FrameSource {
+public:
+    MediaFoundationSource();
+    ~MediaFoundationSource() override;
+
+    bool Open(int index, int width, int height);
+
+    const char* Name() const override { return "mf"; }
+    bool Grab() override;
+    bool Retrieve(cv::Mat& frame) override;
+
+private:
+    std::unique_ptr<MediaFoundationCamera> camera;
+};
+
+class OpenCvCameraSource : public FrameSource {
+public:
+    // apiPreference: cv::CAP_DSHOW or cv::CAP_ANY
+    bool Open(int index, int width, int height, int apiPreference);
+
+    const char* Name() const override { return apiPreference == cv::CAP_DSHOW ? "dshow" : "opencv"; }
+    bool Grab() override { return camera.grab(); }
+    bool Retrieve(cv::Mat& frame) override { return camera.retrieve(frame); }
+
+private:
+    cv::VideoCapture camera;
+    int apiPreference = cv::CAP_ANY;
+};
+
+class VideoFileSource : public FrameSource {
+public:
+    VideoFileSource(const std::string& path, bool lockstep);
+
+    bool Open();
+
+    const char* Name() const override { return "file"; }
+    bool Grab() override;
+    bool Retrieve(cv::Mat& frame) override { return video.retrieve(frame); }
+    bool IsLockstep() const override { return lockstep; }
+
+private:
+    std::string path;
+    bool lockstep;
+    cv::VideoCapture video;
+    std::chrono::steady_clock::duration frameInterval;
+    std::chrono::steady_clock::time_point nextFrame;
+    uint64_t loops = 0;
+};
+
+class NetworkStreamSource : public FrameSource {
+public:
+    static constexpr int RECONNECT_AFTER_FAILURES = 50;
+
+    explicit NetworkStreamSource(const std::string& url);
+
+    bool Open();
+
+    const char* Name() const override { return "network"; }
+    bool Grab() override;
+    bool Retrieve(cv::Mat& frame) override { return stream.retrieve(frame); }
+
+private:
+    std::string url;
+    cv::VideoCapture stream;
+    int failures = 0;
+};
+
+class SyntheticFrameSource : public FrameSource {
+public:
+    static constexpr double FPS = 30.0;
+
+    SyntheticFrameSource(int width, int height, bool lockstep);
+
+    const char* Name() const override { return "synthetic"; }
+    bool Grab() override;
+    bool Retrieve(cv::Mat& frame) override;
+    bool IsLockstep() const override { return lockstep; }
+
+private:
+    int width;
+    int height;
+    bool lockstep;
+    uint64_t sequence = 0;
+    std::chrono::steady_clock::time_point nextFrame;
+};
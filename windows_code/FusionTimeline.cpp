@@ -0,0 +1,259 @@
+#include "FusionTimeline.h"
+#include <algorithm>
+#include "JsonWriter.h"
+#include "UtteranceTracer.h"
+
+FusionTimeline::FusionTimeline()
+    : current{}
+    , nextEventId(1)
+    , nextRecordId(1)
+{
+    int64_t epochMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t clockUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    epochOffsetMs = epochMs - clockUs / 1000;
+}
+
+const char* FusionTimeline::ModalityName(Modality modality) {
+    switch (modality) {
+        case Modality::Voice: return "voice";
+        case Modality::App: return "app";
+        case Modality::Camera: return "camera";
+        case Modality::Screen: return "screen";
+        default: return "unknown";
+    }
+}
+
+void FusionTimeline::SetRecordCallback(RecordCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recordCallback = std::move(callback);
+}
+
+void FusionTimeline::Apply(const EventBus::Event* batch, size_t count) {
+    std::vector<Record> fused;
+    RecordCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t nowUs = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const EventBus::Event& event = batch[i];
+            nowUs = (std::max)(nowUs, event.clockUs);
+            if (const auto* transcript = event.As<EventBus::Transcript>()) {
+                if (transcript->systemAudio || transcript->text.empty()) {
+                    continue;
+                }
+                int64_t startUs = 0;
+                int64_t endUs = 0;
+                if (!UtteranceTracer::Instance().GetSpeechSpan(transcript->traceId, startUs, endUs) || endUs < startUs) {
+                    endUs = event.clockUs - static_cast<int64_t>(transcript->latencyMs * 1000.0f);
+                    startUs = endUs;
+                }
+                uint64_t id = Add(Modality::Voice, startUs, endUs, transcript->text, std::string());
+                Event& voice = events[id];
+                voice.speaker = transcript->speaker;
+                fused.push_back(Fuse(id, voice, event.clockUs));
+            } else if (const auto* app = event.As<EventBus::AppSwitch>()) {
+                Replace(Modality::App, event.clockUs, app->app, app->category);
+            } else if (const auto* caption = event.As<EventBus::Caption>()) {
+                // A reused caption is the same scene: the current interval goes on
+                if (!caption->reused && !caption->text.empty()) {
+                    Replace(Modality::Camera, event.clockUs - static_cast<int64_t>(caption->latencyMs * 1000.0f),
+                            caption->text, std::string());
+                }
+            } else if (const auto* screen = event.As<EventBus::ScreenCaption>()) {
+                if (!screen->text.empty()) {
+                    Replace(Modality::Screen, event.clockUs - static_cast<int64_t>(screen->latencyMs * 1000.0f),
+                            screen->text, screen->window);
+                }
+            }
+        }
+        Evict(nowUs);
+
+        for (const Record& record : fused) {
+            records.push_back(record);
+            if (records.size() > MAX_RECORDS) {
+                records.pop_front();
+            }
+        }
+        callback = recordCallback;
+    }
+    if (callback) {
+        for (const Record& record : fused) {
+            callback(record);
+        }
+    }
+}
+
+uint64_t FusionTimeline::Add(Modality modality, int64_t startUs, int64_t endUs, std::string text, std::string detail) {
+    uint64_t id = nextEventId++;
+    index.Insert(startUs, endUs, id);
+    Event& event = events[id];
+    event.modality = modality;
+    event.startUs = startUs;
+    event.endUs = endUs;
+    event.text = std::move(text);
+    event.detail = std::move(detail);
+    order.push_back(id);
+    return id;
+}
+
+void FusionTimeline::Replace(Modality modality, int64_t startUs, std::string text, std::string detail) {
+    uint64_t& open = current[static_cast<size_t>(modality)];
+    auto previous = open ? events.find(open) : events.end();
+    if (previous != events.end()) {
+        Event& event = previous->second;
+        if (event.text == text && event.detail == detail) {
+            return;
+        }
+        // Latency estimates can put the new start before the old one
+        startUs = (std::max)(startUs, event.startUs);
+        index.SetEnd(event.startUs, open, startUs);
+        event.endUs = startUs;
+    }
+    open = Add(modality, startUs, IntervalIndex::OPEN, std::move(text), std::move(detail));
+}
+
+FusionTimeline::Record FusionTimeline::Fuse(uint64_t voiceId, const Event& voice, int64_t nowUs) {
+    Record record;
+    record.id = nextRecordId++;
+    record.timeMs = ToEpochMs(voice.startUs);
+    record.durationMs = (voice.endUs - voice.startUs) / 1000;
+    record.text = voice.text;
+    record.speaker = voice.speaker;
+
+    std::vector<uint64_t> ids;
+    index.Overlapping(voice.startUs, voice.endUs, ids);
+    for (uint64_t id : ids) {
+        auto found = events.find(id);
+        if (id == voiceId || found == events.end()) {
+            continue;
+        }
+        const Event& event = found->second;
+        int64_t endUs = event.endUs == IntervalIndex::OPEN ? (std::max)(nowUs, voice.endUs) : event.endUs;
+        Overlap overlap;
+        overlap.text = event.text;
+        overlap.detail = event.detail;
+        overlap.overlapMs = ((std::min)(voice.endUs, endUs) - (std::max)(voice.startUs, event.startUs)) / 1000;
+        switch (event.modality) {
+            case Modality::App: record.apps.push_back(std::move(overlap)); break;
+            case Modality::Camera: record.captions.push_back(std::move(overlap)); break;
+            case Modality::Screen: record.screens.push_back(std::move(overlap)); break;
+            default: break;
+        }
+    }
+    return record;
+}
+
+void FusionTimeline::Evict(int64_t nowUs) {
+    const int64_t cutoffUs = nowUs - RETENTION_MS * 1000;
+    // Oldest first; the open events of the state modalities are never
+    // evicted and go to the back when the cap reaches them
+    for (size_t rotated = 0; !order.empty() && rotated < order.size();) {
+        uint64_t id = order.front();
+        auto found = events.find(id);
+        if (found == events.end()) {
+            order.pop_front();
+            continue;
+        }
+        const Event& event = found->second;
+        bool open = event.endUs == IntervalIndex::OPEN;
+        if (!(event.endUs < cutoffUs || events.size() > MAX_EVENTS)) {
+            break;
+        }
+        order.pop_front();
+        if (open) {
+            order.push_back(id);
+            rotated++;
+            continue;
+        }
+        index.Remove(event.startUs, id);
+        events.erase(found);
+    }
+}
+
+void FusionTimeline::WriteRecord(JsonWriter& writer, const Record& record) {
+    auto writeOverlaps = [&writer](const char* key, const char* detailKey, const std::vector<Overlap>& overlaps) {
+        writer.Key(key).BeginArray();
+        for (const Overlap& overlap : overlaps) {
+            writer.BeginObject();
+            writer.Key("text").String(overlap.text);
+            if (detailKey) {
+                writer.Key(detailKey).String(overlap.detail);
+            }
+            writer.Key("overlapMs").Int(overlap.overlapMs);
+            writer.EndObject();
+        }
+        writer.EndArray();
+    };
+
+    writer.BeginObject();
+    writer.Key("id").UInt(record.id);
+    writer.Key("timeMs").Int(record.timeMs);
+    writer.Key("durationMs").Int(record.durationMs);
+    writer.Key("text").String(record.text);
+    writer.Key("speaker").Int(record.speaker);
+    writeOverlaps("apps", "category", record.apps);
+    writeOverlaps("captions", nullptr, record.captions);
+    writeOverlaps("screens", "window", record.screens);
+    writer.EndObject();
+}
+
+void FusionTimeline::WriteRecords(JsonWriter& writer, uint64_t sinceId, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    // The newest `limit` after sinceId, written oldest first
+    size_t first = records.size();
+    size_t taken = 0;
+    while (first > 0 && records[first - 1].id > sinceId && taken < limit) {
+        --first;
+        ++taken;
+    }
+    writer.BeginObject();
+    writer.Key("records").BeginArray();
+    for (size_t i = first; i < records.size(); ++i) {
+        WriteRecord(writer, records[i]);
+    }
+    writer.EndArray();
+    writer.Key("lastId").UInt(nextRecordId - 1);
+    writer.EndObject();
+}
+
+void FusionTimeline::WriteEvents(JsonWriter& writer, int64_t fromMs, int64_t toMs) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint64_t> ids;
+    index.Overlapping(ToClockUs(fromMs), ToClockUs(toMs), ids);
+
+    writer.BeginObject();
+    writer.Key("events").BeginArray();
+    size_t written = 0;
+    for (uint64_t id : ids) {
+        auto found = events.find(id);
+        if (found == events.end()) {
+            continue;
+        }
+        if (written++ == MAX_QUERY_EVENTS) {
+            break;
+        }
+        const Event& event = found->second;
+        writer.BeginObject();
+        writer.Key("modality").String(ModalityName(event.modality));
+        writer.Key("startMs").Int(ToEpochMs(event.startUs));
+        writer.Key("endMs");
+        if (event.endUs == IntervalIndex::OPEN) {
+            writer.Null();
+        } else {
+            writer.Int(ToEpochMs(event.endUs));
+        }
+        writer.Key("text").String(event.text);
+        if (!event.detail.empty()) {
+            writer.Key("detail").String(event.detail);
+        }
+        if (event.modality == Modality::Voice) {
+            writer.Key("speaker").Int(event.speaker);
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("truncated").Bool(written > MAX_QUERY_EVENTS);
+    writer.EndObject();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "EventBus.h"
+#include "IntervalIndex.h"
+
+class JsonWriter;
+
+/**
+ * FusionTimeline - Every modality on one clock, joined per utterance
+ *
+ * fusedContext pairs the latest transcription with the latest caption and
+ * app, whenever each arrived. This keeps the last RETENTION_MS of events of
+ * every modality as intervals on one clock - the steady clock, QPC-based on
+ * Windows, which EventBus stamps on every event (Event::clockUs) and
+ * UtteranceTracer uses for speech frames - in an IntervalIndex, so "what
+ * was on screen while this was said" is an O(log n + k) overlap query for k hits:
+ *
+ *   Voice    first to last speech frame (UtteranceTracer, by the
+ *            transcript's trace id); without a trace, the instant the
+ *            audio ended (arrival minus whisper latency)
+ *   App      from the switch until the next one
+ *   Camera   from the captured frame (arrival minus caption latency) until
+ *            the next caption; reused captions extend the current one
+ *   Screen   the foreground window's caption, the same way
+ *
+ * As each utterance's transcript arrives a fused Record is built - the
+ * utterance and every app, caption and screen interval overlapping it,
+ * with how long each overlapped - kept (the last MAX_RECORDS, for
+ * /timeline) and handed to the record callback. Captions finishing after
+ * the transcript don't join its record; they are still in the index for
+ * later queries.
+ *
+ * Usage:
+ *   FusionTimeline timeline;
+ *   bus.Subscribe(options, [&](const EventBus::Event* events, size_t count) { timeline.Apply(events, count); });
+ *   timeline.WriteRecords(writer, sinceId, limit);
+ *   timeline.WriteEvents(writer, fromMs, toMs);
+ *
+ * Thread-safe (one mutex; the bus delivers on one task at a time).
+ */
+class FusionTimeline {
+public:
+    static constexpr int64_t RETENTION_MS = 30 * 60 * 1000;
+    static constexpr size_t MAX_EVENTS = 20000;         // Whatever RETENTION_MS says
+    static constexpr size_t MAX_RECORDS = 200;
+    static constexpr size_t MAX_QUERY_EVENTS = 1000;    // Per WriteEvents
+
+    enum class Modality : uint8_t { Voice, App, Camera, Screen, Count };
+    static const char* ModalityName(Modality modality);
+
+    // An event and how long it overlapped the record's utterance
+    struct Overlap {
+        std::string text;
+        std::string detail;             // App category, screen window
+        int64_t overlapMs = 0;
+    };
+
+    struct Record {
+        uint64_t id = 0;                // Increasing
+        int64_t timeMs = 0;             // Unix epoch ms of the first speech frame
+        int64_t durationMs = 0;
+        std::string text;
+        int speaker = -1;
+        std::vector<Overlap> apps;      // Each by start
+        std::vector<Overlap> captions;
+        std::vector<Overlap> screens;
+    };
+
+    using RecordCallback = std::function<void(const Record& record)>;
+
+    FusionTimeline();
+
+    FusionTimeline(const FusionTimeline&) = delete;
+    FusionTimeline& operator=(const FusionTimeline&) = delete;
+
+    // Transcript, AppSwitch, Caption and ScreenCaption events; the rest are ignored
+    void Apply(const EventBus::Event* events, size_t count);
+
+    // Called under no lock, on the bus task, once per record
+    void SetRecordCallback(RecordCallback callback);
+
+    // {"records":[...]}: records after sinceId, oldest first, the newest `limit`
+    void WriteRecords(JsonWriter& writer, uint64_t sinceId, size_t limit) const;
+    static void WriteRecord(JsonWriter& writer, const Record& record);
+
+    // {"events":[...]}: events of every modality overlapping [fromMs, toMs] (epoch ms)
+    void WriteEvents(JsonWriter& writer, int64_t fromMs, int64_t toMs) const;
+
+private:
+    struct Event {
+        Modality modality;
+        int64_t startUs;
+        int64_t endUs;                  // IntervalIndex::OPEN while current
+        std::string text;
+        std::string detail;
+        int speaker = -1;
+    };
+
+    // mutex held
+    uint64_t Add(Modality modality, int64_t startUs, int64_t endUs, std::string text, std::string detail);
+    void Replace(Modality modality, int64_t startUs, std::string text, std::string detail);
+    Record Fuse(uint64_t voiceId, const Event& voice, int64_t nowUs);
+    void Evict(int64_t nowUs);
+
+    // Steady clock microseconds to Unix epoch ms (the offset taken at construction)
+    int64_t ToEpochMs(int64_t clockUs) const { return clockUs / 1000 + epochOffsetMs; }
+    int64_t ToClockUs(int64_t epochMs) const { return (epochMs - epochOffsetMs) * 1000; }
+
+    mutable std::mutex mutex;
+    IntervalIndex index;
+    std::unordered_map<uint64_t, Event> events;
+    std::deque<uint64_t> order;                         // Ids, oldest first
+    uint64_t current[static_cast<size_t>(Modality::Count)];    // Open event per state modality; 0: none
+    uint64_t nextEventId;
+    int64_t epochOffsetMs;
+
+    std::deque<Record> records;
+    uint64_t nextRecordId;
+    RecordCallback recordCallback;
+};
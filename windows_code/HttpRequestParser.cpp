@@ -0,0 +1,254 @@
+#include "HttpRequestParser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static std::string_view Trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+// A non-empty run of digits in `base` (10 or 16) no larger than `limit`: no
+// sign, whitespace or "0x" prefix, which strtoull would let through
+static bool ParseSize(std::string_view text, int base, size_t limit, size_t& value) {
+    if (text.empty()) {
+        return false;
+    }
+    value = 0;
+    for (char c : text) {
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (base == 16 && c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        if (value > (limit - digit) / base) {
+            return false;
+        }
+        value = value * base + digit;
+    }
+    return true;
+}
+
+static std::string ToLower(std::string_view value) {
+    std::string lower(value);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lower;
+}
+
+std::string HttpRequest::DecodeQueryValue(std::string_view value) {
+    auto hex = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    };
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            decoded += ' ';
+        } else if (value[i] == '%' && i + 2 < value.size() && hex(value[i + 1]) >= 0 && hex(value[i + 2]) >= 0) {
+            decoded += static_cast<char>(hex(value[i + 1]) * 16 + hex(value[i + 2]));
+            i += 2;
+        } else {
+            decoded += value[i];
+        }
+    }
+    return decoded;
+}
+
+bool HttpRequest::AcceptsEncoding(const std::string& coding) const {
+    std::string acceptEncoding = ToLower(GetHeader("accept-encoding"));
+
+    // Comma-separated codings, each optionally ";q=..."; q=0 means refused
+    size_t start = 0;
+    while (start < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', start);
+        if (end == std::string::npos) {
+            end = acceptEncoding.size();
+        }
+        std::string item = acceptEncoding.substr(start, end - start);
+        start = end + 1;
+
+        size_t first = item.find_first_not_of(" \t");
+        if (first == std::string::npos) {
+            continue;
+        }
+        size_t semicolon = item.find(';', first);
+        std::string name = item.substr(first, semicolon == std::string::npos ? std::string::npos : semicolon - first);
+        name.erase(name.find_last_not_of(" \t") + 1);
+
+        if (name == coding) {
+            size_t quality = semicolon == std::string::npos ? std::string::npos : item.find("q=", semicolon);
+            return quality == std::string::npos || std::strtod(item.c_str() + quality + 2, nullptr) > 0.0;
+        }
+    }
+    return false;
+}
+
+void HttpRequestParser::Reset() {
+    state = State::Headers;
+    scanned = 0;
+    bodyStart = 0;
+    contentLength = 0;
+    chunkOffset = 0;
+    chunkRemaining = 0;
+}
+
+HttpRequestParser::Result HttpRequestParser::Parse(std::string_view data, HttpRequest& request, size_t& consumed) {
+    if (state == State::Headers) {
+        // Resume the terminator search just before where the last call stopped
+        size_t from = scanned >= 3 ? scanned - 3 : 0;
+        size_t headerEnd = data.find("\r\n\r\n", from);
+        if (headerEnd == std::string_view::npos) {
+            scanned = data.size();
+            return data.size() > MAX_HEADER_BYTES ? Result::Error : Result::Incomplete;
+        }
+
+        request = HttpRequest();
+        if (!ParseHead(data.substr(0, headerEnd), request)) {
+            return Result::Error;
+        }
+        bodyStart = headerEnd + 4;
+
+        // Both framings at once is how requests are smuggled past a proxy
+        std::string transferEncoding = ToLower(request.GetHeader("transfer-encoding"));
+        std::string length = request.GetHeader("content-length");
+        if (!transferEncoding.empty() && request.headers.count("content-length") != 0) {
+            return Result::Error;
+        }
+        if (transferEncoding.find("chunked") != std::string::npos) {
+            state = State::ChunkSize;
+            chunkOffset = bodyStart;
+        } else {
+            contentLength = 0;
+            if (request.headers.count("content-length") != 0 && !ParseSize(length, 10, maxBodyBytes, contentLength)) {
+                return Result::Error;
+            }
+            state = State::FixedBody;
+        }
+    }
+
+    if (state == State::FixedBody) {
+        if (data.size() < bodyStart + contentLength) {
+            return Result::Incomplete;
+        }
+        request.body.assign(data.data() + bodyStart, contentLength);
+        consumed = bodyStart + contentLength;
+        Reset();
+        return Result::Complete;
+    }
+
+    return ParseChunked(data, request, consumed);
+}
+
+bool HttpRequestParser::ParseHead(std::string_view head, HttpRequest& request) {
+    size_t lineEnd = head.find("\r\n");
+    std::string_view requestLine = head.substr(0, lineEnd);
+
+    // "METHOD SP PATH SP VERSION"
+    size_t firstSpace = requestLine.find(' ');
+    if (firstSpace == std::string_view::npos || firstSpace == 0) {
+        return false;
+    }
+    size_t secondSpace = requestLine.find(' ', firstSpace + 1);
+    request.method = std::string(requestLine.substr(0, firstSpace));
+    if (secondSpace == std::string_view::npos) {
+        request.path = std::string(requestLine.substr(firstSpace + 1));
+        request.version = "HTTP/1.0";
+    } else {
+        request.path = std::string(requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1));
+        request.version = std::string(Trim(requestLine.substr(secondSpace + 1)));
+    }
+    if (request.path.empty()) {
+        return false;
+    }
+    size_t queryStart = request.path.find('?');
+    if (queryStart != std::string::npos) {
+        request.query = request.path.substr(queryStart + 1);
+        request.path.erase(queryStart);
+    }
+
+    size_t lineStart = (lineEnd == std::string_view::npos) ? head.size() : lineEnd + 2;
+    while (lineStart < head.size()) {
+        size_t next = head.find("\r\n", lineStart);
+        if (next == std::string_view::npos) {
+            next = head.size();
+        }
+        std::string_view line = head.substr(lineStart, next - lineStart);
+        lineStart = next + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0) {
+            return false;
+        }
+
+        std::string name = ToLower(Trim(line.substr(0, colon)));
+        std::string_view value = Trim(line.substr(colon + 1));
+        auto it = request.headers.find(name);
+        if (it == request.headers.end()) {
+            request.headers.emplace(std::move(name), std::string(value));
+        } else {
+            it->second.append(", ").append(value.data(), value.size());
+        }
+    }
+
+    // HTTP/1.1 persists by default, HTTP/1.0 only when asked
+    std::string connection = ToLower(request.GetHeader("connection"));
+    keepAlive = request.version != "HTTP/1.0";
+    if (connection.find("close") != std::string::npos) {
+        keepAlive = false;
+    } else if (connection.find("keep-alive") != std::string::npos) {
+        keepAlive = true;
+    }
+    return true;
+}
+
+HttpRequestParser::Result HttpRequestParser::ParseChunked(std::string_view data, HttpRequest& request,
+                                                          size_t& consumed) {
+    while (true) {
+        if (state == State::ChunkData) {
+            // Chunk payload plus its trailing CRLF
+            if (data.size() < chunkOffset + chunkRemaining + 2) {
+                return Result::Incomplete;
+            }
+            if (data.substr(chunkOffset + chunkRemaining, 2) != "\r\n") {
+                return Result::Error;
+            }
+            request.body.append(data.data() + chunkOffset, chunkRemaining);
+            chunkOffset += chunkRemaining + 2;
+            chunkRemaining = 0;
+            state = State::ChunkSize;
+        }
+
+        size_t lineEnd = data.find("\r\n", chunkOffset);
+        if (lineEnd == std::string_view::npos) {
+            return data.size() - chunkOffset > MAX_HEADER_BYTES ? Result::Error : Result::Incomplete;
+        }
+        std::string_view line = data.substr(chunkOffset, lineEnd - chunkOffset);
+        chunkOffset = lineEnd + 2;
+
+        if (state == State::Trailers) {
+            if (line.empty()) {
+                consumed = chunkOffset;
+                Reset();
+                return Result::Complete;
+            }
+            continue;       // Trailer fields are ignored
+        }
+
+        // Chunk size in hex, optionally followed by whitespace and ";extensions"
+        std::string_view size = line.substr(0, line.find(';'));
+        while (!size.empty() && (size.back() == ' ' || size.back() == '\t')) size.remove_suffix(1);
+        size_t parsed = 0;
+        if (!ParseSize(size, 16, maxBodyBytes - request.body.size(), parsed)) {
+            return Result::Error;
+        }
+
+        if (parsed == 0) {
+            state = State::Trailers;
+        } else {
+            chunkRemaining = parsed;
+            state = State::ChunkData;
+        }
+    }
+}
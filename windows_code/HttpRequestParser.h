@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+
+struct HttpRequest {
+    std::string method;
+    std::string path;                               // Without the query string
+    std::string query;                              // After '?', undecoded ("" if none)
+    std::string version;                            // "HTTP/1.1", "HTTP/1.0"
+    std::map<std::string, std::string> headers;     // Lowercase names; repeats joined with ", "
+    std::string body;
+    std::string remoteAddress;                      // Peer IP, set by the server ("" if unknown)
+
+    // Header value, or "" when absent (name must be lowercase)
+    std::string GetHeader(const std::string& name) const {
+        auto it = headers.find(name);
+        return it != headers.end() ? it->second : std::string();
+    }
+
+    // Value of `name` in the query string, or "" when absent (no percent-decoding)
+    std::string GetQueryParam(const std::string& name) const {
+        size_t start = 0;
+        while (start <= query.size()) {
+            size_t end = query.find('&', start);
+            if (end == std::string::npos) {
+                end = query.size();
+            }
+            size_t equals = query.find('=', start);
+            if (equals != std::string::npos && equals < end && query.compare(start, equals - start, name) == 0 &&
+                equals - start == name.size()) {
+                return query.substr(equals + 1, end - equals - 1);
+            }
+            start = end + 1;
+        }
+        return std::string();
+    }
+
+    // A query value with %XX escapes and '+' decoded (malformed escapes kept as-is)
+    static std::string DecodeQueryValue(std::string_view value);
+
+    // Whether Accept-Encoding lists `coding` without refusing it (q=0)
+    bool AcceptsEncoding(const std::string& coding) const;
+};
+
+/**
+ * HttpRequestParser - Incremental HTTP/1.x request parser
+ *
+ * Works on string_view spans over the connection's receive buffer and keeps
+ * its scan positions between calls, so each read only looks at the new bytes
+ * and headers are never re-split. Bodies framed by Content-Length are copied
+ * once, straight from the buffer into HttpRequest::body; chunked bodies are
+ * decoded into it chunk by chunk as they complete.
+ *
+ * Framing is read strictly: Content-Length is decimal digits only and a
+ * chunk size hex digits only (no sign, whitespace or "0x"), and a request
+ * with both Transfer-Encoding and Content-Length is an Error rather than
+ * one of them winning, as a proxy in front might have picked the other.
+ *
+ * Usage:
+ *   // buffer only grows between calls until a request completes
+ *   size_t consumed = 0;
+ *   if (parser.Parse(buffer, request, consumed) == HttpRequestParser::Result::Complete) {
+ *       Handle(request);
+ *       buffer.erase(0, consumed);          // parser is reset for the next request
+ *   }
+ *
+ * Offsets are relative to the start of the request, so the caller must keep
+ * the incomplete request at the start of the span it passes in, and pass the
+ * same HttpRequest each time (chunked bodies accumulate in it).
+ */
+class HttpRequestParser {
+public:
+    enum class Result { Incomplete, Complete, Error };
+
+    static constexpr size_t MAX_HEADER_BYTES = 64 * 1024;
+
+    explicit HttpRequestParser(size_t maxBodyBytes = 1024 * 1024) : maxBodyBytes(maxBodyBytes) {}
+
+    /**
+     * @brief Continue parsing the request at the start of data
+     * @param request Filled in as the request is parsed (complete on Result::Complete)
+     * @param consumed Total bytes of the request when Complete
+     */
+    Result Parse(std::string_view data, HttpRequest& request, size_t& consumed);
+
+    // Whether the connection persists after the last completed request
+    bool KeepAlive() const { return keepAlive; }
+
+    void Reset();
+
+private:
+    enum class State { Headers, FixedBody, ChunkSize, ChunkData, Trailers };
+
+    bool ParseHead(std::string_view head, HttpRequest& request);
+    Result ParseChunked(std::string_view data, HttpRequest& request, size_t& consumed);
+
+    size_t maxBodyBytes;
+    State state = State::Headers;
+    size_t scanned = 0;             // Bytes already searched for the header terminator
+    size_t bodyStart = 0;
+    size_t contentLength = 0;
+    size_t chunkOffset = 0;         // Start of the next chunk-size line or trailer
+    size_t chunkRemaining = 0;
+    bool keepAlive = true;
+};
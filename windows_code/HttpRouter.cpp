@@ -0,0 +1,422 @@
+#include "HttpRouter.h"
+#include "Deflate.h"
+#include "Log.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+// Seeds tried per table size before the table doubles
+static constexpr uint64_t MAX_SEEDS = 4096;
+
+std::string_view HttpRouter::Params::Get(std::string_view name) const {
+    for (size_t index = 0; index < count; ++index) {
+        if (items[index].first == name) {
+            return items[index].second;
+        }
+    }
+    return std::string_view();
+}
+
+HttpRouter::RouteBuilder& HttpRouter::RouteBuilder::Use(Middleware middleware) {
+    router.routes[route].middleware.push_back(std::move(middleware));
+    return *this;
+}
+
+HttpRouter::RouteBuilder HttpRouter::Add(Method method, const std::string& pattern, Handler handler) {
+    return Add(method, pattern, [handler = std::move(handler)](const HttpRequest& request, HttpResponse& response,
+                                                               const Params&) {
+        handler(request, response);
+    });
+}
+
+HttpRouter::RouteBuilder HttpRouter::Add(Method method, const std::string& pattern, ParamHandler handler) {
+    routes.push_back({method, pattern, std::move(handler), {}});
+    compiled = false;
+    return RouteBuilder(*this, routes.size() - 1);
+}
+
+void HttpRouter::Use(Middleware middleware) {
+    global.push_back(std::move(middleware));
+}
+
+bool HttpRouter::ParseMethod(std::string_view name, Method& method) {
+    switch (name.size()) {
+        case 3:
+            if (name == "GET") { method = Method::Get; return true; }
+            if (name == "PUT") { method = Method::Put; return true; }
+            return false;
+        case 4:
+            if (name == "POST") { method = Method::Post; return true; }
+            return false;
+        case 5:
+            if (name == "PATCH") { method = Method::Patch; return true; }
+            return false;
+        case 6:
+            if (name == "DELETE") { method = Method::Delete; return true; }
+            return false;
+        default:
+            return false;
+    }
+}
+
+const char* HttpRouter::MethodName(Method method) {
+    switch (method) {
+        case Method::Get:    return "GET";
+        case Method::Post:   return "POST";
+        case Method::Put:    return "PUT";
+        case Method::Delete: return "DELETE";
+        case Method::Patch:  return "PATCH";
+        default:             return "UNKNOWN";
+    }
+}
+
+// FNV-1a, seeded
+uint64_t HttpRouter::Hash(std::string_view text, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+bool HttpRouter::IsPattern(std::string_view path) {
+    return path.find('{') != std::string_view::npos;
+}
+
+bool HttpRouter::Compile() {
+    entries.clear();
+    trie.assign(1, TrieNode());
+
+    // One entry per distinct path, holding its route per method
+    std::map<std::string, int> byPattern;
+    for (size_t index = 0; index < routes.size(); ++index) {
+        const Route& route = routes[index];
+        auto found = byPattern.find(route.pattern);
+        int entry;
+        if (found == byPattern.end()) {
+            entry = static_cast<int>(entries.size());
+            PathEntry added;
+            added.pattern = route.pattern;
+            added.routes.fill(-1);
+            entries.push_back(std::move(added));
+            byPattern.emplace(route.pattern, entry);
+        } else {
+            entry = found->second;
+        }
+        int& slot = entries[entry].routes[static_cast<size_t>(route.method)];
+        if (slot >= 0) {
+            LOG_ERROR("Router", "Duplicate route " << MethodName(route.method) << " " << route.pattern);
+            return false;
+        }
+        slot = static_cast<int>(index);
+    }
+    for (PathEntry& entry : entries) {
+        for (size_t method = 0; method < entry.routes.size(); ++method) {
+            if (entry.routes[method] >= 0) {
+                entry.allow += (entry.allow.empty() ? "" : ", ");
+                entry.allow += MethodName(static_cast<Method>(method));
+            }
+        }
+    }
+
+    // Literal paths: search a seed that gives every path its own slot
+    std::vector<int> literals;
+    for (size_t index = 0; index < entries.size(); ++index) {
+        if (IsPattern(entries[index].pattern)) {
+            InsertPattern(entries[index].pattern, static_cast<int>(index));
+        } else {
+            literals.push_back(static_cast<int>(index));
+        }
+    }
+    size_t tableSize = 8;
+    while (tableSize < literals.size() * 2) {
+        tableSize *= 2;
+    }
+    for (;;) {
+        for (uint64_t candidate = 1; candidate <= MAX_SEEDS; ++candidate) {
+            slots.assign(tableSize, -1);
+            bool collided = false;
+            for (int entry : literals) {
+                int& slot = slots[Hash(entries[entry].pattern, candidate) & (tableSize - 1)];
+                if (slot >= 0) {
+                    collided = true;
+                    break;
+                }
+                slot = entry;
+            }
+            if (!collided) {
+                seed = candidate;
+                compiled = true;
+                LOG_DEBUG("Router", routes.size() << " routes, " << literals.size() << " literal paths in "
+                          << tableSize << " slots (seed " << seed << "), " << (trie.size() - 1) << " pattern nodes");
+                return true;
+            }
+        }
+        tableSize *= 2;
+    }
+}
+
+void HttpRouter::InsertPattern(const std::string& pattern, int entry) {
+    size_t node = 0;
+    std::string_view rest(pattern);
+    while (!rest.empty()) {
+        rest.remove_prefix(rest.front() == '/' ? 1 : 0);
+        size_t end = rest.find('/');
+        std::string_view segment = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end);
+
+        if (segment.size() >= 2 && segment.front() == '{' && segment.back() == '}') {
+            if (trie[node].param == 0) {
+                trie[node].param = trie.size();
+                trie[node].paramName = std::string(segment.substr(1, segment.size() - 2));
+                trie.emplace_back();
+            }
+            node = trie[node].param;
+            continue;
+        }
+        size_t child = 0;
+        for (const auto& literal : trie[node].literals) {
+            if (literal.first == segment) {
+                child = literal.second;
+            }
+        }
+        if (child == 0) {
+            child = trie.size();
+            trie[node].literals.emplace_back(std::string(segment), child);
+            trie.emplace_back();
+        }
+        node = child;
+    }
+    trie[node].entry = entry;
+}
+
+bool HttpRouter::MatchTrie(size_t node, std::string_view rest, Params& params, int& entry) const {
+    if (rest.empty()) {
+        entry = trie[node].entry;
+        return entry >= 0;
+    }
+    rest.remove_prefix(rest.front() == '/' ? 1 : 0);
+    size_t end = rest.find('/');
+    std::string_view segment = rest.substr(0, end);
+    std::string_view after = end == std::string_view::npos ? std::string_view() : rest.substr(end);
+
+    // A literal segment wins over a parameter; backtrack to the parameter if its subtree misses
+    for (const auto& literal : trie[node].literals) {
+        if (literal.first == segment && MatchTrie(literal.second, after, params, entry)) {
+            return true;
+        }
+    }
+    if (trie[node].param != 0 && !segment.empty() && params.count < MAX_PARAMS) {
+        size_t saved = params.count;
+        params.items[params.count++] = {trie[node].paramName, segment};
+        if (MatchTrie(trie[node].param, after, params, entry)) {
+            return true;
+        }
+        params.count = saved;
+    }
+    return false;
+}
+
+int HttpRouter::FindLiteral(std::string_view path) const {
+    if (slots.empty()) {
+        return -1;
+    }
+    int entry = slots[Hash(path, seed) & (slots.size() - 1)];
+    return entry >= 0 && entries[entry].pattern == path ? entry : -1;
+}
+
+int HttpRouter::FindPattern(std::string_view path, Params& params) const {
+    int entry = -1;
+    return trie.size() > 1 && MatchTrie(0, path, params, entry) ? entry : -1;
+}
+
+bool HttpRouter::Dispatch(const HttpRequest& request, HttpResponse& response) const {
+    if (!compiled) {
+        return false;
+    }
+    Method method;
+    bool known = ParseMethod(request.method, method);
+    auto routeFor = [&](int entry) {
+        return known && entry >= 0 ? entries[entry].routes[static_cast<size_t>(method)] : -1;
+    };
+
+    // A literal path wins; a pattern still matches methods the literal doesn't have
+    Params params;
+    int literal = FindLiteral(request.path);
+    int route = routeFor(literal);
+    int pattern = -1;
+    if (route < 0) {
+        pattern = FindPattern(request.path, params);
+        route = routeFor(pattern);
+    }
+    if (route < 0) {
+        if (literal < 0 && pattern < 0) {
+            return false;
+        }
+        response.SetHeader("Allow", entries[literal >= 0 ? literal : pattern].allow);
+        response.SetHeader("Content-Type", "application/json");
+        response.SetBody("{\"error\":\"Method not allowed\"}");
+        response.status = 405;
+        return true;
+    }
+    RunChain(routes[route], 0, request, response, params);
+    return true;
+}
+
+void HttpRouter::RunChain(const Route& route, size_t index, const HttpRequest& request, HttpResponse& response,
+                          const Params& params) const {
+    size_t total = global.size() + route.middleware.size();
+    if (index == total) {
+        route.handler(request, response, params);
+        return;
+    }
+    const Middleware& middleware = index < global.size() ? global[index] : route.middleware[index - global.size()];
+    middleware(request, response, [this, &route, index, &request, &response, &params]() {
+        RunChain(route, index + 1, request, response, params);
+    });
+}
+
+HttpRouter::Middleware HttpRouter::Metrics(const std::string& label) {
+    metrics.push_back(std::make_unique<RouteMetrics>());
+    RouteMetrics* target = metrics.back().get();
+    target->label = label;
+    return [target](const HttpRequest&, HttpResponse& response, const Next& next) {
+        auto start = std::chrono::steady_clock::now();
+        next();
+        // A deferred request is measured until its answer, not until the handler returned
+        auto record = [target, start](HttpResponse& answer) {
+            target->latency.RecordMs(
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            if (answer.status >= 500) {
+                target->serverErrors.fetch_add(1, std::memory_order_relaxed);
+            } else if (answer.status >= 400) {
+                target->clientErrors.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+        if (response.IsDeferred()) {
+            response.completion->OnComplete(record);
+        } else {
+            record(response);
+        }
+    };
+}
+
+HttpRouter::Middleware HttpRouter::Cache(int ttlMs, size_t maxEntries) {
+    struct Entry {
+        std::chrono::steady_clock::time_point expires;
+        std::map<std::string, std::string> headers;
+        std::shared_ptr<const std::string> body;
+    };
+    struct State {
+        std::mutex mutex;
+        std::map<std::string, Entry> entries;
+    };
+    auto state = std::make_shared<State>();
+    std::chrono::milliseconds ttl(ttlMs);
+
+    return [state, ttl, maxEntries](const HttpRequest& request, HttpResponse& response, const Next& next) {
+        if (request.method != "GET") {
+            next();
+            return;
+        }
+        std::string key = request.query + '\n' + request.GetHeader("accept") + '\n' +
+                          request.GetHeader("accept-encoding");
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            auto found = state->entries.find(key);
+            if (found != state->entries.end() && found->second.expires > now) {
+                response.headers = found->second.headers;
+                response.SetSharedBody(found->second.body);
+                response.status = 200;
+                return;
+            }
+        }
+
+        next();
+        if (response.IsDeferred() || response.status != 200 || !response.eventStream.empty()) {
+            return;     // Deferred answers aren't cached: they are slow by nature, not repeated
+        }
+        // The response and the cache share one copy of the body
+        if (!response.sharedBody) {
+            response.SetSharedBody(std::make_shared<const std::string>(std::move(response.body)));
+        }
+        std::lock_guard<std::mutex> lock(state->mutex);
+        for (auto it = state->entries.begin(); it != state->entries.end();) {
+            it = it->second.expires <= now ? state->entries.erase(it) : std::next(it);
+        }
+        if (state->entries.size() >= maxEntries) {
+            state->entries.clear();
+        }
+        state->entries[key] = {now + ttl, response.headers, response.sharedBody};
+    };
+}
+
+HttpRouter::Middleware HttpRouter::Compress(size_t minBytes) {
+    return [minBytes](const HttpRequest& request, HttpResponse& response, const Next& next) {
+        next();
+        // Decided now: the request is gone by the time a deferred answer arrives
+        bool gzip = request.AcceptsEncoding("gzip");
+        bool deflate = request.AcceptsEncoding("deflate");
+        auto compress = [minBytes, gzip, deflate](HttpResponse& answer) {
+            if (answer.status != 200 || !answer.eventStream.empty() || answer.GetBodySize() < minBytes ||
+                answer.headers.count("Content-Encoding")) {
+                return;
+            }
+            answer.SetHeader("Vary", "Accept-Encoding");
+            Deflate::Container container;
+            if (gzip) {
+                container = Deflate::Container::Gzip;
+                answer.SetHeader("Content-Encoding", "gzip");
+            } else if (deflate) {
+                container = Deflate::Container::Zlib;
+                answer.SetHeader("Content-Encoding", "deflate");
+            } else {
+                return;
+            }
+            const std::string& body = answer.sharedBody ? *answer.sharedBody : answer.body;
+            answer.SetBody(Deflate::Compress(body, container));
+        };
+        if (response.IsDeferred()) {
+            response.completion->OnComplete(compress);
+        } else {
+            compress(response);
+        }
+    };
+}
+
+std::string HttpRouter::FormatPrometheus() const {
+    static const double QUANTILES[] = { 0.5, 0.9, 0.99 };
+    std::string out;
+    out += "# HELP perception_http_request_seconds Request handling time per route since start\n";
+    out += "# TYPE perception_http_request_seconds summary\n";
+    char line[200];
+    for (const auto& route : metrics) {
+        const char* label = route->label.c_str();
+        for (double quantile : QUANTILES) {
+            std::snprintf(line, sizeof(line), "perception_http_request_seconds{route=\"%s\",quantile=\"%g\"} %.6f\n",
+                          label, quantile, route->latency.QuantileMs(quantile) / 1000.0);
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "perception_http_request_seconds_sum{route=\"%s\"} %.6f\n",
+                      label, route->latency.SumMs() / 1000.0);
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_http_request_seconds_count{route=\"%s\"} %llu\n",
+                      label, static_cast<unsigned long long>(route->latency.Count()));
+        out += line;
+    }
+
+    out += "# HELP perception_http_errors_total Responses with a 4xx or 5xx status per route\n";
+    out += "# TYPE perception_http_errors_total counter\n";
+    for (const auto& route : metrics) {
+        std::snprintf(line, sizeof(line), "perception_http_errors_total{route=\"%s\",class=\"4xx\"} %llu\n",
+                      route->label.c_str(), static_cast<unsigned long long>(route->clientErrors.load()));
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_http_errors_total{route=\"%s\",class=\"5xx\"} %llu\n",
+                      route->label.c_str(), static_cast<unsigned long long>(route->serverErrors.load()));
+        out += line;
+    }
+    return out;
+}
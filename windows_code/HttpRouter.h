@@ -0,0 +1,189 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "HttpServer.h"
+#include "LatencyHistogram.h"
+
+/**
+ * HttpRouter - Method + path dispatch compiled into lookup tables
+ *
+ * Routes are declared up front (Add) and Compile() turns them into:
+ *   - a perfect hash of the literal paths: a seed is searched for that maps
+ *     every path to its own slot, so a lookup is one hash of the request
+ *     path, one slot read and one comparison to reject unknown paths
+ *   - a segment trie for patterns with parameters ("/engines/{name}"),
+ *     consulted only when the literal table misses
+ * Each path entry keeps one handler per method, indexed by the parsed
+ * method, so the method costs a switch instead of string compares. A
+ * literal path wins over a pattern matching the same request; a known path
+ * with an unregistered method gets 405 with an Allow header.
+ *
+ * Middleware:
+ *   Wraps a route's handler; it calls next() to run the rest of the chain
+ *   (or answers on its own). Router-wide middleware (Use) runs outside the
+ *   route's own, first added outermost. Built in:
+ *     Metrics(label)   latency histogram and error count per route, for /metrics
+ *     Cache(ttlMs)     replays a GET's 200 for identical query + Accept headers
+ *     Compress()       gzip/deflate for bodies worth it (Accept-Encoding)
+ *   After next() a response may be deferred (HttpResponse::Defer): work on
+ *   the answer then belongs in completion->OnComplete, as the built-ins do;
+ *   Cache never stores a deferred answer.
+ *
+ * Usage:
+ *   HttpRouter router;
+ *   router.Add(HttpRouter::Method::Get, "/history", ServeHistory)
+ *         .Use(router.Metrics("GET /history")).Use(HttpRouter::Cache(1000)).Use(HttpRouter::Compress());
+ *   router.Add(HttpRouter::Method::Post, "/engines/{name}/restart",
+ *              [](const HttpRequest& request, HttpResponse& response, const HttpRouter::Params& params) {
+ *                  std::string_view name = params.Get("name");
+ *              });
+ *   router.Compile();
+ *   if (!router.Dispatch(request, response)) { ... 404 ... }
+ *
+ * Add/Use/Compile happen before the server starts; Dispatch only reads the
+ * compiled tables and is safe from any number of threads.
+ */
+class HttpRouter {
+public:
+    enum class Method : uint8_t { Get, Post, Put, Delete, Patch, Count };
+
+    static constexpr size_t MAX_PARAMS = 4;
+
+    // Values of a pattern's {name} segments, views into the pattern and the request path
+    class Params {
+    public:
+        std::string_view Get(std::string_view name) const;
+        size_t Size() const { return count; }
+
+    private:
+        friend class HttpRouter;
+        std::array<std::pair<std::string_view, std::string_view>, MAX_PARAMS> items;
+        size_t count = 0;
+    };
+
+    using Handler = std::function<void(const HttpRequest&, HttpResponse&)>;
+    using ParamHandler = std::function<void(const HttpRequest&, HttpResponse&, const Params&)>;
+    using Next = std::function<void()>;
+    using Middleware = std::function<void(const HttpRequest&, HttpResponse&, const Next& next)>;
+
+    // Returned by Add(), to attach route middleware (first Use outermost)
+    class RouteBuilder {
+    public:
+        RouteBuilder& Use(Middleware middleware);
+
+    private:
+        friend class HttpRouter;
+        RouteBuilder(HttpRouter& router, size_t route) : router(router), route(route) {}
+        HttpRouter& router;
+        size_t route;
+    };
+
+    HttpRouter() = default;
+
+    HttpRouter(const HttpRouter&) = delete;
+    HttpRouter& operator=(const HttpRouter&) = delete;
+
+    /**
+     * @brief Declare a route (before Compile); a {name} segment matches any one segment
+     */
+    RouteBuilder Add(Method method, const std::string& pattern, Handler handler);
+    RouteBuilder Add(Method method, const std::string& pattern, ParamHandler handler);
+
+    /**
+     * @brief Middleware around every route (before Compile)
+     */
+    void Use(Middleware middleware);
+
+    /**
+     * @brief Build the dispatch tables; false (and a logged error) for a duplicate method + pattern
+     */
+    bool Compile();
+
+    /**
+     * @brief Run the matching route's chain
+     * @return false when no route has this path (response untouched)
+     */
+    bool Dispatch(const HttpRequest& request, HttpResponse& response) const;
+
+    static bool ParseMethod(std::string_view name, Method& method);
+    static const char* MethodName(Method method);
+
+    /**
+     * @brief Per-route latency and error counts (one Metrics middleware each)
+     */
+    Middleware Metrics(const std::string& label);
+
+    /**
+     * @brief Replay a GET's 200 response for ttlMs to requests with the same
+     *        query string and Accept / Accept-Encoding headers
+     */
+    static Middleware Cache(int ttlMs, size_t maxEntries = 16);
+
+    /**
+     * @brief gzip (else deflate) a 200 body of at least minBytes that isn't encoded yet
+     */
+    static Middleware Compress(size_t minBytes = 512);
+
+    /**
+     * @brief Prometheus text for every Metrics middleware
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    struct Route {
+        Method method;
+        std::string pattern;
+        ParamHandler handler;
+        std::vector<Middleware> middleware;
+    };
+
+    // A distinct path (literal or pattern) with its route per method
+    struct PathEntry {
+        std::string pattern;
+        std::array<int, static_cast<size_t>(Method::Count)> routes;
+        std::string allow;                  // "GET, POST" for 405s
+    };
+
+    // Pattern trie: literal children first, then the {param} child
+    struct TrieNode {
+        std::vector<std::pair<std::string, size_t>> literals;
+        size_t param = 0;                   // 0: none (node 0 is the root, never a child)
+        std::string paramName;
+        int entry = -1;
+    };
+
+    struct RouteMetrics {
+        std::string label;
+        LatencyHistogram latency;
+        std::atomic<uint64_t> clientErrors{0};
+        std::atomic<uint64_t> serverErrors{0};
+    };
+
+    std::vector<Route> routes;
+    std::vector<Middleware> global;
+    bool compiled = false;
+
+    std::vector<PathEntry> entries;
+    std::vector<int> slots;                 // Perfect hash of the literal paths: entry index or -1
+    uint64_t seed = 0;
+    std::vector<TrieNode> trie;
+
+    std::vector<std::unique_ptr<RouteMetrics>> metrics;
+
+    static uint64_t Hash(std::string_view text, uint64_t seed);
+    static bool IsPattern(std::string_view path);
+    int FindLiteral(std::string_view path) const;
+    int FindPattern(std::string_view path, Params& params) const;
+    bool MatchTrie(size_t node, std::string_view rest, Params& params, int& entry) const;
+    void InsertPattern(const std::string& pattern, int entry);
+    void RunChain(const Route& route, size_t index, const HttpRequest& request, HttpResponse& response,
+                  const Params& params) const;
+};
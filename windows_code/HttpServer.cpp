@@ -1,21 +1,151 @@
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
 #include "HttpServer.h"
-#include <thread>
-#include <iostream>
-#include <sstream>
+#include "HttpSysQueue.h"
+#include "Log.h"
+#include "PipelineLatency.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include "Watchdog.h"
 
-HttpServer::HttpServer(int port) : port(port), running(false), listenSocket(INVALID_SOCKET) {
+// Shared by the server and every completion it hands out; a completion that
+// outlives the server finds `server` cleared instead of a dangling pointer
+struct HttpServerLink {
+    std::mutex mutex;
+    HttpServer* server = nullptr;
+};
+
+// One client socket plus the state of its single in-flight overlapped operation
+struct HttpServer::Connection {
+    OVERLAPPED overlapped;                      // Must stay first (completions cast back)
+    SOCKET socket = INVALID_SOCKET;
+    std::atomic<IoOperation> operation{IoOperation::Accept};   // Read by the idle sweep
+    std::atomic<int64_t> lastActivityMs{0};
+    WSABUF wsaBuffer = {};                      // Receive target
+    WSABUF sendBuffers[MAX_SEND_BUFFERS] = {};
+
+    // AcceptEx writes both addresses here (no initial data is requested)
+    char addressBuffer[2 * (sizeof(sockaddr_in) + 16)];
+    std::string remoteAddress;                  // Peer IP, copied into each request
+
+    // Received bytes not yet consumed by a complete request; WSARecv reads
+    // straight into the tail, which grows RECV_CHUNK_SIZE at a time
+    std::string buffer;
+    size_t bufferUsed = 0;
+    HttpRequestParser parser{MAX_REQUEST_BYTES};
+    HttpRequest request;                        // Request being parsed
+    std::vector<SendBuffer> sendQueue;          // Header blocks and bodies being sent
+    size_t sendIndex = 0;                       // First buffer not fully sent
+    size_t sendOffset = 0;                      // Bytes of it already sent
+    bool closeAfterSend = false;
+    std::chrono::steady_clock::time_point sendStart;    // Responses queued by ProcessRequests
+
+    // Event stream subscriber: sends are driven by PublishEvent instead of requests
+    std::string eventStream;
+    std::mutex streamMutex;
+    bool streamSending = false;
+    SendBuffer streamQueued;                    // Newest frame waiting for the send to finish
+
+    // Deferred response: the completion (for the sweep's timeout) and, once
+    // completed, the answer waiting for a worker
+    uint64_t id = 0;
+    std::weak_ptr<HttpCompletion> completion;
+    int64_t deferDeadlineMs = 0;                // 0: no timeout
+    std::unique_ptr<HttpResponse> resumed;
+};
+
+// ============================================================================
+// Deferred Responses
+// ============================================================================
+
+std::shared_ptr<HttpCompletion> HttpResponse::Defer(int timeoutMs) {
+    if (!completion) {
+        completion = std::make_shared<HttpCompletion>(serverLink, connectionId);
+        deferTimeoutMs = timeoutMs;
+    }
+    return completion;
+}
+
+HttpCompletion::HttpCompletion(std::shared_ptr<HttpServerLink> link, uint64_t connectionId)
+    : link(std::move(link)), connectionId(connectionId) {
+}
+
+HttpCompletion::~HttpCompletion() {
+    if (!completed.load()) {
+        LOG_WARNING("Http", "Deferred response dropped without an answer");
+        HttpResponse response;
+        response.status = 500;
+        response.SetBody("{\"error\":\"Request was never completed\"}");
+        Complete(std::move(response));
+    }
+}
+
+void HttpCompletion::OnComplete(Hook hook) {
+    hooks.push_back(std::move(hook));
+}
+
+void HttpCompletion::Complete(HttpResponse response) {
+    if (completed.exchange(true)) {
+        return;     // Timed out (or answered) already
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!armed) {
+            early = std::make_unique<HttpResponse>(std::move(response));
+            return;
+        }
+    }
+    Dispatch(response);
+}
+
+void HttpCompletion::Arm() {
+    std::unique_ptr<HttpResponse> response;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        armed = true;
+        response = std::move(early);
+    }
+    if (response) {
+        Dispatch(*response);
+    }
+}
+
+void HttpCompletion::Dispatch(HttpResponse& response) {
+    for (const Hook& hook : hooks) {
+        hook(response);
+    }
+    hooks.clear();
+    if (!link) {
+        return;     // Not from a server connection
+    }
+    std::lock_guard<std::mutex> lock(link->mutex);
+    if (!link->server || !link->server->Resume(connectionId, response)) {
+        LOG_DEBUG("Http", "Deferred response completed after its connection closed");
+    }
+}
+
+HttpServer::HttpServer(int port, Backend backend)
+    : port(port), running(false), listenSocket(INVALID_SOCKET),
+      completionPort(nullptr), acceptEx(nullptr), pendingIo(0), lastSweepMs(0),
+      link(std::make_shared<HttpServerLink>()) {
+    link->server = this;
+    if (backend == Backend::HttpSys) {
+        kernel = std::make_unique<HttpSysQueue>(*this, port);
+    }
     WSADATA wsaData;
     int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
     if (result != 0) {
-        std::cout << "[ERROR] WSAStartup failed with error: " << result << std::endl;
+        LOG_ERROR("Http", "WSAStartup failed with error: " << result);
     } else {
-        std::cout << "[DEBUG] Winsock initialized successfully" << std::endl;
+        LOG_DEBUG("Http", "Winsock initialized successfully");
     }
 }
 
 HttpServer::~HttpServer() {
     Stop();
+    {
+        std::lock_guard<std::mutex> lock(link->mutex);
+        link->server = nullptr;
+    }
     WSACleanup();
 }
 
@@ -25,23 +155,32 @@ void HttpServer::SetRequestHandler(std::function<void(const HttpRequest&, HttpRe
 
 bool HttpServer::Start() {
     if (running) {
-        std::cout << "[WARNING] Server is already running" << std::endl;
+        LOG_WARNING("Http", "Server is already running");
         return true;
     }
+
+    if (kernel) {
+        if (kernel->Start()) {
+            kernelStarted = true;
+            running = true;
+            return true;
+        }
+        LOG_WARNING("Http", "http.sys unavailable; serving port " << port << " with Winsock instead");
+    }
     
-    std::cout << "[DEBUG] Creating socket..." << std::endl;
+    LOG_DEBUG("Http", "Creating socket...");
     listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (listenSocket == INVALID_SOCKET) {
         int error = WSAGetLastError();
-        std::cout << "[ERROR] Failed to create socket. WSA Error: " << error << std::endl;
+        LOG_ERROR("Http", "Failed to create socket. WSA Error: " << error);
         return false;
     }
-    std::cout << "[DEBUG] Socket created successfully" << std::endl;
+    LOG_DEBUG("Http", "Socket created successfully");
     
     // Allow socket reuse
     int opt = 1;
     if (setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt)) == SOCKET_ERROR) {
-        std::cout << "[WARNING] Failed to set SO_REUSEADDR. WSA Error: " << WSAGetLastError() << std::endl;
+        LOG_WARNING("Http", "Failed to set SO_REUSEADDR. WSA Error: " << WSAGetLastError());
     }
     
     sockaddr_in serverAddr = {0};
@@ -49,25 +188,25 @@ bool HttpServer::Start() {
     serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1"); // Bind only to localhost
     serverAddr.sin_port = htons(static_cast<u_short>(port));
     
-    std::cout << "[DEBUG] Attempting to bind to 127.0.0.1:" << port << std::endl;
+    LOG_DEBUG("Http", "Attempting to bind to 127.0.0.1:" << port);
     if (bind(listenSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
         int error = WSAGetLastError();
-        std::cout << "[ERROR] Failed to bind socket. WSA Error: " << error << std::endl;
+        LOG_ERROR("Http", "Failed to bind socket. WSA Error: " << error);
         
         // Common error explanations
         switch (error) {
             case WSAEADDRINUSE:
-                std::cout << "[ERROR] Address already in use. Port " << port << " is busy." << std::endl;
-                std::cout << "[HINT] Check what's using port " << port << ": netstat -ano | findstr :" << port << std::endl;
+                LOG_ERROR("Http", "Address already in use. Port " << port << " is busy.");
+                LOG_INFO("Http", "Check what's using port " << port << ": netstat -ano | findstr :" << port);
                 break;
             case WSAEACCES:
-                std::cout << "[ERROR] Permission denied. Try running as administrator." << std::endl;
+                LOG_ERROR("Http", "Permission denied. Try running as administrator.");
                 break;
             case WSAEADDRNOTAVAIL:
-                std::cout << "[ERROR] Address not available." << std::endl;
+                LOG_ERROR("Http", "Address not available.");
                 break;
             default:
-                std::cout << "[ERROR] Unknown bind error: " << error << std::endl;
+                LOG_ERROR("Http", "Unknown bind error: " << error);
                 break;
         }
         
@@ -75,173 +214,731 @@ bool HttpServer::Start() {
         listenSocket = INVALID_SOCKET;
         return false;
     }
-    std::cout << "[DEBUG] Socket bound successfully to 127.0.0.1:" << port << std::endl;
+    LOG_DEBUG("Http", "Socket bound successfully to 127.0.0.1:" << port);
     
-    std::cout << "[DEBUG] Starting to listen..." << std::endl;
+    LOG_DEBUG("Http", "Starting to listen...");
     if (listen(listenSocket, SOMAXCONN) == SOCKET_ERROR) {
         int error = WSAGetLastError();
-        std::cout << "[ERROR] Failed to listen on socket. WSA Error: " << error << std::endl;
+        LOG_ERROR("Http", "Failed to listen on socket. WSA Error: " << error);
         closesocket(listenSocket);
         listenSocket = INVALID_SOCKET;
         return false;
     }
     
     running = true;
-    std::cout << "[SUCCESS] HTTP server is now listening on 127.0.0.1:" << port << std::endl;
+    LOG_INFO("Http", "HTTP server is now listening on 127.0.0.1:" << port);
     return true;
 }
 
 void HttpServer::Stop() {
     if (!running) return;
     
-    std::cout << "[DEBUG] Stopping HTTP server..." << std::endl;
+    LOG_DEBUG("Http", "Stopping HTTP server...");
     running = false;
+    if (Kernel()) {
+        kernel->Stop();
+        return;
+    }
     if (listenSocket != INVALID_SOCKET) {
-        closesocket(listenSocket);
+        closesocket(listenSocket);      // Fails the pending AcceptEx calls
         listenSocket = INVALID_SOCKET;
-        std::cout << "[DEBUG] Listen socket closed" << std::endl;
+        LOG_DEBUG("Http", "Listen socket closed");
+    }
+
+    // Wake every worker; Run() tears down the remaining connections
+    if (completionPort) {
+        for (int i = 0; i < WORKER_THREADS; ++i) {
+            PostQueuedCompletionStatus(completionPort, 0, SHUTDOWN_KEY, nullptr);
+        }
     }
 }
 
 void HttpServer::Run() {
     if (!running || !requestHandler) {
-        std::cout << "[ERROR] Cannot run server - not properly initialized" << std::endl;
+        LOG_ERROR("Http", "Cannot run server - not properly initialized");
         return;
     }
-    
-    std::cout << "[DEBUG] Entering server main loop..." << std::endl;
-    std::cout << "[INFO] Server ready to accept connections on http://localhost:" << port << std::endl;
-    
-    while (running) {
-        std::cout << "[DEBUG] Waiting for incoming connections..." << std::endl;
-        SOCKET clientSocket = accept(listenSocket, nullptr, nullptr);
-        
-        if (clientSocket != INVALID_SOCKET) {
-            std::cout << "[DEBUG] New client connection accepted" << std::endl;
-            
-            // Handle each client in a separate thread for better responsiveness
-            std::thread clientThread([this, clientSocket]() {
-                HandleClient(clientSocket);
-            });
-            clientThread.detach();
-        } else {
-            if (running) {  // Only log error if we're still supposed to be running
-                int error = WSAGetLastError();
-                std::cout << "[WARNING] Accept failed. WSA Error: " << error << std::endl;
-                
-                // If it's a serious error, break the loop
-                if (error != WSAEINTR && error != WSAEWOULDBLOCK) {
-                    std::cout << "[ERROR] Fatal accept error, stopping server" << std::endl;
-                    break;
+    if (Kernel()) {
+        kernel->Run();
+        return;
+    }
+
+    completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+    if (!completionPort ||
+        !CreateIoCompletionPort(reinterpret_cast<HANDLE>(listenSocket), completionPort, 0, 0)) {
+        LOG_ERROR("Http", "Failed to create I/O completion port. Error: " << GetLastError());
+        ShutdownCompletionPort();
+        return;
+    }
+
+    // AcceptEx is a Winsock extension, loaded through the listen socket
+    GUID acceptExGuid = WSAID_ACCEPTEX;
+    DWORD bytes = 0;
+    if (WSAIoctl(listenSocket, SIO_GET_EXTENSION_FUNCTION_POINTER, &acceptExGuid, sizeof(acceptExGuid),
+                 &acceptEx, sizeof(acceptEx), &bytes, nullptr, nullptr) == SOCKET_ERROR) {
+        LOG_ERROR("Http", "Failed to load AcceptEx. WSA Error: " << WSAGetLastError());
+        ShutdownCompletionPort();
+        return;
+    }
+
+    int accepts = 0;
+    for (int i = 0; i < PENDING_ACCEPTS; ++i) {
+        accepts += PostAccept() ? 1 : 0;
+    }
+    if (accepts == 0) {
+        LOG_ERROR("Http", "Failed to post any AcceptEx call");
+        ShutdownCompletionPort();
+        return;
+    }
+
+    LOG_DEBUG("Http", "Entering server main loop...");
+    LOG_INFO("Http", "Server ready to accept connections on http://localhost:" << port
+             << " (" << WORKER_THREADS << " I/O workers)");
+
+    if (!running) {
+        ShutdownCompletionPort();     // Stopped while starting up
+        return;
+    }
+
+    // The calling thread is the last worker
+    for (int i = 1; i < WORKER_THREADS; ++i) {
+        workers.emplace_back(&HttpServer::WorkerThread, this);
+    }
+    WorkerThread();
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+    ShutdownCompletionPort();
+
+    LOG_DEBUG("Http", "Server main loop ended");
+}
+
+void HttpServer::ShutdownCompletionPort() {
+    // Closing the sockets cancels their pending operations; the cancelled
+    // completions still reference the Connections, so drain them before deleting
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (Connection* connection : connections) {
+            if (connection->socket != INVALID_SOCKET) {
+                closesocket(connection->socket);
+                connection->socket = INVALID_SOCKET;
+            }
+        }
+    }
+
+    while (completionPort && pendingIo.load() > 0) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED overlapped = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(completionPort, &bytes, &key, &overlapped, 1000);
+        if (!ok && !overlapped) {
+            break;      // Timed out; nothing more is coming
+        }
+        if (overlapped) {
+            pendingIo--;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (Connection* connection : connections) {
+            delete connection;
+        }
+        connections.clear();
+        deferred.clear();
+    }
+
+    if (completionPort) {
+        CloseHandle(completionPort);
+        completionPort = nullptr;
+    }
+}
+
+// ============================================================================
+// Completion Port Workers
+// ============================================================================
+
+void HttpServer::WorkerThread() {
+    TRACE_THREAD("HTTP worker");
+    // Below whisper and capture: a flood of requests slows the API, not the audio path
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    Watchdog::Heartbeat heartbeat("http_worker", "http", WORKER_STALL_MS);
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Http);
+    while (true) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED overlapped = nullptr;
+        heartbeat.Idle();
+        BOOL ok = GetQueuedCompletionStatus(completionPort, &bytes, &key, &overlapped, SWEEP_INTERVAL_MS);
+        heartbeat.Beat();
+
+        if (!overlapped) {
+            if (!ok && GetLastError() == WAIT_TIMEOUT) {
+                SweepIdleConnections();
+                continue;
+            }
+            if (key == SHUTDOWN_KEY || !ok) {
+                break;      // Stop() or the port itself failed
+            }
+            continue;
+        }
+
+        pendingIo--;
+        Connection* connection = reinterpret_cast<Connection*>(overlapped);
+
+        if (!running) {
+            CloseConnection(connection);
+            continue;
+        }
+
+        switch (connection->operation) {
+            case IoOperation::Accept:
+                heartbeat.Beat("accept");
+                // Keep the accept backlog full whether or not this one succeeded
+                PostAccept();
+                if (ok) {
+                    OnAccepted(connection);
+                } else {
+                    CloseConnection(connection);
                 }
+                break;
+            case IoOperation::Recv:
+                heartbeat.Beat("request");
+                if (ok && bytes > 0) {
+                    OnReceived(connection, bytes);
+                } else {
+                    CloseConnection(connection);    // Peer closed or reset
+                }
+                break;
+            case IoOperation::Send:
+                heartbeat.Beat("send");
+                if (ok) {
+                    OnSent(connection, bytes);
+                } else {
+                    CloseConnection(connection);
+                }
+                break;
+            case IoOperation::Close:
+                CloseConnection(connection);    // Posted when a stream send failed to start
+                break;
+            case IoOperation::Resume:
+                heartbeat.Beat("resume");
+                OnResumed(connection);
+                break;
+            case IoOperation::Deferred:
+                break;      // Never posted: a deferred connection has nothing in flight
+        }
+    }
+}
+
+bool HttpServer::PostAccept() {
+    auto connection = new Connection();
+    connection->operation = IoOperation::Accept;
+    connection->id = nextConnectionId.fetch_add(1);
+    connection->socket = WSASocketW(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+    if (connection->socket == INVALID_SOCKET) {
+        LOG_WARNING("Http", "Failed to create accept socket. WSA Error: " << WSAGetLastError());
+        delete connection;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        connections.insert(connection);
+    }
+
+    ZeroMemory(&connection->overlapped, sizeof(connection->overlapped));
+    const DWORD addressLength = sizeof(sockaddr_in) + 16;
+    DWORD bytes = 0;
+    pendingIo++;
+    if (!acceptEx(listenSocket, connection->socket, connection->addressBuffer, 0,
+                  addressLength, addressLength, &bytes, &connection->overlapped)) {
+        int error = WSAGetLastError();
+        if (error != WSA_IO_PENDING) {
+            pendingIo--;
+            if (running) {
+                LOG_WARNING("Http", "AcceptEx failed. WSA Error: " << error);
             }
+            CloseConnection(connection);
+            return false;
         }
     }
-    
-    std::cout << "[DEBUG] Server main loop ended" << std::endl;
+    return true;
 }
 
-void HttpServer::HandleClient(SOCKET clientSocket) {
-    std::cout << "[DEBUG] Handling client request..." << std::endl;
-    
-    char buffer[4096] = {0};
-    int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-    
-    if (bytesReceived > 0) {
-        std::cout << "[DEBUG] Received " << bytesReceived << " bytes from client" << std::endl;
-        
-        std::string rawRequest(buffer, bytesReceived);
-        std::cout << "[DEBUG] Raw request: " << rawRequest.substr(0, 100) << "..." << std::endl;
-        
-        HttpRequest request = ParseHttpRequest(rawRequest);
-        HttpResponse response;
-        
-        // Set default headers
-        response.SetHeader("Content-Type", "application/json");
-        response.SetHeader("Access-Control-Allow-Origin", "*");
-        response.SetHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-        response.SetHeader("Access-Control-Allow-Headers", "Content-Type");
-        
-        if (requestHandler) {
-            requestHandler(request, response);
-        } else {
-            std::cout << "[ERROR] No request handler set!" << std::endl;
+bool HttpServer::PostRecv(Connection* connection) {
+    connection->operation = IoOperation::Recv;
+    connection->lastActivityMs = NowMs();
+    if (connection->buffer.size() < connection->bufferUsed + RECV_CHUNK_SIZE) {
+        connection->buffer.resize(connection->bufferUsed + RECV_CHUNK_SIZE);
+    }
+    connection->wsaBuffer.buf = &connection->buffer[connection->bufferUsed];
+    connection->wsaBuffer.len = static_cast<ULONG>(connection->buffer.size() - connection->bufferUsed);
+    ZeroMemory(&connection->overlapped, sizeof(connection->overlapped));
+
+    DWORD flags = 0;
+    pendingIo++;
+    if (WSARecv(connection->socket, &connection->wsaBuffer, 1, nullptr, &flags,
+                &connection->overlapped, nullptr) == SOCKET_ERROR &&
+        WSAGetLastError() != WSA_IO_PENDING) {
+        pendingIo--;
+        return false;
+    }
+    return true;
+}
+
+bool HttpServer::PostSend(Connection* connection) {
+    connection->operation = IoOperation::Send;
+
+    // Gather the unsent buffers, the first one from where the last send stopped
+    DWORD count = 0;
+    size_t offset = connection->sendOffset;
+    for (size_t i = connection->sendIndex; i < connection->sendQueue.size() && count < MAX_SEND_BUFFERS; ++i) {
+        const std::string& bytes = *connection->sendQueue[i];
+        connection->sendBuffers[count].buf = const_cast<char*>(bytes.data()) + offset;
+        connection->sendBuffers[count].len = static_cast<ULONG>(bytes.size() - offset);
+        count++;
+        offset = 0;
+    }
+    ZeroMemory(&connection->overlapped, sizeof(connection->overlapped));
+
+    pendingIo++;
+    if (WSASend(connection->socket, connection->sendBuffers, count, nullptr, 0,
+                &connection->overlapped, nullptr) == SOCKET_ERROR &&
+        WSAGetLastError() != WSA_IO_PENDING) {
+        pendingIo--;
+        return false;
+    }
+    return true;
+}
+
+void HttpServer::OnAccepted(Connection* connection) {
+    // Inherit the listen socket's properties so shutdown()/getpeername() work
+    setsockopt(connection->socket, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+               reinterpret_cast<char*>(&listenSocket), sizeof(listenSocket));
+
+    sockaddr_in peer = {};
+    int peerLength = sizeof(peer);
+    char address[INET_ADDRSTRLEN] = {};
+    if (getpeername(connection->socket, reinterpret_cast<sockaddr*>(&peer), &peerLength) == 0 &&
+        inet_ntop(AF_INET, &peer.sin_addr, address, sizeof(address))) {
+        connection->remoteAddress = address;
+    }
+
+    if (!CreateIoCompletionPort(reinterpret_cast<HANDLE>(connection->socket), completionPort, 0, 0) ||
+        !PostRecv(connection)) {
+        CloseConnection(connection);
+    }
+}
+
+void HttpServer::OnReceived(Connection* connection, DWORD bytes) {
+    connection->bufferUsed += bytes;
+    connection->sendQueue.clear();
+    connection->sendIndex = 0;
+    connection->sendOffset = 0;
+    ProcessRequests(connection);
+}
+
+void HttpServer::OnResumed(Connection* connection) {
+    // Queued after the answers to requests pipelined before the deferred one
+    std::unique_ptr<HttpResponse> response = std::move(connection->resumed);
+    connection->completion.reset();
+    ApplyDefaultHeaders(*response, !connection->closeAfterSend);
+    response->eventStream.clear();      // Only an immediate answer can become a stream
+    BuildHttpResponse(*response, connection->sendQueue);
+    ProcessRequests(connection);
+}
+
+void HttpServer::ProcessRequests(Connection* connection) {
+    TRACE_ZONE("HttpServer::ProcessRequests");
+
+    // Pipelined requests are answered in arrival order, batched into one send
+    size_t offset = 0;
+    std::shared_ptr<HttpCompletion> completion;
+    while (!connection->closeAfterSend) {
+        std::string_view pending(connection->buffer.data() + offset, connection->bufferUsed - offset);
+        size_t consumed = 0;
+        HttpRequestParser::Result result = connection->parser.Parse(pending, connection->request, consumed);
+        if (result == HttpRequestParser::Result::Incomplete) {
+            break;
         }
-        
-        std::string httpResponse = BuildHttpResponse(response);
-        std::cout << "[DEBUG] Sending response (status " << response.status << ", " 
-                  << httpResponse.length() << " bytes)" << std::endl;
-        
-        int bytesSent = send(clientSocket, httpResponse.c_str(), static_cast<int>(httpResponse.length()), 0);
-        if (bytesSent == SOCKET_ERROR) {
-            std::cout << "[ERROR] Failed to send response. WSA Error: " << WSAGetLastError() << std::endl;
-        } else {
-            std::cout << "[DEBUG] Response sent successfully (" << bytesSent << " bytes)" << std::endl;
+
+        if (result == HttpRequestParser::Result::Error) {
+            HttpResponse badRequest;
+            badRequest.status = 400;
+            badRequest.SetHeader("Connection", "close");
+            BuildHttpResponse(badRequest, connection->sendQueue);
+            connection->closeAfterSend = true;
+            break;
+        }
+
+        bool keepAlive = connection->parser.KeepAlive();
+        std::string eventStream;
+        HandleRequest(connection, keepAlive, eventStream, completion);
+        connection->closeAfterSend = !keepAlive;
+        offset += consumed;
+
+        // Nothing is sent or read until the answer arrives: responses stay in order
+        if (completion) {
+            break;
+        }
+
+        // A subscriber sends nothing more; anything pipelined after it is dropped
+        if (!eventStream.empty()) {
+            std::lock_guard<std::mutex> lock(connection->streamMutex);
+            connection->eventStream = eventStream;
+            connection->streamSending = true;
+            connection->lastActivityMs = NowMs();
+            break;
         }
-    } else {
-        std::cout << "[WARNING] No data received from client or connection closed" << std::endl;
     }
-    
-    closesocket(clientSocket);
-    std::cout << "[DEBUG] Client connection closed" << std::endl;
+
+    // Keep only the incomplete request, at the start of the buffer
+    if (offset > 0) {
+        connection->buffer.erase(0, offset);
+        connection->bufferUsed -= offset;
+    }
+
+    if (completion) {
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            connection->operation = IoOperation::Deferred;
+            deferred[connection->id] = connection;
+        }
+        // May resume right away (already completed), on another worker: hands off
+        completion->Arm();
+        return;
+    }
+
+    if (!connection->sendQueue.empty()) {
+        connection->sendStart = std::chrono::steady_clock::now();
+        if (!PostSend(connection)) {
+            LOG_ERROR("Http", "Failed to send response. WSA Error: " << WSAGetLastError());
+            CloseConnection(connection);
+        }
+        return;
+    }
+
+    // Partial request: read the rest of it
+    if (connection->bufferUsed > MAX_REQUEST_BYTES + HttpRequestParser::MAX_HEADER_BYTES ||
+        !PostRecv(connection)) {
+        CloseConnection(connection);
+    }
 }
 
-HttpRequest HttpServer::ParseHttpRequest(const std::string& rawRequest) {
-    HttpRequest request;
-    
-    std::istringstream stream(rawRequest);
-    std::string line;
-    
-    if (std::getline(stream, line)) {
-        std::istringstream lineStream(line);
-        lineStream >> request.method >> request.path;
-        
-        // Remove \r if present
-        if (!request.path.empty() && request.path.back() == '\r') {
-            request.path.pop_back();
+void HttpServer::OnSent(Connection* connection, DWORD bytes) {
+    // Advance past what was sent; a partial send resumes mid-buffer
+    size_t remaining = bytes;
+    while (connection->sendIndex < connection->sendQueue.size()) {
+        size_t unsent = connection->sendQueue[connection->sendIndex]->size() - connection->sendOffset;
+        if (remaining < unsent) {
+            connection->sendOffset += remaining;
+            break;
         }
-        
-        std::cout << "[DEBUG] Parsed request: " << request.method << " " << request.path << std::endl;
+        remaining -= unsent;
+        connection->sendIndex++;
+        connection->sendOffset = 0;
     }
-    
-    // Parse headers and body if needed
-    std::string headers;
-    while (std::getline(stream, line) && line != "\r") {
-        headers += line + "\n";
+    if (connection->sendIndex < connection->sendQueue.size()) {
+        if (!PostSend(connection)) {
+            CloseConnection(connection);
+        }
+        return;
     }
-    
-    // Read body
-    std::string body;
-    while (std::getline(stream, line)) {
-        body += line + "\n";
+
+    if (!connection->eventStream.empty()) {
+        // Continue with the frame published meanwhile, or go idle until the next one
+        std::lock_guard<std::mutex> lock(connection->streamMutex);
+        if (!connection->streamQueued) {
+            connection->streamSending = false;
+            return;
+        }
+        connection->sendQueue.assign(1, std::move(connection->streamQueued));
+        connection->streamQueued.reset();
+        connection->sendIndex = 0;
+        connection->sendOffset = 0;
+        if (!PostSend(connection)) {
+            connection->streamSending = false;
+            connection->closeAfterSend = true;   // Closed by the next heartbeat
+        }
+        return;
+    }
+
+    PipelineLatency::Record(PipelineLatency::Stage::HttpSend, std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - connection->sendStart).count());
+
+    if (connection->closeAfterSend) {
+        shutdown(connection->socket, SD_SEND);
+        CloseConnection(connection);
+        return;
+    }
+
+    // Keep-alive: anything already buffered is a partial request; read the rest
+    if (!PostRecv(connection)) {
+        CloseConnection(connection);
     }
-    request.body = body;
-    
-    return request;
 }
 
-std::string HttpServer::BuildHttpResponse(const HttpResponse& response) {
-    std::ostringstream oss;
-    
-    oss << "HTTP/1.1 " << response.status << " ";
-    
-    switch (response.status) {
-        case 200: oss << "OK"; break;
-        case 404: oss << "Not Found"; break;
-        case 500: oss << "Internal Server Error"; break;
-        default: oss << "Unknown"; break;
+void HttpServer::SweepIdleConnections() {
+    int64_t now = NowMs();
+    int64_t lastSweep = lastSweepMs.load();
+    if (now - lastSweep < static_cast<int64_t>(SWEEP_INTERVAL_MS) ||
+        !lastSweepMs.compare_exchange_strong(lastSweep, now)) {
+        return;     // Another worker swept recently
     }
-    
-    oss << "\r\n";
-    
-    // Add headers
+
+    std::vector<std::shared_ptr<HttpCompletion>> expired;
+    std::unique_lock<std::mutex> lock(connectionsMutex);
+    for (const auto& entry : deferred) {
+        Connection* connection = entry.second;
+        if (connection->deferDeadlineMs > 0 && now > connection->deferDeadlineMs) {
+            if (auto completion = connection->completion.lock()) {
+                expired.push_back(std::move(completion));
+            }
+        }
+    }
+
+    // Cancelling the pending read completes it with an error, and the worker
+    // that dequeues it closes the connection through the normal path
+    for (Connection* connection : connections) {
+        if (connection->operation.load() == IoOperation::Recv &&
+            now - connection->lastActivityMs.load() > IDLE_TIMEOUT_MS) {
+            CancelIoEx(reinterpret_cast<HANDLE>(connection->socket), &connection->overlapped);
+        } else if (connection->operation.load() != IoOperation::Recv &&
+                   now - connection->lastActivityMs.load() > STREAM_HEARTBEAT_MS) {
+            // Only event streams (and deferred requests) sit outside Recv for this long
+            std::lock_guard<std::mutex> streamLock(connection->streamMutex);
+            if (!connection->eventStream.empty() && !connection->streamSending) {
+                static const SendBuffer heartbeat = std::make_shared<const std::string>(": heartbeat\n\n");
+                QueueStreamBytes(connection, heartbeat);
+            }
+        }
+    }
+    lock.unlock();
+
+    // Completed outside the lock: Complete() resumes through connectionsMutex
+    for (const auto& completion : expired) {
+        HttpResponse timedOut;
+        timedOut.status = 504;
+        timedOut.SetBody("{\"error\":\"Request timed out\"}");
+        completion->Complete(std::move(timedOut));
+    }
+}
+
+bool HttpServer::Resume(uint64_t connectionId, HttpResponse& response) {
+    if (Kernel()) {
+        return kernel->Resume(connectionId, response);
+    }
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    auto found = deferred.find(connectionId);
+    if (found == deferred.end() || !running) {
+        return false;
+    }
+    Connection* connection = found->second;
+    deferred.erase(found);
+    connection->resumed = std::make_unique<HttpResponse>(std::move(response));
+    connection->operation = IoOperation::Resume;
+    ZeroMemory(&connection->overlapped, sizeof(connection->overlapped));
+    pendingIo++;
+    if (!PostQueuedCompletionStatus(completionPort, 0, 0, &connection->overlapped)) {
+        pendingIo--;
+        LOG_ERROR("Http", "Failed to resume deferred response. Error: " << GetLastError());
+        return false;   // Left to shutdown: nothing else references the connection
+    }
+    return true;
+}
+
+void HttpServer::QueueStreamBytes(Connection* connection, const SendBuffer& bytes) {
+    // Caller holds streamMutex
+    connection->lastActivityMs = NowMs();
+    if (connection->streamSending) {
+        connection->streamQueued = bytes;       // Newest frame wins
+        return;
+    }
+
+    connection->streamSending = true;
+    connection->sendQueue.assign(1, bytes);
+    connection->sendIndex = 0;
+    connection->sendOffset = 0;
+    if (connection->closeAfterSend || !PostSend(connection)) {
+        // Let a worker close it: the connection can't be freed under connectionsMutex
+        connection->operation = IoOperation::Close;
+        ZeroMemory(&connection->overlapped, sizeof(connection->overlapped));
+        pendingIo++;
+        PostQueuedCompletionStatus(completionPort, 0, 0, &connection->overlapped);
+    }
+}
+
+std::string HttpServer::FormatEvent(const std::string& eventName, const std::string& data, const std::string& id) {
+    std::string frame;
+    frame.reserve(data.size() + eventName.size() + id.size() + 32);
+    if (!id.empty()) {
+        frame += "id: " + id + "\n";
+    }
+    if (!eventName.empty()) {
+        frame += "event: " + eventName + "\n";
+    }
+
+    size_t lineStart = 0;
+    do {
+        size_t lineEnd = data.find('\n', lineStart);
+        size_t end = (lineEnd == std::string::npos) ? data.size() : lineEnd;
+        frame += "data: ";
+        frame.append(data, lineStart, end - lineStart);
+        frame += "\n";
+        lineStart = (lineEnd == std::string::npos) ? std::string::npos : lineEnd + 1;
+    } while (lineStart != std::string::npos);
+
+    frame += "\n";
+    return frame;
+}
+
+size_t HttpServer::PublishEvent(const std::string& streamName, const std::string& eventName,
+                                const std::string& data, const std::string& id) {
+    // Formatted once; every subscriber's send references the same bytes
+    return PublishBytes(streamName, std::make_shared<const std::string>(FormatEvent(eventName, data, id)));
+}
+
+size_t HttpServer::PublishBytes(const std::string& streamName, std::shared_ptr<const std::string> frame) {
+    if (Kernel()) {
+        return kernel->PublishFrame(streamName, frame);
+    }
+    size_t subscribers = 0;
+
+    // Holding connectionsMutex keeps every subscriber alive while we queue
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (Connection* connection : connections) {
+        std::lock_guard<std::mutex> streamLock(connection->streamMutex);
+        if (connection->eventStream == streamName) {
+            QueueStreamBytes(connection, frame);
+            subscribers++;
+        }
+    }
+    return subscribers;
+}
+
+size_t HttpServer::GetSubscriberCount(const std::string& streamName) {
+    if (Kernel()) {
+        return kernel->GetSubscriberCount(streamName);
+    }
+    size_t subscribers = 0;
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (Connection* connection : connections) {
+        std::lock_guard<std::mutex> streamLock(connection->streamMutex);
+        if (connection->eventStream == streamName) {
+            subscribers++;
+        }
+    }
+    return subscribers;
+}
+
+int64_t HttpServer::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void HttpServer::CloseConnection(Connection* connection) {
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        connections.erase(connection);
+        deferred.erase(connection->id);
+    }
+    if (connection->socket != INVALID_SOCKET) {
+        closesocket(connection->socket);
+    }
+    delete connection;
+}
+
+// ============================================================================
+// Request Handling
+// ============================================================================
+
+void HttpServer::HandleRequest(Connection* connection, bool keepAlive, std::string& eventStream,
+                               std::shared_ptr<HttpCompletion>& completion) {
+    TRACE_ZONE("HttpServer::HandleRequest");
+    connection->request.remoteAddress = connection->remoteAddress;
+    const HttpRequest& request = connection->request;
+    LOG_DEBUG("Http", "Parsed request: " << request.method << " " << request.path);
+    HttpResponse response;
+    RunHandler(request, connection->id, keepAlive, response);
+
+    if (response.completion) {
+        completion = response.completion;
+        connection->completion = completion;
+        connection->deferDeadlineMs = response.deferTimeoutMs > 0 ? NowMs() + response.deferTimeoutMs : 0;
+        return;
+    }
+
+    eventStream = response.eventStream;
+    if (!eventStream.empty()) {
+        response.headers.erase("Keep-Alive");
+    }
+    BuildHttpResponse(response, connection->sendQueue);
+}
+
+void HttpServer::RunHandler(const HttpRequest& request, uint64_t id, bool keepAlive, HttpResponse& response) {
+    response.serverLink = link;
+    response.connectionId = id;
+    ApplyDefaultHeaders(response, keepAlive);
+
+    if (requestHandler) {
+        requestHandler(request, response);
+    } else {
+        LOG_ERROR("Http", "No request handler set!");
+    }
+}
+
+void HttpServer::ApplyDefaultHeaders(HttpResponse& response, bool keepAlive) {
+    response.headers.emplace("Connection", keepAlive ? "keep-alive" : "close");
+    if (keepAlive) {
+        response.headers.emplace("Keep-Alive", "timeout=" + std::to_string(IDLE_TIMEOUT_MS / 1000));
+    }
+    response.headers.emplace("Content-Type", "application/json");
+    response.headers.emplace("Access-Control-Allow-Origin", "*");
+    response.headers.emplace("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
+    response.headers.emplace("Access-Control-Allow-Headers", "Content-Type");
+}
+
+const char* HttpServer::ReasonPhrase(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return "Unknown";
+    }
+}
+
+void HttpServer::BuildHttpResponse(HttpResponse& response, std::vector<SendBuffer>& out) {
+    const char* reason = ReasonPhrase(response.status);
+
+    // Header block only: the body goes out as its own buffer
+    auto head = std::make_shared<std::string>();
+    head->reserve(256);
+    head->append("HTTP/1.1 ").append(std::to_string(response.status)).append(" ").append(reason).append("\r\n");
     for (const auto& header : response.headers) {
-        oss << header.first << ": " << header.second << "\r\n";
+        head->append(header.first).append(": ").append(header.second).append("\r\n");
     }
-    
-    oss << "Content-Length: " << response.body.length() << "\r\n";
-    oss << "\r\n";
-    oss << response.body;
-    
-    return oss.str();
-}
\ No newline at end of file
+
+    // Event streams have no length: the body is just the start of the stream
+    if (response.eventStream.empty()) {
+        head->append("Content-Length: ").append(std::to_string(response.GetBodySize())).append("\r\n");
+    }
+    head->append("\r\n");
+    out.push_back(std::move(head));
+
+    if (response.sharedBody) {
+        if (!response.sharedBody->empty()) {
+            out.push_back(std::move(response.sharedBody));
+        }
+    } else if (!response.body.empty()) {
+        out.push_back(std::make_shared<const std::string>(std::move(response.body)));
+    }
+}
@@ -5,48 +5,307 @@
 #include <windows.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <mswsock.h>
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "HttpRequestParser.h"
 
 #pragma comment(lib, "ws2_32.lib")
 
-struct HttpRequest {
-    std::string method;
-    std::string path;
-    std::string body;
-};
+class HttpCompletion;
+class HttpServer;
+class HttpSysQueue;
+struct HttpServerLink;
 
 struct HttpResponse {
     int status = 200;
     std::string body;
+    std::shared_ptr<const std::string> sharedBody;  // Sent instead of body when set
     std::map<std::string, std::string> headers;
-    
+    std::string eventStream;    // Non-empty: connection stays subscribed to this SSE stream
+    std::string bodyCacheKey;   // Names sharedBody's bytes for the kernel fragment cache (http.sys)
+    int kernelCacheSeconds = 0; // AllowKernelCache
+
     void SetHeader(const std::string& key, const std::string& value) {
         headers[key] = value;
     }
-    
+
     void SetBody(const std::string& content) {
         body = content;
+        sharedBody.reset();
+        bodyCacheKey.clear();
+    }
+
+    // Send bytes owned elsewhere (a snapshot, a cached asset) without copying;
+    // the pointer keeps them alive until the send completes. A cacheKey
+    // ("context.json") names what the bytes are, so the http.sys backend can
+    // keep the current version in the kernel and send later copies from there
+    void SetSharedBody(std::shared_ptr<const std::string> content, std::string cacheKey = std::string()) {
+        sharedBody = std::move(content);
+        body.clear();
+        bodyCacheKey = std::move(cacheKey);
+    }
+
+    // Let the http.sys backend answer repeats of this GET from the kernel for
+    // up to `seconds`, without running the handler. Only taken for a 200 to a
+    // request without a query string and without a Vary header: the kernel
+    // cache keys on the URL alone, so the answer must not depend on headers
+    void AllowKernelCache(int seconds) {
+        kernelCacheSeconds = seconds;
+    }
+
+    size_t GetBodySize() const {
+        return sharedBody ? sharedBody->size() : body.size();
+    }
+
+    // Turn this response into a Server-Sent Events stream; body is sent as the
+    // first bytes of the stream, later events come from HttpServer::PublishEvent
+    void StartEventStream(const std::string& streamName) {
+        eventStream = streamName;
+        SetHeader("Content-Type", "text/event-stream");
+        SetHeader("Cache-Control", "no-cache");
     }
+
+    /**
+     * @brief Answer later, from any thread, without holding the server worker
+     *
+     * Whatever the handler put in this response is discarded; the answer is
+     * what gets passed to the returned completion's Complete(). Without one
+     * within timeoutMs (0: no limit) the client gets a 504.
+     */
+    std::shared_ptr<HttpCompletion> Defer(int timeoutMs = 0);
+    bool IsDeferred() const { return completion != nullptr; }
+
+    std::shared_ptr<HttpCompletion> completion;     // Set by Defer()
+
+private:
+    friend class HttpServer;
+    friend class HttpSysQueue;
+    std::shared_ptr<HttpServerLink> serverLink;     // Set before the handler runs
+    uint64_t connectionId = 0;
+    int deferTimeoutMs = 0;
 };
 
+/**
+ * HttpCompletion - The pending answer of a deferred request
+ *
+ * Complete() hands the response back to the server, which sends it from a
+ * worker thread and then carries on with requests pipelined behind it; only
+ * the first call counts. Middleware that acts on the response after next()
+ * registers an OnComplete hook for deferred responses instead, and hooks run
+ * on the completing thread in the order they were added (innermost
+ * middleware first). Dropping the last reference without completing
+ * answers 500, so a lost callback can't leave a client waiting forever.
+ */
+class HttpCompletion {
+public:
+    using Hook = std::function<void(HttpResponse&)>;
+
+    HttpCompletion(std::shared_ptr<HttpServerLink> link, uint64_t connectionId);
+    ~HttpCompletion();
+
+    HttpCompletion(const HttpCompletion&) = delete;
+    HttpCompletion& operator=(const HttpCompletion&) = delete;
+
+    void Complete(HttpResponse response);
+    void OnComplete(Hook hook);
+    bool IsCompleted() const { return completed.load(); }
+
+private:
+    friend class HttpServer;
+    friend class HttpSysQueue;
+
+    // Called by the server once the handler chain has returned; a Complete()
+    // that came earlier (from another thread, or the handler itself) is sent now
+    void Arm();
+    void Dispatch(HttpResponse& response);
+
+    std::shared_ptr<HttpServerLink> link;
+    uint64_t connectionId;
+    std::mutex mutex;
+    bool armed = false;                     // Guarded by mutex
+    std::unique_ptr<HttpResponse> early;    // Completed before Arm(); guarded by mutex
+    std::vector<Hook> hooks;                // Only added while the handler chain runs
+    std::atomic<bool> completed{false};
+};
+
+/**
+ * HttpServer - Localhost HTTP server on an I/O completion port
+ *
+ * Architecture:
+ *   Start() binds and listens; Run() creates the completion port, keeps
+ *   PENDING_ACCEPTS AcceptEx calls outstanding and serves every connection
+ *   from a fixed pool of WORKER_THREADS threads (Run's caller is one of them).
+ *   Sockets use overlapped WSARecv/WSASend, so no thread ever blocks on a
+ *   client and the thread count stays fixed however often clients poll.
+ *
+ *   Each Connection has at most one overlapped operation in flight; its
+ *   OVERLAPPED is the first member, so a completion maps straight back to it.
+ *
+ * Persistent connections: HTTP/1.1 connections stay open unless the client
+ * sends "Connection: close" (HTTP/1.0 only with "Connection: keep-alive").
+ * Requests are framed by HttpRequestParser (Content-Length or chunked) over a
+ * growable per-connection buffer that WSARecv reads into directly, so
+ * pipelined requests that arrive in one read are answered in order with a
+ * single gathered WSASend. Connections idle longer
+ * than IDLE_TIMEOUT_MS are closed by whichever worker next wakes from its
+ * sweep timeout.
+ *
+ * Responses are queued as separate buffers - a formatted header block, then
+ * the body - and sent with one WSASend over an array of WSABUFs, so bodies
+ * are never copied into a combined string; shared bodies (and event frames,
+ * one per publish for every subscriber) are referenced rather than copied.
+ *
+ * Event streams: a handler that calls HttpResponse::StartEventStream keeps
+ * its connection open as a subscriber. PublishEvent() pushes an SSE frame to
+ * every subscriber of a stream; a subscriber still sending the previous
+ * frame only keeps the newest one, so a slow client never queues more than
+ * one event. Quiet streams get a comment heartbeat every STREAM_HEARTBEAT_MS
+ * so dead clients are found by the failed send.
+ *
+ * Backends: Backend::HttpSys hands the port, connections and parsing to
+ * the kernel's HTTP stack (HttpSysQueue), which adds kernel response
+ * caching; everything above holds for it too. When http.sys can't be used
+ * (no URL reservation for a non-elevated process) Start() falls back to
+ * Winsock.
+ *
+ * The request handler runs on a worker thread and may be called concurrently
+ * for different connections. Workers run below normal priority, under the
+ * capture and whisper threads, so a flood of requests can't starve them.
+ *
+ * Deferred responses: a handler that would wait (an inference, another
+ * engine) calls HttpResponse::Defer() and returns at once. The connection
+ * then has no operation in flight and no worker: it reads nothing more, and
+ * responses to requests pipelined before it stay queued. Complete() posts
+ * the answer to the completion port, and the worker that dequeues it sends
+ * it along with the answers to anything pipelined after it. The idle sweep
+ * answers 504 for deferrals past their timeout.
+ */
 class HttpServer {
 private:
+    struct Connection;
+
+public:
+    enum class Backend { Winsock, HttpSys };
+
+private:
+    // Deferred: no I/O in flight, waiting for HttpCompletion::Complete;
+    // Resume: posted by Complete to send the answer from a worker
+    enum class IoOperation { Accept, Recv, Send, Close, Deferred, Resume };
+
+    static constexpr int WORKER_THREADS = 4;
+    static constexpr int PENDING_ACCEPTS = 4;
+    static constexpr size_t RECV_CHUNK_SIZE = 4096;
+    static constexpr size_t MAX_REQUEST_BYTES = 1024 * 1024;
+    static constexpr ULONG_PTR SHUTDOWN_KEY = 1;    // Posted by Stop(), one per worker
+    static constexpr int IDLE_TIMEOUT_MS = 15000;      // Keep-alive connections with no request
+    static constexpr DWORD SWEEP_INTERVAL_MS = 1000;
+    static constexpr int STREAM_HEARTBEAT_MS = 15000;
+    static constexpr int WORKER_STALL_MS = 10000;       // Watchdog timeout for one completion
+    static constexpr size_t MAX_SEND_BUFFERS = 16;     // WSABUFs per WSASend; the rest go in the next
+
+    // One queued piece of a connection's output (header block, body, SSE frame)
+    using SendBuffer = std::shared_ptr<const std::string>;
+
     int port;
-    bool running;
+    std::atomic<bool> running;
     std::function<void(const HttpRequest&, HttpResponse&)> requestHandler;
     SOCKET listenSocket;
-    
-    void HandleClient(SOCKET clientSocket);
-    std::string BuildHttpResponse(const HttpResponse& response);
-    HttpRequest ParseHttpRequest(const std::string& rawRequest);
-    
+
+    // === Completion port ===
+    HANDLE completionPort;
+    LPFN_ACCEPTEX acceptEx;
+    std::vector<std::thread> workers;
+    std::atomic<int> pendingIo;     // Overlapped operations not yet dequeued
+    std::atomic<int64_t> lastSweepMs;
+
+    // Open connections (owned; deleted by CloseConnection or at shutdown)
+    std::mutex connectionsMutex;
+    std::unordered_set<Connection*> connections;
+    std::unordered_map<uint64_t, Connection*> deferred;    // By Connection::id, awaiting Complete()
+    std::atomic<uint64_t> nextConnectionId{1};
+
+    // What completions hold instead of the server: cleared when it is destroyed
+    std::shared_ptr<HttpServerLink> link;
+
+    // Backend::HttpSys (null: Winsock); serving once kernelStarted, else Winsock took over
+    std::unique_ptr<HttpSysQueue> kernel;
+    std::atomic<bool> kernelStarted{false};
+    HttpSysQueue* Kernel() const { return kernelStarted.load() ? kernel.get() : nullptr; }
+
+    void WorkerThread();
+    bool PostAccept();
+    bool PostRecv(Connection* connection);
+    bool PostSend(Connection* connection);
+    void OnAccepted(Connection* connection);
+    void OnReceived(Connection* connection, DWORD bytes);
+    void OnSent(Connection* connection, DWORD bytes);
+    void OnResumed(Connection* connection);
+    void CloseConnection(Connection* connection);
+    void SweepIdleConnections();
+
+    // Send (or, mid-send, replace the queued) bytes on an event stream;
+    // connectionsMutex must be held
+    void QueueStreamBytes(Connection* connection, const SendBuffer& bytes);
+    void ShutdownCompletionPort();
+
+    // Handle every complete request buffered on the connection, then send or read more
+    void ProcessRequests(Connection* connection);
+
+    static int64_t NowMs();
+
+    // Append the response's header block and body to the send queue, or hand
+    // back the completion when the handler deferred it
+    void HandleRequest(Connection* connection, bool keepAlive, std::string& eventStream,
+                       std::shared_ptr<HttpCompletion>& completion);
+    void BuildHttpResponse(HttpResponse& response, std::vector<SendBuffer>& out);
+    // Connection/Keep-Alive, Content-Type and CORS, without replacing what the handler set
+    static void ApplyDefaultHeaders(HttpResponse& response, bool keepAlive);
+    static const char* ReasonPhrase(int status);
+    // Default headers, then the handler; `id` is what a deferred answer resumes by
+    void RunHandler(const HttpRequest& request, uint64_t id, bool keepAlive, HttpResponse& response);
+
+    friend class HttpCompletion;
+    friend class HttpSysQueue;
+    friend struct PerfMicro;            // perf_micro times BuildHttpResponse
+    // Queue a completed deferred response on its connection's worker; false if it is gone
+    bool Resume(uint64_t connectionId, HttpResponse& response);
+
 public:
-    HttpServer(int port = 8777);
+    HttpServer(int port = 8777, Backend backend = Backend::Winsock);
     ~HttpServer();
-    
+
     void SetRequestHandler(std::function<void(const HttpRequest&, HttpResponse&)> handler);
+
+    // SSE frame ("id:" omitted when empty; multi-line data split across "data:" lines)
+    static std::string FormatEvent(const std::string& eventName, const std::string& data,
+                                   const std::string& id = "");
+
+    /**
+     * @brief Push an event to every subscriber of an event stream
+     * @return Number of subscribers it was queued for
+     */
+    size_t PublishEvent(const std::string& streamName, const std::string& eventName,
+                        const std::string& data, const std::string& id = "");
+    /**
+     * @brief Push bytes other than an SSE frame (a multipart part) to every subscriber of a stream
+     *
+     * For streams that aren't text/event-stream; quiet ones still get the
+     * heartbeat comment, which trails the previous part's body.
+     * @return Number of subscribers it was queued for
+     */
+    size_t PublishBytes(const std::string& streamName, std::shared_ptr<const std::string> bytes);
+    size_t GetSubscriberCount(const std::string& streamName);
     bool Start();
     void Stop();
     void Run(); // Blocking call to handle requests
+    int GetPort() const { return port; }
 };
\ No newline at end of file
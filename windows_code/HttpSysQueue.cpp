@@ -0,0 +1,776 @@
+#include "HttpSysQueue.h"
+#include "Log.h"
+#include "PipelineLatency.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include "Watchdog.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+namespace {
+
+// HTTP_HEADER_ID order, request side, lowercased as HttpRequest keeps names
+const char* const REQUEST_HEADERS[HttpHeaderRequestMaximum] = {
+    "cache-control", "connection", "date", "keep-alive", "pragma", "trailer", "transfer-encoding", "upgrade",
+    "via", "warning", "allow", "content-length", "content-type", "content-encoding", "content-language",
+    "content-location", "content-md5", "content-range", "expires", "last-modified", "accept", "accept-charset",
+    "accept-encoding", "accept-language", "authorization", "cookie", "expect", "from", "host", "if-match",
+    "if-modified-since", "if-none-match", "if-range", "if-unmodified-since", "max-forwards",
+    "proxy-authorization", "referer", "range", "te", "translate", "user-agent"
+};
+
+// Response side: the same general and entity headers, then the response ones
+const char* const RESPONSE_HEADERS[HttpHeaderResponseMaximum] = {
+    "Cache-Control", "Connection", "Date", "Keep-Alive", "Pragma", "Trailer", "Transfer-Encoding", "Upgrade",
+    "Via", "Warning", "Allow", "Content-Length", "Content-Type", "Content-Encoding", "Content-Language",
+    "Content-Location", "Content-MD5", "Content-Range", "Expires", "Last-Modified", "Accept-Ranges", "Age",
+    "ETag", "Location", "Proxy-Authenticate", "Retry-After", "Server", "Set-Cookie", "Vary", "WWW-Authenticate"
+};
+
+const char* VerbName(HTTP_VERB verb) {
+    switch (verb) {
+        case HttpVerbOPTIONS: return "OPTIONS";
+        case HttpVerbGET: return "GET";
+        case HttpVerbHEAD: return "HEAD";
+        case HttpVerbPOST: return "POST";
+        case HttpVerbPUT: return "PUT";
+        case HttpVerbDELETE: return "DELETE";
+        case HttpVerbTRACE: return "TRACE";
+        case HttpVerbCONNECT: return "CONNECT";
+        default: return nullptr;        // PATCH and the rest arrive as pUnknownVerb
+    }
+}
+
+int ResponseHeaderId(const std::string& name) {
+    for (int id = 0; id < HttpHeaderResponseMaximum; ++id) {
+        if (_stricmp(name.c_str(), RESPONSE_HEADERS[id]) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+std::wstring Widen(const std::string& text) {
+    return std::wstring(text.begin(), text.end());      // Fragment keys are ASCII
+}
+
+}  // namespace
+
+// One request from receipt to its last send. Shared by the map and the
+// operations in flight for it, so ending it never frees what a send uses
+struct HttpSysQueue::Exchange {
+    uint64_t id = 0;                            // What a deferred answer resumes by
+    HTTP_REQUEST_ID requestId = HTTP_NULL_ID;
+    bool keepAlive = true;
+    bool cacheable = false;                     // GET without a query: the kernel may keep the answer
+
+    // Deferred (guarded by mutex)
+    bool deferred = false;
+    std::weak_ptr<HttpCompletion> completion;
+    int64_t deferDeadlineMs = 0;                // 0: no timeout
+
+    // Event stream (guarded by mutex)
+    std::string eventStream;
+    bool streamSending = false;
+    bool failed = false;                        // A send couldn't start: dropped by the next sweep
+    HttpServer::SendBuffer streamQueued;        // Newest frame waiting for the send to finish
+    int64_t lastActivityMs = 0;
+
+    std::chrono::steady_clock::time_point sendStart;
+};
+
+// One overlapped call on the queue; OVERLAPPED first, so a completion casts back
+struct HttpSysQueue::Operation {
+    enum class Kind { Receive, Send, StreamSend };
+
+    OVERLAPPED overlapped = {};
+    Kind kind = Kind::Receive;
+
+    // Receive: the HTTP_REQUEST and what it points into (ULONGLONG for its alignment)
+    std::vector<ULONGLONG> buffer;
+
+    // Sends: everything the call points to, alive until it completes
+    std::shared_ptr<Exchange> exchange;
+    HTTP_RESPONSE response = {};
+    std::map<std::string, std::string> headers;
+    std::vector<HTTP_UNKNOWN_HEADER> unknownHeaders;
+    std::string contentLength;
+    HttpServer::SendBuffer body;
+    std::wstring fragment;
+    HTTP_DATA_CHUNK chunk = {};
+    HTTP_CACHE_POLICY cachePolicy = {};
+    bool cached = false;
+
+    ULONG ReceiveBytes() const { return static_cast<ULONG>(buffer.size() * sizeof(ULONGLONG)); }
+    HTTP_REQUEST* Request() { return reinterpret_cast<HTTP_REQUEST*>(buffer.data()); }
+
+    void ChunkFromMemory() {
+        chunk.DataChunkType = HttpDataChunkFromMemory;
+        chunk.FromMemory.pBuffer = const_cast<char*>(body->data());
+        chunk.FromMemory.BufferLength = static_cast<ULONG>(body->size());
+    }
+};
+
+HttpSysQueue::HttpSysQueue(HttpServer& server, int port)
+    : server(server), port(port) {
+    urls.push_back(L"http://localhost:" + std::to_wstring(port) + L"/");
+    urls.push_back(L"http://127.0.0.1:" + std::to_wstring(port) + L"/");
+}
+
+HttpSysQueue::~HttpSysQueue() {
+    Stop();
+    Close();
+}
+
+bool HttpSysQueue::Start() {
+    ULONG result = HttpInitialize(HTTPAPI_VERSION_2, HTTP_INITIALIZE_SERVER, nullptr);
+    if (result != NO_ERROR) {
+        LOG_ERROR("Http", "HttpInitialize failed: " << result);
+        return false;
+    }
+    initialized = true;
+
+    if ((result = HttpCreateServerSession(HTTPAPI_VERSION_2, &session, 0)) != NO_ERROR ||
+        (result = HttpCreateUrlGroup(session, &urlGroup, 0)) != NO_ERROR ||
+        (result = HttpCreateRequestQueue(HTTPAPI_VERSION_2, nullptr, nullptr, 0, &queue)) != NO_ERROR) {
+        LOG_ERROR("Http", "Cannot create the http.sys request queue: " << result);
+        Close();
+        return false;
+    }
+
+    for (const std::wstring& url : urls) {
+        result = HttpAddUrlToUrlGroup(urlGroup, url.c_str(), 0, 0);
+        if (result == NO_ERROR) {
+            continue;
+        }
+        switch (result) {
+            case ERROR_ACCESS_DENIED:
+                LOG_ERROR("Http", "http.sys refused port " << port << ": no URL reservation. Run once, elevated: "
+                          "netsh http add urlacl url=http://localhost:" << port << "/ user=%USERNAME% "
+                          "(and the same for 127.0.0.1)");
+                break;
+            case ERROR_ALREADY_EXISTS:
+            case ERROR_SHARING_VIOLATION:
+                LOG_ERROR("Http", "Port " << port << " is already registered with http.sys by another process");
+                break;
+            default:
+                LOG_ERROR("Http", "HttpAddUrlToUrlGroup failed: " << result);
+                break;
+        }
+        Close();
+        return false;
+    }
+
+    HTTP_BINDING_INFO binding = {};
+    binding.Flags.Present = 1;
+    binding.RequestQueueHandle = queue;
+    result = HttpSetUrlGroupProperty(urlGroup, HttpServerBindingProperty, &binding, sizeof(binding));
+    if (result != NO_ERROR) {
+        LOG_ERROR("Http", "Cannot bind the http.sys URL group to its queue: " << result);
+        Close();
+        return false;
+    }
+
+    // Keep-alive connections idle as long as with Winsock
+    HTTP_TIMEOUT_LIMIT_INFO timeouts = {};
+    timeouts.Flags.Present = 1;
+    timeouts.IdleConnection = static_cast<USHORT>(HttpServer::IDLE_TIMEOUT_MS / 1000);
+    if (HttpSetUrlGroupProperty(urlGroup, HttpServerTimeoutsProperty, &timeouts, sizeof(timeouts)) != NO_ERROR) {
+        LOG_WARNING("Http", "Cannot set the http.sys idle timeout; keeping its default");
+    }
+
+    completionPort = CreateIoCompletionPort(queue, nullptr, 0, 0);
+    if (!completionPort) {
+        LOG_ERROR("Http", "Failed to create I/O completion port. Error: " << GetLastError());
+        Close();
+        return false;
+    }
+
+    running = true;
+    LOG_INFO("Http", "HTTP server is now listening on http.sys, port " << port);
+    return true;
+}
+
+void HttpSysQueue::Stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    // Fails the pending receives; the workers drain them in Run()
+    HttpShutdownRequestQueue(queue);
+    for (int i = 0; i < HttpServer::WORKER_THREADS; ++i) {
+        PostQueuedCompletionStatus(completionPort, 0, HttpServer::SHUTDOWN_KEY, nullptr);
+    }
+}
+
+void HttpSysQueue::Run() {
+    int receives = 0;
+    for (int i = 0; i < HttpServer::PENDING_ACCEPTS; ++i) {
+        auto operation = new Operation();
+        operation->buffer.resize(RECEIVE_BUFFER_BYTES / sizeof(ULONGLONG));
+        if (PostReceive(operation, HTTP_NULL_ID)) {
+            receives++;
+        } else {
+            delete operation;
+        }
+    }
+    if (receives == 0) {
+        LOG_ERROR("Http", "Failed to post any http.sys receive");
+        Shutdown();
+        return;
+    }
+
+    LOG_INFO("Http", "Server ready to accept connections on http://localhost:" << port
+             << " (http.sys, " << HttpServer::WORKER_THREADS << " I/O workers)");
+
+    // The calling thread is the last worker
+    for (int i = 1; i < HttpServer::WORKER_THREADS; ++i) {
+        workers.emplace_back(&HttpSysQueue::WorkerThread, this);
+    }
+    WorkerThread();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+    Shutdown();
+}
+
+void HttpSysQueue::Shutdown() {
+    // The queue is shut down, so everything in flight completes (failed);
+    // drain it before freeing what the calls point to
+    if (queue) {
+        HttpShutdownRequestQueue(queue);
+    }
+    while (completionPort && pendingIo.load() > 0) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED overlapped = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(completionPort, &bytes, &key, &overlapped, 1000);
+        if (!ok && !overlapped) {
+            break;      // Timed out; nothing more is coming
+        }
+        if (overlapped) {
+            pendingIo--;
+            delete reinterpret_cast<Operation*>(overlapped);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exchanges.clear();
+    }
+    Close();
+}
+
+void HttpSysQueue::Close() {
+    {
+        std::lock_guard<std::mutex> lock(fragmentMutex);
+        fragments.clear();          // Dropped by the kernel with the queue
+    }
+    if (completionPort) {
+        CloseHandle(completionPort);
+        completionPort = nullptr;
+    }
+    if (urlGroup != HTTP_NULL_ID) {
+        HttpCloseUrlGroup(urlGroup);
+        urlGroup = HTTP_NULL_ID;
+    }
+    if (queue) {
+        HttpCloseRequestQueue(queue);
+        queue = nullptr;
+    }
+    if (session != HTTP_NULL_ID) {
+        HttpCloseServerSession(session);
+        session = HTTP_NULL_ID;
+    }
+    if (initialized) {
+        HttpTerminate(HTTP_INITIALIZE_SERVER, nullptr);
+        initialized = false;
+    }
+}
+
+// ============================================================================
+// Completion Port Workers
+// ============================================================================
+
+void HttpSysQueue::WorkerThread() {
+    TRACE_THREAD("HTTP worker");
+    // Below whisper and capture, as the Winsock workers
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    Watchdog::Heartbeat heartbeat("http_worker", "http", HttpServer::WORKER_STALL_MS);
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Http);
+    while (true) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED overlapped = nullptr;
+        heartbeat.Idle();
+        BOOL ok = GetQueuedCompletionStatus(completionPort, &bytes, &key, &overlapped,
+                                            HttpServer::SWEEP_INTERVAL_MS);
+        ULONG error = ok ? NO_ERROR : GetLastError();
+        heartbeat.Beat();
+
+        if (!overlapped) {
+            if (error == WAIT_TIMEOUT) {
+                Sweep();
+                continue;
+            }
+            if (key == HttpServer::SHUTDOWN_KEY || !ok) {
+                break;      // Stop() or the port itself failed
+            }
+            continue;
+        }
+
+        pendingIo--;
+        Operation* operation = reinterpret_cast<Operation*>(overlapped);
+        if (!running) {
+            delete operation;       // Exchanges go in Shutdown()
+            continue;
+        }
+
+        switch (operation->kind) {
+            case Operation::Kind::Receive:
+                heartbeat.Beat("request");
+                OnReceived(operation, error, bytes);
+                break;
+            case Operation::Kind::Send:
+            case Operation::Kind::StreamSend:
+                heartbeat.Beat("send");
+                OnSent(operation, error == NO_ERROR);
+                break;
+        }
+    }
+}
+
+bool HttpSysQueue::PostReceive(Operation* operation, HTTP_REQUEST_ID requestId) {
+    operation->kind = Operation::Kind::Receive;
+    ZeroMemory(&operation->overlapped, sizeof(operation->overlapped));
+    pendingIo++;
+    ULONG result = HttpReceiveHttpRequest(queue, requestId, HTTP_RECEIVE_REQUEST_FLAG_COPY_BODY,
+                                          operation->Request(), operation->ReceiveBytes(), nullptr,
+                                          &operation->overlapped);
+    if (result != NO_ERROR && result != ERROR_IO_PENDING) {
+        pendingIo--;
+        return false;
+    }
+    return true;
+}
+
+void HttpSysQueue::OnReceived(Operation* operation, ULONG error, DWORD bytes) {
+    if (error == ERROR_MORE_DATA) {
+        // Headers larger than the buffer: the same request again into one that fits
+        HTTP_REQUEST_ID requestId = operation->Request()->RequestId;
+        size_t needed = (std::max)(static_cast<size_t>(bytes), operation->buffer.size() * sizeof(ULONGLONG) * 2);
+        operation->buffer.resize((needed + sizeof(ULONGLONG) - 1) / sizeof(ULONGLONG));
+        if (PostReceive(operation, requestId)) {
+            return;
+        }
+        HttpCancelHttpRequest(queue, requestId, nullptr);
+    } else if (error == NO_ERROR) {
+        HandleRequest(*operation->Request());
+    } else if (running) {
+        LOG_DEBUG("Http", "http.sys receive failed: " << error);     // The client went away first
+    }
+
+    // Keep the receive outstanding, back at its usual size
+    operation->buffer.resize(RECEIVE_BUFFER_BYTES / sizeof(ULONGLONG));
+    if (!running || !PostReceive(operation, HTTP_NULL_ID)) {
+        if (running) {
+            LOG_WARNING("Http", "Failed to post an http.sys receive");
+        }
+        delete operation;
+    }
+}
+
+bool HttpSysQueue::ReadRequest(const HTTP_REQUEST& raw, HttpRequest& request) {
+    const char* verb = VerbName(raw.Verb);
+    request.method = verb ? std::string(verb) : std::string(raw.pUnknownVerb, raw.UnknownVerbLength);
+
+    // Origin form as sent; an absolute form (a proxy's) keeps only its path
+    std::string_view target(raw.pRawUrl, raw.RawUrlLength);
+    if (target.rfind("http://", 0) == 0) {
+        size_t slash = target.find('/', 7);
+        target = slash == std::string_view::npos ? std::string_view("/") : target.substr(slash);
+    }
+    size_t question = target.find('?');
+    request.path = std::string(target.substr(0, question));
+    request.query = question == std::string_view::npos ? std::string() : std::string(target.substr(question + 1));
+    request.version = "HTTP/" + std::to_string(raw.Version.MajorVersion) + "." +
+                      std::to_string(raw.Version.MinorVersion);
+
+    for (int id = 0; id < HttpHeaderRequestMaximum; ++id) {
+        const HTTP_KNOWN_HEADER& header = raw.Headers.KnownHeaders[id];
+        if (header.RawValueLength > 0) {
+            request.headers[REQUEST_HEADERS[id]].assign(header.pRawValue, header.RawValueLength);
+        }
+    }
+    for (USHORT i = 0; i < raw.Headers.UnknownHeaderCount; ++i) {
+        const HTTP_UNKNOWN_HEADER& header = raw.Headers.pUnknownHeaders[i];
+        std::string name(header.pName, header.NameLength);
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        std::string& value = request.headers[name];
+        if (!value.empty()) {
+            value += ", ";
+        }
+        value.append(header.pRawValue, header.RawValueLength);
+    }
+
+    char address[INET6_ADDRSTRLEN] = {};
+    const SOCKADDR* remote = raw.Address.pRemoteAddress;
+    if (remote && remote->sa_family == AF_INET &&
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(remote)->sin_addr, address, sizeof(address))) {
+        request.remoteAddress = address;
+    } else if (remote && remote->sa_family == AF_INET6 &&
+               inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(remote)->sin6_addr, address,
+                         sizeof(address))) {
+        request.remoteAddress = address;
+    }
+
+    // The body: what came with the headers, then the rest synchronously
+    for (USHORT i = 0; i < raw.EntityChunkCount; ++i) {
+        const HTTP_DATA_CHUNK& chunk = raw.pEntityChunks[i];
+        if (chunk.DataChunkType == HttpDataChunkFromMemory) {
+            request.body.append(static_cast<const char*>(chunk.FromMemory.pBuffer), chunk.FromMemory.BufferLength);
+        }
+    }
+    if (raw.Flags & HTTP_REQUEST_FLAG_MORE_ENTITY_BODY_EXISTS) {
+        char chunk[HttpServer::RECV_CHUNK_SIZE];
+        for (;;) {
+            ULONG read = 0;
+            ULONG result = HttpReceiveRequestEntityBody(queue, raw.RequestId, 0, chunk, sizeof(chunk), &read,
+                                                        nullptr);
+            if (result != NO_ERROR && result != ERROR_HANDLE_EOF) {
+                return false;
+            }
+            request.body.append(chunk, read);
+            if (request.body.size() > HttpServer::MAX_REQUEST_BYTES) {
+                return false;
+            }
+            if (result == ERROR_HANDLE_EOF) {
+                break;
+            }
+        }
+    }
+    return request.body.size() <= HttpServer::MAX_REQUEST_BYTES;
+}
+
+void HttpSysQueue::HandleRequest(const HTTP_REQUEST& raw) {
+    TRACE_ZONE("HttpSysQueue::HandleRequest");
+    auto exchange = std::make_shared<Exchange>();
+    exchange->id = nextId.fetch_add(1);
+    exchange->requestId = raw.RequestId;
+
+    HttpRequest request;
+    bool ok = ReadRequest(raw, request);
+    std::string connection = request.GetHeader("connection");
+    std::transform(connection.begin(), connection.end(), connection.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    exchange->keepAlive = raw.Version.MinorVersion >= 1 ? connection.find("close") == std::string::npos
+                                                        : connection.find("keep-alive") != std::string::npos;
+    exchange->cacheable = raw.Verb == HttpVerbGET && request.query.empty();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exchanges[exchange->id] = exchange;
+    }
+
+    if (!ok) {
+        HttpResponse badRequest;
+        badRequest.status = 400;
+        exchange->keepAlive = false;
+        Send(exchange, badRequest);
+        return;
+    }
+
+    LOG_DEBUG("Http", "Received request: " << request.method << " " << request.path);
+    HttpResponse response;
+    server.RunHandler(request, exchange->id, exchange->keepAlive, response);
+
+    if (response.completion) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            exchange->deferred = true;
+            exchange->completion = response.completion;
+            exchange->deferDeadlineMs = response.deferTimeoutMs > 0
+                                      ? HttpServer::NowMs() + response.deferTimeoutMs : 0;
+        }
+        // May resume right away (already completed): Resume() sends it
+        response.completion->Arm();
+        return;
+    }
+    Send(exchange, response);
+}
+
+bool HttpSysQueue::Resume(uint64_t id, HttpResponse& response) {
+    std::shared_ptr<Exchange> exchange;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = exchanges.find(id);
+        if (found == exchanges.end() || !found->second->deferred || !running) {
+            return false;
+        }
+        exchange = found->second;
+        exchange->deferred = false;
+        exchange->completion.reset();
+    }
+    // Sent from the completing thread: the call is overlapped and never blocks on the client
+    HttpServer::ApplyDefaultHeaders(response, exchange->keepAlive);
+    response.eventStream.clear();      // Only an immediate answer can become a stream
+    Send(exchange, response);
+    return true;
+}
+
+// ============================================================================
+// Sending
+// ============================================================================
+
+void HttpSysQueue::Send(const std::shared_ptr<Exchange>& exchange, HttpResponse& response) {
+    TRACE_ZONE("HttpSysQueue::Send");
+    auto operation = std::make_unique<Operation>();
+    operation->kind = Operation::Kind::Send;
+    operation->exchange = exchange;
+    bool stream = !response.eventStream.empty();
+
+    // The header values stay in the operation; http.sys reads them during the call
+    operation->headers = std::move(response.headers);
+    HTTP_RESPONSE& out = operation->response;
+    out.Version = HTTP_VERSION_1_1;
+    out.StatusCode = static_cast<USHORT>(response.status);
+    out.pReason = HttpServer::ReasonPhrase(response.status);
+    out.ReasonLength = static_cast<USHORT>(strlen(out.pReason));
+    bool varies = false;
+    for (const auto& header : operation->headers) {
+        int id = ResponseHeaderId(header.first);
+        if (id == HttpHeaderConnection || id == HttpHeaderKeepAlive) {
+            continue;       // Persistence is http.sys's to announce
+        }
+        varies = varies || id == HttpHeaderVary;
+        if (id >= 0) {
+            out.Headers.KnownHeaders[id].pRawValue = header.second.c_str();
+            out.Headers.KnownHeaders[id].RawValueLength = static_cast<USHORT>(header.second.size());
+            continue;
+        }
+        HTTP_UNKNOWN_HEADER unknown = {};
+        unknown.pName = header.first.c_str();
+        unknown.NameLength = static_cast<USHORT>(header.first.size());
+        unknown.pRawValue = header.second.c_str();
+        unknown.RawValueLength = static_cast<USHORT>(header.second.size());
+        operation->unknownHeaders.push_back(unknown);
+    }
+    out.Headers.UnknownHeaderCount = static_cast<USHORT>(operation->unknownHeaders.size());
+    out.Headers.pUnknownHeaders = operation->unknownHeaders.data();
+
+    // Event streams have no length: the body is just the start of the stream
+    if (!stream) {
+        operation->contentLength = std::to_string(response.GetBodySize());
+        out.Headers.KnownHeaders[HttpHeaderContentLength].pRawValue = operation->contentLength.c_str();
+        out.Headers.KnownHeaders[HttpHeaderContentLength].RawValueLength =
+            static_cast<USHORT>(operation->contentLength.size());
+    }
+
+    operation->body = response.sharedBody ? std::move(response.sharedBody)
+                                          : std::make_shared<const std::string>(std::move(response.body));
+    operation->cached = exchange->cacheable && !stream && !varies && response.status == 200 &&
+                        response.kernelCacheSeconds > 0;
+    if (!operation->body->empty()) {
+        // A whole cached response carries its body; otherwise the fragment, when there is one
+        if (!operation->cached && !response.bodyCacheKey.empty() && operation->body->size() >= FRAGMENT_MIN_BYTES) {
+            operation->fragment = FragmentFor(response.bodyCacheKey, operation->body);
+        }
+        if (operation->fragment.empty()) {
+            operation->ChunkFromMemory();
+        } else {
+            operation->chunk.DataChunkType = HttpDataChunkFromFragmentCache;
+            operation->chunk.FromFragmentCache.pFragmentName = operation->fragment.c_str();
+            operation->chunk.FromFragmentCache.FragmentNameLength =
+                static_cast<USHORT>(operation->fragment.size() * sizeof(wchar_t));
+        }
+        out.EntityChunkCount = 1;
+        out.pEntityChunks = &operation->chunk;
+    }
+    if (operation->cached) {
+        operation->cachePolicy.Policy = HttpCachePolicyTimeToLive;
+        operation->cachePolicy.SecondsToLive = static_cast<ULONG>(response.kernelCacheSeconds);
+    }
+
+    ULONG flags = stream ? HTTP_SEND_RESPONSE_FLAG_MORE_DATA
+                         : (exchange->keepAlive ? 0 : HTTP_SEND_RESPONSE_FLAG_DISCONNECT);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stream) {
+        exchange->eventStream = response.eventStream;
+        exchange->streamSending = true;
+        exchange->lastActivityMs = HttpServer::NowMs();
+    }
+    exchange->sendStart = std::chrono::steady_clock::now();
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        pendingIo++;
+        ULONG result = HttpSendHttpResponse(queue, exchange->requestId, flags, &out,
+                                            operation->cached ? &operation->cachePolicy : nullptr, nullptr,
+                                            nullptr, 0, &operation->overlapped, nullptr);
+        if (result == NO_ERROR || result == ERROR_IO_PENDING) {
+            operation.release();        // Freed when it completes
+            return;
+        }
+        pendingIo--;
+        if (operation->fragment.empty()) {
+            LOG_DEBUG("Http", "http.sys send failed: " << result);
+            break;
+        }
+        // The fragment was replaced under us: send the bytes themselves
+        operation->fragment.clear();
+        operation->ChunkFromMemory();
+    }
+    exchanges.erase(exchange->id);
+}
+
+bool HttpSysQueue::SendStreamBytes(const std::shared_ptr<Exchange>& exchange, const HttpServer::SendBuffer& bytes) {
+    auto operation = std::make_unique<Operation>();
+    operation->kind = Operation::Kind::StreamSend;
+    operation->exchange = exchange;
+    operation->body = bytes;
+    operation->ChunkFromMemory();
+    pendingIo++;
+    ULONG result = HttpSendResponseEntityBody(queue, exchange->requestId, HTTP_SEND_RESPONSE_FLAG_MORE_DATA, 1,
+                                              &operation->chunk, nullptr, nullptr, 0, &operation->overlapped,
+                                              nullptr);
+    if (result != NO_ERROR && result != ERROR_IO_PENDING) {
+        pendingIo--;
+        return false;
+    }
+    operation.release();
+    return true;
+}
+
+void HttpSysQueue::QueueStreamBytes(const std::shared_ptr<Exchange>& exchange, const HttpServer::SendBuffer& bytes) {
+    // Caller holds mutex
+    exchange->lastActivityMs = HttpServer::NowMs();
+    if (exchange->streamSending) {
+        exchange->streamQueued = bytes;     // Newest frame wins
+        return;
+    }
+    exchange->streamSending = true;
+    if (!SendStreamBytes(exchange, bytes)) {
+        exchange->streamSending = false;
+        exchange->failed = true;
+    }
+}
+
+void HttpSysQueue::OnSent(Operation* operation, bool ok) {
+    std::unique_ptr<Operation> sent(operation);
+    const std::shared_ptr<Exchange>& exchange = operation->exchange;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (exchange->eventStream.empty()) {
+        PipelineLatency::Record(PipelineLatency::Stage::HttpSend, std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - exchange->sendStart).count());
+        exchanges.erase(exchange->id);
+        return;
+    }
+
+    // Continue with the frame published meanwhile, or go idle until the next one
+    if (ok && !exchange->streamQueued) {
+        exchange->streamSending = false;
+        return;
+    }
+    if (ok) {
+        HttpServer::SendBuffer next = std::move(exchange->streamQueued);
+        exchange->streamQueued.reset();
+        if (SendStreamBytes(exchange, next)) {
+            return;
+        }
+    }
+    exchange->streamSending = false;
+    exchanges.erase(exchange->id);          // The client is gone
+}
+
+void HttpSysQueue::Sweep() {
+    int64_t now = HttpServer::NowMs();
+    int64_t lastSweep = lastSweepMs.load();
+    if (now - lastSweep < static_cast<int64_t>(HttpServer::SWEEP_INTERVAL_MS) ||
+        !lastSweepMs.compare_exchange_strong(lastSweep, now)) {
+        return;     // Another worker swept recently
+    }
+
+    static const HttpServer::SendBuffer heartbeat = std::make_shared<const std::string>(": heartbeat\n\n");
+    std::vector<std::shared_ptr<HttpCompletion>> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = exchanges.begin(); it != exchanges.end();) {
+            Exchange& exchange = *it->second;
+            if (exchange.deferred && exchange.deferDeadlineMs > 0 && now > exchange.deferDeadlineMs) {
+                if (auto completion = exchange.completion.lock()) {
+                    expired.push_back(std::move(completion));
+                }
+            } else if (!exchange.eventStream.empty() && !exchange.streamSending && !exchange.failed &&
+                       now - exchange.lastActivityMs > HttpServer::STREAM_HEARTBEAT_MS) {
+                // A dead client shows as the failed send
+                QueueStreamBytes(it->second, heartbeat);
+            }
+            it = exchange.failed ? exchanges.erase(it) : std::next(it);
+        }
+    }
+
+    // Completed outside the lock: Complete() resumes through it
+    for (const auto& completion : expired) {
+        HttpResponse timedOut;
+        timedOut.status = 504;
+        timedOut.SetBody("{\"error\":\"Request timed out\"}");
+        completion->Complete(std::move(timedOut));
+    }
+}
+
+size_t HttpSysQueue::PublishFrame(const std::string& streamName, const HttpServer::SendBuffer& frame) {
+    size_t subscribers = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : exchanges) {
+        if (entry.second->eventStream == streamName && !entry.second->failed) {
+            QueueStreamBytes(entry.second, frame);
+            subscribers++;
+        }
+    }
+    return subscribers;
+}
+
+size_t HttpSysQueue::GetSubscriberCount(const std::string& streamName) {
+    size_t subscribers = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : exchanges) {
+        if (entry.second->eventStream == streamName && !entry.second->failed) {
+            subscribers++;
+        }
+    }
+    return subscribers;
+}
+
+// ============================================================================
+// Fragment Cache
+// ============================================================================
+
+std::wstring HttpSysQueue::FragmentFor(const std::string& key, const HttpServer::SendBuffer& bytes) {
+    std::lock_guard<std::mutex> lock(fragmentMutex);
+    Fragment& fragment = fragments[key];
+    if (fragment.bytes && fragment.bytes->data() == bytes->data() && fragment.bytes->size() == bytes->size()) {
+        return fragment.url;
+    }
+
+    // A new name per version: a send that picked up the old name still finds it
+    // until it is flushed, and one that loses the race falls back to memory
+    std::wstring url = urls.front() + L"fragments/" + Widen(key) + L"/" + std::to_wstring(++fragmentGeneration);
+    HTTP_DATA_CHUNK chunk = {};
+    chunk.DataChunkType = HttpDataChunkFromMemory;
+    chunk.FromMemory.pBuffer = const_cast<char*>(bytes->data());
+    chunk.FromMemory.BufferLength = static_cast<ULONG>(bytes->size());
+    HTTP_CACHE_POLICY policy = {};
+    policy.Policy = HttpCachePolicyUserInvalidates;
+    ULONG result = HttpAddFragmentToCache(queue, url.c_str(), &chunk, &policy, nullptr);
+    if (result != NO_ERROR) {
+        LOG_DEBUG("Http", "http.sys fragment cache refused " << key << " (" << bytes->size() << " bytes): " << result);
+        return std::wstring();
+    }
+    if (!fragment.url.empty()) {
+        HttpFlushResponseCache(queue, fragment.url.c_str(), 0, nullptr);
+    }
+    fragment.bytes = bytes;
+    fragment.url = url;
+    return url;
+}
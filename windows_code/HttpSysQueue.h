@@ -0,0 +1,125 @@
+#pragma once
+
+#include "HttpServer.h"
+#include <http.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#pragma comment(lib, "httpapi.lib")
+
+/**
+ * HttpSysQueue - HttpServer on an http.sys request queue (Backend::HttpSys)
+ *
+ * The kernel's HTTP stack (HTTP Server API v2) owns the port: it accepts,
+ * keeps connections alive (IDLE_TIMEOUT_MS), parses requests and frames
+ * responses. This class keeps HttpServer::PENDING_ACCEPTS receives
+ * outstanding on a completion port served by WORKER_THREADS threads, turns
+ * each request into an HttpRequest, runs it through the server's handler and
+ * sends the HttpResponse back with overlapped calls. What HttpServer promises
+ * holds here too: deferred answers (504 past their timeout), event streams
+ * (the newest frame wins, quiet streams get heartbeats), shared bodies sent
+ * without copying, the default headers and MAX_REQUEST_BYTES. Connection and
+ * Keep-Alive headers are http.sys's to write.
+ *
+ * Kernel caching, what the backend is for:
+ *   - Whole responses: a 200 the handler allowed (AllowKernelCache) for a GET
+ *     without a query string, and without Vary, is cached by http.sys for
+ *     that many seconds; repeats of the URL are answered from the kernel
+ *     without waking a worker.
+ *   - Bodies: a shared body with a cache key is added to the kernel fragment
+ *     cache (HttpAddFragmentToCache) the first time those bytes are sent;
+ *     every later response with them references the fragment instead of
+ *     handing the buffer down again, and a new version under the key
+ *     replaces the old fragment. /context negotiates per request (versions,
+ *     encodings, MessagePack), so its requests still reach the handler but
+ *     its bodies leave from the kernel.
+ *
+ * Registers http://localhost:<port>/ and http://127.0.0.1:<port>/. Outside
+ * an elevated process that takes a URL reservation
+ * (netsh http add urlacl url=http://localhost:8777/ user=<user>); without
+ * one Start() fails and HttpServer serves with Winsock instead.
+ */
+class HttpSysQueue {
+public:
+    static constexpr ULONG RECEIVE_BUFFER_BYTES = 16 * 1024;  // Headers and the start of the body
+    static constexpr size_t FRAGMENT_MIN_BYTES = 4096;       // Smaller bodies aren't worth a cache entry
+
+    HttpSysQueue(HttpServer& server, int port);
+    ~HttpSysQueue();
+
+    HttpSysQueue(const HttpSysQueue&) = delete;
+    HttpSysQueue& operator=(const HttpSysQueue&) = delete;
+
+    /**
+     * @brief Create the request queue and register the port's URLs
+     * @return false (logged) when http.sys refuses them; nothing is left open
+     */
+    bool Start();
+    void Stop();
+    void Run();     // Blocking, as HttpServer::Run
+
+    // HttpServer's entry points, for this backend
+    bool Resume(uint64_t id, HttpResponse& response);
+    size_t PublishFrame(const std::string& streamName, const HttpServer::SendBuffer& frame);
+    size_t GetSubscriberCount(const std::string& streamName);
+
+private:
+    struct Exchange;
+    struct Operation;
+
+    void WorkerThread();
+    bool PostReceive(Operation* operation, HTTP_REQUEST_ID requestId);
+    void OnReceived(Operation* operation, ULONG error, DWORD bytes);
+    void OnSent(Operation* operation, bool ok);
+    void HandleRequest(const HTTP_REQUEST& raw);
+    bool ReadRequest(const HTTP_REQUEST& raw, HttpRequest& request);
+
+    // Send the answer (the headers, for an event stream); the exchange ends
+    // when it is sent unless it became a stream
+    void Send(const std::shared_ptr<Exchange>& exchange, HttpResponse& response);
+    // mutex held
+    bool SendStreamBytes(const std::shared_ptr<Exchange>& exchange, const HttpServer::SendBuffer& bytes);
+    void QueueStreamBytes(const std::shared_ptr<Exchange>& exchange, const HttpServer::SendBuffer& bytes);
+    void Sweep();
+
+    // The fragment holding these bytes under this key, added (replacing the
+    // key's previous version) if needed; empty when the kernel won't take it
+    std::wstring FragmentFor(const std::string& key, const HttpServer::SendBuffer& bytes);
+
+    void Shutdown();
+    void Close();
+
+    HttpServer& server;
+    int port;
+    std::vector<std::wstring> urls;         // Registered prefixes; the first names fragments
+    std::atomic<bool> running{false};
+
+    bool initialized = false;               // HttpInitialize
+    HTTP_SERVER_SESSION_ID session = HTTP_NULL_ID;
+    HTTP_URL_GROUP_ID urlGroup = HTTP_NULL_ID;
+    HANDLE queue = nullptr;
+    HANDLE completionPort = nullptr;
+    std::vector<std::thread> workers;
+    std::atomic<int> pendingIo{0};
+    std::atomic<int64_t> lastSweepMs{0};
+
+    // Requests being answered, deferred or streaming, by the id completions resume
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Exchange>> exchanges;
+    std::atomic<uint64_t> nextId{1};
+
+    // Fragment cache: the current bytes of each key and their fragment name
+    struct Fragment {
+        HttpServer::SendBuffer bytes;       // Held, so the address can't be reused by other bytes
+        std::wstring url;
+    };
+    std::mutex fragmentMutex;
+    std::unordered_map<std::string, Fragment> fragments;
+    uint64_t fragmentGeneration = 0;
+};
@@ -0,0 +1,131 @@
+#include "InferenceScheduler.h"
+#include <algorithm>
+#include <cstdio>
+#include "Trace.h"
+
+InferenceScheduler& InferenceScheduler::Instance() {
+    static InferenceScheduler instance;
+    return instance;
+}
+
+double InferenceScheduler::Smooth(double average, double sample) {
+    return average <= 0.0 ? sample : average + SMOOTHING * (sample - average);
+}
+
+void InferenceScheduler::InteractiveQueued(size_t jobs) {
+    interactive.fetch_add(jobs, std::memory_order_acq_rel);
+}
+
+void InferenceScheduler::InteractiveDone(size_t jobs) {
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs = (std::min)(jobs, interactive.load(std::memory_order_acquire));
+        idle = interactive.fetch_sub(jobs, std::memory_order_acq_rel) == jobs;
+    }
+    if (idle) {
+        drained.notify_all();
+    }
+}
+
+void InferenceScheduler::LearnInteractive(float latencyMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    whisperMsPerJob = Smooth(whisperMsPerJob, latencyMs);
+}
+
+InferenceScheduler::Caption::Caption() = default;
+
+InferenceScheduler::Caption::~Caption() {
+    if (tokens > 0) {
+        InferenceScheduler& scheduler = Instance();
+        std::lock_guard<std::mutex> lock(scheduler.mutex);
+        scheduler.captionTokens = Smooth(scheduler.captionTokens, static_cast<double>(tokens));
+    }
+}
+
+void InferenceScheduler::Caption::Step(size_t produced, double stepMs) {
+    if (produced == 0) {
+        return;
+    }
+    tokens += produced;
+    InferenceScheduler& scheduler = Instance();
+    std::lock_guard<std::mutex> lock(scheduler.mutex);
+    scheduler.captionMsPerToken = Smooth(scheduler.captionMsPerToken, stepMs / produced);
+}
+
+std::chrono::steady_clock::duration InferenceScheduler::Caption::Yield(size_t generated, size_t maxTokens) {
+    InferenceScheduler& scheduler = Instance();
+    if (scheduler.interactive.load(std::memory_order_acquire) == 0) {
+        return {};
+    }
+    const auto deadline = std::chrono::milliseconds(MAX_YIELD_MS);
+    if (parked >= deadline) {
+        return {};
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lock(scheduler.mutex);
+        // Expected tokens still to come: the learned caption length, at least one
+        double expected = scheduler.captionTokens > 0 ? scheduler.captionTokens : static_cast<double>(maxTokens);
+        double remaining = (std::max)(1.0, (std::min)(expected, static_cast<double>(maxTokens)) -
+                                           static_cast<double>(generated));
+        if (scheduler.captionMsPerToken > 0 && remaining * scheduler.captionMsPerToken <= FINISH_WITHIN_MS) {
+            scheduler.finishedInstead.fetch_add(1);
+            return {};
+        }
+
+        TRACE_ZONE("Caption yields to whisper");
+        scheduler.yields.fetch_add(1);
+        while (scheduler.interactive.load(std::memory_order_acquire) > 0) {
+            auto waited = std::chrono::steady_clock::now() - start;
+            if (parked + waited >= deadline) {
+                scheduler.deadlineOverruns.fetch_add(1);
+                break;
+            }
+            // Re-check once the outstanding jobs should be through, or at the deadline
+            auto estimate = std::chrono::milliseconds((std::max)(static_cast<int64_t>(RECHECK_MS), static_cast<int64_t>(
+                scheduler.whisperMsPerJob * scheduler.interactive.load(std::memory_order_acquire))));
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - parked - waited);
+            scheduler.drained.wait_for(lock, (std::min)(estimate, left));
+        }
+    }
+    auto waited = std::chrono::steady_clock::now() - start;
+    parked += waited;
+    scheduler.parkedMs.fetch_add(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(waited).count()));
+    return waited;
+}
+
+std::string InferenceScheduler::FormatPrometheus() const {
+    double msPerJob, msPerToken, tokensPerCaption;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        msPerJob = whisperMsPerJob;
+        msPerToken = captionMsPerToken;
+        tokensPerCaption = captionTokens;
+    }
+    std::string out;
+    char line[160];
+    std::snprintf(line, sizeof(line), "perception_scheduler_interactive_outstanding %zu\n", interactive.load());
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_scheduler_caption_yields_total %llu\n",
+                  static_cast<unsigned long long>(yields.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_scheduler_caption_parked_ms_total %llu\n",
+                  static_cast<unsigned long long>(parkedMs.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_scheduler_caption_finished_instead_total %llu\n",
+                  static_cast<unsigned long long>(finishedInstead.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_scheduler_caption_deadline_overruns_total %llu\n",
+                  static_cast<unsigned long long>(deadlineOverruns.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_scheduler_whisper_ms_per_job %.1f\n", msPerJob);
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_scheduler_caption_ms_per_token %.2f\n", msPerToken);
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_scheduler_caption_tokens %.1f\n", tokensPerCaption);
+    out += line;
+    return out;
+}
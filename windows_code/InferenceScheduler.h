@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * InferenceScheduler - Caption decoding gives way to whisper
+ *
+ * Whisper jobs are interactive: someone waits on the transcript. Camera and
+ * screen captions are background work on a cadence. Both run on the same
+ * cores, and a caption mid-decode when an utterance arrives used to take
+ * its share of them for the rest of the caption, which is exactly when the
+ * voice p99 spiked.
+ *
+ * The whisper queues report every job from enqueue to publication
+ * (InteractiveQueued/InteractiveDone) and how long it took to transcribe.
+ * Caption decoders call Yield() between tokens: while interactive jobs are
+ * outstanding the decoder parks there, KV cache and all, and resumes where
+ * it left off once they are through. Two limits keep captions from starving:
+ *
+ * - Finishing is cheaper than parking: a caption whose remaining tokens
+ *   (learned tokens per caption less those generated, at the learned ms per
+ *   token) fit in FINISH_WITHIN_MS runs to the end.
+ * - Each caption has a deadline of MAX_YIELD_MS spent parked; past it the
+ *   caption runs to completion even under continuous speech.
+ *
+ * A parked decoder wakes when the last interactive job is published, and at
+ * the estimated time the outstanding jobs need (learned whisper ms per job),
+ * whichever comes first (at least every RECHECK_MS), and re-checks.
+ *
+ * Usage:
+ *   InferenceScheduler::Instance().InteractiveQueued();            // whisper job enqueued
+ *   InferenceScheduler::Instance().LearnInteractive(latencyMs);    // transcribed
+ *   InferenceScheduler::Instance().InteractiveDone(1);             // published
+ *
+ *   InferenceScheduler::Caption caption;                           // per caption
+ *   for (...) {
+ *       startTime += caption.Yield(generated, maxTokens);           // between tokens
+ *       ... decode step ...
+ *       caption.Step(tokensProduced, stepMs);
+ *   }
+ *
+ * Thread-safe; the Yield() fast path (nothing outstanding) is one atomic load.
+ */
+class InferenceScheduler {
+public:
+    static constexpr int MAX_YIELD_MS = 4000;
+    static constexpr int FINISH_WITHIN_MS = 150;
+    static constexpr int RECHECK_MS = 50;
+    static constexpr double SMOOTHING = 0.1;        // EWMA weight of the newest observation
+
+    static InferenceScheduler& Instance();
+
+    InferenceScheduler(const InferenceScheduler&) = delete;
+    InferenceScheduler& operator=(const InferenceScheduler&) = delete;
+
+    // === Interactive side (whisper queues) ===
+
+    void InteractiveQueued(size_t jobs = 1);
+    // Published, dropped or abandoned with their queue
+    void InteractiveDone(size_t jobs);
+    // A transcription's duration, for the estimate of outstanding work
+    void LearnInteractive(float latencyMs);
+    size_t GetInteractiveOutstanding() const { return interactive.load(std::memory_order_acquire); }
+
+    // === Background side (caption decoders) ===
+
+    class Caption {
+    public:
+        Caption();
+        ~Caption();
+
+        Caption(const Caption&) = delete;
+        Caption& operator=(const Caption&) = delete;
+
+        /**
+         * @brief Park while interactive work is outstanding, within this caption's limits
+         * @return Time spent parked (add it to the caption's own time budget)
+         */
+        std::chrono::steady_clock::duration Yield(size_t generated, size_t maxTokens);
+
+        // A decode step: the tokens it produced (speculation: several) and its duration
+        void Step(size_t produced, double stepMs);
+
+    private:
+        std::chrono::steady_clock::duration parked{};
+        size_t tokens = 0;
+    };
+
+    /**
+     * @brief Prometheus text: yields, parked time, deadline overruns and the learned costs
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    InferenceScheduler() = default;
+
+    static double Smooth(double average, double sample);
+
+    std::atomic<size_t> interactive{0};
+    mutable std::mutex mutex;
+    std::condition_variable drained;
+
+    // Learned costs (under mutex)
+    double whisperMsPerJob = 0.0;
+    double captionMsPerToken = 0.0;
+    double captionTokens = 0.0;
+
+    std::atomic<uint64_t> yields{0};
+    std::atomic<uint64_t> parkedMs{0};
+    std::atomic<uint64_t> finishedInstead{0};       // Close enough to the end to run on
+    std::atomic<uint64_t> deadlineOverruns{0};      // Ran on after MAX_YIELD_MS parked
+};
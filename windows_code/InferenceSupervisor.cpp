@@ -0,0 +1,244 @@
+#include "InferenceSupervisor.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+std::wstring Widen(const std::string& text) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring wide(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), &wide[0], length);
+    return wide;
+}
+
+// One argument as CommandLineToArgvW reads it back (paths: no quotes inside,
+// but a directory may end in a backslash)
+std::wstring Quote(const std::wstring& argument) {
+    std::wstring quoted = L"\"" + argument;
+    size_t backslashes = 0;
+    for (size_t i = argument.size(); i > 0 && argument[i - 1] == L'\\'; --i) {
+        backslashes++;
+    }
+    quoted.append(backslashes, L'\\');
+    return quoted + L"\"";
+}
+
+}  // namespace
+
+InferenceSupervisor& InferenceSupervisor::Instance() {
+    static InferenceSupervisor instance;
+    return instance;
+}
+
+InferenceSupervisor::InferenceSupervisor() {
+    job = CreateJobObjectW(nullptr, nullptr);
+    if (job) {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+        limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        if (!SetInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits))) {
+            LOG_WARNING("Supervisor", "Cannot set the worker job's limits: " << GetLastError());
+        }
+    } else {
+        LOG_WARNING("Supervisor", "No job object for the workers (" << GetLastError()
+                    << "); they watch the engine's process instead");
+    }
+}
+
+bool InferenceSupervisor::SetCpuRate(int maxPercent, int minPercent) {
+    if (!job) {
+        return maxPercent <= 0;
+    }
+    // Rates are in hundredths of a percent
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate = {};
+    if (maxPercent > 0) {
+        rate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_MIN_MAX_RATE;
+        rate.MinRate = static_cast<WORD>((std::max)(0, (std::min)(minPercent, maxPercent)) * 100);
+        rate.MaxRate = static_cast<WORD>((std::min)(maxPercent, 100) * 100);
+    }
+    if (!SetInformationJobObject(job, JobObjectCpuRateControlInformation, &rate, sizeof(rate))) {
+        LOG_ERROR("Supervisor", "Cannot set the workers' CPU rate: " << GetLastError());
+        return false;
+    }
+    return true;
+}
+
+InferenceSupervisor::~InferenceSupervisor() {
+    if (job) {
+        CloseHandle(job);
+    }
+}
+
+double InferenceSupervisor::CpuSeconds(HANDLE process) {
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(process, &created, &exited, &kernel, &user)) {
+        return 0.0;
+    }
+    auto ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return static_cast<double>(ticks(kernel) + ticks(user)) / 1e7;
+}
+
+void InferenceSupervisor::Started(Process* process) {
+    // kind is a literal: the map keeps a copy of the name, live the pointer
+    std::lock_guard<std::mutex> lock(mutex);
+    live[process] = process->kind;
+    kinds[process->kind].starts++;
+}
+
+void InferenceSupervisor::Exited(Process* process, bool failed, Failure failure) {
+    double cpuSeconds = CpuSeconds(process->handle);
+    std::lock_guard<std::mutex> lock(mutex);
+    live.erase(process);
+    Kind& kind = kinds[process->kind];
+    kind.exitedCpuSeconds += cpuSeconds;
+    if (failed) {
+        (failure == Failure::Hang ? kind.hangs : kind.crashes)++;
+    }
+}
+
+std::string InferenceSupervisor::FormatPrometheus() const {
+    std::map<std::string, std::pair<size_t, double>> running;     // Live children, their CPU
+    std::map<std::string, Kind> totals;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        totals = kinds;
+        for (const auto& entry : live) {
+            auto& counts = running[entry.second];
+            counts.first++;
+            counts.second += CpuSeconds(entry.first->handle);
+        }
+    }
+
+    std::string out;
+    char line[192];
+    for (const auto& entry : totals) {
+        const char* kind = entry.first.c_str();
+        const Kind& counts = entry.second;
+        const auto& alive = running[entry.first];
+        std::snprintf(line, sizeof(line), "perception_worker_processes{kind=\"%s\"} %zu\n", kind, alive.first);
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_worker_starts_total{kind=\"%s\"} %llu\n", kind,
+                      static_cast<unsigned long long>(counts.starts));
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_worker_failures_total{kind=\"%s\",reason=\"crash\"} %llu\n",
+                      kind, static_cast<unsigned long long>(counts.crashes));
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_worker_failures_total{kind=\"%s\",reason=\"hang\"} %llu\n",
+                      kind, static_cast<unsigned long long>(counts.hangs));
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_worker_cpu_seconds_total{kind=\"%s\"} %.3f\n", kind,
+                      counts.exitedCpuSeconds + alive.second);
+        out += line;
+    }
+    return out;
+}
+
+// ============================================================================
+// Process
+// ============================================================================
+
+InferenceSupervisor::Process::Process(const char* kind, std::vector<std::string> arguments, DWORD priorityClass)
+    : kind(kind), arguments(std::move(arguments)), priorityClass(priorityClass) {
+}
+
+InferenceSupervisor::Process::~Process() {
+    Stop();
+}
+
+bool InferenceSupervisor::Process::EnsureRunning() {
+    if (IsRunning()) {
+        return true;
+    }
+    if (std::chrono::steady_clock::now() < notBefore) {
+        return false;
+    }
+    return Spawn();
+}
+
+bool InferenceSupervisor::Process::IsRunning() {
+    if (!handle) {
+        return false;
+    }
+    if (WaitForSingleObject(handle, 0) != WAIT_OBJECT_0) {
+        return true;
+    }
+    DWORD exitCode = 0;
+    GetExitCodeProcess(handle, &exitCode);
+    LOG_WARNING("Supervisor", kind << " worker (pid " << processId << ") exited with code 0x" << std::hex
+                << exitCode << std::dec);
+    Reap(true, Failure::Crash);
+    return false;
+}
+
+void InferenceSupervisor::Process::Fail(Failure failure) {
+    if (!handle) {
+        return;
+    }
+    LOG_WARNING("Supervisor", kind << " worker (pid " << processId << ") "
+                << (failure == Failure::Hang ? "stopped responding" : "failed") << "; terminating it");
+    TerminateProcess(handle, 1);
+    WaitForSingleObject(handle, 5000);
+    Reap(true, failure);
+}
+
+void InferenceSupervisor::Process::Stop() {
+    if (!handle) {
+        return;
+    }
+    TerminateProcess(handle, 0);
+    WaitForSingleObject(handle, 5000);
+    LOG_DEBUG("Supervisor", kind << " worker (pid " << processId << ") stopped");
+    Reap(false, Failure::Crash);
+}
+
+void InferenceSupervisor::Process::Reap(bool failed, Failure failure) {
+    Instance().Exited(this, failed, failure);
+    CloseHandle(handle);
+    handle = nullptr;
+    processId = 0;
+    if (failed) {
+        // A one-off crash restarts at once; a worker that keeps failing backs off
+        int backoffMs = consecutiveFailures == 0 ? 0
+                      : (std::min)(BACKOFF_MAX_MS, BACKOFF_MIN_MS << (std::min)(consecutiveFailures - 1, 16));
+        consecutiveFailures++;
+        notBefore = std::chrono::steady_clock::now() + std::chrono::milliseconds(backoffMs);
+        if (backoffMs > 0) {
+            LOG_INFO("Supervisor", "Restarting the " << kind << " worker in " << backoffMs << "ms at the earliest");
+        }
+    }
+}
+
+bool InferenceSupervisor::Process::Spawn() {
+    // This executable again, in worker mode
+    wchar_t path[MAX_PATH] = {};
+    GetModuleFileNameW(nullptr, path, MAX_PATH);
+    std::wstring command = Quote(path);
+    for (const std::string& argument : arguments) {
+        command += L" " + Quote(Widen(argument));
+    }
+
+    // Suspended until it is in the job: it must not outlive the engine even if it crashes at once
+    STARTUPINFOW startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process = {};
+    if (!CreateProcessW(nullptr, &command[0], nullptr, nullptr, FALSE, CREATE_SUSPENDED | priorityClass,
+                        nullptr, nullptr, &startup, &process)) {
+        LOG_ERROR("Supervisor", "Cannot start the " << kind << " worker: " << GetLastError());
+        notBefore = std::chrono::steady_clock::now() + std::chrono::milliseconds(BACKOFF_MAX_MS);
+        return false;
+    }
+    HANDLE job = Instance().job;
+    if (job && !AssignProcessToJobObject(job, process.hProcess)) {
+        LOG_WARNING("Supervisor", "Cannot add the " << kind << " worker to the job: " << GetLastError());
+    }
+    ResumeThread(process.hThread);
+    CloseHandle(process.hThread);
+
+    handle = process.hProcess;
+    processId = process.dwProcessId;
+    Instance().Started(this);
+    LOG_INFO("Supervisor", kind << " worker started (pid " << processId << ")");
+    return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <windows.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * InferenceSupervisor - Worker processes for whisper and FastVLM, kept alive
+ *
+ * Out-of-process inference (--isolate-inference) runs each model in a child
+ * of this executable (InferenceWorker): a crash or a runaway allocation in
+ * ggml or ORT takes down one worker, not the engine, its HTTP server and the
+ * other pipeline. The supervisor owns the children:
+ *
+ *   - Every child is assigned to one Job object with KILL_ON_JOB_CLOSE, so
+ *     they die with the engine however it exits.
+ *   - A child that exits on its own is a crash; one its owner gives up on
+ *     (no heartbeat, no caption) is terminated as a hang. Either way the
+ *     next EnsureRunning() restarts it: at once after the first failure,
+ *     then after a backoff that doubles with each further failure in a row
+ *     (BACKOFF_MIN_MS .. BACKOFF_MAX_MS) until a child has done some work
+ *     again (MarkHealthy).
+ *   - Stop() ends a child without counting it (scale-down, shutdown).
+ *
+ * SetCpuRate() hard-caps the children's combined CPU (ResourceQuota): the
+ * cap binds the inference alone, never the engine's capture threads.
+ *
+ * /metrics gets the live children, starts, failures by reason and the CPU
+ * the children used, per kind ("whisper", "caption").
+ *
+ * Usage:
+ *   InferenceSupervisor::Process worker("whisper", {"--whisper-worker", channelName, ...});
+ *   if (worker.EnsureRunning()) { ... talk to it ... }
+ *   worker.Fail(InferenceSupervisor::Failure::Hang);    // Stuck: killed, restarted later
+ *
+ * Thread-safe; a Process is used by one owner thread at a time.
+ */
+class InferenceSupervisor {
+public:
+    static constexpr int BACKOFF_MIN_MS = 500;
+    static constexpr int BACKOFF_MAX_MS = 30000;
+
+    enum class Failure { Crash, Hang };
+
+    static InferenceSupervisor& Instance();
+
+    InferenceSupervisor(const InferenceSupervisor&) = delete;
+    InferenceSupervisor& operator=(const InferenceSupervisor&) = delete;
+
+    // One supervised child: this executable with `arguments`
+    class Process {
+    public:
+        // kind: the metrics label; priorityClass: the child's (e.g. BELOW_NORMAL_PRIORITY_CLASS)
+        Process(const char* kind, std::vector<std::string> arguments,
+                DWORD priorityClass = NORMAL_PRIORITY_CLASS);
+        ~Process();
+
+        Process(const Process&) = delete;
+        Process& operator=(const Process&) = delete;
+
+        // Running, or started now unless still backing off from a failure
+        bool EnsureRunning();
+        // Alive; a child found exited is reaped and counted as a crash
+        bool IsRunning();
+        // Terminate a child that stopped responding; counted, backs off
+        void Fail(Failure failure);
+        // Terminate without counting it
+        void Stop();
+        // The child served a request: the failure backoff starts over
+        void MarkHealthy() { consecutiveFailures = 0; }
+
+        HANDLE GetHandle() const { return handle; }
+        DWORD GetProcessId() const { return processId; }
+
+    private:
+        friend class InferenceSupervisor;
+
+        bool Spawn();
+        // Close the exited or terminated child; failed: count it and schedule the backoff
+        void Reap(bool failed, Failure failure);
+
+        const char* kind;
+        std::vector<std::string> arguments;
+        DWORD priorityClass;
+        HANDLE handle = nullptr;
+        DWORD processId = 0;
+        int consecutiveFailures = 0;
+        std::chrono::steady_clock::time_point notBefore{};
+    };
+
+    /**
+     * @brief Cap the children's combined CPU, percent of all logical processors; 0 lifts the cap
+     * @param minPercent Held for them under contention (at most maxPercent)
+     * @return false without a job, or when the rate can't be set (logged)
+     */
+    bool SetCpuRate(int maxPercent, int minPercent);
+
+    /**
+     * @brief Prometheus text: live workers, starts, failures and CPU seconds per kind
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    InferenceSupervisor();
+    ~InferenceSupervisor();
+
+    struct Kind {
+        uint64_t starts = 0;
+        uint64_t crashes = 0;
+        uint64_t hangs = 0;
+        double exitedCpuSeconds = 0.0;      // Reaped children's user + kernel time
+    };
+
+    // Process bookkeeping (under mutex)
+    void Started(Process* process);
+    void Exited(Process* process, bool failed, Failure failure);
+
+    static double CpuSeconds(HANDLE process);
+
+    HANDLE job;
+    mutable std::mutex mutex;
+    std::map<std::string, Kind> kinds;
+    std::map<Process*, const char*> live;     // Running children and their kind
+};
@@ -0,0 +1,215 @@
+#include "InferenceWorker.h"
+#include "CameraVisionEngine.h"
+#include "Log.h"
+#include "SharedFrameRing.h"
+#include "WhisperChannel.h"
+#include "WhisperTranscriber.h"
+#include <windows.h>
+#include <shellapi.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "whisper.h"
+
+#pragma comment(lib, "shell32.lib")
+
+namespace {
+
+const int WARMUP_SEC = 2;               // As AsyncWhisperQueue's warm-up
+const int CAPTION_POLL_MS = 20;
+
+std::string Narrow(const wchar_t* text) {
+    int bytes = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
+    std::string narrow(bytes > 0 ? bytes - 1 : 0, '\0');
+    if (bytes > 1) {
+        WideCharToMultiByte(CP_UTF8, 0, text, -1, &narrow[0], bytes, nullptr, nullptr);
+    }
+    return narrow;
+}
+
+// The engine, to leave with it (null: the job object is all there is)
+HANDLE OpenEngine(const std::string& pid) {
+    return OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(std::strtoul(pid.c_str(), nullptr, 10)));
+}
+
+bool EngineGone(HANDLE engine) {
+    return engine && WaitForSingleObject(engine, 0) == WAIT_OBJECT_0;
+}
+
+// whisper hooks; user data is the channel header
+bool OnAbortCheck(void* userData) {
+    auto* header = static_cast<WhisperChannel::Header*>(userData);
+    header->heartbeat.fetch_add(1, std::memory_order_relaxed);
+    return header->abort.load(std::memory_order_relaxed) != 0;
+}
+
+bool OnEncoderBegin(whisper_context*, whisper_state*, void* userData) {
+    return !OnAbortCheck(userData);
+}
+
+void WriteResponse(const WhisperChannel& channel, const WhisperTranscriber::Result& result) {
+    WhisperChannel::Header* header = channel.GetHeader();
+    char* text = channel.Text();
+    size_t textBytes = (std::min)(result.text.size(), WhisperChannel::MAX_TEXT_BYTES);
+    std::memcpy(text, result.text.data(), textBytes);
+    size_t rejectedBytes = 0;
+    for (const std::string& rejected : result.rejected) {
+        if (textBytes + rejectedBytes + rejected.size() + 1 > WhisperChannel::MAX_TEXT_BYTES) {
+            break;
+        }
+        std::memcpy(text + textBytes + rejectedBytes, rejected.c_str(), rejected.size() + 1);
+        rejectedBytes += rejected.size() + 1;
+    }
+    size_t tailCount = (std::min)(result.tailTokens.size(), WhisperChannel::MAX_TOKENS);
+    std::memcpy(channel.Tail(), result.tailTokens.data(), tailCount * sizeof(int32_t));
+
+    header->textBytes = static_cast<uint32_t>(textBytes);
+    header->rejectedBytes = static_cast<uint32_t>(rejectedBytes);
+    header->tailCount = static_cast<uint32_t>(tailCount);
+    header->ok = result.ok ? 1 : 0;
+}
+
+}  // namespace
+
+bool InferenceWorker::IsWorkerCommand(const std::string& argument) {
+    return argument == "--whisper-worker" || argument == "--caption-worker";
+}
+
+int InferenceWorker::Run() {
+    int count = 0;
+    LPWSTR* wide = CommandLineToArgvW(GetCommandLineW(), &count);
+    if (!wide) {
+        return 2;
+    }
+    std::vector<std::string> arguments;
+    for (int i = 2; i < count; ++i) {
+        arguments.push_back(Narrow(wide[i]));
+    }
+    std::string command = count > 1 ? Narrow(wide[1]) : std::string();
+    LocalFree(wide);
+
+    int exitCode = command == "--whisper-worker" ? RunWhisper(arguments) : RunCaption(arguments);
+    Log::Flush();
+    return exitCode;
+}
+
+int InferenceWorker::RunWhisper(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 4) {
+        LOG_ERROR("Worker", "Usage: --whisper-worker <channel> <enginePid> <gpu> <model> [<model>...]");
+        return 2;
+    }
+    HANDLE engine = OpenEngine(arguments[1]);
+    WhisperChannel channel;
+    if (!channel.Open(arguments[0])) {
+        return 1;
+    }
+    WhisperChannel::Header* header = channel.GetHeader();
+
+    int gpu = std::atoi(arguments[2].c_str());
+    struct whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = gpu >= 0;
+    cparams.gpu_device = (std::max)(gpu, 0);
+    std::vector<whisper_context*> models;
+    std::vector<whisper_state*> states;
+    for (size_t i = 3; i < arguments.size(); ++i) {
+        whisper_context* model = whisper_init_from_file_with_params(arguments[i].c_str(), cparams);
+        whisper_state* state = model ? whisper_init_state(model) : nullptr;
+        if (!state) {
+            LOG_ERROR("Worker", "Cannot load whisper model " << arguments[i]);
+            if (model) {
+                whisper_free(model);
+            }
+            break;
+        }
+        models.push_back(model);
+        states.push_back(state);
+    }
+
+    int exitCode = 1;
+    if (models.size() == arguments.size() - 3) {
+        // Threads come with each request; one until then
+        WhisperTranscriber transcriber(1);
+
+        // Warm every tier before reporting ready; an abort (shutdown, a job that
+        // gave way) cuts it short
+        const std::vector<float> silence(16000 * WARMUP_SEC, 0.0f);
+        for (size_t model = 0; model < models.size(); ++model) {
+            WhisperTranscriber::Request warmUp;
+            warmUp.samples = silence.data();
+            warmUp.count = silence.size();
+            warmUp.encoderBegin = &OnEncoderBegin;
+            warmUp.abortCheck = &OnAbortCheck;
+            warmUp.hookData = header;
+            transcriber.Transcribe(models[model], states[model], warmUp);
+        }
+        header->ready.store(1);
+        SetEvent(channel.ResponseEvent());
+        LOG_INFO("Worker", "Whisper worker ready (" << models.size() << " model tier"
+                 << (models.size() == 1 ? "" : "s") << ")");
+
+        HANDLE waits[2] = { channel.RequestEvent(), engine };
+        std::vector<int32_t> prompt;
+        while (WaitForMultipleObjects(engine ? 2 : 1, waits, FALSE, INFINITE) == WAIT_OBJECT_0) {
+            size_t model = (std::min)(static_cast<size_t>(header->model), models.size() - 1);
+            transcriber.SetThreads(header->threads);
+            prompt.assign(channel.Prompt(), channel.Prompt() + (std::min)(static_cast<size_t>(header->promptCount),
+                                                                          WhisperChannel::MAX_TOKENS));
+
+            WhisperTranscriber::Request request;
+            request.samples = channel.Samples();
+            request.count = (std::min)(static_cast<size_t>(header->sampleCount), WhisperChannel::MAX_SAMPLES);
+            request.prompt = &prompt;
+            request.encoderBegin = &OnEncoderBegin;
+            request.abortCheck = &OnAbortCheck;
+            request.hookData = header;
+            WriteResponse(channel, transcriber.Transcribe(models[model], states[model], request));
+            SetEvent(channel.ResponseEvent());
+        }
+        exitCode = 0;
+    }
+
+    for (size_t i = 0; i < models.size(); ++i) {
+        whisper_free_state(states[i]);
+        whisper_free(models[i]);
+    }
+    if (engine) {
+        CloseHandle(engine);
+    }
+    return exitCode;
+}
+
+int InferenceWorker::RunCaption(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 4) {
+        LOG_ERROR("Worker", "Usage: --caption-worker <ring> <enginePid> <modelDir> <intervalMs>");
+        return 2;
+    }
+    HANDLE engine = OpenEngine(arguments[1]);
+    SharedFrameRing ring;
+    CameraVisionEngine vision;
+    if (!ring.Open(arguments[0]) || !vision.InitializeWithoutCamera(arguments[2])) {
+        LOG_ERROR("Worker", "Caption worker failed to start");
+        return 1;
+    }
+    const auto interval = std::chrono::milliseconds((std::max)(0, std::atoi(arguments[3].c_str())));
+    LOG_INFO("Worker", "Caption worker ready");
+
+    cv::Mat frame;
+    int64_t frameNumber = 0;
+    auto lastCaption = std::chrono::steady_clock::now() - interval;
+    while (!EngineGone(engine)) {
+        if (std::chrono::steady_clock::now() - lastCaption < interval || !ring.ReadLatestFrame(frame, frameNumber)) {
+            Sleep(CAPTION_POLL_MS);
+            continue;
+        }
+        lastCaption = std::chrono::steady_clock::now();
+        std::string text = vision.DescribeImage(frame);
+        float latencyMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - lastCaption).count();
+        // Empty on error, published anyway: the engine counts results to tell slow from stuck
+        ring.PublishResult(frameNumber, text, latencyMs);
+    }
+    if (engine) {
+        CloseHandle(engine);
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * InferenceWorker - The child side of out-of-process inference
+ *
+ * With --isolate-inference the engine runs whisper and FastVLM in children
+ * of its own executable (InferenceSupervisor starts and restarts them);
+ * main() hands the process over here before anything else when the first
+ * argument is a worker command:
+ *
+ *   --whisper-worker <channel> <enginePid> <gpu> <model> [<fast model>]
+ *       Loads every whisper tier, warms each up, reports ready, then decodes
+ *       one request at a time from the WhisperChannel (WhisperProcess is the
+ *       engine's end). whisper's abort callback bumps the channel heartbeat
+ *       and honours its abort flag.
+ *
+ *   --caption-worker <ring> <enginePid> <modelDir> <intervalMs>
+ *       Loads FastVLM (CameraVisionEngine without a camera) and captions the
+ *       newest frame of the engine's SharedFrameRing, at most one caption per
+ *       intervalMs, publishing each result (empty on error) back to the ring.
+ *
+ * Arguments are read from the wide command line (model paths may not be
+ * ANSI). Either worker exits when the engine process does; the engine's job
+ * object kills them anyway if it goes first.
+ */
+class InferenceWorker {
+public:
+    static bool IsWorkerCommand(const std::string& argument);
+
+    // The process's exit code
+    static int Run();
+
+private:
+    static int RunWhisper(const std::vector<std::string>& arguments);
+    static int RunCaption(const std::vector<std::string>& arguments);
+};
@@ -0,0 +1,127 @@
+#include "IntervalIndex.h"
+#include <algorithm>
+
+IntervalIndex::IntervalIndex()
+    : root(NONE), count(0), random(0x9E3779B9u) {
+}
+
+void IntervalIndex::Clear() {
+    nodes.clear();
+    freeNodes.clear();
+    root = NONE;
+    count = 0;
+}
+
+uint32_t IntervalIndex::NextPriority() {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random;
+}
+
+void IntervalIndex::Update(int32_t node) {
+    Node& n = nodes[node];
+    n.maxEnd = n.end;
+    if (n.left != NONE) {
+        n.maxEnd = (std::max)(n.maxEnd, nodes[n.left].maxEnd);
+    }
+    if (n.right != NONE) {
+        n.maxEnd = (std::max)(n.maxEnd, nodes[n.right].maxEnd);
+    }
+}
+
+void IntervalIndex::Split(int32_t tree, int64_t start, uint64_t id, bool after, int32_t& left, int32_t& right) {
+    if (tree == NONE) {
+        left = right = NONE;
+        return;
+    }
+    Node& n = nodes[tree];
+    bool goesLeft = Before(n, start, id) || (after && n.start == start && n.id == id);
+    if (goesLeft) {
+        Split(n.right, start, id, after, nodes[tree].right, right);
+        left = tree;
+    } else {
+        Split(n.left, start, id, after, left, nodes[tree].left);
+        right = tree;
+    }
+    Update(tree);
+}
+
+int32_t IntervalIndex::Merge(int32_t left, int32_t right) {
+    if (left == NONE) {
+        return right;
+    }
+    if (right == NONE) {
+        return left;
+    }
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = Merge(nodes[left].right, right);
+        Update(left);
+        return left;
+    }
+    nodes[right].left = Merge(left, nodes[right].left);
+    Update(right);
+    return right;
+}
+
+void IntervalIndex::Insert(int64_t start, int64_t end, uint64_t id) {
+    int32_t node;
+    if (!freeNodes.empty()) {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    } else {
+        node = static_cast<int32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+    nodes[node] = Node{ start, end, end, id, NextPriority(), NONE, NONE };
+
+    int32_t left;
+    int32_t right;
+    Split(root, start, id, false, left, right);
+    root = Merge(Merge(left, node), right);
+    count++;
+}
+
+bool IntervalIndex::Remove(int64_t start, uint64_t id) {
+    int32_t left;
+    int32_t rest;
+    int32_t match;
+    int32_t right;
+    Split(root, start, id, false, left, rest);
+    Split(rest, start, id, true, match, right);
+    root = Merge(left, right);
+    if (match == NONE) {
+        return false;
+    }
+    freeNodes.push_back(match);         // Keys are unique: a single node
+    count--;
+    return true;
+}
+
+bool IntervalIndex::SetEnd(int64_t start, uint64_t id, int64_t end) {
+    if (!Remove(start, id)) {
+        return false;
+    }
+    Insert(start, end, id);
+    return true;
+}
+
+void IntervalIndex::Overlapping(int64_t from, int64_t to, std::vector<uint64_t>& ids) const {
+    Collect(root, from, to, ids);
+}
+
+void IntervalIndex::Collect(int32_t tree, int64_t from, int64_t to, std::vector<uint64_t>& ids) const {
+    // Nothing below ends at or after `from`
+    if (tree == NONE || nodes[tree].maxEnd < from) {
+        return;
+    }
+    const Node& n = nodes[tree];
+    Collect(n.left, from, to, ids);
+    if (n.start > to) {
+        return;                         // The right subtree starts later still
+    }
+    if (n.end >= from) {
+        ids.push_back(n.id);
+    }
+    Collect(n.right, from, to, ids);
+}
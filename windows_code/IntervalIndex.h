@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * IntervalIndex - Closed intervals [start, end] by id, queried by overlap
+ *
+ * An interval tree: a treap ordered by (start, id) whose nodes also carry
+ * the largest end in their subtree. Overlapping(from, to) skips every
+ * subtree whose largest end is before `from` and every right subtree of a
+ * node that starts after `to`, so a query costs O(log n + k) for k hits;
+ * Insert and Remove are O(log n) (expected: node priorities are random).
+ *
+ * Intervals still open (the current app, the current caption) end at OPEN
+ * until SetEnd() closes them. Nodes live in one vector, reused through a
+ * free list, so a steady stream of inserts and evictions doesn't allocate.
+ *
+ * Usage:
+ *   IntervalIndex index;
+ *   index.Insert(startUs, IntervalIndex::OPEN, id);
+ *   index.SetEnd(startUs, id, endUs);
+ *   index.Overlapping(fromUs, toUs, ids);
+ *
+ * Not thread-safe.
+ */
+class IntervalIndex {
+public:
+    static constexpr int64_t OPEN = (std::numeric_limits<int64_t>::max)();
+
+    IntervalIndex();
+
+    // (start, id) must be unique
+    void Insert(int64_t start, int64_t end, uint64_t id);
+    bool Remove(int64_t start, uint64_t id);
+    bool SetEnd(int64_t start, uint64_t id, int64_t end);
+
+    // Ids of the intervals overlapping [from, to], by start
+    void Overlapping(int64_t from, int64_t to, std::vector<uint64_t>& ids) const;
+
+    size_t Size() const { return count; }
+    void Clear();
+
+private:
+    static constexpr int32_t NONE = -1;
+
+    struct Node {
+        int64_t start;
+        int64_t end;
+        int64_t maxEnd;                 // Of the subtree
+        uint64_t id;
+        uint32_t priority;
+        int32_t left;
+        int32_t right;
+    };
+
+    static bool Before(const Node& node, int64_t start, uint64_t id) {
+        return node.start < start || (node.start == start && node.id < id);
+    }
+
+    void Update(int32_t node);
+    // Split into nodes before (start, id) and the rest; with `after`, the
+    // node equal to it goes left too
+    void Split(int32_t tree, int64_t start, uint64_t id, bool after, int32_t& left, int32_t& right);
+    int32_t Merge(int32_t left, int32_t right);
+    void Collect(int32_t tree, int64_t from, int64_t to, std::vector<uint64_t>& ids) const;
+    uint32_t NextPriority();
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> freeNodes;
+    int32_t root;
+    size_t count;
+    uint32_t random;                    // xorshift32 state
+};
@@ -0,0 +1,618 @@
+#include "JsonReader.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define JSON_READER_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsDelimiter(char c) {
+    return c == ',' || c == '}' || c == ']' || IsWhitespace(c);
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+#ifdef JSON_READER_SSE2
+int FirstSetBit(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// First quote, backslash or control character at or after `position`
+size_t FindStringSpecial(std::string_view json, size_t position) {
+    const char* data = json.data();
+    size_t size = json.size();
+#ifdef JSON_READER_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i controlLimit = _mm_set1_epi8(0x1F);
+    while (position + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+        // Unsigned c <= 0x1F  <=>  min(c, 0x1F) == c
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, controlLimit), chunk);
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                    _mm_cmpeq_epi8(chunk, backslash)), control);
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask != 0) {
+            return position + FirstSetBit(mask);
+        }
+        position += 16;
+    }
+#endif
+    while (position < size) {
+        unsigned char c = static_cast<unsigned char>(data[position]);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            return position;
+        }
+        position++;
+    }
+    return size;
+}
+
+// Length of the well-formed UTF-8 (RFC 3629: no overlong forms, surrogates
+// or code points past U+10FFFF) that `text` starts with; text.size() when
+// all of it is. ASCII runs are skipped 16 bytes at a time
+size_t ValidUtf8Length(std::string_view text) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(text.data());
+    size_t size = text.size();
+    size_t position = 0;
+    while (position < size) {
+#ifdef JSON_READER_SSE2
+        if (position + 16 <= size &&
+            _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position))) == 0) {
+            position += 16;
+            continue;
+        }
+#endif
+        unsigned char lead = data[position];
+        if (lead < 0x80) {
+            position++;
+            continue;
+        }
+        size_t length;
+        unsigned char low = 0x80;       // Range of the second byte
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            if (lead == 0xE0) {
+                low = 0xA0;             // Overlong
+            } else if (lead == 0xED) {
+                high = 0x9F;            // Surrogates
+            }
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            if (lead == 0xF0) {
+                low = 0x90;             // Overlong
+            } else if (lead == 0xF4) {
+                high = 0x8F;            // Past U+10FFFF
+            }
+        } else {
+            return position;
+        }
+        if (position + length > size || data[position + 1] < low || data[position + 1] > high) {
+            return position;
+        }
+        for (size_t i = 2; i < length; ++i) {
+            if (data[position + i] < 0x80 || data[position + i] > 0xBF) {
+                return position;
+            }
+        }
+        position += length;
+    }
+    return size;
+}
+
+void AppendUtf8(std::string& out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out.push_back(static_cast<char>(codepoint));
+    } else if (codepoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+}
+
+// ============================================================================
+// Validation
+// ============================================================================
+
+class Validator {
+public:
+    explicit Validator(std::string_view json) : json(json) {}
+
+    bool Run(size_t& valueStart, size_t& valueEnd) {
+        position = JsonReader::SkipWhitespace(json, 0);
+        valueStart = position;
+        if (!Value(0)) {
+            return false;
+        }
+        valueEnd = position;
+        position = JsonReader::SkipWhitespace(json, position);
+        return position == json.size();
+    }
+
+    size_t position = 0;
+
+private:
+    std::string_view json;
+
+    bool Value(int depth) {
+        if (position >= json.size() || depth > JsonReader::MAX_DEPTH) {
+            return false;
+        }
+        switch (json[position]) {
+            case '"': return String();
+            case '{': return Object(depth);
+            case '[': return Array(depth);
+            case 't': return Literal("true");
+            case 'f': return Literal("false");
+            case 'n': return Literal("null");
+            default: return Number();
+        }
+    }
+
+    bool Literal(std::string_view literal) {
+        if (json.substr(position, literal.size()) != literal) {
+            return false;
+        }
+        position += literal.size();
+        return true;
+    }
+
+    bool String() {
+        position++;     // Opening quote
+        while (true) {
+            // A multi-byte sequence never holds a quote, backslash or control
+            // byte, so the run up to one is checked on its own
+            size_t start = position;
+            position = FindStringSpecial(json, position);
+            size_t valid = ValidUtf8Length(json.substr(start, position - start));
+            if (valid < position - start) {
+                position = start + valid;
+                return false;
+            }
+            if (position >= json.size()) {
+                return false;
+            }
+            char c = json[position];
+            if (c == '"') {
+                position++;
+                return true;
+            }
+            if (c != '\\') {
+                return false;       // Raw control character
+            }
+            if (position + 1 >= json.size()) {
+                return false;
+            }
+            char escape = json[position + 1];
+            if (escape == 'u') {
+                if (position + 6 > json.size()) {
+                    return false;
+                }
+                for (size_t i = position + 2; i < position + 6; ++i) {
+                    if (HexValue(json[i]) < 0) {
+                        return false;
+                    }
+                }
+                position += 6;
+            } else if (std::strchr("\"\\/bfnrt", escape) != nullptr && escape != '\0') {
+                position += 2;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    bool Digits() {
+        size_t start = position;
+        while (position < json.size() && json[position] >= '0' && json[position] <= '9') {
+            position++;
+        }
+        return position > start;
+    }
+
+    bool Number() {
+        if (position < json.size() && json[position] == '-') {
+            position++;
+        }
+        if (position < json.size() && json[position] == '0') {
+            position++;     // No leading zeros
+        } else if (!Digits()) {
+            return false;
+        }
+        if (position < json.size() && json[position] == '.') {
+            position++;
+            if (!Digits()) {
+                return false;
+            }
+        }
+        if (position < json.size() && (json[position] == 'e' || json[position] == 'E')) {
+            position++;
+            if (position < json.size() && (json[position] == '+' || json[position] == '-')) {
+                position++;
+            }
+            if (!Digits()) {
+                return false;
+            }
+        }
+        return position >= json.size() || IsDelimiter(json[position]);
+    }
+
+    bool Array(int depth) {
+        position = JsonReader::SkipWhitespace(json, position + 1);
+        if (position < json.size() && json[position] == ']') {
+            position++;
+            return true;
+        }
+        while (true) {
+            if (!Value(depth + 1)) {
+                return false;
+            }
+            position = JsonReader::SkipWhitespace(json, position);
+            if (position >= json.size()) {
+                return false;
+            }
+            if (json[position] == ']') {
+                position++;
+                return true;
+            }
+            if (json[position] != ',') {
+                return false;
+            }
+            position = JsonReader::SkipWhitespace(json, position + 1);
+        }
+    }
+
+    bool Object(int depth) {
+        position = JsonReader::SkipWhitespace(json, position + 1);
+        if (position < json.size() && json[position] == '}') {
+            position++;
+            return true;
+        }
+        while (true) {
+            if (position >= json.size() || json[position] != '"' || !String()) {
+                return false;
+            }
+            position = JsonReader::SkipWhitespace(json, position);
+            if (position >= json.size() || json[position] != ':') {
+                return false;
+            }
+            position = JsonReader::SkipWhitespace(json, position + 1);
+            if (!Value(depth + 1)) {
+                return false;
+            }
+            position = JsonReader::SkipWhitespace(json, position);
+            if (position >= json.size()) {
+                return false;
+            }
+            if (json[position] == '}') {
+                position++;
+                return true;
+            }
+            if (json[position] != ',') {
+                return false;
+            }
+            position = JsonReader::SkipWhitespace(json, position + 1);
+        }
+    }
+};
+
+} // namespace
+
+// ============================================================================
+// JsonReader
+// ============================================================================
+
+JsonValue JsonReader::Parse(std::string_view json, size_t* errorOffset) {
+    Validator validator(json);
+    size_t start = 0;
+    size_t end = 0;
+    if (!validator.Run(start, end)) {
+        if (errorOffset) {
+            *errorOffset = validator.position;
+        }
+        return JsonValue();
+    }
+    return JsonValue(json.substr(start, end - start));
+}
+
+size_t JsonReader::SkipWhitespace(std::string_view json, size_t position) {
+    while (position < json.size() && IsWhitespace(json[position])) {
+        position++;
+    }
+    return position;
+}
+
+size_t JsonReader::ScanString(std::string_view json, size_t position) {
+    position++;     // Opening quote
+    while (true) {
+        position = FindStringSpecial(json, position);
+        if (position >= json.size()) {
+            return json.size();
+        }
+        if (json[position] == '"') {
+            return position + 1;
+        }
+        position += (json[position] == '\\') ? 2 : 1;
+    }
+}
+
+size_t JsonReader::SkipValue(std::string_view json, size_t position) {
+    if (position >= json.size()) {
+        return position;
+    }
+    char c = json[position];
+    if (c == '"') {
+        return ScanString(json, position);
+    }
+    if (c != '{' && c != '[') {
+        while (position < json.size() && !IsDelimiter(json[position])) {
+            position++;
+        }
+        return position;
+    }
+
+    // Containers: count brackets, jumping over strings (which may contain them)
+    int depth = 0;
+    while (position < json.size()) {
+        c = json[position];
+        if (c == '"') {
+            position = ScanString(json, position);
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+                return position + 1;
+            }
+        }
+        position++;
+    }
+    return position;
+}
+
+void JsonReader::Unescape(std::string_view contents, std::string& out) {
+    out.clear();
+    out.reserve(contents.size());
+    size_t position = 0;
+    while (position < contents.size()) {
+        size_t backslash = contents.find('\\', position);
+        if (backslash == std::string_view::npos) {
+            out.append(contents.data() + position, contents.size() - position);
+            return;
+        }
+        out.append(contents.data() + position, backslash - position);
+        if (backslash + 1 >= contents.size()) {
+            return;
+        }
+
+        char escape = contents[backslash + 1];
+        position = backslash + 2;
+        switch (escape) {
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                auto readHex = [&](size_t at, uint32_t& value) {
+                    if (at + 4 > contents.size()) {
+                        return false;
+                    }
+                    value = 0;
+                    for (size_t i = at; i < at + 4; ++i) {
+                        int digit = HexValue(contents[i]);
+                        if (digit < 0) {
+                            return false;
+                        }
+                        value = (value << 4) | static_cast<uint32_t>(digit);
+                    }
+                    return true;
+                };
+                uint32_t codepoint = 0;
+                if (!readHex(position, codepoint)) {
+                    return;
+                }
+                position += 4;
+                // Surrogate pair; a lone surrogate becomes U+FFFD
+                if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                    uint32_t low = 0;
+                    if (contents.substr(position, 2) == "\\u" && readHex(position + 2, low) &&
+                        low >= 0xDC00 && low <= 0xDFFF) {
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                        position += 6;
+                    } else {
+                        codepoint = 0xFFFD;
+                    }
+                } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                    codepoint = 0xFFFD;
+                }
+                AppendUtf8(out, codepoint);
+                break;
+            }
+            default: out.push_back(escape); break;     // \" \\ \/
+        }
+    }
+}
+
+// ============================================================================
+// JsonValue
+// ============================================================================
+
+JsonValue::Type JsonValue::GetType() const {
+    if (text.empty()) {
+        return Type::Invalid;
+    }
+    switch (text[0]) {
+        case '{': return Type::Object;
+        case '[': return Type::Array;
+        case '"': return Type::String;
+        case 't':
+        case 'f': return Type::Bool;
+        case 'n': return Type::Null;
+        default: return Type::Number;
+    }
+}
+
+bool JsonValue::Next(size_t& cursor, JsonValue& value, std::string_view* key) const {
+    Type type = GetType();
+    if (type != Type::Object && type != Type::Array) {
+        return false;
+    }
+
+    // cursor is 0 before the first item, then just past the previous one
+    size_t position = JsonReader::SkipWhitespace(text, cursor == 0 ? 1 : cursor);
+    if (position < text.size() && text[position] == ',') {
+        position = JsonReader::SkipWhitespace(text, position + 1);
+    }
+    if (position >= text.size() || text[position] == '}' || text[position] == ']') {
+        return false;
+    }
+
+    if (type == Type::Object) {
+        size_t keyEnd = JsonReader::ScanString(text, position);
+        if (key) {
+            *key = text.substr(position + 1, keyEnd - position - 2);
+        }
+        position = JsonReader::SkipWhitespace(text, keyEnd);
+        position = JsonReader::SkipWhitespace(text, position + 1);     // ':'
+    }
+
+    size_t end = JsonReader::SkipValue(text, position);
+    value = JsonValue(text.substr(position, end - position));
+    cursor = end;
+    return true;
+}
+
+JsonValue JsonValue::operator[](std::string_view key) const {
+    if (GetType() != Type::Object) {
+        return JsonValue();
+    }
+    size_t cursor = 0;
+    JsonValue value;
+    std::string_view memberKey;
+    std::string scratch;
+    while (Next(cursor, value, &memberKey)) {
+        if (memberKey == key) {
+            return value;
+        }
+        // Escaped keys are rare; decode only when one could still match
+        if (memberKey.find('\\') != std::string_view::npos) {
+            JsonReader::Unescape(memberKey, scratch);
+            if (scratch == key) {
+                return value;
+            }
+        }
+    }
+    return JsonValue();
+}
+
+JsonValue JsonValue::operator[](size_t index) const {
+    if (GetType() != Type::Array) {
+        return JsonValue();
+    }
+    size_t cursor = 0;
+    JsonValue value;
+    for (size_t i = 0; Next(cursor, value); ++i) {
+        if (i == index) {
+            return value;
+        }
+    }
+    return JsonValue();
+}
+
+size_t JsonValue::Size() const {
+    size_t count = 0;
+    size_t cursor = 0;
+    JsonValue value;
+    while (Next(cursor, value)) {
+        count++;
+    }
+    return count;
+}
+
+bool JsonValue::AsBool(bool defaultValue) const {
+    if (text == "true") return true;
+    if (text == "false") return false;
+    return defaultValue;
+}
+
+double JsonValue::AsDouble(double defaultValue) const {
+    if (GetType() != Type::Number) {
+        return defaultValue;
+    }
+    // Numbers are validated and delimited, so a short copy keeps strtod in bounds
+    char buffer[64];
+    size_t length = (std::min)(text.size(), sizeof(buffer) - 1);
+    std::memcpy(buffer, text.data(), length);
+    buffer[length] = '\0';
+    return std::strtod(buffer, nullptr);
+}
+
+int64_t JsonValue::AsInt(int64_t defaultValue) const {
+    if (GetType() != Type::Number) {
+        return defaultValue;
+    }
+    if (text.find_first_of(".eE") != std::string_view::npos) {
+        return static_cast<int64_t>(AsDouble(static_cast<double>(defaultValue)));
+    }
+    char buffer[32];
+    size_t length = (std::min)(text.size(), sizeof(buffer) - 1);
+    std::memcpy(buffer, text.data(), length);
+    buffer[length] = '\0';
+    return std::strtoll(buffer, nullptr, 10);
+}
+
+std::string_view JsonValue::AsString(std::string& scratch, std::string_view defaultValue) const {
+    if (GetType() != Type::String) {
+        return defaultValue;
+    }
+    std::string_view contents = text.substr(1, text.size() - 2);
+    if (contents.find('\\') == std::string_view::npos) {
+        return contents;
+    }
+    JsonReader::Unescape(contents, scratch);
+    return scratch;
+}
+
+std::string JsonValue::GetString(const std::string& defaultValue) const {
+    std::string scratch;
+    if (GetType() != Type::String) {
+        return defaultValue;
+    }
+    return std::string(AsString(scratch));
+}
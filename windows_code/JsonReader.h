@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * JsonValue - A view of one value inside a validated JSON document
+ *
+ * Holds only a string_view over the caller's buffer: member lookup, array
+ * iteration and number parsing scan the text in place and never allocate.
+ * Strings come back as views unless they contain escapes, in which case
+ * they are decoded into a caller-supplied scratch string.
+ *
+ * Missing members and type mismatches yield an Invalid value, so lookups
+ * chain safely: body["data"]["objects"].AsString(scratch).
+ */
+class JsonValue {
+public:
+    enum class Type { Invalid, Null, Bool, Number, String, Array, Object };
+
+    JsonValue() = default;
+
+    Type GetType() const;
+    bool IsValid() const { return !text.empty(); }
+    bool IsObject() const { return GetType() == Type::Object; }
+    bool IsArray() const { return GetType() == Type::Array; }
+    bool IsString() const { return GetType() == Type::String; }
+    bool IsNumber() const { return GetType() == Type::Number; }
+
+    std::string_view Raw() const { return text; }
+
+    // Object member (first match) or array element; Invalid when absent
+    JsonValue operator[](std::string_view key) const;
+    JsonValue operator[](size_t index) const;
+    size_t Size() const;        // Elements or members; 0 for scalars
+
+    /**
+     * @brief Step through elements (arrays) or members (objects)
+     * @param cursor Start at 0; advanced on each call
+     * @param key Member key, raw (escapes not decoded); untouched for arrays
+     * @return false once there are no more
+     */
+    bool Next(size_t& cursor, JsonValue& value, std::string_view* key = nullptr) const;
+
+    bool AsBool(bool defaultValue = false) const;
+    double AsDouble(double defaultValue = 0.0) const;
+    int64_t AsInt(int64_t defaultValue = 0) const;
+
+    // String contents: a view into the document, or into `scratch` when escaped
+    std::string_view AsString(std::string& scratch, std::string_view defaultValue = {}) const;
+    std::string GetString(const std::string& defaultValue = "") const;
+
+private:
+    friend class JsonReader;
+    explicit JsonValue(std::string_view text) : text(text) {}
+
+    std::string_view text;      // Exactly the value's characters; empty = Invalid
+};
+
+/**
+ * JsonReader - Validating JSON reader (RFC 8259) for request bodies
+ *
+ * Parse() checks the whole document once - structure, string escapes and
+ * UTF-8, number syntax, nesting up to MAX_DEPTH - so the JsonValue accessors can
+ * then skip over values with a cheap structural scan. String scanning looks
+ * for quotes and backslashes 16 bytes at a time with SSE2 where available.
+ *
+ * Usage:
+ *   size_t errorOffset = 0;
+ *   JsonValue body = JsonReader::Parse(request.body, &errorOffset);
+ *   if (!body.IsValid()) { ... 400, invalid at errorOffset ... }
+ *   std::string scratch;
+ *   std::string_view device = body["device"].AsString(scratch);
+ */
+class JsonReader {
+public:
+    static constexpr int MAX_DEPTH = 64;
+
+    static JsonValue Parse(std::string_view json, size_t* errorOffset = nullptr);
+
+    // Position just past the closing quote of the string starting at `position`
+    // (document must already be validated)
+    static size_t ScanString(std::string_view json, size_t position);
+
+    // Position just past the value starting at `position` (validated document)
+    static size_t SkipValue(std::string_view json, size_t position);
+
+    static size_t SkipWhitespace(std::string_view json, size_t position);
+
+    // Decode a string's contents (without quotes) into `out`
+    static void Unescape(std::string_view contents, std::string& out);
+};
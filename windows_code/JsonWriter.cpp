@@ -0,0 +1,194 @@
+#include "JsonWriter.h"
+#include <charconv>
+#include <cmath>
+
+JsonWriter::JsonWriter(std::string& out) : out(out), base(out.size()) {
+}
+
+// ============================================================================
+// Structure
+// ============================================================================
+
+void JsonWriter::BeforeValue() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (depth > 0 && hasItems[depth]) {
+        out.push_back(',');
+    }
+    hasItems[depth] = true;
+}
+
+void JsonWriter::AfterValue() {
+    // A top-level member's value just ended
+    if (depth == 1 && !members.empty() && members.back().valueLength == 0) {
+        members.back().valueLength = out.size() - base - members.back().valueOffset;
+    }
+}
+
+JsonWriter& JsonWriter::BeginObject() {
+    BeforeValue();
+    out.push_back('{');
+    if (depth < MAX_DEPTH) {
+        hasItems[++depth] = false;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndObject() {
+    out.push_back('}');
+    if (depth > 0) {
+        depth--;
+    }
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray() {
+    BeforeValue();
+    out.push_back('[');
+    if (depth < MAX_DEPTH) {
+        hasItems[++depth] = false;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndArray() {
+    out.push_back(']');
+    if (depth > 0) {
+        depth--;
+    }
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key) {
+    if (hasItems[depth]) {
+        out.push_back(',');
+    }
+    hasItems[depth] = true;
+
+    out.push_back('"');
+    size_t keyOffset = out.size() - base;
+    AppendEscaped(out, key);
+    size_t keyLength = out.size() - base - keyOffset;
+    out.append("\":");
+    afterKey = true;
+
+    if (depth == 1) {
+        members.push_back({keyOffset, keyLength, out.size() - base, 0});
+    }
+    return *this;
+}
+
+// ============================================================================
+// Values
+// ============================================================================
+
+JsonWriter& JsonWriter::String(std::string_view value) {
+    BeforeValue();
+    out.push_back('"');
+    AppendEscaped(out, value);
+    out.push_back('"');
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::EscapedString(std::string_view escaped) {
+    BeforeValue();
+    out.push_back('"');
+    out.append(escaped.data(), escaped.size());
+    out.push_back('"');
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::StringOrNull(std::string_view value) {
+    return value.empty() ? Null() : String(value);
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+    BeforeValue();
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::UInt(uint64_t value) {
+    BeforeValue();
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::Double(double value, int precision) {
+    if (!std::isfinite(value)) {
+        return Null();
+    }
+    BeforeValue();
+    char buffer[64];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, precision);
+    if (result.ec == std::errc()) {
+        out.append(buffer, result.ptr);
+    } else {
+        out.append("null");     // Magnitude too large for fixed notation in 64 chars
+    }
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+    BeforeValue();
+    out.append(value ? "true" : "false");
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+    BeforeValue();
+    out.append("null");
+    AfterValue();
+    return *this;
+}
+
+JsonWriter& JsonWriter::Raw(std::string_view json) {
+    BeforeValue();
+    out.append(json.data(), json.size());
+    AfterValue();
+    return *this;
+}
+
+void JsonWriter::AppendEscaped(std::string& out, std::string_view value) {
+    static const char hex[] = "0123456789abcdef";
+
+    // Copy runs of plain bytes in one append; only specials are handled singly
+    size_t runStart = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(value.data() + runStart, i - runStart);
+        runStart = i + 1;
+        switch (c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default: {
+                char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                out.append(escape, sizeof(escape));
+                break;
+            }
+        }
+    }
+    out.append(value.data() + runStart, value.size() - runStart);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * JsonWriter - Streaming JSON writer over a caller-owned buffer
+ *
+ * Appends straight into a std::string the caller keeps and reuses, so
+ * building a document costs no per-field allocations once the buffer has
+ * grown to size. Commas are tracked per nesting level; numbers are
+ * formatted with std::to_chars (locale-independent, no streams).
+ *
+ * Top-level object members are recorded as offsets into the buffer, so a
+ * caller can compare or reuse individual values (e.g. for merge patches)
+ * without re-parsing the document.
+ *
+ * Usage:
+ *   std::string out;
+ *   JsonWriter writer(out);
+ *   writer.BeginObject();
+ *   writer.Key("activeApp").String("Code.exe");
+ *   writer.Key("cpuUsage").Double(12.5, 2);
+ *   writer.Key("recent").BeginArray().String("a").EndArray();
+ *   writer.EndObject();
+ */
+class JsonWriter {
+public:
+    static constexpr int MAX_DEPTH = 64;
+
+    // Offsets relative to where the writer started in the buffer
+    struct MemberSpan {
+        size_t keyOffset;       // Key text (escaped, without quotes)
+        size_t keyLength;
+        size_t valueOffset;     // Serialized value
+        size_t valueLength;
+    };
+
+    explicit JsonWriter(std::string& out);
+
+    JsonWriter& BeginObject();
+    JsonWriter& EndObject();
+    JsonWriter& BeginArray();
+    JsonWriter& EndArray();
+    JsonWriter& Key(std::string_view key);
+
+    JsonWriter& String(std::string_view value);
+    JsonWriter& Int(int64_t value);
+    JsonWriter& UInt(uint64_t value);
+    JsonWriter& Double(double value, int precision);    // Fixed notation; NaN/inf become null
+    JsonWriter& Bool(bool value);
+    JsonWriter& Null();
+    JsonWriter& Raw(std::string_view json);             // Already-serialized value, written as-is
+    JsonWriter& EscapedString(std::string_view escaped); // String whose contents are already escaped
+
+    // String, or null when empty (the context document's "not available")
+    JsonWriter& StringOrNull(std::string_view value);
+
+    const std::vector<MemberSpan>& GetTopLevelMembers() const { return members; }
+
+    static void AppendEscaped(std::string& out, std::string_view value);
+
+private:
+    void BeforeValue();
+    void AfterValue();
+
+    std::string& out;
+    size_t base;
+    int depth = 0;
+    bool afterKey = false;
+    bool hasItems[MAX_DEPTH + 1] = {};
+    std::vector<MemberSpan> members;
+};
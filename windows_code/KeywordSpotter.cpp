@@ -0,0 +1,147 @@
+#include "KeywordSpotter.h"
+#include "OrtRuntime.h"
+#include "CpuBudget.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+KeywordSpotter::KeywordSpotter()
+    : session(nullptr)
+    , memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    , sessionBytes(0)
+    , threshold(DEFAULT_THRESHOLD)
+    , inputBuffer(WINDOW_SAMPLES, 0.0f)
+    , inputTensor(nullptr)
+    , outputTensor(nullptr)
+{
+}
+
+KeywordSpotter::~KeywordSpotter() = default;
+
+bool KeywordSpotter::LoadLabels(const std::string& labelsPath) {
+    std::ifstream file(labelsPath);
+    if (!file) {
+        LOG_ERROR("KeywordSpotter", "Cannot open labels: " << labelsPath);
+        return false;
+    }
+    labels.clear();
+    reportable.clear();
+    std::string line;
+    while (std::getline(file, line) && labels.size() < MAX_KEYWORDS) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        reportable.push_back(line[0] != '_');
+        labels.push_back(line);
+    }
+    return !labels.empty();
+}
+
+bool KeywordSpotter::Initialize(const std::wstring& modelPath, const std::string& labelsPath) {
+    if (!LoadLabels(labelsPath)) {
+        return false;
+    }
+
+    try {
+        // Same arrangement as SileroVAD: tiny model, run on the processing thread,
+        // never queued behind a caption decode in the global pool
+        OrtRuntime::SessionConfig config;
+        config.optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+        config.logId = "KeywordSpotter";
+        config.useGlobalThreadPool = false;
+        config.intraOpThreads = CpuBudget::Instance().Get(CpuBudget::Subsystem::Vad).threads;
+        config.interOpThreads = 1;
+        config.freeDimensionOverrides = { {"batch_size", 1}, {"batch", 1} };
+
+        MemoryAccounting::Meter sessionMeter;
+        session = OrtRuntime::Instance().CreateSession(modelPath, config);
+        if (!session) {
+            LOG_ERROR("KeywordSpotter", "Failed to create keyword spotting session");
+            return false;
+        }
+        sessionBytes = sessionMeter.Bytes();
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        inputName = session->GetInputNameAllocated(0, allocator).get();
+        outputName = session->GetOutputNameAllocated(0, allocator).get();
+
+        // The class count is fixed by the model; the labels have to match it
+        std::vector<int64_t> outputShape = session->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        int64_t classes = outputShape.empty() ? -1 : outputShape.back();
+        if (classes > 0 && static_cast<size_t>(classes) != labels.size()) {
+            LOG_ERROR("KeywordSpotter", "Model has " << classes << " classes but " << labels.size()
+                      << " labels were loaded from " << labelsPath);
+            session.reset();
+            return false;
+        }
+
+        outputBuffer.assign(labels.size(), 0.0f);
+        const int64_t inputShape[] = {1, static_cast<int64_t>(WINDOW_SAMPLES)};
+        const int64_t scoresShape[] = {1, static_cast<int64_t>(labels.size())};
+        inputTensor = Ort::Value::CreateTensor<float>(memoryInfo, inputBuffer.data(), inputBuffer.size(),
+                                                      inputShape, 2);
+        outputTensor = Ort::Value::CreateTensor<float>(memoryInfo, outputBuffer.data(), outputBuffer.size(),
+                                                       scoresShape, 2);
+
+        // One silent window up front: checks the contract and warms the session
+        float score = 0.0f;
+        Spot(inputBuffer.data(), 0, &score);
+        if (!session) {
+            return false;
+        }
+
+        LOG_DEBUG("KeywordSpotter", "Keyword spotting ready: " << labels.size() << " classes, threshold "
+                  << threshold);
+        return true;
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("KeywordSpotter", "ONNX Runtime error: " << e.what());
+        session.reset();
+        return false;
+    }
+}
+
+int KeywordSpotter::Spot(const float* samples, size_t count, float* score) {
+    TRACE_ZONE("KeywordSpotter::Spot");
+    *score = 0.0f;
+    if (!session) {
+        return -1;
+    }
+
+    // Latest second of audio, right-aligned
+    size_t take = (std::min)(count, WINDOW_SAMPLES);
+    size_t pad = WINDOW_SAMPLES - take;
+    std::fill(inputBuffer.begin(), inputBuffer.begin() + pad, 0.0f);
+    if (take > 0) {
+        std::memcpy(inputBuffer.data() + pad, samples + (count - take), take * sizeof(float));
+    }
+
+    try {
+        const char* inputNames[] = { inputName.c_str() };
+        const char* outputNames[] = { outputName.c_str() };
+        session->Run(Ort::RunOptions{nullptr}, inputNames, &inputTensor, 1, outputNames, &outputTensor, 1);
+    }
+    catch (const Ort::Exception& e) {
+        // A model that breaks the contract fails on every window: switch the stage off
+        LOG_ERROR("KeywordSpotter", "Inference failed, keyword spotting disabled: " << e.what());
+        session.reset();
+        return -1;
+    }
+
+    int best = -1;
+    for (size_t i = 0; i < outputBuffer.size(); ++i) {
+        if (reportable[i] && outputBuffer[i] >= threshold && (best < 0 || outputBuffer[i] > outputBuffer[best])) {
+            best = static_cast<int>(i);
+        }
+    }
+    if (best >= 0) {
+        *score = outputBuffer[best];
+    }
+    return best;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * KeywordSpotter - Small ONNX keyword classifier run on speech before whisper
+ *
+ * Many callers only need to know that "stop" or "next" was said. Whisper
+ * takes seconds per utterance; a keyword-spotting (KWS) model classifies a
+ * one-second window in about a millisecond, so the audio engine runs it on
+ * the microphone's speech as it arrives and reports a keyword well before
+ * the utterance has even ended.
+ *
+ * Model contract (any Speech Commands-style classifier exported with its
+ * feature front end in the graph):
+ *   input   float (1, WINDOW_SAMPLES)  16 kHz mono, [-1, 1]
+ *   output  float (1, K)               per-class probabilities (softmax or sigmoid)
+ * Labels come from a text file, one per line, in output order. Classes
+ * whose label starts with '_' ("_silence_", "_unknown_") are never reported;
+ * at most MAX_KEYWORDS classes are used.
+ *
+ * Sessions come from OrtRuntime like SileroVAD's: a private single-thread
+ * pool on the calling (processing) thread, with the input and output tensors
+ * preallocated once so a Spot() call copies one window and runs.
+ *
+ * Usage (processing thread only; not thread-safe):
+ *   KeywordSpotter kws;
+ *   kws.Initialize(L"models/kws/kws.onnx", "models/kws/labels.txt");
+ *   float score = 0.0f;
+ *   int keyword = kws.Spot(speech.data(), speech.size(), &score);    // Last second
+ *   if (keyword >= 0) { Notify(kws.GetKeyword(keyword), score); }
+ */
+class KeywordSpotter {
+public:
+    static constexpr size_t WINDOW_SAMPLES = 16000;     // 1 s @ 16 kHz
+    static constexpr size_t MAX_KEYWORDS = 64;          // Fits a per-utterance bitmask
+
+    KeywordSpotter();
+    ~KeywordSpotter();
+
+    KeywordSpotter(const KeywordSpotter&) = delete;
+    KeywordSpotter& operator=(const KeywordSpotter&) = delete;
+
+    bool Initialize(const std::wstring& modelPath, const std::string& labelsPath);
+    bool IsInitialized() const { return session != nullptr; }
+
+    // Classify the WINDOW_SAMPLES ending at samples + count (zero-padded in
+    // front when shorter). Returns the most probable keyword scoring at least
+    // the threshold, or -1; its probability goes to *score
+    int Spot(const float* samples, size_t count, float* score);
+
+    const std::string& GetKeyword(int index) const { return labels[index]; }
+    size_t GetKeywordCount() const { return labels.size(); }
+
+    // Probability a keyword must reach (default DEFAULT_THRESHOLD)
+    void SetThreshold(float value) { threshold = value; }
+    float GetThreshold() const { return threshold; }
+
+    // Private bytes grown while creating the session (for MemoryAccounting)
+    uint64_t GetSessionBytes() const { return sessionBytes; }
+
+    static constexpr float DEFAULT_THRESHOLD = 0.8f;
+
+private:
+    bool LoadLabels(const std::string& labelsPath);
+
+    std::unique_ptr<Ort::Session> session;
+    Ort::MemoryInfo memoryInfo;
+    std::string inputName;
+    std::string outputName;
+    uint64_t sessionBytes;
+
+    std::vector<std::string> labels;
+    std::vector<bool> reportable;           // Label doesn't start with '_'
+    float threshold;
+
+    // Preallocated tensors over these buffers (created once in Initialize)
+    std::vector<float> inputBuffer;         // (1, WINDOW_SAMPLES)
+    std::vector<float> outputBuffer;        // (1, K)
+    Ort::Value inputTensor;
+    Ort::Value outputTensor;
+};
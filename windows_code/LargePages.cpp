@@ -0,0 +1,147 @@
+#include "LargePages.h"
+#include "JsonWriter.h"
+#include "Log.h"
+
+LargePages& LargePages::Instance() {
+    static LargePages instance;
+    return instance;
+}
+
+// SeLockMemoryPrivilege has to be granted to the account (secpol.msc, "Lock
+// pages in memory") and then enabled on the process token
+static bool EnableLockMemoryPrivilege(std::string& reason) {
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        reason = "OpenProcessToken failed: " + std::to_string(GetLastError());
+        return false;
+    }
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool enabled = false;
+    if (!LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)) {
+        reason = "LookupPrivilegeValue failed: " + std::to_string(GetLastError());
+    } else if (!AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)) {
+        reason = "AdjustTokenPrivileges failed: " + std::to_string(GetLastError());
+    } else if (GetLastError() == ERROR_NOT_ALL_ASSIGNED) {
+        // Succeeds without the privilege; only the last error tells
+        reason = "account lacks SeLockMemoryPrivilege (Lock pages in memory)";
+    } else {
+        enabled = true;
+    }
+    CloseHandle(token);
+    return enabled;
+}
+
+bool LargePages::Enable() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (active.load()) {
+        return true;
+    }
+    requested = true;
+    pageBytes = GetLargePageMinimum();
+    if (pageBytes == 0) {
+        reason = "no large page support";
+    } else if (EnableLockMemoryPrivilege(reason)) {
+        reason.clear();
+        active.store(true);
+        LOG_INFO("LargePages", "Large pages enabled (" << (pageBytes / 1024) << " KB)");
+        return true;
+    }
+    LOG_WARNING("LargePages", "Large pages unavailable, using regular pages: " << reason);
+    return false;
+}
+
+void* LargePages::TakeCached(size_t bytes) {
+    // Smallest cached block that fits, if it doesn't waste more than a quarter
+    auto it = freeBlocks.lower_bound(bytes);
+    if (it == freeBlocks.end() || it->first > bytes + bytes / 4) {
+        return nullptr;
+    }
+    void* block = it->second;
+    size_t size = it->first;
+    freeBlocks.erase(it);
+    cachedBytes -= size;
+    liveBlocks[block] = size;
+    liveBytes += size;
+    return block;
+}
+
+void* LargePages::Allocate(size_t bytes) {
+    if (!active.load() || bytes == 0) {
+        return nullptr;
+    }
+    size_t size = (bytes + pageBytes - 1) / pageBytes * pageBytes;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (void* block = TakeCached(size)) {
+        return block;
+    }
+    void* block = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (!block && !freeBlocks.empty()) {
+        // Physical memory too fragmented: give the cache back and try once more
+        for (const auto& cached : freeBlocks) {
+            VirtualFree(cached.second, 0, MEM_RELEASE);
+        }
+        freeBlocks.clear();
+        cachedBytes = 0;
+        block = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    }
+    if (!block) {
+        if (fallbacks++ == 0) {
+            LOG_WARNING("LargePages", "VirtualAlloc of " << (size / (1024 * 1024)) << " MB large pages failed ("
+                     << GetLastError() << "); falling back to regular pages");
+        }
+        return nullptr;
+    }
+    liveBlocks[block] = size;
+    liveBytes += size;
+    allocations++;
+    return block;
+}
+
+bool LargePages::Free(void* block) {
+    if (!block || !active.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = liveBlocks.find(block);
+    if (it == liveBlocks.end()) {
+        return false;
+    }
+    size_t size = it->second;
+    liveBlocks.erase(it);
+    liveBytes -= size;
+    if (cachedBytes + size <= MAX_CACHED_BYTES) {
+        freeBlocks.emplace(size, block);
+        cachedBytes += size;
+    } else {
+        VirtualFree(block, 0, MEM_RELEASE);
+    }
+    return true;
+}
+
+uint64_t LargePages::Trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& cached : freeBlocks) {
+        VirtualFree(cached.second, 0, MEM_RELEASE);
+    }
+    freeBlocks.clear();
+    uint64_t released = cachedBytes;
+    cachedBytes = 0;
+    return released;
+}
+
+void LargePages::Write(JsonWriter& writer) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    writer.BeginObject();
+    writer.Key("requested").Bool(requested);
+    writer.Key("active").Bool(active.load());
+    writer.Key("reason").StringOrNull(reason);
+    writer.Key("pageBytes").UInt(pageBytes);
+    writer.Key("bytes").UInt(liveBytes);
+    writer.Key("cachedBytes").UInt(cachedBytes);
+    writer.Key("allocations").UInt(allocations);
+    writer.Key("fallbacks").UInt(fallbacks);
+    writer.EndObject();
+}
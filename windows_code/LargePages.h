@@ -0,0 +1,98 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class JsonWriter;
+
+/**
+ * LargePages - Opt-in 2 MB pages for the big inference buffers
+ *
+ * Weight and activation buffers are hundreds of MB walked end to end by
+ * matmuls; on 4 KB pages every 4 KB of them costs a TLB entry, and the
+ * misses show. With memory.large_pages set, Enable() acquires
+ * SeLockMemoryPrivilege ("Lock pages in memory", which the account must be
+ * granted) and Allocate() hands out VirtualAlloc(MEM_LARGE_PAGES) blocks.
+ *
+ * Large pages are committed up front, never paged out, and zeroed on
+ * allocation, so VirtualAlloc is slow and fails once physical memory is
+ * fragmented. Freed blocks are therefore kept for reuse (up to
+ * MAX_CACHED_BYTES) and Trim() gives them back; an allocation that can't
+ * be met returns nullptr and the caller falls back to its ordinary heap.
+ *
+ * Users: OrtRuntime's env allocator (ORT's weights and activations of
+ * PAGE_BYTES and more). whisper's ggml buffers are allocated inside ggml's
+ * CPU buffer type, which the prebuilt whisper.lib offers no hook for.
+ *
+ * Usage:
+ *   LargePages::Instance().Enable();          // Before OrtRuntime::Instance()
+ *   void* block = LargePages::Instance().Allocate(bytes);
+ *   if (!block) block = _aligned_malloc(bytes, 64);
+ *   ...
+ *   if (!LargePages::Instance().Free(block)) _aligned_free(block);
+ *
+ * Thread-safe.
+ */
+class LargePages {
+public:
+    static constexpr uint64_t MAX_CACHED_BYTES = 256ull * 1024 * 1024;
+
+    static LargePages& Instance();
+
+    LargePages(const LargePages&) = delete;
+    LargePages& operator=(const LargePages&) = delete;
+
+    /**
+     * @brief Acquire the privilege and the page size
+     * @return false (and logs why) when large pages can't be used; Allocate() then always returns nullptr
+     */
+    bool Enable();
+
+    bool IsActive() const { return active.load(); }
+    size_t PageBytes() const { return pageBytes; }
+
+    /**
+     * @brief A block of bytes rounded up to whole large pages, or nullptr (inactive, or no memory for it)
+     */
+    void* Allocate(size_t bytes);
+
+    /**
+     * @brief Free a block from Allocate(); false when block isn't one (the caller frees it its own way)
+     */
+    bool Free(void* block);
+
+    /**
+     * @brief Release the cached free blocks; returns their bytes
+     */
+    uint64_t Trim();
+
+    /**
+     * @brief {"requested", "active", "reason", "pageBytes", "bytes", "cachedBytes", "allocations", "fallbacks"}
+     */
+    void Write(JsonWriter& writer) const;
+
+private:
+    LargePages() = default;
+
+    // Cached block of at least bytes, or nullptr (mutex held)
+    void* TakeCached(size_t bytes);
+
+    std::atomic<bool> active{false};
+    bool requested = false;
+    std::string reason;                         // Why it isn't active
+    size_t pageBytes = 0;
+
+    mutable std::mutex mutex;
+    std::unordered_map<void*, size_t> liveBlocks;
+    std::multimap<size_t, void*> freeBlocks;    // By size
+    uint64_t liveBytes = 0;
+    uint64_t cachedBytes = 0;
+    uint64_t allocations = 0;
+    uint64_t fallbacks = 0;                     // Allocate() calls that returned nullptr while active
+};
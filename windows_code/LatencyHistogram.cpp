@@ -0,0 +1,89 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static int HighestSetBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() {
+    Reset();
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sumUs.store(0, std::memory_order_relaxed);
+    maxUs.store(0, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t micros) {
+    if (micros < SUB_BUCKETS) {
+        return static_cast<size_t>(micros);            // Linear: one microsecond each
+    }
+    // Top SUB_BUCKET_BITS + 1 bits pick the bucket within the power-of-two group
+    int shift = HighestSetBit(micros) - SUB_BUCKET_BITS;
+    return static_cast<size_t>(shift + 1) * SUB_BUCKETS + static_cast<size_t>((micros >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::BucketLowerUs(size_t index) {
+    size_t group = index / SUB_BUCKETS;
+    uint64_t sub = index % SUB_BUCKETS;
+    return group == 0 ? sub : (SUB_BUCKETS + sub) << (group - 1);
+}
+
+uint64_t LatencyHistogram::BucketWidthUs(size_t index) {
+    size_t group = index / SUB_BUCKETS;
+    return group == 0 ? 1 : uint64_t(1) << (group - 1);
+}
+
+void LatencyHistogram::RecordUs(uint64_t micros) {
+    micros = (std::min)(micros, MAX_US);
+    buckets[BucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(micros, std::memory_order_relaxed);
+
+    uint64_t seen = maxUs.load(std::memory_order_relaxed);
+    while (micros > seen && !maxUs.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::RecordMs(double millis) {
+    RecordUs(millis > 0 ? static_cast<uint64_t>(std::llround(millis * 1000.0)) : 0);
+}
+
+double LatencyHistogram::QuantileMs(double q) const {
+    // Total from the buckets themselves, so a record racing this walk can't
+    // leave the target rank past the last bucket
+    uint64_t total = 0;
+    for (const auto& bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    q = (std::min)((std::max)(q, 0.0), 1.0);
+    uint64_t rank = (std::max)(static_cast<uint64_t>(std::ceil(q * static_cast<double>(total))), uint64_t(1));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < BUCKET_COUNT; ++index) {
+        seen += buckets[index].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            double middle = BucketLowerUs(index) + (BucketWidthUs(index) - 1) / 2.0;
+            return (std::min)(middle, static_cast<double>(maxUs.load(std::memory_order_relaxed))) / 1000.0;
+        }
+    }
+    return MaxMs();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * LatencyHistogram - Lock-free log-linear histogram of durations (HDR style)
+ *
+ * Values are recorded in microseconds into buckets whose width doubles
+ * every SUB_BUCKETS buckets: 1 us resolution below 16 us, and under 1/16
+ * (6.25%) relative error above, from 1 us to MAX_US. Record() is three
+ * relaxed atomic adds and a max update, so any number of threads can record
+ * on hot paths without a lock; readers see a slightly torn (but monotonic)
+ * view while recording continues, which is fine for percentiles.
+ *
+ * Usage:
+ *   LatencyHistogram histogram;
+ *   histogram.RecordMs(elapsedMs);
+ *   double p99 = histogram.QuantileMs(0.99);
+ *
+ * Fixed size (BUCKET_COUNT counters, ~4 KB); counts accumulate since creation.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr int MAX_BIT = 36;                          // Values clamp below 2^36 us (~19 h)
+    static constexpr uint64_t MAX_US = (uint64_t(1) << MAX_BIT) - 1;
+    static constexpr size_t BUCKET_COUNT = (MAX_BIT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void RecordUs(uint64_t micros);
+    void RecordMs(double millis);
+
+    uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+    double SumMs() const { return sumUs.load(std::memory_order_relaxed) / 1000.0; }
+    double MaxMs() const { return maxUs.load(std::memory_order_relaxed) / 1000.0; }
+
+    // Value at quantile q (0..1), from the bucket midpoint; 0 when empty
+    double QuantileMs(double q) const;
+
+    void Reset();
+
+private:
+    static size_t BucketIndex(uint64_t micros);
+    static uint64_t BucketLowerUs(size_t index);
+    static uint64_t BucketWidthUs(size_t index);
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sumUs;
+    std::atomic<uint64_t> maxUs;
+};
@@ -0,0 +1,376 @@
+#include "LocalContextServer.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include <sddl.h>
+#include <algorithm>
+
+#pragma comment(lib, "advapi32.lib")
+
+namespace {
+
+// SYSTEM and administrators own the pipe; interactive users may connect
+constexpr const char* PIPE_SDDL = "D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GRGW;;;IU)";
+
+std::string ErrorLine(std::string_view message) {
+    std::string line;
+    JsonWriter writer(line);
+    writer.BeginObject();
+    writer.Key("type").String("error");
+    writer.Key("message").String(message);
+    writer.EndObject();
+    line += '\n';
+    return line;
+}
+
+}  // namespace
+
+LocalContextServer::LocalContextServer(ContextCollector& collector, IngestHandler ingest, int minIntervalMs)
+    : collector(collector), ingest(std::move(ingest)), minInterval(minIntervalMs),
+      stopEvent(CreateEventA(nullptr, TRUE, FALSE, nullptr)) {
+}
+
+LocalContextServer::~LocalContextServer() {
+    Stop();
+    if (stopEvent) {
+        CloseHandle(stopEvent);
+    }
+}
+
+bool LocalContextServer::Start() {
+    if (running.load()) {
+        return true;
+    }
+    bool mapped = shared.Create();
+    HANDLE first = CreatePipeInstance(true);
+    if (first == INVALID_HANDLE_VALUE) {
+        LOG_WARNING("LocalIpc", "Cannot create " << PIPE_NAME << ": " << GetLastError());
+        if (!mapped) {
+            return false;
+        }
+    }
+
+    running = true;
+    publishThread = std::thread(&LocalContextServer::PublishThread, this);
+    if (first != INVALID_HANDLE_VALUE) {
+        acceptThread = std::thread(&LocalContextServer::AcceptLoop, this, first);
+    }
+    LOG_INFO("LocalIpc", "Local context on " << (mapped ? shared.GetName() : std::string("(no mapping)"))
+             << (first != INVALID_HANDLE_VALUE ? std::string(" and ") + PIPE_NAME : std::string()));
+    return true;
+}
+
+void LocalContextServer::Stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    SetEvent(stopEvent);
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    if (publishThread.joinable()) {
+        publishThread.join();
+    }
+
+    // The readers woke on stopEvent
+    std::vector<std::shared_ptr<Client>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        remaining.swap(clients);
+    }
+    for (auto& client : remaining) {
+        if (client->reader.joinable()) {
+            client->reader.join();
+        }
+        DisconnectNamedPipe(client->pipe);
+        CloseHandle(client->pipe);
+    }
+    shared.Close();
+    ResetEvent(stopEvent);
+}
+
+size_t LocalContextServer::GetClientCount() const {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    return clients.size();
+}
+
+// ============================================================================
+// Publishing
+// ============================================================================
+
+void LocalContextServer::PublishThread() {
+    TRACE_THREAD("Local context publisher");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Http);
+    std::shared_ptr<const ContextCollector::Snapshot> snapshot = collector.GetSnapshot();
+    shared.Publish(snapshot->serialized, snapshot->version, snapshot->stateVersion);
+    uint64_t published = snapshot->stateVersion;
+    auto lastPublish = std::chrono::steady_clock::now();
+
+    while (running.load()) {
+        // Reap closed connections; the rest are subscribers or idle
+        std::vector<std::shared_ptr<Client>> subscribers;
+        std::vector<std::shared_ptr<Client>> gone;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            for (auto it = clients.begin(); it != clients.end();) {
+                if (!(*it)->connected.load()) {
+                    gone.push_back(*it);
+                    it = clients.erase(it);
+                    continue;
+                }
+                if ((*it)->subscribed.load()) {
+                    subscribers.push_back(*it);
+                }
+                ++it;
+            }
+        }
+        for (auto& client : gone) {
+            client->reader.join();
+            DisconnectNamedPipe(client->pipe);
+            CloseHandle(client->pipe);
+        }
+
+        // Mapping readers pulse, subscribers are readers while connected
+        if (shared.TakeReaderPulse() || !subscribers.empty()) {
+            collector.NoteReader();
+        }
+        if (collector.WaitForSnapshot(published, WAIT_SLICE_MS)->stateVersion == published) {
+            continue;
+        }
+
+        // Let the rest of a burst land before publishing
+        auto earliest = lastPublish + minInterval;
+        auto now = std::chrono::steady_clock::now();
+        if (now < earliest) {
+            std::this_thread::sleep_for(earliest - now);
+        }
+
+        snapshot = collector.GetSnapshot();
+        published = snapshot->stateVersion;
+        shared.Publish(snapshot->serialized, snapshot->version, snapshot->stateVersion);
+        for (auto& client : subscribers) {
+            SendContext(*client, *snapshot);
+        }
+        lastPublish = std::chrono::steady_clock::now();
+    }
+}
+
+std::string LocalContextServer::ContextFrame(const ContextCollector::Snapshot& snapshot) {
+    std::string line;
+    line.reserve(snapshot.serialized.size() + 64);
+    JsonWriter writer(line);
+    writer.BeginObject();
+    writer.Key("type").String("context");
+    writer.Key("version").UInt(snapshot.version);
+    writer.Key("context").Raw(snapshot.serialized);
+    writer.EndObject();
+    line += '\n';
+    return line;
+}
+
+bool LocalContextServer::SendContext(Client& client, const ContextCollector::Snapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(client.writeMutex);
+    if (client.sentVersion == snapshot.version) {
+        return true;        // Already sent (a get or subscribe raced the publisher)
+    }
+    client.sentVersion = snapshot.version;
+    std::string frame = ContextFrame(snapshot);
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    DWORD written = 0;
+    bool ok = WriteFile(client.pipe, frame.data(), static_cast<DWORD>(frame.size()), &written, &overlapped) != 0;
+    if (!ok && GetLastError() == ERROR_IO_PENDING) {
+        if (WaitForSingleObject(overlapped.hEvent, SEND_TIMEOUT_MS) != WAIT_OBJECT_0) {
+            CancelIo(client.pipe);
+        }
+        ok = GetOverlappedResult(client.pipe, &overlapped, &written, TRUE) != 0;
+    }
+    CloseHandle(overlapped.hEvent);
+    if (!ok || written != frame.size()) {
+        // A subscriber that can't keep up is dropped, not queued for
+        LOG_DEBUG("LocalIpc", "Dropping a slow or closed subscriber");
+        client.connected = false;
+        CancelIoEx(client.pipe, nullptr);
+        return false;
+    }
+    return true;
+}
+
+bool LocalContextServer::Send(Client& client, const std::string& line) {
+    std::lock_guard<std::mutex> lock(client.writeMutex);
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    DWORD written = 0;
+    bool ok = WriteFile(client.pipe, line.data(), static_cast<DWORD>(line.size()), &written, &overlapped) != 0;
+    if (!ok && GetLastError() == ERROR_IO_PENDING) {
+        if (WaitForSingleObject(overlapped.hEvent, SEND_TIMEOUT_MS) != WAIT_OBJECT_0) {
+            CancelIo(client.pipe);
+        }
+        ok = GetOverlappedResult(client.pipe, &overlapped, &written, TRUE) != 0;
+    }
+    CloseHandle(overlapped.hEvent);
+    return ok && written == line.size();
+}
+
+// ============================================================================
+// Pipe connections
+// ============================================================================
+
+HANDLE LocalContextServer::CreatePipeInstance(bool first) {
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(PIPE_SDDL, SDDL_REVISION_1, &descriptor, nullptr)) {
+        return INVALID_HANDLE_VALUE;
+    }
+    SECURITY_ATTRIBUTES attributes = { sizeof(attributes), descriptor, FALSE };
+    HANDLE pipe = CreateNamedPipeA(PIPE_NAME,
+                                   PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                                   PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                   PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_BYTES, PIPE_BUFFER_BYTES, 0, &attributes);
+    LocalFree(descriptor);
+    return pipe;
+}
+
+void LocalContextServer::AcceptLoop(HANDLE pipe) {
+    TRACE_THREAD("Local context accept");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Http);
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+    while (running.load()) {
+        if (pipe == INVALID_HANDLE_VALUE) {
+            pipe = CreatePipeInstance(false);
+            if (pipe == INVALID_HANDLE_VALUE) {
+                LOG_ERROR("LocalIpc", "Cannot create a pipe instance: " << GetLastError());
+                WaitForSingleObject(stopEvent, 1000);
+                continue;
+            }
+        }
+
+        ResetEvent(overlapped.hEvent);
+        bool connected = ConnectNamedPipe(pipe, &overlapped) != 0;
+        DWORD error = GetLastError();
+        DWORD ignored = 0;
+        if (!connected && error == ERROR_IO_PENDING) {
+            HANDLE waits[] = { overlapped.hEvent, stopEvent };
+            if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIo(pipe);
+                GetOverlappedResult(pipe, &overlapped, &ignored, TRUE);
+                break;
+            }
+            connected = GetOverlappedResult(pipe, &overlapped, &ignored, FALSE) != 0;
+        } else if (!connected && error == ERROR_PIPE_CONNECTED) {
+            connected = true;
+        }
+        if (!connected) {
+            CloseHandle(pipe);
+            pipe = INVALID_HANDLE_VALUE;
+            continue;
+        }
+
+        auto client = std::make_shared<Client>();
+        client->pipe = pipe;
+        pipe = INVALID_HANDLE_VALUE;
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        if (clients.size() >= MAX_CLIENTS) {
+            LOG_WARNING("LocalIpc", "Client limit (" << MAX_CLIENTS << ") reached; connection refused");
+            client->connected = false;
+            client->reader = std::thread([this, client]() {
+                Send(*client, ErrorLine("too many local clients"));
+            });
+        } else {
+            client->reader = std::thread(&LocalContextServer::ReaderLoop, this, client);
+        }
+        clients.push_back(client);          // The publisher reaps it once disconnected
+    }
+
+    if (pipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(pipe);
+    }
+    CloseHandle(overlapped.hEvent);
+}
+
+void LocalContextServer::ReaderLoop(std::shared_ptr<Client> client) {
+    TRACE_THREAD("Local context client");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Http);
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    std::string pending;
+    std::vector<char> buffer(PIPE_BUFFER_BYTES);
+
+    bool open = true;
+    while (open && running.load() && client->connected.load()) {
+        ResetEvent(overlapped.hEvent);
+        DWORD received = 0;
+        bool ok = ReadFile(client->pipe, buffer.data(), static_cast<DWORD>(buffer.size()), &received, &overlapped) != 0;
+        if (!ok && GetLastError() == ERROR_IO_PENDING) {
+            HANDLE waits[] = { overlapped.hEvent, stopEvent };
+            if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIo(client->pipe);
+                GetOverlappedResult(client->pipe, &overlapped, &received, TRUE);
+                break;
+            }
+            ok = GetOverlappedResult(client->pipe, &overlapped, &received, FALSE) != 0;
+        }
+        if (!ok || received == 0) {
+            break;                  // Closed by the client, or cancelled by a failed push
+        }
+
+        pending.append(buffer.data(), received);
+        size_t newline;
+        while (open && (newline = pending.find('\n')) != std::string::npos) {
+            open = HandleMessage(*client, std::string_view(pending).substr(0, newline));
+            pending.erase(0, newline + 1);
+        }
+        if (pending.size() > MAX_MESSAGE_BYTES) {
+            Send(*client, ErrorLine("message too large"));
+            open = false;
+        }
+    }
+
+    CloseHandle(overlapped.hEvent);
+    client->connected = false;
+}
+
+bool LocalContextServer::HandleMessage(Client& client, std::string_view line) {
+    if (JsonReader::SkipWhitespace(line, 0) == line.size()) {
+        return true;                // Blank line (or a CR)
+    }
+    JsonValue message = JsonReader::Parse(line);
+    std::string scratch;
+    std::string_view type = message["type"].AsString(scratch);
+
+    if (type == "get" || type == "subscribe") {
+        collector.NoteReader();
+        if (type == "subscribe") {
+            client.subscribed = true;
+        }
+        {
+            // A get always answers, even when a subscription already sent this version
+            std::lock_guard<std::mutex> lock(client.writeMutex);
+            client.sentVersion = 0;
+        }
+        return SendContext(client, *collector.GetSnapshot());
+    }
+    if (type == "unsubscribe") {
+        client.subscribed = false;
+        return true;
+    }
+    if (type == "ingest") {
+        JsonValue events = message["events"];
+        if (!events.IsArray()) {
+            return Send(client, ErrorLine("ingest needs an \"events\" array"));
+        }
+        size_t applied = 0;
+        size_t rejected = 0;
+        ingest(events.Raw(), applied, rejected);
+        std::string reply;
+        JsonWriter writer(reply);
+        writer.BeginObject().Key("type").String("ingested")
+              .Key("applied").UInt(applied).Key("rejected").UInt(rejected).EndObject();
+        reply += '\n';
+        return Send(client, reply);
+    }
+    return Send(client, ErrorLine(message.IsObject() ? "unknown message type" : "malformed message"));
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "ContextCollector.h"
+#include "SharedContextSnapshot.h"
+
+/**
+ * LocalContextServer - /context for processes on this machine, without TCP
+ *
+ * Two transports next to the HTTP API, fed from the same snapshots:
+ *
+ *   SharedContextSnapshot (mapping "Global\NovaPerceptionContext", or Local
+ *   in a console run): every new document, for readers that poll. Reading
+ *   an unchanged context is a counter compare.
+ *
+ *   Named pipe PIPE_NAME, one JSON object per line each way, for readers
+ *   that want to be told and for producers:
+ *     client -> engine  {"type":"get"}
+ *                       {"type":"subscribe"} / {"type":"unsubscribe"}
+ *                       {"type":"ingest","events":[...]}   (as POST /ingest)
+ *     engine -> client  {"type":"context","version":n,"context":{...}}
+ *                       {"type":"ingested","applied":n,"rejected":n}
+ *                       {"type":"error","message":"..."}
+ *   A subscriber gets the current context at once and then every change,
+ *   coalesced to one frame per minIntervalMs like /context/stream. One that
+ *   doesn't take a frame within SEND_TIMEOUT_MS is disconnected rather than
+ *   buffered for.
+ *
+ * Shared-memory readers and subscribers count as context readers
+ * (ContextCollector::NoteReader), so system fields keep refreshing for them.
+ *
+ * Usage:
+ *   LocalContextServer local(collector, [&](std::string_view events, size_t& applied, size_t& rejected) { ... });
+ *   local.Start();
+ *   local.Stop();
+ */
+class LocalContextServer {
+public:
+    static constexpr const char* PIPE_NAME = "\\\\.\\pipe\\NovaPerceptionContext";
+    static constexpr int DEFAULT_MIN_INTERVAL_MS = 250;
+    static constexpr size_t MAX_CLIENTS = 32;
+    static constexpr size_t MAX_MESSAGE_BYTES = 1024 * 1024;    // An ingest batch
+
+    // Applies an ingest batch (a JSON array of /ingest events); counts what it took
+    using IngestHandler = std::function<void(std::string_view events, size_t& applied, size_t& rejected)>;
+
+    LocalContextServer(ContextCollector& collector, IngestHandler ingest,
+                       int minIntervalMs = DEFAULT_MIN_INTERVAL_MS);
+    ~LocalContextServer();
+
+    LocalContextServer(const LocalContextServer&) = delete;
+    LocalContextServer& operator=(const LocalContextServer&) = delete;
+
+    /**
+     * @brief Map the snapshot and open the pipe
+     * @return false when neither transport could be set up
+     */
+    bool Start();
+    void Stop();
+
+    size_t GetClientCount() const;
+    const std::string& GetMappingName() const { return shared.GetName(); }
+
+private:
+    struct Client {
+        HANDLE pipe = INVALID_HANDLE_VALUE;
+        std::thread reader;
+        std::atomic<bool> connected{true};
+        std::atomic<bool> subscribed{false};
+        std::mutex writeMutex;              // Replies and pushed frames, one at a time
+        uint64_t sentVersion = 0;           // Guarded by writeMutex
+    };
+
+    static constexpr int WAIT_SLICE_MS = 500;           // Stop() latency
+    static constexpr DWORD SEND_TIMEOUT_MS = 1000;
+    static constexpr DWORD PIPE_BUFFER_BYTES = 64 * 1024;
+
+    void PublishThread();
+    void AcceptLoop(HANDLE first);
+    void ReaderLoop(std::shared_ptr<Client> client);
+    // False ends the connection
+    bool HandleMessage(Client& client, std::string_view line);
+
+    HANDLE CreatePipeInstance(bool first);
+    // The snapshot as a context frame, unless the client already has this version
+    bool SendContext(Client& client, const ContextCollector::Snapshot& snapshot);
+    bool Send(Client& client, const std::string& line);
+    static std::string ContextFrame(const ContextCollector::Snapshot& snapshot);
+
+    ContextCollector& collector;
+    IngestHandler ingest;
+    std::chrono::milliseconds minInterval;
+    SharedContextSnapshot shared;
+
+    std::atomic<bool> running{false};
+    HANDLE stopEvent;                       // Manual reset; wakes the accept and reader waits
+    std::thread publishThread;
+    std::thread acceptThread;
+
+    mutable std::mutex clientsMutex;
+    std::vector<std::shared_ptr<Client>> clients;
+};
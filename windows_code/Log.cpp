@@ -0,0 +1,219 @@
+#include "Log.h"
+#include "JsonWriter.h"
+#include <windows.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+static constexpr size_t RING_MASK = Log::RING_CAPACITY - 1;
+static_assert((Log::RING_CAPACITY & RING_MASK) == 0, "ring capacity must be a power of two");
+
+static constexpr size_t MAX_BATCH_BYTES = 64 * 1024;       // Written (and flushed) in pieces past this
+
+static const char* const LEVEL_NAMES[] = { "debug", "info", "warning", "error", "off" };
+static const char* const LEVEL_LABELS[] = { "DEBUG", "INFO ", "WARN ", "ERROR", "OFF  " };
+
+std::atomic<int> Log::minLevel{static_cast<int>(Log::Level::Info)};
+
+Log& Log::Instance() {
+    // Leaked like the other process-wide caches: threads may log during exit.
+    // atexit drains what is still queued before stdout is flushed and closed
+    static Log* log = [] {
+        Log* instance = new Log();
+        std::atexit([] { Log::Flush(); });
+        return instance;
+    }();
+    return *log;
+}
+
+Log::Log() : slots(new Slot[RING_CAPACITY]) {
+    for (size_t i = 0; i < RING_CAPACITY; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer = std::thread(&Log::WriterThread, this);
+}
+
+// ============================================================================
+// Ring (multi-producer, single-consumer)
+// ============================================================================
+
+bool Log::Push(Record&& record) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[pos & RING_MASK];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;                   // Full: the writer hasn't freed this slot yet
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->record = std::move(record);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool Log::Pop(Record& record) {
+    Slot& slot = slots[dequeuePos & RING_MASK];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+        return false;
+    }
+    record = std::move(slot.record);
+    slot.sequence.store(dequeuePos + RING_CAPACITY, std::memory_order_release);
+    ++dequeuePos;
+    return true;
+}
+
+// ============================================================================
+// Producers
+// ============================================================================
+
+void Log::Write(Level level, const char* tag, std::string message) {
+    Log& log = Instance();
+    Record record;
+    record.level = level;
+    record.tag = tag;
+    record.threadId = GetCurrentThreadId();
+    record.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.message = std::move(message);
+
+    if (!log.Push(std::move(record))) {
+        log.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (level >= Level::Warning) {
+        log.wake.notify_one();              // Don't sit on problems for a flush interval
+    }
+}
+
+void Log::Flush() {
+    Log& log = Instance();
+    std::unique_lock<std::mutex> lock(log.wakeMutex);
+    uint64_t target = ++log.flushRequested;
+    log.wake.notify_one();
+    log.flushed.wait(lock, [&log, target] { return log.flushCompleted.load() >= target; });
+}
+
+void Log::SetFormat(Format value) {
+    Instance().format.store(static_cast<int>(value), std::memory_order_relaxed);
+}
+
+Log::Format Log::GetFormat() {
+    return static_cast<Format>(Instance().format.load(std::memory_order_relaxed));
+}
+
+uint64_t Log::GetWrittenCount() {
+    return Instance().written.load(std::memory_order_relaxed);
+}
+
+uint64_t Log::GetDroppedCount() {
+    return Instance().dropped.load(std::memory_order_relaxed);
+}
+
+const char* Log::LevelName(Level level) {
+    size_t index = static_cast<size_t>(level);
+    return index < sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]) ? LEVEL_NAMES[index] : "unknown";
+}
+
+bool Log::ParseLevel(const std::string& name, Level& level) {
+    for (size_t i = 0; i < sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]); ++i) {
+        if (name == LEVEL_NAMES[i]) {
+            level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+void Log::FormatRecord(const Record& record, std::string& out) const {
+    if (static_cast<Format>(format.load(std::memory_order_relaxed)) == Format::Json) {
+        JsonWriter writer(out);
+        writer.BeginObject();
+        writer.Key("ts").Int(record.timeMs);
+        writer.Key("level").String(LevelName(record.level));
+        writer.Key("tag").String(record.tag);
+        writer.Key("thread").UInt(record.threadId);
+        writer.Key("msg").String(record.message);
+        writer.EndObject();
+        out += '\n';
+        return;
+    }
+
+    time_t seconds = static_cast<time_t>(record.timeMs / 1000);
+    tm local = {};
+    localtime_s(&local, &seconds);
+    char prefix[64];
+    std::snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d %s [", local.tm_hour, local.tm_min, local.tm_sec,
+                  static_cast<int>(record.timeMs % 1000), LEVEL_LABELS[static_cast<size_t>(record.level)]);
+    out += prefix;
+    out += record.tag;
+    out += "] ";
+    out += record.message;
+    out += '\n';
+}
+
+static void Emit(const std::string& batch) {
+    std::fwrite(batch.data(), 1, batch.size(), stdout);
+    std::fflush(stdout);
+    OutputDebugStringA(batch.c_str());
+}
+
+void Log::WriterThread() {
+    std::string batch;
+    batch.reserve(MAX_BATCH_BYTES);
+    uint64_t reportedDrops = 0;
+    Record record;
+
+    for (;;) {
+        uint64_t flushTarget = flushRequested.load();
+        uint64_t count = 0;
+        while (Pop(record)) {
+            FormatRecord(record, batch);
+            ++count;
+            if (batch.size() >= MAX_BATCH_BYTES) {
+                Emit(batch);
+                batch.clear();
+            }
+        }
+
+        uint64_t drops = dropped.load(std::memory_order_relaxed);
+        if (drops != reportedDrops) {
+            Record notice;
+            notice.level = Level::Warning;
+            notice.tag = "Log";
+            notice.threadId = GetCurrentThreadId();
+            notice.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            notice.message = std::to_string(drops - reportedDrops) + " records dropped (ring full)";
+            FormatRecord(notice, batch);
+            reportedDrops = drops;
+        }
+
+        if (!batch.empty()) {
+            Emit(batch);
+            batch.clear();
+        }
+        written.fetch_add(count, std::memory_order_relaxed);
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        if (flushTarget > flushCompleted.load()) {
+            flushCompleted = flushTarget;
+            flushed.notify_all();
+        }
+        wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] {
+            return flushRequested.load() != flushCompleted.load();
+        });
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/**
+ * Log - Asynchronous, leveled, structured logger
+ *
+ * Every std::cout << ... << std::endl used to flush the console on the
+ * calling thread; console writes on Windows are slow and serialize all
+ * writers, so per-request and per-token logging stalled the HTTP workers and
+ * the decoder. Records now go into a lock-free bounded ring (one CAS per
+ * record, Vyukov MPSC) and a background thread formats and writes them in
+ * batches, flushing once per batch.
+ *
+ * Usage:
+ *   LOG_DEBUG("Http", "Parsed request: " << request.method << " " << request.path);
+ *   LOG_ERROR("Camera", "Vision encoder error: " << e.what());
+ *   Log::SetLevel(Log::Level::Debug);              // Any time, e.g. from POST /log
+ *
+ * A disabled level costs one relaxed atomic load and a compare: the macro
+ * arguments aren't evaluated. When the ring is full a record is dropped
+ * (and counted) rather than blocking the caller.
+ *
+ * Output: "HH:MM:SS.mmm LEVEL [Tag] message" lines, or one JSON object per
+ * line (ts, level, tag, thread, msg) in Format::Json, written to stdout and
+ * OutputDebugString (visible in DebugView when running as a service).
+ */
+class Log {
+public:
+    enum class Level { Debug, Info, Warning, Error, Off };
+    enum class Format { Text, Json };
+
+    static constexpr size_t RING_CAPACITY = 4096;          // Records; power of two
+    static constexpr int FLUSH_INTERVAL_MS = 50;            // Writer wake-up when idle
+
+    static bool Enabled(Level level) {
+        return static_cast<int>(level) >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    // Queue a record; tag must be a string literal (stored by pointer)
+    static void Write(Level level, const char* tag, std::string message);
+
+    static void SetLevel(Level level) { minLevel.store(static_cast<int>(level), std::memory_order_relaxed); }
+    static Level GetLevel() { return static_cast<Level>(minLevel.load(std::memory_order_relaxed)); }
+    static void SetFormat(Format format);
+    static Format GetFormat();
+
+    // Block until everything queued so far is written
+    static void Flush();
+
+    static uint64_t GetWrittenCount();
+    static uint64_t GetDroppedCount();
+
+    static const char* LevelName(Level level);
+    static bool ParseLevel(const std::string& name, Level& level);     // "debug", "info", "warning", "error", "off"
+
+private:
+    struct Record {
+        Level level = Level::Info;
+        const char* tag = "";
+        uint32_t threadId = 0;
+        int64_t timeMs = 0;                 // Unix epoch
+        std::string message;
+    };
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    Log();                                  // Never destroyed (see Instance)
+    static Log& Instance();
+
+    bool Push(Record&& record);
+    bool Pop(Record& record);
+    void WriterThread();
+    void FormatRecord(const Record& record, std::string& out) const;
+
+    static std::atomic<int> minLevel;
+
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> enqueuePos{0};
+    size_t dequeuePos = 0;                  // Writer thread only
+
+    std::atomic<int> format{static_cast<int>(Format::Text)};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> flushRequested{0};
+    std::atomic<uint64_t> flushCompleted{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::thread writer;
+};
+
+#define LOG_AT(level, tag, expr)                                        \
+    do {                                                                \
+        if (Log::Enabled(level)) {                                      \
+            std::ostringstream logStream_;                              \
+            logStream_ << expr;                                         \
+            Log::Write(level, tag, logStream_.str());                   \
+        }                                                               \
+    } while (0)
+
+#define LOG_DEBUG(tag, expr) LOG_AT(Log::Level::Debug, tag, expr)
+#define LOG_INFO(tag, expr) LOG_AT(Log::Level::Info, tag, expr)
+#define LOG_WARNING(tag, expr) LOG_AT(Log::Level::Warning, tag, expr)
+#define LOG_ERROR(tag, expr) LOG_AT(Log::Level::Error, tag, expr)
@@ -0,0 +1,257 @@
+#include "LogMelSpectrogram.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define LOG_MEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Slaney mel scale (librosa's default, htk=False): linear below 1 kHz, logarithmic above
+const double MEL_LINEAR_HZ = 200.0 / 3.0;
+const double MEL_LOG_START_HZ = 1000.0;
+const double MEL_LOG_START = MEL_LOG_START_HZ / MEL_LINEAR_HZ;
+const double MEL_LOG_STEP = 0.06875177742094912;    // ln(6.4) / 27
+
+double HzToMel(double hz) {
+    return hz < MEL_LOG_START_HZ ? hz / MEL_LINEAR_HZ
+                                 : MEL_LOG_START + std::log(hz / MEL_LOG_START_HZ) / MEL_LOG_STEP;
+}
+
+double MelToHz(double mel) {
+    return mel < MEL_LOG_START ? mel * MEL_LINEAR_HZ
+                               : MEL_LOG_START_HZ * std::exp(MEL_LOG_STEP * (mel - MEL_LOG_START));
+}
+
+float WeightedSum(const float* weights, const float* values, int count) {
+    int i = 0;
+    float sum = 0.0f;
+#ifdef LOG_MEL_X86
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(weights + i), _mm_loadu_ps(values + i)));
+    }
+    __m128 high = _mm_movehl_ps(acc, acc);
+    acc = _mm_add_ps(acc, high);
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#endif
+    for (; i < count; ++i) {
+        sum += weights[i] * values[i];
+    }
+    return sum;
+}
+
+}  // namespace
+
+LogMelSpectrogram::LogMelSpectrogram()
+    : bands(0)
+    , frameCount(0)
+    , peak(LOG_FLOOR) {
+}
+
+LogMelSpectrogram::~LogMelSpectrogram() = default;
+
+void LogMelSpectrogram::Configure(int bandCount) {
+    bands = (std::max)(bandCount, 0);
+    filterWeights.clear();
+    filterStart.clear();
+    filterLength.clear();
+    filterOffset.clear();
+    frames.clear();
+    frameCount = 0;
+    peak = LOG_FLOOR;
+    if (bands == 0) {
+        return;
+    }
+
+    // Periodic Hann, as whisper's
+    window.resize(FFT_SIZE);
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        window[i] = static_cast<float>(0.5 * (1.0 - std::cos(2.0 * PI * i / FFT_SIZE)));
+    }
+
+    fft.Configure(FFT_SIZE);   // 200 complex points: radix 4, 5, 5, 2
+
+    // librosa.filters.mel(sr=16000, n_fft=400, n_mels=bands), Slaney-normalized
+    std::vector<double> edges(bands + 2);
+    const double maxMel = HzToMel(SAMPLE_RATE / 2.0);
+    for (int i = 0; i < bands + 2; ++i) {
+        edges[i] = MelToHz(maxMel * i / (bands + 1));
+    }
+    for (int b = 0; b < bands; ++b) {
+        const double lower = edges[b];
+        const double centre = edges[b + 1];
+        const double upper = edges[b + 2];
+        const double norm = 2.0 / (upper - lower);
+        int start = -1;
+        int end = -1;
+        std::vector<float> weights;
+        for (int k = 0; k < BINS; ++k) {
+            const double hz = static_cast<double>(k) * SAMPLE_RATE / FFT_SIZE;
+            const double rising = (hz - lower) / (centre - lower);
+            const double falling = (upper - hz) / (upper - centre);
+            const double weight = (std::max)(0.0, (std::min)(rising, falling)) * norm;
+            if (weight > 0.0) {
+                if (start < 0) {
+                    start = k;
+                }
+                end = k + 1;
+            }
+            weights.push_back(static_cast<float>(weight));
+        }
+        if (start < 0) {
+            start = end = 0;    // Narrower than a bin (only with very many bands)
+        }
+        filterStart.push_back(start);
+        filterLength.push_back(end - start);
+        filterOffset.push_back(static_cast<int>(filterWeights.size()));
+        filterWeights.insert(filterWeights.end(), weights.begin() + start, weights.begin() + end);
+    }
+
+    frameSamples.resize(FFT_SIZE);
+    windowed.resize(FFT_SIZE);
+    spectrumRe.resize(BINS);
+    spectrumIm.resize(BINS);
+    power.resize(BINS);
+    frames.reserve(RESERVED_FRAMES * bands);
+}
+
+void LogMelSpectrogram::Reset() {
+    frames.clear();
+    if (bands > 0 && frames.capacity() < RESERVED_FRAMES * bands) {
+        frames.reserve(RESERVED_FRAMES * bands);   // Take() handed the last buffer out
+    }
+    frameCount = 0;
+    peak = LOG_FLOOR;
+}
+
+size_t LogMelSpectrogram::StableFrames(size_t count) {
+    // Frame i spans samples [160 i - 200, 160 i + 200); the reflection of
+    // frame 0 reads sample 200
+    const size_t half = FFT_SIZE / 2;
+    return count > half ? (count - half) / HOP + 1 : 0;
+}
+
+size_t LogMelSpectrogram::TouchingFrames(size_t count) {
+    return (count + FFT_SIZE / 2 + HOP - 1) / HOP;
+}
+
+size_t LogMelSpectrogram::WhisperFrameCount(size_t samples) {
+    return StableFrames(samples) > 0 ? StableFrames(samples) : 1;
+}
+
+void LogMelSpectrogram::Advance(const float* audio, size_t count) {
+    if (bands == 0) {
+        return;
+    }
+    const size_t stable = StableFrames(count);
+    if (stable > frameCount) {
+        ComputeFrames(audio, count, frameCount, stable, frames, peak);
+        frameCount = stable;
+    }
+}
+
+void LogMelSpectrogram::Take(const float* audio, size_t count, Frames& out) {
+    const size_t kept = (std::min)(frameCount, StableFrames(count));
+    out.data.swap(frames);
+    out.data.resize(kept * bands);
+    out.peak = kept == frameCount ? peak : LOG_FLOOR;
+    CompleteFrames(audio, count, kept, out);
+    Reset();
+}
+
+void LogMelSpectrogram::Copy(const float* audio, size_t count, Frames& out) {
+    const size_t kept = (std::min)(frameCount, StableFrames(count));
+    out.data.assign(frames.begin(), frames.begin() + kept * bands);
+    out.peak = kept == frameCount ? peak : LOG_FLOOR;
+    CompleteFrames(audio, count, kept, out);
+}
+
+void LogMelSpectrogram::CompleteFrames(const float* audio, size_t count, size_t kept, Frames& out) {
+    out.bands = bands;
+    out.samples = count;
+    if (bands == 0) {
+        out.data.clear();
+        return;
+    }
+    if (kept < frameCount) {
+        // Cut before the newest frames: the peak may have been among them
+        for (float value : out.data) {
+            out.peak = (std::max)(out.peak, value);
+        }
+    }
+    ComputeFrames(audio, count, kept, TouchingFrames(count), out.data, out.peak);
+}
+
+void LogMelSpectrogram::ComputeFrames(const float* audio, size_t count, size_t first, size_t last,
+                                      std::vector<float>& out, float& maxValue) {
+    if (last <= first) {
+        return;
+    }
+    out.resize(last * bands);
+    for (size_t index = first; index < last; ++index) {
+        float* frame = out.data() + index * bands;
+        ComputeFrame(audio, count, index, frame);
+        for (int b = 0; b < bands; ++b) {
+            maxValue = (std::max)(maxValue, frame[b]);
+        }
+    }
+}
+
+void LogMelSpectrogram::ComputeFrame(const float* audio, size_t count, size_t index, float* out) {
+    // Window start relative to the audio; whisper reflects the first 200
+    // samples (sample -n is sample n) and pads the end with zeros
+    const ptrdiff_t start = static_cast<ptrdiff_t>(index * HOP) - FFT_SIZE / 2;
+    const float* samples = nullptr;
+    if (start >= 0 && static_cast<size_t>(start) + FFT_SIZE <= count) {
+        samples = audio + start;
+    } else {
+        for (int n = 0; n < FFT_SIZE; ++n) {
+            ptrdiff_t position = start + n;
+            if (position < 0) {
+                position = -position;
+            }
+            frameSamples[n] = static_cast<size_t>(position) < count ? audio[position] : 0.0f;
+        }
+        samples = frameSamples.data();
+    }
+
+    for (int n = 0; n < FFT_SIZE; ++n) {
+        windowed[n] = samples[n] * window[n];
+    }
+    fft.Forward(windowed.data(), spectrumRe.data(), spectrumIm.data());
+    for (int k = 0; k < BINS; ++k) {
+        power[k] = spectrumRe[k] * spectrumRe[k] + spectrumIm[k] * spectrumIm[k];
+    }
+
+    for (int b = 0; b < bands; ++b) {
+        const float sum = WeightedSum(filterWeights.data() + filterOffset[b], power.data() + filterStart[b],
+                                      filterLength[b]);
+        out[b] = std::log10((std::max)(sum, 1e-10f));
+    }
+}
+
+size_t LogMelSpectrogram::ToWhisperLayout(const Frames& frames, size_t minFrames, std::vector<float>& out) {
+    const size_t count = frames.Count();
+    const size_t length = (std::max)(count, minFrames);
+    const int bandCount = frames.bands;
+    out.resize(length * bandCount);
+
+    // whisper_pcm_to_mel: clamp to 8 below the peak (its padding is always
+    // part of the maximum), then (x + 4) / 4
+    const float floor = (std::max)(frames.peak, LOG_FLOOR) - 8.0f;
+    const float silence = ((std::max)(LOG_FLOOR, floor) + 4.0f) / 4.0f;
+    for (int b = 0; b < bandCount; ++b) {
+        float* row = out.data() + b * length;
+        for (size_t i = 0; i < count; ++i) {
+            row[i] = ((std::max)(frames.data[i * bandCount + b], floor) + 4.0f) / 4.0f;
+        }
+        std::fill(row + count, row + length, silence);
+    }
+    return length;
+}
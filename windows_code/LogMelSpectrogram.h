@@ -0,0 +1,137 @@
+#pragma once
+
+#include "RealFft.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * LogMelSpectrogram - Whisper's log-mel front end, computed while the audio arrives
+ *
+ * whisper_full() turns the whole utterance into a log-mel spectrogram before
+ * it can encode anything, so that pass ran after the speaker stopped, and
+ * again over most of the same audio for every streaming partial. One
+ * instance per speech lane now advances frame by frame as the segmenter
+ * appends speech; when the utterance is queued only the last few frames
+ * (the ones that reach past its end) are left to compute, and the worker
+ * hands the frames to whisper_set_mel_with_state() instead of the samples.
+ *
+ * The frames are the ones whisper_pcm_to_mel() produces for the same audio:
+ *   - 400-point periodic Hann window (25 ms), 160-sample hop (10 ms), frame
+ *     i centred on sample 160 i; reflected at the start, zeros past the end
+ *   - power spectrum through a RealFft (a 200-point complex Stockham FFT,
+ *     radix 4/5/5/2, over split real/imaginary arrays so each stage's inner
+ *     loop is unit stride and vectorizes)
+ *   - Slaney mel filter bank over 0..8 kHz (librosa's, which whisper's model
+ *     files carry), stored as each band's non-zero span; the band sums use SSE
+ *   - log10(max(power, 1e-10))
+ * The last step, clamping to 8 below the utterance's peak and scaling, needs
+ * the whole utterance: ToWhisperLayout() applies it when the frames are
+ * handed over, along with whisper's band-major layout and silence padding.
+ *
+ * Frames are kept frame-major and unnormalized, so the audio so far can be
+ * snapshotted (Copy) for a partial pass and later finished (Take) without
+ * recomputing anything the two share.
+ *
+ * Not thread-safe: one instance belongs to one segmenter lane.
+ *
+ * Usage:
+ *   LogMelSpectrogram spectrogram;
+ *   spectrogram.Configure(whisper_model_n_mels(ctx));
+ *   speech.insert(speech.end(), frame, frame + count);
+ *   spectrogram.Advance(speech.data(), speech.size());     // Every append
+ *   LogMelSpectrogram::Frames frames;
+ *   spectrogram.Take(speech.data(), speech.size(), frames);  // Utterance done
+ *   LogMelSpectrogram::ToWhisperLayout(frames, 3000, mel);
+ *   whisper_set_mel_with_state(ctx, state, mel.data(), n_len, frames.bands);
+ */
+class LogMelSpectrogram {
+public:
+    static constexpr int SAMPLE_RATE = 16000;
+    static constexpr int FFT_SIZE = 400;
+    static constexpr int HOP = 160;
+    static constexpr int BINS = FFT_SIZE / 2 + 1;
+    static constexpr float LOG_FLOOR = -10.0f;      // log10(1e-10): whisper's floor, and a silent frame
+
+    // The spectrogram of one utterance (or of the audio so far)
+    struct Frames {
+        std::vector<float> data;        // log10 power, `bands` values per frame, oldest frame first
+        int bands = 0;                  // 0: nothing computed
+        size_t samples = 0;             // Length of the audio the frames were computed for
+        float peak = LOG_FLOOR;         // Largest value in data
+
+        size_t Count() const { return bands > 0 ? data.size() / bands : 0; }
+        void Clear() { data.clear(); bands = 0; samples = 0; peak = LOG_FLOOR; }
+    };
+
+    LogMelSpectrogram();
+    ~LogMelSpectrogram();
+
+    LogMelSpectrogram(const LogMelSpectrogram&) = delete;
+    LogMelSpectrogram& operator=(const LogMelSpectrogram&) = delete;
+
+    // Build the window, FFT plan and filter bank; 0 disables. Resets.
+    void Configure(int bands);
+    int GetBands() const { return bands; }
+    bool IsConfigured() const { return bands > 0; }
+
+    // Forget the frames (a new utterance starts)
+    void Reset();
+
+    // Compute every frame that lies entirely within audio[0, count); audio is
+    // the whole utterance so far, the same buffer every call, only ever grown
+    void Advance(const float* audio, size_t count);
+
+    // Frames of exactly audio[0, count), count no more than the last Advance()
+    // saw: the frames before the cut are reused, the ones past it recomputed
+    // with whisper's zero padding. Take() moves the frames out and resets;
+    // Copy() leaves the spectrogram as it was
+    void Take(const float* audio, size_t count, Frames& out);
+    void Copy(const float* audio, size_t count, Frames& out);
+
+    // Frames whisper decodes for `samples` of audio (its n_len_org)
+    static size_t WhisperFrameCount(size_t samples);
+
+    /**
+     * @brief Normalize the frames and lay them out for whisper_set_mel_with_state
+     * @param minFrames Silence frames are appended up to this many (the encoder's window)
+     * @return n_len: frames per band in out (bands x n_len, band-major)
+     */
+    static size_t ToWhisperLayout(const Frames& frames, size_t minFrames, std::vector<float>& out);
+
+private:
+    static constexpr size_t RESERVED_FRAMES = 3000;     // 30 s, one whisper window
+
+    // Frames whose window lies within audio[0, count)
+    static size_t StableFrames(size_t count);
+    // Frames whose window touches audio[0, count) at all
+    static size_t TouchingFrames(size_t count);
+
+    // Frames [first, last) of audio[0, count) into out (frame-major); past the end is zero
+    void ComputeFrames(const float* audio, size_t count, size_t first, size_t last,
+                       std::vector<float>& out, float& maxValue);
+    void ComputeFrame(const float* audio, size_t count, size_t index, float* out);
+    // The frames Advance() kept for a cut at count are at the front of out.data
+    void CompleteFrames(const float* audio, size_t count, size_t kept, Frames& out);
+
+    int bands;
+    std::vector<float> window;
+    RealFft fft;
+
+    // Filter bank: band b weighs bins [filterStart[b], filterStart[b] + filterLength[b])
+    std::vector<float> filterWeights;
+    std::vector<int> filterStart;
+    std::vector<int> filterLength;
+    std::vector<int> filterOffset;      // Into filterWeights
+
+    // Per-frame scratch
+    std::vector<float> frameSamples;
+    std::vector<float> windowed;
+    std::vector<float> spectrumRe;
+    std::vector<float> spectrumIm;
+    std::vector<float> power;
+
+    std::vector<float> frames;          // Frame-major log10 power of the frames computed so far
+    size_t frameCount;
+    float peak;
+};
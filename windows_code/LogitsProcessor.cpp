@@ -0,0 +1,299 @@
+#include "LogitsProcessor.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define LOGITS_PROCESSOR_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits AVX2/AVX-512 intrinsics without /arch; GCC/Clang need a per-function target
+#if defined(LOGITS_PROCESSOR_X86) && (defined(__GNUC__) || defined(__clang__))
+#define LOGITS_PROCESSOR_AVX2_TARGET __attribute__((target("avx2")))
+#define LOGITS_PROCESSOR_AVX512_TARGET __attribute__((target("avx512f")))
+#else
+#define LOGITS_PROCESSOR_AVX2_TARGET
+#define LOGITS_PROCESSOR_AVX512_TARGET
+#endif
+
+// ============================================================================
+// SIMD Argmax
+// ============================================================================
+
+namespace {
+
+enum class ArgmaxPath {
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+ArgmaxPath DetectArgmaxPath() {
+#if defined(LOGITS_PROCESSOR_X86) && defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) {
+        return ArgmaxPath::Scalar;
+    }
+
+    // OS must save YMM (and for AVX-512, opmask/ZMM) state on context switch
+    unsigned long long xcr0 = _xgetbv(0);
+    if ((xcr0 & 0x6) != 0x6) {
+        return ArgmaxPath::Scalar;
+    }
+
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    bool avx512f = (info[1] & (1 << 16)) != 0;
+    if (avx512f && (xcr0 & 0xE6) == 0xE6) {
+        return ArgmaxPath::AVX512;
+    }
+    return avx2 ? ArgmaxPath::AVX2 : ArgmaxPath::Scalar;
+#elif defined(LOGITS_PROCESSOR_X86) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx512f")) {
+        return ArgmaxPath::AVX512;
+    }
+    return __builtin_cpu_supports("avx2") ? ArgmaxPath::AVX2 : ArgmaxPath::Scalar;
+#else
+    return ArgmaxPath::Scalar;
+#endif
+}
+
+const ArgmaxPath g_argmaxPath = DetectArgmaxPath();
+
+int64_t ArgmaxScalar(const float* values, size_t count) {
+    return static_cast<int64_t>(std::max_element(values, values + count) - values);
+}
+
+// Both SIMD paths find the maximum with wide max ops, then locate its first
+// occurrence with a compare/movemask scan (usually short). Same result as
+// std::max_element for non-NaN input.
+
+#ifdef LOGITS_PROCESSOR_X86
+LOGITS_PROCESSOR_AVX2_TARGET
+int64_t ArgmaxAVX2(const float* values, size_t count) {
+    if (count < 8) {
+        return ArgmaxScalar(values, count);
+    }
+
+    __m256 best = _mm256_loadu_ps(values);
+    size_t i = 8;
+    for (; i + 8 <= count; i += 8) {
+        best = _mm256_max_ps(best, _mm256_loadu_ps(values + i));
+    }
+
+    // Horizontal max
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(best), _mm256_extractf128_ps(best, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    float maxValue = _mm_cvtss_f32(m);
+    for (; i < count; ++i) {
+        maxValue = (std::max)(maxValue, values[i]);
+    }
+
+    __m256 target = _mm256_set1_ps(maxValue);
+    size_t j = 0;
+    for (; j + 8 <= count; j += 8) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + j), target, _CMP_EQ_OQ));
+        if (mask != 0) {
+            unsigned long bit = 0;
+#if defined(_MSC_VER)
+            _BitScanForward(&bit, static_cast<unsigned long>(mask));
+#else
+            bit = static_cast<unsigned long>(__builtin_ctz(static_cast<unsigned>(mask)));
+#endif
+            return static_cast<int64_t>(j + bit);
+        }
+    }
+    for (; j < count; ++j) {
+        if (values[j] == maxValue) {
+            return static_cast<int64_t>(j);
+        }
+    }
+    return 0;
+}
+
+LOGITS_PROCESSOR_AVX512_TARGET
+int64_t ArgmaxAVX512(const float* values, size_t count) {
+    if (count < 16) {
+        return ArgmaxScalar(values, count);
+    }
+
+    __m512 best = _mm512_loadu_ps(values);
+    size_t i = 16;
+    for (; i + 16 <= count; i += 16) {
+        best = _mm512_max_ps(best, _mm512_loadu_ps(values + i));
+    }
+
+    float maxValue = _mm512_reduce_max_ps(best);
+    for (; i < count; ++i) {
+        maxValue = (std::max)(maxValue, values[i]);
+    }
+
+    __m512 target = _mm512_set1_ps(maxValue);
+    size_t j = 0;
+    for (; j + 16 <= count; j += 16) {
+        __mmask16 mask = _mm512_cmp_ps_mask(_mm512_loadu_ps(values + j), target, _CMP_EQ_OQ);
+        if (mask != 0) {
+            unsigned long bit = 0;
+#if defined(_MSC_VER)
+            _BitScanForward(&bit, static_cast<unsigned long>(mask));
+#else
+            bit = static_cast<unsigned long>(__builtin_ctz(static_cast<unsigned>(mask)));
+#endif
+            return static_cast<int64_t>(j + bit);
+        }
+    }
+    for (; j < count; ++j) {
+        if (values[j] == maxValue) {
+            return static_cast<int64_t>(j);
+        }
+    }
+    return 0;
+}
+#endif
+
+} // namespace
+
+// ============================================================================
+// LogitsProcessor
+// ============================================================================
+
+LogitsProcessor::LogitsProcessor() {
+    Configure(Config());
+}
+
+void LogitsProcessor::Configure(const Config& newConfig) {
+    config = newConfig;
+    rng.seed(config.seed != 0 ? config.seed : std::random_device{}());
+}
+
+int64_t LogitsProcessor::Argmax(const float* values, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+#ifdef LOGITS_PROCESSOR_X86
+    switch (g_argmaxPath) {
+        case ArgmaxPath::AVX512: return ArgmaxAVX512(values, count);
+        case ArgmaxPath::AVX2:   return ArgmaxAVX2(values, count);
+        default: break;
+    }
+#endif
+    return ArgmaxScalar(values, count);
+}
+
+int64_t LogitsProcessor::SelectToken(float* logits, size_t vocabSize, const std::vector<int64_t>& history) {
+    if (vocabSize == 0) {
+        return 0;
+    }
+
+    if (config.repetitionPenalty != 1.0f && !history.empty()) {
+        ApplyRepetitionPenalty(logits, vocabSize, history);
+    }
+
+    if (IsGreedy()) {
+        return Argmax(logits, vocabSize);
+    }
+    return Sample(logits, vocabSize);
+}
+
+void LogitsProcessor::ApplyRepetitionPenalty(float* logits, size_t vocabSize, const std::vector<int64_t>& history) {
+    // Penalize each distinct token once, however often it repeated
+    penalized.assign(history.begin(), history.end());
+    std::sort(penalized.begin(), penalized.end());
+    penalized.erase(std::unique(penalized.begin(), penalized.end()), penalized.end());
+
+    for (int64_t token : penalized) {
+        if (token < 0 || static_cast<size_t>(token) >= vocabSize) {
+            continue;
+        }
+        float& logit = logits[token];
+        logit = logit > 0.0f ? logit / config.repetitionPenalty : logit * config.repetitionPenalty;
+    }
+}
+
+int64_t LogitsProcessor::Sample(float* logits, size_t vocabSize) {
+    const float invTemperature = 1.0f / config.temperature;
+    for (size_t i = 0; i < vocabSize; ++i) {
+        logits[i] *= invTemperature;
+    }
+
+    const float maxLogit = logits[Argmax(logits, vocabSize)];
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    bool useTopK = config.topK > 0 && static_cast<size_t>(config.topK) < vocabSize;
+    bool useTopP = config.topP < 1.0f;
+
+    if (!useTopK && !useTopP) {
+        // Plain temperature sampling: exponentiate in place and walk the CDF
+        double total = 0.0;
+        for (size_t i = 0; i < vocabSize; ++i) {
+            logits[i] = std::exp(logits[i] - maxLogit);
+            total += logits[i];
+        }
+
+        double threshold = uniform(rng) * total;
+        double cumulative = 0.0;
+        for (size_t i = 0; i < vocabSize; ++i) {
+            cumulative += logits[i];
+            if (cumulative >= threshold) {
+                return static_cast<int64_t>(i);
+            }
+        }
+        return static_cast<int64_t>(vocabSize - 1);
+    }
+
+    // Rank the leading candidates (highest logit first)
+    size_t keep = useTopK ? static_cast<size_t>(config.topK) : (std::min)(MAX_NUCLEUS_CANDIDATES, vocabSize);
+
+    candidates.resize(vocabSize);
+    std::iota(candidates.begin(), candidates.end(), 0);
+    auto byLogitDesc = [logits](int32_t a, int32_t b) { return logits[a] > logits[b]; };
+    std::nth_element(candidates.begin(), candidates.begin() + keep, candidates.end(), byLogitDesc);
+    std::sort(candidates.begin(), candidates.begin() + keep, byLogitDesc);
+
+    weights.resize(keep);
+    double keptTotal = 0.0;
+    for (size_t i = 0; i < keep; ++i) {
+        weights[i] = std::exp(logits[candidates[i]] - maxLogit);
+        keptTotal += weights[i];
+    }
+
+    if (useTopP) {
+        // Top-k renormalizes over its survivors; plain top-p uses the full softmax
+        double denominator = keptTotal;
+        if (!useTopK) {
+            denominator = 0.0;
+            for (size_t i = 0; i < vocabSize; ++i) {
+                denominator += std::exp(logits[i] - maxLogit);
+            }
+        }
+
+        double cumulative = 0.0;
+        size_t nucleus = 0;
+        while (nucleus < keep) {
+            cumulative += weights[nucleus++];
+            if (cumulative >= config.topP * denominator) {
+                break;
+            }
+        }
+        keep = nucleus;
+        keptTotal = cumulative;
+    }
+
+    double threshold = uniform(rng) * keptTotal;
+    double cumulative = 0.0;
+    for (size_t i = 0; i < keep; ++i) {
+        cumulative += weights[i];
+        if (cumulative >= threshold) {
+            return candidates[i];
+        }
+    }
+    return candidates[keep - 1];
+}
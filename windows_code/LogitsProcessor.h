@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * LogitsProcessor - Next-token selection over decoder logits
+ *
+ * Single logits stage for CameraVisionEngine::Generate: the first pass and
+ * every cached step go through SelectToken(), so greedy and sampled decoding
+ * share one code path.
+ *
+ * Features:
+ * - Argmax over the full vocabulary with AVX-512F / AVX2 (runtime cpuid
+ *   dispatch), scalar fallback elsewhere; ties resolve to the lowest ID
+ * - Optional repetition penalty, temperature, top-k and top-p (nucleus)
+ *   sampling, applied in place on the ORT output buffer (no logits copy)
+ * - temperature <= 0 is greedy: penalty (if any) then argmax, no RNG
+ *
+ * Usage:
+ *   LogitsProcessor::Config config;
+ *   config.temperature = 0.7f;
+ *   config.topP = 0.9f;
+ *   processor.Configure(config);
+ *   int64_t token = processor.SelectToken(logits, vocabSize, generatedTokens);
+ */
+class LogitsProcessor {
+public:
+    struct Config {
+        float temperature = 0.0f;           // <= 0: greedy
+        int topK = 0;                       // 0: disabled
+        float topP = 1.0f;                  // >= 1: disabled
+        float repetitionPenalty = 1.0f;     // 1: disabled (HF-style: divide positive, multiply negative)
+        uint32_t seed = 0;                  // 0: seed from std::random_device
+    };
+
+    LogitsProcessor();
+
+    void Configure(const Config& config);
+    const Config& GetConfig() const { return config; }
+
+    bool IsGreedy() const { return config.temperature <= 0.0f; }
+
+    /**
+     * Pick the next token. Modifies logits in place (penalty / temperature).
+     * @param logits Mutable logits row for the last position
+     * @param vocabSize Number of entries in the row
+     * @param history Tokens generated so far (for the repetition penalty)
+     */
+    int64_t SelectToken(float* logits, size_t vocabSize, const std::vector<int64_t>& history);
+
+    // Index of the largest value (first on ties)
+    static int64_t Argmax(const float* values, size_t count);
+
+private:
+    void ApplyRepetitionPenalty(float* logits, size_t vocabSize, const std::vector<int64_t>& history);
+    int64_t Sample(float* logits, size_t vocabSize);
+
+    // Without top-k, top-p only ranks this many leading candidates; the
+    // softmax denominator still covers the whole vocabulary
+    static constexpr size_t MAX_NUCLEUS_CANDIDATES = 1024;
+
+    Config config;
+    std::mt19937 rng;
+
+    // Scratch reused across calls
+    std::vector<int32_t> candidates;
+    std::vector<float> weights;
+    std::vector<int64_t> penalized;
+};
@@ -0,0 +1,85 @@
+#include "MappedFile.h"
+#include "Log.h"
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path) {
+    int wideSize = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    if (wideSize <= 1) {
+        return false;
+    }
+    std::wstring wide(wideSize, 0);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], wideSize);
+    wide.resize(wideSize - 1);
+    return Open(wide);
+}
+
+bool MappedFile::Open(const std::wstring& path) {
+    Close();
+
+    file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;   // Missing file: callers fall back to their own loader
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        LOG_ERROR("MappedFile", "Empty or unreadable file (error " << GetLastError() << ")");
+        Close();
+        return false;
+    }
+
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        LOG_ERROR("MappedFile", "CreateFileMapping failed (error " << GetLastError() << ")");
+        Close();
+        return false;
+    }
+
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        LOG_ERROR("MappedFile", "MapViewOfFile failed (error " << GetLastError() << ")");
+        Close();
+        return false;
+    }
+
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Prefetch() const {
+    if (!view) {
+        return;
+    }
+    WIN32_MEMORY_RANGE_ENTRY range = { const_cast<void*>(view), size };
+    if (!PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0)) {
+        LOG_WARNING("MappedFile", "PrefetchVirtualMemory failed (error " << GetLastError() << ")");
+    }
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const volatile unsigned char* bytes = static_cast<const volatile unsigned char*>(view);
+    unsigned char sum = 0;
+    for (size_t offset = 0; offset < size; offset += info.dwPageSize) {
+        sum ^= bytes[offset];
+    }
+    (void)sum;
+}
+
+void MappedFile::Close() {
+    if (view) {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+    size = 0;
+}
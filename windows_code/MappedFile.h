@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <windows.h>
+
+/**
+ * MappedFile - Read-only memory mapping of a whole file
+ *
+ * Model weights read through a mapping live in the page cache rather than
+ * the process heap: clean pages are shared with other processes mapping the
+ * same file and survive restarts, so a warm start touches no disk at all.
+ *
+ * Usage:
+ *   MappedFile file;
+ *   if (file.Open(L"models/whisper/ggml-tiny.en.bin")) {
+ *       Consume(file.Data(), file.Size());
+ *   }
+ *
+ * The view stays valid until Close() or destruction.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Map the file read-only
+     * @return false (and logs) if the file is missing, empty or can't be mapped
+     */
+    bool Open(const std::wstring& path);
+    bool Open(const std::string& path);
+    void Close();
+
+    /**
+     * @brief Read the whole file into the page cache now (background warm-up)
+     *
+     * PrefetchVirtualMemory queues large reads for the view, then every page
+     * is touched so the call returns once they have landed. The pages stay
+     * cached after Close(), so a later Open() of the same file (or a loader
+     * reading it) finds them in memory.
+     */
+    void Prefetch() const;
+
+    bool IsOpen() const { return view != nullptr; }
+    const void* Data() const { return view; }
+    size_t Size() const { return size; }
+
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const void* view = nullptr;
+    size_t size = 0;
+};
@@ -0,0 +1,308 @@
+#include "MediaFoundationCamera.h"
+#include "Log.h"
+#include "Trace.h"
+#include <cstring>
+#include <mferror.h>
+
+#pragma comment(lib, "mfplat.lib")
+#pragma comment(lib, "mf.lib")
+#pragma comment(lib, "mfreadwrite.lib")
+#pragma comment(lib, "mfuuid.lib")
+#pragma comment(lib, "d3d11.lib")
+
+namespace {
+
+// Lower is better: NV12 needs no decode, MJPEG decodes in the video processor
+int SubtypeRank(const GUID& subtype) {
+    if (subtype == MFVideoFormat_NV12) return 0;
+    if (subtype == MFVideoFormat_MJPG) return 1;
+    if (subtype == MFVideoFormat_YUY2) return 2;
+    return -1;
+}
+
+const char* SubtypeName(const GUID& subtype) {
+    if (subtype == MFVideoFormat_NV12) return "NV12";
+    if (subtype == MFVideoFormat_MJPG) return "MJPG";
+    if (subtype == MFVideoFormat_YUY2) return "YUY2";
+    return "?";
+}
+
+} // namespace
+
+MediaFoundationCamera::MediaFoundationCamera()
+    : resetToken(0), outputWidth(0), outputHeight(0), hardware(false), mfStarted(false) {
+}
+
+MediaFoundationCamera::~MediaFoundationCamera() {
+    Close();
+}
+
+bool MediaFoundationCamera::Open(int index, int width, int height) {
+    Close();
+
+    // COM for the calling thread; the capture thread initializes its own
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(MFStartup(MF_VERSION, MFSTARTUP_NOSOCKET))) {
+        LOG_WARNING("Camera", "Media Foundation unavailable");
+        return false;
+    }
+    mfStarted = true;
+
+    // Video capture devices in MF order (the same order as OpenCV's MSMF backend)
+    CComPtr<IMFAttributes> query;
+    IMFActivate** devices = nullptr;
+    UINT32 deviceCount = 0;
+    HRESULT hr = MFCreateAttributes(&query, 1);
+    if (SUCCEEDED(hr)) {
+        hr = query->SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = MFEnumDeviceSources(query, &devices, &deviceCount);
+    }
+    if (SUCCEEDED(hr) && index >= 0 && static_cast<UINT32>(index) < deviceCount) {
+        hr = devices[index]->ActivateObject(IID_PPV_ARGS(&source));
+    } else if (SUCCEEDED(hr)) {
+        hr = MF_E_NOT_FOUND;
+    }
+    for (UINT32 i = 0; i < deviceCount; ++i) {
+        devices[i]->Release();
+    }
+    CoTaskMemFree(devices);
+    if (FAILED(hr)) {
+        LOG_WARNING("Camera", "Media Foundation: no capture device " << index << " (hr=0x" << std::hex << hr
+                    << std::dec << ")");
+        Close();
+        return false;
+    }
+
+    outputWidth = width;
+    outputHeight = height;
+    if (!SelectNativeFormat(width, height)) {
+        Close();
+        return false;
+    }
+
+    // GPU video processor first; MF's software processor if the device refuses
+    hardware = CreateDeviceManager() && CreateReader(true);
+    if (!hardware && !CreateReader(false)) {
+        Close();
+        return false;
+    }
+
+    format += std::string(" -> BGRA ") + std::to_string(outputWidth) + "x" + std::to_string(outputHeight) +
+              (hardware ? " (GPU)" : " (CPU)");
+    LOG_INFO("Camera", "Media Foundation capture on camera " << index << ": " << format);
+    return true;
+}
+
+bool MediaFoundationCamera::SelectNativeFormat(int width, int height) {
+    CComPtr<IMFPresentationDescriptor> presentation;
+    CComPtr<IMFStreamDescriptor> stream;
+    CComPtr<IMFMediaTypeHandler> handler;
+    BOOL selected = FALSE;
+    DWORD typeCount = 0;
+    if (FAILED(source->CreatePresentationDescriptor(&presentation)) ||
+        FAILED(presentation->GetStreamDescriptorByIndex(0, &selected, &stream)) ||
+        FAILED(stream->GetMediaTypeHandler(&handler)) ||
+        FAILED(handler->GetMediaTypeCount(&typeCount))) {
+        LOG_WARNING("Camera", "Media Foundation: cannot list camera formats");
+        return false;
+    }
+
+    // Smallest format covering the request wins; failing that, the largest there is
+    CComPtr<IMFMediaType> best;
+    bool bestCovers = false;
+    UINT64 bestArea = 0;
+    int bestRank = 0;
+    UINT32 bestWidth = 0, bestHeight = 0;
+    GUID bestSubtype = GUID_NULL;
+    for (DWORD i = 0; i < typeCount; ++i) {
+        CComPtr<IMFMediaType> type;
+        GUID subtype = GUID_NULL;
+        UINT32 typeWidth = 0, typeHeight = 0;
+        if (FAILED(handler->GetMediaTypeByIndex(i, &type)) ||
+            FAILED(type->GetGUID(MF_MT_SUBTYPE, &subtype)) ||
+            FAILED(MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &typeWidth, &typeHeight))) {
+            continue;
+        }
+        int rank = SubtypeRank(subtype);
+        if (rank < 0) {
+            continue;
+        }
+
+        bool covers = typeWidth >= static_cast<UINT32>(width) && typeHeight >= static_cast<UINT32>(height);
+        UINT64 area = static_cast<UINT64>(typeWidth) * typeHeight;
+        bool better = !best ||
+            (covers != bestCovers ? covers :
+             area != bestArea ? (covers ? area < bestArea : area > bestArea) :
+             rank < bestRank);
+        if (better) {
+            best = type;
+            bestCovers = covers;
+            bestArea = area;
+            bestRank = rank;
+            bestWidth = typeWidth;
+            bestHeight = typeHeight;
+            bestSubtype = subtype;
+        }
+    }
+
+    if (!best || FAILED(handler->SetCurrentMediaType(best))) {
+        LOG_WARNING("Camera", "Media Foundation: no usable NV12/MJPG/YUY2 camera format");
+        return false;
+    }
+    format = std::string(SubtypeName(bestSubtype)) + " " + std::to_string(bestWidth) + "x" + std::to_string(bestHeight);
+    return true;
+}
+
+bool MediaFoundationCamera::CreateDeviceManager() {
+    HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, D3D11_CREATE_DEVICE_VIDEO_SUPPORT,
+                                   nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, nullptr);
+    if (FAILED(hr)) {
+        LOG_DEBUG("Camera", "No D3D11 video device, using the software video processor");
+        return false;
+    }
+
+    // The reader's worker threads share the device with ours
+    CComQIPtr<ID3D10Multithread> multithread(device);
+    if (multithread) {
+        multithread->SetMultithreadProtected(TRUE);
+    }
+
+    if (FAILED(MFCreateDXGIDeviceManager(&resetToken, &deviceManager)) ||
+        FAILED(deviceManager->ResetDevice(device, resetToken))) {
+        deviceManager.Release();
+        device.Release();
+        return false;
+    }
+    return true;
+}
+
+bool MediaFoundationCamera::CreateReader(bool useGpu) {
+    reader.Release();
+
+    CComPtr<IMFAttributes> attributes;
+    HRESULT hr = MFCreateAttributes(&attributes, 3);
+    if (SUCCEEDED(hr)) {
+        hr = attributes->SetUINT32(MF_SOURCE_READER_ENABLE_ADVANCED_VIDEO_PROCESSING, TRUE);
+    }
+    if (SUCCEEDED(hr) && useGpu) {
+        hr = attributes->SetUnknown(MF_SOURCE_READER_D3D_MANAGER, deviceManager);
+        if (SUCCEEDED(hr)) {
+            hr = attributes->SetUINT32(MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, TRUE);
+        }
+    }
+    if (SUCCEEDED(hr)) {
+        hr = MFCreateSourceReaderFromMediaSource(source, attributes, &reader);
+    }
+
+    // Only the first video stream, converted and scaled to BGRA at the output size
+    CComPtr<IMFMediaType> output;
+    if (SUCCEEDED(hr)) {
+        reader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_ALL_STREAMS), FALSE);
+        hr = reader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), TRUE);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = MFCreateMediaType(&output);
+    }
+    if (SUCCEEDED(hr)) {
+        output->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+        output->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32);
+        output->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+        MFSetAttributeRatio(output, MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+        hr = MFSetAttributeSize(output, MF_MT_FRAME_SIZE, outputWidth, outputHeight);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = reader->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), nullptr, output);
+    }
+
+    if (FAILED(hr)) {
+        LOG_DEBUG("Camera", "Media Foundation " << (useGpu ? "GPU" : "CPU") << " reader setup failed (hr=0x"
+                  << std::hex << hr << std::dec << ")");
+        reader.Release();
+        return false;
+    }
+    return true;
+}
+
+void MediaFoundationCamera::Close() {
+    sample.Release();
+    reader.Release();
+    if (source) {
+        source->Shutdown();
+        source.Release();
+    }
+    deviceManager.Release();
+    device.Release();
+    hardware = false;
+    format.clear();
+    if (mfStarted) {
+        MFShutdown();
+        mfStarted = false;
+    }
+}
+
+bool MediaFoundationCamera::Grab() {
+    if (!reader) {
+        return false;
+    }
+    sample.Release();
+
+    DWORD streamIndex = 0;
+    DWORD flags = 0;
+    LONGLONG timestamp = 0;
+    HRESULT hr = reader->ReadSample(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), 0,
+                                    &streamIndex, &flags, &timestamp, &sample);
+    if (FAILED(hr) || (flags & (MF_SOURCE_READERF_ERROR | MF_SOURCE_READERF_ENDOFSTREAM))) {
+        sample.Release();
+        return false;
+    }
+    // Stream ticks (gaps) come without a sample
+    return sample != nullptr;
+}
+
+bool MediaFoundationCamera::Retrieve(cv::Mat& frame) {
+    TRACE_ZONE("Camera MF retrieve");
+    if (!sample) {
+        return false;
+    }
+
+    CComPtr<IMFMediaBuffer> buffer;
+    if (FAILED(sample->GetBufferByIndex(0, &buffer))) {
+        return false;
+    }
+
+    // Same size every frame, so create() keeps the existing storage
+    frame.create(outputHeight, outputWidth, CV_8UC4);
+    const size_t rowBytes = static_cast<size_t>(outputWidth) * 4;
+
+    // 2D buffers (and GPU surfaces, read back here) report their real pitch,
+    // negative for bottom-up RGB
+    CComQIPtr<IMF2DBuffer> buffer2d(buffer);
+    if (buffer2d) {
+        BYTE* scanline0 = nullptr;
+        LONG pitch = 0;
+        if (FAILED(buffer2d->Lock2D(&scanline0, &pitch))) {
+            return false;
+        }
+        for (int y = 0; y < outputHeight; ++y) {
+            std::memcpy(frame.ptr<uint8_t>(y), scanline0 + static_cast<ptrdiff_t>(y) * pitch, rowBytes);
+        }
+        buffer2d->Unlock2D();
+        return true;
+    }
+
+    BYTE* data = nullptr;
+    DWORD length = 0;
+    if (FAILED(buffer->Lock(&data, nullptr, &length))) {
+        return false;
+    }
+    bool complete = length >= rowBytes * outputHeight;
+    if (complete) {
+        for (int y = 0; y < outputHeight; ++y) {
+            std::memcpy(frame.ptr<uint8_t>(y), data + y * rowBytes, rowBytes);
+        }
+    }
+    buffer->Unlock();
+    return complete;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Windows.h>
+#include <atlbase.h>
+#include <d3d11.h>
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+/**
+ * MediaFoundationCamera - Camera frames scaled and converted by Media Foundation
+ *
+ * Negotiates the camera's closest native format (NV12 preferred, then MJPEG,
+ * then YUY2; the smallest that still covers the requested size) and asks the
+ * source reader for BGRA at exactly the requested size. With a D3D11 device
+ * manager the reader's advanced video processor does the MJPEG decode, colour
+ * conversion and scaling on the GPU; without one MF's software processor does
+ * it. Either way no OpenCV decode/resize runs per frame, and a 224x224 request
+ * yields frames the vision encoder takes as they are.
+ *
+ * Same grab/retrieve split as cv::VideoCapture: Grab() blocks for the next
+ * sample at the camera's rate and only holds it; Retrieve() copies the held
+ * sample into a caller-owned Mat whose storage is reused frame to frame.
+ *
+ * Usage:
+ *   MediaFoundationCamera camera;
+ *   if (camera.Open(0, 224, 224)) {
+ *       while (camera.Grab()) { camera.Retrieve(frame); }     // frame: CV_8UC4, 224x224
+ *   }
+ *
+ * One thread at a time (the capture thread); COM must be initialized on it.
+ */
+class MediaFoundationCamera {
+public:
+    MediaFoundationCamera();
+    ~MediaFoundationCamera();
+
+    MediaFoundationCamera(const MediaFoundationCamera&) = delete;
+    MediaFoundationCamera& operator=(const MediaFoundationCamera&) = delete;
+
+    /**
+     * @brief Open video capture device `index` (MF enumeration order) with output width x height
+     * @return false if the device or any format step failed (caller falls back to OpenCV)
+     */
+    bool Open(int index, int width, int height);
+    void Close();
+
+    /**
+     * @brief Wait for the next sample and hold it
+     */
+    bool Grab();
+
+    /**
+     * @brief Copy the held sample into frame (CV_8UC4 BGRA, output size)
+     */
+    bool Retrieve(cv::Mat& frame);
+
+    bool IsOpened() const { return reader != nullptr; }
+    bool IsHardwareAccelerated() const { return hardware; }
+    const std::string& GetFormatDescription() const { return format; }   // e.g. "MJPG 640x480 -> BGRA 224x224 (GPU)"
+
+private:
+    CComPtr<IMFMediaSource> source;
+    CComPtr<IMFSourceReader> reader;
+    CComPtr<ID3D11Device> device;
+    CComPtr<IMFDXGIDeviceManager> deviceManager;
+    CComPtr<IMFSample> sample;                     // Held between Grab() and Retrieve()
+    UINT resetToken;
+    int outputWidth;
+    int outputHeight;
+    bool hardware;
+    bool mfStarted;
+    std::string format;
+
+    /**
+     * @brief Set the device's native format closest to width x height
+     */
+    bool SelectNativeFormat(int width, int height);
+
+    /**
+     * @brief D3D11 device + DXGI manager for the hardware video processor
+     */
+    bool CreateDeviceManager();
+
+    /**
+     * @brief Source reader with video processing, on the GPU when useGpu
+     */
+    bool CreateReader(bool useGpu);
+};
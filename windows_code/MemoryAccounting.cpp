@@ -0,0 +1,105 @@
+#include "MemoryAccounting.h"
+#include <windows.h>
+#include <psapi.h>
+#include <cstdio>
+#include <utility>
+
+#pragma comment(lib, "psapi.lib")
+
+MemoryAccounting& MemoryAccounting::Instance() {
+    // Leaked like the other process-wide caches: owners unregister during exit
+    static MemoryAccounting* accounting = new MemoryAccounting();
+    return *accounting;
+}
+
+uint64_t MemoryAccounting::Register(Reporter reporter) {
+    std::lock_guard<std::mutex> lock(reportersMutex);
+    uint64_t id = nextId++;
+    reporters.emplace(id, std::move(reporter));
+    return id;
+}
+
+void MemoryAccounting::Unregister(uint64_t id) {
+    std::lock_guard<std::mutex> lock(reportersMutex);
+    reporters.erase(id);
+}
+
+MemoryAccounting::Entries MemoryAccounting::Collect() const {
+    Entries entries;
+    std::lock_guard<std::mutex> lock(reportersMutex);
+    for (const auto& reporter : reporters) {
+        reporter.second(entries);
+    }
+    return entries;
+}
+
+MemoryAccounting::ProcessMemory MemoryAccounting::GetProcessMemory() {
+    ProcessMemory memory;
+    PROCESS_MEMORY_COUNTERS_EX counters = {};
+    counters.cb = sizeof(counters);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                             sizeof(counters))) {
+        memory.workingSet = counters.WorkingSetSize;
+        memory.peakWorkingSet = counters.PeakWorkingSetSize;
+        memory.privateBytes = counters.PrivateUsage;
+        memory.peakPrivateBytes = counters.PeakPagefileUsage;
+    }
+    return memory;
+}
+
+// Label values are component names and instance names we choose; escape anyway
+static void AppendLabelValue(std::string& out, const std::string& value) {
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+std::string MemoryAccounting::FormatPrometheus() const {
+    Entries entries = Collect();
+    ProcessMemory process = GetProcessMemory();
+
+    std::string out;
+    out.reserve(2048);
+    out += "# HELP perception_memory_bytes Bytes held per component (estimates for opaque allocations)\n";
+    out += "# TYPE perception_memory_bytes gauge\n";
+
+    char value[32];
+    uint64_t attributed = 0;
+    for (const Entry& entry : entries) {
+        out += "perception_memory_bytes{component=\"";
+        out += entry.component;
+        out += "\",instance=\"";
+        AppendLabelValue(out, entry.instance);
+        std::snprintf(value, sizeof(value), "\"} %llu\n", static_cast<unsigned long long>(entry.bytes));
+        out += value;
+        attributed += entry.bytes;
+    }
+
+    uint64_t unattributed = process.privateBytes > attributed ? process.privateBytes - attributed : 0;
+    std::snprintf(value, sizeof(value), "%llu\n", static_cast<unsigned long long>(unattributed));
+    out += "perception_memory_bytes{component=\"unattributed\",instance=\"\"} ";
+    out += value;
+
+    out += "# HELP perception_process_memory_bytes Process working set and private (commit) bytes\n";
+    out += "# TYPE perception_process_memory_bytes gauge\n";
+    const std::pair<const char*, uint64_t> counters[] = {
+        { "working_set", process.workingSet },
+        { "peak_working_set", process.peakWorkingSet },
+        { "private", process.privateBytes },
+        { "peak_private", process.peakPrivateBytes },
+    };
+    char line[128];
+    for (const auto& counter : counters) {
+        std::snprintf(line, sizeof(line), "perception_process_memory_bytes{kind=\"%s\"} %llu\n",
+                      counter.first, static_cast<unsigned long long>(counter.second));
+        out += line;
+    }
+    return out;
+}
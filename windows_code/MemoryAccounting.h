@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * MemoryAccounting - Per-subsystem memory attribution, for /metrics
+ *
+ * The engine sits at 0.8-1.2 GB and the process counters alone don't say
+ * which part to trim. Each owner of a large allocation registers a reporter
+ * that lists what it holds (component + instance, bytes); a scrape collects
+ * every reporter alongside the process working set and private bytes, and
+ * reports what is private but unclaimed as "unattributed".
+ *
+ * Components:
+ *   whisper_model    weights copied out of the model file, per tier
+ *   whisper_state    decoder states (KV, mel, compute buffers), all workers
+ *   ort_session      session creation plus its probe inference, per model
+ *   audio_ring       capture rings
+ *   whisper_queue    queued and recycled utterance buffers, partial window
+ *   kv_cache         caption decoder KV banks, the prompt-prefix KV, the scene arena
+ *   vision_cache     fp16 embedding table, scene feature cache
+ *   context_json     published /context documents and their encodings
+ *   history          /history sample and event rings
+ *   vector_index     /search posting lists (the vectors themselves are file-mapped)
+ *
+ * Opaque allocations (whisper_init_state, ORT session creation) are sized
+ * with a Meter: the growth of private bytes while it is alive. Other threads
+ * allocating at the same time are counted too, so those figures are
+ * estimates; the ORT build has no allocator statistics to read instead.
+ *
+ * Usage:
+ *   MemoryAccounting::Meter meter;
+ *   state = whisper_init_state(model);
+ *   stateBytes += meter.Bytes();
+ *
+ *   reporterId = MemoryAccounting::Instance().Register([this](MemoryAccounting::Entries& entries) {
+ *       entries.push_back({ "audio_ring", "microphone", ring->Capacity() * sizeof(float) });
+ *   });
+ *   MemoryAccounting::Instance().Unregister(reporterId);   // First thing in the destructor
+ *
+ * Reporters run on the scraping thread under the registry lock, so they
+ * must only read state that is safe to read from another thread, and
+ * Unregister() waits for a running scrape before the owner goes away.
+ */
+class MemoryAccounting {
+public:
+    struct Entry {
+        const char* component;          // String literal, one of the components above
+        std::string instance;
+        uint64_t bytes;
+    };
+    using Entries = std::vector<Entry>;
+    using Reporter = std::function<void(Entries&)>;
+
+    struct ProcessMemory {
+        uint64_t workingSet = 0;
+        uint64_t peakWorkingSet = 0;
+        uint64_t privateBytes = 0;
+        uint64_t peakPrivateBytes = 0;
+    };
+
+    static MemoryAccounting& Instance();
+
+    MemoryAccounting(const MemoryAccounting&) = delete;
+    MemoryAccounting& operator=(const MemoryAccounting&) = delete;
+
+    uint64_t Register(Reporter reporter);
+    void Unregister(uint64_t id);
+
+    // Every reporter's entries, in registration order
+    Entries Collect() const;
+
+    // Prometheus text exposition format (version 0.0.4), bytes
+    std::string FormatPrometheus() const;
+
+    static ProcessMemory GetProcessMemory();
+
+    // Private bytes growth over the meter's lifetime (0 if memory was released)
+    class Meter {
+    public:
+        Meter() : start(GetProcessMemory().privateBytes) {}
+
+        uint64_t Bytes() const {
+            uint64_t now = GetProcessMemory().privateBytes;
+            return now > start ? now - start : 0;
+        }
+
+    private:
+        uint64_t start;
+    };
+
+private:
+    MemoryAccounting() = default;
+
+    mutable std::mutex reportersMutex;
+    std::map<uint64_t, Reporter> reporters;
+    uint64_t nextId = 1;
+};
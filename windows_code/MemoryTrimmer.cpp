@@ -0,0 +1,132 @@
+#include "MemoryTrimmer.h"
+#include <cstdio>
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+
+MemoryTrimmer::~MemoryTrimmer() {
+    Stop();
+}
+
+int64_t MemoryTrimmer::NowMs() {
+    return static_cast<int64_t>(GetTickCount64());
+}
+
+void MemoryTrimmer::AddSource(const char* name, ActivityProbe activity, Trim trim) {
+    auto source = std::make_unique<Source>();
+    source->name = name;
+    source->activity = std::move(activity);
+    source->trim = std::move(trim);
+    sources.push_back(std::move(source));
+}
+
+void MemoryTrimmer::Start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    // The quiet period counts from startup, not from the first activity
+    int64_t now = NowMs();
+    for (auto& source : sources) {
+        source->lastActivity = source->activity();
+        source->lastActiveMs = now;
+    }
+    thread = std::thread(&MemoryTrimmer::Run, this);
+}
+
+void MemoryTrimmer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void MemoryTrimmer::Run() {
+    TRACE_THREAD("MemoryTrimmer");
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(CHECK_MS), [this]() { return !running; });
+            if (!running) {
+                break;
+            }
+        }
+        Pass();
+    }
+}
+
+void MemoryTrimmer::Pass() {
+    int64_t now = NowMs();
+    int quietMs = quietMs_.load();
+
+    bool allTrimmed = !sources.empty();
+    for (auto& source : sources) {
+        uint64_t activity = source->activity();
+        if (activity != source->lastActivity) {
+            source->lastActivity = activity;
+            source->lastActiveMs = now;
+            source->trimmed = false;
+            workingSetTrimmed = false;
+        } else if (quietMs > 0 && !source->trimmed && now - source->lastActiveMs >= quietMs) {
+            uint64_t released = source->trim();
+            source->trimmed = true;
+            source->trims.fetch_add(1);
+            source->releasedBytes.fetch_add(released);
+            LOG_DEBUG("MemoryTrimmer", "Trimmed " << source->name << " after " << (now - source->lastActiveMs)
+                      << " ms quiet, " << (released / 1024) << " KB released");
+        }
+        allTrimmed = allTrimmed && source->trimmed;
+    }
+
+    if (!allTrimmed || workingSetTrimmed || quietMs <= 0) {
+        workingSetDue = false;
+        return;
+    }
+    // One pass late, so trims finishing on their own threads are in first
+    if (!workingSetDue) {
+        workingSetDue = true;
+        return;
+    }
+    workingSetDue = false;
+    workingSetTrimmed = true;
+
+    uint64_t before = MemoryAccounting::GetProcessMemory().workingSet;
+    if (!SetProcessWorkingSetSizeEx(GetCurrentProcess(), static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1), 0)) {
+        LOG_WARNING("MemoryTrimmer", "SetProcessWorkingSetSizeEx failed: " << GetLastError());
+        return;
+    }
+    uint64_t after = MemoryAccounting::GetProcessMemory().workingSet;
+    uint64_t released = before > after ? before - after : 0;
+    workingSetTrims.fetch_add(1);
+    workingSetReleasedBytes.fetch_add(released);
+    LOG_INFO("MemoryTrimmer", "All engines quiet; working set " << (before / (1024 * 1024)) << " MB -> "
+             << (after / (1024 * 1024)) << " MB");
+}
+
+std::string MemoryTrimmer::FormatPrometheus() const {
+    std::string out;
+    char line[256];
+    for (const auto& source : sources) {
+        std::snprintf(line, sizeof(line), "perception_memory_trims_total{source=\"%s\"} %llu\n",
+                      source->name, static_cast<unsigned long long>(source->trims.load()));
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_memory_trim_released_bytes_total{source=\"%s\"} %llu\n",
+                      source->name, static_cast<unsigned long long>(source->releasedBytes.load()));
+        out += line;
+    }
+    std::snprintf(line, sizeof(line), "perception_memory_trims_total{source=\"working_set\"} %llu\n",
+                  static_cast<unsigned long long>(workingSetTrims.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_memory_trim_released_bytes_total{source=\"working_set\"} %llu\n",
+                  static_cast<unsigned long long>(workingSetReleasedBytes.load()));
+    out += line;
+    return out;
+}
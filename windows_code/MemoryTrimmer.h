@@ -0,0 +1,102 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * MemoryTrimmer - Gives memory back after the engines have been quiet a while
+ *
+ * A burst of captions or speech grows the ORT arena, every whisper worker's
+ * state and the recycled utterance buffers to their peak, and nothing ever
+ * shrank them again. Each of those registers a source: an activity probe
+ * (a counter that moves while the source works) and a trim. Every CHECK_MS
+ * the trimmer reads the probes; a source whose counter hasn't moved for
+ * the quiet period (RuntimeConfig memory.trim_after_ms) is trimmed once,
+ * and again only after it has worked and gone quiet anew.
+ *
+ * Once every source is trimmed - the whole process quiet - the pass after
+ * (so that trims completing on their own threads, like a whisper worker
+ * freeing its state or the next VAD run shrinking the arena, are in)
+ * empties the working set with SetProcessWorkingSetSizeEx(-1, -1). It is
+ * not done while any source still works: the pages it uses would fault
+ * straight back in.
+ *
+ * Usage:
+ *   MemoryTrimmer trimmer;
+ *   trimmer.AddSource("whisper", [&] { return engine.GetSpeechActivity(); },
+ *                                [&] { return engine.TrimIdleMemory(); });
+ *   trimmer.SetQuietMs(config.memoryTrimAfterMs);
+ *   trimmer.Start();
+ *
+ * Sources are added before Start(); probes and trims run on the trimmer's
+ * thread. Thread-safe otherwise.
+ */
+class MemoryTrimmer {
+public:
+    static constexpr int CHECK_MS = 5000;
+
+    using ActivityProbe = std::function<uint64_t()>;
+    // Returns the bytes it knows it released (0: released elsewhere or unknown)
+    using Trim = std::function<uint64_t()>;
+
+    MemoryTrimmer() = default;
+    ~MemoryTrimmer();
+
+    MemoryTrimmer(const MemoryTrimmer&) = delete;
+    MemoryTrimmer& operator=(const MemoryTrimmer&) = delete;
+
+    /**
+     * @brief A source to trim after quietMs without activity (name: a string literal, for /metrics)
+     */
+    void AddSource(const char* name, ActivityProbe activity, Trim trim);
+
+    /**
+     * @brief Quiet period before a trim; 0 turns trimming off
+     */
+    void SetQuietMs(int quietMs) { quietMs_.store(quietMs); }
+
+    void Start();
+    void Stop();
+
+    /**
+     * @brief Prometheus text: trims and bytes released per source, working set trims and bytes
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    struct Source {
+        const char* name;
+        ActivityProbe activity;
+        Trim trim;
+        uint64_t lastActivity = 0;
+        int64_t lastActiveMs = 0;
+        bool trimmed = false;
+        std::atomic<uint64_t> trims{0};
+        std::atomic<uint64_t> releasedBytes{0};
+    };
+
+    void Run();
+    void Pass();
+    static int64_t NowMs();
+
+    std::vector<std::unique_ptr<Source>> sources;
+    std::atomic<int> quietMs_{0};
+    bool workingSetDue = false;             // Every source trimmed; the next pass empties the working set
+    bool workingSetTrimmed = false;         // Done since the last activity
+
+    std::atomic<uint64_t> workingSetTrims{0};
+    std::atomic<uint64_t> workingSetReleasedBytes{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+    std::thread thread;
+};
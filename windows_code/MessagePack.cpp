@@ -0,0 +1,413 @@
+#include "MessagePack.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+void AppendBigEndian(std::string& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void AppendUtf8(std::string& out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out.push_back(static_cast<char>(codepoint));
+    } else if (codepoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+}
+
+// Recursive-descent JSON reader that writes MessagePack as it goes. Container
+// headers need the element count up front, so elements are written to a
+// scratch buffer first and appended after the header.
+class JsonTranscoder {
+public:
+    explicit JsonTranscoder(std::string_view json) : json(json) {}
+
+    bool Transcode(std::string& out) {
+        if (!Value(out, 0)) {
+            return false;
+        }
+        SkipWhitespace();
+        return position == json.size();
+    }
+
+private:
+    std::string_view json;
+    size_t position = 0;
+
+    void SkipWhitespace() {
+        while (position < json.size() &&
+               (json[position] == ' ' || json[position] == '\t' || json[position] == '\n' || json[position] == '\r')) {
+            position++;
+        }
+    }
+
+    bool Consume(std::string_view literal) {
+        if (json.substr(position, literal.size()) != literal) {
+            return false;
+        }
+        position += literal.size();
+        return true;
+    }
+
+    bool Value(std::string& out, int depth) {
+        if (depth > MessagePack::MAX_DEPTH) {
+            return false;
+        }
+        SkipWhitespace();
+        if (position >= json.size()) {
+            return false;
+        }
+
+        char c = json[position];
+        if (c == '"') {
+            std::string text;
+            if (!String(text)) {
+                return false;
+            }
+            MessagePack::WriteString(out, text);
+            return true;
+        }
+        if (c == '{') {
+            return Object(out, depth);
+        }
+        if (c == '[') {
+            return Array(out, depth);
+        }
+        if (Consume("true")) {
+            MessagePack::WriteBool(out, true);
+            return true;
+        }
+        if (Consume("false")) {
+            MessagePack::WriteBool(out, false);
+            return true;
+        }
+        if (Consume("null")) {
+            MessagePack::WriteNil(out);
+            return true;
+        }
+        return Number(out);
+    }
+
+    // One or more digits; false (nothing consumed) when there are none
+    bool Digits() {
+        size_t start = position;
+        while (position < json.size() && json[position] >= '0' && json[position] <= '9') {
+            position++;
+        }
+        return position > start;
+    }
+
+    // RFC 8259: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    bool Number(std::string& out) {
+        size_t start = position;
+        bool isInteger = true;
+        Consume("-");
+        if (Consume("0")) {
+            if (position < json.size() && json[position] >= '0' && json[position] <= '9') {
+                return false;       // Leading zero
+            }
+        } else if (!Digits()) {
+            return false;
+        }
+        if (Consume(".")) {
+            isInteger = false;
+            if (!Digits()) {
+                return false;
+            }
+        }
+        if (position < json.size() && (json[position] == 'e' || json[position] == 'E')) {
+            position++;
+            isInteger = false;
+            if (!Consume("+")) {
+                Consume("-");
+            }
+            if (!Digits()) {
+                return false;
+            }
+        }
+
+        std::string text(json.substr(start, position - start));
+        char* end = nullptr;
+        // strtoll clamps out-of-range values: those past int64 go as uint64
+        // while they fit, else as a double
+        if (isInteger) {
+            errno = 0;
+            long long value = std::strtoll(text.c_str(), &end, 10);
+            if (*end == '\0' && errno != ERANGE) {
+                MessagePack::WriteInt(out, value);
+                return true;
+            }
+            if (text[0] != '-') {
+                errno = 0;
+                unsigned long long unsignedValue = std::strtoull(text.c_str(), &end, 10);
+                if (*end == '\0' && errno != ERANGE) {
+                    MessagePack::WriteUInt(out, unsignedValue);
+                    return true;
+                }
+            }
+        }
+        double value = std::strtod(text.c_str(), &end);
+        if (*end != '\0') {
+            return false;
+        }
+        MessagePack::WriteDouble(out, value);
+        return true;
+    }
+
+    bool Hex4(uint32_t& value) {
+        if (position + 4 > json.size()) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = json[position++];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool String(std::string& text) {
+        position++;     // Opening quote
+        while (position < json.size()) {
+            char c = json[position++];
+            if (c == '"') {
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) {
+                return false;
+            }
+            if (c != '\\') {
+                text.push_back(c);
+                continue;
+            }
+            if (position >= json.size()) {
+                return false;
+            }
+            char escape = json[position++];
+            switch (escape) {
+                case '"': text.push_back('"'); break;
+                case '\\': text.push_back('\\'); break;
+                case '/': text.push_back('/'); break;
+                case 'b': text.push_back('\b'); break;
+                case 'f': text.push_back('\f'); break;
+                case 'n': text.push_back('\n'); break;
+                case 'r': text.push_back('\r'); break;
+                case 't': text.push_back('\t'); break;
+                case 'u': {
+                    uint32_t codepoint = 0;
+                    if (!Hex4(codepoint)) {
+                        return false;
+                    }
+                    // Surrogate pair: a high half must be followed by "\uDC00".."\uDFFF".
+                    // A lone half has no UTF-8 form, and a str must be valid UTF-8
+                    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                        return false;
+                    }
+                    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                        uint32_t low = 0;
+                        if (!Consume("\\u") || !Hex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                            return false;
+                        }
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(text, codepoint);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool Array(std::string& out, int depth) {
+        position++;     // '['
+        std::string elements;
+        uint32_t count = 0;
+        SkipWhitespace();
+        if (position < json.size() && json[position] == ']') {
+            position++;
+        } else {
+            while (true) {
+                if (!Value(elements, depth + 1)) {
+                    return false;
+                }
+                count++;
+                SkipWhitespace();
+                if (position < json.size() && json[position] == ',') {
+                    position++;
+                    continue;
+                }
+                if (position < json.size() && json[position] == ']') {
+                    position++;
+                    break;
+                }
+                return false;
+            }
+        }
+        MessagePack::WriteArrayHeader(out, count);
+        out += elements;
+        return true;
+    }
+
+    bool Object(std::string& out, int depth) {
+        position++;     // '{'
+        std::string members;
+        uint32_t count = 0;
+        SkipWhitespace();
+        if (position < json.size() && json[position] == '}') {
+            position++;
+        } else {
+            while (true) {
+                SkipWhitespace();
+                std::string key;
+                if (position >= json.size() || json[position] != '"' || !String(key)) {
+                    return false;
+                }
+                SkipWhitespace();
+                if (position >= json.size() || json[position++] != ':') {
+                    return false;
+                }
+                MessagePack::WriteString(members, key);
+                if (!Value(members, depth + 1)) {
+                    return false;
+                }
+                count++;
+                SkipWhitespace();
+                if (position < json.size() && json[position] == ',') {
+                    position++;
+                    continue;
+                }
+                if (position < json.size() && json[position] == '}') {
+                    position++;
+                    break;
+                }
+                return false;
+            }
+        }
+        MessagePack::WriteMapHeader(out, count);
+        out += members;
+        return true;
+    }
+};
+
+} // namespace
+
+void MessagePack::WriteNil(std::string& out) {
+    out.push_back(static_cast<char>(0xC0));
+}
+
+void MessagePack::WriteBool(std::string& out, bool value) {
+    out.push_back(static_cast<char>(value ? 0xC3 : 0xC2));
+}
+
+void MessagePack::WriteInt(std::string& out, int64_t value) {
+    if (value >= 0) {
+        WriteUInt(out, static_cast<uint64_t>(value));
+        return;
+    }
+
+    if (value >= -32) {
+        out.push_back(static_cast<char>(value));                        // negative fixint
+    } else if (value >= INT8_MIN) {
+        out.push_back(static_cast<char>(0xD0));
+        AppendBigEndian(out, static_cast<uint64_t>(value), 1);
+    } else if (value >= INT16_MIN) {
+        out.push_back(static_cast<char>(0xD1));
+        AppendBigEndian(out, static_cast<uint64_t>(value), 2);
+    } else if (value >= INT32_MIN) {
+        out.push_back(static_cast<char>(0xD2));
+        AppendBigEndian(out, static_cast<uint64_t>(value), 4);
+    } else {
+        out.push_back(static_cast<char>(0xD3));
+        AppendBigEndian(out, static_cast<uint64_t>(value), 8);
+    }
+}
+
+void MessagePack::WriteUInt(std::string& out, uint64_t value) {
+    if (value < 0x80) {
+        out.push_back(static_cast<char>(value));                        // positive fixint
+    } else if (value <= 0xFF) {
+        out.push_back(static_cast<char>(0xCC));
+        AppendBigEndian(out, value, 1);
+    } else if (value <= 0xFFFF) {
+        out.push_back(static_cast<char>(0xCD));
+        AppendBigEndian(out, value, 2);
+    } else if (value <= 0xFFFFFFFFull) {
+        out.push_back(static_cast<char>(0xCE));
+        AppendBigEndian(out, value, 4);
+    } else {
+        out.push_back(static_cast<char>(0xCF));
+        AppendBigEndian(out, value, 8);
+    }
+}
+
+void MessagePack::WriteDouble(std::string& out, double value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out.push_back(static_cast<char>(0xCB));
+    AppendBigEndian(out, bits, 8);
+}
+
+void MessagePack::WriteString(std::string& out, std::string_view value) {
+    size_t size = value.size();
+    if (size < 32) {
+        out.push_back(static_cast<char>(0xA0 | size));                  // fixstr
+    } else if (size <= 0xFF) {
+        out.push_back(static_cast<char>(0xD9));
+        AppendBigEndian(out, size, 1);
+    } else if (size <= 0xFFFF) {
+        out.push_back(static_cast<char>(0xDA));
+        AppendBigEndian(out, size, 2);
+    } else {
+        out.push_back(static_cast<char>(0xDB));
+        AppendBigEndian(out, size, 4);
+    }
+    out.append(value.data(), value.size());
+}
+
+void MessagePack::WriteArrayHeader(std::string& out, uint32_t count) {
+    if (count < 16) {
+        out.push_back(static_cast<char>(0x90 | count));                 // fixarray
+    } else if (count <= 0xFFFF) {
+        out.push_back(static_cast<char>(0xDC));
+        AppendBigEndian(out, count, 2);
+    } else {
+        out.push_back(static_cast<char>(0xDD));
+        AppendBigEndian(out, count, 4);
+    }
+}
+
+void MessagePack::WriteMapHeader(std::string& out, uint32_t count) {
+    if (count < 16) {
+        out.push_back(static_cast<char>(0x80 | count));                 // fixmap
+    } else if (count <= 0xFFFF) {
+        out.push_back(static_cast<char>(0xDE));
+        AppendBigEndian(out, count, 2);
+    } else {
+        out.push_back(static_cast<char>(0xDF));
+        AppendBigEndian(out, count, 4);
+    }
+}
+
+bool MessagePack::TranscodeJson(std::string& out, std::string_view json) {
+    return JsonTranscoder(json).Transcode(out);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * MessagePack - Minimal MessagePack encoder for machine consumers of /context
+ *
+ * Appends values in the smallest MessagePack form (fixint/fixstr/fixmap and
+ * up) to a caller-owned buffer. Strings are written as length-prefixed raw
+ * UTF-8, so readers can take views into the received buffer instead of
+ * unescaping and copying the way a JSON parser must.
+ *
+ * TranscodeJson() converts one JSON value (as the Json class serializes raw
+ * values: numbers, booleans, null, arrays, objects) into MessagePack.
+ *
+ * Usage:
+ *   std::string out;
+ *   MessagePack::WriteMapHeader(out, 2);
+ *   MessagePack::WriteString(out, "app");    MessagePack::WriteString(out, "Code.exe");
+ *   MessagePack::WriteString(out, "recent"); MessagePack::TranscodeJson(out, "[\"a\",\"b\"]");
+ */
+class MessagePack {
+public:
+    static constexpr int MAX_DEPTH = 32;
+
+    static void WriteNil(std::string& out);
+    static void WriteBool(std::string& out, bool value);
+    static void WriteInt(std::string& out, int64_t value);
+    static void WriteUInt(std::string& out, uint64_t value);
+    static void WriteDouble(std::string& out, double value);
+    static void WriteString(std::string& out, std::string_view value);
+    static void WriteArrayHeader(std::string& out, uint32_t count);
+    static void WriteMapHeader(std::string& out, uint32_t count);
+
+    /**
+     * @brief Append the MessagePack form of a single JSON value
+     * @return false on malformed JSON (out is left with partial output)
+     */
+    static bool TranscodeJson(std::string& out, std::string_view json);
+};
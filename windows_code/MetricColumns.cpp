@@ -0,0 +1,391 @@
+#include "MetricColumns.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define METRIC_COLUMNS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Both for value != 0
+int LeadingZeros(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(value);
+#endif
+}
+
+int TrailingZeros(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+uint64_t ToBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double FromBits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+}  // namespace
+
+void MetricColumns::Aggregate::Merge(const Aggregate& other) {
+    if (other.count == 0) {
+        return;
+    }
+    min = (std::min)(min, other.min);
+    max = (std::max)(max, other.max);
+    sum += other.sum;
+    last = other.last;
+    count += other.count;
+}
+
+MetricColumns::MetricColumns(size_t columnCount, size_t maxRows)
+    : columnCount((std::min)(columnCount, MAX_COLUMNS))
+    , maxRows(maxRows)
+    , rowCount(0)
+    , previousDelta(0)
+{
+}
+
+size_t MetricColumns::GetMemoryUsage() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks) {
+        bytes += sizeof(Block) + block.times.words.capacity() * sizeof(uint64_t) +
+                 block.values.capacity() * sizeof(Stream) + block.summary.capacity() * sizeof(Aggregate);
+        for (const Stream& stream : block.values) {
+            bytes += stream.words.capacity() * sizeof(uint64_t);
+        }
+    }
+    return bytes;
+}
+
+// ============================================================================
+// Bit streams
+// ============================================================================
+
+void MetricColumns::Stream::Write(uint64_t value, int count) {
+    if (count < 64) {
+        value &= (uint64_t(1) << count) - 1;
+    }
+    int offset = static_cast<int>(bits % 64);
+    if (offset == 0) {
+        words.push_back(0);
+    }
+    int room = 64 - offset;
+    if (count <= room) {
+        words.back() |= value << (room - count);
+    } else {
+        words.back() |= value >> (count - room);
+        words.push_back(value << (64 - (count - room)));
+    }
+    bits += count;
+}
+
+uint64_t MetricColumns::Reader::Read(int count) {
+    size_t word = position / 64;
+    int offset = static_cast<int>(position % 64);
+    int room = 64 - offset;
+    position += count;
+    // The word's unread bits, moved to the top
+    uint64_t high = words[word] << offset;
+    if (count <= room) {
+        return high >> (64 - count);
+    }
+    return (high >> (64 - count)) | (words[word + 1] >> (64 - (count - room)));
+}
+
+// ============================================================================
+// Encoding
+// ============================================================================
+
+bool MetricColumns::Append(int64_t timeMs, const double* values) {
+    if (!blocks.empty() && timeMs < blocks.back().lastMs) {
+        return false;
+    }
+
+    bool first = blocks.empty() || blocks.back().rows == BLOCK_ROWS;
+    if (first) {
+        if (!blocks.empty()) {
+            Block& sealed = blocks.back();
+            sealed.times.words.shrink_to_fit();
+            for (Stream& stream : sealed.values) {
+                stream.words.shrink_to_fit();
+            }
+        }
+        blocks.emplace_back();
+        Block& block = blocks.back();
+        block.firstMs = timeMs;
+        block.values.resize(columnCount);
+        block.summary.resize(columnCount);
+        previousDelta = 0;
+    }
+
+    Block& block = blocks.back();
+    if (!first) {
+        EncodeTime(block, timeMs);
+    }
+    for (size_t column = 0; column < columnCount; ++column) {
+        double value = values[column];
+        // One NaN bit pattern, so runs of "no reading" XOR to zero
+        if (std::isnan(value)) {
+            value = std::numeric_limits<double>::quiet_NaN();
+        }
+        uint64_t bits = ToBits(value);
+        if (first) {
+            block.values[column].Write(bits, 64);
+            valueStates[column] = ValueState{ bits };
+        } else {
+            EncodeValue(block.values[column], valueStates[column], bits);
+        }
+
+        if (!std::isnan(value)) {
+            Aggregate& summary = block.summary[column];
+            summary.min = (std::min)(summary.min, value);
+            summary.max = (std::max)(summary.max, value);
+            summary.sum += value;
+            summary.last = value;
+            summary.count++;
+        }
+    }
+    block.lastMs = timeMs;
+    block.rows++;
+    rowCount++;
+
+    while (blocks.size() > 1 && rowCount - blocks.front().rows >= maxRows) {
+        rowCount -= blocks.front().rows;
+        blocks.pop_front();
+    }
+    return true;
+}
+
+void MetricColumns::EncodeTime(Block& block, int64_t timeMs) {
+    int64_t delta = timeMs - block.lastMs;
+    int64_t deltaOfDelta = delta - previousDelta;
+    previousDelta = delta;
+
+    Stream& stream = block.times;
+    if (deltaOfDelta == 0) {
+        stream.Write(0, 1);
+    } else if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+        stream.Write(0b10, 2);
+        stream.Write(static_cast<uint64_t>(deltaOfDelta + 63), 7);
+    } else if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+        stream.Write(0b110, 3);
+        stream.Write(static_cast<uint64_t>(deltaOfDelta + 255), 9);
+    } else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+        stream.Write(0b1110, 4);
+        stream.Write(static_cast<uint64_t>(deltaOfDelta + 2047), 12);
+    } else {
+        stream.Write(0b1111, 4);
+        stream.Write(static_cast<uint64_t>(deltaOfDelta), 64);
+    }
+}
+
+void MetricColumns::EncodeValue(Stream& stream, ValueState& state, uint64_t bits) {
+    uint64_t difference = bits ^ state.previous;
+    state.previous = bits;
+    if (difference == 0) {
+        stream.Write(0, 1);
+        return;
+    }
+    stream.Write(1, 1);
+
+    int leading = (std::min)(LeadingZeros(difference), 31);
+    int trailing = TrailingZeros(difference);
+    if (state.leading >= 0 && leading >= state.leading && trailing >= state.trailing) {
+        // Inside the previous window
+        stream.Write(0, 1);
+        stream.Write(difference >> state.trailing, 64 - state.leading - state.trailing);
+        return;
+    }
+    int significant = 64 - leading - trailing;
+    stream.Write(1, 1);
+    stream.Write(static_cast<uint64_t>(leading), 5);
+    stream.Write(static_cast<uint64_t>(significant - 1), 6);
+    stream.Write(difference >> trailing, significant);
+    state.leading = leading;
+    state.trailing = trailing;
+}
+
+// ============================================================================
+// Decoding and queries
+// ============================================================================
+
+void MetricColumns::DecodeTimes(const Block& block, int64_t* times) {
+    Reader reader(block.times);
+    int64_t time = block.firstMs;
+    int64_t delta = 0;
+    times[0] = time;
+    for (uint32_t row = 1; row < block.rows; ++row) {
+        int64_t deltaOfDelta;
+        if (!reader.ReadBit()) {
+            deltaOfDelta = 0;
+        } else if (!reader.ReadBit()) {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(7)) - 63;
+        } else if (!reader.ReadBit()) {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(9)) - 255;
+        } else if (!reader.ReadBit()) {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(12)) - 2047;
+        } else {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(64));
+        }
+        delta += deltaOfDelta;
+        time += delta;
+        times[row] = time;
+    }
+}
+
+void MetricColumns::DecodeValues(const Block& block, size_t column, double* values) {
+    Reader reader(block.values[column]);
+    uint64_t previous = reader.Read(64);
+    int leading = 0;
+    int trailing = 0;
+    values[0] = FromBits(previous);
+    for (uint32_t row = 1; row < block.rows; ++row) {
+        if (reader.ReadBit()) {
+            if (reader.ReadBit()) {
+                leading = static_cast<int>(reader.Read(5));
+                int significant = static_cast<int>(reader.Read(6)) + 1;
+                trailing = 64 - leading - significant;
+            }
+            previous ^= reader.Read(64 - leading - trailing) << trailing;
+        }
+        values[row] = FromBits(previous);
+    }
+}
+
+void MetricColumns::Reduce(const double* values, size_t count, Aggregate& aggregate) {
+    const double infinity = (std::numeric_limits<double>::infinity)();
+    double low = infinity;
+    double high = -infinity;
+    double sum = 0.0;
+    uint32_t counted = 0;
+    size_t i = 0;
+#ifdef METRIC_COLUMNS_X86
+    static const uint32_t BITS[4] = { 0, 1, 1, 2 };
+    const __m128d positive = _mm_set1_pd(infinity);
+    const __m128d negative = _mm_set1_pd(-infinity);
+    __m128d lows = positive;
+    __m128d highs = negative;
+    __m128d sums = _mm_setzero_pd();
+    // NaN lanes become +inf for min, -inf for max and 0 for the sum
+    for (; i + 2 <= count; i += 2) {
+        __m128d value = _mm_loadu_pd(values + i);
+        __m128d valid = _mm_cmpord_pd(value, value);
+        __m128d kept = _mm_and_pd(valid, value);
+        lows = _mm_min_pd(lows, _mm_or_pd(kept, _mm_andnot_pd(valid, positive)));
+        highs = _mm_max_pd(highs, _mm_or_pd(kept, _mm_andnot_pd(valid, negative)));
+        sums = _mm_add_pd(sums, kept);
+        counted += BITS[_mm_movemask_pd(valid)];
+    }
+    low = (std::min)(_mm_cvtsd_f64(lows), _mm_cvtsd_f64(_mm_unpackhi_pd(lows, lows)));
+    high = (std::max)(_mm_cvtsd_f64(highs), _mm_cvtsd_f64(_mm_unpackhi_pd(highs, highs)));
+    sum = _mm_cvtsd_f64(sums) + _mm_cvtsd_f64(_mm_unpackhi_pd(sums, sums));
+#endif
+    for (; i < count; ++i) {
+        double value = values[i];
+        if (value == value) {
+            low = (std::min)(low, value);
+            high = (std::max)(high, value);
+            sum += value;
+            counted++;
+        }
+    }
+    if (counted == 0) {
+        return;
+    }
+
+    Aggregate run;
+    run.min = low;
+    run.max = high;
+    run.sum = sum;
+    run.count = counted;
+    for (size_t j = count; j > 0; --j) {
+        if (values[j - 1] == values[j - 1]) {
+            run.last = values[j - 1];
+            break;
+        }
+    }
+    aggregate.Merge(run);
+}
+
+void MetricColumns::Downsample(int64_t fromMs, int64_t toMs, int64_t bucketMs, std::vector<Bucket>& buckets,
+                               uint32_t columnMask) const {
+    buckets.clear();
+    if (bucketMs <= 0 || toMs < fromMs) {
+        return;
+    }
+    auto bucketStart = [&](int64_t timeMs) { return fromMs + (timeMs - fromMs) / bucketMs * bucketMs; };
+    auto bucketAt = [&](int64_t startMs) -> Bucket& {
+        if (buckets.empty() || buckets.back().startMs != startMs) {
+            buckets.emplace_back();
+            buckets.back().startMs = startMs;
+        }
+        return buckets.back();
+    };
+
+    std::vector<int64_t> times;
+    std::vector<double> values;
+
+    auto block = std::partition_point(blocks.begin(), blocks.end(),
+                                      [fromMs](const Block& candidate) { return candidate.lastMs < fromMs; });
+    for (; block != blocks.end() && block->firstMs <= toMs; ++block) {
+        // Wholly inside one bucket: the summary is the answer
+        if (block->firstMs >= fromMs && block->lastMs <= toMs &&
+            bucketStart(block->firstMs) == bucketStart(block->lastMs)) {
+            Bucket& bucket = bucketAt(bucketStart(block->firstMs));
+            bucket.rows += block->rows;
+            for (size_t column = 0; column < columnCount; ++column) {
+                if (columnMask & (1u << column)) {
+                    bucket.columns[column].Merge(block->summary[column]);
+                }
+            }
+            continue;
+        }
+
+        times.resize(block->rows);
+        values.resize(static_cast<size_t>(block->rows) * columnCount);
+        DecodeTimes(*block, times.data());
+        for (size_t column = 0; column < columnCount; ++column) {
+            if (columnMask & (1u << column)) {
+                DecodeValues(*block, column, values.data() + column * block->rows);
+            }
+        }
+
+        size_t row = std::lower_bound(times.begin(), times.end(), fromMs) - times.begin();
+        size_t end = std::upper_bound(times.begin(), times.end(), toMs) - times.begin();
+        while (row < end) {
+            int64_t startMs = bucketStart(times[row]);
+            size_t next = std::lower_bound(times.begin() + row, times.begin() + end, startMs + bucketMs) - times.begin();
+            Bucket& bucket = bucketAt(startMs);
+            bucket.rows += static_cast<uint32_t>(next - row);
+            for (size_t column = 0; column < columnCount; ++column) {
+                if (columnMask & (1u << column)) {
+                    Reduce(values.data() + column * block->rows + row, next - row, bucket.columns[column]);
+                }
+            }
+            row = next;
+        }
+    }
+}
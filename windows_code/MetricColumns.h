@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <vector>
+
+/**
+ * MetricColumns - Gorilla-compressed numeric time series, column by column
+ *
+ * Rows of one timestamp and up to MAX_COLUMNS double values are appended in
+ * time order and packed into blocks of BLOCK_ROWS rows, every column its own
+ * bit stream, so a query decodes only what it reads:
+ *
+ *   Times    Delta of delta (as in Facebook's Gorilla): a steady 1 Hz series
+ *            costs one bit a row, timer jitter within +-63 ms nine
+ *   Values   XOR with the previous value: an unchanged value (or a run of
+ *            "no reading") is one bit, a changed one its meaningful bits,
+ *            usually within the previous value's window of leading and
+ *            trailing zeros. Values rounded to float keep 29 zero low bits
+ *
+ * Every block keeps a summary - first and last time, and per column min,
+ * max, sum, count and last value - so a block that falls inside one bucket
+ * of a downsampled query is never decoded. A full block is sealed (its
+ * streams trimmed to size); the oldest block is dropped once the rest still
+ * hold maxRows.
+ *
+ * Downsample() decodes a block's rows into flat time and value arrays and
+ * reduces each bucket's run of them with a branch-free kernel (SSE2 where
+ * the target has it), skipping NaN ("no reading") values.
+ *
+ * Usage:
+ *   MetricColumns columns(2, 7 * 24 * 3600);
+ *   double row[2] = { cpu, std::numeric_limits<double>::quiet_NaN() };
+ *   columns.Append(timeMs, row);
+ *   columns.Downsample(fromMs, toMs, bucketMs, buckets);
+ *
+ * Not thread-safe.
+ */
+class MetricColumns {
+public:
+    static constexpr size_t BLOCK_ROWS = 1024;
+    static constexpr size_t MAX_COLUMNS = 8;
+
+    // One column over some rows; NaN values are not counted
+    struct Aggregate {
+        double min = (std::numeric_limits<double>::infinity)();
+        double max = -(std::numeric_limits<double>::infinity)();
+        double sum = 0.0;
+        double last = 0.0;              // Latest counted value
+        uint32_t count = 0;
+
+        // `other` covers later rows
+        void Merge(const Aggregate& other);
+        double Mean() const { return count > 0 ? sum / count : 0.0; }
+    };
+
+    struct Bucket {
+        int64_t startMs = 0;
+        uint32_t rows = 0;
+        Aggregate columns[MAX_COLUMNS];
+    };
+
+    MetricColumns(size_t columnCount, size_t maxRows);
+
+    // `values` holds columnCount values, NaN for no reading. False (nothing
+    // stored) if timeMs is before the last row's
+    bool Append(int64_t timeMs, const double* values);
+
+    // The rows in [fromMs, toMs] in buckets of bucketMs from fromMs, oldest
+    // first; empty buckets are left out. Only the columns in columnMask (bit
+    // n: column n) are aggregated
+    void Downsample(int64_t fromMs, int64_t toMs, int64_t bucketMs, std::vector<Bucket>& buckets,
+                    uint32_t columnMask = ~0u) const;
+
+    size_t ColumnCount() const { return columnCount; }
+    size_t Size() const { return rowCount; }
+    bool Empty() const { return rowCount == 0; }
+    int64_t LastTimeMs() const { return blocks.empty() ? 0 : blocks.back().lastMs; }
+
+    // Blocks, their streams and summaries
+    size_t GetMemoryUsage() const;
+
+private:
+    // Bits, most significant first
+    struct Stream {
+        std::vector<uint64_t> words;
+        size_t bits = 0;
+
+        void Write(uint64_t value, int count);
+    };
+
+    class Reader {
+    public:
+        explicit Reader(const Stream& stream) : words(stream.words.data()), position(0) {}
+        uint64_t Read(int count);
+        bool ReadBit() { return Read(1) != 0; }
+
+    private:
+        const uint64_t* words;
+        size_t position;
+    };
+
+    struct Block {
+        int64_t firstMs = 0;
+        int64_t lastMs = 0;
+        uint32_t rows = 0;
+        Stream times;
+        std::vector<Stream> values;     // Per column
+        std::vector<Aggregate> summary; // Per column
+    };
+
+    // XOR encoder state of the open block's column
+    struct ValueState {
+        uint64_t previous = 0;
+        int leading = -1;               // -1: no window yet
+        int trailing = 0;
+    };
+
+    void EncodeTime(Block& block, int64_t timeMs);
+    void EncodeValue(Stream& stream, ValueState& state, uint64_t bits);
+    static void DecodeTimes(const Block& block, int64_t* times);
+    static void DecodeValues(const Block& block, size_t column, double* values);
+    // Aggregate of values[0, count)
+    static void Reduce(const double* values, size_t count, Aggregate& aggregate);
+
+    size_t columnCount;
+    size_t maxRows;
+    std::deque<Block> blocks;           // Oldest first; the last one is open until full
+    size_t rowCount;
+
+    // The open block's encoder state
+    int64_t previousDelta;
+    ValueState valueStates[MAX_COLUMNS];
+};
@@ -0,0 +1,298 @@
+#include "ModelVariants.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <windows.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const COMPONENT_NAMES[] = { "vision_encoder", "embed_tokens", "decoder" };
+const char* const PRECISION_NAMES[] = { "fp32", "fp16", "int8", "q4", "q4f16" };
+
+// File name stems of each model in the ONNX export
+const char* const COMPONENT_BASES[] = { "vision_encoder", "embed_tokens", "decoder_model_merged" };
+
+using Precision = ModelVariants::Precision;
+
+// Fastest first. VNNI runs int8 MatMuls as 4-way dot products; without it the
+// 4-bit kernels (AVX2) win on memory traffic. fp16 weights are cast back to
+// fp32 at every node on CPU, so they come last there and first on a GPU.
+const Precision RANK_VNNI[] = { Precision::Int8, Precision::Q4, Precision::Q4F16, Precision::Fp32, Precision::Fp16 };
+const Precision RANK_AVX2[] = { Precision::Q4, Precision::Q4F16, Precision::Int8, Precision::Fp32, Precision::Fp16 };
+const Precision RANK_BASELINE[] = { Precision::Int8, Precision::Fp32, Precision::Q4, Precision::Q4F16, Precision::Fp16 };
+const Precision RANK_GPU[] = { Precision::Fp16, Precision::Q4F16, Precision::Fp32, Precision::Q4, Precision::Int8 };
+
+uint64_t AvailablePhysicalMemory() {
+    MEMORYSTATUSEX status = {};
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? status.ullAvailPhys : 0;
+}
+
+} // namespace
+
+ModelVariants::CpuFeatures ModelVariants::DetectCpu() {
+    CpuFeatures features;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4] = {};
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    features.f16c = (info[2] & (1 << 29)) != 0;
+    if (!osxsave || !avx || maxLeaf < 7) {
+        return features;
+    }
+
+    // The OS must save YMM (and for AVX-512, opmask/ZMM) state
+    unsigned long long xcr0 = _xgetbv(0);
+    bool ymm = (xcr0 & 0x6) == 0x6;
+    bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+    __cpuidex(info, 7, 0);
+    features.avx2 = ymm && (info[1] & (1 << 5)) != 0;
+    features.avx512f = zmm && (info[1] & (1 << 16)) != 0;
+    features.avx512Vnni = features.avx512f && (info[2] & (1 << 11)) != 0;
+
+    __cpuidex(info, 7, 1);
+    features.avxVnni = ymm && (info[0] & (1 << 4)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.f16c = __builtin_cpu_supports("f16c");
+    features.avx512f = __builtin_cpu_supports("avx512f");
+    features.avx512Vnni = __builtin_cpu_supports("avx512vnni");
+#endif
+    return features;
+}
+
+std::string ModelVariants::DescribeCpu(const CpuFeatures& features) {
+    std::string text;
+    auto add = [&text](bool present, const char* name) {
+        if (present) {
+            text += (text.empty() ? "" : "+");
+            text += name;
+        }
+    };
+    add(features.avx2, "avx2");
+    add(features.f16c, "f16c");
+    add(features.avx512f, "avx512f");
+    add(features.avx512Vnni, "avx512vnni");
+    add(features.avxVnni, "avxvnni");
+    return text.empty() ? "baseline" : text;
+}
+
+const char* ModelVariants::Name(Component component) {
+    return COMPONENT_NAMES[static_cast<int>(component)];
+}
+
+const char* ModelVariants::Name(Precision precision) {
+    return PRECISION_NAMES[static_cast<int>(precision)];
+}
+
+bool ModelVariants::ParsePrecision(const std::string& name, Precision& precision) {
+    for (int i = 0; i < static_cast<int>(Precision::Count); ++i) {
+        if (name == PRECISION_NAMES[i]) {
+            precision = static_cast<Precision>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ModelVariants::AddVariant(Component component, Precision precision, const std::string& fileName) {
+    std::error_code ec;
+    fs::path path = fs::path(directory) / fileName;
+    uint64_t bytes = fs::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+    auto& list = variants[static_cast<int>(component)];
+    bool known = std::any_of(list.begin(), list.end(),
+                             [precision](const Variant& variant) { return variant.precision == precision; });
+    if (!known) {
+        list.push_back({ precision, path.string(), bytes });
+    }
+}
+
+bool ModelVariants::LoadManifest() {
+    std::ifstream file(fs::path(directory) / "variants.json", std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+
+    JsonValue manifest = JsonReader::Parse(text);
+    if (!manifest.IsObject()) {
+        LOG_WARNING("ModelVariants", "Ignoring malformed " << directory << "/variants.json");
+        return false;
+    }
+
+    std::string scratch;
+    for (int c = 0; c < static_cast<int>(Component::Count); ++c) {
+        JsonValue files = manifest[COMPONENT_NAMES[c]];
+        for (int p = 0; p < static_cast<int>(Precision::Count); ++p) {
+            std::string_view fileName = files[PRECISION_NAMES[p]].AsString(scratch);
+            if (!fileName.empty()) {
+                AddVariant(static_cast<Component>(c), static_cast<Precision>(p), std::string(fileName));
+            }
+        }
+    }
+    return true;
+}
+
+void ModelVariants::Discover(const std::string& onnxDirectory) {
+    directory = onnxDirectory;
+    for (auto& list : variants) {
+        list.clear();
+    }
+
+    if (!LoadManifest()) {
+        static const char* const SUFFIXES[] = { "", "_fp16", "_int8", "_q4", "_q4f16" };
+        // Hand-simplified encoder graph first: it stands in for the fp32 export
+        AddVariant(Component::VisionEncoder, Precision::Fp32, "vision_encoder_simplified.onnx");
+        for (int c = 0; c < static_cast<int>(Component::Count); ++c) {
+            for (int p = 0; p < static_cast<int>(Precision::Count); ++p) {
+                AddVariant(static_cast<Component>(c), static_cast<Precision>(p),
+                           std::string(COMPONENT_BASES[c]) + SUFFIXES[p] + ".onnx");
+            }
+            AddVariant(static_cast<Component>(c), Precision::Int8, std::string(COMPONENT_BASES[c]) + "_quantized.onnx");
+        }
+    }
+
+    for (int c = 0; c < static_cast<int>(Component::Count); ++c) {
+        std::string found;
+        for (const Variant& variant : variants[c]) {
+            found += (found.empty() ? "" : ", ") + std::string(Name(variant.precision));
+        }
+        LOG_DEBUG("ModelVariants", COMPONENT_NAMES[c] << ": " << (found.empty() ? "none" : found));
+    }
+}
+
+std::vector<ModelVariants::Variant> ModelVariants::Rank(Component component, bool gpuProvider) const {
+    const Precision* order = RANK_BASELINE;
+    if (gpuProvider) {
+        order = RANK_GPU;
+    } else {
+        CpuFeatures cpu = DetectCpu();
+        if (cpu.avx512Vnni || cpu.avxVnni) {
+            order = RANK_VNNI;
+        } else if (cpu.avx2) {
+            order = RANK_AVX2;
+        }
+    }
+
+    const auto& list = variants[static_cast<int>(component)];
+    std::vector<Variant> ranked;
+    for (int i = 0; i < static_cast<int>(Precision::Count); ++i) {
+        for (const Variant& variant : list) {
+            if (variant.precision == order[i]) {
+                ranked.push_back(variant);
+            }
+        }
+    }
+
+    // Drop variants that would crowd out everything else; keep the smallest if none fit
+    uint64_t available = AvailablePhysicalMemory();
+    if (available > 0 && !ranked.empty()) {
+        uint64_t limit = static_cast<uint64_t>(available * MAX_MEMORY_FRACTION);
+        auto smallest = *std::min_element(ranked.begin(), ranked.end(),
+                                          [](const Variant& a, const Variant& b) { return a.bytes < b.bytes; });
+        ranked.erase(std::remove_if(ranked.begin(), ranked.end(),
+                                    [limit](const Variant& variant) { return variant.bytes > limit; }),
+                     ranked.end());
+        if (ranked.empty()) {
+            LOG_WARNING("ModelVariants", Name(component) << ": no variant fits in " << (limit >> 20)
+                        << " MB, using the smallest (" << Name(smallest.precision) << ")");
+            ranked.push_back(smallest);
+        }
+    }
+    return ranked;
+}
+
+const ModelVariants::Variant* ModelVariants::Find(Component component, Precision precision) const {
+    for (const Variant& variant : variants[static_cast<int>(component)]) {
+        if (variant.precision == precision) {
+            return &variant;
+        }
+    }
+    return nullptr;
+}
+
+void ModelVariants::LoadSelection(const std::string& key) {
+    machineKey = key;
+    std::fill(std::begin(selection), std::end(selection), -1);
+
+    std::ifstream file(fs::path(directory) / "variants.selected.json", std::ios::binary);
+    if (!file) {
+        return;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+
+    JsonValue saved = JsonReader::Parse(text);
+    std::string scratch;
+    if (saved["machine"].AsString(scratch) != machineKey) {
+        LOG_INFO("ModelVariants", "Saved variant choice is for another CPU or provider set, timing again");
+        return;
+    }
+    for (int c = 0; c < static_cast<int>(Component::Count); ++c) {
+        Precision precision;
+        if (ParsePrecision(std::string(saved[COMPONENT_NAMES[c]].AsString(scratch)), precision)) {
+            selection[c] = static_cast<int>(precision);
+        }
+    }
+}
+
+bool ModelVariants::GetSelection(Component component, Precision& precision) const {
+    int index = selection[static_cast<int>(component)];
+    if (index < 0) {
+        return false;
+    }
+    precision = static_cast<Precision>(index);
+    return true;
+}
+
+void ModelVariants::SetSelection(Component component, Precision precision) {
+    selection[static_cast<int>(component)] = static_cast<int>(precision);
+}
+
+bool ModelVariants::SaveSelection() const {
+    std::string text;
+    JsonWriter writer(text);
+    writer.BeginObject();
+    writer.Key("machine").String(machineKey);
+    for (int c = 0; c < static_cast<int>(Component::Count); ++c) {
+        if (selection[c] >= 0) {
+            writer.Key(COMPONENT_NAMES[c]).String(PRECISION_NAMES[selection[c]]);
+        }
+    }
+    writer.EndObject();
+
+    // Temp file + rename, so a concurrent reader never sees half a file
+    fs::path path = fs::path(directory) / "variants.selected.json";
+    fs::path temp = path;
+    temp += ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file << text << '\n';
+        if (!file) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    return !ec;
+}
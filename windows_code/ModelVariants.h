@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * ModelVariants - Which weight precision of each FastVLM model to load
+ *
+ * FastVLM exports ship every model in several precisions (fp32, fp16, int8,
+ * q4, q4f16); which one is fastest depends on the CPU. int8 MatMuls run on
+ * VNNI (AVX512-VNNI / AVX-VNNI) dot-product instructions, 4-bit MatMulNBits
+ * kernels want AVX2, and fp16 weights only pay off on a GPU provider (on CPU
+ * they are cast back to fp32 at every node).
+ *
+ * Manifest: <onnx dir>/variants.json, when present, names the files:
+ *   { "vision_encoder": { "fp32": "vision_encoder_simplified.onnx", "int8": "..." },
+ *     "embed_tokens":   { "q4f16": "embed_tokens_q4f16.onnx" },
+ *     "decoder":        { "q4": "decoder_model_merged_q4.onnx", ... } }
+ * Without it, files are found by the export's naming convention:
+ * <base>.onnx (fp32), <base>_fp16, _int8 (or _quantized), _q4, _q4f16.onnx.
+ *
+ * Rank() orders the variants on disk for this machine: a preference list
+ * per CPU feature level (or fp16-first for a GPU provider), minus any file
+ * larger than MAX_MEMORY_FRACTION of available physical memory (the smallest
+ * is kept if nothing fits). The engine loads the first that works.
+ *
+ * The engine's "auto" mode times each variant once and keeps the winner per
+ * model in <onnx dir>/variants.selected.json, keyed by CPU features and
+ * provider list, so only the first start on a machine pays for the timing.
+ *
+ * Every variant must keep float32 inputs and outputs (the engine binds
+ * float tensors); one that doesn't fails its load probe and is skipped.
+ *
+ * Usage:
+ *   ModelVariants variants;
+ *   variants.Discover("models/fastvlm/onnx");
+ *   for (const auto& variant : variants.Rank(ModelVariants::Component::Decoder, false)) { ... }
+ */
+class ModelVariants {
+public:
+    enum class Component { VisionEncoder, EmbedTokens, Decoder, Count };
+    enum class Precision { Fp32, Fp16, Int8, Q4, Q4F16, Count };
+
+    struct Variant {
+        Precision precision;
+        std::string path;
+        uint64_t bytes;
+    };
+
+    struct CpuFeatures {
+        bool avx2 = false;
+        bool f16c = false;
+        bool avx512f = false;
+        bool avx512Vnni = false;
+        bool avxVnni = false;
+    };
+
+    static constexpr double MAX_MEMORY_FRACTION = 0.25;    // Of available physical memory, per model
+
+    static CpuFeatures DetectCpu();
+    static std::string DescribeCpu(const CpuFeatures& features);   // e.g. "avx2+f16c+avx512vnni"
+
+    static const char* Name(Component component);
+    static const char* Name(Precision precision);
+    static bool ParsePrecision(const std::string& name, Precision& precision);
+
+    /**
+     * @brief Find the variants of every model in onnxDirectory (manifest, else naming convention)
+     */
+    void Discover(const std::string& onnxDirectory);
+
+    /**
+     * @brief Variants on disk for component, best first for this CPU (or GPU when gpuProvider)
+     */
+    std::vector<Variant> Rank(Component component, bool gpuProvider) const;
+
+    /**
+     * @brief Variant of one precision, if on disk
+     */
+    const Variant* Find(Component component, Precision precision) const;
+
+    /**
+     * @brief Read variants.selected.json; entries only count if written under machineKey
+     */
+    void LoadSelection(const std::string& machineKey);
+    bool GetSelection(Component component, Precision& precision) const;
+    void SetSelection(Component component, Precision precision);
+    bool SaveSelection() const;
+
+private:
+    std::string directory;
+    std::vector<Variant> variants[static_cast<int>(Component::Count)];
+
+    std::string machineKey;
+    int selection[static_cast<int>(Component::Count)] = { -1, -1, -1 };    // Precision index, -1 none
+
+    void AddVariant(Component component, Precision precision, const std::string& fileName);
+    bool LoadManifest();
+};
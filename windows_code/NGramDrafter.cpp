@@ -0,0 +1,91 @@
+#include "NGramDrafter.h"
+#include <algorithm>
+
+uint64_t NGramDrafter::ContextKey(int64_t previous, int64_t current, int order) {
+    // Token IDs fit in 32 bits; order 1 ignores `previous`
+    uint64_t key = static_cast<uint32_t>(current);
+    if (order == 2) {
+        key |= static_cast<uint64_t>(static_cast<uint32_t>(previous)) << 32;
+        key ^= 0x9E3779B97F4A7C15ull;   // Keep order-1 and order-2 keys apart
+    }
+    return key;
+}
+
+void NGramDrafter::Add(uint64_t key, int64_t token) {
+    std::vector<Successor>& list = successors[key];
+    for (auto& successor : list) {
+        if (successor.token == token) {
+            successor.count++;
+            successor.lastSeen = observed;
+            return;
+        }
+    }
+
+    if (list.size() < MAX_SUCCESSORS) {
+        list.push_back({token, 1, observed});
+        return;
+    }
+
+    auto leastUsed = std::min_element(list.begin(), list.end(), [](const Successor& a, const Successor& b) {
+        return a.count != b.count ? a.count < b.count : a.lastSeen < b.lastSeen;
+    });
+    *leastUsed = {token, 1, observed};
+}
+
+void NGramDrafter::Observe(const std::vector<int64_t>& tokens) {
+    if (successors.size() >= MAX_CONTEXTS) {
+        successors.clear();
+    }
+    observed++;
+
+    int64_t previous = START_TOKEN;
+    int64_t current = START_TOKEN;
+    for (int64_t token : tokens) {
+        Add(ContextKey(previous, current, 2), token);
+        Add(ContextKey(previous, current, 1), token);
+        previous = current;
+        current = token;
+    }
+}
+
+int64_t NGramDrafter::Predict(int64_t previous, int64_t current) const {
+    for (int order = 2; order >= 1; --order) {
+        auto it = successors.find(ContextKey(previous, current, order));
+        if (it == successors.end() || it->second.empty()) {
+            continue;
+        }
+
+        const Successor* best = &it->second.front();
+        for (const auto& successor : it->second) {
+            if (successor.count > best->count ||
+                (successor.count == best->count && successor.lastSeen > best->lastSeen)) {
+                best = &successor;
+            }
+        }
+        return best->token;
+    }
+    return START_TOKEN;
+}
+
+size_t NGramDrafter::Draft(const std::vector<int64_t>& history, size_t maxTokens,
+                           std::vector<int64_t>& drafts) const {
+    drafts.clear();
+    if (successors.empty()) {
+        return 0;
+    }
+
+    size_t n = history.size();
+    int64_t previous = n >= 2 ? history[n - 2] : START_TOKEN;
+    int64_t current = n >= 1 ? history[n - 1] : START_TOKEN;
+
+    while (drafts.size() < maxTokens) {
+        int64_t next = Predict(previous, current);
+        if (next == START_TOKEN) {
+            break;
+        }
+        drafts.push_back(next);
+        previous = current;
+        current = next;
+    }
+    return drafts.size();
+}
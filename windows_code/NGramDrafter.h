@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * NGramDrafter - Draft tokens for speculative decoding from earlier captions
+ *
+ * Scene captions repeat the same phrases ("A person sitting at a desk..."),
+ * so the tokens that followed a context in previous captions are a cheap,
+ * often-correct guess for what the decoder will produce next.
+ *
+ * Features:
+ * - Order-2 contexts with backoff to order 1; the most frequent successor wins
+ *   (ties go to the most recently seen)
+ * - Caption starts are learned too (contexts padded with a start marker)
+ * - Bounded: the table is cleared once it holds MAX_CONTEXTS contexts
+ *
+ * Usage:
+ *   drafter.Observe(captionTokens);                    // after each caption
+ *   drafter.Draft(generatedSoFar, 4, drafts);          // before a verify pass
+ *
+ * Not thread-safe; owned by the thread that runs Generate.
+ */
+class NGramDrafter {
+public:
+    /**
+     * @brief Learn the successors in one finished caption
+     */
+    void Observe(const std::vector<int64_t>& tokens);
+
+    /**
+     * @brief Chain up to maxTokens guesses after history
+     * @param history Caption tokens generated so far
+     * @param drafts Receives the drafted tokens (cleared first)
+     * @return Number of tokens drafted (0 if the context was never seen)
+     */
+    size_t Draft(const std::vector<int64_t>& history, size_t maxTokens, std::vector<int64_t>& drafts) const;
+
+    void Clear() { successors.clear(); }
+    size_t Size() const { return successors.size(); }
+
+private:
+    struct Successor {
+        int64_t token;
+        uint32_t count;
+        uint64_t lastSeen;
+    };
+
+    static constexpr int64_t START_TOKEN = -1;      // Pads contexts before the first token
+    static constexpr size_t MAX_CONTEXTS = 65536;
+    static constexpr size_t MAX_SUCCESSORS = 4;     // Per context; least used is replaced
+
+    static uint64_t ContextKey(int64_t previous, int64_t current, int order);
+
+    // Predicted successor for (previous, current), or START_TOKEN if unknown
+    int64_t Predict(int64_t previous, int64_t current) const;
+
+    void Add(uint64_t key, int64_t token);
+
+    std::unordered_map<uint64_t, std::vector<Successor>> successors;
+    uint64_t observed = 0;
+};
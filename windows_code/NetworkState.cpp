@@ -0,0 +1,263 @@
+#include "NetworkState.h"
+#include <ws2tcpip.h>
+#include <ocidl.h>
+#include "Log.h"
+
+#pragma comment(lib, "iphlpapi.lib")
+#pragma comment(lib, "ole32.lib")
+
+// Receives ConnectivityChanged on an RPC thread and only wakes the event thread
+class NetworkState::ListEvents : public INetworkListManagerEvents {
+public:
+    explicit ListEvents(NetworkState& owner) : owner(owner), references(1) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override {
+        if (riid == IID_IUnknown || riid == IID_INetworkListManagerEvents) {
+            *object = static_cast<INetworkListManagerEvents*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override {
+        return InterlockedIncrement(&references);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG remaining = InterlockedDecrement(&references);
+        if (remaining == 0) {
+            delete this;
+        }
+        return remaining;
+    }
+
+    HRESULT STDMETHODCALLTYPE ConnectivityChanged(NLM_CONNECTIVITY) override {
+        owner.RequestRefresh();
+        return S_OK;
+    }
+
+private:
+    NetworkState& owner;
+    LONG references;
+};
+
+NetworkState& NetworkState::Instance() {
+    static NetworkState state;
+    return state;
+}
+
+NetworkState::NetworkState()
+    : running(false)
+    , interfaceNotification(nullptr)
+    , listManager(nullptr)
+    , refreshRequested(false)
+    , firstReading(false)
+    , throughputInterface(0)
+    , lastOctets(0)
+{
+}
+
+bool NetworkState::Start() {
+    if (running.exchange(true)) {
+        return true;
+    }
+    if (NotifyIpInterfaceChange(AF_UNSPEC, &NetworkState::OnInterfaceChange, this, FALSE,
+                                &interfaceNotification) != NO_ERROR) {
+        LOG_WARNING("Network", "NotifyIpInterfaceChange failed; network state is polled");
+        interfaceNotification = nullptr;
+        running = false;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        firstReading = false;
+        refreshRequested = true;
+    }
+    eventThread = std::thread(&NetworkState::EventThread, this);
+
+    // The first probe after Start should see real values, not the defaults
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait_for(lock, std::chrono::milliseconds(START_WAIT_MS), [this]() { return firstReading; });
+    return true;
+}
+
+void NetworkState::Stop() {
+    {
+        // Under the mutex, so the event thread can't miss it between its check and its wait
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running.exchange(false)) {
+            return;
+        }
+    }
+    // No interface callback runs once this returns
+    CancelMibChangeNotify2(interfaceNotification);
+    interfaceNotification = nullptr;
+    wake.notify_all();
+    if (eventThread.joinable()) {
+        eventThread.join();
+    }
+}
+
+void CALLBACK NetworkState::OnInterfaceChange(PVOID context, PMIB_IPINTERFACE_ROW, MIB_NOTIFICATION_TYPE) {
+    static_cast<NetworkState*>(context)->RequestRefresh();
+}
+
+void NetworkState::RequestRefresh() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        refreshRequested = true;
+    }
+    wake.notify_all();
+}
+
+void NetworkState::EventThread() {
+    bool comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+
+    // Connectivity events; without them the interface notifications still drive refreshes
+    IConnectionPoint* connectionPoint = nullptr;
+    ListEvents* sink = nullptr;
+    DWORD cookie = 0;
+    if (comInitialized && SUCCEEDED(CoCreateInstance(CLSID_NetworkListManager, nullptr, CLSCTX_ALL,
+                                                     IID_INetworkListManager,
+                                                     reinterpret_cast<void**>(&listManager)))) {
+        IConnectionPointContainer* container = nullptr;
+        if (SUCCEEDED(listManager->QueryInterface(IID_IConnectionPointContainer,
+                                                  reinterpret_cast<void**>(&container)))) {
+            if (SUCCEEDED(container->FindConnectionPoint(IID_INetworkListManagerEvents, &connectionPoint))) {
+                sink = new ListEvents(*this);
+                if (FAILED(connectionPoint->Advise(sink, &cookie))) {
+                    cookie = 0;
+                }
+            }
+            container->Release();
+        }
+    }
+    if (cookie == 0) {
+        LOG_WARNING("Network", "No connectivity events from the network list manager; "
+                    "connectivity is re-read on interface changes");
+    }
+
+    while (running.load()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(FALLBACK_REFRESH_MS),
+                          [this]() { return refreshRequested || !running.load(); });
+            if (!running.load()) {
+                break;
+            }
+            bool settle = refreshRequested && firstReading;
+            refreshRequested = false;
+            if (settle) {
+                // Events come in bursts (an adapter change raises several); read once after them
+                wake.wait_for(lock, std::chrono::milliseconds(SETTLE_MS), [this]() { return !running.load(); });
+                refreshRequested = false;
+            }
+        }
+        Refresh();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            firstReading = true;
+        }
+        wake.notify_all();
+    }
+
+    if (connectionPoint) {
+        if (cookie != 0) {
+            connectionPoint->Unadvise(cookie);
+        }
+        connectionPoint->Release();
+    }
+    if (sink) {
+        sink->Release();
+    }
+    if (listManager) {
+        listManager->Release();
+        listManager = nullptr;
+    }
+    if (comInitialized) {
+        CoUninitialize();
+    }
+}
+
+std::string NetworkState::InterfaceType(IFTYPE type) {
+    switch (type) {
+        case IF_TYPE_IEEE80211:         return "WiFi";
+        case IF_TYPE_ETHERNET_CSMACD:
+        case IF_TYPE_GIGABITETHERNET:   return "Ethernet";
+        case IF_TYPE_WWANPP:
+        case IF_TYPE_WWANPP2:           return "Cellular";
+        default:                        return "Other";
+    }
+}
+
+void NetworkState::Refresh() {
+    Snapshot next;
+    NLM_CONNECTIVITY connectivity = NLM_CONNECTIVITY_DISCONNECTED;
+    if (listManager && SUCCEEDED(listManager->GetConnectivity(&connectivity))) {
+        next.connected = (connectivity & (NLM_CONNECTIVITY_IPV4_INTERNET | NLM_CONNECTIVITY_IPV6_INTERNET)) != 0;
+    }
+
+    // The interface traffic to the internet would leave by (no packet is sent)
+    sockaddr_in remote4 = {};
+    remote4.sin_family = AF_INET;
+    inet_pton(AF_INET, "8.8.8.8", &remote4.sin_addr);
+    sockaddr_in6 remote6 = {};
+    remote6.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "2001:4860:4860::8888", &remote6.sin6_addr);
+    DWORD index = 0;
+    if (GetBestInterfaceEx(reinterpret_cast<sockaddr*>(&remote4), &index) != NO_ERROR &&
+        GetBestInterfaceEx(reinterpret_cast<sockaddr*>(&remote6), &index) != NO_ERROR) {
+        index = 0;
+    }
+
+    next.type = "None";
+    if (index != 0) {
+        MIB_IF_ROW2 row = {};
+        row.InterfaceIndex = index;
+        if (GetIfEntry2(&row) == NO_ERROR && row.OperStatus == IfOperStatusUp) {
+            next.interfaceIndex = index;
+            next.type = InterfaceType(row.Type);
+        }
+    }
+    if (!listManager) {
+        next.connected = next.interfaceIndex != 0;
+    }
+
+    snapshot.Update([&](Snapshot& current) {
+        if (current.generation != 0 && current.connected == next.connected && current.type == next.type &&
+            current.interfaceIndex == next.interfaceIndex) {
+            return false;
+        }
+        next.generation = current.generation + 1;
+        current = next;
+        return true;
+    });
+}
+
+double NetworkState::GetThroughputMbps() {
+    NET_IFINDEX index = Get()->interfaceIndex;
+    if (index == 0) {
+        return -1.0;
+    }
+    MIB_IF_ROW2 row = {};
+    row.InterfaceIndex = index;
+    if (GetIfEntry2(&row) != NO_ERROR) {
+        return -1.0;
+    }
+    uint64_t octets = row.InOctets + row.OutOctets;
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(throughputMutex);
+    double mbps = 0.0;
+    double seconds = std::chrono::duration<double>(now - lastOctetsTime).count();
+    if (throughputInterface == index && octets >= lastOctets && seconds > 0.0) {
+        mbps = static_cast<double>(octets - lastOctets) * 8.0 / seconds / 1e6;
+    }
+    throughputInterface = index;
+    lastOctets = octets;
+    lastOctetsTime = now;
+    return mbps;
+}
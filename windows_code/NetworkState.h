@@ -0,0 +1,105 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <iphlpapi.h>
+#include <netlistmgr.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "PublishedState.h"
+
+/**
+ * NetworkState - Connectivity and the active interface, kept current by events
+ *
+ * Architecture:
+ *   Two notifications mark the state stale instead of it being re-read on
+ *   every probe:
+ *     - INetworkListManagerEvents::ConnectivityChanged (internet reachability)
+ *     - NotifyIpInterfaceChange (an interface added, removed or changed)
+ *   A thread (COM MTA, so the list manager's events arrive without a message
+ *   loop) waits for either, lets a burst settle for SETTLE_MS, and re-reads:
+ *   GetConnectivity, the interface of the default route (GetBestInterfaceEx)
+ *   and that one interface's row (GetIfEntry2) for its type. A snapshot that
+ *   differs from the last is published with the next generation; readers get
+ *   it with one atomic load. A FALLBACK_REFRESH_MS re-read covers a lost event.
+ *
+ *   Throughput reads the byte counters of the active interface only.
+ *
+ * Process-wide: the first ContextCollector starts it and the last stops it,
+ * as with window monitoring. Until it runs, WindowsAPIs' network functions
+ * query the system themselves.
+ *
+ * Usage:
+ *   NetworkState::Instance().Start();
+ *   std::shared_ptr<const NetworkState::Snapshot> network = NetworkState::Instance().Get();
+ *   double mbps = NetworkState::Instance().GetThroughputMbps();
+ */
+class NetworkState {
+public:
+    struct Snapshot {
+        bool connected = true;          // IPv4 or IPv6 internet connectivity
+        std::string type = "Unknown";   // Of the active interface: "WiFi", "Ethernet", "Cellular", "Other", "None"
+        NET_IFINDEX interfaceIndex = 0; // Interface of the default route; 0: none
+        uint64_t generation = 0;        // Bumped with every published change
+    };
+
+    static constexpr int SETTLE_MS = 250;
+    static constexpr int FALLBACK_REFRESH_MS = 60 * 1000;
+    static constexpr int START_WAIT_MS = 2000;      // Start() waits this long for the first reading
+
+    static NetworkState& Instance();
+
+    NetworkState(const NetworkState&) = delete;
+    NetworkState& operator=(const NetworkState&) = delete;
+
+    /**
+     * @brief Subscribe to the notifications and take the first reading
+     * @return false (and logs) when interface notifications can't be registered
+     */
+    bool Start();
+    void Stop();
+    bool IsRunning() const { return running.load(); }
+
+    std::shared_ptr<const Snapshot> Get() const { return snapshot.Load(); }
+    uint64_t GetGeneration() const { return snapshot.Load()->generation; }
+
+    /**
+     * @brief Megabits per second in + out on the active interface since the last call
+     * @return 0 on the first call (or after the interface changed), -1 with no interface
+     */
+    double GetThroughputMbps();
+
+private:
+    class ListEvents;
+
+    NetworkState();
+    ~NetworkState() = default;
+
+    void EventThread();
+    void RequestRefresh();
+    void Refresh();
+    static std::string InterfaceType(IFTYPE type);
+    static void CALLBACK OnInterfaceChange(PVOID context, PMIB_IPINTERFACE_ROW row, MIB_NOTIFICATION_TYPE type);
+
+    PublishedState<Snapshot> snapshot;
+    std::atomic<bool> running;
+    std::thread eventThread;
+    HANDLE interfaceNotification;
+    INetworkListManager* listManager;   // Event thread only
+
+    std::mutex mutex;                   // Guards the three below
+    std::condition_variable wake;
+    bool refreshRequested;
+    bool firstReading;
+
+    std::mutex throughputMutex;         // Guards the three below
+    NET_IFINDEX throughputInterface;
+    uint64_t lastOctets;
+    std::chrono::steady_clock::time_point lastOctetsTime;
+};
@@ -0,0 +1,331 @@
+#include "NoiseSuppressor.h"
+#include "OrtRuntime.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define NOISE_SUPPRESSOR_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const float ENERGY_EPSILON = 1e-10f;
+
+// RNNoise's band grid in 200 Hz units (up to 8 kHz here), 4 bins per unit
+const int BAND_EDGES_200HZ[NoiseSuppressor::BANDS] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 14, 16, 20, 24, 28, 34, 40 };
+
+void PowerSpectrum(const float* re, const float* im, float* power, size_t count) {
+    size_t k = 0;
+#ifdef NOISE_SUPPRESSOR_X86
+    for (; k + 4 <= count; k += 4) {
+        __m128 r = _mm_loadu_ps(re + k);
+        __m128 i = _mm_loadu_ps(im + k);
+        _mm_storeu_ps(power + k, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i)));
+    }
+#endif
+    for (; k < count; ++k) {
+        power[k] = re[k] * re[k] + im[k] * im[k];
+    }
+}
+
+void ApplyGains(float* re, float* im, const float* gains, size_t count) {
+    size_t k = 0;
+#ifdef NOISE_SUPPRESSOR_X86
+    for (; k + 4 <= count; k += 4) {
+        __m128 g = _mm_loadu_ps(gains + k);
+        _mm_storeu_ps(re + k, _mm_mul_ps(_mm_loadu_ps(re + k), g));
+        _mm_storeu_ps(im + k, _mm_mul_ps(_mm_loadu_ps(im + k), g));
+    }
+#endif
+    for (; k < count; ++k) {
+        re[k] *= gains[k];
+        im[k] *= gains[k];
+    }
+}
+
+}  // namespace
+
+NoiseSuppressor::NoiseSuppressor()
+    : blockFill(0)
+    , subwindowBlocks(0)
+    , subwindowIndex(0)
+    , primed(false)
+    , session(nullptr)
+    , memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    , sessionBytes(0)
+{
+    fft.Configure(static_cast<int>(FRAME_SAMPLES));
+
+    // Sine window: analysis times synthesis is sin^2, and sin^2 + cos^2 = 1
+    // across the two overlapping halves
+    window.resize(FRAME_SAMPLES);
+    for (size_t n = 0; n < FRAME_SAMPLES; ++n) {
+        window[n] = static_cast<float>(std::sin(PI * (n + 0.5) / FRAME_SAMPLES));
+    }
+
+    bandEdges.resize(BANDS);
+    for (size_t b = 0; b < BANDS; ++b) {
+        bandEdges[b] = BAND_EDGES_200HZ[b] * 4;
+    }
+    binBand.resize(BINS);
+    binFraction.resize(BINS);
+    for (size_t b = 0; b + 1 < BANDS; ++b) {
+        const int width = bandEdges[b + 1] - bandEdges[b];
+        for (int j = 0; j < width; ++j) {
+            binBand[bandEdges[b] + j] = static_cast<int>(b);
+            binFraction[bandEdges[b] + j] = static_cast<float>(j) / width;
+        }
+    }
+    binBand[BINS - 1] = static_cast<int>(BANDS - 2);     // Nyquist: all on the last centre
+    binFraction[BINS - 1] = 1.0f;
+
+    inputBlock.resize(HOP_SAMPLES);
+    outputBlock.resize(HOP_SAMPLES);
+    previousInput.resize(HOP_SAMPLES);
+    overlap.resize(HOP_SAMPLES);
+    frame.resize(FRAME_SAMPLES);
+    re.resize(BINS);
+    im.resize(BINS);
+    power.resize(BINS);
+    binGains.resize(BINS);
+    bandEnergy.resize(BANDS);
+    bandGains.resize(BANDS);
+    smoothedEnergy.resize(BANDS);
+    noiseEnergy.resize(BANDS);
+    subwindowMinimum.resize(MIN_SUBWINDOWS * BANDS);
+    currentMinimum.resize(BANDS);
+    previousGain.resize(BANDS);
+    previousPosterior.resize(BANDS);
+    features.resize(BANDS);
+    modelGains.resize(BANDS);
+    Reset();
+}
+
+NoiseSuppressor::~NoiseSuppressor() = default;
+
+bool NoiseSuppressor::LoadModel(const std::wstring& modelPath) {
+    try {
+        // A 10 ms block every 10 ms: on the processing thread, own pool
+        OrtRuntime::SessionConfig config;
+        config.optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+        config.logId = "NoiseSuppressor";
+        config.useGlobalThreadPool = false;
+        config.intraOpThreads = 1;
+        config.interOpThreads = 1;
+        config.freeDimensionOverrides = { {"batch_size", 1}, {"batch", 1} };
+
+        MemoryAccounting::Meter sessionMeter;
+        session = OrtRuntime::Instance().CreateSession(modelPath, config);
+        if (!session) {
+            LOG_ERROR("NoiseSuppressor", "Failed to create noise suppression session");
+            return false;
+        }
+        sessionBytes = sessionMeter.Bytes();
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        featuresName = session->GetInputNameAllocated(0, allocator).get();
+        gainsName = session->GetOutputNameAllocated(0, allocator).get();
+
+        std::vector<int64_t> featuresShape = session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        int64_t bands = featuresShape.empty() ? -1 : featuresShape.back();
+        if (bands > 0 && static_cast<size_t>(bands) != BANDS) {
+            LOG_ERROR("NoiseSuppressor", "Model takes " << bands << " bands, expected " << BANDS);
+            session.reset();
+            return false;
+        }
+
+        inputs.clear();
+        outputs.clear();
+        const int64_t bandShape[] = {1, 1, static_cast<int64_t>(BANDS)};
+        inputs.push_back(Ort::Value::CreateTensor<float>(memoryInfo, features.data(), features.size(), bandShape, 3));
+        outputs.push_back(Ort::Value::CreateTensor<float>(memoryInfo, modelGains.data(), modelGains.size(),
+                                                          bandShape, 3));
+
+        // Recurrent state: shape from the model, free dimensions as 1
+        state.clear();
+        nextState.clear();
+        stateName.clear();
+        stateOutName.clear();
+        if (session->GetInputCount() >= 2 && session->GetOutputCount() >= 2) {
+            stateName = session->GetInputNameAllocated(1, allocator).get();
+            stateOutName = session->GetOutputNameAllocated(1, allocator).get();
+            std::vector<int64_t> stateShape = session->GetInputTypeInfo(1).GetTensorTypeAndShapeInfo().GetShape();
+            size_t stateSize = 1;
+            for (int64_t& dim : stateShape) {
+                dim = (std::max)(dim, static_cast<int64_t>(1));
+                stateSize *= static_cast<size_t>(dim);
+            }
+            state.assign(stateSize, 0.0f);
+            nextState.assign(stateSize, 0.0f);
+            inputs.push_back(Ort::Value::CreateTensor<float>(memoryInfo, state.data(), state.size(),
+                                                             stateShape.data(), stateShape.size()));
+            outputs.push_back(Ort::Value::CreateTensor<float>(memoryInfo, nextState.data(), nextState.size(),
+                                                              stateShape.data(), stateShape.size()));
+        }
+
+        // One silent block up front: checks the contract and warms the session
+        if (!ModelGains()) {
+            return false;
+        }
+        std::fill(state.begin(), state.end(), 0.0f);
+
+        LOG_DEBUG("NoiseSuppressor", "Noise suppression model ready, " << state.size() << " state values");
+        return true;
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("NoiseSuppressor", "ONNX Runtime error: " << e.what());
+        session.reset();
+        return false;
+    }
+}
+
+void NoiseSuppressor::Reset() {
+    std::fill(inputBlock.begin(), inputBlock.end(), 0.0f);
+    std::fill(outputBlock.begin(), outputBlock.end(), 0.0f);
+    std::fill(previousInput.begin(), previousInput.end(), 0.0f);
+    std::fill(overlap.begin(), overlap.end(), 0.0f);
+    blockFill = 0;
+    primed = false;
+    std::fill(state.begin(), state.end(), 0.0f);
+}
+
+void NoiseSuppressor::Process(float* samples, size_t count) {
+    TRACE_ZONE("NoiseSuppressor");
+    size_t done = 0;
+    while (done < count) {
+        const size_t take = (std::min)(count - done, HOP_SAMPLES - blockFill);
+        std::memcpy(inputBlock.data() + blockFill, samples + done, take * sizeof(float));
+        std::memcpy(samples + done, outputBlock.data() + blockFill, take * sizeof(float));
+        blockFill += take;
+        done += take;
+        if (blockFill == HOP_SAMPLES) {
+            ProcessBlock();
+            blockFill = 0;
+        }
+    }
+}
+
+void NoiseSuppressor::ProcessBlock() {
+    for (size_t n = 0; n < HOP_SAMPLES; ++n) {
+        frame[n] = previousInput[n] * window[n];
+        frame[HOP_SAMPLES + n] = inputBlock[n] * window[HOP_SAMPLES + n];
+    }
+    previousInput.swap(inputBlock);
+
+    fft.Forward(frame.data(), re.data(), im.data());
+    PowerSpectrum(re.data(), im.data(), power.data(), BINS);
+
+    // Triangular bands: each bin splits its energy between the two centres around it
+    std::fill(bandEnergy.begin(), bandEnergy.end(), 0.0f);
+    float inputEnergy = 0.0f;
+    for (size_t k = 0; k < BINS; ++k) {
+        bandEnergy[binBand[k]] += (1.0f - binFraction[k]) * power[k];
+        bandEnergy[binBand[k] + 1] += binFraction[k] * power[k];
+        inputEnergy += power[k];
+    }
+
+    if (session && ModelGains()) {
+        ++stats.modelBlocks;
+    } else {
+        EstimatorGains();
+    }
+
+    float outputEnergy = 0.0f;
+    for (size_t k = 0; k < BINS; ++k) {
+        binGains[k] = (1.0f - binFraction[k]) * bandGains[binBand[k]] + binFraction[k] * bandGains[binBand[k] + 1];
+        outputEnergy += power[k] * binGains[k] * binGains[k];
+    }
+    ApplyGains(re.data(), im.data(), binGains.data(), BINS);
+    fft.Inverse(re.data(), im.data(), frame.data());
+
+    // Overlap-add: the first half completes the previous frame's second half
+    for (size_t n = 0; n < HOP_SAMPLES; ++n) {
+        outputBlock[n] = overlap[n] + frame[n] * window[n];
+        overlap[n] = frame[HOP_SAMPLES + n] * window[HOP_SAMPLES + n];
+    }
+
+    ++stats.blocks;
+    if (inputEnergy > ENERGY_EPSILON) {
+        const float attenuation = 10.0f * std::log10(inputEnergy / (std::max)(outputEnergy, ENERGY_EPSILON));
+        stats.attenuationDb = 0.99f * stats.attenuationDb + 0.01f * attenuation;
+    }
+}
+
+void NoiseSuppressor::EstimatorGains() {
+    if (!primed) {
+        // First block of the stream: take it as the noise until the minimum tracks
+        for (size_t b = 0; b < BANDS; ++b) {
+            smoothedEnergy[b] = bandEnergy[b];
+            currentMinimum[b] = bandEnergy[b];
+            previousGain[b] = 1.0f;
+            previousPosterior[b] = 1.0f;
+        }
+        for (size_t w = 0; w < MIN_SUBWINDOWS; ++w) {
+            std::copy(bandEnergy.begin(), bandEnergy.end(), subwindowMinimum.begin() + w * BANDS);
+        }
+        subwindowBlocks = 0;
+        subwindowIndex = 0;
+        primed = true;
+    }
+
+    // Minimum statistics: the smoothed energy's minimum over MIN_WINDOW_BLOCKS,
+    // kept as MIN_SUBWINDOWS sub-window minima so the window slides cheaply
+    for (size_t b = 0; b < BANDS; ++b) {
+        smoothedEnergy[b] = ENERGY_SMOOTHING * smoothedEnergy[b] + (1.0f - ENERGY_SMOOTHING) * bandEnergy[b];
+        currentMinimum[b] = (std::min)(currentMinimum[b], smoothedEnergy[b]);
+    }
+    if (++subwindowBlocks == MIN_SUBWINDOW_BLOCKS) {
+        std::copy(currentMinimum.begin(), currentMinimum.end(), subwindowMinimum.begin() + subwindowIndex * BANDS);
+        subwindowIndex = (subwindowIndex + 1) % MIN_SUBWINDOWS;
+        std::copy(smoothedEnergy.begin(), smoothedEnergy.end(), currentMinimum.begin());
+        subwindowBlocks = 0;
+    }
+
+    for (size_t b = 0; b < BANDS; ++b) {
+        float minimum = currentMinimum[b];
+        for (size_t w = 0; w < MIN_SUBWINDOWS; ++w) {
+            minimum = (std::min)(minimum, subwindowMinimum[w * BANDS + b]);
+        }
+        noiseEnergy[b] = MIN_BIAS * minimum;
+
+        // Decision-directed a priori SNR (Ephraim-Malah), Wiener gain
+        const float posterior = bandEnergy[b] / (std::max)(noiseEnergy[b], ENERGY_EPSILON);
+        const float prior = PRIOR_SMOOTHING * previousGain[b] * previousGain[b] * previousPosterior[b] +
+                            (1.0f - PRIOR_SMOOTHING) * (std::max)(posterior - 1.0f, 0.0f);
+        const float gain = (std::max)(prior / (1.0f + prior), GAIN_FLOOR);
+        bandGains[b] = gain;
+        previousGain[b] = gain;
+        previousPosterior[b] = posterior;
+    }
+}
+
+bool NoiseSuppressor::ModelGains() {
+    for (size_t b = 0; b < BANDS; ++b) {
+        features[b] = std::log10((std::max)(bandEnergy[b], ENERGY_EPSILON));
+    }
+    try {
+        const char* inputNames[] = { featuresName.c_str(), stateName.c_str() };
+        const char* outputNames[] = { gainsName.c_str(), stateOutName.c_str() };
+        session->Run(Ort::RunOptions{nullptr}, inputNames, inputs.data(), inputs.size(),
+                     outputNames, outputs.data(), outputs.size());
+    }
+    catch (const Ort::Exception& e) {
+        // A model that breaks the contract fails on every block: the estimator takes over
+        LOG_ERROR("NoiseSuppressor", "Inference failed, falling back to the estimator: " << e.what());
+        session.reset();
+        return false;
+    }
+    if (!state.empty()) {
+        std::memcpy(state.data(), nextState.data(), state.size() * sizeof(float));
+    }
+    for (size_t b = 0; b < BANDS; ++b) {
+        bandGains[b] = (std::min)((std::max)(modelGains[b], 0.0f), 1.0f);
+    }
+    return true;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "RealFft.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * NoiseSuppressor - Stationary noise removal ahead of the VAD and whisper
+ *
+ * A fan or a keyboard next to the microphone keeps Silero hovering around
+ * its thresholds: marginal segments open on the noise alone and each one
+ * costs a whisper run that returns nothing (or a hallucination). This stage
+ * cleans the lane's audio in place before anything scores it, in the
+ * layout RNNoise uses:
+ *
+ *   - 10 ms blocks (HOP_SAMPLES), 20 ms sine-windowed frames with 50%
+ *     overlap; the window is applied at analysis and synthesis, so unit
+ *     gains reconstruct the input exactly, LATENCY_SAMPLES later
+ *   - 161-bin spectrum through a RealFft (320 points: radix 4, 4, 5, 2)
+ *   - BANDS triangular bands on RNNoise's 200 Hz grid (denser at the
+ *     bottom, up to 8 kHz): one gain per band, interpolated across the bins
+ *     between band centres, so no bin is gated on its own (musical noise)
+ *
+ * The band gains come from a model when one is installed, otherwise from a
+ * statistical estimator:
+ *
+ * Model contract (optional; any RNNoise / DeepFilterNet-style band-gain
+ * network exported for this band layout):
+ *   input 0   float (1, 1, BANDS)   log10 band energies of the block
+ *   input 1   float, any shape      recurrent state (optional; zeros at first)
+ *   output 0  float (1, 1, BANDS)   band gains in [0, 1]
+ *   output 1  float, input 1 shape  next recurrent state (when input 1 exists)
+ * The session comes from OrtRuntime like the other small models (private
+ * single-thread pool, tensors preallocated), one run per block.
+ *
+ * Fallback: minimum-statistics noise tracking per band (the minimum of the
+ * smoothed band energy over the last MIN_WINDOW_BLOCKS, scaled by
+ * MIN_BIAS) and a decision-directed Wiener gain, floored at GAIN_FLOOR so
+ * the residual stays natural noise rather than warbling.
+ *
+ * Power spectrum and gain application are SSE; a block allocates nothing.
+ *
+ * Usage (processing thread only; not thread-safe; one instance per stream):
+ *   NoiseSuppressor denoiser;
+ *   denoiser.LoadModel(L"models/denoise/denoise.onnx");   // Optional
+ *   denoiser.Process(samples, count);                      // In place, any count
+ */
+class NoiseSuppressor {
+public:
+    static constexpr size_t HOP_SAMPLES = 160;                  // 10 ms block @ 16 kHz
+    static constexpr size_t FRAME_SAMPLES = 2 * HOP_SAMPLES;    // 20 ms analysis frame
+    static constexpr size_t LATENCY_SAMPLES = FRAME_SAMPLES;    // Block fill + overlap-add
+    static constexpr size_t BINS = FRAME_SAMPLES / 2 + 1;       // 50 Hz apart
+    static constexpr size_t BANDS = 18;                         // Band centres, 0 to 8 kHz
+    static constexpr float GAIN_FLOOR = 0.1f;                   // -20 dB at most (estimator)
+    static constexpr float PRIOR_SMOOTHING = 0.98f;             // Decision-directed alpha
+    static constexpr float ENERGY_SMOOTHING = 0.7f;             // Band energy, noise tracking only
+    static constexpr size_t MIN_SUBWINDOWS = 8;
+    static constexpr size_t MIN_SUBWINDOW_BLOCKS = 19;
+    static constexpr size_t MIN_WINDOW_BLOCKS = MIN_SUBWINDOWS * MIN_SUBWINDOW_BLOCKS;    // ~1.5 s
+    static constexpr float MIN_BIAS = 1.5f;                     // Minimum -> mean noise energy
+
+    struct Stats {
+        uint64_t blocks = 0;
+        uint64_t modelBlocks = 0;           // Gains from the model
+        float attenuationDb = 0.0f;         // Smoothed input/output energy ratio
+    };
+
+    NoiseSuppressor();
+    ~NoiseSuppressor();
+
+    NoiseSuppressor(const NoiseSuppressor&) = delete;
+    NoiseSuppressor& operator=(const NoiseSuppressor&) = delete;
+
+    // Band-gain model per the contract above; false leaves the estimator in charge
+    bool LoadModel(const std::wstring& modelPath);
+    bool HasModel() const { return session != nullptr; }
+
+    // Denoise in place; the output is the input LATENCY_SAMPLES ago
+    void Process(float* samples, size_t count);
+
+    // Forget the stream: noise estimate, recurrent state and the delay line
+    void Reset();
+
+    const Stats& GetStats() const { return stats; }
+
+    // Private bytes grown while creating the session (for MemoryAccounting)
+    uint64_t GetSessionBytes() const { return sessionBytes; }
+
+private:
+    void ProcessBlock();
+    void EstimatorGains();
+    bool ModelGains();
+
+    RealFft fft;
+    std::vector<float> window;              // Sine, analysis and synthesis
+    std::vector<int> bandEdges;             // BANDS bins, the band centres
+    std::vector<int> binBand;               // Lower band of each bin
+    std::vector<float> binFraction;         // ... and its weight on the upper one
+
+    // Delay line: the block being filled and the finished one being emitted
+    std::vector<float> inputBlock;
+    std::vector<float> outputBlock;
+    size_t blockFill;
+    std::vector<float> previousInput;       // First half of the next frame
+    std::vector<float> overlap;             // Second half of the last synthesis
+
+    // Per-block scratch
+    std::vector<float> frame;
+    std::vector<float> re;
+    std::vector<float> im;
+    std::vector<float> power;
+    std::vector<float> binGains;
+    std::vector<float> bandEnergy;
+    std::vector<float> bandGains;
+
+    // Estimator state, per band
+    std::vector<float> smoothedEnergy;
+    std::vector<float> noiseEnergy;
+    std::vector<float> subwindowMinimum;    // MIN_SUBWINDOWS x BANDS, ring
+    std::vector<float> currentMinimum;
+    size_t subwindowBlocks;
+    size_t subwindowIndex;
+    std::vector<float> previousGain;
+    std::vector<float> previousPosterior;
+    bool primed;
+
+    // Model
+    std::unique_ptr<Ort::Session> session;
+    Ort::MemoryInfo memoryInfo;
+    std::string featuresName;
+    std::string stateName;
+    std::string gainsName;
+    std::string stateOutName;
+    uint64_t sessionBytes;
+    std::vector<float> features;            // (1, 1, BANDS)
+    std::vector<float> modelGains;          // (1, 1, BANDS)
+    std::vector<float> state;               // Empty: stateless model
+    std::vector<float> nextState;
+    std::vector<Ort::Value> inputs;
+    std::vector<Ort::Value> outputs;
+
+    Stats stats;
+};
@@ -0,0 +1,443 @@
+#include "OrtRuntime.h"
+#include "CpuBudget.h"
+#include "LargePages.h"
+#include "ThreadCpu.h"
+#include <onnxruntime_session_options_config_keys.h>
+#include <onnxruntime_run_options_config_keys.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <malloc.h>
+#include <thread>
+#include <windows.h>
+
+namespace {
+
+// Global pool threads run under the Vision budget (priority, optional pinning)
+OrtCustomThreadHandle CreateBudgetedThread(void* /*options*/, OrtThreadWorkerFn worker, void* param) {
+    auto* thread = new std::thread([worker, param]() {
+        CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Vision);
+        ThreadCpu::Scope cpu(ThreadCpu::Group::Camera);
+        worker(param);
+    });
+    return reinterpret_cast<OrtCustomThreadHandle>(thread);
+}
+
+void JoinBudgetedThread(OrtCustomThreadHandle handle) {
+    auto* thread = reinterpret_cast<std::thread*>(const_cast<OrtCustomHandleType*>(handle));
+    thread->join();
+    delete thread;
+}
+
+// Env with global thread pools; must be built before any session exists
+Ort::Env CreateGlobalEnv(int intraOpThreads, int interOpThreads) {
+    Ort::ThreadingOptions threadingOptions;
+    threadingOptions.SetGlobalIntraOpNumThreads(intraOpThreads);
+    threadingOptions.SetGlobalInterOpNumThreads(interOpThreads);
+    threadingOptions.SetGlobalSpinControl(0);  // Don't burn cores between audio frames
+    threadingOptions.SetGlobalDenormalAsZero();
+    threadingOptions.SetGlobalCustomCreateThreadFn(CreateBudgetedThread);
+    threadingOptions.SetGlobalCustomJoinThreadFn(JoinBudgetedThread);
+
+    return Ort::Env(threadingOptions, ORT_LOGGING_LEVEL_WARNING, "NovaPerception");
+}
+
+bool IsCpuProvider(const std::string& provider) {
+    return provider.empty() || provider == "CPU";
+}
+
+// Friendly name -> ORT provider name as reported by GetAvailableProviders()
+std::string OrtProviderName(const std::string& provider) {
+    if (IsCpuProvider(provider)) return "CPUExecutionProvider";
+    if (provider == "DirectML")  return "DmlExecutionProvider";
+    return provider + "ExecutionProvider";
+}
+
+// Exported by the DirectML build of onnxruntime.dll; looked up at runtime so
+// the CPU-only package still links
+typedef OrtStatus* (ORT_API_CALL* AppendDmlProviderFn)(OrtSessionOptions* options, int deviceId);
+
+int DefaultIntraOpThreads() {
+    // Vision's share; capture/VAD and whisper have their own cores in the budget
+    return (std::max)(1, CpuBudget::Instance().Get(CpuBudget::Subsystem::Vision).threads);
+}
+
+} // namespace
+
+// Env allocator in large-page mode: blocks of a large page and more come from
+// LargePages, the rest (and any large-page allocation that fails) from the heap
+struct OrtRuntime::LargePageAllocator : OrtAllocator {
+    static constexpr size_t ALIGNMENT = 64;
+
+    explicit LargePageAllocator(const OrtMemoryInfo* memoryInfo) : OrtAllocator{}, memoryInfo(memoryInfo) {
+        version = ORT_API_VERSION;
+        OrtAllocator::Alloc = [](OrtAllocator*, size_t size) -> void* {
+            void* block = size >= LargePages::Instance().PageBytes() ? LargePages::Instance().Allocate(size) : nullptr;
+            return block ? block : _aligned_malloc(size, ALIGNMENT);
+        };
+        OrtAllocator::Free = [](OrtAllocator*, void* block) {
+            if (!LargePages::Instance().Free(block)) {
+                _aligned_free(block);
+            }
+        };
+        OrtAllocator::Info = [](const OrtAllocator* self) -> const OrtMemoryInfo* {
+            return static_cast<const LargePageAllocator*>(self)->memoryInfo;
+        };
+    }
+
+    const OrtMemoryInfo* memoryInfo;
+};
+
+int OrtRuntime::requestedIntraOpThreads = 0;
+
+OrtRuntime& OrtRuntime::Instance() {
+    static OrtRuntime instance;
+    return instance;
+}
+
+void OrtRuntime::SetGlobalIntraOpThreads(int threads) {
+    requestedIntraOpThreads = (std::max)(0, threads);
+}
+
+OrtRuntime::OrtRuntime()
+    : globalIntraOpThreads(requestedIntraOpThreads > 0 ? requestedIntraOpThreads : DefaultIntraOpThreads())
+    , globalInterOpThreads(1)
+    , env(CreateGlobalEnv(globalIntraOpThreads, globalInterOpThreads))
+    , cpuMemoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    , sharedArenaRegistered(false)
+{
+    // One CPU allocator for every session instead of one per session: an arena,
+    // or with LargePages enabled (memory.large_pages) one over large pages,
+    // which keeps its own cache of freed blocks in place of the arena's
+    if (LargePages::Instance().IsActive()) {
+        try {
+            largePageMemoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault);
+            largePageAllocator = std::make_unique<LargePageAllocator>(largePageMemoryInfo);
+            Ort::ThrowOnError(Ort::GetApi().RegisterAllocator(env, largePageAllocator.get()));
+            sharedArenaRegistered = true;
+        } catch (const Ort::Exception& e) {
+            LogError("Failed to register large-page allocator, using the arena: " + std::string(e.what()));
+            largePageAllocator.reset();
+        }
+    }
+    if (!largePageAllocator) {
+        try {
+            Ort::ArenaCfg arenaConfig(0, -1, -1, -1);  // ORT defaults
+            env.CreateAndRegisterAllocator(cpuMemoryInfo, arenaConfig);
+            sharedArenaRegistered = true;
+        } catch (const Ort::Exception& e) {
+            LogError("Failed to register shared arena allocator: " + std::string(e.what()));
+        }
+    }
+
+    try {
+        availableProviders = Ort::GetAvailableProviders();
+    } catch (const Ort::Exception& e) {
+        LogError("Failed to query execution providers: " + std::string(e.what()));
+    }
+
+    std::string providerList;
+    for (const auto& provider : availableProviders) {
+        providerList += (providerList.empty() ? "" : ", ") + provider;
+    }
+    LogDebug("Available execution providers: " + providerList);
+
+    LogDebug("Environment created (global pool: " + std::to_string(globalIntraOpThreads) +
+             " intra-op, " + std::to_string(globalInterOpThreads) + " inter-op threads" +
+             (largePageAllocator ? ", shared large-page allocator)" : sharedArenaRegistered ? ", shared arena)" : ")"));
+}
+
+Ort::SessionOptions OrtRuntime::BuildSessionOptions(const SessionConfig& config) {
+    Ort::SessionOptions options;
+    options.SetGraphOptimizationLevel(config.optimizationLevel);
+
+    if (config.useGlobalThreadPool) {
+        options.DisablePerSessionThreads();
+    } else {
+        options.SetIntraOpNumThreads(config.intraOpThreads);
+        options.SetInterOpNumThreads(config.interOpThreads);
+    }
+
+    if (sharedArenaRegistered) {
+        options.AddConfigEntry(kOrtSessionOptionsConfigUseEnvAllocators, "1");
+    }
+
+    if (!config.enableMemoryPattern) {
+        options.DisableMemPattern();
+    }
+
+    // No C++ wrapper for this one in 1.20; go through the C API
+    for (const auto& dimension : config.freeDimensionOverrides) {
+        Ort::ThrowOnError(Ort::GetApi().AddFreeDimensionOverrideByName(
+            options, dimension.first.c_str(), dimension.second));
+    }
+
+    if (!IsCpuProvider(config.executionProvider)) {
+        AppendProvider(options, config);
+    }
+
+    return options;
+}
+
+void OrtRuntime::AppendProvider(Ort::SessionOptions& options, const SessionConfig& config) {
+    const std::string& provider = config.executionProvider;
+    try {
+        if (!IsProviderAvailable(provider)) {
+            LogError("Execution provider " + provider + " not in this ONNX Runtime build, using CPU for " + config.logId);
+            return;
+        }
+
+        if (provider == "DirectML") {
+            auto append = reinterpret_cast<AppendDmlProviderFn>(
+                GetProcAddress(GetModuleHandleW(L"onnxruntime.dll"), "OrtSessionOptionsAppendExecutionProvider_DML"));
+            if (!append) {
+                LogError("DirectML entry point missing, using CPU for " + config.logId);
+                return;
+            }
+            // DirectML requires sequential execution without memory patterns
+            options.DisableMemPattern();
+            options.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
+            int deviceId = config.executionDevice.empty() ? 0 : std::stoi(config.executionDevice);
+            Ort::ThrowOnError(append(options, deviceId));
+        } else if (provider == "OpenVINO") {
+            std::unordered_map<std::string, std::string> openVinoOptions;
+            openVinoOptions["device_type"] = config.executionDevice.empty() ? "GPU" : config.executionDevice;
+            options.AppendExecutionProvider_OpenVINO_V2(openVinoOptions);
+        } else {
+            options.AppendExecutionProvider(provider);
+        }
+
+        LogDebug("Using execution provider " + provider +
+                 (config.executionDevice.empty() ? "" : " (" + config.executionDevice + ")") + " for " + config.logId);
+    } catch (const std::exception& e) {
+        LogError("Execution provider " + provider + " unavailable for " +
+                 config.logId + ", using CPU: " + std::string(e.what()));
+    }
+}
+
+bool OrtRuntime::IsProviderAvailable(const std::string& provider) const {
+    std::string ortName = OrtProviderName(provider);
+    return std::find(availableProviders.begin(), availableProviders.end(), ortName) != availableProviders.end();
+}
+
+OrtRuntime::~OrtRuntime() {
+    if (largePageAllocator) {
+        Ort::GetApi().UnregisterAllocator(env, largePageMemoryInfo);
+    }
+}
+
+uint64_t OrtRuntime::RequestArenaShrink() {
+    // No arena to shrink in large-page mode (ORT rejects the run option); the
+    // allocator's cached blocks are what it would have released
+    if (largePageAllocator) {
+        return LargePages::Instance().Trim();
+    }
+    arenaShrinkRequested.store(true);
+    return 0;
+}
+
+Ort::RunOptions OrtRuntime::TakeRunOptions() {
+    if (!arenaShrinkRequested.exchange(false)) {
+        return Ort::RunOptions{nullptr};
+    }
+    Ort::RunOptions options;
+    try {
+        options.AddConfigEntry(kOrtRunOptionsConfigEnableMemoryArenaShrinkage, "cpu:0");
+        arenaShrinks.fetch_add(1);
+    } catch (const Ort::Exception& e) {
+        LogError("Arena shrink not supported: " + std::string(e.what()));
+    }
+    return options;
+}
+
+std::wstring OrtRuntime::ProviderModelPath(const std::wstring& optimizedPath, const std::string& provider) {
+    if (IsCpuProvider(provider) || optimizedPath.empty()) {
+        return optimizedPath;
+    }
+
+    std::wstring tag = L"." + std::wstring(provider.begin(), provider.end());
+    size_t extension = optimizedPath.rfind(L".onnx");
+    if (extension == std::wstring::npos) {
+        return optimizedPath + tag;
+    }
+    return optimizedPath.substr(0, extension) + tag + optimizedPath.substr(extension);
+}
+
+std::wstring OrtRuntime::OrtFormatPath(const std::wstring& optimizedPath) {
+    const std::wstring extension = L".onnx";
+    if (optimizedPath.size() >= extension.size() &&
+        optimizedPath.compare(optimizedPath.size() - extension.size(), extension.size(), extension) == 0) {
+        return optimizedPath.substr(0, optimizedPath.size() - extension.size()) + L".ort";
+    }
+    return optimizedPath + L".ort";
+}
+
+std::shared_ptr<MappedFile> OrtRuntime::MapModel(const std::wstring& path) {
+    std::lock_guard<std::mutex> lock(mappedModelsMutex);
+    auto it = mappedModels.find(path);
+    if (it != mappedModels.end()) {
+        return it->second;
+    }
+
+    auto mapped = std::make_shared<MappedFile>();
+    if (!mapped->Open(path)) {
+        return nullptr;
+    }
+    mappedModels[path] = mapped;
+    return mapped;
+}
+
+std::unique_ptr<Ort::Session> OrtRuntime::CreateFastestSession(const std::wstring& modelPath,
+                                                               const SessionConfig& config,
+                                                               const std::vector<std::string>& candidates,
+                                                               const SessionBenchmark& benchmark,
+                                                               std::string* chosenProvider) {
+    std::unique_ptr<Ort::Session> best;
+    std::string bestProvider;
+    double bestMs = 0.0;
+
+    for (const auto& provider : candidates) {
+        if (!IsProviderAvailable(provider)) {
+            continue;
+        }
+
+        SessionConfig candidateConfig = config;
+        candidateConfig.executionProvider = provider;
+        auto session = CreateSession(modelPath, candidateConfig);
+        if (!session) {
+            continue;
+        }
+
+        // Nothing to time with (or nothing to compare): first working provider wins
+        if (!benchmark || candidates.size() == 1) {
+            best = std::move(session);
+            bestProvider = provider;
+            break;
+        }
+
+        try {
+            benchmark(*session);  // Warm-up: kernel compilation, allocations
+
+            double fastestMs = 0.0;
+            for (int run = 0; run < PROBE_RUNS; ++run) {
+                auto start = std::chrono::steady_clock::now();
+                benchmark(*session);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                fastestMs = (run == 0) ? ms : (std::min)(fastestMs, ms);
+            }
+
+            LogDebug("Probe " + config.logId + " on " + provider + ": " + std::to_string(fastestMs) + "ms");
+            if (!best || fastestMs < bestMs) {
+                best = std::move(session);
+                bestProvider = provider;
+                bestMs = fastestMs;
+            }
+        } catch (const std::exception& e) {
+            LogError("Probe " + config.logId + " on " + provider + " failed: " + std::string(e.what()));
+        }
+    }
+
+    if (!best) {
+        LogError("No execution provider could run " + config.logId);
+        return nullptr;
+    }
+
+    LogDebug("Selected execution provider " + (IsCpuProvider(bestProvider) ? std::string("CPU") : bestProvider) +
+             " for " + config.logId);
+    if (chosenProvider) {
+        *chosenProvider = bestProvider;
+    }
+    return best;
+}
+
+bool OrtRuntime::IsOptimizedModelCurrent(const std::wstring& modelPath, const std::wstring& optimizedPath) {
+    std::error_code ec;
+    if (!std::filesystem::exists(optimizedPath, ec)) {
+        return false;
+    }
+
+    auto sourceTime = std::filesystem::last_write_time(modelPath, ec);
+    if (ec) {
+        return false;
+    }
+    auto optimizedTime = std::filesystem::last_write_time(optimizedPath, ec);
+    return !ec && optimizedTime >= sourceTime;
+}
+
+std::unique_ptr<Ort::Session> OrtRuntime::CreateSession(const std::wstring& modelPath, const SessionConfig& requested) {
+    SessionConfig config = requested;
+    config.optimizedModelPath = ProviderModelPath(requested.optimizedModelPath, requested.executionProvider);
+
+    // GPU providers may leave compiled nodes the ORT format can't hold; keep those as .onnx
+    bool mapModel = config.memoryMapModel && IsCpuProvider(config.executionProvider) &&
+                    !config.optimizedModelPath.empty();
+    if (mapModel) {
+        config.optimizedModelPath = OrtFormatPath(config.optimizedModelPath);
+    }
+
+    if (!config.optimizedModelPath.empty()) {
+        // Later starts: the serialized graph is already optimized, skip the passes
+        if (IsOptimizedModelCurrent(modelPath, config.optimizedModelPath)) {
+            try {
+                SessionConfig cachedConfig = config;
+                cachedConfig.optimizationLevel = GraphOptimizationLevel::ORT_DISABLE_ALL;
+                Ort::SessionOptions options = BuildSessionOptions(cachedConfig);
+
+                // In large-page mode the initializers are copied into the allocator
+                // (large pages) rather than read from the page-cache mapping
+                std::shared_ptr<MappedFile> mapped =
+                    mapModel && !largePageAllocator ? MapModel(config.optimizedModelPath) : nullptr;
+                std::unique_ptr<Ort::Session> session;
+                if (mapped) {
+                    // Initializers alias the mapping instead of being copied to the heap
+                    options.AddConfigEntry(kOrtSessionOptionsConfigLoadModelFormat, "ORT");
+                    options.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesDirectly, "1");
+                    options.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesForInitializers, "1");
+                    session = std::make_unique<Ort::Session>(env, mapped->Data(), mapped->Size(), options);
+                } else {
+                    session = std::make_unique<Ort::Session>(env, config.optimizedModelPath.c_str(), options);
+                }
+                LogDebug("Loaded pre-optimized model for " + config.logId +
+                         (mapped ? " (memory-mapped, " + std::to_string(mapped->Size() / (1024 * 1024)) + " MB)" : ""));
+                return session;
+            } catch (const Ort::Exception& e) {
+                LogError("Pre-optimized model for " + config.logId + " failed to load, rebuilding: " +
+                         std::string(e.what()));
+            }
+        }
+
+        // First start (or stale cache): optimize and serialize while creating the session
+        try {
+            Ort::SessionOptions options = BuildSessionOptions(config);
+            if (mapModel) {
+                options.AddConfigEntry(kOrtSessionOptionsConfigSaveModelFormat, "ORT");
+            }
+            options.SetOptimizedModelFilePath(config.optimizedModelPath.c_str());
+            auto session = std::make_unique<Ort::Session>(env, modelPath.c_str(), options);
+            LogDebug("Optimized and cached model for " + config.logId);
+            return session;
+        } catch (const Ort::Exception& e) {
+            LogError("Failed to optimize " + config.logId + ": " + std::string(e.what()));
+            std::error_code ec;
+            std::filesystem::remove(config.optimizedModelPath, ec);
+            return nullptr;
+        }
+    }
+
+    try {
+        Ort::SessionOptions options = BuildSessionOptions(config);
+        return std::make_unique<Ort::Session>(env, modelPath.c_str(), options);
+    } catch (const Ort::Exception& e) {
+        LogError("Failed to create session for " + config.logId + ": " + std::string(e.what()));
+        return nullptr;
+    }
+}
+
+void OrtRuntime::LogDebug(const std::string& message) {
+    std::cout << "[OrtRuntime] " << message << std::endl;
+}
+
+void OrtRuntime::LogError(const std::string& message) {
+    std::cerr << "[OrtRuntime ERROR] " << message << std::endl;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <onnxruntime_cxx_api.h>
+#include "MappedFile.h"
+
+/**
+ * OrtRuntime - Process-wide ONNX Runtime environment and session factory
+ *
+ * Owns the single Ort::Env shared by SileroVAD and CameraVisionEngine, so
+ * voice and vision inference draw from one set of intra-op threads and one
+ * arena instead of each engine oversubscribing the CPU with its own.
+ *
+ * Features:
+ * - One Ort::Env with global intra/inter-op thread pools; sessions call
+ *   DisablePerSessionThreads() and share them (opt out via SessionConfig).
+ *   The pool is sized from CpuBudget's Vision share and its threads run
+ *   with the Vision priority/core mask
+ * - Shared CPU arena allocator registered on the env ("session.use_env_allocators");
+ *   with LargePages enabled, an allocator over large pages instead, which
+ *   also takes the initializers a memory-mapped model would have aliased
+ * - Consistent session configuration: optimization level, execution provider,
+ *   memory pattern, per-session thread counts when not using the global pool
+ * - Offline-optimized model cache: optimize once, serialize, then load the
+ *   pre-optimized file (optimizations off) on later starts
+ * - Memory-mapped weights: CPU caches are written in ORT format and loaded
+ *   from a mapped view with initializers used in place, so weights sit in the
+ *   shared page cache rather than each process's private heap
+ * - Execution providers: "CPU", "DirectML", "OpenVINO" (or any name ORT's
+ *   generic AppendExecutionProvider accepts); unavailable ones fall back to CPU
+ * - Startup probe: CreateFastestSession() times a caller-supplied inference on
+ *   each available candidate provider and keeps the fastest session
+ *
+ * Usage:
+ *   OrtRuntime::SessionConfig config;
+ *   config.optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+ *   config.logId = "SileroVAD";
+ *   auto session = OrtRuntime::Instance().CreateSession(L"models/vad/silero_vad.onnx", config);
+ */
+class OrtRuntime {
+public:
+    struct SessionConfig {
+        GraphOptimizationLevel optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+
+        // Share the env's global thread pools (recommended). When false, the
+        // session gets its own pools sized by the thread counts below.
+        bool useGlobalThreadPool = true;
+        int intraOpThreads = 1;
+        int interOpThreads = 1;
+
+        // Execution provider: "" / "CPU" (default), "DirectML", "OpenVINO", or a
+        // name for SessionOptions::AppendExecutionProvider; falls back to CPU if
+        // unavailable. executionDevice is the OpenVINO device_type ("GPU",
+        // "NPU", ...) or the DirectML adapter index (default 0).
+        std::string executionProvider;
+        std::string executionDevice;
+
+        bool enableMemoryPattern = true;
+        std::string logId;
+
+        // Symbolic dimension overrides (AddFreeDimensionOverrideByName), e.g.
+        // {"batch_size", 1}; names the model doesn't use are ignored by ORT
+        std::vector<std::pair<std::string, int64_t>> freeDimensionOverrides;
+
+        // When set, the first start optimizes at optimizationLevel and writes the
+        // result here; later starts load it with optimizations disabled. Rebuilt
+        // when the source model is newer or the cached file fails to load.
+        // Non-CPU providers get their own file (<path>.<provider> before .onnx)
+        // since the optimized graph is provider-specific.
+        std::wstring optimizedModelPath;
+
+        // CPU only: write the optimized cache as <path>.ort (ORT format) and load
+        // it through CreateSessionFromArray over a memory-mapped view, with ORT
+        // reading initializers straight out of the mapping
+        bool memoryMapModel = true;
+    };
+
+    // One timed inference on a freshly created session (throws on failure)
+    using SessionBenchmark = std::function<void(Ort::Session&)>;
+
+    static OrtRuntime& Instance();
+
+    // Size of the global intra-op pool; must be called before the first
+    // Instance() (the env is built then). 0 = CpuBudget's Vision share
+    static void SetGlobalIntraOpThreads(int threads);
+
+    OrtRuntime(const OrtRuntime&) = delete;
+    OrtRuntime& operator=(const OrtRuntime&) = delete;
+
+    // Create a session for modelPath; returns nullptr (and logs) on failure
+    std::unique_ptr<Ort::Session> CreateSession(const std::wstring& modelPath, const SessionConfig& config);
+
+    // Create a session per available candidate provider (config.executionProvider
+    // is overridden), time `benchmark` on each and return the fastest; the choice
+    // is logged and written to chosenProvider. Returns nullptr if none work.
+    std::unique_ptr<Ort::Session> CreateFastestSession(const std::wstring& modelPath, const SessionConfig& config,
+                                                       const std::vector<std::string>& candidates,
+                                                       const SessionBenchmark& benchmark,
+                                                       std::string* chosenProvider = nullptr);
+
+    // True if this ORT build ships the provider ("CPU", "DirectML", "OpenVINO", ...)
+    bool IsProviderAvailable(const std::string& provider) const;
+
+    Ort::Env& GetEnv() { return env; }
+    const Ort::MemoryInfo& GetCpuMemoryInfo() const { return cpuMemoryInfo; }
+
+    int GetGlobalIntraOpThreads() const { return globalIntraOpThreads; }
+
+    // Ask the shared CPU arena to hand its free chunks back to the OS. ORT
+    // only shrinks an arena at the end of a Run whose RunOptions ask for it,
+    // so this takes effect on the next run that uses TakeRunOptions() (and
+    // returns 0); the large-page allocator releases its cache at once and
+    // returns the bytes
+    uint64_t RequestArenaShrink();
+
+    // RunOptions for a hot-path Run: empty, or once after RequestArenaShrink()
+    // with memory.enable_memory_arena_shrinkage set for the CPU arena
+    Ort::RunOptions TakeRunOptions();
+
+    uint64_t GetArenaShrinks() const { return arenaShrinks.load(); }
+
+private:
+    struct LargePageAllocator;
+
+    OrtRuntime();
+    ~OrtRuntime();
+
+    Ort::SessionOptions BuildSessionOptions(const SessionConfig& config);
+
+    // True if optimizedPath exists and is at least as new as modelPath
+    static bool IsOptimizedModelCurrent(const std::wstring& modelPath, const std::wstring& optimizedPath);
+
+    // Provider-specific optimized model path (unchanged for CPU)
+    static std::wstring ProviderModelPath(const std::wstring& optimizedPath, const std::string& provider);
+
+    void AppendProvider(Ort::SessionOptions& options, const SessionConfig& config);
+
+    // <path>.ort in place of a trailing .onnx
+    static std::wstring OrtFormatPath(const std::wstring& optimizedPath);
+
+    // Mapping for an ORT-format cache, shared by every session (and reload) using it;
+    // nullptr if the file can't be mapped
+    std::shared_ptr<MappedFile> MapModel(const std::wstring& path);
+
+    static int requestedIntraOpThreads;
+
+    static constexpr int PROBE_RUNS = 3;       // Timed runs per provider after one warm-up
+
+    std::vector<std::string> availableProviders;   // ORT names, e.g. "DmlExecutionProvider"
+
+    int globalIntraOpThreads;
+    int globalInterOpThreads;
+
+    Ort::Env env;
+    Ort::MemoryInfo cpuMemoryInfo;
+    bool sharedArenaRegistered;
+
+    // Large-page mode (LargePages active before the env was built): registered
+    // on the env in place of the arena
+    Ort::MemoryInfo largePageMemoryInfo{ nullptr };
+    std::unique_ptr<LargePageAllocator> largePageAllocator;
+
+    std::atomic<bool> arenaShrinkRequested{false};
+    std::atomic<uint64_t> arenaShrinks{0};
+
+    // Never unmapped: sessions built from a view read their weights from it,
+    // and a reload after an idle unload reuses the mapping. A cache that goes
+    // stale while mapped can't be rewritten until the next start (the rebuild
+    // fails and the caller falls back to the source model).
+    std::unordered_map<std::wstring, std::shared_ptr<MappedFile>> mappedModels;
+    std::mutex mappedModelsMutex;
+
+    void LogDebug(const std::string& message);
+    void LogError(const std::string& message);
+};
@@ -0,0 +1,62 @@
+#include "PipelineLatency.h"
+#include "Experiments.h"
+#include <cstdio>
+
+static const char* const STAGE_NAMES[] = {
+    "capture", "resample", "vad", "queue_wait", "whisper", "preprocess",
+    "encoder", "prefill", "decode_token", "json_build", "http_send",
+    "silence_hold", "result_pickup", "utterance_end_to_end"
+};
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == static_cast<size_t>(PipelineLatency::Stage::Count),
+              "every stage needs a name");
+
+static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+LatencyHistogram& PipelineLatency::Get(Stage stage) {
+    // Leaked like the other process-wide caches: recorders may run during exit
+    static LatencyHistogram* histograms = new LatencyHistogram[static_cast<size_t>(Stage::Count)];
+    return histograms[static_cast<size_t>(stage)];
+}
+
+void PipelineLatency::Record(Stage stage, double millis) {
+    Get(stage).RecordMs(millis);
+    Experiments::Instance().Record(stage, millis);
+}
+
+const char* PipelineLatency::StageName(Stage stage) {
+    size_t index = static_cast<size_t>(stage);
+    return index < static_cast<size_t>(Stage::Count) ? STAGE_NAMES[index] : "unknown";
+}
+
+std::string PipelineLatency::FormatPrometheus() {
+    std::string out;
+    out.reserve(4096);
+    out += "# HELP perception_stage_latency_seconds Pipeline stage latency since start\n";
+    out += "# TYPE perception_stage_latency_seconds summary\n";
+
+    char line[160];
+    for (size_t index = 0; index < static_cast<size_t>(Stage::Count); ++index) {
+        const LatencyHistogram& histogram = Get(static_cast<Stage>(index));
+        const char* name = STAGE_NAMES[index];
+        for (double quantile : QUANTILES) {
+            std::snprintf(line, sizeof(line), "perception_stage_latency_seconds{stage=\"%s\",quantile=\"%g\"} %.6f\n",
+                          name, quantile, histogram.QuantileMs(quantile) / 1000.0);
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "perception_stage_latency_seconds_sum{stage=\"%s\"} %.6f\n",
+                      name, histogram.SumMs() / 1000.0);
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_stage_latency_seconds_count{stage=\"%s\"} %llu\n",
+                      name, static_cast<unsigned long long>(histogram.Count()));
+        out += line;
+    }
+
+    out += "# HELP perception_stage_latency_max_seconds Slowest recorded run per stage\n";
+    out += "# TYPE perception_stage_latency_max_seconds gauge\n";
+    for (size_t index = 0; index < static_cast<size_t>(Stage::Count); ++index) {
+        std::snprintf(line, sizeof(line), "perception_stage_latency_max_seconds{stage=\"%s\"} %.6f\n",
+                      STAGE_NAMES[index], Get(static_cast<Stage>(index)).MaxMs() / 1000.0);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/**
+ * PipelineLatency - One LatencyHistogram per pipeline stage, for /metrics
+ *
+ * Stages record where the work happens (a capture packet, one VAD batch,
+ * one decoder step...); the voice hops between stages come from completed
+ * UtteranceTracer traces. FormatPrometheus() renders every stage as a
+ * Prometheus summary - p50/p90/p99/p999, sum and count since start - so tail
+ * latency can be scraped and alerted on instead of read off "last" fields.
+ *
+ * Usage:
+ *   PipelineLatency::Record(PipelineLatency::Stage::Vad, elapsedMs);
+ *   { PipelineLatency::Timer timer(PipelineLatency::Stage::Encoder); RunEncoder(); }
+ *   response.SetBody(PipelineLatency::FormatPrometheus());
+ *
+ * Recording is lock-free (see LatencyHistogram).
+ */
+class PipelineLatency {
+public:
+    enum class Stage {
+        Capture,            // WASAPI packet: GetBuffer to ReleaseBuffer
+        Resample,           // Packet conversion to 16 kHz mono
+        Vad,                // Per 30 ms frame
+        QueueWait,          // Utterance waiting for a whisper worker
+        Whisper,            // Final transcription
+        Preprocess,         // Camera frame to pixel values
+        Encoder,            // Vision encoder run
+        Prefill,            // First decoder pass over the prompt
+        DecodeToken,        // Per generated token
+        JsonBuild,          // Context document snapshot
+        HttpSend,           // Response queued to fully sent
+        SilenceHold,        // Last speech frame to the utterance being cut (UtteranceTracer)
+        ResultPickup,       // Transcription ready until handed to the transcription callback
+        UtteranceEndToEnd,  // Last speech frame to the context update
+        Count
+    };
+
+    static void Record(Stage stage, double millis);
+    static LatencyHistogram& Get(Stage stage);
+
+    // Prometheus text exposition format (version 0.0.4), seconds
+    static std::string FormatPrometheus();
+
+    static const char* StageName(Stage stage);
+
+    // Records the lifetime of the scope
+    class Timer {
+    public:
+        explicit Timer(Stage stage) : stage(stage), start(std::chrono::steady_clock::now()) {}
+        ~Timer() {
+            Record(stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Stage stage;
+        std::chrono::steady_clock::time_point start;
+    };
+};
@@ -0,0 +1,326 @@
+#include "PowerPolicy.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "CpuBudget.h"
+#include "Log.h"
+#include "Trace.h"
+
+// Power setting GUIDs (winnt.h declares them, but only defines them with
+// INITGUID, so they're spelled out here)
+static const GUID POWER_ACDC_SOURCE =
+    { 0x5d3e9a59, 0xe9d5, 0x4b00, { 0xa6, 0xbd, 0xff, 0x34, 0xff, 0x51, 0x65, 0x48 } };
+static const GUID POWER_SAVING_STATUS =
+    { 0xe00958c0, 0xc213, 0x4ace, { 0xac, 0x77, 0xfe, 0xcc, 0xed, 0x2e, 0xee, 0xa5 } };
+static const GUID POWER_ENERGY_SAVER_STATUS =
+    { 0x550e8400, 0xe29b, 0x41d4, { 0xa7, 0x16, 0x44, 0x66, 0x55, 0x44, 0x00, 0x00 } };
+static const GUID POWER_BATTERY_PERCENTAGE =
+    { 0xa7ad8041, 0xb45a, 0x4cae, { 0x87, 0xa3, 0xee, 0xcb, 0xb4, 0x68, 0xa9, 0xe1 } };
+static const GUID POWER_LIDSWITCH_STATE =
+    { 0xba3e0f4d, 0xb817, 0x4094, { 0xa2, 0xd1, 0xd5, 0x63, 0x79, 0xe6, 0xa0, 0xf3 } };
+static const GUID POWER_CONSOLE_DISPLAY_STATE =
+    { 0x6fe69556, 0x704a, 0x47a0, { 0x8f, 0x24, 0xc2, 0x8d, 0x93, 0x6f, 0xda, 0x47 } };
+
+PowerPolicy::~PowerPolicy() {
+    Stop();
+}
+
+std::vector<GUID> PowerPolicy::WatchedSettings() {
+    return { POWER_ACDC_SOURCE, POWER_SAVING_STATUS, POWER_ENERGY_SAVER_STATUS, POWER_BATTERY_PERCENTAGE,
+             POWER_LIDSWITCH_STATE, POWER_CONSOLE_DISPLAY_STATE };
+}
+
+bool PowerPolicy::Start(bool watch) {
+    if (thread.joinable()) {
+        return true;
+    }
+
+    // Seed from the status call: the notifications' first delivery is asynchronous
+    SYSTEM_POWER_STATUS status = {};
+    if (GetSystemPowerStatus(&status)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        state.onAc = status.ACLineStatus != 0;           // 255 (unknown) counts as AC
+        state.batterySaver = (status.SystemStatusFlag & 1) != 0;
+        state.batteryPercent = status.BatteryLifePercent <= 100 ? status.BatteryLifePercent : -1;
+        stateGeneration++;
+    }
+    Update();
+    if (!watch) {
+        return true;
+    }
+
+    HANDLE ready = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    thread = std::thread(&PowerPolicy::MessageLoop, this, ready);
+    WaitForSingleObject(ready, INFINITE);
+    CloseHandle(ready);
+    if (!window) {
+        LOG_WARNING("Power", "Power notifications unavailable; staying " << ProfileName(GetProfile()));
+        if (thread.joinable()) {
+            thread.join();
+        }
+        return false;
+    }
+    return true;
+}
+
+void PowerPolicy::Stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    if (threadId) {
+        PostThreadMessageW(threadId, WM_QUIT, 0, 0);
+    }
+    thread.join();
+    threadId = 0;
+}
+
+void PowerPolicy::MessageLoop(HANDLE ready) {
+    TRACE_THREAD("Power notifications");
+    threadId = GetCurrentThreadId();
+
+    // Force this thread's message queue into existence before anyone can post WM_QUIT
+    MSG msg;
+    PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+
+    const wchar_t* className = L"PerceptionPowerPolicyClass";
+    WNDCLASSEXW wc = { 0 };
+    wc.cbSize = sizeof(WNDCLASSEXW);
+    wc.lpfnWndProc = WindowProc;
+    wc.hInstance = GetModuleHandle(nullptr);
+    wc.lpszClassName = className;
+    if (!RegisterClassExW(&wc) && ::GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+        SetEvent(ready);
+        return;
+    }
+    HWND hwnd = CreateWindowExW(0, className, L"", 0, 0, 0, 0, 0,
+                                HWND_MESSAGE, nullptr, GetModuleHandle(nullptr), nullptr);
+    if (!hwnd) {
+        UnregisterClassW(className, GetModuleHandle(nullptr));
+        SetEvent(ready);
+        return;
+    }
+    SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+
+    // Each registration delivers the current value once, then every change
+    std::vector<HPOWERNOTIFY> registrations;
+    for (const GUID& setting : WatchedSettings()) {
+        HPOWERNOTIFY registration = RegisterPowerSettingNotification(hwnd, &setting, DEVICE_NOTIFY_WINDOW_HANDLE);
+        if (registration) {
+            registrations.push_back(registration);
+        }
+    }
+    window = hwnd;
+    SetEvent(ready);
+    LOG_DEBUG("Power", "Watching " << registrations.size() << " power settings");
+
+    while (GetMessageW(&msg, nullptr, 0, 0) > 0) {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+
+    for (HPOWERNOTIFY registration : registrations) {
+        UnregisterPowerSettingNotification(registration);
+    }
+    window = nullptr;
+    DestroyWindow(hwnd);
+    UnregisterClassW(className, GetModuleHandle(nullptr));
+}
+
+LRESULT CALLBACK PowerPolicy::WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_POWERBROADCAST && wParam == PBT_POWERSETTINGCHANGE) {
+        auto* policy = reinterpret_cast<PowerPolicy*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+        auto* setting = reinterpret_cast<const POWERBROADCAST_SETTING*>(lParam);
+        if (policy && setting) {
+            policy->HandleSetting(setting->PowerSetting, setting->Data, setting->DataLength);
+        }
+        return TRUE;
+    }
+    return DefWindowProcW(hwnd, message, wParam, lParam);
+}
+
+void PowerPolicy::HandleSetting(const GUID& setting, const void* data, size_t size) {
+    // Every setting watched here carries one DWORD
+    if (!data || size < sizeof(DWORD)) {
+        return;
+    }
+    DWORD value;
+    std::memcpy(&value, data, sizeof(value));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (IsEqualGUID(setting, POWER_ACDC_SOURCE)) {
+            state.onAc = value == PoAc;                     // PoDc, or PoHot (UPS) on short-term power
+        } else if (IsEqualGUID(setting, POWER_SAVING_STATUS)) {
+            state.batterySaver = value != 0;
+        } else if (IsEqualGUID(setting, POWER_ENERGY_SAVER_STATUS)) {
+            state.energySaver = value != 0;                 // ENERGY_SAVER_STANDARD or _HIGH_SAVINGS
+        } else if (IsEqualGUID(setting, POWER_BATTERY_PERCENTAGE)) {
+            state.batteryPercent = static_cast<int>((std::min)(value, static_cast<DWORD>(100)));
+        } else if (IsEqualGUID(setting, POWER_LIDSWITCH_STATE)) {
+            state.lidOpen = value != 0;
+        } else if (IsEqualGUID(setting, POWER_CONSOLE_DISPLAY_STATE)) {
+            state.displayOn = value != 0;                   // Dimmed (2) still counts as on
+        } else {
+            return;
+        }
+        stateGeneration++;
+    }
+    Update();
+}
+
+void PowerPolicy::SetForcedProfile(std::optional<Profile> profile) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        forced = profile;
+    }
+    LOG_INFO("Power", "Profile " << (profile ? std::string("forced to ") + ProfileName(*profile)
+                                             : std::string("follows the power state")));
+    Update();
+}
+
+void PowerPolicy::Update() {
+    std::lock_guard<std::mutex> callbackLock(callbackMutex);
+    Profile next;
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        next = forced ? *forced : Classify(state);
+        changed = !announced || next != profile;
+        profile = next;
+        announced = true;
+    }
+    if (!changed) {
+        return;
+    }
+    LOG_INFO("Power", "Power profile " << ProfileName(next));
+    if (profileCallback) {
+        profileCallback(next, SettingsFor(next));
+    }
+}
+
+PowerPolicy::Profile PowerPolicy::GetProfile() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return profile;
+}
+
+PowerPolicy::State PowerPolicy::GetState() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state;
+}
+
+PowerPolicy::Settings PowerPolicy::GetSettings() const {
+    return SettingsFor(GetProfile());
+}
+
+PowerPolicy::Profile PowerPolicy::Classify(const State& state) {
+    if (!state.displayOn || !state.lidOpen) {
+        return Profile::Away;
+    }
+    if (state.batterySaver || state.energySaver ||
+        (!state.onAc && state.batteryPercent >= 0 && state.batteryPercent < LOW_BATTERY_PERCENT)) {
+        return Profile::Saver;
+    }
+    return state.onAc ? Profile::Performance : Profile::Balanced;
+}
+
+PowerPolicy::Settings PowerPolicy::SettingsFor(Profile profile) {
+    int budget = CpuBudget::Instance().Get(CpuBudget::Subsystem::Whisper).threads;
+    Settings settings;
+    switch (profile) {
+        case Profile::Performance:
+            break;
+        case Profile::Balanced:
+            settings.whisperThreadCap = (std::max)(1, budget / 2);
+            settings.vadTickMs = 20;
+            settings.backgroundEcoQos = true;
+            break;
+        case Profile::Saver:
+            settings.preferFastWhisper = true;
+            settings.whisperThreadCap = 2;
+            settings.vadTickMs = 40;
+            settings.cameraIntervalScale = 3;
+            settings.backgroundEcoQos = true;
+            break;
+        case Profile::Away:
+            settings.preferFastWhisper = true;
+            settings.whisperThreadCap = 2;
+            settings.vadTickMs = 64;
+            settings.cameraPaused = true;
+            settings.backgroundEcoQos = true;
+            settings.processEcoQos = true;
+            break;
+    }
+    return settings;
+}
+
+const char* PowerPolicy::ProfileName(Profile profile) {
+    switch (profile) {
+        case Profile::Performance: return "performance";
+        case Profile::Balanced:    return "balanced";
+        case Profile::Saver:       return "saver";
+        case Profile::Away:        return "away";
+    }
+    return "unknown";
+}
+
+bool PowerPolicy::ParseProfile(std::string_view name, Profile& profile) {
+    for (Profile candidate : { Profile::Performance, Profile::Balanced, Profile::Saver, Profile::Away }) {
+        if (name == ProfileName(candidate)) {
+            profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PowerPolicy::SetProcessEcoQos(bool enabled) {
+    PROCESS_POWER_THROTTLING_STATE throttling = {};
+    throttling.Version = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+    throttling.ControlMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+    throttling.StateMask = enabled ? PROCESS_POWER_THROTTLING_EXECUTION_SPEED : 0;
+    return SetProcessInformation(GetCurrentProcess(), ProcessPowerThrottling,
+                                 &throttling, sizeof(throttling)) != FALSE;
+}
+
+bool PowerPolicy::SetThreadEcoQos(bool enabled) {
+    THREAD_POWER_THROTTLING_STATE throttling = {};
+    throttling.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+    throttling.ControlMask = THREAD_POWER_THROTTLING_EXECUTION_SPEED;
+    throttling.StateMask = enabled ? THREAD_POWER_THROTTLING_EXECUTION_SPEED : 0;
+    return SetThreadInformation(GetCurrentThread(), ThreadPowerThrottling,
+                                &throttling, sizeof(throttling)) != FALSE;
+}
+
+void PowerPolicy::Write(JsonWriter& writer) const {
+    State current;
+    Profile active;
+    std::optional<Profile> pinned;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = state;
+        active = profile;
+        pinned = forced;
+    }
+    Settings settings = SettingsFor(active);
+
+    writer.BeginObject();
+    writer.Key("profile").String(ProfileName(active));
+    writer.Key("forced").Bool(pinned.has_value());
+    writer.Key("state").BeginObject();
+    writer.Key("onAc").Bool(current.onAc);
+    writer.Key("batterySaver").Bool(current.batterySaver);
+    writer.Key("energySaver").Bool(current.energySaver);
+    writer.Key("batteryPercent").Int(current.batteryPercent);
+    writer.Key("lidOpen").Bool(current.lidOpen);
+    writer.Key("displayOn").Bool(current.displayOn);
+    writer.EndObject();
+    writer.Key("settings").BeginObject();
+    writer.Key("preferFastWhisper").Bool(settings.preferFastWhisper);
+    writer.Key("whisperThreadCap").Int(settings.whisperThreadCap);
+    writer.Key("vadTickMs").Int(settings.vadTickMs);
+    writer.Key("cameraIntervalScale").Int(settings.cameraIntervalScale);
+    writer.Key("cameraPaused").Bool(settings.cameraPaused);
+    writer.Key("backgroundEcoQos").Bool(settings.backgroundEcoQos);
+    writer.Key("processEcoQos").Bool(settings.processEcoQos);
+    writer.EndObject();
+    writer.EndObject();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "JsonWriter.h"
+
+/**
+ * PowerPolicy - Engine throttling that follows the machine's power state
+ *
+ * The engines used to run flat out whatever the laptop was doing: on
+ * battery with the lid closed the processing thread still woke every 10 ms
+ * and every utterance went to the primary whisper model on every Whisper
+ * core. PowerPolicy watches the power state Windows reports and maps it to
+ * one of four profiles, each a set of Settings the host applies:
+ *
+ *   Profile       When                                   Whisper threads   VAD tick  Fast tier  EcoQoS                 Camera
+ *   Performance   on AC                                  CpuBudget split   10 ms     -          -                      normal
+ *   Balanced      on battery                             half              20 ms     -          background threads     normal
+ *   Saver         battery/energy saver on, or DC < 20%   2                 40 ms     yes        background threads     interval x3
+ *   Away          display off or lid closed              2                 64 ms     yes        whole process          paused
+ *
+ * EcoQoS (power throttling) lets the scheduler run a thread on efficiency
+ * cores at a low clock: background threads (the caption loop) get it from
+ * Balanced down, the whole process only while nobody is looking (Away).
+ *
+ * Signals come from RegisterPowerSettingNotification on a message-only
+ * window (AC/DC source, battery saver, Windows 11 energy saver, battery
+ * percentage, lid switch, console display). The same state feeds the
+ * context's battery and isCharging fields (GetState, polled by generation),
+ * so nothing calls GetSystemPowerStatus after Start. A service, which has no desktop to own that window,
+ * starts without it (Start(false)), registers WatchedSettings() against its
+ * service handle and forwards the PBT_POWERSETTINGCHANGE payloads to
+ * HandleSetting().
+ *
+ * Usage:
+ *   PowerPolicy power;
+ *   power.SetProfileCallback([&](PowerPolicy::Profile profile, const PowerPolicy::Settings& settings) { ... });
+ *   power.Start();
+ *   power.SetForcedProfile(PowerPolicy::Profile::Saver);   // POST /power?profile=saver
+ *   power.Stop();
+ *
+ * The callback runs on the notification thread (or the caller of
+ * SetForcedProfile / HandleSetting), once per profile change, never
+ * concurrently with itself. Thread-safe.
+ */
+class PowerPolicy {
+public:
+    enum class Profile { Performance, Balanced, Saver, Away };
+
+    static constexpr int LOW_BATTERY_PERCENT = 20;
+
+    // What Windows last reported
+    struct State {
+        bool onAc = true;
+        bool batterySaver = false;
+        bool energySaver = false;           // Windows 11 energy saver (standard or high savings)
+        int batteryPercent = -1;            // -1 when unknown (desktops)
+        bool lidOpen = true;
+        bool displayOn = true;
+    };
+
+    // What the host applies for a profile
+    struct Settings {
+        bool preferFastWhisper = false;     // Every utterance to the fast whisper tier
+        int whisperThreadCap = 0;           // Threads per whisper worker (0: the CpuBudget split)
+        int vadTickMs = 10;                 // Processing thread wake-up
+        int cameraIntervalScale = 1;        // CameraCadence::SetPowerScale
+        bool cameraPaused = false;          // No periodic captions (/describe still answers)
+        bool backgroundEcoQos = false;      // EcoQoS on the caption loop
+        bool processEcoQos = false;         // EcoQoS on the whole process
+    };
+
+    using ProfileCallback = std::function<void(Profile, const Settings&)>;
+
+    PowerPolicy() = default;
+    ~PowerPolicy();
+
+    PowerPolicy(const PowerPolicy&) = delete;
+    PowerPolicy& operator=(const PowerPolicy&) = delete;
+
+    /**
+     * @brief Read the current power status and start the notification thread
+     * @param watch false: no window; the caller forwards notifications to HandleSetting()
+     * @return false when the notification window couldn't be created (the
+     *         profile then stays at what the initial status implies)
+     */
+    bool Start(bool watch = true);
+    void Stop();
+
+    /**
+     * @brief The power settings HandleSetting() understands, for RegisterPowerSettingNotification
+     */
+    static std::vector<GUID> WatchedSettings();
+
+    /**
+     * @brief Called on every profile change; set before Start()
+     */
+    void SetProfileCallback(ProfileCallback callback) { profileCallback = std::move(callback); }
+
+    /**
+     * @brief Pin a profile whatever the power state (nullopt: follow it again)
+     */
+    void SetForcedProfile(std::optional<Profile> profile);
+
+    /**
+     * @brief Apply one POWERBROADCAST_SETTING payload (PowerSetting GUID, Data, DataLength)
+     */
+    void HandleSetting(const GUID& setting, const void* data, size_t size);
+
+    Profile GetProfile() const;
+    Settings GetSettings() const;
+    State GetState() const;
+
+    // Bumped whenever a notification (or Start's seeding) updates the state
+    uint64_t GetStateGeneration() const { return stateGeneration.load(); }
+
+    /**
+     * @brief The profile a power state maps to
+     */
+    static Profile Classify(const State& state);
+
+    /**
+     * @brief A profile's settings; whisper caps derive from the CpuBudget Whisper split
+     */
+    static Settings SettingsFor(Profile profile);
+
+    static const char* ProfileName(Profile profile);
+    static bool ParseProfile(std::string_view name, Profile& profile);
+
+    /**
+     * @brief EcoQoS on or off for the process / the calling thread
+     * @return false when the OS doesn't support power throttling (before Windows 10 1709)
+     */
+    static bool SetProcessEcoQos(bool enabled);
+    static bool SetThreadEcoQos(bool enabled);
+
+    /**
+     * @brief {"profile", "forced", "state": {...}, "settings": {...}}
+     */
+    void Write(JsonWriter& writer) const;
+
+private:
+    mutable std::mutex mutex;
+    State state;
+    std::atomic<uint64_t> stateGeneration{0};
+    std::optional<Profile> forced;
+    Profile profile = Profile::Performance;
+    bool announced = false;                 // The callback has seen a profile
+
+    // Serializes the callback; taken before mutex, never under it
+    std::mutex callbackMutex;
+    ProfileCallback profileCallback;
+
+    std::thread thread;
+    DWORD threadId = 0;
+    HWND window = nullptr;
+
+    void MessageLoop(HANDLE ready);
+    void Update();
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
+};
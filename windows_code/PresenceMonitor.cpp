@@ -0,0 +1,234 @@
+#include "PresenceMonitor.h"
+#include <algorithm>
+#include "Log.h"
+#include "Trace.h"
+
+static bool InInteractiveSession() {
+    DWORD session = 0;
+    return ProcessIdToSessionId(GetCurrentProcessId(), &session) && session != 0;
+}
+
+PresenceMonitor::PresenceMonitor()
+    : inputVisible(InInteractiveSession())
+{
+}
+
+PresenceMonitor::~PresenceMonitor() {
+    Stop();
+}
+
+int64_t PresenceMonitor::NowMs() {
+    return static_cast<int64_t>(GetTickCount64());
+}
+
+void PresenceMonitor::SetThresholds(int idle, int away) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle == idleMs && away == awayMs) {
+            return;
+        }
+        idleMs = idle;
+        awayMs = away;
+        recheck = true;
+    }
+    wake.notify_all();
+}
+
+void PresenceMonitor::Start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    if (!inputVisible) {
+        LOG_INFO("Presence", "No user input visible in session 0; presence follows the session lock");
+    }
+    thread = std::thread(&PresenceMonitor::Run, this);
+}
+
+void PresenceMonitor::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void PresenceMonitor::SetSessionLocked(bool locked) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sessionLocked == locked) {
+            return;
+        }
+        sessionLocked = locked;
+        recheck = true;
+    }
+    wake.notify_all();
+}
+
+void PresenceMonitor::ReportActivity() {
+    lastActivityMs.store(NowMs());
+    // While Present the next scheduled check sees it; otherwise it ends Idle / Away now
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (state == State::Present) {
+            return;
+        }
+        recheck = true;
+    }
+    wake.notify_all();
+}
+
+void PresenceMonitor::Run() {
+    TRACE_THREAD("Presence");
+    while (true) {
+        int64_t waitMs = Update();
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait_for(lock, std::chrono::milliseconds(waitMs), [this]() { return recheck || !running; });
+        recheck = false;
+        if (!running) {
+            break;
+        }
+    }
+}
+
+PresenceMonitor::Signals PresenceMonitor::Sample() const {
+    Signals sample;
+    // dwTime is a 32-bit tick count; the difference wraps correctly in 32 bits
+    LASTINPUTINFO input = {};
+    input.cbSize = sizeof(input);
+    if (inputVisible && GetLastInputInfo(&input)) {
+        sample.inputIdleMs = static_cast<int64_t>(static_cast<DWORD>(GetTickCount() - input.dwTime));
+    }
+    int64_t activity = lastActivityMs.load();
+    if (activity >= 0) {
+        sample.activityIdleMs = (std::max)(static_cast<int64_t>(0), NowMs() - activity);
+    }
+    return sample;
+}
+
+int64_t PresenceMonitor::Update() {
+    Signals signals = Sample();
+    State next;
+    bool changed;
+    int64_t waitMs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        signals.sessionLocked = sessionLocked;
+        next = Classify(signals, idleMs, awayMs);
+        changed = !announced || next != state;
+        state = next;
+        announced = true;
+        lastSignals = signals;
+
+        waitMs = POLL_MS;
+        if (next == State::Present) {
+            waitMs = PRESENT_CHECK_MS;
+            if (idleMs > 0 && signals.inputIdleMs >= 0) {
+                int64_t quietMs = signals.inputIdleMs;
+                if (signals.activityIdleMs >= 0) {
+                    quietMs = (std::min)(quietMs, signals.activityIdleMs);
+                }
+                waitMs = std::clamp(idleMs - quietMs, static_cast<int64_t>(POLL_MS),
+                                    static_cast<int64_t>(PRESENT_CHECK_MS));
+            }
+        }
+    }
+    if (changed) {
+        LOG_INFO("Presence", "User " << StateName(next));
+        if (stateCallback) {
+            stateCallback(next, SettingsFor(next));
+        }
+    }
+    return waitMs;
+}
+
+PresenceMonitor::State PresenceMonitor::GetState() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state;
+}
+
+PresenceMonitor::State PresenceMonitor::Classify(const Signals& signals, int idleMs, int awayMs) {
+    if (signals.sessionLocked) {
+        return State::Away;
+    }
+    if (idleMs <= 0 || signals.inputIdleMs < 0) {
+        return State::Present;
+    }
+    // Quiet since the later of the last input and the last time the camera saw someone
+    int64_t quietMs = signals.inputIdleMs;
+    if (signals.activityIdleMs >= 0) {
+        quietMs = (std::min)(quietMs, signals.activityIdleMs);
+    }
+    if (quietMs >= awayMs) {
+        return State::Away;
+    }
+    return quietMs >= idleMs ? State::Idle : State::Present;
+}
+
+PresenceMonitor::Settings PresenceMonitor::SettingsFor(State state) {
+    Settings settings;
+    switch (state) {
+        case State::Present:
+            break;
+        case State::Idle:
+            settings.cameraIntervalScale = 3;
+            settings.contextRefreshScale = 4;
+            settings.screenPaused = true;
+            break;
+        case State::Away:
+            settings.cameraIntervalScale = 12;
+            settings.voicePaused = true;
+            settings.contextRefreshScale = 10;
+            settings.screenPaused = true;
+            break;
+    }
+    return settings;
+}
+
+const char* PresenceMonitor::StateName(State state) {
+    switch (state) {
+        case State::Present: return "present";
+        case State::Idle:    return "idle";
+        case State::Away:    return "away";
+    }
+    return "unknown";
+}
+
+void PresenceMonitor::Write(JsonWriter& writer) const {
+    State current;
+    Signals signals;
+    int idle;
+    int away;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = state;
+        signals = lastSignals;
+        idle = idleMs;
+        away = awayMs;
+    }
+    Settings settings = SettingsFor(current);
+
+    writer.BeginObject();
+    writer.Key("state").String(StateName(current));
+    writer.Key("idleMs").Int(idle);
+    writer.Key("awayMs").Int(away);
+    writer.Key("signals").BeginObject();
+    writer.Key("inputIdleMs").Int(signals.inputIdleMs);
+    writer.Key("activityIdleMs").Int(signals.activityIdleMs);
+    writer.Key("sessionLocked").Bool(signals.sessionLocked);
+    writer.EndObject();
+    writer.Key("settings").BeginObject();
+    writer.Key("cameraIntervalScale").Int(settings.cameraIntervalScale);
+    writer.Key("voicePaused").Bool(settings.voicePaused);
+    writer.Key("contextRefreshScale").Int(settings.contextRefreshScale);
+    writer.Key("screenPaused").Bool(settings.screenPaused);
+    writer.EndObject();
+    writer.EndObject();
+}
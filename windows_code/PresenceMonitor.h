@@ -0,0 +1,141 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "JsonWriter.h"
+
+/**
+ * PresenceMonitor - Whether anyone is at the machine, as a gate for every pipeline
+ *
+ * With nobody there, voice capture, VAD, the caption loop and the context
+ * sampling used to carry on at full rate. PresenceMonitor combines three
+ * cheap signals into one of three states, each a set of Settings the host
+ * applies:
+ *
+ *   State     When                                          Camera      Voice    Context refresh  Screen
+ *   Present   input or camera activity within idle_ms       normal      on       normal           on
+ *   Idle      neither for idle_ms                           x3          on       x4               paused
+ *   Away      neither for away_ms, or the session locked    x12         paused   x10              paused
+ *
+ *   Input     GetLastInputInfo (keyboard / mouse of this session)
+ *   Camera    ReportActivity() from the caption loop: a scene that moved
+ *             (CameraCadence::HIGH_MOTION_BITS) or, with region detection,
+ *             one with a face or person in it
+ *   Lock      SetSessionLocked(), from the service's session events
+ *
+ * The camera keeps running while Away, slowly, so someone sitting down and
+ * reading without touching the keyboard is noticed; the first key press
+ * ends Idle or Away within POLL_MS. Session 0 (the service) sees no user
+ * input, and camera activity alone can't tell a quiet reader from an empty
+ * room: there the state follows the session lock only.
+ *
+ * While Present the thread sleeps until the idle threshold could be
+ * crossed; while Idle or Away it polls GetLastInputInfo every POLL_MS (one
+ * call); activity, the lock and new thresholds wake it early. The callback
+ * runs on that thread, once per state change.
+ *
+ * Usage:
+ *   PresenceMonitor presence;
+ *   presence.SetStateCallback([&](PresenceMonitor::State state, const PresenceMonitor::Settings& settings) { ... });
+ *   presence.SetThresholds(config.presenceIdleMs, config.presenceAwayMs);
+ *   presence.Start();
+ *   presence.ReportActivity();          // the camera saw someone
+ *   presence.Stop();
+ *
+ * Thread-safe.
+ */
+class PresenceMonitor {
+public:
+    enum class State { Present, Idle, Away };
+
+    static constexpr int POLL_MS = 1000;                    // While Idle or Away
+    static constexpr int PRESENT_CHECK_MS = 60000;          // While Present with no threshold to wait for
+
+    struct Signals {
+        int64_t inputIdleMs = -1;           // Since the last input; -1 when this session can't tell (session 0)
+        int64_t activityIdleMs = -1;        // Since the camera last saw someone; -1 before it ever did
+        bool sessionLocked = false;
+    };
+
+    // What the host applies for a state
+    struct Settings {
+        int cameraIntervalScale = 1;        // CameraCadence::SetPresenceScale
+        bool voicePaused = false;           // Audio capture, VAD and whisper stopped
+        int contextRefreshScale = 1;        // ContextCollector::SetRefreshScale
+        bool screenPaused = false;          // No screen captions or OCR
+    };
+
+    using StateCallback = std::function<void(State, const Settings&)>;
+
+    PresenceMonitor();
+    ~PresenceMonitor();
+
+    PresenceMonitor(const PresenceMonitor&) = delete;
+    PresenceMonitor& operator=(const PresenceMonitor&) = delete;
+
+    /**
+     * @brief Called on every state change; set before Start()
+     */
+    void SetStateCallback(StateCallback callback) { stateCallback = std::move(callback); }
+
+    /**
+     * @brief RuntimeConfig presence.idle_ms / away_ms; idleMs 0 keeps the state Present (the lock aside)
+     */
+    void SetThresholds(int idleMs, int awayMs);
+
+    void Start();
+    void Stop();
+
+    void SetSessionLocked(bool locked);
+
+    /**
+     * @brief Someone was seen (cheap; call from any thread)
+     */
+    void ReportActivity();
+
+    State GetState() const;
+    Settings GetSettings() const { return SettingsFor(GetState()); }
+
+    /**
+     * @brief The state a set of signals maps to
+     */
+    static State Classify(const Signals& signals, int idleMs, int awayMs);
+
+    static Settings SettingsFor(State state);
+    static const char* StateName(State state);
+
+    /**
+     * @brief {"state", "idleMs", "awayMs", "signals": {...}, "settings": {...}}
+     */
+    void Write(JsonWriter& writer) const;
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+    bool recheck = false;                   // Wakes the thread: activity, a lock or new thresholds
+    bool sessionLocked = false;
+    int idleMs = 0;
+    int awayMs = 0;
+    State state = State::Present;
+    bool announced = false;                 // The callback has seen a state
+    Signals lastSignals;
+    const bool inputVisible;                // False in session 0
+
+    std::atomic<int64_t> lastActivityMs{-1};
+
+    StateCallback stateCallback;
+
+    std::thread thread;
+
+    void Run();
+    Signals Sample() const;
+    // Re-classifies; returns how long until a threshold could next be crossed
+    int64_t Update();
+    static int64_t NowMs();
+};
@@ -0,0 +1,103 @@
+#include "ProcessInfoCache.h"
+
+ProcessInfoCache& ProcessInfoCache::Instance() {
+    // Never destroyed: exit callbacks may still run on pool threads during shutdown
+    static ProcessInfoCache* cache = new ProcessInfoCache();
+    return *cache;
+}
+
+bool ProcessInfoCache::Lookup(DWORD processId, ProcessInfo& info) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = entries.find(processId);
+        if (it != entries.end()) {
+            info = it->second.info;
+            return true;
+        }
+    }
+
+    // Miss: limited-information access also works for elevated processes
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, processId);
+    if (!process) {
+        return false;
+    }
+
+    wchar_t buffer[MAX_PATH];
+    DWORD size = MAX_PATH;
+    FILETIME creation, exitTime, kernelTime, userTime;
+    if (!QueryFullProcessImageNameW(process, 0, buffer, &size) ||
+        !GetProcessTimes(process, &creation, &exitTime, &kernelTime, &userTime)) {
+        CloseHandle(process);
+        return false;
+    }
+
+    Entry entry;
+    entry.info.path.assign(buffer, size);
+    size_t lastSlash = entry.info.path.find_last_of(L"\\/");
+    entry.info.name = lastSlash == std::wstring::npos ? entry.info.path : entry.info.path.substr(lastSlash + 1);
+    entry.creationTime = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+    entry.process = process;
+    entry.wait = nullptr;
+    info = entry.info;
+
+    Entry replaced = {};
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = entries.find(processId);
+        if (it != entries.end()) {
+            if (it->second.creationTime == entry.creationTime) {
+                CloseHandle(process);       // Another thread cached it meanwhile
+                return true;
+            }
+            // The pid was reused before the old process's exit callback ran
+            replaced = it->second;
+            entries.erase(it);
+        }
+        if (entries.size() >= MAX_ENTRIES) {
+            CloseHandle(process);
+        } else if (RegisterWaitForSingleObject(&entry.wait, process, OnProcessExit,
+                                               reinterpret_cast<PVOID>(static_cast<uintptr_t>(processId)),
+                                               INFINITE, WT_EXECUTEONLYONCE)) {
+            // The callback takes cacheMutex, so it can't run before the entry exists
+            entries.emplace(processId, entry);
+        } else {
+            CloseHandle(process);
+        }
+    }
+    if (replaced.process) {
+        Release(replaced);
+    }
+    return true;
+}
+
+size_t ProcessInfoCache::Size() const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return entries.size();
+}
+
+void CALLBACK ProcessInfoCache::OnProcessExit(PVOID context, BOOLEAN) {
+    // The context is the pid rather than the entry, so a callback that runs
+    // after its entry was replaced never touches freed memory
+    Instance().Evict(static_cast<DWORD>(reinterpret_cast<uintptr_t>(context)));
+}
+
+void ProcessInfoCache::Evict(DWORD processId) {
+    Entry evicted;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = entries.find(processId);
+        // Only evict if the cached process is the one that exited, not a successor on the same pid
+        if (it == entries.end() || WaitForSingleObject(it->second.process, 0) != WAIT_OBJECT_0) {
+            return;
+        }
+        evicted = it->second;
+        entries.erase(it);
+    }
+    Release(evicted);
+}
+
+void ProcessInfoCache::Release(const Entry& entry) {
+    // Non-blocking unregister: this may run inside the wait's own callback
+    UnregisterWaitEx(entry.wait, nullptr);
+    CloseHandle(entry.process);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * ProcessInfoCache - Image name and path per process id, dropped when the process exits
+ *
+ * Window events arrive in bursts for the same few processes (Chrome fires
+ * dozens of name changes per second while pages load), and each one used to
+ * cost an OpenProcess plus an image-name query. The first lookup of a process
+ * pays that once; later lookups are a hash-map hit with no kernel call.
+ *
+ * Architecture:
+ *   Each cached process keeps a SYNCHRONIZE handle open, registered with the
+ *   thread pool (RegisterWaitForSingleObject) so that the process exit evicts
+ *   its entry. Entries also record the process creation time: when a pid is
+ *   reused before the old entry's exit callback has run, the creation times
+ *   differ and the new process replaces the old entry instead of inheriting
+ *   its name.
+ *
+ *   At most MAX_ENTRIES processes are cached (each holds a handle and a wait);
+ *   past that, lookups still work but go to the kernel every time.
+ *
+ * Usage:
+ *   ProcessInfoCache::ProcessInfo process;
+ *   if (ProcessInfoCache::Instance().Lookup(pid, process)) {
+ *       std::wcout << process.name << L" " << process.path;
+ *   }
+ */
+class ProcessInfoCache {
+public:
+    struct ProcessInfo {
+        std::wstring name;              // Image file name, e.g. L"chrome.exe"
+        std::wstring path;              // Full image path
+    };
+
+    static constexpr size_t MAX_ENTRIES = 1024;
+
+    static ProcessInfoCache& Instance();
+
+    ProcessInfoCache(const ProcessInfoCache&) = delete;
+    ProcessInfoCache& operator=(const ProcessInfoCache&) = delete;
+
+    /**
+     * @brief Name and path of a running process
+     * @return false if the process can't be opened or queried (exited, protected)
+     */
+    bool Lookup(DWORD processId, ProcessInfo& info);
+
+    size_t Size() const;
+
+private:
+    struct Entry {
+        ProcessInfo info;
+        uint64_t creationTime;          // FILETIME ticks; tells a reused pid apart
+        HANDLE process;
+        HANDLE wait;
+    };
+
+    ProcessInfoCache() = default;
+
+    static void CALLBACK OnProcessExit(PVOID context, BOOLEAN timedOut);
+    void Evict(DWORD processId);
+    static void Release(const Entry& entry);
+
+    mutable std::mutex cacheMutex;
+    std::unordered_map<DWORD, Entry> entries;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/**
+ * PublishedState - One read-mostly value published by pointer swap (RCU style)
+ *
+ * Readers Load() an immutable snapshot of the value: one atomic shared_ptr
+ * load, no lock, and the snapshot stays valid however long they hold it.
+ * Writers copy the current value, change the copy and publish it with a
+ * compare-and-swap; when two writers race, the loser re-applies its change
+ * to the winner's value, so no update is lost and nobody ever blocks.
+ *
+ * Usage:
+ *   PublishedState<VoiceState> voice;
+ *   voice.Update([&](VoiceState& state) { state.text = text; return true; });
+ *   std::shared_ptr<const VoiceState> current = voice.Load();
+ *
+ * Meant for small values updated a few times per second: every update
+ * allocates and copies the whole value.
+ */
+template <typename T>
+class PublishedState {
+public:
+    PublishedState() : current(std::make_shared<const T>()) {}
+
+    PublishedState(const PublishedState&) = delete;
+    PublishedState& operator=(const PublishedState&) = delete;
+
+    std::shared_ptr<const T> Load() const {
+        return std::atomic_load(&current);
+    }
+
+    /**
+     * @brief Apply `mutate` (bool(T&)) to a copy and publish it
+     * @return false, publishing nothing, when mutate reports no change
+     *
+     * mutate may run more than once under contention, so it must only touch
+     * the value it is given.
+     */
+    template <typename Mutate>
+    bool Update(Mutate mutate) {
+        std::shared_ptr<const T> seen = Load();
+        while (true) {
+            auto next = std::make_shared<T>(*seen);
+            if (!mutate(*next)) {
+                return false;
+            }
+            std::shared_ptr<const T> published = std::move(next);
+            if (std::atomic_compare_exchange_strong(&current, &seen, published)) {
+                return true;
+            }
+            // seen now holds the value another writer published; retry on it
+        }
+    }
+
+private:
+    std::shared_ptr<const T> current;   // Only accessed through std::atomic_* functions
+};
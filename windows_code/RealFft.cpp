@@ -0,0 +1,175 @@
+#include "RealFft.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+}  // namespace
+
+RealFft::RealFft()
+    : size(0)
+    , complexSize(0) {
+}
+
+RealFft::~RealFft() = default;
+
+bool RealFft::Configure(int requested) {
+    size = 0;
+    complexSize = 0;
+    stages.clear();
+    if (requested < 2 || requested % 2 != 0) {
+        return false;
+    }
+
+    // Radix 4 first (fewest stages), then 5, 3 and 2 for what is left
+    std::vector<int> radices;
+    int rest = requested / 2;
+    for (int radix : { 4, 5, 3, 2 }) {
+        while (rest % radix == 0) {
+            radices.push_back(radix);
+            rest /= radix;
+        }
+    }
+    if (rest != 1) {
+        return false;
+    }
+    size = requested;
+    complexSize = requested / 2;
+
+    // Stockham plan: stage k splits each sub-transform of length n into
+    // `radix` interleaved ones of length n / radix
+    int length = complexSize;
+    int stride = 1;
+    for (int radix : radices) {
+        Stage stage;
+        stage.radix = radix;
+        stage.stride = stride;
+        stage.span = length / radix;
+        for (int r = 0; r < radix; ++r) {
+            stage.rootRe.push_back(static_cast<float>(std::cos(2.0 * PI * r / radix)));
+            stage.rootIm.push_back(static_cast<float>(-std::sin(2.0 * PI * r / radix)));
+        }
+        for (int q = 0; q < stage.span; ++q) {
+            for (int j = 0; j < radix; ++j) {
+                stage.twiddleRe.push_back(static_cast<float>(std::cos(2.0 * PI * q * j / length)));
+                stage.twiddleIm.push_back(static_cast<float>(-std::sin(2.0 * PI * q * j / length)));
+            }
+        }
+        stages.push_back(std::move(stage));
+        length /= radix;
+        stride *= radix;
+    }
+
+    // Two real samples per complex point; unpacking needs the size-th roots
+    unpackRe.resize(Bins());
+    unpackIm.resize(Bins());
+    for (int k = 0; k < Bins(); ++k) {
+        unpackRe[k] = static_cast<float>(std::cos(2.0 * PI * k / size));
+        unpackIm[k] = static_cast<float>(-std::sin(2.0 * PI * k / size));
+    }
+
+    packRe.resize(complexSize);
+    packIm.resize(complexSize);
+    workRe.resize(complexSize);
+    workIm.resize(complexSize);
+    return true;
+}
+
+void RealFft::Transform(float*& outRe, float*& outIm) {
+    // Stockham autosort: ping-pong between the two buffers, natural order out.
+    // Every inner loop runs over the stride's contiguous sub-transforms
+    float* inRe = packRe.data();
+    float* inIm = packIm.data();
+    outRe = workRe.data();
+    outIm = workIm.data();
+    for (const Stage& stage : stages) {
+        const int radix = stage.radix;
+        const int stride = stage.stride;
+        const int span = stage.span;
+        for (int q = 0; q < span; ++q) {
+            for (int j = 0; j < radix; ++j) {
+                float* re = outRe + stride * (radix * q + j);
+                float* im = outIm + stride * (radix * q + j);
+                for (int i = 0; i < stride; ++i) {
+                    re[i] = 0.0f;
+                    im[i] = 0.0f;
+                }
+                for (int k = 0; k < radix; ++k) {
+                    const float rootRe = stage.rootRe[(j * k) % radix];
+                    const float rootIm = stage.rootIm[(j * k) % radix];
+                    const float* xRe = inRe + stride * (q + span * k);
+                    const float* xIm = inIm + stride * (q + span * k);
+                    for (int i = 0; i < stride; ++i) {
+                        re[i] += xRe[i] * rootRe - xIm[i] * rootIm;
+                        im[i] += xRe[i] * rootIm + xIm[i] * rootRe;
+                    }
+                }
+                const float twiddleRe = stage.twiddleRe[q * radix + j];
+                const float twiddleIm = stage.twiddleIm[q * radix + j];
+                for (int i = 0; i < stride; ++i) {
+                    const float value = re[i] * twiddleRe - im[i] * twiddleIm;
+                    im[i] = re[i] * twiddleIm + im[i] * twiddleRe;
+                    re[i] = value;
+                }
+            }
+        }
+        std::swap(inRe, outRe);
+        std::swap(inIm, outIm);
+    }
+    outRe = inRe;
+    outIm = inIm;
+}
+
+void RealFft::Forward(const float* samples, float* re, float* im) {
+    // Even samples are the real parts, odd ones the imaginary parts
+    for (int n = 0; n < complexSize; ++n) {
+        packRe[n] = samples[2 * n];
+        packIm[n] = samples[2 * n + 1];
+    }
+    float* zRe = nullptr;
+    float* zIm = nullptr;
+    Transform(zRe, zIm);
+
+    // Unpack the real transform: X[k] = E[k] + w^k O[k], with E and O the
+    // transforms of the even and odd samples recovered from Z[k] and Z[N-k]
+    for (int k = 0; k < Bins(); ++k) {
+        const int a = k % complexSize;
+        const int b = (complexSize - k) % complexSize;
+        const float evenRe = 0.5f * (zRe[a] + zRe[b]);
+        const float evenIm = 0.5f * (zIm[a] - zIm[b]);
+        const float oddRe = 0.5f * (zIm[a] + zIm[b]);
+        const float oddIm = -0.5f * (zRe[a] - zRe[b]);
+        re[k] = evenRe + unpackRe[k] * oddRe - unpackIm[k] * oddIm;
+        im[k] = evenIm + unpackRe[k] * oddIm + unpackIm[k] * oddRe;
+    }
+}
+
+void RealFft::Inverse(const float* re, const float* im, float* samples) {
+    // Pack: E[k] = (X[k] + X*[M-k]) / 2 and O[k] = (X[k] - X*[M-k]) / 2 w^-k
+    // give Z[k] = E[k] + i O[k], whose inverse is the even/odd sample pairs.
+    // The inverse is the forward transform of Z*, conjugated and scaled
+    for (int k = 0; k < complexSize; ++k) {
+        const int m = complexSize - k;
+        const float kIm = k == 0 ? 0.0f : im[k];
+        const float mIm = m == complexSize ? 0.0f : im[m];
+        const float evenRe = 0.5f * (re[k] + re[m]);
+        const float evenIm = 0.5f * (kIm - mIm);
+        const float diffRe = 0.5f * (re[k] - re[m]);
+        const float diffIm = 0.5f * (kIm + mIm);
+        const float oddRe = diffRe * unpackRe[k] + diffIm * unpackIm[k];
+        const float oddIm = diffIm * unpackRe[k] - diffRe * unpackIm[k];
+        packRe[k] = evenRe - oddIm;
+        packIm[k] = -(evenIm + oddRe);
+    }
+    float* zRe = nullptr;
+    float* zIm = nullptr;
+    Transform(zRe, zIm);
+
+    const float scale = 1.0f / complexSize;
+    for (int n = 0; n < complexSize; ++n) {
+        samples[2 * n] = zRe[n] * scale;
+        samples[2 * n + 1] = -zIm[n] * scale;
+    }
+}
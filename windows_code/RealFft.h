@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * RealFft - Mixed-radix FFT of a real frame, for the audio front ends
+ *
+ * The frame sizes the audio stages need are set by milliseconds, not powers
+ * of two (whisper's 400-point window, the noise suppressor's 320), so this
+ * is a Stockham autosort FFT over radices 4, 5, 3 and 2:
+ *
+ *   - the N real samples are packed as N/2 complex points (even samples the
+ *     real parts, odd ones the imaginary parts) and transformed at half size
+ *   - each stage ping-pongs between two split real/imaginary buffers, so the
+ *     inner loops run at unit stride over the interleaved sub-transforms and
+ *     vectorize; the output is in natural order, no bit reversal
+ *   - Forward() unpacks the N/2 + 1 bins of the real spectrum, Inverse()
+ *     packs them back and runs the same plan on the conjugate
+ *
+ * Plan and scratch are allocated by Configure(); transforms allocate nothing.
+ * Not thread-safe: one instance per caller (the scratch is shared between
+ * calls).
+ *
+ * Usage:
+ *   RealFft fft;
+ *   fft.Configure(400);
+ *   fft.Forward(frame, re, im);        // re/im: Bins() values each
+ *   fft.Inverse(re, im, frame);        // Exact inverse, no scaling left to the caller
+ */
+class RealFft {
+public:
+    RealFft();
+    ~RealFft();
+
+    RealFft(const RealFft&) = delete;
+    RealFft& operator=(const RealFft&) = delete;
+
+    /**
+     * @brief Build the plan for `size` real samples
+     * @return False (and unconfigured) unless size is even and size / 2 factors into 2, 3 and 5
+     */
+    bool Configure(int size);
+    int Size() const { return size; }
+    int Bins() const { return size / 2 + 1; }
+
+    // Spectrum of size samples: Bins() bins, DC first, Nyquist last
+    void Forward(const float* samples, float* re, float* im);
+
+    // Samples of a spectrum of Bins() bins (imaginary parts of DC and Nyquist ignored)
+    void Inverse(const float* re, const float* im, float* samples);
+
+private:
+    struct Stage {
+        int radix;
+        int stride;                     // s: interleaved sub-transforms
+        int span;                       // m: butterflies per sub-transform
+        std::vector<float> rootRe;      // exp(-2 pi i r / radix)
+        std::vector<float> rootIm;
+        std::vector<float> twiddleRe;   // w_n^(q j) for q < span, j < radix
+        std::vector<float> twiddleIm;
+    };
+
+    // Forward complex FFT of packRe/packIm; returns the buffers holding the result
+    void Transform(float*& outRe, float*& outIm);
+
+    int size;
+    int complexSize;
+    std::vector<Stage> stages;
+    std::vector<float> unpackRe;        // exp(-2 pi i k / size)
+    std::vector<float> unpackIm;
+
+    std::vector<float> packRe;
+    std::vector<float> packIm;
+    std::vector<float> workRe;
+    std::vector<float> workIm;
+};
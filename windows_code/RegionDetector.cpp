@@ -0,0 +1,97 @@
+#include "RegionDetector.h"
+#include "Log.h"
+#include "Trace.h"
+#include <algorithm>
+
+bool RegionDetector::Initialize(const std::string& faceModelPath) {
+    try {
+        // Input size is reset per frame in Detect(); 320x240 is the capture default
+        faceDetector = cv::FaceDetectorYN::create(faceModelPath, "", cv::Size(320, 240), FACE_SCORE_THRESHOLD);
+    } catch (const cv::Exception& e) {
+        LOG_WARNING("RegionDetector", "Failed to load face model " << faceModelPath << ": " << e.what());
+        faceDetector.release();
+        return false;
+    }
+    if (faceDetector.empty()) {
+        LOG_WARNING("RegionDetector", "Failed to load face model " << faceModelPath);
+        return false;
+    }
+
+    peopleDetector.setSVMDetector(cv::HOGDescriptor::getDefaultPeopleDetector());
+    LOG_INFO("RegionDetector", "Region detector ready (faces: " << faceModelPath << ", people: HOG)");
+    return true;
+}
+
+cv::Rect RegionDetector::ExpandToCrop(const cv::Rect& box, const cv::Size& frameSize, float padding) {
+    int side = static_cast<int>((std::max)(box.width, box.height) * (1.0f + 2.0f * padding));
+    side = (std::max)(side, MIN_CROP_SIZE);
+    side = (std::min)(side, (std::min)(frameSize.width, frameSize.height));
+
+    // Centred on the box, then shifted (not shrunk) back inside the frame
+    int x = box.x + box.width / 2 - side / 2;
+    int y = box.y + box.height / 2 - side / 2;
+    x = (std::max)(0, (std::min)(x, frameSize.width - side));
+    y = (std::max)(0, (std::min)(y, frameSize.height - side));
+    return cv::Rect(x, y, side, side);
+}
+
+std::vector<cv::Rect> RegionDetector::Detect(const cv::Mat& frame) {
+    TRACE_ZONE("RegionDetector::Detect");
+    std::vector<cv::Rect> crops;
+    if (faceDetector.empty() || frame.empty()) {
+        return crops;
+    }
+
+    try {
+        // Both detectors want BGR; Media Foundation frames are BGRA
+        const cv::Mat* image = &frame;
+        if (frame.channels() == 4) {
+            cv::cvtColor(frame, bgrFrame, cv::COLOR_BGRA2BGR);
+            image = &bgrFrame;
+        }
+
+        // Faces: rows of [x, y, w, h, 5 landmarks, score]
+        faceDetector->setInputSize(image->size());
+        faceDetector->detect(*image, faces);
+        for (int i = 0; i < faces.rows; ++i) {
+            const float* row = faces.ptr<float>(i);
+            cv::Rect box(static_cast<int>(row[0]), static_cast<int>(row[1]),
+                         static_cast<int>(row[2]), static_cast<int>(row[3]));
+            crops.push_back(ExpandToCrop(box, frame.size(), PADDING));
+        }
+
+        // People further back than a face detector reaches (HOG needs 64x128)
+        if (frame.cols >= 64 && frame.rows >= 128) {
+            peopleDetector.detectMultiScale(*image, people, peopleWeights, PEOPLE_HIT_THRESHOLD);
+            for (const cv::Rect& box : people) {
+                crops.push_back(ExpandToCrop(box, frame.size(), PADDING));
+            }
+        }
+    } catch (const cv::Exception& e) {
+        LOG_WARNING("RegionDetector", "Detection failed: " << e.what());
+        crops.clear();
+        return crops;
+    }
+
+    // Merge overlapping crops into their bounding square (already padded) until none overlap
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < crops.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < crops.size(); ++j) {
+                if ((crops[i] & crops[j]).area() > 0) {
+                    crops[i] = ExpandToCrop(crops[i] | crops[j], frame.size(), 0.0f);
+                    crops.erase(crops.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::sort(crops.begin(), crops.end(), [](const cv::Rect& a, const cv::Rect& b) { return a.area() > b.area(); });
+    if (crops.size() > static_cast<size_t>(maxRegions)) {
+        crops.resize(maxRegions);
+    }
+    return crops;
+}
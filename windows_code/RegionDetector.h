@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * RegionDetector - Cheap detector choosing which crops FastVLM should see
+ *
+ * Runs before the vision encoder: faces come from OpenCV's YuNet
+ * (FaceDetectorYN, a ~300 KB ONNX model, a few ms on a 320x240 frame) and
+ * whole people from the built-in HOG people detector. Each hit is padded to
+ * take in shoulders/hands, squared (the encoder input is square, so the crop
+ * isn't distorted) and clamped to the frame; overlapping crops merge.
+ *
+ * An empty result means nothing of interest is in view, and the engine can
+ * skip vision-language inference for the frame entirely.
+ *
+ * Usage:
+ *   RegionDetector detector;
+ *   if (detector.Initialize("models/face_detection_yunet_2023mar.onnx")) {
+ *       std::vector<cv::Rect> crops = detector.Detect(frame);
+ *   }
+ *
+ * Not thread-safe: one caller at a time (the caption thread).
+ */
+class RegionDetector {
+public:
+    static constexpr int DEFAULT_MAX_REGIONS = 3;
+    static constexpr float FACE_SCORE_THRESHOLD = 0.8f;
+    static constexpr double PEOPLE_HIT_THRESHOLD = 0.3;    // HOG SVM margin
+    static constexpr float PADDING = 0.6f;                 // Added to each side, as a fraction of the box
+    static constexpr int MIN_CROP_SIZE = 64;               // Smaller crops are upscaled noise
+
+    /**
+     * @brief Load the face model (required) and the HOG people detector
+     * @param faceModelPath YuNet ONNX model
+     * @return false if the face model could not be loaded
+     */
+    bool Initialize(const std::string& faceModelPath);
+
+    bool IsReady() const { return !faceDetector.empty(); }
+
+    void SetMaxRegions(int regions) { maxRegions = regions < 1 ? 1 : regions; }
+    int GetMaxRegions() const { return maxRegions; }
+
+    /**
+     * @brief Crops worth captioning, largest first (at most GetMaxRegions())
+     * @param frame BGR or BGRA camera frame
+     * @return Square crops inside the frame; empty if nothing was found
+     */
+    std::vector<cv::Rect> Detect(const cv::Mat& frame);
+
+private:
+    cv::Ptr<cv::FaceDetectorYN> faceDetector;
+    cv::HOGDescriptor peopleDetector;
+    int maxRegions = DEFAULT_MAX_REGIONS;
+
+    // Reused per frame
+    cv::Mat bgrFrame;                              // Only for BGRA input
+    cv::Mat faces;
+    std::vector<cv::Rect> people;
+    std::vector<double> peopleWeights;
+
+    /**
+     * @brief Pad box by padding per side, square it, then fit it inside frameSize
+     */
+    static cv::Rect ExpandToCrop(const cv::Rect& box, const cv::Size& frameSize, float padding);
+};
@@ -0,0 +1,363 @@
+#include "ResourceQuota.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <psapi.h>
+#include <vector>
+#include "InferenceSupervisor.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+
+static const char* const LEVEL_NAMES[] = { "normal", "slow_camera", "fast_whisper", "no_captions", "shed_http" };
+static_assert(sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]) == static_cast<size_t>(ResourceQuota::Level::Count),
+              "every level needs a name");
+
+ResourceQuota& ResourceQuota::Instance() {
+    static ResourceQuota instance;
+    return instance;
+}
+
+ResourceQuota::~ResourceQuota() {
+    Stop();
+    if (job) {
+        CloseHandle(job);
+    }
+}
+
+int64_t ResourceQuota::NowMs() {
+    return static_cast<int64_t>(GetTickCount64());
+}
+
+// ============================================================================
+// Job
+// ============================================================================
+
+bool ResourceQuota::SetLimits(const Limits& requested) {
+    std::lock_guard<std::mutex> lock(limitsMutex);
+    limits = requested;
+    bool limited = limits.cpuPercent > 0 || limits.memoryMb > 0;
+    // The hard cap goes on the workers' job only: the capture threads here are never descheduled
+    bool applied = InferenceSupervisor::Instance().SetCpuRate(limits.cpuPercent, limits.cpuReservePercent);
+    if (!job && !limited) {
+        return applied;
+    }
+    if (!job) {
+        job = CreateJobObjectW(nullptr, nullptr);
+        if (!job) {
+            LOG_ERROR("Quota", "No job object (" << GetLastError() << "); degrading on usage alone");
+            enforced = false;
+            return false;
+        }
+        // Children started from here on are in it too
+        if (!AssignProcessToJobObject(job, GetCurrentProcess())) {
+            LOG_ERROR("Quota", "Cannot join the job (" << GetLastError() << "); degrading on usage alone");
+            CloseHandle(job);
+            job = nullptr;
+            enforced = false;
+            return false;
+        }
+    }
+
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION memory = {};
+    if (limits.memoryMb > 0) {
+        memory.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_JOB_MEMORY;
+        memory.JobMemoryLimit = static_cast<SIZE_T>(limits.memoryMb) * 1024 * 1024;
+    }
+    if (!SetInformationJobObject(job, JobObjectExtendedLimitInformation, &memory, sizeof(memory))) {
+        LOG_ERROR("Quota", "Cannot set the memory limit: " << GetLastError());
+        applied = false;
+    }
+
+    enforced = applied && limited;
+    if (limited) {
+        LOG_INFO("Quota", "Envelope: CPU " << (limits.cpuPercent > 0 ? std::to_string(limits.cpuPercent) + "%" : "unlimited")
+                 << " (inference workers capped, " << limits.cpuReservePercent << "% reserved for them), memory "
+                 << (limits.memoryMb > 0 ? std::to_string(limits.memoryMb) + " MB" : "unlimited")
+                 << (enforced ? "" : " (not enforced)"));
+    } else {
+        LOG_INFO("Quota", "Envelope lifted");
+    }
+    return applied;
+}
+
+uint64_t ResourceQuota::CpuTime() const {
+    {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting = {};
+        if (job && QueryInformationJobObject(job, JobObjectBasicAccountingInformation, &accounting,
+                                             sizeof(accounting), nullptr)) {
+            return static_cast<uint64_t>(accounting.TotalUserTime.QuadPart + accounting.TotalKernelTime.QuadPart);
+        }
+    }
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return ticks(kernel) + ticks(user);
+}
+
+// ============================================================================
+// Monitor
+// ============================================================================
+
+void ResourceQuota::Start(LevelCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    onLevel = std::move(callback);
+    previousCpuTime = CpuTime();
+    previousMs = NowMs();
+    lastStepMs = previousMs;
+    relaxedSinceMs = -1;
+    running = true;
+    thread = std::thread(&ResourceQuota::Run, this);
+}
+
+void ResourceQuota::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    onLevel = nullptr;
+    level.store(Level::Normal);
+    cpuSmoothed.store(-1.0);
+}
+
+void ResourceQuota::Run() {
+    TRACE_THREAD("ResourceQuota");
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(SAMPLE_MS), [this]() { return !running; });
+            if (!running) {
+                break;
+            }
+        }
+        int64_t now = NowMs();
+        Sample(now);
+        Decide(now);
+    }
+}
+
+void ResourceQuota::Sample(int64_t nowMs) {
+    uint64_t cpuTime = CpuTime();
+    int64_t elapsedMs = nowMs - previousMs;
+    // The job may have appeared since the last sample: its time starts at 0
+    if (elapsedMs <= 0 || cpuTime < previousCpuTime) {
+        previousCpuTime = cpuTime;
+        previousMs = nowMs;
+        return;
+    }
+    // Of all processors, like the job's CPU rate
+    DWORD processors = (std::max)(DWORD(1), GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+    double percent = (std::min)(100.0, 100.0 * (cpuTime - previousCpuTime) /
+                                       (static_cast<double>(elapsedMs) * 10000.0 * processors));
+    previousCpuTime = cpuTime;
+    previousMs = nowMs;
+
+    double smoothed = cpuSmoothed.load();
+    double alpha = 1.0 - std::exp(-static_cast<double>(elapsedMs) / CPU_SMOOTH_MS);
+    cpuSmoothed.store(smoothed < 0 ? percent : smoothed + alpha * (percent - smoothed));
+    memoryBytes.store(CommittedMemory());
+}
+
+uint64_t ResourceQuota::CommittedMemory() const {
+    std::vector<ULONG_PTR> ids;
+    {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        std::vector<BYTE> buffer(sizeof(JOBOBJECT_BASIC_PROCESS_ID_LIST) + MAX_JOB_PROCESSES * sizeof(ULONG_PTR));
+        auto list = reinterpret_cast<JOBOBJECT_BASIC_PROCESS_ID_LIST*>(buffer.data());
+        // A fuller job still fills the list this far (ERROR_MORE_DATA)
+        if (job && (QueryInformationJobObject(job, JobObjectBasicProcessIdList, list,
+                                              static_cast<DWORD>(buffer.size()), nullptr) ||
+                    GetLastError() == ERROR_MORE_DATA)) {
+            ids.assign(list->ProcessIdList, list->ProcessIdList + list->NumberOfProcessIdsInList);
+        }
+    }
+    if (ids.empty()) {
+        return MemoryAccounting::GetProcessMemory().privateBytes;
+    }
+
+    uint64_t total = 0;
+    for (ULONG_PTR id : ids) {
+        HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(id));
+        if (!process) {
+            continue;                   // Exited since the list was taken
+        }
+        PROCESS_MEMORY_COUNTERS_EX counters = {};
+        counters.cb = sizeof(counters);
+        if (GetProcessMemoryInfo(process, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters))) {
+            total += counters.PrivateUsage;
+        }
+        CloseHandle(process);
+    }
+    return total;
+}
+
+void ResourceQuota::Decide(int64_t nowMs) {
+    Limits current;
+    {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        current = limits;
+    }
+    double cpuPressure = current.cpuPercent > 0 ? (std::max)(0.0, cpuSmoothed.load()) / current.cpuPercent : 0.0;
+    double memoryPressure = current.memoryMb > 0
+        ? static_cast<double>(memoryBytes.load()) / (static_cast<double>(current.memoryMb) * 1024 * 1024) : 0.0;
+    double now = (std::max)(cpuPressure, memoryPressure);
+    pressure.store(now);
+
+    Level previous = level.load();
+    int next = static_cast<int>(previous);
+    const int top = static_cast<int>(Level::Count) - 1;
+    if (memoryPressure >= CRITICAL_PRESSURE) {
+        next = top;
+        relaxedSinceMs = -1;
+    } else if (now >= RAISE_PRESSURE) {
+        relaxedSinceMs = -1;
+        if (nowMs - lastStepMs >= STEP_MS) {
+            next = (std::min)(next + 1, top);
+        }
+    } else if (now < LOWER_PRESSURE && next > 0) {
+        if (relaxedSinceMs < 0) {
+            relaxedSinceMs = nowMs;
+        } else if (nowMs - relaxedSinceMs >= RELAX_MS && nowMs - lastStepMs >= RELAX_MS) {
+            next--;
+            relaxedSinceMs = nowMs;
+        }
+    } else {
+        relaxedSinceMs = -1;
+    }
+    if (next == static_cast<int>(previous)) {
+        return;
+    }
+
+    Level changed = static_cast<Level>(next);
+    level.store(changed);
+    lastStepMs = nowMs;
+    levelChanges.fetch_add(1);
+    LOG_INFO("Quota", (next > static_cast<int>(previous) ? "Degrading" : "Recovering") << " to "
+             << LevelName(changed) << " (CPU " << static_cast<int>(cpuSmoothed.load()) << "%, memory "
+             << (memoryBytes.load() / (1024 * 1024)) << " MB, pressure " << static_cast<int>(now * 100) << "%)");
+    if (onLevel) {
+        onLevel(changed, SettingsFor(changed));
+    }
+}
+
+ResourceQuota::Usage ResourceQuota::GetUsage() const {
+    Usage usage;
+    usage.cpuPercent = cpuSmoothed.load();
+    usage.memoryBytes = memoryBytes.load();
+    usage.pressure = pressure.load();
+    return usage;
+}
+
+// ============================================================================
+// Levels
+// ============================================================================
+
+ResourceQuota::Settings ResourceQuota::SettingsFor(Level level) {
+    Settings settings;
+    if (level >= Level::SlowCamera) {
+        settings.cameraIntervalScale = 4;
+    }
+    if (level >= Level::FastWhisper) {
+        settings.preferFastWhisper = true;
+        settings.whisperThreadCap = 2;
+    }
+    if (level >= Level::NoCaptions) {
+        settings.captionsPaused = true;
+    }
+    if (level >= Level::ShedHttp) {
+        settings.httpShare = 4;
+    }
+    return settings;
+}
+
+const char* ResourceQuota::LevelName(Level level) {
+    size_t index = static_cast<size_t>(level);
+    return index < static_cast<size_t>(Level::Count) ? LEVEL_NAMES[index] : "unknown";
+}
+
+void ResourceQuota::Write(JsonWriter& writer) const {
+    Limits current;
+    bool isEnforced;
+    {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        current = limits;
+        isEnforced = enforced;
+    }
+    Usage usage = GetUsage();
+    Settings settings = GetSettings();
+
+    writer.BeginObject();
+    writer.Key("enforced").Bool(isEnforced);
+    writer.Key("limits").BeginObject();
+    writer.Key("cpuPercent").Int(current.cpuPercent);
+    writer.Key("cpuReservePercent").Int(current.cpuReservePercent);
+    writer.Key("memoryMb").Int(current.memoryMb);
+    writer.EndObject();
+    writer.Key("usage").BeginObject();
+    writer.Key("cpuPercent");
+    if (usage.cpuPercent >= 0) {
+        writer.Double(usage.cpuPercent, 1);
+    } else {
+        writer.Null();
+    }
+    writer.Key("memoryMb").Double(static_cast<double>(usage.memoryBytes) / (1024 * 1024), 1);
+    writer.Key("pressure").Double(usage.pressure, 2);
+    writer.EndObject();
+    writer.Key("level").String(LevelName(GetLevel()));
+    writer.Key("levelChanges").UInt(levelChanges.load());
+    writer.Key("settings").BeginObject();
+    writer.Key("cameraIntervalScale").Int(settings.cameraIntervalScale);
+    writer.Key("preferFastWhisper").Bool(settings.preferFastWhisper);
+    writer.Key("whisperThreadCap").Int(settings.whisperThreadCap);
+    writer.Key("captionsPaused").Bool(settings.captionsPaused);
+    writer.Key("httpShare").Int(settings.httpShare);
+    writer.EndObject();
+    writer.EndObject();
+}
+
+std::string ResourceQuota::FormatPrometheus() const {
+    Limits current;
+    {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        current = limits;
+    }
+    Usage usage = GetUsage();
+
+    std::string out;
+    char line[160];
+    out += "# HELP perception_quota_level Degradation level under the resource quota (0: normal)\n";
+    out += "# TYPE perception_quota_level gauge\n";
+    std::snprintf(line, sizeof(line), "perception_quota_level %d\n", static_cast<int>(GetLevel()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_quota_level_changes_total %llu\n",
+                  static_cast<unsigned long long>(levelChanges.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_quota_pressure %.3f\n", usage.pressure);
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_quota_cpu_percent %.2f\n", (std::max)(0.0, usage.cpuPercent));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_quota_cpu_limit_percent %d\n", current.cpuPercent);
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_quota_memory_bytes %llu\n",
+                  static_cast<unsigned long long>(usage.memoryBytes));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_quota_memory_limit_bytes %llu\n",
+                  static_cast<unsigned long long>(current.memoryMb) * 1024 * 1024);
+    out += line;
+    return out;
+}
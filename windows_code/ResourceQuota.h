@@ -0,0 +1,163 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "JsonWriter.h"
+
+/**
+ * ResourceQuota - A fixed CPU and memory envelope, kept by degrading in steps
+ *
+ * IT could only kill the engine when it outgrew its share of the machine.
+ * With quota.cpu_percent or quota.memory_mb set, the process puts itself in
+ * a Job Object; the inference workers it starts (InferenceSupervisor,
+ * --isolate-inference) are in it too:
+ *
+ *   Memory   a job memory limit of memory_mb over the engine and its
+ *            workers: past it allocations fail instead of something
+ *            outside killing the process
+ *   CPU      no rate control on this job: a job's CPU rate is a hard cap on
+ *            every thread in it, and a whisper burst spending the
+ *            interval's budget would deschedule the WASAPI capture threads
+ *            for the rest of it. Only the workers' own job is capped
+ *            (InferenceSupervisor::SetCpuRate: at most cpu_percent,
+ *            cpu_reserve_percent held for them under contention); in
+ *            process, the levels below alone hold the envelope
+ *
+ * Neither limit should ever bind. A monitor thread reads the job's CPU time
+ * (smoothed over CPU_SMOOTH_MS) and committed memory - the private bytes of
+ * every process in it - every SAMPLE_MS; pressure is the larger of the two
+ * against its limit. At
+ * RAISE_PRESSURE the engine degrades one level, at most every STEP_MS so a
+ * step shows its effect before the next; below LOWER_PRESSURE for RELAX_MS
+ * it recovers one. Memory at CRITICAL_PRESSURE goes straight to the last
+ * level. Each level adds to the one before, as Settings the host applies:
+ *
+ *   Level        Camera interval  Whisper                 Captions            HTTP (Read class)
+ *   Normal       x1               as configured           on                  as configured
+ *   SlowCamera   x4               as configured           on                  as configured
+ *   FastWhisper  x4               fast tier, 2 threads    on                  as configured
+ *   NoCaptions   x4               fast tier, 2 threads    off, FastVLM freed  as configured
+ *   ShedHttp     x4               fast tier, 2 threads    off, FastVLM freed  1/4 concurrency and rate
+ *
+ * Audio capture and the VAD are never degraded nor capped. Without a job
+ * (before Windows 8 a process already in a job can't join another) the
+ * levels still follow the process's own usage.
+ *
+ * A process can't leave a job: the quota is process-wide and outlives
+ * Stop(); limits of 0 lift it.
+ *
+ * Usage:
+ *   ResourceQuota::Instance().SetLimits({ 25, 5, 2048 });
+ *   ResourceQuota::Instance().Start([](ResourceQuota::Level level, const ResourceQuota::Settings& settings) { ... });
+ *   ResourceQuota::Instance().Stop();
+ *
+ * The callback runs on the monitor thread, once per level change. Thread-safe.
+ */
+class ResourceQuota {
+public:
+    enum class Level { Normal, SlowCamera, FastWhisper, NoCaptions, ShedHttp, Count };
+
+    static constexpr int SAMPLE_MS = 1000;
+    static constexpr int CPU_SMOOTH_MS = 5000;
+    static constexpr double RAISE_PRESSURE = 0.85;
+    static constexpr double LOWER_PRESSURE = 0.65;
+    static constexpr double CRITICAL_PRESSURE = 0.95;   // Memory only: CPU over its cap is slowed, not failed
+    static constexpr int STEP_MS = 10000;
+    static constexpr int RELAX_MS = 30000;
+    static constexpr size_t MAX_JOB_PROCESSES = 64;     // The engine and its workers, with room to spare
+
+    // RuntimeConfig quota.*; 0 leaves that resource unlimited
+    struct Limits {
+        int cpuPercent = 0;             // Of all logical processors
+        int cpuReservePercent = 0;      // Held for the inference workers under contention; at most cpuPercent
+        int memoryMb = 0;
+    };
+
+    // What the host applies for a level
+    struct Settings {
+        int cameraIntervalScale = 1;    // Multiplies the power profile's
+        bool preferFastWhisper = false;
+        int whisperThreadCap = 0;       // 0: no cap of its own
+        bool captionsPaused = false;    // Camera and screen captions; /describe still answers
+        int httpShare = 1;              // AdmissionControl limits divided by this
+    };
+
+    struct Usage {
+        double cpuPercent = -1.0;       // Smoothed, of all logical processors; -1 before the first sample
+        uint64_t memoryBytes = 0;       // Private bytes of the job's processes (the engine's without a job)
+        double pressure = 0.0;          // Largest usage / limit
+    };
+
+    using LevelCallback = std::function<void(Level, const Settings&)>;
+
+    static ResourceQuota& Instance();
+
+    ResourceQuota(const ResourceQuota&) = delete;
+    ResourceQuota& operator=(const ResourceQuota&) = delete;
+
+    /**
+     * @brief Set (or with zeros lift) the job's limits; the first limit creates the job
+     * @return false when the job can't be created, joined or limited (logged); the levels still follow usage
+     */
+    bool SetLimits(const Limits& limits);
+
+    // The monitor thread; Stop() returns to Normal without calling back
+    void Start(LevelCallback onLevel);
+    void Stop();
+
+    Level GetLevel() const { return level.load(); }
+    Settings GetSettings() const { return SettingsFor(GetLevel()); }
+    Usage GetUsage() const;
+
+    static Settings SettingsFor(Level level);
+    static const char* LevelName(Level level);
+
+    /**
+     * @brief {"enforced", "limits": {...}, "usage": {...}, "level", "settings": {...}}
+     */
+    void Write(JsonWriter& writer) const;
+
+    // Prometheus text: level, usage against the limits, level changes
+    std::string FormatPrometheus() const;
+
+private:
+    ResourceQuota() = default;
+    ~ResourceQuota();
+
+    void Run();
+    void Sample(int64_t nowMs);
+    void Decide(int64_t nowMs);
+    uint64_t CpuTime() const;           // 100 ns units: the job's, else the process's
+    uint64_t CommittedMemory() const;   // The job's processes' private bytes, else the process's
+    static int64_t NowMs();
+
+    mutable std::mutex limitsMutex;     // job, limits, enforced
+    HANDLE job = nullptr;
+    Limits limits;
+    bool enforced = false;              // The limits are the job's
+
+    // Monitor thread only
+    uint64_t previousCpuTime = 0;
+    int64_t previousMs = 0;
+    int64_t lastStepMs = 0;
+    int64_t relaxedSinceMs = -1;        // -1: pressure not below LOWER_PRESSURE
+
+    // Published
+    std::atomic<Level> level{Level::Normal};
+    std::atomic<double> cpuSmoothed{-1.0};
+    std::atomic<uint64_t> memoryBytes{0};
+    std::atomic<double> pressure{0.0};
+    std::atomic<uint64_t> levelChanges{0};
+
+    LevelCallback onLevel;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+    std::thread thread;
+};
@@ -0,0 +1,523 @@
+#include "RuntimeConfig.h"
+#include "CameraCadence.h"
+#include "JsonReader.h"
+#include "Log.h"
+#include "SessionBroker.h"
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <windows.h>
+
+namespace {
+
+enum class FieldType { Int, Float, String };
+
+// One configurable value: its key, where it lives in Values, whether it
+// takes effect without a restart, and whether Write() hides it
+struct Field {
+    const char* key;
+    FieldType type;
+    bool hot;
+    void* (*member)(RuntimeConfig::Values& values);
+    bool secret = false;
+};
+
+using V = RuntimeConfig::Values;
+
+// Grouped by section, in the order Write() emits them
+const Field FIELDS[] = {
+    { "http.port", FieldType::Int, false, [](V& v) -> void* { return &v.httpPort; } },
+    { "http.kernel", FieldType::Int, false, [](V& v) -> void* { return &v.httpKernel; } },
+    { "http.max_concurrent", FieldType::Int, true, [](V& v) -> void* { return &v.httpMaxConcurrent; } },
+    { "http.client_rate", FieldType::Float, true, [](V& v) -> void* { return &v.httpClientRate; } },
+    { "http.client_burst", FieldType::Int, true, [](V& v) -> void* { return &v.httpClientBurst; } },
+    { "models.whisper", FieldType::String, false, [](V& v) -> void* { return &v.whisperModel; } },
+    { "models.whisper_fast", FieldType::String, false, [](V& v) -> void* { return &v.whisperFastModel; } },
+    { "models.vad", FieldType::String, false, [](V& v) -> void* { return &v.vadModel; } },
+    { "models.camera", FieldType::String, false, [](V& v) -> void* { return &v.cameraModelDir; } },
+    { "models.camera_regions", FieldType::String, false, [](V& v) -> void* { return &v.cameraRegionModel; } },
+    { "models.sentence_embedder", FieldType::String, false, [](V& v) -> void* { return &v.sentenceEmbedderModel; } },
+    { "models.fusion", FieldType::String, false, [](V& v) -> void* { return &v.fusionModel; } },
+    { "threads.whisper", FieldType::Int, false, [](V& v) -> void* { return &v.whisperThreads; } },
+    { "threads.vision", FieldType::Int, false, [](V& v) -> void* { return &v.visionThreads; } },
+    { "threads.fusion", FieldType::Int, false, [](V& v) -> void* { return &v.fusionThreads; } },
+    { "threads.tasks", FieldType::Int, false, [](V& v) -> void* { return &v.taskThreads; } },
+    { "sessions.max", FieldType::Int, false, [](V& v) -> void* { return &v.maxSessions; } },
+    { "ipc.local", FieldType::Int, false, [](V& v) -> void* { return &v.localIpc; } },
+    { "publish.url", FieldType::String, false, [](V& v) -> void* { return &v.publishUrl; } },
+    { "publish.token", FieldType::String, false, [](V& v) -> void* { return &v.publishToken; }, true },
+    { "publish.node", FieldType::String, false, [](V& v) -> void* { return &v.publishNode; } },
+    { "publish.batch_ms", FieldType::Int, false, [](V& v) -> void* { return &v.publishBatchMs; } },
+    { "publish.buffer_kb", FieldType::Int, false, [](V& v) -> void* { return &v.publishBufferKb; } },
+    { "memory.large_pages", FieldType::Int, false, [](V& v) -> void* { return &v.memoryLargePages; } },
+    { "archive.dir", FieldType::String, false, [](V& v) -> void* { return &v.archiveDir; } },
+    { "archive.max_mb", FieldType::Int, false, [](V& v) -> void* { return &v.archiveMaxMb; } },
+    { "archive.continuous", FieldType::Int, false, [](V& v) -> void* { return &v.archiveContinuous; } },
+    { "audio.pre_roll_ms", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.preRollMs; } },
+    { "audio.vad_on", FieldType::Float, true, [](V& v) -> void* { return &v.segmenter.speechOnThreshold; } },
+    { "audio.vad_off", FieldType::Float, true, [](V& v) -> void* { return &v.segmenter.speechOffThreshold; } },
+    { "audio.silence_ms", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.silenceThresholdMs; } },
+    { "audio.turn_min_ms", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.turnMinSilenceMs; } },
+    { "audio.turn_max_ms", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.turnMaxSilenceMs; } },
+    { "audio.min_speech_ms", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.minSpeechMs; } },
+    { "audio.max_speech_sec", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.maxSpeechSec; } },
+    { "audio.chunk_min_sec", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.chunkMinSec; } },
+    { "audio.chunk_max_sec", FieldType::Int, true, [](V& v) -> void* { return &v.segmenter.chunkMaxSec; } },
+    { "camera.interval_ms", FieldType::Int, true, [](V& v) -> void* { return &v.cameraIntervalMs; } },
+    { "camera.question", FieldType::String, true, [](V& v) -> void* { return &v.cameraQuestion; } },
+    { "camera.dedup_similarity", FieldType::Float, true, [](V& v) -> void* { return &v.cameraDedupSimilarity; } },
+    { "screen.interval_ms", FieldType::Int, true, [](V& v) -> void* { return &v.screenIntervalMs; } },
+    { "screen.ocr", FieldType::Int, true, [](V& v) -> void* { return &v.screenOcr; } },
+    { "log.level", FieldType::String, true, [](V& v) -> void* { return &v.logLevel; } },
+    { "suspend.unload_ms", FieldType::Int, true, [](V& v) -> void* { return &v.suspendUnloadMs; } },
+    { "presence.idle_ms", FieldType::Int, true, [](V& v) -> void* { return &v.presenceIdleMs; } },
+    { "presence.away_ms", FieldType::Int, true, [](V& v) -> void* { return &v.presenceAwayMs; } },
+    { "memory.trim_after_ms", FieldType::Int, true, [](V& v) -> void* { return &v.memoryTrimAfterMs; } },
+    { "quota.cpu_percent", FieldType::Int, true, [](V& v) -> void* { return &v.quotaCpuPercent; } },
+    { "quota.cpu_reserve_percent", FieldType::Int, true, [](V& v) -> void* { return &v.quotaCpuReservePercent; } },
+    { "quota.memory_mb", FieldType::Int, true, [](V& v) -> void* { return &v.quotaMemoryMb; } },
+};
+
+constexpr int MAX_THREADS = 64;
+constexpr size_t MAX_QUESTION_BYTES = 1024;
+
+// "audio.vad_on" -> ("audio", "vad_on")
+std::pair<std::string_view, std::string_view> SplitKey(std::string_view key) {
+    size_t dot = key.find('.');
+    return { key.substr(0, dot), key.substr(dot + 1) };
+}
+
+// "audio.vad_on" -> "PERCEPTION_AUDIO_VAD_ON"
+std::string VariableName(std::string_view key) {
+    std::string name = RuntimeConfig::VARIABLE_PREFIX;
+    for (char ch : key) {
+        name += ch == '.' ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    }
+    return name;
+}
+
+bool Equal(const Field& field, V& a, V& b) {
+    switch (field.type) {
+        case FieldType::Int:    return *static_cast<int*>(field.member(a)) == *static_cast<int*>(field.member(b));
+        case FieldType::Float:  return *static_cast<float*>(field.member(a)) == *static_cast<float*>(field.member(b));
+        case FieldType::String: return *static_cast<std::string*>(field.member(a)) ==
+                                       *static_cast<std::string*>(field.member(b));
+    }
+    return true;
+}
+
+// Whole-string number, so "8O" or "0.5x" is an error rather than a prefix
+bool ParseText(const Field& field, const std::string& text, V& target) {
+    char* end = nullptr;
+    switch (field.type) {
+        case FieldType::Int: {
+            long value = std::strtol(text.c_str(), &end, 10);
+            if (text.empty() || *end != '\0') {
+                return false;
+            }
+            *static_cast<int*>(field.member(target)) = static_cast<int>(value);
+            return true;
+        }
+        case FieldType::Float: {
+            float value = std::strtof(text.c_str(), &end);
+            if (text.empty() || *end != '\0') {
+                return false;
+            }
+            *static_cast<float*>(field.member(target)) = value;
+            return true;
+        }
+        case FieldType::String:
+            *static_cast<std::string*>(field.member(target)) = text;
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+std::string RuntimeConfig::DefaultPath() {
+    char buffer[MAX_PATH];
+    DWORD length = GetEnvironmentVariableA(FILE_VARIABLE, buffer, sizeof(buffer));
+    return length > 0 && length < sizeof(buffer) ? std::string(buffer, length) : DEFAULT_FILE;
+}
+
+bool RuntimeConfig::Load(const std::string& configPath, std::string& error) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    path = configPath;
+    Values next;
+    if (!ReadLayers(next, error) || !Validate(next, error)) {
+        return false;
+    }
+    startup = next;
+    Publish(next);
+    return true;
+}
+
+bool RuntimeConfig::Reload(std::string& error) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    Values next = *values.Load();
+    if (!ReadLayers(next, error) || !Validate(next, error)) {
+        return false;
+    }
+    Publish(next);
+    return true;
+}
+
+bool RuntimeConfig::Apply(std::string_view json, std::string& error) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    Values next = *values.Load();
+    if (!Overlay(next, json, error) || !Validate(next, error)) {
+        return false;
+    }
+    Publish(next);
+    return true;
+}
+
+bool RuntimeConfig::SetProfile(std::string_view json, bool asStartup, std::string& error) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::string previous = std::move(profile);
+    profile.assign(json.data(), json.size());
+    // From the defaults, so what the previous profile set doesn't linger
+    Values next;
+    if (!ReadLayers(next, error) || !Validate(next, error)) {
+        profile = std::move(previous);
+        return false;
+    }
+    if (asStartup) {
+        startup = next;
+    }
+    Publish(next);
+    return true;
+}
+
+bool RuntimeConfig::CheckProfile(std::string_view json, bool hotOnly, std::string& error) const {
+    Values current = *values.Load();
+    Values candidate = current;
+    if (!Overlay(candidate, json, error) || !Validate(candidate, error)) {
+        return false;
+    }
+    if (hotOnly) {
+        for (const std::string& key : Diff(current, candidate)) {
+            for (const Field& field : FIELDS) {
+                if (!field.hot && key == field.key) {
+                    error = key + ": needs a restart";
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool RuntimeConfig::ReadLayers(Values& target, std::string& error) const {
+    if (!ReadFile(target, error)) {
+        return false;
+    }
+    if (!profile.empty() && !Overlay(target, profile, error)) {
+        error = "profile: " + error;
+        return false;
+    }
+    return OverlayEnvironment(target, error);
+}
+
+void RuntimeConfig::Publish(const Values& next) {
+    values.Update([&next](Values& current) {
+        current = next;
+        return true;
+    });
+}
+
+bool RuntimeConfig::ReadFile(Values& target, std::string& error) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        LOG_DEBUG("Config", "No " << path << "; using defaults and environment");
+        return true;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    if (!Overlay(target, contents.str(), error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    LOG_INFO("Config", "Loaded " << path);
+    return true;
+}
+
+bool RuntimeConfig::Overlay(Values& target, std::string_view json, std::string& error) {
+    size_t errorOffset = 0;
+    JsonValue document = JsonReader::Parse(json, &errorOffset);
+    if (!document.IsObject()) {
+        error = document.IsValid() ? "expected an object" : "invalid JSON at offset " + std::to_string(errorOffset);
+        return false;
+    }
+
+    // Unknown keys are most likely typos; say so, but they don't fail the load
+    std::string scratch;
+    size_t sectionCursor = 0;
+    JsonValue section;
+    std::string_view sectionName;
+    while (document.Next(sectionCursor, section, &sectionName)) {
+        size_t memberCursor = 0;
+        JsonValue member;
+        std::string_view memberName;
+        while (section.Next(memberCursor, member, &memberName)) {
+            bool known = false;
+            for (const Field& field : FIELDS) {
+                auto parts = SplitKey(field.key);
+                known = known || (parts.first == sectionName && parts.second == memberName);
+            }
+            if (!known) {
+                LOG_WARNING("Config", "Ignoring unknown key " << sectionName << "." << memberName);
+            }
+        }
+    }
+
+    for (const Field& field : FIELDS) {
+        auto parts = SplitKey(field.key);
+        JsonValue value = document[parts.first][parts.second];
+        if (!value.IsValid()) {
+            continue;
+        }
+        bool typed = field.type == FieldType::String ? value.IsString() : value.IsNumber();
+        if (!typed) {
+            error = std::string(field.key) + ": expected a " + (field.type == FieldType::String ? "string" : "number");
+            return false;
+        }
+        switch (field.type) {
+            case FieldType::Int:
+                *static_cast<int*>(field.member(target)) = static_cast<int>(value.AsInt());
+                break;
+            case FieldType::Float:
+                *static_cast<float*>(field.member(target)) = static_cast<float>(value.AsDouble());
+                break;
+            case FieldType::String:
+                *static_cast<std::string*>(field.member(target)) = std::string(value.AsString(scratch));
+                break;
+        }
+    }
+    return true;
+}
+
+bool RuntimeConfig::OverlayEnvironment(Values& target, std::string& error) {
+    for (const Field& field : FIELDS) {
+        std::string name = VariableName(field.key);
+        char buffer[MAX_PATH];
+        DWORD length = GetEnvironmentVariableA(name.c_str(), buffer, sizeof(buffer));
+        if (length == 0 || length >= sizeof(buffer)) {
+            continue;
+        }
+        if (!ParseText(field, std::string(buffer, length), target)) {
+            error = name + ": not a number";
+            return false;
+        }
+        LOG_DEBUG("Config", field.key << " from " << name);
+    }
+    return true;
+}
+
+bool RuntimeConfig::Validate(const Values& candidate, std::string& error) {
+    if (candidate.httpPort < 1 || candidate.httpPort > 65535) {
+        error = "http.port: 1-65535";
+        return false;
+    }
+    if (candidate.httpKernel != 0 && candidate.httpKernel != 1) {
+        error = "http.kernel: 0 (Winsock) or 1 (http.sys)";
+        return false;
+    }
+    if (candidate.httpMaxConcurrent < 8 || candidate.httpMaxConcurrent > 4096) {
+        error = "http.max_concurrent: 8-4096";
+        return false;
+    }
+    if (!(candidate.httpClientRate >= 0.0f && candidate.httpClientRate <= 10000.0f)) {
+        error = "http.client_rate: 0 (unlimited) to 10000 requests a second";
+        return false;
+    }
+    if (candidate.httpClientBurst < 1 || candidate.httpClientBurst > 10000) {
+        error = "http.client_burst: 1-10000";
+        return false;
+    }
+    for (int threads : { candidate.whisperThreads, candidate.visionThreads, candidate.fusionThreads,
+                         candidate.taskThreads }) {
+        if (threads < 0 || threads > MAX_THREADS) {
+            error = "threads.*: 0 (automatic) to " + std::to_string(MAX_THREADS);
+            return false;
+        }
+    }
+    if (candidate.maxSessions < 0 || candidate.maxSessions > static_cast<int>(SessionBroker::MAX_SESSIONS_LIMIT)) {
+        error = "sessions.max: 0 (console only) to " + std::to_string(SessionBroker::MAX_SESSIONS_LIMIT);
+        return false;
+    }
+    if (candidate.localIpc != 0 && candidate.localIpc != 1) {
+        error = "ipc.local: 0 (HTTP only) or 1";
+        return false;
+    }
+    if (candidate.memoryLargePages != 0 && candidate.memoryLargePages != 1) {
+        error = "memory.large_pages: 0 or 1";
+        return false;
+    }
+    if (candidate.archiveMaxMb < 16) {
+        error = "archive.max_mb: 16 and more";
+        return false;
+    }
+    if (candidate.archiveContinuous != 0 && candidate.archiveContinuous != 1) {
+        error = "archive.continuous: 0 (speech segments only) or 1";
+        return false;
+    }
+    // Context leaves the machine only over TLS
+    if (!candidate.publishUrl.empty() && candidate.publishUrl.rfind("https://", 0) != 0) {
+        error = "publish.url: empty (off) or an https:// URL";
+        return false;
+    }
+    if (candidate.publishBatchMs < 1000 || candidate.publishBatchMs > 600000) {
+        error = "publish.batch_ms: 1000-600000";
+        return false;
+    }
+    if (candidate.publishBufferKb < 64 || candidate.publishBufferKb > 1024 * 1024) {
+        error = "publish.buffer_kb: 64-1048576";
+        return false;
+    }
+    if (!AudioCaptureEngine::IsValidSegmenterConfig(candidate.segmenter)) {
+        error = "audio: pre_roll_ms 0-1000, 0 < vad_off <= vad_on < 1, silence_ms > 0, min_speech_ms >= 0, "
+                "max_speech_sec 1-30, chunk_max_sec 0 or 1 <= chunk_min_sec < chunk_max_sec <= max_speech_sec";
+        return false;
+    }
+    if (candidate.cameraIntervalMs < 1000 || candidate.cameraIntervalMs > CameraCadence::MAX_INTERVAL_MS) {
+        error = "camera.interval_ms: 1000-" + std::to_string(CameraCadence::MAX_INTERVAL_MS);
+        return false;
+    }
+    if (candidate.cameraQuestion.size() > MAX_QUESTION_BYTES ||
+        candidate.cameraQuestion.find("<image>") != std::string::npos) {
+        error = "camera.question: up to " + std::to_string(MAX_QUESTION_BYTES) + " bytes, without <image>";
+        return false;
+    }
+    if (!(candidate.cameraDedupSimilarity >= 0.5f && candidate.cameraDedupSimilarity <= 1.0f)) {
+        error = "camera.dedup_similarity: 0.5-1 (1: every caption kept)";
+        return false;
+    }
+    if (candidate.screenIntervalMs != 0 &&
+        (candidate.screenIntervalMs < 1000 || candidate.screenIntervalMs > CameraCadence::MAX_INTERVAL_MS)) {
+        error = "screen.interval_ms: 0 (off) or 1000-" + std::to_string(CameraCadence::MAX_INTERVAL_MS);
+        return false;
+    }
+    if (candidate.screenOcr != 0 && candidate.screenOcr != 1) {
+        error = "screen.ocr: 0 or 1";
+        return false;
+    }
+    if (candidate.suspendUnloadMs < 0) {
+        error = "suspend.unload_ms: 0 (never) or more";
+        return false;
+    }
+    if (candidate.presenceIdleMs != 0 && candidate.presenceIdleMs < 10000) {
+        error = "presence.idle_ms: 0 (off) or 10000 and more";
+        return false;
+    }
+    if (candidate.presenceAwayMs < candidate.presenceIdleMs) {
+        error = "presence.away_ms: presence.idle_ms or more";
+        return false;
+    }
+    if (candidate.memoryTrimAfterMs != 0 && candidate.memoryTrimAfterMs < 10000) {
+        error = "memory.trim_after_ms: 0 (never) or 10000 and more";
+        return false;
+    }
+    if (candidate.quotaCpuPercent != 0 && (candidate.quotaCpuPercent < 5 || candidate.quotaCpuPercent > 100)) {
+        error = "quota.cpu_percent: 0 (unlimited) or 5-100";
+        return false;
+    }
+    if (candidate.quotaCpuReservePercent < 0 || candidate.quotaCpuReservePercent > 100) {
+        error = "quota.cpu_reserve_percent: 0-100";
+        return false;
+    }
+    // Below that the models alone don't fit
+    if (candidate.quotaMemoryMb != 0 && (candidate.quotaMemoryMb < 512 || candidate.quotaMemoryMb > 1024 * 1024)) {
+        error = "quota.memory_mb: 0 (unlimited) or 512 and more";
+        return false;
+    }
+    Log::Level level;
+    if (!candidate.logLevel.empty() && !Log::ParseLevel(candidate.logLevel, level)) {
+        error = "log.level: debug, info, warning, error or off";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> RuntimeConfig::Diff(const Values& before, const Values& after) {
+    Values a = before;
+    Values b = after;
+    std::vector<std::string> changed;
+    for (const Field& field : FIELDS) {
+        if (!Equal(field, a, b)) {
+            changed.push_back(field.key);
+        }
+    }
+    return changed;
+}
+
+std::vector<std::string> RuntimeConfig::GetPendingRestart() const {
+    Values started;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        started = startup;
+    }
+    std::vector<std::string> pending;
+    for (const std::string& key : Diff(started, *values.Load())) {
+        for (const Field& field : FIELDS) {
+            if (!field.hot && key == field.key) {
+                pending.push_back(key);
+            }
+        }
+    }
+    return pending;
+}
+
+void RuntimeConfig::Write(JsonWriter& writer) const {
+    std::vector<std::string> pending = GetPendingRestart();
+    Values current = *values.Load();
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        file = path;
+    }
+
+    writer.BeginObject();
+    writer.Key("file").String(file);
+    writer.Key("values").BeginObject();
+    std::string_view openSection;
+    for (const Field& field : FIELDS) {
+        auto parts = SplitKey(field.key);
+        if (parts.first != openSection) {
+            if (!openSection.empty()) {
+                writer.EndObject();
+            }
+            writer.Key(parts.first).BeginObject();
+            openSection = parts.first;
+        }
+        writer.Key(parts.second);
+        switch (field.type) {
+            case FieldType::Int:    writer.Int(*static_cast<int*>(field.member(current))); break;
+            case FieldType::Float:  writer.Double(*static_cast<float*>(field.member(current)), 3); break;
+            case FieldType::String: {
+                const std::string& value = *static_cast<std::string*>(field.member(current));
+                writer.String(field.secret && !value.empty() ? "(set)" : value);
+                break;
+            }
+        }
+    }
+    if (!openSection.empty()) {
+        writer.EndObject();
+    }
+    writer.EndObject();
+    writer.Key("hot").BeginArray();
+    for (const Field& field : FIELDS) {
+        if (field.hot) {
+            writer.String(field.key);
+        }
+    }
+    writer.EndArray();
+    writer.Key("pendingRestart").BeginArray();
+    for (const std::string& key : pending) {
+        writer.String(key);
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "AudioCaptureEngine.h"
+#include "JsonWriter.h"
+#include "PublishedState.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * RuntimeConfig - Model paths, port, thread counts and tuning knobs, per machine
+ *
+ * Values are layered: built-in defaults, then the JSON file (every key
+ * optional, a missing file is fine), then the experiment profile if one is
+ * set (SetProfile; Experiments), then PERCEPTION_* environment variables. Keys are "section.name"; the file nests them one level and the
+ * environment name is the key upper-cased with '.' as '_':
+ *
+ *   { "http": { "port": 8777 }, "audio": { "vad_on": 0.6 } }
+ *   set PERCEPTION_THREADS_WHISPER=6
+ *
+ *   Startup (read once; a change is reported as pending until restart)
+ *     http.port, http.kernel (1: http.sys serves HTTP, with kernel response caching; HttpSysQueue),
+ *     models.{whisper, whisper_fast, vad, camera, camera_regions, sentence_embedder, fusion},
+ *     threads.{whisper, vision, fusion, tasks} (0: CpuBudget's split),
+ *     sessions.max (user sessions besides the console served by SessionBroker; 0: none),
+ *     ipc.local (1: LocalContextServer's shared memory and pipe next to HTTP; 0: HTTP only),
+ *     publish.{url (https://, empty: off), token (Bearer; shown as "(set)"), node,
+ *              batch_ms, buffer_kb} (ContextPublisher),
+ *     memory.large_pages (1: ORT allocates on large pages, needs "Lock pages in memory"; LargePages),
+ *     archive.{dir (transcribed speech kept there; empty: off), max_mb (oldest files pruned past it),
+ *              continuous (1: the raw microphone stream too)} (AudioArchive)
+ *   Hot (applied as soon as they change)
+ *     audio.{pre_roll_ms, vad_on, vad_off, silence_ms, min_speech_ms, max_speech_sec,
+ *            chunk_min_sec, chunk_max_sec} (AudioCaptureEngine::SegmenterConfig),
+ *     camera.interval_ms (CameraCadence's default wait),
+ *     camera.question (asked about every frame; empty: the built-in caption prompt),
+ *     camera.dedup_similarity (CaptionDeduplicator's threshold; 1: every caption kept), log.level,
+ *     screen.interval_ms (foreground window captioned at most this often when it changed; 0: off),
+ *     screen.ocr (1: the window's text recognized along with the caption; 0: caption only),
+ *     suspend.unload_ms (FastVLM unloaded after this long suspended; 0: kept for a warm resume),
+ *     presence.{idle_ms (no input nor camera activity: pipelines slowed; 0: presence ignored),
+ *               away_ms (then voice paused, camera at its slowest)} (PresenceMonitor),
+ *     memory.trim_after_ms (idle engines give back caches and buffers after this long; 0: never)
+ *                          (MemoryTrimmer),
+ *     http.{max_concurrent, client_rate (0: unlimited), client_burst} (AdmissionControl::Limits),
+ *     quota.{cpu_percent (of all processors; a hard cap on the inference workers only),
+ *            cpu_reserve_percent (held for the workers), memory_mb (engine and workers); 0: unlimited}
+ *           (ResourceQuota; the engine degrades in steps before reaching them)
+ *
+ * Reload() re-reads the file and the environment; Apply() overlays a JSON
+ * document of the same layout (POST /config) on the current values. Either
+ * validates the result as a whole and changes nothing when it fails.
+ * Readers Get() an immutable snapshot without locking.
+ *
+ * Usage:
+ *   RuntimeConfig config;
+ *   config.Load(RuntimeConfig::DefaultPath(), error);
+ *   HttpServer server(config.Get()->httpPort);
+ */
+class RuntimeConfig {
+public:
+    static constexpr const char* DEFAULT_FILE = "perception_engine.json";
+    static constexpr const char* FILE_VARIABLE = "PERCEPTION_CONFIG";     // Overrides DEFAULT_FILE
+    static constexpr const char* VARIABLE_PREFIX = "PERCEPTION_";
+
+    struct Values {
+        // Startup
+        int httpPort = 8777;
+        int httpKernel = 0;
+        std::string whisperModel = "models/whisper/ggml-base.en.bin";       // Used when installed
+        std::string whisperFastModel = "models/whisper/ggml-tiny.en.bin";   // Fallback tier, or the only one
+        std::string vadModel = "models/vad/silero_vad.onnx";
+        std::string cameraModelDir = "models/fastvlm";
+        std::string cameraRegionModel = "models/face_detection_yunet_2023mar.onnx";
+        std::string sentenceEmbedderModel = "models/sentence_embedder/model.onnx"; // Optional
+        std::string fusionModel = "models/llm/fusion.gguf";
+        int whisperThreads = 0;
+        int visionThreads = 0;
+        int fusionThreads = 0;
+        int taskThreads = 0;
+        int maxSessions = 0;
+        int localIpc = 1;
+        std::string publishUrl;
+        std::string publishToken;
+        std::string publishNode;        // Empty: the computer name
+        int publishBatchMs = 5000;
+        int publishBufferKb = 4096;
+        int memoryLargePages = 0;
+        std::string archiveDir;         // Empty: no audio kept
+        int archiveMaxMb = 1024;
+        int archiveContinuous = 0;
+
+        // Hot
+        AudioCaptureEngine::SegmenterConfig segmenter;
+        int cameraIntervalMs = 10000;
+        std::string cameraQuestion;     // Empty: FastVLMTokenizer::DEFAULT_QUESTION
+        float cameraDedupSimilarity = 0.9f;
+        int screenIntervalMs = 0;       // Off: the screen is more private than the camera
+        int screenOcr = 1;
+        int suspendUnloadMs = 0;
+        int presenceIdleMs = 2 * 60 * 1000;
+        int presenceAwayMs = 10 * 60 * 1000;
+        int memoryTrimAfterMs = 2 * 60 * 1000;
+        std::string logLevel;           // Empty: leave the level alone
+        int httpMaxConcurrent = 64;
+        float httpClientRate = 20.0f;   // Read requests per second per client
+        int httpClientBurst = 40;
+        int quotaCpuPercent = 0;
+        int quotaCpuReservePercent = 5;
+        int quotaMemoryMb = 0;
+    };
+
+    RuntimeConfig() = default;
+
+    RuntimeConfig(const RuntimeConfig&) = delete;
+    RuntimeConfig& operator=(const RuntimeConfig&) = delete;
+
+    /**
+     * @brief $PERCEPTION_CONFIG, else DEFAULT_FILE
+     */
+    static std::string DefaultPath();
+
+    /**
+     * @brief Defaults, then `path`, then the environment; the result becomes the startup values
+     * @return false with `error` set when the file or a variable is malformed (defaults stay)
+     */
+    bool Load(const std::string& path, std::string& error);
+
+    /**
+     * @brief Current values, then the file and environment again
+     */
+    bool Reload(std::string& error);
+
+    /**
+     * @brief Overlay a JSON document (file layout, any subset of keys) on the current values
+     */
+    bool Apply(std::string_view json, std::string& error);
+
+    /**
+     * @brief Make `json` (file layout; empty: none) the profile layer and rebuild
+     *        the values from the defaults up, like Load()
+     * @param asStartup The result also becomes the startup values (before the engines load)
+     */
+    bool SetProfile(std::string_view json, bool asStartup, std::string& error);
+
+    /**
+     * @brief Whether `json` overlays the current values validly; with hotOnly,
+     *        also that it changes no startup key
+     */
+    bool CheckProfile(std::string_view json, bool hotOnly, std::string& error) const;
+
+    std::shared_ptr<const Values> Get() const { return values.Load(); }
+
+    /**
+     * @brief Keys whose value differs between two snapshots
+     */
+    static std::vector<std::string> Diff(const Values& before, const Values& after);
+
+    /**
+     * @brief Startup keys whose current value differs from the one the process started with
+     */
+    std::vector<std::string> GetPendingRestart() const;
+
+    /**
+     * @brief {"file": ..., "values": {file layout}, "pendingRestart": [...]}
+     */
+    void Write(JsonWriter& writer) const;
+
+private:
+    PublishedState<Values> values;
+    Values startup;                     // As loaded by Load(); guarded by writeMutex
+    std::string path;
+    std::string profile;                // SetProfile()'s layer; guarded by writeMutex
+    mutable std::mutex writeMutex;      // Serializes Load / Reload / Apply
+
+    // Overlay `json` onto `target`; names the offending key in `error`
+    static bool Overlay(Values& target, std::string_view json, std::string& error);
+    static bool OverlayEnvironment(Values& target, std::string& error);
+    static bool Validate(const Values& candidate, std::string& error);
+    bool ReadFile(Values& target, std::string& error) const;
+    // The file, the profile and the environment onto `target`
+    bool ReadLayers(Values& target, std::string& error) const;
+    void Publish(const Values& next);
+};
@@ -0,0 +1,112 @@
+#include "SceneArena.h"
+#include "Log.h"
+#include <algorithm>
+
+SceneArena::SceneArena(size_t blockBytes)
+    : blockBytes((std::max)(blockBytes, static_cast<size_t>(4096))) {
+}
+
+SceneArena::~SceneArena() = default;
+
+void* SceneArena::Allocate(size_t bytes, size_t alignment) {
+    bytes = (std::max)(bytes, static_cast<size_t>(1));
+    for (;;) {
+        if (current < blocks.size()) {
+            Block& block = blocks[current];
+            size_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t offset = ((base + block.used + alignment - 1) & ~(alignment - 1)) - base;
+            if (offset + bytes <= block.size) {
+                block.used = offset + bytes;
+                highWaterBytes = (std::max)(highWaterBytes, UsedBytes());
+                return block.data.get() + offset;
+            }
+        }
+
+        // Blocks after the current one are empty: take the first big enough,
+        // moved up so the order of use stays the order of the vector
+        size_t needed = bytes + alignment;
+        size_t next = current < blocks.size() ? current + 1 : current;
+        auto found = std::find_if(blocks.begin() + next, blocks.end(),
+                                  [needed](const Block& block) { return block.size >= needed; });
+        if (found != blocks.end()) {
+            std::rotate(blocks.begin() + next, found, found + 1);
+        } else {
+            Block block;
+            block.size = (std::max)(blockBytes, needed);
+            block.data.reset(new char[block.size]);
+            reservedBytes += block.size;
+            blocks.insert(blocks.begin() + next, std::move(block));
+            LOG_DEBUG("Arena", "Scene arena grew to " << blocks.size() << " blocks ("
+                      << (reservedBytes / 1024) << " KB)");
+        }
+        current = next;
+        blocks[current].used = 0;
+    }
+}
+
+SceneArena::Marker SceneArena::Mark() const {
+    Marker marker;
+    marker.block = current;
+    marker.offset = current < blocks.size() ? blocks[current].used : 0;
+    return marker;
+}
+
+void SceneArena::Rewind(const Marker& marker) {
+    for (size_t index = marker.block + 1; index < blocks.size(); ++index) {
+        blocks[index].used = 0;
+    }
+    current = marker.block;
+    if (current < blocks.size()) {
+        blocks[current].used = marker.offset;
+    }
+}
+
+void SceneArena::Reset() {
+    Rewind(Marker());
+}
+
+void SceneArena::Release() {
+    blocks.clear();
+    blocks.shrink_to_fit();
+    current = 0;
+    reservedBytes = 0;
+}
+
+size_t SceneArena::UsedBytes() const {
+    size_t used = 0;
+    for (size_t index = 0; index <= current && index < blocks.size(); ++index) {
+        used += blocks[index].used;
+    }
+    return used;
+}
+
+// ============================================================================
+// ONNX Runtime Allocator
+// ============================================================================
+
+OrtAllocator* SceneArena::GetOrtAllocator() {
+    if (!ortView) {
+        ortView = std::make_unique<OrtView>();
+        ortView->version = ORT_API_VERSION;
+        ortView->Alloc = &SceneArena::OrtAlloc;
+        ortView->Free = &SceneArena::OrtFree;
+        ortView->Info = &SceneArena::OrtInfo;
+        ortView->Reserve = &SceneArena::OrtAlloc;
+        ortView->arena = this;
+        ortView->info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault);
+    }
+    return ortView.get();
+}
+
+void* ORT_API_CALL SceneArena::OrtAlloc(OrtAllocator* self, size_t size) {
+    // 64 bytes: what ORT's own CPU allocator guarantees for vectorized kernels
+    return static_cast<OrtView*>(self)->arena->Allocate(size, 64);
+}
+
+void ORT_API_CALL SceneArena::OrtFree(OrtAllocator*, void*) {
+    // Reclaimed when the scope that allocated it is rewound
+}
+
+const OrtMemoryInfo* ORT_API_CALL SceneArena::OrtInfo(const OrtAllocator* self) {
+    return static_cast<const OrtView*>(self)->info;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * SceneArena - Bump allocator for the scratch memory of one caption
+ *
+ * A caption's decode loop needs the same short-lived buffers every step:
+ * position ids, the tensor handles bound for the KV banks, the logits ORT
+ * writes, per-sequence bookkeeping in batched generation. Taken from the
+ * heap they cost an allocation and a free per step, and over days of
+ * captions the varying sizes (prompt length, draft count, batch) fragment
+ * the heap. Here they come from a few large blocks that are kept for the
+ * life of the engine:
+ *
+ *   Allocate()      bumps an offset; moves to the next block when the
+ *                   current one is full (a new block only while the arena
+ *                   is still growing to its high-water mark)
+ *   Scope           marks on construction and rewinds on destruction: one
+ *                   around a caption, one around each decode step
+ *   Reset()         rewinds everything; blocks stay allocated
+ *
+ * Nothing is freed individually, so a pointer stays valid until the scope
+ * it was allocated in ends. Once every block a caption needs exists, a
+ * caption makes no heap allocation through the arena at all; GetBlockCount
+ * only grows while a larger scene than any before comes along.
+ *
+ * GetOrtAllocator() exposes the arena to ONNX Runtime (Alloc bumps, Free
+ * does nothing), for output tensors the engine creates itself with
+ * Ort::Value::CreateTensor(allocator, ...). ArenaAllocator<T> does the same
+ * for standard containers.
+ *
+ * Not thread-safe: one arena belongs to one caption thread at a time
+ * (CameraVisionEngine serializes captions on captionMutex).
+ */
+class SceneArena {
+public:
+    static constexpr size_t DEFAULT_BLOCK_BYTES = 4 * 1024 * 1024;
+
+    struct Marker {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    // Rewinds to where the arena was when it was constructed
+    class Scope {
+    public:
+        explicit Scope(SceneArena& arena) : arena(arena), marker(arena.Mark()) {}
+        ~Scope() { arena.Rewind(marker); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        SceneArena& arena;
+        Marker marker;
+    };
+
+    explicit SceneArena(size_t blockBytes = DEFAULT_BLOCK_BYTES);
+    ~SceneArena();
+
+    SceneArena(const SceneArena&) = delete;
+    SceneArena& operator=(const SceneArena&) = delete;
+
+    /**
+     * @brief Uninitialized memory, valid until the enclosing scope is rewound
+     * @param alignment Power of two, at most 4096
+     */
+    void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T* AllocateArray(size_t count) {
+        return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    Marker Mark() const;
+    void Rewind(const Marker& marker);
+    void Reset();
+
+    /**
+     * @brief Free every block (models unloaded); nothing may be in use
+     */
+    void Release();
+
+    // ONNX Runtime view of the arena (CPU memory); lives as long as the arena
+    OrtAllocator* GetOrtAllocator();
+
+    size_t GetReservedBytes() const { return reservedBytes; }    // Blocks held
+    size_t GetHighWaterBytes() const { return highWaterBytes; }  // Most ever in use at once
+    size_t GetBlockCount() const { return blocks.size(); }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    struct OrtView : OrtAllocator {
+        SceneArena* arena = nullptr;
+        Ort::MemoryInfo info{nullptr};
+    };
+
+    static void* ORT_API_CALL OrtAlloc(OrtAllocator* self, size_t size);
+    static void ORT_API_CALL OrtFree(OrtAllocator* self, void* pointer);
+    static const OrtMemoryInfo* ORT_API_CALL OrtInfo(const OrtAllocator* self);
+
+    size_t UsedBytes() const;
+
+    size_t blockBytes;
+    std::vector<Block> blocks;
+    size_t current = 0;                 // Block Allocate() bumps in
+    size_t reservedBytes = 0;
+    size_t highWaterBytes = 0;
+    std::unique_ptr<OrtView> ortView;   // Created on first use
+};
+
+/**
+ * ArenaAllocator - Standard allocator over a SceneArena
+ *
+ * deallocate() is a no-op, so a container that grows leaves its old buffer
+ * in the arena until the scope ends; reserve() up front where the size is
+ * known.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(SceneArena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->AllocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U> friend class ArenaAllocator;
+    SceneArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
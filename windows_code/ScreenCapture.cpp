@@ -0,0 +1,421 @@
+#include "ScreenCapture.h"
+#include <d3d10.h>
+#include <dxgi.h>
+#include <windows.graphics.capture.interop.h>
+#include <windows.graphics.directx.direct3d11.interop.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include "Log.h"
+#include "Trace.h"
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "dxgi.lib")
+#pragma comment(lib, "windowsapp.lib")
+
+using winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame;
+using winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool;
+using winrt::Windows::Graphics::Capture::GraphicsCaptureItem;
+using winrt::Windows::Graphics::Capture::GraphicsCaptureSession;
+using winrt::Windows::Graphics::DirectX::DirectXPixelFormat;
+
+ScreenCapture::ScreenCapture()
+    : target(nullptr)
+    , poolWidth(0)
+    , poolHeight(0)
+    , mipWidth(0)
+    , mipHeight(0)
+    , mipLevel(0)
+    , maxSide(DEFAULT_MAX_SIDE)
+    , sessionGeneration(0)
+    , referenceTilesX(0)
+    , referenceTilesY(0)
+    , sequence(0)
+    , framesArrived(0)
+    , framesRead(0)
+    , framesUnchanged(0)
+    , retargets(0)
+{
+}
+
+ScreenCapture::~ScreenCapture() {
+    Stop();
+}
+
+bool ScreenCapture::IsSupported() {
+    try {
+        return GraphicsCaptureSession::IsSupported();
+    }
+    catch (...) {
+        return false;       // Before 1903 the type doesn't exist
+    }
+}
+
+bool ScreenCapture::Start() {
+    if (device) {
+        return true;
+    }
+    if (!IsSupported()) {
+        LOG_WARNING("Screen", "Windows.Graphics.Capture unavailable (Windows 10 1903 or later needed)");
+        return false;
+    }
+    HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+                                   nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, &context);
+    if (FAILED(hr)) {
+        LOG_WARNING("Screen", "No D3D11 device for screen capture (hr=0x" << std::hex << hr << std::dec << ")");
+        return false;
+    }
+    // The frame pool's thread-pool threads use the device as well
+    CComQIPtr<ID3D10Multithread> multithread(device);
+    if (multithread) {
+        multithread->SetMultithreadProtected(TRUE);
+    }
+
+    CComQIPtr<IDXGIDevice> dxgiDevice(device);
+    winrt::com_ptr<::IInspectable> inspectable;
+    if (!dxgiDevice || FAILED(CreateDirect3D11DeviceFromDXGIDevice(dxgiDevice, inspectable.put()))) {
+        LOG_WARNING("Screen", "Cannot wrap the D3D11 device for Windows.Graphics.Capture");
+        context.Release();
+        device.Release();
+        return false;
+    }
+    winrtDevice = inspectable.as<winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice>();
+    return true;
+}
+
+void ScreenCapture::Stop() {
+    CloseSession();
+    target = nullptr;
+    referenceHashes.clear();
+    stagingTexture.Release();
+    mipView.Release();
+    mipTexture.Release();
+    mipWidth = mipHeight = mipLevel = 0;
+    winrtDevice = nullptr;
+    context.Release();
+    device.Release();
+}
+
+void ScreenCapture::CloseSession() {
+    if (framePool) {
+        framePool.FrameArrived(frameArrivedToken);
+    }
+    if (session) {
+        session.Close();
+    }
+    if (framePool) {
+        framePool.Close();
+    }
+    session = nullptr;
+    framePool = nullptr;
+    item = nullptr;
+    poolWidth = poolHeight = 0;
+
+    // A handler still running for the old pool sees the generation move and drops its frame
+    Direct3D11CaptureFrame stale{ nullptr };
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        sessionGeneration++;
+        stale = std::exchange(latestFrame, nullptr);
+    }
+    if (stale) {
+        stale.Close();
+    }
+}
+
+bool ScreenCapture::SetTarget(HWND window) {
+    if (window == target && (session || !window)) {
+        return true;
+    }
+    CloseSession();
+    target = nullptr;
+    referenceHashes.clear();        // The next frame is a new picture, all of it changed
+    if (!window) {
+        return true;
+    }
+    if (!device) {
+        return false;
+    }
+
+    try {
+        auto interop = winrt::get_activation_factory<GraphicsCaptureItem, IGraphicsCaptureItemInterop>();
+        winrt::check_hresult(interop->CreateForWindow(window, winrt::guid_of<GraphicsCaptureItem>(),
+                                                      winrt::put_abi(item)));
+        winrt::Windows::Graphics::SizeInt32 size = item.Size();
+        framePool = Direct3D11CaptureFramePool::CreateFreeThreaded(winrtDevice, DirectXPixelFormat::B8G8R8A8UIntNormalized,
+                                                                   FRAME_BUFFERS, size);
+        poolWidth = size.Width;
+        poolHeight = size.Height;
+
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(frameMutex);
+            generation = sessionGeneration;
+        }
+        // Keep only the newest frame; the one it replaces goes back to the pool
+        frameArrivedToken = framePool.FrameArrived([this, generation](const Direct3D11CaptureFramePool& sender,
+                                                                      const winrt::Windows::Foundation::IInspectable&) {
+            Direct3D11CaptureFrame frame = sender.TryGetNextFrame();
+            if (!frame) {
+                return;
+            }
+            framesArrived.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(frameMutex);
+                if (generation == sessionGeneration) {
+                    std::swap(frame, latestFrame);
+                }
+            }
+            if (frame) {
+                frame.Close();
+            }
+        });
+
+        session = framePool.CreateCaptureSession(item);
+        try {
+            session.IsCursorCaptureEnabled(false);      // Windows 10 2004 and later
+        }
+        catch (...) {
+        }
+        try {
+            session.IsBorderRequired(false);            // Windows 11; earlier ones draw a yellow border
+        }
+        catch (...) {
+        }
+        session.StartCapture();
+    }
+    catch (const winrt::hresult_error& error) {
+        LOG_DEBUG("Screen", "Window not capturable: " << winrt::to_string(error.message()));
+        CloseSession();
+        return false;
+    }
+    target = window;
+    retargets.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// The first mip level whose longer side fits maxSide, as a mip chain at the
+// content size plus a staging texture of that level
+bool ScreenCapture::EnsureTextures(int width, int height) {
+    int level = 0;
+    while ((std::max)(width >> level, height >> level) > maxSide && (width >> (level + 1)) > 0 &&
+           (height >> (level + 1)) > 0) {
+        level++;
+    }
+    if (stagingTexture && width == mipWidth && height == mipHeight && level == mipLevel) {
+        return true;
+    }
+    stagingTexture.Release();
+    mipView.Release();
+    mipTexture.Release();
+    mipWidth = mipHeight = mipLevel = 0;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = static_cast<UINT>(width);
+    desc.Height = static_cast<UINT>(height);
+    desc.MipLevels = static_cast<UINT>(level + 1);
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    if (level > 0) {
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+        desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+        if (FAILED(device->CreateTexture2D(&desc, nullptr, &mipTexture)) ||
+            FAILED(device->CreateShaderResourceView(mipTexture, nullptr, &mipView))) {
+            LOG_WARNING("Screen", "Cannot create the " << width << "x" << height << " mip chain");
+            mipTexture.Release();
+            return false;
+        }
+    }
+
+    desc.Width = static_cast<UINT>((std::max)(1, width >> level));
+    desc.Height = static_cast<UINT>((std::max)(1, height >> level));
+    desc.MipLevels = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.MiscFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    if (FAILED(device->CreateTexture2D(&desc, nullptr, &stagingTexture))) {
+        LOG_WARNING("Screen", "Cannot create the readback texture");
+        mipView.Release();
+        mipTexture.Release();
+        return false;
+    }
+    mipWidth = width;
+    mipHeight = height;
+    mipLevel = level;
+    return true;
+}
+
+bool ScreenCapture::ReadBack(ID3D11Texture2D* source, int width, int height, cv::Mat& image) {
+    TRACE_ZONE("ScreenCapture::ReadBack");
+    if (!EnsureTextures(width, height)) {
+        return false;
+    }
+    // Downscaled on the GPU: only the chosen level crosses the bus
+    D3D11_BOX box = { 0, 0, 0, static_cast<UINT>(width), static_cast<UINT>(height), 1 };
+    if (mipLevel == 0) {
+        context->CopySubresourceRegion(stagingTexture, 0, 0, 0, 0, source, 0, &box);
+    } else {
+        context->CopySubresourceRegion(mipTexture, 0, 0, 0, 0, source, 0, &box);
+        context->GenerateMips(mipView);
+        context->CopySubresourceRegion(stagingTexture, 0, 0, 0, 0, mipTexture, static_cast<UINT>(mipLevel), nullptr);
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    if (FAILED(context->Map(stagingTexture, 0, D3D11_MAP_READ, 0, &mapped))) {
+        return false;
+    }
+    int levelWidth = (std::max)(1, width >> mipLevel);
+    int levelHeight = (std::max)(1, height >> mipLevel);
+    image.create(levelHeight, levelWidth, CV_8UC4);
+    const uint8_t* rows = static_cast<const uint8_t*>(mapped.pData);
+    for (int row = 0; row < levelHeight; ++row) {
+        std::memcpy(image.ptr(row), rows + static_cast<size_t>(row) * mapped.RowPitch,
+                    static_cast<size_t>(levelWidth) * 4);
+    }
+    context->Unmap(stagingTexture, 0);
+    return true;
+}
+
+uint64_t ScreenCapture::HashTile(const cv::Mat& image, int x, int y, int width, int height) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+    size_t bytes = static_cast<size_t>(width) * 4;
+    for (int row = y; row < y + height; ++row) {
+        const uint8_t* pixels = image.ptr(row) + static_cast<size_t>(x) * 4;
+        size_t offset = 0;
+        for (; offset + 8 <= bytes; offset += 8) {
+            uint64_t word;
+            std::memcpy(&word, pixels + offset, 8);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 29;
+        }
+        if (offset < bytes) {
+            uint32_t word;
+            std::memcpy(&word, pixels + offset, 4);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 29;
+        }
+    }
+    return hash;
+}
+
+bool ScreenCapture::TakeChanged(Frame& frame, double minChangedShare) {
+    Direct3D11CaptureFrame captured{ nullptr };
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        captured = std::exchange(latestFrame, nullptr);
+    }
+    if (!captured) {
+        return false;
+    }
+
+    bool read = false;
+    int width = 0;
+    int height = 0;
+    try {
+        winrt::Windows::Graphics::SizeInt32 size = captured.ContentSize();
+        // Resized window: later frames come at the new size (this one is clipped to its texture)
+        if (size.Width != poolWidth || size.Height != poolHeight) {
+            framePool.Recreate(winrtDevice, DirectXPixelFormat::B8G8R8A8UIntNormalized, FRAME_BUFFERS, size);
+            poolWidth = size.Width;
+            poolHeight = size.Height;
+        }
+        auto access = captured.Surface().as<::Windows::Graphics::DirectX::Direct3D11::IDirect3DDxgiInterfaceAccess>();
+        CComPtr<ID3D11Texture2D> texture;
+        winrt::check_hresult(access->GetInterface(__uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&texture)));
+        D3D11_TEXTURE2D_DESC desc;
+        texture->GetDesc(&desc);
+        width = (std::min)(size.Width, static_cast<int>(desc.Width));
+        height = (std::min)(size.Height, static_cast<int>(desc.Height));
+        read = width > 0 && height > 0 && ReadBack(texture, width, height, frame.image);
+    }
+    catch (const winrt::hresult_error& error) {
+        LOG_DEBUG("Screen", "Frame readback failed: " << winrt::to_string(error.message()));
+    }
+    captured.Close();
+    if (!read) {
+        return false;
+    }
+    framesRead.fetch_add(1, std::memory_order_relaxed);
+
+    // Tile diff against the last frame handed out
+    const cv::Mat& image = frame.image;
+    int tilesX = (image.cols + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (image.rows + TILE_SIZE - 1) / TILE_SIZE;
+    bool sameGrid = !referenceHashes.empty() && tilesX == referenceTilesX && tilesY == referenceTilesY;
+    std::vector<uint64_t> hashes(static_cast<size_t>(tilesX) * tilesY);
+    int changedTiles = 0;
+    int left = INT_MAX, top = INT_MAX, right = 0, bottom = 0;
+    for (int tileY = 0; tileY < tilesY; ++tileY) {
+        for (int tileX = 0; tileX < tilesX; ++tileX) {
+            int x = tileX * TILE_SIZE;
+            int y = tileY * TILE_SIZE;
+            int tileWidth = (std::min)(TILE_SIZE, image.cols - x);
+            int tileHeight = (std::min)(TILE_SIZE, image.rows - y);
+            size_t index = static_cast<size_t>(tileY) * tilesX + tileX;
+            hashes[index] = HashTile(image, x, y, tileWidth, tileHeight);
+            if (sameGrid && hashes[index] == referenceHashes[index]) {
+                continue;
+            }
+            changedTiles++;
+            left = (std::min)(left, x);
+            top = (std::min)(top, y);
+            right = (std::max)(right, x + tileWidth);
+            bottom = (std::max)(bottom, y + tileHeight);
+        }
+    }
+    if (changedTiles == 0 || changedTiles < minChangedShare * static_cast<double>(hashes.size())) {
+        framesUnchanged.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    referenceHashes = hashes;
+    referenceTilesX = tilesX;
+    referenceTilesY = tilesY;
+    frame.changed = cv::Rect(left, top, right - left, bottom - top);
+    frame.changedTiles = changedTiles;
+    frame.tilesX = tilesX;
+    frame.tilesY = tilesY;
+    frame.tileHashes = std::move(hashes);
+    frame.sourceWidth = width;
+    frame.sourceHeight = height;
+    frame.window = target;
+    frame.sequence = ++sequence;
+    return true;
+}
+
+ScreenCapture::Stats ScreenCapture::GetStats() const {
+    Stats stats;
+    stats.framesArrived = framesArrived.load();
+    stats.framesRead = framesRead.load();
+    stats.framesUnchanged = framesUnchanged.load();
+    stats.retargets = retargets.load();
+    return stats;
+}
+
+std::string ScreenCapture::FormatPrometheus() const {
+    Stats stats = GetStats();
+    std::string out;
+    char line[128];
+    out += "# HELP perception_screen_frames_total Window frames captured, read back, and read back but unchanged\n";
+    out += "# TYPE perception_screen_frames_total counter\n";
+    std::snprintf(line, sizeof(line), "perception_screen_frames_total{stage=\"arrived\"} %llu\n",
+                  static_cast<unsigned long long>(stats.framesArrived));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_screen_frames_total{stage=\"read\"} %llu\n",
+                  static_cast<unsigned long long>(stats.framesRead));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_screen_frames_total{stage=\"unchanged\"} %llu\n",
+                  static_cast<unsigned long long>(stats.framesUnchanged));
+    out += line;
+    out += "# HELP perception_screen_retargets_total Captures moved to a new foreground window\n";
+    out += "# TYPE perception_screen_retargets_total counter\n";
+    std::snprintf(line, sizeof(line), "perception_screen_retargets_total %llu\n",
+                  static_cast<unsigned long long>(stats.retargets));
+    out += line;
+    return out;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11.h>
+#include <atlbase.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <winrt/Windows.Graphics.Capture.h>
+#include <winrt/Windows.Graphics.DirectX.Direct3D11.h>
+
+/**
+ * ScreenCapture - What the foreground window shows, read back only when asked and only where it changed
+ *
+ * Architecture:
+ *   Windows.Graphics.Capture delivers a frame into a free-threaded frame pool
+ *   whenever the target window's content changes (none while it is static).
+ *   FrameArrived only swaps the frame into `latestFrame`, releasing the one
+ *   before: no GPU or CPU work per frame, however fast the window repaints.
+ *   TakeChanged() - called by the consumer at its own, capped rate - takes
+ *   the newest frame and on the GPU copies it into a mip chain,
+ *   GenerateMips(), and copies out only the first level whose longer side
+ *   fits maxSide into a staging texture. That small level is the only CPU
+ *   readback. The readback is cut into TILE_SIZE tiles whose hashes are
+ *   compared with the last frame handed out; unchanged frames are dropped
+ *   there, and a changed one carries the bounding box of its dirty tiles so
+ *   analysis can stay on that region.
+ *
+ *   DirtyRegions() on the capture frame would say the same without the
+ *   hashes, but only on Windows 11 24H2; the tile diff works everywhere and
+ *   also gives per-tile hashes to callers that cache per tile.
+ *
+ * Threads: Start, Stop, SetTarget and TakeChanged belong to one thread (the
+ * consumer; it also owns the D3D11 immediate context). FrameArrived runs on
+ * a capture thread-pool thread and only touches latestFrame.
+ *
+ * Usage:
+ *   ScreenCapture capture;
+ *   capture.Start();
+ *   capture.SetTarget(GetForegroundWindow());
+ *   ScreenCapture::Frame frame;
+ *   if (capture.TakeChanged(frame, 0.01)) { ... frame.image(frame.changed) ... }
+ */
+class ScreenCapture {
+public:
+    struct Frame {
+        cv::Mat image;                      // BGRA, the downscaled level (storage reused call to call)
+        cv::Rect changed;                   // Dirty tiles' bounding box in image; all of it on the first frame
+        int changedTiles = 0;
+        int tilesX = 0;
+        int tilesY = 0;
+        std::vector<uint64_t> tileHashes;   // Row-major, tilesX * tilesY
+        int sourceWidth = 0;                // Window content size before downscaling
+        int sourceHeight = 0;
+        HWND window = nullptr;
+        uint64_t sequence = 0;              // Frames handed out so far
+    };
+
+    struct Stats {
+        uint64_t framesArrived = 0;         // Delivered by the capture (content changes)
+        uint64_t framesRead = 0;            // Downscaled and read back
+        uint64_t framesUnchanged = 0;       // Read back, but below the change threshold
+        uint64_t retargets = 0;             // Successful SetTarget calls
+    };
+
+    static constexpr int TILE_SIZE = 32;
+    static constexpr int DEFAULT_MAX_SIDE = 1280;
+    static constexpr int FRAME_BUFFERS = 2;         // One held in latestFrame, one for the capture to fill
+
+    ScreenCapture();
+    ~ScreenCapture();
+
+    ScreenCapture(const ScreenCapture&) = delete;
+    ScreenCapture& operator=(const ScreenCapture&) = delete;
+
+    /**
+     * @brief Whether this Windows has Windows.Graphics.Capture (1903 and later)
+     */
+    static bool IsSupported();
+
+    /**
+     * @brief Create the D3D11 device
+     * @return false (and logs) without a device or capture support
+     */
+    bool Start();
+
+    /**
+     * @brief End the capture session and release the device
+     */
+    void Stop();
+
+    /**
+     * @brief Capture this window instead (nullptr: none); the next frame is reported as all changed
+     * @return false when the window can't be captured (elevated, cloaked, the shell)
+     */
+    bool SetTarget(HWND window);
+    HWND GetTarget() const { return target; }
+
+    /**
+     * @brief Downscaled readback bound for the longer side (power-of-two steps; call before frames are taken)
+     */
+    void SetMaxSide(int side) { maxSide = side > 0 ? side : DEFAULT_MAX_SIDE; }
+
+    /**
+     * @brief Read back the newest frame if the window changed since the last frame handed out
+     * @param minChangedShare Fraction of tiles that must differ (0: any); smaller changes
+     *        accumulate against the same reference until they add up
+     * @return false when no frame arrived, or it changed too little (frame.image may have been
+     *         overwritten; the rest of frame is left alone)
+     */
+    bool TakeChanged(Frame& frame, double minChangedShare = 0.0);
+
+    Stats GetStats() const;
+
+    /**
+     * @brief Prometheus text: frames arrived, read back and unchanged
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    void CloseSession();
+    bool EnsureTextures(int width, int height);
+    bool ReadBack(ID3D11Texture2D* source, int width, int height, cv::Mat& image);
+    static uint64_t HashTile(const cv::Mat& image, int x, int y, int width, int height);
+
+    CComPtr<ID3D11Device> device;
+    CComPtr<ID3D11DeviceContext> context;
+    winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice winrtDevice{ nullptr };
+
+    winrt::Windows::Graphics::Capture::GraphicsCaptureItem item{ nullptr };
+    winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool framePool{ nullptr };
+    winrt::Windows::Graphics::Capture::GraphicsCaptureSession session{ nullptr };
+    winrt::event_token frameArrivedToken{};
+    HWND target;
+    int poolWidth;
+    int poolHeight;
+
+    // Mip chain at the content size and the staging copy of the level read back
+    CComPtr<ID3D11Texture2D> mipTexture;
+    CComPtr<ID3D11ShaderResourceView> mipView;
+    CComPtr<ID3D11Texture2D> stagingTexture;
+    int mipWidth;
+    int mipHeight;
+    int mipLevel;
+    int maxSide;
+
+    std::mutex frameMutex;                  // The two below
+    winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame latestFrame{ nullptr };
+    uint64_t sessionGeneration;             // Moves when a session closes: its late frames are dropped
+
+    // Reference the next frame is diffed against: the last one handed out
+    std::vector<uint64_t> referenceHashes;
+    int referenceTilesX;
+    int referenceTilesY;
+    uint64_t sequence;
+
+    std::atomic<uint64_t> framesArrived;
+    std::atomic<uint64_t> framesRead;
+    std::atomic<uint64_t> framesUnchanged;
+    std::atomic<uint64_t> retargets;
+};
@@ -0,0 +1,328 @@
+#include "ScreenText.h"
+#include <winrt/Windows.Foundation.Collections.h>
+#include <winrt/Windows.Graphics.Imaging.h>
+#include <winrt/Windows.Storage.Streams.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "Log.h"
+#include "Trace.h"
+
+using winrt::Windows::Graphics::Imaging::BitmapPixelFormat;
+using winrt::Windows::Graphics::Imaging::SoftwareBitmap;
+using winrt::Windows::Media::Ocr::OcrEngine;
+
+namespace {
+
+// Fewer unique rows than this agreeing on an offset is chance, not a scroll
+constexpr int MIN_SCROLL_VOTES = 8;
+
+// OCR wants text about a dozen pixels high: undo at most this much of the downscale
+constexpr double MAX_UPSCALE = 2.0;
+
+uint64_t Mix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+    return hash ^ (hash >> 29);
+}
+
+} // namespace
+
+ScreenText::ScreenText()
+    : previousWindow(nullptr)
+    , previousWidth(0)
+    , rowsSeen(0)
+    , rowsRecognized(0)
+    , bandsRecognized(0)
+    , bandCacheHits(0)
+{
+}
+
+bool ScreenText::Initialize() {
+    try {
+        engine = OcrEngine::TryCreateFromUserProfileLanguages();
+    }
+    catch (const winrt::hresult_error& error) {
+        LOG_WARNING("Screen", "Windows.Media.Ocr unavailable: " << winrt::to_string(error.message()));
+        engine = nullptr;
+        return false;
+    }
+    if (!engine) {
+        LOG_WARNING("Screen", "No OCR language installed for the user's languages; no screen text");
+        return false;
+    }
+    LOG_INFO("Screen", "Screen text OCR in " << winrt::to_string(engine.RecognizerLanguage().DisplayName()));
+    return true;
+}
+
+void ScreenText::Reset() {
+    previousWindow = nullptr;
+    previousWidth = 0;
+    previousRows.clear();
+    previousLines.clear();
+    bandCache.clear();
+}
+
+std::vector<uint64_t> ScreenText::HashRows(const cv::Mat& image) {
+    std::vector<uint64_t> rows(static_cast<size_t>(image.rows));
+    size_t bytes = static_cast<size_t>(image.cols) * image.elemSize();
+    for (int row = 0; row < image.rows; ++row) {
+        const uint8_t* pixels = image.ptr(row);
+        uint64_t hash = 0x9E3779B97F4A7C15ull;
+        size_t offset = 0;
+        for (; offset + 8 <= bytes; offset += 8) {
+            uint64_t word;
+            std::memcpy(&word, pixels + offset, 8);
+            hash = Mix(hash, word);
+        }
+        for (; offset < bytes; ++offset) {
+            hash = Mix(hash, pixels[offset]);
+        }
+        rows[static_cast<size_t>(row)] = hash;
+    }
+    return rows;
+}
+
+uint64_t ScreenText::HashBand(const std::vector<uint64_t>& rows, int top, int bottom) {
+    uint64_t hash = static_cast<uint64_t>(bottom - top);
+    for (int row = top; row < bottom; ++row) {
+        hash = Mix(hash, rows[static_cast<size_t>(row)]);
+    }
+    return hash;
+}
+
+// The offset (previous row = row + offset) most rows that occur once in the
+// previous frame agree on; background rows repeat and don't vote
+int ScreenText::DetectScroll(const std::vector<uint64_t>& rows) const {
+    if (previousRows.empty()) {
+        return 0;
+    }
+    std::unordered_map<uint64_t, int> unique;
+    unique.reserve(previousRows.size());
+    for (size_t row = 0; row < previousRows.size(); ++row) {
+        auto inserted = unique.emplace(previousRows[row], static_cast<int>(row));
+        if (!inserted.second) {
+            inserted.first->second = -1;
+        }
+    }
+    std::unordered_map<int, int> votes;
+    int best = 0;
+    int bestVotes = 0;
+    for (size_t row = 0; row < rows.size(); ++row) {
+        auto match = unique.find(rows[row]);
+        if (match == unique.end() || match->second < 0) {
+            continue;
+        }
+        int offset = match->second - static_cast<int>(row);
+        int count = ++votes[offset];
+        if (count > bestVotes) {
+            best = offset;
+            bestVotes = count;
+        }
+    }
+    int needed = (std::max)(MIN_SCROLL_VOTES, static_cast<int>(rows.size()) / 20);
+    return bestVotes >= needed ? best : 0;
+}
+
+bool ScreenText::Recognize(const cv::Mat& band, double scale, std::vector<Line>& lines) {
+    TRACE_ZONE("ScreenText::Recognize");
+    double maxDimension = static_cast<double>(OcrEngine::MaxImageDimension());
+    scale = (std::min)(scale, maxDimension / (std::max)(band.cols, band.rows));
+    cv::Mat pixels;
+    if (scale != 1.0) {
+        cv::resize(band, pixels, cv::Size(), scale, scale, cv::INTER_LINEAR);
+    } else {
+        pixels = band.clone();          // A band of a larger image isn't contiguous
+    }
+
+    try {
+        uint32_t bytes = static_cast<uint32_t>(pixels.total() * pixels.elemSize());
+        winrt::Windows::Storage::Streams::Buffer buffer(bytes);
+        buffer.Length(bytes);
+        std::memcpy(buffer.data(), pixels.data, bytes);
+        SoftwareBitmap bitmap = SoftwareBitmap::CreateCopyFromBuffer(buffer, BitmapPixelFormat::Bgra8,
+                                                                     pixels.cols, pixels.rows);
+        winrt::Windows::Media::Ocr::OcrResult result = engine.RecognizeAsync(bitmap).get();
+        for (const auto& ocrLine : result.Lines()) {
+            float top = FLT_MAX;
+            float bottom = 0.0f;
+            float left = FLT_MAX;
+            for (const auto& word : ocrLine.Words()) {
+                winrt::Windows::Foundation::Rect rect = word.BoundingRect();
+                top = (std::min)(top, rect.Y);
+                bottom = (std::max)(bottom, rect.Y + rect.Height);
+                left = (std::min)(left, rect.X);
+            }
+            if (top == FLT_MAX) {
+                continue;
+            }
+            Line line;
+            line.text = winrt::to_string(ocrLine.Text());
+            line.top = (std::min)(band.rows - 1, static_cast<int>(top / scale));
+            line.bottom = (std::min)(band.rows, (std::max)(line.top + 1, static_cast<int>(std::ceil(bottom / scale))));
+            line.left = static_cast<int>(left / scale);
+            if (!line.text.empty()) {
+                lines.push_back(std::move(line));
+            }
+        }
+    }
+    catch (const winrt::hresult_error& error) {
+        LOG_DEBUG("Screen", "OCR failed: " << winrt::to_string(error.message()));
+        return false;
+    }
+    return true;
+}
+
+bool ScreenText::Update(const cv::Mat& image, HWND window, int sourceWidth, Result& result) {
+    TRACE_ZONE("ScreenText::Update");
+    if (!engine || image.empty()) {
+        return false;
+    }
+    auto started = std::chrono::steady_clock::now();
+    if (window != previousWindow || image.cols != previousWidth) {
+        previousRows.clear();
+        previousLines.clear();
+    }
+
+    std::vector<uint64_t> rows = HashRows(image);
+    const int height = static_cast<int>(rows.size());
+    const int offset = DetectScroll(rows);
+    std::vector<char> known(rows.size(), 0);
+    for (int row = 0; row < height; ++row) {
+        int previous = row + offset;
+        known[row] = previous >= 0 && previous < static_cast<int>(previousRows.size()) &&
+                     previousRows[previous] == rows[row];
+    }
+
+    // Lines lying entirely on known rows move with the content
+    std::vector<Line> lines;
+    for (const Line& line : previousLines) {
+        Line moved = line;
+        moved.top -= offset;
+        moved.bottom -= offset;
+        if (moved.top >= 0 && moved.bottom <= height &&
+            std::all_of(known.begin() + moved.top, known.begin() + moved.bottom, [](char row) { return row != 0; })) {
+            lines.push_back(std::move(moved));
+        }
+    }
+
+    // The rest in bands: changed runs merged across small gaps, widened by a
+    // margin and over any carried line they touch (which is recognized again)
+    std::vector<std::pair<int, int>> bands;
+    for (int row = 0; row < height;) {
+        if (known[row]) {
+            ++row;
+            continue;
+        }
+        int top = row;
+        while (row < height && !known[row]) {
+            ++row;
+        }
+        if (!bands.empty() && top - bands.back().second <= BAND_MERGE_GAP) {
+            bands.back().second = row;
+        } else {
+            bands.emplace_back(top, row);
+        }
+    }
+    for (auto& band : bands) {
+        band.first = (std::max)(0, band.first - BAND_MARGIN);
+        band.second = (std::min)(height, band.second + BAND_MARGIN);
+        for (const Line& line : lines) {
+            if (line.top < band.second && line.bottom > band.first) {
+                band.first = (std::min)(band.first, line.top);
+                band.second = (std::max)(band.second, line.bottom);
+            }
+        }
+    }
+    std::vector<std::pair<int, int>> merged;
+    for (const auto& band : bands) {
+        if (!merged.empty() && band.first <= merged.back().second) {
+            merged.back().second = (std::max)(merged.back().second, band.second);
+        } else {
+            merged.push_back(band);
+        }
+    }
+    lines.erase(std::remove_if(lines.begin(), lines.end(), [&merged](const Line& line) {
+        return std::any_of(merged.begin(), merged.end(), [&line](const std::pair<int, int>& band) {
+            return line.top < band.second && line.bottom > band.first;
+        });
+    }), lines.end());
+
+    double scale = (std::min)(MAX_UPSCALE, (std::max)(1.0, static_cast<double>(sourceWidth) / image.cols));
+    int recognized = 0;
+    for (const auto& band : merged) {
+        uint64_t key = Mix(HashBand(rows, band.first, band.second), static_cast<uint64_t>(image.cols));
+        std::vector<Line> bandLines;
+        auto cached = bandCache.find(key);
+        if (cached != bandCache.end()) {
+            bandLines = cached->second;
+            bandCacheHits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            if (!Recognize(image(cv::Rect(0, band.first, image.cols, band.second - band.first)), scale, bandLines)) {
+                return false;
+            }
+            recognized += band.second - band.first;
+            bandsRecognized.fetch_add(1, std::memory_order_relaxed);
+            if (bandCache.size() >= MAX_CACHED_BANDS) {
+                bandCache.clear();
+            }
+            bandCache.emplace(key, bandLines);
+        }
+        for (Line& line : bandLines) {
+            line.top += band.first;
+            line.bottom += band.first;
+            lines.push_back(std::move(line));
+        }
+    }
+    std::sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) {
+        return a.top != b.top ? a.top < b.top : a.left < b.left;
+    });
+
+    result.text.clear();
+    for (const Line& line : lines) {
+        if (result.text.size() + line.text.size() + 1 > MAX_TEXT_BYTES) {
+            break;
+        }
+        if (!result.text.empty()) {
+            result.text += '\n';
+        }
+        result.text += line.text;
+    }
+    result.lines = lines.size();
+    result.rows = height;
+    result.rowsRecognized = recognized;
+    result.scrolledBy = offset;
+    result.latencyMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    rowsSeen.fetch_add(static_cast<uint64_t>(height), std::memory_order_relaxed);
+    rowsRecognized.fetch_add(static_cast<uint64_t>(recognized), std::memory_order_relaxed);
+    previousWindow = window;
+    previousWidth = image.cols;
+    previousRows = std::move(rows);
+    previousLines = std::move(lines);
+    return true;
+}
+
+std::string ScreenText::FormatPrometheus() const {
+    std::string out;
+    char line[128];
+    out += "# HELP perception_screen_text_rows_total Image rows OCR looked at, and of them recognized rather than carried\n";
+    out += "# TYPE perception_screen_text_rows_total counter\n";
+    std::snprintf(line, sizeof(line), "perception_screen_text_rows_total{stage=\"seen\"} %llu\n",
+                  static_cast<unsigned long long>(rowsSeen.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_screen_text_rows_total{stage=\"recognized\"} %llu\n",
+                  static_cast<unsigned long long>(rowsRecognized.load()));
+    out += line;
+    out += "# HELP perception_screen_text_bands_total Changed bands recognized, or answered from the band cache\n";
+    out += "# TYPE perception_screen_text_bands_total counter\n";
+    std::snprintf(line, sizeof(line), "perception_screen_text_bands_total{source=\"ocr\"} %llu\n",
+                  static_cast<unsigned long long>(bandsRecognized.load()));
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_screen_text_bands_total{source=\"cache\"} %llu\n",
+                  static_cast<unsigned long long>(bandCacheHits.load()));
+    out += line;
+    return out;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <winrt/Windows.Media.Ocr.h>
+
+/**
+ * ScreenText - Text of the foreground window, recognized only where it is new
+ *
+ * Architecture:
+ *   Each frame (ScreenCapture's downscaled BGRA readback) is hashed per pixel
+ *   row. The row hashes are matched against the previous frame's to find a
+ *   vertical scroll: the offset most unique rows agree on. A row whose
+ *   content equals the previous frame's row at that offset is known, and
+ *   the previous frame's lines lying entirely on known rows are carried over,
+ *   moved by the offset. What is left - rows that are new or changed,
+ *   merged into bands and widened so no line is cut - is looked up in a cache
+ *   of recognized bands by content hash, and only a band seen nowhere before
+ *   goes to Windows.Media.Ocr (upscaled back towards the window's own
+ *   resolution, since OCR wants its text a dozen pixels high). Scrolling a
+ *   page therefore recognizes the lines that scrolled in; switching back to
+ *   a window recognizes nothing it still remembers.
+ *
+ *   Bands of rows rather than ScreenCapture's 32 px tiles: text runs in
+ *   lines across the window, and a scroll moves it by any number of pixels,
+ *   which no tile grid lines up with.
+ *
+ * Single thread (the screen loop); RecognizeAsync is waited on there, so it
+ * must be an MTA thread.
+ *
+ * Usage:
+ *   ScreenText text;
+ *   if (text.Initialize()) {
+ *       ScreenText::Result result;
+ *       text.Update(frame.image, frame.window, frame.sourceWidth, result);
+ *   }
+ */
+class ScreenText {
+public:
+    struct Line {
+        std::string text;
+        int top = 0;                    // Image rows
+        int bottom = 0;
+        int left = 0;
+    };
+
+    struct Result {
+        std::string text;               // Lines top to bottom, '\n'-separated, at most MAX_TEXT_BYTES
+        size_t lines = 0;
+        int rows = 0;                   // Image rows
+        int rowsRecognized = 0;         // Of them, sent to OCR this frame
+        int scrolledBy = 0;             // Rows the content moved up since the last frame (negative: down)
+        float latencyMs = 0.0f;
+    };
+
+    static constexpr size_t MAX_TEXT_BYTES = 8192;
+    static constexpr size_t MAX_CACHED_BANDS = 512;
+    static constexpr int BAND_MERGE_GAP = 8;        // Rows between two changed runs that still make one band
+    static constexpr int BAND_MARGIN = 4;           // Rows added above and below a band
+
+    ScreenText();
+
+    ScreenText(const ScreenText&) = delete;
+    ScreenText& operator=(const ScreenText&) = delete;
+
+    /**
+     * @brief An OCR engine for the user's profile languages
+     * @return false (and logs) when none of them has an OCR language installed
+     */
+    bool Initialize();
+    bool IsReady() const { return engine != nullptr; }
+
+    /**
+     * @brief Recognize what is new in image (BGRA) since the last Update
+     * @param sourceWidth The window's width before downscaling, for the OCR upscale
+     * @return false when recognition failed (the previous lines are kept)
+     */
+    bool Update(const cv::Mat& image, HWND window, int sourceWidth, Result& result);
+
+    /**
+     * @brief Forget the previous frame and the band cache
+     */
+    void Reset();
+
+    /**
+     * @brief Prometheus text: rows seen and recognized, bands recognized and from the cache
+     */
+    std::string FormatPrometheus() const;
+
+private:
+    static std::vector<uint64_t> HashRows(const cv::Mat& image);
+    static uint64_t HashBand(const std::vector<uint64_t>& rows, int top, int bottom);
+    int DetectScroll(const std::vector<uint64_t>& rows) const;
+    bool Recognize(const cv::Mat& band, double scale, std::vector<Line>& lines);
+
+    winrt::Windows::Media::Ocr::OcrEngine engine{ nullptr };
+
+    // The previous frame
+    HWND previousWindow;
+    int previousWidth;
+    std::vector<uint64_t> previousRows;
+    std::vector<Line> previousLines;
+
+    // Recognized bands by content hash; lines relative to the band's top row
+    std::unordered_map<uint64_t, std::vector<Line>> bandCache;
+
+    std::atomic<uint64_t> rowsSeen;
+    std::atomic<uint64_t> rowsRecognized;
+    std::atomic<uint64_t> bandsRecognized;
+    std::atomic<uint64_t> bandCacheHits;
+};
@@ -0,0 +1,266 @@
+#include "SentenceEmbedder.h"
+#include "OrtRuntime.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+bool IsSpace(unsigned char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+// BERT splits every ASCII punctuation character into its own token
+bool IsPunctuation(unsigned char ch) {
+    return (ch >= 33 && ch <= 47) || (ch >= 58 && ch <= 64) || (ch >= 91 && ch <= 96) || (ch >= 123 && ch <= 126);
+}
+
+bool IsContinuationByte(unsigned char ch) {
+    return (ch & 0xC0) == 0x80;
+}
+
+} // namespace
+
+SentenceEmbedder::SentenceEmbedder()
+    : session(nullptr)
+    , memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    , dimensions(0)
+    , sessionBytes(0)
+    , memoryReporterId(0)
+    , clsId(-1)
+    , sepId(-1)
+    , unkId(-1)
+{
+    memoryReporterId = MemoryAccounting::Instance().Register([this](MemoryAccounting::Entries& entries) {
+        entries.push_back({ "ort_session", "sentence_embedder", sessionBytes });
+    });
+}
+
+SentenceEmbedder::~SentenceEmbedder() {
+    MemoryAccounting::Instance().Unregister(memoryReporterId);
+}
+
+bool SentenceEmbedder::LoadVocab(const std::wstring& path) {
+    std::ifstream file{std::filesystem::path(path)};
+    if (!file) {
+        LOG_ERROR("SentenceEmbedder", "Cannot open vocabulary: " << std::filesystem::path(path).u8string());
+        return false;
+    }
+    vocab.clear();
+    std::string line;
+    int64_t id = 0;
+    while (std::getline(file, line)) {
+        // The line number is the id, blank lines included
+        while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+            line.pop_back();
+        }
+        vocab.emplace(line, id++);
+    }
+    auto find = [this](const char* token) {
+        auto it = vocab.find(token);
+        return it == vocab.end() ? int64_t(-1) : it->second;
+    };
+    clsId = find("[CLS]");
+    sepId = find("[SEP]");
+    unkId = find("[UNK]");
+    if (clsId < 0 || sepId < 0 || unkId < 0) {
+        LOG_ERROR("SentenceEmbedder", "Vocabulary lacks [CLS], [SEP] or [UNK]; not a WordPiece vocab.txt");
+        return false;
+    }
+    return true;
+}
+
+bool SentenceEmbedder::Initialize(const std::wstring& modelPath) {
+    std::filesystem::path vocabPath = std::filesystem::path(modelPath).parent_path() / L"vocab.txt";
+    if (!LoadVocab(vocabPath.wstring())) {
+        return false;
+    }
+
+    try {
+        // One private thread: embeddings run between caption decodes and on the
+        // bus workers, and must not queue behind (or take) the vision pool
+        OrtRuntime::SessionConfig config;
+        config.optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+        config.logId = "SentenceEmbedder";
+        config.useGlobalThreadPool = false;
+        config.intraOpThreads = 1;
+        config.interOpThreads = 1;
+        config.freeDimensionOverrides = { {"batch_size", 1}, {"batch", 1} };
+
+        MemoryAccounting::Meter sessionMeter;
+        session = OrtRuntime::Instance().CreateSession(modelPath, config);
+        if (!session) {
+            LOG_ERROR("SentenceEmbedder", "Failed to create sentence embedding session");
+            return false;
+        }
+        sessionBytes = sessionMeter.Bytes();
+
+        // input_ids and attention_mask are required; token_type_ids only if the graph has it
+        Ort::AllocatorWithDefaultOptions allocator;
+        for (size_t i = 0; i < session->GetInputCount(); ++i) {
+            inputNames.push_back(session->GetInputNameAllocated(i, allocator).get());
+        }
+        outputName = session->GetOutputNameAllocated(0, allocator).get();
+        for (const std::string& name : inputNames) {
+            if (name != "input_ids" && name != "attention_mask" && name != "token_type_ids") {
+                LOG_ERROR("SentenceEmbedder", "Unexpected model input " << name);
+                session.reset();
+                return false;
+            }
+        }
+
+        std::vector<float> probe;
+        if (!Run("a person sitting at a desk", probe)) {
+            session.reset();
+            return false;
+        }
+        dimensions = probe.size();
+        LOG_DEBUG("SentenceEmbedder", "Sentence embeddings ready (" << dimensions << " dimensions, "
+                  << vocab.size() << " word pieces)");
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("SentenceEmbedder", "ONNX Runtime error: " << e.what());
+        session.reset();
+        return false;
+    }
+    return true;
+}
+
+void SentenceEmbedder::AppendWordPieces(std::string_view word, std::vector<int64_t>& out) const {
+    if (word.size() > MAX_WORD_BYTES) {
+        out.push_back(unkId);
+        return;
+    }
+    // Greedy longest match, continuations prefixed "##"; any unmatched
+    // remainder makes the whole word [UNK]
+    const size_t mark = out.size();
+    std::string piece;
+    size_t start = 0;
+    while (start < word.size()) {
+        size_t end = word.size();
+        int64_t match = -1;
+        while (end > start) {
+            // Only at code point boundaries: a vocab entry never ends mid-character
+            if (end == word.size() || !IsContinuationByte(static_cast<unsigned char>(word[end]))) {
+                piece.assign(start > 0 ? "##" : "");
+                piece.append(word.substr(start, end - start));
+                auto it = vocab.find(piece);
+                if (it != vocab.end()) {
+                    match = it->second;
+                    break;
+                }
+            }
+            --end;
+        }
+        if (match < 0) {
+            out.resize(mark);
+            out.push_back(unkId);
+            return;
+        }
+        out.push_back(match);
+        start = end;
+    }
+}
+
+void SentenceEmbedder::Tokenize(std::string_view text, std::vector<int64_t>& out) const {
+    out.clear();
+    out.push_back(clsId);
+    std::string word;
+    auto flush = [&]() {
+        if (!word.empty()) {
+            AppendWordPieces(word, out);
+            word.clear();
+        }
+    };
+    for (char c : text) {
+        unsigned char ch = static_cast<unsigned char>(c);
+        if (IsSpace(ch)) {
+            flush();
+        } else if (IsPunctuation(ch)) {
+            flush();
+            word.assign(1, c);
+            flush();
+        } else if (ch >= 0x20 && ch != 0x7F) {
+            word += static_cast<char>(ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch);
+        }
+        if (out.size() >= MAX_TOKENS - 1) {
+            break;
+        }
+    }
+    flush();
+    if (out.size() > MAX_TOKENS - 1) {
+        out.resize(MAX_TOKENS - 1);
+    }
+    out.push_back(sepId);
+}
+
+bool SentenceEmbedder::Embed(std::string_view text, std::vector<float>& embedding) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Run(text, embedding);
+}
+
+bool SentenceEmbedder::Run(std::string_view text, std::vector<float>& out) {
+    TRACE_ZONE("SentenceEmbedder::Embed");
+    if (!session) {
+        return false;
+    }
+    Tokenize(text, ids);
+    const size_t count = ids.size();
+    mask.assign(count, 1);
+    types.assign(count, 0);
+
+    try {
+        const int64_t shape[] = { 1, static_cast<int64_t>(count) };
+        std::vector<Ort::Value> inputs;
+        std::vector<const char*> names;
+        for (const std::string& name : inputNames) {
+            int64_t* data = name == "input_ids" ? ids.data() : name == "attention_mask" ? mask.data() : types.data();
+            inputs.push_back(Ort::Value::CreateTensor<int64_t>(memoryInfo, data, count, shape, 2));
+            names.push_back(name.c_str());
+        }
+        const char* outputNames[] = { outputName.c_str() };
+        std::vector<Ort::Value> outputs = session->Run(Ort::RunOptions{nullptr}, names.data(), inputs.data(),
+                                                       inputs.size(), outputNames, 1);
+
+        auto info = outputs[0].GetTensorTypeAndShapeInfo();
+        std::vector<int64_t> dims = info.GetShape();
+        const float* data = outputs[0].GetTensorData<float>();
+        if (dims.size() == 3 && dims[1] == static_cast<int64_t>(count)) {
+            // Token states: sum over the tokens (all real, no padding); the
+            // normalization below makes it the mean
+            const size_t width = static_cast<size_t>(dims[2]);
+            out.assign(width, 0.0f);
+            for (size_t t = 0; t < count; ++t) {
+                for (size_t d = 0; d < width; ++d) {
+                    out[d] += data[t * width + d];
+                }
+            }
+        } else if (dims.size() == 2) {
+            out.assign(data, data + info.GetElementCount());
+        } else {
+            LOG_ERROR("SentenceEmbedder", "Unexpected output rank " << dims.size());
+            return false;
+        }
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("SentenceEmbedder", "Embedding failed: " << e.what());
+        return false;
+    }
+
+    // Unit length: cosine similarity becomes a dot product
+    double norm = 0.0;
+    for (float v : out) {
+        norm += static_cast<double>(v) * v;
+    }
+    if (norm <= 0.0) {
+        return false;
+    }
+    const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+    for (float& v : out) {
+        v *= scale;
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * SentenceEmbedder - One unit vector per caption or transcript
+ *
+ * A small sentence-embedding model (MiniLM / BGE-small style, BERT WordPiece
+ * vocabulary) maps a sentence to a vector whose dot product with another
+ * one says how close they are in meaning. CaptionDeduplicator compares
+ * successive captions with it; VectorIndex stores them for /search.
+ *
+ * Model contract (vocab.txt next to the model, one WordPiece per line):
+ *   inputs   int64 (1, T)  input_ids, attention_mask, token_type_ids (optional)
+ *   output   float (1, T, D) token states (mean-pooled over the mask here)
+ *            or float (1, D) sentence embedding; normalized here
+ *
+ * Tokenization is BERT's uncased basic tokenizer (lower-case, split on
+ * whitespace and around ASCII punctuation) followed by greedy longest-match
+ * WordPiece; accents are not stripped. Text past MAX_TOKENS is cut off.
+ *
+ * Threading: Embed() serializes on a private mutex; the model runs on a
+ * private single-thread pool, a few milliseconds per sentence.
+ *
+ * Usage:
+ *   SentenceEmbedder embedder;
+ *   embedder.Initialize(L"models/sentence_embedder/model.onnx");
+ *   std::vector<float> vector;
+ *   embedder.Embed("a person at a whiteboard", vector);    // Unit length, GetDimensions() floats
+ */
+class SentenceEmbedder {
+public:
+    static constexpr size_t MAX_TOKENS = 64;            // [CLS] + 62 pieces + [SEP]; captions are short
+    static constexpr size_t MAX_WORD_BYTES = 100;       // Longer words are [UNK], as in BERT
+
+    SentenceEmbedder();
+    ~SentenceEmbedder();
+
+    SentenceEmbedder(const SentenceEmbedder&) = delete;
+    SentenceEmbedder& operator=(const SentenceEmbedder&) = delete;
+
+    // Load the model and the vocab.txt beside it
+    bool Initialize(const std::wstring& modelPath);
+    bool IsInitialized() const { return session != nullptr; }
+
+    // Unit-length embedding of text; false (and logs) on a model error
+    bool Embed(std::string_view text, std::vector<float>& embedding);
+
+    size_t GetDimensions() const { return dimensions; }
+
+    // Private bytes grown while creating the session (for MemoryAccounting)
+    uint64_t GetSessionBytes() const { return sessionBytes; }
+
+private:
+    bool LoadVocab(const std::wstring& path);
+    void Tokenize(std::string_view text, std::vector<int64_t>& ids) const;
+    void AppendWordPieces(std::string_view word, std::vector<int64_t>& ids) const;
+    bool Run(std::string_view text, std::vector<float>& embedding);
+
+    std::unique_ptr<Ort::Session> session;
+    Ort::MemoryInfo memoryInfo;
+    std::vector<std::string> inputNames;
+    std::string outputName;
+    size_t dimensions;
+    uint64_t sessionBytes;
+    uint64_t memoryReporterId;
+
+    std::unordered_map<std::string, int64_t> vocab;
+    int64_t clsId;
+    int64_t sepId;
+    int64_t unkId;
+
+    std::mutex mutex;                   // The session and the scratch below
+    std::vector<int64_t> ids;
+    std::vector<int64_t> mask;
+    std::vector<int64_t> types;
+};
@@ -0,0 +1,155 @@
+#include "SessionAgent.h"
+#include "AudioCaptureEngine.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include "SessionBroker.h"
+#include "WindowsAPIs.h"
+
+SessionAgent::SessionAgent()
+    : pipe(INVALID_HANDLE_VALUE) {
+}
+
+SessionAgent::~SessionAgent() {
+    if (pipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(pipe);
+    }
+}
+
+bool SessionAgent::Connect() {
+    // The broker may be between pipe instances (another agent just connected)
+    DWORD deadline = GetTickCount() + CONNECT_TIMEOUT_MS;
+    while (true) {
+        pipe = CreateFileA(SessionBroker::PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            return true;
+        }
+        DWORD error = GetLastError();
+        DWORD now = GetTickCount();
+        if ((error != ERROR_PIPE_BUSY && error != ERROR_FILE_NOT_FOUND) || static_cast<int32_t>(deadline - now) <= 0) {
+            LOG_ERROR("Agent", "Cannot reach " << SessionBroker::PIPE_NAME << ": " << error);
+            return false;
+        }
+        if (error == ERROR_PIPE_BUSY) {
+            WaitNamedPipeA(SessionBroker::PIPE_NAME, deadline - now);
+        } else {
+            Sleep(500);             // The service is still starting
+        }
+    }
+}
+
+bool SessionAgent::SendLine(const std::string& line) {
+    DWORD written = 0;
+    return WriteFile(pipe, line.data(), static_cast<DWORD>(line.size()), &written, nullptr) &&
+           written == line.size();
+}
+
+bool SessionAgent::ReadLine(std::string& line) {
+    line.clear();
+    char c = 0;
+    DWORD received = 0;
+    while (line.size() < SessionBroker::MAX_MESSAGE_BYTES) {
+        if (!ReadFile(pipe, &c, 1, &received, nullptr) || received == 0) {
+            return false;
+        }
+        if (c == '\n') {
+            return true;
+        }
+        line += c;
+    }
+    return false;
+}
+
+std::string SessionAgent::Hello() {
+    std::string line;
+    JsonWriter writer(line);
+    writer.BeginObject();
+    writer.Key("type").String("hello");
+    writer.Key("version").Int(SessionBroker::PROTOCOL_VERSION);
+    writer.Key("pid").UInt(GetCurrentProcessId());
+    writer.EndObject();
+    line += '\n';
+
+    std::string reply;
+    if (!SendLine(line) || !ReadLine(reply)) {
+        LOG_ERROR("Agent", "No welcome from the broker: " << GetLastError());
+        return "";
+    }
+    JsonValue welcome = JsonReader::Parse(reply);
+    std::string type = welcome["type"].GetString();
+    if (type != "welcome") {
+        LOG_ERROR("Agent", "Broker refused this session: "
+                  << (type == "error" ? welcome["message"].GetString() : reply));
+        return "";
+    }
+    LOG_INFO("Agent", "Serving session " << welcome["session"].AsInt()
+             << (welcome["voice"].AsBool() ? "" : " (no transcription on the service)"));
+    return welcome["ring"].GetString();
+}
+
+int SessionAgent::Run() {
+    if (!Connect()) {
+        return 1;
+    }
+    std::string ringName = Hello();
+    if (ringName.empty() || !ring.Open(ringName)) {
+        return 1;
+    }
+    ring.SetAgentPid(GetCurrentProcessId());
+
+    // Capture only: whatever the service can't keep up with is dropped at the ring
+    AudioCaptureEngine audio;
+    bool capturing = audio.InitializeCaptureOnly([this](bool systemAudio, const float* samples, size_t count) {
+        ring.Write(systemAudio ? SessionAudioRing::Lane::SystemAudio : SessionAudioRing::Lane::Microphone,
+                   samples, count);
+    }) && audio.Start();
+    if (!capturing) {
+        LOG_WARNING("Agent", "No audio capture in this session; reporting apps only");
+    }
+    if (!WindowsAPIs::InitializeActiveAppMonitoring()) {
+        LOG_WARNING("Agent", "Active app monitoring unavailable");
+    }
+
+    uint64_t reportedGeneration = 0;
+    bool connected = true;
+    for (int report = 1; connected; ++report) {
+        uint64_t generation = WindowsAPIs::GetActiveAppGeneration();
+        if (generation != reportedGeneration) {
+            std::string line;
+            JsonWriter writer(line);
+            writer.BeginObject();
+            writer.Key("type").String("app");
+            writer.Key("app").String(WindowsAPIs::GetCurrentForegroundApp());
+            writer.Key("category").String(WindowsAPIs::GetCurrentForegroundCategory());
+            writer.EndObject();
+            line += '\n';
+            connected = SendLine(line);
+            reportedGeneration = generation;
+        }
+        if (connected && report % STATS_EVERY_REPORTS == 0) {
+            std::string line;
+            JsonWriter writer(line);
+            writer.BeginObject();
+            writer.Key("type").String("stats");
+            writer.Key("microphoneDropped").UInt(ring.GetDropped(SessionAudioRing::Lane::Microphone));
+            writer.Key("systemDropped").UInt(ring.GetDropped(SessionAudioRing::Lane::SystemAudio));
+            writer.EndObject();
+            line += '\n';
+            connected = SendLine(line);
+        }
+        // The broker never writes after the welcome: a failing peek is a closed pipe
+        DWORD available = 0;
+        connected = connected && PeekNamedPipe(pipe, nullptr, 0, nullptr, &available, nullptr);
+        if (connected) {
+            Sleep(REPORT_INTERVAL_MS);
+        }
+    }
+
+    LOG_INFO("Agent", "Broker disconnected; exiting");
+    if (capturing) {
+        audio.Stop();
+    }
+    WindowsAPIs::CleanupActiveAppMonitoring();
+    ring.Close();
+    return 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include "SessionAudioRing.h"
+
+/**
+ * SessionAgent - The user-session half of the SessionBroker (--agent)
+ *
+ * Runs in a user session the service can't capture from, with no models:
+ * it says hello on the broker's pipe, opens the audio ring the welcome
+ * names, captures microphone and loopback audio into it, and reports
+ * foreground app changes (and its ring's drop counters) as JSON lines.
+ * Everything else - transcription, the session's context - is the
+ * service's. The agent exits when the pipe closes (the service stopped,
+ * or turned this session away).
+ *
+ * Usage:
+ *   SessionAgent agent;
+ *   return agent.Run();
+ */
+class SessionAgent {
+public:
+    SessionAgent();
+    ~SessionAgent();
+
+    SessionAgent(const SessionAgent&) = delete;
+    SessionAgent& operator=(const SessionAgent&) = delete;
+
+    /**
+     * @brief Connect, capture and report until the broker disconnects
+     * @return Process exit code: 0 after a served session ended, 1 when the
+     *         broker wasn't reachable or refused this session
+     */
+    int Run();
+
+private:
+    HANDLE pipe;
+    SessionAudioRing ring;
+
+    static constexpr DWORD CONNECT_TIMEOUT_MS = 10000;
+    static constexpr DWORD REPORT_INTERVAL_MS = 1000;
+    static constexpr int STATS_EVERY_REPORTS = 5;
+
+    bool Connect();
+    // The welcome's ring name, or empty (refused or malformed)
+    std::string Hello();
+    bool SendLine(const std::string& line);
+    bool ReadLine(std::string& line);
+};
@@ -0,0 +1,177 @@
+#include "SessionAudioRing.h"
+#include "Log.h"
+#include <sddl.h>
+#include <algorithm>
+#include <cstring>
+
+#pragma comment(lib, "advapi32.lib")
+
+SessionAudioRing::SessionAudioRing()
+    : mapping(nullptr), base(nullptr) {
+}
+
+SessionAudioRing::~SessionAudioRing() {
+    Close();
+}
+
+std::string SessionAudioRing::NameFor(DWORD sessionId) {
+    return "Global\\NovaPerceptionSession" + std::to_string(sessionId) + "Audio";
+}
+
+bool SessionAudioRing::Create(const std::string& name, DWORD sessionId, const std::string& userSid) {
+    Close();
+
+    // SYSTEM and administrators own it; the session's user (or, without a
+    // token to name one, interactive users) may read and write
+    std::string sddl = "D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GRGW;;;" + (userSid.empty() ? std::string("IU") : userSid) + ")";
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(sddl.c_str(), SDDL_REVISION_1, &descriptor, nullptr)) {
+        LOG_ERROR("Sessions", "Invalid audio ring DACL " << sddl << ": " << GetLastError());
+        return false;
+    }
+    SECURITY_ATTRIBUTES attributes = { sizeof(attributes), descriptor, FALSE };
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, &attributes, PAGE_READWRITE,
+                                 0, static_cast<DWORD>(MAPPING_SIZE), name.c_str());
+    LocalFree(descriptor);
+    if (!mapping) {
+        LOG_ERROR("Sessions", "CreateFileMapping " << name << " failed: " << GetLastError());
+        return false;
+    }
+
+    base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, MAPPING_SIZE));
+    if (!base) {
+        LOG_ERROR("Sessions", "MapViewOfFile " << name << " failed: " << GetLastError());
+        Close();
+        return false;
+    }
+
+    // Fresh layout every connection; an agent attached to an old mapping re-opens
+    std::memset(base, 0, MAPPING_SIZE);
+    Header* h = header();
+    h->version = VERSION;
+    h->sampleRate = SAMPLE_RATE;
+    h->capacity = CAPACITY;
+    h->sessionId = sessionId;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(h->magic, "NVAR", 4);
+
+    LOG_DEBUG("Sessions", "Mapped " << name << " (" << MAPPING_SIZE / 1024 << " KB)");
+    return true;
+}
+
+bool SessionAudioRing::Open(const std::string& name) {
+    Close();
+
+    mapping = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, name.c_str());
+    if (!mapping) {
+        LOG_ERROR("Sessions", "OpenFileMapping " << name << " failed: " << GetLastError());
+        return false;
+    }
+    base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, MAPPING_SIZE));
+    if (!base) {
+        LOG_ERROR("Sessions", "MapViewOfFile " << name << " failed: " << GetLastError());
+        Close();
+        return false;
+    }
+
+    const Header* h = header();
+    if (std::memcmp(h->magic, "NVAR", 4) != 0 || h->version != VERSION || h->capacity != CAPACITY) {
+        LOG_ERROR("Sessions", name << " is not a version " << VERSION << " audio ring");
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SessionAudioRing::Close() {
+    if (base) {
+        UnmapViewOfFile(base);
+        base = nullptr;
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+}
+
+SessionAudioRing::LaneHeader* SessionAudioRing::LaneAt(Lane lane) const {
+    return reinterpret_cast<LaneHeader*>(base + sizeof(Header) + static_cast<size_t>(lane) * LANE_SIZE);
+}
+
+float* SessionAudioRing::SamplesAt(Lane lane) const {
+    return reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(LaneAt(lane)) + sizeof(LaneHeader));
+}
+
+// ============================================================================
+// Samples (agent -> service)
+// ============================================================================
+
+size_t SessionAudioRing::Write(Lane lane, const float* samples, size_t count) {
+    if (!base || count == 0) {
+        return 0;
+    }
+    LaneHeader* laneHeader = LaneAt(lane);
+    int64_t written = laneHeader->written.load(std::memory_order_relaxed);
+    int64_t read = laneHeader->read.load(std::memory_order_acquire);
+    size_t space = CAPACITY - static_cast<size_t>((std::min)(written - read, static_cast<int64_t>(CAPACITY)));
+    size_t accepted = (std::min)(count, space);
+    if (accepted < count) {
+        laneHeader->dropped.fetch_add(static_cast<int64_t>(count - accepted), std::memory_order_relaxed);
+    }
+
+    // At most two copies: up to the end of the ring, then from its start
+    float* ring = SamplesAt(lane);
+    size_t start = static_cast<size_t>(written % CAPACITY);
+    size_t first = (std::min)(accepted, CAPACITY - start);
+    std::memcpy(ring + start, samples, first * sizeof(float));
+    std::memcpy(ring, samples + first, (accepted - first) * sizeof(float));
+
+    laneHeader->written.store(written + static_cast<int64_t>(accepted), std::memory_order_release);
+    return accepted;
+}
+
+size_t SessionAudioRing::Read(Lane lane, float* out, size_t maxCount) {
+    if (!base) {
+        return 0;
+    }
+    size_t count = (std::min)(Available(lane), maxCount);
+    if (count == 0) {
+        return 0;
+    }
+    LaneHeader* laneHeader = LaneAt(lane);
+    int64_t read = laneHeader->read.load(std::memory_order_relaxed);
+
+    const float* ring = SamplesAt(lane);
+    size_t start = static_cast<size_t>(read % CAPACITY);
+    size_t first = (std::min)(count, CAPACITY - start);
+    std::memcpy(out, ring + start, first * sizeof(float));
+    std::memcpy(out + first, ring, (count - first) * sizeof(float));
+
+    laneHeader->read.store(read + static_cast<int64_t>(count), std::memory_order_release);
+    return count;
+}
+
+size_t SessionAudioRing::Available(Lane lane) const {
+    if (!base) {
+        return 0;
+    }
+    // `written` comes from the agent's process: a value out of range reads as empty or full
+    const LaneHeader* laneHeader = LaneAt(lane);
+    int64_t pending = laneHeader->written.load(std::memory_order_acquire) -
+                      laneHeader->read.load(std::memory_order_relaxed);
+    return static_cast<size_t>((std::max)(int64_t(0), (std::min)(pending, static_cast<int64_t>(CAPACITY))));
+}
+
+uint64_t SessionAudioRing::GetDropped(Lane lane) const {
+    return base ? static_cast<uint64_t>(LaneAt(lane)->dropped.load(std::memory_order_relaxed)) : 0;
+}
+
+void SessionAudioRing::SetAgentPid(DWORD pid) {
+    if (base) {
+        header()->agentPid.store(pid, std::memory_order_release);
+    }
+}
+
+DWORD SessionAudioRing::GetAgentPid() const {
+    return base ? header()->agentPid.load(std::memory_order_acquire) : 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <windows.h>
+
+/**
+ * SessionAudioRing - A session agent's audio, handed to the service through shared memory
+ *
+ * The SessionBroker's agents capture in their own user session and the
+ * service transcribes; between them sit two single-producer single-consumer
+ * rings of 16 kHz mono float samples (microphone, system audio loopback) in
+ * one named mapping per session. The agent writes, the service reads, and
+ * neither waits for the other: a full ring drops the agent's newest samples
+ * (counted) rather than blocking its capture thread.
+ *
+ * Layout (little-endian, all offsets in bytes):
+ *   Header (64):  "NVAR" | version | sampleRate | capacity | sessionId |
+ *                 agentPid (uint32 @20) | pad
+ *   Lane (64 + capacity * 4), microphone then system audio:
+ *                 written (int64) | read (int64) | dropped (int64) | pad,
+ *                 then capacity float samples
+ *
+ * `written` and `read` count samples since the mapping was created; sample n
+ * lives at n % capacity. Only the agent stores `written` (after the samples)
+ * and only the service stores `read` (after copying them out).
+ *
+ * The service creates the mapping in the Global namespace with a DACL for
+ * the session's user (Create); the agent opens it by name (Open).
+ *
+ * Usage:
+ *   SessionAudioRing ring;
+ *   ring.Create(SessionAudioRing::NameFor(sessionId), sessionId, userSid);   // Service
+ *   ring.Open(name);  ring.Write(SessionAudioRing::Lane::Microphone, samples, n);   // Agent
+ *   size_t got = ring.Read(SessionAudioRing::Lane::Microphone, buffer, max);       // Service
+ */
+class SessionAudioRing {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t SAMPLE_RATE = 16000;
+    static constexpr uint32_t CAPACITY = 1 << 16;           // Samples per lane (4 s)
+
+    enum class Lane { Microphone, SystemAudio };
+
+    SessionAudioRing();
+    ~SessionAudioRing();
+
+    SessionAudioRing(const SessionAudioRing&) = delete;
+    SessionAudioRing& operator=(const SessionAudioRing&) = delete;
+
+    /**
+     * @brief "Global\NovaPerceptionSession<id>Audio"
+     */
+    static std::string NameFor(DWORD sessionId);
+
+    /**
+     * @brief Create the mapping (service side) and write the header
+     * @param userSid String SID allowed to read and write it besides SYSTEM and
+     *        administrators; empty grants interactive users
+     */
+    bool Create(const std::string& name, DWORD sessionId, const std::string& userSid);
+
+    /**
+     * @brief Attach to a mapping the service created (agent side)
+     * @return false when it doesn't exist or its header isn't this version
+     */
+    bool Open(const std::string& name);
+
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+
+    /**
+     * @brief Append samples to a lane (agent)
+     * @return Samples accepted; the rest were dropped because the service fell behind
+     */
+    size_t Write(Lane lane, const float* samples, size_t count);
+
+    /**
+     * @brief Take up to `maxCount` samples from a lane (service)
+     */
+    size_t Read(Lane lane, float* out, size_t maxCount);
+
+    // Samples waiting in a lane, and samples dropped since creation
+    size_t Available(Lane lane) const;
+    uint64_t GetDropped(Lane lane) const;
+
+    // The agent records its process id once attached (0 before)
+    void SetAgentPid(DWORD pid);
+    DWORD GetAgentPid() const;
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t sampleRate;
+        uint32_t capacity;
+        uint32_t sessionId;
+        std::atomic<uint32_t> agentPid;
+        uint8_t reserved[40];
+    };
+
+    struct LaneHeader {
+        std::atomic<int64_t> written;
+        std::atomic<int64_t> read;
+        std::atomic<int64_t> dropped;
+        uint8_t pad[40];
+    };
+
+    static_assert(sizeof(Header) == 64, "Header layout is shared with the agent");
+    static_assert(sizeof(LaneHeader) == 64, "Lane layout is shared with the agent");
+    static_assert(std::atomic<int64_t>::is_always_lock_free, "Ring counters must be lock-free across processes");
+
+    static constexpr size_t LANE_SIZE = sizeof(LaneHeader) + CAPACITY * sizeof(float);
+    static constexpr size_t MAPPING_SIZE = sizeof(Header) + 2 * LANE_SIZE;
+
+    Header* header() const { return reinterpret_cast<Header*>(base); }
+    LaneHeader* LaneAt(Lane lane) const;
+    float* SamplesAt(Lane lane) const;
+
+    HANDLE mapping;
+    uint8_t* base;
+};
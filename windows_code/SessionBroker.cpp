@@ -0,0 +1,640 @@
+#include "SessionBroker.h"
+#include "JsonReader.h"
+#include "Log.h"
+#include "Trace.h"
+#include "WindowsAPIs.h"
+#include <wtsapi32.h>
+#include <userenv.h>
+#include <sddl.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#pragma comment(lib, "wtsapi32.lib")
+#pragma comment(lib, "userenv.lib")
+#pragma comment(lib, "advapi32.lib")
+
+namespace {
+
+// SYSTEM and administrators own the pipe; interactive users may connect
+// (the session is read off the connection, not trusted from the agent)
+constexpr const char* PIPE_SDDL = "D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GRGW;;;IU)";
+
+std::string ErrorLine(std::string_view message) {
+    std::string line;
+    JsonWriter writer(line);
+    writer.BeginObject();
+    writer.Key("type").String("error");
+    writer.Key("message").String(message);
+    writer.EndObject();
+    line += '\n';
+    return line;
+}
+
+}  // namespace
+
+SessionBroker::SessionBroker(size_t maxSessions, AudioFactory audioFactory)
+    : maxSessions((std::min)(maxSessions, MAX_SESSIONS_LIMIT)),
+      audioFactory(std::move(audioFactory)),
+      stopEvent(CreateEventA(nullptr, TRUE, FALSE, nullptr)) {
+}
+
+SessionBroker::~SessionBroker() {
+    Stop();
+    if (stopEvent) {
+        CloseHandle(stopEvent);
+    }
+}
+
+int64_t SessionBroker::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ============================================================================
+// Start / Stop
+// ============================================================================
+
+bool SessionBroker::Start(bool launch) {
+    if (running.load()) {
+        return true;
+    }
+    // The first instance claims the name, so no other process can pose as the broker
+    HANDLE first = CreatePipeInstance(true);
+    if (first == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Sessions", "Cannot create " << PIPE_NAME << ": " << GetLastError());
+        return false;
+    }
+    launchAgents = launch;
+    running = true;
+    acceptThread = std::thread(&SessionBroker::AcceptLoop, this, first);
+    pumpThread = std::thread(&SessionBroker::PumpLoop, this);
+    LOG_INFO("Sessions", "Serving up to " << maxSessions << " user sessions on " << PIPE_NAME);
+
+    if (launchAgents) {
+        for (DWORD sessionId : ActiveUserSessions()) {
+            LaunchAgent(sessionId);
+        }
+    }
+    return true;
+}
+
+void SessionBroker::Stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    SetEvent(stopEvent);
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    if (pumpThread.joinable()) {
+        pumpThread.join();
+    }
+
+    // The readers woke on stopEvent; closing the pipes ends the agents
+    std::map<DWORD, std::shared_ptr<Session>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        remaining.swap(sessions);
+    }
+    for (auto& entry : remaining) {
+        Retire(*entry.second);
+    }
+    ResetEvent(stopEvent);
+    LOG_DEBUG("Sessions", "Broker stopped (" << remaining.size() << " sessions disconnected)");
+}
+
+void SessionBroker::OnSessionLogon(DWORD sessionId) {
+    if (!running.load() || !launchAgents || sessionId == WTSGetActiveConsoleSessionId()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        if (sessions.count(sessionId)) {
+            return;
+        }
+    }
+    LaunchAgent(sessionId);
+}
+
+// ============================================================================
+// Settings
+// ============================================================================
+
+void SessionBroker::SetSegmenterConfig(const AudioCaptureEngine::SegmenterConfig& config) {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    std::lock_guard<std::mutex> settingsLock(settingsMutex);
+    segmenterConfig = config;
+    segmenterSet = true;
+    for (auto& entry : sessions) {
+        if (entry.second->welcomed.load() && entry.second->audio) {
+            entry.second->audio->SetSegmenterConfig(config);
+        }
+    }
+}
+
+void SessionBroker::SetPowerSettings(const AudioCaptureEngine::PowerSettings& settings) {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    std::lock_guard<std::mutex> settingsLock(settingsMutex);
+    powerSettings = settings;
+    powerSet = true;
+    for (auto& entry : sessions) {
+        if (entry.second->welcomed.load() && entry.second->audio) {
+            entry.second->audio->SetPowerSettings(settings);
+        }
+    }
+}
+
+// ============================================================================
+// Connections
+// ============================================================================
+
+HANDLE SessionBroker::CreatePipeInstance(bool first) {
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(PIPE_SDDL, SDDL_REVISION_1, &descriptor, nullptr)) {
+        return INVALID_HANDLE_VALUE;
+    }
+    SECURITY_ATTRIBUTES attributes = { sizeof(attributes), descriptor, FALSE };
+    HANDLE pipe = CreateNamedPipeA(PIPE_NAME,
+                                   PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                                   PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                   PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_BYTES, PIPE_BUFFER_BYTES, 0, &attributes);
+    LocalFree(descriptor);
+    return pipe;
+}
+
+void SessionBroker::AcceptLoop(HANDLE pipe) {
+    TRACE_THREAD("Session broker accept");
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+    while (running.load()) {
+        if (pipe == INVALID_HANDLE_VALUE) {
+            pipe = CreatePipeInstance(false);
+            if (pipe == INVALID_HANDLE_VALUE) {
+                LOG_ERROR("Sessions", "Cannot create a pipe instance: " << GetLastError());
+                WaitForSingleObject(stopEvent, 1000);
+                continue;
+            }
+        }
+
+        ResetEvent(overlapped.hEvent);
+        bool connected = ConnectNamedPipe(pipe, &overlapped) != 0;
+        DWORD error = GetLastError();
+        DWORD ignored = 0;
+        if (!connected && error == ERROR_IO_PENDING) {
+            HANDLE waits[] = { overlapped.hEvent, stopEvent };
+            if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIo(pipe);
+                GetOverlappedResult(pipe, &overlapped, &ignored, TRUE);
+                break;
+            }
+            connected = GetOverlappedResult(pipe, &overlapped, &ignored, FALSE) != 0;
+        } else if (!connected && error == ERROR_PIPE_CONNECTED) {
+            connected = true;       // The agent was quicker than ConnectNamedPipe
+        }
+
+        if (connected) {
+            Admit(pipe);
+        } else {
+            CloseHandle(pipe);
+        }
+        pipe = INVALID_HANDLE_VALUE;
+    }
+
+    if (pipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(pipe);
+    }
+    CloseHandle(overlapped.hEvent);
+}
+
+void SessionBroker::Admit(HANDLE pipe) {
+    ULONG sessionId = 0;
+    if (!GetNamedPipeClientSessionId(pipe, &sessionId)) {
+        LOG_WARNING("Sessions", "Agent connection without a session id: " << GetLastError());
+        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
+        return;
+    }
+
+    auto session = std::make_shared<Session>();
+    session->id = sessionId;
+    session->pipe = pipe;
+    session->connectedMs = NowMs();
+    ReadSessionUser(sessionId, session->user, session->userSid);
+
+    std::string refusal;
+    if (sessionId == WTSGetActiveConsoleSessionId()) {
+        refusal = "the console session is served by the host's own engines";
+    } else {
+        // Started under the lock: the pump only sees the session once `reader` is set
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        if (sessions.count(sessionId)) {
+            refusal = "an agent already serves this session";
+        } else if (sessions.size() >= maxSessions) {
+            refusal = "session limit reached (sessions.max " + std::to_string(maxSessions) + ")";
+        } else {
+            sessions[sessionId] = session;
+            session->reader = std::thread(&SessionBroker::ReaderLoop, this, session);
+        }
+    }
+
+    if (!refusal.empty()) {
+        LOG_INFO("Sessions", "Agent from session " << sessionId << " turned away: " << refusal);
+        Send(pipe, ErrorLine(refusal));
+        FlushFileBuffers(pipe);
+        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
+        session->pipe = INVALID_HANDLE_VALUE;
+        return;
+    }
+    LOG_INFO("Sessions", "Agent connected from session " << sessionId
+             << (session->user.empty() ? "" : " (" + session->user + ")"));
+}
+
+void SessionBroker::ReaderLoop(std::shared_ptr<Session> session) {
+    TRACE_THREAD("Session broker reader");
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    int64_t helloDeadlineMs = session->connectedMs + HELLO_TIMEOUT_MS;
+    std::string pending;
+    char buffer[1024];
+
+    bool open = true;
+    while (open && running.load()) {
+        ResetEvent(overlapped.hEvent);
+        DWORD received = 0;
+        bool ok = ReadFile(session->pipe, buffer, sizeof(buffer), &received, &overlapped) != 0;
+        if (!ok && GetLastError() == ERROR_IO_PENDING) {
+            // Until the hello arrives the agent has HELLO_TIMEOUT_MS; then it may stay quiet
+            DWORD timeout = session->welcomed.load() ? INFINITE :
+                static_cast<DWORD>((std::max)(int64_t(0), helloDeadlineMs - NowMs()));
+            HANDLE waits[] = { overlapped.hEvent, stopEvent };
+            DWORD signaled = WaitForMultipleObjects(2, waits, FALSE, timeout);
+            if (signaled != WAIT_OBJECT_0) {
+                CancelIo(session->pipe);
+                GetOverlappedResult(session->pipe, &overlapped, &received, TRUE);
+                if (signaled == WAIT_TIMEOUT) {
+                    LOG_WARNING("Sessions", "Agent in session " << session->id << " sent no hello");
+                }
+                break;
+            }
+            ok = GetOverlappedResult(session->pipe, &overlapped, &received, FALSE) != 0;
+        }
+        if (!ok || received == 0) {
+            break;                  // ERROR_BROKEN_PIPE: the agent exited
+        }
+
+        pending.append(buffer, received);
+        size_t newline;
+        while (open && (newline = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (session->welcomed.load()) {
+                HandleMessage(*session, line);
+                continue;
+            }
+            JsonValue hello = JsonReader::Parse(line);
+            std::string scratch;
+            if (!hello.IsObject() || hello["type"].AsString(scratch) != "hello" ||
+                hello["version"].AsInt() != PROTOCOL_VERSION) {
+                Send(session->pipe, ErrorLine("expected a version " + std::to_string(PROTOCOL_VERSION) + " hello"));
+                open = false;
+            } else {
+                open = Welcome(*session, static_cast<DWORD>(hello["pid"].AsInt()));
+            }
+        }
+        if (pending.size() > MAX_MESSAGE_BYTES) {
+            LOG_WARNING("Sessions", "Agent in session " << session->id << " sent an oversized message");
+            open = false;
+        }
+    }
+
+    CloseHandle(overlapped.hEvent);
+    session->connected = false;
+    LOG_INFO("Sessions", "Agent in session " << session->id << " disconnected");
+}
+
+bool SessionBroker::Welcome(Session& session, DWORD agentPid) {
+    std::string ringName = SessionAudioRing::NameFor(session.id);
+    if (!session.ring.Create(ringName, session.id, session.userSid)) {
+        Send(session.pipe, ErrorLine("audio ring unavailable"));
+        return false;
+    }
+
+    // Transcription on the host's models; results land in the session's fields
+    auto engine = std::make_unique<AudioCaptureEngine>();
+    if (audioFactory && audioFactory(*engine)) {
+        Session* target = &session;
+        AudioCaptureEngine* audio = engine.get();
+        engine->SetTranscriptionCallback([target, audio](const std::string& transcription) {
+            float latencyMs = audio->GetMetrics().whisperLatencyMs;
+            std::lock_guard<std::mutex> lock(target->mutex);
+            target->transcription = transcription;
+            target->partial.clear();
+            target->voiceLatencyMs = latencyMs;
+            target->voiceTimestamp = WindowsAPIs::GetCurrentTimestamp();
+        });
+        engine->SetPartialTranscriptionCallback([target](const std::string& partial) {
+            std::lock_guard<std::mutex> lock(target->mutex);
+            target->partial = partial;
+        });
+        engine->SetSystemAudioCallback([target](const std::string& transcription) {
+            std::lock_guard<std::mutex> lock(target->mutex);
+            target->systemAudio = transcription;
+        });
+    } else {
+        LOG_WARNING("Sessions", "No voice for session " << session.id << ": the shared whisper models aren't loaded");
+        engine.reset();
+    }
+
+    {
+        // Settings and `welcomed` together, so a change either reaches this
+        // engine here or in the Set* loop
+        std::lock_guard<std::mutex> settingsLock(settingsMutex);
+        if (engine) {
+            if (segmenterSet) {
+                engine->SetSegmenterConfig(segmenterConfig);
+            }
+            if (powerSet) {
+                engine->SetPowerSettings(powerSettings);
+            }
+            if (!engine->Start()) {
+                LOG_WARNING("Sessions", "Session " << session.id << " transcription failed to start");
+                engine.reset();
+            }
+        }
+        session.audio = std::move(engine);
+        session.welcomed = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.agentPid = agentPid;
+    }
+
+    std::string line;
+    JsonWriter writer(line);
+    writer.BeginObject();
+    writer.Key("type").String("welcome");
+    writer.Key("session").UInt(session.id);
+    writer.Key("ring").String(ringName);
+    writer.Key("voice").Bool(session.audio != nullptr);
+    writer.EndObject();
+    line += '\n';
+    LOG_INFO("Sessions", "Session " << session.id << " served (agent pid " << agentPid << ", voice "
+             << (session.audio ? "on" : "off") << ")");
+    return Send(session.pipe, line);
+}
+
+void SessionBroker::HandleMessage(Session& session, std::string_view line) {
+    JsonValue message = JsonReader::Parse(line);
+    if (!message.IsObject()) {
+        LOG_DEBUG("Sessions", "Session " << session.id << ": malformed message ignored");
+        return;
+    }
+    std::string scratch;
+    std::string_view type = message["type"].AsString(scratch);
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.messages++;
+    if (type == "app") {
+        session.activeApp = message["app"].GetString();
+        session.activeAppCategory = message["category"].GetString();
+    } else if (type == "stats") {
+        session.microphoneDropped = static_cast<uint64_t>((std::max)(int64_t(0), message["microphoneDropped"].AsInt()));
+        session.systemDropped = static_cast<uint64_t>((std::max)(int64_t(0), message["systemDropped"].AsInt()));
+    }
+    // Other types are from a newer agent: ignored
+}
+
+void SessionBroker::Retire(Session& session) {
+    if (session.reader.joinable()) {
+        session.reader.join();
+    }
+    if (session.audio) {
+        // Nobody reads this session's results any more
+        session.audio->CancelTranscriptions();
+        session.audio->Stop();
+        session.audio.reset();
+    }
+    session.ring.Close();
+    if (session.pipe != INVALID_HANDLE_VALUE) {
+        DisconnectNamedPipe(session.pipe);
+        CloseHandle(session.pipe);
+        session.pipe = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool SessionBroker::Send(HANDLE pipe, const std::string& line, DWORD timeoutMs) {
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    DWORD written = 0;
+    bool ok = WriteFile(pipe, line.data(), static_cast<DWORD>(line.size()), &written, &overlapped) != 0;
+    if (!ok && GetLastError() == ERROR_IO_PENDING) {
+        if (WaitForSingleObject(overlapped.hEvent, timeoutMs) != WAIT_OBJECT_0) {
+            CancelIo(pipe);
+        }
+        ok = GetOverlappedResult(pipe, &overlapped, &written, TRUE) != 0;
+    }
+    CloseHandle(overlapped.hEvent);
+    return ok && written == line.size();
+}
+
+// ============================================================================
+// Audio pump
+// ============================================================================
+
+void SessionBroker::PumpLoop() {
+    TRACE_THREAD("Session audio pump");
+    std::vector<float> buffer(SessionAudioRing::CAPACITY);
+    const SessionAudioRing::Lane lanes[] = { SessionAudioRing::Lane::Microphone, SessionAudioRing::Lane::SystemAudio };
+
+    while (running.load()) {
+        std::vector<std::shared_ptr<Session>> live;
+        std::vector<std::shared_ptr<Session>> gone;
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            for (auto it = sessions.begin(); it != sessions.end();) {
+                if (!it->second->connected.load()) {
+                    gone.push_back(it->second);
+                    it = sessions.erase(it);
+                    continue;
+                }
+                if (it->second->welcomed.load()) {
+                    live.push_back(it->second);
+                }
+                ++it;
+            }
+        }
+        for (auto& session : gone) {
+            Retire(*session);
+        }
+
+        // Everything the agents wrote since the last tick; a session without
+        // voice is still drained, so its agent doesn't count drops
+        for (auto& session : live) {
+            for (SessionAudioRing::Lane lane : lanes) {
+                size_t count = session->ring.Read(lane, buffer.data(), buffer.size());
+                if (count > 0 && session->audio) {
+                    session->audio->FeedAudio(lane == SessionAudioRing::Lane::SystemAudio, buffer.data(), count);
+                }
+            }
+        }
+        WaitForSingleObject(stopEvent, PUMP_TICK_MS);
+    }
+}
+
+// ============================================================================
+// Agents
+// ============================================================================
+
+std::vector<DWORD> SessionBroker::ActiveUserSessions() {
+    std::vector<DWORD> result;
+    WTS_SESSION_INFOA* info = nullptr;
+    DWORD count = 0;
+    if (!WTSEnumerateSessionsA(WTS_CURRENT_SERVER_HANDLE, 0, 1, &info, &count)) {
+        LOG_WARNING("Sessions", "Cannot enumerate sessions: " << GetLastError());
+        return result;
+    }
+    DWORD console = WTSGetActiveConsoleSessionId();
+    for (DWORD i = 0; i < count; ++i) {
+        if (info[i].State == WTSActive && info[i].SessionId != 0 && info[i].SessionId != console) {
+            result.push_back(info[i].SessionId);
+        }
+    }
+    WTSFreeMemory(info);
+    return result;
+}
+
+void SessionBroker::ReadSessionUser(DWORD sessionId, std::string& user, std::string& sid) {
+    char* name = nullptr;
+    char* domain = nullptr;
+    DWORD bytes = 0;
+    if (WTSQuerySessionInformationA(WTS_CURRENT_SERVER_HANDLE, sessionId, WTSUserName, &name, &bytes) && name && *name) {
+        if (WTSQuerySessionInformationA(WTS_CURRENT_SERVER_HANDLE, sessionId, WTSDomainName, &domain, &bytes) &&
+            domain && *domain) {
+            user = std::string(domain) + "\\" + name;
+        } else {
+            user = name;
+        }
+    }
+    if (name) {
+        WTSFreeMemory(name);
+    }
+    if (domain) {
+        WTSFreeMemory(domain);
+    }
+
+    // The SID needs the session's token, which only SYSTEM gets; without it
+    // the audio ring falls back to interactive users
+    HANDLE token = nullptr;
+    if (!WTSQueryUserToken(sessionId, &token)) {
+        return;
+    }
+    DWORD size = 0;
+    GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+    std::vector<uint8_t> tokenUser(size);
+    char* sidText = nullptr;
+    if (size > 0 && GetTokenInformation(token, TokenUser, tokenUser.data(), size, &size) &&
+        ConvertSidToStringSidA(reinterpret_cast<TOKEN_USER*>(tokenUser.data())->User.Sid, &sidText)) {
+        sid = sidText;
+        LocalFree(sidText);
+    }
+    CloseHandle(token);
+}
+
+bool SessionBroker::LaunchAgent(DWORD sessionId) {
+    HANDLE token = nullptr;
+    if (!WTSQueryUserToken(sessionId, &token)) {
+        LOG_WARNING("Sessions", "No agent for session " << sessionId << ": no user token (" << GetLastError() << ")");
+        return false;
+    }
+
+    // This executable again, in agent mode, on the user's desktop and environment
+    char path[MAX_PATH] = {};
+    GetModuleFileNameA(nullptr, path, MAX_PATH);
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    std::string command = "\"" + std::string(path) + "\" --agent";
+    void* environment = nullptr;
+    if (!CreateEnvironmentBlock(&environment, token, FALSE)) {
+        environment = nullptr;
+    }
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    startup.lpDesktop = const_cast<char*>("winsta0\\default");
+    PROCESS_INFORMATION process = {};
+    bool launched = CreateProcessAsUserA(token, nullptr, &command[0], nullptr, nullptr, FALSE,
+                                         CREATE_NO_WINDOW | CREATE_UNICODE_ENVIRONMENT, environment,
+                                         directory.c_str(), &startup, &process) != 0;
+    DWORD error = GetLastError();
+    if (environment) {
+        DestroyEnvironmentBlock(environment);
+    }
+    CloseHandle(token);
+
+    if (!launched) {
+        LOG_WARNING("Sessions", "Cannot launch the agent in session " << sessionId << ": " << error);
+        return false;
+    }
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    LOG_INFO("Sessions", "Agent launched in session " << sessionId << " (pid " << process.dwProcessId << ")");
+    return true;
+}
+
+// ============================================================================
+// Reporting
+// ============================================================================
+
+size_t SessionBroker::GetSessionCount() const {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    return sessions.size();
+}
+
+void SessionBroker::Write(JsonWriter& writer) const {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    int64_t now = NowMs();
+    writer.BeginObject();
+    writer.Key("maxSessions").UInt(maxSessions);
+    writer.Key("launchAgents").Bool(launchAgents);
+    writer.Key("sessions").BeginArray();
+    for (const auto& entry : sessions) {
+        const Session& session = *entry.second;
+        std::lock_guard<std::mutex> sessionLock(session.mutex);
+        writer.BeginObject();
+        writer.Key("session").UInt(session.id);
+        writer.Key("user").StringOrNull(session.user);
+        writer.Key("agentPid").UInt(session.agentPid);
+        writer.Key("connectedSeconds").Int((now - session.connectedMs) / 1000);
+        writer.Key("welcomed").Bool(session.welcomed.load());
+        writer.Key("voice").Bool(session.welcomed.load() && session.audio != nullptr);
+        writer.Key("messages").UInt(session.messages);
+        writer.Key("microphoneDropped").UInt(session.microphoneDropped);
+        writer.Key("systemDropped").UInt(session.systemDropped);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+bool SessionBroker::WriteSession(DWORD sessionId, JsonWriter& writer) const {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    auto it = sessions.find(sessionId);
+    if (it == sessions.end()) {
+        return false;
+    }
+    const Session& session = *it->second;
+    std::lock_guard<std::mutex> sessionLock(session.mutex);
+    writer.BeginObject();
+    writer.Key("session").UInt(session.id);
+    writer.Key("user").StringOrNull(session.user);
+    writer.Key("activeApp").StringOrNull(session.activeApp);
+    writer.Key("activeAppCategory").StringOrNull(session.activeAppCategory);
+    writer.Key("voiceTranscription").StringOrNull(session.transcription);
+    writer.Key("voicePartial").StringOrNull(session.partial);
+    writer.Key("voiceLatencyMs").Double(session.voiceLatencyMs, 1);
+    writer.Key("voiceTimestamp").StringOrNull(session.voiceTimestamp);
+    writer.Key("systemAudioTranscription").StringOrNull(session.systemAudio);
+    writer.Key("voiceModelStatus").String(!session.welcomed.load() ? "loading" : session.audio ? "ready" : "unavailable");
+    writer.EndObject();
+    return true;
+}
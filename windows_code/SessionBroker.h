@@ -0,0 +1,188 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "AudioCaptureEngine.h"
+#include "JsonWriter.h"
+#include "SessionAudioRing.h"
+
+/**
+ * SessionBroker - One engine serving every user session on the machine
+ *
+ * Microphones, loopback audio and window events belong to an interactive
+ * session, and the service's own engines only see the console's. A shared
+ * or RDS host used to need one engine process per user, each with its own
+ * copy of the models. The broker keeps the models in the service and
+ * serves the other sessions through lightweight agents instead:
+ *
+ *   agent (PerceptionEngine.exe --agent, in the user's session)
+ *     WASAPI capture only (AudioCaptureEngine::InitializeCaptureOnly)
+ *       -> SessionAudioRing (shared memory, 16 kHz mono, one per session)
+ *     foreground app changes -> named pipe (JSON lines)
+ *   service
+ *     per session: an AudioCaptureEngine on the host's whisper models
+ *     (InitializeShared: own whisper state, VAD and segmentation), fed
+ *     from the ring every PUMP_TICK_MS, and the session's latest voice
+ *     and app fields, served at /sessions/{id}/context
+ *
+ * Whisper's weights are paid once per machine; a session adds one whisper
+ * state, two Silero states and its ring. Machine-wide fields (CPU, memory,
+ * battery, camera) stay in the host's /context.
+ *
+ * Agents: with launchAgents (the service, which runs as SYSTEM), Start()
+ * launches one in every active session other than the console, and
+ * OnSessionLogon() in each new one (CreateProcessAsUser on the session's
+ * token). The console session stays with the host's own engines, so the
+ * broker turns agents from it away; so it does past maxSessions, or a
+ * second agent for a session. An agent exits when its pipe closes.
+ *
+ * Protocol (one JSON object per line, at most MAX_MESSAGE_BYTES):
+ *   agent -> service  {"type":"hello","version":1,"pid":1234}
+ *   service -> agent  {"type":"welcome","session":2,"ring":"Global\\..."} or {"type":"error","message":...}
+ *   agent -> service  {"type":"app","app":"Visual Studio Code","category":"ide"}
+ *                     {"type":"stats","microphoneDropped":0,"systemDropped":0}
+ * The session id comes from the pipe (GetNamedPipeClientSessionId), never
+ * from the agent.
+ *
+ * Usage:
+ *   SessionBroker broker(4, [&](AudioCaptureEngine& engine) { return engine.InitializeShared(host, "session_voice"); });
+ *   broker.Start(true);
+ *   broker.OnSessionLogon(sessionId);      // WTS_SESSION_LOGON
+ *   broker.Stop();
+ *
+ * Thread-safe.
+ */
+class SessionBroker {
+public:
+    static constexpr const char* PIPE_NAME = "\\\\.\\pipe\\NovaPerceptionBroker";
+    static constexpr int PROTOCOL_VERSION = 1;
+    static constexpr size_t MAX_MESSAGE_BYTES = 4096;
+    static constexpr size_t MAX_SESSIONS_LIMIT = 64;
+    static constexpr const char* WATCHDOG_GROUP = "session_voice";
+
+    // Prepares a session's engine on the host's loaded models; false leaves the session without voice
+    using AudioFactory = std::function<bool(AudioCaptureEngine& engine)>;
+
+    SessionBroker(size_t maxSessions, AudioFactory audioFactory);
+    ~SessionBroker();
+
+    SessionBroker(const SessionBroker&) = delete;
+    SessionBroker& operator=(const SessionBroker&) = delete;
+
+    /**
+     * @brief Open the pipe and start serving agents
+     * @param launchAgents Launch an agent in every active non-console session
+     *        now and on OnSessionLogon (needs SYSTEM's WTSQueryUserToken)
+     * @return false when the pipe can't be created
+     */
+    bool Start(bool launchAgents);
+
+    /**
+     * @brief Disconnect every agent (they exit) and stop their engines
+     */
+    void Stop();
+
+    /**
+     * @brief A user logged on to `sessionId`: launch its agent (launchAgents only)
+     */
+    void OnSessionLogon(DWORD sessionId);
+
+    // The host's settings, applied to every session's engine (now and as they connect)
+    void SetSegmenterConfig(const AudioCaptureEngine::SegmenterConfig& config);
+    void SetPowerSettings(const AudioCaptureEngine::PowerSettings& settings);
+
+    size_t GetSessionCount() const;
+
+    /**
+     * @brief {"maxSessions", "sessions": [{"session", "user", "agentPid", "connectedSeconds", ...}]}
+     */
+    void Write(JsonWriter& writer) const;
+
+    /**
+     * @brief One session's voice and app fields
+     * @return false when no agent serves `sessionId`
+     */
+    bool WriteSession(DWORD sessionId, JsonWriter& writer) const;
+
+private:
+    struct Session {
+        DWORD id = 0;
+        std::string user;                   // DOMAIN\name, when the token could be read
+        std::string userSid;
+        HANDLE pipe = INVALID_HANDLE_VALUE;
+        std::thread reader;
+        std::atomic<bool> connected{true};
+        std::atomic<bool> welcomed{false};  // Ring and engine set up (pump may feed)
+        int64_t connectedMs = 0;
+        SessionAudioRing ring;
+        std::unique_ptr<AudioCaptureEngine> audio;     // Null: no voice for this session
+
+        // Published fields; guarded by mutex
+        mutable std::mutex mutex;
+        DWORD agentPid = 0;
+        std::string activeApp;
+        std::string activeAppCategory;
+        std::string transcription;
+        std::string partial;
+        std::string systemAudio;
+        float voiceLatencyMs = 0.0f;
+        std::string voiceTimestamp;
+        uint64_t microphoneDropped = 0;     // Reported by the agent
+        uint64_t systemDropped = 0;
+        uint64_t messages = 0;
+    };
+
+    size_t maxSessions;
+    AudioFactory audioFactory;
+    bool launchAgents = false;
+
+    std::atomic<bool> running{false};
+    HANDLE stopEvent;                       // Manual reset; wakes the accept and reader waits
+    std::thread acceptThread;
+    std::thread pumpThread;
+
+    mutable std::mutex sessionsMutex;
+    std::map<DWORD, std::shared_ptr<Session>> sessions;
+
+    mutable std::mutex settingsMutex;       // Taken after sessionsMutex, never before
+    AudioCaptureEngine::SegmenterConfig segmenterConfig;
+    AudioCaptureEngine::PowerSettings powerSettings;
+    bool segmenterSet = false;
+    bool powerSet = false;
+
+    static constexpr int PUMP_TICK_MS = 20;
+    static constexpr DWORD HELLO_TIMEOUT_MS = 5000;
+    static constexpr size_t PIPE_BUFFER_BYTES = 8192;
+
+    // Takes the first pipe instance (FILE_FLAG_FIRST_PIPE_INSTANCE, created by Start)
+    void AcceptLoop(HANDLE first);
+    void ReaderLoop(std::shared_ptr<Session> session);
+    void PumpLoop();
+
+    HANDLE CreatePipeInstance(bool first);
+    // Admit or turn away a connected pipe; takes ownership of it
+    void Admit(HANDLE pipe);
+    // The hello's answer: ring, engine, welcome. False ends the connection
+    bool Welcome(Session& session, DWORD agentPid);
+    void HandleMessage(Session& session, std::string_view line);
+    // Joins the reader and stops the engine; the session must be out of `sessions`
+    void Retire(Session& session);
+
+    bool LaunchAgent(DWORD sessionId);
+    static std::vector<DWORD> ActiveUserSessions();
+    static void ReadSessionUser(DWORD sessionId, std::string& user, std::string& sid);
+
+    // One message line out, waiting at most `timeoutMs` (overlapped pipe)
+    bool Send(HANDLE pipe, const std::string& line, DWORD timeoutMs = 1000);
+    static int64_t NowMs();
+};
@@ -0,0 +1,180 @@
+#include "SharedContextSnapshot.h"
+#include "Log.h"
+#include <sddl.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#pragma comment(lib, "advapi32.lib")
+
+namespace {
+
+// SYSTEM and administrators own it; interactive users read the document and pulse
+constexpr const char* MAPPING_SDDL = "D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GRGW;;;IU)";
+
+}  // namespace
+
+SharedContextSnapshot::SharedContextSnapshot()
+    : mapping(nullptr), base(nullptr), lastSequence(0), lastPulse(0) {
+}
+
+SharedContextSnapshot::~SharedContextSnapshot() {
+    Close();
+}
+
+bool SharedContextSnapshot::Create() {
+    Close();
+
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(MAPPING_SDDL, SDDL_REVISION_1, &descriptor, nullptr)) {
+        LOG_ERROR("LocalIpc", "Invalid context mapping DACL: " << GetLastError());
+        return false;
+    }
+    SECURITY_ATTRIBUTES attributes = { sizeof(attributes), descriptor, FALSE };
+
+    // Global needs SeCreateGlobalPrivilege (the service has it, a console run usually not)
+    for (const char* candidate : { GLOBAL_NAME, LOCAL_NAME }) {
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, &attributes, PAGE_READWRITE,
+                                     0, static_cast<DWORD>(MAPPING_SIZE), candidate);
+        if (mapping) {
+            name = candidate;
+            break;
+        }
+        LOG_DEBUG("LocalIpc", "CreateFileMapping " << candidate << " failed: " << GetLastError());
+    }
+    LocalFree(descriptor);
+    if (!mapping) {
+        LOG_ERROR("LocalIpc", "Context mapping unavailable");
+        return false;
+    }
+    if (!Map(FILE_MAP_ALL_ACCESS)) {
+        return false;
+    }
+
+    // Fresh layout every start; a reader attached to an old mapping re-opens
+    std::memset(base, 0, sizeof(Header));
+    Header* h = header();
+    h->version = VERSION;
+    h->capacity = CAPACITY;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(h->magic, "NVCX", 4);
+
+    LOG_DEBUG("LocalIpc", "Mapped " << name << " (" << MAPPING_SIZE / 1024 << " KB)");
+    return true;
+}
+
+bool SharedContextSnapshot::Open() {
+    Close();
+
+    for (const char* candidate : { GLOBAL_NAME, LOCAL_NAME }) {
+        mapping = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, candidate);
+        if (mapping) {
+            name = candidate;
+            break;
+        }
+    }
+    if (!mapping || !Map(FILE_MAP_READ | FILE_MAP_WRITE)) {
+        Close();
+        return false;
+    }
+
+    const Header* h = header();
+    if (std::memcmp(h->magic, "NVCX", 4) != 0 || h->version != VERSION || h->capacity != CAPACITY) {
+        LOG_ERROR("LocalIpc", name << " is not a version " << VERSION << " context mapping");
+        Close();
+        return false;
+    }
+    lastSequence = 0;
+    return true;
+}
+
+bool SharedContextSnapshot::Map(DWORD access) {
+    base = static_cast<uint8_t*>(MapViewOfFile(mapping, access, 0, 0, MAPPING_SIZE));
+    if (!base) {
+        LOG_ERROR("LocalIpc", "MapViewOfFile " << name << " failed: " << GetLastError());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SharedContextSnapshot::Close() {
+    if (base) {
+        UnmapViewOfFile(base);
+        base = nullptr;
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+}
+
+// ============================================================================
+// Document
+// ============================================================================
+
+void SharedContextSnapshot::Publish(std::string_view text, uint64_t documentVersion, uint64_t stateVersion) {
+    if (!base) {
+        return;
+    }
+    Header* h = header();
+    int64_t sequence = h->sequence.load(std::memory_order_relaxed);
+    h->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bool fits = text.size() <= CAPACITY;
+    if (fits) {
+        std::memcpy(document(), text.data(), text.size());
+    }
+    h->documentVersion = static_cast<int64_t>(documentVersion);
+    h->stateVersion = static_cast<int64_t>(stateVersion);
+    h->length = fits ? static_cast<uint32_t>(text.size()) : 0;
+    h->flags = fits ? 0 : FLAG_TRUNCATED;
+    h->publishedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    h->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool SharedContextSnapshot::Read(std::string& text, uint64_t* documentVersion) {
+    if (!base) {
+        return false;
+    }
+    Header* h = header();
+    h->readerPulse.store(GetTickCount(), std::memory_order_relaxed);
+
+    int64_t sequence = h->sequence.load(std::memory_order_acquire);
+    if (sequence == lastSequence || (sequence & 1) != 0) {
+        return false;       // Unchanged, or the engine is mid-write
+    }
+
+    // `length` comes from another process: never past the mapping
+    uint32_t length = (std::min)(h->length, CAPACITY);
+    uint32_t flags = h->flags;
+    int64_t version = h->documentVersion;
+    std::string copy(document(), length);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (h->sequence.load(std::memory_order_relaxed) != sequence) {
+        return false;
+    }
+    lastSequence = sequence;
+    if (flags & FLAG_TRUNCATED) {
+        return false;
+    }
+    text = std::move(copy);
+    if (documentVersion) {
+        *documentVersion = static_cast<uint64_t>(version);
+    }
+    return true;
+}
+
+bool SharedContextSnapshot::TakeReaderPulse() {
+    if (!base) {
+        return false;
+    }
+    uint32_t pulse = header()->readerPulse.load(std::memory_order_relaxed);
+    bool pulsed = pulse != lastPulse;
+    lastPulse = pulse;
+    return pulsed;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <windows.h>
+
+/**
+ * SharedContextSnapshot - The latest /context document in shared memory
+ *
+ * Local readers (the Python client, agents on the same machine) used to
+ * poll GET /context over loopback TCP: a connection, a request parse and a
+ * response per read, even when nothing had changed. The engine now also
+ * copies every new context document into one named mapping; a reader
+ * checks a counter and only copies the document when it moved, so an
+ * unchanged context costs no system call at all.
+ *
+ * Layout (little-endian, all offsets in bytes):
+ *   Header (64):  "NVCX" | version | capacity | readerPulse (uint32 @12) |
+ *                 sequence (int64 @16) | documentVersion (int64 @24) |
+ *                 stateVersion (int64 @32) | length (uint32 @40) | flags (uint32 @44) |
+ *                 publishedMs (int64 @48, Unix epoch) | pad
+ *   Then capacity bytes: the document as UTF-8 JSON (length bytes of it)
+ *
+ * One seqlock: the engine stores an odd sequence, writes the fields and
+ * the document, then stores the next even one. A reader loads an even
+ * sequence, copies, and keeps the copy only if the sequence still reads
+ * the same afterwards; an unchanged even sequence means nothing to copy.
+ * FLAG_TRUNCATED (length 0): the document outgrew the mapping, read it over
+ * HTTP instead.
+ *
+ * Readers store GetTickCount() into readerPulse when they read, so the
+ * engine keeps refreshing the system fields for them like for an HTTP poll
+ * (ContextCollector::NoteReader).
+ *
+ * The service creates the mapping in the Global namespace (interactive
+ * users may read it and pulse); a console run, which can't, falls back to
+ * Local. Open() tries both in the same order.
+ *
+ * Usage:
+ *   SharedContextSnapshot shared;
+ *   shared.Create();                                       // Engine
+ *   shared.Publish(snapshot->serialized, snapshot->version, snapshot->stateVersion);
+ *
+ *   SharedContextSnapshot reader;
+ *   reader.Open();                                         // Local reader
+ *   std::string document;
+ *   if (reader.Read(document)) { ... changed ... }
+ */
+class SharedContextSnapshot {
+public:
+    static constexpr const char* GLOBAL_NAME = "Global\\NovaPerceptionContext";
+    static constexpr const char* LOCAL_NAME = "Local\\NovaPerceptionContext";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t CAPACITY = 1024 * 1024;
+    static constexpr uint32_t FLAG_TRUNCATED = 1;
+
+    SharedContextSnapshot();
+    ~SharedContextSnapshot();
+
+    SharedContextSnapshot(const SharedContextSnapshot&) = delete;
+    SharedContextSnapshot& operator=(const SharedContextSnapshot&) = delete;
+
+    /**
+     * @brief Create the mapping (engine side), Global if allowed, else Local
+     */
+    bool Create();
+
+    /**
+     * @brief Attach to the engine's mapping (reader side)
+     * @return false when no engine runs, or its layout isn't this version
+     */
+    bool Open();
+
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+    const std::string& GetName() const { return name; }
+
+    /**
+     * @brief Replace the document (engine); too large a one is published as FLAG_TRUNCATED
+     */
+    void Publish(std::string_view document, uint64_t documentVersion, uint64_t stateVersion);
+
+    /**
+     * @brief Copy the document if it changed since the last successful Read
+     * @return true if `document` was replaced; false when unchanged, mid-write
+     *         (retry on the next poll) or truncated
+     */
+    bool Read(std::string& document, uint64_t* documentVersion = nullptr);
+
+    /**
+     * @brief Whether a reader pulsed since the last call (engine)
+     */
+    bool TakeReaderPulse();
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t capacity;
+        std::atomic<uint32_t> readerPulse;
+        std::atomic<int64_t> sequence;
+        int64_t documentVersion;
+        int64_t stateVersion;
+        uint32_t length;
+        uint32_t flags;
+        int64_t publishedMs;
+        uint8_t reserved[8];
+    };
+
+    static_assert(sizeof(Header) == 64, "Header layout is shared with local readers");
+    static_assert(std::atomic<int64_t>::is_always_lock_free, "Seqlock counters must be lock-free across processes");
+
+    static constexpr size_t MAPPING_SIZE = sizeof(Header) + CAPACITY;
+
+    Header* header() const { return reinterpret_cast<Header*>(base); }
+    char* document() const { return reinterpret_cast<char*>(base + sizeof(Header)); }
+    bool Map(DWORD access);
+
+    HANDLE mapping;
+    uint8_t* base;
+    std::string name;
+    int64_t lastSequence;           // Reader: sequence of the last copy
+    uint32_t lastPulse;             // Engine: readerPulse at the last TakeReaderPulse
+};
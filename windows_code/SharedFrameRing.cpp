@@ -0,0 +1,230 @@
+#include "SharedFrameRing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "Log.h"
+
+SharedFrameRing::SharedFrameRing()
+    : mapping(nullptr), base(nullptr), publishedFrames(0), lastResult(0) {
+}
+
+SharedFrameRing::~SharedFrameRing() {
+    Close();
+}
+
+bool SharedFrameRing::Create(const std::string& name) {
+    Close();
+
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                 0, static_cast<DWORD>(MAPPING_SIZE), name.c_str());
+    if (!mapping) {
+        LOG_ERROR("SharedRing", "CreateFileMapping failed: " << GetLastError());
+        return false;
+    }
+
+    base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, MAPPING_SIZE));
+    if (!base) {
+        LOG_ERROR("SharedRing", "MapViewOfFile failed: " << GetLastError());
+        Close();
+        return false;
+    }
+
+    // Fresh layout every start; a client attached to an old mapping re-reads the header
+    std::memset(base, 0, MAPPING_SIZE);
+    Header* h = header();
+    h->version = VERSION;
+    h->frameSlotCount = FRAME_SLOTS;
+    h->frameSlotBytes = MAX_FRAME_BYTES;
+    h->resultSlotCount = RESULT_SLOTS;
+    h->resultTextBytes = MAX_RESULT_BYTES;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(h->magic, "NVSR", 4);
+
+    publishedFrames = 0;
+    lastResult = 0;
+    LOG_INFO("SharedRing", "Mapped " << name << " (" << MAPPING_SIZE / 1024 << " KB)");
+    return true;
+}
+
+bool SharedFrameRing::Open(const std::string& name) {
+    Close();
+
+    mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (!mapping) {
+        LOG_ERROR("SharedRing", "OpenFileMapping failed: " << GetLastError());
+        return false;
+    }
+    base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, MAPPING_SIZE));
+    if (!base || std::memcmp(header()->magic, "NVSR", 4) != 0 || header()->version != VERSION) {
+        LOG_ERROR("SharedRing", name << " is not a version " << VERSION << " ring");
+        Close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    lastResult = header()->latestResult.load(std::memory_order_acquire);
+    return true;
+}
+
+void SharedFrameRing::Close() {
+    if (base) {
+        UnmapViewOfFile(base);
+        base = nullptr;
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+}
+
+uint8_t* SharedFrameRing::FrameSlot(int64_t frameNumber) const {
+    return base + sizeof(Header) + static_cast<size_t>(frameNumber % FRAME_SLOTS) * FRAME_SLOT_SIZE;
+}
+
+uint8_t* SharedFrameRing::ResultSlot(int64_t resultNumber) const {
+    return base + sizeof(Header) + FRAME_SLOTS * FRAME_SLOT_SIZE +
+           static_cast<size_t>(resultNumber % RESULT_SLOTS) * RESULT_SLOT_SIZE;
+}
+
+// ============================================================================
+// Frames (engine -> client)
+// ============================================================================
+
+bool SharedFrameRing::PublishFrame(const cv::Mat& frame) {
+    if (!base || frame.empty() || frame.type() != CV_8UC3) {
+        return false;
+    }
+
+    size_t rowBytes = static_cast<size_t>(frame.cols) * 3;
+    size_t frameBytes = rowBytes * frame.rows;
+    if (frameBytes > MAX_FRAME_BYTES) {
+        LOG_ERROR("SharedRing", "Frame " << frame.cols << "x" << frame.rows << " too large for the ring");
+        return false;
+    }
+
+    int64_t frameNumber = publishedFrames + 1;
+    uint8_t* slot = FrameSlot(frameNumber);
+    auto* slotHeader = reinterpret_cast<FrameSlotHeader*>(slot);
+
+    slotHeader->state.store(2 * frameNumber - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slotHeader->width = static_cast<uint32_t>(frame.cols);
+    slotHeader->height = static_cast<uint32_t>(frame.rows);
+    slotHeader->stride = static_cast<uint32_t>(rowBytes);
+    slotHeader->timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // Packed rows: the client reshapes without knowing cv::Mat padding
+    uint8_t* pixels = slot + sizeof(FrameSlotHeader);
+    if (frame.isContinuous()) {
+        std::memcpy(pixels, frame.data, frameBytes);
+    } else {
+        for (int row = 0; row < frame.rows; ++row) {
+            std::memcpy(pixels + row * rowBytes, frame.ptr(row), rowBytes);
+        }
+    }
+
+    slotHeader->state.store(2 * frameNumber, std::memory_order_release);
+    header()->latestFrame.store(frameNumber, std::memory_order_release);
+    publishedFrames = frameNumber;
+    return true;
+}
+
+// ============================================================================
+// Results (client -> engine)
+// ============================================================================
+
+bool SharedFrameRing::PollResult(Result& result) {
+    if (!base) {
+        return false;
+    }
+
+    int64_t resultNumber = header()->latestResult.load(std::memory_order_acquire);
+    if (resultNumber <= lastResult) {
+        return false;
+    }
+
+    const uint8_t* slot = ResultSlot(resultNumber);
+    auto* slotHeader = reinterpret_cast<const ResultSlotHeader*>(slot);
+
+    int64_t expected = 2 * resultNumber;
+    if (slotHeader->state.load(std::memory_order_acquire) != expected) {
+        return false;  // Client is mid-write (or already lapped this slot); retry next poll
+    }
+
+    uint32_t length = (std::min)(slotHeader->length, MAX_RESULT_BYTES);
+    std::string text(reinterpret_cast<const char*>(slot + sizeof(ResultSlotHeader)), length);
+    int64_t frameNumber = slotHeader->frameNumber;
+    float latencyMs = slotHeader->latencyMs;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slotHeader->state.load(std::memory_order_relaxed) != expected) {
+        return false;
+    }
+
+    result.text = std::move(text);
+    result.frameNumber = frameNumber;
+    result.latencyMs = latencyMs;
+    lastResult = resultNumber;
+    return true;
+}
+
+// ============================================================================
+// Client side (frames in, results out)
+// ============================================================================
+
+bool SharedFrameRing::ReadLatestFrame(cv::Mat& frame, int64_t& frameNumber) const {
+    if (!base) {
+        return false;
+    }
+
+    int64_t latest = header()->latestFrame.load(std::memory_order_acquire);
+    if (latest <= frameNumber) {
+        return false;
+    }
+
+    const uint8_t* slot = FrameSlot(latest);
+    auto* slotHeader = reinterpret_cast<const FrameSlotHeader*>(slot);
+    int64_t expected = 2 * latest;
+    if (slotHeader->state.load(std::memory_order_acquire) != expected) {
+        return false;  // Engine is mid-write; the next poll sees it done
+    }
+
+    uint32_t width = slotHeader->width;
+    uint32_t height = slotHeader->height;
+    if (static_cast<size_t>(width) * height * 3 > MAX_FRAME_BYTES || width == 0 || height == 0) {
+        return false;
+    }
+    frame.create(static_cast<int>(height), static_cast<int>(width), CV_8UC3);
+    std::memcpy(frame.data, slot + sizeof(FrameSlotHeader), static_cast<size_t>(width) * height * 3);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slotHeader->state.load(std::memory_order_relaxed) != expected) {
+        return false;
+    }
+    frameNumber = latest;
+    return true;
+}
+
+void SharedFrameRing::PublishResult(int64_t frameNumber, const std::string& text, float latencyMs) {
+    if (!base) {
+        return;
+    }
+
+    int64_t resultNumber = lastResult + 1;
+    uint8_t* slot = ResultSlot(resultNumber);
+    auto* slotHeader = reinterpret_cast<ResultSlotHeader*>(slot);
+
+    slotHeader->state.store(2 * resultNumber - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint32_t length = static_cast<uint32_t>((std::min)(text.size(), static_cast<size_t>(MAX_RESULT_BYTES)));
+    std::memcpy(slot + sizeof(ResultSlotHeader), text.data(), length);
+    slotHeader->frameNumber = frameNumber;
+    slotHeader->latencyMs = latencyMs;
+    slotHeader->length = length;
+
+    slotHeader->state.store(2 * resultNumber, std::memory_order_release);
+    header()->latestResult.store(resultNumber, std::memory_order_release);
+    lastResult = resultNumber;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include <windows.h>
+
+/**
+ * SharedFrameRing - Camera frames out, captions back, through shared memory
+ *
+ * Bridges the engine to an out-of-process captioner (the PyTorch client,
+ * win_camera_fastvlm_pytorch.py --transport shm) without the HTTP hop or a
+ * second process opening the camera: the engine publishes raw BGR frames,
+ * the client publishes caption text.
+ *
+ * Layout (little-endian, all offsets in bytes):
+ *   Header (64):  "NVSR" | version | frameSlotCount | frameSlotBytes |
+ *                 resultSlotCount | resultTextBytes | latestFrame (int64 @24) |
+ *                 latestResult (int64 @32)
+ *   Frame slot:   state (int64) | width | height | stride | pad | timestampMs (int64)
+ *                 then frameSlotBytes of pixels (32-byte header)
+ *   Result slot:  state (int64) | frameNumber (int64) | latencyMs (float) |
+ *                 length (uint32) | pad (8), then resultTextBytes of UTF-8
+ *
+ * Each slot is a seqlock: the writer of item n stores state 2n-1, writes the
+ * payload, then stores 2n and publishes n in latestFrame/latestResult. A
+ * reader copies the payload and keeps it only if state read 2n both before
+ * and after. Item n lives in slot n % slotCount.
+ *
+ * The client side is implemented here too (Open, ReadLatestFrame,
+ * PublishResult) for the engine's own caption worker process
+ * (InferenceWorker, --caption-worker), which attaches to a per-engine ring.
+ *
+ * Usage:
+ *   SharedFrameRing ring;
+ *   ring.Create();
+ *   ring.PublishFrame(frame);
+ *   SharedFrameRing::Result result;
+ *   if (ring.PollResult(result)) { ... result.text ... }
+ *
+ *   SharedFrameRing client;                        // In the captioning process
+ *   client.Open(name);
+ *   if (client.ReadLatestFrame(frame, frameNumber)) { client.PublishResult(frameNumber, text, ms); }
+ */
+class SharedFrameRing {
+public:
+    static constexpr const char* DEFAULT_NAME = "Local\\NovaPerceptionCameraRing";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t FRAME_SLOTS = 3;
+    static constexpr uint32_t MAX_FRAME_BYTES = 640 * 480 * 3;
+    static constexpr uint32_t RESULT_SLOTS = 8;
+    static constexpr uint32_t MAX_RESULT_BYTES = 512;
+
+    struct Result {
+        std::string text;
+        int64_t frameNumber = 0;
+        float latencyMs = 0.0f;
+    };
+
+    SharedFrameRing();
+    ~SharedFrameRing();
+
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    /**
+     * @brief Create (or attach to) the named mapping and write the header
+     * @return true if the mapping is usable
+     */
+    bool Create(const std::string& name = DEFAULT_NAME);
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+
+    /**
+     * @brief Copy a BGR frame into the next slot
+     * @return false if the frame is not 8UC3 or exceeds MAX_FRAME_BYTES
+     */
+    bool PublishFrame(const cv::Mat& frame);
+
+    /**
+     * @brief Take the newest caption not returned before
+     * @return true if a new, consistently read result was copied
+     */
+    bool PollResult(Result& result);
+
+    int64_t GetPublishedFrameCount() const { return publishedFrames; }
+
+    // === Client side ===
+
+    /**
+     * @brief Attach to a ring Create()d by the engine
+     * @return false if it doesn't exist or isn't this version's layout
+     */
+    bool Open(const std::string& name = DEFAULT_NAME);
+
+    /**
+     * @brief Copy the newest frame if it is newer than frameNumber
+     * @return true with frame and frameNumber updated when a newer frame was read consistently
+     */
+    bool ReadLatestFrame(cv::Mat& frame, int64_t& frameNumber) const;
+
+    // Publish the caption of frameNumber (text truncated to MAX_RESULT_BYTES)
+    void PublishResult(int64_t frameNumber, const std::string& text, float latencyMs);
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t frameSlotCount;
+        uint32_t frameSlotBytes;
+        uint32_t resultSlotCount;
+        uint32_t resultTextBytes;
+        std::atomic<int64_t> latestFrame;
+        std::atomic<int64_t> latestResult;
+        uint8_t reserved[24];
+    };
+
+    struct FrameSlotHeader {
+        std::atomic<int64_t> state;
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        uint32_t pad;
+        int64_t timestampMs;
+    };
+
+    struct ResultSlotHeader {
+        std::atomic<int64_t> state;
+        int64_t frameNumber;
+        float latencyMs;
+        uint32_t length;
+        uint8_t pad[8];
+    };
+
+    static_assert(sizeof(Header) == 64, "Header layout is shared with the Python client");
+    static_assert(sizeof(FrameSlotHeader) == 32, "Frame slot layout is shared with the Python client");
+    static_assert(sizeof(ResultSlotHeader) == 32, "Result slot layout is shared with the Python client");
+    static_assert(std::atomic<int64_t>::is_always_lock_free, "Seqlock counters must be lock-free across processes");
+
+    static constexpr size_t FRAME_SLOT_SIZE = sizeof(FrameSlotHeader) + MAX_FRAME_BYTES;
+    static constexpr size_t RESULT_SLOT_SIZE = sizeof(ResultSlotHeader) + MAX_RESULT_BYTES;
+    static constexpr size_t MAPPING_SIZE = sizeof(Header) + FRAME_SLOTS * FRAME_SLOT_SIZE + RESULT_SLOTS * RESULT_SLOT_SIZE;
+
+    Header* header() const { return reinterpret_cast<Header*>(base); }
+    uint8_t* FrameSlot(int64_t frameNumber) const;
+    uint8_t* ResultSlot(int64_t resultNumber) const;
+
+    HANDLE mapping;
+    uint8_t* base;
+    int64_t publishedFrames;
+    int64_t lastResult;                 // Engine: last result polled; client: last result published
+};
@@ -1,20 +1,37 @@
 #include "SileroVAD.h"
-#include <iostream>
+#include "OrtRuntime.h"
+#include "CpuBudget.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
 #include <algorithm>
+#include <cstring>
 
 SileroVAD::SileroVAD()
-    : env(ORT_LOGGING_LEVEL_WARNING, "SileroVAD")
-    , session(nullptr)
+    : session(nullptr)
     , memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    , executionProviders{"CPU"}
+    , sessionBytes(0)
+    , currentState(0)
     , sr(SAMPLE_RATE)
+    , outputProbability(0.0f)
+    , inputTensor(nullptr)
+    , stateTensors{ Ort::Value(nullptr), Ort::Value(nullptr) }
+    , srTensor(nullptr)
+    , outputTensor(nullptr)
+    , useBinding(false)
 {
     // Initialize state (2 layers, batch=1, hidden_size=128)
-    state.resize(2 * 1 * 128, 0.0f);
+    stateBuffers[0].resize(STATE_SIZE, 0.0f);
+    stateBuffers[1].resize(STATE_SIZE, 0.0f);
+    inputBuffer.resize(CHUNK_SIZE, 0.0f);
 
     LogDebug("SileroVAD created");
 }
 
 SileroVAD::~SileroVAD() {
+    bindings[0].reset();
+    bindings[1].reset();
     session.reset();
     LogDebug("SileroVAD destroyed");
 }
@@ -30,12 +47,42 @@ bool SileroVAD::Initialize(const std::wstring& modelPath) {
         });
         LogDebug("Model path: " + modelPathStr);
 
-        // Configure session options
-        sessionOptions.SetIntraOpNumThreads(1);
-        sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        // Create session on the shared runtime (shared arena). A private single-thread
+        // pool keeps VAD frames from queueing behind a caption decode in the global pool;
+        // the model is tiny, so it runs on the calling (processing) thread
+        OrtRuntime::SessionConfig config;
+        config.optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+        config.logId = "SileroVAD";
+        config.useGlobalThreadPool = false;
+        config.intraOpThreads = CpuBudget::Instance().Get(CpuBudget::Subsystem::Vad).threads;
+        config.interOpThreads = 1;
 
-        // Create session
-        session = std::make_unique<Ort::Session>(env, modelPath.c_str(), sessionOptions);
+        // Probe: one silent frame through a throwaway state
+        auto benchmark = [this](Ort::Session& candidate) {
+            std::vector<float> audio(CHUNK_SIZE, 0.0f);
+            std::vector<float> state(STATE_SIZE, 0.0f);
+            int64_t rate = sr;
+            const int64_t audioShape[] = {1, static_cast<int64_t>(CHUNK_SIZE)};
+            const int64_t stateShape[] = {2, 1, 128};
+            const int64_t rateShape[] = {1};
+
+            Ort::Value inputs[] = {
+                Ort::Value::CreateTensor<float>(memoryInfo, audio.data(), audio.size(), audioShape, 2),
+                Ort::Value::CreateTensor<float>(memoryInfo, state.data(), state.size(), stateShape, 3),
+                Ort::Value::CreateTensor<int64_t>(memoryInfo, &rate, 1, rateShape, 1)
+            };
+            const char* inputNames[] = {"input", "state", "sr"};
+            const char* outputNames[] = {"output", "stateN"};
+            candidate.Run(Ort::RunOptions{nullptr}, inputNames, inputs, 3, outputNames, 2);
+        };
+
+        MemoryAccounting::Meter sessionMeter;
+        session = OrtRuntime::Instance().CreateFastestSession(modelPath, config, executionProviders, benchmark);
+        if (!session) {
+            LogError("Failed to create Silero VAD session");
+            return false;
+        }
+        sessionBytes = sessionMeter.Bytes();
 
         LogDebug("Silero VAD model loaded successfully");
 
@@ -61,6 +108,10 @@ bool SileroVAD::Initialize(const std::wstring& modelPath) {
             LogDebug("  Output " + std::to_string(i) + ": " + name_str);
         }
 
+        useBinding = SetupBindings();
+        LogDebug(useBinding ? "Using preallocated IoBinding inference"
+                            : "IoBinding unavailable, using per-frame tensors");
+
         return true;
     }
     catch (const Ort::Exception& e) {
@@ -73,7 +124,50 @@ bool SileroVAD::Initialize(const std::wstring& modelPath) {
     }
 }
 
+bool SileroVAD::SetupBindings() {
+    try {
+        // Input 0: audio (1, 512)
+        const int64_t input_shape[] = {1, static_cast<int64_t>(CHUNK_SIZE)};
+        inputTensor = Ort::Value::CreateTensor<float>(
+            memoryInfo, inputBuffer.data(), inputBuffer.size(), input_shape, 2);
+
+        // Input 1 / output 1: state (2, 1, 128), one tensor per buffer
+        const int64_t state_shape[] = {2, 1, 128};
+        for (int k = 0; k < 2; ++k) {
+            stateTensors[k] = Ort::Value::CreateTensor<float>(
+                memoryInfo, stateBuffers[k].data(), stateBuffers[k].size(), state_shape, 3);
+        }
+
+        // Input 2: sr (sample rate) - scalar int64
+        const int64_t sr_shape[] = {1};
+        srTensor = Ort::Value::CreateTensor<int64_t>(memoryInfo, &sr, 1, sr_shape, 1);
+
+        // Output 0: speech probability (1, 1)
+        const int64_t output_shape[] = {1, 1};
+        outputTensor = Ort::Value::CreateTensor<float>(memoryInfo, &outputProbability, 1, output_shape, 2);
+
+        // Binding k: state in stateBuffers[k] -> stateN in stateBuffers[1 - k]
+        for (int k = 0; k < 2; ++k) {
+            bindings[k] = std::make_unique<Ort::IoBinding>(*session);
+            bindings[k]->BindInput("input", inputTensor);
+            bindings[k]->BindInput("state", stateTensors[k]);
+            bindings[k]->BindInput("sr", srTensor);
+            bindings[k]->BindOutput("output", outputTensor);
+            bindings[k]->BindOutput("stateN", stateTensors[1 - k]);
+        }
+
+        return true;
+    }
+    catch (const Ort::Exception& e) {
+        LogError("IoBinding setup failed: " + std::string(e.what()));
+        bindings[0].reset();
+        bindings[1].reset();
+        return false;
+    }
+}
+
 float SileroVAD::Process(const float* audioData, size_t length) {
+    TRACE_ZONE("SileroVAD::Process");
     if (!session) {
         LogError("Silero VAD not initialized!");
         return 0.0f;
@@ -84,6 +178,48 @@ float SileroVAD::Process(const float* audioData, size_t length) {
         return 0.0f;
     }
 
+    float probability = 0.0f;
+    ProcessBatch(audioData, 1, &probability);
+    return probability;
+}
+
+size_t SileroVAD::ProcessBatch(const float* frames, size_t nFrames, float* probsOut) {
+    TRACE_ZONE("SileroVAD::ProcessBatch");
+    if (!session) {
+        LogError("Silero VAD not initialized!");
+        return 0;
+    }
+
+    // The LSTM state is recurrent, so frames must be stepped in order; the
+    // win here is that no tensor, vector or binding is created per frame
+    for (size_t f = 0; f < nFrames; ++f) {
+        const float* frame = frames + f * CHUNK_SIZE;
+        probsOut[f] = useBinding ? ProcessFrameBound(frame) : ProcessFrameUnbound(frame);
+    }
+
+    return nFrames;
+}
+
+float SileroVAD::ProcessFrameBound(const float* frame) {
+    try {
+        std::memcpy(inputBuffer.data(), frame, CHUNK_SIZE * sizeof(float));
+
+        // Normally empty; once after an idle trim it shrinks the shared arena
+        session->Run(OrtRuntime::Instance().TakeRunOptions(), *bindings[currentState]);
+
+        // stateN landed in the other buffer; it is the next frame's input
+        currentState = 1 - currentState;
+        return outputProbability;
+    }
+    catch (const Ort::Exception& e) {
+        // e.g. model with a different output shape; fall back permanently
+        LogError("Bound inference failed, falling back to per-frame tensors: " + std::string(e.what()));
+        useBinding = false;
+        return ProcessFrameUnbound(frame);
+    }
+}
+
+float SileroVAD::ProcessFrameUnbound(const float* audioData) {
     try {
         // Prepare input tensors based on actual model signature:
         // Input 0: "input" - audio (1, 512)
@@ -92,7 +228,7 @@ float SileroVAD::Process(const float* audioData, size_t length) {
 
         // Input 0: audio (1, 512)
         std::vector<int64_t> input_shape = {1, static_cast<int64_t>(CHUNK_SIZE)};
-        std::vector<float> input_audio(audioData, audioData + length);
+        std::vector<float> input_audio(audioData, audioData + CHUNK_SIZE);
 
         Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
             memoryInfo,
@@ -106,8 +242,8 @@ float SileroVAD::Process(const float* audioData, size_t length) {
         std::vector<int64_t> state_shape = {2, 1, 128};
         Ort::Value state_tensor = Ort::Value::CreateTensor<float>(
             memoryInfo,
-            state.data(),
-            state.size(),
+            stateBuffers[currentState].data(),
+            stateBuffers[currentState].size(),
             state_shape.data(),
             state_shape.size()
         );
@@ -135,7 +271,7 @@ float SileroVAD::Process(const float* audioData, size_t length) {
         input_tensors.push_back(std::move(sr_tensor));
 
         auto output_tensors = session->Run(
-            Ort::RunOptions{nullptr},
+            OrtRuntime::Instance().TakeRunOptions(),
             input_names,
             input_tensors.data(),
             input_tensors.size(),
@@ -149,7 +285,7 @@ float SileroVAD::Process(const float* audioData, size_t length) {
 
         // Update state for next iteration
         float* stateN_data = output_tensors[1].GetTensorMutableData<float>();
-        std::copy(stateN_data, stateN_data + state.size(), state.begin());
+        std::copy(stateN_data, stateN_data + STATE_SIZE, stateBuffers[currentState].begin());
 
         return speech_probability;
     }
@@ -165,14 +301,18 @@ float SileroVAD::Process(const float* audioData, size_t length) {
 
 void SileroVAD::Reset() {
     // Reset internal state
-    std::fill(state.begin(), state.end(), 0.0f);
+    std::fill(stateBuffers[0].begin(), stateBuffers[0].end(), 0.0f);
+    std::fill(stateBuffers[1].begin(), stateBuffers[1].end(), 0.0f);
+    currentState = 0;
     LogDebug("VAD state reset");
 }
 
 void SileroVAD::LogDebug(const std::string& message) {
-    std::cout << "[SileroVAD] " << message << std::endl;
+    if (Log::Enabled(Log::Level::Debug)) {
+        Log::Write(Log::Level::Debug, "SileroVAD", message);
+    }
 }
 
 void SileroVAD::LogError(const std::string& message) {
-    std::cerr << "[SileroVAD ERROR] " << message << std::endl;
+    Log::Write(Log::Level::Error, "SileroVAD", message);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -15,6 +16,9 @@
  * - Distinguishes speech from keyboard clicks, breathing, background music
  * - Low latency: processes 512 samples (32ms @ 16kHz)
  * - Stateful: maintains context across chunks
+ * - Zero-allocation inference: input, LSTM state and output tensors are
+ *   preallocated and bound once via Ort::IoBinding; the state ping-pongs
+ *   between two bound buffers so each frame just copies 512 samples and runs
  *
  * Usage:
  *   SileroVAD vad;
@@ -25,6 +29,9 @@
  *   if (probability > 0.5f) {
  *       // Speech detected!
  *   }
+ *
+ *   // Or classify a backlog of frames in one call (e.g. after a stall)
+ *   vad.ProcessBatch(frames, nFrames, probabilities);
  */
 class SileroVAD {
 public:
@@ -34,31 +41,63 @@ public:
     // Initialize with ONNX model path
     bool Initialize(const std::wstring& modelPath);
 
+    // Candidate execution providers probed by Initialize (default {"CPU"}: a
+    // 512-sample frame is too small for GPU/NPU dispatch to pay off, but the
+    // probe will confirm that on hardware where it doesn't hold)
+    void SetExecutionProviders(const std::vector<std::string>& providers) { executionProviders = providers; }
+
     // Process audio chunk and return speech probability [0.0-1.0]
     // Audio must be 512 samples @ 16kHz, float32
     float Process(const float* audioData, size_t length);
 
+    // Process nFrames consecutive 512-sample frames, stepping the LSTM state
+    // frame by frame; writes one probability per frame to probsOut.
+    // Returns the number of frames processed.
+    size_t ProcessBatch(const float* frames, size_t nFrames, float* probsOut);
+
     // Reset internal state (call between utterances)
     void Reset();
 
     // Check if initialized
     bool IsInitialized() const { return session != nullptr; }
 
+    // Private bytes grown while creating the session (for MemoryAccounting)
+    uint64_t GetSessionBytes() const { return sessionBytes; }
+
 private:
-    // ONNX Runtime
-    Ort::Env env;
+    // ONNX Runtime (session created by the shared OrtRuntime)
     std::unique_ptr<Ort::Session> session;
-    Ort::SessionOptions sessionOptions;
     Ort::MemoryInfo memoryInfo;
+    std::vector<std::string> executionProviders;
+    uint64_t sessionBytes;
 
     // Model expects 512 samples @ 16kHz
     static constexpr size_t CHUNK_SIZE = 512;
     static constexpr size_t SAMPLE_RATE = 16000;
 
+    static constexpr size_t STATE_SIZE = 2 * 1 * 128;
+
     // Internal state (Silero VAD is stateful)
-    std::vector<float> state;  // Combined LSTM state (2, 1, 128)
+    // Combined LSTM state (2, 1, 128), double-buffered: binding k reads
+    // stateBuffers[k] and writes stateN into stateBuffers[1 - k]
+    std::vector<float> stateBuffers[2];
+    int currentState;
     int64_t sr;                // Sample rate
 
+    // Preallocated, bound tensors (created once in Initialize)
+    std::vector<float> inputBuffer;     // (1, 512)
+    float outputProbability;            // (1, 1)
+    Ort::Value inputTensor;
+    Ort::Value stateTensors[2];
+    Ort::Value srTensor;
+    Ort::Value outputTensor;
+    std::unique_ptr<Ort::IoBinding> bindings[2];
+    bool useBinding;
+
+    bool SetupBindings();
+    float ProcessFrameBound(const float* frame);
+    float ProcessFrameUnbound(const float* frame);
+
     // Helper functions
     void LogDebug(const std::string& message);
     void LogError(const std::string& message);
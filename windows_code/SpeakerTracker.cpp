@@ -0,0 +1,263 @@
+#include "SpeakerTracker.h"
+#include "OrtRuntime.h"
+#include "CpuBudget.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+SpeakerTracker::SpeakerTracker()
+    : session(nullptr)
+    , memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    , sessionBytes(0)
+    , running(false)
+    , nextSpeakerId(1)
+    , assignments(0)
+{
+}
+
+SpeakerTracker::~SpeakerTracker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    pendingCv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool SpeakerTracker::Initialize(const std::wstring& modelPath) {
+    try {
+        // Private single-thread pool: the embedding overlaps a whisper decode,
+        // it must not take whisper's (or vision's) threads while doing so
+        OrtRuntime::SessionConfig config;
+        config.optimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+        config.logId = "SpeakerTracker";
+        config.useGlobalThreadPool = false;
+        config.intraOpThreads = 1;
+        config.interOpThreads = 1;
+        config.freeDimensionOverrides = { {"batch_size", 1}, {"batch", 1} };
+
+        MemoryAccounting::Meter sessionMeter;
+        session = OrtRuntime::Instance().CreateSession(modelPath, config);
+        if (!session) {
+            LOG_ERROR("SpeakerTracker", "Failed to create speaker embedding session");
+            return false;
+        }
+        sessionBytes = sessionMeter.Bytes();
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        inputName = session->GetInputNameAllocated(0, allocator).get();
+        outputName = session->GetOutputNameAllocated(0, allocator).get();
+
+        // One second of silence: checks the contract before the worker relies on it
+        std::vector<float> probe(16000, 0.0f);
+        std::vector<float> embedding;
+        if (!Embed(probe, embedding)) {
+            session.reset();
+            return false;
+        }
+        LOG_DEBUG("SpeakerTracker", "Speaker embeddings ready (" << embedding.size() << " dimensions)");
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("SpeakerTracker", "ONNX Runtime error: " << e.what());
+        session.reset();
+        return false;
+    }
+
+    running = true;
+    worker = std::thread(&SpeakerTracker::WorkerThread, this);
+    return true;
+}
+
+void SpeakerTracker::Submit(uint64_t id, const float* samples, size_t count) {
+    const size_t maxSamples = static_cast<size_t>(16000) * MAX_EMBED_SEC;
+    count = (std::min)(count, maxSamples);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!running) {
+        return;
+    }
+    if (pending.size() >= MAX_PENDING) {
+        results[id] = -1;       // Behind: an unknown speaker beats a late transcript
+        return;
+    }
+    std::vector<float> audio;
+    if (!freeBuffers.empty()) {
+        audio = std::move(freeBuffers.back());
+        freeBuffers.pop_back();
+    }
+    lock.unlock();
+
+    // The copy happens outside the lock; the worker never touches `audio` until queued
+    audio.assign(samples, samples + count);
+
+    lock.lock();
+    pending.push_back({ id, std::move(audio) });
+    lock.unlock();
+    pendingCv.notify_one();
+}
+
+int SpeakerTracker::Lookup(uint64_t id, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    resultsCv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                       [&] { return !running || results.count(id) > 0; });
+    auto it = results.find(id);
+    if (it == results.end()) {
+        return -1;
+    }
+    int speaker = it->second;
+    results.erase(it);
+    return speaker;
+}
+
+size_t SpeakerTracker::GetSpeakerCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return speakers.size();
+}
+
+void SpeakerTracker::WorkerThread() {
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Whisper);
+    TRACE_THREAD("Speaker embeddings");
+    ThreadCpu::Scope cpu(ThreadCpu::Group::Whisper);
+    const size_t enrollSamples = static_cast<size_t>(16000 * MIN_ENROLL_SEC);
+    std::vector<float> embedding;
+
+    while (true) {
+        Pending job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pendingCv.wait(lock, [this] { return !running || !pending.empty(); });
+            if (!running) {
+                break;
+            }
+            job = std::move(pending.front());
+            pending.pop_front();
+        }
+
+        int speaker = -1;
+        if (Embed(job.audio, embedding)) {
+            speaker = Assign(embedding, job.audio.size() >= enrollSamples);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            results[job.id] = speaker;
+            // Results nobody claimed (utterance dropped or filtered): oldest ids go first
+            while (results.size() > MAX_RESULTS) {
+                results.erase(results.begin());
+            }
+            if (freeBuffers.size() < MAX_PENDING) {
+                freeBuffers.push_back(std::move(job.audio));
+            }
+        }
+        resultsCv.notify_all();
+    }
+
+    resultsCv.notify_all();
+}
+
+bool SpeakerTracker::Embed(const std::vector<float>& audio, std::vector<float>& embedding) {
+    TRACE_ZONE("SpeakerTracker::Embed");
+    if (!session || audio.empty()) {
+        return false;
+    }
+    try {
+        const int64_t shape[] = { 1, static_cast<int64_t>(audio.size()) };
+        Ort::Value input = Ort::Value::CreateTensor<float>(memoryInfo, const_cast<float*>(audio.data()),
+                                                           audio.size(), shape, 2);
+        const char* inputNames[] = { inputName.c_str() };
+        const char* outputNames[] = { outputName.c_str() };
+        std::vector<Ort::Value> outputs = session->Run(Ort::RunOptions{nullptr}, inputNames, &input, 1,
+                                                       outputNames, 1);
+
+        const float* data = outputs[0].GetTensorData<float>();
+        size_t dims = outputs[0].GetTensorTypeAndShapeInfo().GetElementCount();
+        embedding.assign(data, data + dims);
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("SpeakerTracker", "Embedding failed: " << e.what());
+        return false;
+    }
+
+    // Unit length: cosine similarity becomes a dot product
+    double norm = 0.0;
+    for (float v : embedding) {
+        norm += static_cast<double>(v) * v;
+    }
+    if (norm <= 0.0) {
+        return false;
+    }
+    const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+    for (float& v : embedding) {
+        v *= scale;
+    }
+    return true;
+}
+
+int SpeakerTracker::Assign(const std::vector<float>& embedding, bool enroll) {
+    assignments++;
+
+    Speaker* best = nullptr;
+    float bestSimilarity = -1.0f;
+    for (Speaker& speaker : speakers) {
+        if (speaker.centroid.size() != embedding.size()) {
+            continue;
+        }
+        float similarity = 0.0f;
+        for (size_t i = 0; i < embedding.size(); ++i) {
+            similarity += speaker.centroid[i] * embedding[i];
+        }
+        if (similarity > bestSimilarity) {
+            bestSimilarity = similarity;
+            best = &speaker;
+        }
+    }
+
+    if (best && bestSimilarity >= SAME_SPEAKER_SIMILARITY) {
+        best->lastHeard = assignments;
+        if (enroll) {
+            // Running mean of the unit prints, renormalized
+            best->utterances++;
+            const float weight = 1.0f / static_cast<float>(best->utterances);
+            double norm = 0.0;
+            for (size_t i = 0; i < embedding.size(); ++i) {
+                best->centroid[i] += (embedding[i] - best->centroid[i]) * weight;
+                norm += static_cast<double>(best->centroid[i]) * best->centroid[i];
+            }
+            if (norm > 0.0) {
+                const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+                for (float& v : best->centroid) {
+                    v *= scale;
+                }
+            }
+        }
+        return best->id;
+    }
+    if (!enroll) {
+        return -1;
+    }
+
+    // A new voice; when full it takes the place of the one heard least recently
+    Speaker speaker;
+    speaker.id = nextSpeakerId++;
+    speaker.centroid = embedding;
+    speaker.utterances = 1;
+    speaker.lastHeard = assignments;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (speakers.size() < MAX_SPEAKERS) {
+        speakers.push_back(std::move(speaker));
+    } else {
+        auto oldest = std::min_element(speakers.begin(), speakers.end(),
+                                       [](const Speaker& a, const Speaker& b) { return a.lastHeard < b.lastHeard; });
+        *oldest = std::move(speaker);
+    }
+    LOG_DEBUG("SpeakerTracker", "New speaker " << nextSpeakerId - 1 << " (closest similarity "
+              << bestSimilarity << ")");
+    return nextSpeakerId - 1;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * SpeakerTracker - Who said each utterance, worked out beside whisper
+ *
+ * A small speaker-embedding model (ECAPA / ResNet style, exported with its
+ * feature front end in the graph) turns each utterance into a voice print;
+ * an online centroid index then clusters the prints into speakers as they
+ * arrive, so every transcription can carry a stable speaker id.
+ *
+ * Model contract:
+ *   input   float (1, N)   16 kHz mono, [-1, 1], any length
+ *   output  float (1, D)   embedding (normalized here)
+ *
+ * Clustering: an embedding joins the speaker whose centroid is most similar
+ * (cosine) if that reaches SAME_SPEAKER_SIMILARITY, and the centroid moves
+ * toward it; otherwise it starts a new speaker. Utterances shorter than
+ * MIN_ENROLL_SEC are too short for a reliable print: they are matched but
+ * never create or move a speaker. At most MAX_SPEAKERS are kept; a new one
+ * replaces the speaker heard least recently. Ids start at 1 and are never
+ * reused.
+ *
+ * Threading: Submit() copies (at most MAX_EMBED_SEC of) the utterance and
+ * returns; a private worker runs the model while whisper decodes the same
+ * audio, so by the time the transcription is delivered the speaker is
+ * normally known. Lookup() waits a bounded time for a late one.
+ *
+ * Usage:
+ *   SpeakerTracker speakers;
+ *   speakers.Initialize(L"models/speaker/speaker.onnx");
+ *   speakers.Submit(utteranceId, audio.data(), audio.size());   // Next to QueueAudio
+ *   int speaker = speakers.Lookup(utteranceId, 100);              // At delivery; -1 unknown
+ */
+class SpeakerTracker {
+public:
+    static constexpr float SAME_SPEAKER_SIMILARITY = 0.6f;
+    static constexpr float MIN_ENROLL_SEC = 1.0f;
+    static constexpr int MAX_EMBED_SEC = 10;            // Longer utterances: the first 10 s
+    static constexpr size_t MAX_SPEAKERS = 16;
+    static constexpr size_t MAX_PENDING = 8;            // Utterances waiting for the worker
+    static constexpr size_t MAX_RESULTS = 64;           // Unclaimed results kept
+
+    SpeakerTracker();
+    ~SpeakerTracker();
+
+    SpeakerTracker(const SpeakerTracker&) = delete;
+    SpeakerTracker& operator=(const SpeakerTracker&) = delete;
+
+    // Load the model and start the worker
+    bool Initialize(const std::wstring& modelPath);
+    bool IsInitialized() const { return worker.joinable(); }
+
+    // Queue one utterance (16 kHz mono) under a caller-chosen id; dropped
+    // (Lookup returns -1) when MAX_PENDING are already waiting
+    void Submit(uint64_t id, const float* samples, size_t count);
+
+    // Speaker of utterance id, waiting up to timeoutMs for its embedding;
+    // -1 when unknown. Each result can be looked up once
+    int Lookup(uint64_t id, int timeoutMs);
+
+    size_t GetSpeakerCount() const;
+
+    // Private bytes grown while creating the session (for MemoryAccounting)
+    uint64_t GetSessionBytes() const { return sessionBytes; }
+
+private:
+    struct Pending {
+        uint64_t id;
+        std::vector<float> audio;
+    };
+
+    struct Speaker {
+        int id;
+        std::vector<float> centroid;    // Unit length
+        size_t utterances = 0;
+        uint64_t lastHeard = 0;         // Assignment counter value
+    };
+
+    void WorkerThread();
+    bool Embed(const std::vector<float>& audio, std::vector<float>& embedding);
+    int Assign(const std::vector<float>& embedding, bool enroll);
+
+    std::unique_ptr<Ort::Session> session;
+    Ort::MemoryInfo memoryInfo;
+    std::string inputName;
+    std::string outputName;
+    uint64_t sessionBytes;
+
+    // Worker input
+    std::deque<Pending> pending;
+    std::vector<std::vector<float>> freeBuffers;
+    bool running;
+    std::condition_variable pendingCv;
+
+    // Worker output
+    std::map<uint64_t, int> results;
+    std::condition_variable resultsCv;
+
+    // Clusters (worker thread only, but counted under the mutex)
+    std::vector<Speaker> speakers;
+    int nextSpeakerId;
+    uint64_t assignments;
+
+    mutable std::mutex mutex;           // pending, freeBuffers, running, results, speakers.size()
+    std::thread worker;
+};
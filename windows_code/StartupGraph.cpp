@@ -0,0 +1,192 @@
+#include "StartupGraph.h"
+#include "LargePages.h"
+#include "Log.h"
+#include "StartupTimeline.h"
+#include "Trace.h"
+#include <exception>
+
+StartupGraph::~StartupGraph() {
+    Wait();
+}
+
+bool StartupGraph::Add(const std::string& name, const std::vector<std::string>& dependsOn, Task task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started || Find(name)) {
+        LOG_ERROR("Startup", "Cannot add task " << name);
+        return false;
+    }
+    auto node = std::make_unique<Node>();
+    node->name = name;
+    node->task = std::move(task);
+    for (const std::string& dependency : dependsOn) {
+        const Node* found = Find(dependency);
+        if (!found) {
+            LOG_ERROR("Startup", "Task " << name << " depends on unknown task " << dependency);
+            return false;
+        }
+        for (size_t index = 0; index < nodes.size(); ++index) {
+            if (nodes[index].get() == found) {
+                node->dependsOn.push_back(index);
+            }
+        }
+    }
+    nodes.push_back(std::move(node));
+    return true;
+}
+
+void StartupGraph::Start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started) {
+        return;
+    }
+    started = true;
+    startTime = Clock::now();
+    for (auto& node : nodes) {
+        Node* target = node.get();
+        node->thread = std::thread([this, target]() { Run(*target); });
+    }
+}
+
+void StartupGraph::Wait() {
+    // Nodes are fixed once started, so the threads can be joined without the lock
+    for (auto& node : nodes) {
+        if (node->thread.joinable()) {
+            node->thread.join();
+        }
+    }
+}
+
+void StartupGraph::Run(Node& node) {
+    TRACE_THREAD("Startup task");
+
+    // Wait for the dependencies; any that didn't come up skips this task
+    bool runnable = true;
+    bool allDone = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() {
+            for (size_t index : node.dependsOn) {
+                if (!IsFinal(nodes[index]->state)) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        for (size_t index : node.dependsOn) {
+            if (nodes[index]->state != State::Ready) {
+                LOG_WARNING("Startup", "Skipping " << node.name << ": " << nodes[index]->name << " is "
+                            << StateName(nodes[index]->state));
+                runnable = false;
+            }
+        }
+        node.state = runnable ? State::Running : State::Skipped;
+        node.started = Clock::now();
+        node.finished = node.started;
+        allDone = !runnable && AllFinal();
+    }
+    if (!runnable) {
+        changed.notify_all();
+        if (allDone) {
+            StartupTimeline::Instance().Finish();
+        }
+        return;
+    }
+
+    bool succeeded = false;
+    try {
+        // The task's steps (model loads, device opens) nest under this span
+        StartupTimeline::Span span(node.name);
+        succeeded = node.task();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Startup", node.name << " threw: " << e.what());
+    }
+
+    Clock::time_point finished = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        node.state = succeeded ? State::Ready : State::Failed;
+        node.finished = finished;
+        allDone = AllFinal();
+    }
+    changed.notify_all();
+
+    auto ms = [](Clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    };
+    LOG_INFO("Startup", node.name << " " << StateName(succeeded ? State::Ready : State::Failed) << " in "
+             << ms(finished - node.started) << " ms (" << ms(finished - startTime) << " ms since start)");
+    if (allDone) {
+        StartupTimeline::Instance().Finish();
+    }
+}
+
+bool StartupGraph::AllFinal() const {
+    for (const auto& node : nodes) {
+        if (!IsFinal(node->state)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const StartupGraph::Node* StartupGraph::Find(const std::string& name) const {
+    for (const auto& node : nodes) {
+        if (node->name == name) {
+            return node.get();
+        }
+    }
+    return nullptr;
+}
+
+StartupGraph::State StartupGraph::GetState(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Node* node = Find(name);
+    return node ? node->state : State::Pending;
+}
+
+bool StartupGraph::IsDone(const std::string& name) const {
+    return IsFinal(GetState(name));
+}
+
+const char* StartupGraph::StateName(State state) {
+    switch (state) {
+        case State::Pending: return "pending";
+        case State::Running: return "running";
+        case State::Ready:   return "ready";
+        case State::Failed:  return "failed";
+        case State::Skipped: return "skipped";
+    }
+    return "unknown";
+}
+
+void StartupGraph::Write(JsonWriter& writer) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::time_point now = Clock::now();
+    auto ms = [](Clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    };
+
+    writer.BeginObject();
+    writer.Key("elapsedMs").Int(started ? ms(now - startTime) : 0);
+    writer.Key("tasks").BeginArray();
+    for (const auto& node : nodes) {
+        writer.BeginObject();
+        writer.Key("name").String(node->name);
+        writer.Key("state").String(StateName(node->state));
+        writer.Key("dependsOn").BeginArray();
+        for (size_t index : node->dependsOn) {
+            writer.String(nodes[index]->name);
+        }
+        writer.EndArray();
+        bool begun = node->state != State::Pending;
+        writer.Key("waitedMs").Int(started ? ms((begun ? node->started : now) - startTime) : 0);
+        writer.Key("ranMs").Int(!begun ? 0 : ms((IsFinal(node->state) ? node->finished : now) - node->started));
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("spans");
+    StartupTimeline::Instance().Write(writer);
+    writer.Key("largePages");
+    LargePages::Instance().Write(writer);
+    writer.EndObject();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "JsonWriter.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * StartupGraph - Subsystem initialization as a dependency graph
+ *
+ * The service used to bring its subsystems up one after another: the
+ * collector (journal replay) before the HTTP server, then whisper, then the
+ * camera models, then the fusion model. Each task here runs on its own
+ * thread as soon as the tasks it depends on are ready, so independent
+ * loads overlap and the server answers while they are still running.
+ *
+ * Readiness:
+ *   Every task has a state (pending, running, ready, failed, skipped) that
+ *   any thread can read; request handlers check IsReady() before touching
+ *   what a task creates. The state change is published under the graph's
+ *   mutex, so whatever the task wrote before returning is visible to a
+ *   thread that has seen it ready. A task whose dependency failed or was
+ *   skipped is skipped itself.
+ *
+ * Usage:
+ *   StartupGraph startup;
+ *   startup.Add("collector", {}, [&] { ...; return true; });
+ *   startup.Add("voice", {"collector"}, [&] { return LoadVoice(); });
+ *   startup.Start();
+ *   if (startup.IsReady("collector")) { ... }
+ *   startup.Wait();                      // Joins every task
+ *
+ * Tasks are added before Start() and may only depend on tasks already
+ * added, so the graph can't have a cycle.
+ */
+class StartupGraph {
+public:
+    enum class State { Pending, Running, Ready, Failed, Skipped };
+    using Task = std::function<bool()>;
+
+    StartupGraph() = default;
+    ~StartupGraph();
+
+    StartupGraph(const StartupGraph&) = delete;
+    StartupGraph& operator=(const StartupGraph&) = delete;
+
+    /**
+     * @brief Declare a task (before Start)
+     * @return false (nothing added) for a duplicate name or an unknown dependency
+     */
+    bool Add(const std::string& name, const std::vector<std::string>& dependsOn, Task task);
+
+    /**
+     * @brief Launch every task; each waits for its dependencies
+     */
+    void Start();
+
+    /**
+     * @brief Join every task (returns at once when not started)
+     */
+    void Wait();
+
+    State GetState(const std::string& name) const;
+    bool IsReady(const std::string& name) const { return GetState(name) == State::Ready; }
+
+    // Ready, failed or skipped (Pending for unknown names)
+    bool IsDone(const std::string& name) const;
+
+    static const char* StateName(State state);
+
+    /**
+     * @brief {"elapsedMs": ..., "tasks": [{"name", "state", "dependsOn", "waitedMs", "ranMs"}],
+     *         "spans": StartupTimeline tree, "largePages": whether LargePages got activated}
+     */
+    void Write(JsonWriter& writer) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Node {
+        std::string name;
+        std::vector<size_t> dependsOn;
+        Task task;
+        State state = State::Pending;
+        Clock::time_point started;          // When it began running
+        Clock::time_point finished;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    Clock::time_point startTime;
+    bool started = false;
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+
+    void Run(Node& node);
+    const Node* Find(const std::string& name) const;
+    // Every task ready, failed or skipped (mutex held); the timeline closes then
+    bool AllFinal() const;
+    static bool IsFinal(State state) { return state != State::Pending && state != State::Running; }
+};
@@ -0,0 +1,153 @@
+#include "StartupTimeline.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include <windows.h>
+#include <psapi.h>
+#include <chrono>
+#include <cstdio>
+
+#pragma comment(lib, "psapi.lib")
+
+// Innermost open span on this thread (-1: none)
+static thread_local int t_currentSpan = -1;
+
+static int64_t SteadyNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StartupTimeline& StartupTimeline::Instance() {
+    // Leaked like the other process-wide caches: spans may close during exit
+    static StartupTimeline* timeline = new StartupTimeline();
+    return *timeline;
+}
+
+StartupTimeline::StartupTimeline()
+    : processStartOffsetMs(0.0), steadyOriginUs(SteadyNowUs()), finished(false) {
+    // Anchor the steady clock to the process creation time, so startMs
+    // includes what happened before the first span
+    FILETIME creation, exitTime, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        ULARGE_INTEGER created, current;
+        created.LowPart = creation.dwLowDateTime;
+        created.HighPart = creation.dwHighDateTime;
+        current.LowPart = now.dwLowDateTime;
+        current.HighPart = now.dwHighDateTime;
+        if (current.QuadPart > created.QuadPart) {
+            processStartOffsetMs = (current.QuadPart - created.QuadPart) / 10000.0;     // 100 ns units
+        }
+    }
+}
+
+StartupTimeline::Counters StartupTimeline::Sample() const {
+    Counters counters = {};
+    counters.ms = processStartOffsetMs + (SteadyNowUs() - steadyOriginUs) / 1000.0;
+    IO_COUNTERS io = {};
+    if (GetProcessIoCounters(GetCurrentProcess(), &io)) {
+        counters.readBytes = io.ReadTransferCount;
+    }
+    PROCESS_MEMORY_COUNTERS_EX memory = {};
+    memory.cb = sizeof(memory);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory),
+                             sizeof(memory))) {
+        counters.pageFaults = memory.PageFaultCount;
+        counters.privateBytes = memory.PrivateUsage;
+    }
+    return counters;
+}
+
+int StartupTimeline::Open(const std::string& name, int parent) {
+    Counters start = Sample();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (finished) {
+        return -1;
+    }
+    records.push_back({ name, parent, GetCurrentThreadId(), start, start, true });
+    return static_cast<int>(records.size() - 1);
+}
+
+void StartupTimeline::Close(int index) {
+    Counters end = Sample();
+    std::lock_guard<std::mutex> lock(mutex);
+    Record& record = records[index];
+    record.end = end;
+    record.open = false;
+}
+
+StartupTimeline::Span::Span(const std::string& name)
+    : index(-1), parent(t_currentSpan) {
+    index = Instance().Open(name, parent);
+    if (index >= 0) {
+        t_currentSpan = index;
+    }
+}
+
+StartupTimeline::Span::~Span() {
+    if (index >= 0) {
+        Instance().Close(index);
+        t_currentSpan = parent;
+    }
+}
+
+void StartupTimeline::Finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (finished) {
+        return;
+    }
+    finished = true;
+    LOG_INFO("Startup", "Timeline (ms since process start; read / faults / private delta are process-wide):");
+    LogChildren(-1, 0);
+}
+
+void StartupTimeline::LogChildren(int parent, int depth) const {
+    for (size_t i = 0; i < records.size(); ++i) {
+        const Record& record = records[i];
+        if (record.parent != parent) {
+            continue;
+        }
+        char line[256];
+        int64_t privateDelta = static_cast<int64_t>(record.end.privateBytes) -
+                               static_cast<int64_t>(record.start.privateBytes);
+        std::snprintf(line, sizeof(line), "%*s%-*s %8.1f ms @ %8.1f  read %6.1f MB  faults %7llu  private %+7.1f MB%s",
+                      depth * 2, "", 28 - depth * 2, record.name.c_str(),
+                      record.end.ms - record.start.ms, record.start.ms,
+                      (record.end.readBytes - record.start.readBytes) / (1024.0 * 1024.0),
+                      static_cast<unsigned long long>(record.end.pageFaults - record.start.pageFaults),
+                      privateDelta / (1024.0 * 1024.0), record.open ? " (still running)" : "");
+        LOG_INFO("Startup", line);
+        LogChildren(static_cast<int>(i), depth + 1);
+    }
+}
+
+void StartupTimeline::Write(JsonWriter& writer) const {
+    Counters now = Sample();
+    std::lock_guard<std::mutex> lock(mutex);
+    WriteChildren(writer, -1, now);
+}
+
+void StartupTimeline::WriteChildren(JsonWriter& writer, int parent, const Counters& now) const {
+    writer.BeginArray();
+    for (size_t i = 0; i < records.size(); ++i) {
+        const Record& record = records[i];
+        if (record.parent != parent) {
+            continue;
+        }
+        const Counters& end = record.open ? now : record.end;
+        writer.BeginObject();
+        writer.Key("name").String(record.name);
+        writer.Key("thread").UInt(record.threadId);
+        writer.Key("startMs").Double(record.start.ms, 1);
+        writer.Key("durationMs").Double(end.ms - record.start.ms, 1);
+        writer.Key("running").Bool(record.open);
+        writer.Key("readBytes").UInt(end.readBytes - record.start.readBytes);
+        writer.Key("pageFaults").UInt(end.pageFaults - record.start.pageFaults);
+        writer.Key("privateDeltaBytes").Int(static_cast<int64_t>(end.privateBytes) -
+                                            static_cast<int64_t>(record.start.privateBytes));
+        writer.Key("children");
+        WriteChildren(writer, static_cast<int>(i), now);
+        writer.EndObject();
+    }
+    writer.EndArray();
+}
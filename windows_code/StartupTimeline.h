@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class JsonWriter;
+
+/**
+ * StartupTimeline - Where startup time goes, as a tree of timed spans
+ *
+ * StartupGraph says how long each task took; this says what inside it took
+ * the time: WSAStartup, active app monitoring, journal replay, the whisper
+ * model load, the Silero session, the three FastVLM sessions, opening the
+ * camera. A Span records its start (ms since the process was created, so
+ * the loader and static initialization show up as the gap before the first
+ * span), duration, and what the process did meanwhile: bytes read through
+ * ReadFile, page faults (memory-mapped models are read this way instead),
+ * and the private bytes it grew by.
+ *
+ * Spans nest per thread: a span opened while another is open on the same
+ * thread is its child, so spans inside engine code land under the startup
+ * task that called it. The counters are process-wide, which makes the
+ * deltas of spans running at the same time on different tasks overlap;
+ * durations are exact.
+ *
+ * Recording ends with Finish() (StartupGraph calls it once every task is
+ * done), which logs the tree; spans after that - a camera restart, a model
+ * reload - are not recorded, so the timeline stays the startup's.
+ *
+ * Usage:
+ *   {
+ *       StartupTimeline::Span span("whisper_load");
+ *       LoadWhisper();
+ *   }
+ *   StartupTimeline::Instance().Write(writer);       // /startup
+ */
+class StartupTimeline {
+public:
+    static StartupTimeline& Instance();
+
+    StartupTimeline(const StartupTimeline&) = delete;
+    StartupTimeline& operator=(const StartupTimeline&) = delete;
+
+    class Span {
+    public:
+        explicit Span(const std::string& name);
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        int index;                      // -1: not recorded
+        int parent;
+    };
+
+    // Stop recording and log the tree (once; later calls do nothing)
+    void Finish();
+
+    /**
+     * @brief [{"name", "thread", "startMs", "durationMs", "running", "readBytes",
+     *          "pageFaults", "privateDeltaBytes", "children": [...]}], in start order
+     * A span still running reports its duration so far
+     */
+    void Write(JsonWriter& writer) const;
+
+private:
+    StartupTimeline();
+
+    struct Counters {
+        double ms;                      // Since process creation
+        uint64_t readBytes;
+        uint64_t pageFaults;
+        uint64_t privateBytes;
+    };
+
+    struct Record {
+        std::string name;
+        int parent;
+        uint32_t threadId;
+        Counters start;
+        Counters end;
+        bool open;
+    };
+
+    Counters Sample() const;
+    int Open(const std::string& name, int parent);
+    void Close(int index);
+    void WriteChildren(JsonWriter& writer, int parent, const Counters& now) const;
+    void LogChildren(int parent, int depth) const;
+
+    double processStartOffsetMs;        // Process creation to this object's steady origin
+    int64_t steadyOriginUs;
+    mutable std::mutex mutex;
+    std::vector<Record> records;
+    bool finished;
+};
@@ -0,0 +1,110 @@
+#include "StaticAssetCache.h"
+#include "Log.h"
+#include <fstream>
+
+StaticAssetCache::StaticAssetCache(const std::string& path, const std::string& contentType)
+    : path(path), contentType(contentType), cacheKey("asset." + this->path.filename().string()) {
+}
+
+bool StaticAssetCache::Serve(const HttpRequest& request, HttpResponse& response) {
+    std::shared_ptr<const Asset> current = Current();
+    if (!current) {
+        return false;
+    }
+
+    response.SetHeader("ETag", current->etag);
+    response.SetHeader("Cache-Control", "no-cache");
+    // Only a choice of encodings varies; the one representation may be kept
+    // by the kernel (http.sys backend) for as long as a change takes to notice
+    bool variants = !current->brotli.empty() || !current->gzip.empty();
+    if (variants) {
+        response.SetHeader("Vary", "Accept-Encoding");
+    }
+    response.AllowKernelCache(RECHECK_INTERVAL_MS / 1000);
+
+    std::string ifNoneMatch = request.GetHeader("if-none-match");
+    if (!ifNoneMatch.empty() &&
+        (ifNoneMatch == "*" || ifNoneMatch.find(current->etag) != std::string::npos)) {
+        response.status = 304;
+        return true;
+    }
+
+    // Prefer brotli, then gzip, when a precompressed variant was found
+    response.SetHeader("Content-Type", contentType);
+    if (!current->brotli.empty() && request.AcceptsEncoding("br")) {
+        response.SetHeader("Content-Encoding", "br");
+        response.SetSharedBody(std::shared_ptr<const std::string>(current, &current->brotli), cacheKey + ".br");
+    } else if (!current->gzip.empty() && request.AcceptsEncoding("gzip")) {
+        response.SetHeader("Content-Encoding", "gzip");
+        response.SetSharedBody(std::shared_ptr<const std::string>(current, &current->gzip), cacheKey + ".gz");
+    } else {
+        response.SetSharedBody(std::shared_ptr<const std::string>(current, &current->identity), cacheKey);
+    }
+    response.status = 200;
+    return true;
+}
+
+std::shared_ptr<const StaticAssetCache::Asset> StaticAssetCache::Current() {
+    std::lock_guard<std::mutex> lock(assetMutex);
+
+    auto now = std::chrono::steady_clock::now();
+    if (asset && now - lastCheck < std::chrono::milliseconds(RECHECK_INTERVAL_MS)) {
+        return asset;
+    }
+    lastCheck = now;
+
+    std::error_code ec;
+    auto lastWrite = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return asset;       // Keep serving the copy we have if the file vanished
+    }
+    if (!asset || asset->lastWrite != lastWrite) {
+        std::shared_ptr<const Asset> loaded = Load(lastWrite);
+        if (loaded) {
+            asset = loaded;
+        }
+    }
+    return asset;
+}
+
+std::shared_ptr<const StaticAssetCache::Asset> StaticAssetCache::Load(std::filesystem::file_time_type lastWrite) {
+    auto loaded = std::make_shared<Asset>();
+    if (!ReadFile(path, loaded->identity)) {
+        LOG_ERROR("StaticAsset", "Failed to read " << path.string());
+        return nullptr;
+    }
+    loaded->lastWrite = lastWrite;
+
+    // Variants are only trusted when at least as new as the file they compress
+    std::filesystem::path gzipPath = path.string() + ".gz";
+    std::filesystem::path brotliPath = path.string() + ".br";
+    std::error_code ec;
+    if (std::filesystem::exists(gzipPath, ec) && std::filesystem::last_write_time(gzipPath, ec) >= lastWrite) {
+        ReadFile(gzipPath, loaded->gzip);
+    }
+    if (std::filesystem::exists(brotliPath, ec) && std::filesystem::last_write_time(brotliPath, ec) >= lastWrite) {
+        ReadFile(brotliPath, loaded->brotli);
+    }
+
+    // FNV-1a over the content: the same bytes always get the same tag
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : loaded->identity) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    char tag[24];
+    snprintf(tag, sizeof(tag), "\"%016llx\"", static_cast<unsigned long long>(hash));
+    loaded->etag = tag;
+
+    LOG_INFO("StaticAsset", "Loaded " << path.string() << " (" << loaded->identity.size() << " bytes"
+             << (loaded->gzip.empty() ? "" : ", gzip") << (loaded->brotli.empty() ? "" : ", br") << ")");
+    return loaded;
+}
+
+bool StaticAssetCache::ReadFile(const std::filesystem::path& filePath, std::string& content) {
+    std::ifstream file(filePath.string(), std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "HttpServer.h"
+
+/**
+ * StaticAssetCache - One static file held in memory, served with validators
+ *
+ * The file is read once and re-read only when its last-write time changes
+ * (checked at most every RECHECK_INTERVAL_MS), so a page reload costs no disk
+ * read and a client that already has the current version gets a bodyless 304.
+ *
+ * Features:
+ * - Strong ETag from the content hash; If-None-Match -> 304
+ * - Cache-Control: no-cache, so browsers revalidate instead of going stale
+ * - Precompressed variants: "<file>.br" / "<file>.gz" next to the file are
+ *   served when the client's Accept-Encoding allows (Vary: Accept-Encoding)
+ * - On the http.sys backend the bytes are sent from the kernel's fragment
+ *   cache, and an asset without variants from its response cache
+ *
+ * Usage:
+ *   StaticAssetCache dashboard("dashboard.html", "text/html; charset=utf-8");
+ *   if (!dashboard.Serve(request, response)) { ... file missing ... }
+ *
+ * Thread-safe: assets are immutable once loaded and shared by pointer; a
+ * response references the cached bytes instead of copying them.
+ */
+class StaticAssetCache {
+public:
+    static constexpr int RECHECK_INTERVAL_MS = 2000;
+
+    StaticAssetCache(const std::string& path, const std::string& contentType);
+
+    /**
+     * @brief Fill the response (200 or 304) for a GET of this asset
+     * @return false if the file can't be read (response untouched)
+     */
+    bool Serve(const HttpRequest& request, HttpResponse& response);
+
+private:
+    struct Asset {
+        std::string identity;
+        std::string gzip;                   // Empty when no .gz variant exists
+        std::string brotli;                 // Empty when no .br variant exists
+        std::string etag;
+        std::filesystem::file_time_type lastWrite;
+    };
+
+    std::shared_ptr<const Asset> Current();
+    std::shared_ptr<const Asset> Load(std::filesystem::file_time_type lastWrite);
+
+    static bool ReadFile(const std::filesystem::path& path, std::string& content);
+
+    std::filesystem::path path;
+    std::string contentType;
+    std::string cacheKey;                   // HttpResponse body cache key
+
+    std::mutex assetMutex;
+    std::shared_ptr<const Asset> asset;
+    std::chrono::steady_clock::time_point lastCheck;
+};
@@ -0,0 +1,59 @@
+#include "StringInterner.h"
+#include "JsonWriter.h"
+#include <iostream>
+#include <mutex>
+
+StringInterner::StringInterner() {
+    entries.emplace_back();
+    ids.emplace(std::string_view(entries.front().value), EMPTY);
+}
+
+StringInterner::Id StringInterner::Intern(std::string_view value) {
+    value = value.substr(0, MAX_STRING_BYTES);
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        auto it = ids.find(value);
+        if (it != ids.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(tableMutex);
+    auto it = ids.find(value);          // Another thread may have added it meanwhile
+    if (it != ids.end()) {
+        return it->second;
+    }
+    if (entries.size() >= MAX_ENTRIES) {
+        if (!reportedFull) {
+            std::cerr << "[StringInterner] Table full (" << MAX_ENTRIES << " entries); new strings read as empty"
+                      << std::endl;
+            reportedFull = true;
+        }
+        return EMPTY;
+    }
+
+    Entry& entry = entries.emplace_back();
+    entry.value.assign(value.data(), value.size());
+    JsonWriter::AppendEscaped(entry.escaped, entry.value);
+    Id id = static_cast<Id>(entries.size() - 1);
+    ids.emplace(std::string_view(entry.value), id);
+    return id;
+}
+
+const StringInterner::Entry& StringInterner::EntryFor(Id id) const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    return id < entries.size() ? entries[id] : entries.front();
+}
+
+const std::string& StringInterner::Get(Id id) const {
+    return EntryFor(id).value;
+}
+
+std::string_view StringInterner::GetEscaped(Id id) const {
+    return EntryFor(id).escaped;
+}
+
+size_t StringInterner::Size() const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    return entries.size();
+}
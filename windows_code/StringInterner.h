@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * StringInterner - Append-only table mapping strings to small ids
+ *
+ * Each distinct string is stored once, together with its JSON-escaped form,
+ * so records can carry a 4-byte id instead of an owned std::string (copying
+ * them is a memcpy) and writers emit the pre-escaped bytes instead of
+ * running the escape loop for every document.
+ *
+ * Usage:
+ *   StringInterner::Id id = strings.Intern("Code");
+ *   const std::string& name = strings.Get(id);
+ *   writer.EscapedString(strings.GetEscaped(id));
+ *
+ * Entries are never removed, so the table is capped at MAX_ENTRIES; once full,
+ * new strings intern to EMPTY. Strings longer than MAX_STRING_BYTES are
+ * truncated. Thread-safe: lookups take a shared lock, and references returned
+ * by Get/GetEscaped stay valid for the table's lifetime.
+ */
+class StringInterner {
+public:
+    using Id = uint32_t;
+    static constexpr Id EMPTY = 0;                  // ""
+    static constexpr size_t MAX_ENTRIES = 64 * 1024;
+    static constexpr size_t MAX_STRING_BYTES = 1024;
+
+    StringInterner();
+
+    Id Intern(std::string_view value);
+
+    // Unknown ids read as ""
+    const std::string& Get(Id id) const;
+    std::string_view GetEscaped(Id id) const;       // JSON string contents, without quotes
+
+    size_t Size() const;
+
+private:
+    struct Entry {
+        std::string value;
+        std::string escaped;
+    };
+
+    const Entry& EntryFor(Id id) const;
+
+    mutable std::shared_mutex tableMutex;
+    std::deque<Entry> entries;                      // Stable addresses as the table grows
+    std::unordered_map<std::string_view, Id> ids;   // Views into entries
+    bool reportedFull = false;
+};
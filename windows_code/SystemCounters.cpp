@@ -0,0 +1,165 @@
+#include "SystemCounters.h"
+#include <algorithm>
+#include <cwchar>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#pragma comment(lib, "pdh.lib")
+
+static const double BYTES_PER_GB = 1024.0 * 1024.0 * 1024.0;
+
+SystemCounters& SystemCounters::Instance() {
+    static SystemCounters counters;
+    return counters;
+}
+
+SystemCounters::SystemCounters()
+    : query(nullptr)
+    , cpuTotal(nullptr)
+    , cpuCores(nullptr)
+    , memoryAvailable(nullptr)
+    , diskIdle(nullptr)
+    , gpuEngines(nullptr)
+    , opened(false)
+    , openFailed(false)
+    , totalMemoryBytes(0.0)
+{
+}
+
+SystemCounters::~SystemCounters() {
+    if (query) {
+        PdhCloseQuery(query);
+    }
+}
+
+bool SystemCounters::Open() {
+    if (PdhOpenQueryW(nullptr, 0, &query) != ERROR_SUCCESS) {
+        std::cerr << "[SystemCounters] PdhOpenQuery failed; system metrics unavailable" << std::endl;
+        query = nullptr;
+        return false;
+    }
+
+    // English counter paths work on every display language. A counter missing
+    // here (e.g. GPU Engine before WDDM 2.0) stays null and reads as unavailable
+    auto add = [this](const wchar_t* path, PDH_HCOUNTER& counter) {
+        if (PdhAddEnglishCounterW(query, path, 0, &counter) != ERROR_SUCCESS) {
+            counter = nullptr;
+            std::wcerr << L"[SystemCounters] Counter unavailable: " << path << std::endl;
+        }
+    };
+    add(L"\\Processor(_Total)\\% Processor Time", cpuTotal);
+    add(L"\\Processor(*)\\% Processor Time", cpuCores);
+    add(L"\\Memory\\Available Bytes", memoryAvailable);
+    add(L"\\PhysicalDisk(_Total)\\% Idle Time", diskIdle);
+    add(L"\\GPU Engine(*engtype_3D)\\Utilization Percentage", gpuEngines);
+
+    // Installed memory doesn't change: read it once
+    MEMORYSTATUSEX memInfo;
+    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+    if (GlobalMemoryStatusEx(&memInfo)) {
+        totalMemoryBytes = static_cast<double>(memInfo.ullTotalPhys);
+    }
+
+    // Rate counters need a first collection to have an interval to report on
+    PdhCollectQueryData(query);
+    return true;
+}
+
+SystemCounters::Sample SystemCounters::Get() {
+    std::lock_guard<std::mutex> lock(queryMutex);
+    if (!opened && !openFailed) {
+        opened = Open();
+        openFailed = !opened;
+    }
+    uint64_t now = GetTickCount64();
+    if (opened && now - last.collectedMs >= static_cast<uint64_t>(MIN_COLLECT_INTERVAL_MS)) {
+        Collect(now);
+    }
+    return last;
+}
+
+double SystemCounters::ReadValue(PDH_HCOUNTER counter) {
+    if (!counter) {
+        return -1.0;
+    }
+    PDH_FMT_COUNTERVALUE value;
+    if (PdhGetFormattedCounterValue(counter, PDH_FMT_DOUBLE | PDH_FMT_NOCAP100, nullptr, &value) != ERROR_SUCCESS ||
+        (value.CStatus != PDH_CSTATUS_VALID_DATA && value.CStatus != PDH_CSTATUS_NEW_DATA)) {
+        return -1.0;
+    }
+    return value.doubleValue;
+}
+
+const PDH_FMT_COUNTERVALUE_ITEM_W* SystemCounters::ReadArray(PDH_HCOUNTER counter, DWORD& count) {
+    count = 0;
+    if (!counter) {
+        return nullptr;
+    }
+    DWORD bytes = static_cast<DWORD>(arrayBuffer.size());
+    auto items = reinterpret_cast<PDH_FMT_COUNTERVALUE_ITEM_W*>(arrayBuffer.data());
+    PDH_STATUS status = PdhGetFormattedCounterArrayW(counter, PDH_FMT_DOUBLE | PDH_FMT_NOCAP100, &bytes, &count,
+                                                     bytes ? items : nullptr);
+    if (status == PDH_MORE_DATA) {
+        // The buffer is kept, so this only happens when instances appear
+        arrayBuffer.resize(bytes);
+        items = reinterpret_cast<PDH_FMT_COUNTERVALUE_ITEM_W*>(arrayBuffer.data());
+        status = PdhGetFormattedCounterArrayW(counter, PDH_FMT_DOUBLE | PDH_FMT_NOCAP100, &bytes, &count, items);
+    }
+    if (status != ERROR_SUCCESS) {
+        count = 0;
+        return nullptr;
+    }
+    return items;
+}
+
+void SystemCounters::Collect(uint64_t nowMs) {
+    Sample sample;
+    sample.collectedMs = nowMs;
+    if (PdhCollectQueryData(query) != ERROR_SUCCESS) {
+        last = std::move(sample);
+        return;
+    }
+
+    double cpu = ReadValue(cpuTotal);
+    sample.cpuPercent = cpu >= 0 ? (std::min)(cpu, 100.0) : -1.0;
+
+    DWORD count;
+    if (const PDH_FMT_COUNTERVALUE_ITEM_W* items = ReadArray(cpuCores, count)) {
+        // Instances are "0", "1", ... plus "_Total"; PDH's order isn't numeric
+        std::vector<std::pair<long, double>> cores;
+        for (DWORD index = 0; index < count; ++index) {
+            if (std::wcscmp(items[index].szName, L"_Total") != 0) {
+                cores.emplace_back(std::wcstol(items[index].szName, nullptr, 10),
+                                   (std::min)(items[index].FmtValue.doubleValue, 100.0));
+            }
+        }
+        std::sort(cores.begin(), cores.end());
+        for (const auto& core : cores) {
+            sample.corePercent.push_back(core.second);
+        }
+    }
+
+    double available = ReadValue(memoryAvailable);
+    if (available >= 0 && totalMemoryBytes > 0) {
+        double used = (std::max)(totalMemoryBytes - available, 0.0);
+        sample.memoryPercent = used * 100.0 / totalMemoryBytes;
+        sample.memoryUsedGB = used / BYTES_PER_GB;
+        sample.totalMemoryGB = totalMemoryBytes / BYTES_PER_GB;
+    }
+
+    double idle = ReadValue(diskIdle);
+    if (idle >= 0) {
+        sample.diskBusyPercent = (std::max)(0.0, 100.0 - (std::min)(idle, 100.0));
+    }
+
+    if (const PDH_FMT_COUNTERVALUE_ITEM_W* items = ReadArray(gpuEngines, count)) {
+        double total = 0.0;
+        for (DWORD index = 0; index < count; ++index) {
+            total += items[index].FmtValue.doubleValue;
+        }
+        sample.gpuPercent = (std::min)(total, 100.0);
+    }
+
+    last = std::move(sample);
+}
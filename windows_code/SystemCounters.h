@@ -0,0 +1,71 @@
+#pragma once
+
+#include <windows.h>
+#include <pdh.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * SystemCounters - One PDH query for every system load metric
+ *
+ * CPU (total and per core), memory, disk and GPU engine counters live in a
+ * single PDH query, so one PdhCollectQueryData refreshes them all. Getters
+ * share the resulting sample: a caller within MIN_COLLECT_INTERVAL_MS of the
+ * last collection gets the cached values, so the CPU, memory and other
+ * probes of one sampler pass cost one collection between them.
+ *
+ * Usage:
+ *   SystemCounters::Sample sample = SystemCounters::Instance().Get();
+ *   if (sample.cpuPercent >= 0) { ... }
+ *
+ * Values are negative when unavailable: a counter that doesn't exist on this
+ * system (GPU engines need WDDM 2.0), or a rate counter's first collection,
+ * which has no interval yet. Thread-safe.
+ */
+class SystemCounters {
+public:
+    struct Sample {
+        double cpuPercent = -1.0;
+        std::vector<double> corePercent;        // Per logical processor, in processor order
+        double memoryPercent = -1.0;            // Physical memory in use
+        double memoryUsedGB = -1.0;
+        double totalMemoryGB = -1.0;
+        double diskBusyPercent = -1.0;          // All physical disks, 100 - % idle time
+        double gpuPercent = -1.0;               // 3D engines, summed over adapters' engines (capped at 100)
+        uint64_t collectedMs = 0;               // GetTickCount64 at collection
+    };
+
+    static constexpr int MIN_COLLECT_INTERVAL_MS = 500;
+
+    static SystemCounters& Instance();
+
+    SystemCounters(const SystemCounters&) = delete;
+    SystemCounters& operator=(const SystemCounters&) = delete;
+
+    // Latest sample, collected first if the cached one is older than MIN_COLLECT_INTERVAL_MS
+    Sample Get();
+
+private:
+    SystemCounters();
+    ~SystemCounters();
+
+    bool Open();
+    void Collect(uint64_t nowMs);
+    static double ReadValue(PDH_HCOUNTER counter);
+    // Instances of a wildcard counter, in arrayBuffer (valid until the next call)
+    const PDH_FMT_COUNTERVALUE_ITEM_W* ReadArray(PDH_HCOUNTER counter, DWORD& count);
+
+    std::mutex queryMutex;
+    PDH_HQUERY query;
+    PDH_HCOUNTER cpuTotal;
+    PDH_HCOUNTER cpuCores;
+    PDH_HCOUNTER memoryAvailable;
+    PDH_HCOUNTER diskIdle;
+    PDH_HCOUNTER gpuEngines;
+    bool opened;
+    bool openFailed;
+    double totalMemoryBytes;
+    std::vector<BYTE> arrayBuffer;
+    Sample last;
+};
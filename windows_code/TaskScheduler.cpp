@@ -0,0 +1,177 @@
+#include "TaskScheduler.h"
+#include "CpuBudget.h"
+#include "Log.h"
+#include "Trace.h"
+#include "Watchdog.h"
+#include <windows.h>
+#include <algorithm>
+#include <cstdio>
+
+// The worker the calling thread is, or -1 for any other thread
+static thread_local int currentWorker = -1;
+
+static const int PRIORITY_LEVELS[] = {
+    THREAD_PRIORITY_ABOVE_NORMAL, THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_BELOW_NORMAL
+};
+
+TaskScheduler& TaskScheduler::Instance() {
+    // Leaked like the other process-wide singletons: tasks may still run during exit
+    static TaskScheduler* scheduler = new TaskScheduler();
+    return *scheduler;
+}
+
+TaskScheduler::TaskScheduler() {
+    for (size_t priority = 0; priority < PRIORITIES; ++priority) {
+        submitted[priority].store(0, std::memory_order_relaxed);
+        stolen[priority].store(0, std::memory_order_relaxed);
+        pending[priority].store(0, std::memory_order_relaxed);
+    }
+    int count = (std::max)(1, CpuBudget::Instance().Get(CpuBudget::Subsystem::Tasks).threads);
+    for (int index = 0; index < count; ++index) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Only once every deque exists: workers steal from each other right away
+    for (size_t index = 0; index < workers.size(); ++index) {
+        workers[index]->thread = std::thread(&TaskScheduler::WorkerThread, this, index);
+    }
+    LOG_DEBUG("Tasks", "Started " << workers.size() << " task workers");
+}
+
+const char* TaskScheduler::Name(Priority priority) {
+    switch (priority) {
+        case Priority::Realtime:    return "realtime";
+        case Priority::Interactive: return "interactive";
+        case Priority::Background:  return "background";
+        default:                    return "unknown";
+    }
+}
+
+void TaskScheduler::Submit(Priority priority, const char* name, Task task) {
+    size_t level = static_cast<size_t>(priority);
+    Entry entry{name, std::move(task)};
+    // Counted before the push, so a taker never decrements below zero
+    submitted[level].fetch_add(1, std::memory_order_relaxed);
+    pending[level].fetch_add(1, std::memory_order_relaxed);
+    queued.fetch_add(1, std::memory_order_seq_cst);
+    if (currentWorker >= 0) {
+        Worker& worker = *workers[currentWorker];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queues[level].push_back(std::move(entry));
+    } else {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        injection[level].push_back(std::move(entry));
+    }
+    Wake();
+}
+
+void TaskScheduler::Wake() {
+    if (sleepers.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    // Through the mutex, so a worker between its check and its wait can't miss it
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    sleepCv.notify_one();
+}
+
+bool TaskScheduler::Take(size_t index, Entry& entry, Priority& priority) {
+    Worker& self = *workers[index];
+    for (size_t level = 0; level < PRIORITIES; ++level) {
+        if (pending[level].load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            if (!self.queues[level].empty()) {
+                entry = std::move(self.queues[level].back());
+                self.queues[level].pop_back();
+                found = true;
+            }
+        }
+        if (!found) {
+            std::lock_guard<std::mutex> lock(injectionMutex);
+            if (!injection[level].empty()) {
+                entry = std::move(injection[level].front());
+                injection[level].pop_front();
+                found = true;
+            }
+        }
+        // Steal the oldest task of the next workers in turn, so thieves spread out
+        for (size_t offset = 1; !found && offset < workers.size(); ++offset) {
+            Worker& victim = *workers[(index + offset) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.queues[level].empty()) {
+                entry = std::move(victim.queues[level].front());
+                victim.queues[level].pop_front();
+                stolen[level].fetch_add(1, std::memory_order_relaxed);
+                found = true;
+            }
+        }
+        if (found) {
+            pending[level].fetch_sub(1, std::memory_order_relaxed);
+            queued.fetch_sub(1, std::memory_order_seq_cst);
+            priority = static_cast<Priority>(level);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::WorkerThread(size_t index) {
+    TRACE_THREAD("Task worker");
+    currentWorker = static_cast<int>(index);
+    CpuBudget::Instance().ApplyToCurrentThread(CpuBudget::Subsystem::Tasks);
+    Watchdog::Heartbeat heartbeat("task_worker", "tasks", TASK_STALL_MS);
+    int threadPriority = CpuBudget::Instance().Get(CpuBudget::Subsystem::Tasks).priority;
+
+    Entry entry;
+    Priority priority;
+    for (;;) {
+        if (Take(index, entry, priority)) {
+            heartbeat.Beat(entry.name);
+            int wanted = PRIORITY_LEVELS[static_cast<size_t>(priority)];
+            if (wanted != threadPriority && SetThreadPriority(GetCurrentThread(), wanted)) {
+                threadPriority = wanted;
+            }
+            entry.task();
+            entry.task = nullptr;       // Captures are released before the worker sleeps
+            continue;
+        }
+
+        heartbeat.Idle();
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        sleepCv.wait(lock, [this]() { return queued.load(std::memory_order_seq_cst) > 0; });
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+std::string TaskScheduler::FormatPrometheus() const {
+    std::string out;
+    out.reserve(1024);
+    char line[160];
+    std::string submittedText = "# HELP perception_tasks_submitted_total Tasks submitted to the shared scheduler\n"
+                                "# TYPE perception_tasks_submitted_total counter\n";
+    std::string stolenText = "# HELP perception_tasks_stolen_total Tasks a worker took from another worker's deque\n"
+                             "# TYPE perception_tasks_stolen_total counter\n";
+    std::string queuedText = "# HELP perception_tasks_queued Tasks waiting for a worker\n"
+                             "# TYPE perception_tasks_queued gauge\n";
+    for (size_t level = 0; level < PRIORITIES; ++level) {
+        const char* name = Name(static_cast<Priority>(level));
+        std::snprintf(line, sizeof(line), "perception_tasks_submitted_total{priority=\"%s\"} %llu\n", name,
+                      static_cast<unsigned long long>(submitted[level].load(std::memory_order_relaxed)));
+        submittedText += line;
+        std::snprintf(line, sizeof(line), "perception_tasks_stolen_total{priority=\"%s\"} %llu\n", name,
+                      static_cast<unsigned long long>(stolen[level].load(std::memory_order_relaxed)));
+        stolenText += line;
+        std::snprintf(line, sizeof(line), "perception_tasks_queued{priority=\"%s\"} %zu\n", name,
+                      pending[level].load(std::memory_order_relaxed));
+        queuedText += line;
+    }
+    std::snprintf(line, sizeof(line),
+                  "# HELP perception_task_workers Threads in the shared task pool\n"
+                  "# TYPE perception_task_workers gauge\n"
+                  "perception_task_workers %zu\n", workers.size());
+    out += line;
+    return out + submittedText + stolenText + queuedText;
+}
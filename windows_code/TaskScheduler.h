@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * TaskScheduler - One work-stealing pool for short engine tasks
+ *
+ * Every subsystem used to start its own threads for work that is neither
+ * device I/O nor long-running inference: a dispatch thread per event bus
+ * subscriber, each mostly asleep, all competing for the same cores
+ * without anyone seeing the total. Such work is now submitted here as
+ * tasks, and CpuBudget sizes the pool (Subsystem::Tasks) like every other
+ * thread group. Threads that block on devices (WASAPI, camera, pipes) or
+ * own a model for seconds at a time (whisper workers, the caption
+ * pipeline) stay dedicated.
+ *
+ * Scheduling:
+ *   Each worker keeps a deque per priority. A task submitted from a worker
+ *   goes to the back of that worker's deque and is popped LIFO (its data is
+ *   still in cache); one from any other thread goes to a shared injection
+ *   queue. An idle worker takes, highest priority first: its own deque,
+ *   the injection queue, then the front of another worker's deque (steal).
+ *
+ *   Realtime     runs at above-normal thread priority (audio-path follow-ups)
+ *   Interactive  normal priority (context updates, request work)
+ *   Background   below-normal priority (housekeeping, optional inference)
+ *   A worker only changes its thread priority when the class of the next
+ *   task differs from the last one.
+ *
+ * Tasks must not block for long: a blocked task holds a worker. Workers
+ * carry watchdog heartbeats, so one that doesn't return is reported as a
+ * stall of "task_worker" with the task's name as the activity.
+ *
+ * Usage:
+ *   TaskScheduler::Instance().Submit(TaskScheduler::Priority::Interactive, "bus:context",
+ *                                    [=]() { Drain(subscriber); });
+ *
+ * Task names must be string literals (the watchdog keeps the pointer). The
+ * pool is created on first use and lives until the process exits.
+ */
+class TaskScheduler {
+public:
+    enum class Priority { Realtime, Interactive, Background, Count };
+
+    using Task = std::function<void()>;
+
+    static TaskScheduler& Instance();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * @brief Queue a task; never blocks on other tasks
+     */
+    void Submit(Priority priority, const char* name, Task task);
+
+    size_t GetWorkerCount() const { return workers.size(); }
+
+    // Prometheus text: per-priority submitted, stolen and queued counts
+    std::string FormatPrometheus() const;
+
+    static const char* Name(Priority priority);
+
+private:
+    static constexpr size_t PRIORITIES = static_cast<size_t>(Priority::Count);
+    static constexpr int TASK_STALL_MS = 30000;
+
+    struct Entry {
+        const char* name = nullptr;
+        Task task;
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Entry> queues[PRIORITIES];
+        std::thread thread;
+    };
+
+    TaskScheduler();
+
+    void WorkerThread(size_t index);
+    // One task for worker `index`, highest priority first; false when there is none
+    bool Take(size_t index, Entry& entry, Priority& priority);
+    void Wake();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex injectionMutex;
+    std::deque<Entry> injection[PRIORITIES];
+
+    // Tasks queued anywhere; sleeping workers wait for it to leave zero
+    std::atomic<size_t> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    std::atomic<int> sleepers{0};
+
+    std::atomic<uint64_t> submitted[PRIORITIES];
+    std::atomic<uint64_t> stolen[PRIORITIES];
+    std::atomic<size_t> pending[PRIORITIES];
+};
@@ -0,0 +1,128 @@
+#include "ThreadCpu.h"
+#include <cstdio>
+#include "Log.h"
+
+static const int GROUP_COUNT = static_cast<int>(ThreadCpu::Group::Count);
+static const double AUDIO_SAMPLE_RATE = 16000.0;
+
+ThreadCpu& ThreadCpu::Instance() {
+    static ThreadCpu instance;
+    return instance;
+}
+
+ThreadCpu::Scope::Scope(Group group) : threadId(GetCurrentThreadId()) {
+    ThreadCpu::Instance().Register(threadId, group);
+}
+
+ThreadCpu::Scope::~Scope() {
+    ThreadCpu::Instance().Unregister(threadId);
+}
+
+const char* ThreadCpu::GroupName(Group group) {
+    switch (group) {
+        case Group::Capture: return "capture";
+        case Group::Processing: return "processing";
+        case Group::Whisper: return "whisper";
+        case Group::Camera: return "camera";
+        case Group::Screen: return "screen";
+        case Group::Http: return "http";
+        case Group::Context: return "context";
+        default: return "unknown";
+    }
+}
+
+void ThreadCpu::Register(DWORD threadId, Group group) {
+    HANDLE handle = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, threadId);
+    if (!handle) {
+        LOG_WARNING("ThreadCpu", "OpenThread failed (" << GetLastError() << "); " << GroupName(group)
+                    << " thread not counted");
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    threads[threadId] = Thread{ handle, group };
+}
+
+void ThreadCpu::Unregister(DWORD threadId) {
+    // Still on the thread: its final count is read before the handle goes
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = threads.find(threadId);
+    if (it == threads.end()) {
+        return;
+    }
+    exitedCycles[static_cast<int>(it->second.group)] += cycles;
+    CloseHandle(it->second.handle);
+    threads.erase(it);
+}
+
+uint64_t ThreadCpu::GetCycles(Group group) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t total = exitedCycles[static_cast<int>(group)];
+    for (const auto& thread : threads) {
+        ULONG64 cycles = 0;
+        if (thread.second.group == group && QueryThreadCycleTime(thread.second.handle, &cycles)) {
+            total += cycles;
+        }
+    }
+    return total;
+}
+
+double ThreadCpu::CyclesPerSecond() {
+    ULONG64 cycles = 0;
+    FILETIME creation, exit, kernel, user;
+    if (!QueryProcessCycleTime(GetCurrentProcess(), &cycles) ||
+        !GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0.0;
+    }
+    auto ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    uint64_t time100ns = ticks(kernel) + ticks(user);
+    return time100ns > 0 ? static_cast<double>(cycles) * 1e7 / static_cast<double>(time100ns) : 0.0;
+}
+
+std::string ThreadCpu::FormatPrometheus() const {
+    uint64_t cycles[GROUP_COUNT];
+    for (int group = 0; group < GROUP_COUNT; group++) {
+        cycles[group] = GetCycles(static_cast<Group>(group));
+    }
+    double cyclesPerSecond = CyclesPerSecond();
+
+    std::string out;
+    char line[192];
+    for (int group = 0; group < GROUP_COUNT; group++) {
+        const char* name = GroupName(static_cast<Group>(group));
+        std::snprintf(line, sizeof(line), "perception_thread_cpu_cycles_total{group=\"%s\"} %llu\n", name,
+                      static_cast<unsigned long long>(cycles[group]));
+        out += line;
+        if (cyclesPerSecond > 0) {
+            std::snprintf(line, sizeof(line), "perception_thread_cpu_seconds_total{group=\"%s\"} %.3f\n", name,
+                          cycles[group] / cyclesPerSecond);
+            out += line;
+        }
+    }
+
+    double audioSeconds = audioSamples.load(std::memory_order_relaxed) / AUDIO_SAMPLE_RATE;
+    uint64_t captionCount = captions.load(std::memory_order_relaxed);
+    std::snprintf(line, sizeof(line), "perception_audio_seconds_total %.1f\n", audioSeconds);
+    out += line;
+    std::snprintf(line, sizeof(line), "perception_captions_total %llu\n", static_cast<unsigned long long>(captionCount));
+    out += line;
+    if (cyclesPerSecond <= 0) {
+        return out;
+    }
+    if (audioSeconds > 0) {
+        uint64_t voice = cycles[static_cast<int>(Group::Capture)] + cycles[static_cast<int>(Group::Processing)] +
+                         cycles[static_cast<int>(Group::Whisper)];
+        std::snprintf(line, sizeof(line), "perception_engine_cpu_ms_per_audio_second %.2f\n",
+                      voice * 1000.0 / cyclesPerSecond / audioSeconds);
+        out += line;
+    }
+    if (captionCount > 0) {
+        std::snprintf(line, sizeof(line), "perception_engine_cpu_ms_per_caption %.2f\n",
+                      cycles[static_cast<int>(Group::Camera)] * 1000.0 / cyclesPerSecond / captionCount);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * ThreadCpu - What each part of the engine costs in CPU
+ *
+ * Engine threads register for their lifetime with a Scope naming their
+ * group; /metrics sums QueryThreadCycleTime over the live threads of each
+ * group plus what its exited threads used. Cycles are converted to CPU time
+ * with the process's own cycles-per-second (QueryProcessCycleTime over
+ * GetProcessTimes), which holds on hybrid and frequency-scaled CPUs where a
+ * nominal clock wouldn't.
+ *
+ * Work counters turn the totals into cost per feature: audio seconds (the
+ * microphone stream the processing thread consumed) and captions described.
+ * perception_engine_cpu_ms_per_audio_second covers capture, processing and
+ * whisper; perception_engine_cpu_ms_per_caption the camera group.
+ *
+ * Usage:
+ *   void Worker() {
+ *       ThreadCpu::Scope cpu(ThreadCpu::Group::Whisper);   // Counted until it returns
+ *       ...
+ *   }
+ *   ThreadCpu::Instance().AddCaptions(1);
+ *
+ * Registering and reading take a lock; the work counters are relaxed atomics
+ * cheap enough for the audio path.
+ */
+class ThreadCpu {
+public:
+    // Capture: audio endpoints and sources; Camera: frames, captioning and the
+    // ORT pool; Http: HTTP workers and the local IPC server; Context: the
+    // collector's sampler and writer and the publisher
+    enum class Group { Capture, Processing, Whisper, Camera, Screen, Http, Context, Count };
+
+    static ThreadCpu& Instance();
+
+    ThreadCpu(const ThreadCpu&) = delete;
+    ThreadCpu& operator=(const ThreadCpu&) = delete;
+
+    // Counts the calling thread in group until destroyed (on the same thread)
+    class Scope {
+    public:
+        explicit Scope(Group group);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        DWORD threadId;
+    };
+
+    void AddAudioSamples(uint64_t samples) { audioSamples.fetch_add(samples, std::memory_order_relaxed); }
+    void AddCaptions(uint64_t captions) { this->captions.fetch_add(captions, std::memory_order_relaxed); }
+
+    // Cycles used by a group's threads so far, exited ones included
+    uint64_t GetCycles(Group group) const;
+
+    /**
+     * @brief Prometheus text: cycles and CPU seconds per group, cost per audio second and per caption
+     */
+    std::string FormatPrometheus() const;
+
+    static const char* GroupName(Group group);
+
+private:
+    ThreadCpu() = default;
+
+    struct Thread {
+        HANDLE handle;
+        Group group;
+    };
+
+    void Register(DWORD threadId, Group group);
+    void Unregister(DWORD threadId);
+    static double CyclesPerSecond();
+
+    mutable std::mutex mutex;
+    std::map<DWORD, Thread> threads;
+    uint64_t exitedCycles[static_cast<int>(Group::Count)] = {};
+
+    std::atomic<uint64_t> audioSamples{0};      // 16 kHz
+    std::atomic<uint64_t> captions{0};
+};
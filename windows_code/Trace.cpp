@@ -0,0 +1,65 @@
+#include "Trace.h"
+
+#if defined(PERCEPTION_TRACE_ETW)
+
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+#include <cstdlib>
+#include <string>
+
+// Name-derived GUID (EventSource convention), so "*PerceptionEngine" also works
+TRACELOGGING_DEFINE_PROVIDER(
+    perceptionProvider,
+    "PerceptionEngine",
+    (0x7c772cd3, 0x180f, 0x51d7, 0xc1, 0x33, 0x68, 0xa0, 0xc8, 0x45, 0x78, 0x7c));
+
+// Registered on first use; events before a session starts cost one enabled check
+static void EnsureRegistered() {
+    static bool registered = [] {
+        TraceLoggingRegister(perceptionProvider);
+        std::atexit([] { TraceLoggingUnregister(perceptionProvider); });
+        return true;
+    }();
+    (void)registered;
+}
+
+namespace Trace {
+
+void ZoneBegin(const char* name) {
+    EnsureRegistered();
+    TraceLoggingWrite(perceptionProvider, "Zone",
+                      TraceLoggingOpcode(WINEVENT_OPCODE_START),
+                      TraceLoggingString(name, "Name"));
+}
+
+void ZoneEnd(const char* name) {
+    TraceLoggingWrite(perceptionProvider, "Zone",
+                      TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+                      TraceLoggingString(name, "Name"));
+}
+
+void Counter(const char* name, double value) {
+    EnsureRegistered();
+    TraceLoggingWrite(perceptionProvider, "Counter",
+                      TraceLoggingString(name, "Name"),
+                      TraceLoggingFloat64(value, "Value"));
+}
+
+void Frame(const char* name) {
+    EnsureRegistered();
+    TraceLoggingWrite(perceptionProvider, "Frame",
+                      TraceLoggingString(name, "Name"));
+}
+
+void ThreadName(const char* name) {
+    EnsureRegistered();
+    // WPA labels threads from their description
+    std::wstring wide(name, name + std::char_traits<char>::length(name));
+    SetThreadDescription(GetCurrentThread(), wide.c_str());
+    TraceLoggingWrite(perceptionProvider, "ThreadName",
+                      TraceLoggingString(name, "Name"));
+}
+
+}  // namespace Trace
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+ * Trace - Timeline instrumentation: scoped zones, counters, frame marks
+ *
+ * One set of macros over two optional backends, picked at build time with
+ * the PERCEPTION_TRACE CMake option:
+ *   OFF     (default) every macro expands to nothing
+ *   ETW     TraceLogging events from the "PerceptionEngine" provider
+ *           {7c772cd3-180f-51d7-c133-68a0c845787c}; zones are Start/Stop
+ *           event pairs, so WPA shows them as regions next to the CPU
+ *           Usage (Precise) context switches - lock waits and which thread
+ *           readied which. Record with the bundled profile:
+ *             wpr -start perception_trace.wprp -filemode
+ *             (reproduce)
+ *             wpr -stop trace.etl
+ *   TRACY   Tracy client zones/plots/frames (TRACY_DIR must point at a Tracy
+ *           checkout; connect the Tracy profiler to the running process)
+ *
+ * Usage:
+ *   void SileroVAD::Process(...) {
+ *       TRACE_ZONE("SileroVAD::Process");      // Until the end of the scope
+ *       ...
+ *   }
+ *   TRACE_COUNTER("AsyncQueue depth", queue.size());
+ *   TRACE_FRAME("Audio batch");                // Once per iteration of a loop
+ *   TRACE_THREAD("Audio processing");          // Names the calling thread
+ *
+ * Names must be string literals (both backends keep the pointer).
+ */
+
+#if defined(PERCEPTION_TRACE_TRACY)
+
+#include <tracy/Tracy.hpp>
+
+#define TRACE_ZONE(name) ZoneScopedN(name)
+#define TRACE_COUNTER(name, value) TracyPlot(name, static_cast<double>(value))
+#define TRACE_FRAME(name) FrameMarkNamed(name)
+#define TRACE_THREAD(name) tracy::SetThreadName(name)
+
+#elif defined(PERCEPTION_TRACE_ETW)
+
+namespace Trace {
+
+void ZoneBegin(const char* name);
+void ZoneEnd(const char* name);
+void Counter(const char* name, double value);
+void Frame(const char* name);
+void ThreadName(const char* name);
+
+class Zone {
+public:
+    explicit Zone(const char* name) : name(name) { ZoneBegin(name); }
+    ~Zone() { ZoneEnd(name); }
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* name;
+};
+
+}  // namespace Trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) Trace::Counter(name, static_cast<double>(value))
+#define TRACE_FRAME(name) Trace::Frame(name)
+#define TRACE_THREAD(name) Trace::ThreadName(name)
+
+#else
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_FRAME(name) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+
+#endif
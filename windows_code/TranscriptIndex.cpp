@@ -0,0 +1,917 @@
+#include "TranscriptIndex.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr uint32_t SEGMENT_MAGIC = 0x58544550;     // "PETX"
+constexpr uint32_t SEGMENT_VERSION = 1;
+constexpr size_t LOG_HEADER_BYTES = 16;
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t firstDoc;
+    uint32_t docCount;
+    uint32_t termCount;
+    uint32_t reserved;
+    int64_t minTimeMs;
+    int64_t maxTimeMs;
+    uint64_t termsOffset;
+    uint64_t postingsOffset;
+    uint64_t postingsBytes;
+};
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void PutVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// false on a truncated or over-long varint
+bool GetVarint(const uint8_t*& cursor, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && cursor < end; shift += 7) {
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+T Load(const uint8_t* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+bool WriteAt(HANDLE file, uint64_t offset, const void* data, size_t bytes) {
+    OVERLAPPED position = {};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD written = 0;
+    return WriteFile(file, data, static_cast<DWORD>(bytes), &written, &position) && written == bytes;
+}
+
+bool ReadAt(HANDLE file, uint64_t offset, void* data, size_t bytes) {
+    OVERLAPPED position = {};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD read = 0;
+    return ReadFile(file, data, static_cast<DWORD>(bytes), &read, &position) && read == bytes;
+}
+
+// Decoded posting list: docs ascending, each with its positions
+struct Decoded {
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> starts;           // Into positions; one more than docs
+    std::vector<uint32_t> positions;
+};
+
+bool Decode(const uint8_t* data, size_t size, uint32_t firstDoc, uint32_t docCount, Decoded& out) {
+    out.docs.clear();
+    out.starts.clear();
+    out.positions.clear();
+    out.docs.reserve(docCount);
+    out.starts.reserve(docCount + 1);
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + size;
+    uint32_t doc = firstDoc;
+    for (uint32_t i = 0; i < docCount; ++i) {
+        uint32_t delta, count;
+        if (!GetVarint(cursor, end, delta) || !GetVarint(cursor, end, count)) {
+            return false;
+        }
+        doc += delta;
+        out.docs.push_back(doc);
+        out.starts.push_back(static_cast<uint32_t>(out.positions.size()));
+        uint32_t position = 0;
+        for (uint32_t p = 0; p < count; ++p) {
+            uint32_t step;
+            if (!GetVarint(cursor, end, step)) {
+                return false;
+            }
+            position += step;
+            out.positions.push_back(position);
+        }
+    }
+    out.starts.push_back(static_cast<uint32_t>(out.positions.size()));
+    return true;
+}
+
+bool IsWordByte(unsigned char ch) {
+    return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch >= 0x80;
+}
+
+std::string SegmentName(uint32_t firstDoc, uint32_t docCount) {
+    return "seg_" + std::to_string(firstDoc) + "_" + std::to_string(docCount) + ".idx";
+}
+
+} // namespace
+
+// ============================================================================
+// Segments
+// ============================================================================
+
+class TranscriptIndex::MemorySegment : public TranscriptIndex::SearchableSegment {
+public:
+    struct Term {
+        std::string postings;
+        uint32_t docCount = 0;
+        uint32_t lastDoc = 0;
+    };
+
+    explicit MemorySegment(uint32_t firstDoc) : firstDoc(firstDoc), createdMs(NowMs()) {}
+
+    uint32_t FirstDoc() const override { return firstDoc; }
+    size_t DocCount() const override { return docs.size(); }
+    const DocEntry& Doc(size_t index) const override { return docs[index]; }
+    bool Find(std::string_view term, PostingList& list) const override {
+        auto it = terms.find(std::string(term));
+        if (it == terms.end()) {
+            return false;
+        }
+        list.data = reinterpret_cast<const uint8_t*>(it->second.postings.data());
+        list.size = it->second.postings.size();
+        list.docCount = it->second.docCount;
+        return true;
+    }
+    int64_t MinTimeMs() const override { return docs.empty() ? 0 : minTimeMs; }
+    int64_t MaxTimeMs() const override { return docs.empty() ? 0 : maxTimeMs; }
+
+    uint32_t firstDoc;
+    int64_t createdMs;
+    int64_t minTimeMs = (std::numeric_limits<int64_t>::max)();
+    int64_t maxTimeMs = (std::numeric_limits<int64_t>::min)();
+    std::vector<DocEntry> docs;
+    std::map<std::string, Term> terms;      // Sorted, as the dictionary is written
+};
+
+class TranscriptIndex::FileSegment : public TranscriptIndex::SearchableSegment {
+public:
+    struct Term {
+        std::string_view term;              // Into the mapping
+        uint32_t docCount;
+        uint32_t lastDoc;
+        uint64_t offset;
+        uint32_t bytes;
+    };
+
+    ~FileSegment() override {
+        file.Close();
+        if (obsolete.load()) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+    }
+
+    bool Open(const std::filesystem::path& filePath) {
+        path = filePath;
+        if (!file.Open(path.wstring()) || file.Size() < sizeof(SegmentHeader)) {
+            return false;
+        }
+        const uint8_t* data = static_cast<const uint8_t*>(file.Data());
+        const size_t size = file.Size();
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != SEGMENT_MAGIC || header.version != SEGMENT_VERSION ||
+            sizeof(header) + static_cast<uint64_t>(header.docCount) * sizeof(DocEntry) > header.termsOffset ||
+            header.termsOffset > header.postingsOffset || header.postingsOffset + header.postingsBytes > size) {
+            return false;
+        }
+        docs = reinterpret_cast<const DocEntry*>(data + sizeof(header));
+        postings = data + header.postingsOffset;
+
+        const uint8_t* cursor = data + header.termsOffset;
+        const uint8_t* end = data + header.postingsOffset;
+        terms.reserve(header.termCount);
+        for (uint32_t i = 0; i < header.termCount; ++i) {
+            if (cursor >= end || cursor + 1 + *cursor + 20 > end) {
+                return false;
+            }
+            Term term;
+            size_t length = *cursor++;
+            term.term = std::string_view(reinterpret_cast<const char*>(cursor), length);
+            cursor += length;
+            term.docCount = Load<uint32_t>(cursor);
+            term.lastDoc = Load<uint32_t>(cursor + 4);
+            term.offset = Load<uint64_t>(cursor + 8);
+            term.bytes = Load<uint32_t>(cursor + 16);
+            cursor += 20;
+            if (term.offset + term.bytes > header.postingsBytes) {
+                return false;
+            }
+            terms.push_back(term);
+        }
+        return true;
+    }
+
+    uint32_t FirstDoc() const override { return header.firstDoc; }
+    size_t DocCount() const override { return header.docCount; }
+    const DocEntry& Doc(size_t index) const override { return docs[index]; }
+    bool Find(std::string_view term, PostingList& list) const override {
+        auto it = std::lower_bound(terms.begin(), terms.end(), term,
+                                   [](const Term& a, std::string_view b) { return a.term < b; });
+        if (it == terms.end() || it->term != term) {
+            return false;
+        }
+        list.data = postings + it->offset;
+        list.size = it->bytes;
+        list.docCount = it->docCount;
+        return true;
+    }
+    int64_t MinTimeMs() const override { return header.minTimeMs; }
+    int64_t MaxTimeMs() const override { return header.maxTimeMs; }
+
+    std::filesystem::path path;
+    MappedFile file;
+    SegmentHeader header = {};
+    const DocEntry* docs = nullptr;
+    const uint8_t* postings = nullptr;
+    std::vector<Term> terms;
+    std::atomic<bool> obsolete{false};      // Replaced by a merge: delete with the last reader
+};
+
+// ============================================================================
+// Open / close
+// ============================================================================
+
+TranscriptIndex::TranscriptIndex(const std::string& directory)
+    : directory(directory)
+    , logFile(INVALID_HANDLE_VALUE)
+    , logEnd(0)
+    , nextDoc(0)
+    , running(false)
+    , flushRequested(false)
+{
+}
+
+TranscriptIndex::~TranscriptIndex() {
+    Close();
+}
+
+void TranscriptIndex::Tokenize(std::string_view text, std::vector<std::string>& terms) {
+    terms.clear();
+    std::string word;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        unsigned char ch = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+        // An apostrophe between letters stays in the word ("don't")
+        bool apostrophe = ch == '\'' && !word.empty() && i + 1 < text.size() &&
+                          IsWordByte(static_cast<unsigned char>(text[i + 1]));
+        if (IsWordByte(ch) || apostrophe) {
+            if (word.size() < MAX_TERM_BYTES) {
+                word += static_cast<char>(ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch);
+            }
+        } else if (!word.empty()) {
+            terms.push_back(word);
+            word.clear();
+        }
+    }
+}
+
+bool TranscriptIndex::Open() {
+    Close();
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        LOG_ERROR("TranscriptIndex", "Cannot create " << directory.u8string() << ": " << ec.message());
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!LoadSegments()) {
+        return false;
+    }
+    uint64_t indexedEnd = 0;
+    if (!segments.empty()) {
+        const FileSegment& last = *segments.back();
+        const DocEntry& doc = last.Doc(last.DocCount() - 1);
+        indexedEnd = doc.textOffset + doc.textBytes;
+    }
+
+    std::filesystem::path logPath = directory / "transcripts.log";
+    logFile = CreateFileW(logPath.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                          OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (logFile == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("TranscriptIndex", "Cannot open " << logPath.u8string() << " (error " << GetLastError() << ")");
+        return false;
+    }
+    memory = std::make_shared<MemorySegment>(nextDoc);
+    if (!RecoverLog(indexedEnd)) {
+        CloseHandle(logFile);
+        logFile = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> workerLock(workerMutex);
+        running = true;
+        flushRequested = false;
+    }
+    worker = std::thread(&TranscriptIndex::WorkerThread, this);
+    LOG_INFO("TranscriptIndex", "Transcript index " << directory.u8string() << ": " << nextDoc << " transcripts in "
+             << segments.size() << " segments (" << memory->DocCount() << " re-indexed from the log)");
+    return true;
+}
+
+bool TranscriptIndex::LoadSegments() {
+    // Every segment file, by first document, the widest first
+    struct Candidate {
+        uint32_t firstDoc;
+        uint32_t docCount;
+        std::filesystem::path path;
+    };
+    std::vector<Candidate> candidates;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        std::string name = entry.path().filename().u8string();
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            std::filesystem::remove(entry.path(), ec);      // An interrupted write
+            continue;
+        }
+        unsigned long first = 0, count = 0;
+        char tail[8] = {};
+        if (std::sscanf(name.c_str(), "seg_%lu_%lu%7s", &first, &count, tail) == 3 &&
+            std::strcmp(tail, ".idx") == 0 && count > 0) {
+            candidates.push_back({ static_cast<uint32_t>(first), static_cast<uint32_t>(count), entry.path() });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.firstDoc != b.firstDoc ? a.firstDoc < b.firstDoc : a.docCount > b.docCount;
+    });
+
+    // Chain them: a merge's output covers its inputs, which are left over
+    // only if it was interrupted before deleting them
+    uint32_t expected = 0;
+    for (const Candidate& candidate : candidates) {
+        // Past a gap the log is re-indexed instead, and written out again
+        if (candidate.firstDoc != expected) {
+            if (candidate.firstDoc > expected) {
+                LOG_WARNING("TranscriptIndex", "Gap before " << candidate.path.filename().u8string()
+                            << "; re-indexing the log past document " << expected);
+            }
+            std::filesystem::remove(candidate.path, ec);
+            continue;
+        }
+        auto segment = std::make_shared<FileSegment>();
+        if (!segment->Open(candidate.path) || segment->FirstDoc() != candidate.firstDoc ||
+            segment->DocCount() != candidate.docCount) {
+            LOG_WARNING("TranscriptIndex", "Unreadable segment " << candidate.path.filename().u8string()
+                        << "; re-indexing from the log");
+            segment.reset();
+            std::filesystem::remove(candidate.path, ec);
+            continue;
+        }
+        segments.push_back(segment);
+        expected += candidate.docCount;
+    }
+    nextDoc = expected;
+    return true;
+}
+
+bool TranscriptIndex::RecoverLog(uint64_t indexedEnd) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(logFile, &size)) {
+        return false;
+    }
+    const uint64_t fileBytes = static_cast<uint64_t>(size.QuadPart);
+    if (indexedEnd > fileBytes) {
+        LOG_WARNING("TranscriptIndex", "Log shorter than the index; older texts are unavailable");
+        indexedEnd = fileBytes;
+    }
+
+    // Records after the last segment: back into the memory segment
+    std::string tail(static_cast<size_t>(fileBytes - indexedEnd), '\0');
+    if (!tail.empty() && !ReadAt(logFile, indexedEnd, &tail[0], tail.size())) {
+        LOG_ERROR("TranscriptIndex", "Cannot read the log (error " << GetLastError() << ")");
+        return false;
+    }
+    size_t offset = 0;
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(tail.data());
+    while (offset + LOG_HEADER_BYTES <= tail.size()) {
+        uint32_t length = Load<uint32_t>(data + offset);
+        if (length > MAX_TEXT_BYTES || offset + LOG_HEADER_BYTES + length > tail.size()) {
+            break;
+        }
+        DocEntry doc = {};
+        doc.timeMs = Load<int64_t>(data + offset + 4);
+        doc.speaker = Load<int16_t>(data + offset + 12);
+        doc.flags = data[offset + 14];
+        doc.textOffset = indexedEnd + offset + LOG_HEADER_BYTES;
+        doc.textBytes = length;
+        IndexDocument(*memory, doc, std::string_view(tail.data() + offset + LOG_HEADER_BYTES, length));
+        nextDoc++;
+        offset += LOG_HEADER_BYTES + length;
+    }
+
+    // A torn record at the end is cut off so the next one follows the last intact one
+    logEnd = indexedEnd + offset;
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(logEnd);
+    if (logEnd != fileBytes && (!SetFilePointerEx(logFile, end, nullptr, FILE_BEGIN) || !SetEndOfFile(logFile))) {
+        LOG_WARNING("TranscriptIndex", "Cannot cut the torn end of the log (error " << GetLastError() << ")");
+    }
+    return true;
+}
+
+void TranscriptIndex::Close() {
+    {
+        std::lock_guard<std::mutex> workerLock(workerMutex);
+        running = false;
+    }
+    workerCv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    // Written out now, so the next start doesn't re-index it from the log
+    FlushMemory();
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    segments.clear();
+    memory.reset();
+    flushing.reset();
+    if (logFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(logFile);
+        logFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+uint64_t TranscriptIndex::GetDocumentCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return nextDoc;
+}
+
+size_t TranscriptIndex::GetSegmentCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return segments.size();
+}
+
+// ============================================================================
+// Adding
+// ============================================================================
+
+void TranscriptIndex::IndexDocument(MemorySegment& segment, const DocEntry& doc, std::string_view text) const {
+    const uint32_t id = segment.firstDoc + static_cast<uint32_t>(segment.docs.size());
+    segment.docs.push_back(doc);
+    segment.minTimeMs = (std::min)(segment.minTimeMs, doc.timeMs);
+    segment.maxTimeMs = (std::max)(segment.maxTimeMs, doc.timeMs);
+
+    // Positions per term, then one posting per term
+    std::vector<std::string> words;
+    Tokenize(text, words);
+    std::map<std::string_view, std::vector<uint32_t>> positions;
+    for (size_t i = 0; i < words.size(); ++i) {
+        positions[words[i]].push_back(static_cast<uint32_t>(i));
+    }
+    for (const auto& [word, at] : positions) {
+        MemorySegment::Term& term = segment.terms[std::string(word)];
+        PutVarint(term.postings, term.docCount == 0 ? id - segment.firstDoc : id - term.lastDoc);
+        PutVarint(term.postings, static_cast<uint32_t>(at.size()));
+        uint32_t previous = 0;
+        for (uint32_t position : at) {
+            PutVarint(term.postings, position - previous);
+            previous = position;
+        }
+        term.docCount++;
+        term.lastDoc = id;
+    }
+}
+
+bool TranscriptIndex::Add(int64_t timeMs, std::string_view text, int speaker, bool systemAudio) {
+    TRACE_ZONE("TranscriptIndex::Add");
+    if (text.size() > MAX_TEXT_BYTES) {
+        size_t cut = MAX_TEXT_BYTES;
+        while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) {
+            --cut;
+        }
+        text = text.substr(0, cut);
+    }
+
+    DocEntry doc = {};
+    doc.timeMs = timeMs;
+    doc.textBytes = static_cast<uint32_t>(text.size());
+    doc.speaker = static_cast<int16_t>((std::max)(-1, (std::min)(speaker, 32767)));
+    doc.flags = systemAudio ? 1 : 0;
+
+    std::string record(LOG_HEADER_BYTES, '\0');
+    std::memcpy(&record[0], &doc.textBytes, 4);
+    std::memcpy(&record[4], &doc.timeMs, 8);
+    std::memcpy(&record[12], &doc.speaker, 2);
+    record[14] = static_cast<char>(doc.flags);
+    record.append(text.data(), text.size());
+
+    bool flush = false;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (logFile == INVALID_HANDLE_VALUE || !memory) {
+            return false;
+        }
+        if (!WriteAt(logFile, logEnd, record.data(), record.size())) {
+            LOG_ERROR("TranscriptIndex", "Log write failed (error " << GetLastError() << ")");
+            return false;
+        }
+        doc.textOffset = logEnd + LOG_HEADER_BYTES;
+        logEnd += record.size();
+        IndexDocument(*memory, doc, text);
+        nextDoc++;
+        flush = memory->DocCount() >= FLUSH_DOCS;
+    }
+    if (flush) {
+        {
+            std::lock_guard<std::mutex> workerLock(workerMutex);
+            flushRequested = true;
+        }
+        workerCv.notify_one();
+    }
+    return true;
+}
+
+// ============================================================================
+// Flushing and merging (worker thread)
+// ============================================================================
+
+void TranscriptIndex::WorkerThread() {
+    std::unique_lock<std::mutex> workerLock(workerMutex);
+    while (running) {
+        workerCv.wait_for(workerLock, std::chrono::seconds(30), [this] { return !running || flushRequested; });
+        if (!running) {
+            break;
+        }
+        bool requested = flushRequested;
+        flushRequested = false;
+        workerLock.unlock();
+
+        bool due = requested;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            due = due || (memory && memory->DocCount() > 0 && NowMs() - memory->createdMs >= FLUSH_AGE_MS);
+        }
+        if (due) {
+            FlushMemory();
+            MaybeMerge();
+        }
+        workerLock.lock();
+    }
+}
+
+void TranscriptIndex::FlushMemory() {
+    std::shared_ptr<MemorySegment> full;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (!memory || memory->DocCount() == 0 || flushing) {
+            return;
+        }
+        // Still searched while it is written out
+        full = memory;
+        flushing = full;
+        memory = std::make_shared<MemorySegment>(nextDoc);
+    }
+
+    std::vector<TermOutput> terms;
+    terms.reserve(full->terms.size());
+    for (const auto& [word, term] : full->terms) {
+        terms.push_back({ word, term.docCount, term.lastDoc, term.postings });
+    }
+    std::shared_ptr<FileSegment> segment = WriteSegment(full->firstDoc, full->docs, terms);
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (segment) {
+        segments.push_back(segment);
+        flushing.reset();
+    } else {
+        // Put back in front of what came in meanwhile, to try again later
+        for (size_t i = 0; i < memory->DocCount(); ++i) {
+            full->docs.push_back(memory->docs[i]);
+        }
+        std::shared_ptr<MemorySegment> retry = std::make_shared<MemorySegment>(full->firstDoc);
+        std::string text;
+        for (const DocEntry& doc : full->docs) {
+            if (!ReadText(doc, text)) {
+                text.clear();
+            }
+            IndexDocument(*retry, doc, text);
+        }
+        retry->createdMs = full->createdMs;
+        memory = retry;
+        flushing.reset();
+    }
+}
+
+std::shared_ptr<TranscriptIndex::FileSegment> TranscriptIndex::WriteSegment(
+        uint32_t firstDoc, const std::vector<DocEntry>& docs, const std::vector<TermOutput>& terms) const {
+    SegmentHeader header = {};
+    header.magic = SEGMENT_MAGIC;
+    header.version = SEGMENT_VERSION;
+    header.firstDoc = firstDoc;
+    header.docCount = static_cast<uint32_t>(docs.size());
+    header.termCount = static_cast<uint32_t>(terms.size());
+    header.minTimeMs = (std::numeric_limits<int64_t>::max)();
+    header.maxTimeMs = (std::numeric_limits<int64_t>::min)();
+    for (const DocEntry& doc : docs) {
+        header.minTimeMs = (std::min)(header.minTimeMs, doc.timeMs);
+        header.maxTimeMs = (std::max)(header.maxTimeMs, doc.timeMs);
+    }
+
+    std::string dictionary;
+    uint64_t postingsBytes = 0;
+    for (const TermOutput& term : terms) {
+        dictionary += static_cast<char>(term.term.size());
+        dictionary += term.term;
+        char fields[20];
+        uint32_t bytes = static_cast<uint32_t>(term.postings.size());
+        std::memcpy(fields, &term.docCount, 4);
+        std::memcpy(fields + 4, &term.lastDoc, 4);
+        std::memcpy(fields + 8, &postingsBytes, 8);
+        std::memcpy(fields + 16, &bytes, 4);
+        dictionary.append(fields, sizeof(fields));
+        postingsBytes += bytes;
+    }
+    header.termsOffset = sizeof(header) + docs.size() * sizeof(DocEntry);
+    header.postingsOffset = header.termsOffset + dictionary.size();
+    header.postingsBytes = postingsBytes;
+
+    // Written under a temporary name and renamed: a segment file is whole or absent
+    std::filesystem::path path = directory / SegmentName(firstDoc, header.docCount);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(docs.data()), docs.size() * sizeof(DocEntry));
+        out.write(dictionary.data(), dictionary.size());
+        for (const TermOutput& term : terms) {
+            out.write(term.postings.data(), term.postings.size());
+        }
+        if (!out.flush()) {
+            LOG_ERROR("TranscriptIndex", "Cannot write " << temporary.u8string());
+            return nullptr;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        LOG_ERROR("TranscriptIndex", "Cannot rename " << temporary.u8string() << ": " << ec.message());
+        std::filesystem::remove(temporary, ec);
+        return nullptr;
+    }
+    auto segment = std::make_shared<FileSegment>();
+    if (!segment->Open(path)) {
+        LOG_ERROR("TranscriptIndex", "Cannot reopen " << path.u8string());
+        return nullptr;
+    }
+    return segment;
+}
+
+void TranscriptIndex::MaybeMerge() {
+    // Size tier: each is MERGE_FACTOR times the documents of the one below
+    auto tier = [](size_t docs) {
+        int level = 0;
+        for (size_t size = FLUSH_DOCS * MERGE_FACTOR; docs >= size; size *= MERGE_FACTOR) {
+            level++;
+        }
+        return level;
+    };
+    while (true) {
+        std::vector<std::shared_ptr<FileSegment>> run;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            if (segments.size() < MERGE_FACTOR) {
+                return;
+            }
+            const int level = tier(segments.back()->DocCount());
+            for (size_t i = segments.size() - MERGE_FACTOR; i < segments.size(); ++i) {
+                if (tier(segments[i]->DocCount()) != level) {
+                    return;
+                }
+                run.push_back(segments[i]);
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<FileSegment> merged = Merge(run);
+        if (!merged) {
+            return;
+        }
+        {
+            // Only the worker changes the segment list, so the run is still its tail
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            segments.resize(segments.size() - run.size());
+            segments.push_back(merged);
+        }
+        for (const auto& input : run) {
+            input->obsolete = true;
+        }
+        auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        LOG_DEBUG("TranscriptIndex", "Merged " << run.size() << " segments into "
+                  << merged->path.filename().u8string() << " (" << elapsedMs << " ms)");
+    }
+}
+
+std::shared_ptr<TranscriptIndex::FileSegment> TranscriptIndex::Merge(
+        const std::vector<std::shared_ptr<FileSegment>>& inputs) const {
+    TRACE_ZONE("TranscriptIndex::Merge");
+    const uint32_t firstDoc = inputs.front()->FirstDoc();
+    std::vector<DocEntry> docs;
+    for (const auto& input : inputs) {
+        docs.insert(docs.end(), input->docs, input->docs + input->DocCount());
+    }
+
+    // K-way merge of the sorted dictionaries; inputs are in document order, so
+    // each list appends whole, only its first doc delta rebased
+    std::vector<size_t> cursors(inputs.size(), 0);
+    std::vector<TermOutput> terms;
+    while (true) {
+        std::string_view smallest;
+        bool any = false;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (cursors[i] < inputs[i]->terms.size()) {
+                std::string_view term = inputs[i]->terms[cursors[i]].term;
+                if (!any || term < smallest) {
+                    smallest = term;
+                    any = true;
+                }
+            }
+        }
+        if (!any) {
+            break;
+        }
+        TermOutput output;
+        output.term = std::string(smallest);
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (cursors[i] >= inputs[i]->terms.size() || inputs[i]->terms[cursors[i]].term != smallest) {
+                continue;
+            }
+            const FileSegment::Term& term = inputs[i]->terms[cursors[i]++];
+            const uint8_t* cursor = inputs[i]->postings + term.offset;
+            const uint8_t* end = cursor + term.bytes;
+            uint32_t delta;
+            if (!GetVarint(cursor, end, delta)) {
+                LOG_ERROR("TranscriptIndex", "Corrupt postings in " << inputs[i]->path.filename().u8string());
+                return nullptr;
+            }
+            const uint32_t doc = inputs[i]->FirstDoc() + delta;
+            PutVarint(output.postings, output.docCount == 0 ? doc - firstDoc : doc - output.lastDoc);
+            output.postings.append(reinterpret_cast<const char*>(cursor), end - cursor);
+            output.docCount += term.docCount;
+            output.lastDoc = term.lastDoc;
+        }
+        terms.push_back(std::move(output));
+    }
+    return WriteSegment(firstDoc, docs, terms);
+}
+
+// ============================================================================
+// Searching
+// ============================================================================
+
+bool TranscriptIndex::ReadText(const DocEntry& doc, std::string& text) const {
+    text.resize(doc.textBytes);
+    return text.empty() || ReadAt(logFile, doc.textOffset, &text[0], text.size());
+}
+
+void TranscriptIndex::MatchSegment(const SearchableSegment& segment, const std::vector<std::string>& terms,
+                                   bool phrase, const Query& query,
+                                   std::vector<std::pair<uint32_t, DocEntry>>& matches) {
+    if (segment.DocCount() == 0 || segment.MaxTimeMs() < query.fromMs || segment.MinTimeMs() > query.toMs) {
+        return;
+    }
+    const uint32_t firstDoc = segment.FirstDoc();
+    auto accept = [&](uint32_t doc) {
+        const DocEntry& entry = segment.Doc(doc - firstDoc);
+        if (entry.timeMs >= query.fromMs && entry.timeMs <= query.toMs) {
+            matches.emplace_back(doc, entry);
+        }
+    };
+    if (terms.empty()) {
+        for (size_t i = 0; i < segment.DocCount(); ++i) {
+            accept(firstDoc + static_cast<uint32_t>(i));
+        }
+        return;
+    }
+
+    // Every term's list, or no match here at all
+    std::vector<PostingList> lists(terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (!segment.Find(terms[i], lists[i])) {
+            return;
+        }
+    }
+    std::vector<Decoded> decoded(terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (!Decode(lists[i].data, lists[i].size, firstDoc, lists[i].docCount, decoded[i])) {
+            return;
+        }
+    }
+
+    // Walk the rarest list, look the others up
+    size_t rarest = 0;
+    for (size_t i = 1; i < decoded.size(); ++i) {
+        if (decoded[i].docs.size() < decoded[rarest].docs.size()) {
+            rarest = i;
+        }
+    }
+    std::vector<size_t> at(terms.size());
+    for (uint32_t doc : decoded[rarest].docs) {
+        bool all = true;
+        for (size_t i = 0; i < decoded.size() && all; ++i) {
+            auto it = std::lower_bound(decoded[i].docs.begin(), decoded[i].docs.end(), doc);
+            all = it != decoded[i].docs.end() && *it == doc;
+            at[i] = it - decoded[i].docs.begin();
+        }
+        if (!all) {
+            continue;
+        }
+        if (phrase) {
+            // Some start p with term i at p + i for every i
+            bool found = false;
+            const Decoded& head = decoded[0];
+            for (uint32_t p = head.starts[at[0]]; p < head.starts[at[0] + 1] && !found; ++p) {
+                const uint32_t start = head.positions[p];
+                found = true;
+                for (size_t i = 1; i < decoded.size() && found; ++i) {
+                    auto first = decoded[i].positions.begin() + decoded[i].starts[at[i]];
+                    auto last = decoded[i].positions.begin() + decoded[i].starts[at[i] + 1];
+                    found = std::binary_search(first, last, start + static_cast<uint32_t>(i));
+                }
+            }
+            if (!found) {
+                continue;
+            }
+        }
+        accept(doc);
+    }
+}
+
+TranscriptIndex::Result TranscriptIndex::Search(const Query& query) const {
+    TRACE_ZONE("TranscriptIndex::Search");
+    Result result;
+    std::string_view text = query.text;
+    while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && text.back() == ' ') {
+        text.remove_suffix(1);
+    }
+    const bool phrase = text.size() >= 2 && text.front() == '"' && text.back() == '"';
+    std::vector<std::string> terms;
+    Tokenize(text, terms);
+    if (terms.size() > MAX_QUERY_TERMS) {
+        terms.resize(MAX_QUERY_TERMS);
+    }
+    if (!phrase) {
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    }
+
+    std::vector<std::pair<uint32_t, DocEntry>> matches;
+    std::vector<std::shared_ptr<FileSegment>> files;
+    {
+        // Memory segments change under Add: matched under the lock; files
+        // are immutable, matched after it (kept alive by the copies)
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        files = segments;
+        for (const auto& segment : { flushing, memory }) {
+            if (segment) {
+                MatchSegment(*segment, terms, phrase, query, matches);
+                result.segments++;
+            }
+        }
+    }
+    for (const auto& segment : files) {
+        MatchSegment(*segment, terms, phrase, query, matches);
+        result.segments++;
+    }
+
+    result.matches = matches.size();
+    const size_t limit = (std::min)(query.limit, MAX_RESULTS);
+    const size_t count = (std::min)(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + count, matches.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    for (size_t i = 0; i < count; ++i) {
+        const DocEntry& doc = matches[i].second;
+        Hit hit;
+        hit.timeMs = doc.timeMs;
+        hit.speaker = doc.speaker;
+        hit.systemAudio = (doc.flags & 1) != 0;
+        if (logFile != INVALID_HANDLE_VALUE && ReadText(doc, hit.text)) {
+            result.hits.push_back(std::move(hit));
+        }
+    }
+    return result;
+}
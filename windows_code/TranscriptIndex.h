@@ -0,0 +1,189 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * TranscriptIndex - Every transcript kept, searchable by words and phrases
+ *
+ * The context only holds the latest transcription and the journal rotates
+ * away after a few megabytes; this keeps all of them, with an inverted
+ * index for /transcripts?q=&from=&to=.
+ *
+ * Storage (<directory>/):
+ *   transcripts.log      [length u32][timeMs i64][speaker i16][flags u8][0][text],
+ *                        appended per transcript (the durable copy)
+ *   seg_<first>_<n>.idx  an immutable segment indexing documents
+ *                        first..first+n-1 (a document is a transcript, its id
+ *                        its position in the log): header, document table
+ *                        (time, log offset, speaker), sorted term dictionary,
+ *                        posting lists
+ *
+ * Postings: per term, per document [doc delta][position count][position
+ * deltas], all varints; the first doc delta is from the segment's first
+ * document. Terms are lower-cased ASCII words (bytes >= 0x80 are word
+ * characters, so UTF-8 words stay whole), at most MAX_TERM_BYTES.
+ *
+ * Writes: Add() appends to the log and to an in-memory segment, in the
+ * same format, searchable at once. A worker thread writes it out as a
+ * segment file once it holds FLUSH_DOCS documents or is FLUSH_AGE_MS old,
+ * then merges: whenever the newest MERGE_FACTOR segments are of one size
+ * tier they become one (posting lists concatenate, only the first delta of
+ * each is rebased), so a search touches O(log n) segments. A merged file
+ * replaces its inputs once renamed into place; an input still being
+ * searched is deleted when its last reader lets go.
+ *
+ * Open() takes the run of segments that covers the documents in order
+ * (leftovers of an interrupted merge are deleted) and re-indexes the log
+ * records after it, so nothing written before a crash is lost.
+ *
+ * Queries: words must all occur; a "quoted phrase" must occur in order,
+ * adjacent. Segments outside the time window are skipped without reading
+ * their postings. Results are newest first.
+ *
+ * Usage:
+ *   TranscriptIndex index("transcripts");
+ *   index.Open();
+ *   index.Add(nowMs, text, speaker, systemAudio);
+ *   TranscriptIndex::Query query;
+ *   query.text = "\"budget review\"";
+ *   TranscriptIndex::Result result = index.Search(query);
+ */
+class TranscriptIndex {
+public:
+    struct Query {
+        std::string text;                   // Words, or a "quoted phrase"; empty: everything in the window
+        int64_t fromMs = 0;
+        int64_t toMs = (std::numeric_limits<int64_t>::max)();
+        size_t limit = 20;
+    };
+
+    struct Hit {
+        int64_t timeMs;                     // Unix epoch milliseconds
+        int speaker;                        // SpeakerTracker id; -1 unknown
+        bool systemAudio;
+        std::string text;
+    };
+
+    struct Result {
+        std::vector<Hit> hits;              // Newest first, at most limit
+        size_t matches = 0;                 // All matching transcripts in the window
+        size_t segments = 0;                // Segments searched (memory included)
+    };
+
+    static constexpr size_t FLUSH_DOCS = 256;
+    static constexpr int64_t FLUSH_AGE_MS = 10 * 60 * 1000;
+    static constexpr size_t MERGE_FACTOR = 8;
+    static constexpr size_t MAX_TERM_BYTES = 32;
+    static constexpr size_t MAX_TEXT_BYTES = 16 * 1024;
+    static constexpr size_t MAX_QUERY_TERMS = 16;
+    static constexpr size_t MAX_RESULTS = 100;
+
+    explicit TranscriptIndex(const std::string& directory);
+    ~TranscriptIndex();
+
+    TranscriptIndex(const TranscriptIndex&) = delete;
+    TranscriptIndex& operator=(const TranscriptIndex&) = delete;
+
+    /**
+     * @brief Load the segments, re-index the log past them, start the worker
+     * @return false (and logs) if the directory or log can't be opened
+     */
+    bool Open();
+
+    // Write the in-memory segment out and stop the worker
+    void Close();
+
+    // Index one transcript (text truncated to MAX_TEXT_BYTES); false once closed
+    bool Add(int64_t timeMs, std::string_view text, int speaker, bool systemAudio);
+
+    Result Search(const Query& query) const;
+
+    uint64_t GetDocumentCount() const;
+    size_t GetSegmentCount() const;
+
+    // Lower-cased words of text in order, a word's position its index (query and index alike)
+    static void Tokenize(std::string_view text, std::vector<std::string>& terms);
+
+private:
+    struct DocEntry {                       // 24 bytes, as stored in a segment
+        int64_t timeMs;
+        uint64_t textOffset;                // Of the text in transcripts.log
+        uint32_t textBytes;
+        int16_t speaker;
+        uint8_t flags;                      // 1: system audio
+        uint8_t reserved;
+    };
+
+    struct PostingList {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        uint32_t docCount = 0;
+    };
+
+    // Either kind of segment, as the search sees it
+    class SearchableSegment {
+    public:
+        virtual ~SearchableSegment() = default;
+        virtual uint32_t FirstDoc() const = 0;
+        virtual size_t DocCount() const = 0;
+        virtual const DocEntry& Doc(size_t index) const = 0;
+        virtual bool Find(std::string_view term, PostingList& list) const = 0;
+        virtual int64_t MinTimeMs() const = 0;
+        virtual int64_t MaxTimeMs() const = 0;
+    };
+
+    class MemorySegment;
+    class FileSegment;
+
+    // A term as written out: dictionary fields and its encoded postings
+    struct TermOutput {
+        std::string term;
+        uint32_t docCount = 0;
+        uint32_t lastDoc = 0;
+        std::string postings;
+    };
+
+    bool LoadSegments();
+    bool RecoverLog(uint64_t indexedEnd);
+    void IndexDocument(MemorySegment& segment, const DocEntry& doc, std::string_view text) const;
+    std::shared_ptr<FileSegment> WriteSegment(uint32_t firstDoc, const std::vector<DocEntry>& docs,
+                                              const std::vector<TermOutput>& terms) const;
+    std::shared_ptr<FileSegment> Merge(const std::vector<std::shared_ptr<FileSegment>>& inputs) const;
+    void MaybeMerge();
+    void FlushMemory();
+    void WorkerThread();
+
+    static void MatchSegment(const SearchableSegment& segment, const std::vector<std::string>& terms, bool phrase,
+                             const Query& query, std::vector<std::pair<uint32_t, DocEntry>>& matches);
+    bool ReadText(const DocEntry& doc, std::string& text) const;
+
+    std::filesystem::path directory;
+    HANDLE logFile;
+    uint64_t logEnd;
+
+    mutable std::shared_mutex mutex;        // Everything below
+    std::vector<std::shared_ptr<FileSegment>> segments;     // In document order
+    std::shared_ptr<MemorySegment> memory;                  // Taking documents
+    std::shared_ptr<MemorySegment> flushing;                // Being written out (still searched)
+    uint32_t nextDoc;
+
+    std::mutex workerMutex;
+    std::condition_variable workerCv;
+    bool running;                           // Guarded by workerMutex
+    bool flushRequested;
+    std::thread worker;
+};
@@ -0,0 +1,229 @@
+#include "TurnDetector.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <string_view>
+
+namespace {
+
+const size_t FRAME_MS = 32;
+const float DECIMATED_RATE = 8000.0f;
+const float SILENT_MEAN_SQUARE = 1e-6f;     // -60 dBFS: too quiet to voice
+
+// Evidence weights (log-odds)
+const float FALL_EVIDENCE = 1.0f;
+const float RISE_EVIDENCE = -0.3f;
+const float LEVEL_EVIDENCE = -0.8f;
+const float CLEAN_OFFSET_EVIDENCE = 0.6f;
+const float HOVER_EVIDENCE = -0.8f;
+const float SENTENCE_END_EVIDENCE = 0.8f;      // Whisper often closes a window's text with one anyway
+const float TRAILING_EVIDENCE = -1.5f;
+const float CLAUSE_EVIDENCE = -0.8f;
+const float SHORT_EVIDENCE = 0.4f;
+
+// Words a complete English utterance rarely ends on
+const std::string_view TRAILING_WORDS[] = {
+    "and", "but", "or", "so", "because", "if", "then", "that", "which", "when", "while",
+    "the", "a", "an", "my", "your", "this", "to", "of", "with", "for", "in", "on", "at", "from",
+    "is", "was", "are", "um", "uh", "uhm", "er", "like"
+};
+
+}  // namespace
+
+TurnDetector::TurnDetector() : textSet(false) {
+    Reset();
+}
+
+void TurnDetector::Reset() {
+    if (textSet) {
+        previousText = text;
+    }
+    pitchWrite = 0;
+    pitchCount = 0;
+    speechFrames = 0;
+    pauseFrames = 0;
+    pauseScoreSum = 0.0f;
+    text.clear();
+    textSet = false;
+}
+
+void TurnDetector::AddFrame(const float* frame, float score, bool speech) {
+    if (!speech) {
+        pauseFrames++;
+        pauseScoreSum += score;
+        return;
+    }
+    speechFrames++;
+    pauseFrames = 0;
+    pauseScoreSum = 0.0f;
+    float pitch = EstimatePitch(frame);
+    if (pitch > 0.0f) {
+        semitones[pitchWrite] = 12.0f * std::log2(pitch);
+        pitchWrite = (pitchWrite + 1) % PITCH_FRAMES;
+        pitchCount = (std::min)(pitchCount + 1, PITCH_FRAMES);
+    }
+}
+
+void TurnDetector::SetText(const std::string& partial) {
+    if (partial.empty() || partial == previousText) {
+        return;
+    }
+    text = partial;
+    textSet = true;
+}
+
+float TurnDetector::EstimatePitch(const float* frame) {
+    // 2:1 decimation (pair average) halves the lags to search; 4 kHz is plenty for F0
+    const size_t count = FRAME_SAMPLES / 2;
+    float energy = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        decimated[i] = 0.5f * (frame[2 * i] + frame[2 * i + 1]);
+        energy += decimated[i] * decimated[i];
+    }
+    if (energy < SILENT_MEAN_SQUARE * count) {
+        return 0.0f;
+    }
+
+    const size_t minLag = static_cast<size_t>(DECIMATED_RATE / PITCH_MAX_HZ);
+    const size_t maxLag = static_cast<size_t>(DECIMATED_RATE / PITCH_MIN_HZ);
+    float best = 0.0f;
+    size_t bestLag = 0;
+    for (size_t lag = minLag; lag <= maxLag && lag < count; ++lag) {
+        float cross = 0.0f;
+        float head = 0.0f;
+        float tail = 0.0f;
+        for (size_t i = 0; i + lag < count; ++i) {
+            cross += decimated[i] * decimated[i + lag];
+            head += decimated[i] * decimated[i];
+            tail += decimated[i + lag] * decimated[i + lag];
+        }
+        float denominator = std::sqrt(head * tail);
+        float normalized = denominator > 0.0f ? cross / denominator : 0.0f;
+        if (normalized > best) {
+            best = normalized;
+            bestLag = lag;
+        }
+    }
+    return best >= VOICING ? DECIMATED_RATE / static_cast<float>(bestLag) : 0.0f;
+}
+
+float TurnDetector::PitchEvidence() const {
+    if (pitchCount < 4) {
+        return 0.0f;
+    }
+    // Least-squares slope over the contour, oldest first
+    float sumX = 0.0f;
+    float sumY = 0.0f;
+    float sumXY = 0.0f;
+    float sumXX = 0.0f;
+    float low = 1e9f;
+    float high = -1e9f;
+    const size_t first = (pitchWrite + PITCH_FRAMES - pitchCount) % PITCH_FRAMES;
+    for (size_t i = 0; i < pitchCount; ++i) {
+        float x = static_cast<float>(i);
+        float y = semitones[(first + i) % PITCH_FRAMES];
+        sumX += x;
+        sumY += y;
+        sumXY += x * y;
+        sumXX += x * x;
+        low = (std::min)(low, y);
+        high = (std::max)(high, y);
+    }
+    const float n = static_cast<float>(pitchCount);
+    const float slope = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+    const float change = slope * (n - 1.0f);
+    if (change <= -CONTOUR_SEMITONES) {
+        return FALL_EVIDENCE;
+    }
+    if (change >= CONTOUR_SEMITONES) {
+        return RISE_EVIDENCE;
+    }
+    if (pitchCount == PITCH_FRAMES && high - low <= LEVEL_SEMITONES) {
+        return LEVEL_EVIDENCE;
+    }
+    return 0.0f;
+}
+
+float TurnDetector::PauseEvidence() const {
+    if (pauseFrames == 0) {
+        return 0.0f;
+    }
+    float mean = pauseScoreSum / static_cast<float>(pauseFrames);
+    if (mean <= CLEAN_OFFSET_SCORE) {
+        return CLEAN_OFFSET_EVIDENCE;
+    }
+    return mean >= HOVER_SCORE ? HOVER_EVIDENCE : 0.0f;
+}
+
+float TurnDetector::TextEvidence() const {
+    size_t end = text.find_last_not_of(" \t\n\r");
+    if (end == std::string::npos) {
+        return 0.0f;
+    }
+    std::string_view trimmed(text.data(), end + 1);
+    const char last = trimmed.back();
+    if (trimmed.size() >= 3 && trimmed.compare(trimmed.size() - 3, 3, "...") == 0) {
+        return TRAILING_EVIDENCE;       // Trailing off
+    }
+
+    // The last word, lower-cased, without its punctuation
+    size_t wordEnd = trimmed.size();
+    while (wordEnd > 0 && std::ispunct(static_cast<unsigned char>(trimmed[wordEnd - 1]))) {
+        wordEnd--;
+    }
+    size_t wordStart = wordEnd;
+    while (wordStart > 0 && std::isalpha(static_cast<unsigned char>(trimmed[wordStart - 1]))) {
+        wordStart--;
+    }
+    char word[16];
+    size_t length = (std::min)(wordEnd - wordStart, sizeof(word));
+    for (size_t i = 0; i < length; ++i) {
+        word[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(trimmed[wordStart + i])));
+    }
+    std::string_view lastWord(word, length);
+    for (std::string_view trailing : TRAILING_WORDS) {
+        if (lastWord == trailing) {
+            return TRAILING_EVIDENCE;
+        }
+    }
+
+    if (last == '.' || last == '?' || last == '!') {
+        return SENTENCE_END_EVIDENCE;
+    }
+    if (last == ',' || last == '-' || last == ';' || last == ':') {
+        return CLAUSE_EVIDENCE;
+    }
+    return 0.0f;
+}
+
+float TurnDetector::Confidence() const {
+    float logOdds = PitchEvidence() + PauseEvidence() + TextEvidence();
+    if (speechFrames > 0 && speechFrames * FRAME_MS <= static_cast<size_t>(SHORT_UTTERANCE_MS)) {
+        logOdds += SHORT_EVIDENCE;
+    }
+    return 1.0f / (1.0f + std::exp(-logOdds));
+}
+
+int TurnDetector::HangoverMs(int minMs, int neutralMs, int maxMs) const {
+    minMs = (std::min)(minMs, neutralMs);
+    maxMs = (std::max)(maxMs, neutralMs);
+    float confidence = Confidence();
+    if (confidence >= 0.5f) {
+        return neutralMs - static_cast<int>((neutralMs - minMs) * (confidence - 0.5f) * 2.0f);
+    }
+    return neutralMs + static_cast<int>((maxMs - neutralMs) * (0.5f - confidence) * 2.0f);
+}
+
+void TurnDetector::NoteClosed(int hangoverMs, int neutralMs) {
+    if (hangoverMs < neutralMs) {
+        stats.closedEarly++;
+    } else if (hangoverMs > neutralMs) {
+        stats.closedLate++;
+    }
+}
+
+void TurnDetector::NoteResumed(int silenceMs, int neutralMs) {
+    if (silenceMs >= neutralMs) {
+        stats.bridged++;
+    }
+}
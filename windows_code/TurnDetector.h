@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * TurnDetector - How long a pause has to last before the utterance is over
+ *
+ * The segmenter used to close an utterance after a fixed silenceThresholdMs
+ * of VAD silence: long enough to hold "turn on the lights" back for 300 ms,
+ * and short enough to cut "I was thinking that... maybe" in two whisper jobs.
+ * The detector looks at the utterance while it is open and at the pause as
+ * it goes on, and turns that into a confidence that the speaker is done:
+ *
+ *   pitch       F0 of the last voiced frames (normalized autocorrelation of
+ *               the 8 kHz-decimated frame): a final fall is the end of a
+ *               statement, a level hold is a filled pause ("uhh"), a rise
+ *               usually a list or clause going on
+ *   offset      the VAD probability in the pause: a clean drop to nothing
+ *               after speech ends a turn, scores hovering under the off
+ *               threshold (breath, murmur, trailing syllables) don't
+ *   text        the streaming partial (microphone): sentence punctuation
+ *               ends a turn, a trailing comma, conjunction, article or
+ *               filler ("and", "the", "um") says more is coming
+ *   length      short utterances are mostly commands, complete as spoken
+ *
+ * The cues add up as log-odds; no evidence is 0.5. The caller maps the
+ * confidence onto its hangover (HangoverMs): 0.5 keeps silenceThresholdMs,
+ * certainty shortens it to the minimum, doubt lengthens it to the maximum.
+ *
+ * Usage (processing thread only; not thread-safe):
+ *   TurnDetector turn;
+ *   turn.Reset();                                   // Utterance starts
+ *   turn.AddFrame(frame, score, isSpeech);          // Every frame while open
+ *   turn.SetText(partial);                          // Latest hypothesis, if any
+ *   if (silenceMs >= turn.HangoverMs(120, 300, 900)) { ...close... }
+ */
+class TurnDetector {
+public:
+    static constexpr size_t FRAME_SAMPLES = 512;            // 32 ms, one VAD frame
+    static constexpr int PITCH_MIN_HZ = 70;
+    static constexpr int PITCH_MAX_HZ = 400;
+    static constexpr float VOICING = 0.5f;                  // Normalized autocorrelation of a voiced frame
+    static constexpr size_t PITCH_FRAMES = 12;              // Voiced frames the contour covers (~0.4 s)
+    static constexpr float CONTOUR_SEMITONES = 2.0f;        // Fall (or rise) that counts
+    static constexpr float LEVEL_SEMITONES = 0.75f;         // Spread of a held pitch
+    static constexpr float CLEAN_OFFSET_SCORE = 0.1f;       // Mean pause score of a clean stop
+    static constexpr float HOVER_SCORE = 0.2f;              // ... and of a pause that isn't one
+    static constexpr int SHORT_UTTERANCE_MS = 1200;
+
+    struct Stats {
+        uint64_t closedEarly = 0;       // Turns closed before silenceThresholdMs
+        uint64_t closedLate = 0;        // Turns held open past it, then closed
+        uint64_t bridged = 0;           // Pauses past silenceThresholdMs the utterance survived
+    };
+
+    TurnDetector();
+
+    // A new utterance: contour, pause and text start over
+    void Reset();
+
+    // Every frame of the open utterance, in order; score is the VAD probability
+    void AddFrame(const float* frame, float score, bool speech);
+
+    // The newest partial hypothesis of the utterance (microphone)
+    void SetText(const std::string& partial);
+
+    // Confidence that the utterance is complete if the current pause lasts: 0..1
+    float Confidence() const;
+
+    // Silence that ends the utterance: neutralMs at 0.5, towards minMs (at most
+    // neutralMs) as confidence rises, towards maxMs (at least neutralMs) as it falls
+    int HangoverMs(int minMs, int neutralMs, int maxMs) const;
+
+    // Outcomes, for the stats: the utterance closed after hangoverMs (of a
+    // neutralMs default), or speech resumed after silenceMs of pause
+    void NoteClosed(int hangoverMs, int neutralMs);
+    void NoteResumed(int silenceMs, int neutralMs);
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    // F0 in Hz of a voiced frame, 0 for an unvoiced one
+    float EstimatePitch(const float* frame);
+    // Log-odds of the pitch contour, the pause and the text
+    float PitchEvidence() const;
+    float PauseEvidence() const;
+    float TextEvidence() const;
+
+    float decimated[FRAME_SAMPLES / 2];
+    float semitones[PITCH_FRAMES];      // Ring of the last voiced frames' pitch (semitones re 1 Hz)
+    size_t pitchWrite;
+    size_t pitchCount;
+
+    size_t speechFrames;
+    size_t pauseFrames;                 // Since the last speech frame
+    float pauseScoreSum;
+
+    std::string text;
+    std::string previousText;           // The last utterance's: a stale partial is not this one's
+    bool textSet;
+
+    Stats stats;
+};
@@ -0,0 +1,173 @@
+#include "UtteranceTracer.h"
+#include "Experiments.h"
+#include "JsonWriter.h"
+#include "PipelineLatency.h"
+
+namespace {
+
+struct Span {
+    const char* name;
+    UtteranceTracer::Point from;
+    UtteranceTracer::Point to;
+};
+
+const Span SPANS[] = {
+    { "speech", UtteranceTracer::Point::SpeechStart, UtteranceTracer::Point::SpeechEnd },
+    { "silenceHold", UtteranceTracer::Point::SpeechEnd, UtteranceTracer::Point::Finalized },
+    { "enqueue", UtteranceTracer::Point::Finalized, UtteranceTracer::Point::Enqueued },
+    { "queueWait", UtteranceTracer::Point::Enqueued, UtteranceTracer::Point::WhisperStart },
+    { "whisper", UtteranceTracer::Point::WhisperStart, UtteranceTracer::Point::WhisperEnd },
+    { "pickup", UtteranceTracer::Point::WhisperEnd, UtteranceTracer::Point::PickedUp },
+    { "contextUpdate", UtteranceTracer::Point::PickedUp, UtteranceTracer::Point::ContextUpdated },
+};
+
+const char* const OUTCOME_NAMES[] = { "delivered", "merged", "dropped", "empty" };
+
+int64_t PointUs(const UtteranceTracer::Trace& trace, UtteranceTracer::Point point) {
+    return trace.pointUs[static_cast<size_t>(point)];
+}
+
+// Milliseconds between two marks; negative when either is missing
+double SpanMs(const UtteranceTracer::Trace& trace, UtteranceTracer::Point from, UtteranceTracer::Point to) {
+    int64_t start = PointUs(trace, from);
+    int64_t end = PointUs(trace, to);
+    return (start && end) ? (end - start) / 1000.0 : -1.0;
+}
+
+}  // namespace
+
+UtteranceTracer& UtteranceTracer::Instance() {
+    static UtteranceTracer tracer;
+    return tracer;
+}
+
+int64_t UtteranceTracer::ToUs(Clock::time_point when) {
+    // +1 keeps a real timestamp from ever reading as "not reached"
+    return std::chrono::duration_cast<std::chrono::microseconds>(when.time_since_epoch()).count() + 1;
+}
+
+uint64_t UtteranceTracer::Begin(Clock::time_point speechStart, Clock::time_point speechEnd, uint32_t audioMs) {
+    Clock::time_point now = Clock::now();
+    auto sinceStart = std::chrono::duration_cast<std::chrono::milliseconds>(now - speechStart);
+    int64_t wallNowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    uint64_t id = nextId++;
+    Trace& trace = traces[id % CAPACITY];      // Overwrites the oldest
+    trace = Trace();
+    trace.id = id;
+    trace.startedAtMs = wallNowMs - sinceStart.count();
+    trace.audioMs = audioMs;
+    trace.profile = Experiments::Instance().ActiveIndex();
+    trace.pointUs[static_cast<size_t>(Point::SpeechStart)] = ToUs(speechStart);
+    trace.pointUs[static_cast<size_t>(Point::SpeechEnd)] = ToUs(speechEnd);
+    trace.pointUs[static_cast<size_t>(Point::Finalized)] = ToUs(now);
+    return id;
+}
+
+UtteranceTracer::Trace* UtteranceTracer::Find(uint64_t id) {
+    if (id == 0) {
+        return nullptr;
+    }
+    Trace& trace = traces[id % CAPACITY];
+    return trace.id == id ? &trace : nullptr;
+}
+
+void UtteranceTracer::Mark(uint64_t id, Point point) {
+    int64_t now = ToUs(Clock::now());
+    Trace completed;
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        Trace* trace = Find(id);
+        if (!trace || trace->pointUs[static_cast<size_t>(point)] != 0) {
+            return;                             // First mark wins (a merged job is enqueued once)
+        }
+        trace->pointUs[static_cast<size_t>(point)] = now;
+        if (point != Point::ContextUpdated) {
+            return;
+        }
+        completed = *trace;
+    }
+    RecordCompleted(completed);
+}
+
+void UtteranceTracer::SetOutcome(uint64_t id, Outcome outcome) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (Trace* trace = Find(id)) {
+        trace->outcome = outcome;
+    }
+}
+
+void UtteranceTracer::RecordCompleted(const Trace& trace) {
+    double silenceHold = SpanMs(trace, Point::SpeechEnd, Point::Finalized);
+    double pickup = SpanMs(trace, Point::WhisperEnd, Point::PickedUp);
+    double endToEnd = SpanMs(trace, Point::SpeechEnd, Point::ContextUpdated);
+    if (silenceHold >= 0) {
+        PipelineLatency::Record(PipelineLatency::Stage::SilenceHold, silenceHold);
+    }
+    if (pickup >= 0) {
+        PipelineLatency::Record(PipelineLatency::Stage::ResultPickup, pickup);
+    }
+    if (endToEnd >= 0) {
+        PipelineLatency::Record(PipelineLatency::Stage::UtteranceEndToEnd, endToEnd);
+    }
+}
+
+bool UtteranceTracer::GetSpeechSpan(uint64_t id, int64_t& startUs, int64_t& endUs) const {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    const Trace& trace = traces[id % CAPACITY];
+    if (id == 0 || trace.id != id) {
+        return false;
+    }
+    // Back from ToUs's +1
+    startUs = trace.pointUs[static_cast<size_t>(Point::SpeechStart)] - 1;
+    endUs = trace.pointUs[static_cast<size_t>(Point::SpeechEnd)] - 1;
+    return true;
+}
+
+std::vector<UtteranceTracer::Trace> UtteranceTracer::Recent() const {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    std::vector<Trace> result;
+    result.reserve(CAPACITY);
+    uint64_t first = nextId > CAPACITY ? nextId - CAPACITY : 1;
+    for (uint64_t id = first; id < nextId; ++id) {
+        result.push_back(traces[id % CAPACITY]);
+    }
+    return result;
+}
+
+void UtteranceTracer::Write(JsonWriter& writer) const {
+    std::vector<Trace> recent = Recent();
+    writer.BeginObject();
+    writer.Key("utterances").BeginArray();
+    for (const Trace& trace : recent) {
+        writer.BeginObject();
+        writer.Key("id").UInt(trace.id);
+        writer.Key("startedAt").Int(trace.startedAtMs);
+        writer.Key("audioMs").UInt(trace.audioMs);
+        writer.Key("outcome").String(OUTCOME_NAMES[static_cast<size_t>(trace.outcome)]);
+        writer.Key("profile").String(Experiments::Instance().ProfileName(trace.profile));
+        writer.Key("stagesMs").BeginObject();
+        for (const Span& span : SPANS) {
+            double ms = SpanMs(trace, span.from, span.to);
+            writer.Key(span.name);
+            if (ms >= 0) {
+                writer.Double(ms, 1);
+            } else {
+                writer.Null();
+            }
+        }
+        writer.EndObject();
+        double endToEnd = SpanMs(trace, Point::SpeechEnd, Point::ContextUpdated);
+        writer.Key("endToEndMs");
+        if (endToEnd >= 0) {
+            writer.Double(endToEnd, 1);
+        } else {
+            writer.Null();
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
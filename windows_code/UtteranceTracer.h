@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class JsonWriter;
+
+/**
+ * UtteranceTracer - Per-utterance timestamps from speech start to /context
+ *
+ * Each finalized utterance gets an id when the VAD hands it to whisper; the
+ * id travels with the audio through AsyncWhisperQueue and back with its
+ * result, and every hop marks its time:
+ *
+ *   SpeechStart   first speech frame (VAD)
+ *   SpeechEnd     last speech frame before the silence that ended it
+ *   Finalized     silence window elapsed: the utterance is cut
+ *   Enqueued      in AsyncWhisperQueue
+ *   WhisperStart / WhisperEnd
+ *   PickedUp      result taken from the queue for the transcription callback
+ *   ContextUpdated  transcription callback (UpdateVoiceContext) returned
+ *
+ * The last CAPACITY traces are kept for /utterances. Completed traces also
+ * feed PipelineLatency (SilenceHold, ResultPickup, UtteranceEndToEnd), so
+ * the fixed silence window and the pickup hop show up in /metrics next to
+ * the compute stages. Each trace names the Experiments profile that was
+ * active when it began.
+ *
+ * Usage:
+ *   uint64_t id = UtteranceTracer::Instance().Begin(speechStart, speechEnd);
+ *   UtteranceTracer::Instance().Mark(id, UtteranceTracer::Point::Enqueued);
+ *
+ * Thread-safe (one mutex; a few marks per utterance).
+ */
+class UtteranceTracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Point {
+        SpeechStart,
+        SpeechEnd,
+        Finalized,
+        Enqueued,
+        WhisperStart,
+        WhisperEnd,
+        PickedUp,
+        ContextUpdated,
+        Count
+    };
+
+    // How an utterance left the pipeline early
+    enum class Outcome {
+        Delivered,
+        Merged,         // Appended to the utterance queued before it (that trace continues)
+        Dropped,        // Queue overflow
+        Empty           // Whisper produced no text
+    };
+
+    struct Trace {
+        uint64_t id = 0;
+        int64_t startedAtMs = 0;                        // Wall clock (epoch ms) of SpeechStart
+        int64_t pointUs[static_cast<size_t>(Point::Count)] = {};    // Steady clock; 0 = not reached
+        uint32_t audioMs = 0;
+        Outcome outcome = Outcome::Delivered;
+        uint32_t profile = 0;                           // Experiments::ActiveIndex() at Begin
+    };
+
+    static constexpr size_t CAPACITY = 64;
+
+    static UtteranceTracer& Instance();
+
+    // New trace with SpeechStart, SpeechEnd and Finalized (= now) set; never 0
+    uint64_t Begin(Clock::time_point speechStart, Clock::time_point speechEnd, uint32_t audioMs);
+
+    // Unknown or evicted ids (and 0) are ignored
+    void Mark(uint64_t id, Point point);
+    void SetOutcome(uint64_t id, Outcome outcome);
+
+    /**
+     * @brief When the utterance was spoken: its first and last speech frames
+     * @param startUs, endUs Steady clock microseconds (Clock::time_since_epoch)
+     * @return false for unknown or evicted ids
+     */
+    bool GetSpeechSpan(uint64_t id, int64_t& startUs, int64_t& endUs) const;
+
+    // Newest last
+    std::vector<Trace> Recent() const;
+
+    // {"utterances":[{id, startedAt, audioMs, outcome, stagesMs{...}, endToEndMs}]}
+    void Write(JsonWriter& writer) const;
+
+private:
+    UtteranceTracer() = default;
+
+    static int64_t ToUs(Clock::time_point when);
+    Trace* Find(uint64_t id);           // traceMutex held
+    void RecordCompleted(const Trace& trace);
+
+    mutable std::mutex traceMutex;
+    Trace traces[CAPACITY];             // Slot id % CAPACITY
+    uint64_t nextId = 1;
+};
@@ -0,0 +1,204 @@
+#include "VadGate.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VAD_GATE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Mean square and zero crossings of one frame in a single pass
+void EnergyAndCrossings(const float* frame, size_t count, float& meanSquare, size_t& crossings) {
+    float sum = 0.0f;
+    size_t changes = 0;
+    size_t i = 0;
+#ifdef VAD_GATE_X86
+    static const uint8_t BITS[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    __m128 acc = _mm_setzero_ps();
+    acc = _mm_add_ss(acc, _mm_set_ss(frame[0] * frame[0]));
+    // Sign bits of x[i] ^ x[i - 1]: a crossing wherever they differ
+    for (i = 1; i + 4 <= count; i += 4) {
+        __m128 current = _mm_loadu_ps(frame + i);
+        __m128 previous = _mm_loadu_ps(frame + i - 1);
+        acc = _mm_add_ps(acc, _mm_mul_ps(current, current));
+        changes += BITS[_mm_movemask_ps(_mm_xor_ps(current, previous))];
+    }
+    __m128 high = _mm_movehl_ps(acc, acc);
+    acc = _mm_add_ps(acc, high);
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#else
+    if (count > 0) {
+        sum = frame[0] * frame[0];
+        i = 1;
+    }
+#endif
+    for (; i < count; ++i) {
+        sum += frame[i] * frame[i];
+        changes += std::signbit(frame[i]) != std::signbit(frame[i - 1]) ? 1 : 0;
+    }
+    meanSquare = count > 0 ? sum / count : 0.0f;
+    crossings = changes;
+}
+
+}  // namespace
+
+VadGate::VadGate()
+    : floorDb(FLOOR_INITIAL_DB)
+    , historyFrames(0) {
+    window.resize(FRAME_SAMPLES);
+    for (size_t n = 0; n < FRAME_SAMPLES; ++n) {
+        window[n] = static_cast<float>(0.5 * (1.0 - std::cos(2.0 * PI * n / FRAME_SAMPLES)));
+    }
+    // Twiddles for the 256-point FFT, then for unpacking the 512-point real one
+    twiddleRe.resize(FRAME_SAMPLES / 2 + 1);
+    twiddleIm.resize(FRAME_SAMPLES / 2 + 1);
+    for (size_t k = 0; k <= FRAME_SAMPLES / 2; ++k) {
+        twiddleRe[k] = static_cast<float>(std::cos(2.0 * PI * k / FRAME_SAMPLES));
+        twiddleIm[k] = static_cast<float>(-std::sin(2.0 * PI * k / FRAME_SAMPLES));
+    }
+    bitReverse.resize(FFT_POINTS);
+    size_t bits = 0;
+    while ((static_cast<size_t>(1) << bits) < FFT_POINTS) {
+        bits++;
+    }
+    for (size_t i = 0; i < FFT_POINTS; ++i) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReverse[i] = static_cast<uint16_t>(reversed);
+    }
+    re.resize(FFT_POINTS);
+    im.resize(FFT_POINTS);
+    history.resize(WARMUP_FRAMES * FRAME_SAMPLES);
+}
+
+void VadGate::Classify(const float* frames, size_t nFrames, uint8_t* candidates) {
+    energies.resize(nFrames);
+    for (size_t f = 0; f < nFrames; ++f) {
+        const float* frame = frames + f * FRAME_SAMPLES;
+        float meanSquare = 0.0f;
+        size_t crossings = 0;
+        EnergyAndCrossings(frame, FRAME_SAMPLES, meanSquare, crossings);
+        const float energyDb = 10.0f * std::log10(meanSquare + 1e-10f);
+        energies[f] = energyDb;
+
+        const float margin = energyDb - floorDb;
+        bool candidate = energyDb > SILENCE_DB && margin >= ONSET_MARGIN_DB;
+        if (candidate && margin < CLEAR_MARGIN_DB) {
+            // Close to the floor: hum and steady broadband noise are not worth a Silero run
+            const float zcr = static_cast<float>(crossings) / (FRAME_SAMPLES - 1);
+            if (zcr < ZCR_HUM) {
+                candidate = false;
+            } else {
+                stats.spectra++;
+                candidate = SpectralFlatness(frame) <= FLATNESS_NOISE;
+            }
+        }
+        candidates[f] = candidate ? 1 : 0;
+        stats.frames++;
+        stats.candidates += candidate ? 1 : 0;
+    }
+}
+
+void VadGate::Adapt(const float* scores, size_t nFrames, float noiseThreshold) {
+    for (size_t f = 0; f < (std::min)(nFrames, energies.size()); ++f) {
+        if (scores[f] >= noiseThreshold) {
+            continue;
+        }
+        const float energyDb = (std::max)(energies[f], FLOOR_MIN_DB);
+        if (energyDb < floorDb) {
+            floorDb += (energyDb - floorDb) * FLOOR_FALL;
+        } else {
+            floorDb += (std::min)(energyDb - floorDb, FLOOR_RISE_DB);
+        }
+        floorDb = (std::min)((std::max)(floorDb, FLOOR_MIN_DB), FLOOR_MAX_DB);
+    }
+}
+
+void VadGate::Remember(const float* frames, size_t nFrames) {
+    const size_t keep = (std::min)(nFrames, WARMUP_FRAMES);
+    const size_t old = (std::min)(historyFrames, WARMUP_FRAMES - keep);
+    // Older history moves to the front, then the batch's last frames follow
+    std::memmove(history.data(), history.data() + (historyFrames - old) * FRAME_SAMPLES,
+                 old * FRAME_SAMPLES * sizeof(float));
+    std::memcpy(history.data() + old * FRAME_SAMPLES, frames + (nFrames - keep) * FRAME_SAMPLES,
+                keep * FRAME_SAMPLES * sizeof(float));
+    historyFrames = old + keep;
+}
+
+const float* VadGate::GetHistory(size_t& count) const {
+    count = historyFrames;
+    return history.data();
+}
+
+float VadGate::GetPeakMarginDb() const {
+    if (energies.empty()) {
+        return -std::numeric_limits<float>::infinity();
+    }
+    return *std::max_element(energies.begin(), energies.end()) - floorDb;
+}
+
+void VadGate::Reset() {
+    floorDb = FLOOR_INITIAL_DB;
+    historyFrames = 0;
+    energies.clear();
+}
+
+VadGate::Stats VadGate::GetStats() const {
+    Stats result = stats;
+    result.noiseFloorDb = floorDb;
+    return result;
+}
+
+float VadGate::SpectralFlatness(const float* frame) {
+    // 512 real samples as 256 complex points, bit-reversed for the in-place FFT
+    for (size_t n = 0; n < FFT_POINTS; ++n) {
+        re[bitReverse[n]] = frame[2 * n] * window[2 * n];
+        im[bitReverse[n]] = frame[2 * n + 1] * window[2 * n + 1];
+    }
+    for (size_t size = 2; size <= FFT_POINTS; size *= 2) {
+        const size_t half = size / 2;
+        const size_t step = FRAME_SAMPLES / size;   // Twiddles are 512th roots: w_size^j = w_512^(j step)
+        for (size_t start = 0; start < FFT_POINTS; start += size) {
+            for (size_t j = 0; j < half; ++j) {
+                const float wr = twiddleRe[j * step];
+                const float wi = twiddleIm[j * step];
+                const size_t a = start + j;
+                const size_t b = a + half;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+
+    // Unpack the bins of the real transform that matter and compare the means
+    double logSum = 0.0;
+    double sum = 0.0;
+    for (size_t k = FLATNESS_FIRST_BIN; k <= FLATNESS_LAST_BIN; ++k) {
+        const size_t a = k % FFT_POINTS;
+        const size_t b = (FFT_POINTS - k) % FFT_POINTS;
+        const float evenRe = 0.5f * (re[a] + re[b]);
+        const float evenIm = 0.5f * (im[a] - im[b]);
+        const float oddRe = 0.5f * (im[a] + im[b]);
+        const float oddIm = -0.5f * (re[a] - re[b]);
+        const float xr = evenRe + twiddleRe[k] * oddRe - twiddleIm[k] * oddIm;
+        const float xi = evenIm + twiddleRe[k] * oddIm + twiddleIm[k] * oddRe;
+        const double power = static_cast<double>(xr) * xr + static_cast<double>(xi) * xi + 1e-12;
+        logSum += std::log(power);
+        sum += power;
+    }
+    const double bins = static_cast<double>(FLATNESS_LAST_BIN - FLATNESS_FIRST_BIN + 1);
+    return static_cast<float>(std::exp(logSum / bins) / (sum / bins));
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * VadGate - Cheap first stage in front of Silero
+ *
+ * Silero used to score every 32 ms frame of both lanes, in an empty room as
+ * much as mid-sentence: one ONNX run per frame, around the clock. Most of
+ * those frames are plainly not speech, and three cheap features say so:
+ *
+ *   energy      mean square in dBFS, compared with an adaptive noise floor
+ *   ZCR         zero crossings per sample (one SSE pass with the energy):
+ *               mains hum and rumble barely cross zero, speech does
+ *   flatness    geometric over arithmetic mean of the 125 Hz - 4 kHz power
+ *               spectrum (256-point complex FFT of the frame): close to 1 for
+ *               fans and hiss, low for harmonic voice; only computed for
+ *               frames a little above the floor, where it decides anything
+ *
+ * A frame is a candidate when it stands ONSET_MARGIN_DB above the floor and,
+ * unless it stands CLEAR_MARGIN_DB above, is neither flat nor hum. Only
+ * candidates (plus the hangover the caller keeps around them) go to Silero.
+ *
+ * The floor falls quickly to quieter frames and rises by at most
+ * FLOOR_RISE_DB per frame, and only on frames the caller reports as noise
+ * (Adapt: gated out, or scored below the off threshold by Silero), so a fan
+ * switched on is learned within seconds while a speaker never lifts it.
+ *
+ * The gate also keeps the last WARMUP_FRAMES frames it saw: skipped frames
+ * leave Silero's LSTM state behind, so the caller resets it and runs these
+ * through first, and the first real frame is scored in context.
+ *
+ * Usage (processing thread only; not thread-safe):
+ *   VadGate gate;
+ *   gate.Classify(frames, nFrames, candidates);    // 1: ask Silero
+ *   ...score the candidates, 0 for the rest...
+ *   gate.Adapt(scores, nFrames, offThreshold);
+ *   gate.Remember(frames, nFrames);
+ */
+class VadGate {
+public:
+    static constexpr size_t FRAME_SAMPLES = 512;            // 32 ms, one VAD frame
+    static constexpr size_t WARMUP_FRAMES = 3;              // Silero context replayed after a gap
+    static constexpr float SILENCE_DB = -70.0f;             // Digital silence, never a candidate
+    static constexpr float ONSET_MARGIN_DB = 6.0f;          // Above the floor: possibly speech
+    static constexpr float CLEAR_MARGIN_DB = 15.0f;         // Above the floor: candidate without further checks
+    static constexpr float FLATNESS_NOISE = 0.5f;           // Flatter than this is noise
+    static constexpr float ZCR_HUM = 0.01f;                 // Fewer crossings per sample: hum / rumble
+    static constexpr float FLOOR_FALL = 0.3f;               // Share of the gap closed per quieter frame
+    static constexpr float FLOOR_RISE_DB = 0.1f;            // Per noise frame (~3 dB/s)
+    static constexpr float FLOOR_INITIAL_DB = -60.0f;       // Low: Silero runs until the room is learned
+    static constexpr float FLOOR_MIN_DB = -80.0f;
+    static constexpr float FLOOR_MAX_DB = -25.0f;
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t candidates = 0;            // Frames passed on to Silero
+        uint64_t spectra = 0;               // Frames that needed the flatness check
+        float noiseFloorDb = 0.0f;
+    };
+
+    VadGate();
+
+    // Mark each 512-sample frame as a candidate (1) or clearly not speech (0)
+    void Classify(const float* frames, size_t nFrames, uint8_t* candidates);
+
+    // Frames of the last Classify() whose score is below noiseThreshold
+    // (skipped frames score 0) teach the noise floor
+    void Adapt(const float* scores, size_t nFrames, float noiseThreshold);
+
+    // Keep the tail of a classified batch as the next warm-up
+    void Remember(const float* frames, size_t nFrames);
+
+    // The last `count` (at most WARMUP_FRAMES) frames seen before the current batch, oldest first
+    const float* GetHistory(size_t& count) const;
+
+    // Loudest frame of the last Classify() above the noise floor, in dB (the
+    // batch's SNR; -infinity before the first batch)
+    float GetPeakMarginDb() const;
+
+    void Reset();
+    Stats GetStats() const;
+
+private:
+    static constexpr size_t FFT_POINTS = FRAME_SAMPLES / 2;     // Complex points (two samples each)
+    static constexpr size_t FLATNESS_FIRST_BIN = 4;             // 125 Hz at 31.25 Hz per bin
+    static constexpr size_t FLATNESS_LAST_BIN = 128;            // 4 kHz
+
+    float SpectralFlatness(const float* frame);
+
+    float floorDb;
+    std::vector<float> energies;        // dBFS of the last classified batch
+
+    // Flatness FFT (radix-2, in place)
+    std::vector<float> window;
+    std::vector<float> twiddleRe;
+    std::vector<float> twiddleIm;
+    std::vector<uint16_t> bitReverse;
+    std::vector<float> re;
+    std::vector<float> im;
+
+    std::vector<float> history;         // WARMUP_FRAMES x FRAME_SAMPLES
+    size_t historyFrames;
+
+    Stats stats;
+};
@@ -0,0 +1,582 @@
+#include "VectorIndex.h"
+#include "Log.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+bool WriteAt(HANDLE file, uint64_t offset, const void* data, size_t bytes) {
+    OVERLAPPED position = {};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD written = 0;
+    return WriteFile(file, data, static_cast<DWORD>(bytes), &written, &position) && written == bytes;
+}
+
+bool ReadAt(HANDLE file, uint64_t offset, void* data, size_t bytes) {
+    OVERLAPPED position = {};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD read = 0;
+    return ReadFile(file, data, static_cast<DWORD>(bytes), &read, &position) && read == bytes;
+}
+
+uint64_t FileSize(HANDLE file) {
+    LARGE_INTEGER size;
+    return GetFileSizeEx(file, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+}
+
+bool Truncate(HANDLE file, uint64_t bytes) {
+    LARGE_INTEGER offset;
+    offset.QuadPart = static_cast<LONGLONG>(bytes);
+    return SetFilePointerEx(file, offset, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+}
+
+HANDLE OpenReadWrite(const std::filesystem::path& path, bool truncate) {
+    return CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                       truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+
+float Dot(const float* a, const float* b, size_t count) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void Normalize(float* vector, size_t count) {
+    double norm = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        norm += static_cast<double>(vector[i]) * vector[i];
+    }
+    if (norm > 0.0) {
+        const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+        for (size_t i = 0; i < count; ++i) {
+            vector[i] *= scale;
+        }
+    }
+}
+
+} // namespace
+
+VectorIndex::VectorIndex(const std::string& directory)
+    : directory(directory)
+    , dimensions(0)
+    , recordBytes(0)
+    , recordsOffset(0)
+    , vectorFile(INVALID_HANDLE_VALUE)
+    , mapping(nullptr)
+    , view(nullptr)
+    , capacity(0)
+    , textFile(INVALID_HANDLE_VALUE)
+    , textEnd(0)
+    , listFile(INVALID_HANDLE_VALUE)
+    , training(false)
+    , full(false)
+    , memoryReporterId(0)
+    , postingBytes(0)
+{
+    memoryReporterId = MemoryAccounting::Instance().Register([this](MemoryAccounting::Entries& entries) {
+        entries.push_back({ "vector_index", "postings", postingBytes.load() });
+    });
+}
+
+VectorIndex::~VectorIndex() {
+    MemoryAccounting::Instance().Unregister(memoryReporterId);
+    Close();
+}
+
+// ============================================================================
+// Files
+// ============================================================================
+
+bool VectorIndex::Open(size_t vectorDimensions) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    CloseFiles();
+
+    dimensions = vectorDimensions;
+    recordBytes = sizeof(RecordHeader) + ((dimensions + 7) & ~size_t(7));
+    const uint64_t centroidBytes = static_cast<uint64_t>(LISTS) * dimensions * sizeof(float);
+    recordsOffset = HEADER_BYTES + ((centroidBytes + HEADER_BYTES - 1) / HEADER_BYTES) * HEADER_BYTES;
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        LOG_ERROR("VectorIndex", "Cannot create " << directory.u8string() << ": " << ec.message());
+        return false;
+    }
+
+    std::filesystem::path vectorPath = directory / "vectors.idx";
+    vectorFile = OpenReadWrite(vectorPath, false);
+    if (vectorFile == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("VectorIndex", "Cannot open " << vectorPath.u8string() << " (error " << GetLastError() << ")");
+        return false;
+    }
+
+    // An unreadable header, another format or another model's dimensions: start over
+    const uint64_t fileBytes = FileSize(vectorFile);
+    FileHeader existing = {};
+    bool fresh = fileBytes < recordsOffset || !ReadAt(vectorFile, 0, &existing, sizeof(existing)) ||
+                 existing.magic != MAGIC || existing.version != VERSION;
+    if (!fresh && existing.dimensions != dimensions) {
+        LOG_WARNING("VectorIndex", "Index holds " << existing.dimensions << "-dimension vectors, the model makes "
+                    << dimensions << "; starting a new index");
+        fresh = true;
+    }
+    if (fresh && !Truncate(vectorFile, 0)) {
+        LOG_ERROR("VectorIndex", "Cannot reset " << vectorPath.u8string());
+        CloseFiles();
+        return false;
+    }
+
+    uint64_t count = fresh ? 0 : existing.count;
+    uint64_t records = fresh ? 0 : (fileBytes - recordsOffset) / recordBytes;
+    count = (std::min)(count, records);
+    if (!Map((std::max)(records, GROWTH_RECORDS))) {
+        CloseFiles();
+        return false;
+    }
+    if (fresh) {
+        *Header() = { MAGIC, VERSION, static_cast<uint32_t>(dimensions), 0, 0 };
+    }
+
+    textFile = OpenReadWrite(directory / "vectors.txt", fresh);
+    listFile = OpenReadWrite(directory / "vectors.lists", fresh);
+    if (textFile == INVALID_HANDLE_VALUE || listFile == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("VectorIndex", "Cannot open the text or list file in " << directory.u8string());
+        CloseFiles();
+        return false;
+    }
+
+    // Cut the count back to records whose list entry and text both made it
+    // to disk, then the files back to the count
+    const bool trained = Header()->lists == LISTS;
+    std::vector<uint16_t> lists;
+    if (trained) {
+        count = (std::min)(count, FileSize(listFile) / sizeof(uint16_t));
+        lists.resize(static_cast<size_t>(count));
+        if (count > 0 && !ReadAt(listFile, 0, lists.data(), lists.size() * sizeof(uint16_t))) {
+            LOG_ERROR("VectorIndex", "Cannot read the list file");
+            CloseFiles();
+            return false;
+        }
+    }
+    const uint64_t textBytes = FileSize(textFile);
+    while (count > 0 && RecordAt(count - 1)->textOffset + RecordAt(count - 1)->textBytes > textBytes) {
+        --count;
+    }
+    textEnd = count > 0 ? RecordAt(count - 1)->textOffset + RecordAt(count - 1)->textBytes : 0;
+    Truncate(textFile, textEnd);
+    Truncate(listFile, trained ? count * sizeof(uint16_t) : 0);
+    Header()->count = count;
+
+    postings.assign(trained ? LISTS : 0, {});
+    for (uint64_t i = 0; i < count && trained; ++i) {
+        postings[lists[static_cast<size_t>(i)] % LISTS].push_back(static_cast<uint32_t>(i));
+    }
+    postingBytes = trained ? count * sizeof(uint32_t) : 0;
+    full = count >= MAX_RECORDS;
+
+    LOG_INFO("VectorIndex", "Search index " << directory.u8string() << ": " << count << " records, "
+             << dimensions << " dimensions" << (trained ? ", trained" : ""));
+    return true;
+}
+
+void VectorIndex::Close() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    CloseFiles();
+}
+
+void VectorIndex::CloseFiles() {
+    Unmap();
+    for (HANDLE* file : { &vectorFile, &textFile, &listFile }) {
+        if (*file != INVALID_HANDLE_VALUE) {
+            CloseHandle(*file);
+            *file = INVALID_HANDLE_VALUE;
+        }
+    }
+    postings.clear();
+    postingBytes = 0;
+}
+
+bool VectorIndex::Map(uint64_t capacityRecords) {
+    // Creating the mapping extends the file to its size
+    const uint64_t bytes = recordsOffset + capacityRecords * recordBytes;
+    mapping = CreateFileMappingW(vectorFile, nullptr, PAGE_READWRITE, static_cast<DWORD>(bytes >> 32),
+                                 static_cast<DWORD>(bytes), nullptr);
+    if (!mapping) {
+        LOG_ERROR("VectorIndex", "Cannot map " << (bytes >> 20) << " MB (error " << GetLastError() << ")");
+        return false;
+    }
+    view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+    if (!view) {
+        LOG_ERROR("VectorIndex", "Cannot map a view (error " << GetLastError() << ")");
+        CloseHandle(mapping);
+        mapping = nullptr;
+        return false;
+    }
+    capacity = capacityRecords;
+    return true;
+}
+
+void VectorIndex::Unmap() {
+    if (view) {
+        FlushViewOfFile(view, 0);
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    capacity = 0;
+}
+
+bool VectorIndex::Grow() {
+    // A mapping can't grow in place: remap the longer file (searches are locked out)
+    const uint64_t previous = capacity;
+    Unmap();
+    if (Map(previous + GROWTH_RECORDS)) {
+        return true;
+    }
+    Map(previous);
+    return false;
+}
+
+const VectorIndex::RecordHeader* VectorIndex::RecordAt(uint64_t index) const {
+    return reinterpret_cast<const RecordHeader*>(view + recordsOffset + index * recordBytes);
+}
+
+VectorIndex::RecordHeader* VectorIndex::RecordAt(uint64_t index) {
+    return reinterpret_cast<RecordHeader*>(view + recordsOffset + index * recordBytes);
+}
+
+const float* VectorIndex::Centroids() const {
+    return reinterpret_cast<const float*>(view + HEADER_BYTES);
+}
+
+bool VectorIndex::ReadText(const RecordHeader* record, std::string& text) const {
+    text.resize(record->textBytes);
+    return text.empty() || ReadAt(textFile, record->textOffset, &text[0], text.size());
+}
+
+uint64_t VectorIndex::Size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return view ? Header()->count : 0;
+}
+
+bool VectorIndex::IsTrained() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return view && Header()->lists == LISTS;
+}
+
+// ============================================================================
+// Adding
+// ============================================================================
+
+float VectorIndex::Score(const RecordHeader* record, const float* vector) const {
+    const int8_t* values = reinterpret_cast<const int8_t*>(record + 1);
+    float sum = 0.0f;
+    for (size_t d = 0; d < dimensions; ++d) {
+        sum += values[d] * vector[d];
+    }
+    return sum * record->scale;
+}
+
+uint16_t VectorIndex::NearestList(const float* vector) const {
+    const float* centroids = Centroids();
+    uint16_t best = 0;
+    float bestScore = -2.0f;
+    for (uint32_t list = 0; list < LISTS; ++list) {
+        float score = Dot(centroids + static_cast<size_t>(list) * dimensions, vector, dimensions);
+        if (score > bestScore) {
+            bestScore = score;
+            best = static_cast<uint16_t>(list);
+        }
+    }
+    return best;
+}
+
+bool VectorIndex::Add(Kind kind, int64_t timeMs, std::string_view text, const std::vector<float>& embedding) {
+    TRACE_ZONE("VectorIndex::Add");
+    if (embedding.size() != dimensions || dimensions == 0) {
+        return false;
+    }
+    // Long transcripts keep their start, cut at a character boundary
+    if (text.size() > MAX_TEXT_BYTES) {
+        size_t cut = MAX_TEXT_BYTES;
+        while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) {
+            --cut;
+        }
+        text = text.substr(0, cut);
+    }
+
+    // Symmetric int8: a quarter of the float size, scores within ~1% of exact
+    float largest = 0.0f;
+    for (float v : embedding) {
+        largest = (std::max)(largest, std::fabs(v));
+    }
+    const float scale = largest > 0.0f ? largest / 127.0f : 1.0f;
+    std::vector<int8_t> values(dimensions);
+    for (size_t d = 0; d < dimensions; ++d) {
+        values[d] = static_cast<int8_t>(std::lround(embedding[d] / scale));
+    }
+
+    bool train = false;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (!view || full) {
+            return false;
+        }
+        const uint64_t count = Header()->count;
+        if (count >= MAX_RECORDS) {
+            full = true;
+            LOG_WARNING("VectorIndex", "Search index full (" << count << " records); new records are not indexed");
+            return false;
+        }
+        if (count == capacity && !Grow()) {
+            return false;
+        }
+        if (!text.empty() && !WriteAt(textFile, textEnd, text.data(), text.size())) {
+            LOG_ERROR("VectorIndex", "Text write failed (error " << GetLastError() << ")");
+            return false;
+        }
+
+        RecordHeader* record = RecordAt(count);
+        record->timeMs = timeMs;
+        record->textOffset = textEnd;
+        record->textBytes = static_cast<uint32_t>(text.size());
+        record->scale = scale;
+        record->kind = static_cast<uint8_t>(kind);
+        std::memset(record->reserved, 0, sizeof(record->reserved));
+        std::memcpy(record + 1, values.data(), dimensions);
+
+        if (Header()->lists == LISTS) {
+            uint16_t list = NearestList(embedding.data());
+            if (!WriteAt(listFile, count * sizeof(uint16_t), &list, sizeof(list))) {
+                LOG_ERROR("VectorIndex", "List write failed (error " << GetLastError() << ")");
+                return false;
+            }
+            postings[list].push_back(static_cast<uint32_t>(count));
+            postingBytes += sizeof(uint32_t);
+        }
+        textEnd += text.size();
+        Header()->count = count + 1;        // Commit
+        train = Header()->lists == 0 && count + 1 >= TRAIN_AT && !training.exchange(true);
+    }
+    if (train) {
+        Train();
+    }
+    return true;
+}
+
+void VectorIndex::Train() {
+    auto start = std::chrono::steady_clock::now();
+
+    // The records so far, dequantized; appends carry on meanwhile
+    std::vector<float> samples;
+    uint64_t count = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (!view) {
+            training = false;
+            return;
+        }
+        count = Header()->count;
+        samples.resize(static_cast<size_t>(count) * dimensions);
+        for (uint64_t i = 0; i < count; ++i) {
+            const RecordHeader* record = RecordAt(i);
+            const int8_t* values = reinterpret_cast<const int8_t*>(record + 1);
+            float* sample = &samples[static_cast<size_t>(i) * dimensions];
+            for (size_t d = 0; d < dimensions; ++d) {
+                sample[d] = values[d] * record->scale;
+            }
+        }
+    }
+
+    // Spherical k-means, seeded with records spread over the history
+    std::vector<float> centroids(static_cast<size_t>(LISTS) * dimensions);
+    for (uint32_t list = 0; list < LISTS; ++list) {
+        const float* seed = &samples[static_cast<size_t>(list * count / LISTS) * dimensions];
+        std::copy(seed, seed + dimensions, &centroids[static_cast<size_t>(list) * dimensions]);
+    }
+    std::vector<uint16_t> assignments(static_cast<size_t>(count));
+    std::vector<float> sums(centroids.size());
+    std::vector<uint32_t> sizes(LISTS);
+    for (int iteration = 0; iteration <= KMEANS_ITERATIONS; ++iteration) {
+        for (uint64_t i = 0; i < count; ++i) {
+            const float* sample = &samples[static_cast<size_t>(i) * dimensions];
+            uint16_t best = 0;
+            float bestScore = -2.0f;
+            for (uint32_t list = 0; list < LISTS; ++list) {
+                float score = Dot(&centroids[static_cast<size_t>(list) * dimensions], sample, dimensions);
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = static_cast<uint16_t>(list);
+                }
+            }
+            assignments[static_cast<size_t>(i)] = best;
+        }
+        if (iteration == KMEANS_ITERATIONS) {
+            break;      // Last pass only assigns
+        }
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        std::fill(sizes.begin(), sizes.end(), 0u);
+        for (uint64_t i = 0; i < count; ++i) {
+            const uint16_t list = assignments[static_cast<size_t>(i)];
+            const float* sample = &samples[static_cast<size_t>(i) * dimensions];
+            float* sum = &sums[static_cast<size_t>(list) * dimensions];
+            for (size_t d = 0; d < dimensions; ++d) {
+                sum[d] += sample[d];
+            }
+            sizes[list]++;
+        }
+        // An empty list keeps its centroid
+        for (uint32_t list = 0; list < LISTS; ++list) {
+            if (sizes[list] > 0) {
+                float* centroid = &centroids[static_cast<size_t>(list) * dimensions];
+                std::copy(&sums[static_cast<size_t>(list) * dimensions],
+                          &sums[static_cast<size_t>(list) * dimensions] + dimensions, centroid);
+                Normalize(centroid, dimensions);
+            }
+        }
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (!view) {
+            training = false;
+            return;
+        }
+        std::memcpy(view + HEADER_BYTES, centroids.data(), centroids.size() * sizeof(float));
+
+        // Records added while the centroids were computed
+        const uint64_t total = Header()->count;
+        std::vector<float> vector(dimensions);
+        for (uint64_t i = count; i < total; ++i) {
+            const RecordHeader* record = RecordAt(i);
+            const int8_t* values = reinterpret_cast<const int8_t*>(record + 1);
+            for (size_t d = 0; d < dimensions; ++d) {
+                vector[d] = values[d] * record->scale;
+            }
+            assignments.push_back(NearestList(vector.data()));
+        }
+
+        // The list file first; the header marks the index trained once it is written
+        if (!WriteAt(listFile, 0, assignments.data(), assignments.size() * sizeof(uint16_t))) {
+            LOG_ERROR("VectorIndex", "List file write failed (error " << GetLastError() << "); searching exactly");
+            training = false;
+            return;
+        }
+        postings.assign(LISTS, {});
+        for (size_t i = 0; i < assignments.size(); ++i) {
+            postings[assignments[i]].push_back(static_cast<uint32_t>(i));
+        }
+        postingBytes = assignments.size() * sizeof(uint32_t);
+        Header()->lists = LISTS;
+    }
+    training = false;
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("VectorIndex", "Trained " << LISTS << " lists on " << count << " records (" << elapsedMs << " ms)");
+}
+
+// ============================================================================
+// Searching
+// ============================================================================
+
+std::vector<VectorIndex::Hit> VectorIndex::Search(const std::vector<float>& vector, const Query& query) const {
+    TRACE_ZONE("VectorIndex::Search");
+    std::vector<Hit> hits;
+    if (vector.size() != dimensions || dimensions == 0) {
+        return hits;
+    }
+    const size_t k = (std::max)(size_t(1), (std::min)(query.k, MAX_RESULTS));
+
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (!view) {
+        return hits;
+    }
+    const uint64_t count = Header()->count;
+
+    // Records are appended in time order, so the window is a range of indexes
+    // (a wall clock set back only blurs its edges; each record is still checked)
+    auto firstAtOrAfter = [&](int64_t timeMs) {
+        uint64_t low = 0, high = count;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            if (RecordAt(middle)->timeMs < timeMs) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    };
+    const uint64_t first = query.fromMs > 0 ? firstAtOrAfter(query.fromMs) : 0;
+    const uint64_t last = query.toMs < (std::numeric_limits<int64_t>::max)() ? firstAtOrAfter(query.toMs + 1) : count;
+
+    // Min-heap of the best k so far
+    std::vector<std::pair<float, uint64_t>> best;
+    best.reserve(k + 1);
+    auto greater = [](const std::pair<float, uint64_t>& a, const std::pair<float, uint64_t>& b) {
+        return a.first > b.first;
+    };
+    auto consider = [&](uint64_t index) {
+        const RecordHeader* record = RecordAt(index);
+        if (record->timeMs < query.fromMs || record->timeMs > query.toMs) {
+            return;
+        }
+        float score = Score(record, vector.data());
+        if (best.size() < k) {
+            best.emplace_back(score, index);
+            std::push_heap(best.begin(), best.end(), greater);
+        } else if (score > best.front().first) {
+            std::pop_heap(best.begin(), best.end(), greater);
+            best.back() = { score, index };
+            std::push_heap(best.begin(), best.end(), greater);
+        }
+    };
+
+    if (Header()->lists != LISTS || last - first <= EXACT_WINDOW_RECORDS) {
+        for (uint64_t index = first; index < last; ++index) {
+            consider(index);
+        }
+    } else {
+        // The PROBES lists whose centroids are nearest the query
+        const float* centroids = Centroids();
+        std::vector<std::pair<float, uint32_t>> lists(LISTS);
+        for (uint32_t list = 0; list < LISTS; ++list) {
+            lists[list] = { Dot(centroids + static_cast<size_t>(list) * dimensions, vector.data(), dimensions), list };
+        }
+        std::partial_sort(lists.begin(), lists.begin() + PROBES, lists.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (uint32_t probe = 0; probe < PROBES; ++probe) {
+            for (uint32_t index : postings[lists[probe].second]) {
+                if (index >= first && index < last) {
+                    consider(index);
+                }
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), greater);      // Best first
+    for (const auto& [score, index] : best) {
+        const RecordHeader* record = RecordAt(index);
+        Hit hit;
+        hit.kind = static_cast<Kind>(record->kind);
+        hit.timeMs = record->timeMs;
+        hit.score = score;
+        if (ReadText(record, hit.text)) {
+            hits.push_back(std::move(hit));
+        }
+    }
+    return hits;
+}
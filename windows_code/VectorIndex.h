@@ -0,0 +1,159 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "EventJournal.h"
+
+/**
+ * VectorIndex - Captions and transcripts on disk, searchable by meaning
+ *
+ * Every caption and transcript is stored with its SentenceEmbedder vector,
+ * so /search can answer "when was I last at the whiteboard with someone"
+ * over weeks of history without replaying anything.
+ *
+ * Storage (<directory>/):
+ *   vectors.idx    [header 4 KB][centroids LISTS x D float][records], mapped
+ *                  read-write and grown GROWTH_RECORDS at a time. A record is
+ *                  [timeMs i64][textOffset u64][textBytes u32][scale f32]
+ *                  [kind u8][7 reserved][D int8], the vector quantized
+ *                  symmetrically (value = scale * q)
+ *   vectors.txt    the texts, appended
+ *   vectors.lists  the inverted list of each record, u16, once trained
+ * A record is committed when the header count moves past it; on open the
+ * count is cut back to what the text and list files actually hold.
+ *
+ * Search is IVF: the first TRAIN_AT records train LISTS centroids (spherical
+ * k-means, on the adding thread with no lock held), every record joins its
+ * nearest list, and a query scans only the PROBES lists nearest to it. Until
+ * then, and for a time window of at most EXACT_WINDOW_RECORDS (records are in
+ * time order, so the window is found by binary search), every record is
+ * scanned exactly. RAM is the posting lists (4 bytes a record); vectors and
+ * texts stay in the page cache, touched only for the lists probed.
+ *
+ * A different embedding model (dimension change) starts the index over.
+ * At MAX_RECORDS the index stops taking records.
+ *
+ * Threading: Add() and Search() from any thread; searches share a lock that
+ * Add() takes exclusively for the few microseconds of an append.
+ *
+ * Usage:
+ *   VectorIndex index("vectors");
+ *   index.Open(embedder.GetDimensions());
+ *   index.Add(EventJournal::Kind::Camera, nowMs, caption, vector);
+ *   VectorIndex::Query query;                  // Best 10 over all time
+ *   auto hits = index.Search(queryVector, query);
+ */
+class VectorIndex {
+public:
+    using Kind = EventJournal::Kind;        // Voice or Camera
+
+    struct Hit {
+        Kind kind;
+        int64_t timeMs;                     // Unix epoch milliseconds
+        float score;                        // Cosine similarity to the query
+        std::string text;
+    };
+
+    struct Query {
+        size_t k = 10;
+        int64_t fromMs = 0;
+        int64_t toMs = (std::numeric_limits<int64_t>::max)();
+    };
+
+    static constexpr uint32_t LISTS = 256;
+    static constexpr uint32_t PROBES = 16;
+    static constexpr uint64_t TRAIN_AT = 8192;
+    static constexpr int KMEANS_ITERATIONS = 6;
+    static constexpr uint64_t EXACT_WINDOW_RECORDS = 16384;
+    static constexpr uint64_t GROWTH_RECORDS = 16384;
+    static constexpr uint64_t MAX_RECORDS = 4ull << 20;
+    static constexpr size_t MAX_TEXT_BYTES = 4096;
+    static constexpr size_t MAX_RESULTS = 100;
+
+    explicit VectorIndex(const std::string& directory);
+    ~VectorIndex();
+
+    VectorIndex(const VectorIndex&) = delete;
+    VectorIndex& operator=(const VectorIndex&) = delete;
+
+    /**
+     * @brief Open (or create) the index for vectors of `dimensions` floats
+     * @return false (and logs) if the files can't be opened or mapped
+     */
+    bool Open(size_t dimensions);
+    void Close();
+
+    // Append one record (embedding unit length, GetDimensions() floats)
+    bool Add(Kind kind, int64_t timeMs, std::string_view text, const std::vector<float>& embedding);
+
+    // The query.k records closest to `vector` within the window, best first
+    std::vector<Hit> Search(const std::vector<float>& vector, const Query& query) const;
+
+    uint64_t Size() const;
+    bool IsTrained() const;
+    size_t GetDimensions() const { return dimensions; }
+
+private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t dimensions;
+        uint32_t lists;                     // 0 until trained
+        uint64_t count;                     // Committed records
+    };
+
+    struct RecordHeader {
+        int64_t timeMs;
+        uint64_t textOffset;
+        uint32_t textBytes;
+        float scale;
+        uint8_t kind;
+        uint8_t reserved[7];
+    };
+
+    static constexpr uint32_t MAGIC = 0x49564550;      // "PEVI"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_BYTES = 4096;
+
+    void CloseFiles();
+    bool Map(uint64_t capacityRecords);
+    void Unmap();
+    bool Grow();
+    FileHeader* Header() const { return reinterpret_cast<FileHeader*>(view); }
+    const RecordHeader* RecordAt(uint64_t index) const;
+    RecordHeader* RecordAt(uint64_t index);
+    const float* Centroids() const;
+    float Score(const RecordHeader* record, const float* vector) const;
+    uint16_t NearestList(const float* vector) const;
+    bool ReadText(const RecordHeader* record, std::string& text) const;
+    void Train();
+
+    std::filesystem::path directory;
+    size_t dimensions;
+    size_t recordBytes;
+    uint64_t recordsOffset;
+
+    HANDLE vectorFile;
+    HANDLE mapping;
+    uint8_t* view;
+    uint64_t capacity;                  // Records the mapping holds
+    HANDLE textFile;
+    uint64_t textEnd;
+    HANDLE listFile;
+
+    std::vector<std::vector<uint32_t>> postings;     // Per list, record indexes (trained only)
+    std::atomic<bool> training;
+    bool full;
+    uint64_t memoryReporterId;
+    std::atomic<uint64_t> postingBytes;
+
+    mutable std::shared_mutex mutex;
+};
@@ -0,0 +1,315 @@
+#include "Watchdog.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include <windows.h>
+#include <dbghelp.h>
+#include <chrono>
+#include <cstdio>
+
+#pragma comment(lib, "dbghelp.lib")
+
+static const char* const STATE_NAMES[] = { "free", "claimed", "busy", "idle" };
+
+Watchdog& Watchdog::Instance() {
+    // Leaked like the other process-wide singletons: heartbeats end during exit
+    static Watchdog* watchdog = new Watchdog();
+    return *watchdog;
+}
+
+Watchdog::Watchdog() {
+    watcher = std::thread(&Watchdog::WatchdogThread, this);
+}
+
+int64_t Watchdog::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* Watchdog::StateName(int state) {
+    return state >= FREE && state <= IDLE ? STATE_NAMES[state] : "unknown";
+}
+
+// ============================================================================
+// Heartbeats
+// ============================================================================
+
+int Watchdog::Claim(const char* name, const char* group, int timeoutMs) {
+    for (size_t index = 0; index < MAX_HEARTBEATS; ++index) {
+        Slot& slot = slots[index];
+        int expected = FREE;
+        if (!slot.state.compare_exchange_strong(expected, CLAIMED)) {
+            continue;
+        }
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.group.store(group, std::memory_order_relaxed);
+        slot.timeoutMs.store(timeoutMs, std::memory_order_relaxed);
+        slot.threadId.store(GetCurrentThreadId(), std::memory_order_relaxed);
+        slot.activity.store(nullptr, std::memory_order_relaxed);
+        slot.stalls.store(0, std::memory_order_relaxed);
+        slot.lastBeatMs.store(NowMs(), std::memory_order_relaxed);
+        slot.state.store(BUSY, std::memory_order_release);
+        return static_cast<int>(index);
+    }
+    LOG_WARNING("Watchdog", "No heartbeat slot left for " << name << "; thread is unwatched");
+    return -1;
+}
+
+void Watchdog::Release(int slot) {
+    slots[slot].state.store(FREE, std::memory_order_release);
+}
+
+Watchdog::Heartbeat::Heartbeat(const char* name, const char* group, int timeoutMs)
+    : slot(Instance().Claim(name, group, timeoutMs)) {
+}
+
+Watchdog::Heartbeat::~Heartbeat() {
+    if (slot >= 0) {
+        Instance().Release(slot);
+    }
+}
+
+void Watchdog::Heartbeat::Beat(const char* activity) {
+    if (slot < 0) {
+        return;
+    }
+    Slot& entry = Instance().slots[slot];
+    entry.activity.store(activity, std::memory_order_relaxed);
+    entry.lastBeatMs.store(NowMs(), std::memory_order_relaxed);
+    entry.state.store(BUSY, std::memory_order_relaxed);
+}
+
+void Watchdog::Heartbeat::Idle() {
+    if (slot < 0) {
+        return;
+    }
+    Slot& entry = Instance().slots[slot];
+    entry.lastBeatMs.store(NowMs(), std::memory_order_relaxed);
+    entry.state.store(IDLE, std::memory_order_relaxed);
+}
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+void Watchdog::SetDumpDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    dumpDirectory = directory;
+}
+
+void Watchdog::SetStallHandler(const char* group, StallHandler handler) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    if (handler) {
+        stallHandlers[group] = std::move(handler);
+    } else {
+        stallHandlers.erase(group);
+    }
+}
+
+// ============================================================================
+// Detection
+// ============================================================================
+
+void Watchdog::WatchdogThread() {
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(CHECK_INTERVAL_MS));
+
+        int64_t now = NowMs();
+        for (size_t index = 0; index < MAX_HEARTBEATS; ++index) {
+            Slot& slot = slots[index];
+            int state = slot.state.load(std::memory_order_acquire);
+            if (state != BUSY) {
+                // Idle threads aren't expected to beat; going idle or away ends an episode
+                if (slot.stalled) {
+                    slot.stalled = false;
+                    if (state == IDLE) {
+                        LOG_INFO("Watchdog", "Heartbeat " << slot.name.load() << " (thread "
+                                 << slot.threadId.load() << ") recovered");
+                    }
+                }
+                continue;
+            }
+
+            int64_t age = now - slot.lastBeatMs.load(std::memory_order_relaxed);
+            if (age > slot.timeoutMs.load(std::memory_order_relaxed)) {
+                if (!slot.stalled) {
+                    slot.stalled = true;
+                    slot.stalls++;
+                    totalStalls++;
+                    ReportStall(index, age, now);
+                }
+            } else if (slot.stalled) {
+                slot.stalled = false;
+                LOG_INFO("Watchdog", "Heartbeat " << slot.name.load() << " (thread "
+                         << slot.threadId.load() << ") recovered");
+            }
+        }
+    }
+}
+
+void Watchdog::ReportStall(size_t index, int64_t ageMs, int64_t nowMs) {
+    const Slot& stalled = slots[index];
+    const char* name = stalled.name.load();
+    const char* activity = stalled.activity.load();
+    LOG_ERROR("Watchdog", "Stall: " << name << " (thread " << stalled.threadId.load() << ", group "
+              << stalled.group.load() << ") silent for " << ageMs << " ms, timeout "
+              << stalled.timeoutMs.load() << " ms, last activity " << (activity ? activity : "-"));
+
+    // The others' state at the same moment: a lock cycle shows up as two busy
+    // heartbeats that stopped together
+    for (size_t other = 0; other < MAX_HEARTBEATS; ++other) {
+        const Slot& slot = slots[other];
+        int state = slot.state.load(std::memory_order_acquire);
+        if (other == index || (state != BUSY && state != IDLE)) {
+            continue;
+        }
+        const char* otherActivity = slot.activity.load();
+        LOG_ERROR("Watchdog", "  " << slot.name.load() << " (thread " << slot.threadId.load() << ") "
+                  << StateName(state) << ", last beat " << nowMs - slot.lastBeatMs.load() << " ms ago, activity "
+                  << (otherActivity ? otherActivity : "-"));
+    }
+
+    WriteDump(name);
+    RunStallHandler(stalled.group.load(), name);
+}
+
+void Watchdog::WriteDump(const char* name) {
+    std::string directory;
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        directory = dumpDirectory;
+    }
+    if (directory.empty() || dumpsWritten.load() >= MAX_DUMPS) {
+        return;
+    }
+    dumpsWritten++;
+
+    CreateDirectoryA(directory.c_str(), nullptr);
+    SYSTEMTIME time;
+    GetLocalTime(&time);
+    char fileName[160];
+    std::snprintf(fileName, sizeof(fileName), "\\stall-%s-%04d%02d%02d-%02d%02d%02d.dmp", name,
+                  time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond);
+    std::string path = directory + fileName;
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_WARNING("Watchdog", "Cannot create " << path << " (error " << GetLastError() << ")");
+        return;
+    }
+
+    // Stacks plus the memory they point at (lock words included), not the whole heap
+    MINIDUMP_TYPE type = static_cast<MINIDUMP_TYPE>(MiniDumpWithThreadInfo | MiniDumpWithHandleData |
+                                                    MiniDumpWithIndirectlyReferencedMemory |
+                                                    MiniDumpWithProcessThreadData | MiniDumpWithUnloadedModules);
+    BOOL written = MiniDumpWriteDump(GetCurrentProcess(), GetCurrentProcessId(), file, type, nullptr, nullptr, nullptr);
+    DWORD error = GetLastError();
+    CloseHandle(file);
+
+    if (written) {
+        LOG_ERROR("Watchdog", "Minidump written to " << path);
+    } else {
+        LOG_WARNING("Watchdog", "MiniDumpWriteDump failed (error " << error << ")");
+        DeleteFileA(path.c_str());
+    }
+}
+
+void Watchdog::RunStallHandler(const char* group, const char* thread) {
+    StallHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        auto it = stallHandlers.find(group);
+        if (it == stallHandlers.end() || handlersRunning[group]) {
+            return;
+        }
+        handler = it->second;
+        handlersRunning[group] = true;
+    }
+
+    // Off the watchdog thread: a handler that blocks on the wedged engine
+    // must not stop the other heartbeats from being checked
+    std::string groupName(group);
+    std::thread([this, handler, groupName, thread]() {
+        LOG_WARNING("Watchdog", "Running " << groupName << " stall handler for " << thread);
+        try {
+            handler(thread);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Watchdog", groupName << " stall handler failed: " << e.what());
+        }
+        std::lock_guard<std::mutex> lock(configMutex);
+        handlersRunning[groupName] = false;
+    }).detach();
+}
+
+// ============================================================================
+// Reporting
+// ============================================================================
+
+std::string Watchdog::FormatPrometheus() const {
+    std::string out;
+    out.reserve(2048);
+    char line[192];
+    std::snprintf(line, sizeof(line),
+                  "# HELP perception_watchdog_stalls_total Missed heartbeats since start\n"
+                  "# TYPE perception_watchdog_stalls_total counter\n"
+                  "perception_watchdog_stalls_total %llu\n",
+                  static_cast<unsigned long long>(totalStalls.load()));
+    out += line;
+
+    out += "# HELP perception_heartbeat_age_seconds Time since each busy thread's last heartbeat\n";
+    out += "# TYPE perception_heartbeat_age_seconds gauge\n";
+    std::string stalls;
+    int64_t now = NowMs();
+    for (size_t index = 0; index < MAX_HEARTBEATS; ++index) {
+        const Slot& slot = slots[index];
+        int state = slot.state.load(std::memory_order_acquire);
+        if (state != BUSY && state != IDLE) {
+            continue;
+        }
+        const char* name = slot.name.load();
+        unsigned long threadId = slot.threadId.load();
+        double age = state == BUSY ? (now - slot.lastBeatMs.load()) / 1000.0 : 0.0;
+        std::snprintf(line, sizeof(line), "perception_heartbeat_age_seconds{thread=\"%s\",tid=\"%lu\"} %.3f\n",
+                      name, threadId, age);
+        out += line;
+        std::snprintf(line, sizeof(line), "perception_heartbeat_stalls_total{thread=\"%s\",tid=\"%lu\"} %llu\n",
+                      name, threadId, static_cast<unsigned long long>(slot.stalls.load()));
+        stalls += line;
+    }
+    out += "# HELP perception_heartbeat_stalls_total Stalls per live thread\n";
+    out += "# TYPE perception_heartbeat_stalls_total counter\n";
+    out += stalls;
+    return out;
+}
+
+void Watchdog::Write(JsonWriter& writer) const {
+    int64_t now = NowMs();
+    writer.BeginObject();
+    writer.Key("stalls").UInt(totalStalls.load());
+    writer.Key("dumps").Int(dumpsWritten.load());
+    writer.Key("heartbeats").BeginArray();
+    for (size_t index = 0; index < MAX_HEARTBEATS; ++index) {
+        const Slot& slot = slots[index];
+        int state = slot.state.load(std::memory_order_acquire);
+        if (state != BUSY && state != IDLE) {
+            continue;
+        }
+        const char* activity = slot.activity.load();
+        writer.BeginObject();
+        writer.Key("thread").String(slot.name.load());
+        writer.Key("group").String(slot.group.load());
+        writer.Key("threadId").UInt(slot.threadId.load());
+        writer.Key("state").String(StateName(state));
+        writer.Key("activity");
+        if (activity) {
+            writer.String(activity);
+        } else {
+            writer.Null();
+        }
+        writer.Key("ageMs").Int(now - slot.lastBeatMs.load());
+        writer.Key("timeoutMs").Int(slot.timeoutMs.load());
+        writer.Key("stalls").UInt(slot.stalls.load());
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
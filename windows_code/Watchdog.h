@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class JsonWriter;
+
+/**
+ * Watchdog - Heartbeats for long-lived threads and a stall detector
+ *
+ * A wedged thread used to be invisible: /context just stopped changing
+ * until someone noticed. Every long-lived loop now owns a Heartbeat and
+ * beats once per iteration; a watchdog thread checks them every
+ * CHECK_INTERVAL_MS and flags any busy heartbeat older than its timeout.
+ *
+ * On a stall (once per episode, until the thread beats again):
+ *   - an error is logged with the thread, how long it has been silent and
+ *     the activity it last declared, followed by every other heartbeat's
+ *     activity and age - the thread holding the lock the stalled one waits
+ *     on is the other one that stopped beating
+ *   - a minidump with every thread's stack and handle data is written to
+ *     the dump directory (at most MAX_DUMPS per process), for
+ *     "~*k" / "!locks" in WinDbg
+ *   - the stall handler registered for the heartbeat's group, if any, is
+ *     run on its own thread (e.g. to replace the wedged engine)
+ *
+ * A thread that blocks waiting for work calls Idle() first, so an empty
+ * queue isn't a stall; the next Beat() makes it busy again.
+ *
+ * Usage:
+ *   void AsyncWhisperQueue::WorkerThread(Worker* worker) {
+ *       Watchdog::Heartbeat heartbeat("whisper_worker", "voice", 120000);
+ *       while (running) {
+ *           heartbeat.Idle();
+ *           cv.wait(lock, ...);
+ *           heartbeat.Beat("transcribe");
+ *           ...
+ *       }
+ *   }
+ *
+ *   Watchdog::Instance().SetStallHandler("voice", [](const char* thread) { RestartVoice(); });
+ *
+ * Beat() and Idle() are two relaxed atomic stores. Names, groups and
+ * activities must be string literals (stored by pointer).
+ */
+class Watchdog {
+public:
+    static constexpr size_t MAX_HEARTBEATS = 64;
+    static constexpr int CHECK_INTERVAL_MS = 500;
+    static constexpr int MAX_DUMPS = 3;
+
+    using StallHandler = std::function<void(const char* thread)>;
+
+    class Heartbeat {
+    public:
+        // Registers the calling thread; busy from now on
+        Heartbeat(const char* name, const char* group, int timeoutMs);
+        ~Heartbeat();
+
+        Heartbeat(const Heartbeat&) = delete;
+        Heartbeat& operator=(const Heartbeat&) = delete;
+
+        // Progress; activity is reported if the thread stalls before the next beat
+        void Beat(const char* activity = nullptr);
+
+        // Blocked waiting for work: not a stall however long it takes
+        void Idle();
+
+    private:
+        int slot;                   // -1 when every slot was taken (the thread goes unwatched)
+    };
+
+    static Watchdog& Instance();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    // Where stall minidumps go (created on demand); empty disables dumps
+    void SetDumpDirectory(const std::string& directory);
+
+    // Called (on a new thread) when a heartbeat of `group` stalls; one
+    // handler runs per group at a time. nullptr removes it
+    void SetStallHandler(const char* group, StallHandler handler);
+
+    uint64_t GetStallCount() const { return totalStalls.load(); }
+
+    // Prometheus text exposition format: stall counters and heartbeat ages
+    std::string FormatPrometheus() const;
+
+    // {"stalls":N,"dumps":N,"heartbeats":[{"thread","group","threadId","state","activity","ageMs","timeoutMs","stalls"}]}
+    void Write(JsonWriter& writer) const;
+
+private:
+    enum SlotState : int { FREE, CLAIMED, BUSY, IDLE };
+
+    // Identity fields are atomics too: the watchdog may read a slot while it is being reused
+    struct Slot {
+        std::atomic<int> state{FREE};
+        std::atomic<const char*> name{""};
+        std::atomic<const char*> group{""};
+        std::atomic<int> timeoutMs{0};
+        std::atomic<uint32_t> threadId{0};
+        std::atomic<int64_t> lastBeatMs{0};
+        std::atomic<const char*> activity{nullptr};
+        std::atomic<uint64_t> stalls{0};
+        bool stalled = false;       // Watchdog thread only
+    };
+
+    Watchdog();                     // Never destroyed (see Instance)
+
+    int Claim(const char* name, const char* group, int timeoutMs);
+    void Release(int slot);
+
+    void WatchdogThread();
+    void ReportStall(size_t index, int64_t ageMs, int64_t nowMs);
+    void WriteDump(const char* name);
+    void RunStallHandler(const char* group, const char* thread);
+
+    static int64_t NowMs();
+    static const char* StateName(int state);
+
+    Slot slots[MAX_HEARTBEATS];
+    std::atomic<uint64_t> totalStalls{0};
+    std::atomic<int> dumpsWritten{0};
+
+    std::mutex configMutex;
+    std::string dumpDirectory;
+    std::map<std::string, StallHandler> stallHandlers;
+    std::map<std::string, bool> handlersRunning;
+
+    std::thread watcher;
+};
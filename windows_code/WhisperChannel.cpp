@@ -0,0 +1,82 @@
+#include "WhisperChannel.h"
+#include "Log.h"
+#include <cstring>
+
+WhisperChannel::WhisperChannel()
+    : mapping(nullptr), base(nullptr), requestEvent(nullptr), responseEvent(nullptr) {
+}
+
+WhisperChannel::~WhisperChannel() {
+    Close();
+}
+
+bool WhisperChannel::Create(const std::string& name) {
+    Close();
+
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                 0, static_cast<DWORD>(MAPPING_SIZE), name.c_str());
+    requestEvent = CreateEventA(nullptr, FALSE, FALSE, (name + ".request").c_str());
+    responseEvent = CreateEventA(nullptr, FALSE, FALSE, (name + ".response").c_str());
+    if (!mapping || !requestEvent || !responseEvent) {
+        LOG_ERROR("WhisperChannel", "Cannot create " << name << ": " << GetLastError());
+        Close();
+        return false;
+    }
+    base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, MAPPING_SIZE));
+    if (!base) {
+        LOG_ERROR("WhisperChannel", "MapViewOfFile failed: " << GetLastError());
+        Close();
+        return false;
+    }
+
+    std::memset(base, 0, sizeof(Header));
+    Header* header = GetHeader();
+    header->version = VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, "NVWC", 4);
+    return true;
+}
+
+bool WhisperChannel::Open(const std::string& name) {
+    Close();
+
+    mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    requestEvent = OpenEventA(SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, (name + ".request").c_str());
+    responseEvent = OpenEventA(SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, (name + ".response").c_str());
+    if (!mapping || !requestEvent || !responseEvent) {
+        LOG_ERROR("WhisperChannel", "Cannot open " << name << ": " << GetLastError());
+        Close();
+        return false;
+    }
+    base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, MAPPING_SIZE));
+    if (!base || std::memcmp(GetHeader()->magic, "NVWC", 4) != 0 || GetHeader()->version != VERSION) {
+        LOG_ERROR("WhisperChannel", name << " is not a version " << VERSION << " whisper channel");
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void WhisperChannel::Close() {
+    if (base) {
+        UnmapViewOfFile(base);
+        base = nullptr;
+    }
+    for (HANDLE* handle : { &mapping, &requestEvent, &responseEvent }) {
+        if (*handle) {
+            CloseHandle(*handle);
+            *handle = nullptr;
+        }
+    }
+}
+
+void WhisperChannel::Reset() {
+    if (!base) {
+        return;
+    }
+    ResetEvent(requestEvent);
+    ResetEvent(responseEvent);
+    Header* header = GetHeader();
+    header->abort.store(0);
+    header->ready.store(0);
+}
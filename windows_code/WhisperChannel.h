@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <windows.h>
+
+/**
+ * WhisperChannel - One whisper job at a time between the engine and a worker process
+ *
+ * A whisper worker process (InferenceWorker, --whisper-worker) serves one
+ * AsyncWhisperQueue worker through a named mapping and two auto-reset
+ * events. The engine copies the utterance and the prompt into the mapping
+ * and signals the request; the worker decodes straight out of the mapping,
+ * writes the text and the tail tokens back and signals the response. No
+ * pipe, no serialization: a 30 s utterance is one memcpy each way.
+ *
+ * Layout: Header (64 bytes), then MAX_SAMPLES floats of audio, MAX_TOKENS
+ * prompt tokens, MAX_TOKENS tail tokens and MAX_TEXT_BYTES of UTF-8 (the
+ * text, then each rejected segment NUL-terminated).
+ *
+ * Liveness: the worker bumps heartbeat from whisper's abort callback, which
+ * ggml polls between graph nodes, so a decode that stops advancing it is
+ * hung, not slow. abort is the other direction: the engine sets it to stop
+ * the decode in progress (shutdown, a marginal utterance giving way).
+ *
+ * Usage (engine):                          Usage (worker):
+ *   channel.Create(name);                    channel.Open(name);
+ *   ...fill request...                       WaitForSingleObject(channel.RequestEvent(), ...);
+ *   SetEvent(channel.RequestEvent());        ...decode, fill response...
+ *   WaitForSingleObject(channel.ResponseEvent(), ...);   SetEvent(channel.ResponseEvent());
+ */
+class WhisperChannel {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t MAX_SAMPLES = 16000 * 30;      // One whisper window
+    static constexpr size_t MAX_TOKENS = 256;
+    static constexpr size_t MAX_TEXT_BYTES = 8192;
+
+    struct Header {
+        char magic[4];                      // "NVWC" once the layout is written
+        uint32_t version;
+        std::atomic<uint64_t> heartbeat;    // Worker: advanced while it decodes
+        std::atomic<uint32_t> abort;        // Engine: stop the decode in progress
+        std::atomic<uint32_t> ready;        // Worker: models loaded and warm
+        // Request (engine -> worker)
+        uint32_t model;
+        uint32_t sampleCount;
+        uint32_t promptCount;
+        int32_t threads;
+        // Response (worker -> engine)
+        uint32_t ok;                        // Decoded to the end
+        uint32_t textBytes;
+        uint32_t rejectedBytes;             // After the text: rejected segments, NUL-terminated
+        uint32_t tailCount;
+        uint8_t reserved[8];
+    };
+
+    static_assert(sizeof(Header) == 64, "Header layout is shared with the worker process");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "The heartbeat must be lock-free across processes");
+
+    WhisperChannel();
+    ~WhisperChannel();
+
+    WhisperChannel(const WhisperChannel&) = delete;
+    WhisperChannel& operator=(const WhisperChannel&) = delete;
+
+    // Engine: create the mapping and the events, layout written
+    bool Create(const std::string& name);
+    // Worker: attach to the engine's mapping and events
+    bool Open(const std::string& name);
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+
+    // Engine, before (re)starting a worker: no stale signal, flag or readiness
+    void Reset();
+
+    Header* GetHeader() const { return reinterpret_cast<Header*>(base); }
+    float* Samples() const { return reinterpret_cast<float*>(base + SAMPLES_OFFSET); }
+    int32_t* Prompt() const { return reinterpret_cast<int32_t*>(base + PROMPT_OFFSET); }
+    int32_t* Tail() const { return reinterpret_cast<int32_t*>(base + TAIL_OFFSET); }
+    char* Text() const { return reinterpret_cast<char*>(base + TEXT_OFFSET); }
+
+    HANDLE RequestEvent() const { return requestEvent; }
+    HANDLE ResponseEvent() const { return responseEvent; }
+
+private:
+    static constexpr size_t SAMPLES_OFFSET = sizeof(Header);
+    static constexpr size_t PROMPT_OFFSET = SAMPLES_OFFSET + MAX_SAMPLES * sizeof(float);
+    static constexpr size_t TAIL_OFFSET = PROMPT_OFFSET + MAX_TOKENS * sizeof(int32_t);
+    static constexpr size_t TEXT_OFFSET = TAIL_OFFSET + MAX_TOKENS * sizeof(int32_t);
+    static constexpr size_t MAPPING_SIZE = TEXT_OFFSET + MAX_TEXT_BYTES;
+
+    HANDLE mapping;
+    uint8_t* base;
+    HANDLE requestEvent;
+    HANDLE responseEvent;
+};
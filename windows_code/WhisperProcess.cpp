@@ -0,0 +1,181 @@
+#include "WhisperProcess.h"
+#include "Log.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+// Unique per queue worker across every queue of the process (session engines too)
+std::string NextChannelName() {
+    static std::atomic<uint32_t> next{0};
+    return "Local\\NovaPerceptionWhisper." + std::to_string(GetCurrentProcessId()) + "." +
+           std::to_string(next.fetch_add(1));
+}
+
+std::vector<std::string> WorkerArguments(const std::string& channelName, const WhisperProcess::Options& options) {
+    std::vector<std::string> arguments = { "--whisper-worker", channelName,
+                                           std::to_string(GetCurrentProcessId()), std::to_string(options.gpu) };
+    arguments.insert(arguments.end(), options.modelPaths.begin(), options.modelPaths.end());
+    return arguments;
+}
+
+}  // namespace
+
+WhisperProcess::WhisperProcess(const Options& options)
+    : channelName(NextChannelName())
+    , process("whisper", WorkerArguments(channelName, options))
+    , ready(false)
+{
+    channel.Create(channelName);
+}
+
+WhisperProcess::~WhisperProcess() {
+    process.Stop();
+}
+
+bool WhisperProcess::Start(const WhisperTranscriber::Request* abortSource) {
+    if (process.IsRunning()) {
+        if (ready) {
+            return true;
+        }
+    } else {
+        ready = false;
+        channel.Reset();
+        if (!channel.IsOpen() || !process.EnsureRunning()) {
+            return false;
+        }
+    }
+
+    // The child signals the response event once its models are loaded and warm
+    auto start = std::chrono::steady_clock::now();
+    Wait wait = WaitForResponse(abortSource, LOAD_TIMEOUT_MS);
+    if (wait == Wait::Signalled && channel.GetHeader()->ready.load()) {
+        ready = true;
+        LOG_INFO("WhisperProcess", "Worker (pid " << process.GetProcessId() << ") ready after "
+                 << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+                 << "ms");
+        return true;
+    }
+    if (wait == Wait::Aborted) {
+        process.Stop();             // Shutdown during the load: nothing failed
+    } else if (wait == Wait::Exited || wait == Wait::Signalled) {
+        if (process.IsRunning()) {
+            process.Fail(InferenceSupervisor::Failure::Crash);     // Signalled without loading
+        }
+    } else {
+        process.Fail(InferenceSupervisor::Failure::Hang);
+    }
+    return false;
+}
+
+void WhisperProcess::Stop() {
+    process.Stop();
+    ready = false;
+}
+
+WhisperTranscriber::Result WhisperProcess::Transcribe(size_t model, const WhisperTranscriber::Request& request,
+                                                      int threads) {
+    WhisperTranscriber::Result result;
+    // A crash costs a restart and a second decode, not the utterance; twice is the audio's fault
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (!Start(&request)) {
+            return result;
+        }
+        if (RunOnce(model, request, threads, result) != Outcome::Crashed) {
+            return result;
+        }
+        LOG_WARNING("WhisperProcess", "Worker crashed mid-decode" << (attempt == 0 ? "; decoding again" : ""));
+    }
+    return result;
+}
+
+WhisperProcess::Outcome WhisperProcess::RunOnce(size_t model, const WhisperTranscriber::Request& request,
+                                                int threads, WhisperTranscriber::Result& result) {
+    WhisperChannel::Header* header = channel.GetHeader();
+
+    // Request: the audio (one window at most) and the newest prompt tokens
+    size_t samples = (std::min)(request.count, WhisperChannel::MAX_SAMPLES);
+    std::memcpy(channel.Samples(), request.samples, samples * sizeof(float));
+    size_t promptCount = 0;
+    if (request.prompt) {
+        promptCount = (std::min)(request.prompt->size(), WhisperChannel::MAX_TOKENS);
+        std::memcpy(channel.Prompt(), request.prompt->data() + request.prompt->size() - promptCount,
+                    promptCount * sizeof(int32_t));
+    }
+    header->model = static_cast<uint32_t>(model);
+    header->sampleCount = static_cast<uint32_t>(samples);
+    header->promptCount = static_cast<uint32_t>(promptCount);
+    header->threads = threads;
+    header->ok = 0;
+    header->abort.store(0);
+    SetEvent(channel.RequestEvent());      // A full barrier: the request is visible before the signal
+
+    switch (WaitForResponse(&request, HANG_MS)) {
+    case Wait::Signalled:
+        break;
+    case Wait::Exited:
+        process.IsRunning();               // Reaped and counted as a crash
+        ready = false;
+        return Outcome::Crashed;
+    case Wait::Stalled:
+    case Wait::Aborted:
+        process.Fail(InferenceSupervisor::Failure::Hang);
+        ready = false;
+        return Outcome::Failed;
+    }
+
+    // Response: text, then the rejected segments, then the tail tokens
+    const char* text = channel.Text();
+    size_t textBytes = (std::min)(static_cast<size_t>(header->textBytes), WhisperChannel::MAX_TEXT_BYTES);
+    size_t rejectedBytes = (std::min)(static_cast<size_t>(header->rejectedBytes),
+                                      WhisperChannel::MAX_TEXT_BYTES - textBytes);
+    result.ok = header->ok != 0;
+    result.text.assign(text, textBytes);
+    for (size_t offset = textBytes; offset < textBytes + rejectedBytes;) {
+        size_t length = strnlen(text + offset, textBytes + rejectedBytes - offset);
+        result.rejected.emplace_back(text + offset, length);
+        offset += length + 1;
+    }
+    size_t tailCount = (std::min)(static_cast<size_t>(header->tailCount), WhisperChannel::MAX_TOKENS);
+    result.tailTokens.assign(channel.Tail(), channel.Tail() + tailCount);
+    process.MarkHealthy();
+    return Outcome::Done;
+}
+
+WhisperProcess::Wait WhisperProcess::WaitForResponse(const WhisperTranscriber::Request* abortSource, int timeoutMs) {
+    WhisperChannel::Header* header = channel.GetHeader();
+    HANDLE handles[2] = { channel.ResponseEvent(), process.GetHandle() };
+    uint64_t beat = header->heartbeat.load();
+    auto lastBeat = std::chrono::steady_clock::now();
+    auto abortedAt = lastBeat;
+    bool aborting = false;
+
+    for (;;) {
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, POLL_MS);
+        if (wait == WAIT_OBJECT_0) {
+            return Wait::Signalled;
+        }
+        if (wait != WAIT_TIMEOUT) {
+            return Wait::Exited;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (!aborting && abortSource && abortSource->abortCheck && abortSource->abortCheck(abortSource->hookData)) {
+            header->abort.store(1);
+            aborting = true;
+            abortedAt = now;
+        }
+        uint64_t current = header->heartbeat.load();
+        if (current != beat) {
+            beat = current;
+            lastBeat = now;
+        }
+        if (aborting && now - abortedAt >= std::chrono::milliseconds(ABORT_GRACE_MS)) {
+            return Wait::Aborted;
+        }
+        if (now - lastBeat >= std::chrono::milliseconds(timeoutMs)) {
+            return Wait::Stalled;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "InferenceSupervisor.h"
+#include "WhisperChannel.h"
+#include "WhisperTranscriber.h"
+#include <string>
+#include <vector>
+
+/**
+ * WhisperProcess - An AsyncWhisperQueue worker's decoder in a child process
+ *
+ * The engine side of one whisper worker process: its supervised child
+ * (InferenceSupervisor, kind "whisper") and the WhisperChannel they share.
+ * Transcribe() takes the same Request as WhisperTranscriber and returns the
+ * same Result, so the queue decodes in or out of process with one call:
+ *
+ *   - The child loads every model tier itself and warms each up before it
+ *     reports ready; Start() waits for that (at most LOAD_TIMEOUT_MS).
+ *   - While the child decodes, the request's abortCheck is polled every
+ *     POLL_MS; when it says stop, the channel's abort flag tells the child.
+ *   - A child that exits mid-decode crashed: it is restarted and the audio
+ *     decoded once more. One whose heartbeat stalls for HANG_MS, or that
+ *     ignores an abort for ABORT_GRACE_MS, is terminated as hung and the
+ *     decode fails (ok = false).
+ *
+ * The request's encoder-begin and segment hooks and precomputed mel frames
+ * stay in this process; the child decodes from the samples.
+ *
+ * One owner thread (its queue worker) at a time.
+ */
+class WhisperProcess {
+public:
+    static constexpr int POLL_MS = 20;
+    static constexpr int HANG_MS = 30000;
+    static constexpr int ABORT_GRACE_MS = 5000;
+    static constexpr int LOAD_TIMEOUT_MS = 120000;
+
+    // What the child loads: the queue's model tiers, in order
+    struct Options {
+        std::vector<std::string> modelPaths;
+        int gpu = -1;                   // whisper gpu_device; -1: CPU
+    };
+
+    explicit WhisperProcess(const Options& options);
+    ~WhisperProcess();
+
+    WhisperProcess(const WhisperProcess&) = delete;
+    WhisperProcess& operator=(const WhisperProcess&) = delete;
+
+    /**
+     * @brief Start the child unless it runs, and wait until it is warm
+     * @return false when it can't start (backing off after failures) or failed to load
+     */
+    bool Start(const WhisperTranscriber::Request* abortSource = nullptr);
+
+    // End the child (idle scale-down); the next Start() or Transcribe() starts another
+    void Stop();
+
+    bool IsRunning() { return process.IsRunning() && ready; }
+
+    WhisperTranscriber::Result Transcribe(size_t model, const WhisperTranscriber::Request& request, int threads);
+
+private:
+    enum class Outcome { Done, Crashed, Failed };
+    Outcome RunOnce(size_t model, const WhisperTranscriber::Request& request, int threads,
+                    WhisperTranscriber::Result& result);
+    // Wait for the response event while the child lives; polls the abort hook
+    // (if any) and gives up after timeoutMs without a heartbeat, or ABORT_GRACE_MS
+    // after asking the child to abort
+    enum class Wait { Signalled, Exited, Stalled, Aborted };
+    Wait WaitForResponse(const WhisperTranscriber::Request* abortSource, int timeoutMs);
+
+    std::string channelName;
+    WhisperChannel channel;
+    InferenceSupervisor::Process process;
+    bool ready;
+};
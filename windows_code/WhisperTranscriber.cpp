@@ -0,0 +1,184 @@
+#include "WhisperTranscriber.h"
+#include "Deflate.h"
+#include "Trace.h"
+#include <algorithm>
+#include <string_view>
+#include <vector>
+#include "whisper.h"
+
+WhisperTranscriber::WhisperTranscriber(int threads)
+    : baseParams(std::make_unique<whisper_full_params>(whisper_full_default_params(WHISPER_SAMPLING_GREEDY)))
+    , threads(threads > 0 ? threads : 1) {
+    whisper_full_params& params = *baseParams;
+    params.language = "en";
+    params.n_threads = threads;
+    params.print_progress = false;
+    params.print_special = false;
+    params.print_realtime = false;
+    params.print_timestamps = false;
+    params.translate = false;
+    params.no_context = true;       // Context comes from the caller's prompt only
+    params.single_segment = true;
+    params.no_timestamps = true;
+    params.suppress_nst = true;     // No "[BLANK_AUDIO]" / "(music)" annotations
+    params.greedy.best_of = 1;
+}
+
+WhisperTranscriber::~WhisperTranscriber() = default;
+
+int WhisperTranscriber::AudioContextFor(size_t samples) {
+    // The encoder runs at 50 positions per second (16 kHz / 320)
+    const size_t needed = samples / 320 + AUDIO_CTX_MARGIN;
+    for (int bucket : AUDIO_CTX_BUCKETS) {
+        if (needed <= static_cast<size_t>(bucket)) {
+            return bucket;
+        }
+    }
+    return 0;
+}
+
+WhisperTranscriber::Result WhisperTranscriber::Transcribe(whisper_context* ctx, whisper_state* state,
+                                                          const Request& request) const {
+    TRACE_ZONE("WhisperTranscriber::Transcribe");
+    Result result;
+    if (!ctx || !state || !request.samples || request.count == 0) {
+        return result;
+    }
+
+    // Copy of the tuned base: only the per-decode fields change
+    whisper_full_params params = *baseParams;
+    params.n_threads = threads.load(std::memory_order_relaxed);
+    params.audio_ctx = AudioContextFor(request.count);
+    params.encoder_begin_callback = request.encoderBegin;
+    params.encoder_begin_callback_user_data = request.hookData;
+    params.abort_callback = request.abortCheck;
+    params.abort_callback_user_data = request.hookData;
+    if (request.prompt && !request.prompt->empty()) {
+        params.prompt_tokens = request.prompt->data();
+        params.prompt_n_tokens = static_cast<int>(request.prompt->size());
+    }
+    SegmentRelay relay{ this, &request, whisper_token_eot(ctx) };
+    if (request.segment && request.count >= SEGMENTED_MIN_SAMPLES) {
+        params.single_segment = false;
+        params.no_timestamps = false;
+        params.new_segment_callback = &WhisperTranscriber::OnNewSegment;
+        params.new_segment_callback_user_data = &relay;
+    }
+
+    // Frames computed during capture: whisper decodes them instead of its own pass
+    const float* samples = request.samples;
+    int count = static_cast<int>(request.count);
+    if (request.mel && request.mel->samples == request.count && request.mel->bands == whisper_model_n_mels(ctx)) {
+        // The encoder reads 2 x audio_ctx frames; past the audio whisper pads with silence
+        thread_local std::vector<float> melLayout;      // Per worker, reused across decodes
+        const int window = 2 * (params.audio_ctx > 0 ? params.audio_ctx : FULL_AUDIO_CTX);
+        const size_t frames = LogMelSpectrogram::ToWhisperLayout(*request.mel, window, melLayout);
+        if (whisper_set_mel_with_state(ctx, state, melLayout.data(), static_cast<int>(frames),
+                                       request.mel->bands) == 0) {
+            params.duration_ms = static_cast<int>(LogMelSpectrogram::WhisperFrameCount(request.count) * 10);
+            samples = nullptr;
+            count = 0;
+        }
+    }
+
+    if (whisper_full_with_state(ctx, state, params, samples, count) != 0) {
+        return result;
+    }
+    result.ok = true;
+
+    // Extract transcription, minus the segments that look hallucinated
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    const whisper_token eot = whisper_token_eot(ctx);
+    std::vector<int> keptSegments;
+
+    for (int i = 0; i < n_segments; ++i) {
+        const char* text = whisper_full_get_segment_text_from_state(state, i);
+        if (!text) {
+            continue;
+        }
+        if (IsHallucinatedSegment(state, i, eot, text)) {
+            result.rejected.emplace_back(text);
+            continue;
+        }
+        result.text += text;
+        keptSegments.push_back(i);
+    }
+
+    // Tail of the kept text tokens, for the caller to prompt the next decode with
+    for (int i : keptSegments) {
+        const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+        for (int j = 0; j < n_tokens; ++j) {
+            whisper_token id = whisper_full_get_token_id_from_state(state, i, j);
+            if (id < eot) {
+                result.tailTokens.push_back(id);
+            }
+        }
+    }
+    if (result.tailTokens.size() > PROMPT_TAIL_TOKENS) {
+        result.tailTokens.erase(result.tailTokens.begin(), result.tailTokens.end() - PROMPT_TAIL_TOKENS);
+    }
+
+    // Trim whitespace
+    size_t start = result.text.find_first_not_of(" \t\n\r");
+    size_t end = result.text.find_last_not_of(" \t\n\r");
+    if (start == std::string::npos) {
+        result.text.clear();
+    } else {
+        result.text = result.text.substr(start, end - start + 1);
+    }
+
+    return result;
+}
+
+void WhisperTranscriber::OnNewSegment(whisper_context*, whisper_state* state, int newSegments, void* userData) {
+    const SegmentRelay& relay = *static_cast<const SegmentRelay*>(userData);
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = (std::max)(0, n_segments - newSegments); i < n_segments; ++i) {
+        const char* text = whisper_full_get_segment_text_from_state(state, i);
+        if (!text || relay.transcriber->IsHallucinatedSegment(state, i, relay.eot, text)) {
+            continue;
+        }
+        // Timestamps are in 10 ms units
+        relay.request->segment(text, whisper_full_get_segment_t0_from_state(state, i) * 10,
+                               whisper_full_get_segment_t1_from_state(state, i) * 10, relay.request->hookData);
+    }
+}
+
+bool WhisperTranscriber::IsHallucinatedSegment(whisper_state* state, int segment, int32_t eot,
+                                               const char* text) const {
+    // Mean logprob of the text tokens (timestamps and specials carry no meaning here)
+    double logprobSum = 0.0;
+    int textTokens = 0;
+    const int n_tokens = whisper_full_n_tokens_from_state(state, segment);
+    for (int j = 0; j < n_tokens; ++j) {
+        whisper_token_data data = whisper_full_get_token_data_from_state(state, segment, j);
+        if (data.id < eot) {
+            logprobSum += data.plog;
+            textTokens++;
+        }
+    }
+    if (textTokens == 0) {
+        return true;
+    }
+    const float meanLogprob = static_cast<float>(logprobSum / textTokens);
+
+    // Whisper's own silence verdict: no speech, and nothing it was sure about
+    const float noSpeechProb = whisper_full_get_segment_no_speech_prob_from_state(state, segment);
+    if (noSpeechProb > NO_SPEECH_THRESHOLD && meanLogprob < LOGPROB_THRESHOLD) {
+        return true;
+    }
+    if (meanLogprob < MIN_MEAN_LOGPROB) {
+        return true;
+    }
+
+    // Decoder loops ("Thank you. Thank you. Thank you...") compress far better than speech
+    std::string_view view(text);
+    if (view.size() >= 32) {
+        std::string compressed = Deflate::Compress(view, Deflate::Container::Raw);
+        if (!compressed.empty() &&
+            static_cast<float>(view.size()) / static_cast<float>(compressed.size()) > MAX_COMPRESSION_RATIO) {
+            return true;
+        }
+    }
+    return false;
+}
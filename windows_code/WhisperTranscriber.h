@@ -0,0 +1,132 @@
+#pragma once
+
+#include "LogMelSpectrogram.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Forward declarations for whisper.cpp
+struct whisper_context;
+struct whisper_state;
+struct whisper_full_params;
+
+/**
+ * WhisperTranscriber - The one whisper_full configuration every decode uses
+ *
+ * AudioCaptureEngine and AsyncWhisperQueue each used to build their own
+ * whisper_full_default_params() per utterance, with settings that had
+ * drifted apart. The tuned parameter set is now built once, here, and each
+ * call only fills in what varies per decode (prompt, hooks, audio_ctx):
+ *
+ *   - Greedy, best_of 1: no extra candidates per temperature step
+ *   - single_segment + no_timestamps: utterances are short (VAD-cut, chunked
+ *     at 10 s) and nobody reads the timestamps, so none are decoded. A
+ *     request with a segment hook is the exception from SEGMENTED_MIN_SAMPLES
+ *     on: whisper then segments at timestamps and reports each segment as it
+ *     is decoded, so the start of a long utterance is out seconds before the
+ *     whole of it
+ *   - audio_ctx sized to the utterance (AudioContextFor): the encoder only
+ *     runs over the part of the 30 s window that holds audio. The size is
+ *     rounded up to one of AUDIO_CTX_BUCKETS, so a worker's compute buffers
+ *     are sized for a handful of graph shapes and stop reallocating once
+ *     each has been seen; a typical 2 s command encodes 256 positions of 1500
+ *   - suppress_nst: no "[BLANK_AUDIO]" / "(music)" annotations
+ *
+ * A request may bring the audio's log-mel frames, computed by the capture
+ * path as the speech arrived (LogMelSpectrogram). They go to whisper through
+ * whisper_set_mel_with_state() and whisper_full() gets no samples, so it
+ * skips its own spectrogram pass; duration_ms keeps the decode to the audio
+ * rather than the silence padding. Frames for another band count (a model
+ * tier with 128 mel bands) fall back to the samples.
+ *
+ * The result keeps only segments that pass the hallucination filter: a
+ * segment is dropped when whisper thinks there was no speech and the text
+ * is unlikely (no_speech_prob above NO_SPEECH_THRESHOLD with mean token
+ * logprob below LOGPROB_THRESHOLD), when the text is very unlikely on its
+ * own (MIN_MEAN_LOGPROB), or when it repeats itself (compression ratio above
+ * MAX_COMPRESSION_RATIO).
+ *
+ * Thread-safe: Transcribe() is const; each caller brings its own whisper_state.
+ * SetThreads() changes n_threads from the next decode on (power profiles).
+ *
+ * Usage:
+ *   WhisperTranscriber transcriber(threadsPerWorker);
+ *   WhisperTranscriber::Request request;
+ *   request.samples = audio.data();
+ *   request.count = audio.size();
+ *   WhisperTranscriber::Result result = transcriber.Transcribe(context, state, request);
+ */
+class WhisperTranscriber {
+public:
+    // whisper_encoder_begin_callback / ggml_abort_callback
+    using EncoderBeginHook = bool (*)(whisper_context* ctx, whisper_state* state, void* userData);
+    using AbortHook = bool (*)(void* userData);
+    // A kept segment as soon as it is decoded; times are ms from the start of the audio
+    using SegmentHook = void (*)(const char* text, int64_t startMs, int64_t endMs, void* userData);
+
+    struct Request {
+        const float* samples = nullptr;     // 16 kHz mono
+        size_t count = 0;
+        const LogMelSpectrogram::Frames* mel = nullptr; // Precomputed frames of the samples, if any
+        const std::vector<int32_t>* prompt = nullptr;   // Tokens decoded as prior context
+        EncoderBeginHook encoderBegin = nullptr;        // False: skip the decode
+        AbortHook abortCheck = nullptr;                 // True: stop mid-decode
+        SegmentHook segment = nullptr;                  // Progressive segments (long audio only)
+        void* hookData = nullptr;
+    };
+
+    struct Result {
+        bool ok = false;                    // whisper_full succeeded (not aborted)
+        std::string text;                   // Kept segments, whitespace-trimmed
+        std::vector<int32_t> tailTokens;    // Last PROMPT_TAIL_TOKENS text tokens, for the next prompt
+        std::vector<std::string> rejected;  // Segments the hallucination filter dropped
+    };
+
+    static constexpr size_t PROMPT_TAIL_TOKENS = 64;
+
+    // Shorter audio decodes as one segment even with a segment hook: timestamp
+    // tokens cost more than an early first segment saves
+    static constexpr size_t SEGMENTED_MIN_SAMPLES = 16000 * 8;
+
+    // Hallucination filter thresholds (whisper's own defaults for the first two)
+    static constexpr float NO_SPEECH_THRESHOLD = 0.6f;
+    static constexpr float LOGPROB_THRESHOLD = -1.0f;
+    static constexpr float MIN_MEAN_LOGPROB = -2.0f;
+    static constexpr float MAX_COMPRESSION_RATIO = 2.4f;
+
+    // Encoder context for an utterance: 50 positions per second of audio plus
+    // AUDIO_CTX_MARGIN, rounded up to the next bucket (0 = full window)
+    static constexpr int FULL_AUDIO_CTX = 1500;         // 30 s
+    static constexpr int AUDIO_CTX_MARGIN = 64;         // ~1.3 s, keeps the last words off the edge
+    static constexpr int AUDIO_CTX_BUCKETS[] = { 256, 384, 512, 768, 1024 };   // 5.1 s .. 20.5 s
+    static int AudioContextFor(size_t samples);
+
+    explicit WhisperTranscriber(int threads);
+    ~WhisperTranscriber();
+
+    WhisperTranscriber(const WhisperTranscriber&) = delete;
+    WhisperTranscriber& operator=(const WhisperTranscriber&) = delete;
+
+    Result Transcribe(whisper_context* ctx, whisper_state* state, const Request& request) const;
+
+    // Threads per decode from the next Transcribe() on (at least 1)
+    void SetThreads(int count) { threads.store(count > 0 ? count : 1); }
+    int GetThreads() const { return threads.load(); }
+
+private:
+    // whisper_new_segment_callback: filters the new segments and passes them to the request's hook
+    struct SegmentRelay {
+        const WhisperTranscriber* transcriber;
+        const Request* request;
+        int32_t eot;
+    };
+    static void OnNewSegment(whisper_context* ctx, whisper_state* state, int newSegments, void* userData);
+
+    bool IsHallucinatedSegment(whisper_state* state, int segment, int32_t eot, const char* text) const;
+
+    std::unique_ptr<whisper_full_params> baseParams;
+    std::atomic<int> threads;
+};
@@ -1,7 +1,9 @@
 #include "WindowEventMonitor.h"
+#include "ProcessInfoCache.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 #pragma comment(lib, "user32.lib")
 #pragma comment(lib, "kernel32.lib")
@@ -11,7 +13,11 @@
 WindowEventMonitor* WindowEventMonitor::s_instance = nullptr;
 
 WindowEventMonitor::WindowEventMonitor() 
-    : m_hook(nullptr), m_shellHook(nullptr), m_isRunning(false), m_messageWindow(nullptr) {
+    : m_shellHook(nullptr), m_isRunning(false), m_messageWindow(nullptr), m_messageThreadId(0),
+      m_queueHead(0), m_queueTail(0), m_queueEvent(nullptr), m_droppedEvents(0),
+      m_nameChangeQuietMs(DEFAULT_NAME_CHANGE_QUIET_MS), m_foregroundHwnd(nullptr),
+      m_registryDirty(false), m_registryGeneration(0), m_droppedAtResync(0),
+      m_registrySnapshot(std::make_shared<const WindowRegistrySnapshot>()) {
     s_instance = this;
 }
 
@@ -26,8 +32,19 @@ bool WindowEventMonitor::Start() {
         return false;
     }
 
+    m_queueEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!m_queueEvent) {
+        m_lastError = L"Failed to create event queue signal";
+        return false;
+    }
+    m_queueHead = 0;
+    m_queueTail = 0;
+    m_foregroundHwnd = GetForegroundWindow();
     m_isRunning = true;
 
+    // Worker first, so nothing the hook queues waits for it
+    m_workerThread = std::thread(&WindowEventMonitor::WorkerThread, this);
+
     // 启动消息循环线程
     m_messageThread = std::thread(&WindowEventMonitor::MessageLoopThread, this);
     
@@ -44,21 +61,23 @@ void WindowEventMonitor::Stop() {
 
     m_isRunning = false;
 
-    // 发送退出消息到消息窗口
-    if (m_messageWindow) {
-        PostMessage(m_messageWindow, WM_QUIT, 0, 0);
+    // 发送退出消息到消息循环线程 (it unhooks its own hooks on the way out)
+    if (m_messageThreadId) {
+        PostThreadMessageW(m_messageThreadId, WM_QUIT, 0, 0);
     }
 
     // 等待消息循环线程结束
     if (m_messageThread.joinable()) {
         m_messageThread.join();
     }
+    m_messageThreadId = 0;
 
-    // 清理Hook
-    if (m_hook) {
-        UnhookWinEvent(m_hook);
-        m_hook = nullptr;
+    SetEvent(m_queueEvent);
+    if (m_workerThread.joinable()) {
+        m_workerThread.join();
     }
+    CloseHandle(m_queueEvent);
+    m_queueEvent = nullptr;
 
     if (m_shellHook) {
         UnhookWindowsHookEx(m_shellHook);
@@ -67,6 +86,8 @@ void WindowEventMonitor::Stop() {
 }
 
 void WindowEventMonitor::MessageLoopThread() {
+    m_messageThreadId = GetCurrentThreadId();
+
     // 创建一个隐藏的消息窗口
     const wchar_t* className = L"WindowEventMonitorClass";
     WNDCLASSEXW wc = { 0 }; // 使用Unicode版本
@@ -93,17 +114,26 @@ void WindowEventMonitor::MessageLoopThread() {
     }
 
     // 设置Windows事件Hook - 监控窗口激活和名称变化事件（用于检测Chrome标签页切换）
-    m_hook = SetWinEventHook(
-        EVENT_SYSTEM_FOREGROUND,      // 最小事件
-        EVENT_OBJECT_NAMECHANGE,      // 最大事件（包含窗口标题变化）
-        nullptr,                       // DLL句柄（nullptr表示在调用进程中）
-        WinEventProc,                  // 回调函数
-        0,                            // 进程ID（0表示所有进程）
-        0,                            // 线程ID（0表示所有线程）
-        WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS // 标志，跳过自身进程
-    );
-
-    if (!m_hook) {
+    // One single-event range per event handled: a FOREGROUND..NAMECHANGE
+    // range would also deliver every create, reorder and move system-wide.
+    // Show, hide and destroy keep the window registry current
+    const DWORD hookedEvents[] = { EVENT_SYSTEM_FOREGROUND, EVENT_OBJECT_FOCUS, EVENT_OBJECT_NAMECHANGE,
+                                   EVENT_OBJECT_SHOW, EVENT_OBJECT_HIDE, EVENT_OBJECT_DESTROY };
+    for (DWORD event : hookedEvents) {
+        HWINEVENTHOOK hook = SetWinEventHook(
+            event, event,                  // 事件范围（单个事件）
+            nullptr,                       // DLL句柄（nullptr表示在调用进程中）
+            WinEventProc,                  // 回调函数
+            0,                            // 进程ID（0表示所有进程）
+            0,                            // 线程ID（0表示所有线程）
+            WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS // 标志，跳过自身进程
+        );
+        if (hook) {
+            m_hooks.push_back(hook);
+        }
+    }
+
+    if (m_hooks.empty()) {
         m_lastError = L"Failed to set Windows event hook";
         DestroyWindow(m_messageWindow);
         UnregisterClassW(className, GetModuleHandle(nullptr)); // Unicode版本
@@ -117,6 +147,12 @@ void WindowEventMonitor::MessageLoopThread() {
         DispatchMessage(&msg);
     }
 
+    // 清理Hook (on the thread that set them)
+    for (HWINEVENTHOOK hook : m_hooks) {
+        UnhookWinEvent(hook);
+    }
+    m_hooks.clear();
+
     // 清理窗口
     DestroyWindow(m_messageWindow);
     UnregisterClassW(className, GetModuleHandle(nullptr)); // Unicode版本
@@ -135,25 +171,137 @@ void CALLBACK WindowEventMonitor::WinEventProc(HWINEVENTHOOK hWinEventHook, DWOR
         return;
     }
 
+    if (!hwnd) {
+        return;
+    }
+
+    // Runs on the hook thread: no window queries here, just queue the event
+    // (single producer) and wake the worker if it may be waiting
+    WindowEventMonitor* self = s_instance;
+    size_t head = self->m_queueHead.load(std::memory_order_relaxed);
+    size_t tail = self->m_queueTail.load(std::memory_order_acquire);
+    if (head - tail >= EVENT_QUEUE_SIZE) {
+        self->m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    self->m_queue[head % EVENT_QUEUE_SIZE] = RawEvent{ hwnd, event, eventTime };
+    self->m_queueHead.store(head + 1, std::memory_order_release);
+    if (head == tail) {
+        SetEvent(self->m_queueEvent);
+    }
+}
+
+void WindowEventMonitor::SetNameChangeQuietPeriod(std::chrono::milliseconds quiet) {
+    m_nameChangeQuietMs = quiet.count() > 0 ? static_cast<int>(quiet.count()) : 0;
+}
+
+void WindowEventMonitor::WorkerThread() {
+    // UIA delivers address bar events on its own threads, so an MTA is enough
+    HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    m_tabTracker.Initialize();
+    ResyncRegistry();
+
+    while (m_isRunning) {
+        DWORD wait = FlushNameChanges();
+        PublishRegistry();
+        WaitForSingleObject(m_queueEvent, wait);
+
+        size_t tail = m_queueTail.load(std::memory_order_relaxed);
+        size_t head = m_queueHead.load(std::memory_order_acquire);
+        while (tail != head && m_isRunning) {
+            RawEvent raw = m_queue[tail % EVENT_QUEUE_SIZE];
+            tail++;
+            // Coalesce a run of the same event on the same window (title
+            // updates while a page loads, repeated focus): only the last counts
+            while (tail != head) {
+                const RawEvent& next = m_queue[tail % EVENT_QUEUE_SIZE];
+                if (next.hwnd != raw.hwnd || next.event != raw.event) {
+                    break;
+                }
+                raw = next;
+                tail++;
+            }
+            m_queueTail.store(tail, std::memory_order_release);
+
+            if (IsRegistryEvent(raw.event)) {
+                UpdateRegistry(raw.hwnd, raw.event);
+            } else if (raw.event == EVENT_OBJECT_NAMECHANGE && m_nameChangeQuietMs > 0) {
+                // Hold it back; FlushNameChanges delivers once the title settles
+                auto now = std::chrono::steady_clock::now();
+                auto pending = m_pendingNameChanges.try_emplace(raw.hwnd, PendingNameChange{ now, now });
+                pending.first->second.last = now;
+            } else {
+                HandleEvent(raw.hwnd, raw.event);
+            }
+            head = m_queueHead.load(std::memory_order_acquire);
+        }
+
+        // A lost event may have left the registry stale; so may a long enough time
+        if (m_droppedEvents.load() != m_droppedAtResync ||
+            std::chrono::steady_clock::now() - m_lastResync >= std::chrono::milliseconds(REGISTRY_RESYNC_MS)) {
+            ResyncRegistry();
+        }
+    }
+    m_pendingNameChanges.clear();
+    m_registry.clear();
+
+    m_tabTracker.Shutdown();
+    if (SUCCEEDED(comResult)) {
+        CoUninitialize();
+    }
+}
+
+DWORD WindowEventMonitor::FlushNameChanges() {
+    DWORD wait = 100;
+    if (m_pendingNameChanges.empty()) {
+        return wait;
+    }
+
+    const auto quiet = std::chrono::milliseconds(m_nameChangeQuietMs.load());
+    const auto maxDelay = std::chrono::milliseconds(MAX_NAME_CHANGE_DELAY_MS);
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = m_pendingNameChanges.begin(); it != m_pendingNameChanges.end();) {
+        auto due = (std::min)(it->second.last + quiet, it->second.first + maxDelay);
+        if (due <= now) {
+            HWND hwnd = it->first;
+            it = m_pendingNameChanges.erase(it);
+            HandleEvent(hwnd, EVENT_OBJECT_NAMECHANGE);     // Reads the title as it is now
+        } else {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count() + 1;
+            wait = (std::min)(wait, static_cast<DWORD>(remaining));
+            ++it;
+        }
+    }
+    return wait;
+}
+
+void WindowEventMonitor::HandleEvent(HWND hwnd, DWORD event) {
     // 过滤无效窗口
-    if (!hwnd || !IsWindow(hwnd)) {
+    if (!IsWindow(hwnd)) {
         return;
     }
 
+    if (event == EVENT_SYSTEM_FOREGROUND) {
+        m_foregroundHwnd = hwnd;
+    }
+
     WindowInfo info = GetWindowInfo(hwnd);
+    info.isForeground = (hwnd == m_foregroundHwnd);
+    UpdateRegistryEntry(info);
     
     // 根据事件类型设置事件类型
     switch (event) {
         case EVENT_SYSTEM_FOREGROUND:
         case EVENT_OBJECT_FOCUS:
             info.eventType = WindowEventType::WINDOW_ACTIVATED;
+            if (event == EVENT_SYSTEM_FOREGROUND && IsChromeWindow(hwnd)) {
+                TryGetChromeTabInfo(hwnd, info.tabTitle, info.tabUrl);
+            }
             break;
         case EVENT_OBJECT_NAMECHANGE:
             // 检查是否是Chrome/Edge等浏览器窗口的标题变化（可能是标签页切换）
-            if (s_instance->IsChromeWindow(hwnd)) {
-                std::wstring tabTitle;
-                if (s_instance->TryGetChromeTabInfo(hwnd, tabTitle)) {
-                    info.tabTitle = tabTitle;
+            if (IsChromeWindow(hwnd)) {
+                if (TryGetChromeTabInfo(hwnd, info.tabTitle, info.tabUrl)) {
                     info.eventType = WindowEventType::TAB_ACTIVATED;
                 }
             } else {
@@ -166,7 +314,7 @@ void CALLBACK WindowEventMonitor::WinEventProc(HWINEVENTHOOK hWinEventHook, DWOR
     }
 
     // 触发回调
-    s_instance->TriggerCallbacks(info);
+    TriggerCallbacks(info);
 }
 
 WindowInfo WindowEventMonitor::GetWindowInfo(HWND hwnd) {
@@ -189,42 +337,34 @@ WindowInfo WindowEventMonitor::GetWindowInfo(HWND hwnd) {
 
     // 获取进程名称和路径
     if (info.processId != 0) {
-        info.processName = GetProcessName(info.processId);
-        info.processPath = GetProcessPath(info.processId);
+        ProcessInfoCache::ProcessInfo process;
+        if (ProcessInfoCache::Instance().Lookup(info.processId, process)) {
+            info.processName = process.name;
+            info.processPath = process.path;
+        } else {
+            info.processName = L"Unknown";
+            info.processPath = L"Unknown";
+        }
     }
+    info.category = AppClassifier::Instance().Classify(info.processName, info.windowTitle);
 
     return info;
 }
 
 std::wstring WindowEventMonitor::GetProcessName(DWORD processId) {
-    std::wstring processName = L"Unknown";
-    
-    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
-    if (hProcess) {
-        wchar_t buffer[MAX_PATH]; // Unicode缓冲区
-        if (GetModuleBaseNameW(hProcess, nullptr, buffer, MAX_PATH)) { // Unicode版本
-            processName = buffer;
-        }
-        CloseHandle(hProcess);
+    ProcessInfoCache::ProcessInfo process;
+    if (!ProcessInfoCache::Instance().Lookup(processId, process)) {
+        return L"Unknown";
     }
-    
-    return processName;
+    return process.name;
 }
 
 std::wstring WindowEventMonitor::GetProcessPath(DWORD processId) {
-    std::wstring processPath = L"Unknown";
-    
-    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
-    if (hProcess) {
-        wchar_t buffer[MAX_PATH]; // Unicode缓冲区
-        DWORD size = MAX_PATH;
-        if (QueryFullProcessImageNameW(hProcess, 0, buffer, &size)) { // Unicode版本
-            processPath = buffer;
-        }
-        CloseHandle(hProcess);
+    ProcessInfoCache::ProcessInfo process;
+    if (!ProcessInfoCache::Instance().Lookup(processId, process)) {
+        return L"Unknown";
     }
-    
-    return processPath;
+    return process.path;
 }
 
 void WindowEventMonitor::RegisterCallback(EventCallback callback) {
@@ -254,11 +394,108 @@ WindowInfo WindowEventMonitor::GetActiveWindowInfo() {
 }
 
 std::vector<WindowInfo> WindowEventMonitor::GetAllWindows() {
+    // Generation 0: the worker hasn't made its first scan yet
+    std::shared_ptr<const WindowRegistrySnapshot> registry = GetWindowRegistry();
+    if (m_isRunning && registry->generation != 0) {
+        return registry->windows;
+    }
     std::vector<WindowInfo> windows;
     EnumWindows(EnumWindowsProc, reinterpret_cast<LPARAM>(&windows));
     return windows;
 }
 
+std::shared_ptr<const WindowRegistrySnapshot> WindowEventMonitor::GetWindowRegistry() const {
+    return std::atomic_load(&m_registrySnapshot);
+}
+
+bool WindowEventMonitor::IsRegistryEvent(DWORD event) {
+    return event == EVENT_OBJECT_SHOW || event == EVENT_OBJECT_HIDE || event == EVENT_OBJECT_DESTROY;
+}
+
+// What GetAllWindows lists: visible top-level windows with a title
+bool WindowEventMonitor::IsListedWindow(HWND hwnd) {
+    return IsWindowVisible(hwnd) && GetAncestor(hwnd, GA_PARENT) == GetDesktopWindow() &&
+           GetWindowTextLengthW(hwnd) > 0;
+}
+
+void WindowEventMonitor::UpdateRegistry(HWND hwnd, DWORD event) {
+    if (event != EVENT_OBJECT_SHOW) {
+        // Gone or hidden: nothing to ask the window
+        m_registryDirty = m_registry.erase(hwnd) > 0 || m_registryDirty;
+        return;
+    }
+    if (m_registry.count(hwnd) || !IsListedWindow(hwnd)) {
+        return;
+    }
+    WindowInfo info = GetWindowInfo(hwnd);
+    info.eventType = WindowEventType::WINDOW_CREATED;
+    info.isForeground = (hwnd == m_foregroundHwnd);
+    m_registry.emplace(hwnd, std::move(info));
+    m_registryDirty = true;
+}
+
+// A foreground or title event's fresh details: listed windows are added or
+// refreshed, a window that lost its title is dropped, and the foreground flag moves
+void WindowEventMonitor::UpdateRegistryEntry(const WindowInfo& info) {
+    if (info.isForeground) {
+        for (auto& [hwnd, entry] : m_registry) {
+            if (entry.isForeground && hwnd != info.hwnd) {
+                entry.isForeground = false;
+                m_registryDirty = true;
+            }
+        }
+    }
+    auto it = m_registry.find(info.hwnd);
+    if (info.windowTitle.empty() || !IsWindowVisible(info.hwnd) ||
+        GetAncestor(info.hwnd, GA_PARENT) != GetDesktopWindow()) {
+        if (it != m_registry.end()) {
+            m_registry.erase(it);
+            m_registryDirty = true;
+        }
+        return;
+    }
+    if (it == m_registry.end()) {
+        m_registry.emplace(info.hwnd, info);
+        m_registryDirty = true;
+    } else if (it->second.windowTitle != info.windowTitle || it->second.isForeground != info.isForeground) {
+        it->second.windowTitle = info.windowTitle;
+        it->second.category = info.category;
+        it->second.isForeground = info.isForeground;
+        it->second.timestamp = info.timestamp;
+        m_registryDirty = true;
+    }
+}
+
+void WindowEventMonitor::ResyncRegistry() {
+    m_droppedAtResync = m_droppedEvents.load();
+    m_lastResync = std::chrono::steady_clock::now();
+    std::vector<WindowInfo> windows;
+    EnumWindows(EnumWindowsProc, reinterpret_cast<LPARAM>(&windows));
+    m_registry.clear();
+    for (WindowInfo& info : windows) {
+        info.isForeground = (info.hwnd == m_foregroundHwnd);
+        HWND hwnd = info.hwnd;
+        m_registry.emplace(hwnd, std::move(info));
+    }
+    m_registryDirty = true;
+    PublishRegistry();
+}
+
+void WindowEventMonitor::PublishRegistry() {
+    if (!m_registryDirty) {
+        return;
+    }
+    m_registryDirty = false;
+    auto snapshot = std::make_shared<WindowRegistrySnapshot>();
+    snapshot->windows.reserve(m_registry.size());
+    for (const auto& [hwnd, info] : m_registry) {
+        snapshot->windows.push_back(info);
+        snapshot->countsByProcess[info.processName]++;
+    }
+    snapshot->generation = ++m_registryGeneration;
+    std::atomic_store(&m_registrySnapshot, std::shared_ptr<const WindowRegistrySnapshot>(std::move(snapshot)));
+}
+
 BOOL CALLBACK WindowEventMonitor::EnumWindowsProc(HWND hwnd, LPARAM lParam) {
     if (!IsWindowVisible(hwnd)) {
         return TRUE;  // 跳过不可见窗口
@@ -289,30 +526,14 @@ bool WindowEventMonitor::IsChromeWindow(HWND hwnd) {
     GetWindowThreadProcessId(hwnd, &pid);
     if (pid == 0) return false;
 
-    // 获取进程名称
-    std::wstring processName = GetProcessName(pid);
-    
-    // 转换为小写进行比较
-    for (auto &ch : processName) {
-        ch = towlower(ch);
-    }
-    
-    // 检查是否是Chrome、Edge等浏览器
-    return (processName.find(L"chrome.exe") != std::wstring::npos) ||
-           (processName.find(L"msedge.exe") != std::wstring::npos) ||
-           (processName.find(L"firefox.exe") != std::wstring::npos) ||
-           (processName.find(L"opera.exe") != std::wstring::npos);
+    // By process only: a browser showing a meeting still has an address bar
+    return AppClassifier::Instance().ClassifyProcess(GetProcessName(pid)) == AppCategory::Browser;
 }
 
 // 尝试获取Chrome标签页信息
-bool WindowEventMonitor::TryGetChromeTabInfo(HWND hwnd, std::wstring& tabTitle) {
-    // Chrome会在窗口标题中显示当前活动标签页的标题
-    wchar_t title[1024] = {0};
-    if (GetWindowTextW(hwnd, title, 1023) > 0) { // 使用Unicode版本
-        tabTitle = title;
-        return true;
-    }
-    return false;
+bool WindowEventMonitor::TryGetChromeTabInfo(HWND hwnd, std::wstring& tabTitle, std::wstring& tabUrl) {
+    // Title from the window caption; URL cached from the address bar subscription
+    return m_tabTracker.GetTabInfo(hwnd, tabTitle, tabUrl);
 }
 
 LRESULT CALLBACK WindowEventMonitor::WindowEventProc(int nCode, WPARAM wParam, LPARAM lParam) {
@@ -12,10 +12,14 @@
 #include <chrono>
 #include <thread>
 #include <atomic>
+#include <cstdint>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <comdef.h>
 #include <atlbase.h>
+#include "AppClassifier.h"
+#include "BrowserTabTracker.h"
 
 // 窗口事件类型
 enum class WindowEventType {
@@ -47,16 +51,51 @@ struct WindowInfo {
     // 对于Chrome等浏览器的标签页信息
     std::wstring tabTitle;            // 标签页标题（若可用）
     std::wstring tabUrl;              // 标签页URL（如果可通过UIA/辅助功能获得）
+
+    bool isForeground;                // Window was the foreground window, as of the last foreground event
+    AppCategory category;             // From process name and window title (AppClassifier)
     
     WindowInfo() : hwnd(nullptr), processId(0), threadId(0), 
-                   eventType(WindowEventType::WINDOW_ACTIVATED),
+                   eventType(WindowEventType::WINDOW_ACTIVATED), isForeground(false), category(AppCategory::Unknown),
                    timestamp(std::chrono::system_clock::now()) {}
 };
 
+// Visible, titled top-level windows as WindowEventMonitor's registry last published them
+struct WindowRegistrySnapshot {
+    std::vector<WindowInfo> windows;                    // In no particular order
+    std::map<std::wstring, int> countsByProcess;        // Image name -> windows listed
+    uint64_t generation = 0;                            // Bumped with every published change
+};
+
 // 事件回调函数类型
 using EventCallback = std::function<void(const WindowInfo&)>;
 
 // Windows事件监控器类
+//
+// WinEvent hooks are registered only for the events handled (foreground,
+// focus, name change), each as its own single-event range. The hook callback
+// does no work beyond pushing (hwnd, event, time) into a single-producer
+// ring and signalling; a worker thread drains it, resolves window and process
+// details and runs the callbacks, so the hook returns in microseconds and
+// never lags the desktop. Consecutive events for the same window are
+// coalesced; when the ring is full new events are dropped (and counted).
+//
+// Title changes are debounced per window: a burst of EVENT_OBJECT_NAMECHANGE
+// (page loads, terminal and build progress in the title) is delivered once,
+// with the final title, after the window's title has been quiet for the
+// configured period - or MAX_NAME_CHANGE_DELAY_MS after the burst started,
+// so a title that never settles still gets reported.
+//
+// Window registry: the visible, titled top-level windows are kept in a map
+// updated from the same queue - show, hide and destroy events add and drop
+// entries (destroy and hide cost a map erase, no window query), foreground
+// and title events refresh the entry's title, category and foreground flag,
+// and the process name and path stay with the entry. The worker publishes an
+// immutable snapshot after each batch that changed something, so
+// GetAllWindows() and per-process window counts are a pointer load instead of
+// an EnumWindows scan. One EnumWindows pass seeds it on Start, and another
+// runs every REGISTRY_RESYNC_MS or after the queue dropped events, in case a
+// lost event left it stale.
 class WindowEventMonitor {
 public:
     WindowEventMonitor();
@@ -77,8 +116,11 @@ public:
     // 获取当前活动窗口信息
     WindowInfo GetActiveWindowInfo();
     
-    // 获取所有顶级窗口列表
+    // 获取所有顶级窗口列表 (visible, titled; from the registry while running)
     std::vector<WindowInfo> GetAllWindows();
+
+    // The registry's latest snapshot (empty until Start has seeded it)
+    std::shared_ptr<const WindowRegistrySnapshot> GetWindowRegistry() const;
     
     // 检查监控器是否正在运行
     bool IsRunning() const { return m_isRunning; }
@@ -86,6 +128,16 @@ public:
     // 获取错误信息
     std::wstring GetLastError() const { return m_lastError; }
 
+    // Hook events lost to a full queue
+    uint64_t GetDroppedEvents() const { return m_droppedEvents.load(); }
+
+    // Quiet period for debouncing title changes (0 delivers every change)
+    void SetNameChangeQuietPeriod(std::chrono::milliseconds quiet);
+
+    static constexpr int DEFAULT_NAME_CHANGE_QUIET_MS = 300;
+    static constexpr int MAX_NAME_CHANGE_DELAY_MS = 2000;
+    static constexpr int REGISTRY_RESYNC_MS = 5 * 60 * 1000;
+
 private:
     // Hook回调函数（静态）
     static LRESULT CALLBACK WindowEventProc(int nCode, WPARAM wParam, LPARAM lParam);
@@ -93,25 +145,13 @@ private:
                                       HWND hwnd, LONG idObject, LONG idChild,
                                       DWORD eventThread, DWORD eventTime);
 
-    // UI Automation 事件处理（用于Chrome标签页等控件）
-    void InitUIAutomation();
-    void CleanupUIAutomation();
-    void SubscribeUIAEvents(HWND topLevelHwnd);
-    void UnsubscribeUIAEvents();
-    static void CALLBACK WinEventObjectNameChange(HWINEVENTHOOK hWinEventHook, DWORD event,
-                                                  HWND hwnd, LONG idObject, LONG idChild,
-                                                  DWORD eventThread, DWORD eventTime);
-    void HandleObjectNameChange(HWND hwnd);
     bool IsChromeWindow(HWND hwnd);
 
-    // 尝试通过UI Automation获取标签页标题
-    bool TryGetChromeTabInfo(HWND hwnd, std::wstring& tabTitle);
-    
-    // 辅助: 获取子窗口的可访问对象名
-    static std::wstring GetAccNameFromObject(HWND hwnd);
+    // Active tab of a browser window from m_tabTracker (worker thread only)
+    bool TryGetChromeTabInfo(HWND hwnd, std::wstring& tabTitle, std::wstring& tabUrl);
 
-    // UIA对象
-    CComPtr<IUIAutomation> m_uia;
+    // Address bar subscriptions of browser windows; lives on the worker thread's MTA
+    BrowserTabTracker m_tabTracker;
     
     // 获取窗口详细信息
     static WindowInfo GetWindowInfo(HWND hwnd);
@@ -127,19 +167,70 @@ private:
     
     // 消息循环线程
     void MessageLoopThread();
+
+    // Drains the hook queue: window details and callbacks run here
+    void WorkerThread();
+    void HandleEvent(HWND hwnd, DWORD event);
+
+    // Deliver debounced title changes that are due; returns ms until the next one (capped)
+    DWORD FlushNameChanges();
+
+    // Registry upkeep (worker thread only)
+    static bool IsRegistryEvent(DWORD event);
+    static bool IsListedWindow(HWND hwnd);
+    void UpdateRegistry(HWND hwnd, DWORD event);
+    void UpdateRegistryEntry(const WindowInfo& info);
+    void ResyncRegistry();
+    void PublishRegistry();
+
+    // One hook notification, as queued by WinEventProc
+    struct RawEvent {
+        HWND hwnd;
+        DWORD event;
+        DWORD eventTime;
+    };
+    static constexpr size_t EVENT_QUEUE_SIZE = 1024;    // Power of two
     
     // 枚举所有窗口的回调函数
     static BOOL CALLBACK EnumWindowsProc(HWND hwnd, LPARAM lParam);
 
 private:
     static WindowEventMonitor* s_instance;  // 单例实例
-    HWINEVENTHOOK m_hook;                   // Windows事件Hook句柄
+    std::vector<HWINEVENTHOOK> m_hooks;     // Windows事件Hook句柄 (one per event)
     HHOOK m_shellHook;                      // Shell Hook句柄
     std::vector<EventCallback> m_callbacks; // 事件回调列表
     std::atomic<bool> m_isRunning;          // 运行状态标志
     std::thread m_messageThread;            // 消息循环线程
     std::wstring m_lastError;               // 最后的错误信息
     HWND m_messageWindow;                   // 消息窗口句柄
+    DWORD m_messageThreadId;
+
+    // Hook -> worker queue: the message thread is the only producer and the
+    // worker the only consumer, so head/tail atomics are enough
+    RawEvent m_queue[EVENT_QUEUE_SIZE];
+    std::atomic<size_t> m_queueHead;        // Next slot to write (message thread)
+    std::atomic<size_t> m_queueTail;        // Next slot to read (worker)
+    HANDLE m_queueEvent;                    // Auto-reset; set when the queue goes non-empty
+    std::thread m_workerThread;
+    std::atomic<uint64_t> m_droppedEvents;
+
+    // Title-change bursts being debounced (worker thread only)
+    struct PendingNameChange {
+        std::chrono::steady_clock::time_point first;
+        std::chrono::steady_clock::time_point last;
+    };
+    std::map<HWND, PendingNameChange> m_pendingNameChanges;
+    HWND m_foregroundHwnd;                  // From EVENT_SYSTEM_FOREGROUND (worker thread only)
+    std::atomic<int> m_nameChangeQuietMs;
+
+    // Window registry (worker thread only) and its published snapshot
+    // (std::atomic_load / std::atomic_store only)
+    std::unordered_map<HWND, WindowInfo> m_registry;
+    bool m_registryDirty;
+    uint64_t m_registryGeneration;
+    std::chrono::steady_clock::time_point m_lastResync;
+    uint64_t m_droppedAtResync;
+    std::shared_ptr<const WindowRegistrySnapshot> m_registrySnapshot;
 };
 
 // 辅助函数：将事件类型转换为字符串
@@ -1,12 +1,22 @@
 #include "WindowsAPIs.h"
 #include "WindowEventMonitor.h"
+#include "ProcessInfoCache.h"
+#include "PublishedState.h"
+#include "CpuSampler.h"
+#include "SystemCounters.h"
+#include "ActiveAppHistory.h"
+#include "AppClassifier.h"
+#include "NetworkState.h"
 #define WIN32_LEAN_AND_MEAN
 #define _WINSOCKAPI_    // Prevent inclusion of winsock.h
 #include <windows.h>
 #include <netlistmgr.h>
 #include <comdef.h>
 #include <wlanapi.h>
+#include <algorithm>
+#include <atomic>
 #include <iomanip>
+#include <iostream>
 #include <sstream>
 #include <ctime>
 #include <chrono>
@@ -17,6 +27,7 @@
 #include <vector>
 #include <map>
 #include <mutex>
+#include <thread>
 #include <memory>
 
 // WinRT Headers for Geolocation
@@ -37,12 +48,20 @@ namespace WindowsAPIs {
 
 // Active App Monitoring - Global variables
 static std::unique_ptr<WindowEventMonitor> g_eventMonitor;
-static std::vector<ActiveAppRecord> g_activeAppHistory;
+static const std::chrono::hours HISTORY_RETENTION_PERIOD{1}; // 1 hour retention
+static ActiveAppHistory g_activeAppHistory(HISTORY_RETENTION_PERIOD);
 static std::mutex g_historyMutex;
 static std::string g_lastActiveApp;
 static std::string g_lastActiveAppWindowTitle;
 static std::chrono::system_clock::time_point g_lastAppStartTime;
-static const std::chrono::hours HISTORY_RETENTION_PERIOD{1}; // 1 hour retention
+static std::atomic<uint64_t> g_activeAppGeneration{0};
+static PublishedState<std::string> g_foregroundApp;     // "" until known
+static std::atomic<AppCategory> g_foregroundCategory{AppCategory::Unknown};
+
+StringInterner& GetActiveAppStrings() {
+    static StringInterner strings;
+    return strings;
+}
 
 // Event callback function for window monitoring
 void OnWindowEvent(const WindowInfo& info);
@@ -53,6 +72,9 @@ void CleanupOldRecords();
 // Convert WindowInfo to app name
 std::string GetAppNameFromWindowInfo(const WindowInfo& info);
 
+// GetForegroundAppName's naming applied to an event's window ("" if it has no usable name)
+std::string ForegroundAppNameFromWindowInfo(const WindowInfo& info);
+
 std::string GetForegroundAppName() {
     try {
         // ����1: ���Ի�ȡǰ̨���ڱ��� (��ǿ�� - ֧��Unicode)
@@ -100,56 +122,23 @@ std::string GetForegroundAppName() {
         
         if (processId > 0) {
             // ��ǿ�Ľ�����Ϣ��ȡ
-            HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
-            if (hProcess) {
-                wchar_t processName[MAX_PATH] = {0};
-                DWORD size = sizeof(processName)/sizeof(wchar_t);
-                
-                // ����ʹ��QueryFullProcessImageNameW (Unicode�汾)
-                if (QueryFullProcessImageNameW(hProcess, 0, processName, &size)) {
-                    CloseHandle(hProcess);
-                    
-                    std::wstring fullPath(processName);
-                    size_t lastSlash = fullPath.find_last_of(L"\\/");
-                    if (lastSlash != std::wstring::npos) {
-                        std::wstring exeName = fullPath.substr(lastSlash + 1);
-                        
-                        // ȥ��.exe��չ������ʽ��
-                        size_t dotPos = exeName.find_last_of(L'.');
-                        if (dotPos != std::wstring::npos) {
-                            exeName = exeName.substr(0, dotPos);
-                        }
-                        
-                        std::string exeNameUtf8 = WideStringToUtf8(exeName);
-                        
-                        // �ų�ϵͳ����
-                        if (exeNameUtf8 != "dwm" && 
-                            exeNameUtf8 != "winlogon" && 
-                            exeNameUtf8 != "csrss" &&
-                            exeNameUtf8 != "explorer" &&
-                            !exeNameUtf8.empty()) {
-                            return exeNameUtf8;
-                        }
-                    }
-                } else {
-                    // ���˵�GetModuleBaseNameW
-                    wchar_t baseName[MAX_PATH] = {0};
-                    if (GetModuleBaseNameW(hProcess, NULL, baseName, sizeof(baseName)/sizeof(wchar_t))) {
-                        CloseHandle(hProcess);
-                        
-                        std::wstring name(baseName);
-                        size_t dotPos = name.find_last_of(L'.');
-                        if (dotPos != std::wstring::npos) {
-                            name = name.substr(0, dotPos);
-                        }
-                        
-                        std::string nameUtf8 = WideStringToUtf8(name);
-                        if (!nameUtf8.empty() && nameUtf8 != "explorer") {
-                            return nameUtf8;
-                        }
-                    }
+            // Cached per process: no kernel round trip once the app has been seen
+            ProcessInfoCache::ProcessInfo process;
+            if (ProcessInfoCache::Instance().Lookup(processId, process)) {
+                std::wstring exeName = process.name;
+                size_t dotPos = exeName.find_last_of(L'.');
+                if (dotPos != std::wstring::npos) {
+                    exeName = exeName.substr(0, dotPos);
+                }
+
+                std::string exeNameUtf8 = WideStringToUtf8(exeName);
+                if (exeNameUtf8 != "dwm" && 
+                    exeNameUtf8 != "winlogon" && 
+                    exeNameUtf8 != "csrss" &&
+                    exeNameUtf8 != "explorer" &&
+                    !exeNameUtf8.empty()) {
+                    return exeNameUtf8;
                 }
-                CloseHandle(hProcess);
             }
         }
         
@@ -327,130 +316,40 @@ bool IsCharging() {
     }
 }
 
-// CPU usage calculation
+// System load: CPU from the sampler thread's smoothed values, the rest from
+// the shared PDH sample (one collection per tick)
 double GetCPUUsage() {
-    try {
-        // ʹ��ϵͳ����CPUʹ���ʼ���
-        static FILETIME s_ftPrevSysIdle = {0};
-        static FILETIME s_ftPrevSysKernel = {0};
-        static FILETIME s_ftPrevSysUser = {0};
-        static bool s_firstCall = true;
-        
-        FILETIME ftSysIdle, ftSysKernel, ftSysUser;
-        
-        // ��ȡϵͳʱ��
-        if (!GetSystemTimes(&ftSysIdle, &ftSysKernel, &ftSysUser)) {
-            return -1.0;
-        }
-        
-        // ��һ�ε��ã����浱ǰֵ������0
-        if (s_firstCall) {
-            s_ftPrevSysIdle = ftSysIdle;
-            s_ftPrevSysKernel = ftSysKernel;
-            s_ftPrevSysUser = ftSysUser;
-            s_firstCall = false;
-            return 0.0;
-        }
-        
-        // ת��Ϊ64λֵ
-        ULARGE_INTEGER sysIdle, sysKernel, sysUser;
-        ULARGE_INTEGER prevSysIdle, prevSysKernel, prevSysUser;
-        
-        sysIdle.LowPart = ftSysIdle.dwLowDateTime;
-        sysIdle.HighPart = ftSysIdle.dwHighDateTime;
-        sysKernel.LowPart = ftSysKernel.dwLowDateTime;
-        sysKernel.HighPart = ftSysKernel.dwHighDateTime;
-        sysUser.LowPart = ftSysUser.dwLowDateTime;
-        sysUser.HighPart = ftSysUser.dwHighDateTime;
-        
-        prevSysIdle.LowPart = s_ftPrevSysIdle.dwLowDateTime;
-        prevSysIdle.HighPart = s_ftPrevSysIdle.dwHighDateTime;
-        prevSysKernel.LowPart = s_ftPrevSysKernel.dwLowDateTime;
-        prevSysKernel.HighPart = s_ftPrevSysKernel.dwHighDateTime;
-        prevSysUser.LowPart = s_ftPrevSysUser.dwLowDateTime;
-        prevSysUser.HighPart = s_ftPrevSysUser.dwHighDateTime;
-        
-        // ����ʱ���
-        ULONGLONG idleDiff = sysIdle.QuadPart - prevSysIdle.QuadPart;
-        ULONGLONG kernelDiff = sysKernel.QuadPart - prevSysKernel.QuadPart;
-        ULONGLONG userDiff = sysUser.QuadPart - prevSysUser.QuadPart;
-        
-        // ע�⣺kernelDiff������idle time��������Ҫ��ȥ
-        ULONGLONG systemDiff = kernelDiff + userDiff;
-        ULONGLONG totalDiff = systemDiff;
-        
-        double cpuUsage = 0.0;
-        if (totalDiff > 0) {
-            // CPUʹ���� = (��ʱ�� - ����ʱ��) / ��ʱ�� * 100
-            cpuUsage = (double)(totalDiff - idleDiff) * 100.0 / (double)totalDiff;
-        }
-        
-        // ���浱ǰֵ���´�ʹ��
-        s_ftPrevSysIdle = ftSysIdle;
-        s_ftPrevSysKernel = ftSysKernel;
-        s_ftPrevSysUser = ftSysUser;
-        
-        // ȷ������ֵ�ں�����Χ��
-        if (cpuUsage < 0.0) cpuUsage = 0.0;
-        if (cpuUsage > 100.0) cpuUsage = 100.0;
-        
-        return cpuUsage;
-    }
-    catch (...) {
-        return -1.0;
-    }
+    return CpuSampler::Instance().SystemPercent();
+}
+
+std::vector<double> GetCPUCoreUsage() {
+    return CpuSampler::Instance().CorePercent();
 }
 
 double GetMemoryUsage() {
-    try {
-        MEMORYSTATUSEX memInfo;
-        memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-        if (GlobalMemoryStatusEx(&memInfo)) {
-            // �����ڴ�ʹ�ðٷֱ�
-            return static_cast<double>(memInfo.dwMemoryLoad);
-        }
-        return -1.0;
-    }
-    catch (...) {
-        return -1.0;
-    }
+    return SystemCounters::Instance().Get().memoryPercent;
 }
 
 double GetMemoryUsed() {
-    try {
-        MEMORYSTATUSEX memInfo;
-        memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-        if (GlobalMemoryStatusEx(&memInfo)) {
-            // ���������ڴ沢ת��ΪGB
-            double usedMemoryBytes = static_cast<double>(memInfo.ullTotalPhys - memInfo.ullAvailPhys);
-            double usedMemoryGB = usedMemoryBytes / (1024.0 * 1024.0 * 1024.0);
-            return usedMemoryGB;
-        }
-        return -1.0;
-    }
-    catch (...) {
-        return -1.0;
-    }
+    return SystemCounters::Instance().Get().memoryUsedGB;
 }
 
 double GetTotalMemory() {
-    try {
-        MEMORYSTATUSEX memInfo;
-        memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-        if (GlobalMemoryStatusEx(&memInfo)) {
-            // ���ֽ�ת��ΪGB
-            double totalMemoryBytes = static_cast<double>(memInfo.ullTotalPhys);
-            double totalMemoryGB = totalMemoryBytes / (1024.0 * 1024.0 * 1024.0);
-            return totalMemoryGB;
-        }
-        return -1.0;
-    }
-    catch (...) {
-        return -1.0;
-    }
+    return SystemCounters::Instance().Get().totalMemoryGB;
+}
+
+double GetDiskUsage() {
+    return SystemCounters::Instance().Get().diskBusyPercent;
+}
+
+double GetGPUUsage() {
+    return SystemCounters::Instance().Get().gpuPercent;
 }
 
 bool IsNetworkConnected() {
+    if (NetworkState::Instance().IsRunning()) {
+        return NetworkState::Instance().Get()->connected;
+    }
     try {
         HRESULT hr = CoInitialize(NULL);
         if (FAILED(hr)) return false;
@@ -481,6 +380,9 @@ bool IsNetworkConnected() {
 }
 
 std::string GetNetworkType() {
+    if (NetworkState::Instance().IsRunning()) {
+        return NetworkState::Instance().Get()->type;
+    }
     try {
         // Check if connected to WiFi
         HANDLE hClient = nullptr;
@@ -520,6 +422,9 @@ std::string GetNetworkType() {
 
 // Network speed calculation using Performance Counters
 double GetNetworkSpeed() {
+    if (NetworkState::Instance().IsRunning()) {
+        return NetworkState::Instance().GetThroughputMbps();
+    }
     try {
         // ʹ�ô�ͳ��GetIfTable API (���õļ�����)
         static ULONGLONG s_prevBytesReceived = 0;
@@ -642,6 +547,7 @@ bool InitializeActiveAppMonitoring() {
             // Initialize with current active app and window title
             std::string currentApp = GetForegroundAppName();
             if (!currentApp.empty() && currentApp != "Unknown") {
+                g_foregroundApp.Update([&](std::string& app) { app = currentApp; return true; });
                 g_lastActiveApp = currentApp;
                 g_lastActiveAppWindowTitle = currentApp; // Initialize window title
                 g_lastAppStartTime = std::chrono::system_clock::now();
@@ -666,17 +572,68 @@ void CleanupActiveAppMonitoring() {
         }
         
         // Clear history and current app info
-        g_activeAppHistory.clear();
+        g_activeAppHistory.Clear();
         g_lastActiveApp.clear();
         g_lastActiveAppWindowTitle.clear(); // Clear window title too
+        g_foregroundApp.Update([](std::string& app) { app.clear(); return true; });
+        g_foregroundCategory.store(AppCategory::Unknown, std::memory_order_relaxed);
     }
     catch (...) {
         // Ignore cleanup errors
     }
 }
 
+uint64_t GetActiveAppGeneration() {
+    return g_activeAppGeneration.load(std::memory_order_relaxed);
+}
+
+std::string GetCurrentForegroundApp() {
+    std::shared_ptr<const std::string> app = g_foregroundApp.Load();
+    if (!app->empty()) {
+        return *app;
+    }
+    return GetForegroundAppName();
+}
+
+std::string GetCurrentForegroundCategory() {
+    return AppClassifier::CategoryName(g_foregroundCategory.load(std::memory_order_relaxed));
+}
+
+std::string ForegroundAppNameFromWindowInfo(const WindowInfo& info) {
+    std::string title = WideStringToUtf8(info.windowTitle);
+    if (!title.empty() && title != "Program Manager" && title != "Desktop" &&
+        title.find("Windows Default Lock Screen") == std::string::npos) {
+        return title;
+    }
+
+    std::wstring exeName = info.processName;
+    size_t dotPos = exeName.find_last_of(L'.');
+    if (dotPos != std::wstring::npos) {
+        exeName = exeName.substr(0, dotPos);
+    }
+    std::string name = WideStringToUtf8(exeName);
+    if (name == "dwm" || name == "winlogon" || name == "csrss" || name == "explorer" || name == "Unknown") {
+        return "";
+    }
+    return name;
+}
+
 void OnWindowEvent(const WindowInfo& info) {
     try {
+        if (info.isForeground) {
+            g_foregroundCategory.store(info.category, std::memory_order_relaxed);
+            std::string foregroundApp = ForegroundAppNameFromWindowInfo(info);
+            if (!foregroundApp.empty()) {
+                g_foregroundApp.Update([&](std::string& app) {
+                    if (app == foregroundApp) {
+                        return false;
+                    }
+                    app = foregroundApp;
+                    return true;
+                });
+            }
+        }
+
         std::string appName = GetAppNameFromWindowInfo(info);
         std::string windowTitle = WideStringToUtf8(info.windowTitle);
         
@@ -703,28 +660,25 @@ void OnWindowEvent(const WindowInfo& info) {
             // Only record if the app was active for more than 1 second
             if (duration.count() > 0) {
                 ActiveAppRecord record;
-                record.appName = g_lastActiveApp;
+                record.appId = GetActiveAppStrings().Intern(g_lastActiveApp);
                 record.timestamp = g_lastAppStartTime;
                 record.durationSeconds = static_cast<int>(duration.count());
                 
                 // Use the stored window title from when this session started
-                record.windowTitle = g_lastActiveAppWindowTitle;
+                record.windowTitleId = GetActiveAppStrings().Intern(g_lastActiveAppWindowTitle);
                 
-                g_activeAppHistory.push_back(record);
+                g_activeAppHistory.Append(record, now);     // Prunes expired records too
             }
         }
         
+        if (g_lastActiveApp != appName || g_lastActiveAppWindowTitle != windowTitle) {
+            g_activeAppGeneration.fetch_add(1, std::memory_order_relaxed);
+        }
+
         // Update current active app and window title
         g_lastActiveApp = appName;
         g_lastActiveAppWindowTitle = windowTitle; // Store current window title
         g_lastAppStartTime = now;
-        
-        // Clean up old records periodically
-        static auto lastCleanup = std::chrono::system_clock::now();
-        if (std::chrono::duration_cast<std::chrono::minutes>(now - lastCleanup).count() >= 5) {
-            CleanupOldRecords();
-            lastCleanup = now;
-        }
     }
     catch (...) {
         // Ignore event processing errors
@@ -760,23 +714,21 @@ std::string GetAppNameFromWindowInfo(const WindowInfo& info) {
 
 void CleanupOldRecords() {
     try {
-        auto now = std::chrono::system_clock::now();
-        auto cutoff = now - HISTORY_RETENTION_PERIOD;
-        
-        // Remove records older than 1 hour
-        g_activeAppHistory.erase(
-            std::remove_if(g_activeAppHistory.begin(), g_activeAppHistory.end(),
-                [cutoff](const ActiveAppRecord& record) {
-                    return record.timestamp < cutoff;
-                }),
-            g_activeAppHistory.end()
-        );
+        // Remove records older than 1 hour (only the expired ones are touched)
+        g_activeAppHistory.Prune(std::chrono::system_clock::now());
     }
     catch (...) {
         // Ignore cleanup errors
     }
 }
 
+void RestoreActiveAppHistory(const std::vector<ActiveAppRecord>& records) {
+    std::lock_guard<std::mutex> lock(g_historyMutex);
+
+    // Only records older than everything already tracked this run
+    g_activeAppHistory.Prepend(records, std::chrono::system_clock::now());
+}
+
 std::vector<ActiveAppRecord> GetRecentPeriodActiveAppList() {
     try {
         std::lock_guard<std::mutex> lock(g_historyMutex);
@@ -784,8 +736,9 @@ std::vector<ActiveAppRecord> GetRecentPeriodActiveAppList() {
         // Clean up old records first
         CleanupOldRecords();
 
-        // Build result with current app
-        std::vector<ActiveAppRecord> result = g_activeAppHistory;
+        // Build result with current app (only the tail can survive the limit below)
+        const size_t MAX_RECENT_APPS = 10;
+        std::vector<ActiveAppRecord> result = g_activeAppHistory.Last(MAX_RECENT_APPS);
 
         // Add current active app if it has been running for some time
         auto now = std::chrono::system_clock::now();
@@ -793,17 +746,16 @@ std::vector<ActiveAppRecord> GetRecentPeriodActiveAppList() {
             auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - g_lastAppStartTime);
             if (duration.count() > 0) {
                 ActiveAppRecord currentRecord;
-                currentRecord.appName = g_lastActiveApp;
+                currentRecord.appId = GetActiveAppStrings().Intern(g_lastActiveApp);
                 currentRecord.timestamp = g_lastAppStartTime;
                 currentRecord.durationSeconds = static_cast<int>(duration.count());
-                currentRecord.windowTitle = g_lastActiveAppWindowTitle;
+                currentRecord.windowTitleId = GetActiveAppStrings().Intern(g_lastActiveAppWindowTitle);
 
                 result.push_back(currentRecord);
             }
         }
 
         // Limit to most recent 10 apps to prevent unbounded growth
-        const size_t MAX_RECENT_APPS = 10;
         if (result.size() > MAX_RECENT_APPS) {
             // Keep only the last 10 apps (most recent)
             result.erase(result.begin(), result.begin() + (result.size() - MAX_RECENT_APPS));
@@ -816,102 +768,115 @@ std::vector<ActiveAppRecord> GetRecentPeriodActiveAppList() {
     }
 }
 
-// Global location cache
-static Location g_cachedLocation;
-static std::chrono::steady_clock::time_point g_lastLocationUpdate;
-static const std::chrono::minutes LOCATION_CACHE_DURATION{30}; // 30 minutes cache
-static bool g_locationInitialized = false;
+std::vector<ActiveAppRecord> GetActiveAppListSince(std::chrono::system_clock::time_point since) {
+    std::lock_guard<std::mutex> lock(g_historyMutex);
+    CleanupOldRecords();
+    return g_activeAppHistory.Since(since);
+}
 
-Location GetLocation() {
+std::vector<AppDwellTime> GetActiveAppDwellTimes() {
+    std::lock_guard<std::mutex> lock(g_historyMutex);
+    CleanupOldRecords();
+    std::vector<AppDwellTime> result = g_activeAppHistory.DwellTimes();
+
+    // Plus the session still in progress
+    if (!g_lastActiveApp.empty() && g_lastActiveApp != "Unknown" && g_lastActiveApp != "Desktop") {
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now() - g_lastAppStartTime).count();
+        if (elapsed > 0) {
+            StringInterner::Id appId = GetActiveAppStrings().Intern(g_lastActiveApp);
+            auto it = std::find_if(result.begin(), result.end(),
+                                   [appId](const AppDwellTime& dwell) { return dwell.appId == appId; });
+            if (it != result.end()) {
+                it->seconds += elapsed;
+            } else {
+                result.push_back(AppDwellTime{ appId, elapsed });
+            }
+            std::sort(result.begin(), result.end(), [](const AppDwellTime& a, const AppDwellTime& b) {
+                return a.seconds > b.seconds;
+            });
+        }
+    }
+    return result;
+}
+
+// Location: a background tracker owns the Geolocator and publishes each fix
+// as it arrives (PositionChanged, past LOCATION_MOVEMENT_THRESHOLD_M), so
+// GetLocation is a cache read and never waits on the location stack
+static PublishedState<Location> g_location;
+static std::once_flag g_locationTrackerOnce;
+static const double LOCATION_MOVEMENT_THRESHOLD_M = 100.0;
+static const uint32_t LOCATION_REPORT_INTERVAL_MS = 60000;
+
+static void PublishPosition(const winrt::Windows::Devices::Geolocation::Geoposition& position) {
+    auto coordinate = position.Coordinate();
+    auto point = coordinate.Point().Position();
+    Location fix;
+    fix.latitude = point.Latitude;
+    fix.longitude = point.Longitude;
+    fix.accuracyMeters = coordinate.Accuracy();
+    fix.valid = true;
+    fix.updated = std::chrono::system_clock::from_time_t(winrt::clock::to_time_t(coordinate.Timestamp()));
+    g_location.Update([&](Location& location) {
+        location = fix;
+        return true;
+    });
+}
+
+static void LocationTrackerThread() {
     using namespace winrt;
     using namespace Windows::Devices::Geolocation;
-    using namespace Windows::Foundation;
-    
-    Location loc;
-    loc.latitude = 0.0;
-    loc.longitude = 0.0;
-    loc.valid = false;
-    
+
     try {
-        auto now = std::chrono::steady_clock::now();
-        
-        // Return cached location if still valid
-        if (g_locationInitialized && g_cachedLocation.valid && 
-            (now - g_lastLocationUpdate) < LOCATION_CACHE_DURATION) {
-            return g_cachedLocation;
+        init_apartment(apartment_type::multi_threaded);
+    }
+    catch (...) {
+        // Already initialized on this thread
+    }
+    // Keep the MTA alive after this thread exits: position events arrive on pool threads
+    CO_MTA_USAGE_COOKIE mtaCookie;
+    CoIncrementMTAUsage(&mtaCookie);
+
+    try {
+        if (Geolocator::RequestAccessAsync().get() != GeolocationAccessStatus::Allowed) {
+            std::cout << "[Location] Access not granted; location stays unavailable" << std::endl;
+            return;
         }
-        
-        // Initialize WinRT if not done
-        static bool winrtInitialized = false;
-        if (!winrtInitialized) {
+
+        // Lives for the process: its PositionChanged subscription keeps publishing
+        static Geolocator locator{ nullptr };
+        locator = Geolocator();
+        locator.DesiredAccuracyInMeters(100); // 100 meter accuracy
+        locator.MovementThreshold(LOCATION_MOVEMENT_THRESHOLD_M);
+        locator.ReportInterval(LOCATION_REPORT_INTERVAL_MS);
+        locator.PositionChanged([](Geolocator const&, PositionChangedEventArgs const& args) {
             try {
-                init_apartment(apartment_type::single_threaded);
-                winrtInitialized = true;
+                PublishPosition(args.Position());
             }
             catch (...) {
-                // If already initialized, continue
+                // Keep the last fix
             }
-        }
-        
-        // Request location access
-        GeolocationAccessStatus access;
-        try {
-            access = Geolocator::RequestAccessAsync().get();
-        }
-        catch (...) {
-            // Permission request failed, update cache and return invalid location
-            g_cachedLocation = loc;
-            g_lastLocationUpdate = now;
-            g_locationInitialized = true;
-            return loc;
-        }
-        
-        if (access != GeolocationAccessStatus::Allowed) {
-            // Access denied, update cache and return invalid location
-            g_cachedLocation = loc;
-            g_lastLocationUpdate = now;
-            g_locationInitialized = true;
-            return loc;
-        }
-        
-        // Create geolocator
-        Geolocator locator;
-        locator.DesiredAccuracyInMeters(100); // 100 meter accuracy
-        
-        // Get position with timeout
-        try {
-            Geoposition pos = locator.GetGeopositionAsync().get();
-            auto basicPos = pos.Coordinate().Point().Position();
-            
-            loc.latitude = basicPos.Latitude;
-            loc.longitude = basicPos.Longitude;
-            loc.valid = true;
-            
-            // Cache the successful result
-            g_cachedLocation = loc;
-            g_lastLocationUpdate = now;
-            g_locationInitialized = true;
-            
-            return loc;
-        }
-        catch (winrt::hresult_error const& e) {
-            // Location request failed, cache invalid result for short time
-            g_cachedLocation = loc;
-            g_lastLocationUpdate = now;
-            g_locationInitialized = true;
-            return loc;
-        }
+        });
+
+        // First fix now rather than after the first movement
+        PublishPosition(locator.GetGeopositionAsync().get());
+    }
+    catch (winrt::hresult_error const& e) {
+        std::cerr << "[Location] Position unavailable: " << winrt::to_string(e.message()) << std::endl;
     }
     catch (...) {
-        // Any other error, return invalid location
-        auto now = std::chrono::steady_clock::now();
-        g_cachedLocation = loc;
-        g_lastLocationUpdate = now;
-        g_locationInitialized = true;
-        return loc;
+        std::cerr << "[Location] Position unavailable" << std::endl;
     }
 }
 
+Location GetLocation() {
+    // The first call starts tracking; until a fix arrives the location reads invalid
+    std::call_once(g_locationTrackerOnce, []() {
+        std::thread(LocationTrackerThread).detach();
+    });
+    return *g_location.Load();
+}
+
 std::string GetCurrentTimestamp() {
     try {
         auto now = std::chrono::system_clock::now();
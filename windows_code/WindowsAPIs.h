@@ -2,6 +2,8 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <cstdint>
+#include "StringInterner.h"
 
 // Windows APIs wrapper functions
 namespace WindowsAPIs {
@@ -12,16 +14,24 @@ namespace WindowsAPIs {
     std::string FormatTimestampUTC(const std::chrono::system_clock::time_point& timepoint);
     std::string FormatTimestampLocal(const std::chrono::system_clock::time_point& timepoint);
     
-    // Active Application History - New functionality
+    // App names and window titles of ActiveAppRecords (process-wide)
+    StringInterner& GetActiveAppStrings();
+
+    // Active Application History - New functionality. Names are interned, so
+    // a record is trivially copyable and history copies are a memcpy
     struct ActiveAppRecord {
-        std::string appName;
-        std::string windowTitle;
+        StringInterner::Id appId;
+        StringInterner::Id windowTitleId;
         std::chrono::system_clock::time_point timestamp;
         int durationSeconds;
         
-        ActiveAppRecord() : durationSeconds(0) {}
+        ActiveAppRecord() : appId(StringInterner::EMPTY), windowTitleId(StringInterner::EMPTY), durationSeconds(0) {}
         ActiveAppRecord(const std::string& name, const std::string& title) 
-            : appName(name), windowTitle(title), timestamp(std::chrono::system_clock::now()), durationSeconds(1) {}
+            : appId(GetActiveAppStrings().Intern(name)), windowTitleId(GetActiveAppStrings().Intern(title)),
+              timestamp(std::chrono::system_clock::now()), durationSeconds(1) {}
+
+        const std::string& AppName() const { return GetActiveAppStrings().Get(appId); }
+        const std::string& WindowTitle() const { return GetActiveAppStrings().Get(windowTitleId); }
     };
     
     // Initialize and start active app monitoring
@@ -32,16 +42,46 @@ namespace WindowsAPIs {
     
     // Get recent active apps within the specified time period
     std::vector<ActiveAppRecord> GetRecentPeriodActiveAppList();
+
+    // Records that started at or after `since` (oldest first), without the current app
+    std::vector<ActiveAppRecord> GetActiveAppListSince(std::chrono::system_clock::time_point since);
+
+    // Time in each app over the retention period, current session included, longest first
+    struct AppDwellTime {
+        StringInterner::Id appId;       // GetActiveAppStrings
+        int64_t seconds;
+    };
+    std::vector<AppDwellTime> GetActiveAppDwellTimes();
+
+    // Put records from before a restart back in front of the live history
+    // (oldest first; ones past the retention period are dropped)
+    void RestoreActiveAppHistory(const std::vector<ActiveAppRecord>& records);
+
+    // Bumped whenever the foreground app or its window title changes; poll it
+    // to learn about window events without a callback
+    uint64_t GetActiveAppGeneration();
+
+    // Same naming as GetForegroundAppName, but maintained from foreground and
+    // title-change events: reading it costs no OS queries. Falls back to
+    // GetForegroundAppName until monitoring has seen the foreground window.
+    std::string GetCurrentForegroundApp();
+
+    // AppClassifier category of the foreground window ("browser", "meeting", ...;
+    // "unknown" until a foreground event has been seen)
+    std::string GetCurrentForegroundCategory();
     
     // Battery Status
     int GetBatteryPercentage();
     bool IsCharging();
     
-    // System Performance
+    // System Performance (one shared PDH sample; negative when unavailable)
     double GetCPUUsage();
     double GetMemoryUsage();          // ڴʹðٷֱ
     double GetMemoryUsed();           // GBΪλڴGB
     double GetTotalMemory();          // ڴGB
+    std::vector<double> GetCPUCoreUsage();  // Percent per logical processor
+    double GetDiskUsage();            // Percent of time any physical disk is busy
+    double GetGPUUsage();             // 3D engine utilization percent
     
     // Network Status
     bool IsNetworkConnected();
@@ -52,8 +92,11 @@ namespace WindowsAPIs {
     struct Location {
         double latitude = 0.0;
         double longitude = 0.0;
+        double accuracyMeters = 0.0;
         bool valid = false;
+        std::chrono::system_clock::time_point updated;  // When the fix was taken (staleness)
     };
+    // Last fix from a background tracker (started by the first call); never blocks
     Location GetLocation();
     
     // Timestamp
@@ -1,24 +1,29 @@
 #include "WindowsService.h"
 #include <iostream>
+#include "ModelVariants.h"
 
 WindowsService* WindowsService::instance = nullptr;
 SERVICE_STATUS WindowsService::serviceStatus;
 SERVICE_STATUS_HANDLE WindowsService::serviceStatusHandle = 0;
 
 WindowsService::WindowsService(const std::string& name, const std::string& display)
-    : serviceName(name), displayName(display), running(false) {
+    : serviceName(name), displayName(display), running(false),
+      stopEvent(CreateEventA(nullptr, TRUE, FALSE, nullptr)), stopWaitHintMs(0) {
     instance = this;
 }
 
 WindowsService::~WindowsService() {
     instance = nullptr;
+    if (stopEvent) {
+        CloseHandle(stopEvent);
+    }
 }
 
 VOID WINAPI WindowsService::ServiceMain(DWORD argc, LPSTR* argv) {
     if (!instance) return;
     
-    serviceStatusHandle = RegisterServiceCtrlHandlerA(
-        instance->serviceName.c_str(), ServiceCtrlHandler);
+    serviceStatusHandle = RegisterServiceCtrlHandlerExA(
+        instance->serviceName.c_str(), ServiceCtrlHandler, nullptr);
     
     if (!serviceStatusHandle) return;
     
@@ -38,10 +43,10 @@ VOID WINAPI WindowsService::ServiceMain(DWORD argc, LPSTR* argv) {
         instance->UpdateServiceStatus(SERVICE_RUNNING);
         instance->running = true;
         
-        // Main service loop
+        // Main service loop; a stop request ends the wait at once
         while (instance->running) {
             instance->OnRunning();
-            Sleep(1000); // Sleep for 1 second
+            WaitForSingleObject(instance->stopEvent, 1000);
         }
     }
     catch (...) {
@@ -50,27 +55,55 @@ VOID WINAPI WindowsService::ServiceMain(DWORD argc, LPSTR* argv) {
     }
     
     instance->OnStop();
+    for (HPOWERNOTIFY notification : instance->powerNotifications) {
+        UnregisterPowerSettingNotification(notification);
+    }
+    instance->powerNotifications.clear();
     instance->UpdateServiceStatus(SERVICE_STOPPED);
 }
 
-VOID WINAPI WindowsService::ServiceCtrlHandler(DWORD ctrlCode) {
-    if (!instance) return;
+DWORD WINAPI WindowsService::ServiceCtrlHandler(DWORD ctrlCode, DWORD eventType, LPVOID eventData, LPVOID context) {
+    if (!instance) return ERROR_CALL_NOT_IMPLEMENTED;
     
     switch (ctrlCode) {
         case SERVICE_CONTROL_STOP:
         case SERVICE_CONTROL_SHUTDOWN:
             instance->UpdateServiceStatus(SERVICE_STOP_PENDING);
             instance->running = false;
+            SetEvent(instance->stopEvent);
             break;
             
         case SERVICE_CONTROL_INTERROGATE:
             break;
+
+        case SERVICE_CONTROL_SESSIONCHANGE: {
+            const auto* session = static_cast<const WTSSESSION_NOTIFICATION*>(eventData);
+            if (session) {
+                instance->OnSessionChange(eventType, session->dwSessionId);
+            }
+            return NO_ERROR;
+        }
+
+        case SERVICE_CONTROL_POWEREVENT:
+            instance->OnPowerEvent(eventType, eventData);
+            return NO_ERROR;
             
         default:
-            break;
+            return ERROR_CALL_NOT_IMPLEMENTED;
     }
     
     SetServiceStatus(serviceStatusHandle, &serviceStatus);
+    return NO_ERROR;
+}
+
+bool WindowsService::RegisterPowerSetting(const GUID& setting) {
+    HPOWERNOTIFY notification = RegisterPowerSettingNotification(serviceStatusHandle, &setting,
+                                                                 DEVICE_NOTIFY_SERVICE_HANDLE);
+    if (!notification) {
+        return false;
+    }
+    powerNotifications.push_back(notification);
+    return true;
 }
 
 void WindowsService::UpdateServiceStatus(DWORD currentState, DWORD exitCode) {
@@ -80,9 +113,12 @@ void WindowsService::UpdateServiceStatus(DWORD currentState, DWORD exitCode) {
     if (currentState == SERVICE_START_PENDING || currentState == SERVICE_STOP_PENDING) {
         serviceStatus.dwControlsAccepted = 0;
     } else {
-        serviceStatus.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN;
+        serviceStatus.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN |
+                                           SERVICE_ACCEPT_SESSIONCHANGE | SERVICE_ACCEPT_POWEREVENT;
     }
     
+    serviceStatus.dwWaitHint = currentState == SERVICE_STOP_PENDING ? stopWaitHintMs : 0;
+
     if (currentState == SERVICE_RUNNING || currentState == SERVICE_STOPPED) {
         serviceStatus.dwCheckPoint = 0;
     } else {
@@ -98,6 +134,18 @@ bool WindowsService::Install() {
     
     char exePath[MAX_PATH];
     GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+
+    // Release packages ship PerceptionEngine-avx2.exe (PERCEPTION_ARCH=AVX2)
+    // next to the baseline build: register it when this CPU can run it
+    std::string path = exePath;
+    size_t directory = path.find_last_of("\\/");
+    std::string avx2Path = path.substr(0, directory == std::string::npos ? 0 : directory + 1) +
+                           "PerceptionEngine-avx2.exe";
+    if (path != avx2Path && ModelVariants::DetectCpu().avx2 &&
+        GetFileAttributesA(avx2Path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        std::cout << "AVX2 CPU: installing " << avx2Path << std::endl;
+        path = avx2Path;
+    }
     
     SC_HANDLE service = CreateServiceA(
         scManager,
@@ -107,7 +155,7 @@ bool WindowsService::Install() {
         SERVICE_WIN32_OWN_PROCESS,
         SERVICE_AUTO_START,
         SERVICE_ERROR_NORMAL,
-        exePath,
+        path.c_str(),
         nullptr,
         nullptr,
         nullptr,
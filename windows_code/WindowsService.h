@@ -2,6 +2,7 @@
 #define WIN32_LEAN_AND_MEAN
 #define _WINSOCKAPI_    // Prevent inclusion of winsock.h
 #include <string>
+#include <vector>
 #include <windows.h>
 
 // Windows Service wrapper class
@@ -14,15 +15,28 @@ private:
     std::string serviceName;
     std::string displayName;
     bool running;
+    HANDLE stopEvent;                   // Set by the control handler; ends the OnRunning wait early
+    DWORD stopWaitHintMs;
+    std::vector<HPOWERNOTIFY> powerNotifications;
     
     static VOID WINAPI ServiceMain(DWORD argc, LPSTR* argv);
-    static VOID WINAPI ServiceCtrlHandler(DWORD ctrlCode);
+    static DWORD WINAPI ServiceCtrlHandler(DWORD ctrlCode, DWORD eventType, LPVOID eventData, LPVOID context);
     
     void UpdateServiceStatus(DWORD currentState, DWORD exitCode = NO_ERROR);
     
 protected:
     void SetRunning(bool isRunning) { running = isRunning; }
     bool IsRunning() const { return running; }
+
+    // Deliver changes of a power setting (GUID_*) to OnPowerEvent as
+    // PBT_POWERSETTINGCHANGE; from OnStart, unregistered after OnStop
+    bool RegisterPowerSetting(const GUID& setting);
+
+    // How long OnStop may take, reported with SERVICE_STOP_PENDING (0: none)
+    void SetStopWaitHint(DWORD ms) { stopWaitHintMs = ms; }
+
+    // Report SERVICE_STOPPED now, for a stop that is about to end the process itself
+    void ReportStopped(DWORD exitCode) { UpdateServiceStatus(SERVICE_STOPPED, exitCode); }
     
 public:
     WindowsService(const std::string& name, const std::string& display);
@@ -37,6 +51,12 @@ public:
     virtual void OnStart() = 0;
     virtual void OnStop() = 0;
     virtual void OnRunning() = 0;
+
+    // On the control handler thread; keep them short (the SCM waits on the handler)
+    // WTS_SESSION_LOCK, WTS_SESSION_UNLOCK, WTS_SESSION_LOGON, ... for sessionId
+    virtual void OnSessionChange(DWORD eventType, DWORD sessionId) {}
+    // PBT_* event; for PBT_POWERSETTINGCHANGE eventData is a POWERBROADCAST_SETTING
+    virtual void OnPowerEvent(DWORD eventType, LPVOID eventData) {}
     
     static void RunAsService(WindowsService* service);
 };
\ No newline at end of file
@@ -0,0 +1,453 @@
+// bench_audio - Offline replay benchmark for the voice pipeline
+//
+// Feeds WAV files through the same path live audio takes: AudioResampler
+// (10 ms packets, like WASAPI) -> microphone ring -> VAD + segmentation ->
+// AsyncWhisperQueue -> transcription callback. Reports real-time factor,
+// per-stage latency distributions (PipelineLatency), segments produced and,
+// when foo.txt sits next to foo.wav, the word error rate against it.
+//
+// Usage:
+//   bench_audio <file.wav | corpus-directory> [--model PATH] [--fast-model PATH] [--whisper auto|cpu|gpu]
+//               [--realtime] [--streaming] [--json PATH]
+//               [--pre-roll-ms N] [--silence-ms N] [--min-speech-ms N] [--max-speech-sec N]
+//               [--vad-on P] [--vad-off P] [--chunk-min-sec N] [--chunk-max-sec N]
+//               [--turn-min-ms N] [--turn-max-ms N]
+//
+// --realtime paces the feed at wall-clock speed so the silence hold and end-to-end
+// stages mean what they do live; the default runs as fast as the pipeline drains.
+// The segmenter flags override AudioCaptureEngine::SegmenterConfig, for tuning
+// pre-roll, hangover, VAD hysteresis and long-utterance chunking against a corpus;
+// --turn-min-ms and --turn-max-ms equal to --silence-ms turn the end-of-turn
+// detector off, for an A/B of its latency and utterance count.
+// --whisper cpu measures the CPU path on a GPU-enabled ggml build.
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AudioCaptureEngine.h"
+#include "AudioResampler.h"
+#include "AudioSource.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include "PipelineLatency.h"
+
+namespace fs = std::filesystem;
+
+static constexpr int TARGET_RATE = 16000;
+static constexpr int PACKET_MS = 10;                            // WASAPI-sized feed packets
+static constexpr int TRAILING_SILENCE_MS = 1000;                // Ends the last utterance of a file
+static constexpr size_t MAX_PENDING_SAMPLES = TARGET_RATE * 5;  // Max-speed feed stays well inside the ring
+
+// Stages the voice pipeline records (capture is replaced by the file reader)
+static const PipelineLatency::Stage VOICE_STAGES[] = {
+    PipelineLatency::Stage::Resample,
+    PipelineLatency::Stage::Vad,
+    PipelineLatency::Stage::QueueWait,
+    PipelineLatency::Stage::Whisper,
+    PipelineLatency::Stage::SilenceHold,
+    PipelineLatency::Stage::ResultPickup,
+    PipelineLatency::Stage::UtteranceEndToEnd,
+};
+
+// ============================================================================
+// Word Error Rate
+// ============================================================================
+
+// Lowercase words; punctuation dropped, apostrophes kept ("don't")
+static std::vector<std::string> NormalizeWords(const std::string& text) {
+    std::vector<std::string> words;
+    std::string word;
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (std::isalnum(u) || c == '\'') {
+            word += static_cast<char>(std::tolower(u));
+        } else if (!word.empty()) {
+            words.push_back(std::move(word));
+            word.clear();
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+// Substitutions + deletions + insertions (word-level Levenshtein)
+static size_t WordErrors(const std::vector<std::string>& reference, const std::vector<std::string>& hypothesis) {
+    std::vector<size_t> previous(hypothesis.size() + 1);
+    std::vector<size_t> current(hypothesis.size() + 1);
+    for (size_t j = 0; j <= hypothesis.size(); ++j) {
+        previous[j] = j;
+    }
+    for (size_t i = 1; i <= reference.size(); ++i) {
+        current[0] = i;
+        for (size_t j = 1; j <= hypothesis.size(); ++j) {
+            size_t substitute = previous[j - 1] + (reference[i - 1] == hypothesis[j - 1] ? 0 : 1);
+            current[j] = (std::min)({ substitute, previous[j] + 1, current[j - 1] + 1 });
+        }
+        previous.swap(current);
+    }
+    return previous[hypothesis.size()];
+}
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+struct FileResult {
+    std::string name;
+    double audioSec = 0.0;
+    double wallSec = 0.0;
+    size_t segments = 0;            // Utterances the VAD cut and queued
+    size_t transcriptions = 0;      // Non-empty results delivered
+    std::string hypothesis;
+    bool hasReference = false;
+    size_t referenceWords = 0;
+    size_t wordErrors = 0;
+};
+
+// Transcription callback target; one file is replayed at a time
+struct Collected {
+    std::mutex mutex;
+    std::string text;
+    size_t count = 0;
+};
+
+static bool ReplayFile(AudioCaptureEngine& engine, Collected& collected, const fs::path& path,
+                       bool realtime, FileResult& result) {
+    AudioSource::WavData wav;
+    std::string error;
+    if (!AudioSource::LoadWav(path.string(), wav, error)) {
+        std::cerr << "[Bench] Skipping " << path.string() << ": " << error << std::endl;
+        return false;
+    }
+
+    AudioResampler resampler;
+    if (!resampler.Configure(wav.sampleRate, TARGET_RATE, wav.channels, wav.format)) {
+        std::cerr << "[Bench] Skipping " << path.string() << ": cannot resample " << wav.sampleRate << " Hz" << std::endl;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(collected.mutex);
+        collected.text.clear();
+        collected.count = 0;
+    }
+    size_t segmentsBefore = engine.GetQueuedUtteranceCount();
+
+    const size_t packetFrames = (std::max)(static_cast<size_t>(wav.sampleRate * PACKET_MS / 1000), size_t(1));
+    std::vector<float> packet(resampler.MaxOutputFrames(packetFrames));
+    const size_t totalFrames = wav.Frames();
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t frame = 0; frame < totalFrames; frame += packetFrames) {
+        size_t frames = (std::min)(packetFrames, totalFrames - frame);
+
+        if (realtime) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(
+                static_cast<int64_t>(frame * 1000000.0 / wav.sampleRate)));
+        } else {
+            while (engine.GetPendingReplaySamples() > MAX_PENDING_SAMPLES) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        auto resampleStart = std::chrono::steady_clock::now();
+        size_t produced = resampler.Process(wav.data.data() + frame * wav.bytesPerFrame, frames,
+                                            packet.data(), packet.size());
+        PipelineLatency::Record(PipelineLatency::Stage::Resample, std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - resampleStart).count());
+        engine.FeedReplayAudio(packet.data(), produced);
+    }
+
+    // Trailing silence closes the last utterance, then wait for whisper to drain
+    std::vector<float> silence(TARGET_RATE * PACKET_MS / 1000, 0.0f);
+    for (int ms = 0; ms < TRAILING_SILENCE_MS; ms += PACKET_MS) {
+        if (realtime) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(PACKET_MS));
+        }
+        engine.FeedReplayAudio(silence.data(), silence.size());
+    }
+    while (!engine.IsReplayIdle()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    result.name = path.filename().string();
+    result.audioSec = static_cast<double>(totalFrames) / wav.sampleRate;
+    result.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.segments = engine.GetQueuedUtteranceCount() - segmentsBefore;
+    {
+        std::lock_guard<std::mutex> lock(collected.mutex);
+        result.hypothesis = collected.text;
+        result.transcriptions = collected.count;
+    }
+
+    fs::path referencePath = path;
+    referencePath.replace_extension(".txt");
+    std::ifstream referenceFile(referencePath);
+    if (referenceFile) {
+        std::stringstream reference;
+        reference << referenceFile.rdbuf();
+        std::vector<std::string> referenceWords = NormalizeWords(reference.str());
+        result.hasReference = true;
+        result.referenceWords = referenceWords.size();
+        result.wordErrors = WordErrors(referenceWords, NormalizeWords(result.hypothesis));
+    }
+    return true;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static void PrintReport(const std::vector<FileResult>& results, bool realtime) {
+    double audioSec = 0.0, wallSec = 0.0;
+    size_t segments = 0, referenceWords = 0, wordErrors = 0;
+    char line[256];
+
+    Log::Flush();                           // Engine logs are asynchronous; keep them above the report
+    std::cout << std::endl << "=== bench_audio (" << (realtime ? "real-time" : "max speed") << ") ===" << std::endl;
+    std::cout << "file                              audio s   wall s    RTF  segs  WER" << std::endl;
+    for (const FileResult& r : results) {
+        audioSec += r.audioSec;
+        wallSec += r.wallSec;
+        segments += r.segments;
+        referenceWords += r.referenceWords;
+        wordErrors += r.wordErrors;
+
+        std::string wer = "  -";
+        if (r.hasReference && r.referenceWords > 0) {
+            std::snprintf(line, sizeof(line), "%5.1f%%", 100.0 * r.wordErrors / r.referenceWords);
+            wer = line;
+        }
+        std::snprintf(line, sizeof(line), "%-32.32s %8.2f %8.2f %6.3f %5zu %s",
+                      r.name.c_str(), r.audioSec, r.wallSec, r.audioSec > 0 ? r.wallSec / r.audioSec : 0.0,
+                      r.segments, wer.c_str());
+        std::cout << line << std::endl;
+    }
+
+    double whisperSec = PipelineLatency::Get(PipelineLatency::Stage::Whisper).SumMs() / 1000.0;
+    std::snprintf(line, sizeof(line), "total: %.2f s audio, %.2f s wall, RTF %.3f (whisper compute RTF %.3f), %zu segments",
+                  audioSec, wallSec, audioSec > 0 ? wallSec / audioSec : 0.0,
+                  audioSec > 0 ? whisperSec / audioSec : 0.0, segments);
+    std::cout << line << std::endl;
+    if (referenceWords > 0) {
+        std::snprintf(line, sizeof(line), "WER: %.2f%% (%zu errors / %zu reference words)",
+                      100.0 * wordErrors / referenceWords, wordErrors, referenceWords);
+        std::cout << line << std::endl;
+    }
+
+    std::cout << std::endl << "stage                    count     p50 ms     p90 ms     p99 ms     max ms" << std::endl;
+    for (PipelineLatency::Stage stage : VOICE_STAGES) {
+        const LatencyHistogram& h = PipelineLatency::Get(stage);
+        std::snprintf(line, sizeof(line), "%-22s %7llu %10.3f %10.3f %10.3f %10.3f",
+                      PipelineLatency::StageName(stage), static_cast<unsigned long long>(h.Count()),
+                      h.QuantileMs(0.5), h.QuantileMs(0.9), h.QuantileMs(0.99), h.MaxMs());
+        std::cout << line << std::endl;
+    }
+    if (!realtime) {
+        std::cout << "(silence_hold / utterance_end_to_end are compressed at max speed; use --realtime)" << std::endl;
+    }
+}
+
+static bool WriteJson(const std::string& path, const std::vector<FileResult>& results, bool realtime) {
+    std::string out;
+    JsonWriter writer(out);
+    writer.BeginObject();
+    writer.Key("mode").String(realtime ? "realtime" : "max");
+    writer.Key("files").BeginArray();
+    for (const FileResult& r : results) {
+        writer.BeginObject();
+        writer.Key("name").String(r.name);
+        writer.Key("audioSec").Double(r.audioSec, 3);
+        writer.Key("wallSec").Double(r.wallSec, 3);
+        writer.Key("rtf").Double(r.audioSec > 0 ? r.wallSec / r.audioSec : 0.0, 4);
+        writer.Key("segments").UInt(r.segments);
+        writer.Key("transcriptions").UInt(r.transcriptions);
+        writer.Key("hypothesis").String(r.hypothesis);
+        writer.Key("wer");
+        if (r.hasReference && r.referenceWords > 0) {
+            writer.Double(static_cast<double>(r.wordErrors) / r.referenceWords, 4);
+        } else {
+            writer.Null();
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("stages").BeginObject();
+    for (PipelineLatency::Stage stage : VOICE_STAGES) {
+        const LatencyHistogram& h = PipelineLatency::Get(stage);
+        writer.Key(PipelineLatency::StageName(stage)).BeginObject();
+        writer.Key("count").UInt(h.Count());
+        writer.Key("p50Ms").Double(h.QuantileMs(0.5), 3);
+        writer.Key("p90Ms").Double(h.QuantileMs(0.9), 3);
+        writer.Key("p99Ms").Double(h.QuantileMs(0.99), 3);
+        writer.Key("maxMs").Double(h.MaxMs(), 3);
+        writer.EndObject();
+    }
+    writer.EndObject();
+    writer.EndObject();
+
+    std::ofstream file(path, std::ios::binary);
+    file << out << '\n';
+    return static_cast<bool>(file);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+    std::string input;
+    std::string modelPath;
+    std::string fastModelPath;
+    std::string jsonPath;
+    bool realtime = false;
+    bool streaming = false;
+    AudioCaptureEngine::SegmenterConfig segmenter;
+    AudioCaptureEngine::WhisperBackend whisperBackend = AudioCaptureEngine::WhisperBackend::Auto;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc) {
+            modelPath = argv[++i];
+        } else if (arg == "--fast-model" && i + 1 < argc) {
+            fastModelPath = argv[++i];
+        } else if (arg == "--whisper" && i + 1 < argc) {
+            if (!AudioCaptureEngine::ParseWhisperBackend(argv[++i], whisperBackend)) {
+                input.clear();
+                break;
+            }
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--realtime") {
+            realtime = true;
+        } else if (arg == "--streaming") {
+            streaming = true;
+        } else if (arg == "--pre-roll-ms" && i + 1 < argc) {
+            segmenter.preRollMs = std::atoi(argv[++i]);
+        } else if (arg == "--silence-ms" && i + 1 < argc) {
+            segmenter.silenceThresholdMs = std::atoi(argv[++i]);
+        } else if (arg == "--min-speech-ms" && i + 1 < argc) {
+            segmenter.minSpeechMs = std::atoi(argv[++i]);
+        } else if (arg == "--max-speech-sec" && i + 1 < argc) {
+            segmenter.maxSpeechSec = std::atoi(argv[++i]);
+        } else if (arg == "--vad-on" && i + 1 < argc) {
+            segmenter.speechOnThreshold = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--vad-off" && i + 1 < argc) {
+            segmenter.speechOffThreshold = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--chunk-min-sec" && i + 1 < argc) {
+            segmenter.chunkMinSec = std::atoi(argv[++i]);
+        } else if (arg == "--chunk-max-sec" && i + 1 < argc) {
+            segmenter.chunkMaxSec = std::atoi(argv[++i]);
+        } else if (arg == "--turn-min-ms" && i + 1 < argc) {
+            segmenter.turnMinSilenceMs = std::atoi(argv[++i]);
+        } else if (arg == "--turn-max-ms" && i + 1 < argc) {
+            segmenter.turnMaxSilenceMs = std::atoi(argv[++i]);
+        } else if (input.empty() && arg[0] != '-') {
+            input = arg;
+        } else {
+            input.clear();
+            break;
+        }
+    }
+    if (input.empty()) {
+        std::cout << "Usage: bench_audio <file.wav | directory> [--model PATH] [--fast-model PATH] [--whisper auto|cpu|gpu]" << std::endl
+                  << "                   [--realtime] [--streaming] [--json PATH]" << std::endl
+                  << "                   [--pre-roll-ms N] [--silence-ms N] [--min-speech-ms N] [--max-speech-sec N]" << std::endl
+                  << "                   [--vad-on P] [--vad-off P] [--chunk-min-sec N] [--chunk-max-sec N]" << std::endl
+                  << "                   [--turn-min-ms N] [--turn-max-ms N]" << std::endl;
+        return 1;
+    }
+
+    std::vector<fs::path> files;
+    std::error_code ec;
+    if (fs::is_directory(input, ec)) {
+        for (const auto& entry : fs::directory_iterator(input, ec)) {
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (entry.is_regular_file() && extension == ".wav") {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());  // Stable order across runs
+    } else {
+        files.push_back(input);
+    }
+    if (files.empty()) {
+        std::cout << "[ERROR] No .wav files in " << input << std::endl;
+        return 1;
+    }
+
+    if (modelPath.empty()) {
+        modelPath = fs::exists("models/whisper/ggml-base.en.bin", ec) ? "models/whisper/ggml-base.en.bin"
+                                                                      : "models/whisper/ggml-tiny.en.bin";
+    }
+
+    AudioCaptureEngine engine;
+    if (!fastModelPath.empty()) {
+        engine.SetFastWhisperModel(fastModelPath);
+    }
+    engine.SetWhisperBackend(whisperBackend);
+    engine.SetStreamingEnabled(streaming);
+    if (!engine.SetSegmenterConfig(segmenter)) {
+        std::cout << "[ERROR] Segmenter settings out of range" << std::endl;
+        return 1;
+    }
+    if (!engine.InitializeReplay(modelPath)) {
+        std::cout << "[ERROR] Failed to initialize the audio pipeline with " << modelPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "[Bench] Whisper on " << engine.GetWhisperDevice() << std::endl;
+
+    Collected collected;
+    engine.SetTranscriptionCallback([&collected](const std::string& transcription) {
+        std::lock_guard<std::mutex> lock(collected.mutex);
+        if (!collected.text.empty()) {
+            collected.text += ' ';
+        }
+        collected.text += transcription;
+        collected.count++;
+    });
+
+    // Model loading stays out of the numbers
+    for (PipelineLatency::Stage stage : VOICE_STAGES) {
+        PipelineLatency::Get(stage).Reset();
+    }
+    if (!engine.Start()) {
+        std::cout << "[ERROR] Failed to start the audio pipeline" << std::endl;
+        return 1;
+    }
+
+    std::vector<FileResult> results;
+    for (const fs::path& path : files) {
+        std::cout << "[Bench] Replaying " << path.string() << std::endl;
+        FileResult result;
+        if (ReplayFile(engine, collected, path, realtime, result)) {
+            results.push_back(std::move(result));
+        }
+    }
+    engine.Stop();
+    engine.SetTranscriptionCallback(nullptr);
+
+    PrintReport(results, realtime);
+    if (!jsonPath.empty() && !WriteJson(jsonPath, results, realtime)) {
+        std::cout << "[ERROR] Could not write " << jsonPath << std::endl;
+        return 1;
+    }
+    return results.empty() ? 1 : 0;
+}
@@ -0,0 +1,526 @@
+// bench_camera - Caption pipeline benchmark over a fixed image corpus
+//
+// Runs CameraVisionEngine::DescribeImage over every image of a folder (default:
+// test_frame_320x240.jpg) and reports preprocess / encoder / prefill / per-token
+// decode latency (PipelineLatency), tokens/s, whole-caption latency, captions
+// per second, model load time, peak working set and the captions themselves.
+//
+// Usage:
+//   bench_camera [image | folder] [--models DIR] [--iterations N] [--max-tokens N]
+//                [--max-context N] [--threads N[,N...]] [--provider CPU|DirectML|OpenVINO[,...]]
+//                [--opt cached|disable|basic|extended|all[,...]]
+//                [--variant auto|ranked|fp32|fp16|int8|q4|q4f16]
+//                [--no-speculative] [--pipelined] [--sweep] [--json PATH]
+//
+// --pipelined captions the corpus with DescribeImagesPipelined (encoder of one
+// image overlapping the decode of the previous, encoder on half the threads in
+// its own pool); compare its captions/s with the default serial run.
+//
+// --max-context caps the decoder's KV positions (GenerationConfig::maxContext,
+// 0 = unlimited); the KV precision follows the decoder variant.
+//
+// --variant picks the weight precision of each model (see ModelVariants);
+// a precision missing for some model falls back to the ranked choice there.
+//
+// The ORT thread pool is process-wide and fixed once created, so a list for any
+// of --threads/--provider/--opt (or --sweep for the default grid) runs every
+// combination in its own child process and prints one row per configuration.
+// "cached" is the production path (<model>.opt.onnx); the other levels build an
+// uncached session at that optimization level.
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <windows.h>
+#include <psapi.h>
+#include <opencv2/opencv.hpp>
+#include "CameraVisionEngine.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "LatencyHistogram.h"
+#include "Log.h"
+#include "OrtRuntime.h"
+#include "PipelineLatency.h"
+
+#pragma comment(lib, "psapi.lib")
+
+namespace fs = std::filesystem;
+
+static const PipelineLatency::Stage CAMERA_STAGES[] = {
+    PipelineLatency::Stage::Preprocess,
+    PipelineLatency::Stage::Encoder,
+    PipelineLatency::Stage::Prefill,
+    PipelineLatency::Stage::DecodeToken,
+};
+
+static const char* const SWEEP_PROVIDERS[] = { "CPU", "DirectML", "OpenVINO" };
+static const char* const SWEEP_OPT_LEVELS[] = { "cached", "disable", "basic", "extended", "all" };
+
+struct Options {
+    std::string input = "test_frame_320x240.jpg";
+    std::string modelDir = "models/fastvlm";
+    int iterations = 3;
+    int maxTokens = 50;
+    int maxContext = 0;
+    bool speculative = true;
+    bool pipelined = false;
+    std::string variant = "auto";
+    bool sweep = false;
+    std::vector<int> threads;               // 0 = CpuBudget default
+    std::vector<std::string> providers;
+    std::vector<std::string> optLevels;
+    std::string jsonPath;
+    std::string resultPath;                 // Child mode: write the single result here
+};
+
+struct Config {
+    int threads = 0;
+    std::string provider = "CPU";
+    std::string opt = "cached";
+};
+
+static std::vector<std::string> SplitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static bool ParseOptLevel(const std::string& name, GraphOptimizationLevel& level) {
+    if (name == "disable")  { level = GraphOptimizationLevel::ORT_DISABLE_ALL; return true; }
+    if (name == "basic")    { level = GraphOptimizationLevel::ORT_ENABLE_BASIC; return true; }
+    if (name == "extended") { level = GraphOptimizationLevel::ORT_ENABLE_EXTENDED; return true; }
+    if (name == "all")      { level = GraphOptimizationLevel::ORT_ENABLE_ALL; return true; }
+    return false;
+}
+
+static double PeakWorkingSetMb() {
+    PROCESS_MEMORY_COUNTERS counters = {};
+    counters.cb = sizeof(counters);
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0.0;
+    }
+    return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+}
+
+static std::vector<fs::path> ListImages(const std::string& input) {
+    std::vector<fs::path> images;
+    std::error_code ec;
+    if (!fs::is_directory(input, ec)) {
+        images.push_back(input);
+        return images;
+    }
+    for (const auto& entry : fs::directory_iterator(input, ec)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (entry.is_regular_file() &&
+            (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp")) {
+            images.push_back(entry.path());
+        }
+    }
+    std::sort(images.begin(), images.end());    // Stable order across runs
+    return images;
+}
+
+static void WriteQuantiles(JsonWriter& writer, const LatencyHistogram& histogram) {
+    writer.BeginObject();
+    writer.Key("count").UInt(histogram.Count());
+    writer.Key("p50Ms").Double(histogram.QuantileMs(0.5), 3);
+    writer.Key("p90Ms").Double(histogram.QuantileMs(0.9), 3);
+    writer.Key("p99Ms").Double(histogram.QuantileMs(0.99), 3);
+    writer.Key("maxMs").Double(histogram.MaxMs(), 3);
+    writer.EndObject();
+}
+
+// ============================================================================
+// One Configuration
+// ============================================================================
+
+// Runs the corpus under config; result gets one JSON object
+static bool RunConfig(const Options& options, const Config& config, std::string& result) {
+    GraphOptimizationLevel level = GraphOptimizationLevel::ORT_DISABLE_ALL;
+    if (config.opt != "cached" && !ParseOptLevel(config.opt, level)) {
+        std::cerr << "[Bench] Unknown optimization level " << config.opt << std::endl;
+        return false;
+    }
+
+    // Sizes the global pool: must precede the first OrtRuntime::Instance()
+    OrtRuntime::SetGlobalIntraOpThreads(config.threads);
+    if (config.provider != "CPU" && !OrtRuntime::Instance().IsProviderAvailable(config.provider)) {
+        std::cerr << "[Bench] Execution provider " << config.provider << " not in this ONNX Runtime build" << std::endl;
+        return false;
+    }
+
+    std::vector<fs::path> paths = ListImages(options.input);
+    std::vector<cv::Mat> images;
+    std::vector<std::string> names;
+    for (const fs::path& path : paths) {
+        cv::Mat image = cv::imread(path.string(), cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "[Bench] Skipping unreadable image " << path.string() << std::endl;
+            continue;
+        }
+        images.push_back(std::move(image));
+        names.push_back(path.filename().string());
+    }
+    if (images.empty()) {
+        std::cerr << "[Bench] No images in " << options.input << std::endl;
+        return false;
+    }
+
+    CameraVisionEngine engine;
+    engine.SetExecutionProviders({ config.provider });
+    engine.SetOptimizedModelsEnabled(config.opt == "cached");
+    engine.SetGraphOptimizationLevel(level);
+    engine.SetSpeculativeDecoding(options.speculative ? 4 : 0);
+    engine.SetModelVariant(options.variant);
+    if (options.pipelined) {
+        engine.SetEncoderThreads((std::max)(1, OrtRuntime::Instance().GetGlobalIntraOpThreads() / 2));
+    }
+    CameraVisionEngine::GenerationConfig generation = engine.GetGenerationConfig();
+    generation.maxTokens = options.maxTokens;
+    generation.maxContext = options.maxContext;
+    engine.SetGenerationConfig(generation);
+
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!engine.InitializeWithoutCamera(options.modelDir)) {
+        std::cerr << "[Bench] Failed to load models from " << options.modelDir << std::endl;
+        return false;
+    }
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+    // Warm-up caption (first-run allocations, provider kernel compilation) stays out of the numbers
+    engine.DescribeImage(images.front());
+    for (PipelineLatency::Stage stage : CAMERA_STAGES) {
+        PipelineLatency::Get(stage).Reset();
+    }
+
+    LatencyHistogram captionLatency;
+    std::vector<std::string> captions(images.size());
+    auto runStart = std::chrono::steady_clock::now();
+    if (options.pipelined) {
+        std::vector<float> latencies;
+        for (int iteration = 0; iteration < options.iterations; ++iteration) {
+            captions = engine.DescribeImagesPipelined(images, &latencies);
+            for (float latencyMs : latencies) {
+                captionLatency.RecordMs(latencyMs);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < images.size(); ++i) {
+            for (int iteration = 0; iteration < options.iterations; ++iteration) {
+                auto start = std::chrono::steady_clock::now();
+                captions[i] = engine.DescribeImage(images[i]);
+                captionLatency.RecordMs(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+        }
+    }
+    double runMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+    double captionsPerSec = runMs > 0.0 ? images.size() * options.iterations * 1000.0 / runMs : 0.0;
+
+    const LatencyHistogram& decode = PipelineLatency::Get(PipelineLatency::Stage::DecodeToken);
+    double tokensPerSec = decode.SumMs() > 0.0 ? decode.Count() * 1000.0 / decode.SumMs() : 0.0;
+
+    JsonWriter writer(result);
+    writer.BeginObject();
+    writer.Key("threads").Int(OrtRuntime::Instance().GetGlobalIntraOpThreads());
+    writer.Key("provider").String(config.provider);
+    writer.Key("opt").String(config.opt);
+    writer.Key("pipelined").Bool(options.pipelined);
+    writer.Key("variant").String(options.variant);
+    writer.Key("loadMs").Double(loadMs, 1);
+    writer.Key("images").UInt(images.size());
+    writer.Key("iterations").Int(options.iterations);
+    writer.Key("captionMs");
+    WriteQuantiles(writer, captionLatency);
+    writer.Key("stages").BeginObject();
+    for (PipelineLatency::Stage stage : CAMERA_STAGES) {
+        writer.Key(PipelineLatency::StageName(stage));
+        WriteQuantiles(writer, PipelineLatency::Get(stage));
+    }
+    writer.EndObject();
+    writer.Key("tokensPerSec").Double(tokensPerSec, 2);
+    writer.Key("captionsPerSec").Double(captionsPerSec, 3);
+    writer.Key("peakRssMb").Double(PeakWorkingSetMb(), 1);
+    writer.Key("captions").BeginArray();
+    for (size_t i = 0; i < images.size(); ++i) {
+        writer.BeginObject();
+        writer.Key("image").String(names[i]);
+        writer.Key("text").String(captions[i]);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return true;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static void PrintSummaryHeader() {
+    std::cout << "threads provider  opt       load ms  caption p50  encoder p50  prefill p50  token p50   tok/s"
+              << "  cap/s  peak MB" << std::endl;
+}
+
+static void PrintSummaryRow(const JsonValue& r) {
+    std::string scratch;
+    JsonValue stages = r["stages"];
+    char line[256];
+    std::snprintf(line, sizeof(line), "%7lld %-9s %-8s %8.0f %12.1f %12.1f %12.1f %10.2f %7.1f %6.2f %8.0f",
+                  static_cast<long long>(r["threads"].AsInt()),
+                  std::string(r["provider"].AsString(scratch)).c_str(),
+                  std::string(r["opt"].AsString(scratch)).c_str(),
+                  r["loadMs"].AsDouble(), r["captionMs"]["p50Ms"].AsDouble(),
+                  stages["encoder"]["p50Ms"].AsDouble(), stages["prefill"]["p50Ms"].AsDouble(),
+                  stages["decode_token"]["p50Ms"].AsDouble(), r["tokensPerSec"].AsDouble(),
+                  r["captionsPerSec"].AsDouble(), r["peakRssMb"].AsDouble());
+    std::cout << line << std::endl;
+}
+
+static void PrintDetail(const JsonValue& r) {
+    std::cout << std::endl << "stage           count     p50 ms     p90 ms     p99 ms     max ms" << std::endl;
+    auto row = [](const char* name, const JsonValue& q) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-13s %7lld %10.3f %10.3f %10.3f %10.3f", name,
+                      static_cast<long long>(q["count"].AsInt()), q["p50Ms"].AsDouble(), q["p90Ms"].AsDouble(),
+                      q["p99Ms"].AsDouble(), q["maxMs"].AsDouble());
+        std::cout << line << std::endl;
+    };
+    for (PipelineLatency::Stage stage : CAMERA_STAGES) {
+        row(PipelineLatency::StageName(stage), r["stages"][PipelineLatency::StageName(stage)]);
+    }
+    row("caption", r["captionMs"]);
+
+    std::cout << std::endl;
+    std::string image, text;
+    size_t cursor = 0;
+    JsonValue caption;
+    JsonValue captions = r["captions"];
+    while (captions.Next(cursor, caption)) {
+        std::cout << std::string(caption["image"].AsString(image)) << ": "
+                  << std::string(caption["text"].AsString(text)) << std::endl;
+    }
+}
+
+static bool WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary);
+    file << contents << '\n';
+    return static_cast<bool>(file);
+}
+
+// ============================================================================
+// Sweep
+// ============================================================================
+
+static std::string Quote(const std::string& arg) {
+    return "\"" + arg + "\"";
+}
+
+// Child process for one configuration; returns its result JSON (empty on failure)
+static std::string RunChild(const Options& options, const Config& config, size_t index) {
+    char exePath[MAX_PATH];
+    GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+
+    std::error_code ec;
+    std::string resultPath = (fs::temp_directory_path(ec) / ("bench_camera_" + std::to_string(GetCurrentProcessId()) +
+                              "_" + std::to_string(index) + ".json")).string();
+
+    std::string command = Quote(exePath) + " " + Quote(options.input) +
+        " --models " + Quote(options.modelDir) +
+        " --iterations " + std::to_string(options.iterations) +
+        " --max-tokens " + std::to_string(options.maxTokens) +
+        " --max-context " + std::to_string(options.maxContext) +
+        " --threads " + std::to_string(config.threads) +
+        " --provider " + config.provider +
+        " --opt " + config.opt +
+        (options.speculative ? "" : " --no-speculative") +
+        (options.pipelined ? " --pipelined" : "") +
+        " --variant " + options.variant +
+        " --result " + Quote(resultPath);
+
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process = {};
+    std::vector<char> commandLine(command.begin(), command.end());
+    commandLine.push_back('\0');
+    if (!CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process)) {
+        std::cerr << "[Bench] Failed to start child: " << GetLastError() << std::endl;
+        return "";
+    }
+    WaitForSingleObject(process.hProcess, INFINITE);
+    DWORD exitCode = 1;
+    GetExitCodeProcess(process.hProcess, &exitCode);
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+
+    std::string result;
+    if (exitCode == 0) {
+        std::ifstream file(resultPath, std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        result = contents.str();
+    }
+    fs::remove(resultPath, ec);
+    return result;
+}
+
+static int RunSweep(const Options& options) {
+    std::vector<int> threads = options.threads;
+    std::vector<std::string> providers = options.providers;
+    std::vector<std::string> optLevels = options.optLevels;
+    if (options.sweep) {
+        if (threads.empty()) {
+            int hardware = (std::max)(1, static_cast<int>(std::thread::hardware_concurrency()));
+            for (int n = 1; n <= hardware && n <= 8; n *= 2) {
+                threads.push_back(n);
+            }
+        }
+        if (providers.empty()) {
+            providers.assign(std::begin(SWEEP_PROVIDERS), std::end(SWEEP_PROVIDERS));
+        }
+        if (optLevels.empty()) {
+            optLevels.assign(std::begin(SWEEP_OPT_LEVELS), std::end(SWEEP_OPT_LEVELS));
+        }
+    }
+    if (threads.empty()) threads = { 0 };
+    if (providers.empty()) providers = { "CPU" };
+    if (optLevels.empty()) optLevels = { "cached" };
+
+    std::vector<std::string> results;
+    for (const std::string& provider : providers) {
+        for (const std::string& opt : optLevels) {
+            for (int n : threads) {
+                Config config;
+                config.threads = n;
+                config.provider = provider;
+                config.opt = opt;
+                std::cout << "[Bench] " << provider << ", opt " << opt << ", "
+                          << (n > 0 ? std::to_string(n) : std::string("default")) << " threads..." << std::endl;
+                std::string result = RunChild(options, config, results.size());
+                if (result.empty()) {
+                    std::cout << "[Bench] Configuration failed or unavailable, skipped" << std::endl;
+                    continue;
+                }
+                results.push_back(std::move(result));
+            }
+        }
+    }
+
+    std::cout << std::endl << "=== bench_camera sweep ===" << std::endl;
+    PrintSummaryHeader();
+    std::string all = "[";
+    for (const std::string& result : results) {
+        PrintSummaryRow(JsonReader::Parse(result));
+        all += (all.size() > 1 ? "," : "") + result;
+    }
+    all += "]";
+
+    if (!options.jsonPath.empty() && !WriteFile(options.jsonPath, all)) {
+        std::cout << "[ERROR] Could not write " << options.jsonPath << std::endl;
+        return 1;
+    }
+    return results.empty() ? 1 : 0;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+    Options options;
+    bool haveInput = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--models" && hasValue) {
+            options.modelDir = argv[++i];
+        } else if (arg == "--iterations" && hasValue) {
+            options.iterations = (std::max)(1, std::atoi(argv[++i]));
+        } else if (arg == "--max-tokens" && hasValue) {
+            options.maxTokens = (std::max)(1, std::atoi(argv[++i]));
+        } else if (arg == "--max-context" && hasValue) {
+            options.maxContext = (std::max)(0, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            for (const std::string& n : SplitList(argv[++i])) {
+                options.threads.push_back((std::max)(0, std::atoi(n.c_str())));
+            }
+        } else if (arg == "--provider" && hasValue) {
+            options.providers = SplitList(argv[++i]);
+        } else if (arg == "--opt" && hasValue) {
+            options.optLevels = SplitList(argv[++i]);
+        } else if (arg == "--variant" && hasValue) {
+            options.variant = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--result" && hasValue) {
+            options.resultPath = argv[++i];
+        } else if (arg == "--no-speculative") {
+            options.speculative = false;
+        } else if (arg == "--pipelined") {
+            options.pipelined = true;
+        } else if (arg == "--sweep") {
+            options.sweep = true;
+        } else if (!haveInput && arg[0] != '-') {
+            options.input = arg;
+            haveInput = true;
+        } else {
+            std::cout << "Usage: bench_camera [image | folder] [--models DIR] [--iterations N] [--max-tokens N]" << std::endl
+                      << "                    [--max-context N] [--threads N[,N...]] [--provider CPU|DirectML|OpenVINO[,...]]" << std::endl
+                      << "                    [--opt cached|disable|basic|extended|all[,...]]" << std::endl
+                      << "                    [--variant auto|ranked|fp32|fp16|int8|q4|q4f16]" << std::endl
+                      << "                    [--no-speculative] [--pipelined] [--sweep] [--json PATH]" << std::endl;
+            return 1;
+        }
+    }
+
+    bool multiple = options.threads.size() > 1 || options.providers.size() > 1 || options.optLevels.size() > 1;
+    if (options.sweep || multiple) {
+        return RunSweep(options);
+    }
+
+    Config config;
+    if (!options.threads.empty()) config.threads = options.threads.front();
+    if (!options.providers.empty()) config.provider = options.providers.front();
+    if (!options.optLevels.empty()) config.opt = options.optLevels.front();
+
+    std::string result;
+    if (!RunConfig(options, config, result)) {
+        return 1;
+    }
+
+    // Child of a sweep: hand the result back for the summary table
+    if (!options.resultPath.empty()) {
+        return WriteFile(options.resultPath, result) ? 0 : 1;
+    }
+
+    JsonValue parsed = JsonReader::Parse(result);
+    Log::Flush();                           // Engine logs are asynchronous; keep them above the report
+    std::cout << std::endl << "=== bench_camera ===" << std::endl;
+    PrintSummaryHeader();
+    PrintSummaryRow(parsed);
+    PrintDetail(parsed);
+
+    if (!options.jsonPath.empty() && !WriteFile(options.jsonPath, result)) {
+        std::cout << "[ERROR] Could not write " << options.jsonPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
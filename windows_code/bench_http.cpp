@@ -0,0 +1,736 @@
+// bench_http - Load generator and latency benchmark for HttpServer
+//
+// Opens N client connections against a running PerceptionEngine (or a stub
+// server, see --self) and hammers one endpoint per run for a fixed duration,
+// with and without keep-alive. Every run reports requests/s, MB/s, request
+// latency p50/p90/p99/p999/max (connect included when keep-alive is off),
+// failed and non-2xx requests, and the server process's thread and handle
+// counts before, at peak during, and after the run - so a connection leak or
+// a thread-per-connection regression shows up as a number, not a hunch.
+//
+// Usage:
+//   bench_http [--host 127.0.0.1] [--port 8777] [--connections N[,N...]]
+//              [--duration S] [--warmup S] [--keep-alive on|off|both]
+//              [--endpoint context|dashboard|update_context[,...]]
+//              [--pid PID] [--self] [--json PATH]
+//
+// The server's counters come from --pid, else the first PerceptionEngine.exe
+// found. --self starts this program as a child process serving the same
+// routes from canned content (--serve PORT), which measures HttpServer alone
+// without the collectors behind /context. Note that /update_context posts
+// really land in a live engine's context.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HttpServer.h"
+#include <tlhelp32.h>
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "LatencyHistogram.h"
+#include "StaticAssetCache.h"
+
+struct Endpoint {
+    const char* name;
+    const char* method;
+    const char* path;
+    const char* body;       // nullptr for GET
+};
+
+static const Endpoint ENDPOINTS[] = {
+    { "context", "GET", "/context", nullptr },
+    { "dashboard", "GET", "/dashboard", nullptr },
+    { "update_context", "POST", "/update_context",
+      "{\"device\":\"Camera\",\"data\":{\"caption\":\"bench_http load test\"},\"latencyMs\":1}" },
+};
+
+static constexpr int SAMPLE_INTERVAL_MS = 200;
+static constexpr int SETTLE_MS = 1000;              // After a run, before the "after" sample
+static constexpr int CONNECT_RETRY_MS = 50;         // Stub server startup in --self mode
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8777;
+    std::vector<int> connections;
+    int durationS = 5;
+    int warmupS = 1;
+    std::vector<bool> keepAlive;
+    std::vector<std::string> endpoints;
+    DWORD pid = 0;
+    bool self = false;
+    int servePort = 0;                              // Child mode: run the stub server
+    std::string jsonPath;
+};
+
+static std::vector<std::string> SplitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static const Endpoint* FindEndpoint(const std::string& name) {
+    for (const Endpoint& endpoint : ENDPOINTS) {
+        if (name == endpoint.name) {
+            return &endpoint;
+        }
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// Stub Server (--serve)
+// ============================================================================
+
+// A /context-sized document: the real one is built by ContextCollector
+static std::string BuildStubContext() {
+    std::string json;
+    JsonWriter writer(json);
+    writer.BeginObject();
+    writer.Key("timestamp").Int(0);
+    writer.Key("windows").BeginArray();
+    for (int i = 0; i < 24; ++i) {
+        writer.BeginObject();
+        writer.Key("title").String("Window " + std::to_string(i) + " - bench_http stub content");
+        writer.Key("process").String("process" + std::to_string(i) + ".exe");
+        writer.Key("focused").Bool(i == 0);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("camera").BeginObject().Key("caption").String("a person sitting at a desk").EndObject();
+    writer.Key("voice").BeginObject().Key("transcript").String("bench http stub transcript").EndObject();
+    writer.EndObject();
+    return json;
+}
+
+static int RunStubServer(int port) {
+    HttpServer server(port);
+    StaticAssetCache dashboardAsset("dashboard.html", "text/html; charset=utf-8");
+    auto context = std::make_shared<const std::string>(BuildStubContext());
+
+    server.SetRequestHandler([&](const HttpRequest& request, HttpResponse& response) {
+        if (request.path == "/context" && request.method == "GET") {
+            response.SetHeader("Content-Type", "application/json");
+            response.SetSharedBody(context);
+        } else if (request.path == "/dashboard" && request.method == "GET") {
+            if (!dashboardAsset.Serve(request, response)) {
+                response.SetHeader("Content-Type", "text/html; charset=utf-8");
+                response.SetBody("<html><body><h1>bench_http stub dashboard</h1></body></html>");
+            }
+        } else if (request.path == "/update_context" && request.method == "POST") {
+            JsonValue update = JsonReader::Parse(request.body);
+            response.SetHeader("Content-Type", "application/json");
+            if (update["device"].GetString().empty()) {
+                response.status = 400;
+                response.SetBody("{\"error\":\"invalid update\"}");
+            } else {
+                response.SetBody("{\"status\":\"ok\"}");
+            }
+        } else {
+            response.status = 404;
+            response.SetBody("Not Found");
+        }
+    });
+
+    if (!server.Start()) {
+        std::cerr << "[Bench] Stub server failed to listen on port " << port << std::endl;
+        return 1;
+    }
+    server.Run();       // Until the parent terminates this process
+    return 0;
+}
+
+// ============================================================================
+// Server Process Counters
+// ============================================================================
+
+static DWORD FindProcess(const wchar_t* exeName) {
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    DWORD pid = 0;
+    PROCESSENTRY32W entry = {};
+    entry.dwSize = sizeof(entry);
+    for (BOOL more = Process32FirstW(snapshot, &entry); more; more = Process32NextW(snapshot, &entry)) {
+        if (_wcsicmp(entry.szExeFile, exeName) == 0) {
+            pid = entry.th32ProcessID;
+            break;
+        }
+    }
+    CloseHandle(snapshot);
+    return pid;
+}
+
+static int CountThreads(DWORD pid) {
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    int count = 0;
+    THREADENTRY32 entry = {};
+    entry.dwSize = sizeof(entry);
+    for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry)) {
+        if (entry.th32OwnerProcessID == pid) {
+            ++count;
+        }
+    }
+    CloseHandle(snapshot);
+    return count;
+}
+
+/**
+ * ProcessSampler - Thread and handle counts of the server under load
+ *
+ * Samples every SAMPLE_INTERVAL_MS on its own thread between Start() and
+ * Stop(); Sample() takes a single reading for the before/after columns.
+ * Counts are -1 when the process can't be opened (no pid, access denied).
+ */
+class ProcessSampler {
+public:
+    struct Counts {
+        int threads = -1;
+        int handles = -1;
+    };
+
+    explicit ProcessSampler(DWORD pid)
+        : process(pid ? OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid) : nullptr), pid(pid) {}
+
+    ~ProcessSampler() {
+        Stop();
+        if (process) {
+            CloseHandle(process);
+        }
+    }
+
+    ProcessSampler(const ProcessSampler&) = delete;
+    ProcessSampler& operator=(const ProcessSampler&) = delete;
+
+    Counts Sample() const {
+        Counts counts;
+        if (!process) {
+            return counts;
+        }
+        DWORD handles = 0;
+        if (GetProcessHandleCount(process, &handles)) {
+            counts.handles = static_cast<int>(handles);
+        }
+        counts.threads = CountThreads(pid);
+        return counts;
+    }
+
+    void Start() {
+        peak = Sample();
+        sampling = true;
+        sampler = std::thread([this]() {
+            while (sampling) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(SAMPLE_INTERVAL_MS));
+                Counts now = Sample();
+                peak.threads = (std::max)(peak.threads, now.threads);
+                peak.handles = (std::max)(peak.handles, now.handles);
+            }
+        });
+    }
+
+    void Stop() {
+        sampling = false;
+        if (sampler.joinable()) {
+            sampler.join();
+        }
+    }
+
+    Counts Peak() const { return peak; }
+    bool IsOpen() const { return process != nullptr; }
+
+private:
+    HANDLE process;
+    DWORD pid;
+    Counts peak;
+    std::atomic<bool> sampling{false};
+    std::thread sampler;
+};
+
+// ============================================================================
+// Client
+// ============================================================================
+
+/**
+ * Client - One blocking HTTP/1.1 connection
+ *
+ * Responses are framed by Content-Length (what HttpServer sends), or by the
+ * server closing the connection. The socket is dropped after every request
+ * when keep-alive is off, or when the server answers "Connection: close".
+ */
+class Client {
+public:
+    explicit Client(const sockaddr_in& address) : address(address) {}
+    ~Client() { Close(); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    // Sends request and reads the whole response; false on any socket error
+    bool Exchange(const std::string& request, int& status, size_t& bytes) {
+        if (socket == INVALID_SOCKET && !Connect()) {
+            return false;
+        }
+        if (!SendAll(request) || !ReadResponse(status, bytes)) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (socket != INVALID_SOCKET) {
+            closesocket(socket);
+            socket = INVALID_SOCKET;
+        }
+        buffer.clear();
+    }
+
+private:
+    bool Connect() {
+        socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (socket == INVALID_SOCKET) {
+            return false;
+        }
+        BOOL noDelay = TRUE;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        if (connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    bool SendAll(const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            int n = send(socket, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Appends what the socket has; 0 when the peer closed
+    int Receive() {
+        char chunk[16384];
+        int n = recv(socket, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+        return n;
+    }
+
+    bool ReadResponse(int& status, size_t& bytes) {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (Receive() <= 0) {
+                return false;
+            }
+        }
+
+        std::string head = buffer.substr(0, headerEnd);
+        std::transform(head.begin(), head.end(), head.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (head.compare(0, 5, "http/") != 0 || head.find(' ') == std::string::npos) {
+            return false;
+        }
+        status = std::atoi(head.c_str() + head.find(' ') + 1);
+        bool closeAfter = head.find("\r\nconnection: close") != std::string::npos;
+
+        size_t bodyStart = headerEnd + 4;
+        size_t lengthAt = head.find("\r\ncontent-length:");
+        if (lengthAt == std::string::npos) {
+            // Unframed: the body runs to the end of the connection
+            while (Receive() > 0) {}
+            bytes = buffer.size();
+            Close();
+            return true;
+        }
+
+        size_t total = bodyStart + std::strtoull(head.c_str() + lengthAt + 17, nullptr, 10);
+        while (buffer.size() < total) {
+            if (Receive() <= 0) {
+                return false;
+            }
+        }
+        bytes = total;
+        buffer.erase(0, total);
+        if (closeAfter) {
+            Close();
+        }
+        return true;
+    }
+
+    sockaddr_in address;
+    SOCKET socket = INVALID_SOCKET;
+    std::string buffer;         // Received bytes not yet consumed
+};
+
+// ============================================================================
+// One Run
+// ============================================================================
+
+struct RunConfig {
+    const Endpoint* endpoint = nullptr;
+    bool keepAlive = true;
+    int connections = 1;
+};
+
+static std::string BuildRequest(const Options& options, const RunConfig& config) {
+    std::string request;
+    request.append(config.endpoint->method).append(" ").append(config.endpoint->path).append(" HTTP/1.1\r\n");
+    request.append("Host: ").append(options.host).append(":").append(std::to_string(options.port)).append("\r\n");
+    request.append("Accept-Encoding: gzip, br\r\n");
+    if (!config.keepAlive) {
+        request.append("Connection: close\r\n");
+    }
+    if (config.endpoint->body) {
+        request.append("Content-Type: application/json\r\n");
+        request.append("Content-Length: ").append(std::to_string(std::strlen(config.endpoint->body))).append("\r\n");
+    }
+    request.append("\r\n");
+    if (config.endpoint->body) {
+        request.append(config.endpoint->body);
+    }
+    return request;
+}
+
+static void WriteQuantiles(JsonWriter& writer, const LatencyHistogram& histogram) {
+    writer.BeginObject();
+    writer.Key("count").UInt(histogram.Count());
+    writer.Key("p50Ms").Double(histogram.QuantileMs(0.5), 3);
+    writer.Key("p90Ms").Double(histogram.QuantileMs(0.9), 3);
+    writer.Key("p99Ms").Double(histogram.QuantileMs(0.99), 3);
+    writer.Key("p999Ms").Double(histogram.QuantileMs(0.999), 3);
+    writer.Key("maxMs").Double(histogram.MaxMs(), 3);
+    writer.EndObject();
+}
+
+static void WriteCounts(JsonWriter& writer, const ProcessSampler::Counts& counts) {
+    writer.BeginObject();
+    writer.Key("threads").Int(counts.threads);
+    writer.Key("handles").Int(counts.handles);
+    writer.EndObject();
+}
+
+// Drives config.connections clients for the warm-up plus the measured duration;
+// result gets one JSON object
+static void RunLoad(const Options& options, const RunConfig& config, const sockaddr_in& address,
+                    DWORD serverPid, std::string& result) {
+    const std::string request = BuildRequest(options, config);
+    LatencyHistogram latency;
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> non2xx{0};
+    std::atomic<uint64_t> received{0};
+    std::atomic<bool> measuring{false};
+    std::atomic<bool> stop{false};
+
+    ProcessSampler sampler(serverPid);
+    ProcessSampler::Counts before = sampler.Sample();
+    sampler.Start();
+
+    std::vector<std::thread> clients;
+    clients.reserve(config.connections);
+    for (int i = 0; i < config.connections; ++i) {
+        clients.emplace_back([&]() {
+            Client client(address);
+            while (!stop) {
+                int status = 0;
+                size_t bytes = 0;
+                auto start = std::chrono::steady_clock::now();
+                bool ok = client.Exchange(request, status, bytes);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (!config.keepAlive) {
+                    client.Close();
+                }
+                if (!measuring) {
+                    continue;
+                }
+                if (!ok) {
+                    failures++;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MS));
+                    continue;
+                }
+                latency.RecordMs(ms);
+                requests++;
+                received += bytes;
+                if (status < 200 || status >= 300) {
+                    non2xx++;
+                }
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.warmupS));
+    measuring = true;
+    auto measureStart = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(options.durationS));
+    measuring = false;
+    double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - measureStart).count();
+    stop = true;
+    for (std::thread& client : clients) {
+        client.join();
+    }
+    sampler.Stop();
+
+    // Closed connections should be gone by now; a climbing "after" is a leak
+    std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+    ProcessSampler::Counts after = sampler.Sample();
+
+    JsonWriter writer(result);
+    writer.BeginObject();
+    writer.Key("endpoint").String(config.endpoint->name);
+    writer.Key("keepAlive").Bool(config.keepAlive);
+    writer.Key("connections").Int(config.connections);
+    writer.Key("durationS").Double(elapsedS, 2);
+    writer.Key("requests").UInt(requests.load());
+    writer.Key("failures").UInt(failures.load());
+    writer.Key("non2xx").UInt(non2xx.load());
+    writer.Key("requestsPerSec").Double(elapsedS > 0.0 ? requests.load() / elapsedS : 0.0, 1);
+    writer.Key("mbPerSec").Double(elapsedS > 0.0 ? received.load() / (1024.0 * 1024.0) / elapsedS : 0.0, 2);
+    writer.Key("latencyMs");
+    WriteQuantiles(writer, latency);
+    writer.Key("server").BeginObject();
+    writer.Key("before");
+    WriteCounts(writer, before);
+    writer.Key("peak");
+    WriteCounts(writer, sampler.Peak());
+    writer.Key("after");
+    WriteCounts(writer, after);
+    writer.EndObject();
+    writer.EndObject();
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static void PrintSummaryHeader() {
+    std::cout << "endpoint        ka   conns     req/s    MB/s  p50 ms  p90 ms  p99 ms p999 ms  max ms  fail  non2xx"
+              << "  threads b/peak/a   handles b/peak/a" << std::endl;
+}
+
+static void PrintSummaryRow(const JsonValue& r) {
+    std::string scratch;
+    JsonValue q = r["latencyMs"];
+    JsonValue server = r["server"];
+    char line[320];
+    std::snprintf(line, sizeof(line),
+                  "%-15s %-3s %6lld %9.1f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f %5lld %7lld %6lld/%4lld/%4lld %7lld/%4lld/%4lld",
+                  std::string(r["endpoint"].AsString(scratch)).c_str(), r["keepAlive"].AsBool() ? "on" : "off",
+                  static_cast<long long>(r["connections"].AsInt()), r["requestsPerSec"].AsDouble(),
+                  r["mbPerSec"].AsDouble(), q["p50Ms"].AsDouble(), q["p90Ms"].AsDouble(), q["p99Ms"].AsDouble(),
+                  q["p999Ms"].AsDouble(), q["maxMs"].AsDouble(),
+                  static_cast<long long>(r["failures"].AsInt()), static_cast<long long>(r["non2xx"].AsInt()),
+                  static_cast<long long>(server["before"]["threads"].AsInt()),
+                  static_cast<long long>(server["peak"]["threads"].AsInt()),
+                  static_cast<long long>(server["after"]["threads"].AsInt()),
+                  static_cast<long long>(server["before"]["handles"].AsInt()),
+                  static_cast<long long>(server["peak"]["handles"].AsInt()),
+                  static_cast<long long>(server["after"]["handles"].AsInt()));
+    std::cout << line << std::endl;
+}
+
+static bool WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary);
+    file << contents << '\n';
+    return static_cast<bool>(file);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+// --self: this executable in --serve mode; returns the child's process handle
+static HANDLE StartStubServer(int port, DWORD& pid) {
+    char exePath[MAX_PATH];
+    GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+    std::string command = "\"" + std::string(exePath) + "\" --serve " + std::to_string(port);
+
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process = {};
+    std::vector<char> commandLine(command.begin(), command.end());
+    commandLine.push_back('\0');
+    if (!CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process)) {
+        std::cerr << "[Bench] Failed to start stub server: " << GetLastError() << std::endl;
+        return nullptr;
+    }
+    CloseHandle(process.hThread);
+    pid = process.dwProcessId;
+    return process.hProcess;
+}
+
+// Waits until something accepts on address (the stub server binding)
+static bool WaitForServer(const sockaddr_in& address, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (std::chrono::steady_clock::now() < deadline) {
+        SOCKET probe = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        bool connected = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != SOCKET_ERROR;
+        closesocket(probe);
+        if (connected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MS));
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && hasValue) {
+            options.port = std::atoi(argv[++i]);
+        } else if (arg == "--connections" && hasValue) {
+            for (const std::string& n : SplitList(argv[++i])) {
+                options.connections.push_back((std::max)(1, std::atoi(n.c_str())));
+            }
+        } else if (arg == "--duration" && hasValue) {
+            options.durationS = (std::max)(1, std::atoi(argv[++i]));
+        } else if (arg == "--warmup" && hasValue) {
+            options.warmupS = (std::max)(0, std::atoi(argv[++i]));
+        } else if (arg == "--keep-alive" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "on" || mode == "both") options.keepAlive.push_back(true);
+            if (mode == "off" || mode == "both") options.keepAlive.push_back(false);
+        } else if (arg == "--endpoint" && hasValue) {
+            options.endpoints = SplitList(argv[++i]);
+        } else if (arg == "--pid" && hasValue) {
+            options.pid = static_cast<DWORD>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--serve" && hasValue) {
+            options.servePort = std::atoi(argv[++i]);
+        } else if (arg == "--self") {
+            options.self = true;
+        } else {
+            std::cout << "Usage: bench_http [--host 127.0.0.1] [--port 8777] [--connections N[,N...]]" << std::endl
+                      << "                  [--duration S] [--warmup S] [--keep-alive on|off|both]" << std::endl
+                      << "                  [--endpoint context|dashboard|update_context[,...]]" << std::endl
+                      << "                  [--pid PID] [--self] [--json PATH]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.servePort > 0) {
+        return RunStubServer(options.servePort);
+    }
+
+    if (options.connections.empty()) options.connections = { 1, 8, 32 };
+    if (options.keepAlive.empty()) options.keepAlive = { true, false };
+    if (options.endpoints.empty()) {
+        for (const Endpoint& endpoint : ENDPOINTS) {
+            options.endpoints.push_back(endpoint.name);
+        }
+    }
+    std::vector<const Endpoint*> endpoints;
+    for (const std::string& name : options.endpoints) {
+        const Endpoint* endpoint = FindEndpoint(name);
+        if (!endpoint) {
+            std::cerr << "[Bench] Unknown endpoint " << name << std::endl;
+            return 1;
+        }
+        endpoints.push_back(endpoint);
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "[Bench] WSAStartup failed" << std::endl;
+        return 1;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<u_short>(options.port));
+    if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "[Bench] --host must be an IPv4 address: " << options.host << std::endl;
+        WSACleanup();
+        return 1;
+    }
+
+    HANDLE stubServer = nullptr;
+    DWORD serverPid = options.pid;
+    if (options.self) {
+        stubServer = StartStubServer(options.port, serverPid);
+        if (!stubServer || !WaitForServer(address, 5000)) {
+            std::cerr << "[Bench] Stub server did not come up on port " << options.port << std::endl;
+            if (stubServer) {
+                TerminateProcess(stubServer, 1);
+                CloseHandle(stubServer);
+            }
+            WSACleanup();
+            return 1;
+        }
+    } else if (serverPid == 0) {
+        serverPid = FindProcess(L"PerceptionEngine.exe");
+    }
+    if (!ProcessSampler(serverPid).IsOpen()) {
+        std::cout << "[Bench] Server process not found (--pid); thread and handle counts will read -1" << std::endl;
+    }
+
+    std::vector<std::string> results;
+    for (const Endpoint* endpoint : endpoints) {
+        for (bool keepAlive : options.keepAlive) {
+            for (int connections : options.connections) {
+                RunConfig config;
+                config.endpoint = endpoint;
+                config.keepAlive = keepAlive;
+                config.connections = connections;
+                std::cout << "[Bench] " << endpoint->path << ", keep-alive " << (keepAlive ? "on" : "off") << ", "
+                          << connections << " connections..." << std::endl;
+                std::string result;
+                RunLoad(options, config, address, serverPid, result);
+                results.push_back(std::move(result));
+            }
+        }
+    }
+
+    if (stubServer) {
+        TerminateProcess(stubServer, 0);
+        CloseHandle(stubServer);
+    }
+    WSACleanup();
+
+    std::cout << std::endl << "=== bench_http " << (options.self ? "(stub server)" : options.host + ":" +
+                 std::to_string(options.port)) << " ===" << std::endl;
+    PrintSummaryHeader();
+    std::string all = "[";
+    for (const std::string& result : results) {
+        PrintSummaryRow(JsonReader::Parse(result));
+        all += (all.size() > 1 ? "," : "") + result;
+    }
+    all += "]";
+
+    if (!options.jsonPath.empty() && !WriteFile(options.jsonPath, all)) {
+        std::cout << "[ERROR] Could not write " << options.jsonPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,707 @@
+// bench_regress - Performance regression tracker over the benchmark targets
+//
+// Runs bench_audio, bench_camera, bench_http (--self) and perf_micro on fixed
+// inputs, each --runs times in its own process, and reduces every reported
+// number to a median and a median absolute deviation. The result is stored
+// under --results, keyed by hardware fingerprint and commit:
+//
+//   <results>/<fingerprint>/machine.json       CPU, cores, memory, OS build
+//   <results>/<fingerprint>/<commit>.json      metrics of one commit
+//
+// and compared against a baseline from the same machine (--baseline COMMIT,
+// else the most recently stored other commit). A metric regresses when it
+// moved the wrong way by more than the noise threshold: the larger of
+// --threshold percent and three combined robust standard deviations
+// (1.4826 x MAD / median of each side), so a jittery metric needs a bigger
+// move to be flagged than a stable one.
+//
+// Usage:
+//   bench_regress [--runs N] [--suites audio,camera,http,micro] [--results DIR]
+//                 [--baseline COMMIT] [--commit NAME] [--threshold PCT]
+//                 [--audio-corpus DIR] [--image-corpus PATH] [--models DIR]
+//                 [--report PATH]
+//
+// The benchmark executables are taken from this program's directory; a suite
+// whose executable or corpus is missing is skipped. --commit defaults to
+// `git rev-parse --short=12 HEAD` (with "-dirty" for a modified tree). Exit
+// code 2 when a regression was flagged, so a script can gate on it.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <windows.h>
+#include <intrin.h>
+#include "JsonReader.h"
+#include "JsonWriter.h"
+
+#pragma comment(lib, "advapi32.lib")
+
+namespace fs = std::filesystem;
+
+static const char* const ALL_SUITES[] = { "audio", "camera", "http", "micro" };
+
+struct Options {
+    int runs = 5;
+    std::vector<std::string> suites;
+    std::string resultsDir = "perf_results";
+    std::string baseline;                       // Commit; empty = latest other stored one
+    std::string commit;                         // Empty = from git
+    double thresholdPct = 5.0;
+    std::string audioCorpus = "corpus/audio";
+    std::string imageCorpus = "test_frame_320x240.jpg";
+    std::string modelDir = "models";
+    std::string reportPath;
+};
+
+struct Metric {
+    bool higherIsBetter = false;
+    std::vector<double> samples;
+    double median = 0.0;
+    double mad = 0.0;
+};
+
+using MetricMap = std::map<std::string, Metric>;
+
+static std::vector<std::string> SplitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static std::string Quote(const std::string& arg) {
+    return "\"" + arg + "\"";
+}
+
+static bool ReadFile(const fs::path& path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+static bool WriteFile(const fs::path& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary);
+    file << contents << '\n';
+    return static_cast<bool>(file);
+}
+
+// ============================================================================
+// Machine and commit
+// ============================================================================
+
+struct Machine {
+    std::string cpu;
+    int logicalCores = 0;
+    double memoryGb = 0.0;
+    std::string osBuild;
+    std::string fingerprint;                    // 16 hex digits over the fields above
+};
+
+static std::string CpuBrand() {
+    int regs[4] = {};
+    __cpuid(regs, 0x80000000);
+    if (static_cast<unsigned>(regs[0]) < 0x80000004) {
+        return "unknown";
+    }
+    char brand[49] = {};
+    for (int i = 0; i < 3; ++i) {
+        __cpuid(regs, 0x80000002 + i);
+        std::memcpy(brand + 16 * i, regs, sizeof(regs));
+    }
+    std::string text(brand);
+    text.erase(0, text.find_first_not_of(' '));
+    text.erase(text.find_last_not_of(' ') + 1);
+    return text;
+}
+
+static std::string RegistryString(const char* name) {
+    char value[128] = {};
+    DWORD size = sizeof(value);
+    if (RegGetValueA(HKEY_LOCAL_MACHINE, "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion", name,
+                     RRF_RT_REG_SZ, nullptr, value, &size) != ERROR_SUCCESS) {
+        return "";
+    }
+    return value;
+}
+
+static Machine DescribeMachine() {
+    Machine machine;
+    machine.cpu = CpuBrand();
+    machine.logicalCores = static_cast<int>(std::thread::hardware_concurrency());
+    MEMORYSTATUSEX memory = {};
+    memory.dwLength = sizeof(memory);
+    if (GlobalMemoryStatusEx(&memory)) {
+        // Rounded to whole GB: the reported total moves with firmware reservations
+        machine.memoryGb = std::round(memory.ullTotalPhys / (1024.0 * 1024.0 * 1024.0));
+    }
+    machine.osBuild = RegistryString("CurrentBuild");
+
+    // FNV-1a: same hardware and OS build, same directory
+    std::string key = machine.cpu + "|" + std::to_string(machine.logicalCores) + "|" +
+                      std::to_string(static_cast<int>(machine.memoryGb)) + "|" + machine.osBuild;
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    machine.fingerprint = hex;
+    return machine;
+}
+
+static std::string RunCapture(const char* command) {
+    std::string output;
+    FILE* pipe = _popen(command, "r");
+    if (!pipe) {
+        return output;
+    }
+    char buffer[256];
+    while (std::fgets(buffer, sizeof(buffer), pipe)) {
+        output += buffer;
+    }
+    _pclose(pipe);
+    while (!output.empty() && (output.back() == '\n' || output.back() == '\r')) {
+        output.pop_back();
+    }
+    return output;
+}
+
+static std::string CurrentCommit() {
+    std::string commit = RunCapture("git rev-parse --short=12 HEAD 2>NUL");
+    if (commit.empty()) {
+        return "unknown";
+    }
+    if (!RunCapture("git status --porcelain --untracked-files=no 2>NUL").empty()) {
+        commit += "-dirty";
+    }
+    return commit;
+}
+
+// ============================================================================
+// Suites
+// ============================================================================
+
+// Runs one benchmark process to completion; false when it didn't start or failed
+static bool RunProcess(const std::string& command) {
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process = {};
+    std::vector<char> commandLine(command.begin(), command.end());
+    commandLine.push_back('\0');
+    if (!CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process)) {
+        std::cerr << "[Regress] Failed to start " << command << ": " << GetLastError() << std::endl;
+        return false;
+    }
+    WaitForSingleObject(process.hProcess, INFINITE);
+    DWORD exitCode = 1;
+    GetExitCodeProcess(process.hProcess, &exitCode);
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    return exitCode == 0;
+}
+
+static void AddSample(MetricMap& metrics, const std::string& name, double value, bool higherIsBetter) {
+    if (!std::isfinite(value)) {
+        return;
+    }
+    Metric& metric = metrics[name];
+    metric.higherIsBetter = higherIsBetter;
+    metric.samples.push_back(value);
+}
+
+// {count, p50Ms, p90Ms, p99Ms, maxMs}: the median and tail quantiles (max is one sample, too noisy)
+static void AddQuantiles(MetricMap& metrics, const std::string& prefix, const JsonValue& quantiles) {
+    if (quantiles["count"].AsInt() == 0) {
+        return;
+    }
+    AddSample(metrics, prefix + ".p50Ms", quantiles["p50Ms"].AsDouble(), false);
+    AddSample(metrics, prefix + ".p90Ms", quantiles["p90Ms"].AsDouble(), false);
+    AddSample(metrics, prefix + ".p99Ms", quantiles["p99Ms"].AsDouble(), false);
+}
+
+static void CollectAudio(const JsonValue& result, MetricMap& metrics) {
+    std::string scratch;
+    size_t cursor = 0;
+    JsonValue file;
+    JsonValue files = result["files"];
+    while (files.Next(cursor, file)) {
+        std::string name(file["name"].AsString(scratch));
+        AddSample(metrics, "audio/" + name + "/rtf", file["rtf"].AsDouble(), false);
+        if (file["wer"].IsNumber()) {
+            AddSample(metrics, "audio/" + name + "/wer", file["wer"].AsDouble(), false);
+        }
+    }
+    cursor = 0;
+    JsonValue stage;
+    std::string_view stageName;
+    JsonValue stages = result["stages"];
+    while (stages.Next(cursor, stage, &stageName)) {
+        AddQuantiles(metrics, "audio/stage/" + std::string(stageName), stage);
+    }
+}
+
+static void CollectCamera(const JsonValue& result, MetricMap& metrics) {
+    AddSample(metrics, "camera/loadMs", result["loadMs"].AsDouble(), false);
+    AddQuantiles(metrics, "camera/caption", result["captionMs"]);
+    size_t cursor = 0;
+    JsonValue stage;
+    std::string_view stageName;
+    JsonValue stages = result["stages"];
+    while (stages.Next(cursor, stage, &stageName)) {
+        AddQuantiles(metrics, "camera/stage/" + std::string(stageName), stage);
+    }
+    AddSample(metrics, "camera/tokensPerSec", result["tokensPerSec"].AsDouble(), true);
+    AddSample(metrics, "camera/captionsPerSec", result["captionsPerSec"].AsDouble(), true);
+    AddSample(metrics, "camera/peakRssMb", result["peakRssMb"].AsDouble(), false);
+}
+
+static void CollectHttp(const JsonValue& result, MetricMap& metrics) {
+    std::string scratch;
+    size_t cursor = 0;
+    JsonValue run;
+    while (result.Next(cursor, run)) {
+        std::string prefix = "http/" + std::string(run["endpoint"].AsString(scratch)) +
+                             (run["keepAlive"].AsBool() ? "/ka" : "/close") +
+                             "/c" + std::to_string(run["connections"].AsInt());
+        AddSample(metrics, prefix + "/requestsPerSec", run["requestsPerSec"].AsDouble(), true);
+        AddQuantiles(metrics, prefix + "/latency", run["latencyMs"]);
+        AddSample(metrics, prefix + "/failures", static_cast<double>(run["failures"].AsInt()), false);
+        // Growth over the run: a connection leak shows up here
+        JsonValue server = run["server"];
+        AddSample(metrics, prefix + "/handlesAfter",
+                  static_cast<double>(server["after"]["handles"].AsInt() - server["before"]["handles"].AsInt()), false);
+    }
+}
+
+// Google Benchmark's JSON: {"benchmarks": [{name, run_type, cpu_time, time_unit, error_occurred}, ...]}
+static void CollectMicro(const JsonValue& result, MetricMap& metrics) {
+    std::string scratch;
+    size_t cursor = 0;
+    JsonValue benchmark;
+    JsonValue benchmarks = result["benchmarks"];
+    while (benchmarks.Next(cursor, benchmark)) {
+        if (benchmark["error_occurred"].AsBool() || benchmark["run_type"].AsString(scratch) == "aggregate") {
+            continue;
+        }
+        std::string unit(benchmark["time_unit"].AsString(scratch, "ns"));
+        double scale = unit == "s" ? 1e9 : unit == "ms" ? 1e6 : unit == "us" ? 1e3 : 1.0;
+        AddSample(metrics, "micro/" + std::string(benchmark["name"].AsString(scratch)) + "/cpuNs",
+                  benchmark["cpu_time"].AsDouble() * scale, false);
+    }
+}
+
+struct Suite {
+    const char* name;
+    const char* executable;
+    // Command-line arguments after the executable, given the JSON output path; empty: skip
+    std::function<std::string(const Options&, const std::string& jsonPath)> arguments;
+    std::function<void(const JsonValue&, MetricMap&)> collect;
+};
+
+static std::vector<Suite> BuildSuites() {
+    std::vector<Suite> suites;
+    suites.push_back({ "audio", "bench_audio.exe",
+        [](const Options& options, const std::string& jsonPath) -> std::string {
+            std::error_code ec;
+            if (!fs::exists(options.audioCorpus, ec)) {
+                std::cout << "[Regress] audio: no corpus at " << options.audioCorpus << ", skipped" << std::endl;
+                return "";
+            }
+            // Max speed: the real-time factor is the number that matters
+            return Quote(options.audioCorpus) + " --model " +
+                   Quote((fs::path(options.modelDir) / "whisper" / "ggml-tiny.en.bin").string()) +
+                   " --json " + Quote(jsonPath);
+        },
+        CollectAudio });
+    suites.push_back({ "camera", "bench_camera.exe",
+        [](const Options& options, const std::string& jsonPath) -> std::string {
+            std::error_code ec;
+            if (!fs::exists(options.imageCorpus, ec)) {
+                std::cout << "[Regress] camera: no corpus at " << options.imageCorpus << ", skipped" << std::endl;
+                return "";
+            }
+            return Quote(options.imageCorpus) + " --models " + Quote((fs::path(options.modelDir) / "fastvlm").string()) +
+                   " --iterations 3 --max-tokens 50 --json " + Quote(jsonPath);
+        },
+        CollectCamera });
+    suites.push_back({ "http", "bench_http.exe",
+        [](const Options&, const std::string& jsonPath) -> std::string {
+            // The stub server: HttpServer alone, not whatever a live engine is collecting
+            return "--self --duration 5 --warmup 1 --connections 1,16 --keep-alive both"
+                   " --endpoint context,dashboard --json " + Quote(jsonPath);
+        },
+        CollectHttp });
+    suites.push_back({ "micro", "perf_micro.exe",
+        [](const Options& options, const std::string& jsonPath) -> std::string {
+            return "--models " + Quote(options.modelDir) +
+                   " --benchmark_out=" + Quote(jsonPath) + " --benchmark_out_format=json";
+        },
+        CollectMicro });
+    return suites;
+}
+
+static bool RunSuite(const Options& options, const Suite& suite, const fs::path& binDir, MetricMap& metrics) {
+    std::error_code ec;
+    fs::path executable = binDir / suite.executable;
+    if (!fs::exists(executable, ec)) {
+        std::cout << "[Regress] " << suite.name << ": " << suite.executable << " not built, skipped" << std::endl;
+        return false;
+    }
+    std::string jsonPath = (fs::temp_directory_path(ec) / ("bench_regress_" + std::to_string(GetCurrentProcessId()) +
+                            "_" + suite.name + ".json")).string();
+    std::string arguments = suite.arguments(options, jsonPath);
+    if (arguments.empty()) {
+        return false;
+    }
+
+    int completed = 0;
+    for (int run = 0; run < options.runs; ++run) {
+        std::cout << "[Regress] " << suite.name << " run " << (run + 1) << "/" << options.runs << "..." << std::endl;
+        std::string contents;
+        if (!RunProcess(Quote(executable.string()) + " " + arguments) || !ReadFile(jsonPath, contents)) {
+            std::cout << "[Regress] " << suite.name << " run " << (run + 1) << " failed" << std::endl;
+            continue;
+        }
+        JsonValue result = JsonReader::Parse(contents);
+        if (!result.IsValid()) {
+            std::cout << "[Regress] " << suite.name << " wrote invalid JSON" << std::endl;
+            continue;
+        }
+        suite.collect(result, metrics);
+        ++completed;
+    }
+    fs::remove(jsonPath, ec);
+    return completed > 0;
+}
+
+// ============================================================================
+// Statistics and storage
+// ============================================================================
+
+static double Median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double upper = values[middle];
+    if (values.size() % 2 == 1) {
+        return upper;
+    }
+    return (*std::max_element(values.begin(), values.begin() + middle) + upper) / 2.0;
+}
+
+static void Summarize(MetricMap& metrics) {
+    for (auto& entry : metrics) {
+        Metric& metric = entry.second;
+        metric.median = Median(metric.samples);
+        std::vector<double> deviations;
+        for (double sample : metric.samples) {
+            deviations.push_back(std::fabs(sample - metric.median));
+        }
+        metric.mad = Median(deviations);
+    }
+}
+
+static std::string SerializeRecord(const std::string& commit, const Machine& machine, const Options& options,
+                                   const MetricMap& metrics) {
+    std::string out;
+    JsonWriter writer(out);
+    writer.BeginObject();
+    writer.Key("commit").String(commit);
+    writer.Key("fingerprint").String(machine.fingerprint);
+    writer.Key("timestamp").Int(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    writer.Key("runs").Int(options.runs);
+    writer.Key("metrics").BeginObject();
+    for (const auto& entry : metrics) {
+        const Metric& metric = entry.second;
+        writer.Key(entry.first).BeginObject();
+        writer.Key("better").String(metric.higherIsBetter ? "higher" : "lower");
+        writer.Key("median").Double(metric.median, 4);
+        writer.Key("mad").Double(metric.mad, 4);
+        writer.Key("samples").BeginArray();
+        for (double sample : metric.samples) {
+            writer.Double(sample, 4);
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndObject();
+    writer.EndObject();
+    return out;
+}
+
+static std::string SerializeMachine(const Machine& machine) {
+    std::string out;
+    JsonWriter writer(out);
+    writer.BeginObject();
+    writer.Key("fingerprint").String(machine.fingerprint);
+    writer.Key("cpu").String(machine.cpu);
+    writer.Key("logicalCores").Int(machine.logicalCores);
+    writer.Key("memoryGb").Double(machine.memoryGb, 0);
+    writer.Key("osBuild").String(machine.osBuild);
+    writer.EndObject();
+    return out;
+}
+
+static bool LoadRecord(const fs::path& path, MetricMap& metrics) {
+    std::string contents;
+    if (!ReadFile(path, contents)) {
+        return false;
+    }
+    JsonValue record = JsonReader::Parse(contents);
+    if (!record.IsValid()) {
+        return false;
+    }
+    std::string scratch;
+    size_t cursor = 0;
+    JsonValue value;
+    std::string_view name;
+    JsonValue stored = record["metrics"];
+    while (stored.Next(cursor, value, &name)) {
+        Metric& metric = metrics[std::string(name)];
+        metric.higherIsBetter = value["better"].AsString(scratch) == "higher";
+        metric.median = value["median"].AsDouble();
+        metric.mad = value["mad"].AsDouble();
+        size_t sampleCursor = 0;
+        JsonValue sample;
+        JsonValue samples = value["samples"];
+        while (samples.Next(sampleCursor, sample)) {
+            metric.samples.push_back(sample.AsDouble());
+        }
+    }
+    return true;
+}
+
+// The baseline's record: the named commit, else the newest stored commit other than this one
+static fs::path FindBaseline(const fs::path& machineDir, const std::string& requested, const std::string& commit) {
+    std::error_code ec;
+    if (!requested.empty()) {
+        return machineDir / (requested + ".json");
+    }
+    fs::path newest;
+    fs::file_time_type newestTime;
+    for (const auto& entry : fs::directory_iterator(machineDir, ec)) {
+        const fs::path& path = entry.path();
+        if (path.extension() != ".json" || path.stem() == "machine" || path.stem() == commit) {
+            continue;
+        }
+        fs::file_time_type time = entry.last_write_time(ec);
+        if (newest.empty() || time > newestTime) {
+            newest = path;
+            newestTime = time;
+        }
+    }
+    return newest;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+struct Comparison {
+    std::string name;
+    double baseline;
+    double current;
+    double changePct;           // Signed; positive = worse
+    double thresholdPct;
+    enum class Verdict { Same, Regressed, Improved } verdict;
+};
+
+static std::vector<Comparison> Compare(const MetricMap& baseline, const MetricMap& current, double minThresholdPct) {
+    std::vector<Comparison> comparisons;
+    for (const auto& entry : current) {
+        auto base = baseline.find(entry.first);
+        if (base == baseline.end() || base->second.median == 0.0) {
+            continue;
+        }
+        const Metric& now = entry.second;
+        const Metric& then = base->second;
+
+        double change = (now.median - then.median) / std::fabs(then.median) * 100.0;
+        double worse = now.higherIsBetter ? -change : change;
+
+        // Robust sigma (1.4826 x MAD) relative to each median, combined
+        double sigmaThen = 1.4826 * then.mad / std::fabs(then.median);
+        double sigmaNow = now.median != 0.0 ? 1.4826 * now.mad / std::fabs(now.median) : 0.0;
+        double noisePct = 3.0 * std::sqrt(sigmaThen * sigmaThen + sigmaNow * sigmaNow) * 100.0;
+        double threshold = (std::max)(minThresholdPct, noisePct);
+
+        Comparison comparison{ entry.first, then.median, now.median, worse, threshold, Comparison::Verdict::Same };
+        if (worse > threshold) {
+            comparison.verdict = Comparison::Verdict::Regressed;
+        } else if (worse < -threshold) {
+            comparison.verdict = Comparison::Verdict::Improved;
+        }
+        comparisons.push_back(comparison);
+    }
+    return comparisons;
+}
+
+static void PrintReport(const std::vector<Comparison>& comparisons, const std::string& baselineCommit,
+                        const std::string& commit) {
+    std::cout << std::endl << "=== bench_regress " << baselineCommit << " -> " << commit << " ===" << std::endl;
+    std::cout << "metric                                              baseline      current   worse %  noise %" << std::endl;
+    int regressed = 0;
+    int improved = 0;
+    for (const Comparison& c : comparisons) {
+        if (c.verdict == Comparison::Verdict::Same) {
+            continue;
+        }
+        const char* tag = c.verdict == Comparison::Verdict::Regressed ? "REGRESSED" : "improved";
+        (c.verdict == Comparison::Verdict::Regressed ? regressed : improved)++;
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-48s %12.3f %12.3f %+8.1f %8.1f  %s", c.name.c_str(), c.baseline,
+                      c.current, c.changePct, c.thresholdPct, tag);
+        std::cout << line << std::endl;
+    }
+    std::cout << comparisons.size() << " metrics compared: " << regressed << " regressed, " << improved
+              << " improved, " << (comparisons.size() - regressed - improved) << " within noise" << std::endl;
+}
+
+static std::string SerializeReport(const std::vector<Comparison>& comparisons, const std::string& baselineCommit,
+                                   const std::string& commit, const Machine& machine) {
+    std::string out;
+    JsonWriter writer(out);
+    writer.BeginObject();
+    writer.Key("baseline").String(baselineCommit);
+    writer.Key("commit").String(commit);
+    writer.Key("fingerprint").String(machine.fingerprint);
+    writer.Key("metrics").BeginArray();
+    for (const Comparison& c : comparisons) {
+        writer.BeginObject();
+        writer.Key("name").String(c.name);
+        writer.Key("baseline").Double(c.baseline, 4);
+        writer.Key("current").Double(c.current, 4);
+        writer.Key("worsePct").Double(c.changePct, 2);
+        writer.Key("thresholdPct").Double(c.thresholdPct, 2);
+        writer.Key("verdict").String(c.verdict == Comparison::Verdict::Regressed ? "regressed"
+                                     : c.verdict == Comparison::Verdict::Improved ? "improved" : "same");
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return out;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--runs" && hasValue) {
+            options.runs = (std::max)(1, std::atoi(argv[++i]));
+        } else if (arg == "--suites" && hasValue) {
+            options.suites = SplitList(argv[++i]);
+        } else if (arg == "--results" && hasValue) {
+            options.resultsDir = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            options.baseline = argv[++i];
+        } else if (arg == "--commit" && hasValue) {
+            options.commit = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            options.thresholdPct = (std::max)(0.0, std::atof(argv[++i]));
+        } else if (arg == "--audio-corpus" && hasValue) {
+            options.audioCorpus = argv[++i];
+        } else if (arg == "--image-corpus" && hasValue) {
+            options.imageCorpus = argv[++i];
+        } else if (arg == "--models" && hasValue) {
+            options.modelDir = argv[++i];
+        } else if (arg == "--report" && hasValue) {
+            options.reportPath = argv[++i];
+        } else {
+            std::cout << "Usage: bench_regress [--runs N] [--suites audio,camera,http,micro] [--results DIR]" << std::endl
+                      << "                     [--baseline COMMIT] [--commit NAME] [--threshold PCT]" << std::endl
+                      << "                     [--audio-corpus DIR] [--image-corpus PATH] [--models DIR]" << std::endl
+                      << "                     [--report PATH]" << std::endl;
+            return 1;
+        }
+    }
+    if (options.suites.empty()) {
+        options.suites.assign(std::begin(ALL_SUITES), std::end(ALL_SUITES));
+    }
+
+    Machine machine = DescribeMachine();
+    std::string commit = options.commit.empty() ? CurrentCommit() : options.commit;
+    std::cout << "[Regress] " << machine.cpu << ", " << machine.logicalCores << " threads, " << machine.memoryGb
+              << " GB, build " << machine.osBuild << " (fingerprint " << machine.fingerprint << ")" << std::endl;
+    std::cout << "[Regress] Commit " << commit << ", " << options.runs << " runs per suite" << std::endl;
+
+    char exePath[MAX_PATH];
+    GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+    fs::path binDir = fs::path(exePath).parent_path();
+
+    MetricMap metrics;
+    for (const Suite& suite : BuildSuites()) {
+        if (std::find(options.suites.begin(), options.suites.end(), suite.name) != options.suites.end()) {
+            RunSuite(options, suite, binDir, metrics);
+        }
+    }
+    if (metrics.empty()) {
+        std::cout << "[ERROR] No suite produced results" << std::endl;
+        return 1;
+    }
+    Summarize(metrics);
+
+    std::error_code ec;
+    fs::path machineDir = fs::path(options.resultsDir) / machine.fingerprint;
+    fs::create_directories(machineDir, ec);
+    fs::path recordPath = machineDir / (commit + ".json");
+    if (!WriteFile(machineDir / "machine.json", SerializeMachine(machine)) ||
+        !WriteFile(recordPath, SerializeRecord(commit, machine, options, metrics))) {
+        std::cout << "[ERROR] Could not write " << recordPath.string() << std::endl;
+        return 1;
+    }
+    std::cout << "[Regress] " << metrics.size() << " metrics stored in " << recordPath.string() << std::endl;
+
+    fs::path baselinePath = FindBaseline(machineDir, options.baseline, commit);
+    MetricMap baseline;
+    if (baselinePath.empty() || !LoadRecord(baselinePath, baseline)) {
+        std::cout << "[Regress] No baseline for this machine yet"
+                  << (options.baseline.empty() ? "" : " (" + options.baseline + " not stored)")
+                  << "; this run is the first" << std::endl;
+        return 0;
+    }
+
+    std::string baselineCommit = baselinePath.stem().string();
+    std::vector<Comparison> comparisons = Compare(baseline, metrics, options.thresholdPct);
+    PrintReport(comparisons, baselineCommit, commit);
+    if (!options.reportPath.empty() &&
+        !WriteFile(options.reportPath, SerializeReport(comparisons, baselineCommit, commit, machine))) {
+        std::cout << "[ERROR] Could not write " << options.reportPath << std::endl;
+        return 1;
+    }
+
+    bool regressed = std::any_of(comparisons.begin(), comparisons.end(), [](const Comparison& c) {
+        return c.verdict == Comparison::Verdict::Regressed;
+    });
+    return regressed ? 2 : 0;
+}
@@ -0,0 +1,82 @@
+@echo off
+echo ============================================
+echo Building PerceptionEngine with PGO (x64)
+echo ============================================
+
+REM build_pgo.bat default^|avx2 ^<speech.wav^>
+REM Run from an "x64 Native Tools Command Prompt" (pgosweep, pgomgr).
+REM
+REM Instruments the engine, trains it on the replay workloads - the WAV fed
+REM through the whole voice path the way bench_audio replays it, a synthetic
+REM camera, and bench_http loading the HTTP routes - then relinks it with the
+REM recorded profile and LTCG. A profile only applies to the binary that
+REM recorded it, so the engine itself is trained rather than the benchmarks.
+REM avx2 builds PerceptionEngine-avx2.exe, which --install prefers on AVX2 CPUs.
+set FLAVOR=pgo
+set ARCH=DEFAULT
+set EXE=PerceptionEngine
+if /I "%1"=="avx2" (
+    set FLAVOR=avx2-pgo
+    set ARCH=AVX2
+    set EXE=PerceptionEngine-avx2
+)
+if "%~2"=="" (
+    echo Usage: build_pgo.bat default^|avx2 ^<speech.wav^>
+    exit /b 1
+)
+set WAV=%~f2
+set BUILD=out\build\engine-%FLAVOR%
+set BIN=%BUILD%\bin\Release
+set PGD=%BUILD%\pgo\PerceptionEngine-%ARCH%.pgd
+
+REM Instrumented build, plus the HTTP load generator
+echo.
+echo [1/4] Building instrumented %EXE%...
+cmake --preset engine-%FLAVOR%-instrument && cmake --build --preset engine-%FLAVOR%-instrument
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Instrumented build failed
+    exit /b 1
+)
+cmake --build %BUILD% --config Release --target bench_http
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: bench_http build failed
+    exit /b 1
+)
+
+REM Training: the engine replays the WAV at full speed with a synthetic camera
+REM while bench_http drives context, dashboard and update_context
+echo.
+echo [2/4] Training on the replay workloads...
+del /q "%BUILD%\pgo\*.pgc" 2>nul
+start "PerceptionEngine PGO" /D "%BIN%" %EXE%.exe --console --audio-source=file-max:"%WAV%" --camera-source=synthetic-max
+timeout /t 20 /nobreak >nul
+"%BIN%\bench_http.exe" --connections 1,8 --duration 60 --keep-alive both --endpoint context,dashboard,update_context
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: bench_http failed
+    taskkill /IM %EXE%.exe /F >nul 2>&1
+    exit /b 1
+)
+REM A killed process writes no counts: sweep them out first
+pgosweep %EXE%.exe "%BUILD%\pgo\PerceptionEngine-%ARCH%!1.pgc"
+taskkill /IM %EXE%.exe /F >nul 2>&1
+
+echo.
+echo [3/4] Merging the profile...
+pgomgr /merge "%PGD%"
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: pgomgr failed
+    exit /b 1
+)
+
+echo.
+echo [4/4] Building optimized %EXE%...
+cmake --preset engine-%FLAVOR%-optimize && cmake --build --preset engine-%FLAVOR%-optimize
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Optimized build failed
+    exit /b 1
+)
+
+echo.
+echo ============================================
+echo Success! %BIN%\%EXE%.exe
+echo ============================================
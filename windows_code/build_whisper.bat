@@ -3,6 +3,13 @@ echo ============================================
 echo Building whisper.cpp for Windows (x64)
 echo ============================================
 
+REM Optional ggml backend: build_whisper.bat [cpu^|vulkan^|cuda^|blas]
+REM (configure PerceptionEngine with the matching -DWHISPER_GGML_BACKEND)
+set GGML_BACKEND_FLAGS=
+if /I "%1"=="vulkan" set GGML_BACKEND_FLAGS=-DGGML_VULKAN=ON
+if /I "%1"=="cuda" set GGML_BACKEND_FLAGS=-DGGML_CUDA=ON
+if /I "%1"=="blas" set GGML_BACKEND_FLAGS=-DGGML_BLAS=ON -DGGML_BLAS_VENDOR=OpenBLAS
+
 cd third-party\whisper.cpp
 
 REM Create build directory
@@ -15,7 +22,7 @@ echo [1/3] Configuring CMake...
 cmake .. -G "Visual Studio 17 2022" -A x64 ^
     -DWHISPER_BUILD_EXAMPLES=OFF ^
     -DWHISPER_BUILD_TESTS=OFF ^
-    -DBUILD_SHARED_LIBS=OFF
+    -DBUILD_SHARED_LIBS=OFF %GGML_BACKEND_FLAGS%
 
 if %ERRORLEVEL% neq 0 (
     echo ERROR: CMake configuration failed
@@ -0,0 +1,396 @@
+// perf_micro - Google Benchmark microbenchmarks for the engine's hot kernels
+//
+// Each kernel runs in isolation on synthetic input shaped like the live
+// pipeline's (10 ms WASAPI packets, 512-sample VAD frames, a 1280x720 camera
+// frame, a full-vocabulary logits row, a /context document, a browser's
+// request), so a change to one of them shows up as ns/op before it is lost in
+// an end-to-end run of bench_audio, bench_camera or bench_http.
+//
+//   BM_PcmToFloat           int16/int24/int32/float32 stereo -> mono float, 48 kHz in and out
+//   BM_Resample             same formats, 48 kHz stereo -> 16 kHz mono (the capture path)
+//   BM_SileroVadProcess     one 512-sample frame through the ONNX session (needs the model)
+//   BM_PreprocessImage      BGR and BGRA 1280x720 -> 224x224 normalized CHW
+//   BM_Argmax               greedy decoding's pick over the decoder vocabulary
+//   BM_TokenizerLoadVocab   vocab.json parse (needs the model)
+//   BM_TokenizerDecode      64-token caption -> text (needs the model)
+//   BM_JsonWriterContext    a /context-sized document
+//   BM_HttpParseRequest     a browser GET and an /update_context POST
+//   BM_HttpBuildResponse    status line, headers and body buffers
+//   BM_RecentActiveApps     GetRecentPeriodActiveAppList over an hour of history
+//
+// Usage:
+//   perf_micro [--models DIR] [Google Benchmark flags]
+//
+// Results as JSON: --benchmark_format=json (stdout) or
+// --benchmark_out=PATH --benchmark_out_format=json. Benchmarks whose model is
+// missing under --models (default "models") report an error and are skipped.
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "AudioResampler.h"
+#include "CameraVisionEngine.h"
+#include "FastVLMTokenizer.h"
+#include "HttpRequestParser.h"
+#include "HttpServer.h"
+#include "JsonWriter.h"
+#include "Log.h"
+#include "LogitsProcessor.h"
+#include "SileroVAD.h"
+#include "WindowsAPIs.h"
+
+namespace fs = std::filesystem;
+
+static std::string g_modelDir = "models";
+
+// Private kernels (CameraVisionEngine and HttpServer name this struct a friend)
+struct PerfMicro {
+    static void PreprocessImage(CameraVisionEngine& engine, const cv::Mat& frame, std::vector<float>& output) {
+        engine.PreprocessImage(frame, output, 0);
+    }
+
+    static size_t BuildHttpResponse(HttpServer& server, HttpResponse& response) {
+        std::vector<HttpServer::SendBuffer> out;
+        server.BuildHttpResponse(response, out);
+        return out.size();
+    }
+};
+
+// Deterministic input: a 440 Hz tone per channel, with a little xorshift noise
+static std::vector<float> MakeSignal(size_t frames, int channels) {
+    std::vector<float> samples(frames * channels);
+    uint32_t state = 1;
+    for (size_t i = 0; i < frames; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            float noise = (static_cast<float>(state) / 4294967296.0f - 0.5f) * 0.01f;
+            samples[i * channels + c] = 0.5f * std::sin(2.0f * 3.14159265f * 440.0f * i / 48000.0f + c) + noise;
+        }
+    }
+    return samples;
+}
+
+// Float samples packed as the WASAPI mix format would deliver them
+static std::vector<uint8_t> Pack(const std::vector<float>& samples, AudioResampler::SampleFormat format) {
+    const size_t bytes = AudioResampler::BytesPerSample(format);
+    std::vector<uint8_t> packed(samples.size() * bytes);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        uint8_t* dst = packed.data() + i * bytes;
+        switch (format) {
+            case AudioResampler::SampleFormat::Int16: {
+                int16_t v = static_cast<int16_t>(samples[i] * 32767.0f);
+                std::memcpy(dst, &v, sizeof(v));
+                break;
+            }
+            case AudioResampler::SampleFormat::Int24: {
+                int32_t v = static_cast<int32_t>(samples[i] * 8388607.0f);
+                dst[0] = static_cast<uint8_t>(v);
+                dst[1] = static_cast<uint8_t>(v >> 8);
+                dst[2] = static_cast<uint8_t>(v >> 16);
+                break;
+            }
+            case AudioResampler::SampleFormat::Int32: {
+                int32_t v = static_cast<int32_t>(samples[i] * 2147483647.0);
+                std::memcpy(dst, &v, sizeof(v));
+                break;
+            }
+            default:
+                std::memcpy(dst, &samples[i], sizeof(float));
+                break;
+        }
+    }
+    return packed;
+}
+
+static AudioResampler::SampleFormat FormatArg(int64_t arg) {
+    switch (arg) {
+        case 16: return AudioResampler::SampleFormat::Int16;
+        case 24: return AudioResampler::SampleFormat::Int24;
+        case 32: return AudioResampler::SampleFormat::Int32;
+        default: return AudioResampler::SampleFormat::Float32;
+    }
+}
+
+// Arg: sample format (16, 24, 32 bit integer; 0 float). One 10 ms packet per iteration.
+static void RunResampler(benchmark::State& state, int outputRate) {
+    const AudioResampler::SampleFormat format = FormatArg(state.range(0));
+    const size_t packetFrames = 480;
+    const int channels = 2;
+    const std::vector<uint8_t> packet = Pack(MakeSignal(packetFrames, channels), format);
+
+    AudioResampler resampler;
+    if (!resampler.Configure(48000, outputRate, channels, format)) {
+        state.SkipWithError("Configure failed");
+        return;
+    }
+    std::vector<float> out(resampler.MaxOutputFrames(packetFrames));
+    for (auto _ : state) {
+        size_t written = resampler.Process(packet.data(), packetFrames, out.data(), out.size());
+        benchmark::DoNotOptimize(written);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * packetFrames);
+    state.SetBytesProcessed(state.iterations() * packet.size());
+}
+
+static void BM_PcmToFloat(benchmark::State& state) {
+    RunResampler(state, 48000);
+}
+BENCHMARK(BM_PcmToFloat)->ArgName("bits")->Arg(16)->Arg(24)->Arg(32)->Arg(0);
+
+static void BM_Resample(benchmark::State& state) {
+    RunResampler(state, 16000);
+}
+BENCHMARK(BM_Resample)->ArgName("bits")->Arg(16)->Arg(24)->Arg(32)->Arg(0);
+
+static void BM_SileroVadProcess(benchmark::State& state) {
+    const fs::path modelPath = fs::path(g_modelDir) / "vad" / "silero_vad.onnx";
+    SileroVAD vad;
+    if (!fs::exists(modelPath) || !vad.Initialize(modelPath.wstring())) {
+        state.SkipWithError("silero_vad.onnx not found under --models");
+        return;
+    }
+    const std::vector<float> signal = MakeSignal(512, 1);
+    for (auto _ : state) {
+        float probability = vad.Process(signal.data(), signal.size());
+        benchmark::DoNotOptimize(probability);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SileroVadProcess)->Unit(benchmark::kMicrosecond);
+
+// Arg: channels of the camera frame (3 OpenCV BGR, 4 Media Foundation BGRA)
+static void BM_PreprocessImage(benchmark::State& state) {
+    const int channels = static_cast<int>(state.range(0));
+    cv::Mat frame(720, 1280, channels == 4 ? CV_8UC4 : CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    // Leaked like the engine's own: its destructor would tear down sessions never created
+    static CameraVisionEngine* engine = new CameraVisionEngine();
+    std::vector<float> output;
+    for (auto _ : state) {
+        PerfMicro::PreprocessImage(*engine, frame, output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PreprocessImage)->ArgName("channels")->Arg(3)->Arg(4)->Unit(benchmark::kMicrosecond);
+
+// Arg: vocabulary size (FastVLM's decoder emits 151936 logits per step)
+static void BM_Argmax(benchmark::State& state) {
+    const size_t count = static_cast<size_t>(state.range(0));
+    std::vector<float> logits(count);
+    uint32_t seed = 7;
+    for (float& v : logits) {
+        seed = seed * 1664525u + 1013904223u;
+        v = static_cast<float>(seed >> 8) / 16777216.0f * 20.0f - 10.0f;
+    }
+    for (auto _ : state) {
+        int64_t token = LogitsProcessor::Argmax(logits.data(), logits.size());
+        benchmark::DoNotOptimize(token);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_Argmax)->ArgName("vocab")->Arg(151936)->Arg(4096);
+
+static void BM_TokenizerLoadVocab(benchmark::State& state) {
+    const std::string vocabPath = (fs::path(g_modelDir) / "fastvlm" / "vocab.json").string();
+    if (!fs::exists(vocabPath)) {
+        state.SkipWithError("fastvlm/vocab.json not found under --models");
+        return;
+    }
+    for (auto _ : state) {
+        FastVLMTokenizer tokenizer;
+        bool loaded = tokenizer.LoadVocab(vocabPath);
+        benchmark::DoNotOptimize(loaded);
+    }
+}
+BENCHMARK(BM_TokenizerLoadVocab)->Unit(benchmark::kMillisecond);
+
+static void BM_TokenizerDecode(benchmark::State& state) {
+    const std::string vocabPath = (fs::path(g_modelDir) / "fastvlm" / "vocab.json").string();
+    static FastVLMTokenizer* tokenizer = nullptr;
+    if (!tokenizer) {
+        auto* loaded = new FastVLMTokenizer();
+        if (fs::exists(vocabPath) && loaded->LoadVocab(vocabPath)) {
+            tokenizer = loaded;
+        } else {
+            delete loaded;
+        }
+    }
+    if (!tokenizer) {
+        state.SkipWithError("fastvlm/vocab.json not found under --models");
+        return;
+    }
+
+    // A caption's worth of ordinary (non-special) tokens
+    std::vector<int64_t> tokens;
+    uint32_t seed = 11;
+    for (int i = 0; i < 64; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        tokens.push_back(256 + static_cast<int64_t>(seed % 30000));
+    }
+    for (auto _ : state) {
+        std::string text = tokenizer->Decode(tokens);
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_TokenizerDecode);
+
+// Roughly the shape of /context: scalars, an app list, a transcript and a caption
+static void BM_JsonWriterContext(benchmark::State& state) {
+    std::string out;
+    for (auto _ : state) {
+        out.clear();
+        JsonWriter json(out);
+        json.BeginObject();
+        json.Key("timestamp").String("2026-01-01T12:00:00.000Z");
+        json.Key("foreground_app").String("chrome.exe");
+        json.Key("window_title").String("Quarterly review \"draft\" - Google Docs\tC:\\Users\\me");
+        json.Key("cpu_percent").Double(12.3456, 1);
+        json.Key("memory_percent").Double(61.75, 1);
+        json.Key("idle_seconds").Int(3);
+        json.Key("on_battery").Bool(false);
+        json.Key("location").Null();
+        json.Key("recent_apps").BeginArray();
+        for (int i = 0; i < 10; ++i) {
+            json.BeginObject();
+            json.Key("app").String(i % 2 ? "Code.exe" : "Teams.exe");
+            json.Key("title").String("perf_micro.cpp - perception_engine - Visual Studio Code");
+            json.Key("duration_seconds").Int(30 + i * 7);
+            json.EndObject();
+        }
+        json.EndArray();
+        json.Key("transcript").BeginArray();
+        for (int i = 0; i < 8; ++i) {
+            json.BeginObject();
+            json.Key("source").String(i % 3 ? "microphone" : "system");
+            json.Key("text").String("so the plan for next week is to ship the capture changes and then profile again");
+            json.Key("confidence").Double(0.91, 2);
+            json.EndObject();
+        }
+        json.EndArray();
+        json.Key("camera").BeginObject();
+        json.Key("caption").String("A person sitting at a desk in front of two monitors, holding a coffee mug.");
+        json.Key("latency_ms").Double(412.5, 1);
+        json.EndObject();
+        json.EndObject();
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_JsonWriterContext);
+
+static const char* const BROWSER_GET =
+    "GET /context?format=json&fields=apps,audio HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8777\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\"\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0 Safari/537.36\r\n"
+    "Accept: application/json, text/plain, */*\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "If-None-Match: \"5f3a-17\"\r\n"
+    "\r\n";
+
+static const char* const UPDATE_POST =
+    "POST /update_context HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8777\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 61\r\n"
+    "\r\n"
+    "{\"source\":\"extension\",\"key\":\"tab\",\"value\":\"docs.google.com\"}";
+
+// Arg: 0 browser GET, 1 /update_context POST
+static void BM_HttpParseRequest(benchmark::State& state) {
+    const std::string_view raw = state.range(0) ? UPDATE_POST : BROWSER_GET;
+    HttpRequestParser parser;
+    HttpRequest request;
+    for (auto _ : state) {
+        request = HttpRequest();
+        size_t consumed = 0;
+        if (parser.Parse(raw, request, consumed) != HttpRequestParser::Result::Complete) {
+            state.SkipWithError("request did not parse");
+            break;
+        }
+        benchmark::DoNotOptimize(consumed);
+    }
+    state.SetBytesProcessed(state.iterations() * raw.size());
+}
+BENCHMARK(BM_HttpParseRequest)->ArgName("post")->Arg(0)->Arg(1);
+
+// Arg: body bytes (moved into its own send buffer)
+static void BM_HttpBuildResponse(benchmark::State& state) {
+    static HttpServer* server = new HttpServer(0);  // Never started: the constructor only brings up Winsock
+    const std::string body(static_cast<size_t>(state.range(0)), 'x');
+    for (auto _ : state) {
+        state.PauseTiming();
+        HttpResponse response;
+        response.SetBody(body);
+        state.ResumeTiming();
+
+        response.SetHeader("Content-Type", "application/json");
+        response.SetHeader("Cache-Control", "no-cache");
+        response.SetHeader("ETag", "\"5f3a-18\"");
+        response.SetHeader("Connection", "keep-alive");
+        size_t buffers = PerfMicro::BuildHttpResponse(*server, response);
+        benchmark::DoNotOptimize(buffers);
+    }
+}
+BENCHMARK(BM_HttpBuildResponse)->ArgName("body")->Arg(0)->Arg(4096);
+
+// An hour of app switches every 15 s (the retention period, full), seeded once
+static void BM_RecentActiveApps(benchmark::State& state) {
+    static bool seeded = false;
+    if (!seeded) {
+        static const char* const apps[] = { "chrome.exe", "Code.exe", "Teams.exe", "OUTLOOK.EXE", "explorer.exe" };
+        std::vector<WindowsAPIs::ActiveAppRecord> records;
+        const auto now = std::chrono::system_clock::now();
+        for (int i = 240; i > 0; --i) {
+            WindowsAPIs::ActiveAppRecord record(apps[i % 5], "Window " + std::to_string(i % 37));
+            record.timestamp = now - std::chrono::seconds(15 * i);
+            record.durationSeconds = 15;
+            records.push_back(record);
+        }
+        WindowsAPIs::RestoreActiveAppHistory(records);
+        seeded = true;
+    }
+    for (auto _ : state) {
+        std::vector<WindowsAPIs::ActiveAppRecord> recent = WindowsAPIs::GetRecentPeriodActiveAppList();
+        benchmark::DoNotOptimize(recent.data());
+    }
+}
+BENCHMARK(BM_RecentActiveApps);
+
+int main(int argc, char* argv[]) {
+    benchmark::Initialize(&argc, argv);
+
+    // What Google Benchmark left over is ours
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--models" && i + 1 < argc) {
+            g_modelDir = argv[++i];
+        } else {
+            std::cout << "Usage: perf_micro [--models DIR] [--benchmark_filter=REGEX] [--benchmark_format=json]" << std::endl
+                      << "                  [--benchmark_out=PATH --benchmark_out_format=json] [--benchmark_repetitions=N]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Kernel timings, not log output
+    Log::SetLevel(Log::Level::Warning);
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -21,7 +21,7 @@ if not exist "PerceptionEngine.exe" (
 
 REM Start PerceptionEngine in new window
 echo [1/2] Starting PerceptionEngine.exe...
-start "PerceptionEngine" /D "%~dp0build\bin\Release" PerceptionEngine.exe --console
+start "PerceptionEngine" /D "%~dp0build\bin\Release" PerceptionEngine.exe --console --camera=python
 
 REM Wait 3 seconds for server to start
 echo [1/2] Waiting for server to initialize...
@@ -0,0 +1,932 @@
+// test_structures - Round-trip and reference checks for the engine's own
+// storage and encoding structures
+//
+//   MetricColumns   randomized series and boundary values (NaN, +-0,
+//                   infinities, denormals, equal timestamps, block rollover
+//                   and eviction) appended, then every row read back bit for
+//                   bit and Downsample() compared with a brute-force reduction
+//   IntervalIndex   random inserts, removals and SetEnd() calls, every
+//                   Overlapping() answer compared with a linear scan
+//   Deflate         Compress() output inflated again (fixed-Huffman and stored
+//                   blocks) for each container, checksums against known values
+//   MessagePack     TranscodeJson() against a table of JSON texts and the
+//                   bytes they must become, or their rejection
+//   JsonReader      Parse() against a table of valid and invalid documents,
+//                   UTF-8 inside strings above all, short and past 16 bytes
+//   HttpRequest-    requests (Content-Length and chunked framing, malformed
+//   Parser          sizes, both framings at once) parsed whole and a byte at
+//                   a time, against the expected result and body
+//
+// Usage:
+//   test_structures [--seed N] [--rounds N]
+//
+// Prints one line per failed check (the first few per kind) and a summary.
+// Exit code 1 when anything failed.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "Deflate.h"
+#include "HttpRequestParser.h"
+#include "IntervalIndex.h"
+#include "JsonReader.h"
+#include "MessagePack.h"
+#include "MetricColumns.h"
+
+namespace {
+
+int failures = 0;
+
+void Fail(const std::string& what) {
+    if (failures < 20) {
+        std::cout << "[FAIL] " << what << std::endl;
+    }
+    failures++;
+}
+
+uint64_t Bits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double FromBits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// ============================================================================
+// MetricColumns
+// ============================================================================
+
+struct Row {
+    int64_t timeMs;
+    double values[MetricColumns::MAX_COLUMNS];
+};
+
+// Times that exercise every delta-of-delta width, including none at all
+int64_t NextTime(std::mt19937_64& rng, int64_t timeMs, int64_t& delta) {
+    switch (rng() % 8) {
+        case 0: return timeMs;                                              // Equal timestamps
+        case 1: return timeMs + delta;                                      // Steady
+        case 2: delta = 1000 + static_cast<int64_t>(rng() % 127) - 63; break;
+        case 3: delta = static_cast<int64_t>(rng() % 512); break;
+        case 4: delta = static_cast<int64_t>(rng() % 4096); break;
+        case 5: delta = static_cast<int64_t>(rng() % (int64_t(1) << 40)); break;
+        default: delta = 1000; break;
+    }
+    return timeMs + delta;
+}
+
+double NextValue(std::mt19937_64& rng, double previous) {
+    static const double SPECIAL[] = {
+        std::numeric_limits<double>::quiet_NaN(), 0.0, -0.0,
+        (std::numeric_limits<double>::infinity)(), -(std::numeric_limits<double>::infinity)(),
+        (std::numeric_limits<double>::min)(), std::numeric_limits<double>::denorm_min(),
+        -(std::numeric_limits<double>::max)(), (std::numeric_limits<double>::max)(),
+    };
+    switch (rng() % 8) {
+        case 0: return SPECIAL[rng() % (sizeof(SPECIAL) / sizeof(SPECIAL[0]))];
+        case 1: return FromBits(rng());                                     // Any bit pattern
+        case 2: return static_cast<float>(std::uniform_real_distribution<double>(0.0, 100.0)(rng));
+        case 3: return std::uniform_real_distribution<double>(-1e6, 1e6)(rng);
+        default: return previous;                                           // Unchanged
+    }
+}
+
+// What Downsample() should report, reduced row by row
+void Reference(const std::vector<Row>& rows, size_t columnCount, int64_t fromMs, int64_t toMs, int64_t bucketMs,
+               uint32_t columnMask, std::vector<MetricColumns::Bucket>& buckets, std::vector<double>& sumScale) {
+    buckets.clear();
+    sumScale.clear();
+    for (const Row& row : rows) {
+        if (row.timeMs < fromMs || row.timeMs > toMs) {
+            continue;
+        }
+        int64_t startMs = fromMs + (row.timeMs - fromMs) / bucketMs * bucketMs;
+        if (buckets.empty() || buckets.back().startMs != startMs) {
+            buckets.emplace_back();
+            buckets.back().startMs = startMs;
+            sumScale.resize(buckets.size() * columnCount, 0.0);
+        }
+        MetricColumns::Bucket& bucket = buckets.back();
+        bucket.rows++;
+        for (size_t column = 0; column < columnCount; ++column) {
+            double value = row.values[column];
+            if (!(columnMask & (1u << column)) || std::isnan(value)) {
+                continue;
+            }
+            MetricColumns::Aggregate& aggregate = bucket.columns[column];
+            aggregate.min = (std::min)(aggregate.min, value);
+            aggregate.max = (std::max)(aggregate.max, value);
+            aggregate.sum += value;
+            aggregate.last = value;
+            aggregate.count++;
+            sumScale[(buckets.size() - 1) * columnCount + column] += std::fabs(value);
+        }
+    }
+}
+
+bool SameValue(double a, double b) {
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+void CompareDownsample(const MetricColumns& columns, const std::vector<Row>& rows, int64_t fromMs, int64_t toMs,
+                       int64_t bucketMs, uint32_t columnMask, const char* label) {
+    std::vector<MetricColumns::Bucket> actual;
+    std::vector<MetricColumns::Bucket> expected;
+    std::vector<double> sumScale;
+    columns.Downsample(fromMs, toMs, bucketMs, actual, columnMask);
+    Reference(rows, columns.ColumnCount(), fromMs, toMs, bucketMs, columnMask, expected, sumScale);
+
+    std::string where = std::string(label) + " [" + std::to_string(fromMs) + ", " + std::to_string(toMs) +
+                        "] / " + std::to_string(bucketMs) + ": ";
+    if (actual.size() != expected.size()) {
+        Fail(where + std::to_string(actual.size()) + " buckets, expected " + std::to_string(expected.size()));
+        return;
+    }
+    for (size_t i = 0; i < actual.size(); ++i) {
+        const MetricColumns::Bucket& a = actual[i];
+        const MetricColumns::Bucket& e = expected[i];
+        if (a.startMs != e.startMs || a.rows != e.rows) {
+            Fail(where + "bucket " + std::to_string(i) + " starts " + std::to_string(a.startMs) + " with " +
+                 std::to_string(a.rows) + " rows, expected " + std::to_string(e.startMs) + " with " +
+                 std::to_string(e.rows));
+            return;
+        }
+        for (size_t column = 0; column < columns.ColumnCount(); ++column) {
+            const MetricColumns::Aggregate& ac = a.columns[column];
+            const MetricColumns::Aggregate& ec = e.columns[column];
+            // Sums are added in another order; compare them within rounding of the magnitudes added
+            double scale = sumScale[i * columns.ColumnCount() + column];
+            bool sumMatches = !std::isfinite(scale) || SameValue(ac.sum, ec.sum) ||
+                              std::fabs(ac.sum - ec.sum) <= scale * 1e-12;
+            if (ac.count != ec.count || !SameValue(ac.min, ec.min) || !SameValue(ac.max, ec.max) ||
+                Bits(ac.last) != Bits(ec.last) || !sumMatches) {
+                Fail(where + "bucket " + std::to_string(i) + " column " + std::to_string(column) + " differs");
+                return;
+            }
+        }
+    }
+}
+
+// Each row read back through one-row buckets: times and values bit for bit
+void CompareRows(const MetricColumns& columns, const std::vector<Row>& rows, const char* label) {
+    if (rows.empty()) {
+        return;
+    }
+    std::vector<MetricColumns::Bucket> buckets;
+    columns.Downsample(rows.front().timeMs, rows.back().timeMs, 1, buckets);
+    size_t row = 0;
+    for (const MetricColumns::Bucket& bucket : buckets) {
+        // Equal timestamps share a bucket: its last value is the last row's
+        row += bucket.rows;
+        if (row == 0 || row > rows.size() || rows[row - 1].timeMs != bucket.startMs) {
+            Fail(std::string(label) + ": rows out of step at bucket " + std::to_string(bucket.startMs));
+            return;
+        }
+        for (size_t column = 0; column < columns.ColumnCount(); ++column) {
+            double value = rows[row - 1].values[column];
+            if (!std::isnan(value) && Bits(bucket.columns[column].last) != Bits(value)) {
+                Fail(std::string(label) + ": row " + std::to_string(row - 1) + " column " + std::to_string(column) +
+                     " reads back differently");
+                return;
+            }
+        }
+    }
+    if (row != rows.size()) {
+        Fail(std::string(label) + ": read back " + std::to_string(row) + " rows, expected " + std::to_string(rows.size()));
+    }
+}
+
+void TestMetricColumns(std::mt19937_64& rng, int rounds) {
+    // Fixed boundaries: +-0 and NaN runs, equal timestamps across a block edge
+    {
+        MetricColumns columns(3, 1 << 20);
+        std::vector<Row> rows;
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        for (size_t i = 0; i < 3 * MetricColumns::BLOCK_ROWS + 1; ++i) {
+            bool edge = i + 2 >= MetricColumns::BLOCK_ROWS && i <= MetricColumns::BLOCK_ROWS + 1;
+            Row row{ edge ? int64_t(5000) : int64_t(i) * 1000, { (i & 1) ? 0.0 : -0.0, i % 7 ? nan : -1.5, double(i) } };
+            rows.push_back(row);
+        }
+        std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.timeMs < b.timeMs; });
+        for (const Row& row : rows) {
+            if (!columns.Append(row.timeMs, row.values)) {
+                Fail("boundaries: append refused");
+            }
+        }
+        if (columns.Append(rows.back().timeMs - 1, rows.back().values)) {
+            Fail("boundaries: a row before the last was stored");
+        }
+        if (columns.Size() != rows.size()) {
+            Fail("boundaries: " + std::to_string(columns.Size()) + " rows stored");
+        }
+        CompareRows(columns, rows, "boundaries");
+        CompareDownsample(columns, rows, rows.front().timeMs, rows.back().timeMs, 60000, ~0u, "boundaries");
+        CompareDownsample(columns, rows, 5000, 5000, 1, ~0u, "boundaries");
+    }
+
+    // All-NaN column: nothing counted
+    {
+        MetricColumns columns(1, 4096);
+        std::vector<Row> rows;
+        for (int i = 0; i < 2000; ++i) {
+            rows.push_back(Row{ i * 10, { std::numeric_limits<double>::quiet_NaN() } });
+            columns.Append(rows.back().timeMs, rows.back().values);
+        }
+        CompareDownsample(columns, rows, 0, 20000, 1000, ~0u, "all NaN");
+    }
+
+    for (int round = 0; round < rounds; ++round) {
+        size_t columnCount = 1 + rng() % MetricColumns::MAX_COLUMNS;
+        size_t maxRows = 1 + rng() % (4 * MetricColumns::BLOCK_ROWS);
+        size_t appended = rng() % (6 * MetricColumns::BLOCK_ROWS);
+        MetricColumns columns(columnCount, maxRows);
+
+        std::vector<Row> rows;
+        int64_t timeMs = static_cast<int64_t>(rng() % 1000000) - 500000;
+        int64_t delta = 1000;
+        double previous[MetricColumns::MAX_COLUMNS] = {};
+        for (size_t i = 0; i < appended; ++i) {
+            Row row{ timeMs, {} };
+            for (size_t column = 0; column < columnCount; ++column) {
+                row.values[column] = previous[column] = NextValue(rng, previous[column]);
+            }
+            if (!columns.Append(row.timeMs, row.values)) {
+                Fail("random: append refused");
+            }
+            rows.push_back(row);
+            timeMs = NextTime(rng, timeMs, delta);
+        }
+
+        // The oldest blocks go once the rest hold maxRows: what is left is a suffix
+        size_t kept = columns.Size();
+        size_t lowest = (std::min)(appended, maxRows);
+        if (kept < lowest || kept > lowest + MetricColumns::BLOCK_ROWS) {
+            Fail("random: " + std::to_string(kept) + " rows kept of " + std::to_string(appended) +
+                 " with maxRows " + std::to_string(maxRows));
+            continue;
+        }
+        rows.erase(rows.begin(), rows.end() - kept);
+        if (!rows.empty() && columns.LastTimeMs() != rows.back().timeMs) {
+            Fail("random: last time differs");
+        }
+
+        CompareRows(columns, rows, "random");
+        if (rows.empty()) {
+            continue;
+        }
+        int64_t first = rows.front().timeMs;
+        int64_t last = rows.back().timeMs;
+        int64_t span = (std::max)(int64_t(1), last - first);
+        for (int query = 0; query < 4; ++query) {
+            int64_t fromMs = first - span / 8 + static_cast<int64_t>(rng() % static_cast<uint64_t>(span));
+            int64_t toMs = fromMs + static_cast<int64_t>(rng() % static_cast<uint64_t>(span + 1));
+            int64_t bucketMs = 1 + static_cast<int64_t>(rng() % static_cast<uint64_t>(span));
+            uint32_t mask = static_cast<uint32_t>(rng());
+            CompareDownsample(columns, rows, fromMs, toMs, bucketMs, mask, "random");
+        }
+        CompareDownsample(columns, rows, first, last, span + 1, ~0u, "random whole");
+    }
+}
+
+// ============================================================================
+// IntervalIndex
+// ============================================================================
+
+struct Interval {
+    int64_t start;
+    int64_t end;
+    uint64_t id;
+};
+
+void TestIntervalIndex(std::mt19937_64& rng, int rounds) {
+    for (int round = 0; round < rounds; ++round) {
+        IntervalIndex index;
+        std::vector<Interval> intervals;
+        int64_t range = 1 + static_cast<int64_t>(rng() % 10000);
+        uint64_t nextId = 0;
+        int operations = 1 + static_cast<int>(rng() % 2000);
+
+        for (int operation = 0; operation < operations; ++operation) {
+            unsigned kind = rng() % 10;
+            if (kind < 5 || intervals.empty()) {
+                // Shared starts and ends, and still-open intervals
+                int64_t start = static_cast<int64_t>(rng() % static_cast<uint64_t>(range));
+                int64_t end = rng() % 4 == 0 ? IntervalIndex::OPEN
+                                             : start + static_cast<int64_t>(rng() % static_cast<uint64_t>(range / 4 + 1));
+                uint64_t id = rng() % 3 == 0 && nextId > 0 ? rng() % nextId : nextId++;
+                bool taken = std::any_of(intervals.begin(), intervals.end(),
+                                         [&](const Interval& i) { return i.start == start && i.id == id; });
+                if (taken) {
+                    id = nextId++;
+                }
+                index.Insert(start, end, id);
+                intervals.push_back(Interval{ start, end, id });
+            } else if (kind < 7) {
+                size_t victim = rng() % intervals.size();
+                if (!index.Remove(intervals[victim].start, intervals[victim].id)) {
+                    Fail("interval: remove of a stored interval failed");
+                }
+                intervals.erase(intervals.begin() + victim);
+            } else if (kind < 9) {
+                Interval& target = intervals[rng() % intervals.size()];
+                target.end = target.start + static_cast<int64_t>(rng() % static_cast<uint64_t>(range / 4 + 1));
+                if (!index.SetEnd(target.start, target.id, target.end)) {
+                    Fail("interval: SetEnd of a stored interval failed");
+                }
+            } else {
+                if (index.Remove(range + 1, nextId + 1) || index.SetEnd(range + 1, nextId + 1, 0)) {
+                    Fail("interval: an absent interval was found");
+                }
+            }
+
+            if (index.Size() != intervals.size()) {
+                Fail("interval: size " + std::to_string(index.Size()) + ", expected " + std::to_string(intervals.size()));
+                break;
+            }
+
+            // Point, ordinary and unbounded queries, inside and around the range
+            int64_t from = static_cast<int64_t>(rng() % static_cast<uint64_t>(range + 20)) - 10;
+            int64_t to = rng() % 8 == 0 ? from : from + static_cast<int64_t>(rng() % static_cast<uint64_t>(range));
+            if (rng() % 16 == 0) {
+                to = IntervalIndex::OPEN;
+            }
+            std::vector<Interval> hits;
+            for (const Interval& interval : intervals) {
+                if (interval.start <= to && interval.end >= from) {
+                    hits.push_back(interval);
+                }
+            }
+            std::sort(hits.begin(), hits.end(), [](const Interval& a, const Interval& b) {
+                return a.start < b.start || (a.start == b.start && a.id < b.id);
+            });
+            std::vector<uint64_t> expected;
+            for (const Interval& hit : hits) {
+                expected.push_back(hit.id);
+            }
+            std::vector<uint64_t> actual;
+            index.Overlapping(from, to, actual);
+            if (actual != expected) {
+                Fail("interval: [" + std::to_string(from) + ", " + std::to_string(to) + "] found " +
+                     std::to_string(actual.size()) + " ids, expected " + std::to_string(expected.size()));
+                break;
+            }
+        }
+
+        index.Clear();
+        std::vector<uint64_t> ids;
+        index.Overlapping((std::numeric_limits<int64_t>::min)(), IntervalIndex::OPEN, ids);
+        if (index.Size() != 0 || !ids.empty()) {
+            Fail("interval: not empty after Clear()");
+        }
+    }
+}
+
+// ============================================================================
+// Deflate
+// ============================================================================
+
+// Inflates what Deflate emits: stored and fixed-Huffman blocks (RFC 1951)
+class Inflater {
+public:
+    explicit Inflater(const std::string& data, size_t position) : data(data), position(position) {}
+
+    bool Run(std::string& out) {
+        bool final = false;
+        while (!final) {
+            uint32_t header = 0;
+            if (!Bits(3, header)) {
+                return false;
+            }
+            final = (header & 1) != 0;
+            uint32_t type = header >> 1;
+            if (type == 0) {
+                if (!Stored(out)) {
+                    return false;
+                }
+            } else if (type == 1) {
+                if (!Fixed(out)) {
+                    return false;
+                }
+            } else {
+                return false;       // Deflate never writes dynamic trees
+            }
+        }
+        bitCount = 0;               // The rest of the last byte is padding
+        return true;
+    }
+
+    size_t Position() const { return position; }
+
+private:
+    const std::string& data;
+    size_t position;
+    uint32_t bitBuffer = 0;
+    int bitCount = 0;
+
+    bool Bits(int count, uint32_t& value) {
+        while (bitCount < count) {
+            if (position >= data.size()) {
+                return false;
+            }
+            bitBuffer |= static_cast<uint32_t>(static_cast<unsigned char>(data[position++])) << bitCount;
+            bitCount += 8;
+        }
+        value = bitBuffer & ((1u << count) - 1);
+        bitBuffer >>= count;
+        bitCount -= count;
+        return true;
+    }
+
+    // Huffman codes are packed most significant bit first
+    bool Code(int count, uint32_t& value) {
+        value = 0;
+        for (int i = 0; i < count; ++i) {
+            uint32_t bit = 0;
+            if (!Bits(1, bit)) {
+                return false;
+            }
+            value = (value << 1) | bit;
+        }
+        return true;
+    }
+
+    bool Stored(std::string& out) {
+        bitBuffer = 0;
+        bitCount = 0;
+        if (position + 4 > data.size()) {
+            return false;
+        }
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + position;
+        uint32_t length = p[0] | (p[1] << 8);
+        uint32_t complement = p[2] | (p[3] << 8);
+        position += 4;
+        if ((length ^ 0xFFFF) != complement || position + length > data.size()) {
+            return false;
+        }
+        out.append(data, position, length);
+        position += length;
+        return true;
+    }
+
+    bool Literal(uint32_t& symbol) {
+        uint32_t code = 0;
+        if (!Code(7, code)) {
+            return false;
+        }
+        if (code <= 0x17) {
+            symbol = 256 + code;
+            return true;
+        }
+        uint32_t bit = 0;
+        if (!Bits(1, bit)) {
+            return false;
+        }
+        code = (code << 1) | bit;
+        if (code >= 0x30 && code <= 0xBF) {
+            symbol = code - 0x30;
+            return true;
+        }
+        if (code >= 0xC0 && code <= 0xC7) {
+            symbol = 280 + code - 0xC0;
+            return true;
+        }
+        if (!Bits(1, bit)) {
+            return false;
+        }
+        code = (code << 1) | bit;
+        if (code >= 0x190 && code <= 0x1FF) {
+            symbol = 144 + code - 0x190;
+            return true;
+        }
+        return false;
+    }
+
+    bool Fixed(std::string& out) {
+        static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                                    8193, 12289, 16385, 24577 };
+        static const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        while (true) {
+            uint32_t symbol = 0;
+            if (!Literal(symbol)) {
+                return false;
+            }
+            if (symbol < 256) {
+                out.push_back(static_cast<char>(symbol));
+                continue;
+            }
+            if (symbol == 256) {
+                return true;
+            }
+            symbol -= 257;
+            if (symbol >= 29) {
+                return false;
+            }
+            uint32_t extra = 0;
+            if (!Bits(LENGTH_EXTRA[symbol], extra)) {
+                return false;
+            }
+            size_t length = LENGTH_BASE[symbol] + extra;
+
+            uint32_t distanceCode = 0;
+            if (!Code(5, distanceCode) || distanceCode >= 30 || !Bits(DISTANCE_EXTRA[distanceCode], extra)) {
+                return false;
+            }
+            size_t distance = DISTANCE_BASE[distanceCode] + extra;
+            if (distance > out.size() || distance > 32768) {
+                return false;
+            }
+            for (size_t i = 0; i < length; ++i) {
+                out.push_back(out[out.size() - distance]);
+            }
+        }
+    }
+};
+
+uint32_t ReadLittleEndian(const std::string& data, size_t position) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + position;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint32_t ReadBigEndian(const std::string& data, size_t position) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + position;
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+void CheckDeflate(const std::string& input, const char* label) {
+    static const Deflate::Container CONTAINERS[] = { Deflate::Container::Raw, Deflate::Container::Zlib,
+                                                     Deflate::Container::Gzip };
+    static const char* NAMES[] = { "raw", "zlib", "gzip" };
+    for (int c = 0; c < 3; ++c) {
+        std::string where = std::string(label) + " (" + NAMES[c] + ", " + std::to_string(input.size()) + " bytes): ";
+        std::string compressed = Deflate::Compress(input, CONTAINERS[c]);
+
+        size_t header = 0;
+        if (CONTAINERS[c] == Deflate::Container::Zlib) {
+            header = 2;
+            if (compressed.size() < 6 || (static_cast<unsigned char>(compressed[0]) & 0x0F) != 8 ||
+                ((static_cast<unsigned char>(compressed[0]) << 8) | static_cast<unsigned char>(compressed[1])) % 31 != 0) {
+                Fail(where + "bad zlib header");
+                continue;
+            }
+        } else if (CONTAINERS[c] == Deflate::Container::Gzip) {
+            header = 10;
+            if (compressed.size() < 18 || static_cast<unsigned char>(compressed[0]) != 0x1F ||
+                static_cast<unsigned char>(compressed[1]) != 0x8B || compressed[2] != 8 || compressed[3] != 0) {
+                Fail(where + "bad gzip header");
+                continue;
+            }
+        }
+
+        Inflater inflater(compressed, header);
+        std::string output;
+        if (!inflater.Run(output)) {
+            Fail(where + "does not inflate");
+            continue;
+        }
+        if (output != input) {
+            Fail(where + "inflates to different data");
+            continue;
+        }
+
+        size_t trailer = inflater.Position();
+        if (CONTAINERS[c] == Deflate::Container::Zlib) {
+            if (trailer + 4 != compressed.size() || ReadBigEndian(compressed, trailer) != Deflate::Adler32(input)) {
+                Fail(where + "bad Adler-32 trailer");
+            }
+        } else if (CONTAINERS[c] == Deflate::Container::Gzip) {
+            if (trailer + 8 != compressed.size() || ReadLittleEndian(compressed, trailer) != Deflate::Crc32(input) ||
+                ReadLittleEndian(compressed, trailer + 4) != static_cast<uint32_t>(input.size())) {
+                Fail(where + "bad gzip trailer");
+            }
+        } else if (trailer != compressed.size()) {
+            Fail(where + "trailing bytes");
+        }
+
+        // Stored blocks cost at most 5 bytes per 65535
+        if (compressed.size() > header + input.size() + 5 * (input.size() / 65535 + 1) + 8) {
+            Fail(where + "larger than stored");
+        }
+    }
+}
+
+void TestDeflate(std::mt19937_64& rng, int rounds) {
+    if (Deflate::Crc32("123456789") != 0xCBF43926u) {
+        Fail("deflate: CRC-32 check value");
+    }
+    if (Deflate::Adler32("Wikipedia") != 0x11E60398u) {
+        Fail("deflate: Adler-32 check value");
+    }
+    if (Deflate::Crc32("") != 0 || Deflate::Adler32("") != 1) {
+        Fail("deflate: checksums of nothing");
+    }
+
+    CheckDeflate("", "empty");
+    CheckDeflate("a", "one byte");
+    CheckDeflate("abc", "shorter than a match");
+    CheckDeflate(std::string(100000, 'x'), "one long run");
+
+    std::string json;
+    while (json.size() < 200000) {
+        json += "{\"app\":\"Code.exe\",\"title\":\"test_structures.cpp\",\"ts\":" + std::to_string(rng() % 100000) + "},";
+    }
+    CheckDeflate(json, "repeated keys");
+
+    // Incompressible: stored blocks, more than one of them
+    std::string noise(200000, '\0');
+    for (char& c : noise) {
+        c = static_cast<char>(rng());
+    }
+    CheckDeflate(noise, "random bytes");
+
+    // Matches at the far end of the window, and just beyond it
+    std::string far = noise.substr(0, 1000) + std::string(31000, 'y') + noise.substr(0, 1000) +
+                      std::string(1000, 'z') + noise.substr(0, 1000);
+    CheckDeflate(far, "window edge");
+
+    for (int round = 0; round < rounds; ++round) {
+        // Small alphabets and repeated fragments of random length
+        std::string input;
+        size_t size = rng() % 70000;
+        unsigned alphabet = 1 + static_cast<unsigned>(rng() % 256);
+        while (input.size() < size) {
+            if (!input.empty() && rng() % 3 == 0) {
+                size_t from = rng() % input.size();
+                input += input.substr(from, rng() % 300);
+            } else {
+                input.push_back(static_cast<char>(rng() % alphabet));
+            }
+        }
+        CheckDeflate(input, "random");
+    }
+}
+
+// ============================================================================
+// MessagePack
+// ============================================================================
+
+std::string Hex(const std::string& bytes) {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : bytes) {
+        if (!hex.empty()) {
+            hex.push_back(' ');
+        }
+        hex.push_back(DIGITS[c >> 4]);
+        hex.push_back(DIGITS[c & 0x0F]);
+    }
+    return hex;
+}
+
+void TestMessagePack(std::mt19937_64&, int) {
+    // Expected bytes in hex; nullptr: the text must be rejected
+    struct Case {
+        const char* json;
+        const char* packed;
+    };
+    static const Case CASES[] = {
+        { "0", "00" },
+        { "-1", "ff" },
+        { "127", "7f" },
+        { "128", "cc 80" },
+        { "-33", "d0 df" },
+        { "65536", "ce 00 01 00 00" },
+        { "9223372036854775807", "cf 7f ff ff ff ff ff ff ff" },
+        { "-9223372036854775808", "d3 80 00 00 00 00 00 00 00" },
+        // Past int64: uint64 while it fits, else a double
+        { "9223372036854775808", "cf 80 00 00 00 00 00 00 00" },
+        { "18446744073709551615", "cf ff ff ff ff ff ff ff ff" },
+        { "18446744073709551616", "cb 43 f0 00 00 00 00 00 00" },
+        { "99999999999999999999", "cb 44 15 af 1d 78 b5 8c 40" },
+        { "-9223372036854775809", "cb c3 e0 00 00 00 00 00 00" },
+        { "-99999999999999999999", "cb c4 15 af 1d 78 b5 8c 40" },
+        { "1.5", "cb 3f f8 00 00 00 00 00 00" },
+        { "-2e3", "cb c0 9f 40 00 00 00 00 00" },
+        { "01", nullptr },
+        { "1.", nullptr },
+        { "-", nullptr },
+        { ".5", nullptr },
+        { "1e", nullptr },
+        { "+1", nullptr },
+        { "\"\\ud83d\\ude00\"", "a4 f0 9f 98 80" },
+        { "\"\\ud800\"", nullptr },
+        { "\"\\udc00\"", nullptr },
+        { "\"a\tb\"", nullptr },
+        { "[1,{\"k\":null}]", "92 01 81 a1 6b c0" },
+        { "[1,]", nullptr },
+    };
+    for (const Case& test : CASES) {
+        std::string out;
+        bool accepted = MessagePack::TranscodeJson(out, test.json);
+        if (!test.packed) {
+            if (accepted) {
+                Fail(std::string("msgpack: ") + test.json + " accepted as " + Hex(out));
+            }
+        } else if (!accepted || Hex(out) != test.packed) {
+            Fail(std::string("msgpack: ") + test.json + (accepted ? " packed as " + Hex(out) : " rejected") +
+                 ", expected " + test.packed);
+        }
+    }
+}
+
+// ============================================================================
+// JsonReader
+// ============================================================================
+
+void TestJsonReader(std::mt19937_64&, int) {
+    // Valid documents, and where Parse() must report an invalid one: at the
+    // first byte of a bad UTF-8 sequence
+    struct Case {
+        const char* json;
+        bool valid;
+        size_t errorOffset;
+    };
+    static const Case CASES[] = {
+        { "\"plain\"", true, 0 },
+        { "\"h\xc3\xa9\"", true, 0 },                                   // U+00E9
+        { "\"\xe2\x82\xac\"", true, 0 },                               // U+20AC
+        { "\"\xef\xbf\xbf\"", true, 0 },                               // U+FFFF
+        { "\"\xf0\x9f\x98\x80\"", true, 0 },                          // U+1F600
+        { "\"\xf4\x8f\xbf\xbf\"", true, 0 },                          // U+10FFFF
+        { "\"\xed\x9f\xbf\"", true, 0 },                               // U+D7FF, below the surrogates
+        { "{\"k\xc3\xa9\":[\"\xe2\x82\xac\\n\"]}", true, 0 },
+        { "\"\xc0\xaf\"", false, 1 },                                   // Overlong '/'
+        { "\"\xc1\xbf\"", false, 1 },                                   // Overlong, 2 bytes
+        { "\"\xe0\x80\xaf\"", false, 1 },                              // Overlong, 3 bytes
+        { "\"\xf0\x8f\xbf\xbf\"", false, 1 },                         // Overlong, 4 bytes
+        { "\"\xed\xa0\x80\"", false, 1 },                              // U+D800
+        { "\"\xed\xbf\xbf\"", false, 1 },                              // U+DFFF
+        { "\"\xf4\x90\x80\x80\"", false, 1 },                         // Past U+10FFFF
+        { "\"\xf5\x80\x80\x80\"", false, 1 },
+        { "\"\xff\"", false, 1 },
+        { "\"\x80\"", false, 1 },                                        // Lone continuation byte
+        { "\"\xe2\x82\"", false, 1 },                                   // Truncated before the quote
+        { "\"\xe2\x82\\n\"", false, 1 },                              // Truncated before an escape
+        { "\"\xc3\"", false, 1 },
+        { "\"\xc3", false, 1 },                                          // Truncated at the end
+        { "\"\xc3(\"", false, 1 },                                       // Bad continuation byte
+        { "\"ok\\n\xc0\x80\"", false, 5 },                             // The run after an escape
+        // Past the 16-byte ASCII skip
+        { "\"0123456789abcdef0123\xc3\xa9\"", true, 0 },
+        { "\"0123456789abcdef0123\xed\xa0\x80\"", false, 21 },
+        { "\"0123456789abcdef\xf0\x9f\x98\x80\xf0\x9f\x98\"", false, 21 },
+        // The rest of the grammar still holds
+        { "\"a\x01\"", false, 2 },
+        { "\"\\x\"", false, 1 },
+        { "[1,]", false, 3 },
+        { "01", false, 1 },
+    };
+    for (const Case& test : CASES) {
+        size_t errorOffset = 0;
+        bool valid = JsonReader::Parse(test.json, &errorOffset).IsValid();
+        std::string where = "json: " + Hex(test.json) + ": ";
+        if (valid != test.valid) {
+            Fail(where + (valid ? "accepted" : "rejected at " + std::to_string(errorOffset)));
+        } else if (!valid && errorOffset != test.errorOffset) {
+            Fail(where + "rejected at " + std::to_string(errorOffset) + ", expected " + std::to_string(test.errorOffset));
+        }
+    }
+}
+
+// ============================================================================
+// HttpRequestParser
+// ============================================================================
+
+const char* ResultName(HttpRequestParser::Result result) {
+    switch (result) {
+        case HttpRequestParser::Result::Complete: return "Complete";
+        case HttpRequestParser::Result::Incomplete: return "Incomplete";
+        default: return "Error";
+    }
+}
+
+void TestHttpRequestParser(std::mt19937_64&, int) {
+    using Result = HttpRequestParser::Result;
+    struct Case {
+        const char* label;
+        const char* request;
+        Result result;
+        const char* body;               // On Complete
+    };
+    static const Case CASES[] = {
+        { "no body", "GET /context HTTP/1.1\r\nHost: x\r\n\r\n", Result::Complete, "" },
+        { "content-length", "POST /ingest HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello", Result::Complete, "hello" },
+        { "content-length OWS", "POST / HTTP/1.1\r\nContent-Length:\t 5 \r\n\r\nhello", Result::Complete, "hello" },
+        { "content-length 0", "POST / HTTP/1.1\r\nContent-Length: 0\r\n\r\n", Result::Complete, "" },
+        { "content-length short", "POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nhel", Result::Incomplete, "" },
+        { "content-length +", "POST / HTTP/1.1\r\nContent-Length: +5\r\n\r\nhello", Result::Error, "" },
+        { "content-length -", "POST / HTTP/1.1\r\nContent-Length: -5\r\n\r\nhello", Result::Error, "" },
+        { "content-length inner space", "POST / HTTP/1.1\r\nContent-Length: \v5\r\n\r\nhello", Result::Error, "" },
+        { "content-length hex", "POST / HTTP/1.1\r\nContent-Length: 0x5\r\n\r\nhello", Result::Error, "" },
+        { "content-length empty", "POST / HTTP/1.1\r\nContent-Length:\r\n\r\n", Result::Error, "" },
+        { "content-length repeated", "POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\nhello",
+          Result::Error, "" },
+        { "content-length too large", "POST / HTTP/1.1\r\nContent-Length: 1048577\r\n\r\n", Result::Error, "" },
+        { "content-length overflow", "POST / HTTP/1.1\r\nContent-Length: 18446744073709551621\r\n\r\n",
+          Result::Error, "" },
+        { "chunked", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n",
+          Result::Complete, "hello world" },
+        { "chunked upper hex, extension", "POST / HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n"
+          "A ;name=value\r\n0123456789\r\n0\r\nTrailer: x\r\n\r\n", Result::Complete, "0123456789" },
+        { "chunk 0x", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0x5\r\nhello\r\n0\r\n\r\n",
+          Result::Error, "" },
+        { "chunk +", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n+5\r\nhello\r\n0\r\n\r\n",
+          Result::Error, "" },
+        { "chunk leading space", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n 5\r\nhello\r\n0\r\n\r\n",
+          Result::Error, "" },
+        { "chunk empty size", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n;x\r\n0\r\n\r\n", Result::Error, "" },
+        { "chunk too large", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n100001\r\n", Result::Error, "" },
+        { "chunk overflow", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n10000000000000005\r\n",
+          Result::Error, "" },
+        { "chunk without CRLF", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloXX0\r\n\r\n",
+          Result::Error, "" },
+        { "both framings", "POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n"
+          "5\r\nhello\r\n0\r\n\r\n", Result::Error, "" },
+        { "both framings, identity", "POST / HTTP/1.1\r\nTransfer-Encoding: identity\r\nContent-Length: 5\r\n\r\nhello",
+          Result::Error, "" },
+        { "no colon", "GET / HTTP/1.1\r\nHost x\r\n\r\n", Result::Error, "" },
+    };
+
+    for (const Case& test : CASES) {
+        std::string where = std::string("http: ") + test.label + ": ";
+        std::string data = test.request;
+
+        // Whole, then a byte at a time: Incomplete until the last byte a
+        // Complete request needs, or the first an Error one can be told by
+        for (int incremental = 0; incremental < 2; ++incremental) {
+            HttpRequestParser parser;
+            HttpRequest request;
+            size_t consumed = 0;
+            Result result = Result::Incomplete;
+            for (size_t size = incremental ? 1 : data.size(); size <= data.size(); ++size) {
+                result = parser.Parse(std::string_view(data).substr(0, size), request, consumed);
+                if (result != Result::Incomplete) {
+                    break;
+                }
+            }
+            std::string mode = incremental ? " (a byte at a time)" : "";
+            if (result != test.result) {
+                Fail(where + ResultName(result) + mode + ", expected " + ResultName(test.result));
+            } else if (result == Result::Complete && (request.body != test.body || consumed != data.size())) {
+                Fail(where + "body \"" + request.body + "\" over " + std::to_string(consumed) + " bytes" + mode);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    uint64_t seed = 1;
+    int rounds = 50;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            rounds = (std::max)(1, std::atoi(argv[++i]));
+        } else {
+            std::cout << "Usage: test_structures [--seed N] [--rounds N]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::mt19937_64 rng(seed);
+    struct Suite {
+        const char* name;
+        void (*run)(std::mt19937_64&, int);
+    };
+    static const Suite SUITES[] = {
+        { "MetricColumns", TestMetricColumns },
+        { "IntervalIndex", TestIntervalIndex },
+        { "Deflate", TestDeflate },
+        { "MessagePack", TestMessagePack },
+        { "JsonReader", TestJsonReader },
+        { "HttpRequestParser", TestHttpRequestParser },
+    };
+    for (const Suite& suite : SUITES) {
+        int before = failures;
+        suite.run(rng, rounds);
+        std::cout << (failures == before ? "[PASS] " : "[FAIL] ") << suite.name << std::endl;
+    }
+
+    std::cout << failures << " failed check(s), seed " << seed << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -72,6 +72,35 @@ public:
         return defaultValue;
     }
 
+    bool has(const std::string& key) const {
+        return data.find(key) != data.end();
+    }
+
+    // Whether the value is raw JSON (number, bool, null, array, object) rather than a string
+    bool isRaw(const std::string& key) const {
+        auto rawIt = isRawValue.find(key);
+        return (rawIt != isRawValue.end()) && rawIt->second;
+    }
+
+    std::vector<std::string> keys() const {
+        std::vector<std::string> result;
+        for (const auto& pair : data) {
+            result.push_back(pair.first);
+        }
+        return result;
+    }
+
+    // Value exactly as toString() writes it (quoted and escaped unless raw)
+    std::string getSerialized(const std::string& key) const {
+        auto it = data.find(key);
+        if (it == data.end()) {
+            return "null";
+        }
+        auto rawIt = isRawValue.find(key);
+        bool isRaw = (rawIt != isRawValue.end()) && rawIt->second;
+        return isRaw ? it->second : "\"" + escapeJsonString(it->second) + "\"";
+    }
+
     bool getBool(const std::string& key, bool defaultValue = false) const {
         auto it = data.find(key);
         if (it != data.end()) {
@@ -1,9 +1,20 @@
 """
 Windows Camera Vision - OPTIMIZED FastVLM
 Lower resolution + fewer tokens for 2x speed improvement
+
+The C++ engine captions natively by default. Run this client only with
+`PerceptionEngine.exe --console --camera=python`:
+  --transport shm   (default) frames come from the engine's shared-memory ring,
+                    captions go back the same way; the engine owns the camera
+  --transport http  opens the camera here and POSTs to /update_context
 """
 
+import argparse
+import ctypes
+import mmap
+import struct
 import time
+import numpy as np
 import requests
 import cv2
 import torch
@@ -13,6 +24,78 @@ from transformers import AutoTokenizer, AutoModelForCausalLM
 SERVER_URL = "http://127.0.0.1:8777/update_context"  # C++ PerceptionEngine server
 IMAGE_TOKEN_INDEX = -200
 
+# Must match SharedFrameRing.h
+RING_NAME = "Local\\NovaPerceptionCameraRing"
+RING_HEADER = struct.Struct("<4s5I")        # magic, version, frame slots/bytes, result slots/bytes
+RING_LATEST_FRAME = 24
+RING_LATEST_RESULT = 32
+RING_HEADER_SIZE = 64
+SLOT_HEADER_SIZE = 32
+FRAME_SLOT_HEADER = struct.Struct("<q4Iq")  # state, width, height, stride, pad, timestampMs
+RESULT_SLOT_FIELDS = struct.Struct("<qfI")  # frameNumber, latencyMs, length (after state)
+
+
+class SharedFrameRing:
+    """Client side of the engine's seqlocked frame/result ring."""
+
+    def __init__(self, name=RING_NAME):
+        self.name = name
+        self.buf = None
+        self.last_frame = 0
+        self.results = 0
+
+    def attach(self):
+        probe = mmap.mmap(-1, RING_HEADER_SIZE, tagname=self.name)
+        magic, version, frame_slots, frame_bytes, result_slots, result_bytes = RING_HEADER.unpack_from(probe, 0)
+        probe.close()
+        if magic != b"NVSR" or version != 1:
+            return False
+
+        self.frame_slots, self.frame_bytes = frame_slots, frame_bytes
+        self.result_slots, self.result_bytes = result_slots, result_bytes
+        self.frame_slot_size = SLOT_HEADER_SIZE + frame_bytes
+        self.result_base = RING_HEADER_SIZE + frame_slots * self.frame_slot_size
+        size = self.result_base + result_slots * (SLOT_HEADER_SIZE + result_bytes)
+        self.buf = mmap.mmap(-1, size, tagname=self.name)
+        # Aligned 8-byte ctypes stores for the counters the engine reads
+        self.results = self._int64(RING_LATEST_RESULT).value
+        return True
+
+    def _int64(self, offset):
+        return ctypes.c_int64.from_buffer(self.buf, offset)
+
+    def latest_frame(self):
+        """Newest frame not returned before, or None."""
+        number = self._int64(RING_LATEST_FRAME).value
+        if number <= self.last_frame:
+            return None
+
+        offset = RING_HEADER_SIZE + (number % self.frame_slots) * self.frame_slot_size
+        state, width, height, stride, _, _ = FRAME_SLOT_HEADER.unpack_from(self.buf, offset)
+        if state != 2 * number:
+            return None
+        start = offset + SLOT_HEADER_SIZE
+        pixels = bytes(self.buf[start:start + stride * height])
+        if self._int64(offset).value != 2 * number:
+            return None  # Overwritten while copying; take the next one
+
+        self.last_frame = number
+        frame = np.frombuffer(pixels, dtype=np.uint8).reshape(height, stride // 3, 3)
+        return number, frame
+
+    def publish_result(self, frame_number, text, latency_ms):
+        self.results += 1
+        number = self.results
+        offset = self.result_base + (number % self.result_slots) * (SLOT_HEADER_SIZE + self.result_bytes)
+        data = text.encode("utf-8")[:self.result_bytes]
+
+        state = self._int64(offset)
+        state.value = 2 * number - 1
+        RESULT_SLOT_FIELDS.pack_into(self.buf, offset + 8, frame_number, latency_ms, len(data))
+        self.buf[offset + SLOT_HEADER_SIZE:offset + SLOT_HEADER_SIZE + len(data)] = data
+        state.value = 2 * number
+        self._int64(RING_LATEST_RESULT).value = number
+
 class FastVLMEngine:
     def __init__(self):
         print("🔧 Loading FastVLM-0.5B model (optimized mode)...")
@@ -66,7 +149,7 @@ class FastVLMEngine:
                     max_new_tokens=50,      # MUCH shorter
                     temperature=0.0,        # Lower for faster
                     do_sample=False,        # Greedy = faster
-                    use_cache=False,        # CRITICAL: Don't accumulate KV cache
+                    use_cache=True,         # Fresh cache per generate() call, nothing accumulates
                 )
 
             # Clear any cached state to prevent degradation
@@ -109,11 +192,7 @@ class FastVLMEngine:
             print(f"❌ Error: {e}")
             return "Error", 0
 
-def main():
-    print("="*60)
-    print("📷 CAMERA VISION - FastVLM OPTIMIZED")
-    print("="*60)
-
+def run_http(vision_engine):
     cap = cv2.VideoCapture(0, cv2.CAP_DSHOW)  # Use DirectShow backend
     if not cap.isOpened():
         print("❌ Failed to open camera")
@@ -123,19 +202,6 @@ def main():
     cap.set(cv2.CAP_PROP_FRAME_HEIGHT, 240)
     print("✅ Camera initialized (320x240 - optimized)")
 
-    try:
-        vision_engine = FastVLMEngine()
-    except Exception as e:
-        print(f"❌ Failed to initialize: {e}")
-        cap.release()
-        return
-
-    print(f"\n🚀 Starting optimized camera monitoring...")
-    print(f"   Optimizations: 224x224 input, 50 tokens, greedy decode")
-    print(f"   Expected latency: 8-12 seconds (2x faster)")
-    print(f"   Update: Every 10 seconds")
-    print(f"   Press Ctrl+C to stop\n")
-
     frame_count = 0
 
     try:
@@ -168,5 +234,58 @@ def main():
     finally:
         cap.release()
 
+
+def run_shm(vision_engine):
+    ring = SharedFrameRing()
+    print(f"⏳ Waiting for PerceptionEngine ring ({ring.name})...")
+    while not ring.attach():
+        time.sleep(1)
+    print("✅ Attached to shared frame ring")
+
+    try:
+        while True:
+            latest = ring.latest_frame()
+            if latest:
+                frame_number, frame = latest
+                print(f"\n📸 Frame {frame_number}")
+
+                description, latency = vision_engine.describe_scene(frame)
+                print(f"   Scene: {description}")
+                print(f"   ⚡ Latency: {latency:.0f}ms ({latency/1000:.1f}s)")
+                ring.publish_result(frame_number, description, latency)
+                time.sleep(10)
+            else:
+                time.sleep(0.1)
+
+    except KeyboardInterrupt:
+        print("\n\n👋 Stopping...")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="FastVLM camera client for PerceptionEngine")
+    parser.add_argument("--transport", choices=["shm", "http"], default="shm",
+                        help="shm: frames/captions via the engine's shared memory; http: own camera + POST")
+    args = parser.parse_args()
+
+    print("="*60)
+    print("📷 CAMERA VISION - FastVLM OPTIMIZED")
+    print("="*60)
+
+    try:
+        vision_engine = FastVLMEngine()
+    except Exception as e:
+        print(f"❌ Failed to initialize: {e}")
+        return
+
+    print(f"\n🚀 Starting optimized camera monitoring ({args.transport})...")
+    print(f"   Optimizations: 224x224 input, 50 tokens, greedy decode")
+    print(f"   Update: Every 10 seconds")
+    print(f"   Press Ctrl+C to stop\n")
+
+    if args.transport == "shm":
+        run_shm(vision_engine)
+    else:
+        run_http(vision_engine)
+
 if __name__ == "__main__":
     main()